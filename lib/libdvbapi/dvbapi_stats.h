@@ -0,0 +1,55 @@
+/*
+ * libdvbapi - a DVB API library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBAPI_STATS_H
+#define LIBDVBAPI_STATS_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct dvbstats_set;
+
+/**
+ * The libdvbapi performance counters. Dump them with dvbstats_dump() from
+ * libdvbmisc/dvbstats.h, or have them dumped at exit by setting DVB_STATS in
+ * the environment.
+ */
+extern struct dvbstats_set dvbapi_stats;
+
+enum dvbapi_stats_counter {
+	DVBAPI_STATS_DVR_BYTES,		/* bytes from dvbdemux_stream_get() */
+	DVBAPI_STATS_DVR_OVERFLOWS,	/* data lost behind dvbdemux_stream_get() */
+	DVBAPI_STATS_TUNES,		/* parameters sent to a frontend */
+	DVBAPI_STATS_DISEQC_COMMANDS,	/* DiSEqC messages sent */
+	DVBAPI_STATS_COUNTERS
+};
+
+enum dvbapi_stats_histogram {
+	DVBAPI_STATS_DVR_READ_BYTES,	/* sizes of the buffers from dvbdemux_stream_get() */
+	DVBAPI_STATS_HISTOGRAMS
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <sys/param.h>
 #include <sys/ioctl.h>
+#include <sys/poll.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <ctype.h>
@@ -30,6 +31,18 @@
 #include <linux/dvb/ca.h>
 #include "dvbca.h"
 
+/* frames up to this size are put together on the stack */
+#define DVBCA_LINK_STACK_FRAME 4096
+
+/* dropped from the kernel headers along with the av7110 descramblers */
+#ifndef CA_SET_PID
+struct ca_pid {
+	unsigned int pid;
+	int index;		/* -1 == disable */
+};
+#define CA_SET_PID _IOW('o', 135, struct ca_pid)
+#endif
+
 
 int dvbca_open(int adapter, int cadevice)
 {
@@ -85,40 +98,123 @@ int dvbca_get_cam_state(int fd, uint8_t slot)
 	return -1;
 }
 
-int dvbca_link_write(int fd, uint8_t slot, uint8_t connection_id,
-		     uint8_t *data, uint16_t data_length)
+int dvbca_link_buffer_size(int fd, uint8_t slot, uint32_t requested)
 {
-	uint8_t *buf = malloc(data_length + 2);
-	if (buf == NULL)
+	if (dvbca_get_interface_type(fd, slot) != DVBCA_INTERFACE_LINK)
 		return -1;
 
-	buf[0] = slot;
-	buf[1] = connection_id;
-	memcpy(buf+2, data, data_length);
+	if (requested > DVBCA_LINK_MAX_TPDU)
+		return DVBCA_LINK_MAX_TPDU;
+	return requested;
+}
 
-	int result = write(fd, buf, data_length+2);
-	free(buf);
-	return result;
+int dvbca_link_write(int fd, uint8_t slot, uint8_t connection_id,
+		     uint8_t *data, uint16_t data_length)
+{
+	struct iovec iov;
+
+	iov.iov_base = data;
+	iov.iov_len = data_length;
+	return dvbca_link_writev(fd, slot, connection_id, &iov, 1);
 }
 
 int dvbca_link_read(int fd, uint8_t *slot, uint8_t *connection_id,
 		     uint8_t *data, uint16_t data_length)
 {
+	uint8_t stack[DVBCA_LINK_HEADER + DVBCA_LINK_STACK_FRAME];
+	uint8_t *buf = stack;
 	int size;
 
-	uint8_t *buf = malloc(data_length + 2);
-	if (buf == NULL)
+	if ((data_length > DVBCA_LINK_STACK_FRAME) &&
+	    ((buf = malloc(data_length + DVBCA_LINK_HEADER)) == NULL))
 		return -1;
 
-	if ((size = read(fd, buf, data_length+2)) < 2)
+	if ((size = read(fd, buf, data_length + DVBCA_LINK_HEADER)) < DVBCA_LINK_HEADER) {
+		if (buf != stack)
+			free(buf);
 		return -1;
+	}
 
 	*slot = buf[0];
 	*connection_id = buf[1];
-	memcpy(data, buf+2, size-2);
-	free(buf);
+	memcpy(data, buf + DVBCA_LINK_HEADER, size - DVBCA_LINK_HEADER);
+	if (buf != stack)
+		free(buf);
+
+	return size - DVBCA_LINK_HEADER;
+}
+
+int dvbca_link_writev(int fd, uint8_t slot, uint8_t connection_id,
+		      const struct iovec *iov, int iovcnt)
+{
+	uint8_t stack[DVBCA_LINK_HEADER + DVBCA_LINK_STACK_FRAME];
+	uint8_t *buf = stack;
+	size_t length = DVBCA_LINK_HEADER;
+	int result;
+	int i;
+
+	for(i=0; i < iovcnt; i++)
+		length += iov[i].iov_len;
+	if ((length > sizeof(stack)) && ((buf = malloc(length)) == NULL))
+		return -1;
+
+	buf[0] = slot;
+	buf[1] = connection_id;
+	length = DVBCA_LINK_HEADER;
+	for(i=0; i < iovcnt; i++) {
+		memcpy(buf + length, iov[i].iov_base, iov[i].iov_len);
+		length += iov[i].iov_len;
+	}
+
+	result = write(fd, buf, length);
+	if (buf != stack)
+		free(buf);
+	return result;
+}
+
+int dvbca_link_write_frame(int fd, uint8_t slot, uint8_t connection_id,
+			   uint8_t *frame, uint16_t data_length)
+{
+	frame[0] = slot;
+	frame[1] = connection_id;
+	return write(fd, frame, data_length + DVBCA_LINK_HEADER);
+}
+
+int dvbca_link_read_frames(int fd, uint8_t *buf, size_t size, uint16_t frame_size,
+			   struct dvbca_link_frame *frames, int count)
+{
+	struct pollfd pollfd;
+	size_t used = 0;
+	int n = 0;
+	int got;
+
+	while ((n < count) && ((size - used) >= ((size_t) frame_size + DVBCA_LINK_HEADER))) {
+		// only the first one is waited for
+		if (n) {
+			pollfd.fd = fd;
+			pollfd.events = POLLIN;
+			pollfd.revents = 0;
+			if ((poll(&pollfd, 1, 0) != 1) || !(pollfd.revents & POLLIN))
+				break;
+		}
+
+		got = read(fd, buf + used, frame_size + DVBCA_LINK_HEADER);
+		if (got < DVBCA_LINK_HEADER) {
+			// a later failure shows up again on the next call
+			if (n)
+				break;
+			return -1;
+		}
+
+		frames[n].slot = buf[used];
+		frames[n].connection_id = buf[used + 1];
+		frames[n].length = got - DVBCA_LINK_HEADER;
+		frames[n].data = buf + used + DVBCA_LINK_HEADER;
+		used += got;
+		n++;
+	}
 
-	return size - 2;
+	return n;
 }
 
 int dvbca_hlci_write(int fd, uint8_t *data, uint16_t data_length)
@@ -157,3 +253,156 @@ int dvbca_hlci_read(int fd, uint32_t app_tag, uint8_t *data,
 	memcpy(data, msg.msg, msg.length);
 	return msg.length;
 }
+
+int dvbca_descr_init(struct dvbca_descr *descr, int fd)
+{
+	struct ca_descr_info info;
+	struct ca_caps caps;
+	int i;
+
+	memset(descr, 0, sizeof(struct dvbca_descr));
+	descr->fd = fd;
+	if (ioctl(fd, CA_GET_DESCR_INFO, &info) == 0) {
+		descr->num = info.num;
+	} else if (ioctl(fd, CA_GET_CAP, &caps) == 0) {
+		descr->num = caps.descr_num;
+	}
+	if (descr->num > DVBCA_DESCR_MAX_SLOTS)
+		descr->num = DVBCA_DESCR_MAX_SLOTS;
+	for (i = 0; i < DVBCA_DESCR_MAX_SLOTS; i++)
+		descr->slots[i].ecm_pid = -1;
+
+	return (descr->num > 0) ? descr->num : -1;
+}
+
+static int dvbca_descr_set_pid(struct dvbca_descr *descr, uint16_t pid, int index)
+{
+	struct ca_pid ca_pid;
+
+	ca_pid.pid = pid;
+	ca_pid.index = index;
+	descr->ioctls++;
+	return ioctl(descr->fd, CA_SET_PID, &ca_pid);
+}
+
+int dvbca_descr_find(struct dvbca_descr *descr, int ecm_pid)
+{
+	int i;
+
+	if (ecm_pid < 0)
+		return -1;
+	for (i = 0; i < descr->num; i++) {
+		if (descr->slots[i].ecm_pid == ecm_pid)
+			return i;
+	}
+	return -1;
+}
+
+int dvbca_descr_set_pids(struct dvbca_descr *descr,
+			 const struct dvbca_descr_pid *pids, int count)
+{
+	int used[DVBCA_DESCR_MAX_SLOTS];
+	int index[DVBCA_DESCR_MAX_PIDS];
+	int unassigned = 0;
+	int i, j;
+
+	if (count > DVBCA_DESCR_MAX_PIDS)
+		count = DVBCA_DESCR_MAX_PIDS;
+
+	// keep the descramblers of ECM PIDs still wanted, free the rest
+	memset(used, 0, sizeof(used));
+	for (i = 0; i < count; i++) {
+		if ((j = dvbca_descr_find(descr, pids[i].ecm_pid)) >= 0)
+			used[j] = 1;
+	}
+	for (j = 0; j < descr->num; j++) {
+		if (!used[j]) {
+			descr->slots[j].ecm_pid = -1;
+			descr->slots[j].keys_valid = 0;
+		}
+	}
+
+	// then hand out free ones to new ECM PIDs
+	for (i = 0; i < count; i++) {
+		index[i] = -1;
+		if (pids[i].ecm_pid < 0)
+			continue;
+		if ((index[i] = dvbca_descr_find(descr, pids[i].ecm_pid)) >= 0)
+			continue;
+		for (j = 0; j < descr->num; j++) {
+			if (descr->slots[j].ecm_pid == -1) {
+				descr->slots[j].ecm_pid = pids[i].ecm_pid;
+				index[i] = j;
+				break;
+			}
+		}
+		if (index[i] < 0)
+			unassigned++;
+	}
+
+	// disable the PIDs no longer descrambled...
+	for (i = 0; i < descr->pid_count; i++) {
+		for (j = 0; j < count; j++) {
+			if ((pids[j].pid == descr->pids[i]) && (index[j] >= 0))
+				break;
+		}
+		if ((j == count) && dvbca_descr_set_pid(descr, descr->pids[i], -1))
+			return -1;
+	}
+
+	// ...and set those which are new or moved
+	for (j = 0; j < count; j++) {
+		if (index[j] < 0)
+			continue;
+		for (i = 0; i < descr->pid_count; i++) {
+			if (descr->pids[i] == pids[j].pid)
+				break;
+		}
+		if ((i < descr->pid_count) && (descr->pid_index[i] == index[j]))
+			continue;
+		if (dvbca_descr_set_pid(descr, pids[j].pid, index[j]))
+			return -1;
+	}
+
+	descr->pid_count = 0;
+	for (j = 0; j < count; j++) {
+		if (index[j] < 0)
+			continue;
+		descr->pids[descr->pid_count] = pids[j].pid;
+		descr->pid_index[descr->pid_count] = index[j];
+		descr->pid_count++;
+	}
+
+	return unassigned;
+}
+
+int dvbca_descr_set_key(struct dvbca_descr *descr, int index, int parity,
+			const uint8_t cw[8])
+{
+	struct dvbca_descr_slot *slot;
+	struct ca_descr ca_descr;
+
+	if ((index < 0) || (index >= descr->num) || (parity & ~1))
+		return -1;
+	slot = &descr->slots[index];
+	if ((slot->keys_valid & (1 << parity)) && !memcmp(slot->cw[parity], cw, 8))
+		return 1;
+
+	ca_descr.index = index;
+	ca_descr.parity = parity;
+	memcpy(ca_descr.cw, cw, 8);
+	descr->ioctls++;
+	if (ioctl(descr->fd, CA_SET_DESCR, &ca_descr)) {
+		slot->keys_valid &= ~(1 << parity);
+		return -1;
+	}
+
+	memcpy(slot->cw[parity], cw, 8);
+	slot->keys_valid |= 1 << parity;
+	return 0;
+}
+
+void dvbca_descr_clear(struct dvbca_descr *descr)
+{
+	dvbca_descr_set_pids(descr, NULL, 0);
+}
@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <sys/uio.h>
 
 /**
  * The types of CA interface we support.
@@ -104,6 +105,92 @@ extern int dvbca_link_write(int fd, uint8_t slot, uint8_t connection_id,
 extern int dvbca_link_read(int fd, uint8_t *slot, uint8_t *connection_id,
 			   uint8_t *data, uint16_t data_length);
 
+/**
+ * Bytes of slot and connection ID in front of each link-layer frame.
+ */
+#define DVBCA_LINK_HEADER 2
+
+/**
+ * The largest TPDU a link-layer CA device passes in one read() or write().
+ * The device reassembles the module's link-layer fragments into whole
+ * TPDUs in a 64k ring buffer, so this is what fits in there with its
+ * length prefix.
+ */
+#define DVBCA_LINK_MAX_TPDU 65533
+
+/**
+ * Agree the size of the TPDUs exchanged with a CAM using a link-layer
+ * interface. The CA device negotiates the link-layer buffer with the module
+ * during its initialisation, and splits and reassembles TPDUs of any size
+ * across it, so what is left to agree here is the TPDU size: the host's
+ * request, limited to what the device can reassemble.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param slot Slot where the requested CAM is in.
+ * @param requested The size the host would like to use.
+ * @return The size to use, or -1 if the slot is not a link-layer one.
+ */
+extern int dvbca_link_buffer_size(int fd, uint8_t slot, uint32_t requested);
+
+/**
+ * Write a message made up of several pieces to a CAM using a link-layer
+ * interface. The CA device takes a frame per write() call, and splits a
+ * writev() into one write() per piece; so the pieces are put together here
+ * instead, on the stack unless the frame is very large.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param slot Slot where the requested CAM is in.
+ * @param connection_id Connection ID of the message.
+ * @param iov Pieces of the message.
+ * @param iovcnt Number of pieces.
+ * @return Number of bytes written including the header, or -1 on failure.
+ */
+extern int dvbca_link_writev(int fd, uint8_t slot, uint8_t connection_id,
+			     const struct iovec *iov, int iovcnt);
+
+/**
+ * Write a message to a CAM using a link-layer interface, without copying
+ * it: the caller leaves DVBCA_LINK_HEADER bytes free in front of the data,
+ * which the header is written into.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param slot Slot where the requested CAM is in.
+ * @param connection_id Connection ID of the message.
+ * @param frame Buffer starting with DVBCA_LINK_HEADER free bytes, followed
+ * by the data.
+ * @param data_length Number of bytes of data after the header.
+ * @return Number of bytes written including the header, or -1 on failure.
+ */
+extern int dvbca_link_write_frame(int fd, uint8_t slot, uint8_t connection_id,
+				  uint8_t *frame, uint16_t data_length);
+
+/**
+ * A message read by dvbca_link_read_frames().
+ */
+struct dvbca_link_frame {
+	uint8_t slot;
+	uint8_t connection_id;
+	uint16_t length;
+	uint8_t *data;		/* in the buffer passed to dvbca_link_read_frames() */
+};
+
+/**
+ * Read all the messages waiting from a CA device using a link-layer
+ * interface. Blocks (unless the handle is non blocking) for the first, but
+ * not for the others, which are read straight into buf.
+ *
+ * @param fd File handle opened with dvbca_open.
+ * @param buf Buffer to read the messages into.
+ * @param size Size of buf.
+ * @param frame_size The largest message expected; reading stops when a
+ * message this large would not fit into what is left of buf.
+ * @param frames Where to describe the messages.
+ * @param count Maximum number of messages to read.
+ * @return Number of messages read, or -1 on failure (with nothing read).
+ */
+extern int dvbca_link_read_frames(int fd, uint8_t *buf, size_t size, uint16_t frame_size,
+				  struct dvbca_link_frame *frames, int count);
+
 // FIXME how do we determine which CAM slot of a CA is meant?
 /**
  * Write a message to a CAM using an HLCI interface.
@@ -128,6 +215,94 @@ extern int dvbca_hlci_write(int fd, uint8_t *data, uint16_t data_length);
 extern int dvbca_hlci_read(int fd, uint32_t app_tag, uint8_t *data,
 			   uint16_t data_length);
 
+/**
+ * Descramblers of a CA device (CA_SET_PID/CA_SET_DESCR), shared out between
+ * the ECM streams of the programs being watched: all the PIDs scrambled
+ * under one ECM PID take the same control words, so they get the same
+ * descrambler index.
+ */
+#define DVBCA_DESCR_MAX_SLOTS	32
+#define DVBCA_DESCR_MAX_PIDS	64
+
+#define DVBCA_PARITY_EVEN	0
+#define DVBCA_PARITY_ODD	1
+
+struct dvbca_descr_slot {
+	int ecm_pid;			/* -1 => free */
+	int keys_valid;			/* bit per parity */
+	uint8_t cw[2][8];		/* as last set */
+};
+
+struct dvbca_descr {
+	int fd;
+	int num;			/* descramblers in use, up to DVBCA_DESCR_MAX_SLOTS */
+	struct dvbca_descr_slot slots[DVBCA_DESCR_MAX_SLOTS];
+	int pid_count;
+	uint16_t pids[DVBCA_DESCR_MAX_PIDS];	/* as programmed */
+	int pid_index[DVBCA_DESCR_MAX_PIDS];
+	unsigned int ioctls;		/* CA_SET_PID and CA_SET_DESCR calls made */
+};
+
+/**
+ * A PID to descramble, and the ECM PID its control words come from.
+ */
+struct dvbca_descr_pid {
+	uint16_t pid;
+	int ecm_pid;			/* -1 => in the clear */
+};
+
+/**
+ * Start managing the descramblers of a CA device.
+ *
+ * @param descr The descrambler state.
+ * @param fd File handle opened with dvbca_open.
+ * @return Number of descramblers, or -1 if the device has none.
+ */
+extern int dvbca_descr_init(struct dvbca_descr *descr, int fd);
+
+/**
+ * Program the descramblers for a new set of PIDs, typically those of a PMT
+ * just received. Only changes are sent down: PIDs which keep their ECM PID
+ * keep their index (and its control words, so there is no glitch), dropped
+ * PIDs are disabled, and descramblers of ECM PIDs no longer used are freed.
+ *
+ * @param descr The descrambler state.
+ * @param pids The PIDs.
+ * @param count Number of PIDs (up to DVBCA_DESCR_MAX_PIDS).
+ * @return Number of PIDs left without a descrambler (there are more ECM
+ * streams than descramblers), or -1 if an ioctl failed.
+ */
+extern int dvbca_descr_set_pids(struct dvbca_descr *descr,
+				const struct dvbca_descr_pid *pids, int count);
+
+/**
+ * @param descr The descrambler state.
+ * @param ecm_pid An ECM PID.
+ * @return The index of its descrambler, or -1 if it has none.
+ */
+extern int dvbca_descr_find(struct dvbca_descr *descr, int ecm_pid);
+
+/**
+ * Load control words into a descrambler: one CA_SET_DESCR, or none if the
+ * descrambler has them already. Control words change at every crypto
+ * period, and must be in place before the stream switches parity.
+ *
+ * @param descr The descrambler state.
+ * @param index Descrambler index, as from dvbca_descr_find().
+ * @param parity DVBCA_PARITY_EVEN or DVBCA_PARITY_ODD.
+ * @param cw The control words.
+ * @return 0 if they were loaded, 1 if they were already, -1 on failure.
+ */
+extern int dvbca_descr_set_key(struct dvbca_descr *descr, int index, int parity,
+			       const uint8_t cw[8]);
+
+/**
+ * Disable all the PIDs and free all the descramblers.
+ *
+ * @param descr The descrambler state.
+ */
+extern void dvbca_descr_clear(struct dvbca_descr *descr);
+
 #ifdef __cplusplus
 }
 #endif
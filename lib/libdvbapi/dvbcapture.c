@@ -0,0 +1,588 @@
+/*
+ * libdvbcapture - io_uring DVR capture engine
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "dvbcapture.h"
+
+// user_data of the operations which aren't on a buffer; buffers are aligned,
+// so the bottom bit of their address tells a write from a read
+#define DVBCAPTURE_TIMEOUT 0
+#define DVBCAPTURE_CANCEL 1
+#define DVBCAPTURE_WRITE 1
+
+// timeouts which may be left over from interrupted waits
+#define DVBCAPTURE_MAX_TIMEOUTS 8
+
+// how long dvbcapture_destroy() waits for the output to drain
+#define DVBCAPTURE_DRAIN_MS 5000
+
+struct dvbcapture_stream;
+
+struct dvbcapture_buffer {
+	struct dvbcapture_stream *stream;
+	uint8_t *data;
+	int index;			// in the registered buffers
+	size_t len;			// bytes of data in it
+	size_t done;			// bytes of that written so far
+	uint64_t offset;		// in the output, if it is a regular file
+	struct dvbcapture_buffer *next;	// on the free list or write queue
+};
+
+struct dvbcapture_stream {
+	int dvrfd;
+	int outfd;
+	int seekable;
+	uint64_t offset;		// next output offset, if seekable
+	dvbcapture_read_callback callback;
+	void *arg;
+
+	struct dvbcapture_buffer *free;
+	struct dvbcapture_buffer *reading;
+	struct dvbcapture_buffer *queue;	// not seekable: waiting to be written,
+	struct dvbcapture_buffer *queue_tail;	// the first one in flight
+	int writes;			// in flight
+	int stalled;
+	int done;			// no more reads are to be made
+	int error;
+	struct dvbcapture_stats stats;
+};
+
+struct dvbcapture {
+	int fd;
+
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	struct io_uring_sqe *sqes;
+	unsigned int pending;		// queued, but not submitted yet
+
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+
+	void *sq_map;
+	size_t sq_map_size;
+	void *cq_map;
+	size_t cq_map_size;
+	size_t sqes_size;
+
+	int fixed;			// the buffers are registered
+	uint8_t *memory;
+	size_t memory_size;
+	size_t buffer_size;
+	int buffers;			// per stream
+	struct dvbcapture_buffer *buffer_list;
+
+	struct dvbcapture_stream *streams;
+	int max_streams;
+	int stream_count;
+
+	struct __kernel_timespec timeout;
+	int timeouts;			// in flight
+};
+
+static int io_uring_setup(unsigned int entries, struct io_uring_params *p)
+{
+	return syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned int to_submit, unsigned int min_complete, unsigned int flags)
+{
+	return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned int opcode, void *arg, unsigned int nr_args)
+{
+	return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/**
+ * Queue an operation; it goes to the kernel with the next io_uring_enter().
+ * There is always room, as the ring has an entry for every buffer.
+ */
+static void dvbcapture_queue(struct dvbcapture *cap, int opcode, int fd, void *addr,
+			     unsigned int len, uint64_t off, int index, uint64_t user_data)
+{
+	unsigned int tail = *cap->sq_tail;
+	unsigned int idx = tail & *cap->sq_mask;
+	struct io_uring_sqe *sqe = &cap->sqes[idx];
+
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	sqe->opcode = opcode;
+	sqe->fd = fd;
+	sqe->addr = (uintptr_t) addr;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->buf_index = index;
+	sqe->user_data = user_data;
+	cap->sq_array[idx] = idx;
+
+	__atomic_store_n(cap->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	cap->pending++;
+}
+
+static int dvbcapture_running(struct dvbcapture_stream *stream)
+{
+	return !stream->done || stream->reading || stream->writes || stream->queue;
+}
+
+static void dvbcapture_submit_read(struct dvbcapture *cap, struct dvbcapture_stream *stream)
+{
+	struct dvbcapture_buffer *buf = stream->free;
+
+	if (stream->done || stream->reading)
+		return;
+	if (buf == NULL) {
+		if (!stream->stalled)
+			stream->stats.stalls++;
+		stream->stalled = 1;
+		return;
+	}
+	stream->stalled = 0;
+	stream->free = buf->next;
+	stream->reading = buf;
+
+	// DVRs have no position; -1 keeps any other file's
+	dvbcapture_queue(cap, cap->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, stream->dvrfd,
+			 buf->data, cap->buffer_size, (uint64_t) -1, buf->index, (uintptr_t) buf);
+}
+
+static void dvbcapture_submit_write(struct dvbcapture *cap, struct dvbcapture_buffer *buf)
+{
+	struct dvbcapture_stream *stream = buf->stream;
+
+	dvbcapture_queue(cap, cap->fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, stream->outfd,
+			 buf->data + buf->done, buf->len - buf->done,
+			 stream->seekable ? buf->offset + buf->done : (uint64_t) -1,
+			 buf->index, (uintptr_t) buf | DVBCAPTURE_WRITE);
+	stream->writes++;
+}
+
+static void dvbcapture_free_buffer(struct dvbcapture_stream *stream, struct dvbcapture_buffer *buf)
+{
+	buf->next = stream->free;
+	stream->free = buf;
+}
+
+static void dvbcapture_stop(struct dvbcapture_stream *stream, int error, int output)
+{
+	struct dvbcapture_buffer *keep;
+	struct dvbcapture_buffer *buf;
+	struct dvbcapture_buffer *next;
+
+	if (!stream->error)
+		stream->error = error;
+	stream->done = 1;
+	if (!output)
+		return;
+
+	// the output has failed, so the data waiting for it is dropped; only
+	// the write in flight is left to complete
+	keep = stream->writes ? stream->queue : NULL;
+	for(buf = keep ? keep->next : stream->queue; buf; buf = next) {
+		next = buf->next;
+		dvbcapture_free_buffer(stream, buf);
+	}
+	if (keep)
+		keep->next = NULL;
+	stream->queue = keep;
+	stream->queue_tail = keep;
+}
+
+static void dvbcapture_read_done(struct dvbcapture *cap, struct dvbcapture_buffer *buf, int res)
+{
+	struct dvbcapture_stream *stream = buf->stream;
+
+	stream->reading = NULL;
+	if (res < 0)
+		errno = -res;
+	if (stream->callback)
+		stream->callback(stream->arg, cap->buffer_size, (res < 0) ? -1 : res);
+
+	if (res <= 0) {
+		dvbcapture_free_buffer(stream, buf);
+		switch(-res) {
+		case 0:			// end of the input
+			stream->done = 1;
+			break;
+		case EOVERFLOW:		// the error flag has been cleared; carry on
+			stream->stats.overflows++;
+			break;
+		case EINTR:
+		case EAGAIN:
+			break;
+		case ECANCELED:
+			stream->done = 1;
+			break;
+		default:
+			dvbcapture_stop(stream, -res, 0);
+			break;
+		}
+		dvbcapture_submit_read(cap, stream);
+		return;
+	}
+
+	stream->stats.reads++;
+	stream->stats.bytes_read += res;
+	if (stream->error) {
+		// nowhere to write it
+		dvbcapture_free_buffer(stream, buf);
+		return;
+	}
+	buf->len = res;
+	buf->done = 0;
+	buf->next = NULL;
+
+	// get the next read going before writing this one out
+	dvbcapture_submit_read(cap, stream);
+
+	if (stream->seekable) {
+		buf->offset = stream->offset;
+		stream->offset += res;
+		dvbcapture_submit_write(cap, buf);
+		return;
+	}
+	if (stream->queue_tail)
+		stream->queue_tail->next = buf;
+	else
+		stream->queue = buf;
+	stream->queue_tail = buf;
+	if (!stream->writes)
+		dvbcapture_submit_write(cap, buf);
+}
+
+static void dvbcapture_write_done(struct dvbcapture *cap, struct dvbcapture_buffer *buf, int res)
+{
+	struct dvbcapture_stream *stream = buf->stream;
+
+	stream->writes--;
+	if ((res == -EINTR) || (res == -EAGAIN)) {
+		dvbcapture_submit_write(cap, buf);
+		return;
+	}
+	if (res > 0) {
+		stream->stats.bytes_written += res;
+		buf->done += res;
+		if (buf->done < buf->len) {
+			dvbcapture_submit_write(cap, buf);
+			return;
+		}
+	}
+
+	if (!stream->seekable) {
+		stream->queue = buf->next;
+		if (stream->queue == NULL)
+			stream->queue_tail = NULL;
+	}
+	dvbcapture_free_buffer(stream, buf);
+
+	if (res <= 0)
+		dvbcapture_stop(stream, res ? -res : EIO, 1);
+	else if (!stream->seekable && stream->queue)
+		dvbcapture_submit_write(cap, stream->queue);
+
+	if (stream->stalled)
+		dvbcapture_submit_read(cap, stream);
+}
+
+static void dvbcapture_reap(struct dvbcapture *cap)
+{
+	unsigned int head = *cap->cq_head;
+	unsigned int tail = __atomic_load_n(cap->cq_tail, __ATOMIC_ACQUIRE);
+
+	while(head != tail) {
+		struct io_uring_cqe *cqe = &cap->cqes[head & *cap->cq_mask];
+		uint64_t user_data = cqe->user_data;
+		int res = cqe->res;
+
+		head++;
+		__atomic_store_n(cap->cq_head, head, __ATOMIC_RELEASE);
+
+		if (user_data == DVBCAPTURE_TIMEOUT)
+			cap->timeouts--;
+		else if (user_data == DVBCAPTURE_CANCEL)
+			;
+		else if (user_data & DVBCAPTURE_WRITE)
+			dvbcapture_write_done(cap, (struct dvbcapture_buffer *) (uintptr_t) (user_data & ~DVBCAPTURE_WRITE), res);
+		else
+			dvbcapture_read_done(cap, (struct dvbcapture_buffer *) (uintptr_t) user_data, res);
+
+		tail = __atomic_load_n(cap->cq_tail, __ATOMIC_ACQUIRE);
+	}
+}
+
+static void dvbcapture_unmap(struct dvbcapture *cap)
+{
+	if (cap->sqes)
+		munmap(cap->sqes, cap->sqes_size);
+	if (cap->cq_map && (cap->cq_map != cap->sq_map))
+		munmap(cap->cq_map, cap->cq_map_size);
+	if (cap->sq_map)
+		munmap(cap->sq_map, cap->sq_map_size);
+	if (cap->fd != -1)
+		close(cap->fd);
+	if (cap->memory)
+		munmap(cap->memory, cap->memory_size);
+	free(cap->buffer_list);
+	free(cap->streams);
+	free(cap);
+}
+
+struct dvbcapture *dvbcapture_create(int max_streams, int buffers, size_t buffer_size)
+{
+	struct dvbcapture *cap;
+	struct io_uring_params p;
+	struct iovec *iovs;
+	long page = sysconf(_SC_PAGESIZE);
+	void *map;
+	int count;
+	int err;
+	int i;
+
+	if ((max_streams < 1) || (buffers < 2) || (buffer_size == 0)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	buffer_size = (buffer_size + page - 1) & ~((size_t) page - 1);
+	count = max_streams * buffers;
+
+	if ((cap = calloc(1, sizeof(struct dvbcapture))) == NULL)
+		return NULL;
+	cap->fd = -1;
+	cap->buffer_size = buffer_size;
+	cap->buffers = buffers;
+	cap->max_streams = max_streams;
+
+	// every buffer can have one operation in flight, plus a cancel for each
+	// stream's read and the timeouts
+	memset(&p, 0, sizeof(p));
+	if ((cap->fd = io_uring_setup(count + max_streams + DVBCAPTURE_MAX_TIMEOUTS, &p)) < 0)
+		goto fail;
+
+	// IORING_OP_READ/WRITE and offsets of -1 came in together
+	if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+		errno = ENOSYS;
+		goto fail;
+	}
+
+	cap->sq_map_size = p.sq_off.array + (p.sq_entries * sizeof(unsigned int));
+	cap->cq_map_size = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cap->cq_map_size > cap->sq_map_size)
+			cap->sq_map_size = cap->cq_map_size;
+		cap->cq_map_size = cap->sq_map_size;
+	}
+	map = mmap(NULL, cap->sq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		   cap->fd, IORING_OFF_SQ_RING);
+	if (map == MAP_FAILED)
+		goto fail;
+	cap->sq_map = map;
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		cap->cq_map = cap->sq_map;
+	} else {
+		map = mmap(NULL, cap->cq_map_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+			   cap->fd, IORING_OFF_CQ_RING);
+		if (map == MAP_FAILED)
+			goto fail;
+		cap->cq_map = map;
+	}
+	cap->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	map = mmap(NULL, cap->sqes_size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		   cap->fd, IORING_OFF_SQES);
+	if (map == MAP_FAILED)
+		goto fail;
+	cap->sqes = map;
+
+	cap->sq_tail = (unsigned int *) ((uint8_t *) cap->sq_map + p.sq_off.tail);
+	cap->sq_mask = (unsigned int *) ((uint8_t *) cap->sq_map + p.sq_off.ring_mask);
+	cap->sq_array = (unsigned int *) ((uint8_t *) cap->sq_map + p.sq_off.array);
+	cap->cq_head = (unsigned int *) ((uint8_t *) cap->cq_map + p.cq_off.head);
+	cap->cq_tail = (unsigned int *) ((uint8_t *) cap->cq_map + p.cq_off.tail);
+	cap->cq_mask = (unsigned int *) ((uint8_t *) cap->cq_map + p.cq_off.ring_mask);
+	cap->cqes = (struct io_uring_cqe *) ((uint8_t *) cap->cq_map + p.cq_off.cqes);
+
+	// the buffers, registered if the locked memory limit allows
+	cap->memory_size = count * buffer_size;
+	map = mmap(NULL, cap->memory_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (map == MAP_FAILED)
+		goto fail;
+	cap->memory = map;
+	cap->buffer_list = calloc(count, sizeof(struct dvbcapture_buffer));
+	cap->streams = calloc(max_streams, sizeof(struct dvbcapture_stream));
+	if ((iovs = calloc(count, sizeof(struct iovec))) == NULL)
+		goto fail;
+	if ((cap->buffer_list == NULL) || (cap->streams == NULL)) {
+		free(iovs);
+		errno = ENOMEM;
+		goto fail;
+	}
+	for(i = 0; i < count; i++) {
+		cap->buffer_list[i].data = cap->memory + (i * buffer_size);
+		cap->buffer_list[i].index = i;
+		iovs[i].iov_base = cap->buffer_list[i].data;
+		iovs[i].iov_len = buffer_size;
+	}
+	if (io_uring_register(cap->fd, IORING_REGISTER_BUFFERS, iovs, count) == 0)
+		cap->fixed = 1;
+	free(iovs);
+
+	return cap;
+
+fail:
+	err = errno;
+	dvbcapture_unmap(cap);
+	errno = err;
+	return NULL;
+}
+
+int dvbcapture_add(struct dvbcapture *cap, int dvrfd, int outfd,
+		   dvbcapture_read_callback callback, void *arg)
+{
+	struct dvbcapture_stream *stream;
+	struct stat st;
+	off_t pos;
+	int i;
+
+	if (cap->stream_count == cap->max_streams) {
+		errno = ENOSPC;
+		return -1;
+	}
+	stream = &cap->streams[cap->stream_count];
+	memset(stream, 0, sizeof(struct dvbcapture_stream));
+	stream->dvrfd = dvrfd;
+	stream->outfd = outfd;
+	stream->callback = callback;
+	stream->arg = arg;
+
+	if ((fstat(outfd, &st) == 0) && S_ISREG(st.st_mode) &&
+	    ((pos = lseek(outfd, 0, SEEK_CUR)) != (off_t) -1)) {
+		stream->seekable = 1;
+		stream->offset = pos;
+	}
+
+	for(i = 0; i < cap->buffers; i++) {
+		struct dvbcapture_buffer *buf = &cap->buffer_list[(cap->stream_count * cap->buffers) + i];
+
+		buf->stream = stream;
+		dvbcapture_free_buffer(stream, buf);
+	}
+
+	return cap->stream_count++;
+}
+
+int dvbcapture_run(struct dvbcapture *cap, int timeout_ms)
+{
+	unsigned int wait = 0;
+	int running = 0;
+	int ret;
+	int i;
+
+	for(i = 0; i < cap->stream_count; i++) {
+		dvbcapture_submit_read(cap, &cap->streams[i]);
+		if (dvbcapture_running(&cap->streams[i]))
+			running++;
+	}
+
+	// a timeout which also ends as soon as anything else completes, so it
+	// doesn't outlive the wait
+	if (running && timeout_ms) {
+		wait = 1;
+		if ((timeout_ms > 0) && (cap->timeouts < DVBCAPTURE_MAX_TIMEOUTS)) {
+			cap->timeout.tv_sec = timeout_ms / 1000;
+			cap->timeout.tv_nsec = (timeout_ms % 1000) * 1000000LL;
+			dvbcapture_queue(cap, IORING_OP_TIMEOUT, -1, &cap->timeout, 1, 1, 0,
+					 DVBCAPTURE_TIMEOUT);
+			cap->timeouts++;
+		} else if (timeout_ms > 0) {
+			wait = 0;
+		}
+	}
+
+	ret = io_uring_enter(cap->fd, cap->pending, wait, wait ? IORING_ENTER_GETEVENTS : 0);
+	if (ret >= 0) {
+		cap->pending -= ret;
+	} else if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) {
+		return -1;
+	}
+
+	dvbcapture_reap(cap);
+
+	// anything the completions queued goes in now, rather than after the
+	// next wait
+	if (cap->pending && ((ret = io_uring_enter(cap->fd, cap->pending, 0, 0)) > 0))
+		cap->pending -= ret;
+
+	running = 0;
+	for(i = 0; i < cap->stream_count; i++) {
+		if (dvbcapture_running(&cap->streams[i]))
+			running++;
+	}
+	return running;
+}
+
+void dvbcapture_get_stats(struct dvbcapture *cap, int stream, struct dvbcapture_stats *stats)
+{
+	*stats = cap->streams[stream].stats;
+}
+
+int dvbcapture_get_error(struct dvbcapture *cap, int stream)
+{
+	return cap->streams[stream].error;
+}
+
+void dvbcapture_destroy(struct dvbcapture *cap)
+{
+	struct timespec start;
+	struct timespec now;
+	int i;
+
+	for(i = 0; i < cap->stream_count; i++) {
+		struct dvbcapture_stream *stream = &cap->streams[i];
+
+		stream->done = 1;
+		if (stream->reading)
+			dvbcapture_queue(cap, IORING_OP_ASYNC_CANCEL, -1, stream->reading, 0, 0, 0,
+					 DVBCAPTURE_CANCEL);
+	}
+
+	// let what has been read be written; a read which can't be cancelled
+	// will complete once the DVR has data
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while(dvbcapture_run(cap, 100) > 0) {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (((now.tv_sec - start.tv_sec) * 1000) + ((now.tv_nsec - start.tv_nsec) / 1000000) >
+		    DVBCAPTURE_DRAIN_MS)
+			break;
+	}
+
+	// closing the ring cancels anything left before the buffers go
+	dvbcapture_unmap(cap);
+}
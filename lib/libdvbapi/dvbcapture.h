@@ -0,0 +1,143 @@
+/*
+ * libdvbcapture - io_uring DVR capture engine
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBCAPTURE_H
+#define LIBDVBCAPTURE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A capture engine copies any number of DVR devices to files or sockets from
+ * a single thread, using io_uring: each stream keeps a read of its DVR in
+ * flight at all times, and the writes of the data read before it are queued
+ * behind it, so the thread only wakes up to hand buffers between the two.
+ *
+ * Each stream has its own set of buffers, which are registered with the
+ * kernel if the locked memory limit allows it. When all of a stream's
+ * buffers are waiting to be written, no more is read from its DVR until one
+ * is free, so the DVR's own buffer absorbs a slow output.
+ *
+ * Output to a regular file is written at explicit offsets, so several writes
+ * may be in flight; anything else (a pipe or socket) gets one write at a time,
+ * in order.
+ *
+ * An engine is not thread safe: all calls for it must be made by one thread.
+ */
+struct dvbcapture;
+
+/**
+ * Counters of one stream.
+ */
+struct dvbcapture_stats {
+	uint64_t bytes_read;		/* from the DVR */
+	uint64_t bytes_written;		/* to the output */
+	uint64_t reads;			/* completed reads */
+	uint64_t overflows;		/* EOVERFLOW from the DVR */
+	uint64_t stalls;		/* reads delayed as all buffers were full */
+};
+
+/**
+ * Called for every completed DVR read, with the same results as read().
+ *
+ * @param arg The argument given to dvbcapture_add().
+ * @param requested The size of the read.
+ * @param result The number of bytes read, or -1 with errno set.
+ */
+typedef void (*dvbcapture_read_callback)(void *arg, int requested, int result);
+
+/**
+ * Create a capture engine.
+ *
+ * @param max_streams The most streams that will be added.
+ * @param buffers Buffers per stream, at least 2.
+ * @param buffer_size Size of each buffer (and so of each DVR read), rounded up
+ * to whole pages.
+ * @return The engine, or NULL with errno set on failure. ENOSYS (or EPERM
+ * where io_uring is disabled) means the kernel can't do it, and the caller
+ * should fall back to read() and write().
+ */
+extern struct dvbcapture *dvbcapture_create(int max_streams, int buffers, size_t buffer_size);
+
+/**
+ * Add a stream to an engine. Capture starts with the next dvbcapture_run().
+ *
+ * @param cap The engine.
+ * @param dvrfd The DVR (or any other file) to read from.
+ * @param outfd Where to write the data; a regular file is written from its
+ * current position.
+ * @param callback Called for each read, or NULL.
+ * @param arg Argument for callback.
+ * @return The stream's number (from 0), or -1 with errno set on failure.
+ */
+extern int dvbcapture_add(struct dvbcapture *cap, int dvrfd, int outfd,
+			  dvbcapture_read_callback callback, void *arg);
+
+/**
+ * Run an engine until something completes or a timeout expires.
+ *
+ * A stream stops when its input ends or on a read or write error other than
+ * EOVERFLOW; dvbcapture_get_error() tells which.
+ *
+ * @param cap The engine.
+ * @param timeout_ms Longest time to wait in milliseconds; 0 only handles
+ * what has completed already, and -1 waits for as long as it takes.
+ * @return The number of streams still running, or -1 with errno set on
+ * failure of the engine itself. EINTR is not a failure.
+ */
+extern int dvbcapture_run(struct dvbcapture *cap, int timeout_ms);
+
+/**
+ * Retrieve the counters of a stream.
+ *
+ * @param cap The engine.
+ * @param stream The stream's number.
+ * @param stats Where to put them.
+ */
+extern void dvbcapture_get_stats(struct dvbcapture *cap, int stream, struct dvbcapture_stats *stats);
+
+/**
+ * Retrieve why a stream has stopped.
+ *
+ * @param cap The engine.
+ * @param stream The stream's number.
+ * @return 0 if it is still running or reached the end of its input, else the
+ * errno of the read or write that failed.
+ */
+extern int dvbcapture_get_error(struct dvbcapture *cap, int stream);
+
+/**
+ * Destroy an engine. The reads in flight are cancelled, but everything which
+ * has been read is written out first. The file descriptors are not closed.
+ *
+ * @param cap The engine.
+ */
+extern void dvbcapture_destroy(struct dvbcapture *cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBDVBCAPTURE_H
@@ -0,0 +1,204 @@
+/*
+ * libdvbclock - stream clock recovery
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <string.h>
+#include <time.h>
+#include "dvbdemux.h"
+#include "dvbclock.h"
+
+static int64_t dvbclock_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+/* kept free of libm, so users of libdvbapi need not link it */
+static double dvbclock_sqrt(double x)
+{
+	double r = (x > 1) ? x : 1;
+	int i;
+
+	if (x <= 0)
+		return 0;
+	for(i=0; i < 64; i++) {
+		double next = (r + x / r) / 2;
+
+		if (next >= r)
+			break;
+		r = next;
+	}
+	return r;
+}
+
+void dvbclock_init(struct dvbclock *clk)
+{
+	memset(clk, 0, sizeof(struct dvbclock));
+}
+
+static void dvbclock_restart(struct dvbclock *clk, uint64_t clock, int64_t local_ns)
+{
+	clk->count = 1;
+	clk->head = 1;
+	clk->local0 = local_ns;
+	clk->stream0 = clock;
+	clk->last_clock = clock;
+	clk->last_stream = 0;
+	clk->local[0] = 0;
+	clk->stream[0] = 0;
+}
+
+/* least squares line through the window, about its means */
+static void dvbclock_fit(struct dvbclock *clk)
+{
+	double sum_local = 0, sum_stream = 0;
+	double sxx = 0, sxy = 0, syy = 0;
+	double residual;
+	int i;
+
+	for(i=0; i < clk->count; i++) {
+		sum_local += clk->local[i];
+		sum_stream += clk->stream[i];
+	}
+	clk->mean_local = sum_local / clk->count;
+	clk->mean_stream = sum_stream / clk->count;
+
+	for(i=0; i < clk->count; i++) {
+		double dx = clk->local[i] - clk->mean_local;
+		double dy = clk->stream[i] - clk->mean_stream;
+
+		sxx += dx * dx;
+		sxy += dx * dy;
+		syy += dy * dy;
+	}
+	if ((sxx <= 0) || (sxy <= 0)) {
+		clk->rate = DVBCLOCK_HZ / 1e9;
+		return;
+	}
+	clk->rate = sxy / sxx;
+	clk->drift_ppm = (clk->rate * 1e9 / DVBCLOCK_HZ - 1.0) * 1e6;
+
+	/* scatter, in local time */
+	residual = syy - (sxy * sxy / sxx);
+	if (residual < 0)
+		residual = 0;
+	clk->jitter_ns = dvbclock_sqrt(residual / clk->count) / clk->rate;
+}
+
+int dvbclock_add(struct dvbclock *clk, uint64_t clock, int64_t local_ns)
+{
+	int64_t step;
+	int64_t stream;
+	int64_t local;
+
+	clock %= DVBCLOCK_WRAP;
+	if (clk->count == 0) {
+		dvbclock_restart(clk, clock, local_ns);
+		return 0;
+	}
+
+	step = ((int64_t) clock - (int64_t) clk->last_clock + DVBCLOCK_WRAP) % DVBCLOCK_WRAP;
+	if (step > DVBCLOCK_WRAP / 2)
+		goto discontinuity;
+	stream = clk->last_stream + step;
+	local = local_ns - clk->local0;
+
+	if (dvbclock_valid(clk)) {
+		double expected = clk->mean_local + (stream - clk->mean_stream) / clk->rate;
+
+		clk->offset_ns = local - expected;
+		if ((clk->offset_ns > DVBCLOCK_MAX_ERROR) || (clk->offset_ns < -DVBCLOCK_MAX_ERROR))
+			goto discontinuity;
+	} else {
+		int64_t prev = clk->local[(clk->head + DVBCLOCK_WINDOW - 1) % DVBCLOCK_WINDOW];
+
+		/* no fit yet: far more stream time passed than local time */
+		if (((step * 1000) / 27) - (local - prev) > DVBCLOCK_MAX_ERROR)
+			goto discontinuity;
+	}
+
+	clk->last_clock = clock;
+	clk->last_stream = stream;
+	clk->local[clk->head] = local;
+	clk->stream[clk->head] = stream;
+	clk->head = (clk->head + 1) % DVBCLOCK_WINDOW;
+	if (clk->count < DVBCLOCK_WINDOW)
+		clk->count++;
+	if (dvbclock_valid(clk))
+		dvbclock_fit(clk);
+	return 0;
+
+discontinuity:
+	clk->discontinuities++;
+	dvbclock_restart(clk, clock, local_ns);
+	return 1;
+}
+
+int dvbclock_add_stc(struct dvbclock *clk, int fd)
+{
+	uint64_t stc;
+	int64_t before, after;
+
+	before = dvbclock_now();
+	if (dvbdemux_get_stc(fd, &stc))
+		return -1;
+	after = dvbclock_now();
+
+	/* the STC is in 90kHz units */
+	return dvbclock_add(clk, stc * 300, before + (after - before) / 2);
+}
+
+int dvbclock_stream_time(struct dvbclock *clk, int64_t local_ns, uint64_t *clock)
+{
+	double stream;
+
+	if (!dvbclock_valid(clk))
+		return -1;
+
+	stream = clk->mean_stream + (local_ns - clk->local0 - clk->mean_local) * clk->rate;
+	*clock = (uint64_t) (((clk->stream0 + (int64_t) stream) % DVBCLOCK_WRAP + DVBCLOCK_WRAP) %
+			     DVBCLOCK_WRAP);
+	return 0;
+}
+
+int dvbclock_local_time(struct dvbclock *clk, uint64_t clock, int64_t *local_ns)
+{
+	int64_t step;
+
+	if (!dvbclock_valid(clk))
+		return -1;
+
+	step = ((int64_t) (clock % DVBCLOCK_WRAP) - (int64_t) clk->last_clock + DVBCLOCK_WRAP) %
+	       DVBCLOCK_WRAP;
+	if (step > DVBCLOCK_WRAP / 2)
+		step -= DVBCLOCK_WRAP;
+
+	*local_ns = clk->local0 + (int64_t) (clk->mean_local +
+		    (clk->last_stream + step - clk->mean_stream) / clk->rate);
+	return 0;
+}
+
+int64_t dvbclock_ticks_to_ns(struct dvbclock *clk, int64_t ticks)
+{
+	if (!dvbclock_valid(clk))
+		return (ticks * 1000) / 27;
+	return (int64_t) (ticks / clk->rate);
+}
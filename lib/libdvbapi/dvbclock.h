@@ -0,0 +1,140 @@
+/*
+ * libdvbclock - stream clock recovery
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBCLOCK_H
+#define LIBDVBCLOCK_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * The 27MHz clock of a program (its PCRs, or the STC of a demux), tracked
+ * against CLOCK_MONOTONIC.
+ *
+ * Each sample pairs a clock value with the local time it was seen. A line is
+ * fitted through the last DVBCLOCK_WINDOW samples by least squares, which
+ * gives the rate of the stream clock against the local one (its drift), and
+ * maps times either way between them. How far the samples scatter about the
+ * line is the jitter; how far the latest one is off it, the offset.
+ *
+ * A sample more than DVBCLOCK_MAX_ERROR ns off the line (or a backwards
+ * step) is a discontinuity: the fit starts over from that sample.
+ */
+
+#define DVBCLOCK_HZ		27000000LL
+#define DVBCLOCK_WRAP		(300LL << 33)
+#define DVBCLOCK_WINDOW		128
+#define DVBCLOCK_MIN_SAMPLES	8
+#define DVBCLOCK_MAX_ERROR	250000000LL
+
+struct dvbclock {
+	int count;			/* samples in the window */
+	int head;			/* next slot to fill */
+	int64_t local0;			/* origin of the samples, ns */
+	int64_t stream0;		/* 27MHz, unwrapped */
+	uint64_t last_clock;		/* last value given, wrapped */
+	int64_t last_stream;		/* ... unwrapped, relative to stream0 */
+	int64_t local[DVBCLOCK_WINDOW];	/* relative to local0 */
+	int64_t stream[DVBCLOCK_WINDOW]; /* relative to stream0 */
+
+	/* results of the fit, once count >= DVBCLOCK_MIN_SAMPLES */
+	double rate;			/* stream ticks per local ns */
+	double mean_local;
+	double mean_stream;
+	double drift_ppm;		/* stream clock fast (+) or slow (-) */
+	double jitter_ns;		/* RMS distance of the samples from the fit */
+	double offset_ns;		/* latest sample's, + => late */
+	unsigned int discontinuities;
+};
+
+/**
+ * Start tracking a clock.
+ *
+ * @param clk The clock.
+ */
+extern void dvbclock_init(struct dvbclock *clk);
+
+/**
+ * Add a sample.
+ *
+ * @param clk The clock.
+ * @param clock 27MHz clock value (a PCR: base * 300 + extension).
+ * @param local_ns CLOCK_MONOTONIC time it was seen at.
+ * @return 1 if it was a discontinuity, 0 otherwise.
+ */
+extern int dvbclock_add(struct dvbclock *clk, uint64_t clock, int64_t local_ns);
+
+/**
+ * Sample the STC of a demux (which must be filtering a PCR PID).
+ *
+ * @param clk The clock.
+ * @param fd Demux handle as opened with dvbdemux_open_demux().
+ * @return As dvbclock_add(), or -1 if the STC could not be read.
+ */
+extern int dvbclock_add_stc(struct dvbclock *clk, int fd);
+
+/**
+ * @param clk The clock.
+ * @return 1 if there are enough samples for the results to mean anything.
+ */
+static inline int dvbclock_valid(struct dvbclock *clk)
+{
+	return clk->count >= DVBCLOCK_MIN_SAMPLES;
+}
+
+/**
+ * Work out the stream clock at a local time.
+ *
+ * @param clk The clock.
+ * @param local_ns CLOCK_MONOTONIC time.
+ * @param clock Where to put the 27MHz clock value (wrapped).
+ * @return 0 on success, -1 if the clock is not valid yet.
+ */
+extern int dvbclock_stream_time(struct dvbclock *clk, int64_t local_ns, uint64_t *clock);
+
+/**
+ * Work out when the stream clock reaches a value, which is taken to be
+ * within half a wrap of the last sample.
+ *
+ * @param clk The clock.
+ * @param clock 27MHz clock value.
+ * @param local_ns Where to put the CLOCK_MONOTONIC time.
+ * @return 0 on success, -1 if the clock is not valid yet.
+ */
+extern int dvbclock_local_time(struct dvbclock *clk, uint64_t clock, int64_t *local_ns);
+
+/**
+ * Convert a span of stream clock to local ns, allowing for drift.
+ *
+ * @param clk The clock.
+ * @param ticks 27MHz ticks.
+ * @return Local ns (nominal, if the clock is not valid yet).
+ */
+extern int64_t dvbclock_ticks_to_ns(struct dvbclock *clk, int64_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -23,13 +23,31 @@
 #include <stdio.h>
 #include <sys/param.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
 #include <linux/dvb/dmx.h>
+#include <libdvbmisc/dvbstats.h>
+#include <libdvbmisc/dvbprobe.h>
 #include "dvbdemux.h"
+#include "dvbremote.h"
+#include "dvbapi_stats.h"
 
+/*
+ * FDs of adapters on another host are sockets, and their ioctls are handled
+ * by the software demux in dvbremote.c.
+ */
+static int dvbdemux_ioctl(int fd, unsigned long request, void *arg)
+{
+	int result;
+
+	if (dvbremote_demux_ioctl(fd, request, arg, &result))
+		return result;
+	return ioctl(fd, request, arg);
+}
 
 int dvbdemux_open_demux(int adapter, int demuxdevice, int nonblocking)
 {
@@ -37,6 +55,14 @@ int dvbdemux_open_demux(int adapter, int demuxdevice, int nonblocking)
 	int flags = O_RDWR;
 	int fd;
 
+	if (dvbremote_lookup(adapter, NULL)) {
+		if (demuxdevice != 0) {
+			errno = ENODEV;
+			return -1;
+		}
+		return dvbremote_open_demux(adapter, nonblocking);
+	}
+
 	if (nonblocking)
 		flags |= O_NONBLOCK;
 
@@ -56,6 +82,14 @@ int dvbdemux_open_dvr(int adapter, int dvrdevice, int readonly, int nonblocking)
 	int flags = O_RDWR;
 	int fd;
 
+	if (dvbremote_lookup(adapter, NULL)) {
+		if ((dvrdevice != 0) || !readonly) {
+			errno = (dvrdevice != 0) ? ENODEV : EINVAL;
+			return -1;
+		}
+		return dvbremote_open_dvr(adapter, nonblocking);
+	}
+
 	if (readonly)
 		flags = O_RDONLY;
 	if (nonblocking)
@@ -74,6 +108,13 @@ int dvbdemux_open_dvr(int adapter, int dvrdevice, int readonly, int nonblocking)
 int dvbdemux_set_section_filter(int fd, int pid,
 				uint8_t filter[18], uint8_t mask[18],
 				int start, int checkcrc)
+{
+	return dvbdemux_set_section_filter_mode(fd, pid, filter, mask, NULL, start, checkcrc);
+}
+
+int dvbdemux_set_section_filter_mode(int fd, int pid,
+				     uint8_t filter[18], uint8_t mask[18],
+				     uint8_t mode[18], int start, int checkcrc)
 {
 	struct dmx_sct_filter_params sctfilter;
 
@@ -83,13 +124,36 @@ int dvbdemux_set_section_filter(int fd, int pid,
 	memcpy(sctfilter.filter.filter+1, filter+3, 15);
 	memcpy(sctfilter.filter.mask, mask, 1);
 	memcpy(sctfilter.filter.mask+1, mask+3, 15);
-	memset(sctfilter.filter.mode, 0, 16);
+	if (mode) {
+		memcpy(sctfilter.filter.mode, mode, 1);
+		memcpy(sctfilter.filter.mode+1, mode+3, 15);
+	}
 	if (start)
 		sctfilter.flags |= DMX_IMMEDIATE_START;
 	if (checkcrc)
 		sctfilter.flags |= DMX_CHECK_CRC;
 
-	return ioctl(fd, DMX_SET_FILTER, &sctfilter);
+	return dvbdemux_ioctl(fd, DMX_SET_FILTER, &sctfilter);
+}
+
+int dvbdemux_set_section_filter_changed(int fd, int pid,
+					uint8_t filter[18], uint8_t mask[18],
+					int version, int start, int checkcrc)
+{
+	uint8_t vfilter[18];
+	uint8_t vmask[18];
+	uint8_t mode[18];
+
+	memcpy(vfilter, filter, 18);
+	memcpy(vmask, mask, 18);
+	memset(mode, 0, 18);
+
+	/* byte 5 holds the version_number: a negative match on it */
+	vfilter[5] = (vfilter[5] & ~0x3e) | ((version & 0x1f) << 1);
+	vmask[5] |= 0x3e;
+	mode[5] = 0x3e;
+
+	return dvbdemux_set_section_filter_mode(fd, pid, vfilter, vmask, mode, start, checkcrc);
 }
 
 int dvbdemux_set_pes_filter(int fd, int pid,
@@ -128,7 +192,7 @@ int dvbdemux_set_pes_filter(int fd, int pid,
 		filter.output = DMX_OUT_TS_TAP;
 		break;
 
-#ifdef DMX_OUT_TSDEMUX_TAP
+#ifdef DMX_ADD_PID	/* DMX_OUT_TSDEMUX_TAP is an enum; this is newer */
 	case DVBDEMUX_OUTPUT_TS_DEMUX:
 		filter.output = DMX_OUT_TSDEMUX_TAP;
 		break;
@@ -166,7 +230,7 @@ int dvbdemux_set_pes_filter(int fd, int pid,
 	if (start)
 		filter.flags |= DMX_IMMEDIATE_START;
 
-	return ioctl(fd, DMX_SET_PES_FILTER, &filter);
+	return dvbdemux_ioctl(fd, DMX_SET_PES_FILTER, &filter);
 }
 
 int dvbdemux_set_pid_filter(int fd, int pid,
@@ -207,7 +271,7 @@ int dvbdemux_set_pid_filter(int fd, int pid,
 		filter.output = DMX_OUT_TS_TAP;
 		break;
 
-#ifdef DMX_OUT_TSDEMUX_TAP
+#ifdef DMX_ADD_PID	/* DMX_OUT_TSDEMUX_TAP is an enum; this is newer */
 	case DVBDEMUX_OUTPUT_TS_DEMUX:
 		filter.output = DMX_OUT_TSDEMUX_TAP;
 		break;
@@ -222,17 +286,17 @@ int dvbdemux_set_pid_filter(int fd, int pid,
 	if (start)
 		filter.flags |= DMX_IMMEDIATE_START;
 
-	return ioctl(fd, DMX_SET_PES_FILTER, &filter);
+	return dvbdemux_ioctl(fd, DMX_SET_PES_FILTER, &filter);
 }
 
 int dvbdemux_start(int fd)
 {
-	return ioctl(fd, DMX_START);
+	return dvbdemux_ioctl(fd, DMX_START, NULL);
 }
 
 int dvbdemux_stop(int fd)
 {
-	return ioctl(fd, DMX_STOP);
+	return dvbdemux_ioctl(fd, DMX_STOP, NULL);
 }
 
 int dvbdemux_get_stc(int fd, uint64_t *stc)
@@ -240,8 +304,8 @@ int dvbdemux_get_stc(int fd, uint64_t *stc)
 	struct dmx_stc _stc;
 	int result;
 
-	memset(stc, 0, sizeof(_stc));
-	if ((result = ioctl(fd, DMX_GET_STC, &_stc)) != 0) {
+	memset(&_stc, 0, sizeof(_stc));
+	if ((result = dvbdemux_ioctl(fd, DMX_GET_STC, &_stc)) != 0) {
 		return result;
 	}
 
@@ -251,5 +315,706 @@ int dvbdemux_get_stc(int fd, uint64_t *stc)
 
 int dvbdemux_set_buffer(int fd, int bufsize)
 {
-	return ioctl(fd, DMX_SET_BUFFER_SIZE, bufsize);
+	return dvbdemux_ioctl(fd, DMX_SET_BUFFER_SIZE, (void *) (long) bufsize);
+}
+
+#define PIDSET_MAX_PIDS 0x2000
+
+struct dvbdemux_stream {
+	int fd;
+	int mapped;
+	int buffers;
+	size_t buffer_size;
+	uint8_t *map[DVBDEMUX_STREAM_MAX_BUFFERS];	// the read buffer if not mapped
+	size_t map_length[DVBDEMUX_STREAM_MAX_BUFFERS];
+	int hugepages;
+
+	int held;		// buffer returned by the last get, or -1
+	int pending;		// buffer dequeued behind an EOVERFLOW, or -1
+	int pending_used;
+	int sequenced;		// next_count is valid
+	uint32_t next_count;
+};
+
+static void dvbdemux_stream_unmap(struct dvbdemux_stream *stream)
+{
+	int i;
+
+	for(i = 0; i < DVBDEMUX_STREAM_MAX_BUFFERS; i++) {
+		if (stream->map[i] != NULL)
+			munmap(stream->map[i], stream->map_length[i]);
+		stream->map[i] = NULL;
+	}
+}
+
+static int dvbdemux_stream_map(struct dvbdemux_stream *stream)
+{
+#ifdef DMX_REQBUFS
+	struct dmx_requestbuffers req;
+	struct dmx_buffer buf;
+	int i;
+
+	req.count = stream->buffers;
+	req.size = stream->buffer_size;
+	if (dvbdemux_ioctl(stream->fd, DMX_REQBUFS, &req))
+		return -1;
+	if ((req.count == 0) || (req.count > DVBDEMUX_STREAM_MAX_BUFFERS))
+		return -1;
+	stream->buffers = req.count;
+
+	for(i = 0; i < stream->buffers; i++) {
+		memset(&buf, 0, sizeof(buf));
+		buf.index = i;
+		if (dvbdemux_ioctl(stream->fd, DMX_QUERYBUF, &buf))
+			goto fail;
+		stream->map[i] = mmap(NULL, buf.length, PROT_READ, MAP_SHARED,
+				      stream->fd, buf.offset);
+		if (stream->map[i] == MAP_FAILED) {
+			stream->map[i] = NULL;
+			goto fail;
+		}
+		stream->map_length[i] = buf.length;
+	}
+
+	for(i = 0; i < stream->buffers; i++) {
+		memset(&buf, 0, sizeof(buf));
+		buf.index = i;
+		if (dvbdemux_ioctl(stream->fd, DMX_QBUF, &buf))
+			goto fail;
+	}
+	return 0;
+
+fail:
+	dvbdemux_stream_unmap(stream);
+	return -1;
+#else
+	(void) stream;
+	return -1;
+#endif
+}
+
+struct dvbdemux_stream *dvbdemux_stream_open(int fd, int buffers, int buffer_size)
+{
+	struct dvbdemux_stream *stream;
+
+	if ((stream = calloc(1, sizeof(struct dvbdemux_stream))) == NULL)
+		return NULL;
+	stream->fd = fd;
+	stream->buffers = buffers ? buffers : DVBDEMUX_STREAM_BUFFERS;
+	if (stream->buffers > DVBDEMUX_STREAM_MAX_BUFFERS)
+		stream->buffers = DVBDEMUX_STREAM_MAX_BUFFERS;
+	stream->buffer_size = buffer_size ? buffer_size : DVBDEMUX_STREAM_BUFFER_SIZE;
+	stream->held = -1;
+	stream->pending = -1;
+
+	if ((buffers >= 0) && (dvbdemux_stream_map(stream) == 0)) {
+		stream->mapped = 1;
+		return stream;
+	}
+
+	// no mapping (an old kernel, or not a DVR): read into our own buffer
+	stream->buffers = 1;
+	stream->map_length[0] = stream->buffer_size;
+	stream->hugepages = 1;
+	if ((stream->map[0] = dvbdemux_alloc_buffer(&stream->map_length[0], &stream->hugepages)) == NULL) {
+		free(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+void dvbdemux_stream_close(struct dvbdemux_stream *stream)
+{
+	if (stream->mapped)
+		dvbdemux_stream_unmap(stream);
+	else
+		dvbdemux_free_buffer(stream->map[0], stream->map_length[0]);
+	free(stream);
+}
+
+int dvbdemux_stream_mapped(struct dvbdemux_stream *stream)
+{
+	return stream->mapped;
+}
+
+void dvbdemux_stream_release(struct dvbdemux_stream *stream)
+{
+#ifdef DMX_QBUF
+	struct dmx_buffer buf;
+
+	if (stream->held == -1)
+		return;
+	memset(&buf, 0, sizeof(buf));
+	buf.index = stream->held;
+	dvbdemux_ioctl(stream->fd, DMX_QBUF, &buf);
+#endif
+	stream->held = -1;
+}
+
+static int dvbdemux_stream_next(struct dvbdemux_stream *stream, uint8_t **data)
+{
+#ifdef DMX_DQBUF
+	struct dmx_buffer buf;
+	int lost;
+#endif
+
+	if (!stream->mapped) {
+		*data = stream->map[0];
+		return read(stream->fd, stream->map[0], stream->buffer_size);
+	}
+
+#ifdef DMX_DQBUF
+	dvbdemux_stream_release(stream);
+
+	// the data behind a reported gap
+	if (stream->pending != -1) {
+		stream->held = stream->pending;
+		stream->pending = -1;
+		*data = stream->map[stream->held];
+		return stream->pending_used;
+	}
+
+	while(1) {
+		memset(&buf, 0, sizeof(buf));
+		if (dvbdemux_ioctl(stream->fd, DMX_DQBUF, &buf))
+			return -1;
+		if ((buf.index >= (unsigned) stream->buffers) ||
+		    (buf.bytesused > stream->map_length[buf.index])) {
+			errno = EIO;
+			return -1;
+		}
+
+		lost = (stream->sequenced && (buf.count != stream->next_count)) ||
+		       (buf.flags & DMX_BUFFER_FLAG_DISCONTINUITY_DETECTED);
+		stream->sequenced = 1;
+		stream->next_count = buf.count + 1;
+
+		if (buf.bytesused == 0) {
+			// nothing in it: straight back to the kernel
+			stream->held = buf.index;
+			dvbdemux_stream_release(stream);
+			if (lost) {
+				errno = EOVERFLOW;
+				return -1;
+			}
+			continue;
+		}
+
+		if (lost) {
+			stream->pending = buf.index;
+			stream->pending_used = buf.bytesused;
+			errno = EOVERFLOW;
+			return -1;
+		}
+
+		stream->held = buf.index;
+		*data = stream->map[buf.index];
+		return buf.bytesused;
+	}
+#else
+	errno = EINVAL;
+	return -1;
+#endif
+}
+
+int dvbdemux_stream_get(struct dvbdemux_stream *stream, uint8_t **data)
+{
+	int result = dvbdemux_stream_next(stream, data);
+
+	DVBPROBE2(dvr_read, stream->fd, result);
+	if (result > 0) {
+		dvbstats_add(&dvbapi_stats, DVBAPI_STATS_DVR_BYTES, result);
+		dvbstats_record(&dvbapi_stats, DVBAPI_STATS_DVR_READ_BYTES, result);
+	} else if ((result < 0) && (errno == EOVERFLOW)) {
+		dvbstats_inc(&dvbapi_stats, DVBAPI_STATS_DVR_OVERFLOWS);
+	}
+	return result;
+}
+
+struct dvbdemux_pidset {
+	int adapter;
+	int demuxdevice;
+	int fd;				/* the single filter, -1 if DVR filters */
+	int count;
+	uint16_t refs[PIDSET_MAX_PIDS];	/* users of each PID */
+	int fds[PIDSET_MAX_PIDS];	/* DVR filter of each PID, if fd == -1 */
+};
+
+/*
+ * Open the single filter if the kernel can add PIDs to one. The check is
+ * made with two PIDs which are then removed again, leaving it started and
+ * empty; the kernel only removes PIDs from a started filter. A few null
+ * packets may get through meanwhile.
+ */
+static int dvbdemux_pidset_open_filter(int adapter, int demuxdevice, int bufsize)
+{
+#ifdef DMX_ADD_PID
+	uint16_t probe = 0x1ffe;
+	uint16_t null_pid = 0x1fff;
+	int fd;
+
+	if ((fd = dvbdemux_open_demux(adapter, demuxdevice, 0)) < 0)
+		return -1;
+
+	if (dvbdemux_set_buffer(fd, bufsize) ||
+	    dvbdemux_set_pid_filter(fd, null_pid, DVBDEMUX_INPUT_FRONTEND,
+				    DVBDEMUX_OUTPUT_TS_DEMUX, 0) ||
+	    dvbdemux_ioctl(fd, DMX_ADD_PID, &probe)) {
+		close(fd);
+		return -1;
+	}
+	if (dvbdemux_start(fd) ||
+	    dvbdemux_ioctl(fd, DMX_REMOVE_PID, &probe) ||
+	    dvbdemux_ioctl(fd, DMX_REMOVE_PID, &null_pid)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+#else
+	return -1;
+#endif
+}
+
+struct dvbdemux_pidset *dvbdemux_pidset_open(int adapter, int demuxdevice, int dvr, int bufsize)
+{
+	struct dvbdemux_pidset *set;
+
+	if ((set = calloc(1, sizeof(struct dvbdemux_pidset))) == NULL)
+		return NULL;
+	set->adapter = adapter;
+	set->demuxdevice = demuxdevice;
+
+	if (bufsize <= 0)
+		bufsize = DVBDEMUX_DVR_DEFAULT_BUFFER;
+	set->fd = -1;
+	if (!dvr)
+		set->fd = dvbdemux_pidset_open_filter(adapter, demuxdevice, bufsize);
+
+	return set;
+}
+
+void dvbdemux_pidset_close(struct dvbdemux_pidset *set)
+{
+	int pid;
+
+	if (set->fd != -1) {
+		close(set->fd);
+	} else {
+		for(pid = 0; pid < PIDSET_MAX_PIDS; pid++) {
+			if (set->refs[pid])
+				close(set->fds[pid]);
+		}
+	}
+	free(set);
+}
+
+int dvbdemux_pidset_fd(struct dvbdemux_pidset *set)
+{
+	return set->fd;
+}
+
+int dvbdemux_pidset_add(struct dvbdemux_pidset *set, int pid)
+{
+	if ((pid < 0) || (pid >= PIDSET_MAX_PIDS))
+		return -EINVAL;
+
+	if (set->refs[pid]) {
+		set->refs[pid]++;
+		return 0;
+	}
+
+	if (set->fd != -1) {
+#ifdef DMX_ADD_PID
+		uint16_t _pid = pid;
+
+		if (dvbdemux_ioctl(set->fd, DMX_ADD_PID, &_pid))
+			return -1;
+#endif
+	} else {
+		int fd;
+
+		if ((fd = dvbdemux_open_demux(set->adapter, set->demuxdevice, 0)) < 0)
+			return -1;
+		if (dvbdemux_set_pid_filter(fd, pid, DVBDEMUX_INPUT_FRONTEND,
+					    DVBDEMUX_OUTPUT_DVR, 1)) {
+			close(fd);
+			return -1;
+		}
+		set->fds[pid] = fd;
+	}
+
+	set->refs[pid] = 1;
+	set->count++;
+	return 0;
+}
+
+int dvbdemux_pidset_remove(struct dvbdemux_pidset *set, int pid)
+{
+	if ((pid < 0) || (pid >= PIDSET_MAX_PIDS) || (set->refs[pid] == 0))
+		return 0;
+
+	if (--set->refs[pid])
+		return 0;
+	set->count--;
+
+	if (set->fd != -1) {
+#ifdef DMX_REMOVE_PID
+		uint16_t _pid = pid;
+
+		return dvbdemux_ioctl(set->fd, DMX_REMOVE_PID, &_pid);
+#endif
+	} else {
+		close(set->fds[pid]);
+	}
+	return 0;
+}
+
+struct dvbdemux_pool_fd {
+	int fd;
+	int demux;
+};
+
+struct dvbdemux_pool {
+	int adapter;
+	int count;
+	int load[DVBDEMUX_POOL_MAX_DEMUXES];
+	int capacity[DVBDEMUX_POOL_MAX_DEMUXES];	/* load it was full at, or -1 */
+	struct dvbdemux_pool_fd *fds;
+	int fd_count;
+	int fd_size;
+};
+
+#ifndef DMX_SET_SOURCE
+/* gone from newer kernel headers, but some drivers still implement it */
+#define DMX_SET_SOURCE _IOW('o', 49, int)
+#endif
+
+static int dvbdemux_pool_exists(int adapter, int demuxdevice)
+{
+	char filename[PATH_MAX+1];
+
+	if (dvbremote_lookup(adapter, NULL))
+		return demuxdevice == 0;
+
+	sprintf(filename, "/dev/dvb/adapter%i/demux%i", adapter, demuxdevice);
+	if (access(filename, F_OK) == 0)
+		return 1;
+	sprintf(filename, "/dev/dvb%i.demux%i", adapter, demuxdevice);
+	return access(filename, F_OK) == 0;
+}
+
+struct dvbdemux_pool *dvbdemux_pool_open(int adapter, int frontend)
+{
+	struct dvbdemux_pool *pool;
+	int source = frontend;
+	int fd;
+	int i;
+
+	if ((pool = calloc(1, sizeof(struct dvbdemux_pool))) == NULL)
+		return NULL;
+	pool->adapter = adapter;
+
+	while((pool->count < DVBDEMUX_POOL_MAX_DEMUXES) && dvbdemux_pool_exists(adapter, pool->count)) {
+		pool->capacity[pool->count] = -1;
+		pool->count++;
+	}
+	if (pool->count == 0) {
+		free(pool);
+		return NULL;
+	}
+
+	// routing is best effort: most drivers have one source per demux anyway
+	for(i = 0; (frontend >= 0) && (i < pool->count); i++) {
+		if ((fd = dvbdemux_open_demux(adapter, i, 1)) < 0)
+			continue;
+		dvbdemux_ioctl(fd, DMX_SET_SOURCE, &source);
+		close(fd);
+	}
+
+	return pool;
+}
+
+void dvbdemux_pool_close(struct dvbdemux_pool *pool)
+{
+	free(pool->fds);
+	free(pool);
+}
+
+int dvbdemux_pool_count(struct dvbdemux_pool *pool)
+{
+	return pool->count;
+}
+
+int dvbdemux_pool_load(struct dvbdemux_pool *pool, int demuxdevice)
+{
+	if ((demuxdevice < 0) || (demuxdevice >= pool->count))
+		return 0;
+	return pool->load[demuxdevice];
+}
+
+int dvbdemux_pool_pick(struct dvbdemux_pool *pool)
+{
+	int best = -1;
+	int i;
+
+	for(i = 0; i < pool->count; i++) {
+		if ((pool->capacity[i] >= 0) && (pool->load[i] >= pool->capacity[i]))
+			continue;
+		if ((best == -1) || (pool->load[i] < pool->load[best]))
+			best = i;
+	}
+	return best;
+}
+
+void dvbdemux_pool_add_load(struct dvbdemux_pool *pool, int demuxdevice, int delta)
+{
+	if ((demuxdevice < 0) || (demuxdevice >= pool->count))
+		return;
+	pool->load[demuxdevice] += delta;
+	if (pool->load[demuxdevice] < 0)
+		pool->load[demuxdevice] = 0;
+}
+
+static int dvbdemux_pool_track(struct dvbdemux_pool *pool, int demuxdevice, int fd)
+{
+	struct dvbdemux_pool_fd *fds;
+
+	if (pool->fd_count == pool->fd_size) {
+		int size = pool->fd_size ? pool->fd_size * 2 : 16;
+
+		if ((fds = realloc(pool->fds, size * sizeof(struct dvbdemux_pool_fd))) == NULL) {
+			close(fd);
+			return -1;
+		}
+		pool->fds = fds;
+		pool->fd_size = size;
+	}
+	pool->fds[pool->fd_count].fd = fd;
+	pool->fds[pool->fd_count].demux = demuxdevice;
+	pool->fd_count++;
+	pool->load[demuxdevice]++;
+	return fd;
+}
+
+/* removes an FD from the pool, returning its demux, or -1 */
+static int dvbdemux_pool_untrack(struct dvbdemux_pool *pool, int fd)
+{
+	int demuxdevice;
+	int i;
+
+	for(i = 0; i < pool->fd_count; i++) {
+		if (pool->fds[i].fd != fd)
+			continue;
+		demuxdevice = pool->fds[i].demux;
+		pool->fds[i] = pool->fds[--pool->fd_count];
+		pool->load[demuxdevice]--;
+		return demuxdevice;
+	}
+	return -1;
+}
+
+int dvbdemux_pool_open_demux(struct dvbdemux_pool *pool, int demuxdevice, int nonblocking)
+{
+	int fd;
+
+	if (demuxdevice < 0)
+		demuxdevice = dvbdemux_pool_pick(pool);
+	if ((demuxdevice < 0) || (demuxdevice >= pool->count))
+		return -1;
+
+	if ((fd = dvbdemux_open_demux(pool->adapter, demuxdevice, nonblocking)) < 0)
+		return -1;
+	return dvbdemux_pool_track(pool, demuxdevice, fd);
+}
+
+int dvbdemux_pool_open_dvr(struct dvbdemux_pool *pool, int demuxdevice,
+			   int readonly, int nonblocking)
+{
+	int fd;
+
+	if (demuxdevice < 0)
+		demuxdevice = dvbdemux_pool_pick(pool);
+	if ((demuxdevice < 0) || (demuxdevice >= pool->count))
+		return -1;
+
+	// each demux feeds the DVR of the same number
+	if ((fd = dvbdemux_open_dvr(pool->adapter, demuxdevice, readonly, nonblocking)) < 0)
+		return -1;
+	return dvbdemux_pool_track(pool, demuxdevice, fd);
+}
+
+int dvbdemux_pool_demux_of(struct dvbdemux_pool *pool, int fd)
+{
+	int i;
+
+	for(i = 0; i < pool->fd_count; i++) {
+		if (pool->fds[i].fd == fd)
+			return pool->fds[i].demux;
+	}
+	return -1;
+}
+
+void dvbdemux_pool_full(struct dvbdemux_pool *pool, int fd)
+{
+	int demuxdevice;
+
+	if ((demuxdevice = dvbdemux_pool_untrack(pool, fd)) >= 0)
+		pool->capacity[demuxdevice] = pool->load[demuxdevice];
+	close(fd);
+}
+
+void dvbdemux_pool_close_fd(struct dvbdemux_pool *pool, int fd)
+{
+	dvbdemux_pool_untrack(pool, fd);
+	close(fd);
+}
+
+int dvbdemux_pidset_count(struct dvbdemux_pidset *set)
+{
+	return set->count;
+}
+
+void dvbdemux_dvr_stats_init(struct dvbdemux_dvr_stats *stats, int buffer_size)
+{
+	memset(stats, 0, sizeof(struct dvbdemux_dvr_stats));
+	stats->buffer_size = buffer_size;
+}
+
+void dvbdemux_dvr_stats_update(struct dvbdemux_dvr_stats *stats, int requested, int result)
+{
+	if (result < 0) {
+		// an overflow means it was full
+		if (errno == EOVERFLOW) {
+			stats->overflows++;
+			stats->backlog = stats->buffer_size;
+			stats->peak_backlog = stats->buffer_size;
+			stats->run = 0;
+		}
+		return;
+	}
+
+	stats->reads++;
+	stats->bytes += result;
+	stats->run += result;
+
+	// the burst so far is a lower bound; a short read ends it
+	if (stats->run > stats->buffer_size)
+		stats->run = stats->buffer_size;
+	if ((result < requested) || (stats->run > stats->backlog))
+		stats->backlog = stats->run;
+	if (stats->backlog > stats->peak_backlog)
+		stats->peak_backlog = stats->backlog;
+	if (result < requested)
+		stats->run = 0;
+}
+
+int dvbdemux_dvr_stats_fill(struct dvbdemux_dvr_stats *stats, int peak)
+{
+	int backlog = peak ? stats->peak_backlog : stats->backlog;
+
+	if (stats->buffer_size <= 0)
+		return 0;
+	return (int) (((int64_t) backlog * 100) / stats->buffer_size);
+}
+
+void dvbdemux_tts_init(struct dvbdemux_tts *tts)
+{
+	memset(tts, 0, sizeof(struct dvbdemux_tts));
+}
+
+uint64_t dvbdemux_tts_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (uint64_t) ts.tv_sec * DVBDEMUX_TTS_HZ + (uint64_t) ts.tv_nsec * 27 / 1000;
+}
+
+int dvbdemux_tts_stamp(struct dvbdemux_tts *tts, const uint8_t *in, int len,
+		       uint8_t *out, uint64_t now)
+{
+	int count = (tts->partial + len) / 188;
+	uint64_t span = tts->last ? now - tts->last : 0;
+	uint8_t *pos = out;
+	int used = 0;
+	int i;
+
+	/* not even the packet carried over is complete yet */
+	if (count == 0) {
+		memcpy(tts->packet + tts->partial, in, len);
+		tts->partial += len;
+		return 0;
+	}
+
+	for(i = 0; i < count; i++) {
+		uint32_t stamp = (now - span + span * (i + 1) / count) & DVBDEMUX_TTS_MASK;
+
+		pos[0] = stamp >> 24;
+		pos[1] = stamp >> 16;
+		pos[2] = stamp >> 8;
+		pos[3] = stamp;
+		if (tts->partial) {
+			memcpy(pos + 4, tts->packet, tts->partial);
+			memcpy(pos + 4 + tts->partial, in, 188 - tts->partial);
+			used = 188 - tts->partial;
+			tts->partial = 0;
+		} else {
+			memcpy(pos + 4, in + used, 188);
+			used += 188;
+		}
+		pos += DVBDEMUX_TTS_PACKET_SIZE;
+	}
+
+	tts->partial = len - used;
+	memcpy(tts->packet, in + used, tts->partial);
+	tts->last = now;
+	return pos - out;
+}
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+void *dvbdemux_alloc_buffer(size_t *size, int *hugepages)
+{
+	void *buf;
+	size_t len;
+
+	if (*hugepages) {
+		len = ((*size + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE) * HUGEPAGE_SIZE;
+		buf = mmap(NULL, len, PROT_READ|PROT_WRITE,
+			   MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB|MAP_POPULATE, -1, 0);
+		if (buf != MAP_FAILED) {
+			*size = len;
+			return buf;
+		}
+		*hugepages = 0;
+
+		// no reserved huge pages: ask for transparent ones
+		buf = mmap(NULL, len, PROT_READ|PROT_WRITE,
+			   MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED)
+			return NULL;
+#ifdef MADV_HUGEPAGE
+		madvise(buf, len, MADV_HUGEPAGE);
+#endif
+		// prefault, now that the pages may be huge ones
+		memset(buf, 0, len);
+		*size = len;
+		return buf;
+	}
+
+	buf = mmap(NULL, *size, PROT_READ|PROT_WRITE,
+		   MAP_PRIVATE|MAP_ANONYMOUS|MAP_POPULATE, -1, 0);
+	if (buf == MAP_FAILED)
+		return NULL;
+	return buf;
+}
+
+void dvbdemux_free_buffer(void *buf, size_t size)
+{
+	munmap(buf, size);
 }
@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 
 /**
  * Source of the data to be demuxed.
@@ -124,6 +125,52 @@ extern int dvbdemux_set_section_filter(int fd, int pid,
                                        uint8_t filter[18], uint8_t mask[18],
                                        int start, int checkcrc);
 
+/**
+ * Set filter for SI table sections as dvbdemux_set_section_filter() does,
+ * with the driver's match mode for each bit as well. The bits set in mode
+ * (and mask) are a negative match: a section is passed if its positive bits
+ * all match and at least one of its negative bits differs from the filter.
+ *
+ * @param fd FD as opened with dvbdemux_open_demux() above.
+ * @param pid PID of the stream.
+ * @param filter The filter values of the first 18 bytes of the desired sections.
+ * @param mask Bitmask indicating which bits in the filter array should be tested.
+ * @param mode Bitmask indicating which of the tested bits are negative matches,
+ * in the same layout; NULL for none.
+ * @param start If 1, the filter will be started immediately.
+ * @param checkcrc If 1, the driver will check the CRC on the table sections.
+ * @return 0 on success, nonzero on failure.
+ */
+extern int dvbdemux_set_section_filter_mode(int fd, int pid,
+					    uint8_t filter[18], uint8_t mask[18],
+					    uint8_t mode[18], int start, int checkcrc);
+
+/**
+ * Set filter for SI table sections as dvbdemux_set_section_filter() does,
+ * but only passing those whose version_number differs from the one given.
+ * Watching a table this way costs nothing until it changes, after which every
+ * section of its new version is passed.
+ *
+ * The version bits of filter[5] and mask[5] are ignored; the other bits of
+ * those bytes (section_syntax_indicator, current_next_indicator) are still
+ * matched normally.
+ *
+ * Called again on a running filter once the new version has been dealt
+ * with, it re-arms the filter for the version after that.
+ *
+ * @param fd FD as opened with dvbdemux_open_demux() above.
+ * @param pid PID of the stream.
+ * @param filter The filter values of the first 18 bytes of the desired sections.
+ * @param mask Bitmask indicating which bits in the filter array should be tested.
+ * @param version The version_number (0-31) already held.
+ * @param start If 1, the filter will be started immediately.
+ * @param checkcrc If 1, the driver will check the CRC on the table sections.
+ * @return 0 on success, nonzero on failure.
+ */
+extern int dvbdemux_set_section_filter_changed(int fd, int pid,
+					       uint8_t filter[18], uint8_t mask[18],
+					       int version, int start, int checkcrc);
+
 /**
  * Set filter for a stream of PES data. This call can only used for cards
  * equipped with a hardware decoder.
@@ -197,6 +244,404 @@ extern int dvbdemux_get_stc(int fd, uint64_t *stc);
  */
 extern int dvbdemux_set_buffer(int fd, int bufsize);
 
+/**
+ * Size of the DVR buffer in the kernel when dvbdemux_set_buffer() has not
+ * been used on it.
+ */
+#define DVBDEMUX_DVR_DEFAULT_BUFFER (10 * 188 * 1024)
+
+/**
+ * Statistics on a DVR, gathered by dvbdemux_dvr_stats_update().
+ *
+ * The kernel has no way of saying how full the DVR buffer is, so the backlog
+ * is estimated from the reads: a burst of reads which each return all that
+ * was asked for, ended by a short one, has emptied the buffer; the total is
+ * (slightly more than, as data keeps arriving) what was in it.
+ */
+struct dvbdemux_dvr_stats {
+	int buffer_size;	/* size of the DVR buffer in the kernel */
+	int backlog;		/* estimated backlog at the last burst of reads */
+	int peak_backlog;	/* highest backlog since dvbdemux_dvr_stats_init() */
+	uint64_t bytes;		/* total bytes read */
+	uint64_t reads;		/* number of reads */
+	uint64_t overflows;	/* number of EOVERFLOW errors: data was lost */
+	int run;		/* bytes so far in the current burst */
+};
+
+/**
+ * Initialise a dvbdemux_dvr_stats structure.
+ *
+ * @param stats The structure.
+ * @param buffer_size Size of the DVR buffer in the kernel (as passed to
+ * dvbdemux_set_buffer(), or DVBDEMUX_DVR_DEFAULT_BUFFER).
+ */
+extern void dvbdemux_dvr_stats_init(struct dvbdemux_dvr_stats *stats, int buffer_size);
+
+/**
+ * Account for a read() (or splice()) from a DVR.
+ *
+ * @param stats The structure.
+ * @param requested Number of bytes asked for.
+ * @param result Return value of the call; if -1, errno is examined.
+ */
+extern void dvbdemux_dvr_stats_update(struct dvbdemux_dvr_stats *stats, int requested, int result);
+
+/**
+ * Estimated DVR fill level, in percent of the kernel buffer.
+ *
+ * @param stats The structure.
+ * @param peak If 1, the peak level rather than the last one.
+ * @return The fill level.
+ */
+extern int dvbdemux_dvr_stats_fill(struct dvbdemux_dvr_stats *stats, int peak);
+
+/**
+ * Timestamped TS, as in M2TS and TTS files: each 188 byte transport packet
+ * is preceded by a four byte big endian arrival timestamp, of which the low
+ * 30 bits count a 27 MHz clock (wrapping about every 40 seconds). The top two
+ * bits, the M2TS copy permission indicator, are written as 0.
+ */
+#define DVBDEMUX_TTS_PACKET_SIZE 192
+#define DVBDEMUX_TTS_HZ 27000000ULL
+#define DVBDEMUX_TTS_MASK 0x3fffffff
+
+/* most bytes dvbdemux_tts_stamp() can produce from len bytes of TS */
+#define DVBDEMUX_TTS_SIZE(len) ((((len) + 187) / 188) * DVBDEMUX_TTS_PACKET_SIZE)
+
+/**
+ * Timestamping of what is read from a DVR, by dvbdemux_tts_stamp(). The
+ * clock is CLOCK_MONOTONIC_RAW, which NTP does not slew. A read only says
+ * when the last of its packets had arrived; the others are taken to have
+ * arrived evenly since the previous read, so each packet is stamped a
+ * proportional part of the way between the two.
+ */
+struct dvbdemux_tts {
+	uint64_t last;		/* 27 MHz time of the previous read, 0 before the first */
+	int partial;		/* bytes of a packet split between reads */
+	uint8_t packet[188];
+};
+
+/**
+ * Initialise a dvbdemux_tts structure.
+ *
+ * @param tts The structure.
+ */
+extern void dvbdemux_tts_init(struct dvbdemux_tts *tts);
+
+/**
+ * The timestamp clock.
+ *
+ * @return CLOCK_MONOTONIC_RAW in 27 MHz ticks.
+ */
+extern uint64_t dvbdemux_tts_now(void);
+
+/**
+ * Timestamp the transport packets of one read. A packet split between two
+ * reads is kept back, and stamped with the second one.
+ *
+ * @param tts The structure.
+ * @param in The data read.
+ * @param len Its length.
+ * @param out Where to put the timestamped packets, with room for
+ * DVBDEMUX_TTS_SIZE(len) bytes.
+ * @param now dvbdemux_tts_now() just after the read.
+ * @return The number of bytes put at out.
+ */
+extern int dvbdemux_tts_stamp(struct dvbdemux_tts *tts, const uint8_t *in, int len,
+			      uint8_t *out, uint64_t now);
+
+/**
+ * Allocate a large buffer for staging DVR data in userspace. The memory is
+ * prefaulted, and backed by huge pages if requested and possible: explicit
+ * (hugetlbfs) ones if the system has some reserved, transparent ones
+ * otherwise. Either way, fewer TLB misses when streaming through it.
+ *
+ * @param size Size wanted; set to the size actually allocated, to pass to
+ * dvbdemux_free_buffer().
+ * @param hugepages If 1, use huge pages; set to 1 if explicit huge pages
+ * were used, 0 otherwise.
+ * @return The buffer, or NULL on failure.
+ */
+extern void *dvbdemux_alloc_buffer(size_t *size, int *hugepages);
+
+/**
+ * Free a buffer from dvbdemux_alloc_buffer().
+ *
+ * @param buf The buffer.
+ * @param size The size set by dvbdemux_alloc_buffer().
+ */
+extern void dvbdemux_free_buffer(void *buf, size_t size);
+
+/**
+ * Streaming of what a DVR (or any other FD) produces, without copying it out
+ * where the kernel allows it.
+ *
+ * Kernels built with CONFIG_DVB_MMAP can hand a DVR's data over in buffers
+ * mapped into the process (DMX_REQBUFS/DMX_QBUF/DMX_DQBUF): a stream opened
+ * on such a DVR returns pointers straight into those buffers, each one held
+ * until the next dvbdemux_stream_get() or dvbdemux_stream_release(). On
+ * other kernels, and on FDs which are not DVRs (files, pipes), the stream
+ * reads into a buffer of its own instead, so callers need not care which
+ * they have.
+ *
+ * Once a DVR is streaming mapped, read() on it no longer works, and its
+ * buffers are those of the stream: dvbdemux_set_buffer() does not apply.
+ * The kernel reports lost data by a gap in the buffer sequence, which
+ * dvbdemux_stream_get() turns into an EOVERFLOW error as read() would.
+ */
+struct dvbdemux_stream;
+
+/**
+ * Default number and size of the buffers of a stream.
+ */
+#define DVBDEMUX_STREAM_BUFFERS 8
+#define DVBDEMUX_STREAM_BUFFER_SIZE (188 * 1024)
+
+/**
+ * Most buffers a mapped stream can have.
+ */
+#define DVBDEMUX_STREAM_MAX_BUFFERS 32
+
+/**
+ * Open a stream on an FD.
+ *
+ * @param fd The FD, usually from dvbdemux_open_dvr(). It is not closed with
+ * the stream.
+ * @param buffers Number of kernel buffers if mapped, 0 for
+ * DVBDEMUX_STREAM_BUFFERS, or -1 never to map and always read().
+ * @param buffer_size Size of each buffer (which is also the most
+ * dvbdemux_stream_get() returns at once), 0 for DVBDEMUX_STREAM_BUFFER_SIZE.
+ * A multiple of 188 keeps transport packets whole in mapped buffers.
+ * @return The stream, or NULL on failure.
+ */
+extern struct dvbdemux_stream *dvbdemux_stream_open(int fd, int buffers, int buffer_size);
+
+/**
+ * Close a stream, unmapping its buffers.
+ *
+ * @param stream The stream.
+ */
+extern void dvbdemux_stream_close(struct dvbdemux_stream *stream);
+
+/**
+ * Whether a stream is using mapped kernel buffers.
+ *
+ * @param stream The stream.
+ * @return 1 if mapped, 0 if it reads.
+ */
+extern int dvbdemux_stream_mapped(struct dvbdemux_stream *stream);
+
+/**
+ * Get the next data from a stream. Whatever the previous call returned is
+ * released first.
+ *
+ * @param stream The stream.
+ * @param data Set to the data, valid until the next call to this or
+ * dvbdemux_stream_release().
+ * @return Number of bytes at data, 0 at the end of a file, or -1 on error
+ * with errno set as by read(): EAGAIN on a nonblocking FD with nothing
+ * ready, EOVERFLOW once where data was lost (the data after the gap is
+ * returned by the next call).
+ */
+extern int dvbdemux_stream_get(struct dvbdemux_stream *stream, uint8_t **data);
+
+/**
+ * Hand the data from the last dvbdemux_stream_get() back, before the next
+ * one: it lets the kernel refill the buffer while the caller does other
+ * things.
+ *
+ * @param stream The stream.
+ */
+extern void dvbdemux_stream_release(struct dvbdemux_stream *stream);
+
+/**
+ * A set of PIDs all filtered into one stream of transport packets.
+ *
+ * Where the kernel supports DMX_ADD_PID, the whole set is one filter on one
+ * demux FD (in DMX_OUT_TSDEMUX_TAP mode: the kernel only allows several PIDs
+ * on a filter whose packets are read from the demux FD itself), and the
+ * packets are read from dvbdemux_pidset_fd() instead of the DVR. Otherwise
+ * each PID gets its own DVBDEMUX_OUTPUT_DVR filter as usual, and the packets
+ * are read from the DVR.
+ *
+ * PIDs are counted: a PID added twice stays in the set until it has been
+ * removed twice, so several users may share a set.
+ */
+struct dvbdemux_pidset;
+
+/**
+ * Create an empty PID set.
+ *
+ * @param adapter Index of the DVB adapter.
+ * @param demuxdevice Index of the demux device on that adapter (usually 0).
+ * @param dvr If 1, always use DVR filters, for packets read from the DVR by
+ * someone else.
+ * @param bufsize Kernel buffer size for the single filter, 0 for
+ * DVBDEMUX_DVR_DEFAULT_BUFFER (the demux FD's own default is much too small
+ * for a recording). Unused with DVR filters.
+ * @return The set, or NULL on failure.
+ */
+extern struct dvbdemux_pidset *dvbdemux_pidset_open(int adapter, int demuxdevice, int dvr, int bufsize);
+
+/**
+ * Destroy a PID set, closing all its filters.
+ *
+ * @param set The set.
+ */
+extern void dvbdemux_pidset_close(struct dvbdemux_pidset *set);
+
+/**
+ * The FD to read the packets of a set from.
+ *
+ * @param set The set.
+ * @return The demux FD of the single filter, or -1 if the set uses DVR
+ * filters, when the packets are to be read from the DVR.
+ */
+extern int dvbdemux_pidset_fd(struct dvbdemux_pidset *set);
+
+/**
+ * Add a PID to a set.
+ *
+ * @param set The set.
+ * @param pid The PID (0 to 0x1fff).
+ * @return 0 on success, nonzero on failure.
+ */
+extern int dvbdemux_pidset_add(struct dvbdemux_pidset *set, int pid);
+
+/**
+ * Remove a PID from a set. Removing a PID which is not in it does nothing.
+ *
+ * @param set The set.
+ * @param pid The PID.
+ * @return 0 on success, nonzero on failure.
+ */
+extern int dvbdemux_pidset_remove(struct dvbdemux_pidset *set, int pid);
+
+/**
+ * Number of distinct PIDs in a set.
+ *
+ * @param set The set.
+ * @return The count.
+ */
+extern int dvbdemux_pidset_count(struct dvbdemux_pidset *set);
+
+/**
+ * Most demux devices a pool covers.
+ */
+#define DVBDEMUX_POOL_MAX_DEMUXES 8
+
+/**
+ * A pool of the demux devices of one adapter. Cards with several demuxes
+ * have a filter pool and DMA engine behind each one, so filters are spread
+ * over them: each new filter or DVR consumer goes to the demux with the
+ * fewest placed so far. A demux which runs out of filters (which the caller
+ * reports with dvbdemux_pool_full()) is passed over until some of its
+ * filters are closed.
+ *
+ * The load is that of the pool's own users only, not of other processes.
+ * A pool is not thread safe.
+ */
+struct dvbdemux_pool;
+
+/**
+ * Open a pool over every demux device of an adapter.
+ *
+ * @param adapter Index of the DVB adapter.
+ * @param frontend If >= 0, route every demux to this frontend with
+ * DMX_SET_SOURCE, where the driver supports it.
+ * @return The pool, or NULL if the adapter has no demux or out of memory.
+ */
+extern struct dvbdemux_pool *dvbdemux_pool_open(int adapter, int frontend);
+
+/**
+ * Destroy a pool. FDs opened through it stay open.
+ *
+ * @param pool The pool.
+ */
+extern void dvbdemux_pool_close(struct dvbdemux_pool *pool);
+
+/**
+ * @param pool The pool.
+ * @return Number of demux devices in the pool: demux0 to demux<count - 1>.
+ */
+extern int dvbdemux_pool_count(struct dvbdemux_pool *pool);
+
+/**
+ * Number of filters and DVR consumers placed on a demux.
+ *
+ * @param pool The pool.
+ * @param demuxdevice Index of the demux.
+ * @return The load.
+ */
+extern int dvbdemux_pool_load(struct dvbdemux_pool *pool, int demuxdevice);
+
+/**
+ * The demux the next filter would go to.
+ *
+ * @param pool The pool.
+ * @return Index of the least loaded demux not known to be full, or -1 if
+ * they all are.
+ */
+extern int dvbdemux_pool_pick(struct dvbdemux_pool *pool);
+
+/**
+ * Account for filters the pool did not open, such as those of a
+ * dvbdemux_pidset on one of its demuxes.
+ *
+ * @param pool The pool.
+ * @param demuxdevice Index of the demux.
+ * @param delta Filters added (or, if negative, removed).
+ */
+extern void dvbdemux_pool_add_load(struct dvbdemux_pool *pool, int demuxdevice, int delta);
+
+/**
+ * Open a demux FD for a filter, as dvbdemux_open_demux() does.
+ *
+ * @param pool The pool.
+ * @param demuxdevice Index of the demux, or -1 for dvbdemux_pool_pick()'s.
+ * Filters whose output goes to a DVR must be on the DVR's demux.
+ * @param nonblocking If 1, frontend is opened in nonblocking mode.
+ * @return The FD, or -1 on failure. Close it with dvbdemux_pool_close_fd().
+ */
+extern int dvbdemux_pool_open_demux(struct dvbdemux_pool *pool, int demuxdevice, int nonblocking);
+
+/**
+ * Open the DVR of a demux, as dvbdemux_open_dvr() does. A DVR consumer
+ * counts as one filter of load.
+ *
+ * @param pool The pool.
+ * @param demuxdevice Index of the demux, or -1 for dvbdemux_pool_pick()'s.
+ * @param readonly If 1, frontend will be opened in readonly mode only.
+ * @param nonblocking If 1, frontend will be opened in nonblocking mode.
+ * @return The FD, or -1 on failure. Close it with dvbdemux_pool_close_fd().
+ */
+extern int dvbdemux_pool_open_dvr(struct dvbdemux_pool *pool, int demuxdevice,
+				  int readonly, int nonblocking);
+
+/**
+ * @param pool The pool.
+ * @param fd FD opened through the pool.
+ * @return Index of the demux it is on, or -1 if it is not the pool's.
+ */
+extern int dvbdemux_pool_demux_of(struct dvbdemux_pool *pool, int fd);
+
+/**
+ * Report that setting a filter on an FD failed for want of filters: its
+ * demux is full at its current load. The FD is closed.
+ *
+ * @param pool The pool.
+ * @param fd FD opened through the pool.
+ */
+extern void dvbdemux_pool_full(struct dvbdemux_pool *pool, int fd);
+
+/**
+ * Close an FD opened through the pool.
+ *
+ * @param pool The pool.
+ * @param fd The FD.
+ */
+extern void dvbdemux_pool_close_fd(struct dvbdemux_pool *pool, int fd);
+
 #ifdef __cplusplus
 }
 #endif
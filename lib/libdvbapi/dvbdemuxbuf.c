@@ -0,0 +1,335 @@
+/*
+ * libdvbdemuxbuf - kernel buffer sizing for demux filters
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include "dvbdemux.h"
+#include "dvbdemuxbuf.h"
+
+// how often each filter's needs are worked out again
+#define WINDOW_US 1000000ULL
+
+// how long after an overflow a filter may not shrink
+#define HOLD_US (30 * 1000000ULL)
+
+// sizes remembered by key
+#define LEARNED 64
+
+struct filter {
+	int in_use;
+	int key;
+	int max_read;
+	uint64_t last_read;		// 0 => none yet
+	uint64_t window_start;		// 0 => none yet
+	uint64_t window_bytes;
+	uint32_t gap_us;		// longest wait between reads, decaying
+	uint64_t hold_until;
+	int exhausted;			// the budget being short has been reported
+	struct dvbdemuxbuf_stats stats;
+};
+
+struct learned {
+	int key;
+	int size;
+};
+
+struct dvbdemuxbuf {
+	size_t budget;
+	size_t total;
+	int flags;
+
+	struct filter *filters;		// indexed by fd
+	int num_filters;
+
+	struct learned learned[LEARNED];
+	int num_learned;
+	int next_learned;
+};
+
+static uint64_t dvbdemuxbuf_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static int dvbdemuxbuf_round(uint64_t size)
+{
+	int result = DVBDEMUXBUF_MIN_SIZE;
+
+	while (((uint64_t) result < size) && (result < DVBDEMUXBUF_MAX_SIZE))
+		result <<= 1;
+	return result;
+}
+
+static struct filter *dvbdemuxbuf_lookup(struct dvbdemuxbuf *db, int fd)
+{
+	if ((fd < 0) || (fd >= db->num_filters) || !db->filters[fd].in_use)
+		return NULL;
+	return &db->filters[fd];
+}
+
+struct dvbdemuxbuf *dvbdemuxbuf_create(size_t budget, int flags)
+{
+	struct dvbdemuxbuf *db;
+
+	if ((db = calloc(1, sizeof(struct dvbdemuxbuf))) == NULL)
+		return NULL;
+	db->budget = budget ? budget : DVBDEMUXBUF_DEFAULT_BUDGET;
+	db->flags = flags;
+
+	return db;
+}
+
+void dvbdemuxbuf_destroy(struct dvbdemuxbuf *db)
+{
+	free(db->filters);
+	free(db);
+}
+
+/**
+ * Give a filter a new size, as far as the budget allows.
+ */
+static int dvbdemuxbuf_resize(struct dvbdemuxbuf *db, int fd, struct filter *f, int size,
+			      int overflow)
+{
+	size_t others = db->total - f->stats.size;
+	size_t room = (others < db->budget) ? db->budget - others : 0;
+	int old = f->stats.size;
+
+	if (size > DVBDEMUXBUF_MAX_SIZE)
+		size = DVBDEMUXBUF_MAX_SIZE;
+	if ((size_t) size > room) {
+		for(size = DVBDEMUXBUF_MIN_SIZE; ((size_t) size << 1) <= room; size <<= 1);
+		if (size <= old) {
+			if ((db->flags & DVBDEMUXBUF_LOG) && !f->exhausted)
+				fprintf(stderr, "dvbdemuxbuf: fd %i needs more than the %zu byte budget allows\n",
+					fd, db->budget);
+			f->exhausted = 1;
+			return -1;
+		}
+	}
+	if (size == old)
+		return 0;
+
+	// only a stopped filter may be resized, and starting it empties the buffer
+	if (dvbdemux_stop(fd))
+		return -1;
+	if (dvbdemux_set_buffer(fd, size)) {
+		dvbdemux_start(fd);
+		return -1;
+	}
+	if (dvbdemux_start(fd))
+		return -1;
+
+	db->total = db->total - old + size;
+	f->stats.size = size;
+	if (size > old) {
+		f->stats.grows++;
+	} else {
+		f->stats.shrinks++;
+		f->exhausted = 0;
+	}
+
+	if (db->flags & DVBDEMUXBUF_LOG) {
+		if (overflow)
+			fprintf(stderr, "dvbdemuxbuf: fd %i overflowed, buffer %i -> %i bytes\n",
+				fd, old, size);
+		else
+			fprintf(stderr, "dvbdemuxbuf: fd %i buffer %i -> %i bytes (%u bytes/s, %u ms between reads)\n",
+				fd, old, size, f->stats.rate, f->stats.latency_us / 1000);
+	}
+	return 0;
+}
+
+/**
+ * Account for a successful read, and once a window has gone by, see whether
+ * the filter's size still suits it.
+ */
+static void dvbdemuxbuf_account(struct dvbdemuxbuf *db, int fd, struct filter *f, int len)
+{
+	uint64_t now = dvbdemuxbuf_now();
+	uint64_t rate;
+	uint64_t needed;
+	struct pollfd pollfd;
+	int target;
+
+	f->stats.bytes += len;
+	f->stats.reads++;
+	if (len > f->max_read)
+		f->max_read = len;
+	if (f->last_read && ((now - f->last_read) > f->gap_us))
+		f->gap_us = now - f->last_read;
+	f->last_read = now;
+
+	f->window_bytes += len;
+	if (f->window_start == 0) {
+		f->window_start = now;
+		return;
+	}
+	if ((now - f->window_start) < WINDOW_US)
+		return;
+
+	rate = (f->window_bytes * 1000000) / (now - f->window_start);
+	f->stats.rate = f->stats.rate ? ((f->stats.rate * 3) + rate) / 4 : rate;
+	f->stats.latency_us = f->gap_us;
+	f->window_start = now;
+	f->window_bytes = 0;
+
+	// twice the longest section, and what comes in during a wait
+	needed = 2 * (f->max_read + (((uint64_t) f->stats.rate * f->gap_us) / 1000000));
+	f->stats.needed = (needed > DVBDEMUXBUF_MAX_SIZE) ? DVBDEMUXBUF_MAX_SIZE : needed;
+	f->gap_us -= f->gap_us / 4;
+
+	// grow once it doesn't fit, shrink once a quarter would do
+	if (!(needed > (uint64_t) f->stats.size) &&
+	    !((needed <= (uint64_t) (f->stats.size / 4)) && (now >= f->hold_until)))
+		return;
+	target = dvbdemuxbuf_round(needed);
+	if (target == f->stats.size)
+		return;
+
+	// not while there is something to lose
+	pollfd.fd = fd;
+	pollfd.events = POLLIN;
+	if ((poll(&pollfd, 1, 0) != 0) || (pollfd.revents & POLLIN))
+		return;
+	dvbdemuxbuf_resize(db, fd, f, target, 0);
+}
+
+int dvbdemuxbuf_add(struct dvbdemuxbuf *db, int fd, int key)
+{
+	struct filter *f;
+	size_t room = (db->total < db->budget) ? db->budget - db->total : 0;
+	int size = DVBDEMUXBUF_DEFAULT_SIZE;
+	int i;
+
+	if (fd < 0) {
+		errno = EBADF;
+		return -1;
+	}
+	if (fd >= db->num_filters) {
+		int count = db->num_filters ? db->num_filters : 16;
+
+		while (count <= fd)
+			count <<= 1;
+		if ((f = realloc(db->filters, count * sizeof(struct filter))) == NULL)
+			return -1;
+		memset(f + db->num_filters, 0, (count - db->num_filters) * sizeof(struct filter));
+		db->filters = f;
+		db->num_filters = count;
+	}
+	f = &db->filters[fd];
+	if (f->in_use)
+		dvbdemuxbuf_remove(db, fd);
+
+	if (key != -1) {
+		for(i = 0; i < db->num_learned; i++) {
+			if (db->learned[i].key == key) {
+				size = db->learned[i].size;
+				break;
+			}
+		}
+	}
+	while ((size > DVBDEMUXBUF_MIN_SIZE) && ((size_t) size > room))
+		size >>= 1;
+	if (dvbdemux_set_buffer(fd, size))
+		return -1;
+
+	memset(f, 0, sizeof(struct filter));
+	f->in_use = 1;
+	f->key = key;
+	f->stats.size = size;
+	db->total += size;
+
+	return 0;
+}
+
+void dvbdemuxbuf_remove(struct dvbdemuxbuf *db, int fd)
+{
+	struct filter *f;
+	int i;
+
+	if ((f = dvbdemuxbuf_lookup(db, fd)) == NULL)
+		return;
+
+	// only a size which has been tried is worth remembering
+	if ((f->key != -1) && f->stats.reads) {
+		for(i = 0; i < db->num_learned; i++)
+			if (db->learned[i].key == f->key)
+				break;
+		if (i == db->num_learned) {
+			if (db->num_learned < LEARNED) {
+				i = db->num_learned++;
+			} else {
+				i = db->next_learned;
+				db->next_learned = (db->next_learned + 1) % LEARNED;
+			}
+		}
+		db->learned[i].key = f->key;
+		db->learned[i].size = f->stats.size;
+	}
+
+	db->total -= f->stats.size;
+	f->in_use = 0;
+}
+
+ssize_t dvbdemuxbuf_read(struct dvbdemuxbuf *db, int fd, void *buf, size_t len)
+{
+	struct filter *f;
+	ssize_t result;
+
+	if ((f = dvbdemuxbuf_lookup(db, fd)) == NULL)
+		return read(fd, buf, len);
+
+	result = read(fd, buf, len);
+	if ((result < 0) && (errno == EOVERFLOW)) {
+		// the kernel has emptied the buffer, so it may be resized at once
+		f->stats.overflows++;
+		f->hold_until = dvbdemuxbuf_now() + HOLD_US;
+		dvbdemuxbuf_resize(db, fd, f, f->stats.size * 2, 1);
+		result = read(fd, buf, len);
+	}
+	if (result > 0)
+		dvbdemuxbuf_account(db, fd, f, result);
+
+	return result;
+}
+
+int dvbdemuxbuf_get_stats(struct dvbdemuxbuf *db, int fd, struct dvbdemuxbuf_stats *stats)
+{
+	struct filter *f;
+
+	if ((f = dvbdemuxbuf_lookup(db, fd)) == NULL)
+		return -1;
+	*stats = f->stats;
+	return 0;
+}
+
+size_t dvbdemuxbuf_total(struct dvbdemuxbuf *db)
+{
+	return db->total;
+}
@@ -0,0 +1,151 @@
+/*
+ * libdvbdemuxbuf - kernel buffer sizing for demux filters
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBDEMUXBUF_H
+#define LIBDVBDEMUXBUF_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * Sizing of the kernel buffers of section and PES filters, each to what it
+ * needs, within a memory budget shared by all of them.
+ *
+ * The reads of each demux fd are timed: its byte rate, the longest read and
+ * the longest wait between reads are followed, and the buffer is sized to
+ * hold twice what arrives in that wait. A filter is grown when that no longer
+ * fits, and shrunk when a quarter of its buffer would do; either is only
+ * done while nothing is waiting in the buffer, since the kernel can only
+ * resize a stopped filter, and stopping it empties the buffer. An EOVERFLOW
+ * doubles the buffer at once (the kernel has emptied it already) and stops
+ * it shrinking back for a while; the read is then retried, so the caller
+ * never sees the error, only the sections which were lost.
+ *
+ * Filters added with the same key start at the size the last one settled
+ * on, so a program opening the same kind of filter time and again (one per
+ * transponder, say) only learns each size once.
+ *
+ * Not for DVR fds: their buffer is not a filter's, and is sized by
+ * dvbdemux_set_buffer() and struct dvbdemux_dvr_stats. A manager is not
+ * thread safe.
+ */
+struct dvbdemuxbuf;
+
+#define DVBDEMUXBUF_DEFAULT_BUDGET (4 * 1024 * 1024)
+
+#define DVBDEMUXBUF_MIN_SIZE 4096		/* the longest (private) section */
+#define DVBDEMUXBUF_MAX_SIZE (1024 * 1024)
+#define DVBDEMUXBUF_DEFAULT_SIZE 8192		/* the kernel's own size */
+
+/**
+ * Flags for dvbdemuxbuf_create().
+ */
+#define DVBDEMUXBUF_LOG		1	/* report every resize on stderr */
+
+/**
+ * Statistics of one filter.
+ */
+struct dvbdemuxbuf_stats {
+	int size;		/* of its kernel buffer */
+	int needed;		/* what its reads say it needs */
+	uint32_t rate;		/* bytes per second */
+	uint32_t latency_us;	/* longest recent wait between reads */
+	uint64_t bytes;
+	uint64_t reads;
+	uint64_t overflows;
+	uint64_t grows;
+	uint64_t shrinks;
+};
+
+/**
+ * Create a manager.
+ *
+ * @param budget Most bytes of kernel buffers for all its filters, 0 for
+ * DVBDEMUXBUF_DEFAULT_BUDGET.
+ * @param flags DVBDEMUXBUF_*.
+ * @return The manager, or NULL on failure.
+ */
+extern struct dvbdemuxbuf *dvbdemuxbuf_create(size_t budget, int flags);
+
+/**
+ * Destroy a manager; its filters are left as they are.
+ *
+ * @param db The manager.
+ */
+extern void dvbdemuxbuf_destroy(struct dvbdemuxbuf *db);
+
+/**
+ * Manage the buffer of a demux fd, before its filter is set (or while it is
+ * stopped): it is given its first size straight away.
+ *
+ * @param db The manager.
+ * @param fd The demux fd.
+ * @param key Filters with the same key (a PID, say) start at the size the
+ * last of them settled on; -1 for none.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+extern int dvbdemuxbuf_add(struct dvbdemuxbuf *db, int fd, int key);
+
+/**
+ * Stop managing a demux fd, before it is closed.
+ *
+ * @param db The manager.
+ * @param fd The demux fd.
+ */
+extern void dvbdemuxbuf_remove(struct dvbdemuxbuf *db, int fd);
+
+/**
+ * read() from a demux fd, resizing its buffer if that is due. A fd which is
+ * not managed is simply read.
+ *
+ * @param db The manager.
+ * @param fd The demux fd.
+ * @param buf Where to put the data.
+ * @param len Size of buf.
+ * @return As read(), except that an EOVERFLOW is dealt with and the read
+ * retried (which gives EAGAIN on a non blocking fd).
+ */
+extern ssize_t dvbdemuxbuf_read(struct dvbdemuxbuf *db, int fd, void *buf, size_t len);
+
+/**
+ * Retrieve the statistics of a filter.
+ *
+ * @param db The manager.
+ * @param fd The demux fd.
+ * @param stats Where to put them.
+ * @return 0 on success, or -1 if the fd is not managed.
+ */
+extern int dvbdemuxbuf_get_stats(struct dvbdemuxbuf *db, int fd, struct dvbdemuxbuf_stats *stats);
+
+/**
+ * @return Bytes of kernel buffers in use by the filters of a manager.
+ */
+extern size_t dvbdemuxbuf_total(struct dvbdemuxbuf *db);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBDVBDEMUXBUF_H
@@ -28,13 +28,25 @@
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <ctype.h>
 #include <errno.h>
 #include <linux/dvb/frontend.h>
 #include <libdvbmisc/dvbmisc.h>
+#include <libdvbmisc/dvbstats.h>
+#include <libdvbmisc/dvbprobe.h>
 #include "dvbfe.h"
+#include "dvbremote.h"
+#include "dvbfepool.h"
+#include "dvbapi_stats.h"
+#include "dvblatency.h"
+#include "dvbtunememo.h"
+
+#define DVBFE_TUNE_MAX_EVENTS 16		/* more than the kernel queues */
+#define DVBFE_TUNEMEMO_TRY_MS 1500		/* to lock with remembered parameters */
 
 int verbose = 0;
 
@@ -58,8 +70,53 @@ static int dvbfe_code_rate_to_kapi[][2] =
 	{ DVBFE_FEC_7_8, FEC_7_8 },
 	{ DVBFE_FEC_8_9, FEC_8_9 },
 	{ DVBFE_FEC_AUTO, FEC_AUTO },
+#ifdef DTV_STREAM_ID
+	{ DVBFE_FEC_3_5, FEC_3_5 },
+	{ DVBFE_FEC_9_10, FEC_9_10 },
+#endif
+	{ -1, -1 }
+};
+
+#ifdef DTV_STREAM_ID
+static int dvbfe_dvbs_mod_to_kapi[][2] =
+{
+	{ DVBFE_DVBS_MOD_QPSK, QPSK },
+	{ DVBFE_DVBS_MOD_8PSK, PSK_8 },
+	{ DVBFE_DVBS_MOD_16APSK, APSK_16 },
+	{ DVBFE_DVBS_MOD_32APSK, APSK_32 },
+	{ DVBFE_DVBS_MOD_AUTO, QAM_AUTO },
+	{ -1, -1 }
+};
+
+static int dvbfe_dvbs_rolloff_to_kapi[][2] =
+{
+	{ DVBFE_DVBS_ROLLOFF_35, ROLLOFF_35 },
+	{ DVBFE_DVBS_ROLLOFF_25, ROLLOFF_25 },
+	{ DVBFE_DVBS_ROLLOFF_20, ROLLOFF_20 },
+	{ DVBFE_DVBS_ROLLOFF_AUTO, ROLLOFF_AUTO },
+	{ -1, -1 }
+};
+
+static int dvbfe_dvbs_pilot_to_kapi[][2] =
+{
+	{ DVBFE_DVBS_PILOT_OFF, PILOT_OFF },
+	{ DVBFE_DVBS_PILOT_ON, PILOT_ON },
+	{ DVBFE_DVBS_PILOT_AUTO, PILOT_AUTO },
+	{ -1, -1 }
+};
+
+static int dvbfe_dvbt_bandwidth_to_hz[][2] =
+{
+	{ DVBFE_DVBT_BANDWIDTH_8_MHZ, 8000000 },
+	{ DVBFE_DVBT_BANDWIDTH_7_MHZ, 7000000 },
+	{ DVBFE_DVBT_BANDWIDTH_6_MHZ, 6000000 },
+	{ DVBFE_DVBT_BANDWIDTH_AUTO, 0 },
+	{ DVBFE_DVBT_BANDWIDTH_5_MHZ, 5000000 },
+	{ DVBFE_DVBT_BANDWIDTH_10_MHZ, 10000000 },
+	{ DVBFE_DVBT_BANDWIDTH_1_712_MHZ, 1712000 },
 	{ -1, -1 }
 };
+#endif
 
 static int dvbfe_dvbt_const_to_kapi[][2] =
 {
@@ -99,6 +156,11 @@ static int dvbfe_dvbt_transmit_mode_to_kapi[][2] =
 	{ DVBFE_DVBT_TRANSMISSION_MODE_2K, TRANSMISSION_MODE_2K },
 	{ DVBFE_DVBT_TRANSMISSION_MODE_8K, TRANSMISSION_MODE_8K },
 	{ DVBFE_DVBT_TRANSMISSION_MODE_AUTO, TRANSMISSION_MODE_AUTO },
+#ifdef DTV_STREAM_ID
+	{ DVBFE_DVBT_TRANSMISSION_MODE_1K, TRANSMISSION_MODE_1K },
+	{ DVBFE_DVBT_TRANSMISSION_MODE_16K, TRANSMISSION_MODE_16K },
+	{ DVBFE_DVBT_TRANSMISSION_MODE_32K, TRANSMISSION_MODE_32K },
+#endif
 	{ -1, -1 }
 };
 
@@ -108,6 +170,11 @@ static int dvbfe_dvbt_bandwidth_to_kapi[][2] =
 	{ DVBFE_DVBT_BANDWIDTH_7_MHZ, BANDWIDTH_7_MHZ },
 	{ DVBFE_DVBT_BANDWIDTH_6_MHZ, BANDWIDTH_6_MHZ },
 	{ DVBFE_DVBT_BANDWIDTH_AUTO, BANDWIDTH_AUTO },
+#ifdef DTV_STREAM_ID
+	{ DVBFE_DVBT_BANDWIDTH_5_MHZ, BANDWIDTH_5_MHZ },
+	{ DVBFE_DVBT_BANDWIDTH_10_MHZ, BANDWIDTH_10_MHZ },
+	{ DVBFE_DVBT_BANDWIDTH_1_712_MHZ, BANDWIDTH_1_712_MHZ },
+#endif
 	{ -1, -1 }
 };
 
@@ -118,6 +185,11 @@ static int dvbfe_dvbt_guard_interval_to_kapi[][2] =
 	{ DVBFE_DVBT_GUARD_INTERVAL_1_8, GUARD_INTERVAL_1_8},
 	{ DVBFE_DVBT_GUARD_INTERVAL_1_4, GUARD_INTERVAL_1_4},
 	{ DVBFE_DVBT_GUARD_INTERVAL_AUTO, GUARD_INTERVAL_AUTO},
+#ifdef DTV_STREAM_ID
+	{ DVBFE_DVBT_GUARD_INTERVAL_1_128, GUARD_INTERVAL_1_128},
+	{ DVBFE_DVBT_GUARD_INTERVAL_19_128, GUARD_INTERVAL_19_128},
+	{ DVBFE_DVBT_GUARD_INTERVAL_19_256, GUARD_INTERVAL_19_256},
+#endif
 	{ -1, -1 }
 };
 
@@ -153,17 +225,61 @@ static int lookupval(int val, int reverse, int table[][2])
 }
 
 
+enum dvbfe_tune_state {
+	DVBFE_TUNE_STATE_IDLE,
+	DVBFE_TUNE_STATE_TUNING,
+	DVBFE_TUNE_STATE_LOCKED,
+	DVBFE_TUNE_STATE_UNLOCKED,	/* timed out, or lost lock */
+};
+
+enum dvbfe_memo_state {
+	DVBFE_MEMO_STATE_IDLE,
+	DVBFE_MEMO_STATE_TRYING,	/* tuned with remembered parameters */
+	DVBFE_MEMO_STATE_LEARNING,	/* tuned as asked, with AUTO values */
+};
+
 struct dvbfe_handle {
 	int fd;
+	int remote;			/* fd is a connection to dvbremoted */
+	int pool_checkout;		/* -1 => fd not from dvbfepoold */
 	enum dvbfe_type type;
 	char *name;
+
+	/* asynchronous tuning */
+	int tune_pollfd;
+	int tune_timerfd;
+	enum dvbfe_tune_state tune_state;
+
+	int v5_tune;			/* 0 => unknown, 1 => supported, -1 => not */
+	int v5_stats;			/* 0 => unknown, 1 => supported, -1 => not */
+
+	struct dvblatency_session latency;
+	struct dvbfe_sec_state sec_state;
+
+	/* learned tuning parameters */
+	struct dvbtunememo *memo;
+	enum dvbfe_memo_state memo_state;
+	uint32_t memo_key;
+	struct dvbfe_parameters memo_request;
+	struct timespec memo_deadline;
 };
 
+static void dvbfe_memo_status(struct dvbfe_handle *fehandle, int locked);
+
+static int dvbfe_ioctl(struct dvbfe_handle *fehandle, unsigned long request, void *arg)
+{
+	if (fehandle->remote)
+		return dvbremote_frontend_ioctl(fehandle->fd, request, arg);
+	return ioctl(fehandle->fd, request, arg);
+}
+
 struct dvbfe_handle *dvbfe_open(int adapter, int frontend, int readonly)
 {
 	char filename[PATH_MAX+1];
 	struct dvbfe_handle *fehandle;
 	int fd;
+	int remote = 0;
+	int pool_checkout = -1;
 	struct dvb_frontend_info info;
 
 	//  flags
@@ -172,19 +288,31 @@ struct dvbfe_handle *dvbfe_open(int adapter, int frontend, int readonly)
 		flags = O_RDONLY;
 	}
 
-	// open it (try normal /dev structure first)
+	// open it (an adapter on another host, one kept warm by dvbfepoold, or
+	// try normal /dev structure first)
 	sprintf(filename, "/dev/dvb/adapter%i/frontend%i", adapter, frontend);
-	if ((fd = open(filename, flags)) < 0) {
-		// if that failed, try a flat /dev structure
-		sprintf(filename, "/dev/dvb%i.frontend%i", adapter, frontend);
-		if ((fd = open(filename, flags)) < 0) {
+	if (dvbremote_lookup(adapter, NULL)) {
+		if ((fd = dvbremote_open_frontend(adapter, frontend, readonly)) < 0)
 			return NULL;
+		remote = 1;
+	} else if (readonly ||
+		   ((fd = dvbfepool_open_frontend(adapter, frontend, &pool_checkout)) < 0)) {
+		// one the keeper has checked out to another program gives
+		// EBUSY here, as it would without a keeper
+		if ((fd = open(filename, flags)) < 0) {
+			// if that failed, try a flat /dev structure
+			sprintf(filename, "/dev/dvb%i.frontend%i", adapter, frontend);
+			if ((fd = open(filename, flags)) < 0) {
+				return NULL;
+			}
 		}
 	}
 
 	// determine fe type
-	if (ioctl(fd, FE_GET_INFO, &info)) {
+	if ((remote ? dvbremote_frontend_ioctl(fd, FE_GET_INFO, &info) : ioctl(fd, FE_GET_INFO, &info))) {
 		close(fd);
+		if (pool_checkout != -1)
+			close(pool_checkout);
 		return NULL;
 	}
 
@@ -192,6 +320,10 @@ struct dvbfe_handle *dvbfe_open(int adapter, int frontend, int readonly)
 	fehandle = (struct dvbfe_handle*) malloc(sizeof(struct dvbfe_handle));
 	memset(fehandle, 0, sizeof(struct dvbfe_handle));
 	fehandle->fd = fd;
+	fehandle->remote = remote;
+	fehandle->pool_checkout = pool_checkout;
+	fehandle->tune_pollfd = -1;
+	fehandle->tune_timerfd = -1;
 	switch(info.type) {
 	case FE_QPSK:
 		fehandle->type = DVBFE_TYPE_DVBS;
@@ -217,11 +349,174 @@ struct dvbfe_handle *dvbfe_open(int adapter, int frontend, int readonly)
 
 void dvbfe_close(struct dvbfe_handle *fehandle)
 {
+	if (fehandle->sec_state.release)
+		fehandle->sec_state.release(fehandle, fehandle->sec_state.priv);
+	if (fehandle->tune_pollfd != -1)
+		close(fehandle->tune_pollfd);
+	if (fehandle->tune_timerfd != -1)
+		close(fehandle->tune_timerfd);
 	close(fehandle->fd);
+	// only once the fd is gone may the keeper hand the frontend on
+	if (fehandle->pool_checkout != -1)
+		close(fehandle->pool_checkout);
 	free(fehandle->name);
 	free(fehandle);
 }
 
+static int dvbfe_get_stats_v5(struct dvbfe_handle *fehandle,
+			      enum dvbfe_info_mask querymask,
+			      struct dvbfe_info *result)
+{
+	int returnval = 0;
+#ifdef DTV_STAT_SIGNAL_STRENGTH
+	struct dtv_property props[7];
+	struct dtv_properties cmd;
+	int i;
+
+	if (fehandle->v5_stats < 0)
+		return 0;
+	if (!(querymask & (DVBFE_INFO_SIGNAL_STRENGTH | DVBFE_INFO_SNR | DVBFE_INFO_UNCORRECTED_BLOCKS |
+			   DVBFE_INFO_PRE_ERROR_BITS | DVBFE_INFO_POST_ERROR_BITS)))
+		return 0;
+
+	// newer kernels give all the statistics in one go
+	memset(props, 0, sizeof(props));
+	props[0].cmd = DTV_STAT_SIGNAL_STRENGTH;
+	props[1].cmd = DTV_STAT_CNR;
+	props[2].cmd = DTV_STAT_ERROR_BLOCK_COUNT;
+	props[3].cmd = DTV_STAT_PRE_ERROR_BIT_COUNT;
+	props[4].cmd = DTV_STAT_PRE_TOTAL_BIT_COUNT;
+	props[5].cmd = DTV_STAT_POST_ERROR_BIT_COUNT;
+	props[6].cmd = DTV_STAT_POST_TOTAL_BIT_COUNT;
+	cmd.num = 7;
+	cmd.props = props;
+
+	if (dvbfe_ioctl(fehandle, FE_GET_PROPERTY, &cmd)) {
+		fehandle->v5_stats = -1;
+		return 0;
+	}
+	fehandle->v5_stats = 1;
+
+	// a statistic the frontend does not provide has no entries
+	for(i = 0; i < 7; i++) {
+		if (props[i].u.st.len == 0)
+			props[i].u.st.stat[0].scale = FE_SCALE_NOT_AVAILABLE;
+	}
+
+	if ((querymask & DVBFE_INFO_SIGNAL_STRENGTH) &&
+	    (props[0].u.st.stat[0].scale == FE_SCALE_RELATIVE)) {
+		result->signal_strength = props[0].u.st.stat[0].uvalue;
+		returnval |= DVBFE_INFO_SIGNAL_STRENGTH;
+	}
+	if ((querymask & DVBFE_INFO_SNR) &&
+	    (props[1].u.st.stat[0].scale == FE_SCALE_RELATIVE)) {
+		result->snr = props[1].u.st.stat[0].uvalue;
+		returnval |= DVBFE_INFO_SNR;
+	}
+	if ((querymask & DVBFE_INFO_UNCORRECTED_BLOCKS) &&
+	    (props[2].u.st.stat[0].scale == FE_SCALE_COUNTER)) {
+		result->ucblocks = props[2].u.st.stat[0].uvalue;
+		returnval |= DVBFE_INFO_UNCORRECTED_BLOCKS;
+	}
+	if ((querymask & DVBFE_INFO_PRE_ERROR_BITS) &&
+	    (props[3].u.st.stat[0].scale == FE_SCALE_COUNTER) &&
+	    (props[4].u.st.stat[0].scale == FE_SCALE_COUNTER)) {
+		result->pre_error_bits = props[3].u.st.stat[0].uvalue;
+		result->pre_total_bits = props[4].u.st.stat[0].uvalue;
+		returnval |= DVBFE_INFO_PRE_ERROR_BITS;
+	}
+	if ((querymask & DVBFE_INFO_POST_ERROR_BITS) &&
+	    (props[5].u.st.stat[0].scale == FE_SCALE_COUNTER) &&
+	    (props[6].u.st.stat[0].scale == FE_SCALE_COUNTER)) {
+		result->post_error_bits = props[5].u.st.stat[0].uvalue;
+		result->post_total_bits = props[6].u.st.stat[0].uvalue;
+		returnval |= DVBFE_INFO_POST_ERROR_BITS;
+	}
+#else
+	(void) fehandle;
+	(void) querymask;
+	(void) result;
+#endif
+
+	return returnval;
+}
+
+#ifdef DTV_STREAM_ID
+static int dvbfe_get_frontend_v5(struct dvbfe_handle *fehandle,
+				 struct dvbfe_parameters *params)
+{
+	static const uint32_t cmds[] = {
+		DTV_DELIVERY_SYSTEM, DTV_FREQUENCY, DTV_INVERSION, DTV_SYMBOL_RATE,
+		DTV_INNER_FEC, DTV_MODULATION, DTV_ROLLOFF, DTV_PILOT,
+		DTV_BANDWIDTH_HZ, DTV_CODE_RATE_HP, DTV_CODE_RATE_LP,
+		DTV_TRANSMISSION_MODE, DTV_GUARD_INTERVAL, DTV_HIERARCHY,
+		DTV_STREAM_ID,
+	};
+	struct dtv_property props[sizeof(cmds) / sizeof(cmds[0])];
+	struct dtv_properties cmd;
+	unsigned int i;
+
+	memset(props, 0, sizeof(props));
+	for(i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++)
+		props[i].cmd = cmds[i];
+	cmd.num = i;
+	cmd.props = props;
+	if (dvbfe_ioctl(fehandle, FE_GET_PROPERTY, &cmd))
+		return -1;
+
+	memset(params, 0, sizeof(struct dvbfe_parameters));
+	params->frequency = props[1].u.data;
+	params->inversion = lookupval(props[2].u.data, 1, dvbfe_spectral_inversion_to_kapi);
+	params->stream_id = DVBFE_STREAM_ID_NONE;
+	switch(props[0].u.data) {
+	case SYS_DVBS2:
+		params->delivery_system = DVBFE_DELSYS_DVBS2;
+		params->stream_id = props[14].u.data;
+		params->u.dvbs.modulation = lookupval(props[5].u.data, 1, dvbfe_dvbs_mod_to_kapi);
+		params->u.dvbs.rolloff = lookupval(props[6].u.data, 1, dvbfe_dvbs_rolloff_to_kapi);
+		params->u.dvbs.pilot = lookupval(props[7].u.data, 1, dvbfe_dvbs_pilot_to_kapi);
+		// fall through
+	case SYS_DVBS:
+		params->u.dvbs.symbol_rate = props[3].u.data;
+		params->u.dvbs.fec_inner = lookupval(props[4].u.data, 1, dvbfe_code_rate_to_kapi);
+		break;
+
+	case SYS_DVBC_ANNEX_A:
+		params->u.dvbc.symbol_rate = props[3].u.data;
+		params->u.dvbc.fec_inner = lookupval(props[4].u.data, 1, dvbfe_code_rate_to_kapi);
+		params->u.dvbc.modulation = lookupval(props[5].u.data, 1, dvbfe_dvbc_mod_to_kapi);
+		break;
+
+	case SYS_DVBT2:
+		params->delivery_system = DVBFE_DELSYS_DVBT2;
+		params->stream_id = props[14].u.data;
+		// fall through
+	case SYS_DVBT:
+		params->u.dvbt.bandwidth = lookupval(props[8].u.data, 1, dvbfe_dvbt_bandwidth_to_hz);
+		params->u.dvbt.code_rate_HP = lookupval(props[9].u.data, 1, dvbfe_code_rate_to_kapi);
+		params->u.dvbt.code_rate_LP = lookupval(props[10].u.data, 1, dvbfe_code_rate_to_kapi);
+		params->u.dvbt.constellation = lookupval(props[5].u.data, 1, dvbfe_dvbt_const_to_kapi);
+		params->u.dvbt.transmission_mode =
+			lookupval(props[11].u.data, 1, dvbfe_dvbt_transmit_mode_to_kapi);
+		params->u.dvbt.guard_interval =
+			lookupval(props[12].u.data, 1, dvbfe_dvbt_guard_interval_to_kapi);
+		params->u.dvbt.hierarchy_information =
+			lookupval(props[13].u.data, 1, dvbfe_dvbt_hierarchy_to_kapi);
+		break;
+
+	case SYS_ATSC:
+	case SYS_DVBC_ANNEX_B:
+		params->u.atsc.modulation = lookupval(props[5].u.data, 1, dvbfe_atsc_mod_to_kapi);
+		break;
+
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+#endif
+
 extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 			  enum dvbfe_info_mask querymask,
 			  struct dvbfe_info *result,
@@ -238,12 +533,21 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 	switch(querytype) {
 	case DVBFE_INFO_QUERYTYPE_IMMEDIATE:
 		if (querymask & DVBFE_INFO_LOCKSTATUS) {
-			if (!ioctl(fehandle->fd, FE_READ_STATUS, &kevent.status)) {
+			if (!dvbfe_ioctl(fehandle, FE_READ_STATUS, &kevent.status)) {
 				returnval |= DVBFE_INFO_LOCKSTATUS;
 			}
 		}
 		if (querymask & DVBFE_INFO_FEPARAMS) {
-			if (!ioctl(fehandle->fd, FE_GET_FRONTEND, &kevent.parameters)) {
+#ifdef DTV_STREAM_ID
+			// the frontend was tuned with properties: read them back the same way
+			if ((fehandle->v5_tune == 1) &&
+			    (!dvbfe_get_frontend_v5(fehandle, &result->feparams))) {
+				returnval |= DVBFE_INFO_FEPARAMS;
+				querymask &= ~DVBFE_INFO_FEPARAMS;
+			}
+#endif
+			if ((querymask & DVBFE_INFO_FEPARAMS) &&
+			    (!dvbfe_ioctl(fehandle, FE_GET_FRONTEND, &kevent.parameters))) {
 				returnval |= DVBFE_INFO_FEPARAMS;
 			}
 		}
@@ -267,7 +571,7 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 		if (ok &&
 		    ((querymask & DVBFE_INFO_LOCKSTATUS) ||
 		     (querymask & DVBFE_INFO_FEPARAMS))) {
-			if (!ioctl(fehandle->fd, FE_GET_EVENT, &kevent)) {
+			if (!dvbfe_ioctl(fehandle, FE_GET_EVENT, &kevent)) {
 				if (querymask & DVBFE_INFO_LOCKSTATUS)
 					returnval |= DVBFE_INFO_LOCKSTATUS;
 				if (querymask & DVBFE_INFO_FEPARAMS)
@@ -283,9 +587,14 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 		result->viterbi = kevent.status & FE_HAS_VITERBI ? 1 : 0;
 		result->sync = kevent.status & FE_HAS_SYNC ? 1 : 0;
 		result->lock = kevent.status & FE_HAS_LOCK ? 1 : 0;
+		if (result->lock)
+			dvblatency_mark(&fehandle->latency, DVBLATENCY_LOCKED);
+		dvbfe_memo_status(fehandle, result->lock);
 	}
 
-	if (returnval & DVBFE_INFO_FEPARAMS) {
+	if ((returnval & DVBFE_INFO_FEPARAMS) && (querymask & DVBFE_INFO_FEPARAMS)) {
+		memset(&result->feparams, 0, sizeof(struct dvbfe_parameters));
+		result->feparams.stream_id = DVBFE_STREAM_ID_NONE;
 		result->feparams.frequency = kevent.parameters.frequency;
 		result->feparams.inversion = lookupval(kevent.parameters.inversion, 1, dvbfe_spectral_inversion_to_kapi);
 		switch(fehandle->type) {
@@ -327,20 +636,21 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 		}
 	}
 
+	returnval |= dvbfe_get_stats_v5(fehandle, querymask, result);
 	if (querymask & DVBFE_INFO_BER) {
-		if (!ioctl(fehandle->fd, FE_READ_BER, &result->ber))
+		if (!dvbfe_ioctl(fehandle, FE_READ_BER, &result->ber))
 			returnval |= DVBFE_INFO_BER;
 	}
-	if (querymask & DVBFE_INFO_SIGNAL_STRENGTH) {
-		if (!ioctl(fehandle->fd, FE_READ_SIGNAL_STRENGTH, &result->signal_strength))
+	if ((querymask & DVBFE_INFO_SIGNAL_STRENGTH) && !(returnval & DVBFE_INFO_SIGNAL_STRENGTH)) {
+		if (!dvbfe_ioctl(fehandle, FE_READ_SIGNAL_STRENGTH, &result->signal_strength))
 			returnval |= DVBFE_INFO_SIGNAL_STRENGTH;
 	}
-	if (querymask & DVBFE_INFO_SNR) {
-		if (!ioctl(fehandle->fd, FE_READ_SNR, &result->snr))
+	if ((querymask & DVBFE_INFO_SNR) && !(returnval & DVBFE_INFO_SNR)) {
+		if (!dvbfe_ioctl(fehandle, FE_READ_SNR, &result->snr))
 			returnval |= DVBFE_INFO_SNR;
 	}
-	if (querymask & DVBFE_INFO_UNCORRECTED_BLOCKS) {
-		if (!ioctl(fehandle->fd, FE_READ_UNCORRECTED_BLOCKS, &result->ucblocks))
+	if ((querymask & DVBFE_INFO_UNCORRECTED_BLOCKS) && !(returnval & DVBFE_INFO_UNCORRECTED_BLOCKS)) {
+		if (!dvbfe_ioctl(fehandle, FE_READ_UNCORRECTED_BLOCKS, &result->ucblocks))
 			returnval |= DVBFE_INFO_UNCORRECTED_BLOCKS;
 	}
 
@@ -348,14 +658,133 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
 	return returnval;
 }
 
-int dvbfe_set(struct dvbfe_handle *fehandle,
-	      struct dvbfe_parameters *params,
-	      int timeout)
+#ifdef DTV_STREAM_ID
+static void dvbfe_add_prop(struct dtv_property *props, unsigned int *num,
+			   uint32_t cmd, uint32_t data)
+{
+	memset(&props[*num], 0, sizeof(struct dtv_property));
+	props[*num].cmd = cmd;
+	props[*num].u.data = data;
+	(*num)++;
+}
+
+static int dvbfe_set_frontend_v5(struct dvbfe_handle *fehandle,
+				 struct dvbfe_parameters *params)
+{
+	struct dtv_property props[16];
+	struct dtv_properties cmd;
+	unsigned int num = 0;
+	int second_gen = params->delivery_system != DVBFE_DELSYS_DEFAULT;
+
+	dvbfe_add_prop(props, &num, DTV_CLEAR, 0);
+	switch(fehandle->type) {
+	case FE_QPSK:
+		if (params->delivery_system == DVBFE_DELSYS_DVBT2)
+			return -EINVAL;
+		dvbfe_add_prop(props, &num, DTV_DELIVERY_SYSTEM, second_gen ? SYS_DVBS2 : SYS_DVBS);
+		dvbfe_add_prop(props, &num, DTV_SYMBOL_RATE, params->u.dvbs.symbol_rate);
+		dvbfe_add_prop(props, &num, DTV_INNER_FEC,
+			       lookupval(params->u.dvbs.fec_inner, 0, dvbfe_code_rate_to_kapi));
+		if (second_gen) {
+			dvbfe_add_prop(props, &num, DTV_MODULATION,
+				       lookupval(params->u.dvbs.modulation, 0, dvbfe_dvbs_mod_to_kapi));
+			dvbfe_add_prop(props, &num, DTV_ROLLOFF,
+				       lookupval(params->u.dvbs.rolloff, 0, dvbfe_dvbs_rolloff_to_kapi));
+			dvbfe_add_prop(props, &num, DTV_PILOT,
+				       lookupval(params->u.dvbs.pilot, 0, dvbfe_dvbs_pilot_to_kapi));
+		} else {
+			dvbfe_add_prop(props, &num, DTV_MODULATION, QPSK);
+		}
+		break;
+
+	case FE_QAM:
+		if (second_gen)
+			return -EINVAL;
+		dvbfe_add_prop(props, &num, DTV_DELIVERY_SYSTEM, SYS_DVBC_ANNEX_A);
+		dvbfe_add_prop(props, &num, DTV_SYMBOL_RATE, params->u.dvbc.symbol_rate);
+		dvbfe_add_prop(props, &num, DTV_INNER_FEC,
+			       lookupval(params->u.dvbc.fec_inner, 0, dvbfe_code_rate_to_kapi));
+		dvbfe_add_prop(props, &num, DTV_MODULATION,
+			       lookupval(params->u.dvbc.modulation, 0, dvbfe_dvbc_mod_to_kapi));
+		break;
+
+	case FE_OFDM:
+		if (params->delivery_system == DVBFE_DELSYS_DVBS2)
+			return -EINVAL;
+		dvbfe_add_prop(props, &num, DTV_DELIVERY_SYSTEM, second_gen ? SYS_DVBT2 : SYS_DVBT);
+		dvbfe_add_prop(props, &num, DTV_BANDWIDTH_HZ,
+			       lookupval(params->u.dvbt.bandwidth, 0, dvbfe_dvbt_bandwidth_to_hz));
+		dvbfe_add_prop(props, &num, DTV_CODE_RATE_HP,
+			       lookupval(params->u.dvbt.code_rate_HP, 0, dvbfe_code_rate_to_kapi));
+		dvbfe_add_prop(props, &num, DTV_CODE_RATE_LP,
+			       lookupval(params->u.dvbt.code_rate_LP, 0, dvbfe_code_rate_to_kapi));
+		dvbfe_add_prop(props, &num, DTV_MODULATION,
+			       lookupval(params->u.dvbt.constellation, 0, dvbfe_dvbt_const_to_kapi));
+		dvbfe_add_prop(props, &num, DTV_TRANSMISSION_MODE,
+			       lookupval(params->u.dvbt.transmission_mode, 0, dvbfe_dvbt_transmit_mode_to_kapi));
+		dvbfe_add_prop(props, &num, DTV_GUARD_INTERVAL,
+			       lookupval(params->u.dvbt.guard_interval, 0, dvbfe_dvbt_guard_interval_to_kapi));
+		dvbfe_add_prop(props, &num, DTV_HIERARCHY,
+			       lookupval(params->u.dvbt.hierarchy_information, 0, dvbfe_dvbt_hierarchy_to_kapi));
+		break;
+
+	case FE_ATSC:
+		if (second_gen)
+			return -EINVAL;
+		switch(params->u.atsc.modulation) {
+		case DVBFE_ATSC_MOD_QAM_64:
+		case DVBFE_ATSC_MOD_QAM_256:
+			dvbfe_add_prop(props, &num, DTV_DELIVERY_SYSTEM, SYS_DVBC_ANNEX_B);
+			break;
+		default:
+			dvbfe_add_prop(props, &num, DTV_DELIVERY_SYSTEM, SYS_ATSC);
+			break;
+		}
+		dvbfe_add_prop(props, &num, DTV_MODULATION,
+			       lookupval(params->u.atsc.modulation, 0, dvbfe_atsc_mod_to_kapi));
+		break;
+
+	default:
+		return -EINVAL;
+	}
+
+	dvbfe_add_prop(props, &num, DTV_FREQUENCY, params->frequency);
+	dvbfe_add_prop(props, &num, DTV_INVERSION,
+		       lookupval(params->inversion, 0, dvbfe_spectral_inversion_to_kapi));
+	if (second_gen)
+		dvbfe_add_prop(props, &num, DTV_STREAM_ID, params->stream_id);
+	dvbfe_add_prop(props, &num, DTV_TUNE, 0);
+
+	cmd.num = num;
+	cmd.props = props;
+	return dvbfe_ioctl(fehandle, FE_SET_PROPERTY, &cmd);
+}
+#endif
+
+static int dvbfe_set_frontend(struct dvbfe_handle *fehandle,
+			      struct dvbfe_parameters *params)
 {
 	struct dvb_frontend_parameters kparams;
 	int res;
-	struct timeval endtime;
-	fe_status_t status;
+
+#ifdef DTV_STREAM_ID
+	// one command sequence, if the kernel has the property API
+	if (fehandle->v5_tune >= 0) {
+		res = dvbfe_set_frontend_v5(fehandle, params);
+		if (res == 0) {
+			fehandle->v5_tune = 1;
+			dvblatency_mark(&fehandle->latency, DVBLATENCY_TUNE_ISSUED);
+			dvbstats_inc(&dvbapi_stats, DVBAPI_STATS_TUNES);
+			DVBPROBE2(tune_start, fehandle->fd, params->frequency);
+			return 0;
+		}
+		if ((res == -EINVAL) || (fehandle->v5_tune == 1) ||
+		    (params->delivery_system != DVBFE_DELSYS_DEFAULT))
+			return res;
+	}
+#endif
+	if (params->delivery_system != DVBFE_DELSYS_DEFAULT)
+		return -EINVAL;
 
 	kparams.frequency = params->frequency;
 	kparams.inversion = lookupval(params->inversion, 0, dvbfe_spectral_inversion_to_kapi);
@@ -392,8 +821,112 @@ int dvbfe_set(struct dvbfe_handle *fehandle,
 		return -EINVAL;
 	}
 
-	// set it and check for error
-	res = ioctl(fehandle->fd, FE_SET_FRONTEND, &kparams);
+	res = dvbfe_ioctl(fehandle, FE_SET_FRONTEND, &kparams);
+	if (res == 0) {
+		if (fehandle->v5_tune == 0)
+			fehandle->v5_tune = -1;
+		dvblatency_mark(&fehandle->latency, DVBLATENCY_TUNE_ISSUED);
+		dvbstats_inc(&dvbapi_stats, DVBAPI_STATS_TUNES);
+		DVBPROBE2(tune_start, fehandle->fd, params->frequency);
+	}
+	return res;
+}
+
+/*
+ * Tune, with the memo's parameters if it has any for these; they are given
+ * try_ms to lock before dvbfe_memo_status() falls back to params.
+ */
+static int dvbfe_memo_set_frontend(struct dvbfe_handle *fehandle,
+				   struct dvbfe_parameters *params,
+				   int try_ms)
+{
+	struct dvbfe_parameters tune;
+	int res;
+
+	if (fehandle->memo == NULL)
+		return dvbfe_set_frontend(fehandle, params);
+
+	fehandle->memo_state = DVBFE_MEMO_STATE_IDLE;
+	fehandle->memo_key = fehandle->sec_state.valid ? fehandle->sec_state.key : 0;
+	memcpy(&fehandle->memo_request, params, sizeof(struct dvbfe_parameters));
+
+	if (dvbtunememo_lookup(fehandle->memo, fehandle->type, fehandle->memo_key, params, &tune)) {
+		if ((res = dvbfe_set_frontend(fehandle, &tune)) != 0)
+			return res;
+		clock_gettime(CLOCK_MONOTONIC, &fehandle->memo_deadline);
+		fehandle->memo_deadline.tv_sec += try_ms / 1000;
+		fehandle->memo_deadline.tv_nsec += (try_ms % 1000) * 1000000;
+		if (fehandle->memo_deadline.tv_nsec >= 1000000000) {
+			fehandle->memo_deadline.tv_sec++;
+			fehandle->memo_deadline.tv_nsec -= 1000000000;
+		}
+		fehandle->memo_state = DVBFE_MEMO_STATE_TRYING;
+		return 0;
+	}
+
+	if ((res = dvbfe_set_frontend(fehandle, params)) != 0)
+		return res;
+	fehandle->memo_state = DVBFE_MEMO_STATE_LEARNING;
+	return 0;
+}
+
+/*
+ * Called with the lock status whenever it is read: learns the parameters
+ * once a tune with AUTO values locks, and retunes as asked if remembered
+ * parameters have not locked in time.
+ */
+static void dvbfe_memo_status(struct dvbfe_handle *fehandle, int locked)
+{
+	struct dvbfe_info info;
+	struct timespec now;
+
+	switch(fehandle->memo_state) {
+	case DVBFE_MEMO_STATE_IDLE:
+		break;
+
+	case DVBFE_MEMO_STATE_TRYING:
+		if (locked) {
+			fehandle->memo_state = DVBFE_MEMO_STATE_IDLE;
+			break;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if ((now.tv_sec < fehandle->memo_deadline.tv_sec) ||
+		    ((now.tv_sec == fehandle->memo_deadline.tv_sec) &&
+		     (now.tv_nsec < fehandle->memo_deadline.tv_nsec)))
+			break;
+
+		dvbtunememo_forget(fehandle->memo, fehandle->type, fehandle->memo_key,
+				   &fehandle->memo_request);
+		fehandle->memo_state = DVBFE_MEMO_STATE_IDLE;
+		if (!dvbfe_set_frontend(fehandle, &fehandle->memo_request))
+			fehandle->memo_state = DVBFE_MEMO_STATE_LEARNING;
+		break;
+
+	case DVBFE_MEMO_STATE_LEARNING:
+		if (!locked)
+			break;
+		fehandle->memo_state = DVBFE_MEMO_STATE_IDLE;
+		if (dvbfe_get_info(fehandle, DVBFE_INFO_FEPARAMS, &info,
+				   DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) == DVBFE_INFO_FEPARAMS)
+			dvbtunememo_learn(fehandle->memo, fehandle->type, fehandle->memo_key,
+					  &fehandle->memo_request, &info.feparams);
+		break;
+	}
+}
+
+int dvbfe_set(struct dvbfe_handle *fehandle,
+	      struct dvbfe_parameters *params,
+	      int timeout)
+{
+	int res;
+	struct timeval endtime;
+	fe_status_t status;
+
+	// set it and check for error; remembered parameters get up to half
+	// the timeout before the ones asked for are tried
+	res = dvbfe_memo_set_frontend(fehandle, params,
+				      (timeout > 0) ? MIN(timeout / 2, DVBFE_TUNEMEMO_TRY_MS) :
+						      DVBFE_TUNEMEMO_TRY_MS);
 	if (res)
 		return res;
 
@@ -413,8 +946,10 @@ int dvbfe_set(struct dvbfe_handle *fehandle,
 	/* wait for a lock */
 	while(1) {
 		/* has it locked? */
-		if (!ioctl(fehandle->fd, FE_READ_STATUS, &status)) {
+		if (!dvbfe_ioctl(fehandle, FE_READ_STATUS, &status)) {
+			dvbfe_memo_status(fehandle, status & FE_HAS_LOCK);
 			if (status & FE_HAS_LOCK) {
+				dvblatency_mark(&fehandle->latency, DVBLATENCY_LOCKED);
 				break;
 			}
 		}
@@ -439,21 +974,236 @@ int dvbfe_set(struct dvbfe_handle *fehandle,
 	return -ETIMEDOUT;
 }
 
+void dvbfe_set_tunememo(struct dvbfe_handle *fehandle, struct dvbtunememo *memo)
+{
+	fehandle->memo = memo;
+	fehandle->memo_state = DVBFE_MEMO_STATE_IDLE;
+}
+
+struct dvblatency_session *dvbfe_get_latency(struct dvbfe_handle *fehandle)
+{
+	return &fehandle->latency;
+}
+
+struct dvbfe_sec_state *dvbfe_get_sec_state(struct dvbfe_handle *fehandle)
+{
+	return &fehandle->sec_state;
+}
+
 int dvbfe_get_pollfd(struct dvbfe_handle *handle)
 {
 	return handle->fd;
 }
 
+static int dvbfe_tune_setup(struct dvbfe_handle *fehandle)
+{
+	struct epoll_event ev;
+	int err;
+
+	if (fehandle->tune_pollfd != -1)
+		return 0;
+
+	if ((fehandle->tune_timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		goto error;
+	if ((fehandle->tune_pollfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		goto error;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN | EPOLLPRI;
+	ev.data.fd = fehandle->fd;
+	if (epoll_ctl(fehandle->tune_pollfd, EPOLL_CTL_ADD, fehandle->fd, &ev))
+		goto error;
+	ev.events = EPOLLIN;
+	ev.data.fd = fehandle->tune_timerfd;
+	if (epoll_ctl(fehandle->tune_pollfd, EPOLL_CTL_ADD, fehandle->tune_timerfd, &ev))
+		goto error;
+
+	return 0;
+
+error:
+	err = errno;
+	if (fehandle->tune_pollfd != -1)
+		close(fehandle->tune_pollfd);
+	if (fehandle->tune_timerfd != -1)
+		close(fehandle->tune_timerfd);
+	fehandle->tune_pollfd = -1;
+	fehandle->tune_timerfd = -1;
+	return -err;
+}
+
+static void dvbfe_tune_set_timer(struct dvbfe_handle *fehandle, int timeout)
+{
+	struct itimerspec its;
+
+	// a zero it_value disarms it, and clears any expiry not yet read
+	memset(&its, 0, sizeof(its));
+	if (timeout > 0) {
+		its.it_value.tv_sec = timeout / 1000;
+		its.it_value.tv_nsec = (timeout % 1000) * 1000000;
+	}
+	timerfd_settime(fehandle->tune_timerfd, 0, &its, NULL);
+}
+
+/* read queued lock status change events without blocking */
+static void dvbfe_tune_drain_events(struct dvbfe_handle *fehandle)
+{
+	struct dvb_frontend_event kevent;
+	struct pollfd pollfd;
+	int i;
+
+	pollfd.fd = fehandle->fd;
+	pollfd.events = POLLIN | POLLPRI;
+	for(i = 0; i < DVBFE_TUNE_MAX_EVENTS; i++) {
+		if (poll(&pollfd, 1, 0) <= 0)
+			break;
+		if (!(pollfd.revents & (POLLIN | POLLPRI)))
+			break;
+		if (dvbfe_ioctl(fehandle, FE_GET_EVENT, &kevent) && (errno != EOVERFLOW))
+			break;
+	}
+}
+
+int dvbfe_tune_start(struct dvbfe_handle *fehandle,
+		     struct dvbfe_parameters *params,
+		     int timeout)
+{
+	int res;
+
+	if ((res = dvbfe_tune_setup(fehandle)) != 0)
+		return res;
+
+	// events from before this tune are of no interest
+	dvbfe_tune_set_timer(fehandle, 0);
+	dvbfe_tune_drain_events(fehandle);
+
+	if ((res = dvbfe_memo_set_frontend(fehandle, params, DVBFE_TUNEMEMO_TRY_MS)) != 0) {
+		fehandle->tune_state = DVBFE_TUNE_STATE_IDLE;
+		return res;
+	}
+
+	fehandle->tune_state = DVBFE_TUNE_STATE_TUNING;
+	dvbfe_tune_set_timer(fehandle, timeout);
+	return 0;
+}
+
+int dvbfe_tune_get_pollfd(struct dvbfe_handle *fehandle)
+{
+	if (dvbfe_tune_setup(fehandle))
+		return -1;
+
+	return fehandle->tune_pollfd;
+}
+
+int dvbfe_tune_process(struct dvbfe_handle *fehandle)
+{
+	uint64_t expirations;
+	fe_status_t status;
+	int timedout = 0;
+
+	if (fehandle->tune_pollfd == -1)
+		return DVBFE_TUNE_NONE;
+
+	if (read(fehandle->tune_timerfd, &expirations, sizeof(expirations)) == sizeof(expirations))
+		timedout = 1;
+
+	dvbfe_tune_drain_events(fehandle);
+
+	if (dvbfe_ioctl(fehandle, FE_READ_STATUS, &status))
+		return -errno;
+	dvbfe_memo_status(fehandle, status & FE_HAS_LOCK);
+
+	switch(fehandle->tune_state) {
+	case DVBFE_TUNE_STATE_IDLE:
+		break;
+
+	case DVBFE_TUNE_STATE_TUNING:
+	case DVBFE_TUNE_STATE_UNLOCKED:
+		if (status & FE_HAS_LOCK) {
+			dvblatency_mark(&fehandle->latency, DVBLATENCY_LOCKED);
+			fehandle->tune_state = DVBFE_TUNE_STATE_LOCKED;
+			dvbfe_tune_set_timer(fehandle, 0);
+			return DVBFE_TUNE_LOCKED;
+		}
+		if (timedout) {
+			fehandle->tune_state = DVBFE_TUNE_STATE_UNLOCKED;
+			return DVBFE_TUNE_TIMEDOUT;
+		}
+		break;
+
+	case DVBFE_TUNE_STATE_LOCKED:
+		if (!(status & FE_HAS_LOCK)) {
+			fehandle->tune_state = DVBFE_TUNE_STATE_UNLOCKED;
+			return DVBFE_TUNE_LOST_LOCK;
+		}
+		break;
+	}
+
+	return DVBFE_TUNE_NONE;
+}
+
+void dvbfe_tune_cancel(struct dvbfe_handle *fehandle)
+{
+	if (fehandle->tune_pollfd == -1)
+		return;
+
+	dvbfe_tune_set_timer(fehandle, 0);
+	dvbfe_tune_drain_events(fehandle);
+	fehandle->tune_state = DVBFE_TUNE_STATE_IDLE;
+}
+
+int dvbfe_get_stats(struct dvbfe_handle *fehandle, struct dvbfe_info *result)
+{
+	int returnval = 0;
+	fe_status_t status;
+
+	result->name = fehandle->name;
+	result->type = fehandle->type;
+
+	if (!dvbfe_ioctl(fehandle, FE_READ_STATUS, &status)) {
+		result->signal = status & FE_HAS_SIGNAL ? 1 : 0;
+		result->carrier = status & FE_HAS_CARRIER ? 1 : 0;
+		result->viterbi = status & FE_HAS_VITERBI ? 1 : 0;
+		result->sync = status & FE_HAS_SYNC ? 1 : 0;
+		result->lock = status & FE_HAS_LOCK ? 1 : 0;
+		if (result->lock)
+			dvblatency_mark(&fehandle->latency, DVBLATENCY_LOCKED);
+		dvbfe_memo_status(fehandle, result->lock);
+		returnval |= DVBFE_INFO_LOCKSTATUS;
+	}
+
+	returnval |= dvbfe_get_stats_v5(fehandle, DVBFE_INFO_SIGNAL_STRENGTH | DVBFE_INFO_SNR |
+					DVBFE_INFO_UNCORRECTED_BLOCKS |
+					DVBFE_INFO_PRE_ERROR_BITS | DVBFE_INFO_POST_ERROR_BITS,
+					result);
+
+	// whatever did not come in the batch
+	if (!dvbfe_ioctl(fehandle, FE_READ_BER, &result->ber))
+		returnval |= DVBFE_INFO_BER;
+	if (!(returnval & DVBFE_INFO_SIGNAL_STRENGTH) &&
+	    !dvbfe_ioctl(fehandle, FE_READ_SIGNAL_STRENGTH, &result->signal_strength))
+		returnval |= DVBFE_INFO_SIGNAL_STRENGTH;
+	if (!(returnval & DVBFE_INFO_SNR) &&
+	    !dvbfe_ioctl(fehandle, FE_READ_SNR, &result->snr))
+		returnval |= DVBFE_INFO_SNR;
+	if (!(returnval & DVBFE_INFO_UNCORRECTED_BLOCKS) &&
+	    !dvbfe_ioctl(fehandle, FE_READ_UNCORRECTED_BLOCKS, &result->ucblocks))
+		returnval |= DVBFE_INFO_UNCORRECTED_BLOCKS;
+
+	return returnval;
+}
+
 int dvbfe_set_22k_tone(struct dvbfe_handle *fehandle, enum dvbfe_sec_tone_mode tone)
 {
 	int ret = 0;
 
+	fehandle->sec_state.valid = 0;
+
 	switch (tone) {
 	case DVBFE_SEC_TONE_OFF:
-		ret = ioctl(fehandle->fd, FE_SET_TONE, SEC_TONE_OFF);
+		ret = dvbfe_ioctl(fehandle, FE_SET_TONE, (void *) (long) SEC_TONE_OFF);
 		break;
 	case DVBFE_SEC_TONE_ON:
-		ret = ioctl(fehandle->fd, FE_SET_TONE, SEC_TONE_ON);
+		ret = dvbfe_ioctl(fehandle, FE_SET_TONE, (void *) (long) SEC_TONE_ON);
 		break;
 	default:
 		print(verbose, ERROR, 1, "Invalid command !");
@@ -469,12 +1219,14 @@ int dvbfe_set_tone_data_burst(struct dvbfe_handle *fehandle, enum dvbfe_sec_mini
 {
 	int ret = 0;
 
+	fehandle->sec_state.valid = 0;
+
 	switch (minicmd) {
 	case DVBFE_SEC_MINI_A:
-		ret = ioctl(fehandle->fd, FE_DISEQC_SEND_BURST, SEC_MINI_A);
+		ret = dvbfe_ioctl(fehandle, FE_DISEQC_SEND_BURST, (void *) (long) SEC_MINI_A);
 		break;
 	case DVBFE_SEC_MINI_B:
-		ret = ioctl(fehandle->fd, FE_DISEQC_SEND_BURST, SEC_MINI_B);
+		ret = dvbfe_ioctl(fehandle, FE_DISEQC_SEND_BURST, (void *) (long) SEC_MINI_B);
 		break;
 	default:
 		print(verbose, ERROR, 1, "Invalid command");
@@ -490,15 +1242,17 @@ int dvbfe_set_voltage(struct dvbfe_handle *fehandle, enum dvbfe_sec_voltage volt
 {
 	int ret = 0;
 
+	fehandle->sec_state.valid = 0;
+
 	switch (voltage) {
 	case DVBFE_SEC_VOLTAGE_OFF:
-		ret = ioctl(fehandle->fd, FE_SET_VOLTAGE, SEC_VOLTAGE_OFF);
+		ret = dvbfe_ioctl(fehandle, FE_SET_VOLTAGE, (void *) (long) SEC_VOLTAGE_OFF);
 		break;
 	case DVBFE_SEC_VOLTAGE_13:
-		ret = ioctl(fehandle->fd, FE_SET_VOLTAGE, SEC_VOLTAGE_13);
+		ret = dvbfe_ioctl(fehandle, FE_SET_VOLTAGE, (void *) (long) SEC_VOLTAGE_13);
 		break;
 	case DVBFE_SEC_VOLTAGE_18:
-		ret = ioctl(fehandle->fd, FE_SET_VOLTAGE, SEC_VOLTAGE_18);
+		ret = dvbfe_ioctl(fehandle, FE_SET_VOLTAGE, (void *) (long) SEC_VOLTAGE_18);
 		break;
 	default:
 		print(verbose, ERROR, 1, "Invalid command");
@@ -512,12 +1266,14 @@ int dvbfe_set_voltage(struct dvbfe_handle *fehandle, enum dvbfe_sec_voltage volt
 
 int dvbfe_set_high_lnb_voltage(struct dvbfe_handle *fehandle, int on)
 {
+	fehandle->sec_state.valid = 0;
+
 	switch (on) {
 	case 0:
-		ioctl(fehandle->fd, FE_ENABLE_HIGH_LNB_VOLTAGE, 0);
+		dvbfe_ioctl(fehandle, FE_ENABLE_HIGH_LNB_VOLTAGE, (void *) 0);
 		break;
 	default:
-		ioctl(fehandle->fd, FE_ENABLE_HIGH_LNB_VOLTAGE, 1);
+		dvbfe_ioctl(fehandle, FE_ENABLE_HIGH_LNB_VOLTAGE, (void *) 1);
 		break;
 	}
 	return 0;
@@ -527,7 +1283,9 @@ int dvbfe_do_dishnetworks_legacy_command(struct dvbfe_handle *fehandle, unsigned
 {
 	int ret = 0;
 
-	ret = ioctl(fehandle->fd, FE_DISHNETWORK_SEND_LEGACY_CMD, cmd);
+	fehandle->sec_state.valid = 0;
+
+	ret = dvbfe_ioctl(fehandle, FE_DISHNETWORK_SEND_LEGACY_CMD, (void *) (unsigned long) cmd);
 	if (ret == -1)
 		print(verbose, ERROR, 1, "IOCTL failed");
 
@@ -539,15 +1297,19 @@ int dvbfe_do_diseqc_command(struct dvbfe_handle *fehandle, uint8_t *data, uint8_
 	int ret = 0;
 	struct dvb_diseqc_master_cmd diseqc_message;
 
+	fehandle->sec_state.valid = 0;
+
 	if (len > 6)
 		return -EINVAL;
 
 	diseqc_message.msg_len = len;
 	memcpy(diseqc_message.msg, data, len);
 
-	ret = ioctl(fehandle->fd, FE_DISEQC_SEND_MASTER_CMD, &diseqc_message);
+	ret = dvbfe_ioctl(fehandle, FE_DISEQC_SEND_MASTER_CMD, &diseqc_message);
 	if (ret == -1)
 		print(verbose, ERROR, 1, "IOCTL failed");
+	else
+		dvbstats_inc(&dvbapi_stats, DVBAPI_STATS_DISEQC_COMMANDS);
 
 	return ret;
 }
@@ -563,7 +1325,7 @@ int dvbfe_diseqc_read(struct dvbfe_handle *fehandle, int timeout, unsigned char
 	reply.timeout = timeout;
 	reply.msg_len = len;
 
-	if ((result = ioctl(fehandle->fd, FE_DISEQC_RECV_SLAVE_REPLY, reply)) != 0)
+	if ((result = dvbfe_ioctl(fehandle, FE_DISEQC_RECV_SLAVE_REPLY, &reply)) != 0)
 		return result;
 
 	if (reply.msg_len < len)
@@ -40,6 +40,16 @@ enum dvbfe_type {
 	DVBFE_TYPE_ATSC,
 };
 
+/**
+ * Delivery system to tune. The second generation systems need a kernel with
+ * the DVBv5 property API.
+ */
+enum dvbfe_delivery_system {
+	DVBFE_DELSYS_DEFAULT,		/* first generation system of the frontend type */
+	DVBFE_DELSYS_DVBS2,
+	DVBFE_DELSYS_DVBT2,
+};
+
 enum dvbfe_spectral_inversion {
 	DVBFE_INVERSION_OFF,
 	DVBFE_INVERSION_ON,
@@ -56,7 +66,30 @@ enum dvbfe_code_rate {
 	DVBFE_FEC_6_7,
 	DVBFE_FEC_7_8,
 	DVBFE_FEC_8_9,
-	DVBFE_FEC_AUTO
+	DVBFE_FEC_AUTO,
+	DVBFE_FEC_3_5,
+	DVBFE_FEC_9_10,
+};
+
+enum dvbfe_dvbs_mod {
+	DVBFE_DVBS_MOD_QPSK,
+	DVBFE_DVBS_MOD_8PSK,
+	DVBFE_DVBS_MOD_16APSK,
+	DVBFE_DVBS_MOD_32APSK,
+	DVBFE_DVBS_MOD_AUTO
+};
+
+enum dvbfe_dvbs_rolloff {
+	DVBFE_DVBS_ROLLOFF_35,
+	DVBFE_DVBS_ROLLOFF_25,
+	DVBFE_DVBS_ROLLOFF_20,
+	DVBFE_DVBS_ROLLOFF_AUTO
+};
+
+enum dvbfe_dvbs_pilot {
+	DVBFE_DVBS_PILOT_OFF,
+	DVBFE_DVBS_PILOT_ON,
+	DVBFE_DVBS_PILOT_AUTO
 };
 
 enum dvbfe_dvbt_const {
@@ -89,14 +122,20 @@ enum dvbfe_atsc_mod {
 enum dvbfe_dvbt_transmit_mode {
 	DVBFE_DVBT_TRANSMISSION_MODE_2K,
 	DVBFE_DVBT_TRANSMISSION_MODE_8K,
-	DVBFE_DVBT_TRANSMISSION_MODE_AUTO
+	DVBFE_DVBT_TRANSMISSION_MODE_AUTO,
+	DVBFE_DVBT_TRANSMISSION_MODE_1K,
+	DVBFE_DVBT_TRANSMISSION_MODE_16K,
+	DVBFE_DVBT_TRANSMISSION_MODE_32K,
 };
 
 enum dvbfe_dvbt_bandwidth {
 	DVBFE_DVBT_BANDWIDTH_8_MHZ,
 	DVBFE_DVBT_BANDWIDTH_7_MHZ,
 	DVBFE_DVBT_BANDWIDTH_6_MHZ,
-	DVBFE_DVBT_BANDWIDTH_AUTO
+	DVBFE_DVBT_BANDWIDTH_AUTO,
+	DVBFE_DVBT_BANDWIDTH_5_MHZ,
+	DVBFE_DVBT_BANDWIDTH_10_MHZ,
+	DVBFE_DVBT_BANDWIDTH_1_712_MHZ,
 };
 
 enum dvbfe_dvbt_guard_interval {
@@ -104,7 +143,10 @@ enum dvbfe_dvbt_guard_interval {
 	DVBFE_DVBT_GUARD_INTERVAL_1_16,
 	DVBFE_DVBT_GUARD_INTERVAL_1_8,
 	DVBFE_DVBT_GUARD_INTERVAL_1_4,
-	DVBFE_DVBT_GUARD_INTERVAL_AUTO
+	DVBFE_DVBT_GUARD_INTERVAL_AUTO,
+	DVBFE_DVBT_GUARD_INTERVAL_1_128,
+	DVBFE_DVBT_GUARD_INTERVAL_19_128,
+	DVBFE_DVBT_GUARD_INTERVAL_19_256,
 };
 
 enum dvbfe_dvbt_hierarchy {
@@ -115,16 +157,29 @@ enum dvbfe_dvbt_hierarchy {
 	DVBFE_DVBT_HIERARCHY_AUTO
 };
 
+/**
+ * stream_id value meaning "do not filter on an input stream".
+ */
+#define DVBFE_STREAM_ID_NONE 0xffffffff
+
 /**
  * Structure used to store and communicate frontend parameters.
+ *
+ * The fields marked "second generation" are only used when delivery_system
+ * selects DVB-S2 or DVB-T2; zero them (e.g. with memset()) otherwise.
  */
 struct dvbfe_parameters {
 	uint32_t frequency;
 	enum dvbfe_spectral_inversion inversion;
+	enum dvbfe_delivery_system delivery_system;
+	uint32_t stream_id;				/* second generation: input stream/PLP */
 	union {
 		struct {
 			uint32_t			symbol_rate;
 			enum dvbfe_code_rate		fec_inner;
+			enum dvbfe_dvbs_mod		modulation;	/* second generation */
+			enum dvbfe_dvbs_rolloff		rolloff;	/* second generation */
+			enum dvbfe_dvbs_pilot		pilot;		/* second generation */
 		} dvbs;
 
 		struct {
@@ -175,6 +230,8 @@ enum dvbfe_info_mask {
 	DVBFE_INFO_SIGNAL_STRENGTH		= 0x08,
 	DVBFE_INFO_SNR				= 0x10,
 	DVBFE_INFO_UNCORRECTED_BLOCKS		= 0x20,
+	DVBFE_INFO_PRE_ERROR_BITS		= 0x40,
+	DVBFE_INFO_POST_ERROR_BITS		= 0x80,
 };
 
 /**
@@ -193,6 +250,10 @@ struct dvbfe_info {
 	uint16_t signal_strength;		/* DVBFE_INFO_SIGNAL_STRENGTH */
 	uint16_t snr;				/* DVBFE_INFO_SNR */
 	uint32_t ucblocks;			/* DVBFE_INFO_UNCORRECTED_BLOCKS */
+	uint64_t pre_error_bits;		/* } DVBFE_INFO_PRE_ERROR_BITS */
+	uint64_t pre_total_bits;		/* } (before the inner FEC) */
+	uint64_t post_error_bits;		/* } DVBFE_INFO_POST_ERROR_BITS */
+	uint64_t post_total_bits;		/* } (after the inner FEC) */
 };
 
 /**
@@ -237,6 +298,10 @@ extern void dvbfe_close(struct dvbfe_handle *handle);
  * Note: this function provides only the basic tuning operation; you might want to
  * investigate dvbfe_set_sec() in sec.h for a unified device tuning operation.
  *
+ * On kernels with the DVBv5 property API, the parameters are sent as a single
+ * FE_SET_PROPERTY command sequence, which also allows DVB-S2 and DVB-T2;
+ * older kernels get FE_SET_FRONTEND.
+ *
  * @param fehandle Handle opened with dvbfe_open().
  * @param params Params to set.
  * @param timeout <0 => wait forever for lock. 0=>return immediately, >0=>
@@ -272,6 +337,121 @@ extern int dvbfe_get_info(struct dvbfe_handle *fehandle,
  */
 extern int dvbfe_get_pollfd(struct dvbfe_handle *handle);
 
+struct dvblatency_session;
+struct dvbtunememo;
+
+/**
+ * Have dvbfe_set() and dvbfe_tune_start() tune with, and learn, the
+ * parameters remembered in a memo (see dvbtunememo.h).
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @param memo The memo, or NULL to stop using one.
+ */
+extern void dvbfe_set_tunememo(struct dvbfe_handle *fehandle, struct dvbtunememo *memo);
+
+/**
+ * Get the tuning latency session of a frontend (see dvblatency.h). dvbfe
+ * marks the tune and the first lock seen through any of its calls;
+ * applications add the tables they wait for.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @return The session.
+ */
+extern struct dvblatency_session *dvbfe_get_latency(struct dvbfe_handle *fehandle);
+
+/**
+ * The SEC (LNB voltage, tone and switch) state last fully established on a
+ * frontend by a SEC library. Every SEC call made through the handle (voltage,
+ * tone, burst, DiSEqC or legacy commands) marks it unknown again, so the
+ * library only has to set it once its whole sequence has been sent.
+ */
+struct dvbfe_sec_state {
+	int valid;		/* 0 => unknown: the next sequence must be sent in full */
+	uint32_t key;		/* what was established, encoded by the SEC library */
+
+	/* anything else the SEC library keeps for the frontend (e.g. a Unicable
+	 * SCR reservation); release is called by dvbfe_close() while the
+	 * frontend is still open */
+	void *priv;
+	void (*release)(struct dvbfe_handle *fehandle, void *priv);
+};
+
+/**
+ * Get the SEC state cache of a frontend.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @return The state.
+ */
+extern struct dvbfe_sec_state *dvbfe_get_sec_state(struct dvbfe_handle *fehandle);
+
+/**
+ * Events returned by dvbfe_tune_process().
+ */
+enum dvbfe_tune_event {
+	DVBFE_TUNE_NONE,			/* nothing to report yet */
+	DVBFE_TUNE_LOCKED,			/* the frontend has locked */
+	DVBFE_TUNE_TIMEDOUT,			/* no lock within the timeout */
+	DVBFE_TUNE_LOST_LOCK,			/* lock was lost after DVBFE_TUNE_LOCKED */
+};
+
+/**
+ * Start tuning the frontend without waiting for a lock. Progress is then
+ * driven by polling dvbfe_tune_get_pollfd() and calling dvbfe_tune_process()
+ * when it is readable, so one thread can tune many frontends at once.
+ *
+ * The frontend keeps trying after a timeout: a lock gained later is still
+ * reported, as is a lock regained after DVBFE_TUNE_LOST_LOCK.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @param params Params to set.
+ * @param timeout Number of milliseconds after which DVBFE_TUNE_TIMEDOUT is
+ * reported if there is still no lock, or <= 0 for no timeout.
+ * @return 0 on success, or nonzero on failure.
+ */
+extern int dvbfe_tune_start(struct dvbfe_handle *fehandle,
+			    struct dvbfe_parameters *params,
+			    int timeout);
+
+/**
+ * Get a file descriptor which becomes readable when dvbfe_tune_process() has
+ * something to look at: a lock status change, or the timeout. It may be
+ * added to poll(), select() or epoll sets.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @return FD for polling, or -1 on failure.
+ */
+extern int dvbfe_tune_get_pollfd(struct dvbfe_handle *fehandle);
+
+/**
+ * Process what made the tune poll fd readable. This never blocks.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @return One of DVBFE_TUNE_*, or < 0 on error.
+ */
+extern int dvbfe_tune_process(struct dvbfe_handle *fehandle);
+
+/**
+ * Stop reporting tune events, e.g. before the frontend is used for
+ * something else.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ */
+extern void dvbfe_tune_cancel(struct dvbfe_handle *fehandle);
+
+/**
+ * Retrieve the lock status and all signal statistics with as few ioctls as
+ * the kernel allows: signal strength, SNR, uncorrected blocks and the bit
+ * error counts come in one call on kernels with DVBv5 statistics, falling
+ * back to the older one value per call ioctls otherwise. Note that the
+ * uncorrected block and bit counts are running totals with DVBv5 statistics.
+ *
+ * @param fehandle Handle opened with dvbfe_open().
+ * @param result Where to put the retrieved results.
+ * @return ORed bitmask of DVBFE_INFO_* indicating which values were read
+ * successfully (never DVBFE_INFO_FEPARAMS).
+ */
+extern int dvbfe_get_stats(struct dvbfe_handle *fehandle, struct dvbfe_info *result);
+
 /**
  *	Tone/Data Burst control
  * 	@param fehandle Handle opened with dvbfe_open().
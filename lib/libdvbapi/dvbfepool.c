@@ -0,0 +1,419 @@
+/*
+ * libdvbfepool - frontends kept open between the programs using them
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/param.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <linux/dvb/frontend.h>
+#include "dvbfepool.h"
+
+#define DVBFEPOOL_OP_OPEN 1
+#define DVBFEPOOL_OP_LIST 2
+
+// how long a program waits for the keeper before opening the device itself
+#define DVBFEPOOL_TIMEOUT_MS 2000
+
+struct dvbfepool_request {
+	int32_t op;
+	int32_t adapter;
+	int32_t frontend;
+};
+
+struct dvbfepool_list_reply {
+	int32_t count;
+	struct {
+		int32_t adapter;
+		int32_t frontend;
+		int32_t in_use;
+	} frontends[DVBFEPOOL_MAX_FRONTENDS];
+};
+
+struct dvbfepool_held {
+	int adapter;
+	int frontend;
+	int fd;
+	int holder;			/* connection it is checked out on, -1 => none */
+};
+
+struct dvbfepool_client {
+	int sock;
+	int held;			/* index into frontends, -1 => none */
+};
+
+struct dvbfepool {
+	char sock_path[108];
+	int listen_fd;
+
+	struct dvbfepool_held frontends[DVBFEPOOL_MAX_FRONTENDS];
+	int frontend_count;
+
+	struct dvbfepool_client clients[DVBFEPOOL_MAX_CLIENTS];
+	int client_count;
+};
+
+static const char *dvbfepool_path(void)
+{
+	const char *path = getenv("DVB_FEPOOL_SOCKET");
+
+	if ((path == NULL) || (strlen(path) >= sizeof(((struct sockaddr_un *) 0)->sun_path)))
+		return DVBFEPOOL_SOCKET;
+	return path;
+}
+
+struct dvbfepool *dvbfepool_create(void)
+{
+	struct dvbfepool *pool;
+	struct sockaddr_un addr;
+
+	if ((pool = calloc(1, sizeof(struct dvbfepool))) == NULL)
+		return NULL;
+	strcpy(pool->sock_path, dvbfepool_path());
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, pool->sock_path);
+
+	// a stale socket from a keeper which didn't shut down cleanly
+	unlink(pool->sock_path);
+
+	if ((pool->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0) {
+		free(pool);
+		return NULL;
+	}
+	if (bind(pool->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(pool->listen_fd, DVBFEPOOL_MAX_CLIENTS)) {
+		close(pool->listen_fd);
+		free(pool);
+		return NULL;
+	}
+	// the same people as may open the devices themselves
+	chmod(pool->sock_path, 0660);
+
+	return pool;
+}
+
+int dvbfepool_add(struct dvbfepool *pool, int adapter, int frontend)
+{
+	char filename[PATH_MAX+1];
+	struct dvbfepool_held *held;
+	int fd;
+	int i;
+
+	for(i=0; i < pool->frontend_count; i++) {
+		if ((pool->frontends[i].adapter == adapter) && (pool->frontends[i].frontend == frontend))
+			return 0;
+	}
+	if (pool->frontend_count == DVBFEPOOL_MAX_FRONTENDS) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	sprintf(filename, "/dev/dvb/adapter%i/frontend%i", adapter, frontend);
+	if ((fd = open(filename, O_RDWR | O_CLOEXEC)) < 0) {
+		if (errno != ENOENT)
+			return -1;
+		sprintf(filename, "/dev/dvb%i.frontend%i", adapter, frontend);
+		if ((fd = open(filename, O_RDWR | O_CLOEXEC)) < 0)
+			return -1;
+	}
+
+	held = &pool->frontends[pool->frontend_count++];
+	held->adapter = adapter;
+	held->frontend = frontend;
+	held->fd = fd;
+	held->holder = -1;
+	return 0;
+}
+
+int dvbfepool_get_pollfds(struct dvbfepool *pool, struct pollfd *pollfds, int max)
+{
+	int count = 0;
+	int i;
+
+	if (max < 1)
+		return 0;
+	pollfds[count].fd = pool->listen_fd;
+	pollfds[count++].events = POLLIN;
+	for(i=0; (i < pool->client_count) && (count < max); i++) {
+		pollfds[count].fd = pool->clients[i].sock;
+		pollfds[count++].events = POLLIN;
+	}
+	return count;
+}
+
+/**
+ * Take a frontend back: the events of the last program's tuning are thrown
+ * away, and the flags it may have set on the shared file description reset.
+ */
+static void dvbfepool_release(struct dvbfepool_held *held)
+{
+	struct dvb_frontend_event event;
+
+	fcntl(held->fd, F_SETFL, O_NONBLOCK);
+	while ((ioctl(held->fd, FE_GET_EVENT, &event) == 0) || (errno == EOVERFLOW))
+		;
+	fcntl(held->fd, F_SETFL, 0);
+	held->holder = -1;
+}
+
+static void dvbfepool_drop(struct dvbfepool *pool, int i)
+{
+	struct dvbfepool_client *client = &pool->clients[i];
+
+	if (client->held != -1)
+		dvbfepool_release(&pool->frontends[client->held]);
+	close(client->sock);
+
+	// the last one moves into the gap, so its frontend changes hands too
+	*client = pool->clients[--pool->client_count];
+	if ((i != pool->client_count) && (client->held != -1))
+		pool->frontends[client->held].holder = i;
+}
+
+static int dvbfepool_send_fd(int sock, int32_t status, int fd)
+{
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cbuf, 0, sizeof(cbuf));
+	iov.iov_base = &status;
+	iov.iov_len = sizeof(status);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	if (fd != -1) {
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+	if (sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) != sizeof(status))
+		return -1;
+	return 0;
+}
+
+static int dvbfepool_answer(struct dvbfepool *pool, int i, const struct dvbfepool_request *request)
+{
+	struct dvbfepool_client *client = &pool->clients[i];
+	struct dvbfepool_list_reply reply;
+	int j;
+
+	switch(request->op) {
+	case DVBFEPOOL_OP_OPEN:
+		for(j=0; j < pool->frontend_count; j++) {
+			if ((pool->frontends[j].adapter == request->adapter) &&
+			    (pool->frontends[j].frontend == request->frontend))
+				break;
+		}
+		if (j == pool->frontend_count)
+			return dvbfepool_send_fd(client->sock, ENOENT, -1);
+		if ((pool->frontends[j].holder != -1) || (client->held != -1))
+			return dvbfepool_send_fd(client->sock, EBUSY, -1);
+		if (dvbfepool_send_fd(client->sock, 0, pool->frontends[j].fd))
+			return -1;
+		pool->frontends[j].holder = i;
+		client->held = j;
+		return 0;
+
+	case DVBFEPOOL_OP_LIST:
+		memset(&reply, 0, sizeof(reply));
+		reply.count = pool->frontend_count;
+		for(j=0; j < pool->frontend_count; j++) {
+			reply.frontends[j].adapter = pool->frontends[j].adapter;
+			reply.frontends[j].frontend = pool->frontends[j].frontend;
+			reply.frontends[j].in_use = pool->frontends[j].holder != -1;
+		}
+		if (send(client->sock, &reply, sizeof(reply), MSG_NOSIGNAL | MSG_DONTWAIT) != sizeof(reply))
+			return -1;
+		return 0;
+	}
+
+	return dvbfepool_send_fd(client->sock, EINVAL, -1);
+}
+
+void dvbfepool_process(struct dvbfepool *pool, int fd)
+{
+	struct dvbfepool_request request;
+	ssize_t len;
+	int sock;
+	int i;
+
+	if (fd == pool->listen_fd) {
+		if ((sock = accept4(pool->listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) < 0)
+			return;
+		if (pool->client_count == DVBFEPOOL_MAX_CLIENTS) {
+			close(sock);
+			return;
+		}
+		pool->clients[pool->client_count].sock = sock;
+		pool->clients[pool->client_count++].held = -1;
+		return;
+	}
+
+	for(i=0; i < pool->client_count; i++) {
+		if (pool->clients[i].sock == fd)
+			break;
+	}
+	if (i == pool->client_count)
+		return;
+
+	// requests are small enough to always arrive whole
+	len = recv(fd, &request, sizeof(request), MSG_DONTWAIT);
+	if ((len < 0) && (errno == EAGAIN))
+		return;
+	if ((len != sizeof(request)) || dvbfepool_answer(pool, i, &request))
+		dvbfepool_drop(pool, i);
+}
+
+void dvbfepool_destroy(struct dvbfepool *pool)
+{
+	int i;
+
+	while (pool->client_count)
+		dvbfepool_drop(pool, 0);
+	for(i=0; i < pool->frontend_count; i++)
+		close(pool->frontends[i].fd);
+	close(pool->listen_fd);
+	unlink(pool->sock_path);
+	free(pool);
+}
+
+/**
+ * Connect to the keeper and send it a request.
+ */
+static int dvbfepool_request(int op, int adapter, int frontend)
+{
+	struct dvbfepool_request request;
+	struct sockaddr_un addr;
+	struct timeval tv;
+	int sock;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, dvbfepool_path());
+	if ((sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	if (connect(sock, (struct sockaddr *) &addr, sizeof(addr))) {
+		// nobody listening is the same as nobody holding the frontend
+		if ((errno == ECONNREFUSED) || (errno == EACCES))
+			errno = ENOENT;
+		close(sock);
+		return -1;
+	}
+
+	tv.tv_sec = DVBFEPOOL_TIMEOUT_MS / 1000;
+	tv.tv_usec = (DVBFEPOOL_TIMEOUT_MS % 1000) * 1000;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+	request.op = op;
+	request.adapter = adapter;
+	request.frontend = frontend;
+	if (send(sock, &request, sizeof(request), MSG_NOSIGNAL) != sizeof(request)) {
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+int dvbfepool_open_frontend(int adapter, int frontend, int *checkout)
+{
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	int32_t status;
+	int sock;
+	int fd;
+
+	if ((sock = dvbfepool_request(DVBFEPOOL_OP_OPEN, adapter, frontend)) < 0)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &status;
+	iov.iov_len = sizeof(status);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != sizeof(status)) {
+		close(sock);
+		errno = ETIMEDOUT;
+		return -1;
+	}
+	if (status) {
+		close(sock);
+		errno = status;
+		return -1;
+	}
+	if (((cmsg = CMSG_FIRSTHDR(&msg)) == NULL) ||
+	    (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS)) {
+		close(sock);
+		errno = EPROTO;
+		return -1;
+	}
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+	*checkout = sock;
+	return fd;
+}
+
+int dvbfepool_list(struct dvbfepool_frontend *frontends, int max)
+{
+	struct dvbfepool_list_reply reply;
+	ssize_t got = 0;
+	ssize_t len;
+	int sock;
+	int i;
+
+	if ((sock = dvbfepool_request(DVBFEPOOL_OP_LIST, -1, -1)) < 0)
+		return -1;
+	while (got < (ssize_t) sizeof(reply)) {
+		if ((len = recv(sock, ((uint8_t *) &reply) + got, sizeof(reply) - got, 0)) <= 0) {
+			close(sock);
+			errno = len ? errno : EPROTO;
+			return -1;
+		}
+		got += len;
+	}
+	close(sock);
+
+	for(i=0; (i < reply.count) && (i < max) && (i < DVBFEPOOL_MAX_FRONTENDS); i++) {
+		frontends[i].adapter = reply.frontends[i].adapter;
+		frontends[i].frontend = reply.frontends[i].frontend;
+		frontends[i].in_use = reply.frontends[i].in_use;
+	}
+	return i;
+}
@@ -0,0 +1,144 @@
+/*
+ * libdvbfepool - frontends kept open between the programs using them
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBFEPOOL_H
+#define LIBDVBFEPOOL_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <poll.h>
+
+/**
+ * A pool of warm frontends.
+ *
+ * Many drivers load firmware, power up the tuner and demodulator, and
+ * sometimes recalibrate, on the first open of a frontend, and power it all
+ * down again some seconds after the last close; a program which opens a
+ * frontend from cold can spend longer on that than on tuning. A keeper
+ * (dvbfepoold) holds frontends open read-write so they stay powered, and
+ * hands a duplicate of its fd to a program asking for one over the
+ * DVBFEPOOL_SOCKET Unix socket (as SCM_RIGHTS).
+ *
+ * The connection a frontend was handed out on is the checkout: while it is
+ * open nobody else is given that frontend, and when it closes (the program
+ * exits, say) the keeper takes the frontend back. A program must therefore
+ * close the frontend fd no later than the connection. The fd shares its
+ * file description with the keeper's, so O_NONBLOCK set on it would stay
+ * set; the keeper clears it on taking the frontend back. Tuning, the LNB
+ * voltage and tone are left as the last program set them.
+ *
+ * dvbfe_open() asks the keeper first when opening read-write, so programs
+ * using it get warm frontends without changes, and dvbtuner_acquire()
+ * prefers frontends the keeper has warm when several are idle. Without a
+ * keeper, asking costs one failed connect().
+ */
+struct dvbfepool;
+
+#define DVBFEPOOL_SOCKET "/run/dvbfepool.sock"
+
+#define DVBFEPOOL_MAX_FRONTENDS 64
+#define DVBFEPOOL_MAX_CLIENTS 64
+
+/**
+ * A frontend held by the keeper.
+ */
+struct dvbfepool_frontend {
+	int adapter;
+	int frontend;
+	int in_use;		/* checked out at the moment */
+};
+
+/**
+ * Start a keeper, listening on DVBFEPOOL_SOCKET (or $DVB_FEPOOL_SOCKET).
+ *
+ * @return The pool, or NULL on failure.
+ */
+extern struct dvbfepool *dvbfepool_create(void);
+
+/**
+ * Open a frontend read-write and keep it open. This is when a driver loads
+ * its firmware, so it may take seconds.
+ *
+ * @param pool The pool.
+ * @param adapter Adapter concerned.
+ * @param frontend Frontend concerned.
+ * @return 0 on success, or -1 with errno set on failure (EBUSY if another
+ * program has it open read-write).
+ */
+extern int dvbfepool_add(struct dvbfepool *pool, int adapter, int frontend);
+
+/**
+ * Fill in pollfds for the socket and the connections, for POLLIN.
+ *
+ * @param pool The pool.
+ * @param pollfds Where to put them.
+ * @param max Size of pollfds.
+ * @return The number filled in.
+ */
+extern int dvbfepool_get_pollfds(struct dvbfepool *pool, struct pollfd *pollfds, int max);
+
+/**
+ * Deal with one of those fds being readable: take a connection, answer a
+ * request, or take a frontend back from a connection which has closed.
+ *
+ * @param pool The pool.
+ * @param fd The fd.
+ */
+extern void dvbfepool_process(struct dvbfepool *pool, int fd);
+
+/**
+ * Stop listening and close the frontends. Programs which have one checked
+ * out keep it.
+ *
+ * @param pool The pool.
+ */
+extern void dvbfepool_destroy(struct dvbfepool *pool);
+
+/**
+ * Check out a frontend from the keeper.
+ *
+ * @param adapter Adapter concerned.
+ * @param frontend Frontend concerned.
+ * @param checkout Where to put the connection, to be closed after the
+ * frontend fd.
+ * @return The frontend fd (blocking, read-write), or -1 with errno set:
+ * ENOENT if there is no keeper or it doesn't hold that frontend, EBUSY if it
+ * is checked out, anything else on failure.
+ */
+extern int dvbfepool_open_frontend(int adapter, int frontend, int *checkout);
+
+/**
+ * Retrieve the frontends held by the keeper.
+ *
+ * @param frontends Where to put them.
+ * @param max Size of frontends.
+ * @return The number filled in, or -1 with errno set (ENOENT if there is no
+ * keeper).
+ */
+extern int dvbfepool_list(struct dvbfepool_frontend *frontends, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBDVBFEPOOL_H
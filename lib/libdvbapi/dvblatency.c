@@ -0,0 +1,239 @@
+/*
+ * libdvblatency - tuning latency instrumentation
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <string.h>
+#include <time.h>
+#include <libdvbmisc/dvbprobe.h>
+#include "dvblatency.h"
+
+/*
+ * A value v >= 16 with its top bit at position 4 + shift goes in bucket
+ * (shift + 1) * 16 + (the 4 bits under the top bit); smaller values have a
+ * bucket each.
+ */
+#define DVBLATENCY_SUB_BITS 4
+#define DVBLATENCY_SUB_BUCKETS (1 << DVBLATENCY_SUB_BITS)
+#define DVBLATENCY_MAX_SHIFT 32
+#define DVBLATENCY_BUCKETS ((DVBLATENCY_MAX_SHIFT + 2) * DVBLATENCY_SUB_BUCKETS)
+
+struct dvblatency_histogram {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint32_t buckets[DVBLATENCY_BUCKETS];
+};
+
+static struct dvblatency_histogram histograms[DVBLATENCY_INTERVAL_COUNT];
+
+static const char *interval_names[DVBLATENCY_INTERVAL_COUNT] = {
+	"diseqc-to-tune",
+	"tune-to-lock",
+	"lock-to-pat",
+	"pat-to-pmt",
+	"tune-to-pmt",
+};
+
+static uint64_t dvblatency_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000) + 1;
+}
+
+static int dvblatency_bucket(uint64_t value)
+{
+	int shift;
+
+	if (value < DVBLATENCY_SUB_BUCKETS)
+		return value;
+
+	shift = 63 - __builtin_clzll(value) - DVBLATENCY_SUB_BITS;
+	if (shift > DVBLATENCY_MAX_SHIFT)
+		return DVBLATENCY_BUCKETS - 1;
+	return ((shift + 1) << DVBLATENCY_SUB_BITS) +
+		((value >> shift) - DVBLATENCY_SUB_BUCKETS);
+}
+
+static uint64_t dvblatency_bucket_top(int bucket)
+{
+	int shift;
+	uint64_t top;
+
+	if (bucket < DVBLATENCY_SUB_BUCKETS)
+		return bucket;
+
+	shift = (bucket >> DVBLATENCY_SUB_BITS) - 1;
+	top = (bucket & (DVBLATENCY_SUB_BUCKETS - 1)) + DVBLATENCY_SUB_BUCKETS;
+	return ((top + 1) << shift) - 1;
+}
+
+void dvblatency_record(enum dvblatency_interval interval, uint64_t value_us)
+{
+	struct dvblatency_histogram *h;
+	uint64_t cur;
+
+	if ((unsigned int) interval >= DVBLATENCY_INTERVAL_COUNT)
+		return;
+	h = &histograms[interval];
+
+	__sync_fetch_and_add(&h->buckets[dvblatency_bucket(value_us)], 1);
+
+	// min is stored + 1 so that 0 means "none yet"
+	while(((cur = h->min) == 0) || (value_us + 1 < cur)) {
+		if (__sync_bool_compare_and_swap(&h->min, cur, value_us + 1))
+			break;
+	}
+	while(value_us > (cur = h->max)) {
+		if (__sync_bool_compare_and_swap(&h->max, cur, value_us))
+			break;
+	}
+
+	// the count goes last, so readers never see more values than buckets hold
+	__sync_fetch_and_add(&h->count, 1);
+}
+
+void dvblatency_session_init(struct dvblatency_session *session)
+{
+	memset(session, 0, sizeof(struct dvblatency_session));
+}
+
+void dvblatency_mark(struct dvblatency_session *session, enum dvblatency_event event)
+{
+	uint64_t *mark = session->mark_us;
+	uint64_t now = dvblatency_now();
+
+	switch(event) {
+	case DVBLATENCY_DISEQC_SENT:
+		// several commands make up one switch sequence
+		if (mark[DVBLATENCY_DISEQC_SENT] && !mark[DVBLATENCY_TUNE_ISSUED])
+			return;
+		dvblatency_session_init(session);
+		break;
+
+	case DVBLATENCY_TUNE_ISSUED:
+		if (mark[DVBLATENCY_TUNE_ISSUED])
+			mark[DVBLATENCY_DISEQC_SENT] = 0;
+		if (mark[DVBLATENCY_DISEQC_SENT])
+			dvblatency_record(DVBLATENCY_DISEQC_TO_TUNE, now - mark[DVBLATENCY_DISEQC_SENT]);
+		mark[DVBLATENCY_LOCKED] = 0;
+		mark[DVBLATENCY_FIRST_PAT] = 0;
+		mark[DVBLATENCY_FIRST_PMT] = 0;
+		break;
+
+	case DVBLATENCY_LOCKED:
+		if (!mark[DVBLATENCY_TUNE_ISSUED] || mark[DVBLATENCY_LOCKED] ||
+		    mark[DVBLATENCY_FIRST_PAT] || mark[DVBLATENCY_FIRST_PMT])
+			return;
+		dvblatency_record(DVBLATENCY_TUNE_TO_LOCK, now - mark[DVBLATENCY_TUNE_ISSUED]);
+		DVBPROBE1(tune_lock, now - mark[DVBLATENCY_TUNE_ISSUED]);
+		break;
+
+	case DVBLATENCY_FIRST_PAT:
+		if (!mark[DVBLATENCY_TUNE_ISSUED] || mark[DVBLATENCY_FIRST_PAT] ||
+		    mark[DVBLATENCY_FIRST_PMT])
+			return;
+		if (mark[DVBLATENCY_LOCKED])
+			dvblatency_record(DVBLATENCY_LOCK_TO_PAT, now - mark[DVBLATENCY_LOCKED]);
+		break;
+
+	case DVBLATENCY_FIRST_PMT:
+		if (!mark[DVBLATENCY_TUNE_ISSUED] || mark[DVBLATENCY_FIRST_PMT])
+			return;
+		if (mark[DVBLATENCY_FIRST_PAT])
+			dvblatency_record(DVBLATENCY_PAT_TO_PMT, now - mark[DVBLATENCY_FIRST_PAT]);
+		dvblatency_record(DVBLATENCY_TUNE_TO_PMT, now - mark[DVBLATENCY_TUNE_ISSUED]);
+		break;
+
+	default:
+		return;
+	}
+
+	mark[event] = now;
+}
+
+uint64_t dvblatency_count(enum dvblatency_interval interval)
+{
+	if ((unsigned int) interval >= DVBLATENCY_INTERVAL_COUNT)
+		return 0;
+	return histograms[interval].count;
+}
+
+uint64_t dvblatency_percentile(enum dvblatency_interval interval, double percentile)
+{
+	struct dvblatency_histogram *h;
+	uint64_t wanted;
+	uint64_t seen = 0;
+	uint64_t value;
+	int i;
+
+	if ((unsigned int) interval >= DVBLATENCY_INTERVAL_COUNT)
+		return 0;
+	h = &histograms[interval];
+	if (h->count == 0)
+		return 0;
+
+	if (percentile <= 0)
+		return h->min - 1;
+	if (percentile >= 100)
+		return h->max;
+
+	wanted = (uint64_t) ((percentile * h->count) / 100.0);
+	if (wanted == 0)
+		wanted = 1;
+	for(i = 0; i < DVBLATENCY_BUCKETS; i++) {
+		seen += h->buckets[i];
+		if (seen >= wanted)
+			break;
+	}
+
+	value = dvblatency_bucket_top(i);
+	if (value > h->max)
+		value = h->max;
+	return value;
+}
+
+void dvblatency_dump(FILE *f)
+{
+	int i;
+
+	fprintf(f, "%-16s %8s %10s %10s %10s %10s %10s\n",
+		"latency (ms)", "count", "min", "p50", "p90", "p99", "max");
+	for(i = 0; i < DVBLATENCY_INTERVAL_COUNT; i++) {
+		if (histograms[i].count == 0) {
+			fprintf(f, "%-16s %8u\n", interval_names[i], 0);
+			continue;
+		}
+
+		fprintf(f, "%-16s %8llu %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+			interval_names[i],
+			(unsigned long long) histograms[i].count,
+			dvblatency_percentile(i, 0) / 1000.0,
+			dvblatency_percentile(i, 50) / 1000.0,
+			dvblatency_percentile(i, 90) / 1000.0,
+			dvblatency_percentile(i, 99) / 1000.0,
+			dvblatency_percentile(i, 100) / 1000.0);
+	}
+}
+
+void dvblatency_reset(void)
+{
+	memset(histograms, 0, sizeof(histograms));
+}
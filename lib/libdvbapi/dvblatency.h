@@ -0,0 +1,134 @@
+/*
+ * libdvblatency - tuning latency instrumentation
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBLATENCY_H
+#define LIBDVBLATENCY_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * Tuning latency instrumentation.
+ *
+ * Each tune is followed by a session: a monotonic timestamp is taken at each
+ * of the events below, and the time between consecutive events goes into a
+ * process wide histogram for that interval. dvbfe marks the tune and the
+ * lock on its own handles (see dvbfe_get_latency()), dvbsec_set() marks the
+ * switch commands, and applications mark the tables they wait for.
+ *
+ * The histograms are log-linear (as HDR histograms are): every value is
+ * kept to within 1/16 of itself, from 1us up to well over a day. They may be
+ * updated from several threads at once.
+ */
+enum dvblatency_event {
+	DVBLATENCY_DISEQC_SENT,		/* first switch command of a tune */
+	DVBLATENCY_TUNE_ISSUED,		/* frontend parameters set */
+	DVBLATENCY_LOCKED,		/* FE_HAS_LOCK first seen */
+	DVBLATENCY_FIRST_PAT,		/* first PAT section received */
+	DVBLATENCY_FIRST_PMT,		/* first PMT section received */
+	DVBLATENCY_EVENT_COUNT,
+};
+
+/**
+ * The intervals measured.
+ */
+enum dvblatency_interval {
+	DVBLATENCY_DISEQC_TO_TUNE,
+	DVBLATENCY_TUNE_TO_LOCK,
+	DVBLATENCY_LOCK_TO_PAT,
+	DVBLATENCY_PAT_TO_PMT,
+	DVBLATENCY_TUNE_TO_PMT,
+	DVBLATENCY_INTERVAL_COUNT,
+};
+
+/**
+ * Timestamps of one tune. Zero it (or use dvblatency_session_init()) before
+ * the first use.
+ */
+struct dvblatency_session {
+	uint64_t mark_us[DVBLATENCY_EVENT_COUNT];	/* 0 => not seen yet */
+};
+
+/**
+ * Start a session from scratch.
+ *
+ * @param session The session.
+ */
+extern void dvblatency_session_init(struct dvblatency_session *session);
+
+/**
+ * Record that an event has happened now. DVBLATENCY_DISEQC_SENT and
+ * DVBLATENCY_TUNE_ISSUED start a new tune; the other events only count the
+ * first time they are seen after a tune, and are ignored out of order (e.g.
+ * a lock first noticed after the PAT arrived).
+ *
+ * @param session The session.
+ * @param event The event.
+ */
+extern void dvblatency_mark(struct dvblatency_session *session, enum dvblatency_event event);
+
+/**
+ * Add a value to an interval's histogram directly.
+ *
+ * @param interval The interval.
+ * @param value_us The value in microseconds.
+ */
+extern void dvblatency_record(enum dvblatency_interval interval, uint64_t value_us);
+
+/**
+ * Retrieve the number of values recorded for an interval.
+ *
+ * @param interval The interval.
+ * @return The number of values.
+ */
+extern uint64_t dvblatency_count(enum dvblatency_interval interval);
+
+/**
+ * Retrieve a percentile of an interval.
+ *
+ * @param interval The interval.
+ * @param percentile The percentile, 0 to 100.
+ * @return The value in microseconds (the top of its histogram bucket, so at
+ * most 1/16 high), or 0 if nothing was recorded.
+ */
+extern uint64_t dvblatency_percentile(enum dvblatency_interval interval, double percentile);
+
+/**
+ * Print a table of counts and percentiles of every interval.
+ *
+ * @param f Where to print it.
+ */
+extern void dvblatency_dump(FILE *f);
+
+/**
+ * Clear all the histograms.
+ */
+extern void dvblatency_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
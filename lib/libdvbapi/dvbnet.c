@@ -102,3 +102,76 @@ int dvbnet_remove_interface(int fd, int ifnum)
 {
 	return ioctl(fd, NET_REMOVE_IF, ifnum);
 }
+
+int dvbnet_get_interfaces(int fd, struct dvbnet_interface *interfaces, int max)
+{
+	int ifnum;
+	int count = 0;
+
+	for (ifnum = 0; (ifnum < DVBNET_MAX_INTERFACES) && (count < max); ifnum++) {
+		if (dvbnet_get_interface(fd, ifnum, &interfaces[count].pid,
+					 &interfaces[count].encapsulation))
+			continue;
+		interfaces[count++].ifnum = ifnum;
+	}
+
+	return count;
+}
+
+int dvbnet_set_interfaces(int fd, struct dvbnet_interface *wanted, int count,
+			  int *added, int *removed)
+{
+	struct dvbnet_interface current[DVBNET_MAX_INTERFACES];
+	int ncurrent;
+	int status = 0;
+	int res;
+	int i, j;
+
+	if (added)
+		*added = 0;
+	if (removed)
+		*removed = 0;
+
+	for (i = 0; i < count; i++)
+		wanted[i].ifnum = -1;
+
+	// match the existing interfaces, each one against at most one wanted entry
+	ncurrent = dvbnet_get_interfaces(fd, current, DVBNET_MAX_INTERFACES);
+	for (j = 0; j < ncurrent; j++) {
+		for (i = 0; i < count; i++) {
+			if ((wanted[i].ifnum < 0) &&
+			    (wanted[i].pid == current[j].pid) &&
+			    (wanted[i].encapsulation == current[j].encapsulation))
+				break;
+		}
+
+		if (i < count) {
+			wanted[i].ifnum = current[j].ifnum;
+			continue;
+		}
+
+		if ((res = dvbnet_remove_interface(fd, current[j].ifnum)) < 0) {
+			if (status == 0)
+				status = res;
+		} else if (removed) {
+			(*removed)++;
+		}
+	}
+
+	// removals first, so their slots can be reused
+	for (i = 0; i < count; i++) {
+		if (wanted[i].ifnum >= 0)
+			continue;
+
+		if ((res = dvbnet_add_interface(fd, wanted[i].pid, wanted[i].encapsulation)) < 0) {
+			if (status == 0)
+				status = res;
+		} else {
+			wanted[i].ifnum = res;
+			if (added)
+				(*added)++;
+		}
+	}
+
+	return status;
+}
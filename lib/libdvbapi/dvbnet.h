@@ -41,6 +41,15 @@ enum dvbnet_encap {
  */
 #define DVBNET_MAX_INTERFACES 10
 
+/**
+ * Details of one DVBNET interface.
+ */
+struct dvbnet_interface {
+	int ifnum;
+	uint16_t pid;
+	enum dvbnet_encap encapsulation;
+};
+
 /**
  * Open a DVB net interface.
  *
@@ -80,6 +89,33 @@ extern int dvbnet_get_interface(int fd, int ifnum, uint16_t *pid, enum dvbnet_en
  */
 extern int dvbnet_remove_interface(int fd, int ifnum);
 
+/**
+ * Get the details of all DVBNET interfaces of a netdevice.
+ *
+ * @param fd FD opened with libdvbnet_open().
+ * @param interfaces Array receiving the interfaces, in ifnum order.
+ * @param max Number of entries in interfaces.
+ * @return Number of interfaces found.
+ */
+extern int dvbnet_get_interfaces(int fd, struct dvbnet_interface *interfaces, int max);
+
+/**
+ * Bring the DVBNET interfaces of a netdevice to a wanted set in one go.
+ * Existing interfaces whose PID and encapsulation are wanted are kept, all
+ * the others are removed, then the missing ones are added. The ifnum of
+ * each wanted entry is filled in, or set to -1 if it couldn't be added.
+ *
+ * @param fd FD opened with libdvbnet_open().
+ * @param wanted Array of wanted interfaces (the ifnum fields are ignored).
+ * @param count Number of entries in wanted.
+ * @param added If not NULL, set to the number of interfaces added.
+ * @param removed If not NULL, set to the number of interfaces removed.
+ * @return 0 on success, or the status of the first ioctl which failed (the
+ * remaining changes are still attempted).
+ */
+extern int dvbnet_set_interfaces(int fd, struct dvbnet_interface *wanted, int count,
+				 int *added, int *removed);
+
 #ifdef __cplusplus
 }
 #endif
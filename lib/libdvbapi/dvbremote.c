@@ -0,0 +1,1047 @@
+/*
+ * libdvbremote - adapters on another host
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/dvb/dmx.h>
+#include <linux/dvb/frontend.h>
+#include "dvbremote.h"
+
+#define REMOTE_MAX_ADAPTERS	16
+#define REMOTE_MAX_FILTERS	256
+#define REMOTE_MAX_PIDS		32	/* per PES filter, with DMX_ADD_PID */
+#define REMOTE_SECTION_MAX	4096
+#define REMOTE_BATCH		(64 * 188)
+#define REMOTE_UDP_BUFFER	(4 * 1024 * 1024)
+#define REMOTE_DEMUX_BUFFER	(256 * 1024)
+#define REMOTE_DVR_BUFFER	(2 * 1024 * 1024)
+#define REMOTE_ALL_PIDS		0x2000
+#define REMOTE_CONFIG_MAX	64	/* lines of the configuration */
+
+enum remote_filter_type {
+	REMOTE_FILTER_UNSET,
+	REMOTE_FILTER_SECTION,
+	REMOTE_FILTER_PES,
+	REMOTE_FILTER_DVR,
+};
+
+struct remote_demux;
+
+struct remote_filter {
+	int fd;			/* the caller's end */
+	int peer;		/* ours, written by the thread */
+	dev_t dev;		/* of fd, so that a reused FD number is not mistaken for it */
+	ino_t ino;
+	struct remote_demux *demux;
+
+	enum remote_filter_type type;
+	int started;
+	struct dmx_sct_filter_params sct;
+	struct dmx_pes_filter_params pes;
+	uint16_t pids[REMOTE_MAX_PIDS];
+	int pid_count;
+
+	/* the section being put together, -1 while waiting for a start */
+	uint8_t section[REMOTE_SECTION_MAX];
+	int section_len;
+	int cc;
+
+	/* what goes out in one write after each datagram */
+	uint8_t out[REMOTE_BATCH];
+	int out_len;
+};
+
+/*
+ * The demux of a remote adapter: a connection to the server to change the
+ * PIDs it sends, the UDP socket they arrive on, and the thread filtering
+ * them.
+ */
+struct remote_demux {
+	int adapter;
+	int running;
+	int tcp;
+	int udp;
+	int wake[2];
+	pthread_t thread;
+	uint16_t pid_refs[REMOTE_ALL_PIDS + 1];
+};
+
+static pthread_mutex_t remote_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct remote_demux remote_demuxes[REMOTE_MAX_ADAPTERS];
+
+/* the configuration, as the file was when it was last read */
+struct remote_config_entry {
+	int adapter;
+	struct dvbremote_address address;
+};
+
+static pthread_mutex_t config_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct remote_config_entry config_entries[REMOTE_CONFIG_MAX];
+static int config_count;
+static char config_filename[PATH_MAX];	/* "" => not read */
+static struct stat config_stat;
+static struct remote_filter *remote_filters[REMOTE_MAX_FILTERS];
+static int remote_filter_count;
+
+/* parse the configuration into config_entries */
+static void config_parse(FILE *f)
+{
+	char line[512];
+
+	config_count = 0;
+	while((config_count < REMOTE_CONFIG_MAX) && fgets(line, sizeof(line), f)) {
+		struct dvbremote_address *address = &config_entries[config_count].address;
+		char *cur = line + strspn(line, " \t");
+		char host[256];
+		char *port;
+		char *end;
+		int remote = 0;
+		long a;
+
+		if ((*cur == '#') || (*cur == '\n') || (*cur == 0))
+			continue;
+
+		a = strtol(cur, &end, 10);
+		if (end == cur)
+			continue;
+		if (sscanf(end, " %255s %i", host, &remote) < 1)
+			continue;
+
+		config_entries[config_count].adapter = a;
+		address->port = DVBREMOTE_DEFAULT_PORT;
+		address->adapter = remote;
+		// host:port, [v6 address]:port
+		if ((host[0] == '[') && ((end = strchr(host, ']')) != NULL)) {
+			*end = 0;
+			port = (end[1] == ':') ? end + 2 : NULL;
+			memmove(host, host + 1, strlen(host + 1) + 1);
+		} else if ((port = strrchr(host, ':')) != NULL) {
+			*port++ = 0;
+		}
+		if (port)
+			address->port = atoi(port);
+		strcpy(address->host, host);
+		config_count++;
+	}
+}
+
+int dvbremote_lookup(int adapter, struct dvbremote_address *address)
+{
+	const char *filename = getenv("DVB_REMOTE_CONFIG");
+	struct stat st;
+	int found = 0;
+	int i;
+	FILE *f;
+
+	if (filename == NULL)
+		filename = DVBREMOTE_CONFIG_FILE;
+
+	// every device open asks, so the file is only read again once it changed
+	pthread_mutex_lock(&config_lock);
+	if (stat(filename, &st)) {
+		config_count = 0;
+		config_filename[0] = 0;
+	} else if (strcmp(filename, config_filename) ||
+		   (st.st_dev != config_stat.st_dev) || (st.st_ino != config_stat.st_ino) ||
+		   (st.st_size != config_stat.st_size) ||
+		   (st.st_mtim.tv_sec != config_stat.st_mtim.tv_sec) ||
+		   (st.st_mtim.tv_nsec != config_stat.st_mtim.tv_nsec)) {
+		config_count = 0;
+		config_filename[0] = 0;
+		if ((f = fopen(filename, "r")) != NULL) {
+			config_parse(f);
+			fclose(f);
+			snprintf(config_filename, sizeof(config_filename), "%s", filename);
+			config_stat = st;
+		}
+	}
+
+	for(i = 0; i < config_count; i++) {
+		if (config_entries[i].adapter != adapter)
+			continue;
+		if (address != NULL)
+			*address = config_entries[i].address;
+		found = 1;
+		break;
+	}
+	pthread_mutex_unlock(&config_lock);
+
+	return found;
+}
+
+static int remote_connect(int adapter, struct dvbremote_address *address)
+{
+	struct addrinfo hints;
+	struct addrinfo *res;
+	struct addrinfo *ai;
+	char port[16];
+	int one = 1;
+	int fd = -1;
+	int ret;
+
+	if (!dvbremote_lookup(adapter, address)) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	sprintf(port, "%i", address->port);
+	if ((ret = getaddrinfo(address->host, port, &hints, &res)) != 0) {
+		errno = (ret == EAI_SYSTEM) ? errno : EHOSTUNREACH;
+		return -1;
+	}
+	for(ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol)) < 0)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		return -1;
+
+	// requests are small and each waits for its reply
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+static int remote_write(int fd, const void *buf, size_t len)
+{
+	const uint8_t *pos = buf;
+
+	while(len) {
+		ssize_t count = send(fd, pos, len, MSG_NOSIGNAL);
+
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		pos += count;
+		len -= count;
+	}
+	return 0;
+}
+
+static int remote_read(int fd, void *buf, size_t len)
+{
+	uint8_t *pos = buf;
+
+	while(len) {
+		ssize_t count = recv(fd, pos, len, 0);
+
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (count == 0) {
+			errno = EIO;
+			return -1;
+		}
+		pos += count;
+		len -= count;
+	}
+	return 0;
+}
+
+static int remote_send(int fd, struct dvbremote_msg *msg, const void *payload)
+{
+	if (remote_write(fd, msg, sizeof(struct dvbremote_msg)))
+		return -1;
+	if (msg->length && remote_write(fd, payload, msg->length))
+		return -1;
+	return 0;
+}
+
+/*
+ * Wait for the reply to a request, passing over event notifications. The
+ * payload goes to buf, for up to size bytes.
+ */
+static int remote_reply(int fd, struct dvbremote_msg *msg, void *buf, size_t size)
+{
+	uint8_t skip[256];
+
+	do {
+		if (remote_read(fd, msg, sizeof(struct dvbremote_msg)))
+			return -1;
+		if ((msg->length > DVBREMOTE_MAX_PAYLOAD) ||
+		    ((msg->type == DVBREMOTE_MSG_EVENT) && msg->length)) {
+			errno = EPROTO;
+			return -1;
+		}
+	} while(msg->type == DVBREMOTE_MSG_EVENT);
+	if (msg->type != DVBREMOTE_MSG_REPLY) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	if (msg->length <= size)
+		return msg->length ? remote_read(fd, buf, msg->length) : 0;
+	if (remote_read(fd, buf, size))
+		return -1;
+	for(size = msg->length - size; size; ) {
+		size_t count = (size < sizeof(skip)) ? size : sizeof(skip);
+
+		if (remote_read(fd, skip, count))
+			return -1;
+		size -= count;
+	}
+	return 0;
+}
+
+int dvbremote_open_frontend(int adapter, int frontend, int readonly)
+{
+	struct dvbremote_address address;
+	struct dvbremote_msg msg;
+	int fd;
+
+	if ((fd = remote_connect(adapter, &address)) < 0)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = DVBREMOTE_MSG_OPEN_FRONTEND;
+	msg.request = readonly;
+	msg.value = frontend;
+	msg.adapter = address.adapter;
+	if (remote_send(fd, &msg, NULL) || remote_reply(fd, &msg, NULL, 0)) {
+		close(fd);
+		return -1;
+	}
+	if (msg.value < 0) {
+		close(fd);
+		errno = -msg.value;
+		return -1;
+	}
+
+	return fd;
+}
+
+int dvbremote_frontend_ioctl(int fd, unsigned long request, void *arg)
+{
+	struct dtv_properties *props = NULL;
+	struct dvbremote_msg msg;
+	uint8_t buf[DVBREMOTE_MAX_PAYLOAD];
+	void *payload = arg;
+	size_t size = _IOC_SIZE(request);
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = DVBREMOTE_MSG_IOCTL;
+	msg.request = request;
+
+	// the properties themselves go, not the pointer to them
+	if ((request == FE_SET_PROPERTY) || (request == FE_GET_PROPERTY)) {
+		props = arg;
+		payload = props->props;
+		size = props->num * sizeof(struct dtv_property);
+		msg.length = size;
+	} else if (_IOC_DIR(request) & _IOC_WRITE) {
+		msg.length = size;
+	} else if (_IOC_DIR(request) == _IOC_NONE) {
+		msg.value = (long) arg;
+	}
+	if (size > DVBREMOTE_MAX_PAYLOAD) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (remote_send(fd, &msg, payload) || remote_reply(fd, &msg, buf, sizeof(buf)))
+		return -1;
+
+	if (props || (_IOC_DIR(request) & _IOC_READ))
+		memcpy(payload, buf, (msg.length < size) ? msg.length : size);
+	if (msg.value < 0) {
+		errno = -msg.value;
+		return -1;
+	}
+	return msg.value;
+}
+
+static void remote_wake(struct remote_demux *demux)
+{
+	char c = 0;
+
+	if (write(demux->wake[1], &c, 1) < 0)
+		return;
+}
+
+/*
+ * Have the server send a PID, or stop sending it, as filters come and go.
+ * Called with the lock held.
+ */
+static void remote_pid_ref(struct remote_demux *demux, int pid, int delta)
+{
+	struct dvbremote_msg msg;
+
+	if (!demux->running || ((delta < 0) && (demux->pid_refs[pid] == 0)))
+		return;
+	demux->pid_refs[pid] += delta;
+	if ((delta > 0) ? (demux->pid_refs[pid] != 1) : (demux->pid_refs[pid] != 0))
+		return;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = (delta > 0) ? DVBREMOTE_MSG_ADD_PID : DVBREMOTE_MSG_REMOVE_PID;
+	msg.value = pid;
+	remote_send(demux->tcp, &msg, NULL);
+}
+
+static void remote_filter_start(struct remote_filter *f)
+{
+	int i;
+
+	if (f->started)
+		return;
+	f->started = 1;
+	f->section_len = -1;
+	f->cc = -1;
+	for(i = 0; i < f->pid_count; i++)
+		remote_pid_ref(f->demux, f->pids[i], 1);
+}
+
+static void remote_filter_stop(struct remote_filter *f)
+{
+	int i;
+
+	if (!f->started)
+		return;
+	f->started = 0;
+	for(i = 0; i < f->pid_count; i++)
+		remote_pid_ref(f->demux, f->pids[i], -1);
+}
+
+static void remote_filter_free(struct remote_filter *f)
+{
+	int i;
+
+	remote_filter_stop(f);
+	for(i = 0; i < REMOTE_MAX_FILTERS; i++) {
+		if (remote_filters[i] == f)
+			remote_filters[i] = NULL;
+	}
+	__atomic_fetch_sub(&remote_filter_count, 1, __ATOMIC_RELAXED);
+	close(f->peer);
+	free(f);
+}
+
+static uint32_t remote_crc32(const uint8_t *data, int len)
+{
+	uint32_t crc = 0xffffffff;
+	int i;
+
+	while(len--) {
+		crc ^= (uint32_t) *data++ << 24;
+		for(i = 0; i < 8; i++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+	}
+	return crc;
+}
+
+/*
+ * Section filter match, as the kernel does it: filter byte 0 is the table
+ * id, the others follow the section length. Mode bits set ask for a
+ * mismatch, of at least one of those bits.
+ */
+static int remote_section_match(struct remote_filter *f, const uint8_t *section, int len)
+{
+	struct dmx_filter *filter = &f->sct.filter;
+	int have_negative = 0;
+	int negative_differs = 0;
+	int i;
+
+	for(i = 0; i < DMX_FILTER_SIZE; i++) {
+		uint8_t mask = filter->mask[i];
+		int pos = i ? i + 2 : 0;
+		uint8_t diff;
+
+		if (mask == 0)
+			continue;
+		if (pos >= len)
+			return 0;
+		diff = (section[pos] ^ filter->filter[i]) & mask;
+		if (diff & ~filter->mode[i])
+			return 0;
+		if (mask & filter->mode[i]) {
+			have_negative = 1;
+			if (diff & filter->mode[i])
+				negative_differs = 1;
+		}
+	}
+
+	return !have_negative || negative_differs;
+}
+
+static void remote_section_done(struct remote_filter *f)
+{
+	int len = f->section_len;
+
+	if (!remote_section_match(f, f->section, len))
+		return;
+	if ((f->sct.flags & DMX_CHECK_CRC) && (f->section[1] & 0x80) &&
+	    remote_crc32(f->section, len))
+		return;
+
+	// a full buffer loses the section, as a kernel overflow would
+	send(f->peer, f->section, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (f->sct.flags & DMX_ONESHOT)
+		remote_filter_stop(f);
+}
+
+/*
+ * Add payload bytes to the section being put together. Past the end of it,
+ * a new section only starts if may_start (the bytes after the pointer
+ * field); the rest up to there belongs to nothing.
+ */
+static void remote_section_add(struct remote_filter *f, const uint8_t *data, int len, int may_start)
+{
+	while((len > 0) && f->started) {
+		int want;
+		int take;
+
+		if (f->section_len < 0)
+			return;
+		if ((f->section_len == 0) && (data[0] == 0xff)) {
+			// stuffing to the end of the packet
+			f->section_len = -1;
+			return;
+		}
+
+		if (f->section_len < 3)
+			want = 3 - f->section_len;
+		else
+			want = 3 + (((f->section[1] & 0x0f) << 8) | f->section[2]) - f->section_len;
+		take = (want < len) ? want : len;
+		memcpy(f->section + f->section_len, data, take);
+		f->section_len += take;
+		data += take;
+		len -= take;
+
+		if (f->section_len == 3) {
+			if ((3 + (((f->section[1] & 0x0f) << 8) | f->section[2])) > REMOTE_SECTION_MAX)
+				f->section_len = -1;
+			continue;
+		}
+		if (take == want) {
+			remote_section_done(f);
+			f->section_len = may_start ? 0 : -1;
+		}
+	}
+}
+
+static void remote_section_packet(struct remote_filter *f, const uint8_t *pkt)
+{
+	const uint8_t *payload = pkt + 4;
+	int cc = pkt[3] & 0x0f;
+	int len;
+
+	if (!(pkt[3] & 0x10))
+		return;
+	if (pkt[3] & 0x20)
+		payload += 1 + pkt[4];
+	len = pkt + 188 - payload;
+	if (len <= 0)
+		return;
+
+	// a repeated packet is dropped, a lost one loses the section
+	if (f->cc != -1) {
+		if (cc == f->cc)
+			return;
+		if (cc != ((f->cc + 1) & 0x0f))
+			f->section_len = -1;
+	}
+	f->cc = cc;
+
+	if (!(pkt[1] & 0x40)) {
+		remote_section_add(f, payload, len, 0);
+		return;
+	}
+
+	if (payload[0] >= len) {
+		f->section_len = -1;
+		return;
+	}
+	if (f->section_len > 0)
+		remote_section_add(f, payload + 1, payload[0], 0);
+	f->section_len = 0;
+	remote_section_add(f, payload + 1 + payload[0], len - 1 - payload[0], 1);
+}
+
+static void remote_flush(struct remote_filter *f)
+{
+	if (f->out_len)
+		send(f->peer, f->out, f->out_len, MSG_DONTWAIT | MSG_NOSIGNAL);
+	f->out_len = 0;
+}
+
+static void remote_out(struct remote_filter *f, const uint8_t *data, int len)
+{
+	if (f->out_len + len > REMOTE_BATCH)
+		remote_flush(f);
+	memcpy(f->out + f->out_len, data, len);
+	f->out_len += len;
+}
+
+static int remote_pes_wants(struct remote_filter *f, int pid)
+{
+	int i;
+
+	for(i = 0; i < f->pid_count; i++) {
+		if ((f->pids[i] == pid) || (f->pids[i] == REMOTE_ALL_PIDS))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Hand one packet to the filters which want it. Called with the lock held.
+ */
+static void remote_packet(struct remote_demux *demux, const uint8_t *pkt)
+{
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	int i;
+	int j;
+
+	if ((pkt[0] != 0x47) || (pkt[1] & 0x80))
+		return;
+	if (!demux->pid_refs[pid] && !demux->pid_refs[REMOTE_ALL_PIDS])
+		return;
+
+	for(i = 0; i < REMOTE_MAX_FILTERS; i++) {
+		struct remote_filter *f = remote_filters[i];
+
+		if ((f == NULL) || (f->demux != demux) || !f->started)
+			continue;
+
+		switch(f->type) {
+		case REMOTE_FILTER_SECTION:
+			if (f->sct.pid == pid)
+				remote_section_packet(f, pkt);
+			break;
+
+		case REMOTE_FILTER_PES:
+			if (!remote_pes_wants(f, pid))
+				break;
+			if (f->pes.output == DMX_OUT_TS_TAP) {
+				for(j = 0; j < REMOTE_MAX_FILTERS; j++) {
+					struct remote_filter *dvr = remote_filters[j];
+
+					if (dvr && (dvr->demux == demux) && (dvr->type == REMOTE_FILTER_DVR))
+						remote_out(dvr, pkt, 188);
+				}
+			} else if (f->pes.output == DMX_OUT_TSDEMUX_TAP) {
+				remote_out(f, pkt, 188);
+			} else if (pkt[3] & 0x10) {
+				const uint8_t *payload = pkt + 4 + ((pkt[3] & 0x20) ? 1 + pkt[4] : 0);
+
+				if (payload < pkt + 188)
+					remote_out(f, payload, pkt + 188 - payload);
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+static void remote_datagram(struct remote_demux *demux, uint8_t *buf, int len)
+{
+	int i;
+
+	// an RTP header (RFC 3550) first, unless it starts with a packet
+	if ((len >= 12) && (buf[0] != 0x47) && ((buf[0] & 0xc0) == 0x80)) {
+		int skip = 12 + ((buf[0] & 0x0f) * 4);
+
+		if ((buf[0] & 0x10) && (len >= skip + 4))
+			skip += 4 + (((buf[skip + 2] << 8) | buf[skip + 3]) * 4);
+		if (skip > len)
+			return;
+		buf += skip;
+		len -= skip;
+	}
+
+	pthread_mutex_lock(&remote_lock);
+	for(i = 0; (i + 188) <= len; i += 188)
+		remote_packet(demux, buf + i);
+	for(i = 0; i < REMOTE_MAX_FILTERS; i++) {
+		if (remote_filters[i] && (remote_filters[i]->demux == demux))
+			remote_flush(remote_filters[i]);
+	}
+	pthread_mutex_unlock(&remote_lock);
+}
+
+static void remote_demux_shutdown(struct remote_demux *demux)
+{
+	int i;
+
+	// the callers' reads see the end of their files
+	for(i = 0; i < REMOTE_MAX_FILTERS; i++) {
+		struct remote_filter *f = remote_filters[i];
+
+		if (f && (f->demux == demux)) {
+			shutdown(f->peer, SHUT_WR);
+			f->started = 0;
+		}
+	}
+	close(demux->tcp);
+	close(demux->udp);
+	close(demux->wake[0]);
+	close(demux->wake[1]);
+	memset(demux->pid_refs, 0, sizeof(demux->pid_refs));
+	demux->running = 0;
+}
+
+static void *remote_demux_thread(void *arg)
+{
+	struct remote_demux *demux = arg;
+	struct pollfd pollfds[REMOTE_MAX_FILTERS + 3];
+	struct remote_filter *polled[REMOTE_MAX_FILTERS];
+	uint8_t buf[65536];
+	int count;
+	int i;
+
+	while(1) {
+		// the callers' ends closing is how filters go away
+		pthread_mutex_lock(&remote_lock);
+		pollfds[0].fd = demux->udp;
+		pollfds[0].events = POLLIN;
+		pollfds[1].fd = demux->tcp;
+		pollfds[1].events = POLLIN;
+		pollfds[2].fd = demux->wake[0];
+		pollfds[2].events = POLLIN;
+		for(i = 0, count = 0; i < REMOTE_MAX_FILTERS; i++) {
+			if (remote_filters[i] && (remote_filters[i]->demux == demux)) {
+				polled[count] = remote_filters[i];
+				pollfds[3 + count].fd = remote_filters[i]->peer;
+				pollfds[3 + count].events = 0;
+				count++;
+			}
+		}
+		pthread_mutex_unlock(&remote_lock);
+
+		if (poll(pollfds, 3 + count, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (pollfds[1].revents) {
+			// nothing is expected from the server: it went away
+			if (recv(demux->tcp, buf, sizeof(buf), MSG_DONTWAIT) <= 0)
+				break;
+		}
+		if (pollfds[2].revents) {
+			while(read(demux->wake[0], buf, sizeof(buf)) > 0);
+		}
+		if (pollfds[0].revents) {
+			int len;
+
+			while((len = recv(demux->udp, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+				remote_datagram(demux, buf, len);
+		}
+
+		pthread_mutex_lock(&remote_lock);
+		for(i = 0; i < count; i++) {
+			if (pollfds[3 + i].revents & (POLLHUP | POLLERR))
+				remote_filter_free(polled[i]);
+		}
+		pthread_mutex_unlock(&remote_lock);
+	}
+
+	pthread_mutex_lock(&remote_lock);
+	remote_demux_shutdown(demux);
+	pthread_mutex_unlock(&remote_lock);
+	return NULL;
+}
+
+/*
+ * The demux of an adapter, connected. Called with the lock held.
+ */
+static struct remote_demux *remote_demux_get(int adapter)
+{
+	struct dvbremote_address address;
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+	struct remote_demux *demux = NULL;
+	struct dvbremote_msg msg;
+	int size = REMOTE_UDP_BUFFER;
+	int i;
+
+	for(i = 0; i < REMOTE_MAX_ADAPTERS; i++) {
+		if (remote_demuxes[i].running && (remote_demuxes[i].adapter == adapter))
+			return &remote_demuxes[i];
+		if (!remote_demuxes[i].running && (demux == NULL))
+			demux = &remote_demuxes[i];
+	}
+	if (demux == NULL) {
+		errno = EMFILE;
+		return NULL;
+	}
+
+	memset(demux, 0, sizeof(struct remote_demux));
+	demux->adapter = adapter;
+	demux->udp = -1;
+	demux->wake[0] = demux->wake[1] = -1;
+	if ((demux->tcp = remote_connect(adapter, &address)) < 0)
+		return NULL;
+
+	// packets come to a port of our own, on the address the server sees
+	if (getsockname(demux->tcp, (struct sockaddr *) &addr, &addr_len) ||
+	    ((demux->udp = socket(addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0))
+		goto fail;
+	if (addr.ss_family == AF_INET6)
+		((struct sockaddr_in6 *) &addr)->sin6_port = 0;
+	else
+		((struct sockaddr_in *) &addr)->sin_port = 0;
+	setsockopt(demux->udp, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+	if (bind(demux->udp, (struct sockaddr *) &addr, addr_len) ||
+	    getsockname(demux->udp, (struct sockaddr *) &addr, &addr_len) ||
+	    pipe2(demux->wake, O_NONBLOCK | O_CLOEXEC))
+		goto fail;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = DVBREMOTE_MSG_OPEN_DEMUX;
+	msg.adapter = address.adapter;
+	msg.value = ntohs((addr.ss_family == AF_INET6) ?
+			  ((struct sockaddr_in6 *) &addr)->sin6_port :
+			  ((struct sockaddr_in *) &addr)->sin_port);
+	if (remote_send(demux->tcp, &msg, NULL) || remote_reply(demux->tcp, &msg, NULL, 0))
+		goto fail;
+	if (msg.value < 0) {
+		errno = -msg.value;
+		goto fail;
+	}
+
+	if ((errno = pthread_create(&demux->thread, NULL, remote_demux_thread, demux)) != 0)
+		goto fail;
+	pthread_detach(demux->thread);
+	demux->running = 1;
+	return demux;
+
+fail:
+	i = errno;
+	close(demux->tcp);
+	if (demux->udp != -1)
+		close(demux->udp);
+	if (demux->wake[0] != -1) {
+		close(demux->wake[0]);
+		close(demux->wake[1]);
+	}
+	errno = i;
+	return NULL;
+}
+
+static int remote_open(int adapter, int nonblocking, enum remote_filter_type type)
+{
+	struct remote_filter *f;
+	struct stat st;
+	int size = (type == REMOTE_FILTER_DVR) ? REMOTE_DVR_BUFFER : REMOTE_DEMUX_BUFFER;
+	int sv[2];
+	int slot;
+	int err;
+
+	if ((f = calloc(1, sizeof(struct remote_filter))) == NULL) {
+		errno = ENOMEM;
+		return -1;
+	}
+	f->type = type;
+	f->section_len = -1;
+	f->cc = -1;
+
+	// reads on a SOCK_SEQPACKET socket keep to what each write sent
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv)) {
+		free(f);
+		return -1;
+	}
+	f->fd = sv[0];
+	f->peer = sv[1];
+	fcntl(f->peer, F_SETFL, O_NONBLOCK);
+	if (nonblocking)
+		fcntl(f->fd, F_SETFL, O_NONBLOCK);
+	setsockopt(f->peer, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+	fstat(f->fd, &st);
+	f->dev = st.st_dev;
+	f->ino = st.st_ino;
+
+	pthread_mutex_lock(&remote_lock);
+	for(slot = 0; (slot < REMOTE_MAX_FILTERS) && remote_filters[slot]; slot++);
+	if (slot == REMOTE_MAX_FILTERS) {
+		err = EMFILE;
+		goto fail;
+	}
+	if ((f->demux = remote_demux_get(adapter)) == NULL) {
+		err = errno;
+		goto fail;
+	}
+	remote_filters[slot] = f;
+	__atomic_fetch_add(&remote_filter_count, 1, __ATOMIC_RELAXED);
+	remote_wake(f->demux);
+	pthread_mutex_unlock(&remote_lock);
+
+	return f->fd;
+
+fail:
+	pthread_mutex_unlock(&remote_lock);
+	close(sv[0]);
+	close(sv[1]);
+	free(f);
+	errno = err;
+	return -1;
+}
+
+int dvbremote_open_demux(int adapter, int nonblocking)
+{
+	return remote_open(adapter, nonblocking, REMOTE_FILTER_UNSET);
+}
+
+int dvbremote_open_dvr(int adapter, int nonblocking)
+{
+	return remote_open(adapter, nonblocking, REMOTE_FILTER_DVR);
+}
+
+static int remote_filter_ioctl(struct remote_filter *f, unsigned long request, void *arg)
+{
+	struct dmx_pes_filter_params *pes;
+	int size;
+	int pid;
+	int i;
+
+	if (!f->demux->running)
+		return -EIO;
+
+	switch(request) {
+	case DMX_SET_FILTER:
+		if (f->type == REMOTE_FILTER_DVR)
+			return -EINVAL;
+		remote_filter_stop(f);
+		memcpy(&f->sct, arg, sizeof(f->sct));
+		f->sct.pid &= 0x1fff;
+		f->type = REMOTE_FILTER_SECTION;
+		f->pids[0] = f->sct.pid;
+		f->pid_count = 1;
+		if (f->sct.flags & DMX_IMMEDIATE_START)
+			remote_filter_start(f);
+		return 0;
+
+	case DMX_SET_PES_FILTER:
+		pes = arg;
+		if ((f->type == REMOTE_FILTER_DVR) || (pes->input != DMX_IN_FRONTEND) ||
+		    (pes->output == DMX_OUT_DECODER) || (pes->pid > REMOTE_ALL_PIDS))
+			return -EINVAL;
+		remote_filter_stop(f);
+		memcpy(&f->pes, pes, sizeof(f->pes));
+		f->type = REMOTE_FILTER_PES;
+		f->pids[0] = pes->pid;
+		f->pid_count = 1;
+		if (pes->flags & DMX_IMMEDIATE_START)
+			remote_filter_start(f);
+		return 0;
+
+	case DMX_START:
+		if ((f->type != REMOTE_FILTER_SECTION) && (f->type != REMOTE_FILTER_PES))
+			return -EINVAL;
+		remote_filter_start(f);
+		return 0;
+
+	case DMX_STOP:
+		remote_filter_stop(f);
+		return 0;
+
+	case DMX_SET_BUFFER_SIZE:
+		size = (long) arg;
+		setsockopt(f->peer, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+		return 0;
+
+	case DMX_ADD_PID:
+	case DMX_REMOVE_PID:
+		pid = *(uint16_t *) arg;
+		if ((f->type != REMOTE_FILTER_PES) || (pid > 0x1fff))
+			return -EINVAL;
+		for(i = 0; (i < f->pid_count) && (f->pids[i] != pid); i++);
+		if (request == DMX_ADD_PID) {
+			if (i < f->pid_count)
+				return 0;
+			if (f->pid_count == REMOTE_MAX_PIDS)
+				return -ENOSPC;
+			f->pids[f->pid_count++] = pid;
+			if (f->started)
+				remote_pid_ref(f->demux, pid, 1);
+		} else {
+			if (i == f->pid_count)
+				return -EINVAL;
+			f->pids[i] = f->pids[--f->pid_count];
+			if (f->started)
+				remote_pid_ref(f->demux, pid, -1);
+		}
+		return 0;
+	}
+
+	return -ENOTTY;
+}
+
+int dvbremote_demux_ioctl(int fd, unsigned long request, void *arg, int *result)
+{
+	struct remote_filter *f = NULL;
+	struct stat st;
+	int ret;
+	int i;
+
+	if (__atomic_load_n(&remote_filter_count, __ATOMIC_RELAXED) == 0)
+		return 0;
+	if (fstat(fd, &st) || !S_ISSOCK(st.st_mode))
+		return 0;
+
+	pthread_mutex_lock(&remote_lock);
+	for(i = 0; i < REMOTE_MAX_FILTERS; i++) {
+		f = remote_filters[i];
+		if (f && (f->fd == fd) && (f->dev == st.st_dev) && (f->ino == st.st_ino))
+			break;
+	}
+	if (i == REMOTE_MAX_FILTERS) {
+		pthread_mutex_unlock(&remote_lock);
+		return 0;
+	}
+	ret = remote_filter_ioctl(f, request, arg);
+	pthread_mutex_unlock(&remote_lock);
+
+	*result = 0;
+	if (ret < 0) {
+		errno = -ret;
+		*result = -1;
+	}
+	return 1;
+}
@@ -0,0 +1,153 @@
+/*
+ * libdvbremote - adapters on another host
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBREMOTE_H
+#define LIBDVBREMOTE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * An adapter number can stand for an adapter served by dvbremoted on another
+ * host. DVBREMOTE_CONFIG_FILE (or the file named by DVB_REMOTE_CONFIG in the
+ * environment) has lines of
+ *
+ *   <adapter> <host>[:<port>] [<remote adapter>]
+ *
+ * and dvbfe_open(), dvbdemux_open_demux() and dvbdemux_open_dvr() on such an
+ * adapter connect to the server instead of opening /dev/dvb nodes.
+ *
+ * Frontend ioctls are forwarded over a TCP connection, whose socket stands
+ * in for the frontend FD (it becomes readable when the remote frontend has
+ * an event). The demux runs here: the server sends the packets of the PIDs
+ * the filters need over UDP (RTP if it was started with -r), and a thread
+ * demultiplexes them into sockets which stand in for the demux and DVR FDs,
+ * a section or a run of packets per read. A remote adapter has one demux.
+ *
+ * Programs using the libdvbapi calls therefore work unchanged; programs
+ * issuing their own ioctls on the FDs do not. The ioctl arguments travel as
+ * they are, so client and server must share an ABI (the same architecture).
+ */
+
+#define DVBREMOTE_CONFIG_FILE	"/etc/dvb/remote.conf"
+#define DVBREMOTE_DEFAULT_PORT	5510
+
+/**
+ * Where a remote adapter is.
+ */
+struct dvbremote_address {
+	char host[256];
+	int port;
+	int adapter;		/* adapter number on the server */
+};
+
+/**
+ * Look an adapter up in the configuration. It is read once, and again only
+ * when stat() shows the file changed, so this is cheap on every open.
+ *
+ * @param adapter Local adapter number.
+ * @param address Where to put its address, may be NULL.
+ * @return 1 if the adapter is remote, 0 if not.
+ */
+extern int dvbremote_lookup(int adapter, struct dvbremote_address *address);
+
+/**
+ * Connect to the frontend of a remote adapter.
+ *
+ * @param adapter Local adapter number.
+ * @param frontend Frontend number.
+ * @param readonly If 1, the frontend is opened read only on the server.
+ * @return Connected socket to use as the frontend FD, or -1 on failure
+ * (errno is set).
+ */
+extern int dvbremote_open_frontend(int adapter, int frontend, int readonly);
+
+/**
+ * Forward an ioctl on a frontend socket from dvbremote_open_frontend().
+ *
+ * @return As for ioctl().
+ */
+extern int dvbremote_frontend_ioctl(int fd, unsigned long request, void *arg);
+
+/**
+ * Open the demux of a remote adapter.
+ *
+ * @param adapter Local adapter number.
+ * @param nonblocking If 1, the FD is non blocking.
+ * @return FD, or -1 on failure (errno is set).
+ */
+extern int dvbremote_open_demux(int adapter, int nonblocking);
+
+/**
+ * Open the DVR of a remote adapter. Only reading is supported.
+ *
+ * @param adapter Local adapter number.
+ * @param nonblocking If 1, the FD is non blocking.
+ * @return FD, or -1 on failure (errno is set).
+ */
+extern int dvbremote_open_dvr(int adapter, int nonblocking);
+
+/**
+ * Run a demux ioctl on an FD if it is a remote demux FD.
+ *
+ * @param fd The FD.
+ * @param request The ioctl.
+ * @param arg Its argument.
+ * @param result Where to put what the ioctl returned.
+ * @return 1 if the FD is a remote demux FD, 0 if not.
+ */
+extern int dvbremote_demux_ioctl(int fd, unsigned long request, void *arg, int *result);
+
+/*
+ * The protocol. Each message is a struct dvbremote_msg followed by length
+ * bytes of payload, in host byte order. The client opens a connection with
+ * DVBREMOTE_MSG_OPEN_FRONTEND or DVBREMOTE_MSG_OPEN_DEMUX; the server
+ * replies to each request with DVBREMOTE_MSG_REPLY, except to the PID
+ * changes, and sends DVBREMOTE_MSG_EVENT on a frontend connection when the
+ * frontend has an event to read.
+ */
+#define DVBREMOTE_MSG_OPEN_FRONTEND	1	/* value: frontend, request: readonly */
+#define DVBREMOTE_MSG_OPEN_DEMUX	2	/* value: UDP port, payload: none */
+#define DVBREMOTE_MSG_IOCTL		3	/* request, value or payload: the argument */
+#define DVBREMOTE_MSG_ADD_PID		4	/* value: PID, 0x2000 for all */
+#define DVBREMOTE_MSG_REMOVE_PID	5	/* value: PID */
+#define DVBREMOTE_MSG_REPLY		6	/* value: result or -errno, payload: the argument */
+#define DVBREMOTE_MSG_EVENT		7
+
+#define DVBREMOTE_MAX_PAYLOAD		8192
+
+struct dvbremote_msg {
+	uint32_t type;
+	uint32_t request;
+	int32_t value;
+	int32_t adapter;	/* server side adapter, in the open messages */
+	uint32_t length;
+	uint32_t reserved;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
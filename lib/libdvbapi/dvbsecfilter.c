@@ -0,0 +1,527 @@
+/*
+ * libdvbsecfilter - section filter planner for the DVB demux
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <linux/dvb/dmx.h>
+#include "dvbdemux.h"
+#include "dvbsecfilter.h"
+
+#define MAX_SECTION_SIZE 4096
+
+/*
+ * While planning, the table_id and table_id_extension of a want are one
+ * 24 bit key: table_id in bits 16-23, the extension below it.
+ */
+#define KEY_TABLE_ID	0xff0000
+#define KEY_EXT		0x00ffff
+
+struct want {
+	int in_use;
+	int pid;
+	int table_id;
+	int table_id_ext;
+	int version;
+	dvbsecfilter_callback callback;
+	void *arg;
+	int item;		/* while planning */
+};
+
+struct item {
+	int pid;
+	uint32_t value;
+	uint32_t mask;
+	int wants;
+};
+
+struct kfilter {
+	struct dvbsecfilter_kfilter k;
+	int fd;
+	int set;		/* fd is filtering for k */
+	int *want_ids;
+};
+
+struct dvbsecfilter {
+	int adapter;
+	int demuxdevice;
+	int max_filters;
+	int dirty;
+
+	struct want *wants;
+	int want_count;
+	int want_max;
+
+	struct kfilter *kfilters;
+	int kfilter_count;
+
+	uint8_t buf[MAX_SECTION_SIZE];
+};
+
+static int bits(uint32_t v)
+{
+	return __builtin_popcount(v);
+}
+
+static int want_matches(struct want *w, int pid, uint8_t *section, int len)
+{
+	if (!w->in_use || (w->pid != pid) || (len < 3))
+		return 0;
+	if ((w->table_id >= 0) && (section[0] != w->table_id))
+		return 0;
+	if ((w->table_id_ext >= 0) &&
+	    ((len < 5) || (((section[3] << 8) | section[4]) != w->table_id_ext)))
+		return 0;
+	if ((w->version >= 0) &&
+	    ((len < 6) || (((section[5] >> 1) & 0x1f) == w->version)))
+		return 0;
+	return 1;
+}
+
+/* fold item j into item i, keeping i's value and mask, then drop j */
+static void fold_item(struct dvbsecfilter *sf, struct item *items, int *count, int i, int j)
+{
+	int last = *count - 1;
+	int w;
+
+	for (w = 0; w < sf->want_count; w++) {
+		if (sf->wants[w].item == j)
+			sf->wants[w].item = i;
+		else if (sf->wants[w].item == last)
+			sf->wants[w].item = j;
+	}
+	items[i].wants += items[j].wants;
+	items[j] = items[last];
+	(*count)--;
+}
+
+/* merges which let no extra sections through */
+static void merge_free(struct dvbsecfilter *sf, struct item *items, int *count)
+{
+	int merged = 1;
+	int i, j;
+
+	while (merged) {
+		merged = 0;
+		for (i = 0; i < *count; i++) {
+			for (j = 0; j < *count; j++) {
+				uint32_t diff;
+
+				if ((i == j) || (items[i].pid != items[j].pid))
+					continue;
+
+				// j is covered by i
+				if (((items[i].mask & items[j].mask) == items[i].mask) &&
+				    ((items[j].value & items[i].mask) == items[i].value)) {
+					fold_item(sf, items, count, i, j);
+					merged = 1;
+					break;
+				}
+
+				// i and j differ in a single bit
+				diff = items[i].value ^ items[j].value;
+				if ((items[i].mask == items[j].mask) && (bits(diff) == 1)) {
+					items[i].mask &= ~diff;
+					items[i].value &= items[i].mask;
+					fold_item(sf, items, count, i, j);
+					merged = 1;
+					break;
+				}
+			}
+			if (merged)
+				break;
+		}
+	}
+}
+
+/* the merge on one PID leaving the most specific filter, or -1 */
+static int merge_cheapest(struct dvbsecfilter *sf, struct item *items, int *count)
+{
+	int best_i = -1, best_j = -1, best = -1;
+	int i, j;
+
+	for (i = 0; i < *count; i++) {
+		for (j = i + 1; j < *count; j++) {
+			uint32_t mask;
+
+			if (items[i].pid != items[j].pid)
+				continue;
+			mask = items[i].mask & items[j].mask & ~(items[i].value ^ items[j].value);
+			if (bits(mask) > best) {
+				best = bits(mask);
+				best_i = i;
+				best_j = j;
+			}
+		}
+	}
+	if (best < 0)
+		return -1;
+
+	items[best_i].mask &= items[best_j].mask & ~(items[best_i].value ^ items[best_j].value);
+	items[best_i].value &= items[best_i].mask;
+	fold_item(sf, items, count, best_i, best_j);
+	return 0;
+}
+
+static void free_kfilters(struct kfilter *kfilters, int count, int close_fds)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (close_fds && (kfilters[i].fd >= 0))
+			close(kfilters[i].fd);
+		free(kfilters[i].want_ids);
+	}
+	free(kfilters);
+}
+
+struct dvbsecfilter *dvbsecfilter_create(int adapter, int demuxdevice, int max_filters)
+{
+	struct dvbsecfilter *sf;
+
+	if (max_filters < 1) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((sf = calloc(1, sizeof(struct dvbsecfilter))) == NULL)
+		return NULL;
+	sf->adapter = adapter;
+	sf->demuxdevice = demuxdevice;
+	sf->max_filters = max_filters;
+	return sf;
+}
+
+void dvbsecfilter_destroy(struct dvbsecfilter *sf)
+{
+	free_kfilters(sf->kfilters, sf->kfilter_count, 1);
+	free(sf->wants);
+	free(sf);
+}
+
+int dvbsecfilter_add(struct dvbsecfilter *sf, int pid, int table_id, int table_id_ext,
+		     int version, dvbsecfilter_callback callback, void *arg)
+{
+	struct want *w;
+	int id;
+
+	if ((pid < 0) || (pid > 0x1fff) || (table_id > 0xff) || (table_id_ext > 0xffff) ||
+	    (version > 0x1f) || (callback == NULL)) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	for (id = 0; id < sf->want_count; id++) {
+		if (!sf->wants[id].in_use)
+			break;
+	}
+	if (id == sf->want_count) {
+		if (sf->want_count == sf->want_max) {
+			int max = sf->want_max ? sf->want_max * 2 : 32;
+			struct want *wants = realloc(sf->wants, max * sizeof(struct want));
+
+			if (wants == NULL)
+				return -1;
+			sf->wants = wants;
+			sf->want_max = max;
+		}
+		sf->want_count++;
+	}
+
+	w = &sf->wants[id];
+	w->in_use = 1;
+	w->pid = pid;
+	w->table_id = (table_id < 0) ? -1 : table_id;
+	w->table_id_ext = (table_id_ext < 0) ? -1 : table_id_ext;
+	w->version = (version < 0) ? -1 : version;
+	w->callback = callback;
+	w->arg = arg;
+	sf->dirty = 1;
+	return id;
+}
+
+int dvbsecfilter_remove(struct dvbsecfilter *sf, int id)
+{
+	if ((id < 0) || (id >= sf->want_count) || !sf->wants[id].in_use) {
+		errno = EINVAL;
+		return -1;
+	}
+	sf->wants[id].in_use = 0;
+	sf->dirty = 1;
+	return 0;
+}
+
+int dvbsecfilter_set_version(struct dvbsecfilter *sf, int id, int version)
+{
+	if ((id < 0) || (id >= sf->want_count) || !sf->wants[id].in_use || (version > 0x1f)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (version < 0)
+		version = -1;
+	if (sf->wants[id].version != version) {
+		sf->wants[id].version = version;
+		sf->dirty = 1;
+	}
+	return 0;
+}
+
+int dvbsecfilter_plan(struct dvbsecfilter *sf)
+{
+	struct kfilter *kfilters;
+	struct item *items;
+	int count = 0;
+	int i, w;
+
+	if ((items = malloc((sf->want_count + 1) * sizeof(struct item))) == NULL)
+		return -1;
+
+	// one item per distinct want
+	for (w = 0; w < sf->want_count; w++) {
+		struct want *want = &sf->wants[w];
+		uint32_t value = 0, mask = 0;
+
+		want->item = -1;
+		if (!want->in_use)
+			continue;
+
+		if (want->table_id >= 0) {
+			value |= want->table_id << 16;
+			mask |= KEY_TABLE_ID;
+		}
+		if (want->table_id_ext >= 0) {
+			value |= want->table_id_ext;
+			mask |= KEY_EXT;
+		}
+		for (i = 0; i < count; i++) {
+			if ((items[i].pid == want->pid) && (items[i].value == value) &&
+			    (items[i].mask == mask))
+				break;
+		}
+		if (i == count) {
+			items[count].pid = want->pid;
+			items[count].value = value;
+			items[count].mask = mask;
+			items[count].wants = 0;
+			count++;
+		}
+		items[i].wants++;
+		want->item = i;
+	}
+
+	merge_free(sf, items, &count);
+	while (count > sf->max_filters) {
+		if (merge_cheapest(sf, items, &count)) {
+			free(items);
+			errno = ENOSPC;
+			return -1;
+		}
+		merge_free(sf, items, &count);
+	}
+
+	if ((kfilters = calloc(count + 1, sizeof(struct kfilter))) == NULL) {
+		free(items);
+		return -1;
+	}
+	for (i = 0; i < count; i++) {
+		struct dvbsecfilter_kfilter *k = &kfilters[i].k;
+
+		kfilters[i].fd = -1;
+		if ((kfilters[i].want_ids = malloc(items[i].wants * sizeof(int))) == NULL) {
+			free_kfilters(kfilters, count, 0);
+			free(items);
+			return -1;
+		}
+		k->pid = items[i].pid;
+		k->filter[0] = items[i].value >> 16;
+		k->mask[0] = items[i].mask >> 16;
+		k->filter[1] = items[i].value >> 8;
+		k->mask[1] = items[i].mask >> 8;
+		k->filter[2] = items[i].value;
+		k->mask[2] = items[i].mask;
+	}
+	for (w = 0; w < sf->want_count; w++) {
+		struct want *want = &sf->wants[w];
+		struct kfilter *kf;
+
+		if (want->item < 0)
+			continue;
+		kf = &kfilters[want->item];
+		kf->want_ids[kf->k.wants++] = w;
+
+		// the kernel skips the version itself when nothing else shares the filter
+		if ((items[want->item].wants == 1) && (want->version >= 0)) {
+			kf->k.filter[3] = want->version << 1;
+			kf->k.mask[3] = 0x3e;
+			kf->k.mode[3] = 0x3e;
+		}
+	}
+	free(items);
+
+	/*
+	 * Filters left unchanged keep their fds and go on running. Any other
+	 * fds of the old plan are reset for the new filters, or closed.
+	 */
+	if (sf->kfilters) {
+		struct kfilter *old = sf->kfilters;
+		int old_count = sf->kfilter_count;
+		int j;
+
+		for (i = 0; i < count; i++) {
+			for (j = 0; j < old_count; j++) {
+				if ((old[j].fd >= 0) && old[j].set &&
+				    (old[j].k.pid == kfilters[i].k.pid) &&
+				    !memcmp(old[j].k.filter, kfilters[i].k.filter, 16) &&
+				    !memcmp(old[j].k.mask, kfilters[i].k.mask, 16) &&
+				    !memcmp(old[j].k.mode, kfilters[i].k.mode, 16)) {
+					kfilters[i].fd = old[j].fd;
+					kfilters[i].set = 1;
+					old[j].fd = -1;
+					break;
+				}
+			}
+		}
+		for (j = 0; j < old_count; j++) {
+			if (old[j].fd < 0)
+				continue;
+			for (i = 0; i < count; i++) {
+				if (kfilters[i].fd < 0) {
+					kfilters[i].fd = old[j].fd;
+					break;
+				}
+			}
+			if (i == count)
+				close(old[j].fd);
+		}
+		free_kfilters(old, old_count, 0);
+	}
+
+	sf->kfilters = kfilters;
+	sf->kfilter_count = count;
+	sf->dirty = 0;
+	return count;
+}
+
+int dvbsecfilter_get_kfilter(struct dvbsecfilter *sf, int index,
+			     struct dvbsecfilter_kfilter *kfilter)
+{
+	if ((index < 0) || (index >= sf->kfilter_count))
+		return -1;
+
+	*kfilter = sf->kfilters[index].k;
+	return 0;
+}
+
+int dvbsecfilter_commit(struct dvbsecfilter *sf)
+{
+	struct dmx_sct_filter_params params;
+	int i;
+
+	if (sf->adapter < 0) {
+		errno = ENODEV;
+		return -1;
+	}
+	if ((sf->dirty || (sf->kfilters == NULL)) && (dvbsecfilter_plan(sf) < 0))
+		return -1;
+
+	for (i = 0; i < sf->kfilter_count; i++) {
+		struct kfilter *kf = &sf->kfilters[i];
+
+		if (kf->set)
+			continue;
+		if ((kf->fd < 0) &&
+		    ((kf->fd = dvbdemux_open_demux(sf->adapter, sf->demuxdevice, 1)) < 0))
+			return -1;
+
+		memset(&params, 0, sizeof(params));
+		params.pid = kf->k.pid;
+		memcpy(params.filter.filter, kf->k.filter, DMX_FILTER_SIZE);
+		memcpy(params.filter.mask, kf->k.mask, DMX_FILTER_SIZE);
+		memcpy(params.filter.mode, kf->k.mode, DMX_FILTER_SIZE);
+		params.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
+		if (ioctl(kf->fd, DMX_SET_FILTER, &params))
+			return -1;
+		kf->set = 1;
+	}
+	return sf->kfilter_count;
+}
+
+int dvbsecfilter_get_pollfds(struct dvbsecfilter *sf, struct pollfd *pollfds, int max)
+{
+	int count = 0;
+	int i;
+
+	for (i = 0; (i < sf->kfilter_count) && (count < max); i++) {
+		if (sf->kfilters[i].fd < 0)
+			continue;
+		pollfds[count].fd = sf->kfilters[i].fd;
+		pollfds[count].events = POLLIN;
+		pollfds[count].revents = 0;
+		count++;
+	}
+	return count;
+}
+
+int dvbsecfilter_process(struct dvbsecfilter *sf, int fd)
+{
+	struct kfilter *kf = NULL;
+	int matched = 0;
+	int len, i;
+
+	for (i = 0; i < sf->kfilter_count; i++) {
+		if (sf->kfilters[i].fd == fd) {
+			kf = &sf->kfilters[i];
+			break;
+		}
+	}
+	if (kf == NULL) {
+		errno = EBADF;
+		return -1;
+	}
+
+	if ((len = read(fd, sf->buf, sizeof(sf->buf))) < 0)
+		return -1;
+
+	// only the wants the filter was planned for can match
+	for (i = 0; i < kf->k.wants; i++) {
+		int id = kf->want_ids[i];
+
+		if (want_matches(&sf->wants[id], kf->k.pid, sf->buf, len)) {
+			sf->wants[id].callback(sf->wants[id].arg, id, sf->buf, len);
+			matched++;
+		}
+	}
+	return matched;
+}
+
+int dvbsecfilter_dispatch(struct dvbsecfilter *sf, int pid, uint8_t *section, int len)
+{
+	int matched = 0;
+	int id;
+
+	for (id = 0; id < sf->want_count; id++) {
+		if (want_matches(&sf->wants[id], pid, section, len)) {
+			sf->wants[id].callback(sf->wants[id].arg, id, section, len);
+			matched++;
+		}
+	}
+	return matched;
+}
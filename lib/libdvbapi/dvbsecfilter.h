@@ -0,0 +1,199 @@
+/*
+ * libdvbsecfilter - section filter planner for the DVB demux
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBSECFILTER_H
+#define LIBDVBSECFILTER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <poll.h>
+
+/**
+ * A section filter planner: the sections wanted from a mux are described as
+ * (pid, table_id, table_id_ext, version) tuples, and the planner works out a
+ * small set of kernel section filters which together pass all of them, then
+ * hands each section read to the wants it matches.
+ *
+ * Each kernel filter needs a demux fd of its own, and the demux has only so
+ * many. Wants on the same PID whose filter values differ in one bit are
+ * merged for free (0x4e and 0x4f into 0x4e/0xfe, say), as is a want already
+ * covered by a broader one. If that still leaves more filters than allowed,
+ * the pairs on one PID whose merge lets the fewest extra sections through
+ * are merged until it fits, and userspace drops what was not wanted.
+ *
+ * A version of -1 matches any version; otherwise only sections whose
+ * version_number differs from it, which is how a table is watched for
+ * changes. A kernel filter serving a single want does the version test
+ * itself, so an unchanged table causes no wakeups at all.
+ *
+ * A planner is not thread safe.
+ */
+struct dvbsecfilter;
+
+/**
+ * Called for each section which matches a want.
+ *
+ * @param arg The argument given to dvbsecfilter_add().
+ * @param id The id of the want.
+ * @param section The section, starting at table_id.
+ * @param len Its length.
+ */
+typedef void (*dvbsecfilter_callback)(void *arg, int id, uint8_t *section, int len);
+
+/**
+ * One kernel filter of a plan.
+ */
+struct dvbsecfilter_kfilter {
+	int pid;
+	uint8_t filter[16];	/* as in struct dmx_filter: byte 0 is table_id, */
+	uint8_t mask[16];	/* then from byte 3 of the section onwards */
+	uint8_t mode[16];
+	int wants;		/* number of wants it serves */
+};
+
+/**
+ * Create a planner.
+ *
+ * @param adapter Index of the DVB adapter, or -1 for one which only plans
+ * (dvbsecfilter_commit() is then not available).
+ * @param demuxdevice Index of the demux device on that adapter.
+ * @param max_filters Most kernel filters (and so demux fds) to use.
+ * @return The planner, or NULL with errno set on failure.
+ */
+extern struct dvbsecfilter *dvbsecfilter_create(int adapter, int demuxdevice, int max_filters);
+
+/**
+ * Destroy a planner, closing its demux fds.
+ *
+ * @param sf The planner.
+ */
+extern void dvbsecfilter_destroy(struct dvbsecfilter *sf);
+
+/**
+ * Add a want. It takes effect at the next dvbsecfilter_commit().
+ *
+ * @param sf The planner.
+ * @param pid PID the sections are on.
+ * @param table_id Their table_id, or -1 for any.
+ * @param table_id_ext Their table_id_extension, or -1 for any.
+ * @param version Version to skip, or -1 for any version.
+ * @param callback Called for each matching section.
+ * @param arg Argument for callback.
+ * @return The id of the want (from 0), or -1 with errno set on failure.
+ */
+extern int dvbsecfilter_add(struct dvbsecfilter *sf, int pid, int table_id, int table_id_ext,
+			    int version, dvbsecfilter_callback callback, void *arg);
+
+/**
+ * Remove a want. It takes effect at the next dvbsecfilter_commit(), though
+ * its callback is not called again from now on.
+ *
+ * @param sf The planner.
+ * @param id The id of the want.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+extern int dvbsecfilter_remove(struct dvbsecfilter *sf, int id);
+
+/**
+ * Change the version a want skips, typically to the version just received.
+ * Userspace matching changes at once; a kernel filter testing the version is
+ * updated by the next dvbsecfilter_commit().
+ *
+ * @param sf The planner.
+ * @param id The id of the want.
+ * @param version Version to skip, or -1 for any version.
+ * @return 0 on success, or -1 with errno set on failure.
+ */
+extern int dvbsecfilter_set_version(struct dvbsecfilter *sf, int id, int version);
+
+/**
+ * Work out the kernel filters for the current wants. dvbsecfilter_commit()
+ * does this itself; it is only needed to look at a plan.
+ *
+ * @param sf The planner.
+ * @return The number of kernel filters, or -1 with errno set to ENOSPC if the
+ * wants are on more PIDs than there are filters.
+ */
+extern int dvbsecfilter_plan(struct dvbsecfilter *sf);
+
+/**
+ * Retrieve a kernel filter of the last plan.
+ *
+ * @param sf The planner.
+ * @param index The filter, from 0.
+ * @param kfilter Where to put it.
+ * @return 0 on success, or -1 if there is no such filter.
+ */
+extern int dvbsecfilter_get_kfilter(struct dvbsecfilter *sf, int index,
+				    struct dvbsecfilter_kfilter *kfilter);
+
+/**
+ * Plan the kernel filters if the wants have changed, and set them up on the
+ * demux. Filters which are unchanged are left running, so no sections are
+ * lost on them.
+ *
+ * @param sf The planner.
+ * @return The number of kernel filters, or -1 with errno set on failure.
+ */
+extern int dvbsecfilter_commit(struct dvbsecfilter *sf);
+
+/**
+ * Fill in pollfds for the demux fds, for POLLIN.
+ *
+ * @param sf The planner.
+ * @param pollfds Where to put them.
+ * @param max Size of pollfds.
+ * @return The number filled in.
+ */
+extern int dvbsecfilter_get_pollfds(struct dvbsecfilter *sf, struct pollfd *pollfds, int max);
+
+/**
+ * Read one section from a demux fd which is readable, and call the
+ * callbacks of the wants it matches.
+ *
+ * @param sf The planner.
+ * @param fd The demux fd, from dvbsecfilter_get_pollfds().
+ * @return The number of wants matched, or -1 with errno set on failure
+ * (EAGAIN if nothing was there, EOVERFLOW if the kernel buffer overflowed and
+ * sections were lost).
+ */
+extern int dvbsecfilter_process(struct dvbsecfilter *sf, int fd);
+
+/**
+ * Call the callbacks of the wants a section from some other source matches,
+ * e.g. one reassembled from a DVR stream.
+ *
+ * @param sf The planner.
+ * @param pid PID the section was on.
+ * @param section The section.
+ * @param len Its length.
+ * @return The number of wants matched.
+ */
+extern int dvbsecfilter_dispatch(struct dvbsecfilter *sf, int pid, uint8_t *section, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBDVBSECFILTER_H
@@ -0,0 +1,755 @@
+/*
+ * libdvbsistore - SI tables of an adapter shared between processes
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include "dvbsistore.h"
+
+#define DVBSISTORE_MAGIC	"DVBSISTO"
+#define DVBSISTORE_VERSION	1
+#define DVBSISTORE_MAX_CLIENTS	64
+
+// a reader copying while the publisher laps it gives up after this many tries
+#define DVBSISTORE_READ_TRIES	64
+
+/*
+ * Store layout, host byte order: a header, the slots, and the data ring.
+ * Positions in the ring only ever grow; a record's data is at its position
+ * modulo data_size, and never wraps round the end. A record of a table still
+ * current is moved to the head before the ring comes round onto it, which
+ * always ends as the current tables are kept to half the ring.
+ */
+struct dvbsistore_slot {
+	uint32_t seq;			/* odd => being changed */
+	uint16_t pid;
+	uint16_t table_id_ext;
+	uint8_t table_id;
+	uint8_t kind;
+	uint8_t version;
+	uint8_t used;
+	uint32_t raw_len;
+	uint32_t decoded_len;
+	uint64_t raw_pos;
+	uint64_t decoded_pos;
+	uint64_t serial;
+	uint64_t updated_ms;
+};
+
+struct dvbsistore_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_size;
+	uint32_t slot_count;
+	uint32_t data_size;
+	uint64_t data_offset;
+	uint64_t head;			/* claimed before it is written */
+	uint64_t serial;		/* of the last publication */
+};
+
+struct dvbsistore_client {
+	int sock;
+	int efd;			/* -1 => not subscribed yet */
+	uint32_t kinds;
+};
+
+struct dvbsistore {
+	struct dvbsistore_header *hdr;
+	struct dvbsistore_slot *slots;
+	uint8_t *data;
+	size_t map_size;
+	char path[64];
+
+	// publisher
+	char sock_path[108];
+	int listen_fd;
+	uint64_t live;			/* bytes of current records in the ring */
+	uint8_t *moving;		/* per slot, 1 << decoded of a record in transit */
+	struct dvbsistore_client clients[DVBSISTORE_MAX_CLIENTS];
+	int client_count;
+
+	// reader
+	int sock;
+	int efd;
+};
+
+static void dvbsistore_paths(struct dvbsistore *store, int adapter, int demux)
+{
+	snprintf(store->path, sizeof(store->path), DVBSISTORE_DIR "/dvbsi-%i.%i", adapter, demux);
+	snprintf(store->sock_path, sizeof(store->sock_path),
+		 DVBSISTORE_SOCKET_DIR "/dvbsi-%i.%i.sock", adapter, demux);
+}
+
+static int dvbsistore_listen(struct dvbsistore *store)
+{
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, store->sock_path);
+
+	// a stale socket from a publisher which didn't shut down cleanly
+	unlink(store->sock_path);
+
+	if ((store->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0)) < 0)
+		return -1;
+	if (bind(store->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(store->listen_fd, DVBSISTORE_MAX_CLIENTS)) {
+		close(store->listen_fd);
+		return -1;
+	}
+	// anyone may read the store, so anyone may subscribe
+	chmod(store->sock_path, 0666);
+	return 0;
+}
+
+struct dvbsistore *dvbsistore_create(int adapter, int demux, uint32_t slots, uint32_t data_size)
+{
+	struct dvbsistore *store;
+	uint64_t data_offset;
+	int fd;
+
+	if ((slots == 0) || (data_size < 4096)) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((store = calloc(1, sizeof(struct dvbsistore))) == NULL)
+		return NULL;
+	if ((store->moving = calloc(slots, 1)) == NULL) {
+		free(store);
+		return NULL;
+	}
+	store->sock = -1;
+	store->efd = -1;
+	dvbsistore_paths(store, adapter, demux);
+
+	data_offset = (sizeof(struct dvbsistore_header) +
+		       (slots * sizeof(struct dvbsistore_slot)) + 63) & ~63ULL;
+	data_size &= ~7U;
+	store->map_size = data_offset + data_size;
+
+	// an old store is left to whoever still has it mapped
+	unlink(store->path);
+	if ((fd = open(store->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644)) < 0)
+		goto fail;
+	if (ftruncate(fd, store->map_size)) {
+		close(fd);
+		goto fail_unlink;
+	}
+	store->hdr = mmap(NULL, store->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (store->hdr == MAP_FAILED)
+		goto fail_unlink;
+
+	store->slots = (struct dvbsistore_slot *) (store->hdr + 1);
+	store->data = (uint8_t *) store->hdr + data_offset;
+	store->hdr->version = DVBSISTORE_VERSION;
+	store->hdr->slot_size = sizeof(struct dvbsistore_slot);
+	store->hdr->slot_count = slots;
+	store->hdr->data_size = data_size;
+	store->hdr->data_offset = data_offset;
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	memcpy(store->hdr->magic, DVBSISTORE_MAGIC, sizeof(store->hdr->magic));
+
+	if (dvbsistore_listen(store)) {
+		munmap(store->hdr, store->map_size);
+		goto fail_unlink;
+	}
+	return store;
+
+fail_unlink:
+	unlink(store->path);
+fail:
+	free(store->moving);
+	free(store);
+	return NULL;
+}
+
+static uint64_t dvbsistore_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+#define DVBSISTORE_ALIGN(len) (((len) + 7) & ~7U)
+
+static uint64_t dvbsistore_put(struct dvbsistore *store, const void *buf, uint32_t len);
+
+/**
+ * Find the oldest record of a current table before a position.
+ *
+ * @return Its slot, with *decoded set if it is the decoded form, or NULL.
+ */
+static struct dvbsistore_slot *dvbsistore_oldest(struct dvbsistore *store, uint64_t before,
+						 int *decoded)
+{
+	struct dvbsistore_slot *oldest = NULL;
+	uint64_t oldest_pos = before;
+	uint32_t i;
+
+	for (i = 0; i < store->hdr->slot_count; i++) {
+		struct dvbsistore_slot *slot = &store->slots[i];
+
+		if (!slot->used)
+			continue;
+		if ((slot->raw_pos < oldest_pos) && !(store->moving[i] & 1)) {
+			oldest = slot;
+			oldest_pos = slot->raw_pos;
+			*decoded = 0;
+		}
+		if (slot->decoded_len && (slot->decoded_pos < oldest_pos) && !(store->moving[i] & 2)) {
+			oldest = slot;
+			oldest_pos = slot->decoded_pos;
+			*decoded = 1;
+		}
+	}
+	return oldest;
+}
+
+/**
+ * Move a record to the head of the ring.
+ *
+ * @return 0 on success, -1 if out of memory (the record is then lost).
+ */
+static int dvbsistore_move(struct dvbsistore *store, struct dvbsistore_slot *slot, int decoded)
+{
+	uint32_t len = decoded ? slot->decoded_len : slot->raw_len;
+	uint64_t pos = decoded ? slot->decoded_pos : slot->raw_pos;
+	int i = slot - store->slots;
+	uint8_t *tmp;
+
+	if ((tmp = malloc(len)) == NULL)
+		return -1;
+	memcpy(tmp, store->data + (pos % store->hdr->data_size), len);
+
+	// making room for it must not move it again
+	store->moving[i] |= 1 << decoded;
+	pos = dvbsistore_put(store, tmp, len);
+	store->moving[i] &= ~(1 << decoded);
+	free(tmp);
+
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (decoded)
+		slot->decoded_pos = pos;
+	else
+		slot->raw_pos = pos;
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/**
+ * Claim room in the ring and fill it.
+ *
+ * @return The position of the data.
+ */
+static uint64_t dvbsistore_put(struct dvbsistore *store, const void *buf, uint32_t len)
+{
+	struct dvbsistore_header *hdr = store->hdr;
+	struct dvbsistore_slot *slot;
+	uint64_t pos;
+	uint32_t off;
+	int decoded;
+
+	while (1) {
+		pos = hdr->head;
+		off = pos % hdr->data_size;
+
+		// records never wrap: what is left before the end is skipped
+		if (off + len > hdr->data_size)
+			pos += hdr->data_size - off;
+
+		// what is still current is moved out of the way first
+		if ((pos + DVBSISTORE_ALIGN(len) <= hdr->data_size) ||
+		    ((slot = dvbsistore_oldest(store, pos + DVBSISTORE_ALIGN(len) - hdr->data_size,
+					       &decoded)) == NULL) ||
+		    dvbsistore_move(store, slot, decoded))
+			break;
+	}
+
+	__atomic_store_n(&hdr->head, pos + DVBSISTORE_ALIGN(len), __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	memcpy(store->data + (pos % hdr->data_size), buf, len);
+	return pos;
+}
+
+static void dvbsistore_notify(struct dvbsistore *store, uint32_t kinds)
+{
+	int i;
+
+	for (i = 0; i < store->client_count; i++) {
+		if ((store->clients[i].efd != -1) && (store->clients[i].kinds & kinds))
+			eventfd_write(store->clients[i].efd, 1);
+	}
+}
+
+int dvbsistore_publish(struct dvbsistore *store, const struct dvbsistore_info *info,
+		       const void *raw, uint32_t raw_len,
+		       const void *decoded, uint32_t decoded_len)
+{
+	struct dvbsistore_header *hdr = store->hdr;
+	struct dvbsistore_slot *slot = NULL;
+	struct dvbsistore_slot *free_slot = NULL;
+	uint64_t raw_pos, decoded_pos = 0;
+	uint64_t old_len = 0;
+	uint64_t new_len;
+	uint32_t i;
+
+	if (decoded == NULL)
+		decoded_len = 0;
+	new_len = DVBSISTORE_ALIGN(raw_len) + DVBSISTORE_ALIGN(decoded_len);
+	if (new_len > (hdr->data_size / 4)) {
+		errno = ENOSPC;
+		return -1;
+	}
+	for (i = 0; i < hdr->slot_count; i++) {
+		struct dvbsistore_slot *s = &store->slots[i];
+
+		if (!s->used) {
+			if (free_slot == NULL)
+				free_slot = s;
+			continue;
+		}
+		if ((s->pid == info->pid) && (s->table_id == info->table_id) &&
+		    (s->table_id_ext == info->table_id_ext)) {
+			slot = s;
+			break;
+		}
+	}
+	if ((slot == NULL) && ((slot = free_slot) == NULL)) {
+		errno = ENOSPC;
+		return -1;
+	}
+	if (slot->used)
+		old_len = DVBSISTORE_ALIGN(slot->raw_len) + DVBSISTORE_ALIGN(slot->decoded_len);
+	if (store->live - old_len + new_len > (hdr->data_size / 2)) {
+		errno = ENOSPC;
+		return -1;
+	}
+
+	// the data first, so the slot only ever refers to what is complete
+	raw_pos = dvbsistore_put(store, raw, raw_len);
+	if (decoded)
+		decoded_pos = dvbsistore_put(store, decoded, decoded_len);
+
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	slot->pid = info->pid;
+	slot->table_id = info->table_id;
+	slot->table_id_ext = info->table_id_ext;
+	slot->kind = info->kind;
+	slot->version = info->version;
+	slot->raw_pos = raw_pos;
+	slot->raw_len = raw_len;
+	slot->decoded_pos = decoded_pos;
+	slot->decoded_len = decoded_len;
+	slot->updated_ms = dvbsistore_now_ms();
+	slot->serial = ++hdr->serial;
+	slot->used = 1;
+	__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	store->live += new_len - old_len;
+
+	dvbsistore_notify(store, DVBSISTORE_MASK(info->kind));
+	return 0;
+}
+
+void dvbsistore_reset(struct dvbsistore *store)
+{
+	uint32_t i;
+
+	for (i = 0; i < store->hdr->slot_count; i++) {
+		struct dvbsistore_slot *slot = &store->slots[i];
+
+		if (!slot->used)
+			continue;
+		__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		slot->used = 0;
+		__atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+	}
+	store->live = 0;
+	store->hdr->serial++;
+	dvbsistore_notify(store, DVBSISTORE_ALL);
+}
+
+int dvbsistore_get_pollfds(struct dvbsistore *store, struct pollfd *pollfds, int max)
+{
+	int count = 0;
+	int i;
+
+	if (max < 1)
+		return 0;
+	pollfds[count].fd = store->listen_fd;
+	pollfds[count++].events = POLLIN;
+	for (i = 0; (i < store->client_count) && (count < max); i++) {
+		pollfds[count].fd = store->clients[i].sock;
+		pollfds[count++].events = POLLIN;
+	}
+	return count;
+}
+
+static void dvbsistore_drop(struct dvbsistore *store, int i)
+{
+	close(store->clients[i].sock);
+	if (store->clients[i].efd != -1)
+		close(store->clients[i].efd);
+	store->clients[i] = store->clients[--store->client_count];
+}
+
+/**
+ * A subscriber has sent the kinds it wants: hand it its eventfd.
+ */
+static int dvbsistore_subscribe(struct dvbsistore_client *client)
+{
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	uint8_t ok = 0;
+
+	if ((client->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	memset(cbuf, 0, sizeof(cbuf));
+	iov.iov_base = &ok;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &client->efd, sizeof(int));
+	if (sendmsg(client->sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) != 1)
+		return -1;
+	return 0;
+}
+
+void dvbsistore_process(struct dvbsistore *store, int fd)
+{
+	struct dvbsistore_client *client;
+	uint32_t kinds;
+	int sock;
+	int i;
+
+	if (fd == store->listen_fd) {
+		if ((sock = accept4(store->listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) < 0)
+			return;
+		if (store->client_count == DVBSISTORE_MAX_CLIENTS) {
+			close(sock);
+			return;
+		}
+		client = &store->clients[store->client_count++];
+		client->sock = sock;
+		client->efd = -1;
+		client->kinds = 0;
+		return;
+	}
+
+	for (i = 0; i < store->client_count; i++) {
+		if (store->clients[i].sock == fd)
+			break;
+	}
+	if (i == store->client_count)
+		return;
+	client = &store->clients[i];
+
+	// the subscription is all a client ever sends; after it, only the
+	// close is looked for
+	if ((client->efd == -1) &&
+	    (recv(fd, &kinds, sizeof(kinds), MSG_DONTWAIT) == sizeof(kinds))) {
+		client->kinds = kinds;
+		if (dvbsistore_subscribe(client))
+			dvbsistore_drop(store, i);
+		return;
+	}
+	if ((recv(fd, &kinds, sizeof(kinds), MSG_DONTWAIT) < 0) && (errno == EAGAIN))
+		return;
+	dvbsistore_drop(store, i);
+}
+
+void dvbsistore_destroy(struct dvbsistore *store)
+{
+	while (store->client_count)
+		dvbsistore_drop(store, 0);
+	close(store->listen_fd);
+	unlink(store->sock_path);
+	unlink(store->path);
+	munmap(store->hdr, store->map_size);
+	free(store->moving);
+	free(store);
+}
+
+static int dvbsistore_connect(struct dvbsistore *store, uint32_t kinds)
+{
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	struct sockaddr_un addr;
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	uint8_t ok;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, store->sock_path);
+	if ((store->sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	if (connect(store->sock, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    (send(store->sock, &kinds, sizeof(kinds), MSG_NOSIGNAL) != sizeof(kinds)))
+		return -1;
+
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = &ok;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	if (recvmsg(store->sock, &msg, MSG_CMSG_CLOEXEC) != 1)
+		return -1;
+	if (((cmsg = CMSG_FIRSTHDR(&msg)) == NULL) ||
+	    (cmsg->cmsg_level != SOL_SOCKET) || (cmsg->cmsg_type != SCM_RIGHTS)) {
+		errno = EPROTO;
+		return -1;
+	}
+	memcpy(&store->efd, CMSG_DATA(cmsg), sizeof(int));
+	return 0;
+}
+
+struct dvbsistore *dvbsistore_attach(int adapter, int demux, uint32_t kinds)
+{
+	struct dvbsistore *store;
+	struct dvbsistore_header *hdr;
+	struct stat st;
+	int fd;
+
+	if ((store = calloc(1, sizeof(struct dvbsistore))) == NULL)
+		return NULL;
+	store->listen_fd = -1;
+	store->sock = -1;
+	store->efd = -1;
+	dvbsistore_paths(store, adapter, demux);
+
+	if ((fd = open(store->path, O_RDONLY | O_CLOEXEC)) < 0)
+		goto fail;
+	if (fstat(fd, &st) || (st.st_size < (off_t) sizeof(struct dvbsistore_header))) {
+		close(fd);
+		errno = EINVAL;
+		goto fail;
+	}
+	store->map_size = st.st_size;
+	hdr = mmap(NULL, store->map_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (hdr == MAP_FAILED)
+		goto fail;
+	store->hdr = hdr;
+
+	if (memcmp(hdr->magic, DVBSISTORE_MAGIC, sizeof(hdr->magic)) ||
+	    (hdr->version != DVBSISTORE_VERSION) ||
+	    (hdr->slot_size != sizeof(struct dvbsistore_slot)) ||
+	    (hdr->data_offset + hdr->data_size != store->map_size)) {
+		errno = EINVAL;
+		goto fail_unmap;
+	}
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	store->slots = (struct dvbsistore_slot *) (hdr + 1);
+	store->data = (uint8_t *) hdr + hdr->data_offset;
+
+	if (kinds && dvbsistore_connect(store, kinds))
+		goto fail_unmap;
+	return store;
+
+fail_unmap:
+	if (store->sock != -1)
+		close(store->sock);
+	munmap(store->hdr, store->map_size);
+fail:
+	free(store);
+	return NULL;
+}
+
+int dvbsistore_fd(struct dvbsistore *store)
+{
+	return store->efd;
+}
+
+void dvbsistore_ack(struct dvbsistore *store)
+{
+	eventfd_t value;
+
+	if (store->efd != -1)
+		eventfd_read(store->efd, &value);
+}
+
+/**
+ * Take a consistent copy of a slot.
+ *
+ * @return 0 on success, -1 if the publisher kept changing it.
+ */
+static int dvbsistore_slot_get(struct dvbsistore_slot *slot, struct dvbsistore_slot *copy)
+{
+	uint32_t seq;
+	int tries;
+
+	for (tries = 0; tries < DVBSISTORE_READ_TRIES; tries++) {
+		if ((seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE)) & 1) {
+			sched_yield();
+			continue;
+		}
+		memcpy(copy, slot, sizeof(struct dvbsistore_slot));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+	return -1;
+}
+
+static void dvbsistore_slot_info(struct dvbsistore_slot *slot, struct dvbsistore_info *info)
+{
+	info->pid = slot->pid;
+	info->table_id = slot->table_id;
+	info->table_id_ext = slot->table_id_ext;
+	info->kind = slot->kind;
+	info->version = slot->version;
+	info->serial = slot->serial;
+	info->updated_ms = slot->updated_ms;
+	info->raw_len = slot->raw_len;
+	info->decoded_len = slot->decoded_len;
+}
+
+int dvbsistore_next(struct dvbsistore *store, uint64_t *serial, uint32_t kinds,
+		    struct dvbsistore_info *info)
+{
+	struct dvbsistore_slot copy;
+	struct dvbsistore_slot best;
+	uint32_t i;
+
+	best.serial = 0;
+	for (i = 0; i < store->hdr->slot_count; i++) {
+		if (dvbsistore_slot_get(&store->slots[i], &copy) || !copy.used ||
+		    !(kinds & DVBSISTORE_MASK(copy.kind)) || (copy.serial <= *serial))
+			continue;
+		if ((best.serial == 0) || (copy.serial < best.serial))
+			best = copy;
+	}
+	if (best.serial == 0)
+		return 0;
+
+	dvbsistore_slot_info(&best, info);
+	*serial = best.serial;
+	return 1;
+}
+
+static struct dvbsistore_slot *dvbsistore_lookup(struct dvbsistore *store, int pid, int table_id,
+						 int table_id_ext, struct dvbsistore_slot *copy)
+{
+	uint32_t i;
+
+	for (i = 0; i < store->hdr->slot_count; i++) {
+		if (dvbsistore_slot_get(&store->slots[i], copy) || !copy->used)
+			continue;
+		if ((copy->pid == pid) && (copy->table_id == table_id) &&
+		    (copy->table_id_ext == table_id_ext))
+			return &store->slots[i];
+	}
+	errno = ENOENT;
+	return NULL;
+}
+
+int dvbsistore_find(struct dvbsistore *store, int pid, int table_id, int table_id_ext,
+		    struct dvbsistore_info *info)
+{
+	struct dvbsistore_slot copy;
+
+	if (dvbsistore_lookup(store, pid, table_id, table_id_ext, &copy) == NULL)
+		return -1;
+	dvbsistore_slot_info(&copy, info);
+	return 0;
+}
+
+int dvbsistore_read(struct dvbsistore *store, int pid, int table_id, int table_id_ext,
+		    int decoded, void *buf, size_t size, struct dvbsistore_info *info)
+{
+	struct dvbsistore_header *hdr = store->hdr;
+	struct dvbsistore_slot *slot;
+	struct dvbsistore_slot copy;
+	uint64_t pos;
+	uint32_t len;
+	int tries;
+
+	if ((slot = dvbsistore_lookup(store, pid, table_id, table_id_ext, &copy)) == NULL)
+		return -1;
+
+	for (tries = 0; tries < DVBSISTORE_READ_TRIES; tries++) {
+		if (tries && (dvbsistore_slot_get(slot, &copy) || !copy.used ||
+			      (copy.pid != pid) || (copy.table_id != table_id) ||
+			      (copy.table_id_ext != table_id_ext))) {
+			errno = ENOENT;
+			return -1;
+		}
+		if (info)
+			dvbsistore_slot_info(&copy, info);
+
+		pos = decoded ? copy.decoded_pos : copy.raw_pos;
+		len = decoded ? copy.decoded_len : copy.raw_len;
+		if (decoded && (len == 0)) {
+			errno = ENOENT;
+			return -1;
+		}
+		if (len > size) {
+			errno = ENOBUFS;
+			return -1;
+		}
+		memcpy(buf, store->data + (pos % hdr->data_size), len);
+
+		// unless the ring has come round since, what was copied is whole
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&hdr->head, __ATOMIC_RELAXED) - pos <= hdr->data_size)
+			return len;
+	}
+	errno = EAGAIN;
+	return -1;
+}
+
+void dvbsistore_detach(struct dvbsistore *store)
+{
+	if (store->efd != -1)
+		close(store->efd);
+	if (store->sock != -1)
+		close(store->sock);
+	munmap(store->hdr, store->map_size);
+	free(store);
+}
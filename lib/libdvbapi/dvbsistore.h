@@ -0,0 +1,239 @@
+/*
+ * libdvbsistore - SI tables of an adapter shared between processes
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBSISTORE_H
+#define LIBDVBSISTORE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <poll.h>
+
+/**
+ * A store of the SI tables received on one demux, kept by a single
+ * publisher (the dvbsid daemon) in shared memory for any number of readers,
+ * so each table is filtered and decoded once whoever wants it.
+ *
+ * The store is DVBSISTORE_DIR/dvbsi-<adapter>.<demux>: a header, a fixed
+ * table of slots, one per table (by PID, table_id and table_id_extension),
+ * and a ring the data of each new version is written into. A slot is
+ * changed under a sequence count, odd while it is, and data is only
+ * overwritten once the ring has gone right round, which readers check for
+ * after copying; so reading needs no locks or syscalls, and a reader never
+ * holds up the publisher.
+ *
+ * Each version is kept raw, as its sections one after the other in
+ * section_number order, and for the tables libucsi's si_table_decode()
+ * knows, decoded: a struct si_table whose pointers are offsets, which
+ * si_table_rebase(table, NULL, table) makes usable once copied out.
+ *
+ * Readers wanting to hear of new versions subscribe over the unix socket
+ * DVBSISTORE_SOCKET_DIR/dvbsi-<adapter>.<demux>.sock to a set of kinds of
+ * table, and are handed an eventfd the publisher signals when one is
+ * published. However many readers there are, the demux sees one filter.
+ */
+
+#define DVBSISTORE_DIR "/dev/shm"
+#define DVBSISTORE_SOCKET_DIR "/run"
+
+/**
+ * Kinds of table, for subscriptions.
+ */
+enum dvbsistore_kind {
+	DVBSISTORE_PAT,
+	DVBSISTORE_PMT,
+	DVBSISTORE_NIT,
+	DVBSISTORE_SDT,
+	DVBSISTORE_EIT,
+	DVBSISTORE_TDT,
+	DVBSISTORE_TOT,
+	DVBSISTORE_KINDS,
+};
+
+#define DVBSISTORE_MASK(kind) (1 << (kind))
+#define DVBSISTORE_ALL ((1 << DVBSISTORE_KINDS) - 1)
+
+/**
+ * What is known of a table in the store.
+ */
+struct dvbsistore_info {
+	int pid;
+	int table_id;
+	int table_id_ext;		/* 0 for tables without one */
+	enum dvbsistore_kind kind;
+	int version;
+	uint64_t serial;		/* of its publication; later ones are higher */
+	uint64_t updated_ms;		/* CLOCK_REALTIME of its publication */
+	uint32_t raw_len;
+	uint32_t decoded_len;		/* 0 => not decoded */
+};
+
+struct dvbsistore;
+
+/**
+ * Create the store of a demux, replacing any old one, and start listening
+ * for subscriptions.
+ *
+ * @param adapter Index of the DVB adapter.
+ * @param demux Index of the demux device on that adapter.
+ * @param slots Number of tables it can hold.
+ * @param data_size Size of its data ring; the current versions of all the
+ * tables must fit in half of it, and each in a quarter.
+ * @return The store, or NULL with errno set on failure.
+ */
+extern struct dvbsistore *dvbsistore_create(int adapter, int demux, uint32_t slots,
+					    uint32_t data_size);
+
+/**
+ * Publish a new version of a table, and signal the readers subscribed to
+ * its kind.
+ *
+ * @param store The store.
+ * @param info Its pid, table_id, table_id_ext, kind and version.
+ * @param raw The sections.
+ * @param raw_len Their length.
+ * @param decoded The decoded table, with offsets for pointers; NULL for none.
+ * @param decoded_len Its length.
+ * @return 0 on success, or -1 with errno ENOSPC if there is no free slot or
+ * the version is too large.
+ */
+extern int dvbsistore_publish(struct dvbsistore *store, const struct dvbsistore_info *info,
+			      const void *raw, uint32_t raw_len,
+			      const void *decoded, uint32_t decoded_len);
+
+/**
+ * Forget every table, e.g. when the adapter has been tuned to another mux.
+ * Readers are signalled as for a publication.
+ *
+ * @param store The store.
+ */
+extern void dvbsistore_reset(struct dvbsistore *store);
+
+/**
+ * Fill in pollfds for the subscription socket and the subscribers, for
+ * POLLIN.
+ *
+ * @param store The store.
+ * @param pollfds Where to put them.
+ * @param max Size of pollfds.
+ * @return The number filled in.
+ */
+extern int dvbsistore_get_pollfds(struct dvbsistore *store, struct pollfd *pollfds, int max);
+
+/**
+ * Deal with one of those fds being readable: take a new subscriber, or
+ * drop one which has gone.
+ *
+ * @param store The store.
+ * @param fd The fd.
+ */
+extern void dvbsistore_process(struct dvbsistore *store, int fd);
+
+/**
+ * Remove the store and stop listening. Readers keep what they have mapped.
+ *
+ * @param store The store.
+ */
+extern void dvbsistore_destroy(struct dvbsistore *store);
+
+/**
+ * Map the store of a demux for reading, and subscribe to kinds of table.
+ *
+ * @param adapter Index of the DVB adapter.
+ * @param demux Index of the demux device on that adapter.
+ * @param kinds DVBSISTORE_MASK()s of the kinds to be told of, or 0.
+ * @return The store, or NULL with errno set on failure (ENOENT if no
+ * publisher is running).
+ */
+extern struct dvbsistore *dvbsistore_attach(int adapter, int demux, uint32_t kinds);
+
+/**
+ * @return The eventfd which becomes readable when a table of a kind
+ * subscribed to has been published, or -1 with no subscription.
+ */
+extern int dvbsistore_fd(struct dvbsistore *store);
+
+/**
+ * Clear the eventfd, before looking for what has changed with
+ * dvbsistore_next(), so that nothing published afterwards is missed.
+ *
+ * @param store The store.
+ */
+extern void dvbsistore_ack(struct dvbsistore *store);
+
+/**
+ * Find the table published soonest after a serial.
+ *
+ * @param store The store.
+ * @param serial The last serial seen, 0 at first; advanced to the table's.
+ * @param kinds DVBSISTORE_MASK()s of the kinds wanted.
+ * @param info Set to the table's details.
+ * @return 1 if there was one, 0 if not.
+ */
+extern int dvbsistore_next(struct dvbsistore *store, uint64_t *serial, uint32_t kinds,
+			   struct dvbsistore_info *info);
+
+/**
+ * Look a table up.
+ *
+ * @param store The store.
+ * @param pid Its PID.
+ * @param table_id Its table_id.
+ * @param table_id_ext Its table_id_extension, 0 without one.
+ * @param info Set to its details.
+ * @return 0 on success, or -1 with errno ENOENT if it is not in the store.
+ */
+extern int dvbsistore_find(struct dvbsistore *store, int pid, int table_id, int table_id_ext,
+			   struct dvbsistore_info *info);
+
+/**
+ * Copy the current version of a table out.
+ *
+ * @param store The store.
+ * @param pid Its PID.
+ * @param table_id Its table_id.
+ * @param table_id_ext Its table_id_extension, 0 without one.
+ * @param decoded 1 for the decoded table, 0 for the sections.
+ * @param buf Where to put it.
+ * @param size Size of buf.
+ * @param info Set to the details of the version copied, or to the current
+ * one on failure; may be NULL.
+ * @return The length copied, or -1 with errno ENOENT if the table (or its
+ * decoded form) is not in the store, or ENOBUFS if buf is too small.
+ */
+extern int dvbsistore_read(struct dvbsistore *store, int pid, int table_id, int table_id_ext,
+			   int decoded, void *buf, size_t size, struct dvbsistore_info *info);
+
+/**
+ * Unmap a store and end its subscription.
+ *
+ * @param store The store.
+ */
+extern void dvbsistore_detach(struct dvbsistore *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
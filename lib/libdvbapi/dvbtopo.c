@@ -0,0 +1,527 @@
+/*
+ * libdvbtopo - cached DVB adapter topology and capabilities
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/param.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <linux/dvb/frontend.h>
+#include "dvbtopo.h"
+
+#define DVBTOPO_DEV_DIR		"/dev/dvb"
+#define DVBTOPO_SYSFS_DIR	"/sys/class/dvb"
+#define DVBTOPO_BOOT_ID		"/proc/sys/kernel/random/boot_id"
+
+#define DVBTOPO_MAGIC		"DVBTOPO"
+#define DVBTOPO_VERSION		1
+
+struct dvbtopo_stamp {
+	int64_t sec;
+	int64_t nsec;
+};
+
+/*
+ * Cache file layout, host byte order:
+ *
+ *   struct dvbtopo_header
+ *   struct dvbtopo_adapter adapters[adapter_count]
+ *   struct dvbtopo_stamp stamps[adapter_count]	mtime of each /dev/dvb/adapterN
+ */
+struct dvbtopo_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t adapter_size;
+	uint32_t adapter_count;
+	uint32_t reserved;
+	char boot_id[40];
+	struct dvbtopo_stamp dev_dir;		/* mtime of /dev/dvb */
+};
+
+struct dvbtopo {
+	int adapter_count;
+	struct dvbtopo_adapter *adapters;
+	struct dvbtopo_stamp *stamps;
+};
+
+static int dvbtopo_get_stamp(const char *path, struct dvbtopo_stamp *stamp)
+{
+	struct stat st;
+
+	if (stat(path, &st))
+		return -1;
+	stamp->sec = st.st_mtim.tv_sec;
+	stamp->nsec = st.st_mtim.tv_nsec;
+	return 0;
+}
+
+static int dvbtopo_adapter_stamp(int adapter, struct dvbtopo_stamp *stamp)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/adapter%i", DVBTOPO_DEV_DIR, adapter);
+	return dvbtopo_get_stamp(path, stamp);
+}
+
+/*
+ * What the cache must have been written against to be used.
+ */
+static void dvbtopo_current(struct dvbtopo_header *header)
+{
+	FILE *f;
+
+	memset(header, 0, sizeof(struct dvbtopo_header));
+	memcpy(header->magic, DVBTOPO_MAGIC, sizeof(DVBTOPO_MAGIC));
+	header->version = DVBTOPO_VERSION;
+	header->adapter_size = sizeof(struct dvbtopo_adapter);
+
+	if ((f = fopen(DVBTOPO_BOOT_ID, "r")) != NULL) {
+		if (fgets(header->boot_id, sizeof(header->boot_id), f) == NULL)
+			header->boot_id[0] = 0;
+		fclose(f);
+	}
+	dvbtopo_get_stamp(DVBTOPO_DEV_DIR, &header->dev_dir);
+}
+
+static int dvbtopo_read_int(const char *path, const char *entry, int *value)
+{
+	char filename[PATH_MAX + 32];
+	FILE *f;
+	int result;
+
+	snprintf(filename, sizeof(filename), "%s/%s", path, entry);
+	if ((f = fopen(filename, "r")) == NULL)
+		return -1;
+	result = fscanf(f, "%i", value);
+	fclose(f);
+
+	return (result == 1) ? 0 : -1;
+}
+
+static int dvbtopo_read_hex(const char *path, const char *entry, uint16_t *value)
+{
+	char filename[PATH_MAX + 32];
+	unsigned int tmp;
+	FILE *f;
+	int result;
+
+	snprintf(filename, sizeof(filename), "%s/%s", path, entry);
+	if ((f = fopen(filename, "r")) == NULL)
+		return -1;
+	result = fscanf(f, "%x", &tmp);
+	fclose(f);
+	if (result != 1)
+		return -1;
+
+	*value = tmp;
+	return 0;
+}
+
+/*
+ * Fill in where the card is from sysfs: /sys/class/dvb/dvbA.<node>/device is
+ * the PCI device or USB interface. A PCI device has vendor ids and a
+ * numa_node of its own; for USB the ids are on the parent device, and the
+ * NUMA node is the host controller's.
+ */
+static void dvbtopo_scan_sysfs(struct dvbtopo_adapter *adapter, const char *node)
+{
+	char filename[PATH_MAX + 32];
+	char path[PATH_MAX];
+	char link[PATH_MAX];
+	char *slash;
+	ssize_t len;
+	int have_ids = 0;
+
+	adapter->numa_node = -1;
+
+	snprintf(filename, sizeof(filename), "%s/dvb%i.%s/device", DVBTOPO_SYSFS_DIR, adapter->id, node);
+	if (realpath(filename, path) == NULL)
+		return;
+	strncpy(adapter->bus_path, path, sizeof(adapter->bus_path) - 1);
+
+	snprintf(filename, sizeof(filename), "%s/driver", path);
+	if ((len = readlink(filename, link, sizeof(link) - 1)) > 0) {
+		link[len] = 0;
+		slash = strrchr(link, '/');
+		strncpy(adapter->driver, slash ? slash + 1 : link, sizeof(adapter->driver) - 1);
+	}
+
+	if (dvbtopo_read_hex(path, "vendor", &adapter->vendor) == 0) {
+		dvbtopo_read_hex(path, "device", &adapter->device);
+		dvbtopo_read_hex(path, "subsystem_vendor", &adapter->subvendor);
+		dvbtopo_read_hex(path, "subsystem_device", &adapter->subdevice);
+		have_ids = 1;
+	}
+
+	while (strcmp(path, "/sys/devices") && ((slash = strrchr(path, '/')) != NULL)) {
+		if (!have_ids && (dvbtopo_read_hex(path, "idVendor", &adapter->vendor) == 0)) {
+			dvbtopo_read_hex(path, "idProduct", &adapter->device);
+			have_ids = 1;
+		}
+		if (dvbtopo_read_int(path, "numa_node", &adapter->numa_node) == 0)
+			break;
+		*slash = 0;
+	}
+}
+
+static void dvbtopo_scan_frontend(int adapter, struct dvbtopo_frontend *frontend)
+{
+	char filename[PATH_MAX + 32];
+	struct dvb_frontend_info info;
+	int fd;
+
+	// read only: this does not wake the demodulator up
+	snprintf(filename, sizeof(filename), "%s/adapter%i/frontend%i", DVBTOPO_DEV_DIR,
+		 adapter, frontend->id);
+	if ((fd = open(filename, O_RDONLY | O_NONBLOCK)) < 0)
+		return;
+
+	if (ioctl(fd, FE_GET_INFO, &info) == 0) {
+		switch(info.type) {
+		case FE_QPSK:
+			frontend->type = DVBFE_TYPE_DVBS;
+			break;
+
+		case FE_QAM:
+			frontend->type = DVBFE_TYPE_DVBC;
+			break;
+
+		case FE_OFDM:
+			frontend->type = DVBFE_TYPE_DVBT;
+			break;
+
+		case FE_ATSC:
+			frontend->type = DVBFE_TYPE_ATSC;
+			break;
+		}
+		strncpy(frontend->name, info.name, sizeof(frontend->name) - 1);
+		frontend->frequency_min = info.frequency_min;
+		frontend->frequency_max = info.frequency_max;
+		frontend->symbol_rate_min = info.symbol_rate_min;
+		frontend->symbol_rate_max = info.symbol_rate_max;
+		frontend->caps = info.caps;
+	}
+
+#ifdef DTV_ENUM_DELSYS
+	{
+		struct dtv_property property;
+		struct dtv_properties properties;
+		unsigned int i;
+
+		memset(&property, 0, sizeof(property));
+		property.cmd = DTV_ENUM_DELSYS;
+		properties.num = 1;
+		properties.props = &property;
+		if (ioctl(fd, FE_GET_PROPERTY, &properties) == 0) {
+			for (i = 0; (i < property.u.buffer.len) && (i < DVBTOPO_MAX_DELSYS); i++)
+				frontend->delsys[i] = property.u.buffer.data[i];
+			frontend->delsys_count = i;
+		}
+	}
+#endif
+
+	close(fd);
+}
+
+static int dvbtopo_int_compare(const void *a, const void *b)
+{
+	return *(const int *) a - *(const int *) b;
+}
+
+static void dvbtopo_scan_adapter(struct dvbtopo_adapter *adapter)
+{
+	char filename[PATH_MAX + 32];
+	char node[32] = "";
+	struct dirent *entry;
+	int frontends[DVBTOPO_MAX_FRONTENDS];
+	int frontend_count = 0;
+	int id;
+	int i;
+	DIR *dir;
+
+	snprintf(filename, sizeof(filename), "%s/adapter%i", DVBTOPO_DEV_DIR, adapter->id);
+	if ((dir = opendir(filename)) == NULL)
+		return;
+
+	while ((entry = readdir(dir)) != NULL) {
+		if (sscanf(entry->d_name, "frontend%i", &id) == 1) {
+			if (frontend_count < DVBTOPO_MAX_FRONTENDS)
+				frontends[frontend_count++] = id;
+			adapter->frontend_count++;
+		} else if (sscanf(entry->d_name, "demux%i", &id) == 1) {
+			adapter->demux_count++;
+		} else if (sscanf(entry->d_name, "dvr%i", &id) == 1) {
+			adapter->dvr_count++;
+		} else if (sscanf(entry->d_name, "ca%i", &id) == 1) {
+			adapter->ca_count++;
+		} else if (sscanf(entry->d_name, "net%i", &id) == 1) {
+			adapter->net_count++;
+		} else {
+			continue;
+		}
+
+		// any of the adapter's devices leads to the card
+		if (node[0] == 0)
+			strncpy(node, entry->d_name, sizeof(node) - 1);
+	}
+	closedir(dir);
+
+	qsort(frontends, frontend_count, sizeof(int), dvbtopo_int_compare);
+	for (i = 0; i < frontend_count; i++) {
+		adapter->frontends[i].id = frontends[i];
+		dvbtopo_scan_frontend(adapter->id, &adapter->frontends[i]);
+	}
+	if (adapter->frontend_count > DVBTOPO_MAX_FRONTENDS)
+		adapter->frontend_count = DVBTOPO_MAX_FRONTENDS;
+
+	if (node[0])
+		dvbtopo_scan_sysfs(adapter, node);
+	else
+		adapter->numa_node = -1;
+}
+
+static struct dvbtopo *dvbtopo_scan(void)
+{
+	struct dvbtopo *topo;
+	struct dirent *entry;
+	int *ids = NULL;
+	int count = 0;
+	int alloc = 0;
+	int id;
+	int i;
+	DIR *dir;
+
+	if ((topo = calloc(1, sizeof(struct dvbtopo))) == NULL)
+		return NULL;
+
+	// no /dev/dvb just means no adapters
+	if ((dir = opendir(DVBTOPO_DEV_DIR)) != NULL) {
+		while ((entry = readdir(dir)) != NULL) {
+			if (sscanf(entry->d_name, "adapter%i", &id) != 1)
+				continue;
+			if (count == alloc) {
+				int *tmp;
+
+				alloc = alloc ? alloc * 2 : 16;
+				if ((tmp = realloc(ids, alloc * sizeof(int))) == NULL) {
+					closedir(dir);
+					free(ids);
+					free(topo);
+					return NULL;
+				}
+				ids = tmp;
+			}
+			ids[count++] = id;
+		}
+		closedir(dir);
+	}
+	qsort(ids, count, sizeof(int), dvbtopo_int_compare);
+
+	if (count) {
+		topo->adapters = calloc(count, sizeof(struct dvbtopo_adapter));
+		topo->stamps = calloc(count, sizeof(struct dvbtopo_stamp));
+		if ((topo->adapters == NULL) || (topo->stamps == NULL)) {
+			free(ids);
+			dvbtopo_close(topo);
+			return NULL;
+		}
+	}
+	topo->adapter_count = count;
+
+	for (i = 0; i < count; i++) {
+		topo->adapters[i].id = ids[i];
+		dvbtopo_adapter_stamp(ids[i], &topo->stamps[i]);
+		dvbtopo_scan_adapter(&topo->adapters[i]);
+	}
+
+	free(ids);
+	return topo;
+}
+
+static struct dvbtopo *dvbtopo_load(const struct dvbtopo_header *current)
+{
+	struct dvbtopo_header header;
+	struct dvbtopo_stamp stamp;
+	struct dvbtopo *topo;
+	int count;
+	int i;
+	FILE *f;
+
+	if ((f = fopen(DVBTOPO_CACHE_FILE, "r")) == NULL)
+		return NULL;
+	if ((fread(&header, sizeof(header), 1, f) != 1) ||
+	    memcmp(header.magic, current->magic, sizeof(header.magic)) ||
+	    (header.version != current->version) ||
+	    (header.adapter_size != current->adapter_size) ||
+	    memcmp(header.boot_id, current->boot_id, sizeof(header.boot_id)) ||
+	    memcmp(&header.dev_dir, &current->dev_dir, sizeof(header.dev_dir))) {
+		fclose(f);
+		return NULL;
+	}
+
+	if ((topo = calloc(1, sizeof(struct dvbtopo))) == NULL) {
+		fclose(f);
+		return NULL;
+	}
+	count = header.adapter_count;
+	if (count) {
+		topo->adapters = calloc(count, sizeof(struct dvbtopo_adapter));
+		topo->stamps = calloc(count, sizeof(struct dvbtopo_stamp));
+		if ((topo->adapters == NULL) || (topo->stamps == NULL) ||
+		    (fread(topo->adapters, sizeof(struct dvbtopo_adapter), count, f) != (size_t) count) ||
+		    (fread(topo->stamps, sizeof(struct dvbtopo_stamp), count, f) != (size_t) count)) {
+			fclose(f);
+			dvbtopo_close(topo);
+			return NULL;
+		}
+	}
+	topo->adapter_count = count;
+	fclose(f);
+
+	// devices come and go inside an adapter's directory too
+	for (i = 0; i < count; i++) {
+		if (dvbtopo_adapter_stamp(topo->adapters[i].id, &stamp) ||
+		    memcmp(&stamp, &topo->stamps[i], sizeof(stamp))) {
+			dvbtopo_close(topo);
+			return NULL;
+		}
+	}
+
+	return topo;
+}
+
+static void dvbtopo_save(struct dvbtopo *topo, const struct dvbtopo_header *current)
+{
+	struct dvbtopo_header header;
+	char *tmpname;
+	FILE *f;
+	int fd;
+	int ok;
+
+	if (asprintf(&tmpname, "%s.XXXXXX", DVBTOPO_CACHE_FILE) < 0)
+		return;
+
+	// written aside and renamed, as several tools may start at once
+	if ((fd = mkstemp(tmpname)) < 0) {
+		free(tmpname);
+		return;
+	}
+	fchmod(fd, 0644);
+	if ((f = fdopen(fd, "w")) == NULL) {
+		close(fd);
+		unlink(tmpname);
+		free(tmpname);
+		return;
+	}
+
+	memcpy(&header, current, sizeof(header));
+	header.adapter_count = topo->adapter_count;
+	ok = (fwrite(&header, sizeof(header), 1, f) == 1);
+	if (ok && topo->adapter_count) {
+		ok = (fwrite(topo->adapters, sizeof(struct dvbtopo_adapter), topo->adapter_count, f) ==
+		      (size_t) topo->adapter_count) &&
+		     (fwrite(topo->stamps, sizeof(struct dvbtopo_stamp), topo->adapter_count, f) ==
+		      (size_t) topo->adapter_count);
+	}
+	if (fclose(f) || !ok || rename(tmpname, DVBTOPO_CACHE_FILE))
+		unlink(tmpname);
+
+	free(tmpname);
+}
+
+struct dvbtopo *dvbtopo_open(int flags)
+{
+	struct dvbtopo_header current;
+	struct dvbtopo *topo;
+
+	dvbtopo_current(&current);
+
+	if (!(flags & DVBTOPO_RESCAN) && ((topo = dvbtopo_load(&current)) != NULL))
+		return topo;
+	if (flags & DVBTOPO_CACHE_ONLY)
+		return NULL;
+
+	if ((topo = dvbtopo_scan()) == NULL)
+		return NULL;
+	dvbtopo_save(topo, &current);
+
+	return topo;
+}
+
+void dvbtopo_close(struct dvbtopo *topo)
+{
+	free(topo->adapters);
+	free(topo->stamps);
+	free(topo);
+}
+
+int dvbtopo_adapter_count(struct dvbtopo *topo)
+{
+	return topo->adapter_count;
+}
+
+const struct dvbtopo_adapter *dvbtopo_adapter(struct dvbtopo *topo, int index)
+{
+	if ((index < 0) || (index >= topo->adapter_count))
+		return NULL;
+
+	return &topo->adapters[index];
+}
+
+const struct dvbtopo_adapter *dvbtopo_find_adapter(struct dvbtopo *topo, int adapter)
+{
+	int low = 0;
+	int high = topo->adapter_count;
+
+	// adapters are kept in number order
+	while (low < high) {
+		int mid = low + ((high - low) / 2);
+
+		if (topo->adapters[mid].id < adapter)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if ((low < topo->adapter_count) && (topo->adapters[low].id == adapter))
+		return &topo->adapters[low];
+	return NULL;
+}
+
+const struct dvbtopo_frontend *dvbtopo_find_frontend(struct dvbtopo *topo,
+						     int adapter, int frontend)
+{
+	const struct dvbtopo_adapter *a = dvbtopo_find_adapter(topo, adapter);
+	int i;
+
+	if (a == NULL)
+		return NULL;
+
+	for (i = 0; i < a->frontend_count; i++)
+		if (a->frontends[i].id == frontend)
+			return &a->frontends[i];
+	return NULL;
+}
@@ -0,0 +1,154 @@
+/*
+ * libdvbtopo - cached DVB adapter topology and capabilities
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBTOPO_H
+#define LIBDVBTOPO_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libdvbapi/dvbfe.h>
+
+/**
+ * A registry of the DVB adapters in the system: which devices each one has,
+ * what its frontends can do, and where the card sits (bus path, NUMA node).
+ *
+ * Finding this out means walking /dev/dvb and sysfs, and opening every
+ * frontend for FE_GET_INFO, so the result is kept in DVBTOPO_CACHE_FILE.
+ * The cache is used for as long as the system has not been rebooted and
+ * /dev/dvb and its adapter directories are unchanged, which is a handful
+ * of stat() calls. Frontends are only ever opened read only, which does not
+ * power up their demodulators.
+ *
+ * Adapter hotplug is noticed through the /dev/dvb timestamps anyway. To
+ * have the cache ready before the first tool runs, rescan it from udev:
+ *
+ *   SUBSYSTEM=="dvb", ACTION=="add|remove", RUN+="/usr/bin/lsdvb -r"
+ */
+
+#define DVBTOPO_CACHE_FILE "/run/dvbtopo.cache"
+
+#define DVBTOPO_MAX_FRONTENDS 8
+#define DVBTOPO_MAX_DELSYS 16
+
+/**
+ * Flags for dvbtopo_open().
+ */
+#define DVBTOPO_RESCAN		1	/* ignore the cache, and rewrite it */
+#define DVBTOPO_CACHE_ONLY	2	/* fail rather than scan */
+
+/**
+ * A frontend, as FE_GET_INFO and DTV_ENUM_DELSYS describe it.
+ */
+struct dvbtopo_frontend {
+	int id;				/* frontend<id> */
+	enum dvbfe_type type;
+	char name[128];
+	uint32_t frequency_min;		/* kHz for DVB-S, Hz otherwise */
+	uint32_t frequency_max;
+	uint32_t symbol_rate_min;
+	uint32_t symbol_rate_max;
+	uint32_t caps;			/* FE_CAN_* flags */
+	int delsys_count;		/* 0 if the kernel cannot say */
+	uint8_t delsys[DVBTOPO_MAX_DELSYS];	/* SYS_* values */
+};
+
+/**
+ * An adapter and the card it is on.
+ */
+struct dvbtopo_adapter {
+	int id;				/* adapter<id> */
+	int frontend_count;
+	int demux_count;
+	int dvr_count;
+	int ca_count;
+	int net_count;
+	int numa_node;			/* -1 if not known */
+	char driver[32];		/* "" if not known */
+	char bus_path[256];		/* the card in /sys/devices, "" if not known */
+	uint16_t vendor;		/* PCI vendor:device, or USB idVendor:idProduct */
+	uint16_t device;
+	uint16_t subvendor;		/* PCI only */
+	uint16_t subdevice;
+	struct dvbtopo_frontend frontends[DVBTOPO_MAX_FRONTENDS];
+};
+
+/**
+ * Opaque registry handle.
+ */
+struct dvbtopo;
+
+/**
+ * Get the registry, from the cache if it is still valid, otherwise by
+ * scanning the system (and caching the result if the cache can be written).
+ *
+ * @param flags DVBTOPO_* flags.
+ * @return The registry, or NULL on failure.
+ */
+extern struct dvbtopo *dvbtopo_open(int flags);
+
+/**
+ * Release a registry.
+ *
+ * @param topo The registry.
+ */
+extern void dvbtopo_close(struct dvbtopo *topo);
+
+/**
+ * @param topo The registry.
+ * @return Number of adapters, in adapter number order.
+ */
+extern int dvbtopo_adapter_count(struct dvbtopo *topo);
+
+/**
+ * @param topo The registry.
+ * @param index Index from 0 to dvbtopo_adapter_count() - 1.
+ * @return The adapter.
+ */
+extern const struct dvbtopo_adapter *dvbtopo_adapter(struct dvbtopo *topo, int index);
+
+/**
+ * Look up an adapter by number.
+ *
+ * @param topo The registry.
+ * @param adapter Adapter number.
+ * @return The adapter, or NULL if there is no such adapter.
+ */
+extern const struct dvbtopo_adapter *dvbtopo_find_adapter(struct dvbtopo *topo, int adapter);
+
+/**
+ * Look up a frontend by adapter and frontend number.
+ *
+ * @param topo The registry.
+ * @param adapter Adapter number.
+ * @param frontend Frontend number.
+ * @return The frontend, or NULL if there is no such frontend.
+ */
+extern const struct dvbtopo_frontend *dvbtopo_find_frontend(struct dvbtopo *topo,
+							   int adapter, int frontend);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,370 @@
+/*
+ * libdvbtunememo - learned tuning parameters
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "dvbtunememo.h"
+
+/* values of a struct dvbfe_parameters in the file */
+#define DVBTUNEMEMO_FIELDS 11
+
+struct dvbtunememo_entry {
+	enum dvbfe_type type;
+	uint32_t key;
+	struct dvbfe_parameters request;
+	struct dvbfe_parameters tune;		/* request with the AUTO values learned */
+};
+
+struct dvbtunememo {
+	char *path;
+	struct dvbtunememo_entry *entries;	/* oldest first */
+	int count;
+	int size;
+};
+
+static void memo_pack(enum dvbfe_type type, const struct dvbfe_parameters *p, uint32_t *v)
+{
+	memset(v, 0, DVBTUNEMEMO_FIELDS * sizeof(uint32_t));
+	v[0] = p->frequency;
+	v[1] = p->inversion;
+	v[2] = p->delivery_system;
+	v[3] = p->stream_id;
+
+	switch(type) {
+	case DVBFE_TYPE_DVBS:
+		v[4] = p->u.dvbs.symbol_rate;
+		v[5] = p->u.dvbs.fec_inner;
+		v[6] = p->u.dvbs.modulation;
+		v[7] = p->u.dvbs.rolloff;
+		v[8] = p->u.dvbs.pilot;
+		break;
+
+	case DVBFE_TYPE_DVBC:
+		v[4] = p->u.dvbc.symbol_rate;
+		v[5] = p->u.dvbc.fec_inner;
+		v[6] = p->u.dvbc.modulation;
+		break;
+
+	case DVBFE_TYPE_DVBT:
+		v[4] = p->u.dvbt.bandwidth;
+		v[5] = p->u.dvbt.code_rate_HP;
+		v[6] = p->u.dvbt.code_rate_LP;
+		v[7] = p->u.dvbt.constellation;
+		v[8] = p->u.dvbt.transmission_mode;
+		v[9] = p->u.dvbt.guard_interval;
+		v[10] = p->u.dvbt.hierarchy_information;
+		break;
+
+	case DVBFE_TYPE_ATSC:
+		v[4] = p->u.atsc.modulation;
+		break;
+	}
+}
+
+static void memo_unpack(enum dvbfe_type type, const uint32_t *v, struct dvbfe_parameters *p)
+{
+	memset(p, 0, sizeof(struct dvbfe_parameters));
+	p->frequency = v[0];
+	p->inversion = v[1];
+	p->delivery_system = v[2];
+	p->stream_id = v[3];
+
+	switch(type) {
+	case DVBFE_TYPE_DVBS:
+		p->u.dvbs.symbol_rate = v[4];
+		p->u.dvbs.fec_inner = v[5];
+		p->u.dvbs.modulation = v[6];
+		p->u.dvbs.rolloff = v[7];
+		p->u.dvbs.pilot = v[8];
+		break;
+
+	case DVBFE_TYPE_DVBC:
+		p->u.dvbc.symbol_rate = v[4];
+		p->u.dvbc.fec_inner = v[5];
+		p->u.dvbc.modulation = v[6];
+		break;
+
+	case DVBFE_TYPE_DVBT:
+		p->u.dvbt.bandwidth = v[4];
+		p->u.dvbt.code_rate_HP = v[5];
+		p->u.dvbt.code_rate_LP = v[6];
+		p->u.dvbt.constellation = v[7];
+		p->u.dvbt.transmission_mode = v[8];
+		p->u.dvbt.guard_interval = v[9];
+		p->u.dvbt.hierarchy_information = v[10];
+		break;
+
+	case DVBFE_TYPE_ATSC:
+		p->u.atsc.modulation = v[4];
+		break;
+	}
+}
+
+/*
+ * Copy into out (a copy of request) the values of known which request
+ * leaves at AUTO. Values lookupval() could not map (-1) are not known.
+ * Returns how many were copied.
+ */
+static int memo_apply(enum dvbfe_type type, const struct dvbfe_parameters *request,
+		      const struct dvbfe_parameters *known, struct dvbfe_parameters *out)
+{
+	int count = 0;
+
+#define MEMO_FIELD(field, autoval) \
+	if ((request->field == (autoval)) && ((int) known->field >= 0) && \
+	    (known->field != (autoval))) { \
+		out->field = known->field; \
+		count++; \
+	}
+
+	memcpy(out, request, sizeof(struct dvbfe_parameters));
+	MEMO_FIELD(inversion, DVBFE_INVERSION_AUTO);
+
+	switch(type) {
+	case DVBFE_TYPE_DVBS:
+		MEMO_FIELD(u.dvbs.fec_inner, DVBFE_FEC_AUTO);
+		MEMO_FIELD(u.dvbs.modulation, DVBFE_DVBS_MOD_AUTO);
+		MEMO_FIELD(u.dvbs.rolloff, DVBFE_DVBS_ROLLOFF_AUTO);
+		MEMO_FIELD(u.dvbs.pilot, DVBFE_DVBS_PILOT_AUTO);
+		break;
+
+	case DVBFE_TYPE_DVBC:
+		MEMO_FIELD(u.dvbc.fec_inner, DVBFE_FEC_AUTO);
+		MEMO_FIELD(u.dvbc.modulation, DVBFE_DVBC_MOD_AUTO);
+		break;
+
+	case DVBFE_TYPE_DVBT:
+		MEMO_FIELD(u.dvbt.bandwidth, DVBFE_DVBT_BANDWIDTH_AUTO);
+		MEMO_FIELD(u.dvbt.code_rate_HP, DVBFE_FEC_AUTO);
+		MEMO_FIELD(u.dvbt.code_rate_LP, DVBFE_FEC_AUTO);
+		MEMO_FIELD(u.dvbt.constellation, DVBFE_DVBT_CONST_AUTO);
+		MEMO_FIELD(u.dvbt.transmission_mode, DVBFE_DVBT_TRANSMISSION_MODE_AUTO);
+		MEMO_FIELD(u.dvbt.guard_interval, DVBFE_DVBT_GUARD_INTERVAL_AUTO);
+		MEMO_FIELD(u.dvbt.hierarchy_information, DVBFE_DVBT_HIERARCHY_AUTO);
+		break;
+
+	case DVBFE_TYPE_ATSC:
+		MEMO_FIELD(u.atsc.modulation, DVBFE_ATSC_MOD_AUTO);
+		break;
+	}
+
+#undef MEMO_FIELD
+
+	return count;
+}
+
+static int memo_same(enum dvbfe_type type, const struct dvbfe_parameters *a,
+		     const struct dvbfe_parameters *b)
+{
+	uint32_t va[DVBTUNEMEMO_FIELDS];
+	uint32_t vb[DVBTUNEMEMO_FIELDS];
+
+	// compared packed, so bytes outside the type's part of the union don't matter
+	memo_pack(type, a, va);
+	memo_pack(type, b, vb);
+	return !memcmp(va, vb, sizeof(va));
+}
+
+static struct dvbtunememo_entry *memo_find(struct dvbtunememo *memo, enum dvbfe_type type,
+					   uint32_t key, const struct dvbfe_parameters *request)
+{
+	int i;
+
+	for(i = 0; i < memo->count; i++) {
+		struct dvbtunememo_entry *e = &memo->entries[i];
+
+		if ((e->type == type) && (e->key == key) && memo_same(type, &e->request, request))
+			return e;
+	}
+
+	return NULL;
+}
+
+static void memo_remove(struct dvbtunememo *memo, struct dvbtunememo_entry *e)
+{
+	int i = e - memo->entries;
+
+	memmove(e, e + 1, (memo->count - i - 1) * sizeof(struct dvbtunememo_entry));
+	memo->count--;
+}
+
+static void memo_load(struct dvbtunememo *memo)
+{
+	struct dvbtunememo_entry e;
+	uint32_t request[DVBTUNEMEMO_FIELDS];
+	uint32_t tune[DVBTUNEMEMO_FIELDS];
+	char *line = NULL;
+	size_t line_size = 0;
+	unsigned int type;
+	FILE *f;
+	char *pos;
+	int i;
+
+	if ((f = fopen(memo->path, "r")) == NULL)
+		return;
+
+	while(getline(&line, &line_size, f) > 0) {
+		if (line[0] == '#')
+			continue;
+
+		pos = line;
+		type = strtoul(pos, &pos, 10);
+		e.key = strtoul(pos, &pos, 16);
+		for(i = 0; i < DVBTUNEMEMO_FIELDS; i++)
+			request[i] = strtoul(pos, &pos, 10);
+		for(i = 0; i < DVBTUNEMEMO_FIELDS; i++)
+			tune[i] = strtoul(pos, &pos, 10);
+		if ((type > DVBFE_TYPE_ATSC) || (*pos != '\n'))
+			continue;
+
+		e.type = type;
+		memo_unpack(e.type, request, &e.request);
+		memo_unpack(e.type, tune, &e.tune);
+		if (memo_find(memo, e.type, e.key, &e.request))
+			continue;
+		if (memo->count == memo->size)
+			break;
+		memo->entries[memo->count++] = e;
+	}
+
+	free(line);
+	fclose(f);
+}
+
+static void memo_save(struct dvbtunememo *memo)
+{
+	uint32_t v[DVBTUNEMEMO_FIELDS];
+	char *tmppath;
+	FILE *f;
+	int i, j;
+
+	if (memo->path == NULL)
+		return;
+	if (asprintf(&tmppath, "%s.tmp", memo->path) < 0)
+		return;
+	if ((f = fopen(tmppath, "w")) == NULL) {
+		free(tmppath);
+		return;
+	}
+
+	fprintf(f, "# type seckey request(%i) tune(%i)\n", DVBTUNEMEMO_FIELDS, DVBTUNEMEMO_FIELDS);
+	for(i = 0; i < memo->count; i++) {
+		struct dvbtunememo_entry *e = &memo->entries[i];
+
+		fprintf(f, "%i %x", e->type, e->key);
+		memo_pack(e->type, &e->request, v);
+		for(j = 0; j < DVBTUNEMEMO_FIELDS; j++)
+			fprintf(f, " %u", v[j]);
+		memo_pack(e->type, &e->tune, v);
+		for(j = 0; j < DVBTUNEMEMO_FIELDS; j++)
+			fprintf(f, " %u", v[j]);
+		fprintf(f, "\n");
+	}
+
+	// replace the old file whole, so a reader never sees half of one
+	if (fclose(f) || rename(tmppath, memo->path))
+		unlink(tmppath);
+	free(tmppath);
+}
+
+struct dvbtunememo *dvbtunememo_open(const char *path)
+{
+	struct dvbtunememo *memo;
+
+	if ((memo = calloc(1, sizeof(struct dvbtunememo))) == NULL)
+		return NULL;
+	memo->size = DVBTUNEMEMO_MAX_ENTRIES;
+	if ((memo->entries = malloc(memo->size * sizeof(struct dvbtunememo_entry))) == NULL) {
+		free(memo);
+		return NULL;
+	}
+	if (path != NULL) {
+		if ((memo->path = strdup(path)) == NULL) {
+			dvbtunememo_close(memo);
+			return NULL;
+		}
+		memo_load(memo);
+	}
+
+	return memo;
+}
+
+void dvbtunememo_close(struct dvbtunememo *memo)
+{
+	free(memo->entries);
+	free(memo->path);
+	free(memo);
+}
+
+int dvbtunememo_lookup(struct dvbtunememo *memo, enum dvbfe_type type, uint32_t key,
+		       const struct dvbfe_parameters *request,
+		       struct dvbfe_parameters *tune)
+{
+	struct dvbtunememo_entry *e;
+
+	if ((e = memo_find(memo, type, key, request)) == NULL) {
+		memcpy(tune, request, sizeof(struct dvbfe_parameters));
+		return 0;
+	}
+
+	return memo_apply(type, request, &e->tune, tune) ? 1 : 0;
+}
+
+void dvbtunememo_learn(struct dvbtunememo *memo, enum dvbfe_type type, uint32_t key,
+		       const struct dvbfe_parameters *request,
+		       const struct dvbfe_parameters *actual)
+{
+	struct dvbtunememo_entry *e;
+	struct dvbfe_parameters tune;
+
+	if (!memo_apply(type, request, actual, &tune))
+		return;
+
+	// the newest go at the end
+	if ((e = memo_find(memo, type, key, request)) != NULL) {
+		if (memo_same(type, &e->tune, &tune) && (e == &memo->entries[memo->count - 1]))
+			return;
+		memo_remove(memo, e);
+	} else if (memo->count == memo->size) {
+		memo_remove(memo, &memo->entries[0]);
+	}
+
+	e = &memo->entries[memo->count++];
+	e->type = type;
+	e->key = key;
+	memcpy(&e->request, request, sizeof(struct dvbfe_parameters));
+	memcpy(&e->tune, &tune, sizeof(struct dvbfe_parameters));
+	memo_save(memo);
+}
+
+void dvbtunememo_forget(struct dvbtunememo *memo, enum dvbfe_type type, uint32_t key,
+			const struct dvbfe_parameters *request)
+{
+	struct dvbtunememo_entry *e;
+
+	if ((e = memo_find(memo, type, key, request)) == NULL)
+		return;
+
+	memo_remove(memo, e);
+	memo_save(memo);
+}
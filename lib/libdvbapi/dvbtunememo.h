@@ -0,0 +1,124 @@
+/*
+ * libdvbtunememo - learned tuning parameters
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBTUNEMEMO_H
+#define LIBDVBTUNEMEMO_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libdvbapi/dvbfe.h>
+
+/**
+ * Channel lists often leave inversion, FEC, modulation and the like at
+ * AUTO, and many demodulators take hundreds of milliseconds longer to lock
+ * when they have to find them. A memo records, for each set of parameters
+ * asked for, what the frontend reported once it had locked, so that the
+ * next tune can ask for those values directly.
+ *
+ * A memo is attached to a frontend with dvbfe_set_tunememo(), after which
+ * dvbfe_set() and dvbfe_tune_start() use it by themselves: the remembered
+ * values replace the AUTO ones, and if the frontend has not locked
+ * DVBFE_TUNEMEMO_TRY_MS later the entry is dropped and the parameters are
+ * sent again as asked. Whenever a tune with AUTO values (still) in it
+ * locks, the values found are learned. Lock is noticed whenever the status
+ * is read through dvbfe: polling dvbfe_get_info() or dvbfe_get_stats()
+ * after a dvbfe_set() with a timeout of 0 is enough.
+ *
+ * Parameters asked for are told apart by the SEC state key too (see
+ * dvbfe_get_sec_state()), so one DVB-S IF frequency in different bands or
+ * polarisations has different entries.
+ *
+ * A memo with a file is loaded from it, and written back as it changes.
+ * The file is rewritten whole each time, so processes sharing one may lose
+ * each other's entries, which only costs a slower lock.
+ */
+struct dvbtunememo;
+
+/**
+ * Most entries a memo keeps. The oldest are dropped beyond it.
+ */
+#define DVBTUNEMEMO_MAX_ENTRIES 1024
+
+/**
+ * Open a memo.
+ *
+ * @param path File to load it from and save it to (it need not exist yet),
+ * or NULL to keep it in memory only.
+ * @return The memo, or NULL if out of memory.
+ */
+extern struct dvbtunememo *dvbtunememo_open(const char *path);
+
+/**
+ * Close a memo. Detach it from any frontends first.
+ *
+ * @param memo The memo.
+ */
+extern void dvbtunememo_close(struct dvbtunememo *memo);
+
+/**
+ * Look up the parameters to tune with for a request.
+ *
+ * @param memo The memo.
+ * @param type Type of the frontend.
+ * @param key SEC state key, or 0.
+ * @param request The parameters asked for.
+ * @param tune Where to put them with the AUTO values replaced.
+ * @return 1 if there was an entry which changed something, 0 if not (tune
+ * is then a copy of request).
+ */
+extern int dvbtunememo_lookup(struct dvbtunememo *memo, enum dvbfe_type type, uint32_t key,
+			      const struct dvbfe_parameters *request,
+			      struct dvbfe_parameters *tune);
+
+/**
+ * Learn what a request locked with.
+ *
+ * @param memo The memo.
+ * @param type Type of the frontend.
+ * @param key SEC state key, or 0.
+ * @param request The parameters asked for.
+ * @param actual The parameters read back from the locked frontend. Only the
+ * values the request left at AUTO are used; if none of them is known,
+ * nothing is learned.
+ */
+extern void dvbtunememo_learn(struct dvbtunememo *memo, enum dvbfe_type type, uint32_t key,
+			      const struct dvbfe_parameters *request,
+			      const struct dvbfe_parameters *actual);
+
+/**
+ * Forget a request's entry, e.g. because it no longer locks.
+ *
+ * @param memo The memo.
+ * @param type Type of the frontend.
+ * @param key SEC state key, or 0.
+ * @param request The parameters asked for.
+ */
+extern void dvbtunememo_forget(struct dvbtunememo *memo, enum dvbfe_type type, uint32_t key,
+			       const struct dvbfe_parameters *request);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
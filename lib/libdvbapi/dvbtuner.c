@@ -0,0 +1,455 @@
+/*
+ * libdvbtuner - tuner allocation between processes
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <linux/dvb/frontend.h>
+#include "dvbtopo.h"
+#include "dvbfepool.h"
+#include "dvbtuner.h"
+
+#define DVBTUNER_MAGIC		"DVBTUNER"
+#define DVBTUNER_VERSION	1
+#define DVBTUNER_SLOTS		256
+
+/*
+ * Lease file layout, host byte order: a header and a fixed table of slots,
+ * mapped shared by every user. Slots are only changed with the file
+ * flock()ed; the id of a slot is cleared last on revocation so that a
+ * holder can check it without the lock.
+ */
+struct dvbtuner_slot {
+	int32_t pid;			/* 0 => free */
+	int32_t adapter;
+	int32_t frontend;
+	int32_t priority;
+	int32_t flags;
+	uint32_t reserved;
+	uint64_t id;
+	struct dvbtuner_mux mux;
+};
+
+struct dvbtuner_registry {
+	char magic[8];
+	uint32_t version;
+	uint32_t slot_size;
+	uint32_t slot_count;
+	uint32_t reserved;
+	uint64_t next_id;
+	struct dvbtuner_slot slots[DVBTUNER_SLOTS];
+};
+
+struct dvbtuner_lease {
+	int fd;
+	struct dvbtuner_registry *registry;
+	struct dvbtuner_slot *slot;
+	uint64_t id;
+	int adapter;
+	int frontend;
+	int shared;
+};
+
+/* what is known about one frontend while choosing */
+struct dvbtuner_candidate {
+	int adapter;
+	int frontend;
+	int holders;
+	int max_priority;
+	int exclusive;
+	const struct dvbtuner_mux *mux;
+	int warm;			/* held free by dvbfepoold */
+};
+
+static struct dvbtuner_registry *dvbtuner_map(int *fdp)
+{
+	struct dvbtuner_registry *registry;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(DVBTUNER_LEASE_FILE, O_RDWR | O_CREAT | O_CLOEXEC, 0666)) < 0)
+		return NULL;
+	if (flock(fd, LOCK_EX) || fstat(fd, &st))
+		goto fail;
+
+	// a new file: it is used by everyone, whatever their umask
+	if (st.st_size == 0) {
+		fchmod(fd, 0666);
+		if (ftruncate(fd, sizeof(struct dvbtuner_registry)))
+			goto fail;
+	} else if (st.st_size != sizeof(struct dvbtuner_registry)) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	registry = mmap(NULL, sizeof(struct dvbtuner_registry), PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+	if (registry == MAP_FAILED)
+		goto fail;
+
+	if (st.st_size == 0) {
+		memcpy(registry->magic, DVBTUNER_MAGIC, sizeof(registry->magic));
+		registry->version = DVBTUNER_VERSION;
+		registry->slot_size = sizeof(struct dvbtuner_slot);
+		registry->slot_count = DVBTUNER_SLOTS;
+		registry->next_id = 1;
+	} else if (memcmp(registry->magic, DVBTUNER_MAGIC, sizeof(registry->magic)) ||
+		   (registry->version != DVBTUNER_VERSION) ||
+		   (registry->slot_size != sizeof(struct dvbtuner_slot)) ||
+		   (registry->slot_count != DVBTUNER_SLOTS)) {
+		munmap(registry, sizeof(struct dvbtuner_registry));
+		errno = EINVAL;
+		goto fail;
+	}
+
+	*fdp = fd;
+	return registry;
+
+fail:
+	close(fd);
+	return NULL;
+}
+
+static void dvbtuner_free_slot(struct dvbtuner_slot *slot)
+{
+	__atomic_store_n(&slot->id, 0, __ATOMIC_RELEASE);
+	slot->pid = 0;
+}
+
+static void dvbtuner_reap(struct dvbtuner_registry *registry)
+{
+	int i;
+
+	for(i=0; i < DVBTUNER_SLOTS; i++) {
+		struct dvbtuner_slot *slot = &registry->slots[i];
+
+		if (slot->pid && kill(slot->pid, 0) && (errno == ESRCH))
+			dvbtuner_free_slot(slot);
+	}
+}
+
+static int dvbtuner_same_mux(const struct dvbtuner_mux *a, const struct dvbtuner_mux *b)
+{
+	if ((a->type != b->type) ||
+	    (a->delivery_system != b->delivery_system) ||
+	    (a->frequency != b->frequency) ||
+	    (a->stream_id != b->stream_id))
+		return 0;
+
+	// the same frequency from another dish or polarization is not the same mux
+	if (a->type == DVBFE_TYPE_DVBS) {
+		if ((a->polarization != b->polarization) ||
+		    (a->diseqc_switch != b->diseqc_switch) ||
+		    strncmp(a->wiring, b->wiring, sizeof(a->wiring)))
+			return 0;
+	}
+
+	return 1;
+}
+
+static int dvbtuner_has_delsys(const struct dvbtopo_frontend *fe,
+			       enum dvbfe_delivery_system delivery_system)
+{
+	int sys;
+	int i;
+
+	switch(delivery_system) {
+	case DVBFE_DELSYS_DEFAULT:
+		return 1;
+#ifdef DTV_ENUM_DELSYS
+	case DVBFE_DELSYS_DVBS2:
+		sys = SYS_DVBS2;
+		break;
+	case DVBFE_DELSYS_DVBT2:
+		sys = SYS_DVBT2;
+		break;
+#endif
+	default:
+		return 0;
+	}
+
+	for(i=0; i < fe->delsys_count; i++) {
+		if (fe->delsys[i] == sys)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Is a frontend wired to a dish? A line for the frontend itself overrides
+ * the one for its adapter; with neither, it is wired to anything.
+ */
+static int dvbtuner_wired(int adapter, int frontend, const char *wiring)
+{
+	char line[256];
+	int adapter_match = -1;
+	int frontend_match = -1;
+	FILE *f;
+
+	if (wiring[0] == 0)
+		return 1;
+	if ((f = fopen(DVBTUNER_WIRING_FILE, "r")) == NULL)
+		return 1;
+
+	while(fgets(line, sizeof(line), f)) {
+		char *cur = line + strspn(line, " \t");
+		char *save;
+		char *end;
+		long a;
+		long fe = -1;
+		int match = 0;
+
+		if ((*cur == '#') || (*cur == '\n') || (*cur == 0))
+			continue;
+
+		a = strtol(cur, &end, 10);
+		if (end == cur)
+			continue;
+		if (*end == '.') {
+			cur = end + 1;
+			fe = strtol(cur, &end, 10);
+			if (end == cur)
+				continue;
+		}
+		if ((a != adapter) || ((fe != -1) && (fe != frontend)))
+			continue;
+
+		for(cur = strtok_r(end, " \t\n", &save); cur; cur = strtok_r(NULL, " \t\n", &save)) {
+			if (!strcmp(cur, wiring))
+				match = 1;
+		}
+		if (fe == -1)
+			adapter_match = match;
+		else
+			frontend_match = match;
+	}
+	fclose(f);
+
+	if (frontend_match != -1)
+		return frontend_match;
+	if (adapter_match != -1)
+		return adapter_match;
+	return 1;
+}
+
+static int dvbtuner_suitable(const struct dvbtuner_request *request,
+			     int adapter, const struct dvbtopo_frontend *fe)
+{
+	if ((request->adapter != -1) && (request->adapter != adapter))
+		return 0;
+	if ((request->frontend != -1) && (request->frontend != fe->id))
+		return 0;
+	if (fe->type != request->mux.type)
+		return 0;
+	if (!dvbtuner_has_delsys(fe, request->mux.delivery_system))
+		return 0;
+	return dvbtuner_wired(adapter, fe->id, request->mux.wiring);
+}
+
+static void dvbtuner_survey(struct dvbtuner_registry *registry, struct dvbtuner_candidate *c)
+{
+	int i;
+
+	c->holders = 0;
+	c->max_priority = 0;
+	c->exclusive = 0;
+	c->mux = NULL;
+	for(i=0; i < DVBTUNER_SLOTS; i++) {
+		struct dvbtuner_slot *slot = &registry->slots[i];
+
+		if ((slot->pid == 0) || (slot->adapter != c->adapter) ||
+		    (slot->frontend != c->frontend))
+			continue;
+		if ((c->holders == 0) || (slot->priority > c->max_priority))
+			c->max_priority = slot->priority;
+		if (slot->flags & DVBTUNER_EXCLUSIVE)
+			c->exclusive = 1;
+		c->mux = &slot->mux;
+		c->holders++;
+	}
+}
+
+static int dvbtuner_warm(const struct dvbfepool_frontend *warm, int warm_count,
+			 int adapter, int frontend)
+{
+	int i;
+
+	for(i=0; i < warm_count; i++) {
+		if ((warm[i].adapter == adapter) && (warm[i].frontend == frontend))
+			return !warm[i].in_use;
+	}
+	return 0;
+}
+
+static void dvbtuner_revoke(struct dvbtuner_registry *registry, int adapter, int frontend)
+{
+	int i;
+
+	for(i=0; i < DVBTUNER_SLOTS; i++) {
+		struct dvbtuner_slot *slot = &registry->slots[i];
+
+		if (slot->pid && (slot->adapter == adapter) && (slot->frontend == frontend))
+			dvbtuner_free_slot(slot);
+	}
+}
+
+struct dvbtuner_lease *dvbtuner_acquire(const struct dvbtuner_request *request, int flags)
+{
+	struct dvbtuner_candidate share, idle, victim;
+	struct dvbtuner_candidate *chosen = NULL;
+	struct dvbtuner_registry *registry;
+	struct dvbtuner_lease *lease;
+	struct dvbtuner_slot *slot = NULL;
+	struct dvbfepool_frontend warm[DVBFEPOOL_MAX_FRONTENDS];
+	struct dvbtopo *topo;
+	int warm_count;
+	int suitable = 0;
+	int fd;
+	int i, j;
+
+	if ((topo = dvbtopo_open(0)) == NULL)
+		return NULL;
+	if ((registry = dvbtuner_map(&fd)) == NULL) {
+		dvbtopo_close(topo);
+		return NULL;
+	}
+	dvbtuner_reap(registry);
+	if ((warm_count = dvbfepool_list(warm, DVBFEPOOL_MAX_FRONTENDS)) < 0)
+		warm_count = 0;
+
+	share.adapter = idle.adapter = victim.adapter = -1;
+	for(i=0; i < dvbtopo_adapter_count(topo); i++) {
+		const struct dvbtopo_adapter *adapter = dvbtopo_adapter(topo, i);
+
+		for(j=0; j < adapter->frontend_count; j++) {
+			struct dvbtuner_candidate c;
+
+			if (!dvbtuner_suitable(request, adapter->id, &adapter->frontends[j]))
+				continue;
+			suitable++;
+
+			c.adapter = adapter->id;
+			c.frontend = adapter->frontends[j].id;
+			dvbtuner_survey(registry, &c);
+			c.warm = dvbtuner_warm(warm, warm_count, c.adapter, c.frontend);
+
+			if (c.holders == 0) {
+				if ((idle.adapter == -1) || (c.warm && !idle.warm))
+					idle = c;
+			} else if (!c.exclusive && !(flags & DVBTUNER_EXCLUSIVE) &&
+				   dvbtuner_same_mux(c.mux, &request->mux)) {
+				if (share.adapter == -1)
+					share = c;
+			} else if ((c.max_priority < request->priority) &&
+				   ((victim.adapter == -1) || (c.max_priority < victim.max_priority))) {
+				victim = c;
+			}
+		}
+	}
+	dvbtopo_close(topo);
+
+	if (share.adapter != -1)
+		chosen = &share;
+	else if (idle.adapter != -1)
+		chosen = &idle;
+	else if ((flags & DVBTUNER_PREEMPT) && (victim.adapter != -1)) {
+		dvbtuner_revoke(registry, victim.adapter, victim.frontend);
+		chosen = &victim;
+		chosen->holders = 0;
+	}
+	if (chosen == NULL) {
+		errno = suitable ? EBUSY : ENODEV;
+		goto fail;
+	}
+
+	for(i=0; i < DVBTUNER_SLOTS; i++) {
+		if (registry->slots[i].pid == 0) {
+			slot = &registry->slots[i];
+			break;
+		}
+	}
+	if ((slot == NULL) || ((lease = malloc(sizeof(struct dvbtuner_lease))) == NULL)) {
+		errno = slot ? ENOMEM : EBUSY;
+		goto fail;
+	}
+
+	slot->pid = getpid();
+	slot->adapter = chosen->adapter;
+	slot->frontend = chosen->frontend;
+	slot->priority = request->priority;
+	slot->flags = flags & DVBTUNER_EXCLUSIVE;
+	slot->mux = request->mux;
+	lease->id = registry->next_id++;
+	__atomic_store_n(&slot->id, lease->id, __ATOMIC_RELEASE);
+	flock(fd, LOCK_UN);
+
+	lease->fd = fd;
+	lease->registry = registry;
+	lease->slot = slot;
+	lease->adapter = chosen->adapter;
+	lease->frontend = chosen->frontend;
+	lease->shared = chosen->holders != 0;
+	return lease;
+
+fail:
+	i = errno;
+	munmap(registry, sizeof(struct dvbtuner_registry));
+	close(fd);
+	errno = i;
+	return NULL;
+}
+
+void dvbtuner_release(struct dvbtuner_lease *lease)
+{
+	flock(lease->fd, LOCK_EX);
+	if (__atomic_load_n(&lease->slot->id, __ATOMIC_ACQUIRE) == lease->id)
+		dvbtuner_free_slot(lease->slot);
+	munmap(lease->registry, sizeof(struct dvbtuner_registry));
+	close(lease->fd);
+	free(lease);
+}
+
+int dvbtuner_lease_adapter(struct dvbtuner_lease *lease)
+{
+	return lease->adapter;
+}
+
+int dvbtuner_lease_frontend(struct dvbtuner_lease *lease)
+{
+	return lease->frontend;
+}
+
+int dvbtuner_lease_shared(struct dvbtuner_lease *lease)
+{
+	return lease->shared;
+}
+
+int dvbtuner_lease_revoked(struct dvbtuner_lease *lease)
+{
+	return __atomic_load_n(&lease->slot->id, __ATOMIC_ACQUIRE) != lease->id;
+}
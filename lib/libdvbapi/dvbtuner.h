@@ -0,0 +1,144 @@
+/*
+ * libdvbtuner - tuner allocation between processes
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBTUNER_H
+#define LIBDVBTUNER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libdvbapi/dvbfe.h>
+
+/**
+ * Tuners are handed out as leases, recorded in DVBTUNER_LEASE_FILE so that
+ * every process on the host sees the same picture. A request names the
+ * multiplex it wants; it is given, in order of preference:
+ *
+ *  - a frontend already tuned to that multiplex, shared with its holders
+ *    (unless either side asked for DVBTUNER_EXCLUSIVE);
+ *  - a free frontend that can receive it, one kept warm by dvbfepoold (see
+ *    libdvbfepool) before the others;
+ *  - with DVBTUNER_PREEMPT, the frontend whose holders have the lowest
+ *    priority, if that is below the request's. Their leases are revoked;
+ *    they find out through dvbtuner_lease_revoked() and should let go.
+ *
+ * A frontend can receive a multiplex if it is of the right type, lists the
+ * delivery system (see libdvbtopo), and is wired to the right satellite.
+ * The wiring is read from DVBTUNER_WIRING_FILE, lines of
+ *
+ *   <adapter>[.<frontend>] <wiring> [<wiring>...]
+ *
+ * where a wiring is whatever the caller uses to name a dish, normally the
+ * libdvbsec configuration id. A frontend without a line is taken to be
+ * wired to anything.
+ *
+ * Leases of processes that have died are cleared on the next request.
+ */
+
+#define DVBTUNER_LEASE_FILE "/run/dvbtuner.leases"
+#define DVBTUNER_WIRING_FILE "/etc/dvb/wiring.conf"
+
+/**
+ * Flags for dvbtuner_acquire().
+ */
+#define DVBTUNER_EXCLUSIVE	1	/* do not share the frontend (e.g. to retune it) */
+#define DVBTUNER_PREEMPT	2	/* take a frontend from lower priority holders */
+
+/**
+ * What identifies a multiplex for sharing.
+ */
+struct dvbtuner_mux {
+	enum dvbfe_type type;
+	enum dvbfe_delivery_system delivery_system;
+	uint32_t frequency;
+	uint32_t stream_id;
+	char polarization;		/* DVB-S only, 0 otherwise */
+	int diseqc_switch;		/* DVB-S only */
+	char wiring[32];		/* dish it comes from, "" => any */
+};
+
+/**
+ * A request for a tuner.
+ */
+struct dvbtuner_request {
+	struct dvbtuner_mux mux;
+	int priority;			/* higher wins with DVBTUNER_PREEMPT */
+	int adapter;			/* -1 => any */
+	int frontend;			/* -1 => any */
+};
+
+/**
+ * Opaque lease handle.
+ */
+struct dvbtuner_lease;
+
+/**
+ * Lease a frontend for a multiplex.
+ *
+ * @param request What is wanted.
+ * @param flags DVBTUNER_* flags.
+ * @return The lease, or NULL on failure, with errno EBUSY if every suitable
+ * frontend is taken, or ENODEV if there is no suitable frontend at all.
+ */
+extern struct dvbtuner_lease *dvbtuner_acquire(const struct dvbtuner_request *request, int flags);
+
+/**
+ * Give a lease back.
+ *
+ * @param lease The lease.
+ */
+extern void dvbtuner_release(struct dvbtuner_lease *lease);
+
+/**
+ * @param lease The lease.
+ * @return Adapter number of the leased frontend.
+ */
+extern int dvbtuner_lease_adapter(struct dvbtuner_lease *lease);
+
+/**
+ * @param lease The lease.
+ * @return Frontend number of the leased frontend.
+ */
+extern int dvbtuner_lease_frontend(struct dvbtuner_lease *lease);
+
+/**
+ * @param lease The lease.
+ * @return 1 if the frontend was already tuned to the multiplex by another
+ * holder, so it must be left alone (opened read only, and not tuned).
+ */
+extern int dvbtuner_lease_shared(struct dvbtuner_lease *lease);
+
+/**
+ * Check whether a lease was taken away by a higher priority request. This
+ * is a memory read, cheap enough for every pass of a main loop.
+ *
+ * @param lease The lease.
+ * @return 1 if it was revoked.
+ */
+extern int dvbtuner_lease_revoked(struct dvbtuner_lease *lease);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
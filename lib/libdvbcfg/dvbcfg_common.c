@@ -21,29 +21,41 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include "dvbcfg_common.h"
 
-int dvbcfg_parse_int(char **text, char *tokens)
+/*
+ * Cut the next field off text in one pass: the separator (if any) is
+ * replaced by a terminator and *text moved past it. Returns the field and
+ * its length.
+ */
+static char *dvbcfg_next_token(char **text, const char *tokens, size_t *length)
 {
 	char *start = *text;
-	char *stop = *text;
-	int value;
-
-	while (*stop != '\0') {
-		if (strchr(tokens, *stop) != NULL) {
-			*stop = '\0';
-			stop++;
-			break;
-		}
+	char *stop = start + strcspn(start, tokens);
+
+	*length = stop - start;
+	if (*stop != '\0') {
+		*stop = '\0';
 		stop++;
 	}
+	*text = stop;
+	return start;
+}
 
-	if (sscanf(start, "%i", &value) == 1) {
-		*text = stop;
+int dvbcfg_parse_int(char **text, char *tokens)
+{
+	size_t length;
+	char *start = dvbcfg_next_token(text, tokens, &length);
+	char *end;
+	long value;
+
+	/* as sscanf("%i") would, without the stdio machinery */
+	value = strtol(start, &end, 0);
+	if (end != start)
 		return value;
-	}
 
 	*text = NULL;
 	return -1;
@@ -51,23 +63,11 @@ int dvbcfg_parse_int(char **text, char *tokens)
 
 int dvbcfg_parse_char(char **text, char *tokens)
 {
-	char *start = *text;
-	char *stop = *text;
-	char value;
-
-	while (*stop != '\0') {
-		if (strchr(tokens, *stop) != NULL) {
-			*stop = '\0';
-			stop++;
-			break;
-		}
-		stop++;
-	}
+	size_t length;
+	char *start = dvbcfg_next_token(text, tokens, &length);
 
-	if (sscanf(start, "%c", &value) == 1) {
-		*text = stop;
-		return value;
-	}
+	if (length)
+		return *start;
 
 	*text = NULL;
 	return -1;
@@ -75,23 +75,15 @@ int dvbcfg_parse_char(char **text, char *tokens)
 
 int dvbcfg_parse_setting(char **text, char *tokens, const struct dvbcfg_setting *settings)
 {
-	char *start = *text;
-	char *stop = *text;
-
-	while (*stop != '\0') {
-		if (strchr(tokens, *stop) != NULL) {
-			*stop = '\0';
-			stop++;
-			break;
-		}
-		stop++;
-	}
+	size_t length;
+	char *start = dvbcfg_next_token(text, tokens, &length);
 
+	/* the tables are short; the first character and length reject most names */
 	while (settings->name) {
-		if (strcmp(start, settings->name) == 0) {
-			*text = stop;
+		if ((settings->name[0] == start[0]) &&
+		    (strncmp(settings->name, start, length) == 0) &&
+		    (settings->name[length] == '\0'))
 			return settings->value;
-		}
 		settings++;
 	}
 
@@ -102,26 +94,15 @@ int dvbcfg_parse_setting(char **text, char *tokens, const struct dvbcfg_setting
 void dvbcfg_parse_string(char **text, char *tokens, char *dest, unsigned long size)
 {
 	char *start = *text;
-	char *stop = *text;
-	unsigned long length;
-
-	while ((*stop != '\0') && (strchr(tokens, *stop) == NULL))
-		stop++;
+	size_t length = strcspn(start, tokens);
 
-	length = (stop - start) + 1;
-
-	if (length <= size) {
-		if (strchr(tokens, *stop) != NULL) {
-			*stop = '\0';
-			*text = stop + 1;
-		} else
-			*text = stop;
-			memcpy(dest, start, length);
-			return;
+	if ((length + 1) > size) {
+		*text = NULL;
+		return;
 	}
 
-	*text = NULL;
-	return;
+	dvbcfg_next_token(text, tokens, &length);
+	memcpy(dest, start, length + 1);
 }
 
 const char *dvbcfg_lookup_setting(unsigned int setting, const struct dvbcfg_setting *settings)
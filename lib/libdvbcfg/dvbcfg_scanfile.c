@@ -23,6 +23,7 @@
 #define _GNU_SOURCE
 
 #include <malloc.h>
+#include <string.h>
 #include <ctype.h>
 
 #include "dvbcfg_scanfile.h"
@@ -116,6 +117,9 @@ int dvbcfg_scanfile_parse(FILE *file, dvbcfg_scancallback callback, void *privat
 		char *line_pos = line_buf;
 		struct dvbcfg_scanfile tmp;
 
+		/* unused (second generation) parameters stay zero */
+		memset(&tmp, 0, sizeof(tmp));
+
 		/* remove newline and comments (started with hashes) */
 		while ((*line_tmp != '\0') && (*line_tmp != '\n') && (*line_tmp != '#'))
 			line_tmp++;
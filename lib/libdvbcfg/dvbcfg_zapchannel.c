@@ -22,6 +22,7 @@
 
 #define _GNU_SOURCE
 
+#include <errno.h>
 #include <malloc.h>
 #include <string.h>
 #include <ctype.h>
@@ -112,181 +113,193 @@ static const struct dvbcfg_setting dvbcfg_atsc_modulation_list[] = {
 	{ NULL, 0 }
 };
 
-int dvbcfg_zapchannel_parse(FILE *file, dvbcfg_zapcallback callback, void *private_data)
+int dvbcfg_zapchannel_parse_line(char *line, struct dvbcfg_zapchannel *channel)
 {
-	char *line_buf = NULL;
-	size_t line_size = 0;
-	int line_len = 0;
-	int ret_val = 0;
+	char *line_tmp = line;
+	char *line_pos = line;
+
+	/* unused (second generation) parameters stay zero */
+	memset(channel, 0, sizeof(struct dvbcfg_zapchannel));
+
+	/* remove newline and comments (started with hashes) */
+	while ((*line_tmp != '\0') && (*line_tmp != '\n') && (*line_tmp != '#'))
+		line_tmp++;
+	*line_tmp = '\0';
+
+	/* parse name */
+	dvbcfg_parse_string(&line_pos, ":", channel->name, sizeof(channel->name));
+	if (!line_pos)
+		return -EINVAL;
+
+	/* parse frequency */
+	channel->fe_params.frequency = dvbcfg_parse_int(&line_pos, ":");
+	if (!line_pos)
+		return -EINVAL;
+
+	/* try to determine frontend type */
+	if (strstr(line_pos, ":FEC_")) {
+		if (strstr(line_pos, ":HIERARCHY_"))
+			channel->fe_type = DVBFE_TYPE_DVBT;
+		else
+			channel->fe_type = DVBFE_TYPE_DVBC;
+	} else {
+		if (strstr(line_pos, "VSB:") || strstr(line_pos, "QAM_"))
+			channel->fe_type = DVBFE_TYPE_ATSC;
+		else
+			channel->fe_type = DVBFE_TYPE_DVBS;
+	}
 
-	while ((line_len = getline(&line_buf, &line_size, file)) > 0) {
-		char *line_tmp = line_buf;
-		char *line_pos = line_buf;
-		struct dvbcfg_zapchannel tmp;
+	/* parse frontend specific settings */
+	switch (channel->fe_type) {
+	case DVBFE_TYPE_ATSC:
+		/* inversion */
+		channel->fe_params.inversion = DVBFE_INVERSION_AUTO;
+
+		/* modulation */
+		channel->fe_params.u.atsc.modulation =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_atsc_modulation_list);
+		if (!line_pos)
+			return -EINVAL;
 
-		/* remove newline and comments (started with hashes) */
-		while ((*line_tmp != '\0') && (*line_tmp != '\n') && (*line_tmp != '#'))
-			line_tmp++;
-		*line_tmp = '\0';
+		break;
 
-		/* parse name */
-		dvbcfg_parse_string(&line_pos, ":", tmp.name, sizeof(tmp.name));
+	case DVBFE_TYPE_DVBC:
+		/* inversion */
+		channel->fe_params.inversion =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_inversion_list);
 		if (!line_pos)
-			continue;
+			return -EINVAL;
 
-		/* parse frequency */
-		tmp.fe_params.frequency = dvbcfg_parse_int(&line_pos, ":");
+		/* symbol rate */
+		channel->fe_params.u.dvbc.symbol_rate = dvbcfg_parse_int(&line_pos, ":");
 		if (!line_pos)
-			continue;
+			return -EINVAL;
 
-		/* try to determine frontend type */
-		if (strstr(line_pos, ":FEC_")) {
-			if (strstr(line_pos, ":HIERARCHY_"))
-				tmp.fe_type = DVBFE_TYPE_DVBT;
-			else
-				tmp.fe_type = DVBFE_TYPE_DVBC;
-		} else {
-			if (strstr(line_pos, "VSB:") || strstr(line_pos, "QAM_"))
-				tmp.fe_type = DVBFE_TYPE_ATSC;
-			else
-				tmp.fe_type = DVBFE_TYPE_DVBS;
-		}
+		/* fec */
+		channel->fe_params.u.dvbc.fec_inner =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_fec_list);
+		if (!line_pos)
+			return -EINVAL;
 
-		/* parse frontend specific settings */
-		switch (tmp.fe_type) {
-		case DVBFE_TYPE_ATSC:
-			/* inversion */
-			tmp.fe_params.inversion = DVBFE_INVERSION_AUTO;
+		/* modulation */
+		channel->fe_params.u.dvbc.modulation =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_dvbc_modulation_list);
+		if (!line_pos)
+			return -EINVAL;
 
-			/* modulation */
-			tmp.fe_params.u.atsc.modulation =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_atsc_modulation_list);
-			if (!line_pos)
-				continue;
+		break;
 
-			break;
+	case DVBFE_TYPE_DVBS:
+		/* adjust frequency */
+		channel->fe_params.frequency *= 1000;
 
-		case DVBFE_TYPE_DVBC:
-			/* inversion */
-			tmp.fe_params.inversion =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_inversion_list);
-			if (!line_pos)
-				continue;
-
-			/* symbol rate */
-			tmp.fe_params.u.dvbc.symbol_rate = dvbcfg_parse_int(&line_pos, ":");
-			if (!line_pos)
-				continue;
-
-			/* fec */
-			tmp.fe_params.u.dvbc.fec_inner =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_fec_list);
-			if (!line_pos)
-				continue;
-
-			/* modulation */
-			tmp.fe_params.u.dvbc.modulation =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_dvbc_modulation_list);
-			if (!line_pos)
-				continue;
+		/* inversion */
+		channel->fe_params.inversion = DVBFE_INVERSION_AUTO;
 
-			break;
+		/* fec */
+		channel->fe_params.u.dvbs.fec_inner = DVBFE_FEC_AUTO;
 
-		case DVBFE_TYPE_DVBS:
-			/* adjust frequency */
-			tmp.fe_params.frequency *= 1000;
-
-			/* inversion */
-			tmp.fe_params.inversion = DVBFE_INVERSION_AUTO;
-
-			/* fec */
-			tmp.fe_params.u.dvbs.fec_inner = DVBFE_FEC_AUTO;
-
-			/* polarization */
-			tmp.polarization = tolower(dvbcfg_parse_char(&line_pos, ":"));
-			if (!line_pos)
-				continue;
-			if ((tmp.polarization != 'h') &&
-			    (tmp.polarization != 'v') &&
-			    (tmp.polarization != 'l') &&
-			    (tmp.polarization != 'r'))
-				continue;
-
-			/* satellite switch position */
-			tmp.diseqc_switch = dvbcfg_parse_int(&line_pos, ":");
-			if (!line_pos)
-				continue;
-
-			/* symbol rate */
-			tmp.fe_params.u.dvbs.symbol_rate =
-				dvbcfg_parse_int(&line_pos, ":") * 1000;
-			if (!line_pos)
-				continue;
+		/* polarization */
+		channel->polarization = tolower(dvbcfg_parse_char(&line_pos, ":"));
+		if (!line_pos)
+			return -EINVAL;
+		if ((channel->polarization != 'h') &&
+		    (channel->polarization != 'v') &&
+		    (channel->polarization != 'l') &&
+		    (channel->polarization != 'r'))
+			return -EINVAL;
+
+		/* satellite switch position */
+		channel->diseqc_switch = dvbcfg_parse_int(&line_pos, ":");
+		if (!line_pos)
+			return -EINVAL;
 
-			break;
+		/* symbol rate */
+		channel->fe_params.u.dvbs.symbol_rate =
+			dvbcfg_parse_int(&line_pos, ":") * 1000;
+		if (!line_pos)
+			return -EINVAL;
 
-		case DVBFE_TYPE_DVBT:
-			/* inversion */
-			tmp.fe_params.inversion =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_inversion_list);
-			if (!line_pos)
-				continue;
-
-			/* bandwidth */
-			tmp.fe_params.u.dvbt.bandwidth =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_bandwidth_list);
-			if (!line_pos)
-				continue;
-
-			/* fec hp */
-			tmp.fe_params.u.dvbt.code_rate_HP =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_fec_list);
-			if (!line_pos)
-				continue;
-
-			/* fec lp */
-			tmp.fe_params.u.dvbt.code_rate_LP =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_fec_list);
-			if (!line_pos)
-				continue;
-
-			/* constellation */
-			tmp.fe_params.u.dvbt.constellation =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_constellation_list);
-			if (!line_pos)
-				continue;
-
-			/* transmission mode */
-			tmp.fe_params.u.dvbt.transmission_mode =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_transmission_mode_list);
-			if (!line_pos)
-				continue;
-
-			/* guard interval */
-			tmp.fe_params.u.dvbt.guard_interval =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_guard_interval_list);
-			if (!line_pos)
-				continue;
-
-			/* hierarchy */
-			tmp.fe_params.u.dvbt.hierarchy_information =
-				dvbcfg_parse_setting(&line_pos, ":", dvbcfg_hierarchy_list);
-			if (!line_pos)
-				continue;
+		break;
 
-			break;
-		}
+	case DVBFE_TYPE_DVBT:
+		/* inversion */
+		channel->fe_params.inversion =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_inversion_list);
+		if (!line_pos)
+			return -EINVAL;
 
-		/* parse video and audio pids and service id */
-		tmp.video_pid = dvbcfg_parse_int(&line_pos, ":");
+		/* bandwidth */
+		channel->fe_params.u.dvbt.bandwidth =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_bandwidth_list);
 		if (!line_pos)
-			continue;
-		tmp.audio_pid = dvbcfg_parse_int(&line_pos, ":");
+			return -EINVAL;
+
+		/* fec hp */
+		channel->fe_params.u.dvbt.code_rate_HP =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_fec_list);
+		if (!line_pos)
+			return -EINVAL;
+
+		/* fec lp */
+		channel->fe_params.u.dvbt.code_rate_LP =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_fec_list);
+		if (!line_pos)
+			return -EINVAL;
+
+		/* constellation */
+		channel->fe_params.u.dvbt.constellation =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_constellation_list);
 		if (!line_pos)
+			return -EINVAL;
+
+		/* transmission mode */
+		channel->fe_params.u.dvbt.transmission_mode =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_transmission_mode_list);
+		if (!line_pos)
+			return -EINVAL;
+
+		/* guard interval */
+		channel->fe_params.u.dvbt.guard_interval =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_guard_interval_list);
+		if (!line_pos)
+			return -EINVAL;
+
+		/* hierarchy */
+		channel->fe_params.u.dvbt.hierarchy_information =
+			dvbcfg_parse_setting(&line_pos, ":", dvbcfg_hierarchy_list);
+		if (!line_pos)
+			return -EINVAL;
+
+		break;
+	}
+
+	/* parse video and audio pids and service id */
+	channel->video_pid = dvbcfg_parse_int(&line_pos, ":");
+	if (!line_pos)
+		return -EINVAL;
+	channel->audio_pid = dvbcfg_parse_int(&line_pos, ":");
+	if (!line_pos)
+		return -EINVAL;
+	channel->service_id = dvbcfg_parse_int(&line_pos, ":");
+	if (!line_pos) /* old files don't have a service id */
+		channel->service_id = 0;
+
+	return 0;
+}
+
+int dvbcfg_zapchannel_parse(FILE *file, dvbcfg_zapcallback callback, void *private_data)
+{
+	char *line_buf = NULL;
+	size_t line_size = 0;
+	int line_len = 0;
+	int ret_val = 0;
+
+	while ((line_len = getline(&line_buf, &line_size, file)) > 0) {
+		struct dvbcfg_zapchannel tmp;
+
+		if (dvbcfg_zapchannel_parse_line(line_buf, &tmp))
 			continue;
-		tmp.service_id = dvbcfg_parse_int(&line_pos, ":");
-		if (!line_pos) /* old files don't have a service id */
-			tmp.service_id = 0;
 
 		/* invoke callback */
 		if ((ret_val = callback(&tmp, private_data)) != 0) {
@@ -302,79 +315,140 @@ int dvbcfg_zapchannel_parse(FILE *file, dvbcfg_zapcallback callback, void *priva
 	return ret_val;
 }
 
-int dvbcfg_zapchannel_save(FILE *file, dvbcfg_zapcallback callback, void *private_data)
+/*
+ * Appenders for dvbcfg_zapchannel_format(): each writes a field and its
+ * separator, and returns where the next field goes, or NULL if it did not
+ * fit (which then carries through the rest of the line).
+ */
+static char *dvbcfg_put_string(char *pos, char *end, const char *string, char separator)
 {
-	int ret_val = 0;
-	struct dvbcfg_zapchannel tmp;
+	size_t length;
 
-	while ((ret_val = callback(&tmp, private_data)) == 0) {
-		/* name */
-		if ((ret_val = fprintf(file, "%s:", tmp.name)) < 0)
-			return ret_val;
-
-		/* frontend specific settings */
-		switch (tmp.fe_type) {
-		case DVBFE_TYPE_ATSC:
-			if ((ret_val = fprintf(file, "%i:%s:",
-			    tmp.fe_params.frequency,
-			    dvbcfg_lookup_setting(tmp.fe_params.u.atsc.modulation,
-						  dvbcfg_atsc_modulation_list))) < 0)
-				return ret_val;
+	if ((pos == NULL) || (string == NULL))
+		return NULL;
 
-			break;
+	length = strlen(string);
+	if ((size_t) (end - pos) < (length + 1))
+		return NULL;
 
-		case DVBFE_TYPE_DVBC:
-			if ((ret_val = fprintf(file, "%i:%s:%i:%s:%s:",
-			    tmp.fe_params.frequency,
-			    dvbcfg_lookup_setting(tmp.fe_params.inversion,
-						  dvbcfg_inversion_list),
-			    tmp.fe_params.u.dvbc.symbol_rate,
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbc.fec_inner,
-						  dvbcfg_fec_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbc.modulation,
-						  dvbcfg_dvbc_modulation_list))) < 0)
-				return ret_val;
+	memcpy(pos, string, length);
+	pos[length] = separator;
+	return pos + length + 1;
+}
 
-			break;
+static char *dvbcfg_put_int(char *pos, char *end, int value, char separator)
+{
+	char digits[12];
+	char *digit = digits + sizeof(digits);
+	unsigned int magnitude = (value < 0) ? -(unsigned int) value : (unsigned int) value;
+
+	*--digit = '\0';
+	do {
+		*--digit = '0' + (magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude);
+	if (value < 0)
+		*--digit = '-';
+
+	return dvbcfg_put_string(pos, end, digit, separator);
+}
 
-		case DVBFE_TYPE_DVBS:
-			if ((ret_val = fprintf(file, "%i:%c:%i:%i:",
-			    tmp.fe_params.frequency / 1000,
-			    tolower(tmp.polarization),
-			    tmp.diseqc_switch,
-			    tmp.fe_params.u.dvbs.symbol_rate / 1000)) < 0)
-				return ret_val;
+static char *dvbcfg_put_setting(char *pos, char *end, unsigned int setting,
+				const struct dvbcfg_setting *settings, char separator)
+{
+	return dvbcfg_put_string(pos, end, dvbcfg_lookup_setting(setting, settings), separator);
+}
 
-			break;
-		case DVBFE_TYPE_DVBT:
-			if ((ret_val = fprintf(file, "%i:%s:%s:%s:%s:%s:%s:%s:%s:",
-			    tmp.fe_params.frequency,
-			    dvbcfg_lookup_setting(tmp.fe_params.inversion,
-						  dvbcfg_inversion_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.bandwidth,
-						  dvbcfg_bandwidth_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.code_rate_HP,
-						  dvbcfg_fec_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.code_rate_LP,
-						  dvbcfg_fec_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.constellation,
-						  dvbcfg_constellation_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.transmission_mode,
-						  dvbcfg_transmission_mode_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.guard_interval,
-						  dvbcfg_guard_interval_list),
-			    dvbcfg_lookup_setting(tmp.fe_params.u.dvbt.hierarchy_information,
-						  dvbcfg_hierarchy_list))) < 0)
-				return ret_val;
+int dvbcfg_zapchannel_format(const struct dvbcfg_zapchannel *channel, char *buf, size_t size)
+{
+	const struct dvbfe_parameters *fe_params = &channel->fe_params;
+	char *end = buf + size;
+	char *pos = buf;
+
+	/* the name must not break the line up */
+	if ((memchr(channel->name, '\0', sizeof(channel->name)) == NULL) ||
+	    strpbrk(channel->name, ":#\n"))
+		return -EINVAL;
+
+	/* name */
+	pos = dvbcfg_put_string(pos, end, channel->name, ':');
+
+	/* frontend specific settings */
+	switch (channel->fe_type) {
+	case DVBFE_TYPE_ATSC:
+		pos = dvbcfg_put_int(pos, end, fe_params->frequency, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.atsc.modulation,
+					 dvbcfg_atsc_modulation_list, ':');
+		break;
+
+	case DVBFE_TYPE_DVBC:
+		pos = dvbcfg_put_int(pos, end, fe_params->frequency, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->inversion,
+					 dvbcfg_inversion_list, ':');
+		pos = dvbcfg_put_int(pos, end, fe_params->u.dvbc.symbol_rate, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbc.fec_inner,
+					 dvbcfg_fec_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbc.modulation,
+					 dvbcfg_dvbc_modulation_list, ':');
+		break;
+
+	case DVBFE_TYPE_DVBS:
+		pos = dvbcfg_put_int(pos, end, fe_params->frequency / 1000, ':');
+		if (pos && (pos + 2 <= end)) {
+			*pos++ = tolower(channel->polarization);
+			*pos++ = ':';
+		} else
+			pos = NULL;
+		pos = dvbcfg_put_int(pos, end, channel->diseqc_switch, ':');
+		pos = dvbcfg_put_int(pos, end, fe_params->u.dvbs.symbol_rate / 1000, ':');
+		break;
+
+	case DVBFE_TYPE_DVBT:
+		pos = dvbcfg_put_int(pos, end, fe_params->frequency, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->inversion,
+					 dvbcfg_inversion_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.bandwidth,
+					 dvbcfg_bandwidth_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.code_rate_HP,
+					 dvbcfg_fec_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.code_rate_LP,
+					 dvbcfg_fec_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.constellation,
+					 dvbcfg_constellation_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.transmission_mode,
+					 dvbcfg_transmission_mode_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.guard_interval,
+					 dvbcfg_guard_interval_list, ':');
+		pos = dvbcfg_put_setting(pos, end, fe_params->u.dvbt.hierarchy_information,
+					 dvbcfg_hierarchy_list, ':');
+		break;
+	}
 
-			break;
-		}
+	/* video and audio pids and service id */
+	pos = dvbcfg_put_int(pos, end, channel->video_pid, ':');
+	pos = dvbcfg_put_int(pos, end, channel->audio_pid, ':');
+	pos = dvbcfg_put_int(pos, end, channel->service_id, '\n');
+
+	/* room for the terminator too; a full size buffer only fails on a bad setting */
+	if ((pos == NULL) || (pos == end))
+		return (size >= DVBCFG_ZAPCHANNEL_LINE_MAX) ? -EINVAL : -ENOSPC;
+	*pos = '\0';
 
-		/* video and audio pids and service id */
-		if ((ret_val = fprintf(file, "%i:%i:%i\n",
-		    tmp.video_pid, tmp.audio_pid, tmp.service_id)) < 0)
-			return ret_val;
+	return pos - buf;
+}
 
+int dvbcfg_zapchannel_save(FILE *file, dvbcfg_zapcallback callback, void *private_data)
+{
+	char line[DVBCFG_ZAPCHANNEL_LINE_MAX];
+	int ret_val = 0;
+	int line_len;
+	struct dvbcfg_zapchannel tmp;
+
+	while ((ret_val = callback(&tmp, private_data)) == 0) {
+		if ((line_len = dvbcfg_zapchannel_format(&tmp, line, sizeof(line))) < 0)
+			return line_len;
+		if (fwrite(line, line_len, 1, file) != 1)
+			return -EIO;
 	}
 
 	if (ret_val < 0)
@@ -41,6 +41,11 @@ struct dvbcfg_zapchannel {
 	int diseqc_switch; /* only used for dvb-s */
 };
 
+/**
+ * Longest line dvbcfg_zapchannel_format() produces, with its terminator.
+ */
+#define DVBCFG_ZAPCHANNEL_LINE_MAX 512
+
 /**
  * Callback used in dvbcfg_zapchannel_parse() and dvbcfg_zapchannel_save()
  *
@@ -60,6 +65,28 @@ typedef int (*dvbcfg_zapcallback)(struct dvbcfg_zapchannel *channel, void *priva
  */
 extern int dvbcfg_zapchannel_parse(FILE *file, dvbcfg_zapcallback callback, void *private_data);
 
+/**
+ * Parse one line of a linuxtv channel file. The line is modified.
+ *
+ * @param line The line, with or without its newline
+ * @param channel Where to put the channel
+ * @return 0 on success, -EINVAL if the line holds no channel
+ */
+extern int dvbcfg_zapchannel_parse_line(char *line, struct dvbcfg_zapchannel *channel);
+
+/**
+ * Format a channel as a line of a linuxtv channel file, newline included,
+ * as dvbcfg_zapchannel_save() writes it.
+ *
+ * @param channel The channel
+ * @param buf Where to put the line (DVBCFG_ZAPCHANNEL_LINE_MAX is always enough)
+ * @param size Size of buf
+ * @return Length of the line without the terminator, -EINVAL if the channel
+ * has a setting with no name in the file format or a name that cannot be
+ * written, -ENOSPC if buf is too small
+ */
+extern int dvbcfg_zapchannel_format(const struct dvbcfg_zapchannel *channel, char *buf, size_t size);
+
 /**
  * Save to a linuxtv channel file
  *
@@ -0,0 +1,1407 @@
+/*
+ * dvbcfg - support for linuxtv configuration files
+ * binary zap channel index
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dvbcfg_zapindex.h"
+
+#define ZAPINDEX_MAGIC "DVBZAPIX"
+#define ZAPINDEX_VERSION 3
+#define ZAPINDEX_TRIGRAM_SLOTS 8192
+
+#define ZAPSTORE_DIR "/dev/shm/dvbcfg-"
+#define ZAPSTORE_MAGIC "DVBZAPST"
+#define ZAPSTORE_VERSION 1
+
+/*
+ * Index file layout, all in host byte order (the index is a cache, never
+ * shared between machines):
+ *
+ *   struct zapindex_header
+ *   struct dvbcfg_zapchannel channels[count]	in channel file order
+ *   struct zapindex_line lines[count]		where each channel is in the file
+ *   uint32_t name_hash[name_slots]		channel number + 1, 0 if free
+ *   uint32_t sid_order[count]			channel numbers sorted by service id
+ *   uint32_t key_order[count]			channel numbers sorted by search key
+ *   uint32_t key_offsets[count]		where each channel's search key is in keys
+ *   uint32_t trigram_start[trigram_slots + 1]	where each trigram's channels start
+ *   uint32_t postings[posting_count]		channel numbers, ascending per trigram
+ *   char keys[key_size]			NUL terminated search keys
+ *
+ * A search key is the channel name folded for searching: ASCII letters in
+ * lower case, digits and non-ASCII bytes as they are, everything else left
+ * out. "BBC One HD" is "bbconehd"; a prefix is then a range of key_order,
+ * and a substring must contain every trigram of the query's key.
+ */
+struct zapindex_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t entry_size;
+	uint32_t count;
+	uint32_t name_slots;
+	uint32_t trigram_slots;
+	uint32_t posting_count;
+	uint32_t key_size;
+	uint32_t reserved;
+	uint64_t source_size;
+	uint64_t source_ino;
+	int64_t source_mtime;
+	int64_t source_mtime_nsec;
+};
+
+/*
+ * Control page of a shared store. Each published index image is an
+ * immutable file "<control>.<generation>"; publishing one is a single
+ * store to generation, so readers never lock and never see a half written
+ * image. A reader that loses the race against the unlink of an old
+ * snapshot just loads the generation again.
+ */
+struct zapstore_control {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t generation;	/* 0 until the first publish */
+};
+
+struct zapindex_line {
+	uint32_t offset;
+	uint32_t length;	/* newline included, if there is one */
+};
+
+struct dvbcfg_zapindex {
+	void *base;
+	size_t size;
+	int mapped;
+
+	uint32_t count;
+	uint32_t name_slots;
+	const struct dvbcfg_zapchannel *channels;
+	const struct zapindex_line *lines;
+	const uint32_t *name_hash;
+	const uint32_t *sid_order;
+	const uint32_t *key_order;
+	const uint32_t *key_offsets;
+	const uint32_t *trigram_start;
+	const uint32_t *postings;
+	const char *keys;
+	uint32_t trigram_slots;
+	uint32_t key_size;
+
+	/* set when attached to a shared store */
+	const struct zapstore_control *control;
+	char *controlname;
+	uint64_t generation;
+};
+
+struct zapindex_build {
+	struct dvbcfg_zapchannel *channels;
+	struct zapindex_line *lines;
+	uint32_t count;
+	uint32_t alloc;
+};
+
+struct zapindex_change {
+	uint32_t channel;	/* replaced channel, or index->count for an append */
+	uint32_t order;		/* position in the caller's array */
+	char line[DVBCFG_ZAPCHANNEL_LINE_MAX];
+	uint32_t length;
+};
+
+struct zapindex_sid {
+	int service_id;
+	uint32_t channel;
+};
+
+struct zapindex_keyref {
+	const char *key;
+	uint32_t channel;
+};
+
+struct zapindex_match {
+	uint32_t channel;
+	uint32_t score;		/* query trigrams the channel has */
+	uint32_t distance;	/* how much longer or shorter its key is */
+};
+
+static uint32_t zapindex_hash(const char *name)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	/* FNV-1a */
+	for (i = 0; (i < sizeof(((struct dvbcfg_zapchannel *) 0)->name)) && name[i]; i++) {
+		hash ^= (uint8_t) name[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*
+ * Search key of a name, see above; returns its length.
+ */
+static size_t zapindex_key(const char *name, char *key)
+{
+	size_t length = 0;
+	size_t i;
+
+	for (i = 0; (i < sizeof(((struct dvbcfg_zapchannel *) 0)->name)) && name[i]; i++) {
+		uint8_t c = name[i];
+
+		if ((c >= 'A') && (c <= 'Z'))
+			key[length++] = c - 'A' + 'a';
+		else if (((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')) || (c >= 0x80))
+			key[length++] = c;
+	}
+	key[length] = '\0';
+
+	return length;
+}
+
+static uint32_t zapindex_trigram(const char *key, uint32_t slots)
+{
+	uint32_t trigram = ((uint8_t) key[0] << 16) | ((uint8_t) key[1] << 8) | (uint8_t) key[2];
+
+	uint32_t hash = trigram * 2654435761U;
+
+	/* the multiply mixes upwards: fold the high bits into the slot */
+	return (hash ^ (hash >> 16)) & (slots - 1);
+}
+
+/*
+ * The distinct trigram slots of a key, in slots[], sorted; returns how many.
+ * slots must have room for length - 2 of them.
+ */
+static uint32_t zapindex_trigrams(const char *key, size_t length, uint32_t trigram_slots,
+				  uint32_t *slots)
+{
+	uint32_t count = 0;
+	uint32_t i;
+	uint32_t j;
+
+	for (i = 0; (i + 2) < length; i++) {
+		uint32_t slot = zapindex_trigram(key + i, trigram_slots);
+
+		/* insertion sort: keys are short */
+		for (j = count; (j > 0) && (slots[j - 1] > slot); j--);
+		if ((j > 0) && (slots[j - 1] == slot))
+			continue;
+		memmove(slots + j + 1, slots + j, (count - j) * sizeof(uint32_t));
+		slots[j] = slot;
+		count++;
+	}
+
+	return count;
+}
+
+static size_t zapindex_size(const struct zapindex_header *header)
+{
+	return sizeof(struct zapindex_header) +
+	       ((size_t) header->count * sizeof(struct dvbcfg_zapchannel)) +
+	       ((size_t) header->count * sizeof(struct zapindex_line)) +
+	       ((size_t) header->name_slots * sizeof(uint32_t)) +
+	       ((size_t) header->count * sizeof(uint32_t) * 3) +
+	       (((size_t) header->trigram_slots + 1) * sizeof(uint32_t)) +
+	       ((size_t) header->posting_count * sizeof(uint32_t)) +
+	       header->key_size;
+}
+
+static void zapindex_setup(struct dvbcfg_zapindex *index)
+{
+	struct zapindex_header *header = index->base;
+	uint8_t *pos = (uint8_t *) index->base + sizeof(struct zapindex_header);
+
+	index->count = header->count;
+	index->name_slots = header->name_slots;
+	index->channels = (const struct dvbcfg_zapchannel *) pos;
+	pos += (size_t) header->count * sizeof(struct dvbcfg_zapchannel);
+	index->lines = (const struct zapindex_line *) pos;
+	pos += (size_t) header->count * sizeof(struct zapindex_line);
+	index->name_hash = (const uint32_t *) pos;
+	pos += (size_t) header->name_slots * sizeof(uint32_t);
+	index->sid_order = (const uint32_t *) pos;
+	pos += (size_t) header->count * sizeof(uint32_t);
+	index->key_order = (const uint32_t *) pos;
+	pos += (size_t) header->count * sizeof(uint32_t);
+	index->key_offsets = (const uint32_t *) pos;
+	pos += (size_t) header->count * sizeof(uint32_t);
+	index->trigram_start = (const uint32_t *) pos;
+	pos += ((size_t) header->trigram_slots + 1) * sizeof(uint32_t);
+	index->postings = (const uint32_t *) pos;
+	pos += (size_t) header->posting_count * sizeof(uint32_t);
+	index->keys = (const char *) pos;
+	index->trigram_slots = header->trigram_slots;
+	index->key_size = header->key_size;
+}
+
+static int zapindex_valid(const struct zapindex_header *header, size_t size, const struct stat *source)
+{
+	const uint32_t *trigram_end;
+
+	if ((size < sizeof(struct zapindex_header)) ||
+	    memcmp(header->magic, ZAPINDEX_MAGIC, sizeof(header->magic)) ||
+	    (header->version != ZAPINDEX_VERSION) ||
+	    (header->entry_size != sizeof(struct dvbcfg_zapchannel)))
+		return 0;
+
+	/* the name hash is a power of two, never completely full */
+	if ((header->name_slots == 0) || (header->name_slots & (header->name_slots - 1)) ||
+	    (header->name_slots <= header->count))
+		return 0;
+	if ((header->trigram_slots == 0) || (header->trigram_slots & (header->trigram_slots - 1)))
+		return 0;
+	if (size != zapindex_size(header))
+		return 0;
+
+	/* the trigram table covers the postings, the last key is terminated */
+	trigram_end = (const uint32_t *) ((const uint8_t *) header + size - header->key_size) -
+		      header->posting_count - 1;
+	if (*trigram_end != header->posting_count)
+		return 0;
+	if (header->key_size && ((const char *) header)[size - 1])
+		return 0;
+
+	/* and built from the file as it is now */
+	if (source == NULL)
+		return 1;
+	if ((header->source_size != (uint64_t) source->st_size) ||
+	    (header->source_ino != (uint64_t) source->st_ino) ||
+	    (header->source_mtime != (int64_t) source->st_mtim.tv_sec) ||
+	    (header->source_mtime_nsec != (int64_t) source->st_mtim.tv_nsec))
+		return 0;
+
+	return 1;
+}
+
+static int zapindex_map(struct dvbcfg_zapindex *index, const char *indexname, const struct stat *source)
+{
+	struct stat st;
+	void *base;
+	int fd;
+
+	if ((fd = open(indexname, O_RDONLY)) < 0)
+		return -1;
+	if (fstat(fd, &st) || (st.st_size < (off_t) sizeof(struct zapindex_header))) {
+		close(fd);
+		return -1;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return -1;
+
+	if (!zapindex_valid(base, st.st_size, source)) {
+		munmap(base, st.st_size);
+		return -1;
+	}
+
+	index->base = base;
+	index->size = st.st_size;
+	index->mapped = 1;
+	zapindex_setup(index);
+	return 0;
+}
+
+static int zapindex_add(struct zapindex_build *build, const struct dvbcfg_zapchannel *channel,
+			uint32_t offset, uint32_t length)
+{
+	if (build->count == build->alloc) {
+		uint32_t alloc = build->alloc ? build->alloc * 2 : 256;
+		struct dvbcfg_zapchannel *channels;
+		struct zapindex_line *lines;
+
+		channels = realloc(build->channels, alloc * sizeof(struct dvbcfg_zapchannel));
+		if (channels == NULL)
+			return -ENOMEM;
+		build->channels = channels;
+		lines = realloc(build->lines, alloc * sizeof(struct zapindex_line));
+		if (lines == NULL)
+			return -ENOMEM;
+		build->lines = lines;
+		build->alloc = alloc;
+	}
+
+	build->channels[build->count] = *channel;
+	build->lines[build->count].offset = offset;
+	build->lines[build->count].length = length;
+	build->count++;
+	return 0;
+}
+
+static void zapindex_build_free(struct zapindex_build *build)
+{
+	free(build->channels);
+	free(build->lines);
+}
+
+static int zapindex_sid_compare(const void *a, const void *b)
+{
+	const struct zapindex_sid *sa = a;
+	const struct zapindex_sid *sb = b;
+
+	if (sa->service_id != sb->service_id)
+		return (sa->service_id < sb->service_id) ? -1 : 1;
+	if (sa->channel != sb->channel)
+		return (sa->channel < sb->channel) ? -1 : 1;
+	return 0;
+}
+
+static int zapindex_keyref_compare(const void *a, const void *b)
+{
+	const struct zapindex_keyref *ka = a;
+	const struct zapindex_keyref *kb = b;
+	int ret = strcmp(ka->key, kb->key);
+
+	if (ret)
+		return ret;
+	if (ka->channel != kb->channel)
+		return (ka->channel < kb->channel) ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Parse the channel file as dvbcfg_zapchannel_parse() does, but keep where
+ * each channel's line is so that dvbcfg_zapindex_merge() can replace it.
+ * The lines are parsed straight out of a mapping of the file, through a
+ * stack buffer that only very long (comment) lines overflow.
+ */
+static int zapindex_read(struct zapindex_build *build, const char *filename)
+{
+	char line_buf[DVBCFG_ZAPCHANNEL_LINE_MAX];
+	const char *text = NULL;
+	struct stat st;
+	size_t offset = 0;
+	int ret_val = 0;
+	int fd;
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return -errno;
+	if (fstat(fd, &st)) {
+		ret_val = -errno;
+		close(fd);
+		return ret_val;
+	}
+	if (st.st_size > UINT32_MAX) {
+		close(fd);
+		return -EFBIG;
+	}
+	if (st.st_size) {
+		text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (text == MAP_FAILED) {
+			ret_val = -errno;
+			close(fd);
+			return ret_val;
+		}
+	}
+	close(fd);
+
+	while (offset < (size_t) st.st_size) {
+		const char *line = text + offset;
+		const char *newline = memchr(line, '\n', st.st_size - offset);
+		size_t line_len = newline ? (size_t) (newline - line) + 1 : st.st_size - offset;
+		char *line_pos = line_buf;
+		struct dvbcfg_zapchannel tmp;
+
+		if (line_len >= sizeof(line_buf)) {
+			if ((line_pos = malloc(line_len + 1)) == NULL) {
+				ret_val = -ENOMEM;
+				break;
+			}
+		}
+		memcpy(line_pos, line, line_len);
+		line_pos[line_len] = '\0';
+
+		if (dvbcfg_zapchannel_parse_line(line_pos, &tmp) == 0)
+			ret_val = zapindex_add(build, &tmp, offset, line_len);
+		if (line_pos != line_buf)
+			free(line_pos);
+		if (ret_val < 0)
+			break;
+		offset += line_len;
+	}
+
+	if (text)
+		munmap((void *) text, st.st_size);
+	return ret_val;
+}
+
+/*
+ * Lay out a new index image in memory for the given channels.
+ */
+static int zapindex_compile(struct dvbcfg_zapindex *index, const struct dvbcfg_zapchannel *channels,
+			    const struct zapindex_line *lines, uint32_t count, const struct stat *source)
+{
+	char key[sizeof(((struct dvbcfg_zapchannel *) 0)->name) + 1];
+	uint32_t slots[sizeof(((struct dvbcfg_zapchannel *) 0)->name)];
+	struct zapindex_header layout;
+	struct zapindex_header *header;
+	struct zapindex_keyref *keyrefs;
+	struct zapindex_sid *sids;
+	uint32_t *trigram_fill;
+	uint32_t *trigram_start;
+	uint32_t *name_hash;
+	uint32_t *sid_order;
+	uint32_t *postings;
+	uint32_t name_slots;
+	uint32_t key_pos;
+	uint32_t i;
+	uint32_t j;
+	uint32_t n;
+	size_t length;
+	size_t size;
+
+	/* at most half full */
+	name_slots = 16;
+	while (name_slots < (count * 2))
+		name_slots <<= 1;
+
+	/* size the search tables: a key and a posting per trigram for each channel */
+	memset(&layout, 0, sizeof(layout));
+	layout.count = count;
+	layout.name_slots = name_slots;
+	layout.trigram_slots = ZAPINDEX_TRIGRAM_SLOTS;
+	if ((trigram_fill = calloc(layout.trigram_slots, sizeof(uint32_t))) == NULL)
+		return -ENOMEM;
+	for (i = 0; i < count; i++) {
+		length = zapindex_key(channels[i].name, key);
+		layout.key_size += length + 1;
+		n = zapindex_trigrams(key, length, layout.trigram_slots, slots);
+		for (j = 0; j < n; j++)
+			trigram_fill[slots[j]]++;
+		layout.posting_count += n;
+	}
+
+	size = zapindex_size(&layout);
+	if ((header = calloc(1, size)) == NULL) {
+		free(trigram_fill);
+		return -ENOMEM;
+	}
+	memcpy(header, &layout, sizeof(layout));
+	memcpy(header->magic, ZAPINDEX_MAGIC, sizeof(header->magic));
+	header->version = ZAPINDEX_VERSION;
+	header->entry_size = sizeof(struct dvbcfg_zapchannel);
+	header->source_size = source->st_size;
+	header->source_ino = source->st_ino;
+	header->source_mtime = source->st_mtim.tv_sec;
+	header->source_mtime_nsec = source->st_mtim.tv_nsec;
+
+	index->base = header;
+	index->size = size;
+	index->mapped = 0;
+	zapindex_setup(index);
+
+	if (count) {
+		memcpy((void *) index->channels, channels, count * sizeof(struct dvbcfg_zapchannel));
+		memcpy((void *) index->lines, lines, count * sizeof(struct zapindex_line));
+	}
+
+	/* name hash: only the first channel of a name goes in */
+	name_hash = (uint32_t *) index->name_hash;
+	for (i = 0; i < count; i++) {
+		const char *name = index->channels[i].name;
+		uint32_t slot = zapindex_hash(name) & (name_slots - 1);
+
+		while (name_hash[slot] &&
+		       strncmp(index->channels[name_hash[slot] - 1].name, name,
+			       sizeof(index->channels[i].name)))
+			slot = (slot + 1) & (name_slots - 1);
+		if (!name_hash[slot])
+			name_hash[slot] = i + 1;
+	}
+
+	/* service ids, sorted, ties in file order */
+	sid_order = (uint32_t *) index->sid_order;
+	if (count) {
+		if ((sids = malloc(count * sizeof(struct zapindex_sid))) == NULL) {
+			free(trigram_fill);
+			free(header);
+			return -ENOMEM;
+		}
+		for (i = 0; i < count; i++) {
+			sids[i].service_id = index->channels[i].service_id;
+			sids[i].channel = i;
+		}
+		qsort(sids, count, sizeof(struct zapindex_sid), zapindex_sid_compare);
+		for (i = 0; i < count; i++)
+			sid_order[i] = sids[i].channel;
+		free(sids);
+	}
+
+	/* the keys, and the postings, which come out in channel order */
+	trigram_start = (uint32_t *) index->trigram_start;
+	postings = (uint32_t *) index->postings;
+	for (i = 0, n = 0; i < index->trigram_slots; i++) {
+		trigram_start[i] = n;
+		n += trigram_fill[i];
+		trigram_fill[i] = trigram_start[i];
+	}
+	trigram_start[index->trigram_slots] = n;
+
+	key_pos = 0;
+	for (i = 0; i < count; i++) {
+		char *channel_key = (char *) index->keys + key_pos;
+
+		length = zapindex_key(index->channels[i].name, channel_key);
+		((uint32_t *) index->key_offsets)[i] = key_pos;
+		key_pos += length + 1;
+
+		n = zapindex_trigrams(channel_key, length, index->trigram_slots, slots);
+		for (j = 0; j < n; j++)
+			postings[trigram_fill[slots[j]]++] = i;
+	}
+	free(trigram_fill);
+
+	/* keys, sorted, ties in file order */
+	if (count) {
+		if ((keyrefs = malloc(count * sizeof(struct zapindex_keyref))) == NULL) {
+			free(header);
+			return -ENOMEM;
+		}
+		for (i = 0; i < count; i++) {
+			keyrefs[i].key = index->keys + index->key_offsets[i];
+			keyrefs[i].channel = i;
+		}
+		qsort(keyrefs, count, sizeof(struct zapindex_keyref), zapindex_keyref_compare);
+		for (i = 0; i < count; i++)
+			((uint32_t *) index->key_order)[i] = keyrefs[i].channel;
+		free(keyrefs);
+	}
+
+	return 0;
+}
+
+static int zapindex_build(struct dvbcfg_zapindex *index, const char *filename, const struct stat *source)
+{
+	struct zapindex_build build;
+	int ret;
+
+	/* parse the channel file */
+	memset(&build, 0, sizeof(build));
+	if ((ret = zapindex_read(&build, filename)) == 0)
+		ret = zapindex_compile(index, build.channels, build.lines, build.count, source);
+
+	zapindex_build_free(&build);
+	return ret;
+}
+
+static int zapindex_save(struct dvbcfg_zapindex *index, const char *indexname)
+{
+	char *tmpname;
+	size_t done = 0;
+	int ret = 0;
+	int fd;
+
+	if (asprintf(&tmpname, "%s.XXXXXX", indexname) < 0)
+		return -ENOMEM;
+
+	/* written aside and renamed: readers keep the index they mapped */
+	if ((fd = mkstemp(tmpname)) < 0) {
+		ret = -errno;
+		free(tmpname);
+		return ret;
+	}
+	fchmod(fd, 0644);
+	while (done < index->size) {
+		ssize_t count = write(fd, (uint8_t *) index->base + done, index->size - done);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			ret = -errno;
+			break;
+		}
+		done += count;
+	}
+	if (close(fd) || (done != index->size) || rename(tmpname, indexname)) {
+		if (ret == 0)
+			ret = -errno;
+		unlink(tmpname);
+	}
+
+	free(tmpname);
+	return ret;
+}
+
+struct dvbcfg_zapindex *dvbcfg_zapindex_open(const char *filename, const char *indexname)
+{
+	struct dvbcfg_zapindex *index;
+	char *defaultname = NULL;
+	struct stat source;
+	int ret;
+
+	if (stat(filename, &source))
+		return NULL;
+
+	if (indexname == NULL) {
+		if (asprintf(&defaultname, "%s.idx", filename) < 0) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		indexname = defaultname;
+	}
+
+	if ((index = calloc(1, sizeof(struct dvbcfg_zapindex))) == NULL) {
+		free(defaultname);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* an up to date index on disk? */
+	if (zapindex_map(index, indexname, &source) == 0) {
+		free(defaultname);
+		return index;
+	}
+
+	/* no: compile the channel file, and keep it for next time if we can */
+	if ((ret = zapindex_build(index, filename, &source)) < 0) {
+		free(defaultname);
+		free(index);
+		errno = -ret;
+		return NULL;
+	}
+	zapindex_save(index, indexname);
+
+	free(defaultname);
+	return index;
+}
+
+void dvbcfg_zapindex_close(struct dvbcfg_zapindex *index)
+{
+	if (index->mapped)
+		munmap(index->base, index->size);
+	else
+		free(index->base);
+	if (index->control)
+		munmap((void *) index->control, sizeof(struct zapstore_control));
+	free(index->controlname);
+	free(index);
+}
+
+int dvbcfg_zapindex_count(struct dvbcfg_zapindex *index)
+{
+	return index->count;
+}
+
+/*
+ * Channel number of the first channel called name, or index->count.
+ */
+static uint32_t zapindex_lookup(struct dvbcfg_zapindex *index, const char *name)
+{
+	uint32_t slot = zapindex_hash(name) & (index->name_slots - 1);
+	uint32_t probes;
+
+	for (probes = 0; probes < index->name_slots; probes++) {
+		uint32_t entry = index->name_hash[slot];
+
+		if (entry == 0)
+			break;
+		if ((entry <= index->count) &&
+		    !strncmp(index->channels[entry - 1].name, name,
+			     sizeof(index->channels[0].name)))
+			return entry - 1;
+		slot = (slot + 1) & (index->name_slots - 1);
+	}
+
+	return index->count;
+}
+
+int dvbcfg_zapindex_find_name(struct dvbcfg_zapindex *index, const char *name,
+			      struct dvbcfg_zapchannel *channel)
+{
+	uint32_t entry = zapindex_lookup(index, name);
+
+	if (entry == index->count)
+		return -ENOENT;
+
+	memcpy(channel, &index->channels[entry], sizeof(struct dvbcfg_zapchannel));
+	return 0;
+}
+
+int dvbcfg_zapindex_number(struct dvbcfg_zapindex *index, const char *name)
+{
+	uint32_t entry = zapindex_lookup(index, name);
+
+	if (entry == index->count)
+		return -ENOENT;
+
+	return entry;
+}
+
+int dvbcfg_zapindex_get(struct dvbcfg_zapindex *index, int number,
+			struct dvbcfg_zapchannel *channel)
+{
+	if ((number < 0) || ((uint32_t) number >= index->count))
+		return -ENOENT;
+
+	memcpy(channel, &index->channels[number], sizeof(struct dvbcfg_zapchannel));
+	return 0;
+}
+
+int dvbcfg_zapindex_find_service(struct dvbcfg_zapindex *index, int service_id,
+				 dvbcfg_zapcallback callback, void *private_data)
+{
+	struct dvbcfg_zapchannel tmp;
+	uint32_t low = 0;
+	uint32_t high = index->count;
+	int ret_val;
+
+	/* first channel with this service id */
+	while (low < high) {
+		uint32_t mid = low + ((high - low) / 2);
+
+		if (index->channels[index->sid_order[mid]].service_id < service_id)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; low < index->count; low++) {
+		uint32_t entry = index->sid_order[low];
+
+		if ((entry >= index->count) || (index->channels[entry].service_id != service_id))
+			break;
+
+		memcpy(&tmp, &index->channels[entry], sizeof(struct dvbcfg_zapchannel));
+		if ((ret_val = callback(&tmp, private_data)) != 0) {
+			if (ret_val < 0)
+				ret_val = 0;
+			return ret_val;
+		}
+	}
+
+	return 0;
+}
+
+static const char *zapindex_channel_key(struct dvbcfg_zapindex *index, uint32_t channel)
+{
+	uint32_t offset = index->key_offsets[channel];
+
+	return (offset < index->key_size) ? index->keys + offset : "";
+}
+
+static int zapindex_search_prefix(struct dvbcfg_zapindex *index, const char *key, size_t length,
+				  int *numbers, int max)
+{
+	uint32_t low = 0;
+	uint32_t high = index->count;
+	int found = 0;
+
+	/* first key not below the prefix: the matches follow it */
+	while (low < high) {
+		uint32_t mid = low + ((high - low) / 2);
+		uint32_t entry = index->key_order[mid];
+
+		if ((entry < index->count) && (strcmp(zapindex_channel_key(index, entry), key) < 0))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (; (low < index->count) && (found < max); low++) {
+		uint32_t entry = index->key_order[low];
+
+		if ((entry >= index->count) || strncmp(zapindex_channel_key(index, entry), key, length))
+			break;
+		numbers[found++] = entry;
+	}
+
+	return found;
+}
+
+static int zapindex_search_substring(struct dvbcfg_zapindex *index, const char *key, size_t length,
+				     int *numbers, int max)
+{
+	uint32_t slots[sizeof(((struct dvbcfg_zapchannel *) 0)->name)];
+	uint32_t best = 0;
+	uint32_t n;
+	uint32_t i;
+	int found = 0;
+
+	/* too short for a trigram: the keys are small enough to just look */
+	if (length < 3) {
+		for (i = 0; (i < index->count) && (found < max); i++)
+			if (strstr(zapindex_channel_key(index, i), key))
+				numbers[found++] = i;
+		return found;
+	}
+
+	/* only the channels of the query's rarest trigram can match */
+	n = zapindex_trigrams(key, length, index->trigram_slots, slots);
+	for (i = 1; i < n; i++)
+		if ((index->trigram_start[slots[i] + 1] - index->trigram_start[slots[i]]) <
+		    (index->trigram_start[slots[best] + 1] - index->trigram_start[slots[best]]))
+			best = i;
+
+	for (i = index->trigram_start[slots[best]];
+	     (i < index->trigram_start[slots[best] + 1]) && (found < max); i++) {
+		uint32_t entry = index->postings[i];
+
+		if ((entry < index->count) && strstr(zapindex_channel_key(index, entry), key))
+			numbers[found++] = entry;
+	}
+
+	return found;
+}
+
+static int zapindex_match_compare(const void *a, const void *b)
+{
+	const struct zapindex_match *ma = a;
+	const struct zapindex_match *mb = b;
+
+	if (ma->score != mb->score)
+		return (ma->score > mb->score) ? -1 : 1;
+	if (ma->distance != mb->distance)
+		return (ma->distance < mb->distance) ? -1 : 1;
+	if (ma->channel != mb->channel)
+		return (ma->channel < mb->channel) ? -1 : 1;
+	return 0;
+}
+
+static int zapindex_search_fuzzy(struct dvbcfg_zapindex *index, const char *key, size_t length,
+				 int *numbers, int max)
+{
+	uint32_t slots[sizeof(((struct dvbcfg_zapchannel *) 0)->name)];
+	struct zapindex_match *matches;
+	uint8_t *scores;
+	uint32_t matched = 0;
+	uint32_t n;
+	uint32_t i;
+	uint32_t j;
+	int found;
+
+	if (length < 3)
+		return zapindex_search_prefix(index, key, length, numbers, max);
+	if (index->count == 0)
+		return 0;
+
+	/* count the query's trigrams each channel has */
+	n = zapindex_trigrams(key, length, index->trigram_slots, slots);
+	if ((scores = calloc(index->count, sizeof(uint8_t))) == NULL)
+		return -ENOMEM;
+	for (i = 0; i < n; i++) {
+		for (j = index->trigram_start[slots[i]]; j < index->trigram_start[slots[i] + 1]; j++) {
+			uint32_t entry = index->postings[j];
+
+			if ((entry < index->count) && (scores[entry]++ == 0))
+				matched++;
+		}
+	}
+
+	/* the best max of those with at least half of them, kept in order */
+	if ((matches = malloc((max + 1) * sizeof(struct zapindex_match))) == NULL) {
+		free(scores);
+		return -ENOMEM;
+	}
+	found = 0;
+	for (i = 0; (i < index->count) && matched; i++) {
+		struct zapindex_match match;
+		size_t key_length;
+
+		if (scores[i] == 0)
+			continue;
+		matched--;
+		if ((scores[i] * 2) < n)
+			continue;
+		if ((found == max) && (scores[i] < matches[max - 1].score))
+			continue;
+
+		key_length = strlen(zapindex_channel_key(index, i));
+		match.channel = i;
+		match.score = scores[i];
+		match.distance = (key_length > length) ? key_length - length : length - key_length;
+		for (j = found; (j > 0) && (zapindex_match_compare(&match, &matches[j - 1]) < 0); j--)
+			matches[j] = matches[j - 1];
+		matches[j] = match;
+		if (found < max)
+			found++;
+	}
+
+	for (i = 0; i < (uint32_t) found; i++)
+		numbers[i] = matches[i].channel;
+
+	free(matches);
+	free(scores);
+	return found;
+}
+
+int dvbcfg_zapindex_search(struct dvbcfg_zapindex *index, const char *query, int mode,
+			   int *numbers, int max)
+{
+	char key[sizeof(((struct dvbcfg_zapchannel *) 0)->name) + 1];
+	size_t length = zapindex_key(query, key);
+
+	if (max <= 0)
+		return 0;
+
+	switch (mode) {
+	case DVBCFG_ZAPINDEX_SEARCH_PREFIX:
+		return zapindex_search_prefix(index, key, length, numbers, max);
+	case DVBCFG_ZAPINDEX_SEARCH_SUBSTRING:
+		return zapindex_search_substring(index, key, length, numbers, max);
+	case DVBCFG_ZAPINDEX_SEARCH_FUZZY:
+		return zapindex_search_fuzzy(index, key, length, numbers, max);
+	}
+
+	return -EINVAL;
+}
+
+static int zapindex_change_compare(const void *a, const void *b)
+{
+	const struct zapindex_change *ca = a;
+	const struct zapindex_change *cb = b;
+
+	if (ca->channel != cb->channel)
+		return (ca->channel < cb->channel) ? -1 : 1;
+	if (ca->order != cb->order)
+		return (ca->order < cb->order) ? -1 : 1;
+	return 0;
+}
+
+static int zapindex_write(FILE *file, const void *data, size_t size)
+{
+	if (size && (fwrite(data, size, 1, file) != 1))
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Put the parsed form of a formatted line in the index, so that the index
+ * holds what a later rebuild from the text would.
+ */
+static void zapindex_apply(struct dvbcfg_zapchannel *channel, const struct zapindex_change *change)
+{
+	char line[DVBCFG_ZAPCHANNEL_LINE_MAX];
+
+	memcpy(line, change->line, change->length + 1);
+	dvbcfg_zapchannel_parse_line(line, channel);
+}
+
+int dvbcfg_zapindex_merge(struct dvbcfg_zapindex *index, const char *filename, const char *indexname,
+			  const struct dvbcfg_zapchannel *changes, int count)
+{
+	struct zapindex_change *sorted = NULL;
+	struct dvbcfg_zapchannel *channels = NULL;
+	struct zapindex_line *lines = NULL;
+	struct dvbcfg_zapindex merged;
+	struct stat source;
+	struct stat st;
+	char *defaultname = NULL;
+	char *tmpname = NULL;
+	uint8_t *text = NULL;
+	FILE *file = NULL;
+	uint32_t appended = 0;
+	uint32_t total;
+	uint64_t pos = 0;
+	uint64_t end;
+	int64_t delta = 0;
+	int i;
+	int c;
+	int fd;
+	int ret;
+
+	if (count < 0)
+		return -EINVAL;
+	if (count == 0)
+		return 0;
+
+	/* the changes are placed using the index, so it must match the file */
+	if (stat(filename, &source))
+		return -errno;
+	if (!zapindex_valid(index->base, index->size, &source))
+		return -ESTALE;
+
+	if ((sorted = malloc(count * sizeof(struct zapindex_change))) == NULL)
+		return -ENOMEM;
+
+	/* format each change, and find the channel it replaces */
+	for (i = 0; i < count; i++) {
+		struct zapindex_change *change = &sorted[i];
+
+		if ((ret = dvbcfg_zapchannel_format(&changes[i], change->line, sizeof(change->line))) < 0)
+			goto out;
+		change->length = ret;
+		change->order = i;
+		change->channel = zapindex_lookup(index, changes[i].name);
+		if (change->channel < index->count)
+			continue;
+
+		/* not in the file yet: appended, once per name */
+		for (c = 0; c < i; c++)
+			if ((sorted[c].channel >= index->count) &&
+			    !strncmp(changes[c].name, changes[i].name, sizeof(changes[i].name)))
+				break;
+		change->channel = (c < i) ? sorted[c].channel : index->count + appended++;
+	}
+	qsort(sorted, count, sizeof(struct zapindex_change), zapindex_change_compare);
+
+	total = index->count + appended;
+	channels = malloc(total * sizeof(struct dvbcfg_zapchannel));
+	lines = malloc(total * sizeof(struct zapindex_line));
+	if ((channels == NULL) || (lines == NULL)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	if (index->count)
+		memcpy(channels, index->channels, index->count * sizeof(struct dvbcfg_zapchannel));
+
+	/* map the text we are going to copy from */
+	if ((fd = open(filename, O_RDONLY)) < 0) {
+		ret = -errno;
+		goto out;
+	}
+	if (fstat(fd, &st) || (st.st_ino != source.st_ino) || (st.st_size != source.st_size)) {
+		close(fd);
+		ret = -ESTALE;
+		goto out;
+	}
+	if (source.st_size) {
+		text = mmap(NULL, source.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (text == MAP_FAILED) {
+			text = NULL;
+			ret = -errno;
+			close(fd);
+			goto out;
+		}
+	}
+	close(fd);
+
+	/* written aside and renamed: readers see either the old or the new file */
+	if (asprintf(&tmpname, "%s.XXXXXX", filename) < 0) {
+		tmpname = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+	if ((fd = mkstemp(tmpname)) < 0) {
+		ret = -errno;
+		free(tmpname);
+		tmpname = NULL;
+		goto out;
+	}
+	fchmod(fd, source.st_mode & 07777);
+	if ((file = fdopen(fd, "w")) == NULL) {
+		ret = -errno;
+		close(fd);
+		goto out;
+	}
+
+	/* unchanged runs of lines are copied as they are, changed lines replaced */
+	c = 0;
+	for (i = 0; i < (int) index->count; i++) {
+		const struct zapindex_line *old = &index->lines[i];
+
+		lines[i].offset = old->offset + delta;
+		lines[i].length = old->length;
+		if ((c == count) || (sorted[c].channel != (uint32_t) i))
+			continue;
+
+		/* the last change to a channel wins */
+		while (((c + 1) < count) && (sorted[c + 1].channel == (uint32_t) i))
+			c++;
+
+		if ((ret = zapindex_write(file, text + pos, old->offset - pos)) < 0)
+			goto out;
+		if ((ret = zapindex_write(file, sorted[c].line, sorted[c].length)) < 0)
+			goto out;
+		pos = old->offset + old->length;
+		delta += (int64_t) sorted[c].length - old->length;
+		lines[i].length = sorted[c].length;
+		zapindex_apply(&channels[i], &sorted[c]);
+		c++;
+	}
+	if ((ret = zapindex_write(file, text + pos, source.st_size - pos)) < 0)
+		goto out;
+	end = source.st_size + delta;
+
+	/* new channels go at the end */
+	if (c < count) {
+		if (source.st_size && (text[source.st_size - 1] != '\n')) {
+			if ((ret = zapindex_write(file, "\n", 1)) < 0)
+				goto out;
+			end++;
+		}
+	}
+	for (; c < count; c++) {
+		uint32_t channel = sorted[c].channel;
+
+		while (((c + 1) < count) && (sorted[c + 1].channel == channel))
+			c++;
+
+		if ((ret = zapindex_write(file, sorted[c].line, sorted[c].length)) < 0)
+			goto out;
+		lines[channel].offset = end;
+		lines[channel].length = sorted[c].length;
+		zapindex_apply(&channels[channel], &sorted[c]);
+		end += sorted[c].length;
+	}
+	if (end > UINT32_MAX) {
+		ret = -EFBIG;
+		goto out;
+	}
+
+	/* on disk before it replaces the old file */
+	if (fflush(file) || fsync(fileno(file)) || fstat(fileno(file), &st)) {
+		ret = -errno;
+		goto out;
+	}
+	ret = fclose(file);
+	file = NULL;
+	if (ret || rename(tmpname, filename)) {
+		ret = -errno;
+		goto out;
+	}
+	free(tmpname);
+	tmpname = NULL;
+
+	/* the index follows the file; if it cannot, the next open rebuilds it */
+	memset(&merged, 0, sizeof(merged));
+	if ((ret = zapindex_compile(&merged, channels, lines, total, &st)) < 0)
+		goto out;
+
+	if (indexname == NULL) {
+		if (asprintf(&defaultname, "%s.idx", filename) < 0)
+			defaultname = NULL;
+		indexname = defaultname;
+	}
+	if (indexname)
+		zapindex_save(&merged, indexname);
+
+	if (index->mapped)
+		munmap(index->base, index->size);
+	else
+		free(index->base);
+	merged.control = index->control;
+	merged.controlname = index->controlname;
+	merged.generation = index->generation;
+	memcpy(index, &merged, sizeof(struct dvbcfg_zapindex));
+
+out:
+	if (file)
+		fclose(file);
+	if (tmpname) {
+		unlink(tmpname);
+		free(tmpname);
+	}
+	if (text)
+		munmap(text, source.st_size);
+	free(defaultname);
+	free(lines);
+	free(channels);
+	free(sorted);
+	return ret;
+}
+
+static char *zapstore_controlname(const char *storename)
+{
+	char *controlname;
+
+	if ((*storename == '\0') || strchr(storename, '/'))
+		return NULL;
+	if (asprintf(&controlname, ZAPSTORE_DIR "%s", storename) < 0)
+		return NULL;
+	return controlname;
+}
+
+/*
+ * Map the snapshot the control page currently points at.
+ */
+static int zapstore_map(const struct zapstore_control *control, const char *controlname,
+			struct dvbcfg_zapindex *image)
+{
+	uint64_t generation;
+	char *snapname;
+	int ret;
+
+	while ((generation = __atomic_load_n(&control->generation, __ATOMIC_ACQUIRE)) != 0) {
+		if (asprintf(&snapname, "%s.%llu", controlname, (unsigned long long) generation) < 0)
+			return -ENOMEM;
+		ret = zapindex_map(image, snapname, NULL);
+		free(snapname);
+		if (ret == 0) {
+			image->generation = generation;
+			return 0;
+		}
+
+		/* only worth another go if it was replaced under us */
+		if (__atomic_load_n(&control->generation, __ATOMIC_ACQUIRE) == generation)
+			return -ENOENT;
+	}
+
+	return -ENOENT;
+}
+
+int dvbcfg_zapindex_publish(struct dvbcfg_zapindex *index, const char *storename)
+{
+	struct zapstore_control *control;
+	uint64_t generation;
+	char *controlname;
+	char *snapname;
+	struct stat st;
+	int ret;
+	int fd;
+
+	if ((controlname = zapstore_controlname(storename)) == NULL)
+		return -EINVAL;
+
+	/* publishers take turns on the control page */
+	if ((fd = open(controlname, O_RDWR | O_CREAT, 0644)) < 0) {
+		ret = -errno;
+		free(controlname);
+		return ret;
+	}
+	if (flock(fd, LOCK_EX) || fstat(fd, &st) ||
+	    ((st.st_size == 0) && ftruncate(fd, sizeof(struct zapstore_control)))) {
+		ret = -errno;
+		goto out;
+	}
+	if ((st.st_size != 0) && (st.st_size != sizeof(struct zapstore_control))) {
+		ret = -EINVAL;
+		goto out;
+	}
+	control = mmap(NULL, sizeof(struct zapstore_control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (control == MAP_FAILED) {
+		ret = -errno;
+		goto out;
+	}
+	if (st.st_size == 0) {
+		memcpy(control->magic, ZAPSTORE_MAGIC, sizeof(control->magic));
+		control->version = ZAPSTORE_VERSION;
+	} else if (memcmp(control->magic, ZAPSTORE_MAGIC, sizeof(control->magic)) ||
+		   (control->version != ZAPSTORE_VERSION)) {
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	/* the new image goes in complete before anyone is pointed at it */
+	generation = control->generation + 1;
+	if (asprintf(&snapname, "%s.%llu", controlname, (unsigned long long) generation) < 0) {
+		ret = -ENOMEM;
+		goto unmap;
+	}
+	ret = zapindex_save(index, snapname);
+	free(snapname);
+	if (ret < 0)
+		goto unmap;
+	__atomic_store_n(&control->generation, generation, __ATOMIC_RELEASE);
+
+	/* readers still holding the old image keep it until they unmap */
+	if (asprintf(&snapname, "%s.%llu", controlname, (unsigned long long) (generation - 1)) >= 0) {
+		unlink(snapname);
+		free(snapname);
+	}
+
+unmap:
+	munmap(control, sizeof(struct zapstore_control));
+out:
+	close(fd);
+	free(controlname);
+	return ret;
+}
+
+struct dvbcfg_zapindex *dvbcfg_zapindex_attach(const char *storename)
+{
+	struct dvbcfg_zapindex *index;
+	const struct zapstore_control *control;
+	char *controlname;
+	struct stat st;
+	int ret;
+	int fd;
+
+	if ((controlname = zapstore_controlname(storename)) == NULL) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((fd = open(controlname, O_RDONLY)) < 0) {
+		free(controlname);
+		return NULL;
+	}
+	if (fstat(fd, &st)) {
+		ret = -errno;
+		close(fd);
+		goto fail;
+	}
+	if (st.st_size != sizeof(struct zapstore_control)) {
+		close(fd);
+		ret = -EINVAL;
+		goto fail;
+	}
+	control = mmap(NULL, sizeof(struct zapstore_control), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (control == MAP_FAILED) {
+		ret = -errno;
+		goto fail;
+	}
+	if (memcmp(control->magic, ZAPSTORE_MAGIC, sizeof(control->magic)) ||
+	    (control->version != ZAPSTORE_VERSION)) {
+		ret = -EINVAL;
+		goto unmap;
+	}
+
+	if ((index = calloc(1, sizeof(struct dvbcfg_zapindex))) == NULL) {
+		ret = -ENOMEM;
+		goto unmap;
+	}
+	if ((ret = zapstore_map(control, controlname, index)) < 0) {
+		free(index);
+		goto unmap;
+	}
+	index->control = control;
+	index->controlname = controlname;
+	return index;
+
+unmap:
+	munmap((void *) control, sizeof(struct zapstore_control));
+fail:
+	free(controlname);
+	errno = -ret;
+	return NULL;
+}
+
+int dvbcfg_zapindex_refresh(struct dvbcfg_zapindex *index)
+{
+	struct dvbcfg_zapindex image;
+	int ret;
+
+	if ((index->control == NULL) ||
+	    (__atomic_load_n(&index->control->generation, __ATOMIC_ACQUIRE) == index->generation))
+		return 0;
+
+	memset(&image, 0, sizeof(image));
+	if ((ret = zapstore_map(index->control, index->controlname, &image)) < 0)
+		return ret;
+
+	munmap(index->base, index->size);
+	image.control = index->control;
+	image.controlname = index->controlname;
+	memcpy(index, &image, sizeof(struct dvbcfg_zapindex));
+	return 1;
+}
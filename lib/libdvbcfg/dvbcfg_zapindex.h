@@ -0,0 +1,202 @@
+/*
+ * dvbcfg - support for linuxtv configuration files
+ * binary zap channel index
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DVBCFG_ZAPINDEX_H
+#define DVBCFG_ZAPINDEX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libdvbcfg/dvbcfg_zapchannel.h>
+
+/**
+ * A compiled index of a linuxtv channel file. It holds the parsed channels
+ * in file order, a hash table on the channel name, a table sorted by
+ * service id and tables for searching by name. The index lives in a file next to the channel file and is
+ * mmap()ed, so a lookup costs the same however big the channel file is.
+ */
+struct dvbcfg_zapindex;
+
+/**
+ * Open the index for a linuxtv channel file. The index is rebuilt when it
+ * is missing, was written by another version of the library, or the
+ * channel file changed since it was built. If the index file cannot be
+ * written (e.g. a read-only /etc), an in-memory index is used instead.
+ *
+ * @param filename Linuxtv channel file
+ * @param indexname Index file, or NULL for "<filename>.idx"
+ * @return The index, or NULL on failure (errno is set)
+ */
+extern struct dvbcfg_zapindex *dvbcfg_zapindex_open(const char *filename, const char *indexname);
+
+/**
+ * Close an index.
+ *
+ * @param index Index to close
+ */
+extern void dvbcfg_zapindex_close(struct dvbcfg_zapindex *index);
+
+/**
+ * Number of channels in an index.
+ *
+ * @param index The index
+ * @return Number of channels
+ */
+extern int dvbcfg_zapindex_count(struct dvbcfg_zapindex *index);
+
+/**
+ * Look up a channel by name. If several channels share a name, the first
+ * in the channel file is returned, as a dvbcfg_zapchannel_parse() search
+ * would find it.
+ *
+ * @param index The index
+ * @param name Name of the channel
+ * @param channel Where to copy the channel
+ * @return 0 on success, -ENOENT if there is no such channel
+ */
+extern int dvbcfg_zapindex_find_name(struct dvbcfg_zapindex *index, const char *name,
+				     struct dvbcfg_zapchannel *channel);
+
+/**
+ * Channel number of a channel: its position in the channel file, from 0,
+ * which is what a channel up or down is relative to. If several channels
+ * share the name, the number of the one dvbcfg_zapindex_find_name() returns.
+ *
+ * @param index The index
+ * @param name Name of the channel
+ * @return The number, or -ENOENT if there is no such channel
+ */
+extern int dvbcfg_zapindex_number(struct dvbcfg_zapindex *index, const char *name);
+
+/**
+ * Look up a channel by channel number.
+ *
+ * @param index The index
+ * @param number Channel number, from 0 to dvbcfg_zapindex_count() - 1
+ * @param channel Where to copy the channel
+ * @return 0 on success, -ENOENT if there is no such channel
+ */
+extern int dvbcfg_zapindex_get(struct dvbcfg_zapindex *index, int number,
+			       struct dvbcfg_zapchannel *channel);
+
+/**
+ * Look up channels by service id, in channel file order.
+ *
+ * @param index The index
+ * @param service_id Service id to look for
+ * @param callback Callback called for each matching channel
+ * @param private_data Private data for the callback
+ * @return 0 or value from the callback if it's > 0
+ */
+extern int dvbcfg_zapindex_find_service(struct dvbcfg_zapindex *index, int service_id,
+					dvbcfg_zapcallback callback, void *private_data);
+
+/**
+ * Ways of matching a name in dvbcfg_zapindex_search().
+ */
+enum dvbcfg_zapindex_search_mode {
+	DVBCFG_ZAPINDEX_SEARCH_PREFIX,		/* names starting with the query, by name */
+	DVBCFG_ZAPINDEX_SEARCH_SUBSTRING,	/* names containing it, in file order */
+	DVBCFG_ZAPINDEX_SEARCH_FUZZY,		/* names sharing most of its trigrams, best first */
+};
+
+/**
+ * Search channels by name, as a user types it. Case, spaces and
+ * punctuation are ignored on both sides, so "bbc1" finds "BBC 1 London".
+ * Prefix and substring searches use tables kept in the index and take
+ * microseconds however many channels there are; a fuzzy search also scores
+ * every channel sharing a trigram with the query. Queries shorter than
+ * three letters do a prefix search in fuzzy mode, and look at each name
+ * in substring mode.
+ *
+ * @param index The index
+ * @param query What to look for
+ * @param mode One of DVBCFG_ZAPINDEX_SEARCH_*
+ * @param numbers Where to put the channel numbers found
+ * @param max Room in numbers
+ * @return Number of channel numbers put in numbers, or -EINVAL for an unknown
+ * mode, -ENOMEM
+ */
+extern int dvbcfg_zapindex_search(struct dvbcfg_zapindex *index, const char *query, int mode,
+				  int *numbers, int max);
+
+/**
+ * Merge changed channels into a linuxtv channel file and its index. A
+ * change replaces the first channel of the same name; channels not in the
+ * file yet are appended, in order. If a channel is given more than once, the
+ * last one wins. Only the changed lines are formatted: the rest of the file
+ * is copied as it is, comments included. The new file is written aside and
+ * renamed into place, then the index is updated from the changes and saved
+ * the same way.
+ *
+ * @param index Index opened on filename
+ * @param filename Linuxtv channel file
+ * @param indexname Index file, or NULL for "<filename>.idx"
+ * @param changes Changed channels
+ * @param count Number of changed channels
+ * @return 0 on success, -ESTALE if the file changed since the index was
+ * opened, -EINVAL if a channel cannot be written, or another negative errno
+ */
+extern int dvbcfg_zapindex_merge(struct dvbcfg_zapindex *index, const char *filename,
+				 const char *indexname,
+				 const struct dvbcfg_zapchannel *changes, int count);
+
+/**
+ * Publish an index to a shared store in /dev/shm. The store holds one
+ * read only image of the index at a time; publishing a new one is atomic,
+ * and processes attached to the store keep the image they mapped until they
+ * refresh. Publishers of the same store are serialised.
+ *
+ * @param index The index to publish
+ * @param storename Name of the store (no slashes)
+ * @return 0 on success, or a negative errno
+ */
+extern int dvbcfg_zapindex_publish(struct dvbcfg_zapindex *index, const char *storename);
+
+/**
+ * Attach to a shared store. The result is used like an index from
+ * dvbcfg_zapindex_open(), but nothing is parsed, no channel file is
+ * looked at, and lookups take no locks. dvbcfg_zapindex_merge() is not
+ * meant for it.
+ *
+ * @param storename Name of the store
+ * @return The index, or NULL on failure (errno is ENOENT if nothing has
+ * been published yet)
+ */
+extern struct dvbcfg_zapindex *dvbcfg_zapindex_attach(const char *storename);
+
+/**
+ * Switch an attached index to the latest published image. This is one
+ * memory read when nothing new was published, so long running processes
+ * can call it before every lookup.
+ *
+ * @param index The index
+ * @return 1 if the image changed, 0 if not (or the index is not attached
+ * to a store), or a negative errno
+ */
+extern int dvbcfg_zapindex_refresh(struct dvbcfg_zapindex *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DVBCFG_ZAPINDEX_H */
@@ -23,6 +23,7 @@
 
 #include <string.h>
 #include <libdvbmisc/dvbmisc.h>
+#include <libdvbmisc/dvbprobe.h>
 #include <pthread.h>
 #include <libucsi/mpeg/descriptor.h>
 #include "en50221_app_ca.h"
@@ -46,6 +47,29 @@ struct en50221_app_ca {
 	pthread_mutex_t lock;
 };
 
+// state of a program in a ca_pmt list, relative to what the CAM was last sent
+#define CA_PMT_ENTRY_SENT	0
+#define CA_PMT_ENTRY_NEW	1
+#define CA_PMT_ENTRY_CHANGED	2
+#define CA_PMT_ENTRY_REMOVED	3
+
+struct ca_pmt_entry {
+	uint16_t program_number;
+	uint8_t version_number;
+	uint8_t state;
+	uint8_t *ca_pmt;
+	uint32_t ca_pmt_length;
+};
+
+struct en50221_app_ca_pmt_list {
+	uint32_t max_programs;
+	uint32_t count;
+	struct ca_pmt_entry *entries;
+
+	uint8_t *format_buf;
+	uint32_t format_buf_length;
+};
+
 struct ca_pmt_descriptor {
 	uint8_t *descriptor;
 	uint16_t length;
@@ -72,6 +96,10 @@ static void en50221_ca_try_move_pmt_descriptors(struct ca_pmt_descriptor **pmt_d
 static uint32_t en50221_ca_calculate_length(struct ca_pmt_descriptor *pmt_descriptors,
 					    uint32_t *pmt_descriptors_length,
 					    struct ca_pmt_stream *pmt_streams);
+static void en50221_ca_set_pmt_cmd_id(uint8_t *ca_pmt, uint32_t ca_pmt_length,
+				      uint8_t ca_pmt_cmd_id);
+static void en50221_ca_pmt_list_drop(struct en50221_app_ca_pmt_list *list,
+				     uint32_t idx);
 static int en50221_app_ca_parse_info(struct en50221_app_ca *ca,
 				     uint8_t slot_id,
 				     uint16_t session_number,
@@ -165,6 +193,7 @@ int en50221_app_ca_pmt(struct en50221_app_ca *ca,
 	iov[1].iov_len = ca_pmt_length;
 
 	// create the data and send it
+	DVBPROBE3(ca_pmt_send, session_number, ca_pmt[0], ca_pmt_length);
 	return ca->funcs->send_datav(ca->funcs->arg, session_number, iov, 2);
 }
 
@@ -313,6 +342,226 @@ int en50221_ca_format_pmt(struct mpeg_pmt_section *pmt, uint8_t * data,
 
 
 
+struct en50221_app_ca_pmt_list *en50221_app_ca_pmt_list_create(uint32_t max_programs,
+							       uint32_t max_ca_pmt_length)
+{
+	struct en50221_app_ca_pmt_list *list = NULL;
+
+	// create structure and set it up
+	list = malloc(sizeof(struct en50221_app_ca_pmt_list));
+	if (list == NULL)
+		return NULL;
+	list->max_programs = max_programs;
+	list->count = 0;
+	list->format_buf_length = max_ca_pmt_length;
+	list->entries = malloc(sizeof(struct ca_pmt_entry) * max_programs);
+	list->format_buf = malloc(max_ca_pmt_length);
+	if ((list->entries == NULL) || (list->format_buf == NULL)) {
+		en50221_app_ca_pmt_list_destroy(list);
+		return NULL;
+	}
+
+	// done
+	return list;
+}
+
+void en50221_app_ca_pmt_list_destroy(struct en50221_app_ca_pmt_list *list)
+{
+	uint32_t i;
+
+	if (list->entries) {
+		for (i = 0; i < list->count; i++)
+			free(list->entries[i].ca_pmt);
+		free(list->entries);
+	}
+	free(list->format_buf);
+	free(list);
+}
+
+int en50221_app_ca_pmt_list_set(struct en50221_app_ca_pmt_list *list,
+				struct mpeg_pmt_section *pmt,
+				int move_ca_descriptors,
+				uint8_t ca_pmt_cmd_id)
+{
+	uint16_t program_number = mpeg_pmt_section_program_number(pmt);
+	struct ca_pmt_entry *entry = NULL;
+	uint32_t i;
+
+	// find the program
+	for (i = 0; i < list->count; i++) {
+		if (list->entries[i].program_number == program_number) {
+			entry = &list->entries[i];
+			break;
+		}
+	}
+	if (entry && (entry->state != CA_PMT_ENTRY_REMOVED) &&
+	    (entry->version_number == pmt->head.version_number))
+		return 0;
+	if ((entry == NULL) && (list->count == list->max_programs))
+		return -1;
+
+	// format only this program; the list management byte is set on sending
+	int size = en50221_ca_format_pmt(pmt, list->format_buf, list->format_buf_length,
+					 move_ca_descriptors, CA_LIST_MANAGEMENT_ONLY,
+					 ca_pmt_cmd_id);
+	if (size < 0)
+		return -1;
+	uint8_t *ca_pmt = malloc(size);
+	if (ca_pmt == NULL)
+		return -1;
+	memcpy(ca_pmt, list->format_buf, size);
+
+	if (entry == NULL) {
+		entry = &list->entries[list->count++];
+		entry->program_number = program_number;
+		entry->state = CA_PMT_ENTRY_NEW;
+	} else {
+		free(entry->ca_pmt);
+		if (entry->state != CA_PMT_ENTRY_NEW)
+			entry->state = CA_PMT_ENTRY_CHANGED;
+	}
+	entry->version_number = pmt->head.version_number;
+	entry->ca_pmt = ca_pmt;
+	entry->ca_pmt_length = size;
+
+	return 1;
+}
+
+int en50221_app_ca_pmt_list_remove(struct en50221_app_ca_pmt_list *list,
+				   uint16_t program_number)
+{
+	uint32_t i;
+
+	for (i = 0; i < list->count; i++) {
+		if ((list->entries[i].program_number != program_number) ||
+		    (list->entries[i].state == CA_PMT_ENTRY_REMOVED))
+			continue;
+
+		// the CAM never heard of it: just forget it
+		if (list->entries[i].state == CA_PMT_ENTRY_NEW)
+			en50221_ca_pmt_list_drop(list, i);
+		else
+			list->entries[i].state = CA_PMT_ENTRY_REMOVED;
+		return 0;
+	}
+
+	return -1;
+}
+
+int en50221_app_ca_pmt_list_send(struct en50221_app_ca *ca,
+				 uint16_t session_number,
+				 struct en50221_app_ca_pmt_list *list)
+{
+	uint32_t i;
+
+	// removed programs are simply left out of a full list
+	for (i = 0; i < list->count;) {
+		if (list->entries[i].state == CA_PMT_ENTRY_REMOVED)
+			en50221_ca_pmt_list_drop(list, i);
+		else
+			i++;
+	}
+
+	for (i = 0; i < list->count; i++) {
+		struct ca_pmt_entry *entry = &list->entries[i];
+
+		if (list->count == 1)
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_ONLY;
+		else if (i == 0)
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_FIRST;
+		else if (i == (list->count - 1))
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_LAST;
+		else
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_MORE;
+
+		if (en50221_app_ca_pmt(ca, session_number, entry->ca_pmt, entry->ca_pmt_length))
+			return -1;
+		entry->state = CA_PMT_ENTRY_SENT;
+	}
+
+	return 0;
+}
+
+int en50221_app_ca_pmt_list_send_changes(struct en50221_app_ca *ca,
+					 uint16_t session_number,
+					 struct en50221_app_ca_pmt_list *list)
+{
+	uint32_t i;
+	int sent = 0;
+
+	for (i = 0; i < list->count;) {
+		struct ca_pmt_entry *entry = &list->entries[i];
+
+		switch (entry->state) {
+		case CA_PMT_ENTRY_SENT:
+			i++;
+			continue;
+
+		case CA_PMT_ENTRY_NEW:
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_ADD;
+			break;
+
+		case CA_PMT_ENTRY_CHANGED:
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_UPDATE;
+			break;
+
+		case CA_PMT_ENTRY_REMOVED:
+			entry->ca_pmt[0] = CA_LIST_MANAGEMENT_UPDATE;
+			en50221_ca_set_pmt_cmd_id(entry->ca_pmt, entry->ca_pmt_length,
+						  CA_PMT_CMD_ID_NOT_SELECTED);
+			break;
+		}
+
+		if (en50221_app_ca_pmt(ca, session_number, entry->ca_pmt, entry->ca_pmt_length))
+			return -1;
+		sent++;
+
+		if (entry->state == CA_PMT_ENTRY_REMOVED) {
+			en50221_ca_pmt_list_drop(list, i);
+		} else {
+			entry->state = CA_PMT_ENTRY_SENT;
+			i++;
+		}
+	}
+
+	return sent;
+}
+
+static void en50221_ca_pmt_list_drop(struct en50221_app_ca_pmt_list *list,
+				     uint32_t idx)
+{
+	free(list->entries[idx].ca_pmt);
+
+	// keep the others in order: it is the order they are sent in
+	memmove(&list->entries[idx], &list->entries[idx + 1],
+		(list->count - idx - 1) * sizeof(struct ca_pmt_entry));
+	list->count--;
+}
+
+static void en50221_ca_set_pmt_cmd_id(uint8_t *ca_pmt, uint32_t ca_pmt_length,
+				      uint8_t ca_pmt_cmd_id)
+{
+	uint32_t pos;
+	uint32_t info_length;
+
+	// the cmd_id leads every non-empty descriptor loop (see en50221_ca_format_pmt())
+	if (ca_pmt_length < 6)
+		return;
+	info_length = ((ca_pmt[4] & 0x0f) << 8) | ca_pmt[5];
+	pos = 6;
+	if (info_length && (pos < ca_pmt_length))
+		ca_pmt[pos] = ca_pmt_cmd_id;
+	pos += info_length;
+
+	while ((pos + 5) <= ca_pmt_length) {
+		info_length = ((ca_pmt[pos + 3] & 0x0f) << 8) | ca_pmt[pos + 4];
+		pos += 5;
+		if (info_length && (pos < ca_pmt_length))
+			ca_pmt[pos] = ca_pmt_cmd_id;
+		pos += info_length;
+	}
+}
+
 static int en50221_ca_extract_pmt_descriptors(struct mpeg_pmt_section *pmt,
 					      struct ca_pmt_descriptor **outdescriptors)
 {
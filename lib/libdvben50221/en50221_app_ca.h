@@ -208,6 +208,86 @@ extern int en50221_ca_format_pmt(struct mpeg_pmt_section *pmt,
 				 uint8_t ca_pmt_list_management,
 				 uint8_t ca_pmt_cmd_id);
 
+/**
+ * A list of programs to descramble, kept as formatted ca_pmts so each
+ * program is only formatted again when its PMT changes. Access to a list
+ * must be serialised by the caller.
+ */
+struct en50221_app_ca_pmt_list;
+
+/**
+ * Create a ca_pmt list.
+ *
+ * @param max_programs Maximum number of programs in the list.
+ * @param max_ca_pmt_length Largest formatted ca_pmt accepted for a program.
+ * @return The list, or NULL on failure.
+ */
+extern struct en50221_app_ca_pmt_list *en50221_app_ca_pmt_list_create(uint32_t max_programs,
+								      uint32_t max_ca_pmt_length);
+
+/**
+ * Destroy a ca_pmt list.
+ *
+ * @param list The list.
+ */
+extern void en50221_app_ca_pmt_list_destroy(struct en50221_app_ca_pmt_list *list);
+
+/**
+ * Add a program to the list, or replace its ca_pmt if the PMT version has
+ * changed. Other programs in the list are left untouched.
+ *
+ * @param list The list.
+ * @param pmt The program's PMT.
+ * @param move_ca_descriptors As for en50221_ca_format_pmt().
+ * @param ca_pmt_cmd_id One of the CA_PMT_CMD_ID_*.
+ * @return 1 if the program was added or changed, 0 if it was already
+ * there with this version, or -1 on error.
+ */
+extern int en50221_app_ca_pmt_list_set(struct en50221_app_ca_pmt_list *list,
+				       struct mpeg_pmt_section *pmt,
+				       int move_ca_descriptors,
+				       uint8_t ca_pmt_cmd_id);
+
+/**
+ * Remove a program from the list.
+ *
+ * @param list The list.
+ * @param program_number Program to remove.
+ * @return 0 on success, -1 if the program is not in the list.
+ */
+extern int en50221_app_ca_pmt_list_remove(struct en50221_app_ca_pmt_list *list,
+					  uint16_t program_number);
+
+/**
+ * Send the whole list to the CAM: one ca_pmt per program, with
+ * CA_LIST_MANAGEMENT_FIRST/MORE/LAST (or ONLY for a single program). This
+ * replaces whatever the CAM was descrambling before. The ca_pmts are sent
+ * straight from the list, only their list management byte is rewritten.
+ *
+ * @param ca ca resource instance.
+ * @param session_number Session number to send it on.
+ * @param list The list.
+ * @return 0 on success, -1 on failure.
+ */
+extern int en50221_app_ca_pmt_list_send(struct en50221_app_ca *ca,
+					uint16_t session_number,
+					struct en50221_app_ca_pmt_list *list);
+
+/**
+ * Send only what changed since the list was last sent: CA_LIST_MANAGEMENT_ADD
+ * for new programs, CA_LIST_MANAGEMENT_UPDATE for changed ones, and an
+ * UPDATE with CA_PMT_CMD_ID_NOT_SELECTED for removed ones. The CAM must
+ * support ADD/UPDATE; otherwise use en50221_app_ca_pmt_list_send().
+ *
+ * @param ca ca resource instance.
+ * @param session_number Session number to send it on.
+ * @param list The list.
+ * @return Number of ca_pmts sent, or -1 on failure.
+ */
+extern int en50221_app_ca_pmt_list_send_changes(struct en50221_app_ca *ca,
+						uint16_t session_number,
+						struct en50221_app_ca_pmt_list *list);
+
 /**
  * Pass data received for this resource into it for parsing.
  *
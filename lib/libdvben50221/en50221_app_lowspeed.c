@@ -22,16 +22,31 @@
 */
 
 #include <string.h>
+#include <sys/uio.h>
 #include <libdvbmisc/dvbmisc.h>
 #include <pthread.h>
 #include "en50221_app_lowspeed.h"
 #include "en50221_app_tags.h"
 #include "asn_1.h"
 
+// data queued for the CAM, per session
+#define LOWSPEED_RCV_QUEUE_SIZE 65536
+
 struct en50221_app_lowspeed_session {
 	uint16_t session_number;
+
+	// comms_send reassembly; kept for the next block
 	uint8_t *block_chain;
 	uint32_t block_length;
+	uint32_t block_size;
+
+	// comms_rcv data waiting for a get_next_buffer
+	uint8_t *rcv_queue;
+	uint32_t rcv_head;
+	uint32_t rcv_count;
+	uint32_t rcv_buffer_size;	// from set_params
+	int rcv_phase_id;		// of the request outstanding, or -1
+	int rcv_sending;
 
 	struct en50221_app_lowspeed_session *next;
 };
@@ -64,6 +79,12 @@ static int en50221_app_lowspeed_parse_send(struct en50221_app_lowspeed *lowspeed
 					   int more_last,
 					   uint8_t *data,
 					   uint32_t data_length);
+static struct en50221_app_lowspeed_session *en50221_app_lowspeed_find_session(struct en50221_app_lowspeed *lowspeed,
+									      uint16_t session_number,
+									      int create);
+static void en50221_app_lowspeed_free_session(struct en50221_app_lowspeed_session *session);
+static int en50221_app_lowspeed_send_queued(struct en50221_app_lowspeed *lowspeed,
+					    uint16_t session_number);
 
 
 
@@ -92,9 +113,7 @@ void en50221_app_lowspeed_destroy(struct en50221_app_lowspeed *lowspeed)
 	struct en50221_app_lowspeed_session *cur_s = lowspeed->sessions;
 	while (cur_s) {
 		struct en50221_app_lowspeed_session *next = cur_s->next;
-		if (cur_s->block_chain)
-			free(cur_s->block_chain);
-		free(cur_s);
+		en50221_app_lowspeed_free_session(cur_s);
 		cur_s = next;
 	}
 
@@ -110,15 +129,13 @@ void en50221_app_lowspeed_clear_session(struct en50221_app_lowspeed *lowspeed,
 	struct en50221_app_lowspeed_session *prev_s = NULL;
 	while (cur_s) {
 		if (cur_s->session_number == session_number) {
-			if (cur_s->block_chain)
-				free(cur_s->block_chain);
 			if (prev_s) {
 				prev_s->next = cur_s->next;
 			} else {
 				lowspeed->sessions = cur_s->next;
 			}
-			free(cur_s);
-			return;
+			en50221_app_lowspeed_free_session(cur_s);
+			break;
 		}
 
 		prev_s = cur_s;
@@ -169,11 +186,32 @@ int en50221_app_lowspeed_send_comms_data(struct en50221_app_lowspeed *lowspeed,
 					 uint8_t phase_id,
 					 uint32_t tx_data_length,
 					 uint8_t * tx_data)
+{
+	struct iovec iov;
+
+	iov.iov_base = tx_data;
+	iov.iov_len = tx_data_length;
+	return en50221_app_lowspeed_send_comms_datav(lowspeed, session_number,
+						     phase_id, &iov, 1);
+}
+
+int en50221_app_lowspeed_send_comms_datav(struct en50221_app_lowspeed *lowspeed,
+					  uint16_t session_number,
+					  uint8_t phase_id,
+					  struct iovec *vector,
+					  int iov_count)
 {
 	uint8_t buf[10];
+	uint32_t tx_data_length = 0;
+	int i;
+
+	if ((iov_count < 0) || (iov_count > EN50221_APP_LOWSPEED_MAX_IOV))
+		return -1;
+	for (i = 0; i < iov_count; i++)
+		tx_data_length += vector[i].iov_len;
 
 	// the spec defines this limit
-	if (tx_data_length > 254) {
+	if (tx_data_length > EN50221_APP_LOWSPEED_MAX_DATA) {
 		return -1;
 	}
 	// set up the tag
@@ -189,16 +227,82 @@ int en50221_app_lowspeed_send_comms_data(struct en50221_app_lowspeed *lowspeed,
 	// the phase_id
 	buf[3 + length_field_len] = phase_id;
 
-	// build the iovecs
-	struct iovec iov[2];
+	// the header, then the data where it lies
+	struct iovec iov[1 + EN50221_APP_LOWSPEED_MAX_IOV];
 	iov[0].iov_base = buf;
 	iov[0].iov_len = 3 + length_field_len + 1;
-	iov[1].iov_base = tx_data;
-	iov[1].iov_len = tx_data_length;
+	memcpy(iov + 1, vector, iov_count * sizeof(struct iovec));
 
 	// create the data and send it
 	return lowspeed->funcs->send_datav(lowspeed->funcs->arg,
-					   session_number, iov, 2);
+					   session_number, iov, 1 + iov_count);
+}
+
+int en50221_app_lowspeed_queue_comms_data(struct en50221_app_lowspeed *lowspeed,
+					  uint16_t session_number,
+					  struct iovec *vector,
+					  int iov_count)
+{
+	uint32_t queued = 0;
+	int i;
+
+	pthread_mutex_lock(&lowspeed->lock);
+	struct en50221_app_lowspeed_session *cur_s =
+		en50221_app_lowspeed_find_session(lowspeed, session_number, 1);
+	if (cur_s == NULL) {
+		pthread_mutex_unlock(&lowspeed->lock);
+		return -1;
+	}
+	if (cur_s->rcv_queue == NULL) {
+		cur_s->rcv_queue = malloc(LOWSPEED_RCV_QUEUE_SIZE);
+		if (cur_s->rcv_queue == NULL) {
+			print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
+			pthread_mutex_unlock(&lowspeed->lock);
+			return -1;
+		}
+	}
+
+	// copy in as much as there is room for
+	for (i = 0; i < iov_count; i++) {
+		uint8_t *src = vector[i].iov_base;
+		uint32_t len = vector[i].iov_len;
+
+		while (len && (cur_s->rcv_count < LOWSPEED_RCV_QUEUE_SIZE)) {
+			uint32_t tail = (cur_s->rcv_head + cur_s->rcv_count) % LOWSPEED_RCV_QUEUE_SIZE;
+			uint32_t chunk = LOWSPEED_RCV_QUEUE_SIZE - tail;
+			if (chunk > LOWSPEED_RCV_QUEUE_SIZE - cur_s->rcv_count)
+				chunk = LOWSPEED_RCV_QUEUE_SIZE - cur_s->rcv_count;
+			if (chunk > len)
+				chunk = len;
+
+			memcpy(cur_s->rcv_queue + tail, src, chunk);
+			cur_s->rcv_count += chunk;
+			queued += chunk;
+			src += chunk;
+			len -= chunk;
+		}
+	}
+	pthread_mutex_unlock(&lowspeed->lock);
+
+	// the CAM may be waiting for it already
+	if (en50221_app_lowspeed_send_queued(lowspeed, session_number))
+		return -1;
+	return queued;
+}
+
+uint32_t en50221_app_lowspeed_queued_comms_data(struct en50221_app_lowspeed *lowspeed,
+						uint16_t session_number)
+{
+	uint32_t count = 0;
+
+	pthread_mutex_lock(&lowspeed->lock);
+	struct en50221_app_lowspeed_session *cur_s =
+		en50221_app_lowspeed_find_session(lowspeed, session_number, 0);
+	if (cur_s)
+		count = cur_s->rcv_count;
+	pthread_mutex_unlock(&lowspeed->lock);
+
+	return count;
 }
 
 int en50221_app_lowspeed_message(struct en50221_app_lowspeed *lowspeed,
@@ -412,15 +516,36 @@ static int en50221_app_lowspeed_parse_command(struct en50221_app_lowspeed *lowsp
 		return -1;
 	}
 
-	// tell the app
+	// the queued data goes in buffers of the size the CAM asks for, when
+	// it asks for them
 	pthread_mutex_lock(&lowspeed->lock);
+	int send_queued = 0;
+	if ((command_id == COMMS_COMMAND_ID_SET_PARAMS) ||
+	    (command_id == COMMS_COMMAND_ID_GET_NEXT_BUFFER)) {
+		struct en50221_app_lowspeed_session *cur_s =
+			en50221_app_lowspeed_find_session(lowspeed, session_number, 1);
+		if (cur_s == NULL) {
+			pthread_mutex_unlock(&lowspeed->lock);
+			return -1;
+		}
+		if (command_id == COMMS_COMMAND_ID_SET_PARAMS) {
+			cur_s->rcv_buffer_size = command.u.set_params.buffer_size;
+		} else {
+			cur_s->rcv_phase_id = command.u.get_next_buffer.phase_id;
+			send_queued = 1;
+		}
+	}
+
+	// tell the app
 	en50221_app_lowspeed_command_callback cb = lowspeed->command_callback;
 	void *cb_arg = lowspeed->command_callback_arg;
 	pthread_mutex_unlock(&lowspeed->lock);
 	if (cb) {
-		return cb(cb_arg, slot_id, session_number, command_id,
-			  &command);
+		if (cb(cb_arg, slot_id, session_number, command_id, &command))
+			return -1;
 	}
+	if (send_queued)
+		return en50221_app_lowspeed_send_queued(lowspeed, session_number);
 	return 0;
 }
 
@@ -445,73 +570,51 @@ static int en50221_app_lowspeed_parse_send(struct en50221_app_lowspeed *lowspeed
 	}
 	// skip over the length field
 	data += length_field_len;
+	data_length = asn_data_length;
 
 	// find previous session
 	pthread_mutex_lock(&lowspeed->lock);
-	struct en50221_app_lowspeed_session *cur_s = lowspeed->sessions;
-	while (cur_s) {
-		if (cur_s->session_number == session_number)
-			break;
-		cur_s = cur_s->next;
+	struct en50221_app_lowspeed_session *cur_s =
+		en50221_app_lowspeed_find_session(lowspeed, session_number, !more_last);
+	if ((cur_s == NULL) && !more_last) {
+		pthread_mutex_unlock(&lowspeed->lock);
+		return -1;
 	}
 
-	// more data is still to come
-	if (!more_last) {
-		// if there was no previous session, create one
-		if (cur_s == NULL) {
-			cur_s = malloc(sizeof(struct en50221_app_lowspeed_session));
-			if (cur_s == NULL) {
-				print(LOG_LEVEL, ERROR, 1,
-				      "Ran out of memory\n");
+	// append the data to any preceding fragments
+	if ((cur_s != NULL) && (!more_last || cur_s->block_length)) {
+		// double it, so a block in many fragments is not copied for each
+		if (cur_s->block_length + data_length > cur_s->block_size) {
+			uint32_t new_size = cur_s->block_size ? cur_s->block_size : 1024;
+			while (new_size < cur_s->block_length + data_length)
+				new_size *= 2;
+			uint8_t *new_data = realloc(cur_s->block_chain, new_size);
+			if (new_data == NULL) {
+				print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
 				pthread_mutex_unlock(&lowspeed->lock);
 				return -1;
 			}
-			cur_s->session_number = session_number;
-			cur_s->block_chain = NULL;
-			cur_s->block_length = 0;
-			cur_s->next = lowspeed->sessions;
-			lowspeed->sessions = cur_s;
+			cur_s->block_chain = new_data;
+			cur_s->block_size = new_size;
 		}
-		// append the data
-		uint8_t *new_data = realloc(cur_s->block_chain,
-					    cur_s->block_length + asn_data_length);
-		if (new_data == NULL) {
-			print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
-			pthread_mutex_unlock(&lowspeed->lock);
-			return -1;
-		}
-		memcpy(new_data + cur_s->block_length, data, asn_data_length);
-		cur_s->block_chain = new_data;
-		cur_s->block_length += asn_data_length;
+		memcpy(cur_s->block_chain + cur_s->block_length, data, data_length);
+		cur_s->block_length += data_length;
 
-		// done
-		pthread_mutex_unlock(&lowspeed->lock);
-		return 0;
-	}
-	// we hit the last of a possible chain of fragments
-	int do_free = 0;
-	if (cur_s != NULL) {
-		// we have a preceding fragment - need to append
-		uint8_t *new_data = realloc(cur_s->block_chain,
-					    cur_s->block_length + asn_data_length);
-		if (new_data == NULL) {
-			print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
+		// more data is still to come
+		if (!more_last) {
 			pthread_mutex_unlock(&lowspeed->lock);
-			return -1;
+			return 0;
 		}
-		memcpy(new_data + cur_s->block_length, data, asn_data_length);
-		asn_data_length = cur_s->block_length + asn_data_length;
-		data = new_data;
-		cur_s->block_chain = NULL;
+
+		// we hit the last of a chain of fragments
+		data = cur_s->block_chain;
+		data_length = cur_s->block_length;
 		cur_s->block_length = 0;
-		do_free = 1;
 	}
 	// check the reassembled data length
-	if (asn_data_length < 1) {
+	if (data_length < 1) {
 		pthread_mutex_unlock(&lowspeed->lock);
 		print(LOG_LEVEL, ERROR, 1, "Received short data\n");
-		if (do_free)
-			free(data);
 		return -1;
 	}
 	// now, parse the data
@@ -524,10 +627,102 @@ static int en50221_app_lowspeed_parse_send(struct en50221_app_lowspeed *lowspeed
 	int cbstatus = 0;
 	if (cb) {
 		cbstatus =
-		    cb(cb_arg, slot_id, session_number, phase_id, data + 1, asn_data_length - 1);
+		    cb(cb_arg, slot_id, session_number, phase_id, data + 1, data_length - 1);
 	}
 	// done
-	if (do_free)
-		free(data);
 	return cbstatus;
 }
+
+static struct en50221_app_lowspeed_session *en50221_app_lowspeed_find_session(struct en50221_app_lowspeed *lowspeed,
+									      uint16_t session_number,
+									      int create)
+{
+	struct en50221_app_lowspeed_session *cur_s = lowspeed->sessions;
+	while (cur_s) {
+		if (cur_s->session_number == session_number)
+			return cur_s;
+		cur_s = cur_s->next;
+	}
+	if (!create)
+		return NULL;
+
+	// if there was no previous session, create one
+	cur_s = calloc(1, sizeof(struct en50221_app_lowspeed_session));
+	if (cur_s == NULL) {
+		print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
+		return NULL;
+	}
+	cur_s->session_number = session_number;
+	cur_s->rcv_phase_id = -1;
+	cur_s->next = lowspeed->sessions;
+	lowspeed->sessions = cur_s;
+	return cur_s;
+}
+
+static void en50221_app_lowspeed_free_session(struct en50221_app_lowspeed_session *session)
+{
+	if (session->block_chain)
+		free(session->block_chain);
+	if (session->rcv_queue)
+		free(session->rcv_queue);
+	free(session);
+}
+
+static int en50221_app_lowspeed_send_queued(struct en50221_app_lowspeed *lowspeed,
+					    uint16_t session_number)
+{
+	pthread_mutex_lock(&lowspeed->lock);
+	struct en50221_app_lowspeed_session *cur_s =
+		en50221_app_lowspeed_find_session(lowspeed, session_number, 0);
+
+	// nothing to do unless the CAM has asked for a buffer and there is
+	// data for it
+	if ((cur_s == NULL) || (cur_s->rcv_phase_id < 0) ||
+	    (cur_s->rcv_count == 0) || cur_s->rcv_sending) {
+		pthread_mutex_unlock(&lowspeed->lock);
+		return 0;
+	}
+
+	uint32_t length = cur_s->rcv_count;
+	if (cur_s->rcv_buffer_size && (length > cur_s->rcv_buffer_size))
+		length = cur_s->rcv_buffer_size;
+	if (length > EN50221_APP_LOWSPEED_MAX_DATA)
+		length = EN50221_APP_LOWSPEED_MAX_DATA;
+
+	// it is sent from the queue, in two pieces if it wraps
+	struct iovec iov[2];
+	int iov_count = 1;
+	iov[0].iov_base = cur_s->rcv_queue + cur_s->rcv_head;
+	iov[0].iov_len = length;
+	if (cur_s->rcv_head + length > LOWSPEED_RCV_QUEUE_SIZE) {
+		iov[0].iov_len = LOWSPEED_RCV_QUEUE_SIZE - cur_s->rcv_head;
+		iov[1].iov_base = cur_s->rcv_queue;
+		iov[1].iov_len = length - iov[0].iov_len;
+		iov_count = 2;
+	}
+	uint8_t phase_id = cur_s->rcv_phase_id;
+
+	// the data stays put while it is sent, as nothing is queued over it
+	cur_s->rcv_phase_id = -1;
+	cur_s->rcv_sending = 1;
+	pthread_mutex_unlock(&lowspeed->lock);
+
+	int status = en50221_app_lowspeed_send_comms_datav(lowspeed, session_number,
+							   phase_id, iov, iov_count);
+
+	pthread_mutex_lock(&lowspeed->lock);
+	cur_s = en50221_app_lowspeed_find_session(lowspeed, session_number, 0);
+	if (cur_s) {
+		cur_s->rcv_sending = 0;
+		if (status == 0) {
+			cur_s->rcv_head = (cur_s->rcv_head + length) % LOWSPEED_RCV_QUEUE_SIZE;
+			cur_s->rcv_count -= length;
+		} else {
+			// it can be tried again
+			cur_s->rcv_phase_id = phase_id;
+		}
+	}
+	pthread_mutex_unlock(&lowspeed->lock);
+
+	return status;
+}
@@ -30,6 +30,7 @@ extern "C" {
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <sys/uio.h>
 #include <libdvben50221/en50221_app_utils.h>
 #include <libucsi/dvb/descriptor.h>
 
@@ -49,6 +50,12 @@ extern "C" {
 #define COMMS_REPLY_ID_GET_NEXT_BUFFER_ACK      0x05
 #define COMMS_REPLY_ID_SEND_ACK                 0x06
 
+// the most data one comms_rcv may carry
+#define EN50221_APP_LOWSPEED_MAX_DATA           254
+
+// the most pieces en50221_app_lowspeed_send_comms_datav() takes
+#define EN50221_APP_LOWSPEED_MAX_IOV            8
+
 #define EN50221_APP_LOWSPEED_RESOURCEID(DEVICE_TYPE, DEVICE_NUMBER) MKRID(96,((DEVICE_TYPE)<<2)|((DEVICE_NUMBER) & 0x03),1)
 
 
@@ -195,6 +202,55 @@ extern int en50221_app_lowspeed_send_comms_data(struct en50221_app_lowspeed *low
 						uint32_t tx_data_length,
 						uint8_t * tx_data);
 
+/**
+ * Send received data to the CAM, from several pieces. The pieces are sent
+ * where they lie, after a header built on the stack.
+ *
+ * @param lowspeed lowspeed resource instance.
+ * @param session_number Session number to send it on.
+ * @param phase_id Comms phase id.
+ * @param vector The pieces, of EN50221_APP_LOWSPEED_MAX_DATA bytes at most
+ * in all.
+ * @param iov_count Number of pieces (max EN50221_APP_LOWSPEED_MAX_IOV).
+ * @return 0 on success, -1 on failure.
+ */
+extern int en50221_app_lowspeed_send_comms_datav(struct en50221_app_lowspeed *lowspeed,
+						 uint16_t session_number,
+						 uint8_t phase_id,
+						 struct iovec *vector,
+						 int iov_count);
+
+/**
+ * Queue received data for the CAM. It is sent as the CAM asks for it with
+ * get_next_buffer, in comms_rcvs of the buffer_size of its last set_params,
+ * with the phase_id of the request; straight away if the CAM is already
+ * waiting. Each comms_rcv is sent from the queue where it lies.
+ *
+ * Once data has been queued on a session, the command callback should leave
+ * the get_next_buffer commands on it to the queue.
+ *
+ * @param lowspeed lowspeed resource instance.
+ * @param session_number Session number to send it on.
+ * @param vector The data.
+ * @param iov_count Number of pieces.
+ * @return The number of bytes queued, which is less than asked for if the
+ * queue is full, or -1 on failure.
+ */
+extern int en50221_app_lowspeed_queue_comms_data(struct en50221_app_lowspeed *lowspeed,
+						 uint16_t session_number,
+						 struct iovec *vector,
+						 int iov_count);
+
+/**
+ * Find out how much data is waiting in a session's queue.
+ *
+ * @param lowspeed lowspeed resource instance.
+ * @param session_number Session number concerned.
+ * @return The number of bytes.
+ */
+extern uint32_t en50221_app_lowspeed_queued_comms_data(struct en50221_app_lowspeed *lowspeed,
+						       uint16_t session_number);
+
 /**
  * Pass data received for this resource into it for parsing.
  *
@@ -29,20 +29,27 @@
 #include "en50221_app_tags.h"
 #include "asn_1.h"
 
+// smallest arena allocated
+#define MMI_ARENA_MIN_SIZE 1024
+
+/**
+ * Where the fragments of one kind of object are reassembled. It grows to the
+ * largest object seen and is then kept, so the objects (and the text items
+ * within them) which follow are decoded without allocating anything.
+ */
+struct en50221_app_mmi_arena {
+	uint8_t *data;
+	uint32_t length;
+	uint32_t size;
+};
+
 struct en50221_app_mmi_session {
 	uint16_t session_number;
 
-	uint8_t *menu_block_chain;
-	uint32_t menu_block_length;
-
-	uint8_t *list_block_chain;
-	uint32_t list_block_length;
-
-	uint8_t *subtitlesegment_block_chain;
-	uint32_t subtitlesegment_block_length;
-
-	uint8_t *subtitledownload_block_chain;
-	uint32_t subtitledownload_block_length;
+	struct en50221_app_mmi_arena menu;
+	struct en50221_app_mmi_arena list;
+	struct en50221_app_mmi_arena subtitlesegment;
+	struct en50221_app_mmi_arena subtitledownload;
 
 	struct en50221_app_mmi_session *next;
 };
@@ -151,6 +158,15 @@ static int en50221_app_mmi_defragment_text(uint8_t * data,
 					   uint8_t ** outdata,
 					   uint32_t * outdata_length,
 					   uint32_t * outconsumed);
+static struct en50221_app_mmi_session *en50221_app_mmi_find_session(struct en50221_app_mmi *mmi,
+								    uint16_t session_number,
+								    int create);
+static struct en50221_app_mmi_arena *en50221_app_mmi_session_arena(struct en50221_app_mmi_session *session,
+								   uint32_t tag_id);
+static int en50221_app_mmi_arena_append(struct en50221_app_mmi_arena *arena,
+					uint8_t * data,
+					uint32_t data_length);
+static void en50221_app_mmi_release_arenas(struct en50221_app_mmi_session *session);
 
 
 
@@ -188,14 +204,7 @@ void en50221_app_mmi_destroy(struct en50221_app_mmi *mmi)
 	struct en50221_app_mmi_session *cur_s = mmi->sessions;
 	while (cur_s) {
 		struct en50221_app_mmi_session *next = cur_s->next;
-		if (cur_s->menu_block_chain)
-			free(cur_s->menu_block_chain);
-		if (cur_s->list_block_chain)
-			free(cur_s->list_block_chain);
-		if (cur_s->subtitlesegment_block_chain)
-			free(cur_s->subtitlesegment_block_chain);
-		if (cur_s->subtitledownload_block_chain)
-			free(cur_s->subtitledownload_block_chain);
+		en50221_app_mmi_release_arenas(cur_s);
 		free(cur_s);
 		cur_s = next;
 	}
@@ -212,21 +221,14 @@ void en50221_app_mmi_clear_session(struct en50221_app_mmi *mmi,
 	struct en50221_app_mmi_session *prev_s = NULL;
 	while (cur_s) {
 		if (cur_s->session_number == session_number) {
-			if (cur_s->menu_block_chain)
-				free(cur_s->menu_block_chain);
-			if (cur_s->list_block_chain)
-				free(cur_s->list_block_chain);
-			if (cur_s->subtitlesegment_block_chain)
-				free(cur_s->subtitlesegment_block_chain);
-			if (cur_s->subtitledownload_block_chain)
-				free(cur_s->subtitledownload_block_chain);
+			en50221_app_mmi_release_arenas(cur_s);
 			if (prev_s) {
 				prev_s->next = cur_s->next;
 			} else {
 				mmi->sessions = cur_s->next;
 			}
 			free(cur_s);
-			return;
+			break;
 		}
 
 		prev_s = cur_s;
@@ -709,8 +711,14 @@ static int en50221_app_mmi_parse_close(struct en50221_app_mmi *mmi,
 		}
 		delay = data[2];
 	}
-	// tell the app
+	// the menus are gone, and so is any memory they needed
 	pthread_mutex_lock(&mmi->lock);
+	struct en50221_app_mmi_session *cur_s =
+		en50221_app_mmi_find_session(mmi, session_number, 0);
+	if (cur_s)
+		en50221_app_mmi_release_arenas(cur_s);
+
+	// tell the app
 	en50221_app_mmi_close_callback cb = mmi->closecallback;
 	void *cb_arg = mmi->closecallback_arg;
 	pthread_mutex_unlock(&mmi->lock);
@@ -846,10 +854,9 @@ static int en50221_app_mmi_parse_list_menu(struct en50221_app_mmi *mmi,
 					   uint32_t data_length)
 {
 	int result = 0;
-	uint8_t *text_flags = NULL;
 	struct en50221_app_mmi_text *text_data = NULL;
 	uint32_t i;
-	uint8_t text_count = 0;
+	uint16_t text_count = 0;
 
 	// first of all, decode the length field
 	uint16_t asn_data_length;
@@ -886,8 +893,7 @@ static int en50221_app_mmi_parse_list_menu(struct en50221_app_mmi *mmi,
 	if (data_length < 1) {
 		print(LOG_LEVEL, ERROR, 1, "Received short data\n");
 		pthread_mutex_unlock(&mmi->lock);
-		result = -1;
-		goto exit_cleanup;
+		return -1;
 	}
 	// now, parse the data
 	uint8_t choice_nb = data[0];
@@ -897,55 +903,51 @@ static int en50221_app_mmi_parse_list_menu(struct en50221_app_mmi *mmi,
 	data++;
 	data_length--;
 
-	// variables for extracted text state
-	text_flags = alloca(text_count);
-	if (text_flags == NULL) {
-		pthread_mutex_unlock(&mmi->lock);
-		result = -1;
-		goto exit_cleanup;
-	}
-	memset(text_flags, 0, text_count);
+	// the text items are slices of the object
 	text_data = (struct en50221_app_mmi_text *)
 	    alloca(sizeof(struct en50221_app_mmi_text) * text_count);
-	if (text_data == NULL) {
-		pthread_mutex_unlock(&mmi->lock);
-		result = -1;
-		goto exit_cleanup;
-	}
-	memset(text_data, 0,
-	       sizeof(struct en50221_app_mmi_text) * text_count);
 
 	// extract the text!
 	for (i = 0; i < text_count; i++) {
+		// a text item in fragments is joined up where it lies, so if
+		// the object is still in the caller's buffer, the rest of it
+		// has to be moved to the arena first
+		if ((dfstatus == 1) && (data_length >= 3) &&
+		    (((data[0] << 16) | (data[1] << 8) | data[2]) == TAG_TEXT_MORE)) {
+			struct en50221_app_mmi_session *cur_s =
+				en50221_app_mmi_find_session(mmi, session_number, 1);
+			struct en50221_app_mmi_arena *arena;
+			if ((cur_s == NULL) ||
+			    ((arena = en50221_app_mmi_session_arena(cur_s, tag_id)) == NULL)) {
+				pthread_mutex_unlock(&mmi->lock);
+				return -1;
+			}
+			arena->length = 0;
+			if (en50221_app_mmi_arena_append(arena, data, data_length)) {
+				pthread_mutex_unlock(&mmi->lock);
+				return -1;
+			}
+			data = arena->data;
+			dfstatus = 2;
+		}
+
 		uint32_t consumed = 0;
-		int cur_status =
-		    en50221_app_mmi_defragment_text(data, data_length,
+		if (en50221_app_mmi_defragment_text(data, data_length,
 						    &text_data[i].text,
 						    &text_data[i].text_length,
-						    &consumed);
-		if (cur_status < 0) {
+						    &consumed) < 0) {
 			pthread_mutex_unlock(&mmi->lock);
-			result = -1;
-			goto exit_cleanup;
+			return -1;
 		}
 
-		text_flags[i] = cur_status;
 		data += consumed;
 		data_length -= consumed;
 	}
 
 	// work out what to pass to the user
-	struct en50221_app_mmi_text *text_data_for_user = (struct en50221_app_mmi_text *)
-	    alloca(sizeof(struct en50221_app_mmi_text) * text_count);
-	if (text_data_for_user == NULL) {
-		result = -1;
-		goto exit_cleanup;
-	}
-	memcpy(text_data_for_user, text_data,
-	       sizeof(struct en50221_app_mmi_text) * text_count);
 	struct en50221_app_mmi_text *text_ptr = NULL;
 	if (text_count > 3) {
-		text_ptr = &text_data_for_user[3];
+		text_ptr = &text_data[3];
 	}
 	uint8_t *items_raw = NULL;
 	uint32_t items_raw_length = 0;
@@ -964,9 +966,9 @@ static int en50221_app_mmi_parse_list_menu(struct en50221_app_mmi *mmi,
 		if (cb) {
 			result =
 				cb(cb_arg, slot_id, session_number,
-				&text_data_for_user[0],
-				&text_data_for_user[1],
-				&text_data_for_user[2],
+				&text_data[0],
+				&text_data[1],
+				&text_data[2],
 				text_count - 3, text_ptr,
 				items_raw_length, items_raw);
 		}
@@ -981,9 +983,9 @@ static int en50221_app_mmi_parse_list_menu(struct en50221_app_mmi *mmi,
 		if (cb) {
 			result =
 				cb(cb_arg, slot_id, session_number,
-				&text_data_for_user[0],
-				&text_data_for_user[1],
-				&text_data_for_user[2],
+				&text_data[0],
+				&text_data[1],
+				&text_data[2],
 				text_count - 3, text_ptr,
 				items_raw_length, items_raw);
 		}
@@ -995,16 +997,6 @@ static int en50221_app_mmi_parse_list_menu(struct en50221_app_mmi *mmi,
 		break;
 	}
 
-exit_cleanup:
-	if ((dfstatus == 2) && outdata)
-		free(outdata);
-	if (text_flags && text_data) {
-		for (i = 0; i < text_count; i++) {
-			if ((text_flags[i] == 2) && text_data[i].text) {
-				free(text_data[i].text);
-			}
-		}
-	}
 	return result;
 }
 
@@ -1073,10 +1065,6 @@ static int en50221_app_mmi_parse_subtitle(struct en50221_app_mmi *mmi,
 		}
 	}
 
-	// free the data returned by the defragment call if asked to
-	if (dfstatus == 2) {
-		free(outdata);
-	}
 	// done
 	return cbstatus;
 }
@@ -1178,128 +1166,53 @@ static int en50221_app_mmi_defragment(struct en50221_app_mmi *mmi,
 				      uint8_t ** outdata,
 				      uint32_t * outdata_length)
 {
-	struct en50221_app_mmi_session *cur_s = mmi->sessions;
-	while (cur_s) {
-		if (cur_s->session_number == session_number)
-			break;
-		cur_s = cur_s->next;
+	struct en50221_app_mmi_session *cur_s =
+		en50221_app_mmi_find_session(mmi, session_number, !more_last);
+	struct en50221_app_mmi_arena *arena = NULL;
+
+	// find the arena to use
+	if (cur_s != NULL) {
+		arena = en50221_app_mmi_session_arena(cur_s, tag_id);
+		if (arena == NULL)
+			return -1;
+	} else if (!more_last) {
+		return -1;
 	}
 
 	// more data is still to come
 	if (!more_last) {
-		// if there was no previous session, create one
-		if (cur_s == NULL) {
-			cur_s = malloc(sizeof(struct en50221_app_mmi_session));
-			if (cur_s == NULL) {
-				print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
-				return -1;
-			}
-			cur_s->session_number = session_number;
-			cur_s->menu_block_chain = NULL;
-			cur_s->menu_block_length = 0;
-			cur_s->list_block_chain = NULL;
-			cur_s->list_block_length = 0;
-			cur_s->subtitlesegment_block_chain = NULL;
-			cur_s->subtitlesegment_block_length = 0;
-			cur_s->subtitledownload_block_chain = NULL;
-			cur_s->subtitledownload_block_length = 0;
-			cur_s->next = mmi->sessions;
-			mmi->sessions = cur_s;
-		}
-		// find the block/block_length to use
-		uint8_t **block_chain;
-		uint32_t *block_length;
-		switch (tag_id) {
-		case TAG_MENU_LAST:
-		case TAG_MENU_MORE:
-			block_chain = &cur_s->menu_block_chain;
-			block_length = &cur_s->menu_block_length;
-			break;
-		case TAG_LIST_LAST:
-		case TAG_LIST_MORE:
-			block_chain = &cur_s->list_block_chain;
-			block_length = &cur_s->list_block_length;
-			break;
-		case TAG_SUBTITLE_SEGMENT_LAST:
-		case TAG_SUBTITLE_SEGMENT_MORE:
-			block_chain = &cur_s->subtitlesegment_block_chain;
-			block_length = &cur_s->subtitlesegment_block_length;
-			break;
-		case TAG_SUBTITLE_DOWNLOAD_LAST:
-		case TAG_SUBTITLE_DOWNLOAD_MORE:
-			block_chain = &cur_s->subtitledownload_block_chain;
-			block_length = &cur_s->subtitledownload_block_length;
-			break;
-		default:
+		if (en50221_app_mmi_arena_append(arena, indata, indata_length))
 			return -1;
-		}
-
-		// append the data
-		uint8_t *new_data =
-		    realloc(*block_chain, *block_length + indata_length);
-		if (new_data == NULL) {
-			print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
-			return -1;
-		}
-		memcpy(new_data + *block_length, indata, indata_length);
-		*block_chain = new_data;
-		*block_length += indata_length;
 
 		// success, but block not complete yet
 		return 0;
 	}
-	// we hit the last of a possible chain of fragments
-	if (cur_s != NULL) {
-		// find the block/block_length to use
-		uint8_t **block_chain;
-		uint32_t *block_length;
-		switch (tag_id) {
-		case TAG_MENU_LAST:
-		case TAG_MENU_MORE:
-			block_chain = &cur_s->menu_block_chain;
-			block_length = &cur_s->menu_block_length;
-			break;
-		case TAG_LIST_LAST:
-		case TAG_LIST_MORE:
-			block_chain = &cur_s->list_block_chain;
-			block_length = &cur_s->list_block_length;
-			break;
-		case TAG_SUBTITLE_SEGMENT_LAST:
-		case TAG_SUBTITLE_SEGMENT_MORE:
-			block_chain = &cur_s->subtitlesegment_block_chain;
-			block_length = &cur_s->subtitlesegment_block_length;
-			break;
-		case TAG_SUBTITLE_DOWNLOAD_LAST:
-		case TAG_SUBTITLE_DOWNLOAD_MORE:
-			block_chain = &cur_s->subtitledownload_block_chain;
-			block_length = &cur_s->subtitledownload_block_length;
-			break;
-		default:
+	// we hit the last of a chain of fragments
+	if ((arena != NULL) && arena->length) {
+		if (en50221_app_mmi_arena_append(arena, indata, indata_length))
 			return -1;
-		}
+		*outdata_length = arena->length;
+		*outdata = arena->data;
 
-		// we have a preceding fragment - need to append
-		uint8_t *new_data =
-		    realloc(*block_chain, *block_length + indata_length);
-		if (new_data == NULL) {
-			print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
-			return -1;
-		}
-		memcpy(new_data + *block_length, indata, indata_length);
-		*outdata_length = *block_length + indata_length;
-		*outdata = new_data;
-		*block_chain = NULL;
-		*block_length = 0;
+		// the arena is kept for the next object
+		arena->length = 0;
 
-		// success, and indicate to free the block when done
+		// success, and the data is in the arena
 		return 2;
 	}
-	// success, but indicate it is not to be freed
+	// success, and the data is the caller's
 	*outdata_length = indata_length;
 	*outdata = indata;
 	return 1;
 }
 
+/**
+ * Extract one text item. If it was sent in fragments, they are joined up in
+ * place, over the headers of the fragments after the first; the data must
+ * then be writable.
+ *
+ * @return 0 on success, -1 on failure.
+ */
 static int en50221_app_mmi_defragment_text(uint8_t * data,
 					   uint32_t data_length,
 					   uint8_t ** outdata,
@@ -1314,14 +1227,17 @@ static int en50221_app_mmi_defragment_text(uint8_t * data,
 		// get the tag
 		if (data_length < 3) {
 			print(LOG_LEVEL, ERROR, 1, "Short data\n");
-			if (text)
-				free(text);
 			return -1;
 		}
 		uint32_t tag = (data[0] << 16) | (data[1] << 8) | data[2];
 		data += 3;
 		data_length -= 3;
 		consumed += 3;
+		if ((tag != TAG_TEXT_LAST) && (tag != TAG_TEXT_MORE)) {
+			print(LOG_LEVEL, ERROR, 1,
+			      "Unknown MMI text tag\n");
+			return -1;
+		}
 
 		// get the length of the data and adjust
 		uint16_t asn_data_length;
@@ -1330,68 +1246,117 @@ static int en50221_app_mmi_defragment_text(uint8_t * data,
 		     asn_1_decode(&asn_data_length, data,
 				  data_length)) < 0) {
 			print(LOG_LEVEL, ERROR, 1, "ASN.1 decode error\n");
-			if (text)
-				free(text);
 			return -1;
 		}
 		data += length_field_len;
 		data_length -= length_field_len;
 		consumed += length_field_len;
+		if (asn_data_length > data_length) {
+			print(LOG_LEVEL, ERROR, 1, "Short data\n");
+			return -1;
+		}
+
+		// append the data
+		if (text == NULL)
+			text = data;
+		else
+			memmove(text + text_length, data, asn_data_length);
+		text_length += asn_data_length;
+
+		// consume the data
+		data += asn_data_length;
+		data_length -= asn_data_length;
+		consumed += asn_data_length;
 
-		// deal with the tags
 		if (tag == TAG_TEXT_LAST) {
-			if (text == NULL) {
-				*outdata = data;
-				*outdata_length = asn_data_length;
-				*outconsumed = consumed + asn_data_length;
-				return 1;
-			} else {
-				// append the data
-				uint8_t *new_text = realloc(text,
-							    text_length + asn_data_length);
-				if (new_text == NULL) {
-					print(LOG_LEVEL, ERROR, 1,
-					      "Ran out of memory\n");
-					if (text)
-						free(text);
-					return -1;
-				}
-				memcpy(new_text + text_length, data,
-				       asn_data_length);
-				*outdata = new_text;
-				*outdata_length =
-				    text_length + asn_data_length;
-				*outconsumed = consumed + asn_data_length;
-				return 2;
-			}
+			*outdata = text;
+			*outdata_length = text_length;
+			*outconsumed = consumed;
+			return 0;
+		}
+	}
+}
 
-		} else if (tag == TAG_TEXT_MORE) {
-			// append the data
-			uint8_t *new_text =
-			    realloc(text, text_length + asn_data_length);
-			if (new_text == NULL) {
-				print(LOG_LEVEL, ERROR, 1,
-				      "Ran out of memory\n");
-				if (text)
-					free(text);
-				return -1;
-			}
-			memcpy(new_text + text_length, data,
-			       asn_data_length);
-			text = new_text;
-			text_length += asn_data_length;
-
-			// consume the data
-			data += asn_data_length;
-			data_length -= asn_data_length;
-			consumed += asn_data_length;
-		} else {
-			// unknown tag
-			print(LOG_LEVEL, ERROR, 1,
-			      "Unknown MMI text tag\n");
-			if (text)
-				free(text);
+static struct en50221_app_mmi_session *en50221_app_mmi_find_session(struct en50221_app_mmi *mmi,
+								    uint16_t session_number,
+								    int create)
+{
+	struct en50221_app_mmi_session *cur_s = mmi->sessions;
+	while (cur_s) {
+		if (cur_s->session_number == session_number)
+			return cur_s;
+		cur_s = cur_s->next;
+	}
+	if (!create)
+		return NULL;
+
+	// if there was no previous session, create one
+	cur_s = calloc(1, sizeof(struct en50221_app_mmi_session));
+	if (cur_s == NULL) {
+		print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
+		return NULL;
+	}
+	cur_s->session_number = session_number;
+	cur_s->next = mmi->sessions;
+	mmi->sessions = cur_s;
+	return cur_s;
+}
+
+static struct en50221_app_mmi_arena *en50221_app_mmi_session_arena(struct en50221_app_mmi_session *session,
+								   uint32_t tag_id)
+{
+	switch (tag_id) {
+	case TAG_MENU_LAST:
+	case TAG_MENU_MORE:
+		return &session->menu;
+	case TAG_LIST_LAST:
+	case TAG_LIST_MORE:
+		return &session->list;
+	case TAG_SUBTITLE_SEGMENT_LAST:
+	case TAG_SUBTITLE_SEGMENT_MORE:
+		return &session->subtitlesegment;
+	case TAG_SUBTITLE_DOWNLOAD_LAST:
+	case TAG_SUBTITLE_DOWNLOAD_MORE:
+		return &session->subtitledownload;
+	}
+	return NULL;
+}
+
+static int en50221_app_mmi_arena_append(struct en50221_app_mmi_arena *arena,
+					uint8_t * data,
+					uint32_t data_length)
+{
+	// double it, so an object in many fragments is not copied for each
+	if (arena->length + data_length > arena->size) {
+		uint32_t new_size = arena->size ? arena->size : MMI_ARENA_MIN_SIZE;
+		while (new_size < arena->length + data_length)
+			new_size *= 2;
+		uint8_t *new_data = realloc(arena->data, new_size);
+		if (new_data == NULL) {
+			print(LOG_LEVEL, ERROR, 1, "Ran out of memory\n");
 			return -1;
 		}
+		arena->data = new_data;
+		arena->size = new_size;
+	}
+
+	memcpy(arena->data + arena->length, data, data_length);
+	arena->length += data_length;
+	return 0;
+}
+
+static void en50221_app_mmi_release_arenas(struct en50221_app_mmi_session *session)
+{
+	struct en50221_app_mmi_arena *arenas[] = {
+		&session->menu, &session->list,
+		&session->subtitlesegment, &session->subtitledownload
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(arenas) / sizeof(arenas[0]); i++) {
+		free(arenas[i]->data);
+		arenas[i]->data = NULL;
+		arenas[i]->length = 0;
+		arenas[i]->size = 0;
 	}
 }
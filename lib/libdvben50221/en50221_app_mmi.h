@@ -297,6 +297,9 @@ typedef int (*en50221_app_mmi_enq_callback) (void *arg,
  * @param item_raw_length Length of item raw data.
  * @param items_raw If nonstandard items were supplied, pointer to their data.
  * @return 0 on success, -1 on failure.
+ *
+ * The texts point into the received object, and are only valid during the
+ * callback.
  */
 typedef int (*en50221_app_mmi_menu_callback) (void *arg,
 					      uint8_t slot_id,
@@ -323,6 +326,9 @@ typedef int (*en50221_app_mmi_menu_callback) (void *arg,
  * @param item_raw_length Length of item raw data.
  * @param items_raw If nonstandard items were supplied, pointer to their data.
  * @return 0 on success, -1 on failure.
+ *
+ * The texts point into the received object, and are only valid during the
+ * callback.
  */
 typedef int (*en50221_app_mmi_list_callback) (void *arg,
 					      uint8_t slot_id,
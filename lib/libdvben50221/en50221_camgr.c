@@ -0,0 +1,418 @@
+/*
+	en50221 encoder An implementation for libdvb
+	an implementation for the en50221 transport layer
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libucsi/mpeg/descriptor.h>
+#include "en50221_camgr.h"
+
+// largest formatted ca_pmt of a program
+#define CAMGR_MAX_CA_PMT_LENGTH 4096
+
+struct camgr_slot {
+	int up;
+	struct en50221_app_ca *ca;
+	uint16_t session_number;
+	uint16_t *ca_ids;
+	uint32_t ca_id_count;
+	uint32_t max_programs;
+	int incremental;
+
+	int sent;		// the CAM has had a complete list since it came up
+	int changed;		// the list has changes the CAM hasn't been sent
+	uint32_t count;		// programs on the slot
+	struct en50221_app_ca_pmt_list *list;
+};
+
+struct camgr_program {
+	uint16_t program_number;
+	int slot;		// -1 while waiting for one
+	uint8_t *pmt;		// copy of the parsed PMT section
+};
+
+struct en50221_camgr {
+	uint32_t max_slots;
+	uint32_t max_programs;
+	int move_ca_descriptors;
+	struct camgr_slot *slots;
+
+	struct camgr_program *programs;
+	uint32_t count;
+
+	pthread_mutex_t lock;
+};
+
+static void en50221_camgr_release_slot(struct en50221_camgr *mgr, uint32_t slot);
+static int en50221_camgr_assign(struct en50221_camgr *mgr, struct camgr_program *program);
+static int en50221_camgr_matches(struct camgr_slot *slot, struct mpeg_pmt_section *pmt);
+static struct camgr_program *en50221_camgr_find(struct en50221_camgr *mgr, uint16_t program_number);
+
+
+
+struct en50221_camgr *en50221_camgr_create(uint32_t max_slots,
+					   uint32_t max_programs,
+					   int move_ca_descriptors)
+{
+	struct en50221_camgr *mgr = NULL;
+
+	// create structure and set it up
+	mgr = malloc(sizeof(struct en50221_camgr));
+	if (mgr == NULL)
+		return NULL;
+	mgr->max_slots = max_slots;
+	mgr->max_programs = max_programs;
+	mgr->move_ca_descriptors = move_ca_descriptors;
+	mgr->count = 0;
+	mgr->slots = calloc(max_slots, sizeof(struct camgr_slot));
+	mgr->programs = malloc(sizeof(struct camgr_program) * max_programs);
+	if ((mgr->slots == NULL) || (mgr->programs == NULL)) {
+		free(mgr->slots);
+		free(mgr->programs);
+		free(mgr);
+		return NULL;
+	}
+
+	pthread_mutex_init(&mgr->lock, NULL);
+
+	// done
+	return mgr;
+}
+
+void en50221_camgr_destroy(struct en50221_camgr *mgr)
+{
+	uint32_t i;
+
+	for (i = 0; i < mgr->max_slots; i++)
+		en50221_camgr_release_slot(mgr, i);
+	for (i = 0; i < mgr->count; i++)
+		free(mgr->programs[i].pmt);
+
+	pthread_mutex_destroy(&mgr->lock);
+	free(mgr->slots);
+	free(mgr->programs);
+	free(mgr);
+}
+
+int en50221_camgr_slot_up(struct en50221_camgr *mgr,
+			  uint32_t slot,
+			  struct en50221_app_ca *ca,
+			  uint16_t session_number,
+			  uint32_t ca_id_count,
+			  uint16_t *ca_ids,
+			  uint32_t max_programs,
+			  int incremental)
+{
+	struct camgr_slot *s;
+
+	if (slot >= mgr->max_slots)
+		return -1;
+	s = &mgr->slots[slot];
+
+	pthread_mutex_lock(&mgr->lock);
+
+	// a CAM which has been reset forgets what it was descrambling
+	en50221_camgr_release_slot(mgr, slot);
+
+	if ((max_programs == 0) || (max_programs > mgr->max_programs))
+		max_programs = mgr->max_programs;
+	s->list = en50221_app_ca_pmt_list_create(max_programs, CAMGR_MAX_CA_PMT_LENGTH);
+	s->ca_ids = malloc(sizeof(uint16_t) * (ca_id_count ? ca_id_count : 1));
+	if ((s->list == NULL) || (s->ca_ids == NULL)) {
+		en50221_camgr_release_slot(mgr, slot);
+		pthread_mutex_unlock(&mgr->lock);
+		return -1;
+	}
+	memcpy(s->ca_ids, ca_ids, sizeof(uint16_t) * ca_id_count);
+	s->ca_id_count = ca_id_count;
+	s->ca = ca;
+	s->session_number = session_number;
+	s->max_programs = max_programs;
+	s->incremental = incremental;
+	s->up = 1;
+
+	pthread_mutex_unlock(&mgr->lock);
+	return 0;
+}
+
+void en50221_camgr_slot_down(struct en50221_camgr *mgr,
+			     uint32_t slot)
+{
+	if (slot >= mgr->max_slots)
+		return;
+
+	pthread_mutex_lock(&mgr->lock);
+	en50221_camgr_release_slot(mgr, slot);
+	pthread_mutex_unlock(&mgr->lock);
+}
+
+void en50221_camgr_resend(struct en50221_camgr *mgr,
+			  uint32_t slot)
+{
+	struct camgr_slot *s;
+
+	if (slot >= mgr->max_slots)
+		return;
+	s = &mgr->slots[slot];
+
+	pthread_mutex_lock(&mgr->lock);
+	if (s->up && s->count) {
+		s->sent = 0;
+		s->changed = 1;
+	}
+	pthread_mutex_unlock(&mgr->lock);
+}
+
+int en50221_camgr_set_pmt(struct en50221_camgr *mgr,
+			  struct mpeg_pmt_section *pmt)
+{
+	uint16_t program_number = mpeg_pmt_section_program_number(pmt);
+	size_t length = section_length((struct section *) &pmt->head);
+	struct camgr_program *program;
+	struct camgr_slot *s;
+	uint8_t *copy;
+
+	// keep a copy, to give it to another slot later if need be
+	if ((copy = malloc(length)) == NULL)
+		return -1;
+	memcpy(copy, pmt, length);
+
+	pthread_mutex_lock(&mgr->lock);
+
+	program = en50221_camgr_find(mgr, program_number);
+	if (program == NULL) {
+		if (mgr->count == mgr->max_programs) {
+			pthread_mutex_unlock(&mgr->lock);
+			free(copy);
+			return -1;
+		}
+		program = &mgr->programs[mgr->count++];
+		program->program_number = program_number;
+		program->slot = -1;
+		program->pmt = NULL;
+	}
+	free(program->pmt);
+	program->pmt = copy;
+
+	// a program already on a slot stays there
+	if (program->slot != -1) {
+		s = &mgr->slots[program->slot];
+		switch (en50221_app_ca_pmt_list_set(s->list, (struct mpeg_pmt_section *) copy,
+						    mgr->move_ca_descriptors,
+						    CA_PMT_CMD_ID_OK_DESCRAMBLING)) {
+		case 1:
+			s->changed = 1;
+			break;
+		case -1:
+			pthread_mutex_unlock(&mgr->lock);
+			return -1;
+		}
+	}
+
+	pthread_mutex_unlock(&mgr->lock);
+	return 0;
+}
+
+int en50221_camgr_remove(struct en50221_camgr *mgr,
+			 uint16_t program_number)
+{
+	struct camgr_program *program;
+	struct camgr_slot *s;
+
+	pthread_mutex_lock(&mgr->lock);
+
+	if ((program = en50221_camgr_find(mgr, program_number)) == NULL) {
+		pthread_mutex_unlock(&mgr->lock);
+		return -1;
+	}
+
+	if (program->slot != -1) {
+		s = &mgr->slots[program->slot];
+		en50221_app_ca_pmt_list_remove(s->list, program_number);
+		s->count--;
+		s->changed = 1;
+	}
+
+	free(program->pmt);
+	*program = mgr->programs[--mgr->count];
+
+	pthread_mutex_unlock(&mgr->lock);
+	return 0;
+}
+
+int en50221_camgr_flush(struct en50221_camgr *mgr)
+{
+	struct camgr_slot *s;
+	uint32_t i;
+	int sent = 0;
+	int result;
+	int failed = 0;
+
+	pthread_mutex_lock(&mgr->lock);
+
+	for (i = 0; i < mgr->count; i++) {
+		if (mgr->programs[i].slot == -1)
+			en50221_camgr_assign(mgr, &mgr->programs[i]);
+	}
+
+	for (i = 0; i < mgr->max_slots; i++) {
+		s = &mgr->slots[i];
+		if (!s->up || !s->changed)
+			continue;
+
+		// an empty list can only be sent as the removals themselves
+		if ((!s->sent || !s->incremental) && s->count) {
+			result = en50221_app_ca_pmt_list_send(s->ca, s->session_number, s->list);
+			if (result == 0)
+				result = s->count;
+		} else {
+			result = en50221_app_ca_pmt_list_send_changes(s->ca, s->session_number, s->list);
+		}
+
+		if (result < 0) {
+			failed = 1;
+			continue;
+		}
+		sent += result;
+		s->sent = 1;
+		s->changed = 0;
+	}
+
+	pthread_mutex_unlock(&mgr->lock);
+	return failed ? -1 : sent;
+}
+
+int en50221_camgr_get_slot(struct en50221_camgr *mgr,
+			   uint16_t program_number)
+{
+	struct camgr_program *program;
+	int slot = -1;
+
+	pthread_mutex_lock(&mgr->lock);
+	if ((program = en50221_camgr_find(mgr, program_number)) != NULL)
+		slot = program->slot;
+	pthread_mutex_unlock(&mgr->lock);
+
+	return slot;
+}
+
+static void en50221_camgr_release_slot(struct en50221_camgr *mgr, uint32_t slot)
+{
+	struct camgr_slot *s = &mgr->slots[slot];
+	uint32_t i;
+
+	for (i = 0; i < mgr->count; i++) {
+		if (mgr->programs[i].slot == (int) slot)
+			mgr->programs[i].slot = -1;
+	}
+
+	if (s->list)
+		en50221_app_ca_pmt_list_destroy(s->list);
+	free(s->ca_ids);
+	memset(s, 0, sizeof(struct camgr_slot));
+}
+
+static int en50221_camgr_assign(struct en50221_camgr *mgr, struct camgr_program *program)
+{
+	struct mpeg_pmt_section *pmt = (struct mpeg_pmt_section *) program->pmt;
+	struct camgr_slot *best = NULL;
+	struct camgr_slot *fallback = NULL;
+	uint32_t i;
+
+	// the least loaded slot with room whose CAM can descramble it, or else
+	// the least loaded one with room, as CAMs don't always list every system
+	for (i = 0; i < mgr->max_slots; i++) {
+		struct camgr_slot *s = &mgr->slots[i];
+
+		if (!s->up || (s->count >= s->max_programs))
+			continue;
+		if ((fallback == NULL) || (s->count < fallback->count))
+			fallback = s;
+		if (best && (best->count <= s->count))
+			continue;
+		if (en50221_camgr_matches(s, pmt))
+			best = s;
+	}
+	if (best == NULL)
+		best = fallback;
+	if (best == NULL)
+		return -1;
+
+	if (en50221_app_ca_pmt_list_set(best->list, pmt, mgr->move_ca_descriptors,
+					CA_PMT_CMD_ID_OK_DESCRAMBLING) < 0)
+		return -1;
+	program->slot = best - mgr->slots;
+	best->count++;
+	best->changed = 1;
+
+	return 0;
+}
+
+static int en50221_camgr_matches(struct camgr_slot *slot, struct mpeg_pmt_section *pmt)
+{
+	struct descriptor *cur_descriptor;
+	struct mpeg_pmt_stream *cur_stream;
+	int has_ca = 0;
+	uint16_t ca_system_id;
+	uint32_t i;
+
+	if (slot->ca_id_count == 0)
+		return 1;
+
+	// the descriptors are still in wire order: they were never decoded
+	mpeg_pmt_section_descriptors_for_each(pmt, cur_descriptor) {
+		if ((cur_descriptor->tag != dtag_mpeg_ca) || (cur_descriptor->len < 2))
+			continue;
+		has_ca = 1;
+		ca_system_id = (((uint8_t *) cur_descriptor)[2] << 8) | ((uint8_t *) cur_descriptor)[3];
+		for (i = 0; i < slot->ca_id_count; i++) {
+			if (slot->ca_ids[i] == ca_system_id)
+				return 1;
+		}
+	}
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		mpeg_pmt_stream_descriptors_for_each(cur_stream, cur_descriptor) {
+			if ((cur_descriptor->tag != dtag_mpeg_ca) || (cur_descriptor->len < 2))
+				continue;
+			has_ca = 1;
+			ca_system_id = (((uint8_t *) cur_descriptor)[2] << 8) | ((uint8_t *) cur_descriptor)[3];
+			for (i = 0; i < slot->ca_id_count; i++) {
+				if (slot->ca_ids[i] == ca_system_id)
+					return 1;
+			}
+		}
+	}
+
+	// a program in the clear can go anywhere
+	return !has_ca;
+}
+
+static struct camgr_program *en50221_camgr_find(struct en50221_camgr *mgr, uint16_t program_number)
+{
+	uint32_t i;
+
+	for (i = 0; i < mgr->count; i++) {
+		if (mgr->programs[i].program_number == program_number)
+			return &mgr->programs[i];
+	}
+
+	return NULL;
+}
@@ -0,0 +1,163 @@
+/*
+	en50221 encoder An implementation for libdvb
+	an implementation for the en50221 transport layer
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as
+	published by the Free Software Foundation; either version 2.1 of
+	the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*/
+
+#ifndef EN50221_CAMGR_H
+#define EN50221_CAMGR_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <libdvben50221/en50221_app_ca.h>
+#include <libucsi/mpeg/pmt_section.h>
+
+/**
+ * A CAM resource manager: it shares the programs to descramble between the
+ * CA resources of several slots, and lets each CAM descramble as many at
+ * once as it can.
+ *
+ * Each program goes to the slot with the fewest programs, of those with room
+ * whose CAM reported (in its ca_info) one of the ca_system_ids of the
+ * program's CA descriptors; a program with none matches any CAM. If no CAM
+ * matches, it goes to the slot with the fewest programs anyway, as CAMs
+ * don't always report every system they handle. A program stays on its slot
+ * until it is removed or the slot goes down; programs no slot has room for
+ * wait until one has.
+ *
+ * Programs and PMT changes are only queued, and en50221_camgr_flush() sends
+ * them: to each slot, the first time, a complete ca_pmt_list, and after that
+ * just the ADDs and UPDATEs for what changed. A program whose PMT version
+ * has not changed is never sent again.
+ *
+ * All functions may be called from any thread.
+ */
+struct en50221_camgr;
+
+/**
+ * Create a manager.
+ *
+ * @param max_slots Number of slots, numbered from 0.
+ * @param max_programs Most programs the manager holds, and the default limit
+ * of each slot.
+ * @param move_ca_descriptors As for en50221_ca_format_pmt().
+ * @return The manager, or NULL on failure.
+ */
+extern struct en50221_camgr *en50221_camgr_create(uint32_t max_slots,
+						  uint32_t max_programs,
+						  int move_ca_descriptors);
+
+/**
+ * Destroy a manager. Nothing is sent to the CAMs.
+ *
+ * @param mgr The manager.
+ */
+extern void en50221_camgr_destroy(struct en50221_camgr *mgr);
+
+/**
+ * A slot's CA resource is connected: call this from its ca_info callback.
+ *
+ * @param mgr The manager.
+ * @param slot Slot number.
+ * @param ca The slot's CA resource.
+ * @param session_number The CA resource's session number.
+ * @param ca_id_count Number of ca_system_ids the CAM reported.
+ * @param ca_ids The ca_system_ids.
+ * @param max_programs Most programs the CAM can descramble at once, or 0 for
+ * the manager's limit.
+ * @param incremental Nonzero if the CAM accepts CA_LIST_MANAGEMENT_ADD and
+ * UPDATE; otherwise every change resends the slot's whole list.
+ * @return 0 on success, -1 on failure.
+ */
+extern int en50221_camgr_slot_up(struct en50221_camgr *mgr,
+				 uint32_t slot,
+				 struct en50221_app_ca *ca,
+				 uint16_t session_number,
+				 uint32_t ca_id_count,
+				 uint16_t *ca_ids,
+				 uint32_t max_programs,
+				 int incremental);
+
+/**
+ * A slot's CA resource is gone (the CAM was removed or reset). Its programs
+ * are given to other slots on the next flush.
+ *
+ * @param mgr The manager.
+ * @param slot Slot number.
+ */
+extern void en50221_camgr_slot_down(struct en50221_camgr *mgr,
+				    uint32_t slot);
+
+/**
+ * Have the next flush send a slot its complete ca_pmt_list again, as if it
+ * had just come up: for a CAM which seems to have lost track of it.
+ *
+ * @param mgr The manager.
+ * @param slot Slot number.
+ */
+extern void en50221_camgr_resend(struct en50221_camgr *mgr,
+				 uint32_t slot);
+
+/**
+ * Add a program, or update it with a new version of its PMT.
+ *
+ * @param mgr The manager.
+ * @param pmt The program's PMT.
+ * @return 0 on success, -1 on failure.
+ */
+extern int en50221_camgr_set_pmt(struct en50221_camgr *mgr,
+				 struct mpeg_pmt_section *pmt);
+
+/**
+ * Remove a program.
+ *
+ * @param mgr The manager.
+ * @param program_number Program to remove.
+ * @return 0 on success, -1 if the program is unknown.
+ */
+extern int en50221_camgr_remove(struct en50221_camgr *mgr,
+				uint16_t program_number);
+
+/**
+ * Give waiting programs to slots, and send every slot what changed.
+ *
+ * @param mgr The manager.
+ * @return Number of ca_pmts sent, or -1 if sending to a slot failed (the
+ * other slots are still sent theirs).
+ */
+extern int en50221_camgr_flush(struct en50221_camgr *mgr);
+
+/**
+ * Find which slot a program is on.
+ *
+ * @param mgr The manager.
+ * @param program_number The program.
+ * @return The slot number, or -1 if the program is unknown or waiting for a
+ * slot.
+ */
+extern int en50221_camgr_get_slot(struct en50221_camgr *mgr,
+				  uint16_t program_number);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -56,6 +56,8 @@
 #define S_STATE_IN_CREATION     0x04	// this session waits for a ST_CREATE_SESSION_RES to become active
 #define S_STATE_IN_DELETION     0x08	// this session waits for ST_CLOSE_SESSION_RES to become idle again
 
+#define LOOKUP_CACHE_SIZE 64		// must be a power of 2
+
 
 // for each session we store its identifier, the resource-id
 // it is linked to and the callback of the specific resource
@@ -71,12 +73,22 @@ struct en50221_session {
 	pthread_mutex_t session_lock;
 };
 
+// a failed resource lookup: the answer only changes with the set of
+// resources, while successful lookups may depend on the open sessions
+struct en50221_lookup_cache_entry {
+	uint32_t resource_id;
+	uint8_t slot_id;
+	uint8_t valid;
+	int status;
+};
+
 struct en50221_session_layer {
 	uint32_t max_sessions;
 	struct en50221_transport_layer *tl;
 
 	en50221_sl_lookup_callback lookup;
 	void *lookup_arg;
+	struct en50221_lookup_cache_entry lookup_cache[LOOKUP_CACHE_SIZE];
 
 	en50221_sl_session_callback session;
 	void *session_arg;
@@ -87,6 +99,11 @@ struct en50221_session_layer {
 	int error;
 
 	struct en50221_session *sessions;
+
+	// idle session numbers, oldest first; protected by global_lock
+	uint16_t *free_sessions;
+	uint32_t free_head;
+	uint32_t free_count;
 };
 
 static void en50221_sl_transport_callback(void *arg, int reason,
@@ -100,6 +117,8 @@ static int en50221_sl_alloc_new_session(struct en50221_session_layer *sl,
 					uint8_t connection_id,
 					en50221_sl_resource_callback
 					callback, void *arg);
+static void en50221_sl_set_idle(struct en50221_session_layer *sl,
+				uint16_t session_number);
 
 
 
@@ -120,6 +139,11 @@ struct en50221_session_layer *en50221_sl_create(struct en50221_transport_layer *
 	sl->session = NULL;
 	sl->tl = tl;
 	sl->error = 0;
+	sl->sessions = NULL;
+	sl->free_sessions = NULL;
+	sl->free_head = 0;
+	sl->free_count = 0;
+	memset(sl->lookup_cache, 0, sizeof(sl->lookup_cache));
 
 	// init the mutex
 	pthread_mutex_init(&sl->global_lock, NULL);
@@ -130,12 +154,19 @@ struct en50221_session_layer *en50221_sl_create(struct en50221_transport_layer *
 	if (sl->sessions == NULL)
 		goto error_exit;
 
-	// set them up
+	sl->free_sessions = malloc(sizeof(uint16_t) * max_sessions);
+	if (sl->free_sessions == NULL)
+		goto error_exit;
+
+	// set them up; session number 0 is never handed out
 	for (i = 0; i < max_sessions; i++) {
 		sl->sessions[i].state = S_STATE_IDLE;
 		sl->sessions[i].callback = NULL;
 
 		pthread_mutex_init(&sl->sessions[i].session_lock, NULL);
+
+		if (i)
+			sl->free_sessions[sl->free_count++] = i;
 	}
 
 	// register ourselves with the transport layer
@@ -159,6 +190,8 @@ void en50221_sl_destroy(struct en50221_session_layer *sl)
 			}
 			free(sl->sessions);
 		}
+		if (sl->free_sessions)
+			free(sl->free_sessions);
 
 		pthread_mutex_destroy(&sl->setcallback_lock);
 		pthread_mutex_destroy(&sl->global_lock);
@@ -179,6 +212,14 @@ void en50221_sl_register_lookup_callback(struct en50221_session_layer *sl,
 	pthread_mutex_lock(&sl->setcallback_lock);
 	sl->lookup = callback;
 	sl->lookup_arg = arg;
+	memset(sl->lookup_cache, 0, sizeof(sl->lookup_cache));
+	pthread_mutex_unlock(&sl->setcallback_lock);
+}
+
+void en50221_sl_flush_lookup_cache(struct en50221_session_layer *sl)
+{
+	pthread_mutex_lock(&sl->setcallback_lock);
+	memset(sl->lookup_cache, 0, sizeof(sl->lookup_cache));
 	pthread_mutex_unlock(&sl->setcallback_lock);
 }
 
@@ -224,7 +265,7 @@ int en50221_sl_create_session(struct en50221_session_layer *sl,
 	if (en50221_tl_send_data(sl->tl, slot_id, connection_id, hdr, 8)) {
 		pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 		if (sl->sessions[session_number].state == S_STATE_IN_CREATION) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_set_idle(sl, session_number);
 		}
 		pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
@@ -266,7 +307,7 @@ int en50221_sl_destroy_session(struct en50221_session_layer *sl,
 	if (en50221_tl_send_data(sl->tl, slot_id, connection_id, hdr, 4)) {
 		pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 		if (sl->sessions[session_number].state == S_STATE_IN_DELETION) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_set_idle(sl, session_number);
 		}
 		pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
@@ -418,22 +459,45 @@ static void en50221_sl_handle_open_session_request(struct en50221_session_layer
 	uint32_t requested_resource_id =
 	    (data[1] << 24) | (data[2] << 16) | (data[3] << 8) | data[4];
 
-	// get lookup callback details
+	// get lookup callback details, and whether it already said no
+	struct en50221_lookup_cache_entry *cached =
+		&sl->lookup_cache[(requested_resource_id ^ (requested_resource_id >> 16) ^ slot_id) &
+				  (LOOKUP_CACHE_SIZE - 1)];
+	int cached_status = 0;
 	pthread_mutex_lock(&sl->setcallback_lock);
 	en50221_sl_lookup_callback lcb = sl->lookup;
 	void *lcb_arg = sl->lookup_arg;
+	if (cached->valid && (cached->resource_id == requested_resource_id) &&
+	    (cached->slot_id == slot_id))
+		cached_status = cached->status;
 	pthread_mutex_unlock(&sl->setcallback_lock);
 
 	// first of all, lookup this resource id
 	int status = S_STATUS_CLOSE_NO_RES;
 	en50221_sl_resource_callback resource_callback = NULL;
 	void *resource_arg = NULL;
-	uint32_t connected_resource_id;
+	uint32_t connected_resource_id = requested_resource_id;
 	if (lcb) {
-		status =
-		    lcb(lcb_arg, slot_id, requested_resource_id,
-			&resource_callback, &resource_arg,
-			&connected_resource_id);
+		if (cached_status) {
+			status = cached_status;
+		} else {
+			status =
+			    lcb(lcb_arg, slot_id, requested_resource_id,
+				&resource_callback, &resource_arg,
+				&connected_resource_id);
+
+			// a missing resource (or version) stays missing
+			if ((status == -1) || (status == -2)) {
+				pthread_mutex_lock(&sl->setcallback_lock);
+				if (sl->lookup == lcb) {
+					cached->resource_id = requested_resource_id;
+					cached->slot_id = slot_id;
+					cached->status = status;
+					cached->valid = 1;
+				}
+				pthread_mutex_unlock(&sl->setcallback_lock);
+			}
+		}
 		switch (status) {
 		case 0:
 			status = S_STATUS_OPEN;
@@ -506,7 +570,7 @@ static void en50221_sl_handle_open_session_request(struct en50221_session_layer
 		// setup session state apppropriately from upper layer response
 		pthread_mutex_lock(&sl->sessions[session_number].session_lock);
 		if (status != S_STATUS_OPEN) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_set_idle(sl, session_number);
 		} else {
 			sl->sessions[session_number].state = S_STATE_ACTIVE;
 		}
@@ -526,8 +590,7 @@ static void en50221_sl_handle_open_session_request(struct en50221_session_layer
 					   slot_id, session_number,
 					   connected_resource_id);
 			} else {
-				sl->sessions[session_number].state =
-				    S_STATE_IDLE;
+				en50221_sl_set_idle(sl, session_number);
 				if (cb)
 					cb(cb_arg,
 					   S_SCALLBACK_REASON_CAMCONNECTFAIL,
@@ -590,7 +653,7 @@ static void en50221_sl_handle_close_session_request(struct en50221_session_layer
 		}
 
 		if (code == 0x00) {
-			sl->sessions[session_number].state = S_STATE_IDLE;
+			en50221_sl_set_idle(sl, session_number);
 			code = 0x00;	// close ok
 		}
 		resource_id = sl->sessions[session_number].resource_id;
@@ -679,7 +742,7 @@ static void en50221_sl_handle_create_session_response(struct en50221_session_lay
 	if (data[1] != S_STATUS_OPEN) {
 		print(LOG_LEVEL, ERROR, 1,
 		      "Session creation failed 0x%02x\n", data[1]);
-		sl->sessions[session_number].state = S_STATE_IDLE;
+		en50221_sl_set_idle(sl, session_number);
 		pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 
 		// inform upper layers
@@ -764,7 +827,7 @@ static void en50221_sl_handle_close_session_response(struct en50221_session_laye
 		// just fallthrough anyway
 	}
 	// completed
-	sl->sessions[session_number].state = S_STATE_IDLE;
+	en50221_sl_set_idle(sl, session_number);
 	pthread_mutex_unlock(&sl->sessions[session_number].session_lock);
 }
 
@@ -928,7 +991,7 @@ static void en50221_sl_transport_callback(void *arg, int reason,
 				continue;
 			}
 
-			sl->sessions[i].state = S_STATE_IDLE;
+			en50221_sl_set_idle(sl, i);
 
 			uint8_t _slot_id = sl->sessions[i].slot_id;
 			uint32_t resource_id = sl->sessions[i].resource_id;
@@ -958,7 +1021,7 @@ static void en50221_sl_transport_callback(void *arg, int reason,
 				pthread_mutex_unlock(&sl->sessions[i].session_lock);
 				continue;
 			}
-			sl->sessions[i].state = S_STATE_IDLE;
+			en50221_sl_set_idle(sl, i);
 
 			uint32_t resource_id = sl->sessions[i].resource_id;
 			pthread_mutex_unlock(&sl->sessions[i].session_lock);
@@ -1031,10 +1094,14 @@ static int en50221_sl_alloc_new_session(struct en50221_session_layer *sl,
 					callback, void *arg)
 {
 	int session_number = -1;
-	uint32_t i;
-	for (i = 1; i < sl->max_sessions; i++) {
-		if (sl->sessions[i].state == S_STATE_IDLE) {
-			session_number = i;
+
+	// take the session which has been idle the longest
+	while (sl->free_count) {
+		uint16_t candidate = sl->free_sessions[sl->free_head];
+		sl->free_head = (sl->free_head + 1) % sl->max_sessions;
+		sl->free_count--;
+		if (sl->sessions[candidate].state == S_STATE_IDLE) {
+			session_number = candidate;
 			break;
 		}
 	}
@@ -1053,3 +1120,18 @@ static int en50221_sl_alloc_new_session(struct en50221_session_layer *sl,
 	// ok
 	return session_number;
 }
+
+// called with the session lock held
+static void en50221_sl_set_idle(struct en50221_session_layer *sl,
+				uint16_t session_number)
+{
+	if (sl->sessions[session_number].state == S_STATE_IDLE)
+		return;
+	sl->sessions[session_number].state = S_STATE_IDLE;
+
+	// give the session number back
+	pthread_mutex_lock(&sl->global_lock);
+	sl->free_sessions[(sl->free_head + sl->free_count) % sl->max_sessions] = session_number;
+	sl->free_count++;
+	pthread_mutex_unlock(&sl->global_lock);
+}
@@ -142,6 +142,17 @@ extern void en50221_sl_register_lookup_callback(struct en50221_session_layer *sl
 						en50221_sl_lookup_callback callback,
 						void *arg);
 
+/**
+ * Forget which resources the lookup callback has reported as missing.
+ * Failed lookups are cached per slot and resource id, so a CAM probing
+ * for resources we do not have is answered without calling the callback.
+ * Call this if the set of resources the lookup callback knows changes.
+ * Registering a lookup callback flushes the cache as well.
+ *
+ * @param sl The en50221_session_layer instance.
+ */
+extern void en50221_sl_flush_lookup_cache(struct en50221_session_layer *sl);
+
 /**
  * Register the callback for informing about session from a cam.
  *
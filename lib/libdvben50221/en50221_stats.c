@@ -0,0 +1,38 @@
+/*
+ * en50221 encoder An implementation for libdvb
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libdvbmisc/dvbstats.h>
+#include "en50221_stats.h"
+
+static const char * const en50221_stats_names[] = {
+	"tpdus_sent",
+	"tpdus_received",
+	"polls",
+	"timeouts",
+	"bursts",
+	"tpdu_bytes",
+};
+
+DVBSTATS_SET(en50221_stats, "libdvben50221", en50221_stats_names, EN50221_STATS_COUNTERS, EN50221_STATS_HISTOGRAMS);
+
+static void __attribute__((destructor)) en50221_stats_exit(void)
+{
+	dvbstats_dump_at_exit(&en50221_stats);
+}
@@ -0,0 +1,56 @@
+/*
+ * en50221 encoder An implementation for libdvb
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef __EN50221_STATS_H__
+#define __EN50221_STATS_H__ 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct dvbstats_set;
+
+/**
+ * The libdvben50221 performance counters. Dump them with dvbstats_dump() from
+ * libdvbmisc/dvbstats.h, or have them dumped at exit by setting DVB_STATS in
+ * the environment.
+ */
+extern struct dvbstats_set en50221_stats;
+
+enum en50221_stats_counter {
+	EN50221_STATS_TPDUS_SENT,	/* TPDUs written to CAMs, polls included */
+	EN50221_STATS_TPDUS_RECEIVED,	/* TPDUs read from CAMs */
+	EN50221_STATS_POLLS,		/* T_DATA_LAST polls of active connections */
+	EN50221_STATS_TIMEOUTS,		/* responses which did not come in time */
+	EN50221_STATS_BURSTS,		/* answers awaited within a service, for a chain */
+	EN50221_STATS_COUNTERS
+};
+
+enum en50221_stats_histogram {
+	EN50221_STATS_TPDU_BYTES,	/* sizes of the TPDUs read */
+	EN50221_STATS_HISTOGRAMS
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
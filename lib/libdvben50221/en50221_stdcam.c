@@ -24,7 +24,11 @@
 #include <limits.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
 #include <libdvbapi/dvbca.h>
+#include "asn_1.h"
+#include "en50221_app_tags.h"
 #include "en50221_stdcam.h"
 
 struct en50221_stdcam *en50221_stdcam_create(int adapter, int slotnum,
@@ -52,3 +56,93 @@ struct en50221_stdcam *en50221_stdcam_create(int adapter, int slotnum,
 		close(cafd);
 	return result;
 }
+
+void en50221_stdcam_set_camgr(struct en50221_stdcam *stdcam,
+			      struct en50221_camgr *camgr,
+			      uint32_t slot,
+			      uint32_t max_programs,
+			      int incremental)
+{
+	en50221_stdcam_camgr_down(stdcam);
+
+	stdcam->camgr = camgr;
+	stdcam->camgr_slot = slot;
+	stdcam->camgr_max_programs = max_programs;
+	stdcam->camgr_incremental = incremental;
+}
+
+void en50221_stdcam_camgr_down(struct en50221_stdcam *stdcam)
+{
+	if (stdcam->camgr)
+		en50221_camgr_slot_down(stdcam->camgr, stdcam->camgr_slot);
+}
+
+int64_t en50221_stdcam_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000LL) + (ts.tv_nsec / 1000000);
+}
+
+int en50221_stdcam_set_timer(int *timer_fd, int64_t deadline)
+{
+	struct itimerspec its;
+
+	if (*timer_fd == -1) {
+		if ((*timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0) {
+			*timer_fd = -1;
+			return -1;
+		}
+	}
+
+	// a deadline in the past still has to expire: 0 would disarm it
+	memset(&its, 0, sizeof(its));
+	if (deadline >= 0) {
+		if (deadline == 0)
+			deadline = 1;
+		its.it_value.tv_sec = deadline / 1000;
+		its.it_value.tv_nsec = (deadline % 1000) * 1000000;
+	}
+	return timerfd_settime(*timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+int en50221_stdcam_ca_message(struct en50221_stdcam *stdcam,
+			      uint8_t slot_id,
+			      uint16_t session_number,
+			      uint32_t resource_id,
+			      uint8_t *data, uint32_t data_length)
+{
+	uint16_t asn_data_length;
+	int length_field_len;
+	uint16_t *ca_ids;
+	uint32_t ca_id_count;
+	uint32_t i;
+
+	if ((stdcam->camgr == NULL) || (data_length < 4) ||
+	    ((uint32_t) ((data[0] << 16) | (data[1] << 8) | data[2]) != TAG_CA_INFO))
+		goto pass;
+	if (((length_field_len = asn_1_decode(&asn_data_length, data + 3, data_length - 3)) < 0) ||
+	    (asn_data_length > (data_length - 3 - length_field_len)))
+		goto pass;
+
+	// the ids are still big-endian: the CA resource swaps them in place
+	ca_id_count = asn_data_length / 2;
+	if ((ca_ids = malloc(sizeof(uint16_t) * (ca_id_count ? ca_id_count : 1))) == NULL)
+		goto pass;
+	for (i = 0; i < ca_id_count; i++) {
+		uint8_t *id = data + 3 + length_field_len + (i * 2);
+		ca_ids[i] = (id[0] << 8) | id[1];
+	}
+
+	// the CAM is ready for its CA PMTs: they go out before anything else
+	if (en50221_camgr_slot_up(stdcam->camgr, stdcam->camgr_slot, stdcam->ca_resource,
+				  session_number, ca_id_count, ca_ids,
+				  stdcam->camgr_max_programs, stdcam->camgr_incremental) == 0)
+		en50221_camgr_flush(stdcam->camgr);
+	free(ca_ids);
+
+pass:
+	return en50221_app_ca_message(stdcam->ca_resource, slot_id, session_number,
+				      resource_id, data, data_length);
+}
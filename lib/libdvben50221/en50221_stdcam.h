@@ -29,6 +29,7 @@ extern "C" {
 #include <libdvben50221/en50221_app_ai.h>
 #include <libdvben50221/en50221_app_ca.h>
 #include <libdvben50221/en50221_app_mmi.h>
+#include <libdvben50221/en50221_camgr.h>
 #include <libdvben50221/en50221_session.h>
 #include <libdvben50221/en50221_transport.h>
 
@@ -53,11 +54,32 @@ struct en50221_stdcam {
 	/* poll the stdcam instance */
 	enum en50221_stdcam_status (*poll)(struct en50221_stdcam *stdcam);
 
+	/* for waiting on the stdcam in an event loop: returns an fd to wait on
+	 * for input (or -1 if there is none), and sets timeout to the ms after
+	 * which poll must be called anyway (-1 for none). once this has been
+	 * called, poll no longer sleeps itself: call it when the fd becomes
+	 * readable or the timeout expires, then call this again. */
+	int (*get_pollfd)(struct en50221_stdcam *stdcam, int *timeout);
+
+	/* the CLOCK_MONOTONIC time in ms by which poll must be called, as of
+	 * the last get_pollfd (-1 for none). the fd get_pollfd returned also
+	 * becomes readable then, so it may be waited on with no timeout. */
+	int64_t (*next_deadline)(struct en50221_stdcam *stdcam);
+
 	/* inform the stdcam of the current DVB time */
 	void (*dvbtime)(struct en50221_stdcam *stdcam, time_t dvbtime);
 
+	/* reset the CAM, which is then set up again from scratch by poll */
+	void (*reset)(struct en50221_stdcam *stdcam);
+
 	/* destroy the stdcam instance */
 	void (*destroy)(struct en50221_stdcam *stdcam, int closefd);
+
+	/* where CA PMTs are staged: see en50221_stdcam_set_camgr() */
+	struct en50221_camgr *camgr;
+	uint32_t camgr_slot;
+	uint32_t camgr_max_programs;
+	int camgr_incremental;
 };
 
 /**
@@ -95,6 +117,63 @@ extern struct en50221_stdcam *en50221_stdcam_create(int adapter, int slotnum,
 						    struct en50221_transport_layer *tl,
 						    struct en50221_session_layer *sl);
 
+/**
+ * Stage the CA PMTs for this CAM in a CAM resource manager. The stdcam then
+ * brings its slot up in the manager, and flushes it, the moment the CAM's
+ * ca_info arrives (before any ca_info callback of the application is
+ * called), so the latest ca_pmt of each program is the first thing a newly
+ * initialised CAM is sent. The slot goes down again when the CAM is removed
+ * or reset, or closes its CA session: programs set meanwhile are held in the
+ * manager for the next CAM, instead of being sent into a dead session.
+ *
+ * Several stdcams, one per slot, may share a manager; each slot is then
+ * given its programs as soon as it is ready itself, whatever the others are
+ * doing. The manager must outlive the stdcam, or be unset first.
+ *
+ * @param stdcam The stdcam.
+ * @param camgr The manager, or NULL to stop staging.
+ * @param slot This CAM's slot number in the manager.
+ * @param max_programs As for en50221_camgr_slot_up().
+ * @param incremental As for en50221_camgr_slot_up().
+ */
+extern void en50221_stdcam_set_camgr(struct en50221_stdcam *stdcam,
+				     struct en50221_camgr *camgr,
+				     uint32_t slot,
+				     uint32_t max_programs,
+				     int incremental);
+
+/**
+ * The session layer callback of the stdcam implementations' CA resource:
+ * it brings the slot up in the stdcam's manager on a ca_info, and passes
+ * everything on to en50221_app_ca_message().
+ */
+extern int en50221_stdcam_ca_message(struct en50221_stdcam *stdcam,
+				     uint8_t slot_id,
+				     uint16_t session_number,
+				     uint32_t resource_id,
+				     uint8_t *data, uint32_t data_length);
+
+/**
+ * Take the stdcam's slot down in its manager, if it has one: for the
+ * stdcam implementations, when the CAM goes away.
+ */
+extern void en50221_stdcam_camgr_down(struct en50221_stdcam *stdcam);
+
+/**
+ * For the stdcam implementations: the CLOCK_MONOTONIC time in ms.
+ */
+extern int64_t en50221_stdcam_now(void);
+
+/**
+ * For the stdcam implementations: set a timerfd to become readable at a
+ * deadline, creating it on first use. A timerfd already readable is reset.
+ *
+ * @param timer_fd The timerfd, or -1 to create one.
+ * @param deadline CLOCK_MONOTONIC time in ms, -1 to disarm.
+ * @return 0 on success, -1 on failure.
+ */
+extern int en50221_stdcam_set_timer(int *timer_fd, int64_t deadline);
+
 #ifdef __cplusplus
 }
 #endif
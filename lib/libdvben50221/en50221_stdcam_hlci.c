@@ -29,6 +29,7 @@
 #include "en50221_app_tags.h"
 #include "en50221_stdcam.h"
 
+#define HLCI_STATE_CHECK_MS 100	// how often an event loop checks for CAM insertion/removal
 
 struct en50221_stdcam_hlci {
 	struct en50221_stdcam stdcam;
@@ -36,11 +37,17 @@ struct en50221_stdcam_hlci {
 	int cafd;
 	int slotnum;
 	int initialised;
+	int event_driven;
+	int timer_fd;		// expires at deadline
+	int64_t deadline;
 	struct en50221_app_send_functions sendfuncs;
 };
 
 static void en50221_stdcam_hlci_destroy(struct en50221_stdcam *stdcam, int closefd);
 static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam *stdcam);
+static int en50221_stdcam_hlci_get_pollfd(struct en50221_stdcam *stdcam, int *timeout);
+static int64_t en50221_stdcam_hlci_next_deadline(struct en50221_stdcam *stdcam);
+static void en50221_stdcam_hlci_reset(struct en50221_stdcam *stdcam);
 static int hlci_cam_added(struct en50221_stdcam_hlci *hlci);
 static int hlci_send_data(void *arg, uint16_t session_number,
 			  uint8_t * data, uint16_t data_length);
@@ -76,8 +83,13 @@ struct en50221_stdcam *en50221_stdcam_hlci_create(int cafd, int slotnum)
 	// done
 	hlci->stdcam.destroy = en50221_stdcam_hlci_destroy;
 	hlci->stdcam.poll = en50221_stdcam_hlci_poll;
+	hlci->stdcam.get_pollfd = en50221_stdcam_hlci_get_pollfd;
+	hlci->stdcam.next_deadline = en50221_stdcam_hlci_next_deadline;
+	hlci->stdcam.reset = en50221_stdcam_hlci_reset;
 	hlci->slotnum = slotnum;
 	hlci->cafd = cafd;
+	hlci->timer_fd = -1;
+	hlci->deadline = -1;
 	return &hlci->stdcam;
 }
 
@@ -92,6 +104,8 @@ static void en50221_stdcam_hlci_destroy(struct en50221_stdcam *stdcam, int close
 	if (hlci->stdcam.mmi_resource)
 		en50221_app_mmi_destroy(hlci->stdcam.mmi_resource);
 
+	if (hlci->timer_fd != -1)
+		close(hlci->timer_fd);
 	if (closefd)
 		close(hlci->cafd);
 
@@ -101,9 +115,18 @@ static void en50221_stdcam_hlci_destroy(struct en50221_stdcam *stdcam, int close
 static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam *stdcam)
 {
 	struct en50221_stdcam_hlci *hlci = (struct en50221_stdcam_hlci *) stdcam;
+	uint64_t expirations;
+
+	if (hlci->timer_fd != -1) {
+		if (read(hlci->timer_fd, &expirations, sizeof(expirations)) < 0) {
+			// not expired yet
+		}
+	}
 
 	switch(dvbca_get_cam_state(hlci->cafd, hlci->slotnum)) {
 	case DVBCA_CAMSTATE_MISSING:
+		if (hlci->initialised)
+			en50221_stdcam_camgr_down(&hlci->stdcam);
 		hlci->initialised = 0;
 		break;
 
@@ -114,8 +137,9 @@ static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam
 		break;
 	}
 
-	// delay to prevent busy loop
-	usleep(10);
+	// delay to prevent busy loop (an event loop does its own waiting)
+	if (!hlci->event_driven)
+		usleep(10);
 
 	if (!hlci->initialised) {
 		return EN50221_STDCAM_CAM_NONE;
@@ -123,6 +147,39 @@ static enum en50221_stdcam_status en50221_stdcam_hlci_poll(struct en50221_stdcam
 	return EN50221_STDCAM_CAM_OK;
 }
 
+static int en50221_stdcam_hlci_get_pollfd(struct en50221_stdcam *stdcam, int *timeout)
+{
+	struct en50221_stdcam_hlci *hlci = (struct en50221_stdcam_hlci *) stdcam;
+
+	// HLCI messages are read synchronously when they are sent, so the only
+	// thing to wait for is a change in the CAM state, which the driver
+	// does not signal; a timerfd expiring then gives an fd to wait on
+	hlci->event_driven = 1;
+	*timeout = HLCI_STATE_CHECK_MS;
+	hlci->deadline = en50221_stdcam_now() + HLCI_STATE_CHECK_MS;
+	if (en50221_stdcam_set_timer(&hlci->timer_fd, hlci->deadline))
+		return -1;
+	return hlci->timer_fd;
+}
+
+static int64_t en50221_stdcam_hlci_next_deadline(struct en50221_stdcam *stdcam)
+{
+	struct en50221_stdcam_hlci *hlci = (struct en50221_stdcam_hlci *) stdcam;
+
+	return hlci->deadline;
+}
+
+
+static void en50221_stdcam_hlci_reset(struct en50221_stdcam *stdcam)
+{
+	struct en50221_stdcam_hlci *hlci = (struct en50221_stdcam_hlci *) stdcam;
+
+	// poll sets it up again once it is ready
+	if (hlci->initialised)
+		en50221_stdcam_camgr_down(&hlci->stdcam);
+	hlci->initialised = 0;
+	dvbca_reset(hlci->cafd, hlci->slotnum);
+}
 
 
 static int hlci_cam_added(struct en50221_stdcam_hlci *hlci)
@@ -147,7 +204,8 @@ static int hlci_cam_added(struct en50221_stdcam_hlci *hlci)
 	buf[1] = (uint8_t) (TAG_CA_INFO >> 8);
 	buf[2] = (uint8_t) TAG_CA_INFO;
 	buf[3] = 0;
-	if (en50221_app_ca_message(hlci->stdcam.ca_resource, 0, 0, EN50221_APP_CA_RESOURCEID, buf, 4)) {
+	if (en50221_stdcam_ca_message(&hlci->stdcam, 0, hlci->stdcam.ca_session_number,
+				      EN50221_APP_CA_RESOURCEID, buf, 4)) {
 		return -EIO;
 	}
 
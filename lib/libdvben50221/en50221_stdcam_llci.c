@@ -24,6 +24,7 @@
 #include <limits.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/epoll.h>
 #include <libdvbapi/dvbca.h>
 #include <libdvbmisc/dvbmisc.h>
 #include "en50221_app_rm.h"
@@ -34,6 +35,8 @@
 
 #define LLCI_RESPONSE_TIMEOUT_MS 1000
 #define LLCI_POLL_DELAY_MS 100
+#define LLCI_MAX_WAIT_MS 100	// longest a poll sleeps, so CAM removal is noticed
+#define LLCI_IDLE_WAIT_MS 10	// poll interval while there is no CAM to talk to
 
 /* resource IDs we support */
 static uint32_t resource_ids[] =
@@ -71,12 +74,21 @@ struct en50221_stdcam_llci {
 	struct en50221_app_datetime *datetime_resource;
 	int datetime_session_number;
 	uint8_t datetime_response_interval;
-	time_t datetime_next_send;
+	int64_t datetime_next_send;	// CLOCK_MONOTONIC ms
 	time_t datetime_dvbtime;
+
+	int event_driven;
+	int epoll_fd;		// cafd, the transport slot's wake fd, and timer_fd
+	int epoll_wake_fd;	// wake fd currently in epoll_fd
+	int timer_fd;		// expires at deadline
+	int64_t deadline;
 };
 
 static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam *stdcam);
+static int en50221_stdcam_llci_get_pollfd(struct en50221_stdcam *stdcam, int *timeout);
+static int64_t en50221_stdcam_llci_next_deadline(struct en50221_stdcam *stdcam);
 static void en50221_stdcam_llci_dvbtime(struct en50221_stdcam *stdcam, time_t dvbtime);
+static void en50221_stdcam_llci_reset(struct en50221_stdcam *stdcam);
 static void en50221_stdcam_llci_destroy(struct en50221_stdcam *stdcam, int closefd);
 static void llci_cam_added(struct en50221_stdcam_llci *llci);
 static void llci_cam_in_reset(struct en50221_stdcam_llci *llci);
@@ -149,8 +161,8 @@ struct en50221_stdcam *en50221_stdcam_llci_create(int cafd, int slotnum,
 	llci->stdcam.ca_resource = en50221_app_ca_create(&llci->sendfuncs);
 	en50221_app_decode_public_resource_id(&llci->resources[resource_idx].resid, EN50221_APP_CA_RESOURCEID);
 	llci->resources[resource_idx].binary_resource_id = EN50221_APP_CA_RESOURCEID;
-	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_app_ca_message;
-	llci->resources[resource_idx].arg = llci->stdcam.ca_resource;
+	llci->resources[resource_idx].callback = (en50221_sl_resource_callback) en50221_stdcam_ca_message;
+	llci->resources[resource_idx].arg = &llci->stdcam;
 	llci->stdcam.ca_session_number = -1;
 	resource_idx++;
 
@@ -170,13 +182,20 @@ struct en50221_stdcam *en50221_stdcam_llci_create(int cafd, int slotnum,
 	// done
 	llci->stdcam.destroy = en50221_stdcam_llci_destroy;
 	llci->stdcam.poll = en50221_stdcam_llci_poll;
+	llci->stdcam.get_pollfd = en50221_stdcam_llci_get_pollfd;
+	llci->stdcam.next_deadline = en50221_stdcam_llci_next_deadline;
 	llci->stdcam.dvbtime = en50221_stdcam_llci_dvbtime;
+	llci->stdcam.reset = en50221_stdcam_llci_reset;
 	llci->cafd = cafd;
 	llci->slotnum = slotnum;
 	llci->tl = tl;
 	llci->sl = sl;
 	llci->tl_slot_id = -1;
 	llci->state = EN50221_STDCAM_CAM_NONE;
+	llci->epoll_fd = -1;
+	llci->epoll_wake_fd = -1;
+	llci->timer_fd = -1;
+	llci->deadline = -1;
 	return &llci->stdcam;
 }
 
@@ -187,6 +206,15 @@ static void en50221_stdcam_llci_dvbtime(struct en50221_stdcam *stdcam, time_t dv
 	llci->datetime_dvbtime = dvbtime;
 }
 
+static void en50221_stdcam_llci_reset(struct en50221_stdcam *stdcam)
+{
+	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
+
+	// as if it had just been inserted
+	if (llci->state != EN50221_STDCAM_CAM_NONE)
+		llci_cam_added(llci);
+}
+
 static void en50221_stdcam_llci_destroy(struct en50221_stdcam *stdcam, int closefd)
 {
 	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
@@ -206,6 +234,10 @@ static void en50221_stdcam_llci_destroy(struct en50221_stdcam *stdcam, int close
 	if (llci->stdcam.mmi_resource)
 		en50221_app_mmi_destroy(llci->stdcam.mmi_resource);
 
+	if (llci->epoll_fd != -1)
+		close(llci->epoll_fd);
+	if (llci->timer_fd != -1)
+		close(llci->timer_fd);
 	if (closefd)
 		close(llci->cafd);
 
@@ -218,6 +250,14 @@ static void en50221_stdcam_llci_destroy(struct en50221_stdcam *stdcam, int close
 static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam *stdcam)
 {
 	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
+	uint64_t expirations;
+
+	// the deadline is being handled
+	if (llci->timer_fd != -1) {
+		if (read(llci->timer_fd, &expirations, sizeof(expirations)) < 0) {
+			// not expired yet: called for input
+		}
+	}
 
 	switch(dvbca_get_cam_state(llci->cafd, llci->slotnum)) {
 	case DVBCA_CAMSTATE_MISSING:
@@ -233,26 +273,114 @@ static enum en50221_stdcam_status en50221_stdcam_llci_poll(struct en50221_stdcam
 		break;
 	}
 
-	// poll the stack
-	int error;
-	if ((error = en50221_tl_poll(llci->tl)) != 0) {
+	// poll the stack: only our own slot, so a slow CAM in another slot
+	// (polled by another stdcam) cannot hold us up
+	// an event loop has already waited for us
+	int error = 0;
+	if (llci->tl_slot_id != -1)
+		error = en50221_tl_poll_slot(llci->tl, llci->tl_slot_id,
+					     llci->event_driven ? 0 : LLCI_MAX_WAIT_MS);
+	else if (!llci->event_driven)
+		usleep(LLCI_IDLE_WAIT_MS * 1000);
+	if (error != 0) {
 		print(LOG_LEVEL, ERROR, 1, "Error reported by stack:%i\n", en50221_tl_get_error(llci->tl));
 	}
 
 	// send date/time response
 	if (llci->datetime_session_number != -1) {
-		time_t cur_time = time(NULL);
-		if (llci->datetime_response_interval && (cur_time > llci->datetime_next_send)) {
+		int64_t now = en50221_stdcam_now();
+		if (llci->datetime_response_interval && (now >= llci->datetime_next_send)) {
 			en50221_app_datetime_send(llci->datetime_resource,
 						llci->datetime_session_number,
 						llci->datetime_dvbtime, 0);
-			llci->datetime_next_send = cur_time + llci->datetime_response_interval;
+			llci->datetime_next_send = now + (llci->datetime_response_interval * 1000);
 		}
 	}
 
 	return llci->state;
 }
 
+static int en50221_stdcam_llci_get_pollfd(struct en50221_stdcam *stdcam, int *timeout)
+{
+	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
+	struct epoll_event ev;
+	int64_t now = en50221_stdcam_now();
+	int wake_fd = -1;
+
+	// one fd for the application to wait on, covering both the CA device
+	// and messages queued for the CAM by other threads
+	if (llci->epoll_fd == -1) {
+		if ((llci->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+			llci->epoll_fd = -1;
+			return -1;
+		}
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLPRI;
+		if (epoll_ctl(llci->epoll_fd, EPOLL_CTL_ADD, llci->cafd, &ev)) {
+			close(llci->epoll_fd);
+			llci->epoll_fd = -1;
+			return -1;
+		}
+	}
+	llci->event_driven = 1;
+
+	// CAM insertion/removal is not signalled, so it is checked for regularly;
+	// the end of a reset more often, as everything else waits for it
+	*timeout = LLCI_MAX_WAIT_MS;
+	if (llci->state == EN50221_STDCAM_CAM_INRESET)
+		*timeout = LLCI_IDLE_WAIT_MS;
+	if (llci->tl_slot_id != -1) {
+		int slot_timeout = en50221_tl_get_slot_wait(llci->tl, llci->tl_slot_id, &wake_fd);
+		if ((slot_timeout >= 0) && (slot_timeout < *timeout))
+			*timeout = slot_timeout;
+	}
+	if (wake_fd != llci->epoll_wake_fd) {
+		if (llci->epoll_wake_fd != -1)
+			epoll_ctl(llci->epoll_fd, EPOLL_CTL_DEL, llci->epoll_wake_fd, NULL);
+		llci->epoll_wake_fd = -1;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		if ((wake_fd != -1) &&
+		    (epoll_ctl(llci->epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) == 0))
+			llci->epoll_wake_fd = wake_fd;
+	}
+
+	// date/time responses
+	if ((llci->datetime_session_number != -1) && llci->datetime_response_interval) {
+		int64_t due = llci->datetime_next_send - now;
+
+		if (due < 0)
+			due = 0;
+		if (due < *timeout)
+			*timeout = due;
+	}
+
+	// the same deadline on a timerfd, so the fd alone may be waited on
+	llci->deadline = now + *timeout;
+	if (llci->timer_fd == -1) {
+		if (en50221_stdcam_set_timer(&llci->timer_fd, llci->deadline) == 0) {
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			if (epoll_ctl(llci->epoll_fd, EPOLL_CTL_ADD, llci->timer_fd, &ev)) {
+				close(llci->timer_fd);
+				llci->timer_fd = -1;
+			}
+		}
+	} else {
+		en50221_stdcam_set_timer(&llci->timer_fd, llci->deadline);
+	}
+
+	return llci->epoll_fd;
+}
+
+static int64_t en50221_stdcam_llci_next_deadline(struct en50221_stdcam *stdcam)
+{
+	struct en50221_stdcam_llci *llci = (struct en50221_stdcam_llci *) stdcam;
+
+	return llci->deadline;
+}
+
 static void llci_cam_added(struct en50221_stdcam_llci *llci)
 {
 	// clear down any old structures
@@ -291,6 +419,7 @@ static void llci_cam_in_reset(struct en50221_stdcam_llci *llci)
 
 static void llci_cam_removed(struct en50221_stdcam_llci *llci)
 {
+	en50221_stdcam_camgr_down(&llci->stdcam);
 	if (llci->tl_slot_id != -1) {
 		en50221_tl_destroy_slot(llci->tl, llci->tl_slot_id);
 		llci->tl_slot_id = -1;
@@ -384,6 +513,7 @@ static int llci_session_callback(void *arg, int reason, uint8_t _slot_id, uint16
 		} else if (resource_id == EN50221_APP_AI_RESOURCEID) {
 			llci->stdcam.ai_session_number = -1;
 		} else if (resource_id == EN50221_APP_CA_RESOURCEID) {
+			en50221_stdcam_camgr_down(&llci->stdcam);
 			llci->stdcam.ca_session_number = -1;
 		} else if (resource_id == EN50221_APP_MMI_RESOURCEID) {
 			llci->stdcam.mmi_session_number = -1;
@@ -436,7 +566,7 @@ static int llci_datetime_enquiry_callback(void *arg, uint8_t _slot_id, uint16_t
 	llci->datetime_response_interval = response_interval;
 	llci->datetime_next_send = 0;
 	if (response_interval) {
-		llci->datetime_next_send = time(NULL) + response_interval;
+		llci->datetime_next_send = en50221_stdcam_now() + (response_interval * 1000);
 	}
 	en50221_app_datetime_send(llci->datetime_resource, session_number, llci->datetime_dvbtime, 0);
 
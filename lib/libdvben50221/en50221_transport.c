@@ -28,11 +28,15 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/poll.h>
+#include <sys/eventfd.h>
 #include <time.h>
 #include <libdvbmisc/dvbmisc.h>
+#include <libdvbmisc/dvbstats.h>
+#include <libdvbmisc/dvbprobe.h>
 #include <libdvbapi/dvbca.h>
 #include "en50221_errno.h"
 #include "en50221_transport.h"
+#include "en50221_stats.h"
 #include "asn_1.h"
 
 // these are the Transport Tags, like
@@ -54,15 +58,51 @@
 struct en50221_message {
 	struct en50221_message *next;
 	uint32_t length;
+	uint32_t size;		// of data: TL_MSG_SMALL/TL_MSG_LARGE if from a pool
+	uint8_t link_header[DVBCA_LINK_HEADER];	// so data is sent without a copy
 	uint8_t data[0];
 };
 
+// Messages are queued in chunks from per slot pools, which are only freed
+// with the slot, so once the pools have grown to the most messages ever
+// queued at once, sending needs no allocations. A small chunk takes the
+// connection TPDUs and most APDUs, a large one a CA PMT or MMI answer; only
+// bigger messages are allocated for themselves.
+#define TL_MSG_SMALL		64
+#define TL_MSG_LARGE		4096
+#define TL_MSG_PREALLOC_SMALL	8
+#define TL_MSG_PREALLOC_LARGE	2
+
+// room for the T_DATA_LAST header in front of the data
+#define TL_MSG_HEADER		10
+
+// a reassembly buffer up to this size is kept for the connection's next
+// chained APDU, so MMI menus and the like are reassembled without allocations
+#define TL_CHAIN_KEEP		65536
+
+// TPDU size the host asks for when a slot is registered, and the one used
+// if the CA device will not say; data_length + TL_MSG_HEADER above it is
+// sent as a T_DATA_MORE chain. Sending and receiving a large APDU in one
+// TPDU saves a T_SB/T_RCV round trip per fragment
+#define TL_LINK_SIZE		16384
+#define TL_LINK_SIZE_FALLBACK	4096
+
+// how many messages are read per wakeup
+#define TL_READ_FRAMES		4
+
+// while a chain is going either way, the transport waits this long (ms) for
+// the CAM's answer rather than going back through the caller's poll loop,
+// for up to this many TPDUs
+#define TL_BURST_WAIT		5
+#define TL_BURST_TPDUS		64
+
 struct en50221_connection {
 	uint32_t state;		// the current state: idle/in_delete/in_create/active
 	struct timeval tx_time;	// time last request was sent from host->module, or 0 if ok
 	struct timeval last_poll_time;	// time of last poll transmission
 	uint8_t *chain_buffer;	// used to save parts of chained packets
-	uint32_t buffer_length;
+	uint32_t buffer_length;	// bytes saved, 0 when no chain is in progress
+	uint32_t buffer_size;	// allocated size of chain_buffer
 
 	struct en50221_message *send_queue;
 	struct en50221_message *send_queue_tail;
@@ -74,9 +114,17 @@ struct en50221_slot {
 	struct en50221_connection *connections;
 
 	pthread_mutex_t slot_lock;
+	int wake_fd;		// signalled when a message is queued for the slot
 
 	uint32_t response_timeout;
 	uint32_t poll_delay;
+
+	uint32_t link_size;	// agreed TPDU size
+	uint8_t *rx_buffer;	// TL_READ_FRAMES of link_size, NULL while in use
+	uint32_t rx_size;
+
+	struct en50221_message *free_small;	// message pools
+	struct en50221_message *free_large;
 };
 
 struct en50221_transport_layer {
@@ -106,6 +154,26 @@ static int en50221_tl_alloc_new_tc(struct en50221_transport_layer *tl,
 static void queue_message(struct en50221_transport_layer *tl,
 			  uint8_t slot_id, uint8_t connection_id,
 			  struct en50221_message *msg);
+static struct en50221_message *en50221_tl_alloc_message(struct en50221_slot *slot,
+							uint32_t data_size);
+static void en50221_tl_free_message(struct en50221_slot *slot,
+				    struct en50221_message *msg);
+static void en50221_tl_free_pools(struct en50221_slot *slot);
+static int en50221_tl_chain_append(struct en50221_connection *connection,
+				   uint8_t *data, uint32_t data_length);
+static void en50221_tl_reset_chain(struct en50221_connection *connection);
+static int en50221_tl_service_slot(struct en50221_transport_layer *tl,
+				   uint8_t slot_id, short revents);
+static int en50221_tl_service_pass(struct en50221_transport_layer *tl,
+				   uint8_t slot_id, short revents,
+				   uint8_t *rx_buffer, uint32_t rx_size,
+				   uint32_t link_size, int *burst_fd);
+static int en50221_tl_queue_apdu(struct en50221_transport_layer *tl,
+				 uint8_t slot_id, uint8_t connection_id,
+				 struct iovec *vector, int iov_count,
+				 uint32_t data_size);
+static int en50221_tl_slot_timeout(struct en50221_transport_layer *tl,
+				   uint8_t slot_id);
 static int en50221_tl_handle_create_tc_reply(struct en50221_transport_layer
 					     *tl, uint8_t slot_id,
 					     uint8_t connection_id);
@@ -166,6 +234,12 @@ struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 	// set them up
 	for (i = 0; i < max_slots; i++) {
 		tl->slots[i].ca_hndl = -1;
+		tl->slots[i].wake_fd = -1;
+		tl->slots[i].free_small = NULL;
+		tl->slots[i].free_large = NULL;
+		tl->slots[i].link_size = TL_LINK_SIZE_FALLBACK;
+		tl->slots[i].rx_buffer = NULL;
+		tl->slots[i].rx_size = 0;
 
 		// create the connections for this slot
 		tl->slots[i].connections =
@@ -176,6 +250,9 @@ struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 		// create a mutex for the slot
 		pthread_mutex_init(&tl->slots[i].slot_lock, NULL);
 
+		// and something to wake en50221_tl_poll_slot() with
+		tl->slots[i].wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
 		// set them up
 		for (j = 0; j < max_connections_per_slot; j++) {
 			tl->slots[i].connections[j].state = T_STATE_IDLE;
@@ -184,9 +261,21 @@ struct en50221_transport_layer *en50221_tl_create(uint8_t max_slots,
 			tl->slots[i].connections[j].last_poll_time.tv_usec = 0;
 			tl->slots[i].connections[j].chain_buffer = NULL;
 			tl->slots[i].connections[j].buffer_length = 0;
+			tl->slots[i].connections[j].buffer_size = 0;
 			tl->slots[i].connections[j].send_queue = NULL;
 			tl->slots[i].connections[j].send_queue_tail = NULL;
 		}
+
+		// fill the message pools
+		for (j = 0; j < TL_MSG_PREALLOC_SMALL + TL_MSG_PREALLOC_LARGE; j++) {
+			uint32_t size = (j < TL_MSG_PREALLOC_SMALL) ? TL_MSG_SMALL : TL_MSG_LARGE;
+			struct en50221_message *msg =
+				malloc(sizeof(struct en50221_message) + size);
+			if (msg == NULL)
+				goto error_exit;
+			msg->size = size;
+			en50221_tl_free_message(&tl->slots[i], msg);
+		}
 	}
 
 	// create the pollfds
@@ -227,9 +316,13 @@ void en50221_tl_destroy(struct en50221_transport_layer *tl)
 						tl->slots[i].connections[j].send_queue = NULL;
 						tl->slots[i].connections[j].send_queue_tail = NULL;
 					}
+					en50221_tl_free_pools(&tl->slots[i]);
+					free(tl->slots[i].rx_buffer);
 					free(tl->slots[i].connections);
 					pthread_mutex_destroy(&tl->slots[i].slot_lock);
 				}
+				if (tl->slots[i].wake_fd != -1)
+					close(tl->slots[i].wake_fd);
 			}
 			free(tl->slots);
 		}
@@ -267,12 +360,32 @@ int en50221_tl_register_slot(struct en50221_transport_layer *tl,
 		pthread_mutex_unlock(&tl->global_lock);
 		return -1;
 	}
+	// agree the TPDU size, and make room to read it; the buffer is kept
+	// for the next CAM in the slot if it is large enough
+	int link_size = dvbca_link_buffer_size(ca_hndl, slot, TL_LINK_SIZE);
+	if (link_size < TL_LINK_SIZE_FALLBACK)
+		link_size = TL_LINK_SIZE_FALLBACK;
+	uint32_t rx_size = TL_READ_FRAMES * (link_size + DVBCA_LINK_HEADER);
+
 	// set up the slot struct
 	pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+	if (tl->slots[slot_id].rx_size < rx_size) {
+		uint8_t *rx_buffer = malloc(rx_size);
+		if (rx_buffer == NULL) {
+			pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+			tl->error = EN50221ERR_OUTOFMEMORY;
+			pthread_mutex_unlock(&tl->global_lock);
+			return -1;
+		}
+		free(tl->slots[slot_id].rx_buffer);
+		tl->slots[slot_id].rx_buffer = rx_buffer;
+		tl->slots[slot_id].rx_size = rx_size;
+	}
 	tl->slots[slot_id].ca_hndl = ca_hndl;
 	tl->slots[slot_id].slot = slot;
 	tl->slots[slot_id].response_timeout = response_timeout;
 	tl->slots[slot_id].poll_delay = poll_delay;
+	tl->slots[slot_id].link_size = link_size;
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 
 	tl->slots_changed = 1;
@@ -305,12 +418,14 @@ void en50221_tl_destroy_slot(struct en50221_transport_layer *tl,
 		}
 		tl->slots[slot_id].connections[i].chain_buffer = NULL;
 		tl->slots[slot_id].connections[i].buffer_length = 0;
+		tl->slots[slot_id].connections[i].buffer_size = 0;
 
+		// the messages go back to the pools, for the next CAM
 		struct en50221_message *cur_msg =
 		    tl->slots[slot_id].connections[i].send_queue;
 		while (cur_msg) {
 			struct en50221_message *next_msg = cur_msg->next;
-			free(cur_msg);
+			en50221_tl_free_message(&tl->slots[slot_id], cur_msg);
 			cur_msg = next_msg;
 		}
 		tl->slots[slot_id].connections[i].send_queue = NULL;
@@ -332,9 +447,8 @@ void en50221_tl_destroy_slot(struct en50221_transport_layer *tl,
 
 int en50221_tl_poll(struct en50221_transport_layer *tl)
 {
-	uint8_t data[4096];
 	int slot_id;
-	int j;
+	int timeout = 10;
 
 	// make up pollfds if the slots have changed
 	pthread_mutex_lock(&tl->global_lock);
@@ -354,38 +468,192 @@ int en50221_tl_poll(struct en50221_transport_layer *tl)
 	}
 	pthread_mutex_unlock(&tl->global_lock);
 
+	// don't sleep past a poll or timeout which is due sooner
+	for (slot_id = 0; slot_id < tl->max_slots; slot_id++) {
+		pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+		int slot_timeout = en50221_tl_slot_timeout(tl, slot_id);
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		if ((slot_timeout >= 0) && (slot_timeout < timeout))
+			timeout = slot_timeout;
+	}
+
 	// anything happened?
-	if (poll(tl->slot_pollfds, tl->max_slots, 10) < 0) {
+	if (poll(tl->slot_pollfds, tl->max_slots, timeout) < 0) {
 		tl->error_slot = -1;
 		tl->error = EN50221ERR_CAREAD;
 		return -1;
 	}
 	// go through all slots (even though poll may not have reported any events
 	for (slot_id = 0; slot_id < tl->max_slots; slot_id++) {
+		if (en50221_tl_service_slot(tl, slot_id, tl->slot_pollfds[slot_id].revents))
+			return -1;
+	}
 
-		// check if this slot is still used and get its handle
-		pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
-		if (tl->slots[slot_id].ca_hndl == -1) {
+	return 0;
+}
+
+int en50221_tl_poll_slot(struct en50221_transport_layer *tl, uint8_t slot_id, int timeout)
+{
+	struct pollfd pollfds[2];
+	uint64_t wakeups;
+
+	if (slot_id >= tl->max_slots) {
+		tl->error = EN50221ERR_BADSLOTID;
+		return -1;
+	}
+
+	// sleep until there is data, a message is queued, or a poll/timeout is due
+	pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+	if (tl->slots[slot_id].ca_hndl == -1) {
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		tl->error = EN50221ERR_BADSLOTID;
+		return -1;
+	}
+	pollfds[0].fd = tl->slots[slot_id].ca_hndl;
+	pollfds[0].events = POLLIN | POLLPRI | POLLERR;
+	pollfds[0].revents = 0;
+	pollfds[1].fd = tl->slots[slot_id].wake_fd;
+	pollfds[1].events = POLLIN;
+	pollfds[1].revents = 0;
+	int slot_timeout = en50221_tl_slot_timeout(tl, slot_id);
+	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+	if ((slot_timeout >= 0) && ((timeout < 0) || (slot_timeout < timeout)))
+		timeout = slot_timeout;
+
+	if (poll(pollfds, (pollfds[1].fd != -1) ? 2 : 1, timeout) < 0) {
+		tl->error_slot = slot_id;
+		tl->error = EN50221ERR_CAREAD;
+		return -1;
+	}
+	if (pollfds[1].revents & POLLIN) {
+		if (read(pollfds[1].fd, &wakeups, sizeof(wakeups)) < 0) {
+			// nothing to do: the counter was already drained
+		}
+	}
+
+	return en50221_tl_service_slot(tl, slot_id, pollfds[0].revents);
+}
+
+int en50221_tl_get_slot_wait(struct en50221_transport_layer *tl, uint8_t slot_id,
+			     int *wake_fd)
+{
+	int timeout;
+
+	*wake_fd = -1;
+	if (slot_id >= tl->max_slots)
+		return -2;
+
+	pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+	if (tl->slots[slot_id].ca_hndl == -1) {
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		return -2;
+	}
+	*wake_fd = tl->slots[slot_id].wake_fd;
+	timeout = en50221_tl_slot_timeout(tl, slot_id);
+	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+
+	return timeout;
+}
+
+static int en50221_tl_service_slot(struct en50221_transport_layer *tl,
+				   uint8_t slot_id, short revents)
+{
+	struct en50221_slot *slot = &tl->slots[slot_id];
+	int tpdus = TL_BURST_TPDUS;
+	int burst_fd;
+	int result;
+
+	// take the read buffer off the slot while it is unlocked
+	pthread_mutex_lock(&slot->slot_lock);
+	if (slot->ca_hndl == -1) {
+		pthread_mutex_unlock(&slot->slot_lock);
+		return 0;
+	}
+	uint8_t *rx_buffer = slot->rx_buffer;
+	uint32_t rx_size = slot->rx_size;
+	uint32_t link_size = slot->link_size;
+	slot->rx_buffer = NULL;
+	slot->rx_size = 0;
+	pthread_mutex_unlock(&slot->slot_lock);
+	if (rx_buffer == NULL) {
+		// an other thread is servicing the slot as well
+		rx_size = TL_READ_FRAMES * (link_size + DVBCA_LINK_HEADER);
+		if ((rx_buffer = malloc(rx_size)) == NULL) {
+			tl->error_slot = slot_id;
+			tl->error = EN50221ERR_OUTOFMEMORY;
+			return -1;
+		}
+	}
+
+	// keep a chain going while the CAM answers promptly
+	while ((result = en50221_tl_service_pass(tl, slot_id, revents, rx_buffer, rx_size,
+						 link_size, &burst_fd)) == 0) {
+		struct pollfd pollfd;
+
+		if ((burst_fd == -1) || (--tpdus == 0))
+			break;
+		pollfd.fd = burst_fd;
+		pollfd.events = POLLIN | POLLPRI;
+		pollfd.revents = 0;
+		if (poll(&pollfd, 1, TL_BURST_WAIT) != 1)
+			break;
+		revents = pollfd.revents;
+		dvbstats_inc(&en50221_stats, EN50221_STATS_BURSTS);
+	}
+
+	// and give it back, unless the slot has a new CAM needing a bigger one
+	pthread_mutex_lock(&slot->slot_lock);
+	if ((slot->rx_buffer == NULL) &&
+	    (rx_size >= TL_READ_FRAMES * (slot->link_size + DVBCA_LINK_HEADER))) {
+		slot->rx_buffer = rx_buffer;
+		slot->rx_size = rx_size;
+		rx_buffer = NULL;
+	}
+	pthread_mutex_unlock(&slot->slot_lock);
+	free(rx_buffer);
+
+	return result;
+}
+
+static int en50221_tl_service_pass(struct en50221_transport_layer *tl,
+				   uint8_t slot_id, short revents,
+				   uint8_t *rx_buffer, uint32_t rx_size,
+				   uint32_t link_size, int *burst_fd)
+{
+	struct dvbca_link_frame frames[TL_READ_FRAMES];
+	int frame_count;
+	int f;
+	int j;
+
+	*burst_fd = -1;
+
+	// check if this slot is still used and get its handle
+	pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+	if (tl->slots[slot_id].ca_hndl == -1) {
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		return 0;
+	}
+	int ca_hndl = tl->slots[slot_id].ca_hndl;
+
+	if (revents & (POLLPRI | POLLIN)) {
+		// read everything the CAM has sent, not just a message per wakeup
+		frame_count = dvbca_link_read_frames(ca_hndl, rx_buffer, rx_size, link_size,
+						     frames, TL_READ_FRAMES);
+		if (frame_count < 0) {
+			tl->error_slot = slot_id;
+			tl->error = EN50221ERR_CAREAD;
 			pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-			continue;
+			return -1;
 		}
-		int ca_hndl = tl->slots[slot_id].ca_hndl;
+		for (f = 0; f < frame_count; f++) {
+			uint8_t r_slot_id = frames[f].slot;
+			int readcnt = frames[f].length;
 
-		if (tl->slot_pollfds[slot_id].revents & (POLLPRI | POLLIN)) {
-			// read data
-			uint8_t r_slot_id;
-			uint8_t connection_id;
-			int readcnt = dvbca_link_read(ca_hndl, &r_slot_id,
-						      &connection_id,
-						      data, sizeof(data));
-			if (readcnt < 0) {
-				tl->error_slot = slot_id;
-				tl->error = EN50221ERR_CAREAD;
-				pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-				return -1;
-			}
 			// process it if we got some
 			if (readcnt > 0) {
+				dvbstats_inc(&en50221_stats, EN50221_STATS_TPDUS_RECEIVED);
+				dvbstats_record(&en50221_stats, EN50221_STATS_TPDU_BYTES, readcnt);
+				DVBPROBE2(tpdu_receive, r_slot_id, readcnt);
 				if (tl->slots[slot_id].slot != r_slot_id) {
 					// this message is for an other CAM of the same CA
 					int new_slot_id;
@@ -395,119 +663,173 @@ int en50221_tl_poll(struct en50221_transport_layer *tl)
 							break;
 					}
 					if (new_slot_id != tl->max_slots) {
-						// we found the requested CAM
+						// we found the requested CAM. Only one slot lock is
+						// held at a time, as the other slot may be serviced
+						// by a thread of its own
+						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 						pthread_mutex_lock(&tl->slots[new_slot_id].slot_lock);
-						if (en50221_tl_process_data(tl, new_slot_id, data, readcnt)) {
+						if (en50221_tl_process_data(tl, new_slot_id, frames[f].data, readcnt)) {
 							pthread_mutex_unlock(&tl->slots[new_slot_id].slot_lock);
-							pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 							return -1;
 						}
 						pthread_mutex_unlock(&tl->slots[new_slot_id].slot_lock);
+						pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
+						if (tl->slots[slot_id].ca_hndl != ca_hndl) {
+							pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+							return 0;
+						}
 					} else {
 						tl->error = EN50221ERR_BADSLOTID;
 						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 						return -1;
 					}
 				} else
-				    if (en50221_tl_process_data(tl, slot_id, data, readcnt)) {
+				    if (en50221_tl_process_data(tl, slot_id, frames[f].data, readcnt)) {
 					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 					return -1;
 				}
 			}
-		} else if (tl->slot_pollfds[slot_id].revents & POLLERR) {
-			// an error was reported
-			tl->error_slot = slot_id;
-			tl->error = EN50221ERR_CAREAD;
-			pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-			return -1;
 		}
-		// poll the connections on this slot + check for timeouts
-		for (j = 0; j < tl->max_connections_per_slot; j++) {
-			// ignore connection if idle
-			if (tl->slots[slot_id].connections[j].state == T_STATE_IDLE) {
-				continue;
-			}
-			// send queued data
-			if (tl->slots[slot_id].connections[j].state &
-				(T_STATE_IN_CREATION | T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
-				// send data if there is some to go and we're not waiting for a response already
-				if (tl->slots[slot_id].connections[j].send_queue &&
-				    (tl->slots[slot_id].connections[j].tx_time.tv_sec == 0)) {
-
-					// get the message
-					struct en50221_message *msg =
-						tl->slots[slot_id].connections[j].send_queue;
-					if (msg->next != NULL) {
-						tl->slots[slot_id].connections[j].send_queue = msg->next;
-					} else {
-						tl->slots[slot_id].connections[j].send_queue = NULL;
-						tl->slots[slot_id].connections[j].send_queue_tail = NULL;
-					}
-
-					// send the message
-					if (dvbca_link_write(tl->slots[slot_id].ca_hndl,
-					    		     tl->slots[slot_id].slot,
-							     j,
-							     msg->data, msg->length) < 0) {
-						free(msg);
-						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-						tl->error_slot = slot_id;
-						tl->error = EN50221ERR_CAWRITE;
-						print(LOG_LEVEL, ERROR, 1, "CAWrite failed");
-						return -1;
-					}
-					gettimeofday(&tl->slots[slot_id].connections[j].tx_time, 0);
-
-					// fixup connection state for T_DELETE_T_C
-					if (msg->length && (msg->data[0] == T_DELETE_T_C)) {
-						tl->slots[slot_id].connections[j].state = T_STATE_IN_DELETION;
-						if (tl->slots[slot_id].connections[j].chain_buffer) {
-							free(tl->slots[slot_id].connections[j].chain_buffer);
-						}
-						tl->slots[slot_id].connections[j].chain_buffer = NULL;
-						tl->slots[slot_id].connections[j].buffer_length = 0;
-					}
+	} else if (revents & POLLERR) {
+		// an error was reported
+		tl->error_slot = slot_id;
+		tl->error = EN50221ERR_CAREAD;
+		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+		return -1;
+	}
+	// poll the connections on this slot + check for timeouts
+	for (j = 0; j < tl->max_connections_per_slot; j++) {
+		// ignore connection if idle
+		if (tl->slots[slot_id].connections[j].state == T_STATE_IDLE) {
+			continue;
+		}
+		// send queued data
+		if (tl->slots[slot_id].connections[j].state &
+			(T_STATE_IN_CREATION | T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
+			// send data if there is some to go and we're not waiting for a response already
+			if (tl->slots[slot_id].connections[j].send_queue &&
+			    (tl->slots[slot_id].connections[j].tx_time.tv_sec == 0)) {
+
+				// get the message
+				struct en50221_message *msg =
+					tl->slots[slot_id].connections[j].send_queue;
+				if (msg->next != NULL) {
+					tl->slots[slot_id].connections[j].send_queue = msg->next;
+				} else {
+					tl->slots[slot_id].connections[j].send_queue = NULL;
+					tl->slots[slot_id].connections[j].send_queue_tail = NULL;
+				}
 
-					free(msg);
+				// send the message
+				if (dvbca_link_write_frame(tl->slots[slot_id].ca_hndl,
+							   tl->slots[slot_id].slot,
+							   j,
+							   msg->link_header, msg->length) < 0) {
+					en50221_tl_free_message(&tl->slots[slot_id], msg);
+					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+					tl->error_slot = slot_id;
+					tl->error = EN50221ERR_CAWRITE;
+					print(LOG_LEVEL, ERROR, 1, "CAWrite failed");
+					return -1;
 				}
-			}
-			// poll it if we're not expecting a reponse and the poll time has elapsed
-			if (tl->slots[slot_id].connections[j].state & T_STATE_ACTIVE) {
-				if ((tl->slots[slot_id].connections[j].tx_time.tv_sec == 0) &&
-				    (time_after(tl->slots[slot_id].connections[j].last_poll_time,
-				     		tl->slots[slot_id].poll_delay))) {
-
-					gettimeofday(&tl->slots[slot_id].connections[j].last_poll_time, 0);
-					if (en50221_tl_poll_tc(tl, slot_id, j)) {
-						pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-						return -1;
-					}
+				gettimeofday(&tl->slots[slot_id].connections[j].tx_time, 0);
+				dvbstats_inc(&en50221_stats, EN50221_STATS_TPDUS_SENT);
+				DVBPROBE3(tpdu_send, tl->slots[slot_id].slot, j, msg->length);
+
+				// fixup connection state for T_DELETE_T_C
+				if (msg->length && (msg->data[0] == T_DELETE_T_C)) {
+					tl->slots[slot_id].connections[j].state = T_STATE_IN_DELETION;
+					en50221_tl_reset_chain(&tl->slots[slot_id].connections[j]);
 				}
-			}
 
-			// check for timeouts - in any state
-			if (tl->slots[slot_id].connections[j].tx_time.tv_sec &&
-			    (time_after(tl->slots[slot_id].connections[j].tx_time,
-			     		tl->slots[slot_id].response_timeout))) {
+				en50221_tl_free_message(&tl->slots[slot_id], msg);
 
-				if (tl->slots[slot_id].connections[j].state &
-				    (T_STATE_IN_CREATION |T_STATE_IN_DELETION)) {
-					tl->slots[slot_id].connections[j].state = T_STATE_IDLE;
-				} else if (tl->slots[slot_id].connections[j].state &
-					   (T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
-					tl->error_slot = slot_id;
-					tl->error = EN50221ERR_TIMEOUT;
+				// more to go: the next can follow as soon as the CAM answers
+				if (tl->slots[slot_id].connections[j].send_queue)
+					*burst_fd = ca_hndl;
+			}
+		}
+		// a chain is coming in, and a T_RCV for its next part went out
+		if (tl->slots[slot_id].connections[j].buffer_length &&
+		    tl->slots[slot_id].connections[j].tx_time.tv_sec)
+			*burst_fd = ca_hndl;
+
+		// poll it if we're not expecting a reponse and the poll time has elapsed
+		if (tl->slots[slot_id].connections[j].state & T_STATE_ACTIVE) {
+			if ((tl->slots[slot_id].connections[j].tx_time.tv_sec == 0) &&
+			    (time_after(tl->slots[slot_id].connections[j].last_poll_time,
+			     		tl->slots[slot_id].poll_delay))) {
+
+				gettimeofday(&tl->slots[slot_id].connections[j].last_poll_time, 0);
+				if (en50221_tl_poll_tc(tl, slot_id, j)) {
 					pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 					return -1;
 				}
 			}
 		}
-		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-	}
 
+		// check for timeouts - in any state
+		if (tl->slots[slot_id].connections[j].tx_time.tv_sec &&
+		    (time_after(tl->slots[slot_id].connections[j].tx_time,
+		     		tl->slots[slot_id].response_timeout))) {
+
+			dvbstats_inc(&en50221_stats, EN50221_STATS_TIMEOUTS);
+			if (tl->slots[slot_id].connections[j].state &
+			    (T_STATE_IN_CREATION |T_STATE_IN_DELETION)) {
+				tl->slots[slot_id].connections[j].state = T_STATE_IDLE;
+			} else if (tl->slots[slot_id].connections[j].state &
+				   (T_STATE_ACTIVE | T_STATE_ACTIVE_DELETEQUEUED)) {
+				tl->error_slot = slot_id;
+				tl->error = EN50221ERR_TIMEOUT;
+				pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
+				return -1;
+			}
+		}
+	}
+	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 	return 0;
 }
 
+// milliseconds until something on the slot needs attention, -1 for never.
+// called with the slot lock held
+static int en50221_tl_slot_timeout(struct en50221_transport_layer *tl,
+				   uint8_t slot_id)
+{
+	struct en50221_slot *slot = &tl->slots[slot_id];
+	int timeout = -1;
+	int j;
+
+	if (slot->ca_hndl == -1)
+		return -1;
+
+	for (j = 0; j < tl->max_connections_per_slot; j++) {
+		struct en50221_connection *connection = &slot->connections[j];
+		int due;
+
+		if (connection->state == T_STATE_IDLE)
+			continue;
+
+		if (connection->tx_time.tv_sec) {
+			// waiting for a response
+			due = time_remaining(connection->tx_time, slot->response_timeout);
+		} else if (connection->send_queue &&
+			   (connection->state & (T_STATE_IN_CREATION | T_STATE_ACTIVE |
+						 T_STATE_ACTIVE_DELETEQUEUED))) {
+			// something to send right away
+			return 0;
+		} else if (connection->state & T_STATE_ACTIVE) {
+			due = time_remaining(connection->last_poll_time, slot->poll_delay);
+		} else {
+			continue;
+		}
+
+		if ((timeout < 0) || (due < timeout))
+			timeout = due;
+	}
+
+	return timeout;
+}
+
 void en50221_tl_register_callback(struct en50221_transport_layer *tl,
 				  en50221_tl_callback callback, void *arg)
 {
@@ -562,34 +884,14 @@ int en50221_tl_send_data(struct en50221_transport_layer *tl,
 		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
 		return -1;
 	}
-	// allocate msg structure
-	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + data_size + 10);
-	if (msg == NULL) {
-		tl->error_slot = slot_id;
-		tl->error = EN50221ERR_OUTOFMEMORY;
-		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-		return -1;
-	}
-	// make up data to send
-	int length_field_len;
-	msg->data[0] = T_DATA_LAST;
-	if ((length_field_len = asn_1_encode(data_size + 1, msg->data + 1, 3)) < 0) {
-		free(msg);
-		tl->error_slot = slot_id;
-		tl->error = EN50221ERR_ASNENCODE;
-		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-		return -1;
-	}
-	msg->data[1 + length_field_len] = connection_id;
-	memcpy(msg->data + 1 + length_field_len + 1, data, data_size);
-	msg->length = 1 + length_field_len + 1 + data_size;
-
 	// queue it for transmission
-	queue_message(tl, slot_id, connection_id, msg);
+	struct iovec iov;
+	iov.iov_base = data;
+	iov.iov_len = data_size;
+	int result = en50221_tl_queue_apdu(tl, slot_id, connection_id, &iov, 1, data_size);
 
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-	return 0;
+	return result;
 }
 
 int en50221_tl_send_datav(struct en50221_transport_layer *tl,
@@ -640,42 +942,12 @@ int en50221_tl_send_datav(struct en50221_transport_layer *tl,
 		data_size += vector[i].iov_len;
 	}
 
-	// allocate msg structure
-	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + data_size + 10);
-	if (msg == NULL) {
-		tl->error_slot = slot_id;
-		tl->error = EN50221ERR_OUTOFMEMORY;
-		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-		return -1;
-	}
-	// make up data to send
-	int length_field_len;
-	msg->data[0] = T_DATA_LAST;
-	if ((length_field_len = asn_1_encode(data_size + 1, msg->data + 1, 3)) < 0) {
-		free(msg);
-		tl->error_slot = slot_id;
-		tl->error = EN50221ERR_ASNENCODE;
-		pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-		return -1;
-	}
-	msg->data[1 + length_field_len] = connection_id;
-	msg->length = 1 + length_field_len + 1 + data_size;
-	msg->next = NULL;
-
-	// merge the iovecs
-	uint32_t pos = 1 + length_field_len + 1;
-	for (i = 0; i < iov_count; i++) {
-		memcpy(msg->data + pos, vector[i].iov_base,
-		       vector[i].iov_len);
-		pos += vector[i].iov_len;
-	}
-
 	// queue it for transmission
-	queue_message(tl, slot_id, connection_id, msg);
+	int result = en50221_tl_queue_apdu(tl, slot_id, connection_id,
+					   vector, iov_count, data_size);
 
 	pthread_mutex_unlock(&tl->slots[slot_id].slot_lock);
-	return 0;
+	return result;
 }
 
 int en50221_tl_new_tc(struct en50221_transport_layer *tl, uint8_t slot_id)
@@ -702,7 +974,7 @@ int en50221_tl_new_tc(struct en50221_transport_layer *tl, uint8_t slot_id)
 	}
 	// allocate msg structure
 	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + 3);
+	    en50221_tl_alloc_message(&tl->slots[slot_id], 3);
 	if (msg == NULL) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
@@ -754,7 +1026,7 @@ int en50221_tl_del_tc(struct en50221_transport_layer *tl, uint8_t slot_id,
 	}
 	// allocate msg structure
 	struct en50221_message *msg =
-	    malloc(sizeof(struct en50221_message) + 3);
+	    en50221_tl_alloc_message(&tl->slots[slot_id], 3);
 	if (msg == NULL) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
@@ -814,17 +1086,21 @@ static int en50221_tl_poll_tc(struct en50221_transport_layer *tl,
 		     tx_time, 0);
 
 	// send command
-	uint8_t hdr[3];
+	uint8_t frame[DVBCA_LINK_HEADER + 3];
+	uint8_t *hdr = frame + DVBCA_LINK_HEADER;
 	hdr[0] = T_DATA_LAST;
 	hdr[1] = 1;
 	hdr[2] = connection_id;
-	if (dvbca_link_write(tl->slots[slot_id].ca_hndl,
-	    		     tl->slots[slot_id].slot,
-			     connection_id, hdr, 3) < 0) {
+	if (dvbca_link_write_frame(tl->slots[slot_id].ca_hndl,
+				   tl->slots[slot_id].slot,
+				   connection_id, frame, 3) < 0) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_CAWRITE;
 		return -1;
 	}
+	dvbstats_inc(&en50221_stats, EN50221_STATS_TPDUS_SENT);
+	dvbstats_inc(&en50221_stats, EN50221_STATS_POLLS);
+	DVBPROBE3(tpdu_send, tl->slots[slot_id].slot, connection_id, 3);
 	return 0;
 }
 
@@ -982,11 +1258,7 @@ static int en50221_tl_handle_delete_tc(struct en50221_transport_layer *tl,
 	    (T_STATE_ACTIVE | T_STATE_IN_DELETION)) {
 		// clear down the slot
 		tl->slots[slot_id].connections[connection_id].state = T_STATE_IDLE;
-		if (tl->slots[slot_id].connections[connection_id].chain_buffer) {
-			free(tl->slots[slot_id].connections[connection_id].chain_buffer);
-		}
-		tl->slots[slot_id].connections[connection_id].chain_buffer = NULL;
-		tl->slots[slot_id].connections[connection_id].buffer_length = 0;
+		en50221_tl_reset_chain(&tl->slots[slot_id].connections[connection_id]);
 
 		// send the reply
 		uint8_t hdr[3];
@@ -1122,21 +1394,12 @@ static int en50221_tl_handle_data_more(struct en50221_transport_layer *tl,
 	// a chained data packet is coming in, save
 	// it to the buffer and wait for more
 	tl->slots[slot_id].connections[connection_id].tx_time.tv_sec = 0;
-	int new_data_length =
-	    tl->slots[slot_id].connections[connection_id].buffer_length + data_length;
-	uint8_t *new_data_buffer =
-	    realloc(tl->slots[slot_id].connections[connection_id].chain_buffer, new_data_length);
-	if (new_data_buffer == NULL) {
+	if (en50221_tl_chain_append(&tl->slots[slot_id].connections[connection_id],
+				    data, data_length)) {
 		tl->error_slot = slot_id;
 		tl->error = EN50221ERR_OUTOFMEMORY;
 		return -1;
 	}
-	tl->slots[slot_id].connections[connection_id].chain_buffer = new_data_buffer;
-
-	memcpy(tl->slots[slot_id].connections[connection_id].chain_buffer +
-	       tl->slots[slot_id].connections[connection_id].buffer_length,
-	       data, data_length);
-	tl->slots[slot_id].connections[connection_id].buffer_length = new_data_length;
 
 	return 0;
 }
@@ -1158,8 +1421,9 @@ static int en50221_tl_handle_data_last(struct en50221_transport_layer *tl,
 		return -1;
 	}
 	// last package of a chain or single package comes in
-	tl->slots[slot_id].connections[connection_id].tx_time.tv_sec = 0;
-	if (tl->slots[slot_id].connections[connection_id].chain_buffer == NULL) {
+	struct en50221_connection *connection = &tl->slots[slot_id].connections[connection_id];
+	connection->tx_time.tv_sec = 0;
+	if (connection->buffer_length == 0) {
 		// single package => dispatch immediately
 		pthread_mutex_lock(&tl->setcallback_lock);
 		en50221_tl_callback cb = tl->callback;
@@ -1173,23 +1437,19 @@ static int en50221_tl_handle_data_last(struct en50221_transport_layer *tl,
 			pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
 		}
 	} else {
-		int new_data_length =
-		    tl->slots[slot_id].connections[connection_id].buffer_length + data_length;
-		uint8_t *new_data_buffer =
-		    realloc(tl->slots[slot_id].connections[connection_id].chain_buffer, new_data_length);
-		if (new_data_buffer == NULL) {
+		if (en50221_tl_chain_append(connection, data, data_length)) {
 			tl->error_slot = slot_id;
 			tl->error = EN50221ERR_OUTOFMEMORY;
 			return -1;
 		}
 
-		memcpy(new_data_buffer +
-		       tl->slots[slot_id].connections[connection_id].
-		       buffer_length, data, data_length);
-
-		// clean the buffer position
-		tl->slots[slot_id].connections[connection_id].chain_buffer = NULL;
-		tl->slots[slot_id].connections[connection_id].buffer_length = 0;
+		// take the buffer off the connection while the slot is unlocked
+		uint8_t *new_data_buffer = connection->chain_buffer;
+		uint32_t new_data_length = connection->buffer_length;
+		uint32_t new_data_size = connection->buffer_size;
+		connection->chain_buffer = NULL;
+		connection->buffer_length = 0;
+		connection->buffer_size = 0;
 
 		// tell the upper layers
 		pthread_mutex_lock(&tl->setcallback_lock);
@@ -1204,7 +1464,13 @@ static int en50221_tl_handle_data_last(struct en50221_transport_layer *tl,
 			pthread_mutex_lock(&tl->slots[slot_id].slot_lock);
 		}
 
-		free(new_data_buffer);
+		// and keep it for the connection's next chain, unless it is huge
+		if ((connection->chain_buffer == NULL) && (new_data_size <= TL_CHAIN_KEEP)) {
+			connection->chain_buffer = new_data_buffer;
+			connection->buffer_size = new_data_size;
+		} else {
+			free(new_data_buffer);
+		}
 	}
 
 	return 0;
@@ -1275,8 +1541,7 @@ static int en50221_tl_alloc_new_tc(struct en50221_transport_layer *tl,
 	}
 	// set up the connection struct
 	tl->slots[slot_id].connections[conid].state = T_STATE_IN_CREATION;
-	tl->slots[slot_id].connections[conid].chain_buffer = NULL;
-	tl->slots[slot_id].connections[conid].buffer_length = 0;
+	en50221_tl_reset_chain(&tl->slots[slot_id].connections[conid]);
 
 	return conid;
 }
@@ -1293,4 +1558,178 @@ static void queue_message(struct en50221_transport_layer *tl,
 		tl->slots[slot_id].connections[connection_id].send_queue = msg;
 		tl->slots[slot_id].connections[connection_id].send_queue_tail = msg;
 	}
+
+	// wake up en50221_tl_poll_slot() if it is waiting on this slot
+	if (tl->slots[slot_id].wake_fd != -1) {
+		uint64_t one = 1;
+		if (write(tl->slots[slot_id].wake_fd, &one, sizeof(one)) < 0) {
+			// the counter is saturated: a wakeup is pending anyway
+		}
+	}
+}
+
+// pack an APDU into TPDUs of at most the slot's link size and queue them:
+// a T_DATA_LAST, or a T_DATA_MORE chain for a large one, which goes out
+// fragment after fragment as the CAM answers. called with the slot lock held
+static int en50221_tl_queue_apdu(struct en50221_transport_layer *tl,
+				 uint8_t slot_id, uint8_t connection_id,
+				 struct iovec *vector, int iov_count,
+				 uint32_t data_size)
+{
+	struct en50221_slot *slot = &tl->slots[slot_id];
+	uint32_t fragment_max = slot->link_size - TL_MSG_HEADER;
+	struct en50221_message *head = NULL;
+	struct en50221_message *tail = NULL;
+	struct en50221_message *msg;
+	int iov_idx = 0;
+	size_t iov_pos = 0;
+
+	do {
+		uint32_t fragment = (data_size > fragment_max) ? fragment_max : data_size;
+		int length_field_len;
+
+		// make up the fragment
+		if ((msg = en50221_tl_alloc_message(slot, fragment + TL_MSG_HEADER)) == NULL) {
+			tl->error = EN50221ERR_OUTOFMEMORY;
+			goto error;
+		}
+		msg->data[0] = (data_size > fragment) ? T_DATA_MORE : T_DATA_LAST;
+		if ((length_field_len = asn_1_encode(fragment + 1, msg->data + 1, 3)) < 0) {
+			en50221_tl_free_message(slot, msg);
+			tl->error = EN50221ERR_ASNENCODE;
+			goto error;
+		}
+		msg->data[1 + length_field_len] = connection_id;
+		msg->length = 1 + length_field_len + 1 + fragment;
+		if (tail)
+			tail->next = msg;
+		else
+			head = msg;
+		tail = msg;
+
+		// merge the iovecs into it
+		uint32_t pos = 1 + length_field_len + 1;
+		while ((pos < msg->length) && (iov_idx < iov_count)) {
+			size_t copy = vector[iov_idx].iov_len - iov_pos;
+			if (copy > msg->length - pos)
+				copy = msg->length - pos;
+			memcpy(msg->data + pos, (uint8_t *) vector[iov_idx].iov_base + iov_pos, copy);
+			pos += copy;
+			iov_pos += copy;
+			if (iov_pos == vector[iov_idx].iov_len) {
+				iov_idx++;
+				iov_pos = 0;
+			}
+		}
+		data_size -= fragment;
+	} while (data_size);
+
+	// only a whole APDU is queued
+	while (head) {
+		msg = head;
+		head = msg->next;
+		queue_message(tl, slot_id, connection_id, msg);
+	}
+	return 0;
+
+error:
+	while (head) {
+		msg = head;
+		head = msg->next;
+		en50221_tl_free_message(slot, msg);
+	}
+	tl->error_slot = slot_id;
+	return -1;
+}
+
+static struct en50221_message *en50221_tl_alloc_message(struct en50221_slot *slot,
+							uint32_t data_size)
+{
+	struct en50221_message **pool = NULL;
+	struct en50221_message *msg;
+	uint32_t size = data_size;
+
+	if (data_size <= TL_MSG_SMALL) {
+		pool = &slot->free_small;
+		size = TL_MSG_SMALL;
+	} else if (data_size <= TL_MSG_LARGE) {
+		pool = &slot->free_large;
+		size = TL_MSG_LARGE;
+	}
+
+	// reuse a chunk, or make one which joins the pool when it is freed
+	if (pool && *pool) {
+		msg = *pool;
+		*pool = msg->next;
+	} else {
+		msg = malloc(sizeof(struct en50221_message) + size);
+		if (msg == NULL)
+			return NULL;
+		msg->size = size;
+	}
+	msg->next = NULL;
+	return msg;
+}
+
+static void en50221_tl_free_message(struct en50221_slot *slot,
+				    struct en50221_message *msg)
+{
+	switch (msg->size) {
+	case TL_MSG_SMALL:
+		msg->next = slot->free_small;
+		slot->free_small = msg;
+		break;
+
+	case TL_MSG_LARGE:
+		msg->next = slot->free_large;
+		slot->free_large = msg;
+		break;
+
+	default:
+		free(msg);
+		break;
+	}
+}
+
+static void en50221_tl_free_pools(struct en50221_slot *slot)
+{
+	struct en50221_message *msg;
+
+	while ((msg = slot->free_small) != NULL) {
+		slot->free_small = msg->next;
+		free(msg);
+	}
+	while ((msg = slot->free_large) != NULL) {
+		slot->free_large = msg->next;
+		free(msg);
+	}
+}
+
+static int en50221_tl_chain_append(struct en50221_connection *connection,
+				   uint8_t *data, uint32_t data_length)
+{
+	uint32_t new_data_length = connection->buffer_length + data_length;
+
+	// grow by doubling, so a long chain isn't reallocated for every TPDU
+	if (new_data_length > connection->buffer_size) {
+		uint32_t new_size = connection->buffer_size ? connection->buffer_size : TL_MSG_LARGE;
+		while (new_size < new_data_length)
+			new_size *= 2;
+
+		uint8_t *new_data_buffer = realloc(connection->chain_buffer, new_size);
+		if (new_data_buffer == NULL)
+			return -1;
+		connection->chain_buffer = new_data_buffer;
+		connection->buffer_size = new_size;
+	}
+
+	memcpy(connection->chain_buffer + connection->buffer_length, data, data_length);
+	connection->buffer_length = new_data_length;
+	return 0;
+}
+
+static void en50221_tl_reset_chain(struct en50221_connection *connection)
+{
+	// a partial chain is dropped, but its buffer is kept for the next one
+	connection->buffer_length = 0;
 }
@@ -131,6 +131,38 @@ extern void en50221_tl_destroy_slot(struct en50221_transport_layer *tl, uint8_t
  */
 extern int en50221_tl_poll(struct en50221_transport_layer *tl);
 
+/**
+ * Performs one iteration of the transport layer poll for a single slot.
+ * It sleeps until the slot has data, a message is queued on it, or one of
+ * its connections is due a poll or times out, but for no longer than timeout.
+ *
+ * Slots are independent of each other: an application may poll each slot
+ * from a thread of its own, so a slow CAM does not hold up the others.
+ * Do not mix this with en50221_tl_poll() on the same transport layer.
+ *
+ * @param tl The en50221_transport_layer instance.
+ * @param slot_id ID of the slot.
+ * @param timeout Maximum time to wait in ms, or -1 to wait for the slot.
+ * @return 0 on succes, or -1 if there was an error of some sort.
+ */
+extern int en50221_tl_poll_slot(struct en50221_transport_layer *tl, uint8_t slot_id, int timeout);
+
+/**
+ * Find out what to wait for before calling en50221_tl_poll_slot() with a
+ * timeout of 0, for applications which wait on the slot in an event loop of
+ * their own: input on the slot's CA device, input on wake_fd, or the
+ * returned timeout expiring.
+ *
+ * @param tl The en50221_transport_layer instance.
+ * @param slot_id ID of the slot.
+ * @param wake_fd Set to an fd which becomes readable when a message is queued
+ * on the slot, or -1 if there is none.
+ * @return Maximum time to wait in ms, -1 to wait for input only, or -2 if
+ * the slot is not in use.
+ */
+extern int en50221_tl_get_slot_wait(struct en50221_transport_layer *tl, uint8_t slot_id,
+				    int *wake_fd);
+
 /**
  * Register the callback for data reception.
  *
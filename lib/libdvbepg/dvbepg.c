@@ -0,0 +1,1444 @@
+/*
+ * dvbepg - in-memory EPG store
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <libucsi/dvb/descriptor.h>
+#include <libucsi/dvb/text.h>
+#include <libucsi/atsc/types.h>
+
+#include "dvbepg.h"
+#include "dvbepg_dict.h"
+#include "dvbepg_int.h"
+
+#define SNAPSHOT_MAGIC "DVBEPGSN"
+#define SNAPSHOT_VERSION 3		/* 1 had no dictionary, 2 no change serials */
+#define SNAPSHOT_NO_STRING 0xffffffff
+
+/*
+ * Snapshot file layout, all in host byte order (a snapshot is a cache,
+ * never shared between machines):
+ *
+ *   struct snapshot_header
+ *   dictionary[dictionary_count]		uint8_t length, then the bytes
+ *   strings[string_count]			uint32_t length, then the bytes
+ *						 (encoded with the dictionary)
+ *   services[service_count], each:
+ *     struct snapshot_service
+ *     struct snapshot_section sections[section_count]
+ *     struct snapshot_event events[event_count]	in start time order
+ */
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t string_count;
+	uint32_t service_count;
+	uint32_t dictionary_count;
+	uint32_t change_serial;
+};
+
+struct snapshot_service {
+	uint8_t source;
+	uint8_t reserved;
+	uint16_t network_id;
+	uint16_t transport_stream_id;
+	uint16_t service_id;
+	uint32_t section_count;
+	uint32_t event_count;
+};
+
+struct snapshot_section {
+	uint16_t key;
+	uint8_t version;
+	uint8_t reserved;
+};
+
+struct snapshot_event {
+	int64_t start_time;
+	uint32_t duration;
+	uint32_t title;
+	uint32_t text;
+	uint16_t event_id;
+	uint16_t origin;
+	char language[4];
+	uint8_t ett_version;
+	uint8_t reserved[3];
+	uint32_t changed;
+};
+
+static void epg_release(struct dvbepg *epg, const char *str);
+static void epg_free_service(struct dvbepg *epg, struct epg_service *svc);
+static int epg_grow_strings(struct dvbepg *epg);
+static int epg_grow_services(struct dvbepg *epg);
+
+struct dvbepg *dvbepg_create(void)
+{
+	struct dvbepg *epg;
+
+	if ((epg = calloc(1, sizeof(struct dvbepg))) == NULL)
+		return NULL;
+
+	if (((epg->decoder = dvb_text_decoder_create(NULL)) == NULL) ||
+	    epg_grow_services(epg) || epg_grow_strings(epg)) {
+		dvbepg_destroy(epg);
+		return NULL;
+	}
+
+	return epg;
+}
+
+void dvbepg_destroy(struct dvbepg *epg)
+{
+	uint32_t i;
+
+	for (i = 0; i < epg->service_buckets; i++) {
+		while (epg->services[i]) {
+			struct epg_service *svc = epg->services[i];
+
+			epg->services[i] = svc->next;
+			epg_free_service(epg, svc);
+		}
+	}
+	free(epg->services);
+	free(epg->strings);
+	dvbepg_dict_destroy(epg->dict);
+	free(epg->code);
+	free(epg->view_text[0]);
+	free(epg->view_text[1]);
+	free(epg->text);
+	if (epg->decoder)
+		dvb_text_decoder_destroy(epg->decoder);
+	free(epg);
+}
+
+
+
+
+/********************************** strings ***********************************/
+
+static uint32_t epg_hash_string(const char *str, size_t len)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uint8_t) str[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static int epg_grow_strings(struct dvbepg *epg)
+{
+	uint32_t buckets = epg->string_buckets ? epg->string_buckets * 2 : 1024;
+	struct epg_string **strings;
+	uint32_t i;
+
+	if ((strings = calloc(buckets, sizeof(struct epg_string *))) == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < epg->string_buckets; i++) {
+		while (epg->strings[i]) {
+			struct epg_string *s = epg->strings[i];
+
+			epg->strings[i] = s->next;
+			s->next = strings[s->hash & (buckets - 1)];
+			strings[s->hash & (buckets - 1)] = s;
+		}
+	}
+	free(epg->strings);
+	epg->strings = strings;
+	epg->string_buckets = buckets;
+	return 0;
+}
+
+/*
+ * Get a reference to the interned copy of a string, as it is stored (encoded
+ * if there is a dictionary); an empty one is NULL.
+ */
+static int epg_intern_code(struct dvbepg *epg, const char *str, size_t len, const char **out)
+{
+	uint32_t hash;
+	struct epg_string *s;
+
+	*out = NULL;
+	while (len && (str[len - 1] == '\0'))
+		len--;
+	if (len == 0)
+		return 0;
+
+	hash = epg_hash_string(str, len);
+	for (s = epg->strings[hash & (epg->string_buckets - 1)]; s; s = s->next) {
+		if ((s->hash == hash) && !strncmp(s->str, str, len) && (s->str[len] == '\0')) {
+			s->refs++;
+			*out = s->str;
+			return 0;
+		}
+	}
+
+	if ((epg->string_count >= epg->string_buckets * 2) && epg_grow_strings(epg))
+		return -ENOMEM;
+	if ((s = malloc(sizeof(struct epg_string) + len + 1)) == NULL)
+		return -ENOMEM;
+	s->hash = hash;
+	s->refs = 1;
+	memcpy(s->str, str, len);
+	s->str[len] = '\0';
+	s->next = epg->strings[hash & (epg->string_buckets - 1)];
+	epg->strings[hash & (epg->string_buckets - 1)] = s;
+	epg->string_count++;
+
+	*out = s->str;
+	return 0;
+}
+
+/* as epg_intern_code(), for a string as it came */
+static int epg_intern(struct dvbepg *epg, const char *str, size_t len, const char **out)
+{
+	if (epg->dict == NULL)
+		return epg_intern_code(epg, str, len, out);
+
+	while (len && (str[len - 1] == '\0'))
+		len--;
+	if ((len * 2) + 1 > epg->code_size) {
+		char *code = realloc(epg->code, (len * 2) + 1);
+
+		if (code == NULL)
+			return -ENOMEM;
+		epg->code = code;
+		epg->code_size = (len * 2) + 1;
+	}
+	len = dvbepg_dict_encode(epg->dict, str, len, epg->code);
+	return epg_intern_code(epg, epg->code, len, out);
+}
+
+static void epg_release(struct dvbepg *epg, const char *str)
+{
+	struct epg_string *s;
+	struct epg_string **prev;
+
+	if (str == NULL)
+		return;
+	s = epg_string_of(str);
+	if (--s->refs)
+		return;
+
+	for (prev = &epg->strings[s->hash & (epg->string_buckets - 1)]; *prev; prev = &(*prev)->next) {
+		if (*prev == s) {
+			*prev = s->next;
+			break;
+		}
+	}
+	epg->string_count--;
+	free(s);
+}
+
+/* decode a stored string into one of the view buffers */
+static int epg_view_string(struct dvbepg *epg, int which, const char *code, const char **out)
+{
+	size_t len;
+
+	*out = NULL;
+	if (code == NULL)
+		return 0;
+
+	len = dvbepg_dict_decode(epg->dict, code, epg->view_text[which], epg->view_size[which]);
+	if (len >= epg->view_size[which]) {
+		char *text = realloc(epg->view_text[which], len + 1);
+
+		if (text == NULL)
+			return -ENOMEM;
+		epg->view_text[which] = text;
+		epg->view_size[which] = len + 1;
+		dvbepg_dict_decode(epg->dict, code, text, len + 1);
+	}
+	*out = epg->view_text[which];
+	return 0;
+}
+
+/* an event as it is handed out: with a dictionary, a copy with its strings decoded */
+static const struct dvbepg_event *epg_view(struct dvbepg *epg, struct epg_event *ev)
+{
+	if (epg->dict == NULL)
+		return &ev->pub;
+
+	epg->view = ev->pub;
+	if (epg_view_string(epg, 0, ev->pub.title, &epg->view.title) ||
+	    epg_view_string(epg, 1, ev->pub.text, &epg->view.text))
+		return NULL;
+	return &epg->view;
+}
+
+static int epg_text_reserve(struct dvbepg *epg, size_t size)
+{
+	uint8_t *text;
+
+	if (size <= epg->text_size)
+		return 0;
+	if ((text = realloc(epg->text, size)) == NULL)
+		return -ENOMEM;
+	epg->text = text;
+	epg->text_size = size;
+	return 0;
+}
+
+/* convert DVB text to UTF-8 in the scratch buffer, returning its length */
+static int epg_dvb_text(struct dvbepg *epg, uint8_t *buf, int len)
+{
+	// UTF-8 needs at most 3 bytes for every byte of DVB text
+	if (epg_text_reserve(epg, (len * 3) + 1))
+		return -ENOMEM;
+
+	return dvb_text_decode(epg->decoder, buf, len, (char *) epg->text, epg->text_size);
+}
+
+/* decode the first string of an ATSC multiple string structure */
+static int epg_atsc_text(struct dvbepg *epg, struct atsc_text *text)
+{
+	struct atsc_text_string *str;
+	struct atsc_text_string_segment *seg;
+	int i;
+	int j;
+	size_t pos = 0;
+
+	if (text == NULL)
+		return 0;
+
+	atsc_text_strings_for_each(text, str, i) {
+		atsc_text_string_segments_for_each(str, seg, j) {
+			if (atsc_text_segment_decode(seg, &epg->text, &epg->text_size, &pos) < 0)
+				return -ENOMEM;
+		}
+		break;
+	}
+
+	return pos;
+}
+
+
+
+
+/********************************** services **********************************/
+
+static uint64_t epg_service_key(const struct dvbepg_service_id *id)
+{
+	return ((uint64_t) id->source << 48) | ((uint64_t) id->network_id << 32) |
+		((uint64_t) id->transport_stream_id << 16) | id->service_id;
+}
+
+static uint32_t epg_service_bucket(uint64_t key, uint32_t buckets)
+{
+	return (uint32_t) ((key * 0x9e3779b97f4a7c15ULL) >> 32) & (buckets - 1);
+}
+
+static int epg_grow_services(struct dvbepg *epg)
+{
+	uint32_t buckets = epg->service_buckets ? epg->service_buckets * 2 : 64;
+	struct epg_service **services;
+	uint32_t i;
+
+	if ((services = calloc(buckets, sizeof(struct epg_service *))) == NULL)
+		return -ENOMEM;
+
+	for (i = 0; i < epg->service_buckets; i++) {
+		while (epg->services[i]) {
+			struct epg_service *svc = epg->services[i];
+			uint32_t bucket = epg_service_bucket(svc->key, buckets);
+
+			epg->services[i] = svc->next;
+			svc->next = services[bucket];
+			services[bucket] = svc;
+		}
+	}
+	free(epg->services);
+	epg->services = services;
+	epg->service_buckets = buckets;
+	return 0;
+}
+
+static struct epg_service *epg_get_service(struct dvbepg *epg,
+					   const struct dvbepg_service_id *id, int create)
+{
+	uint64_t key = epg_service_key(id);
+	struct epg_service *svc;
+	uint32_t bucket;
+
+	for (svc = epg->services[epg_service_bucket(key, epg->service_buckets)]; svc; svc = svc->next) {
+		if (svc->key == key)
+			return svc;
+	}
+	if (!create)
+		return NULL;
+
+	if ((epg->service_count >= epg->service_buckets) && epg_grow_services(epg))
+		return NULL;
+	if ((svc = calloc(1, sizeof(struct epg_service))) == NULL)
+		return NULL;
+	svc->id = *id;
+	svc->key = key;
+	bucket = epg_service_bucket(key, epg->service_buckets);
+	svc->next = epg->services[bucket];
+	epg->services[bucket] = svc;
+	epg->service_count++;
+
+	return svc;
+}
+
+static void epg_free_event(struct dvbepg *epg, struct epg_event *ev)
+{
+	epg_release(epg, ev->pub.title);
+	epg_release(epg, ev->pub.text);
+	free(ev);
+}
+
+static void epg_free_service(struct dvbepg *epg, struct epg_service *svc)
+{
+	uint32_t i;
+
+	for (i = 0; i < svc->event_count; i++)
+		epg_free_event(epg, svc->events[i]);
+	free(svc->events);
+	free(svc->sections);
+	free(svc);
+}
+
+/* index of the section, or of where it would go */
+static uint32_t epg_section_pos(struct epg_service *svc, uint16_t key)
+{
+	uint32_t lo = 0;
+	uint32_t hi = svc->section_count;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+
+		if (svc->sections[mid].key < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int epg_section_applied(struct epg_service *svc, uint16_t key, uint8_t version)
+{
+	uint32_t pos = epg_section_pos(svc, key);
+
+	return (pos < svc->section_count) && (svc->sections[pos].key == key) &&
+		(svc->sections[pos].version == version);
+}
+
+static int epg_set_section(struct epg_service *svc, uint16_t key, uint8_t version)
+{
+	uint32_t pos = epg_section_pos(svc, key);
+
+	if ((pos < svc->section_count) && (svc->sections[pos].key == key)) {
+		svc->sections[pos].version = version;
+		return 0;
+	}
+
+	if (svc->section_count == svc->section_alloc) {
+		uint32_t alloc = svc->section_alloc ? svc->section_alloc * 2 : 16;
+		struct epg_section *sections = realloc(svc->sections, alloc * sizeof(struct epg_section));
+
+		if (sections == NULL)
+			return -ENOMEM;
+		svc->sections = sections;
+		svc->section_alloc = alloc;
+	}
+	memmove(&svc->sections[pos + 1], &svc->sections[pos],
+		(svc->section_count - pos) * sizeof(struct epg_section));
+	svc->sections[pos].key = key;
+	svc->sections[pos].version = version;
+	svc->section_count++;
+	return 0;
+}
+
+
+
+
+/*********************************** events ***********************************/
+
+/* index of the first event at or after (start_time, event_id) */
+static uint32_t epg_event_pos(struct epg_service *svc, time_t start_time, uint16_t event_id)
+{
+	uint32_t lo = 0;
+	uint32_t hi = svc->event_count;
+
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		struct dvbepg_event *ev = &svc->events[mid]->pub;
+
+		if ((ev->start_time < start_time) ||
+		    ((ev->start_time == start_time) && (ev->event_id < event_id)))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static int epg_link_event(struct epg_service *svc, struct epg_event *ev)
+{
+	uint32_t pos;
+
+	if (svc->event_count == svc->event_alloc) {
+		uint32_t alloc = svc->event_alloc ? svc->event_alloc * 2 : 64;
+		struct epg_event **events = realloc(svc->events, alloc * sizeof(struct epg_event *));
+
+		if (events == NULL)
+			return -ENOMEM;
+		svc->events = events;
+		svc->event_alloc = alloc;
+	}
+
+	pos = epg_event_pos(svc, ev->pub.start_time, ev->pub.event_id);
+	memmove(&svc->events[pos + 1], &svc->events[pos],
+		(svc->event_count - pos) * sizeof(struct epg_event *));
+	svc->events[pos] = ev;
+	svc->event_count++;
+
+	if (ev->pub.duration > svc->max_duration)
+		svc->max_duration = ev->pub.duration;
+	return 0;
+}
+
+static void epg_unlink_event(struct epg_service *svc, struct epg_event *ev)
+{
+	uint32_t pos = epg_event_pos(svc, ev->pub.start_time, ev->pub.event_id);
+
+	memmove(&svc->events[pos], &svc->events[pos + 1],
+		(svc->event_count - pos - 1) * sizeof(struct epg_event *));
+	svc->event_count--;
+}
+
+static struct epg_event *epg_find_event(struct epg_service *svc, uint16_t event_id)
+{
+	struct epg_event *ev;
+
+	for (ev = svc->id_hash[event_id % EPG_ID_BUCKETS]; ev; ev = ev->id_next) {
+		if (ev->pub.event_id == event_id)
+			return ev;
+	}
+	return NULL;
+}
+
+static void epg_remove_event(struct dvbepg *epg, struct epg_service *svc, struct epg_event *ev)
+{
+	struct epg_event **prev;
+
+	for (prev = &svc->id_hash[ev->pub.event_id % EPG_ID_BUCKETS]; *prev; prev = &(*prev)->id_next) {
+		if (*prev == ev) {
+			*prev = ev->id_next;
+			break;
+		}
+	}
+	epg_free_event(epg, ev);
+}
+
+/*
+ * Add or update an event listed in a section. Title and text are in UTF-8;
+ * text is left untouched if set_text is 0.
+ */
+static int epg_update_event(struct dvbepg *epg, struct epg_service *svc, uint16_t origin,
+			    uint16_t event_id, time_t start_time, uint32_t duration,
+			    const char *language,
+			    const char *title, size_t title_len,
+			    int set_text, const char *text, size_t text_len)
+{
+	struct epg_event *ev = epg_find_event(svc, event_id);
+	const char *new_title;
+	const char *new_text = NULL;
+	char new_language[4] = { 0 };
+	int changed = 1;
+
+	if (epg_intern(epg, title, title_len, &new_title))
+		return -ENOMEM;
+	if (set_text && epg_intern(epg, text, text_len, &new_text)) {
+		epg_release(epg, new_title);
+		return -ENOMEM;
+	}
+
+	if (ev == NULL) {
+		if ((ev = calloc(1, sizeof(struct epg_event))) == NULL)
+			goto nomem;
+		ev->pub.event_id = event_id;
+		ev->pub.start_time = start_time;
+		ev->pub.duration = duration;
+		ev->ett_version = EPG_NO_ETT;
+		if (epg_link_event(svc, ev)) {
+			free(ev);
+			goto nomem;
+		}
+		ev->id_next = svc->id_hash[event_id % EPG_ID_BUCKETS];
+		svc->id_hash[event_id % EPG_ID_BUCKETS] = ev;
+	} else if (ev->pub.start_time != start_time) {
+		// moved: re-sort it
+		epg_unlink_event(svc, ev);
+		ev->pub.start_time = start_time;
+		ev->pub.duration = duration;
+		if (epg_link_event(svc, ev)) {
+			epg_remove_event(epg, svc, ev);
+			goto nomem;
+		}
+	} else {
+		// strings are interned, so the same string is the same pointer
+		changed = (ev->pub.duration != duration) || (ev->pub.title != new_title) ||
+			(set_text && (ev->pub.text != new_text));
+		ev->pub.duration = duration;
+		if (duration > svc->max_duration)
+			svc->max_duration = duration;
+	}
+
+	if (language)
+		memcpy(new_language, language, 3);
+	if (memcmp(ev->pub.language, new_language, sizeof(new_language)))
+		changed = 1;
+	memcpy(ev->pub.language, new_language, sizeof(new_language));
+	if (changed)
+		ev->changed = ++epg->changes;
+	epg_release(epg, ev->pub.title);
+	ev->pub.title = new_title;
+	if (set_text) {
+		epg_release(epg, ev->pub.text);
+		ev->pub.text = new_text;
+	}
+	ev->origin = origin;
+	ev->generation = epg->generation;
+	return 0;
+
+nomem:
+	epg_release(epg, new_title);
+	epg_release(epg, new_text);
+	return -ENOMEM;
+}
+
+/* drop the events a section listed before, but does not any more */
+static void epg_sweep_section(struct dvbepg *epg, struct epg_service *svc, uint16_t origin)
+{
+	uint32_t i;
+	uint32_t j = 0;
+
+	for (i = 0; i < svc->event_count; i++) {
+		struct epg_event *ev = svc->events[i];
+
+		if ((ev->origin == origin) && (ev->generation != epg->generation))
+			epg_remove_event(epg, svc, ev);
+		else
+			svc->events[j++] = ev;
+	}
+	svc->event_count = j;
+}
+
+
+
+
+/********************************** sections **********************************/
+
+static int epg_dvb_event(struct dvbepg *epg, struct epg_service *svc, uint16_t origin,
+			 struct dvb_eit_event *e)
+{
+	struct descriptor *d;
+	struct dvb_short_event_descriptor *sed = NULL;
+	struct dvb_short_event_descriptor_part2 *part2;
+	uint8_t *title = NULL;
+	int title_len = 0;
+	uint8_t *text;
+	int text_len;
+	int ret;
+
+	dvb_eit_event_descriptors_for_each(e, d) {
+		if (d->tag == dtag_dvb_short_event) {
+			sed = dvb_short_event_descriptor_codec(d);
+			if (sed)
+				break;
+		}
+	}
+
+	if (sed == NULL)
+		return epg_update_event(epg, svc, origin, e->event_id,
+					dvbdate_to_unixtime_fast(e->start_time),
+					dvbduration_to_seconds_fast(e->duration),
+					NULL, NULL, 0, 1, NULL, 0);
+
+	// the title is converted and interned before the text reuses the scratch buffer
+	if ((ret = epg_dvb_text(epg, dvb_short_event_descriptor_event_name(sed),
+				sed->event_name_length)) < 0)
+		return ret;
+	title_len = ret;
+	if ((title = malloc(title_len + 1)) == NULL)
+		return -ENOMEM;
+	memcpy(title, epg->text, title_len);
+
+	part2 = dvb_short_event_descriptor_part2(sed);
+	text = dvb_short_event_descriptor_text(part2);
+	if ((text_len = epg_dvb_text(epg, text, part2->text_length)) < 0) {
+		free(title);
+		return text_len;
+	}
+
+	ret = epg_update_event(epg, svc, origin, e->event_id,
+			       dvbdate_to_unixtime_fast(e->start_time),
+			       dvbduration_to_seconds_fast(e->duration),
+			       (const char *) sed->language_code,
+			       (const char *) title, title_len,
+			       1, (const char *) epg->text, text_len);
+	free(title);
+	return ret;
+}
+
+int dvbepg_add_dvb_eit(struct dvbepg *epg, struct dvb_eit_section *eit)
+{
+	struct dvbepg_service_id id;
+	struct epg_service *svc;
+	struct dvb_eit_event *e;
+	uint16_t origin;
+	int ret;
+
+	if (!eit->head.current_next_indicator)
+		return 0;
+
+	id.source = DVBEPG_SOURCE_DVB;
+	id.network_id = eit->original_network_id;
+	id.transport_stream_id = eit->transport_stream_id;
+	id.service_id = dvb_eit_section_service_id(eit);
+	if ((svc = epg_get_service(epg, &id, 1)) == NULL)
+		return -ENOMEM;
+
+	origin = (eit->head.table_id << 8) | eit->head.section_number;
+	if (epg_section_applied(svc, origin, eit->head.version_number))
+		return 0;
+
+	epg->generation++;
+	dvb_eit_section_events_for_each(eit, e) {
+		if ((ret = epg_dvb_event(epg, svc, origin, e)) < 0)
+			return ret;
+	}
+	epg_sweep_section(epg, svc, origin);
+
+	// only once it is all in, so a failed section is tried again
+	if (epg_set_section(svc, origin, eit->head.version_number))
+		return -ENOMEM;
+	return 1;
+}
+
+int dvbepg_add_atsc_eit(struct dvbepg *epg, uint16_t transport_stream_id,
+			int eit_index, struct atsc_eit_section *eit)
+{
+	struct dvbepg_service_id id;
+	struct epg_service *svc;
+	struct atsc_eit_event *e;
+	uint16_t origin;
+	int idx;
+	int ret;
+
+	if (!eit->head.ext_head.current_next_indicator)
+		return 0;
+
+	id.source = DVBEPG_SOURCE_ATSC;
+	id.network_id = 0;
+	id.transport_stream_id = transport_stream_id;
+	id.service_id = atsc_eit_section_source_id(eit);
+	if ((svc = epg_get_service(epg, &id, 1)) == NULL)
+		return -ENOMEM;
+
+	origin = ((eit_index & 0x7f) << 8) | eit->head.ext_head.section_number;
+	if (epg_section_applied(svc, origin, eit->head.ext_head.version_number))
+		return 0;
+
+	epg->generation++;
+	atsc_eit_section_events_for_each(eit, e, idx) {
+		// the text comes from the ETT, so it is not touched here
+		if ((ret = epg_atsc_text(epg, atsc_eit_event_name_title_text(e))) < 0)
+			return ret;
+		if (epg_update_event(epg, svc, origin, e->event_id,
+				     atsctime_to_unixtime(e->start_time), e->length_in_seconds,
+				     NULL, (const char *) epg->text, ret, 0, NULL, 0))
+			return -ENOMEM;
+	}
+	epg_sweep_section(epg, svc, origin);
+
+	if (epg_set_section(svc, origin, eit->head.ext_head.version_number))
+		return -ENOMEM;
+	return 1;
+}
+
+int dvbepg_add_atsc_ett(struct dvbepg *epg, uint16_t transport_stream_id,
+			struct atsc_ett_section *ett)
+{
+	struct dvbepg_service_id id;
+	struct epg_service *svc;
+	struct epg_event *ev;
+	const char *text;
+	int ret;
+
+	// only event ETMs: channel ETMs have no event to attach to
+	if (!ett->head.ext_head.current_next_indicator || (ett->ETM_type != 0x2))
+		return 0;
+
+	id.source = DVBEPG_SOURCE_ATSC;
+	id.network_id = 0;
+	id.transport_stream_id = transport_stream_id;
+	id.service_id = ett->ETM_source_id;
+	if ((svc = epg_get_service(epg, &id, 0)) == NULL)
+		return 0;
+	if ((ev = epg_find_event(svc, ett->ETM_sub_id)) == NULL)
+		return 0;
+	if (ev->ett_version == ett->head.ext_head.version_number)
+		return 0;
+
+	if (atsc_ett_section_extended_text_message_length(ett) <= 0)
+		ret = 0;
+	else if ((ret = epg_atsc_text(epg, atsc_ett_section_extended_text_message(ett))) < 0)
+		return ret;
+	if (epg_intern(epg, (const char *) epg->text, ret, &text))
+		return -ENOMEM;
+
+	if (text != ev->pub.text)
+		ev->changed = ++epg->changes;
+	epg_release(epg, ev->pub.text);
+	ev->pub.text = text;
+	ev->ett_version = ett->head.ext_head.version_number;
+	return 1;
+}
+
+int dvbepg_expire(struct dvbepg *epg, time_t before)
+{
+	uint32_t bucket;
+	int count = 0;
+
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		struct epg_service *svc;
+
+		for (svc = epg->services[bucket]; svc; svc = svc->next) {
+			uint32_t i;
+			uint32_t j = 0;
+
+			for (i = 0; i < svc->event_count; i++) {
+				struct epg_event *ev = svc->events[i];
+
+				if ((ev->pub.start_time + (time_t) ev->pub.duration) <= before) {
+					epg_remove_event(epg, svc, ev);
+					count++;
+				} else {
+					svc->events[j++] = ev;
+				}
+			}
+			svc->event_count = j;
+		}
+	}
+
+	return count;
+}
+
+
+
+
+/********************************** queries ***********************************/
+
+int dvbepg_for_each_service(struct dvbepg *epg, dvbepg_service_callback callback,
+			    void *private_data)
+{
+	uint32_t bucket;
+	struct epg_service *svc;
+	int ret;
+
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		for (svc = epg->services[bucket]; svc; svc = svc->next) {
+			if ((ret = callback(private_data, &svc->id)) > 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+const struct dvbepg_event *dvbepg_find_event(struct dvbepg *epg,
+					     const struct dvbepg_service_id *service,
+					     uint16_t event_id)
+{
+	struct epg_service *svc;
+	struct epg_event *ev;
+
+	if ((svc = epg_get_service(epg, service, 0)) == NULL)
+		return NULL;
+	if ((ev = epg_find_event(svc, event_id)) == NULL)
+		return NULL;
+	return epg_view(epg, ev);
+}
+
+const struct dvbepg_event *dvbepg_find_event_at(struct dvbepg *epg,
+						const struct dvbepg_service_id *service,
+						time_t when)
+{
+	struct epg_service *svc;
+	uint32_t pos;
+
+	if ((svc = epg_get_service(epg, service, 0)) == NULL)
+		return NULL;
+
+	// walk back from the last event starting at or before when, as far
+	// as the longest event could reach
+	pos = epg_event_pos(svc, when + 1, 0);
+	while (pos > 0) {
+		struct epg_event *ev = svc->events[--pos];
+
+		if ((ev->pub.start_time + (time_t) svc->max_duration) <= when)
+			break;
+		if ((ev->pub.start_time + (time_t) ev->pub.duration) > when)
+			return epg_view(epg, ev);
+	}
+
+	return NULL;
+}
+
+int dvbepg_for_each_event(struct dvbepg *epg, const struct dvbepg_service_id *service,
+			  time_t from, time_t to,
+			  dvbepg_event_callback callback, void *private_data)
+{
+	struct epg_service *svc;
+	uint32_t pos;
+	int ret;
+
+	if ((svc = epg_get_service(epg, service, 0)) == NULL)
+		return 0;
+
+	for (pos = epg_event_pos(svc, from - (time_t) svc->max_duration, 0);
+	     (pos < svc->event_count) && (svc->events[pos]->pub.start_time < to); pos++) {
+		struct dvbepg_event *ev = &svc->events[pos]->pub;
+		const struct dvbepg_event *view;
+
+		if (((ev->start_time + (time_t) ev->duration) <= from) && (ev->start_time < from))
+			continue;
+		if ((view = epg_view(epg, svc->events[pos])) == NULL)
+			return -ENOMEM;
+		if ((ret = callback(private_data, view)) > 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+uint32_t dvbepg_change_serial(struct dvbepg *epg)
+{
+	return epg->changes;
+}
+
+void dvbepg_stats(struct dvbepg *epg, struct dvbepg_stats *stats)
+{
+	uint32_t bucket;
+	struct epg_service *svc;
+	struct epg_string *s;
+
+	memset(stats, 0, sizeof(struct dvbepg_stats));
+	stats->services = epg->service_count;
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		for (svc = epg->services[bucket]; svc; svc = svc->next)
+			stats->events += svc->event_count;
+	}
+
+	stats->strings = epg->string_count;
+	for (bucket = 0; bucket < epg->string_buckets; bucket++) {
+		for (s = epg->strings[bucket]; s; s = s->next) {
+			size_t len = strlen(s->str);
+
+			stats->stored_size += sizeof(struct epg_string) + len + 1;
+			stats->text_size += epg->dict ?
+				dvbepg_dict_decode(epg->dict, s->str, NULL, 0) : len;
+		}
+	}
+	if (epg->dict) {
+		stats->dictionary_entries = dvbepg_dict_count(epg->dict);
+		stats->stored_size += dvbepg_dict_size(epg->dict);
+	}
+}
+
+
+
+
+/********************************* dictionary *********************************/
+
+/* a stored string made again with another dictionary (or none) */
+static struct epg_string *epg_recode(struct dvbepg *epg, struct dvbepg_dict *dict,
+				     struct epg_string *old)
+{
+	struct epg_string *s;
+	char *plain = old->str;
+	size_t len = strlen(old->str);
+
+	if (epg->dict) {
+		len = dvbepg_dict_decode(epg->dict, old->str, NULL, 0);
+		if ((plain = malloc(len + 1)) == NULL)
+			return NULL;
+		dvbepg_dict_decode(epg->dict, old->str, plain, len + 1);
+	}
+
+	if ((s = malloc(sizeof(struct epg_string) + (dict ? (len * 2) : len) + 1)) != NULL) {
+		if (dict) {
+			len = dvbepg_dict_encode(dict, plain, len, s->str);
+		} else {
+			memcpy(s->str, plain, len);
+			s->str[len] = '\0';
+		}
+		s->hash = epg_hash_string(s->str, len);
+		s->refs = old->refs;
+		s->index = 0;
+	}
+
+	if (plain != old->str)
+		free(plain);
+	return s;
+}
+
+static const char *epg_recoded(const char *str)
+{
+	if (str == NULL)
+		return NULL;
+	return epg_string_of(str)->next->str;
+}
+
+int dvbepg_compress(struct dvbepg *epg, uint32_t max_entries)
+{
+	struct epg_string **old = NULL;
+	struct epg_string **new = NULL;
+	const char **plain = NULL;
+	struct dvbepg_dict *dict = NULL;
+	struct epg_service *svc;
+	uint32_t count = 0;
+	uint32_t bucket;
+	uint32_t i;
+	int copied = (epg->dict != NULL);
+	int err = -ENOMEM;
+
+	if (((old = malloc((epg->string_count + 1) * sizeof(struct epg_string *))) == NULL) ||
+	    ((new = calloc(epg->string_count + 1, sizeof(struct epg_string *))) == NULL) ||
+	    ((plain = calloc(epg->string_count + 1, sizeof(char *))) == NULL))
+		goto out;
+	for (bucket = 0; bucket < epg->string_buckets; bucket++) {
+		struct epg_string *s;
+
+		for (s = epg->strings[bucket]; s; s = s->next)
+			old[count++] = s;
+	}
+
+	// train on the strings as they came
+	if (max_entries) {
+		for (i = 0; i < count; i++) {
+			if (!copied) {
+				plain[i] = old[i]->str;
+			} else {
+				size_t len = dvbepg_dict_decode(epg->dict, old[i]->str, NULL, 0);
+				char *text;
+
+				if ((text = malloc(len + 1)) == NULL)
+					goto out;
+				dvbepg_dict_decode(epg->dict, old[i]->str, text, len + 1);
+				plain[i] = text;
+			}
+		}
+		if ((dict = dvbepg_dict_train(plain, count, max_entries)) == NULL)
+			goto out;
+		if (dvbepg_dict_count(dict) == 0) {
+			dvbepg_dict_destroy(dict);
+			dict = NULL;
+		}
+	}
+	if ((dict == NULL) && (epg->dict == NULL)) {
+		err = 0;
+		goto out;
+	}
+
+	// everything is made again before anything is changed, so a failure
+	// leaves the store as it was
+	for (i = 0; i < count; i++) {
+		if ((new[i] = epg_recode(epg, dict, old[i])) == NULL)
+			goto out;
+	}
+
+	// the old copies lead to the new ones while the events are moved over
+	for (i = 0; i < count; i++)
+		old[i]->next = new[i];
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		for (svc = epg->services[bucket]; svc; svc = svc->next) {
+			for (i = 0; i < svc->event_count; i++) {
+				struct epg_event *ev = svc->events[i];
+
+				ev->pub.title = epg_recoded(ev->pub.title);
+				ev->pub.text = epg_recoded(ev->pub.text);
+			}
+		}
+	}
+
+	memset(epg->strings, 0, epg->string_buckets * sizeof(struct epg_string *));
+	for (i = 0; i < count; i++) {
+		struct epg_string *s = new[i];
+
+		s->next = epg->strings[s->hash & (epg->string_buckets - 1)];
+		epg->strings[s->hash & (epg->string_buckets - 1)] = s;
+		free(old[i]);
+		new[i] = NULL;
+	}
+	dvbepg_dict_destroy(epg->dict);
+	epg->dict = dict;
+	dict = NULL;
+	err = 0;
+
+out:
+	if (plain && copied) {
+		for (i = 0; i < count; i++)
+			free((char *) plain[i]);
+	}
+	if (new) {
+		for (i = 0; i < count; i++)
+			free(new[i]);
+	}
+	dvbepg_dict_destroy(dict);
+	free(plain);
+	free(new);
+	free(old);
+	return err;
+}
+
+
+
+
+/********************************* snapshots **********************************/
+
+static uint32_t epg_save_index(const char *str)
+{
+	if (str == NULL)
+		return SNAPSHOT_NO_STRING;
+	return epg_string_of(str)->index;
+}
+
+int dvbepg_save(struct dvbepg *epg, const char *filename)
+{
+	struct snapshot_header header;
+	char tmpname[PATH_MAX];
+	uint32_t bucket;
+	uint32_t index = 0;
+	struct epg_string *s;
+	struct epg_service *svc;
+	FILE *f;
+	int fd;
+	int err;
+
+	if (snprintf(tmpname, sizeof(tmpname), "%s.XXXXXX", filename) >= (int) sizeof(tmpname))
+		return -ENAMETOOLONG;
+	if ((fd = mkstemp(tmpname)) < 0)
+		return -errno;
+	if ((f = fdopen(fd, "w")) == NULL) {
+		err = -errno;
+		close(fd);
+		unlink(tmpname);
+		return err;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.string_count = epg->string_count;
+	header.service_count = epg->service_count;
+	header.dictionary_count = epg->dict ? dvbepg_dict_count(epg->dict) : 0;
+	header.change_serial = epg->changes;
+	fwrite(&header, sizeof(header), 1, f);
+
+	for (index = 0; index < header.dictionary_count; index++) {
+		uint8_t len;
+		const uint8_t *entry = dvbepg_dict_entry(epg->dict, index, &len);
+
+		fwrite(&len, sizeof(len), 1, f);
+		fwrite(entry, len, 1, f);
+	}
+	index = 0;
+
+	// each string once; events refer to them by number
+	for (bucket = 0; bucket < epg->string_buckets; bucket++) {
+		for (s = epg->strings[bucket]; s; s = s->next) {
+			uint32_t len = strlen(s->str);
+
+			s->index = index++;
+			fwrite(&len, sizeof(len), 1, f);
+			fwrite(s->str, len, 1, f);
+		}
+	}
+
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		for (svc = epg->services[bucket]; svc; svc = svc->next) {
+			struct snapshot_service ss;
+			uint32_t i;
+
+			memset(&ss, 0, sizeof(ss));
+			ss.source = svc->id.source;
+			ss.network_id = svc->id.network_id;
+			ss.transport_stream_id = svc->id.transport_stream_id;
+			ss.service_id = svc->id.service_id;
+			ss.section_count = svc->section_count;
+			ss.event_count = svc->event_count;
+			fwrite(&ss, sizeof(ss), 1, f);
+
+			for (i = 0; i < svc->section_count; i++) {
+				struct snapshot_section sec;
+
+				memset(&sec, 0, sizeof(sec));
+				sec.key = svc->sections[i].key;
+				sec.version = svc->sections[i].version;
+				fwrite(&sec, sizeof(sec), 1, f);
+			}
+
+			for (i = 0; i < svc->event_count; i++) {
+				struct epg_event *ev = svc->events[i];
+				struct snapshot_event se;
+
+				memset(&se, 0, sizeof(se));
+				se.start_time = ev->pub.start_time;
+				se.duration = ev->pub.duration;
+				se.title = epg_save_index(ev->pub.title);
+				se.text = epg_save_index(ev->pub.text);
+				se.event_id = ev->pub.event_id;
+				se.origin = ev->origin;
+				memcpy(se.language, ev->pub.language, sizeof(se.language));
+				se.ett_version = ev->ett_version;
+				se.changed = ev->changed;
+				fwrite(&se, sizeof(se), 1, f);
+			}
+		}
+	}
+
+	if (ferror(f) | fclose(f)) {
+		err = errno ? -errno : -EIO;
+		unlink(tmpname);
+		return err;
+	}
+	if (rename(tmpname, filename)) {
+		err = -errno;
+		unlink(tmpname);
+		return err;
+	}
+
+	return 0;
+}
+
+/* read the next record of a snapshot, checking it is all there */
+static int snapshot_read(const uint8_t *buf, size_t size, size_t *pos, void *out, size_t len)
+{
+	if ((size - *pos) < len)
+		return -1;
+	memcpy(out, buf + *pos, len);
+	*pos += len;
+	return 0;
+}
+
+static int epg_load_snapshot(struct dvbepg *epg, const uint8_t *buf, size_t size)
+{
+	struct snapshot_header header;
+	const char **strings = NULL;
+	size_t event_size = offsetof(struct snapshot_event, changed);
+	size_t pos = 0;
+	uint32_t i;
+	uint32_t j;
+	int err = -EINVAL;
+
+	// older records are the same up to the fields added since
+	memset(&header, 0, sizeof(header));
+	if (snapshot_read(buf, size, &pos, &header, offsetof(struct snapshot_header, change_serial)) ||
+	    memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) ||
+	    (header.version < 1) || (header.version > SNAPSHOT_VERSION))
+		return -EINVAL;
+	if (header.version == 1)
+		header.dictionary_count = 0;
+	if (header.version >= 3) {
+		if (snapshot_read(buf, size, &pos, &header.change_serial, sizeof(header.change_serial)))
+			return -EINVAL;
+		event_size = sizeof(struct snapshot_event);
+	}
+	// without serials every event counts as changed once, at serial 1
+	epg->changes = header.change_serial ? header.change_serial : 1;
+
+	// the strings are taken as they were stored, so the dictionary must match
+	if (header.dictionary_count) {
+		uint8_t lens[DVBEPG_DICT_MAX_ENTRIES];
+		uint8_t *data;
+		size_t data_size = 0;
+
+		if (header.dictionary_count > DVBEPG_DICT_MAX_ENTRIES)
+			return -EINVAL;
+		if ((data = malloc(header.dictionary_count * DVBEPG_DICT_MAX_LEN)) == NULL)
+			return -ENOMEM;
+		for (i = 0; i < header.dictionary_count; i++) {
+			if (snapshot_read(buf, size, &pos, &lens[i], sizeof(lens[i])) ||
+			    (lens[i] > DVBEPG_DICT_MAX_LEN) ||
+			    snapshot_read(buf, size, &pos, data + data_size, lens[i])) {
+				free(data);
+				return -EINVAL;
+			}
+			data_size += lens[i];
+		}
+		epg->dict = dvbepg_dict_create(data, lens, header.dictionary_count);
+		free(data);
+		if (epg->dict == NULL)
+			return -EINVAL;
+	}
+
+	// the snapshot's own reference keeps each string until all events are in
+	if (header.string_count > (size / sizeof(uint32_t)))
+		return -EINVAL;
+	if ((strings = calloc(header.string_count + 1, sizeof(char *))) == NULL)
+		return -ENOMEM;
+	for (i = 0; i < header.string_count; i++) {
+		uint32_t len;
+
+		if (snapshot_read(buf, size, &pos, &len, sizeof(len)) || ((size - pos) < len))
+			goto out;
+		if (epg_intern_code(epg, (const char *) buf + pos, len, &strings[i])) {
+			err = -ENOMEM;
+			goto out;
+		}
+		if (epg->dict && strings[i] && dvbepg_dict_check(epg->dict, strings[i]))
+			goto out;
+		pos += len;
+	}
+
+	for (i = 0; i < header.service_count; i++) {
+		struct snapshot_service ss;
+		struct dvbepg_service_id id;
+		struct epg_service *svc;
+
+		if (snapshot_read(buf, size, &pos, &ss, sizeof(ss)))
+			goto out;
+		id.source = ss.source;
+		id.network_id = ss.network_id;
+		id.transport_stream_id = ss.transport_stream_id;
+		id.service_id = ss.service_id;
+		if ((svc = epg_get_service(epg, &id, 1)) == NULL) {
+			err = -ENOMEM;
+			goto out;
+		}
+
+		for (j = 0; j < ss.section_count; j++) {
+			struct snapshot_section sec;
+
+			if (snapshot_read(buf, size, &pos, &sec, sizeof(sec)))
+				goto out;
+			if (epg_set_section(svc, sec.key, sec.version)) {
+				err = -ENOMEM;
+				goto out;
+			}
+		}
+
+		for (j = 0; j < ss.event_count; j++) {
+			struct snapshot_event se;
+			struct epg_event *ev;
+
+			memset(&se, 0, sizeof(se));
+			if (snapshot_read(buf, size, &pos, &se, event_size))
+				goto out;
+			if ((se.changed == 0) || (se.changed > epg->changes))
+				se.changed = epg->changes;
+			if (((se.title != SNAPSHOT_NO_STRING) && (se.title >= header.string_count)) ||
+			    ((se.text != SNAPSHOT_NO_STRING) && (se.text >= header.string_count)) ||
+			    epg_find_event(svc, se.event_id))
+				goto out;
+
+			if ((ev = calloc(1, sizeof(struct epg_event))) == NULL) {
+				err = -ENOMEM;
+				goto out;
+			}
+			ev->pub.event_id = se.event_id;
+			ev->pub.start_time = se.start_time;
+			ev->pub.duration = se.duration;
+			memcpy(ev->pub.language, se.language, 3);
+			ev->origin = se.origin;
+			ev->ett_version = se.ett_version;
+			ev->changed = se.changed;
+			if (epg_link_event(svc, ev)) {
+				free(ev);
+				err = -ENOMEM;
+				goto out;
+			}
+			ev->id_next = svc->id_hash[se.event_id % EPG_ID_BUCKETS];
+			svc->id_hash[se.event_id % EPG_ID_BUCKETS] = ev;
+
+			if (se.title != SNAPSHOT_NO_STRING) {
+				ev->pub.title = strings[se.title];
+				epg_string_of(ev->pub.title)->refs++;
+			}
+			if (se.text != SNAPSHOT_NO_STRING) {
+				ev->pub.text = strings[se.text];
+				epg_string_of(ev->pub.text)->refs++;
+			}
+		}
+	}
+	err = 0;
+
+out:
+	for (i = 0; i < header.string_count; i++)
+		epg_release(epg, strings[i]);
+	free(strings);
+	return err;
+}
+
+struct dvbepg *dvbepg_load(const char *filename)
+{
+	struct dvbepg *epg = NULL;
+	struct stat st;
+	uint8_t *buf = NULL;
+	FILE *f;
+	int err;
+
+	if ((f = fopen(filename, "r")) == NULL)
+		return NULL;
+	if (fstat(fileno(f), &st)) {
+		err = errno;
+		goto out;
+	}
+	if ((buf = malloc(st.st_size ? st.st_size : 1)) == NULL) {
+		err = ENOMEM;
+		goto out;
+	}
+	if (fread(buf, 1, st.st_size, f) != (size_t) st.st_size) {
+		err = EIO;
+		goto out;
+	}
+	if ((epg = dvbepg_create()) == NULL) {
+		err = ENOMEM;
+		goto out;
+	}
+	if ((err = -epg_load_snapshot(epg, buf, st.st_size)) != 0) {
+		dvbepg_destroy(epg);
+		epg = NULL;
+	}
+
+out:
+	free(buf);
+	fclose(f);
+	if (epg == NULL)
+		errno = err;
+	return epg;
+}
@@ -0,0 +1,352 @@
+/*
+ * dvbepg - in-memory EPG store
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DVBEPG_H
+#define DVBEPG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+#include <libucsi/dvb/eit_section.h>
+#include <libucsi/atsc/eit_section.h>
+#include <libucsi/atsc/ett_section.h>
+
+/**
+ * An EPG store. It collects events from DVB EIT, and ATSC EIT/ETT, sections
+ * and keeps them per service, in time order. Sections whose version was
+ * already seen are skipped, so the same tables may be fed in over and over.
+ * A store is not thread safe: calls on it must be serialised by the caller.
+ */
+struct dvbepg;
+
+/**
+ * Where the events of a service come from.
+ */
+enum dvbepg_source {
+	DVBEPG_SOURCE_DVB,
+	DVBEPG_SOURCE_ATSC,
+};
+
+/**
+ * Identifies a service in the store.
+ */
+struct dvbepg_service_id {
+	enum dvbepg_source source;
+	uint16_t network_id;		/* original_network_id, 0 for ATSC */
+	uint16_t transport_stream_id;
+	uint16_t service_id;		/* the source_id for ATSC */
+};
+
+/**
+ * An event. Strings are UTF-8 and owned by the store: they stay valid until
+ * the event is changed or removed. Once the store is compressed (see
+ * dvbepg_compress()), an event handed out is a decoded copy instead, valid
+ * until the next call on the store.
+ */
+struct dvbepg_event {
+	uint16_t event_id;
+	time_t start_time;
+	uint32_t duration;		/* in seconds */
+	char language[4];		/* ISO 639-2 code, "" if unknown */
+	const char *title;		/* NULL if none */
+	const char *text;		/* NULL if none */
+};
+
+/**
+ * Sizes of a store.
+ */
+struct dvbepg_stats {
+	uint32_t services;
+	uint32_t events;
+	uint32_t strings;		/* distinct titles and texts */
+	uint32_t dictionary_entries;
+	uint64_t text_size;		/* bytes of text in those strings */
+	uint64_t stored_size;		/* bytes they take in the store, with the dictionary */
+};
+
+/**
+ * Most entries a dictionary can have.
+ */
+#define DVBEPG_DICTIONARY_MAX 1785
+
+/**
+ * Formats dvbepg_export() can write.
+ */
+enum dvbepg_export_format {
+	DVBEPG_EXPORT_XMLTV,
+	DVBEPG_EXPORT_JSON,
+	DVBEPG_EXPORT_ARROW,
+};
+
+/**
+ * Callback naming a service for an export.
+ *
+ * @param private_data Private data passed to the function called.
+ * @param service The service.
+ * @return Its name in UTF-8 (it need only stay valid until the next call),
+ * or NULL to name it by its ids.
+ */
+typedef const char *(*dvbepg_name_callback)(void *private_data,
+					     const struct dvbepg_service_id *service);
+
+/**
+ * What dvbepg_export() writes.
+ */
+struct dvbepg_export_params {
+	enum dvbepg_export_format format;
+	int threads;			/* formatting threads, 0 => one per CPU (not for Arrow) */
+	uint32_t since;			/* only events changed after this change serial, 0 => all */
+	time_t from;			/* only events overlapping [from, to), 0 and 0 => all */
+	time_t to;
+	dvbepg_name_callback service_name;	/* NULL => name services by their ids */
+	void *private_data;
+};
+
+/**
+ * Callback for events.
+ *
+ * @param private_data Private data passed to the function called.
+ * @param event The event.
+ * @return 0 to continue, > 0 to stop.
+ */
+typedef int (*dvbepg_event_callback)(void *private_data, const struct dvbepg_event *event);
+
+/**
+ * Callback for services.
+ *
+ * @param private_data Private data passed to the function called.
+ * @param service The service.
+ * @return 0 to continue, > 0 to stop.
+ */
+typedef int (*dvbepg_service_callback)(void *private_data,
+				       const struct dvbepg_service_id *service);
+
+/**
+ * Create an empty store.
+ *
+ * @return The store, or NULL on failure.
+ */
+extern struct dvbepg *dvbepg_create(void);
+
+/**
+ * Destroy a store.
+ *
+ * @param epg The store.
+ */
+extern void dvbepg_destroy(struct dvbepg *epg);
+
+/**
+ * Apply a DVB EIT section (present/following or schedule, actual or other).
+ *
+ * @param epg The store.
+ * @param eit The decoded section.
+ * @return 1 if the section was applied, 0 if this version of it was
+ * already applied, or -ENOMEM.
+ */
+extern int dvbepg_add_dvb_eit(struct dvbepg *epg, struct dvb_eit_section *eit);
+
+/**
+ * Apply an ATSC EIT section.
+ *
+ * @param epg The store.
+ * @param transport_stream_id Transport stream the section came from.
+ * @param eit_index Which EIT it came from (0 for EIT-0, and so on).
+ * @param eit The decoded section.
+ * @return 1 if the section was applied, 0 if this version of it was
+ * already applied, or -ENOMEM.
+ */
+extern int dvbepg_add_atsc_eit(struct dvbepg *epg, uint16_t transport_stream_id,
+			       int eit_index, struct atsc_eit_section *eit);
+
+/**
+ * Apply an ATSC ETT section for an event: its text becomes the text of the
+ * event. ETTs for events not yet in the store are dropped.
+ *
+ * @param epg The store.
+ * @param transport_stream_id Transport stream the section came from.
+ * @param ett The decoded section.
+ * @return 1 if the section was applied, 0 if it was already applied or is
+ * for an unknown event, or -ENOMEM.
+ */
+extern int dvbepg_add_atsc_ett(struct dvbepg *epg, uint16_t transport_stream_id,
+			       struct atsc_ett_section *ett);
+
+/**
+ * Remove events which ended before a time.
+ *
+ * @param epg The store.
+ * @param before Events ending at or before this time are removed.
+ * @return Number of events removed.
+ */
+extern int dvbepg_expire(struct dvbepg *epg, time_t before);
+
+/**
+ * Iterate over the services in the store.
+ *
+ * @param epg The store.
+ * @param callback Callback called for each service.
+ * @param private_data Private data for the callback.
+ * @return 0 or value from the callback if it's > 0
+ */
+extern int dvbepg_for_each_service(struct dvbepg *epg, dvbepg_service_callback callback,
+				   void *private_data);
+
+/**
+ * Look up an event by its id.
+ *
+ * @param epg The store.
+ * @param service The service.
+ * @param event_id The event id.
+ * @return The event, or NULL if there is none.
+ */
+extern const struct dvbepg_event *dvbepg_find_event(struct dvbepg *epg,
+						    const struct dvbepg_service_id *service,
+						    uint16_t event_id);
+
+/**
+ * Look up the event running on a service at a time.
+ *
+ * @param epg The store.
+ * @param service The service.
+ * @param when The time.
+ * @return The event, or NULL if there is none.
+ */
+extern const struct dvbepg_event *dvbepg_find_event_at(struct dvbepg *epg,
+						       const struct dvbepg_service_id *service,
+						       time_t when);
+
+/**
+ * Iterate over the events of a service overlapping a time range, in start
+ * time order.
+ *
+ * @param epg The store.
+ * @param service The service.
+ * @param from Start of the range.
+ * @param to End of the range (exclusive).
+ * @param callback Callback called for each event.
+ * @param private_data Private data for the callback.
+ * @return 0 or value from the callback if it's > 0, or -ENOMEM
+ */
+extern int dvbepg_for_each_event(struct dvbepg *epg, const struct dvbepg_service_id *service,
+				 time_t from, time_t to,
+				 dvbepg_event_callback callback, void *private_data);
+
+/**
+ * Get the sizes of a store.
+ *
+ * @param epg The store.
+ * @param stats Where to put them.
+ */
+extern void dvbepg_stats(struct dvbepg *epg, struct dvbepg_stats *stats);
+
+/**
+ * Compress the strings of the store. Every distinct title and text is only
+ * kept once anyway; this trains a dictionary of the phrases they share most
+ * on the strings in the store, and keeps every string encoded with it, so a
+ * phrase takes two bytes wherever it comes up. Strings added later are
+ * encoded with the same dictionary, and decoded one at a time as events are
+ * handed out. Call it again after the guide has grown or changed a lot to
+ * train a new dictionary. The dictionary goes into snapshots with the
+ * strings.
+ *
+ * @param epg The store.
+ * @param max_entries Most entries in the dictionary, up to
+ * DVBEPG_DICTIONARY_MAX, or 0 to go back to plain strings.
+ * @return 0 on success, or -ENOMEM (the store is left as it was).
+ */
+extern int dvbepg_compress(struct dvbepg *epg, uint32_t max_entries);
+
+/**
+ * Get the change serial of the store. It goes up by one every time an event
+ * is added or its times, language, title or text change, and is kept in
+ * snapshots. Exporting with since set to the serial of the last export gives
+ * only the events added or changed since; a since beyond the serial of the
+ * store (one made afresh since) gives all of them.
+ *
+ * @param epg The store.
+ * @return The serial, 0 if no event was ever added.
+ */
+extern uint32_t dvbepg_change_serial(struct dvbepg *epg);
+
+/**
+ * Export the store as an XMLTV document, as JSON, or as an Arrow IPC stream.
+ *
+ * XMLTV has a <channel> per service and a <programme> per event, with the
+ * title and text as <title> and <desc> in the event's language. Channel ids
+ * are "onid.tsid.sid.dvb" or "tsid.source_id.atsc".
+ *
+ * JSON is a single object: "channels" is an array of { "id", "name" }, and
+ * "programmes" an array of { "channel", "event_id", "start", "stop",
+ * "language", "title", "text" }, times in seconds since the epoch; absent
+ * strings are left out.
+ *
+ * Arrow is a single table with a row per event (an IPC stream, readable by
+ * pyarrow.ipc.open_stream() and the like): "channel" and "name" (null if
+ * not named), then "network_id", "transport_stream_id", "service_id" and
+ * "event_id" as uint16, "start" and "stop" as timestamp[s, UTC], and
+ * "language", "title" and "text", null where absent. The strings are
+ * dictionary encoded, each distinct one written once in a dictionary batch
+ * ahead of the rows, which follow in record batches of up to 65536 events
+ * in the same order as the other formats. Services without events are left
+ * out. Each incremental export is a stream of its own, to be loaded after
+ * the ones before it.
+ *
+ * Services are formatted in parallel, each into a buffer of its own, and
+ * written out in order (of their ids) with large writes as they are done;
+ * every distinct string is escaped once, however many events share it. An
+ * incremental export (params->since nonzero) lists only the services with
+ * events changed since, and only those events: removed events are not
+ * reported, so a consumer merging them in should drop events that have
+ * ended by itself. The store must not be changed while the export runs.
+ *
+ * @param epg The store.
+ * @param fd Where to write it.
+ * @param params What to write.
+ * @return 0 on success, or -errno.
+ */
+extern int dvbepg_export(struct dvbepg *epg, int fd, const struct dvbepg_export_params *params);
+
+/**
+ * Write a snapshot of the store, including the section versions seen, so a
+ * store loaded from it skips sections which did not change since. The file
+ * is replaced atomically.
+ *
+ * @param epg The store.
+ * @param filename File to write.
+ * @return 0 on success, or -errno.
+ */
+extern int dvbepg_save(struct dvbepg *epg, const char *filename);
+
+/**
+ * Create a store from a snapshot written by dvbepg_save().
+ *
+ * @param filename File to read.
+ * @return The store, or NULL on failure (errno is set).
+ */
+extern struct dvbepg *dvbepg_load(const char *filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DVBEPG_H */
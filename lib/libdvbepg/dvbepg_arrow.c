@@ -0,0 +1,889 @@
+/*
+ * dvbepg - in-memory EPG store
+ * Arrow IPC export
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvbepg.h"
+#include "dvbepg_dict.h"
+#include "dvbepg_int.h"
+
+/*
+ * An Arrow IPC stream is a run of messages, each a Flatbuffers header and a
+ * body of the buffers it describes:
+ *
+ *	0xffffffff, header length, Message (padded to 8), body
+ *
+ * and ends with 0xffffffff, 0. Ours is the schema, a dictionary batch for
+ * each dictionary encoded column holding every value it takes, and then
+ * record batches of up to ARROW_BATCH_ROWS events. Everything is written
+ * little endian, whatever the host.
+ *
+ * The Flatbuffers are built front to back: a table, vector or string is
+ * always put after whatever points at it, since offsets only point
+ * forwards, and each table directly follows its vtable.
+ */
+
+#define ARROW_BATCH_ROWS 65536
+#define ARROW_NO_STRING 0xffffffff
+#define ARROW_METADATA_V5 4
+#define ARROW_MAX_FIELDS 8		/* of any Flatbuffers table we write */
+
+/* MessageHeader and Type union members */
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_DICTIONARY_BATCH 2
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_TIMESTAMP 10
+
+enum arrow_type {
+	ARROW_UINT16,
+	ARROW_TIMESTAMP,		/* seconds, UTC */
+	ARROW_DICTIONARY,		/* int32 indices into a dictionary of UTF-8 strings */
+};
+
+enum arrow_column {
+	COLUMN_CHANNEL,
+	COLUMN_NAME,
+	COLUMN_NETWORK_ID,
+	COLUMN_TRANSPORT_STREAM_ID,
+	COLUMN_SERVICE_ID,
+	COLUMN_EVENT_ID,
+	COLUMN_START,
+	COLUMN_STOP,
+	COLUMN_LANGUAGE,
+	COLUMN_TITLE,
+	COLUMN_TEXT,
+	COLUMN_COUNT,
+};
+
+/* dictionaries, by the column they are for; the id is the number */
+enum arrow_dict {
+	DICT_CHANNEL,
+	DICT_NAME,
+	DICT_LANGUAGE,
+	DICT_TITLE,
+	DICT_TEXT,
+	DICT_COUNT,
+};
+
+static const struct {
+	const char *name;
+	enum arrow_type type;
+	int dict;
+	int nullable;
+} arrow_columns[COLUMN_COUNT] = {
+	{ "channel",		 ARROW_DICTIONARY,	DICT_CHANNEL,	0 },
+	{ "name",		 ARROW_DICTIONARY,	DICT_NAME,	1 },
+	{ "network_id",		 ARROW_UINT16,		-1,		0 },
+	{ "transport_stream_id", ARROW_UINT16,		-1,		0 },
+	{ "service_id",		 ARROW_UINT16,		-1,		0 },
+	{ "event_id",		 ARROW_UINT16,		-1,		0 },
+	{ "start",		 ARROW_TIMESTAMP,	-1,		0 },
+	{ "stop",		 ARROW_TIMESTAMP,	-1,		0 },
+	{ "language",		 ARROW_DICTIONARY,	DICT_LANGUAGE,	1 },
+	{ "title",		 ARROW_DICTIONARY,	DICT_TITLE,	1 },
+	{ "text",		 ARROW_DICTIONARY,	DICT_TEXT,	1 },
+};
+
+struct arrow_buf {
+	uint8_t *data;
+	size_t len;
+	size_t alloc;
+	int err;
+};
+
+struct arrow_row {
+	struct epg_event *ev;
+	uint32_t service;
+	int32_t index[DICT_COUNT];	/* -1 => null */
+};
+
+struct arrow_values {
+	char **values;			/* plain strings */
+	const char **stored;		/* or strings of the store, maybe encoded */
+	uint32_t count;
+};
+
+struct arrow_export {
+	struct dvbepg *epg;
+	const struct dvbepg_export_params *params;
+	uint32_t since;
+	int ranged;
+	int fd;
+
+	struct epg_service **services;
+	uint32_t service_count;
+	struct arrow_row *rows;
+	uint32_t row_count;
+	struct arrow_values dicts[DICT_COUNT];
+
+	struct arrow_buf meta;		/* Flatbuffers header of a message */
+	struct arrow_buf body;
+	struct arrow_buf nodes;		/* FieldNodes and Buffers of a batch, as they go into it */
+	struct arrow_buf buffers;
+	struct arrow_buf strings;	/* values of a dictionary, before they go into the body */
+	uint32_t node_count;
+	uint32_t buffer_count;
+	char *plain;			/* scratch for decoding */
+	size_t plain_size;
+};
+
+
+
+
+/********************************** buffers ***********************************/
+
+static uint8_t *buf_reserve(struct arrow_buf *b, size_t len)
+{
+	size_t alloc;
+	uint8_t *data;
+
+	if (b->err)
+		return NULL;
+	if (b->len + len > b->alloc) {
+		alloc = b->alloc ? b->alloc : 4096;
+		while (alloc < b->len + len)
+			alloc *= 2;
+		if ((data = realloc(b->data, alloc)) == NULL) {
+			b->err = -ENOMEM;
+			return NULL;
+		}
+		b->data = data;
+		b->alloc = alloc;
+	}
+	return b->data + b->len;
+}
+
+static void put_le(uint8_t *p, uint64_t v, int size)
+{
+	int i;
+
+	for (i = 0; i < size; i++)
+		p[i] = v >> (i * 8);
+}
+
+/* append a little endian value */
+static void buf_le(struct arrow_buf *b, uint64_t v, int size)
+{
+	uint8_t *p = buf_reserve(b, size);
+
+	if (p) {
+		put_le(p, v, size);
+		b->len += size;
+	}
+}
+
+static void buf_put(struct arrow_buf *b, const void *data, size_t len)
+{
+	uint8_t *p = buf_reserve(b, len);
+
+	if (p) {
+		memcpy(p, data, len);
+		b->len += len;
+	}
+}
+
+/* zero pad until len + extra is a multiple of align */
+static void buf_pad(struct arrow_buf *b, size_t align, size_t extra)
+{
+	while (((b->len + extra) % align) && !b->err)
+		buf_le(b, 0, 1);
+}
+
+/* set a value already in the buffer */
+static void buf_set(struct arrow_buf *b, size_t pos, uint64_t v, int size)
+{
+	if (!b->err && pos)
+		put_le(b->data + pos, v, size);
+}
+
+static int write_all(int fd, const uint8_t *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(fd, data, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+
+
+
+/********************************* flatbuffers ********************************/
+
+/*
+ * Lay out a table with fields of these sizes (0 for those left out): its
+ * vtable, then the table, 8 byte aligned. The fields are zeroed; where each
+ * went, 0 for those left out, is put in pos.
+ */
+static size_t fb_table(struct arrow_buf *b, int nfields, const uint8_t *sizes, size_t *pos)
+{
+	uint16_t offsets[ARROW_MAX_FIELDS];
+	size_t vt_size = 4 + (2 * nfields);
+	size_t size = 4;
+	size_t table;
+	uint8_t *p;
+	int i;
+
+	for (i = 0; i < nfields; i++) {
+		offsets[i] = 0;
+		if (sizes[i] == 0)
+			continue;
+		size = (size + sizes[i] - 1) & ~(size_t) (sizes[i] - 1);
+		offsets[i] = size;
+		size += sizes[i];
+	}
+	size = (size + 3) & ~(size_t) 3;
+
+	buf_pad(b, 8, vt_size);
+	buf_le(b, vt_size, 2);
+	buf_le(b, size, 2);
+	for (i = 0; i < nfields; i++)
+		buf_le(b, offsets[i], 2);
+	table = b->len;
+	for (i = 0; i < nfields; i++)
+		pos[i] = offsets[i] ? (table + offsets[i]) : 0;
+	if ((p = buf_reserve(b, size)) == NULL)
+		return 0;
+	memset(p, 0, size);
+	put_le(p, vt_size, 4);		// the vtable is just before
+	b->len += size;
+	return table;
+}
+
+/* point an offset field at what was just put after it */
+static void fb_offset(struct arrow_buf *b, size_t field, size_t target)
+{
+	buf_set(b, field, target - field, 4);
+}
+
+/*
+ * Start a vector, its elements aligned to align.
+ *
+ * @return Where it is, which is what offsets point at; its elements follow.
+ */
+static size_t fb_vector(struct arrow_buf *b, uint32_t count, size_t size, size_t align)
+{
+	size_t pos;
+	uint8_t *p;
+
+	buf_pad(b, (align < 4) ? 4 : align, 4);
+	pos = b->len;
+	buf_le(b, count, 4);
+	if ((p = buf_reserve(b, count * size)) == NULL)
+		return 0;
+	memset(p, 0, count * size);
+	b->len += count * size;
+	return pos;
+}
+
+static size_t fb_string(struct arrow_buf *b, const char *str)
+{
+	size_t len = strlen(str);
+	size_t pos;
+
+	buf_pad(b, 4, 0);
+	pos = b->len;
+	buf_le(b, len, 4);
+	buf_put(b, str, len + 1);
+	return pos;
+}
+
+/*
+ * Start a message: the root offset and the Message table.
+ *
+ * @return Where its header offset goes.
+ */
+static size_t fb_message(struct arrow_buf *b, int header_type, uint64_t body_length)
+{
+	static const uint8_t sizes[] = { 2, 1, 4, 8 };
+	size_t pos[4];
+	size_t table;
+
+	b->len = 0;
+	b->err = 0;
+	buf_le(b, 0, 4);
+	table = fb_table(b, 4, sizes, pos);
+	if (!b->err)
+		put_le(b->data, table, 4);
+	buf_set(b, pos[0], ARROW_METADATA_V5, 2);
+	buf_set(b, pos[1], header_type, 1);
+	buf_set(b, pos[3], body_length, 8);
+	return pos[2];
+}
+
+static size_t fb_int_type(struct arrow_buf *b, int bit_width, int is_signed)
+{
+	static const uint8_t sizes[] = { 4, 1 };
+	size_t pos[2];
+	size_t table = fb_table(b, 2, sizes, pos);
+
+	buf_set(b, pos[0], bit_width, 4);
+	buf_set(b, pos[1], is_signed, 1);
+	return table;
+}
+
+static void fb_field(struct arrow_buf *b, size_t at, int column)
+{
+	static const uint8_t sizes[] = { 4, 1, 1, 4, 4, 4 };
+	static const uint8_t timestamp_sizes[] = { 2, 4 };
+	size_t pos[6];
+	size_t tpos[2];
+	size_t table;
+	size_t sub;
+	uint8_t field_sizes[6];
+	int dict = arrow_columns[column].dict;
+
+	memcpy(field_sizes, sizes, sizeof(sizes));
+	if (dict < 0)
+		field_sizes[4] = 0;
+	table = fb_table(b, 6, field_sizes, pos);
+	fb_offset(b, at, table);
+	buf_set(b, pos[1], arrow_columns[column].nullable, 1);
+
+	fb_offset(b, pos[0], fb_string(b, arrow_columns[column].name));
+
+	switch (arrow_columns[column].type) {
+	case ARROW_UINT16:
+		buf_set(b, pos[2], ARROW_TYPE_INT, 1);
+		fb_offset(b, pos[3], fb_int_type(b, 16, 0));
+		break;
+
+	case ARROW_TIMESTAMP:
+		buf_set(b, pos[2], ARROW_TYPE_TIMESTAMP, 1);
+		sub = fb_table(b, 2, timestamp_sizes, tpos);
+		fb_offset(b, pos[3], sub);
+		fb_offset(b, tpos[1], fb_string(b, "UTC"));
+		break;
+
+	case ARROW_DICTIONARY: {
+		static const uint8_t dict_sizes[] = { 8, 4 };
+		size_t dpos[2];
+
+		// the field's type is that of the values
+		buf_set(b, pos[2], ARROW_TYPE_UTF8, 1);
+		fb_offset(b, pos[3], fb_table(b, 0, NULL, NULL));
+		sub = fb_table(b, 2, dict_sizes, dpos);
+		fb_offset(b, pos[4], sub);
+		buf_set(b, dpos[0], dict, 8);
+		fb_offset(b, dpos[1], fb_int_type(b, 32, 1));
+		break;
+	}
+	}
+
+	fb_offset(b, pos[5], fb_vector(b, 0, 4, 4));
+}
+
+/*
+ * Add a RecordBatch, with the nodes and buffers gathered for it.
+ *
+ * @return Where it is.
+ */
+static size_t fb_record_batch(struct arrow_export *ex, uint32_t length)
+{
+	static const uint8_t sizes[] = { 8, 4, 4 };
+	struct arrow_buf *b = &ex->meta;
+	size_t pos[3];
+	size_t table;
+	size_t vec;
+
+	table = fb_table(b, 3, sizes, pos);
+	buf_set(b, pos[0], length, 8);
+
+	vec = fb_vector(b, ex->node_count, 16, 8);
+	fb_offset(b, pos[1], vec);
+	if (!b->err)
+		memcpy(b->data + vec + 4, ex->nodes.data, ex->nodes.len);
+	vec = fb_vector(b, ex->buffer_count, 16, 8);
+	fb_offset(b, pos[2], vec);
+	if (!b->err)
+		memcpy(b->data + vec + 4, ex->buffers.data, ex->buffers.len);
+	return table;
+}
+
+
+
+
+/********************************** messages **********************************/
+
+static int message_write(struct arrow_export *ex)
+{
+	uint8_t prefix[8];
+	int ret;
+
+	buf_pad(&ex->meta, 8, 0);
+	if (ex->meta.err || ex->body.err || ex->nodes.err || ex->buffers.err)
+		return -ENOMEM;
+	put_le(prefix, 0xffffffff, 4);
+	put_le(prefix + 4, ex->meta.len, 4);
+
+	if ((ret = write_all(ex->fd, prefix, sizeof(prefix))) ||
+	    (ret = write_all(ex->fd, ex->meta.data, ex->meta.len)) ||
+	    (ret = write_all(ex->fd, ex->body.data, ex->body.len)))
+		return ret;
+	return 0;
+}
+
+static void batch_start(struct arrow_export *ex)
+{
+	ex->body.len = 0;
+	ex->nodes.len = 0;
+	ex->buffers.len = 0;
+	ex->node_count = 0;
+	ex->buffer_count = 0;
+}
+
+static void batch_node(struct arrow_export *ex, uint32_t length, uint32_t null_count)
+{
+	buf_le(&ex->nodes, length, 8);
+	buf_le(&ex->nodes, null_count, 8);
+	ex->node_count++;
+}
+
+/*
+ * Add a buffer to the body of a batch.
+ *
+ * @return Where to put its len bytes (valid until the next buffer), or NULL
+ * if out of memory.
+ */
+static uint8_t *batch_buffer(struct arrow_export *ex, size_t len)
+{
+	size_t padded = (len + 7) & ~(size_t) 7;
+	uint8_t *p;
+
+	buf_le(&ex->buffers, ex->body.len, 8);
+	buf_le(&ex->buffers, len, 8);
+	ex->buffer_count++;
+	if ((p = buf_reserve(&ex->body, padded)) == NULL)
+		return NULL;
+	memset(p + len, 0, padded - len);
+	ex->body.len += padded;
+	return p;
+}
+
+static int write_schema(struct arrow_export *ex)
+{
+	static const uint8_t sizes[] = { 2, 4 };
+	struct arrow_buf *b = &ex->meta;
+	size_t header = fb_message(b, ARROW_HEADER_SCHEMA, 0);
+	size_t pos[2];
+	size_t vec;
+	int i;
+
+	fb_offset(b, header, fb_table(b, 2, sizes, pos));
+	vec = fb_vector(b, COLUMN_COUNT, 4, 4);
+	fb_offset(b, pos[1], vec);
+	for (i = 0; i < COLUMN_COUNT; i++)
+		fb_field(b, vec + 4 + (i * 4), i);
+
+	ex->body.len = 0;
+	return message_write(ex);
+}
+
+static const char *dict_value(struct arrow_export *ex, struct arrow_values *d, uint32_t i,
+			      size_t *len)
+{
+	const char *str;
+
+	if (d->values) {
+		*len = strlen(d->values[i]);
+		return d->values[i];
+	}
+
+	str = d->stored[i];
+	if (ex->epg->dict == NULL) {
+		*len = strlen(str);
+		return str;
+	}
+	*len = dvbepg_dict_decode(ex->epg->dict, str, ex->plain, ex->plain_size);
+	if (*len >= ex->plain_size) {
+		char *p = realloc(ex->plain, *len + 1);
+
+		if (p == NULL)
+			return NULL;
+		ex->plain = p;
+		ex->plain_size = *len + 1;
+		dvbepg_dict_decode(ex->epg->dict, str, p, *len + 1);
+	}
+	return ex->plain;
+}
+
+static int write_dictionary(struct arrow_export *ex, int id)
+{
+	static const uint8_t sizes[] = { 8, 4, 1 };
+	struct arrow_values *d = &ex->dicts[id];
+	uint8_t *offsets;
+	uint8_t *data;
+	const char *str;
+	size_t header;
+	size_t pos[3];
+	size_t len;
+	uint32_t i;
+
+	// a single utf8 column: no nulls, the offsets, then the values
+	batch_start(ex);
+	batch_node(ex, d->count, 0);
+	batch_buffer(ex, 0);
+	if ((offsets = batch_buffer(ex, (d->count + 1) * 4)) == NULL)
+		return -ENOMEM;
+	ex->strings.len = 0;
+	for (i = 0; i < d->count; i++) {
+		put_le(offsets + (i * 4), ex->strings.len, 4);
+		if ((str = dict_value(ex, d, i, &len)) == NULL)
+			return -ENOMEM;
+		buf_put(&ex->strings, str, len);
+	}
+	put_le(offsets + (d->count * 4), ex->strings.len, 4);
+	if (ex->strings.err)
+		return -ENOMEM;
+	if (ex->strings.len > INT32_MAX)
+		return -E2BIG;
+	if ((data = batch_buffer(ex, ex->strings.len)) == NULL)
+		return -ENOMEM;
+	memcpy(data, ex->strings.data, ex->strings.len);
+
+	header = fb_message(&ex->meta, ARROW_HEADER_DICTIONARY_BATCH, ex->body.len);
+	fb_offset(&ex->meta, header, fb_table(&ex->meta, 3, sizes, pos));
+	buf_set(&ex->meta, pos[0], id, 8);
+	fb_offset(&ex->meta, pos[1], fb_record_batch(ex, d->count));
+	return message_write(ex);
+}
+
+static uint64_t row_value(struct arrow_export *ex, struct arrow_row *row, int column)
+{
+	struct dvbepg_service_id *id = &ex->services[row->service]->id;
+
+	switch (column) {
+	case COLUMN_NETWORK_ID:
+		return id->network_id;
+	case COLUMN_TRANSPORT_STREAM_ID:
+		return id->transport_stream_id;
+	case COLUMN_SERVICE_ID:
+		return id->service_id;
+	case COLUMN_EVENT_ID:
+		return row->ev->pub.event_id;
+	case COLUMN_START:
+		return row->ev->pub.start_time;
+	case COLUMN_STOP:
+		return row->ev->pub.start_time + (time_t) row->ev->pub.duration;
+	}
+	return 0;
+}
+
+static int write_batch(struct arrow_export *ex, uint32_t first, uint32_t count)
+{
+	struct arrow_row *rows = ex->rows + first;
+	size_t header;
+	uint8_t *p;
+	uint32_t nulls;
+	uint32_t i;
+	int size;
+	int dict;
+	int c;
+
+	batch_start(ex);
+	for (c = 0; c < COLUMN_COUNT; c++) {
+		switch (arrow_columns[c].type) {
+		case ARROW_UINT16:
+		case ARROW_TIMESTAMP:
+			size = (arrow_columns[c].type == ARROW_UINT16) ? 2 : 8;
+			batch_node(ex, count, 0);
+			batch_buffer(ex, 0);
+			if ((p = batch_buffer(ex, count * size)) == NULL)
+				return -ENOMEM;
+			for (i = 0; i < count; i++)
+				put_le(p + (i * size), row_value(ex, &rows[i], c), size);
+			break;
+
+		case ARROW_DICTIONARY:
+			dict = arrow_columns[c].dict;
+			for (i = 0, nulls = 0; i < count; i++)
+				nulls += rows[i].index[dict] < 0;
+			batch_node(ex, count, nulls);
+
+			// the validity bitmap may be left out if there are no nulls
+			if ((p = batch_buffer(ex, nulls ? ((count + 7) / 8) : 0)) == NULL)
+				return -ENOMEM;
+			if (nulls) {
+				memset(p, 0, (count + 7) / 8);
+				for (i = 0; i < count; i++) {
+					if (rows[i].index[dict] >= 0)
+						p[i / 8] |= 1 << (i % 8);
+				}
+			}
+			if ((p = batch_buffer(ex, count * 4)) == NULL)
+				return -ENOMEM;
+			for (i = 0; i < count; i++)
+				put_le(p + (i * 4), (rows[i].index[dict] < 0) ? 0 : rows[i].index[dict], 4);
+			break;
+		}
+	}
+
+	header = fb_message(&ex->meta, ARROW_HEADER_RECORD_BATCH, ex->body.len);
+	fb_offset(&ex->meta, header, fb_record_batch(ex, count));
+	return message_write(ex);
+}
+
+
+
+
+/********************************** selection *********************************/
+
+static int arrow_selected(struct arrow_export *ex, struct epg_event *ev)
+{
+	if (ev->changed <= ex->since)
+		return 0;
+	if (ex->ranged &&
+	    ((ev->pub.start_time >= ex->params->to) ||
+	     ((ev->pub.start_time + (time_t) ev->pub.duration) <= ex->params->from)))
+		return 0;
+	return 1;
+}
+
+static int service_compare(const void *a, const void *b)
+{
+	const struct epg_service *sa = *(struct epg_service * const *) a;
+	const struct epg_service *sb = *(struct epg_service * const *) b;
+
+	if (sa->key < sb->key)
+		return -1;
+	return sa->key > sb->key;
+}
+
+/* whether an event's language is a language code */
+static int arrow_language(const struct dvbepg_event *ev)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		char c = ev->language[i];
+
+		if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))))
+			return 0;
+	}
+	return 1;
+}
+
+/* number the titles or the texts of the rows, each distinct string once */
+static void number_strings(struct arrow_export *ex, int dict)
+{
+	struct arrow_values *d = &ex->dicts[dict];
+	struct epg_string *s;
+	uint32_t i;
+
+	for (i = 0; i < ex->row_count; i++) {
+		struct dvbepg_event *ev = &ex->rows[i].ev->pub;
+
+		if (ev->title)
+			epg_string_of(ev->title)->index = ARROW_NO_STRING;
+		if (ev->text)
+			epg_string_of(ev->text)->index = ARROW_NO_STRING;
+	}
+
+	for (i = 0; i < ex->row_count; i++) {
+		struct arrow_row *row = &ex->rows[i];
+		const char *str = (dict == DICT_TITLE) ? row->ev->pub.title : row->ev->pub.text;
+
+		row->index[dict] = -1;
+		if (str == NULL)
+			continue;
+		s = epg_string_of(str);
+		if (s->index == ARROW_NO_STRING) {
+			s->index = d->count;
+			d->stored[d->count++] = str;
+		}
+		row->index[dict] = s->index;
+	}
+}
+
+static void number_language(struct arrow_export *ex, struct arrow_row *row)
+{
+	struct arrow_values *d = &ex->dicts[DICT_LANGUAGE];
+	uint32_t i;
+
+	row->index[DICT_LANGUAGE] = -1;
+	if (!arrow_language(&row->ev->pub))
+		return;
+
+	// there are only ever a few
+	for (i = 0; i < d->count; i++) {
+		if (!memcmp(d->values[i], row->ev->pub.language, 3))
+			break;
+	}
+	if (i == d->count)
+		d->values[d->count++] = (char *) row->ev->pub.language;
+	row->index[DICT_LANGUAGE] = i;
+}
+
+/* pick the events to export, and build the dictionaries */
+static int arrow_select(struct arrow_export *ex)
+{
+	struct dvbepg *epg = ex->epg;
+	const struct dvbepg_export_params *params = ex->params;
+	struct arrow_values *channels = &ex->dicts[DICT_CHANNEL];
+	struct arrow_values *names = &ex->dicts[DICT_NAME];
+	struct epg_service *svc;
+	uint32_t bucket;
+	uint32_t rows = 0;
+	uint32_t count = 0;
+	uint32_t i;
+	uint32_t e;
+
+	if ((ex->services = malloc((epg->service_count + 1) * sizeof(struct epg_service *))) == NULL)
+		return -ENOMEM;
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		for (svc = epg->services[bucket]; svc; svc = svc->next)
+			ex->services[ex->service_count++] = svc;
+	}
+	qsort(ex->services, ex->service_count, sizeof(struct epg_service *), service_compare);
+
+	// a service without events to export has no rows, so is left out
+	for (i = 0; i < ex->service_count; i++) {
+		uint32_t n = 0;
+
+		svc = ex->services[i];
+		for (e = 0; e < svc->event_count; e++)
+			n += arrow_selected(ex, svc->events[e]);
+		if (n)
+			ex->services[count++] = svc;
+		rows += n;
+	}
+	ex->service_count = count;
+
+	if (((ex->rows = malloc((rows + 1) * sizeof(struct arrow_row))) == NULL) ||
+	    ((channels->values = calloc(count + 1, sizeof(char *))) == NULL) ||
+	    ((names->values = calloc(count + 1, sizeof(char *))) == NULL) ||
+	    ((ex->dicts[DICT_LANGUAGE].values = malloc((rows + 1) * sizeof(char *))) == NULL) ||
+	    ((ex->dicts[DICT_TITLE].stored = malloc((rows + 1) * sizeof(char *))) == NULL) ||
+	    ((ex->dicts[DICT_TEXT].stored = malloc((rows + 1) * sizeof(char *))) == NULL))
+		return -ENOMEM;
+
+	for (i = 0; i < ex->service_count; i++) {
+		const char *name = NULL;
+		char id[32];
+		int32_t name_index = -1;
+
+		svc = ex->services[i];
+		if (svc->id.source == DVBEPG_SOURCE_ATSC)
+			sprintf(id, "%u.%u.atsc", svc->id.transport_stream_id, svc->id.service_id);
+		else
+			sprintf(id, "%u.%u.%u.dvb", svc->id.network_id,
+				svc->id.transport_stream_id, svc->id.service_id);
+		if ((channels->values[channels->count++] = strdup(id)) == NULL)
+			return -ENOMEM;
+		if (params->service_name)
+			name = params->service_name(params->private_data, &svc->id);
+		if (name) {
+			if ((names->values[names->count] = strdup(name)) == NULL)
+				return -ENOMEM;
+			name_index = names->count++;
+		}
+
+		for (e = 0; e < svc->event_count; e++) {
+			struct arrow_row *row = &ex->rows[ex->row_count];
+
+			if (!arrow_selected(ex, svc->events[e]))
+				continue;
+			row->ev = svc->events[e];
+			row->service = i;
+			row->index[DICT_CHANNEL] = i;
+			row->index[DICT_NAME] = name_index;
+			number_language(ex, row);
+			ex->row_count++;
+		}
+	}
+
+	number_strings(ex, DICT_TITLE);
+	number_strings(ex, DICT_TEXT);
+	return 0;
+}
+
+
+
+
+/*********************************** export ***********************************/
+
+int epg_export_arrow(struct dvbepg *epg, int fd, const struct dvbepg_export_params *params)
+{
+	struct arrow_export ex;
+	uint8_t eos[8];
+	uint32_t i;
+	int ret;
+
+	memset(&ex, 0, sizeof(ex));
+	ex.epg = epg;
+	ex.params = params;
+	ex.since = (params->since <= epg->changes) ? params->since : 0;
+	ex.ranged = params->from || params->to;
+	ex.fd = fd;
+
+	if ((ret = arrow_select(&ex)) != 0)
+		goto out;
+	if ((ret = write_schema(&ex)) != 0)
+		goto out;
+	for (i = 0; i < DICT_COUNT; i++) {
+		if ((ret = write_dictionary(&ex, i)) != 0)
+			goto out;
+	}
+	for (i = 0; i < ex.row_count; i += ARROW_BATCH_ROWS) {
+		uint32_t count = ex.row_count - i;
+
+		if (count > ARROW_BATCH_ROWS)
+			count = ARROW_BATCH_ROWS;
+		if ((ret = write_batch(&ex, i, count)) != 0)
+			goto out;
+	}
+	put_le(eos, 0xffffffff, 4);
+	put_le(eos + 4, 0, 4);
+	ret = write_all(fd, eos, sizeof(eos));
+
+out:
+	for (i = 0; i < ex.dicts[DICT_CHANNEL].count; i++)
+		free(ex.dicts[DICT_CHANNEL].values[i]);
+	for (i = 0; i < ex.dicts[DICT_NAME].count; i++)
+		free(ex.dicts[DICT_NAME].values[i]);
+	for (i = 0; i < DICT_COUNT; i++) {
+		free(ex.dicts[i].values);
+		free(ex.dicts[i].stored);
+	}
+	free(ex.services);
+	free(ex.rows);
+	free(ex.meta.data);
+	free(ex.body.data);
+	free(ex.nodes.data);
+	free(ex.buffers.data);
+	free(ex.strings.data);
+	free(ex.plain);
+	return ret;
+}
@@ -0,0 +1,472 @@
+/*
+ * dvbepg - in-memory EPG store
+ * shared dictionary for event strings
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dvbepg_dict.h"
+
+#define DICT_HASH_BITS 12
+#define DICT_NONE 0xffff
+#define DICT_SAMPLE_SIZE (1024 * 1024)	/* most text to train on */
+#define DICT_MAX_WORDS 6		/* longest run of words tried as an entry */
+
+struct dvbepg_dict {
+	uint32_t count;
+	uint32_t *offset;		/* of each entry in data, and of the end */
+	uint8_t *data;
+
+	/* entries by their first three bytes, longest first */
+	uint16_t head[1 << DICT_HASH_BITS];
+	uint16_t *next;
+};
+
+/* a substring of the training sample */
+struct candidate {
+	uint32_t pos;
+	uint32_t hash;
+	uint32_t count;
+	uint8_t len;
+};
+
+struct candidates {
+	struct candidate *slots;
+	uint32_t size;			/* power of two */
+	uint32_t used;
+};
+
+static uint32_t hash3(const uint8_t *p)
+{
+	return ((((uint32_t) p[0] << 16) | ((uint32_t) p[1] << 8) | p[2]) * 2654435761U) >>
+		(32 - DICT_HASH_BITS);
+}
+
+static uint32_t entry_len(struct dvbepg_dict *dict, uint32_t index)
+{
+	return dict->offset[index + 1] - dict->offset[index];
+}
+
+static struct dvbepg_dict *dict_alloc(uint32_t count, uint32_t size)
+{
+	struct dvbepg_dict *dict;
+
+	if ((dict = calloc(1, sizeof(struct dvbepg_dict))) == NULL)
+		return NULL;
+	dict->offset = malloc((count + 1) * sizeof(uint32_t));
+	dict->data = malloc(size ? size : 1);
+	dict->next = malloc((count ? count : 1) * sizeof(uint16_t));
+	if ((dict->offset == NULL) || (dict->data == NULL) || (dict->next == NULL)) {
+		dvbepg_dict_destroy(dict);
+		return NULL;
+	}
+	dict->offset[0] = 0;
+	return dict;
+}
+
+/* link the entries into the lookup chains, so each chain runs longest first */
+static void dict_index(struct dvbepg_dict *dict)
+{
+	uint32_t len;
+	uint32_t i;
+
+	memset(dict->head, 0xff, sizeof(dict->head));
+	for (len = DVBEPG_DICT_MIN_LEN; len <= DVBEPG_DICT_MAX_LEN; len++) {
+		for (i = 0; i < dict->count; i++) {
+			uint32_t bucket;
+
+			if (entry_len(dict, i) != len)
+				continue;
+			bucket = hash3(dict->data + dict->offset[i]);
+			dict->next[i] = dict->head[bucket];
+			dict->head[bucket] = i;
+		}
+	}
+}
+
+struct dvbepg_dict *dvbepg_dict_create(const uint8_t *data, const uint8_t *lens, uint32_t count)
+{
+	struct dvbepg_dict *dict;
+	uint32_t size = 0;
+	uint32_t i;
+
+	if (count > DVBEPG_DICT_MAX_ENTRIES)
+		return NULL;
+	for (i = 0; i < count; i++) {
+		if ((lens[i] < DVBEPG_DICT_MIN_LEN) || (lens[i] > DVBEPG_DICT_MAX_LEN))
+			return NULL;
+		size += lens[i];
+	}
+
+	if ((dict = dict_alloc(count, size)) == NULL)
+		return NULL;
+	memcpy(dict->data, data, size);
+	for (i = 0; i < count; i++)
+		dict->offset[i + 1] = dict->offset[i] + lens[i];
+	dict->count = count;
+	dict_index(dict);
+	return dict;
+}
+
+void dvbepg_dict_destroy(struct dvbepg_dict *dict)
+{
+	if (dict == NULL)
+		return;
+	free(dict->offset);
+	free(dict->data);
+	free(dict->next);
+	free(dict);
+}
+
+uint32_t dvbepg_dict_count(struct dvbepg_dict *dict)
+{
+	return dict->count;
+}
+
+size_t dvbepg_dict_size(struct dvbepg_dict *dict)
+{
+	return sizeof(struct dvbepg_dict) + dict->offset[dict->count] +
+		((dict->count + 1) * sizeof(uint32_t)) + (dict->count * sizeof(uint16_t));
+}
+
+const uint8_t *dvbepg_dict_entry(struct dvbepg_dict *dict, uint32_t index, uint8_t *len)
+{
+	*len = entry_len(dict, index);
+	return dict->data + dict->offset[index];
+}
+
+size_t dvbepg_dict_encode(struct dvbepg_dict *dict, const char *in, size_t len, char *out)
+{
+	const uint8_t *p = (const uint8_t *) in;
+	uint8_t *o = (uint8_t *) out;
+	size_t i = 0;
+
+	while (i < len) {
+		if (dict->count && ((len - i) >= DVBEPG_DICT_MIN_LEN)) {
+			uint32_t e;
+			uint32_t elen = 0;
+
+			for (e = dict->head[hash3(p + i)]; e != DICT_NONE; e = dict->next[e]) {
+				elen = entry_len(dict, e);
+				if ((elen <= (len - i)) && !memcmp(dict->data + dict->offset[e], p + i, elen))
+					break;
+			}
+			if (e != DICT_NONE) {
+				*o++ = 0xf8 + (e / 255);
+				*o++ = 1 + (e % 255);
+				i += elen;
+				continue;
+			}
+		}
+
+		if (p[i] >= 0xf8)
+			*o++ = 0xff;
+		*o++ = p[i++];
+	}
+	*o = '\0';
+
+	return o - (uint8_t *) out;
+}
+
+size_t dvbepg_dict_decode(struct dvbepg_dict *dict, const char *in, char *out, size_t size)
+{
+	const uint8_t *p = (const uint8_t *) in;
+	size_t pos = 0;
+
+	while (*p) {
+		const uint8_t *src = p;
+		size_t n = 1;
+
+		if ((*p >= 0xf8) && p[1]) {
+			if (*p == 0xff) {
+				src = p + 1;
+			} else {
+				uint32_t e = ((p[0] - 0xf8) * 255) + (p[1] - 1);
+
+				src = dict->data + dict->offset[e];
+				n = entry_len(dict, e);
+			}
+			p += 2;
+		} else {
+			p++;
+		}
+
+		if ((pos + n) < size) {
+			memcpy(out + pos, src, n);
+		} else if (pos < size) {
+			memcpy(out + pos, src, size - pos - 1);
+		}
+		pos += n;
+	}
+	if (size)
+		out[(pos < size) ? pos : (size - 1)] = '\0';
+
+	return pos;
+}
+
+int dvbepg_dict_check(struct dvbepg_dict *dict, const char *in)
+{
+	const uint8_t *p = (const uint8_t *) in;
+
+	while (*p) {
+		if (*p < 0xf8) {
+			p++;
+			continue;
+		}
+		if (p[1] == '\0')
+			return -1;
+		if ((*p != 0xff) && ((uint32_t) (((p[0] - 0xf8) * 255) + (p[1] - 1)) >= dict->count))
+			return -1;
+		p += 2;
+	}
+	return 0;
+}
+
+
+
+
+/********************************** training **********************************/
+
+static uint32_t hash_bytes(const uint8_t *p, size_t len)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= p[i];
+		hash *= 16777619U;
+	}
+	return hash;
+}
+
+static int candidates_grow(struct candidates *c)
+{
+	uint32_t size = c->size ? c->size * 2 : 65536;
+	struct candidate *slots;
+	uint32_t i;
+
+	if ((slots = calloc(size, sizeof(struct candidate))) == NULL)
+		return -1;
+	for (i = 0; i < c->size; i++) {
+		uint32_t slot;
+
+		if (c->slots[i].count == 0)
+			continue;
+		for (slot = c->slots[i].hash & (size - 1); slots[slot].count; slot = (slot + 1) & (size - 1))
+			;
+		slots[slot] = c->slots[i];
+	}
+	free(c->slots);
+	c->slots = slots;
+	c->size = size;
+	return 0;
+}
+
+static int candidates_add(struct candidates *c, const uint8_t *sample, uint32_t pos, uint32_t len)
+{
+	uint32_t hash = hash_bytes(sample + pos, len);
+	uint32_t slot;
+
+	if (((c->used + 1) * 3 >= c->size * 2) && candidates_grow(c))
+		return -1;
+
+	for (slot = hash & (c->size - 1); c->slots[slot].count; slot = (slot + 1) & (c->size - 1)) {
+		struct candidate *cand = &c->slots[slot];
+
+		if ((cand->hash == hash) && (cand->len == len) &&
+		    !memcmp(sample + cand->pos, sample + pos, len)) {
+			cand->count++;
+			return 0;
+		}
+	}
+	c->slots[slot].pos = pos;
+	c->slots[slot].hash = hash;
+	c->slots[slot].len = len;
+	c->slots[slot].count = 1;
+	c->used++;
+	return 0;
+}
+
+/* every run of up to DICT_MAX_WORDS whole words (with the space after them) */
+static int candidates_scan(struct candidates *c, const uint8_t *sample, uint32_t start, uint32_t end)
+{
+	uint32_t pos;
+
+	for (pos = start; pos < end; pos++) {
+		uint32_t cur = pos;
+		int words;
+
+		if ((sample[pos] == ' ') || ((pos > start) && (sample[pos - 1] != ' ')))
+			continue;
+
+		for (words = 0; words < DICT_MAX_WORDS; words++) {
+			while ((cur < end) && (sample[cur] != ' '))
+				cur++;
+			if ((cur < end) && (sample[cur] == ' '))
+				cur++;
+			if ((cur - pos) > DVBEPG_DICT_MAX_LEN)
+				break;
+			if (((cur - pos) >= DVBEPG_DICT_MIN_LEN) && candidates_add(c, sample, pos, cur - pos))
+				return -1;
+			if (cur == end)
+				break;
+		}
+	}
+	return 0;
+}
+
+/* bytes an entry saves over the sample, less what it costs to keep */
+static int64_t candidate_score(const struct candidate *cand)
+{
+	return ((int64_t) (cand->len - 2) * cand->count) - cand->len;
+}
+
+static int candidate_cmp(const void *a, const void *b)
+{
+	int64_t sa = candidate_score(a);
+	int64_t sb = candidate_score(b);
+
+	if (sa != sb)
+		return (sa > sb) ? -1 : 1;
+	return 0;
+}
+
+static struct dvbepg_dict *dict_from_candidates(const uint8_t *sample,
+						const struct candidate *cands, uint32_t count)
+{
+	struct dvbepg_dict *dict;
+	uint32_t size = 0;
+	uint32_t i;
+
+	for (i = 0; i < count; i++)
+		size += cands[i].len;
+	if ((dict = dict_alloc(count, size)) == NULL)
+		return NULL;
+	for (i = 0; i < count; i++) {
+		memcpy(dict->data + dict->offset[i], sample + cands[i].pos, cands[i].len);
+		dict->offset[i + 1] = dict->offset[i] + cands[i].len;
+	}
+	dict->count = count;
+	dict_index(dict);
+	return dict;
+}
+
+/*
+ * Count how often each entry is really used when the sample is encoded: runs
+ * of words overlap, so the first guess at each one's worth is too high.
+ */
+static void dict_usage(struct dvbepg_dict *dict, const uint8_t *sample, uint32_t size,
+		       uint32_t *uses)
+{
+	uint32_t pos = 0;
+
+	while (pos < size) {
+		uint32_t e = DICT_NONE;
+		uint32_t elen = 0;
+
+		if ((size - pos) >= DVBEPG_DICT_MIN_LEN) {
+			for (e = dict->head[hash3(sample + pos)]; e != DICT_NONE; e = dict->next[e]) {
+				elen = entry_len(dict, e);
+				if ((elen <= (size - pos)) &&
+				    !memcmp(dict->data + dict->offset[e], sample + pos, elen))
+					break;
+			}
+		}
+		if (e != DICT_NONE) {
+			uses[e]++;
+			pos += elen;
+		} else {
+			pos++;
+		}
+	}
+}
+
+struct dvbepg_dict *dvbepg_dict_train(const char **strings, uint32_t count, uint32_t max_entries)
+{
+	struct candidates c;
+	struct candidate *best = NULL;
+	struct dvbepg_dict *dict = NULL;
+	uint8_t *sample = NULL;
+	uint32_t *uses = NULL;
+	uint64_t total = 0;
+	uint32_t sample_size = 0;
+	uint32_t stride;
+	uint32_t best_count = 0;
+	uint32_t kept;
+	uint32_t i;
+
+	if (max_entries > DVBEPG_DICT_MAX_ENTRIES)
+		max_entries = DVBEPG_DICT_MAX_ENTRIES;
+	memset(&c, 0, sizeof(c));
+
+	// a spread of the strings, as much as fits the sample, each ended by a 0
+	for (i = 0; i < count; i++)
+		total += strlen(strings[i]) + 1;
+	stride = (total / DICT_SAMPLE_SIZE) + 1;
+	if (((sample = malloc(DICT_SAMPLE_SIZE)) == NULL) || candidates_grow(&c))
+		goto out;
+	for (i = 0; i < count; i += stride) {
+		size_t len = strlen(strings[i]);
+
+		if ((sample_size + len + 1) > DICT_SAMPLE_SIZE)
+			break;
+		memcpy(sample + sample_size, strings[i], len + 1);
+		if (candidates_scan(&c, sample, sample_size, sample_size + len))
+			goto out;
+		sample_size += len + 1;
+	}
+
+	// the best candidates worth keeping
+	if ((best = malloc((c.used ? c.used : 1) * sizeof(struct candidate))) == NULL)
+		goto out;
+	for (i = 0; i < c.size; i++) {
+		if ((c.slots[i].count >= 2) && (candidate_score(&c.slots[i]) > 0))
+			best[best_count++] = c.slots[i];
+	}
+	qsort(best, best_count, sizeof(struct candidate), candidate_cmp);
+	if (best_count > max_entries)
+		best_count = max_entries;
+
+	// then drop those the others leave little use for
+	if ((dict = dict_from_candidates(sample, best, best_count)) == NULL)
+		goto out;
+	if ((uses = calloc(best_count ? best_count : 1, sizeof(uint32_t))) == NULL) {
+		dvbepg_dict_destroy(dict);
+		dict = NULL;
+		goto out;
+	}
+	dict_usage(dict, sample, sample_size, uses);
+	for (i = 0, kept = 0; i < best_count; i++) {
+		best[i].count = uses[i];
+		if ((uses[i] >= 2) && (candidate_score(&best[i]) > 0))
+			best[kept++] = best[i];
+	}
+	if (kept != best_count) {
+		dvbepg_dict_destroy(dict);
+		dict = dict_from_candidates(sample, best, kept);
+	}
+
+out:
+	free(c.slots);
+	free(best);
+	free(uses);
+	free(sample);
+	return dict;
+}
@@ -0,0 +1,112 @@
+/*
+ * dvbepg - in-memory EPG store
+ * shared dictionary for event strings
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DVBEPG_DICT_H
+#define DVBEPG_DICT_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A dictionary of substrings which come up over and over in event titles and
+ * texts ("Followed by", "(Subtitled)", the name of a series...). An encoded
+ * string is each byte of the string as it is, except where a dictionary entry
+ * was found: that becomes a two byte code. Codes use bytes which never start
+ * a UTF-8 sequence:
+ *
+ *   0x00-0xf7			the byte itself
+ *   0xf8-0xfe, 0x01-0xff	entry ((first - 0xf8) * 255) + (second - 1)
+ *   0xff, byte			the byte itself (for the rare 0xf8-0xff in text)
+ *
+ * An encoded string never holds a zero byte, so it is still a C string and
+ * can be interned as one; and each string decodes on its own, by copying.
+ */
+#define DVBEPG_DICT_MAX_ENTRIES (7 * 255)
+#define DVBEPG_DICT_MIN_LEN 3		/* shorter entries would save nothing */
+#define DVBEPG_DICT_MAX_LEN 64
+
+struct dvbepg_dict;
+
+/**
+ * Train a dictionary on a sample of strings.
+ *
+ * @param strings The strings.
+ * @param count Number of strings.
+ * @param max_entries Most entries to keep, up to DVBEPG_DICT_MAX_ENTRIES.
+ * @return The dictionary (which may have no entries), or NULL if out of memory.
+ */
+extern struct dvbepg_dict *dvbepg_dict_train(const char **strings, uint32_t count,
+					     uint32_t max_entries);
+
+/**
+ * Create a dictionary from its entries, as kept in a snapshot.
+ *
+ * @param data The entries, one after the other.
+ * @param lens Length of each entry.
+ * @param count Number of entries.
+ * @return The dictionary, or NULL if the entries are not valid or out of memory.
+ */
+extern struct dvbepg_dict *dvbepg_dict_create(const uint8_t *data, const uint8_t *lens,
+					      uint32_t count);
+
+extern void dvbepg_dict_destroy(struct dvbepg_dict *dict);
+
+/**
+ * @return Number of entries in the dictionary.
+ */
+extern uint32_t dvbepg_dict_count(struct dvbepg_dict *dict);
+
+/**
+ * @return Bytes of memory the dictionary takes.
+ */
+extern size_t dvbepg_dict_size(struct dvbepg_dict *dict);
+
+/**
+ * Get an entry.
+ *
+ * @param dict The dictionary.
+ * @param index Entry number.
+ * @param len Where to put the length of the entry.
+ * @return The bytes of the entry.
+ */
+extern const uint8_t *dvbepg_dict_entry(struct dvbepg_dict *dict, uint32_t index, uint8_t *len);
+
+/**
+ * Encode a string. The output needs room for (len * 2) + 1 bytes.
+ *
+ * @return Length of the encoded string, which is zero terminated.
+ */
+extern size_t dvbepg_dict_encode(struct dvbepg_dict *dict, const char *in, size_t len, char *out);
+
+/**
+ * Decode a string, like snprintf(): at most size bytes are written, zero
+ * terminated, and the length of the whole decoded string is returned.
+ */
+extern size_t dvbepg_dict_decode(struct dvbepg_dict *dict, const char *in, char *out, size_t size);
+
+/**
+ * Check an encoded string only refers to entries in the dictionary.
+ *
+ * @return 0 if it does, -1 if not.
+ */
+extern int dvbepg_dict_check(struct dvbepg_dict *dict, const char *in);
+
+#endif
@@ -0,0 +1,873 @@
+/*
+ * dvbepg - in-memory EPG store
+ * XMLTV and JSON export (Arrow is in dvbepg_arrow.c)
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "dvbepg.h"
+#include "dvbepg_dict.h"
+#include "dvbepg_int.h"
+
+/*
+ * An export goes in four steps:
+ *
+ *  1. the services are sorted, and the strings of the events to export are
+ *     numbered, each once (by the calling thread);
+ *  2. the threads split the strings between them and escape each into an
+ *     arena of their own;
+ *  3. the threads take services one at a time and format their events into
+ *     a buffer per service, which is only copying the escaped strings;
+ *  4. meanwhile the calling thread writes the buffers out in order, through
+ *     an output buffer so each write is large.
+ *
+ * None of it changes the store but for the numbers of the strings, so
+ * decoding the strings with the dictionary, which only reads it, is safe
+ * from any thread.
+ */
+
+#define EXPORT_MAX_THREADS 32
+#define EXPORT_WINDOW 4			/* services formatted ahead of the writer, per thread */
+#define EXPORT_WRITE_SIZE (1024 * 1024)	/* bytes written at once */
+#define EXPORT_NO_STRING 0xffffffff
+
+struct export_buf {
+	char *data;
+	size_t len;
+	size_t alloc;
+};
+
+/* a string as it goes into the output */
+struct export_string {
+	const char *str;
+	uint32_t offset;		/* into the arena of the thread which escaped it */
+	uint32_t len;
+};
+
+struct export_service {
+	struct epg_service *svc;
+	char id[32];			/* channel id, already safe in XML and JSON */
+	uint32_t events;		/* to export */
+	struct export_buf out;
+	int done;
+};
+
+struct export {
+	struct dvbepg *epg;
+	const struct dvbepg_export_params *params;
+	uint32_t since;
+	int ranged;
+
+	struct export_service *services;
+	uint32_t service_count;
+
+	const char **strings;		/* stored strings, by number */
+	struct export_string *escaped;
+	uint32_t string_count;
+
+	int thread_count;
+	pthread_mutex_t lock;
+	pthread_cond_t ready;		/* a service was formatted */
+	pthread_cond_t space;		/* one was written */
+	uint32_t next;			/* next service to format */
+	uint32_t written;
+	int err;
+};
+
+struct export_thread {
+	struct export *ex;
+	int index;
+	pthread_t thread;
+	struct export_buf arena;
+	char *plain;			/* scratch for decoding */
+	size_t plain_size;
+};
+
+
+
+
+/********************************** buffers ***********************************/
+
+static int buf_reserve(struct export_buf *b, size_t len)
+{
+	size_t alloc;
+	char *data;
+
+	if (b->len + len <= b->alloc)
+		return 0;
+	alloc = b->alloc ? b->alloc : 4096;
+	while (alloc < b->len + len)
+		alloc *= 2;
+	if ((data = realloc(b->data, alloc)) == NULL)
+		return -ENOMEM;
+	b->data = data;
+	b->alloc = alloc;
+	return 0;
+}
+
+/* callers reserve first: these do not check */
+static inline void buf_put(struct export_buf *b, const char *str, size_t len)
+{
+	memcpy(b->data + b->len, str, len);
+	b->len += len;
+}
+
+#define buf_puts(b, s) buf_put((b), (s), sizeof(s) - 1)
+
+static void buf_put_uint(struct export_buf *b, uint64_t v)
+{
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + (v % 10);
+		v /= 10;
+	} while (v);
+	while (n)
+		b->data[b->len++] = digits[--n];
+}
+
+static void buf_put_digits(struct export_buf *b, unsigned int v, int width)
+{
+	int i;
+
+	for (i = width - 1; i >= 0; i--) {
+		b->data[b->len + i] = '0' + (v % 10);
+		v /= 10;
+	}
+	b->len += width;
+}
+
+/* an XMLTV time: YYYYMMDDhhmmss +0000 */
+static void buf_put_xmltv_time(struct export_buf *b, time_t t)
+{
+	int64_t days = t / 86400;
+	int64_t secs = t % 86400;
+	int64_t era;
+	uint32_t doe, yoe, doy, mp;
+	int64_t year;
+	unsigned int month, day;
+
+	if (secs < 0) {
+		secs += 86400;
+		days--;
+	}
+
+	// days to the civil calendar, counting from 0000-03-01
+	days += 719468;
+	era = ((days >= 0) ? days : (days - 146096)) / 146097;
+	doe = days - (era * 146097);
+	yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+	doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+	mp = ((5 * doy) + 2) / 153;
+	day = doy - (((153 * mp) + 2) / 5) + 1;
+	month = (mp < 10) ? (mp + 3) : (mp - 9);
+	year = yoe + (era * 400) + (month <= 2);
+	if (year < 0)
+		year = 0;
+
+	buf_put_digits(b, year, 4);
+	buf_put_digits(b, month, 2);
+	buf_put_digits(b, day, 2);
+	buf_put_digits(b, secs / 3600, 2);
+	buf_put_digits(b, (secs / 60) % 60, 2);
+	buf_put_digits(b, secs % 60, 2);
+	buf_puts(b, " +0000");
+}
+
+static int write_all(int fd, const char *data, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(fd, data, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += ret;
+		len -= ret;
+	}
+	return 0;
+}
+
+
+
+
+/********************************** escaping **********************************/
+
+/* the most one byte of a string can become */
+#define ESCAPE_MAX 6
+
+/* escape text for XML; control characters XML cannot hold are dropped */
+static size_t escape_xml(char *out, const char *in, size_t len)
+{
+	char *start = out;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		uint8_t c = in[i];
+
+		switch (c) {
+		case '&':
+			memcpy(out, "&amp;", 5);
+			out += 5;
+			break;
+		case '<':
+			memcpy(out, "&lt;", 4);
+			out += 4;
+			break;
+		case '>':
+			memcpy(out, "&gt;", 4);
+			out += 4;
+			break;
+		case '"':
+			memcpy(out, "&quot;", 6);
+			out += 6;
+			break;
+		default:
+			if ((c >= 0x20) || (c == '\t') || (c == '\n') || (c == '\r'))
+				*out++ = c;
+			break;
+		}
+	}
+	return out - start;
+}
+
+static size_t escape_json(char *out, const char *in, size_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	char *start = out;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		uint8_t c = in[i];
+
+		if ((c == '"') || (c == '\\')) {
+			*out++ = '\\';
+			*out++ = c;
+		} else if (c == '\n') {
+			*out++ = '\\';
+			*out++ = 'n';
+		} else if (c == '\t') {
+			*out++ = '\\';
+			*out++ = 't';
+		} else if (c < 0x20) {
+			memcpy(out, "\\u00", 4);
+			out[4] = hex[c >> 4];
+			out[5] = hex[c & 0xf];
+			out += 6;
+		} else {
+			*out++ = c;
+		}
+	}
+	return out - start;
+}
+
+static size_t escape(enum dvbepg_export_format format, char *out, const char *in, size_t len)
+{
+	if (format == DVBEPG_EXPORT_JSON)
+		return escape_json(out, in, len);
+	return escape_xml(out, in, len);
+}
+
+/* escape a share of the strings into the thread's arena */
+static int escape_strings(struct export_thread *t)
+{
+	struct export *ex = t->ex;
+	struct dvbepg_dict *dict = ex->epg->dict;
+	uint32_t first = ((uint64_t) ex->string_count * t->index) / ex->thread_count;
+	uint32_t last = ((uint64_t) ex->string_count * (t->index + 1)) / ex->thread_count;
+	uint32_t i;
+
+	for (i = first; i < last; i++) {
+		const char *plain = ex->strings[i];
+		size_t len;
+
+		if (dict) {
+			len = dvbepg_dict_decode(dict, ex->strings[i], t->plain, t->plain_size);
+			if (len >= t->plain_size) {
+				char *p = realloc(t->plain, len + 1);
+
+				if (p == NULL)
+					return -ENOMEM;
+				t->plain = p;
+				t->plain_size = len + 1;
+				dvbepg_dict_decode(dict, ex->strings[i], p, len + 1);
+			}
+			plain = t->plain;
+		} else {
+			len = strlen(plain);
+		}
+
+		if ((len * ESCAPE_MAX > UINT32_MAX - t->arena.len) ||
+		    buf_reserve(&t->arena, len * ESCAPE_MAX))
+			return -ENOMEM;
+		ex->escaped[i].offset = t->arena.len;
+		ex->escaped[i].len = escape(ex->params->format, t->arena.data + t->arena.len, plain, len);
+		t->arena.len += ex->escaped[i].len;
+	}
+
+	// the arena is not moved any more
+	for (i = first; i < last; i++)
+		ex->escaped[i].str = t->arena.data + ex->escaped[i].offset;
+	return 0;
+}
+
+
+
+
+/********************************* formatting *********************************/
+
+static int export_selected(struct export *ex, struct epg_event *ev)
+{
+	if (ev->changed <= ex->since)
+		return 0;
+	if (ex->ranged &&
+	    ((ev->pub.start_time >= ex->params->to) ||
+	     ((ev->pub.start_time + (time_t) ev->pub.duration) <= ex->params->from)))
+		return 0;
+	return 1;
+}
+
+static const struct export_string *export_string(struct export *ex, const char *str)
+{
+	if (str == NULL)
+		return NULL;
+	return &ex->escaped[epg_string_of(str)->index];
+}
+
+/* a language code, if it is one */
+static int export_language(const struct dvbepg_event *ev)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		char c = ev->language[i];
+
+		if (!(((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z'))))
+			return 0;
+	}
+	return 1;
+}
+
+static void format_xmltv_text(struct export_buf *b, const char *tag, size_t tag_len,
+			      const struct dvbepg_event *ev, const struct export_string *s)
+{
+	buf_put(b, "    <", 5);
+	buf_put(b, tag, tag_len);
+	if (export_language(ev)) {
+		buf_puts(b, " lang=\"");
+		buf_put(b, ev->language, 3);
+		buf_puts(b, "\"");
+	}
+	buf_puts(b, ">");
+	if (s)
+		buf_put(b, s->str, s->len);
+	buf_puts(b, "</");
+	buf_put(b, tag, tag_len);
+	buf_puts(b, ">\n");
+}
+
+static void format_xmltv(struct export_service *es, struct epg_event *ev,
+			 const struct export_string *title, const struct export_string *text)
+{
+	struct export_buf *b = &es->out;
+
+	buf_puts(b, "  <programme start=\"");
+	buf_put_xmltv_time(b, ev->pub.start_time);
+	buf_puts(b, "\" stop=\"");
+	buf_put_xmltv_time(b, ev->pub.start_time + (time_t) ev->pub.duration);
+	buf_puts(b, "\" channel=\"");
+	buf_put(b, es->id, strlen(es->id));
+	buf_puts(b, "\">\n");
+	format_xmltv_text(b, "title", 5, &ev->pub, title);
+	if (text)
+		format_xmltv_text(b, "desc", 4, &ev->pub, text);
+	buf_puts(b, "  </programme>\n");
+}
+
+static void format_json(struct export_service *es, struct epg_event *ev,
+			const struct export_string *title, const struct export_string *text)
+{
+	struct export_buf *b = &es->out;
+
+	// the writer drops the comma before the first programme
+	buf_puts(b, ",\n{\"channel\":\"");
+	buf_put(b, es->id, strlen(es->id));
+	buf_puts(b, "\",\"event_id\":");
+	buf_put_uint(b, ev->pub.event_id);
+	buf_puts(b, ",\"start\":");
+	buf_put_uint(b, ev->pub.start_time);
+	buf_puts(b, ",\"stop\":");
+	buf_put_uint(b, ev->pub.start_time + (time_t) ev->pub.duration);
+	if (export_language(&ev->pub)) {
+		buf_puts(b, ",\"language\":\"");
+		buf_put(b, ev->pub.language, 3);
+		buf_puts(b, "\"");
+	}
+	if (title) {
+		buf_puts(b, ",\"title\":\"");
+		buf_put(b, title->str, title->len);
+		buf_puts(b, "\"");
+	}
+	if (text) {
+		buf_puts(b, ",\"text\":\"");
+		buf_put(b, text->str, text->len);
+		buf_puts(b, "\"");
+	}
+	buf_puts(b, "}");
+}
+
+static int format_service(struct export *ex, struct export_service *es)
+{
+	struct epg_service *svc = es->svc;
+	size_t id_len = strlen(es->id);
+	uint32_t i;
+
+	for (i = 0; i < svc->event_count; i++) {
+		struct epg_event *ev = svc->events[i];
+		const struct export_string *title;
+		const struct export_string *text;
+		size_t len = 256 + (3 * id_len);
+
+		if (!export_selected(ex, ev))
+			continue;
+		title = export_string(ex, ev->pub.title);
+		text = export_string(ex, ev->pub.text);
+		if (title)
+			len += title->len;
+		if (text)
+			len += text->len;
+		if (buf_reserve(&es->out, len))
+			return -ENOMEM;
+
+		if (ex->params->format == DVBEPG_EXPORT_JSON)
+			format_json(es, ev, title, text);
+		else
+			format_xmltv(es, ev, title, text);
+	}
+	return 0;
+}
+
+static void export_fail(struct export *ex, int err)
+{
+	pthread_mutex_lock(&ex->lock);
+	if (ex->err == 0)
+		ex->err = err;
+	pthread_cond_broadcast(&ex->ready);
+	pthread_cond_broadcast(&ex->space);
+	pthread_mutex_unlock(&ex->lock);
+}
+
+static void *escape_thread(void *arg)
+{
+	struct export_thread *t = arg;
+	int ret;
+
+	if ((ret = escape_strings(t)) != 0)
+		export_fail(t->ex, ret);
+	return NULL;
+}
+
+static void *format_thread(void *arg)
+{
+	struct export_thread *t = arg;
+	struct export *ex = t->ex;
+	uint32_t window = EXPORT_WINDOW * ex->thread_count;
+
+	for (;;) {
+		uint32_t i = __atomic_fetch_add(&ex->next, 1, __ATOMIC_SEQ_CST);
+		struct export_service *es;
+		int ret;
+
+		if (i >= ex->service_count)
+			break;
+		es = &ex->services[i];
+
+		// keep only so many buffers waiting for the writer
+		pthread_mutex_lock(&ex->lock);
+		while ((i >= ex->written + window) && !ex->err)
+			pthread_cond_wait(&ex->space, &ex->lock);
+		ret = ex->err;
+		pthread_mutex_unlock(&ex->lock);
+		if (ret)
+			break;
+
+		if ((ret = format_service(ex, es)) != 0) {
+			export_fail(ex, ret);
+			break;
+		}
+
+		pthread_mutex_lock(&ex->lock);
+		es->done = 1;
+		pthread_cond_broadcast(&ex->ready);
+		pthread_mutex_unlock(&ex->lock);
+	}
+	return NULL;
+}
+
+/* run a step on every thread; with one thread, on the caller's */
+static int export_run(struct export *ex, struct export_thread *threads, void *(*func)(void *))
+{
+	int i;
+
+	if (ex->thread_count == 1) {
+		func(&threads[0]);
+		return 0;
+	}
+
+	for (i = 0; i < ex->thread_count; i++) {
+		if (pthread_create(&threads[i].thread, NULL, func, &threads[i])) {
+			export_fail(ex, -EAGAIN);
+			while (i--)
+				pthread_join(threads[i].thread, NULL);
+			return -EAGAIN;
+		}
+	}
+	return 0;
+}
+
+static void export_join(struct export *ex, struct export_thread *threads)
+{
+	int i;
+
+	if (ex->thread_count == 1)
+		return;
+	for (i = 0; i < ex->thread_count; i++)
+		pthread_join(threads[i].thread, NULL);
+}
+
+
+
+
+/*********************************** output ***********************************/
+
+struct export_out {
+	int fd;
+	struct export_buf buf;
+	int first;			/* nothing listed yet (JSON commas) */
+};
+
+static int out_flush(struct export_out *out)
+{
+	int ret = write_all(out->fd, out->buf.data, out->buf.len);
+
+	out->buf.len = 0;
+	return ret;
+}
+
+static int out_put(struct export_out *out, const char *data, size_t len)
+{
+	int ret;
+
+	if (out->buf.len + len > EXPORT_WRITE_SIZE) {
+		if ((ret = out_flush(out)) != 0)
+			return ret;
+		// a big one goes out as it is
+		if (len >= EXPORT_WRITE_SIZE)
+			return write_all(out->fd, data, len);
+	}
+	if (buf_reserve(&out->buf, len))
+		return -ENOMEM;
+	buf_put(&out->buf, data, len);
+	return 0;
+}
+
+#define out_puts(out, s) out_put((out), (s), sizeof(s) - 1)
+
+/* add a string to the output, escaped */
+static int out_put_escaped(struct export_out *out, enum dvbepg_export_format format,
+			   const char *str)
+{
+	size_t len = strlen(str);
+
+	if (buf_reserve(&out->buf, len * ESCAPE_MAX))
+		return -ENOMEM;
+	out->buf.len += escape(format, out->buf.data + out->buf.len, str, len);
+	return 0;
+}
+
+static int out_channel(struct export *ex, struct export_out *out, struct export_service *es)
+{
+	enum dvbepg_export_format format = ex->params->format;
+	const char *name = NULL;
+	int ret;
+
+	if (ex->params->service_name)
+		name = ex->params->service_name(ex->params->private_data, &es->svc->id);
+	if (name == NULL)
+		name = es->id;
+
+	if (format == DVBEPG_EXPORT_JSON) {
+		if ((!out->first && (ret = out_puts(out, ","))) ||
+		    (ret = out_puts(out, "\n{\"id\":\"")) ||
+		    (ret = out_put(out, es->id, strlen(es->id))) ||
+		    (ret = out_puts(out, "\",\"name\":\"")) ||
+		    (ret = out_put_escaped(out, format, name)) ||
+		    (ret = out_puts(out, "\"}")))
+			return ret;
+	} else {
+		if ((ret = out_puts(out, "  <channel id=\"")) ||
+		    (ret = out_put(out, es->id, strlen(es->id))) ||
+		    (ret = out_puts(out, "\">\n    <display-name>")) ||
+		    (ret = out_put_escaped(out, format, name)) ||
+		    (ret = out_puts(out, "</display-name>\n  </channel>\n")))
+			return ret;
+	}
+	out->first = 0;
+	return 0;
+}
+
+/*
+ * Write the services out in order, as the threads format them; with one
+ * thread, format each here first.
+ */
+static int out_services(struct export *ex, struct export_out *out)
+{
+	uint32_t i;
+	int ret = 0;
+
+	out->first = 1;
+	for (i = 0; i < ex->service_count; i++) {
+		struct export_service *es = &ex->services[i];
+		size_t skip = 0;
+
+		if (ex->thread_count == 1) {
+			if ((ret = format_service(ex, es)) != 0)
+				return ret;
+		} else {
+			pthread_mutex_lock(&ex->lock);
+			while (!es->done && !ex->err)
+				pthread_cond_wait(&ex->ready, &ex->lock);
+			ret = ex->err;
+			pthread_mutex_unlock(&ex->lock);
+			if (ret)
+				return ret;
+		}
+
+		if (es->out.len) {
+			if (out->first && (ex->params->format == DVBEPG_EXPORT_JSON))
+				skip = 1;
+			out->first = 0;
+			if ((ret = out_put(out, es->out.data + skip, es->out.len - skip)) != 0) {
+				export_fail(ex, ret);
+				return ret;
+			}
+		}
+		free(es->out.data);
+		memset(&es->out, 0, sizeof(es->out));
+
+		pthread_mutex_lock(&ex->lock);
+		ex->written = i + 1;
+		pthread_cond_broadcast(&ex->space);
+		pthread_mutex_unlock(&ex->lock);
+	}
+	return 0;
+}
+
+
+
+
+/*********************************** export ***********************************/
+
+static int service_compare(const void *a, const void *b)
+{
+	const struct export_service *sa = a;
+	const struct export_service *sb = b;
+
+	if (sa->svc->key < sb->svc->key)
+		return -1;
+	return sa->svc->key > sb->svc->key;
+}
+
+static void export_number(struct export *ex, const char *str)
+{
+	struct epg_string *s;
+
+	if (str == NULL)
+		return;
+	s = epg_string_of(str);
+	if (s->index == EXPORT_NO_STRING) {
+		s->index = ex->string_count;
+		ex->strings[ex->string_count++] = str;
+	}
+}
+
+/* pick the services and events to export, and number their strings */
+static int export_select(struct export *ex)
+{
+	struct dvbepg *epg = ex->epg;
+	uint32_t bucket;
+	uint32_t i;
+	uint32_t j;
+	struct epg_string *s;
+	struct epg_service *svc;
+
+	if (((ex->services = calloc(epg->service_count + 1, sizeof(struct export_service))) == NULL) ||
+	    ((ex->strings = malloc((epg->string_count + 1) * sizeof(char *))) == NULL))
+		return -ENOMEM;
+
+	for (bucket = 0; bucket < epg->string_buckets; bucket++) {
+		for (s = epg->strings[bucket]; s; s = s->next)
+			s->index = EXPORT_NO_STRING;
+	}
+	for (bucket = 0; bucket < epg->service_buckets; bucket++) {
+		for (svc = epg->services[bucket]; svc; svc = svc->next)
+			ex->services[ex->service_count++].svc = svc;
+	}
+	qsort(ex->services, ex->service_count, sizeof(struct export_service), service_compare);
+
+	for (i = 0, j = 0; i < ex->service_count; i++) {
+		struct export_service *es = &ex->services[i];
+		uint32_t e;
+
+		svc = es->svc;
+		for (e = 0; e < svc->event_count; e++) {
+			struct epg_event *ev = svc->events[e];
+
+			if (!export_selected(ex, ev))
+				continue;
+			es->events++;
+			export_number(ex, ev->pub.title);
+			export_number(ex, ev->pub.text);
+		}
+
+		// an incremental export only lists what changed
+		if (ex->since && (es->events == 0))
+			continue;
+		if (svc->id.source == DVBEPG_SOURCE_ATSC)
+			sprintf(es->id, "%u.%u.atsc", svc->id.transport_stream_id, svc->id.service_id);
+		else
+			sprintf(es->id, "%u.%u.%u.dvb", svc->id.network_id,
+				svc->id.transport_stream_id, svc->id.service_id);
+		ex->services[j++] = *es;
+	}
+	ex->service_count = j;
+
+	if ((ex->escaped = calloc(ex->string_count + 1, sizeof(struct export_string))) == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+int dvbepg_export(struct dvbepg *epg, int fd, const struct dvbepg_export_params *params)
+{
+	struct export ex;
+	struct export_out out;
+	struct export_thread threads[EXPORT_MAX_THREADS];
+	uint32_t i;
+	int ret;
+
+	if (params->format == DVBEPG_EXPORT_ARROW)
+		return epg_export_arrow(epg, fd, params);
+
+	memset(&ex, 0, sizeof(ex));
+	memset(&out, 0, sizeof(out));
+	memset(threads, 0, sizeof(threads));
+	ex.epg = epg;
+	ex.params = params;
+	ex.since = (params->since <= epg->changes) ? params->since : 0;
+	ex.ranged = params->from || params->to;
+	out.fd = fd;
+	pthread_mutex_init(&ex.lock, NULL);
+	pthread_cond_init(&ex.ready, NULL);
+	pthread_cond_init(&ex.space, NULL);
+
+	if ((ret = export_select(&ex)) != 0)
+		goto out;
+
+	ex.thread_count = params->threads;
+	if (ex.thread_count <= 0)
+		ex.thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (ex.thread_count <= 0)
+		ex.thread_count = 1;
+	if (ex.thread_count > EXPORT_MAX_THREADS)
+		ex.thread_count = EXPORT_MAX_THREADS;
+	if ((uint32_t) ex.thread_count > ex.service_count)
+		ex.thread_count = ex.service_count ? ex.service_count : 1;
+	for (i = 0; i < (uint32_t) ex.thread_count; i++) {
+		threads[i].ex = &ex;
+		threads[i].index = i;
+	}
+
+	if ((ret = export_run(&ex, threads, escape_thread)) != 0)
+		goto out;
+	export_join(&ex, threads);
+	if ((ret = ex.err) != 0)
+		goto out;
+
+	// the head and the channels, while the threads start on the programmes
+	if (params->format == DVBEPG_EXPORT_JSON)
+		ret = out_puts(&out, "{\"channels\":[");
+	else
+		ret = out_puts(&out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			       "<!DOCTYPE tv SYSTEM \"xmltv.dtd\">\n"
+			       "<tv generator-info-name=\"dvbepg\">\n");
+	if (ret)
+		goto out;
+	if (ex.thread_count > 1) {
+		if ((ret = export_run(&ex, threads, format_thread)) != 0)
+			goto out;
+	}
+	out.first = 1;
+	for (i = 0; (i < ex.service_count) && !ret; i++)
+		ret = out_channel(&ex, &out, &ex.services[i]);
+	if (!ret && (params->format == DVBEPG_EXPORT_JSON))
+		ret = out_puts(&out, "\n],\"programmes\":[");
+
+	if (ret)
+		export_fail(&ex, ret);
+	else
+		ret = out_services(&ex, &out);
+	if (ex.thread_count > 1)
+		export_join(&ex, threads);
+	if (ret)
+		goto out;
+
+	if (params->format == DVBEPG_EXPORT_JSON)
+		ret = out_puts(&out, "\n]}\n");
+	else
+		ret = out_puts(&out, "</tv>\n");
+	if (!ret)
+		ret = out_flush(&out);
+
+out:
+	for (i = 0; i < EXPORT_MAX_THREADS; i++) {
+		free(threads[i].arena.data);
+		free(threads[i].plain);
+	}
+	for (i = 0; i < ex.service_count; i++)
+		free(ex.services[i].out.data);
+	free(ex.services);
+	free(ex.strings);
+	free(ex.escaped);
+	free(out.buf.data);
+	pthread_mutex_destroy(&ex.lock);
+	pthread_cond_destroy(&ex.ready);
+	pthread_cond_destroy(&ex.space);
+	return ret;
+}
@@ -0,0 +1,109 @@
+/*
+ * dvbepg - in-memory EPG store
+ * internals shared between the parts of the store
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DVBEPG_INT_H
+#define DVBEPG_INT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dvbepg.h"
+
+#define EPG_ID_BUCKETS 256		/* event id hash buckets per service */
+#define EPG_NO_ETT 0xff			/* ett_version of an event without ETT text */
+
+/* an interned string: every event with the same title shares one copy */
+struct epg_string {
+	struct epg_string *next;
+	uint32_t hash;
+	uint32_t refs;
+	uint32_t index;		/* number of the string while a snapshot or an export is written */
+	char str[];
+};
+
+struct epg_event {
+	struct dvbepg_event pub;
+	struct epg_event *id_next;
+	uint32_t generation;	/* generation of the last section listing it */
+	uint16_t origin;	/* key of that section */
+	uint8_t ett_version;
+	uint32_t changed;	/* change serial of its last change */
+};
+
+/* a section applied to a service, keyed on (table_id or EIT index, section_number) */
+struct epg_section {
+	uint16_t key;
+	uint8_t version;
+};
+
+struct epg_service {
+	struct dvbepg_service_id id;
+	uint64_t key;
+	struct epg_service *next;
+
+	struct epg_event **events;	/* sorted by start time, then event id */
+	uint32_t event_count;
+	uint32_t event_alloc;
+	uint32_t max_duration;		/* bounds how far back an overlap can start */
+	struct epg_event *id_hash[EPG_ID_BUCKETS];
+
+	struct epg_section *sections;	/* sorted by key */
+	uint32_t section_count;
+	uint32_t section_alloc;
+};
+
+struct dvbepg {
+	struct epg_service **services;
+	uint32_t service_buckets;
+	uint32_t service_count;
+
+	struct epg_string **strings;
+	uint32_t string_buckets;
+	uint32_t string_count;
+
+	uint32_t generation;
+	uint32_t changes;	/* change serial, bumped whenever an event changes */
+
+	/* strings are kept encoded with this, if there is one */
+	struct dvbepg_dict *dict;
+	char *code;
+	size_t code_size;
+
+	/* an event handed out, with its strings decoded */
+	struct dvbepg_event view;
+	char *view_text[2];
+	size_t view_size[2];
+
+	/* scratch space for decoding text */
+	uint8_t *text;
+	size_t text_size;
+	struct dvb_text_decoder *decoder;
+};
+
+static inline struct epg_string *epg_string_of(const char *str)
+{
+	return (struct epg_string *) (str - offsetof(struct epg_string, str));
+}
+
+/* dvbepg_export() as Arrow, in dvbepg_arrow.c */
+extern int epg_export_arrow(struct dvbepg *epg, int fd, const struct dvbepg_export_params *params);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * dvbepg - in-memory EPG store
+ * present/following tracker for the current multiplex
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libdvbapi/dvbdemux.h>
+#include <libucsi/section.h>
+#include <libucsi/dvb/descriptor.h>
+#include <libucsi/dvb/section.h>
+#include <libucsi/dvb/text.h>
+
+#include "dvbnownext.h"
+
+#define EIT_PID 0x12
+#define NO_VERSION 0xff
+
+struct nownext_entry {
+	uint32_t seq;			/* odd while an update is under way */
+
+	/* only the updating thread looks at these */
+	uint8_t version[2];		/* of the section in each slot */
+
+	struct dvbnownext_service data;
+};
+
+struct dvbnownext {
+	/* by service_id, made on first use and kept until the end */
+	struct nownext_entry *services[0x10000];
+
+	struct dvb_text_decoder *decoder;
+};
+
+struct dvbnownext *dvbnownext_create(void)
+{
+	struct dvbnownext *nn;
+
+	if ((nn = calloc(1, sizeof(struct dvbnownext))) == NULL)
+		return NULL;
+	if ((nn->decoder = dvb_text_decoder_create(NULL)) == NULL) {
+		free(nn);
+		return NULL;
+	}
+	return nn;
+}
+
+void dvbnownext_destroy(struct dvbnownext *nn)
+{
+	int i;
+
+	for (i = 0; i < 0x10000; i++)
+		free(nn->services[i]);
+	dvb_text_decoder_destroy(nn->decoder);
+	free(nn);
+}
+
+int dvbnownext_open(int adapter, int demuxdevice)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+	int fd;
+
+	if ((fd = dvbdemux_open_demux(adapter, demuxdevice, 1)) < 0)
+		return -1;
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = stag_dvb_event_information_nownext_actual;
+	mask[0] = 0xff;
+	if (dvbdemux_set_section_filter(fd, EIT_PID, filter, mask, 1, 1)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int dvbnownext_process(struct dvbnownext *nn, int fd)
+{
+	uint8_t buf[4096];
+	int len;
+
+	if ((len = read(fd, buf, sizeof(buf))) < 0)
+		return -1;
+	return dvbnownext_add_section(nn, buf, len);
+}
+
+/* is the section in a slot already? (on the raw bytes) */
+static int nownext_seen(struct dvbnownext *nn, uint8_t *section, int len)
+{
+	struct nownext_entry *e;
+	uint16_t service_id;
+	uint8_t section_number;
+
+	if ((len < 14) || (section[0] != stag_dvb_event_information_nownext_actual) ||
+	    !(section[1] & 0x80) || !(section[5] & 0x01) || (section[6] > 1))
+		return 1;
+
+	service_id = (section[3] << 8) | section[4];
+	section_number = section[6];
+	if ((e = nn->services[service_id]) == NULL)
+		return 0;
+	return (e->version[section_number] == ((section[5] >> 1) & 0x1f)) &&
+		(e->data.transport_stream_id == ((section[8] << 8) | section[9])) &&
+		(e->data.network_id == ((section[10] << 8) | section[11]));
+}
+
+int dvbnownext_add_section(struct dvbnownext *nn, uint8_t *section, int len)
+{
+	struct section *s;
+	struct section_ext *ext;
+	struct dvb_eit_section *eit;
+
+	if (nownext_seen(nn, section, len))
+		return 0;
+
+	if ((s = section_codec(section, len)) == NULL)
+		return 0;
+	if ((ext = section_ext_decode(s, 1)) == NULL)
+		return 0;
+	if ((eit = dvb_eit_section_codec(ext)) == NULL)
+		return 0;
+	return dvbnownext_add_eit(nn, eit);
+}
+
+static void nownext_event(struct dvbnownext *nn, struct dvb_eit_section *eit,
+			  struct dvb_eit_event *e, struct dvbnownext_event *ev)
+{
+	struct dvb_eit_event_time times;
+	struct descriptor *d;
+
+	dvb_eit_section_event_times(eit, &times, 1);
+	ev->event_id = e->event_id;
+	ev->running_status = e->running_status;
+	ev->start_time = times.start_time;
+	ev->duration = times.duration;
+
+	dvb_eit_event_descriptors_for_each(e, d) {
+		struct dvb_short_event_descriptor *sed;
+		struct dvb_short_event_descriptor_part2 *part2;
+
+		if ((d->tag != dtag_dvb_short_event) ||
+		    ((sed = dvb_short_event_descriptor_codec(d)) == NULL))
+			continue;
+
+		// cut short if need be: the decoder stops at a whole character
+		memcpy(ev->language, sed->language_code, 3);
+		dvb_text_decode(nn->decoder, dvb_short_event_descriptor_event_name(sed),
+				sed->event_name_length, ev->title, sizeof(ev->title));
+		part2 = dvb_short_event_descriptor_part2(sed);
+		dvb_text_decode(nn->decoder, dvb_short_event_descriptor_text(part2),
+				part2->text_length, ev->text, sizeof(ev->text));
+		break;
+	}
+}
+
+int dvbnownext_add_eit(struct dvbnownext *nn, struct dvb_eit_section *eit)
+{
+	uint16_t service_id = dvb_eit_section_service_id(eit);
+	struct nownext_entry *e = nn->services[service_id];
+	struct dvbnownext_event ev;
+	struct dvb_eit_event *first;
+	int slot = eit->head.section_number;
+	int other_mux;
+
+	if ((eit->head.table_id != stag_dvb_event_information_nownext_actual) ||
+	    !eit->head.current_next_indicator || (slot > 1))
+		return 0;
+
+	if (e == NULL) {
+		if ((e = calloc(1, sizeof(struct nownext_entry))) == NULL)
+			return 0;
+		e->version[0] = e->version[1] = NO_VERSION;
+		__atomic_store_n(&nn->services[service_id], e, __ATOMIC_RELEASE);
+	}
+	other_mux = (e->data.transport_stream_id != eit->transport_stream_id) ||
+		(e->data.network_id != eit->original_network_id);
+	if (!other_mux && (e->version[slot] == eit->head.version_number))
+		return 0;
+
+	// decoded outside the update, which is then just a copy
+	memset(&ev, 0, sizeof(ev));
+	if ((first = dvb_eit_section_events_first(eit)) != NULL)
+		nownext_event(nn, eit, first, &ev);
+
+	__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	if (other_mux) {
+		// what the other slot holds is from another multiplex
+		e->data.valid[!slot] = 0;
+		e->version[!slot] = NO_VERSION;
+	}
+	e->data.network_id = eit->original_network_id;
+	e->data.transport_stream_id = eit->transport_stream_id;
+	e->data.valid[slot] = (first != NULL);
+	memcpy(&e->data.event[slot], &ev, sizeof(ev));
+	__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELEASE);
+
+	e->version[slot] = eit->head.version_number;
+	return 1;
+}
+
+void dvbnownext_clear(struct dvbnownext *nn)
+{
+	int i;
+
+	for (i = 0; i < 0x10000; i++) {
+		struct nownext_entry *e = nn->services[i];
+
+		if ((e == NULL) || ((e->version[0] == NO_VERSION) && (e->version[1] == NO_VERSION)))
+			continue;
+
+		__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		e->data.valid[0] = e->data.valid[1] = 0;
+		__atomic_store_n(&e->seq, e->seq + 1, __ATOMIC_RELEASE);
+		e->version[0] = e->version[1] = NO_VERSION;
+	}
+}
+
+int dvbnownext_get(struct dvbnownext *nn, uint16_t service_id, struct dvbnownext_service *service)
+{
+	struct nownext_entry *e = __atomic_load_n(&nn->services[service_id], __ATOMIC_ACQUIRE);
+	uint32_t seq;
+
+	if (e == NULL)
+		return -1;
+
+	for(;;) {
+		if ((seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE)) & 1) {
+			sched_yield();
+			continue;
+		}
+		memcpy(service, &e->data, sizeof(struct dvbnownext_service));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) == seq)
+			break;
+	}
+
+	if (!service->valid[0] && !service->valid[1])
+		return -1;
+	return 0;
+}
+
+uint32_t dvbnownext_changes(struct dvbnownext *nn, uint16_t service_id)
+{
+	struct nownext_entry *e = __atomic_load_n(&nn->services[service_id], __ATOMIC_ACQUIRE);
+
+	if (e == NULL)
+		return 0;
+	return (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) + 1) / 2;
+}
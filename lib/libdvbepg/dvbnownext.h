@@ -0,0 +1,166 @@
+/*
+ * dvbepg - in-memory EPG store
+ * present/following tracker for the current multiplex
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#ifndef DVBNOWNEXT_H
+#define DVBNOWNEXT_H 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+#include <libucsi/dvb/eit_section.h>
+
+/**
+ * A tracker of the present and following events of every service on the
+ * current multiplex, from the EIT present/following actual table (table_id
+ * 0x4e on PID 0x12) alone. Each service has two slots, indexed by its
+ * service_id; a section is only decoded when its version differs from the
+ * one in its slot, which is checked on the raw bytes, so the repeats of an
+ * unchanged table cost almost nothing.
+ *
+ * Updates (dvbnownext_process(), dvbnownext_add_section(),
+ * dvbnownext_add_eit(), dvbnownext_clear()) must come from one thread at a
+ * time. Any number of threads may meanwhile call dvbnownext_get() and
+ * dvbnownext_changes() without taking a lock: a read copies the slots out
+ * and tries again if an update overlapped it, and an update never blocks on
+ * readers.
+ */
+struct dvbnownext;
+
+#define DVBNOWNEXT_PRESENT	0
+#define DVBNOWNEXT_FOLLOWING	1
+
+#define DVBNOWNEXT_TEXT_MAX	256	/* longer titles and texts are cut short */
+
+/**
+ * An event, with its strings in UTF-8.
+ */
+struct dvbnownext_event {
+	uint16_t event_id;
+	uint8_t running_status;
+	char language[4];		/* ISO 639-2 code, "" if unknown */
+	time_t start_time;		/* -1 if undefined */
+	uint32_t duration;		/* in seconds */
+	char title[DVBNOWNEXT_TEXT_MAX];
+	char text[DVBNOWNEXT_TEXT_MAX];
+};
+
+/**
+ * What is known of a service.
+ */
+struct dvbnownext_service {
+	uint16_t network_id;		/* original_network_id */
+	uint16_t transport_stream_id;
+	uint8_t valid[2];		/* if the slot holds an event */
+	struct dvbnownext_event event[2]; /* DVBNOWNEXT_PRESENT, DVBNOWNEXT_FOLLOWING */
+};
+
+/**
+ * Create an empty tracker.
+ *
+ * @return The tracker, or NULL on failure.
+ */
+extern struct dvbnownext *dvbnownext_create(void);
+
+/**
+ * Destroy a tracker. No thread may be reading from it any more.
+ *
+ * @param nn The tracker.
+ */
+extern void dvbnownext_destroy(struct dvbnownext *nn);
+
+/**
+ * Open the one demux filter a tracker needs: EIT present/following actual,
+ * CRC checked, non blocking.
+ *
+ * @param adapter Index of the DVB adapter.
+ * @param demuxdevice Index of the demux device on that adapter.
+ * @return The demux fd, or -1 on failure.
+ */
+extern int dvbnownext_open(int adapter, int demuxdevice);
+
+/**
+ * Read one section from a demux fd opened with dvbnownext_open() and apply
+ * it.
+ *
+ * @param nn The tracker.
+ * @param fd The demux fd.
+ * @return 1 if a service changed, 0 if not, or -1 with errno set if there
+ * was nothing to read (EAGAIN) or reading failed.
+ */
+extern int dvbnownext_process(struct dvbnownext *nn, int fd);
+
+/**
+ * Apply a raw section from some other source (a DVR stream, a capture).
+ * Sections other than EIT present/following actual are ignored. The section
+ * is decoded in place if it is new.
+ *
+ * @param nn The tracker.
+ * @param section The section, starting at table_id.
+ * @param len Its length.
+ * @return 1 if a service changed, 0 if not.
+ */
+extern int dvbnownext_add_section(struct dvbnownext *nn, uint8_t *section, int len);
+
+/**
+ * Apply an already decoded section.
+ *
+ * @param nn The tracker.
+ * @param eit The section.
+ * @return 1 if a service changed, 0 if not.
+ */
+extern int dvbnownext_add_eit(struct dvbnownext *nn, struct dvb_eit_section *eit);
+
+/**
+ * Forget every service, e.g. after tuning to another multiplex.
+ *
+ * @param nn The tracker.
+ */
+extern void dvbnownext_clear(struct dvbnownext *nn);
+
+/**
+ * Get the present and following events of a service.
+ *
+ * @param nn The tracker.
+ * @param service_id The service.
+ * @param service Where to put them.
+ * @return 0 on success, or -1 if nothing is known of the service.
+ */
+extern int dvbnownext_get(struct dvbnownext *nn, uint16_t service_id,
+			  struct dvbnownext_service *service);
+
+/**
+ * A count which goes up each time a service changes, to poll for changes
+ * without copying the events.
+ *
+ * @param nn The tracker.
+ * @param service_id The service.
+ * @return The count, 0 if nothing was ever known of the service.
+ */
+extern uint32_t dvbnownext_changes(struct dvbnownext *nn, uint16_t service_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
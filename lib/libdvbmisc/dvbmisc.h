@@ -69,4 +69,19 @@ static inline int time_after(struct timeval oldtime, uint32_t delta_ms)
 	return nowtime_ms > oldtime_ms;
 }
 
+static inline uint32_t time_remaining(struct timeval oldtime, uint32_t delta_ms)
+{
+	// milliseconds until time_after(oldtime, delta_ms) becomes true
+	uint64_t oldtime_ms = (oldtime.tv_sec * 1000) + (oldtime.tv_usec / 1000);
+	oldtime_ms += delta_ms;
+
+	struct timeval nowtime;
+	gettimeofday(&nowtime, 0);
+	uint64_t nowtime_ms = (nowtime.tv_sec * 1000) + (nowtime.tv_usec / 1000);
+
+	if (nowtime_ms > oldtime_ms)
+		return 0;
+	return oldtime_ms - nowtime_ms + 1;
+}
+
 #endif
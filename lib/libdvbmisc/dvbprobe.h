@@ -0,0 +1,52 @@
+/*
+	libdvbmisc - DVB miscellaneous library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#ifndef DVB_PROBE_H
+#define DVB_PROBE_H
+
+/*
+ * Static tracing probes (USDT), all under the provider "dvb", e.g.
+ *
+ *	bpftrace -e 'usdt:./libdvbapi.so:dvb:tune_lock { @lock_us = hist(arg0); }'
+ *
+ * With <sys/sdt.h> (systemtap's, as packaged in systemtap-sdt-dev(el)) a
+ * probe is a single nop plus an ELF note, until a tracer attaches. Without
+ * it, or built with -DDVB_NO_PROBES, probes compile to nothing; their
+ * arguments must then have no side effects.
+ */
+
+#if !defined(DVB_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define DVB_HAVE_PROBES 1
+#endif
+#endif
+
+#ifdef DVB_HAVE_PROBES
+#define DVBPROBE(name)			DTRACE_PROBE(dvb, name)
+#define DVBPROBE1(name, a)		DTRACE_PROBE1(dvb, name, a)
+#define DVBPROBE2(name, a, b)		DTRACE_PROBE2(dvb, name, a, b)
+#define DVBPROBE3(name, a, b, c)	DTRACE_PROBE3(dvb, name, a, b, c)
+#else
+#define DVBPROBE(name)			do { } while(0)
+#define DVBPROBE1(name, a)		do { (void) (a); } while(0)
+#define DVBPROBE2(name, a, b)		do { (void) (a); (void) (b); } while(0)
+#define DVBPROBE3(name, a, b, c)	do { (void) (a); (void) (b); (void) (c); } while(0)
+#endif
+
+#endif
@@ -0,0 +1,599 @@
+/*
+	libdvbmisc - DVB miscellaneous library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/eventfd.h>
+#include "dvbreactor.h"
+
+#define MAX_EVENTS	16
+#define FIRST_HANDLERS	16
+
+#define HANDLER_FREE	0
+#define HANDLER_FD	1
+#define HANDLER_WAKEUP	2
+
+/* the stop eventfd is the one fd without a handler slot */
+#define STOP_SLOT	0xffffffff
+
+/*
+ * The timing wheel: WHEEL_LEVELS levels of WHEEL_SIZE slots, a slot of
+ * level n spanning WHEEL_SIZE^n ticks of 1ms. A timer goes on the lowest
+ * level whose span covers its delay, in the slot its expiry falls into;
+ * as the lower levels wrap round, the slot of the level above which is
+ * coming up is cascaded, its timers being put back on lower levels. Timers
+ * further away than the top level reaches are put in its furthest slot and
+ * go round again.
+ */
+#define WHEEL_BITS	6
+#define WHEEL_SIZE	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SIZE - 1)
+#define WHEEL_LEVELS	4
+#define WHEEL_RANGE	(1ULL << (WHEEL_BITS * WHEEL_LEVELS))
+
+#define NEVER		(~0ULL)
+
+struct link {
+	struct link *next;
+	struct link *prev;
+};
+
+struct dvbreactor_timer {
+	struct link link;		/* first, so a link is a timer */
+	uint64_t expires;		/* ms tick */
+	int interval;
+	int level;			/* -1 when not on the wheel */
+	dvbreactor_callback callback;
+	void *arg;
+};
+
+/*
+ * epoll hands back the slot and its generation, so an event collected for
+ * an fd which has since been removed (and the slot reused) is ignored.
+ */
+struct handler {
+	int fd;
+	int type;
+	uint32_t generation;
+	dvbreactor_callback callback;
+	void *arg;
+};
+
+struct dvbreactor {
+	int epoll_fd;
+	int stop_fd;
+	int stopped;
+
+	struct handler *handlers;
+	int handler_count;
+
+	uint64_t now;			/* the next tick to run */
+	struct link slots[WHEEL_LEVELS][WHEEL_SIZE];
+	int timer_count[WHEEL_LEVELS];
+	struct dvbreactor_timer *running;
+	int running_removed;
+};
+
+static uint64_t clock_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static void link_init(struct link *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+static void link_add(struct link *head, struct link *l)
+{
+	l->next = head;
+	l->prev = head->prev;
+	head->prev->next = l;
+	head->prev = l;
+}
+
+static void link_del(struct link *l)
+{
+	l->prev->next = l->next;
+	l->next->prev = l->prev;
+	l->next = NULL;
+	l->prev = NULL;
+}
+
+/* move a whole list to an empty head */
+static void link_move(struct link *from, struct link *to)
+{
+	if (from->next == from) {
+		link_init(to);
+		return;
+	}
+	to->next = from->next;
+	to->prev = from->prev;
+	to->next->prev = to;
+	to->prev->next = to;
+	link_init(from);
+}
+
+struct dvbreactor *dvbreactor_create(void)
+{
+	struct dvbreactor *reactor;
+	struct epoll_event ev;
+	int level;
+	int i;
+
+	if ((reactor = calloc(1, sizeof(struct dvbreactor))) == NULL)
+		return NULL;
+	for(level = 0; level < WHEEL_LEVELS; level++)
+		for(i = 0; i < WHEEL_SIZE; i++)
+			link_init(&reactor->slots[level][i]);
+	reactor->now = clock_ms();
+
+	if ((reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+		free(reactor);
+		return NULL;
+	}
+	if ((reactor->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+		close(reactor->epoll_fd);
+		free(reactor);
+		return NULL;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.u64 = STOP_SLOT;
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->stop_fd, &ev)) {
+		close(reactor->stop_fd);
+		close(reactor->epoll_fd);
+		free(reactor);
+		return NULL;
+	}
+
+	return reactor;
+}
+
+void dvbreactor_destroy(struct dvbreactor *reactor)
+{
+	struct link *head;
+	int level;
+	int i;
+
+	for(i = 0; i < reactor->handler_count; i++) {
+		if (reactor->handlers[i].type == HANDLER_WAKEUP)
+			close(reactor->handlers[i].fd);
+	}
+	for(level = 0; level < WHEEL_LEVELS; level++) {
+		for(i = 0; i < WHEEL_SIZE; i++) {
+			head = &reactor->slots[level][i];
+			while(head->next != head) {
+				struct link *l = head->next;
+
+				link_del(l);
+				free(l);
+			}
+		}
+	}
+
+	close(reactor->stop_fd);
+	close(reactor->epoll_fd);
+	free(reactor->handlers);
+	free(reactor);
+}
+
+static int reactor_add(struct dvbreactor *reactor, int fd, uint32_t events,
+		       dvbreactor_callback callback, void *arg, int type)
+{
+	struct epoll_event ev;
+	struct handler *h;
+	int count;
+	int i;
+
+	for(i = 0; i < reactor->handler_count; i++) {
+		if (reactor->handlers[i].type == HANDLER_FREE)
+			break;
+	}
+	if (i == reactor->handler_count) {
+		count = reactor->handler_count ? reactor->handler_count * 2 : FIRST_HANDLERS;
+		if ((h = realloc(reactor->handlers, count * sizeof(struct handler))) == NULL)
+			return -1;
+		memset(h + reactor->handler_count, 0,
+		       (count - reactor->handler_count) * sizeof(struct handler));
+		reactor->handlers = h;
+		reactor->handler_count = count;
+	}
+	h = &reactor->handlers[i];
+
+	h->generation++;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.u64 = ((uint64_t) h->generation << 32) | i;
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		return -1;
+
+	h->fd = fd;
+	h->type = type;
+	h->callback = callback;
+	h->arg = arg;
+	return 0;
+}
+
+static struct handler *find_handler(struct dvbreactor *reactor, int fd)
+{
+	int i;
+
+	for(i = 0; i < reactor->handler_count; i++) {
+		if ((reactor->handlers[i].type != HANDLER_FREE) &&
+		    (reactor->handlers[i].fd == fd))
+			return &reactor->handlers[i];
+	}
+	return NULL;
+}
+
+int dvbreactor_add(struct dvbreactor *reactor, int fd, uint32_t events,
+		   dvbreactor_callback callback, void *arg)
+{
+	return reactor_add(reactor, fd, events, callback, arg, HANDLER_FD);
+}
+
+int dvbreactor_modify(struct dvbreactor *reactor, int fd, uint32_t events)
+{
+	struct handler *h;
+	struct epoll_event ev;
+
+	if ((h = find_handler(reactor, fd)) == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.u64 = ((uint64_t) h->generation << 32) | (h - reactor->handlers);
+	return epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void dvbreactor_remove(struct dvbreactor *reactor, int fd)
+{
+	struct handler *h;
+
+	if ((h = find_handler(reactor, fd)) == NULL)
+		return;
+	epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	h->type = HANDLER_FREE;
+	h->fd = -1;
+}
+
+int dvbreactor_add_wakeup(struct dvbreactor *reactor,
+			  dvbreactor_callback callback, void *arg)
+{
+	int fd;
+
+	if ((fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0)
+		return -1;
+	if (reactor_add(reactor, fd, EPOLLIN, callback, arg, HANDLER_WAKEUP)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+void dvbreactor_remove_wakeup(struct dvbreactor *reactor, int wakeup_fd)
+{
+	dvbreactor_remove(reactor, wakeup_fd);
+	close(wakeup_fd);
+}
+
+void dvbreactor_wakeup(int wakeup_fd)
+{
+	uint64_t one = 1;
+
+	if (write(wakeup_fd, &one, sizeof(one)) < 0) {
+		/* only fails if the counter is full, when it is signalled anyway */
+	}
+}
+
+static void timer_queue(struct dvbreactor *reactor, struct dvbreactor_timer *timer)
+{
+	uint64_t expires = timer->expires;
+	int level;
+
+	if (expires < reactor->now)
+		expires = reactor->now;
+	if (expires - reactor->now >= WHEEL_RANGE)
+		expires = reactor->now + WHEEL_RANGE - 1;
+	for(level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if ((expires - reactor->now) < (1ULL << (WHEEL_BITS * (level + 1))))
+			break;
+	}
+
+	timer->level = level;
+	reactor->timer_count[level]++;
+	link_add(&reactor->slots[level][(expires >> (WHEEL_BITS * level)) & WHEEL_MASK],
+		 &timer->link);
+}
+
+struct dvbreactor_timer *dvbreactor_add_timer(struct dvbreactor *reactor,
+					      int delay, int interval,
+					      dvbreactor_callback callback, void *arg)
+{
+	struct dvbreactor_timer *timer;
+	uint64_t now = clock_ms();
+	int level;
+
+	if ((timer = malloc(sizeof(struct dvbreactor_timer))) == NULL)
+		return NULL;
+	timer->expires = now + (delay > 0 ? delay : 0);
+	timer->interval = interval > 0 ? interval : 0;
+	timer->callback = callback;
+	timer->arg = arg;
+
+	/* an empty wheel can be moved on to now at no cost */
+	for(level = 0; level < WHEEL_LEVELS; level++) {
+		if (reactor->timer_count[level])
+			break;
+	}
+	if ((level == WHEEL_LEVELS) && (reactor->now < now))
+		reactor->now = now;
+
+	timer_queue(reactor, timer);
+	return timer;
+}
+
+void dvbreactor_remove_timer(struct dvbreactor *reactor, struct dvbreactor_timer *timer)
+{
+	if (timer == reactor->running) {
+		reactor->running_removed = 1;
+		return;
+	}
+	if (timer->level >= 0)
+		reactor->timer_count[timer->level]--;
+	if (timer->link.next)
+		link_del(&timer->link);
+	free(timer);
+}
+
+/*
+ * The next tick at which the wheel has work: a slot of level 0 to run, or
+ * (if cascade is set) a slot of a level above to cascade. If not, the
+ * earliest expiry, to sleep until; only the first slot in use on each level
+ * has to be looked at, as those after it all expire later.
+ */
+static uint64_t wheel_next(struct dvbreactor *reactor, int cascade)
+{
+	uint64_t next = NEVER;
+	uint64_t base;
+	uint64_t tick;
+	struct link *head;
+	struct link *l;
+	int level;
+	int start;
+	int k;
+
+	if (reactor->timer_count[0]) {
+		for(k = 0; k < WHEEL_SIZE; k++) {
+			if (reactor->slots[0][(reactor->now + k) & WHEEL_MASK].next !=
+			    &reactor->slots[0][(reactor->now + k) & WHEEL_MASK]) {
+				next = reactor->now + k;
+				break;
+			}
+		}
+	}
+
+	for(level = 1; level < WHEEL_LEVELS; level++) {
+		if (!reactor->timer_count[level])
+			continue;
+
+		/* the slot under the cursor has been cascaded already, unless
+		 * the lower levels have only just wrapped round */
+		base = reactor->now >> (WHEEL_BITS * level);
+		start = (reactor->now & ((1ULL << (WHEEL_BITS * level)) - 1)) ? 1 : 0;
+		for(k = start; k < start + WHEEL_SIZE; k++) {
+			head = &reactor->slots[level][(base + k) & WHEEL_MASK];
+			if (head->next == head)
+				continue;
+
+			if (cascade) {
+				tick = (base + k) << (WHEEL_BITS * level);
+			} else {
+				tick = NEVER;
+				for(l = head->next; l != head; l = l->next) {
+					if (((struct dvbreactor_timer *) l)->expires < tick)
+						tick = ((struct dvbreactor_timer *) l)->expires;
+				}
+			}
+			if (tick < next)
+				next = tick;
+			break;
+		}
+	}
+
+	return next;
+}
+
+static void wheel_cascade(struct dvbreactor *reactor, int level, int slot)
+{
+	struct link list;
+	struct dvbreactor_timer *timer;
+
+	link_move(&reactor->slots[level][slot], &list);
+	while(list.next != &list) {
+		timer = (struct dvbreactor_timer *) list.next;
+		link_del(&timer->link);
+		reactor->timer_count[level]--;
+		timer_queue(reactor, timer);
+	}
+}
+
+/*
+ * Run the tick reactor->now: cascade what is coming up, then run the timers
+ * of its level 0 slot.
+ */
+static int wheel_tick(struct dvbreactor *reactor)
+{
+	struct link list;
+	struct link *l;
+	struct dvbreactor_timer *timer;
+	uint64_t tick = reactor->now;
+	int level;
+	int slot;
+	int count = 0;
+
+	if (!(tick & WHEEL_MASK)) {
+		for(level = 1; level < WHEEL_LEVELS; level++) {
+			slot = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+			wheel_cascade(reactor, level, slot);
+			if (slot)
+				break;
+		}
+	}
+
+	/* timers started from the callbacks go on later ticks */
+	link_move(&reactor->slots[0][tick & WHEEL_MASK], &list);
+	for(l = list.next; l != &list; l = l->next) {
+		((struct dvbreactor_timer *) l)->level = -1;
+		reactor->timer_count[0]--;
+	}
+	reactor->now = tick + 1;
+
+	while(list.next != &list) {
+		timer = (struct dvbreactor_timer *) list.next;
+		link_del(&timer->link);
+
+		reactor->running = timer;
+		reactor->running_removed = 0;
+		timer->callback(timer->arg, 0);
+		reactor->running = NULL;
+		count++;
+
+		if (reactor->running_removed || !timer->interval) {
+			free(timer);
+			continue;
+		}
+
+		/* keep to the period, skipping the runs missed if held up */
+		timer->expires += timer->interval;
+		if (timer->expires < reactor->now)
+			timer->expires += ((reactor->now - timer->expires) / timer->interval + 1) *
+					  timer->interval;
+		timer_queue(reactor, timer);
+	}
+
+	return count;
+}
+
+static int wheel_advance(struct dvbreactor *reactor)
+{
+	uint64_t now = clock_ms();
+	uint64_t next;
+	int count = 0;
+
+	while((next = wheel_next(reactor, 1)) <= now) {
+		reactor->now = next;
+		count += wheel_tick(reactor);
+	}
+	if (reactor->now <= now)
+		reactor->now = now + 1;
+
+	return count;
+}
+
+int dvbreactor_timeout(struct dvbreactor *reactor)
+{
+	uint64_t next = wheel_next(reactor, 0);
+	uint64_t now;
+
+	if (next == NEVER)
+		return -1;
+	if ((now = clock_ms()) >= next)
+		return 0;
+	if (next - now > 0x7fffffff)
+		return 0x7fffffff;
+	return next - now;
+}
+
+int dvbreactor_fd(struct dvbreactor *reactor)
+{
+	return reactor->epoll_fd;
+}
+
+int dvbreactor_poll(struct dvbreactor *reactor, int timeout)
+{
+	struct epoll_event events[MAX_EVENTS];
+	struct handler *h;
+	uint64_t counter;
+	int wait;
+	int count;
+	int run = 0;
+	int i;
+
+	wait = dvbreactor_timeout(reactor);
+	if ((timeout >= 0) && ((wait < 0) || (timeout < wait)))
+		wait = timeout;
+
+	if ((count = epoll_wait(reactor->epoll_fd, events, MAX_EVENTS, wait)) < 0) {
+		if (errno != EINTR)
+			return -1;
+		count = 0;
+	}
+
+	for(i = 0; i < count; i++) {
+		uint32_t slot = events[i].data.u64 & 0xffffffff;
+		uint32_t generation = events[i].data.u64 >> 32;
+
+		if (slot == STOP_SLOT) {
+			if (read(reactor->stop_fd, &counter, sizeof(counter)) < 0) {
+				/* cleared already */
+			}
+			reactor->stopped = 1;
+			continue;
+		}
+
+		/* the table may move while the callbacks run */
+		h = &reactor->handlers[slot];
+		if ((h->type == HANDLER_FREE) || (h->generation != generation))
+			continue;
+
+		/* wakeups have to be acknowledged, or they stay readable */
+		if ((h->type == HANDLER_WAKEUP) &&
+		    (read(h->fd, &counter, sizeof(counter)) < 0))
+			continue;
+		h->callback(h->arg, events[i].events);
+		run++;
+	}
+
+	return run + wheel_advance(reactor);
+}
+
+int dvbreactor_run(struct dvbreactor *reactor)
+{
+	while(!reactor->stopped) {
+		if (dvbreactor_poll(reactor, -1) < 0)
+			return -1;
+	}
+	reactor->stopped = 0;
+
+	return 0;
+}
+
+void dvbreactor_stop(struct dvbreactor *reactor)
+{
+	dvbreactor_wakeup(reactor->stop_fd);
+}
@@ -0,0 +1,163 @@
+/*
+	libdvbmisc - DVB miscellaneous library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#ifndef DVB_REACTOR_H
+#define DVB_REACTOR_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/*
+ * An event loop to share between the tools: file descriptors are watched
+ * with epoll and registered with a callback, run whenever the fd is ready,
+ * and timers are kept on a hierarchical timing wheel (four levels of 64
+ * slots, of 1ms, 64ms, 4.096s and 262.144s), so adding, cancelling and
+ * firing one are O(1) however many there are. epoll_wait() sleeps until
+ * the next timer is due, so an idle loop takes no CPU.
+ *
+ * Handlers and timers may be added and removed from callbacks, a timer
+ * from its own callback too. Apart from dvbreactor_stop() and
+ * dvbreactor_wakeup(), the calls are for the thread running the loop.
+ */
+struct dvbreactor;
+struct dvbreactor_timer;
+
+/*
+ * The events to watch the DVB devices for: the frontend signals an event to
+ * read with POLLPRI, a section filter or the DVR has data to read, and a CA
+ * device has a link layer frame to read.
+ */
+#define DVBREACTOR_FRONTEND	(EPOLLIN | EPOLLPRI)
+#define DVBREACTOR_DEMUX	(EPOLLIN | EPOLLPRI | EPOLLERR)
+#define DVBREACTOR_DVR		(EPOLLIN | EPOLLERR)
+#define DVBREACTOR_CA		(EPOLLIN | EPOLLERR)
+
+/**
+ * Called when a registered fd is ready, a timer is due or a wakeup fd has
+ * been signalled.
+ *
+ * @param arg As passed when registering.
+ * @param events EPOLL* events which occurred, 0 for a timer.
+ */
+typedef void (*dvbreactor_callback)(void *arg, uint32_t events);
+
+extern struct dvbreactor *dvbreactor_create(void);
+
+/**
+ * Destroy a reactor. Registered fds are not closed; timers and wakeup fds
+ * are freed.
+ */
+extern void dvbreactor_destroy(struct dvbreactor *reactor);
+
+/**
+ * Register an fd.
+ *
+ * @param events EPOLL* events to wait for, or one of the DVBREACTOR_* sets.
+ * @return 0 on success, -1 on failure.
+ */
+extern int dvbreactor_add(struct dvbreactor *reactor, int fd, uint32_t events,
+			  dvbreactor_callback callback, void *arg);
+
+/**
+ * Change the events an fd is watched for.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+extern int dvbreactor_modify(struct dvbreactor *reactor, int fd, uint32_t events);
+
+/**
+ * Unregister an fd; call before closing it. Its callback will not be run
+ * again, even for events already collected.
+ */
+extern void dvbreactor_remove(struct dvbreactor *reactor, int fd);
+
+/**
+ * Start a timer.
+ *
+ * @param delay ms before it first runs.
+ * @param interval ms between runs after that, 0 to run once. A one shot
+ * timer is freed after it has run, and must not be removed then.
+ * @return The timer, or NULL on failure.
+ */
+extern struct dvbreactor_timer *dvbreactor_add_timer(struct dvbreactor *reactor,
+						     int delay, int interval,
+						     dvbreactor_callback callback, void *arg);
+
+/**
+ * Cancel and free a timer.
+ */
+extern void dvbreactor_remove_timer(struct dvbreactor *reactor, struct dvbreactor_timer *timer);
+
+/**
+ * Register an eventfd, for other threads to run a callback in the loop
+ * with dvbreactor_wakeup(). Wakeups before the callback has run are merged.
+ *
+ * @return The eventfd, or -1 on failure.
+ */
+extern int dvbreactor_add_wakeup(struct dvbreactor *reactor,
+				 dvbreactor_callback callback, void *arg);
+
+/**
+ * Unregister and close a wakeup fd.
+ */
+extern void dvbreactor_remove_wakeup(struct dvbreactor *reactor, int wakeup_fd);
+
+/**
+ * Signal a wakeup fd; may be called from any thread, or a signal handler.
+ */
+extern void dvbreactor_wakeup(int wakeup_fd);
+
+/**
+ * Run one iteration of the loop: wait for events for at most timeout ms (-1
+ * for as long as it takes, 0 not at all, either way no longer than until
+ * the next timer), then run the callbacks of the ready fds and due timers.
+ *
+ * @return The number of callbacks run, or -1 on an epoll error.
+ */
+extern int dvbreactor_poll(struct dvbreactor *reactor, int timeout);
+
+/**
+ * Run callbacks until dvbreactor_stop() is called.
+ *
+ * @return 0 when stopped, -1 on an epoll error.
+ */
+extern int dvbreactor_run(struct dvbreactor *reactor);
+
+/**
+ * Make dvbreactor_run() return; may be called from any thread.
+ */
+extern void dvbreactor_stop(struct dvbreactor *reactor);
+
+/**
+ * For running the reactor inside another loop: the epoll fd, readable when
+ * a registered fd is ready, and the ms until the next timer is due (-1 if
+ * there is none). dvbreactor_poll(reactor, 0) then runs what is ready.
+ */
+extern int dvbreactor_fd(struct dvbreactor *reactor);
+extern int dvbreactor_timeout(struct dvbreactor *reactor);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+/*
+	libdvbmisc - DVB miscellaneous library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#ifndef DVB_STATS_H
+#define DVB_STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Performance counters. Each library keeps one set of counters and log2
+ * histograms, bumped in its hot paths. Every value has a copy per slot, each
+ * slot on cache lines of its own, and a thread always uses the same slot, so
+ * threads do not share the lines they write; reading adds the slots up.
+ *
+ * Sets are dumped to stderr when the program exits if DVB_STATS is set in
+ * the environment, or appended to the file it names if it is not "", "-" or
+ * "1".
+ */
+
+#define DVBSTATS_SLOTS		16
+#define DVBSTATS_CACHE_LINE	64
+#define DVBSTATS_BUCKETS	32	/* bucket b counts values in [2^(b-1), 2^b) */
+
+struct dvbstats_set {
+	const char *name;
+	const char * const *names;	/* the counters', then the histograms' */
+	int counters;
+	int histograms;
+	int stride;			/* values per slot */
+	uint64_t *values;
+};
+
+#define DVBSTATS_STRIDE(counters, histograms) \
+	(((counters) + ((histograms) * DVBSTATS_BUCKETS) + 7) & ~7)
+
+/* define a set, with its storage */
+#define DVBSTATS_SET(var, setname, names, counters, histograms)				\
+	static uint64_t var##_values[DVBSTATS_SLOTS * DVBSTATS_STRIDE(counters, histograms)]	\
+		__attribute__((aligned(DVBSTATS_CACHE_LINE)));					\
+	struct dvbstats_set var = { setname, names, counters, histograms,			\
+				    DVBSTATS_STRIDE(counters, histograms), var##_values }
+
+static inline unsigned int dvbstats_slot(void)
+{
+	static __thread unsigned int slot;	/* slot + 1, 0 until the first use */
+	static unsigned int next;
+
+	if (slot == 0)
+		slot = (__atomic_fetch_add(&next, 1, __ATOMIC_RELAXED) % DVBSTATS_SLOTS) + 1;
+	return slot - 1;
+}
+
+static inline void dvbstats_add(struct dvbstats_set *set, int counter, uint64_t n)
+{
+	// threads may still meet in a slot, hence the (uncontended) atomic
+	__atomic_fetch_add(&set->values[(dvbstats_slot() * set->stride) + counter], n,
+			   __ATOMIC_RELAXED);
+}
+
+static inline void dvbstats_inc(struct dvbstats_set *set, int counter)
+{
+	dvbstats_add(set, counter, 1);
+}
+
+static inline void dvbstats_record(struct dvbstats_set *set, int histogram, uint64_t value)
+{
+	int bucket = value ? 64 - __builtin_clzll(value) : 0;
+
+	if (bucket >= DVBSTATS_BUCKETS)
+		bucket = DVBSTATS_BUCKETS - 1;
+	dvbstats_add(set, set->counters + (histogram * DVBSTATS_BUCKETS) + bucket, 1);
+}
+
+/* the total of a value over the slots */
+static inline uint64_t dvbstats_sum(struct dvbstats_set *set, int value)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for(i = 0; i < DVBSTATS_SLOTS; i++)
+		sum += __atomic_load_n(&set->values[(i * set->stride) + value], __ATOMIC_RELAXED);
+	return sum;
+}
+
+static inline uint64_t dvbstats_read(struct dvbstats_set *set, int counter)
+{
+	return dvbstats_sum(set, counter);
+}
+
+static inline uint64_t dvbstats_read_bucket(struct dvbstats_set *set, int histogram, int bucket)
+{
+	return dvbstats_sum(set, set->counters + (histogram * DVBSTATS_BUCKETS) + bucket);
+}
+
+static inline void dvbstats_dump(FILE *f, struct dvbstats_set *set)
+{
+	const char *name;
+	uint64_t count;
+	int i;
+	int b;
+
+	for(i = 0; i < set->counters; i++)
+		fprintf(f, "%s.%s %llu\n", set->name, set->names[i],
+			(unsigned long long) dvbstats_read(set, i));
+
+	for(i = 0; i < set->histograms; i++) {
+		name = set->names[set->counters + i];
+		for(b = 0; b < DVBSTATS_BUCKETS; b++) {
+			if ((count = dvbstats_read_bucket(set, i, b)) == 0)
+				continue;
+			if (b == 0)
+				fprintf(f, "%s.%s[0] %llu\n", set->name, name,
+					(unsigned long long) count);
+			else
+				fprintf(f, "%s.%s[%llu..%llu] %llu\n", set->name, name,
+					1ULL << (b - 1),
+					(b < DVBSTATS_BUCKETS - 1) ? (2ULL << (b - 1)) - 1 : ~0ULL,
+					(unsigned long long) count);
+		}
+	}
+}
+
+/* for the libraries' destructors */
+static inline void dvbstats_dump_at_exit(struct dvbstats_set *set)
+{
+	const char *path = getenv("DVB_STATS");
+	FILE *f;
+
+	if (path == NULL)
+		return;
+	if ((*path == 0) || !strcmp(path, "-") || !strcmp(path, "1")) {
+		dvbstats_dump(stderr, set);
+		return;
+	}
+	if ((f = fopen(path, "a")) == NULL)
+		return;
+	dvbstats_dump(f, set);
+	fclose(f);
+}
+
+#endif
@@ -25,7 +25,18 @@
 #include <ctype.h>
 #include <linux/types.h>
 #include <libdvbapi/dvbfe.h>
+#include <libdvbapi/dvblatency.h>
+#include <libdvbmisc/dvbstats.h>
 #include "dvbsec_api.h"
+#include "dvbsec_stats.h"
+
+/*
+ * What dvbsec_set() last established on a frontend, for its SEC state cache:
+ * the config type, and the four switch settings in six bits each.
+ */
+#define SEC_STATE_KEY(type, osc, pol, sat, opt) \
+	((((uint32_t) (type)) << 24) | (((osc) & 0x3f) << 18) | (((pol) & 0x3f) << 12) | \
+	 (((sat) & 0x3f) << 6) | ((opt) & 0x3f))
 
 // uncomment this to make dvbsec_command print out debug instead of talking to a frontend
 // #define TEST_SEC_COMMAND 1
@@ -42,15 +53,32 @@ int dvbsec_set(struct dvbfe_handle *fe,
 	struct dvbfe_parameters localparams;
 	struct dvbfe_parameters *topass = params;
 
+	dvbstats_inc(&dvbsec_stats, DVBSEC_STATS_SETS);
+
 	// perform SEC
 	if (sec_config != NULL) {
+		if (sec_config->config_type != DVBSEC_CONFIG_NONE)
+			dvblatency_mark(dvbfe_get_latency(fe), DVBLATENCY_DISEQC_SENT);
+
 		switch(sec_config->config_type) {
 		case DVBSEC_CONFIG_NONE:
 			break;
 
 		case DVBSEC_CONFIG_POWER:
-			dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_13);
+		{
+			struct dvbfe_sec_state *state = dvbfe_get_sec_state(fe);
+			uint32_t key = SEC_STATE_KEY(DVBSEC_CONFIG_POWER, 0, 0, 0, 0);
+
+			if (state->valid && (state->key == key)) {
+				dvbstats_inc(&dvbsec_stats, DVBSEC_STATS_SEC_SKIPPED);
+				break;
+			}
+			if (dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_13) == 0) {
+				state->key = key;
+				state->valid = 1;
+			}
 			break;
+		}
 
 		case DVBSEC_CONFIG_STANDARD:
 		{
@@ -112,6 +140,11 @@ int dvbsec_set(struct dvbfe_handle *fe,
 					return tmp;
 			break;
 		}
+
+		case DVBSEC_CONFIG_UNICABLE:
+		case DVBSEC_CONFIG_JESS:
+			// the SCR command depends on the frequency: sent below
+			break;
 		}
 
 		// work out the correct LOF value
@@ -166,6 +199,18 @@ int dvbsec_set(struct dvbfe_handle *fe,
 		}
 	}
 
+	// the SCR does the tuning
+	if ((sec_config != NULL) &&
+	    ((sec_config->config_type == DVBSEC_CONFIG_UNICABLE) ||
+	     (sec_config->config_type == DVBSEC_CONFIG_JESS))) {
+		int high = 0;
+		if (sec_config->switch_frequency && (sec_config->switch_frequency < params->frequency))
+			high = 1;
+
+		return dvbsec_scr_set(fe, sec_config, polarization, sat_pos, high,
+				      topass->frequency, params, timeout);
+	}
+
 	// set the frontend!
 	return dvbfe_set(fe, topass, timeout);
 }
@@ -176,36 +221,46 @@ int dvbsec_std_sequence(struct dvbfe_handle *fe,
 			   enum dvbsec_diseqc_switch sat_pos,
 			   enum dvbsec_diseqc_switch switch_option)
 {
-	dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_OFF);
+	struct dvbfe_sec_state *state = dvbfe_get_sec_state(fe);
+	uint32_t key = SEC_STATE_KEY(DVBSEC_CONFIG_STANDARD, oscillator, polarization, sat_pos, switch_option);
+	int err = 0;
+
+	// the LNB and switches are already set this way
+	if (state->valid && (state->key == key)) {
+		dvbstats_inc(&dvbsec_stats, DVBSEC_STATS_SEC_SKIPPED);
+		return 0;
+	}
+
+	err |= dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_OFF);
 
 	switch(polarization) {
 	case DISEQC_POLARIZATION_V:
 	case DISEQC_POLARIZATION_R:
-		dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_13);
+		err |= dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_13);
 		break;
 	case DISEQC_POLARIZATION_H:
 	case DISEQC_POLARIZATION_L:
-		dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_18);
+		err |= dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_18);
 		break;
 	default:
 		return -EINVAL;
 	}
 
-	dvbsec_diseqc_set_committed_switches(fe,
-					    DISEQC_ADDRESS_ANY_DEVICE,
-					    oscillator,
-					    polarization,
-					    sat_pos,
-					    switch_option);
+	err |= dvbsec_diseqc_set_committed_switches(fe,
+						   DISEQC_ADDRESS_ANY_DEVICE,
+						   oscillator,
+						   polarization,
+						   sat_pos,
+						   switch_option);
 
 	usleep(15000);
 
 	switch(sat_pos) {
 	case DISEQC_SWITCH_A:
-		dvbfe_set_tone_data_burst(fe, DVBFE_SEC_MINI_A);
+		err |= dvbfe_set_tone_data_burst(fe, DVBFE_SEC_MINI_A);
 		break;
 	case DISEQC_SWITCH_B:
-		dvbfe_set_tone_data_burst(fe, DVBFE_SEC_MINI_B);
+		err |= dvbfe_set_tone_data_burst(fe, DVBFE_SEC_MINI_B);
 		break;
 	default:
 		break;
@@ -216,15 +271,25 @@ int dvbsec_std_sequence(struct dvbfe_handle *fe,
 
 	switch(oscillator) {
 	case DISEQC_OSCILLATOR_LOW:
-		dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_OFF);
+		err |= dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_OFF);
 		break;
 	case DISEQC_OSCILLATOR_HIGH:
-		dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_ON);
+		err |= dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_ON);
 		break;
 	default:
 		break;
 	}
 
+	// UNCHANGED switches leave whatever was there before in place
+	if ((err == 0) &&
+	    (oscillator != DISEQC_OSCILLATOR_UNCHANGED) &&
+	    (polarization != DISEQC_POLARIZATION_UNCHANGED) &&
+	    (sat_pos != DISEQC_SWITCH_UNCHANGED) &&
+	    (switch_option != DISEQC_SWITCH_UNCHANGED)) {
+		state->key = key;
+		state->valid = 1;
+	}
+
 	return 0;
 }
 
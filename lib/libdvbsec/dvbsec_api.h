@@ -118,10 +118,13 @@ enum dvbsec_config_type {
 	DVBSEC_CONFIG_POWER,
 	DVBSEC_CONFIG_STANDARD,
 	DVBSEC_CONFIG_ADVANCED,
+	DVBSEC_CONFIG_UNICABLE,
+	DVBSEC_CONFIG_JESS,
 };
 
 
 #define MAX_SEC_CMD_LEN 100
+#define DVBSEC_MAX_SCR 32
 
 struct dvbsec_config
 {
@@ -147,6 +150,11 @@ struct dvbsec_config
 	 *
 	 * ADVANCED - SEC strings are supplied by the user describing the exact sequence
 	 * of operations to use.
+	 *
+	 * UNICABLE - an EN 50494 single cable installation: each tune is an
+	 * ODU_ChannelChange to one of the SCRs (user bands) below.
+	 *
+	 * JESS - the same with EN 50607 (Unicable II) commands, for up to 32 SCRs.
 	 */
 	enum dvbsec_config_type config_type;
 
@@ -159,6 +167,12 @@ struct dvbsec_config
 	char adv_cmd_hi_v[MAX_SEC_CMD_LEN];			/* ADVANCED SEC command to use for HI/V. */
 	char adv_cmd_hi_l[MAX_SEC_CMD_LEN];			/* ADVANCED SEC command to use for HI/L. */
 	char adv_cmd_hi_r[MAX_SEC_CMD_LEN];			/* ADVANCED SEC command to use for HI/R. */
+
+	/* stuff for type == DVBSEC_CONFIG_UNICABLE or DVBSEC_CONFIG_JESS */
+	uint32_t scr_frequency[DVBSEC_MAX_SCR];	/* centre of each SCR's user band; 0 => not ours to use */
+	int scr_use_pin;			/* 1 => use the PIN protected commands */
+	uint8_t scr_pin;
+	char scr_bus[32];			/* name of the cable the SCRs are on; "" => "default" */
 };
 
 /**
@@ -173,6 +187,11 @@ struct dvbsec_config
  *
  * The sec configuration structures can be looked up using the dvbcfg_sec library.
  *
+ * The SEC state set up for POWER and STANDARD configurations is remembered
+ * per frontend (see dvbfe_get_sec_state()), and a retune to the same band,
+ * polarisation and switch position goes straight to setting the frontend.
+ * ADVANCED command strings are always sent.
+ *
  * @param fe Frontend concerned.
  * @param sec_config SEC configuration structure. May be NULL to disable SEC/frequency adjustment.
  * @param polarization Polarization of signal.
@@ -192,12 +211,65 @@ extern int dvbsec_set(struct dvbfe_handle *fe,
 			  struct dvbfe_parameters *params,
 			  int timeout);
 
+/**
+ * Tune through a Unicable (EN 50494) or JESS (EN 50607) SCR; dvbsec_set()
+ * calls this for such configurations, once it has worked out the LOF.
+ *
+ * The frontend is given an SCR of its own the first time, which it keeps
+ * until dvbsec_scr_release() or dvbfe_close(). The SCRs of a cable are
+ * shared among all processes on the host through lock files (in
+ * DVBSEC_LOCK_DIR if set in the environment, else /var/lock), which also
+ * stop two local tuners talking on the cable at the same time.
+ *
+ * Commands from other hosts on the cable may still collide with ours, so
+ * when the caller waits for a lock, a tune which doesn't lock is retried
+ * after a randomised backoff.
+ *
+ * @param fe Frontend concerned.
+ * @param sec_config SEC configuration structure.
+ * @param polarization Polarization of signal.
+ * @param sat_pos Satellite position.
+ * @param high 1 for the high band.
+ * @param if_frequency The frequency after the LOF, in kHz.
+ * @param params Tuning parameters; the frequency is replaced with the SCR's.
+ * @param timeout As for dvbsec_set().
+ * @return 0 on locked (or if timeout==0 and everything else worked),
+ * -EBUSY if all the SCRs are taken, or other nonzero on failure.
+ */
+extern int dvbsec_scr_set(struct dvbfe_handle *fe,
+			  struct dvbsec_config *sec_config,
+			  enum dvbsec_diseqc_polarization polarization,
+			  enum dvbsec_diseqc_switch sat_pos,
+			  int high,
+			  uint32_t if_frequency,
+			  struct dvbfe_parameters *params,
+			  int timeout);
+
+/**
+ * The SCR a frontend is using.
+ *
+ * @param fe Frontend concerned.
+ * @return The SCR number, or -1 if it has none.
+ */
+extern int dvbsec_scr_get(struct dvbfe_handle *fe);
+
+/**
+ * Switch a frontend's SCR off and give it up for others to use.
+ *
+ * @param fe Frontend concerned.
+ */
+extern void dvbsec_scr_release(struct dvbfe_handle *fe);
+
 /**
  * This will issue the standardised back-compatable DISEQC/SEC command
  * sequence as defined in the DISEQC spec:
  *
  * i.e. tone off, set voltage, wait15, DISEQC, wait15, toneburst, wait15, set tone.
  *
+ * Nothing is sent if the last sequence sent to the frontend (with no other
+ * SEC calls since) set the same values; none of them may be UNCHANGED for
+ * the sequence to be remembered.
+ *
  * @param fe Frontend concerned.
  * @param oscillator Value to set the lo/hi switch to.
  * @param polarization Value to set the polarisation switch to.
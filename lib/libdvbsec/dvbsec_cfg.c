@@ -25,6 +25,8 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include <linux/types.h>
 #include "dvbsec_cfg.h"
 
@@ -144,6 +146,10 @@ int dvbsec_cfg_load(FILE *f,
 				tmpsec.config_type = DVBSEC_CONFIG_STANDARD;
 			} else if (!strcasecmp(value, "advanced")) {
 				tmpsec.config_type = DVBSEC_CONFIG_ADVANCED;
+			} else if (!strcasecmp(value, "unicable")) {
+				tmpsec.config_type = DVBSEC_CONFIG_UNICABLE;
+			} else if (!strcasecmp(value, "jess")) {
+				tmpsec.config_type = DVBSEC_CONFIG_JESS;
 			} else {
 				insection = 0;
 			}
@@ -163,6 +169,23 @@ int dvbsec_cfg_load(FILE *f,
 			strncpy(tmpsec.adv_cmd_hi_r, value, sizeof(tmpsec.adv_cmd_hi_r));
 		} else if ((value = dvbcfg_iskey(line, "cmd-hi-l")) != NULL) {
 			strncpy(tmpsec.adv_cmd_hi_l, value, sizeof(tmpsec.adv_cmd_hi_l));
+		} else if ((value = dvbcfg_iskey(line, "scr-frequencies")) != NULL) {
+			int scr = 0;
+			char *cur = value;
+
+			memset(tmpsec.scr_frequency, 0, sizeof(tmpsec.scr_frequency));
+			while(*cur && (scr < DVBSEC_MAX_SCR)) {
+				tmpsec.scr_frequency[scr++] = strtoul(cur, &cur, 10);
+				while(*cur && (*cur != ','))
+					cur++;
+				if (*cur == ',')
+					cur++;
+			}
+		} else if ((value = dvbcfg_iskey(line, "scr-pin")) != NULL) {
+			tmpsec.scr_use_pin = 1;
+			tmpsec.scr_pin = atoi(value);
+		} else if ((value = dvbcfg_iskey(line, "scr-bus")) != NULL) {
+			strncpy(tmpsec.scr_bus, value, sizeof(tmpsec.scr_bus) - 1);
 		} else {
 			insection = 0;
 		}
@@ -250,6 +273,12 @@ int dvbsec_cfg_save(FILE *f,
 		case DVBSEC_CONFIG_ADVANCED:
 			config_type = "advanced";
 			break;
+		case DVBSEC_CONFIG_UNICABLE:
+			config_type = "unicable";
+			break;
+		case DVBSEC_CONFIG_JESS:
+			config_type = "jess";
+			break;
 		}
 
 		fprintf(f, "[lnb]\n");
@@ -291,6 +320,23 @@ int dvbsec_cfg_save(FILE *f,
 				fprintf(f, "cmd-hi-l=%s\n", secs[i].adv_cmd_hi_l);
 		}
 
+		if ((secs[i].config_type == DVBSEC_CONFIG_UNICABLE) ||
+		    (secs[i].config_type == DVBSEC_CONFIG_JESS)) {
+			int last = DVBSEC_MAX_SCR - 1;
+			int scr;
+
+			while((last > 0) && (secs[i].scr_frequency[last] == 0))
+				last--;
+			fprintf(f, "scr-frequencies=");
+			for(scr=0; scr <= last; scr++)
+				fprintf(f, "%s%u", scr ? "," : "", secs[i].scr_frequency[scr]);
+			fprintf(f, "\n");
+			if (secs[i].scr_use_pin)
+				fprintf(f, "scr-pin=%i\n", secs[i].scr_pin);
+			if (secs[i].scr_bus[0])
+				fprintf(f, "scr-bus=%s\n", secs[i].scr_bus);
+		}
+
 		fprintf(f, "\n");
 	}
 
@@ -364,3 +410,232 @@ static int dvbsec_cfg_find_default(const char *sec_id,
 
 	return -1;
 }
+
+struct dvbsec_cfg_store {
+	char *filename;
+	struct stat source;		/* of the file as loaded */
+
+	struct dvbsec_config *secs;
+	int count;
+	int size;
+	int failed;			/* ran out of memory while loading */
+
+	uint32_t *hash;			/* entry number + 1, 0 if free */
+	uint32_t hash_slots;		/* a power of two, never full */
+
+	struct dvbsec_topo *topos;	/* of the frontends asked about so far */
+	int topo_count;
+	int topo_size;
+};
+
+static uint32_t dvbsec_cfg_hash(const char *sec_id)
+{
+	uint32_t hash = 2166136261U;
+	size_t i;
+
+	for(i=0; (i < sizeof(((struct dvbsec_config *) 0)->id)) && sec_id[i]; i++) {
+		hash ^= (uint8_t) sec_id[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static int dvbsec_cfg_store_callback(void *arg, struct dvbsec_config *sec)
+{
+	struct dvbsec_cfg_store *store = arg;
+	struct dvbsec_config *tmp;
+
+	if (store->count == store->size) {
+		int size = store->size ? store->size * 2 : 16;
+
+		if ((tmp = realloc(store->secs, size * sizeof(struct dvbsec_config))) == NULL) {
+			store->failed = 1;
+			return 1;
+		}
+		store->secs = tmp;
+		store->size = size;
+	}
+
+	memcpy(&store->secs[store->count++], sec, sizeof(struct dvbsec_config));
+	return 0;
+}
+
+/**
+ * Parse the file into a new set of entries, which replace the old ones only
+ * once they're complete.
+ */
+static int dvbsec_cfg_store_load(struct dvbsec_cfg_store *store, struct stat *source)
+{
+	struct dvbsec_cfg_store tmp;
+	FILE *f;
+	uint32_t slot;
+	int i;
+
+	if ((f = fopen(store->filename, "r")) == NULL)
+		return -EIO;
+	memset(&tmp, 0, sizeof(tmp));
+	dvbsec_cfg_load(f, &tmp, dvbsec_cfg_store_callback);
+	fclose(f);
+
+	if (tmp.failed) {
+		free(tmp.secs);
+		return -ENOMEM;
+	}
+
+	for(tmp.hash_slots = 16; tmp.hash_slots < (uint32_t) (tmp.count * 2); tmp.hash_slots *= 2);
+	if ((tmp.hash = calloc(tmp.hash_slots, sizeof(uint32_t))) == NULL) {
+		free(tmp.secs);
+		return -ENOMEM;
+	}
+
+	// only the first entry with an ID goes in
+	for(i=0; i < tmp.count; i++) {
+		slot = dvbsec_cfg_hash(tmp.secs[i].id) & (tmp.hash_slots - 1);
+		while(tmp.hash[slot] &&
+		      strncmp(tmp.secs[tmp.hash[slot] - 1].id, tmp.secs[i].id, sizeof(tmp.secs[i].id)))
+			slot = (slot + 1) & (tmp.hash_slots - 1);
+		if (tmp.hash[slot] == 0)
+			tmp.hash[slot] = i + 1;
+	}
+
+	free(store->secs);
+	free(store->hash);
+	store->secs = tmp.secs;
+	store->count = tmp.count;
+	store->size = tmp.size;
+	store->hash = tmp.hash;
+	store->hash_slots = tmp.hash_slots;
+	memcpy(&store->source, source, sizeof(struct stat));
+	return 0;
+}
+
+static void dvbsec_cfg_store_check(struct dvbsec_cfg_store *store)
+{
+	struct stat source;
+
+	if (stat(store->filename, &source))
+		return;
+
+	if ((source.st_size != store->source.st_size) ||
+	    (source.st_ino != store->source.st_ino) ||
+	    (source.st_dev != store->source.st_dev) ||
+	    (source.st_mtim.tv_sec != store->source.st_mtim.tv_sec) ||
+	    (source.st_mtim.tv_nsec != store->source.st_mtim.tv_nsec))
+		dvbsec_cfg_store_load(store, &source);
+}
+
+struct dvbsec_cfg_store *dvbsec_cfg_store_open(const char *config_file)
+{
+	struct dvbsec_cfg_store *store;
+	struct stat source;
+	int err;
+
+	if ((store = calloc(1, sizeof(struct dvbsec_cfg_store))) == NULL)
+		return NULL;
+	if (config_file == NULL)
+		return store;
+
+	if ((store->filename = strdup(config_file)) == NULL) {
+		free(store);
+		return NULL;
+	}
+	if (stat(config_file, &source))
+		err = errno;
+	else
+		err = -dvbsec_cfg_store_load(store, &source);
+	if (err) {
+		dvbsec_cfg_store_close(store);
+		errno = err;
+		return NULL;
+	}
+
+	return store;
+}
+
+void dvbsec_cfg_store_close(struct dvbsec_cfg_store *store)
+{
+	free(store->filename);
+	free(store->secs);
+	free(store->hash);
+	free(store->topos);
+	free(store);
+}
+
+int dvbsec_cfg_store_find(struct dvbsec_cfg_store *store,
+			  const char *sec_id,
+			  struct dvbsec_config *sec)
+{
+	uint32_t slot;
+
+	memset(sec, 0, sizeof(struct dvbsec_config));
+
+	if (store->filename != NULL) {
+		dvbsec_cfg_store_check(store);
+
+		slot = dvbsec_cfg_hash(sec_id) & (store->hash_slots - 1);
+		while(store->hash[slot]) {
+			struct dvbsec_config *cur = &store->secs[store->hash[slot] - 1];
+
+			if (!strncmp(cur->id, sec_id, sizeof(cur->id))) {
+				memcpy(sec, cur, sizeof(struct dvbsec_config));
+				return 0;
+			}
+			slot = (slot + 1) & (store->hash_slots - 1);
+		}
+	}
+
+	return dvbsec_cfg_find_default(sec_id, sec);
+}
+
+int dvbsec_cfg_store_count(struct dvbsec_cfg_store *store)
+{
+	return store->count;
+}
+
+int dvbsec_cfg_store_topo(struct dvbsec_cfg_store *store,
+			  struct dvbfe_handle *fe,
+			  int adapter, int frontend, int flags,
+			  struct dvbsec_topo *topo)
+{
+	char key[DVBSEC_TOPO_KEY_LEN];
+	int i, err;
+
+	dvbsec_topo_key(adapter, frontend, key);
+
+	if (!(flags & DVBSEC_TOPO_REDISCOVER)) {
+		for(i=0; i < store->topo_count; i++) {
+			if (!strcmp(store->topos[i].key, key)) {
+				memcpy(topo, &store->topos[i], sizeof(struct dvbsec_topo));
+				return 0;
+			}
+		}
+	}
+
+	if ((flags & DVBSEC_TOPO_REDISCOVER) || dvbsec_topo_cache_read(key, topo)) {
+		if ((flags & DVBSEC_TOPO_CACHE_ONLY) || (fe == NULL))
+			return -ENOENT;
+		if ((err = dvbsec_topo_discover(fe, topo)) != 0)
+			return err;
+		snprintf(topo->key, sizeof(topo->key), "%s", key);
+		dvbsec_topo_cache_write(topo);
+	}
+
+	for(i=0; i < store->topo_count; i++)
+		if (!strcmp(store->topos[i].key, key))
+			break;
+	if (i == store->topo_size) {
+		int size = store->topo_size ? store->topo_size * 2 : 4;
+		struct dvbsec_topo *tmp;
+
+		if ((tmp = realloc(store->topos, size * sizeof(struct dvbsec_topo))) == NULL)
+			return 0;
+		store->topos = tmp;
+		store->topo_size = size;
+	}
+	memcpy(&store->topos[i], topo, sizeof(struct dvbsec_topo));
+	if (i == store->topo_count)
+		store->topo_count++;
+
+	return 0;
+}
@@ -50,7 +50,7 @@
  * lof-hi-h=<high band + H + frequency>
  * lof-hi-l=<high band + L + frequency>
  * lof-hi-r=<high band + R + frequency>
- * config-type=<none|power|standard|advanced>
+ * config-type=<none|power|standard|advanced|unicable|jess>
  * cmd-lo-v=<sec sequence>
  * cmd-lo-h=<sec sequence>
  * cmd-lo-r=<sec sequence>
@@ -59,6 +59,9 @@
  * cmd-hi-h=<sec sequence>
  * cmd-hi-r=<sec sequence>
  * cmd-hi-l=<sec sequence>
+ * scr-frequencies=<user band frequency of SCR 0>,<SCR 1>,...
+ * scr-pin=<pin>
+ * scr-bus=<cable name>
  *
  * The sec_id is whatever unique value you wish. If it is the same as one of the hardcoded defaults, the configuration
  * 	details from the file will be used instead of the hardcoded ones.
@@ -78,6 +81,15 @@
  * 	power - Only the SEC power is turned on.
  * 	standard - The standard DISEQC back compatable sequence will be issued.
  * 	advanced - The DISEQC sequence described in the appropriate sec cmd string will be used.
+ * 	unicable - An EN 50494 (Unicable) single cable system: the LNB or switch is tuned through an SCR.
+ * 	jess - An EN 50607 (JESS/Unicable II) single cable system.
+ *
+ * The scr-frequencies list the user band frequency (in kHz) of each SCR, from SCR 0 on, for unicable
+ * 	(up to 8) and jess (up to 32); each tuner takes a free one of them. An SCR used by equipment other
+ * 	than this host's tuners should be given as 0.
+ * The scr-pin is the PIN of an installation with protected user bands, if any.
+ * The scr-bus names the cable, so SCRs are shared between all the processes using it; there's
+ * 	no need for one if the host's tuners are all on the same cable.
  *
  * The cmd-<lo|hi>-<v|h|l|r> describes the SEC cmd string to use in advanced mode for each of the possible combinations of
  * frequency band and polarisation. If a certain combination is not required, it may be omitted. It consists of a
@@ -149,6 +161,7 @@ extern "C"
 #include <stdio.h>
 #include <stdint.h>
 #include <libdvbsec/dvbsec_api.h>
+#include <libdvbsec/dvbsec_topo.h>
 
 /**
  * Callback function used in dvbsec_cfg_load().
@@ -196,6 +209,70 @@ extern int dvbsec_cfg_save(FILE *f,
 			   struct dvbsec_config *secs,
 			   int count);
 
+/**
+ * An SEC config file loaded into memory once, with its entries hashed on
+ * their ID, for callers which look SEC configurations up for every tune.
+ * The file's size, inode and mtime are checked on each lookup, and it is
+ * reloaded when they change; if the reload fails, the previous contents
+ * stay in use. A store is not thread safe.
+ */
+struct dvbsec_cfg_store;
+
+/**
+ * Load an SEC config file into a store.
+ *
+ * @param config_file Config filename to load, or NULL for just the defaults.
+ * @return The store, or NULL on failure (errno is set).
+ */
+extern struct dvbsec_cfg_store *dvbsec_cfg_store_open(const char *config_file);
+
+/**
+ * Close a store.
+ *
+ * @param store The store.
+ */
+extern void dvbsec_cfg_store_close(struct dvbsec_cfg_store *store);
+
+/**
+ * Look up an SEC configuration, as dvbsec_cfg_find() would: the first entry
+ * of the file with the ID, or else the hardcoded default.
+ *
+ * @param store The store.
+ * @param sec_id ID of SEC configuration.
+ * @param sec Where to put the details if found.
+ * @return 0 on success, nonzero on error.
+ */
+extern int dvbsec_cfg_store_find(struct dvbsec_cfg_store *store,
+				 const char *sec_id,
+				 struct dvbsec_config *sec);
+
+/**
+ * Number of entries loaded from the file of a store.
+ *
+ * @param store The store.
+ * @return The number of entries.
+ */
+extern int dvbsec_cfg_store_count(struct dvbsec_cfg_store *store);
+
+/**
+ * Get the switch and LNB topology of a frontend (see dvbsec_topo.h): as the
+ * store has it from an earlier call, else from the cache file, else by
+ * discovery on the frontend, which is then written to the cache file (a
+ * cache file which cannot be written is not an error).
+ *
+ * @param store The store.
+ * @param fe Frontend concerned; may be NULL with DVBSEC_TOPO_CACHE_ONLY.
+ * @param adapter Adapter number of the frontend.
+ * @param frontend Frontend number.
+ * @param flags DVBSEC_TOPO_* flags.
+ * @param topo Where to put the topology.
+ * @return 0 on success, nonzero on error.
+ */
+extern int dvbsec_cfg_store_topo(struct dvbsec_cfg_store *store,
+				 struct dvbfe_handle *fe,
+				 int adapter, int frontend, int flags,
+				 struct dvbsec_topo *topo);
+
 #ifdef __cplusplus
 }
 #endif
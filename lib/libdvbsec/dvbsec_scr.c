@@ -0,0 +1,349 @@
+/*
+	libdvbsec - an SEC library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+#include <libdvbapi/dvbfe.h>
+#include "dvbsec_api.h"
+
+#define SCR_LOCK_DIR "/var/lock"
+
+// a tune which doesn't lock within SCR_VERIFY_TIME ms is retried, up to
+// SCR_ATTEMPTS times, after a random wait of up to SCR_BACKOFF ms, doubling
+#define SCR_ATTEMPTS 4
+#define SCR_VERIFY_TIME 1000
+#define SCR_BACKOFF 50
+
+// EN 50494 commands, after the E0 10 framing and address
+#define UNICABLE_CHANNEL_CHANGE 0x5A
+#define UNICABLE_CHANNEL_CHANGE_PIN 0x5C
+
+// EN 50607 commands, sent without framing
+#define JESS_CHANNEL_CHANGE 0x70
+#define JESS_CHANNEL_CHANGE_PIN 0x71
+
+/*
+ * What a frontend holds: its SCR, with the lock file which keeps it ours, and
+ * the cable's bus lock file. Kept in the frontend's dvbfe_sec_state.
+ */
+struct scr_state {
+	char bus[32];
+	int jess;
+	int use_pin;
+	uint8_t pin;
+	int scr;
+	int scr_fd;
+	int bus_fd;
+};
+
+static unsigned int backoff_seed = 0;
+
+static void scr_lock_name(char *buf, size_t len, const char *bus, int scr)
+{
+	const char *dir = getenv("DVBSEC_LOCK_DIR");
+
+	if (dir == NULL)
+		dir = SCR_LOCK_DIR;
+	if (scr < 0)
+		snprintf(buf, len, "%s/dvbsec-%s.lock", dir, bus);
+	else
+		snprintf(buf, len, "%s/dvbsec-%s-scr%i.lock", dir, bus, scr);
+}
+
+static int scr_lock_open(const char *bus, int scr)
+{
+	char filename[PATH_MAX];
+
+	scr_lock_name(filename, sizeof(filename), bus, scr);
+	return open(filename, O_RDWR|O_CREAT|O_CLOEXEC, 0666);
+}
+
+/**
+ * Build the command putting an SCR on a frequency, or switching it off if
+ * if_frequency is 0.
+ *
+ * @return The command length, with the frequency to tune to in *tune_frequency.
+ */
+static int scr_build_command(struct scr_state *state, struct dvbsec_config *sec_config,
+			     int bank, uint32_t if_frequency, uint8_t *cmd, uint32_t *tune_frequency)
+{
+	uint32_t scr_frequency = sec_config->scr_frequency[state->scr];
+	uint32_t t = 0;
+	int len;
+
+	if (!state->jess) {
+		/*
+		 * The SCR's oscillator is at (T + 350) * 4MHz, and the user band
+		 * is what it mixes down to, so the rounding of T moves the
+		 * transponder off the centre of the band by up to 2MHz.
+		 */
+		if (if_frequency) {
+			t = ((if_frequency + scr_frequency + 2000) / 4000) - 350;
+			*tune_frequency = ((t + 350) * 4000) - if_frequency;
+		}
+
+		cmd[0] = DISEQC_FRAMING_MASTER_NOREPLY;
+		cmd[1] = DISEQC_ADDRESS_ANY_LNB_SWITCHER_SMATV;
+		cmd[2] = state->use_pin ? UNICABLE_CHANNEL_CHANGE_PIN : UNICABLE_CHANNEL_CHANGE;
+		cmd[3] = (state->scr << 5) | (if_frequency ? ((bank & 0x07) << 2) | ((t >> 8) & 0x03) : 0);
+		cmd[4] = t & 0xff;
+		len = 5;
+	} else {
+		// T is the transponder's IF in MHz; it lands within 500kHz of the centre
+		if (if_frequency) {
+			t = ((if_frequency + 500) / 1000) - 100;
+			*tune_frequency = scr_frequency;
+		}
+
+		cmd[0] = state->use_pin ? JESS_CHANNEL_CHANGE_PIN : JESS_CHANNEL_CHANGE;
+		cmd[1] = (state->scr << 3) | ((t >> 8) & 0x07);
+		cmd[2] = t & 0xff;
+		cmd[3] = if_frequency ? bank : 0;
+		len = 4;
+	}
+
+	if (state->use_pin)
+		cmd[len++] = state->pin;
+
+	return len;
+}
+
+/**
+ * Send a command on the cable: at 18V, which is what the SCRs listen for,
+ * and with no other local tuner talking at the same time.
+ */
+static int scr_send_command(struct dvbfe_handle *fe, struct scr_state *state, uint8_t *cmd, int len)
+{
+	int err = 0;
+
+	if (state->bus_fd != -1)
+		flock(state->bus_fd, LOCK_EX);
+
+	err |= dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_OFF);
+	err |= dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_18);
+	usleep(15000);
+	err |= dvbfe_do_diseqc_command(fe, cmd, len);
+	usleep(15000);
+	err |= dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_13);
+
+	if (state->bus_fd != -1)
+		flock(state->bus_fd, LOCK_UN);
+
+	return err ? -EIO : 0;
+}
+
+static void scr_release(struct dvbfe_handle *fe, void *priv)
+{
+	struct scr_state *state = (struct scr_state *) priv;
+	struct dvbfe_sec_state *sec_state = dvbfe_get_sec_state(fe);
+	struct dvbsec_config sec_config;
+	uint32_t unused;
+	uint8_t cmd[6];
+	int len;
+
+	// the SCR is switched off before anyone else may have it
+	if (state->scr != -1) {
+		memset(&sec_config, 0, sizeof(sec_config));
+		len = scr_build_command(state, &sec_config, 0, 0, cmd, &unused);
+		scr_send_command(fe, state, cmd, len);
+		close(state->scr_fd);
+	}
+	if (state->bus_fd != -1)
+		close(state->bus_fd);
+	free(state);
+
+	sec_state->priv = NULL;
+	sec_state->release = NULL;
+}
+
+/**
+ * Get the frontend's SCR state, allocating an SCR if it doesn't have one of
+ * the configuration's.
+ */
+static int scr_acquire(struct dvbfe_handle *fe, struct dvbsec_config *sec_config,
+		       struct scr_state **result)
+{
+	struct dvbfe_sec_state *sec_state = dvbfe_get_sec_state(fe);
+	struct scr_state *state = NULL;
+	const char *bus = sec_config->scr_bus[0] ? sec_config->scr_bus : "default";
+	int jess = (sec_config->config_type == DVBSEC_CONFIG_JESS);
+	int max_scr = jess ? DVBSEC_MAX_SCR : 8;
+	int start;
+	int fd;
+	int i;
+
+	if (sec_state->release == scr_release) {
+		state = (struct scr_state *) sec_state->priv;
+		if ((state->scr != -1) && !strcmp(state->bus, bus) && (state->jess == jess) &&
+		    (state->scr < max_scr) && sec_config->scr_frequency[state->scr]) {
+			state->use_pin = sec_config->scr_use_pin;
+			state->pin = sec_config->scr_pin;
+			*result = state;
+			return 0;
+		}
+
+		// a different installation: start again
+		scr_release(fe, state);
+	} else if (sec_state->release) {
+		sec_state->release(fe, sec_state->priv);
+	}
+
+	if ((state = malloc(sizeof(struct scr_state))) == NULL)
+		return -ENOMEM;
+	memset(state, 0, sizeof(struct scr_state));
+	snprintf(state->bus, sizeof(state->bus), "%s", bus);
+	state->jess = jess;
+	state->use_pin = sec_config->scr_use_pin;
+	state->pin = sec_config->scr_pin;
+	state->scr = -1;
+	state->scr_fd = -1;
+	state->bus_fd = scr_lock_open(state->bus, -1);
+
+	/*
+	 * Take the first free SCR, starting from a random one so that hosts
+	 * sharing the cable (and not our lock files) are less likely to pick
+	 * the same one. The lock is held for as long as the SCR is ours, and
+	 * goes with the process.
+	 */
+	if (backoff_seed == 0)
+		backoff_seed = getpid() ^ time(NULL);
+	start = rand_r(&backoff_seed) % max_scr;
+	for(i=0; i < max_scr; i++) {
+		int scr = (start + i) % max_scr;
+
+		if (sec_config->scr_frequency[scr] == 0)
+			continue;
+		if ((fd = scr_lock_open(state->bus, scr)) < 0)
+			continue;
+		if (flock(fd, LOCK_EX|LOCK_NB) == 0) {
+			state->scr = scr;
+			state->scr_fd = fd;
+			break;
+		}
+		close(fd);
+	}
+	if (state->scr == -1) {
+		if (state->bus_fd != -1)
+			close(state->bus_fd);
+		free(state);
+		return -EBUSY;
+	}
+
+	sec_state->priv = state;
+	sec_state->release = scr_release;
+	*result = state;
+	return 0;
+}
+
+int dvbsec_scr_set(struct dvbfe_handle *fe,
+		   struct dvbsec_config *sec_config,
+		   enum dvbsec_diseqc_polarization polarization,
+		   enum dvbsec_diseqc_switch sat_pos,
+		   int high,
+		   uint32_t if_frequency,
+		   struct dvbfe_parameters *params,
+		   int timeout)
+{
+	struct dvbfe_parameters localparams;
+	struct scr_state *state = NULL;
+	struct timespec start;
+	struct timespec now;
+	uint8_t cmd[6];
+	int backoff = SCR_BACKOFF;
+	int attempt;
+	int bank;
+	int len;
+	int tmp;
+
+	if ((tmp = scr_acquire(fe, sec_config, &state)) < 0)
+		return tmp;
+
+	// bank: position, then horizontal (18V), then high band
+	bank = high ? 1 : 0;
+	switch(polarization) {
+	case DISEQC_POLARIZATION_H:
+	case DISEQC_POLARIZATION_L:
+		bank |= 2;
+		break;
+	default:
+		break;
+	}
+	if (sat_pos == DISEQC_SWITCH_B)
+		bank |= 4;
+
+	memcpy(&localparams, params, sizeof(struct dvbfe_parameters));
+	len = scr_build_command(state, sec_config, bank, if_frequency, cmd, &localparams.frequency);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(attempt = 1; ; attempt++) {
+		int wait = timeout;
+
+		if ((tmp = scr_send_command(fe, state, cmd, len)) < 0)
+			return tmp;
+
+		// can't tell a collision without waiting for the lock
+		if (timeout == 0)
+			return dvbfe_set(fe, &localparams, 0);
+
+		// each attempt but the last has a limited time to lock
+		if (timeout > 0) {
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			wait = timeout - (((now.tv_sec - start.tv_sec) * 1000) +
+					  ((now.tv_nsec - start.tv_nsec) / 1000000));
+			if (wait <= 0)
+				return -ETIMEDOUT;
+		}
+		if ((attempt < SCR_ATTEMPTS) && ((wait < 0) || (wait > SCR_VERIFY_TIME)))
+			wait = SCR_VERIFY_TIME;
+
+		if ((tmp = dvbfe_set(fe, &localparams, wait)) == 0)
+			return 0;
+		if ((tmp != -ETIMEDOUT) || (attempt == SCR_ATTEMPTS))
+			return tmp;
+
+		// probably a collision: wait a random time, so it won't recur
+		usleep(((rand_r(&backoff_seed) % backoff) + 1) * 1000);
+		backoff *= 2;
+	}
+}
+
+int dvbsec_scr_get(struct dvbfe_handle *fe)
+{
+	struct dvbfe_sec_state *sec_state = dvbfe_get_sec_state(fe);
+
+	if (sec_state->release != scr_release)
+		return -1;
+
+	return ((struct scr_state *) sec_state->priv)->scr;
+}
+
+void dvbsec_scr_release(struct dvbfe_handle *fe)
+{
+	struct dvbfe_sec_state *sec_state = dvbfe_get_sec_state(fe);
+
+	if (sec_state->release == scr_release)
+		scr_release(fe, sec_state->priv);
+}
@@ -0,0 +1,34 @@
+/*
+ * libdvbsec - an SEC library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libdvbmisc/dvbstats.h>
+#include "dvbsec_stats.h"
+
+static const char * const dvbsec_stats_names[] = {
+	"sets",
+	"sec_skipped",
+};
+
+DVBSTATS_SET(dvbsec_stats, "libdvbsec", dvbsec_stats_names, DVBSEC_STATS_COUNTERS, 0);
+
+static void __attribute__((destructor)) dvbsec_stats_exit(void)
+{
+	dvbstats_dump_at_exit(&dvbsec_stats);
+}
@@ -0,0 +1,391 @@
+/*
+	libdvbsec - an SEC library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <libdvbapi/dvbfe.h>
+#include <libdvbapi/dvbtopo.h>
+#include "dvbsec_topo.h"
+
+// DiSEqC 2.x read commands
+#define CMD_READ_STATUS		0x10
+#define CMD_READ_CONFIG		0x11
+#define CMD_READ_UNCOMMITTED	0x15
+#define CMD_READ_LO_LO		0x52
+#define CMD_READ_LO_HI		0x53
+
+// the config byte: which committed switches are fitted
+#define CONFIG_POSITION		0x04
+#define CONFIG_OPTION		0x08
+
+#define REPLY_TIMEOUT 150	// ms a slave has to start its reply
+#define SETTLE_TIME 15		// ms of quiet bus after each message
+#define POWER_UP_TIME 100	// ms for the bus to be powered before the first message
+#define ATTEMPTS 2		// sends of a command which meets a parity error
+
+// what topo_query() returns when it has no data
+#define QUERY_ABSENT -1		// nothing answered
+#define QUERY_UNSUPPORTED -2	// a device answered, but not with the data
+#define QUERY_NO_REPLIES -3	// the frontend cannot receive replies at all
+
+static void msleep(int ms)
+{
+	struct timespec req = { ms / 1000, (ms % 1000) * 1000000 };
+
+	while (nanosleep(&req, &req) && (errno == EINTR))
+		;
+}
+
+/**
+ * Send a read command and collect the reply.
+ *
+ * @return Number of data bytes put in data, or a QUERY_* value.
+ */
+static int topo_query(struct dvbfe_handle *fe, uint8_t address, uint8_t cmd,
+		      uint8_t *data, int len)
+{
+	uint8_t msg[] = { DISEQC_FRAMING_MASTER_REPLY, address, cmd };
+	unsigned char reply[4];
+	int attempt, n;
+
+	for (attempt = 0; attempt < ATTEMPTS; attempt++) {
+		if (dvbfe_do_diseqc_command(fe, msg, sizeof(msg)))
+			return QUERY_NO_REPLIES;
+		n = dvbfe_diseqc_read(fe, REPLY_TIMEOUT, reply, sizeof(reply));
+		if ((n < 0) && ((errno == EOPNOTSUPP) || (errno == ENOTTY) ||
+				(errno == ENOSYS) || (errno == EINVAL)))
+			return QUERY_NO_REPLIES;
+		msleep(SETTLE_TIME);
+		if (n <= 0)
+			return QUERY_ABSENT;
+
+		switch (reply[0]) {
+		case DISEQC_FRAMING_SLAVE_OK:
+			n--;
+			if (n > len)
+				n = len;
+			memcpy(data, reply + 1, n);
+			return n;
+
+		case DISEQC_FRAMING_SLAVE_PARITY_ERROR:
+			msg[0] = DISEQC_FRAMING_MASTER_REPLY_REPEAT;
+			break;
+
+		case DISEQC_FRAMING_SLAVE_UNSUPPORTED:
+		case DISEQC_FRAMING_SLAVE_UNRECOGNISED:
+			return QUERY_UNSUPPORTED;
+
+		default:
+			return QUERY_ABSENT;
+		}
+	}
+
+	return QUERY_ABSENT;
+}
+
+// a local oscillator reply: MHz, four BCD digits
+static uint32_t topo_query_lo(struct dvbfe_handle *fe, uint8_t address, uint8_t cmd)
+{
+	uint8_t data[3];
+	uint32_t mhz = 0;
+	int i;
+
+	if (topo_query(fe, address, cmd, data, sizeof(data)) < 2)
+		return 0;
+	for (i = 0; i < 2; i++) {
+		if (((data[i] >> 4) > 9) || ((data[i] & 0x0f) > 9))
+			return 0;
+		mhz = (mhz * 100) + ((data[i] >> 4) * 10) + (data[i] & 0x0f);
+	}
+	return mhz * 1000;
+}
+
+static void topo_probe_lnb(struct dvbfe_handle *fe, struct dvbsec_topo_port *port)
+{
+	static const uint8_t addresses[] = { DISEQC_ADDRESS_LNB, DISEQC_ADDRESS_LNB_WITH_LOOP };
+	uint8_t status;
+	unsigned int i;
+	int n;
+
+	port->lnb_address = 0;
+	port->lnb_status = -1;
+	port->lof_lo = 0;
+	port->lof_hi = 0;
+
+	for (i = 0; i < sizeof(addresses); i++) {
+		if ((n = topo_query(fe, addresses[i], CMD_READ_STATUS, &status, 1)) == QUERY_ABSENT)
+			continue;
+		if (n < QUERY_UNSUPPORTED)
+			return;
+
+		port->lnb_address = addresses[i];
+		if (n > 0)
+			port->lnb_status = status;
+		port->lof_lo = topo_query_lo(fe, addresses[i], CMD_READ_LO_LO);
+		port->lof_hi = topo_query_lo(fe, addresses[i], CMD_READ_LO_HI);
+		return;
+	}
+}
+
+static enum dvbsec_diseqc_switch topo_switch(int bit)
+{
+	return bit ? DISEQC_SWITCH_B : DISEQC_SWITCH_A;
+}
+
+void dvbsec_topo_key(int adapter, int frontend, char *key)
+{
+	struct dvbtopo *topo;
+	const struct dvbtopo_adapter *a = NULL;
+
+	if ((topo = dvbtopo_open(0)) != NULL)
+		a = dvbtopo_find_adapter(topo, adapter);
+
+	if ((a != NULL) && a->bus_path[0])
+		snprintf(key, DVBSEC_TOPO_KEY_LEN, "%s:%i", a->bus_path, frontend);
+	else
+		snprintf(key, DVBSEC_TOPO_KEY_LEN, "adapter%i:%i", adapter, frontend);
+
+	if (topo != NULL)
+		dvbtopo_close(topo);
+}
+
+int dvbsec_topo_discover(struct dvbfe_handle *fe, struct dvbsec_topo *topo)
+{
+	static const uint8_t switchers[] = {
+		DISEQC_ADDRESS_SWITCHER, DISEQC_ADDRESS_SWITCHER_WITH_LOOP, DISEQC_ADDRESS_SMATV
+	};
+	uint8_t data;
+	unsigned int i;
+	int committed[4], committed_count = 0;
+	int c, uncommitted, uncommitted_count;
+	int n;
+
+	topo->discovered = time(NULL);
+	topo->replies = 1;
+	topo->switch_address = 0;
+	topo->switch_status = -1;
+	topo->switch_config = -1;
+	topo->port_count = 0;
+
+	// the bus must be powered, and quiet
+	if (dvbfe_set_22k_tone(fe, DVBFE_SEC_TONE_OFF) ||
+	    dvbfe_set_voltage(fe, DVBFE_SEC_VOLTAGE_13))
+		return -EIO;
+	msleep(POWER_UP_TIME);
+
+	for (i = 0; i < sizeof(switchers); i++) {
+		if ((n = topo_query(fe, switchers[i], CMD_READ_STATUS, &data, 1)) == QUERY_NO_REPLIES) {
+			topo->replies = 0;
+			return 0;
+		}
+		if (n == QUERY_ABSENT)
+			continue;
+
+		topo->switch_address = switchers[i];
+		if (n > 0)
+			topo->switch_status = data;
+		if (topo_query(fe, switchers[i], CMD_READ_CONFIG, &data, 1) > 0)
+			topo->switch_config = data;
+		break;
+	}
+
+	// the committed ports whose switches are fitted; without a config
+	// byte, all four
+	if (!topo->switch_address) {
+		committed[committed_count++] = -1;
+	} else {
+		for (c = 0; c < 4; c++) {
+			if ((topo->switch_config >= 0) &&
+			    (((c & 1) && !(topo->switch_config & CONFIG_POSITION)) ||
+			     ((c & 2) && !(topo->switch_config & CONFIG_OPTION))))
+				continue;
+			committed[committed_count++] = c;
+		}
+	}
+
+	for (c = 0; c < committed_count; c++) {
+		uncommitted_count = 1;
+		if (committed[c] >= 0) {
+			if (dvbsec_diseqc_set_committed_switches(fe, topo->switch_address,
+								 DISEQC_OSCILLATOR_LOW,
+								 DISEQC_POLARIZATION_V,
+								 topo_switch(committed[c] & 1),
+								 topo_switch(committed[c] & 2)))
+				return -EIO;
+			msleep(SETTLE_TIME);
+			if (topo_query(fe, topo->switch_address, CMD_READ_UNCOMMITTED, &data, 1) >= 0)
+				uncommitted_count = 4;
+		}
+
+		for (uncommitted = 0; uncommitted < uncommitted_count; uncommitted++) {
+			struct dvbsec_topo_port *p = &topo->ports[topo->port_count++];
+
+			p->committed = committed[c];
+			p->uncommitted = (uncommitted_count > 1) ? uncommitted : -1;
+			if (p->uncommitted >= 0) {
+				if (dvbsec_diseqc_set_uncommitted_switches(fe, topo->switch_address,
+									   topo_switch(uncommitted & 1),
+									   topo_switch(uncommitted & 2),
+									   DISEQC_SWITCH_UNCHANGED,
+									   DISEQC_SWITCH_UNCHANGED))
+					return -EIO;
+				msleep(SETTLE_TIME);
+			}
+			topo_probe_lnb(fe, p);
+		}
+	}
+
+	return 0;
+}
+
+int dvbsec_topo_select(struct dvbfe_handle *fe, struct dvbsec_topo *topo, int port,
+		       enum dvbsec_diseqc_switch *sat_pos,
+		       enum dvbsec_diseqc_switch *switch_option)
+{
+	struct dvbsec_topo_port *p;
+
+	if ((port < 0) || (port >= topo->port_count))
+		return -EINVAL;
+	p = &topo->ports[port];
+
+	*sat_pos = topo_switch((p->committed >= 0) && (p->committed & 1));
+	*switch_option = topo_switch((p->committed >= 0) && (p->committed & 2));
+	if (p->uncommitted < 0)
+		return 0;
+
+	return dvbsec_diseqc_set_uncommitted_switches(fe, topo->switch_address,
+						      topo_switch(p->uncommitted & 1),
+						      topo_switch(p->uncommitted & 2),
+						      DISEQC_SWITCH_UNCHANGED,
+						      DISEQC_SWITCH_UNCHANGED);
+}
+
+static const char *topo_cache_file(void)
+{
+	const char *file = getenv("DVBSEC_TOPO_CACHE");
+
+	return file ? file : DVBSEC_TOPO_CACHE_FILE;
+}
+
+/*
+ * The cache is a text file of entries
+ *
+ *   frontend <key> <discovered> <replies> <switch_address> <switch_status> <switch_config> <ports>
+ *   port <committed> <uncommitted> <lnb_address> <lnb_status> <lof_lo> <lof_hi>
+ *
+ * with one port line for each of the entry's ports.
+ */
+static int topo_cache_parse(FILE *f, struct dvbsec_topo *topo)
+{
+	char line[DVBSEC_TOPO_KEY_LEN + 128];
+	long discovered;
+	int i, addr;
+
+	if (fgets(line, sizeof(line), f) == NULL)
+		return -1;
+	if ((sscanf(line, "frontend %279s %ld %i %i %i %i %i", topo->key, &discovered,
+		    &topo->replies, &addr, &topo->switch_status, &topo->switch_config,
+		    &topo->port_count) != 7) ||
+	    (topo->port_count < 0) || (topo->port_count > DVBSEC_TOPO_MAX_PORTS))
+		return -1;
+	topo->discovered = discovered;
+	topo->switch_address = addr;
+
+	for (i = 0; i < topo->port_count; i++) {
+		struct dvbsec_topo_port *p = &topo->ports[i];
+
+		if ((fgets(line, sizeof(line), f) == NULL) ||
+		    (sscanf(line, "port %i %i %i %i %u %u", &p->committed, &p->uncommitted,
+			    &addr, &p->lnb_status, &p->lof_lo, &p->lof_hi) != 6))
+			return -1;
+		p->lnb_address = addr;
+	}
+	return 0;
+}
+
+static void topo_cache_print(FILE *f, const struct dvbsec_topo *topo)
+{
+	int i;
+
+	fprintf(f, "frontend %s %ld %i %i %i %i %i\n", topo->key, (long) topo->discovered,
+		topo->replies, topo->switch_address, topo->switch_status, topo->switch_config,
+		topo->port_count);
+	for (i = 0; i < topo->port_count; i++) {
+		const struct dvbsec_topo_port *p = &topo->ports[i];
+
+		fprintf(f, "port %i %i %i %i %u %u\n", p->committed, p->uncommitted,
+			p->lnb_address, p->lnb_status, p->lof_lo, p->lof_hi);
+	}
+}
+
+int dvbsec_topo_cache_read(const char *key, struct dvbsec_topo *topo)
+{
+	FILE *f;
+	int found = -1;
+
+	if ((f = fopen(topo_cache_file(), "r")) == NULL)
+		return -1;
+	while (topo_cache_parse(f, topo) == 0) {
+		if (!strcmp(topo->key, key)) {
+			found = 0;
+			break;
+		}
+	}
+	fclose(f);
+
+	if (found)
+		return -1;
+	if ((time(NULL) - topo->discovered) > DVBSEC_TOPO_MAX_AGE)
+		return -1;
+	return 0;
+}
+
+int dvbsec_topo_cache_write(const struct dvbsec_topo *topo)
+{
+	const char *file = topo_cache_file();
+	char tmpname[PATH_MAX];
+	struct dvbsec_topo other;
+	FILE *in, *out;
+
+	snprintf(tmpname, sizeof(tmpname), "%s.%i", file, (int) getpid());
+	if ((out = fopen(tmpname, "w")) == NULL)
+		return -errno;
+
+	// every other frontend's entry is carried over
+	if ((in = fopen(file, "r")) != NULL) {
+		while (topo_cache_parse(in, &other) == 0)
+			if (strcmp(other.key, topo->key))
+				topo_cache_print(out, &other);
+		fclose(in);
+	}
+	topo_cache_print(out, topo);
+
+	if (fclose(out) || rename(tmpname, file)) {
+		int err = -errno;
+
+		unlink(tmpname);
+		return err;
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+/*
+	libdvbsec - an SEC library
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+*/
+
+#ifndef DVBSEC_TOPO_H
+#define DVBSEC_TOPO_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <time.h>
+#include <libdvbsec/dvbsec_api.h>
+
+/**
+ * Discovery of the switches and LNBs behind a frontend from their DiSEqC 2.x
+ * replies, so that tools need not be told the layout of a cascade, nor tune
+ * every port to find out which have a dish.
+ *
+ * The bus is modelled as at most two levels: a switcher's committed switches
+ * (satellite position and option, ports 0-3 as dvbsec_set() numbers them) and
+ * behind each of those, optionally, the first two uncommitted switches (ports
+ * 0-3 again, S1 | S2 << 1). Every combination is selected in turn, and the
+ * LNB addresses are asked for their status and local oscillators.
+ *
+ * Discovery sends a few dozen commands, each waiting for its reply, so it
+ * takes some seconds; the result is cached per frontend in
+ * DVBSEC_TOPO_CACHE_FILE (or $DVBSEC_TOPO_CACHE) by dvbsec_cfg_store_topo().
+ * Frontends which cannot receive replies are cached as such too.
+ */
+
+#define DVBSEC_TOPO_CACHE_FILE "/var/cache/dvbsec.topo"
+#define DVBSEC_TOPO_MAX_AGE (7 * 24 * 3600)	/* seconds a cached topology is trusted */
+#define DVBSEC_TOPO_MAX_PORTS 16
+#define DVBSEC_TOPO_KEY_LEN 280
+
+/**
+ * Flags for dvbsec_cfg_store_topo().
+ */
+#define DVBSEC_TOPO_REDISCOVER	1	/* ignore the cache, and rewrite it */
+#define DVBSEC_TOPO_CACHE_ONLY	2	/* fail rather than query the bus */
+
+/**
+ * A port: one setting of the switches, and what answered behind it.
+ */
+struct dvbsec_topo_port {
+	int committed;			/* 0-3: sat_pos | switch_option << 1; -1 => no switcher */
+	int uncommitted;		/* 0-3: S1 | S2 << 1; -1 => no uncommitted switches */
+	uint8_t lnb_address;		/* DISEQC_ADDRESS_LNB*, 0 if none answered */
+	int lnb_status;			/* status byte of the LNB, -1 if unknown */
+	uint32_t lof_lo;		/* local oscillators in kHz as the LNB reports them, 0 if unknown */
+	uint32_t lof_hi;
+};
+
+/**
+ * What discovery found on a frontend's bus.
+ */
+struct dvbsec_topo {
+	char key[DVBSEC_TOPO_KEY_LEN];	/* the frontend, see dvbsec_topo_key() */
+	time_t discovered;
+	int replies;			/* 0 => the frontend cannot receive replies; nothing else is valid */
+
+	uint8_t switch_address;		/* DISEQC_ADDRESS_SWITCHER* or SMATV; 0 if none answered */
+	int switch_status;		/* status and config bytes, -1 if unknown */
+	int switch_config;
+
+	int port_count;
+	struct dvbsec_topo_port ports[DVBSEC_TOPO_MAX_PORTS];
+};
+
+/**
+ * Work out the cache key of a frontend: the bus path of its card if
+ * libdvbapi's dvbtopo knows it (so the key survives adapter renumbering),
+ * else the adapter number.
+ *
+ * @param adapter Adapter number.
+ * @param frontend Frontend number.
+ * @param key Where to put it, DVBSEC_TOPO_KEY_LEN bytes.
+ */
+extern void dvbsec_topo_key(int adapter, int frontend, char *key);
+
+/**
+ * Query the bus of a frontend. The switches are left in an unknown state
+ * (the frontend's SEC state is invalidated), so the next dvbsec_set() sends
+ * its whole sequence.
+ *
+ * @param fe Frontend concerned.
+ * @param topo Where to put the result; key is left alone.
+ * @return 0 on success (including a frontend with no reply support, which
+ * has topo->replies == 0), or nonzero on error.
+ */
+extern int dvbsec_topo_discover(struct dvbfe_handle *fe, struct dvbsec_topo *topo);
+
+/**
+ * Select a port: the uncommitted switches are set here, and the committed
+ * ones are returned for dvbsec_set() to send with the band and polarisation.
+ *
+ * @param fe Frontend concerned.
+ * @param topo The topology.
+ * @param port Index into topo->ports.
+ * @param sat_pos Set to the satellite position switch for dvbsec_set().
+ * @param switch_option Set to the option switch for dvbsec_set().
+ * @return 0 on success, or nonzero on error.
+ */
+extern int dvbsec_topo_select(struct dvbfe_handle *fe, struct dvbsec_topo *topo, int port,
+			      enum dvbsec_diseqc_switch *sat_pos,
+			      enum dvbsec_diseqc_switch *switch_option);
+
+/**
+ * Read a frontend's topology from the cache file.
+ *
+ * @param key The frontend.
+ * @param topo Where to put it.
+ * @return 0 if it was there and not older than DVBSEC_TOPO_MAX_AGE,
+ * nonzero if not.
+ */
+extern int dvbsec_topo_cache_read(const char *key, struct dvbsec_topo *topo);
+
+/**
+ * Write a frontend's topology into the cache file, replacing its earlier
+ * entry. The file is rewritten through a rename, so concurrent readers see
+ * all of it or none.
+ *
+ * @param topo The topology.
+ * @return 0 on success, or nonzero on error.
+ */
+extern int dvbsec_topo_cache_write(const struct dvbsec_topo *topo);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
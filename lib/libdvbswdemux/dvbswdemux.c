@@ -0,0 +1,592 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <libucsi/crc32.h>
+#include <libucsi/section_buf.h>
+#include <libucsi/transport_packet.h>
+
+#include "dvbswdemux.h"
+#include "dvbswdemux_int.h"
+
+#define SWDEMUX_MAX_SECTION_BYTES 4096		/* private sections can be this big */
+#define SWDEMUX_MAX_PES_BYTES (4 * 1024 * 1024)
+#define SWDEMUX_PES_ALLOC_DELTA (64 * 1024)
+#define SWDEMUX_PES_HDR_SIZE 6
+#define SWDEMUX_FILTER_BYTES 16			/* section bytes 0 and 3-17 */
+
+enum swdemux_filter_type {
+	SWDEMUX_FILTER_TS,
+	SWDEMUX_FILTER_SECTION,
+	SWDEMUX_FILTER_PES,
+};
+
+struct dvbswdemux_filter {
+	struct dvbswdemux_filter *next;
+	struct dvbswdemux_filter *next_garbage;
+
+	int pid;
+	enum swdemux_filter_type type;
+	int removed;
+
+	dvbswdemux_ts_callback ts_callback;
+	dvbswdemux_data_callback data_callback;
+	void *private_data;
+
+	int checkcrc;
+	int match_len;				/* bytes of filter/mask in use */
+	uint8_t filter[SWDEMUX_FILTER_BYTES];
+	uint8_t mask[SWDEMUX_FILTER_BYTES];
+};
+
+struct swdemux_pid {
+	struct dvbswdemux_filter *filters;
+	int section_filters;
+	int pes_filters;
+	unsigned char cstate;
+
+	struct section_buf *section;
+
+	uint8_t *pes;
+	size_t pes_size;
+	size_t pes_count;
+	size_t pes_len;				/* 0 => unbounded */
+	int pes_started;
+	int pes_header;				/* the header has been checked */
+};
+
+struct dvbswdemux {
+	struct swdemux_pid *pids[TRANSPORT_MAX_PIDS];
+	struct dvbswdemux_filter *all_filters;
+
+	int dispatching;
+	struct dvbswdemux_filter *garbage;
+
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int partial_len;
+
+	uint8_t *readbuf;
+	struct transport_packet_batch batch;
+};
+
+static void swdemux_unlink(struct dvbswdemux *demux, struct dvbswdemux_filter *filter);
+
+struct dvbswdemux *dvbswdemux_create(void)
+{
+	struct dvbswdemux *demux;
+
+	if ((demux = calloc(1, sizeof(struct dvbswdemux))) == NULL)
+		return NULL;
+
+	if ((demux->readbuf = malloc(SWDEMUX_READ_SIZE)) == NULL) {
+		free(demux);
+		return NULL;
+	}
+
+	return demux;
+}
+
+void dvbswdemux_destroy(struct dvbswdemux *demux)
+{
+	int i;
+
+	while(demux->all_filters)
+		swdemux_unlink(demux, demux->all_filters);
+
+	for(i = 0; i < TRANSPORT_MAX_PIDS; i++) {
+		while(demux->pids[i])
+			swdemux_unlink(demux, demux->pids[i]->filters);
+	}
+
+	free(demux->readbuf);
+	free(demux);
+}
+
+static struct dvbswdemux_filter *swdemux_add(struct dvbswdemux *demux, int pid,
+					     enum swdemux_filter_type type)
+{
+	struct dvbswdemux_filter *filter;
+	struct dvbswdemux_filter **tail;
+	struct swdemux_pid *p = NULL;
+
+	if ((pid < -1) || (pid >= TRANSPORT_MAX_PIDS))
+		return NULL;
+	if ((pid == -1) && (type != SWDEMUX_FILTER_TS))
+		return NULL;
+
+	if ((filter = calloc(1, sizeof(struct dvbswdemux_filter))) == NULL)
+		return NULL;
+	filter->pid = pid;
+	filter->type = type;
+
+	if (pid == -1) {
+		tail = &demux->all_filters;
+	} else {
+		if ((p = demux->pids[pid]) == NULL) {
+			if ((p = calloc(1, sizeof(struct swdemux_pid))) == NULL) {
+				free(filter);
+				return NULL;
+			}
+			demux->pids[pid] = p;
+		}
+
+		if ((type == SWDEMUX_FILTER_SECTION) && (p->section == NULL)) {
+			p->section = malloc(sizeof(struct section_buf) + SWDEMUX_MAX_SECTION_BYTES);
+			if (p->section == NULL)
+				goto error;
+			section_buf_init(p->section, SWDEMUX_MAX_SECTION_BYTES);
+		}
+
+		if (type == SWDEMUX_FILTER_SECTION)
+			p->section_filters++;
+		else if (type == SWDEMUX_FILTER_PES)
+			p->pes_filters++;
+		tail = &p->filters;
+	}
+
+	// keep filters in the order they were added
+	while(*tail)
+		tail = &(*tail)->next;
+	*tail = filter;
+
+	return filter;
+
+error:
+	if (p->filters == NULL) {
+		demux->pids[pid] = NULL;
+		free(p);
+	}
+	free(filter);
+	return NULL;
+}
+
+struct dvbswdemux_filter *dvbswdemux_add_pid_filter(struct dvbswdemux *demux, int pid,
+						    dvbswdemux_ts_callback callback,
+						    void *private_data)
+{
+	struct dvbswdemux_filter *filter;
+
+	if ((filter = swdemux_add(demux, pid, SWDEMUX_FILTER_TS)) == NULL)
+		return NULL;
+	filter->ts_callback = callback;
+	filter->private_data = private_data;
+
+	return filter;
+}
+
+struct dvbswdemux_filter *dvbswdemux_add_section_filter(struct dvbswdemux *demux, int pid,
+							uint8_t filter[18], uint8_t mask[18],
+							int checkcrc,
+							dvbswdemux_data_callback callback,
+							void *private_data)
+{
+	struct dvbswdemux_filter *f;
+	int i;
+
+	if (pid == -1)
+		return NULL;
+	if ((f = swdemux_add(demux, pid, SWDEMUX_FILTER_SECTION)) == NULL)
+		return NULL;
+	f->data_callback = callback;
+	f->private_data = private_data;
+	f->checkcrc = checkcrc;
+
+	// same layout as the kernel filter: the length bytes are skipped
+	f->filter[0] = filter[0];
+	f->mask[0] = mask[0];
+	memcpy(f->filter + 1, filter + 3, SWDEMUX_FILTER_BYTES - 1);
+	memcpy(f->mask + 1, mask + 3, SWDEMUX_FILTER_BYTES - 1);
+	for(i = 0; i < SWDEMUX_FILTER_BYTES; i++) {
+		f->filter[i] &= f->mask[i];
+		if (f->mask[i])
+			f->match_len = i + 1;
+	}
+
+	return f;
+}
+
+struct dvbswdemux_filter *dvbswdemux_add_pes_filter(struct dvbswdemux *demux, int pid,
+						    dvbswdemux_data_callback callback,
+						    void *private_data)
+{
+	struct dvbswdemux_filter *filter;
+
+	if (pid == -1)
+		return NULL;
+	if ((filter = swdemux_add(demux, pid, SWDEMUX_FILTER_PES)) == NULL)
+		return NULL;
+	filter->data_callback = callback;
+	filter->private_data = private_data;
+
+	return filter;
+}
+
+static void swdemux_unlink(struct dvbswdemux *demux, struct dvbswdemux_filter *filter)
+{
+	struct dvbswdemux_filter **pos;
+	struct swdemux_pid *p = NULL;
+
+	if (filter->pid == -1) {
+		pos = &demux->all_filters;
+	} else {
+		p = demux->pids[filter->pid];
+		pos = &p->filters;
+	}
+
+	while(*pos != filter)
+		pos = &(*pos)->next;
+	*pos = filter->next;
+
+	if (p) {
+		if ((filter->type == SWDEMUX_FILTER_SECTION) && (--p->section_filters == 0)) {
+			free(p->section);
+			p->section = NULL;
+		}
+		if ((filter->type == SWDEMUX_FILTER_PES) && (--p->pes_filters == 0)) {
+			free(p->pes);
+			p->pes = NULL;
+			p->pes_size = 0;
+			p->pes_started = 0;
+		}
+		if (p->filters == NULL) {
+			demux->pids[filter->pid] = NULL;
+			free(p);
+		}
+	}
+
+	free(filter);
+}
+
+void dvbswdemux_remove_filter(struct dvbswdemux *demux, struct dvbswdemux_filter *filter)
+{
+	if (filter->removed)
+		return;
+
+	// the lists may be being walked: just mark it, and unlink it afterwards
+	if (demux->dispatching) {
+		filter->removed = 1;
+		filter->next_garbage = demux->garbage;
+		demux->garbage = filter;
+		return;
+	}
+
+	swdemux_unlink(demux, filter);
+}
+
+static void swdemux_reset(struct swdemux_pid *p)
+{
+	if (p->section)
+		section_buf_reset(p->section);
+	p->pes_started = 0;
+}
+
+static int swdemux_section_match(struct dvbswdemux_filter *filter, uint8_t *data, int len)
+{
+	int i;
+
+	if ((data[0] & filter->mask[0]) != filter->filter[0])
+		return 0;
+
+	for(i = 1; i < filter->match_len; i++) {
+		if (!filter->mask[i])
+			continue;
+		if ((i + 2) >= len)
+			return 0;
+		if ((data[i + 2] & filter->mask[i]) != filter->filter[i])
+			return 0;
+	}
+
+	return 1;
+}
+
+static void swdemux_section(struct dvbswdemux *demux, struct swdemux_pid *p,
+			    uint8_t *data, int len)
+{
+	struct dvbswdemux_filter *filter;
+	int crc_ok = -1;
+
+	for(filter = p->filters; filter; filter = filter->next) {
+		if ((filter->type != SWDEMUX_FILTER_SECTION) || filter->removed)
+			continue;
+		if (!swdemux_section_match(filter, data, len))
+			continue;
+
+		// only sections with the syntax indicator set carry a CRC
+		if (filter->checkcrc && (data[1] & 0x80)) {
+			if (crc_ok == -1)
+				crc_ok = (crc32(CRC32_INIT, data, len) == 0);
+			if (!crc_ok)
+				continue;
+		}
+
+		if (filter->data_callback(filter->private_data, data, len))
+			dvbswdemux_remove_filter(demux, filter);
+	}
+}
+
+static void swdemux_section_payload(struct dvbswdemux *demux, struct swdemux_pid *p,
+				    uint8_t *payload, int len, int pdu_start)
+{
+	int section_status;
+	int used;
+
+	while(len) {
+		used = section_buf_add_transport_payload(p->section, payload, len,
+							 pdu_start, &section_status);
+		pdu_start = 0;
+		len -= used;
+		payload += used;
+
+		if (section_status == 1) {
+			swdemux_section(demux, p, section_buf_data(p->section), p->section->len);
+			section_buf_reset(p->section);
+		} else if (section_status < 0) {
+			section_buf_reset(p->section);
+		}
+	}
+}
+
+static void swdemux_pes(struct dvbswdemux *demux, struct swdemux_pid *p,
+			uint8_t *data, int len)
+{
+	struct dvbswdemux_filter *filter;
+
+	for(filter = p->filters; filter; filter = filter->next) {
+		if ((filter->type != SWDEMUX_FILTER_PES) || filter->removed)
+			continue;
+
+		if (filter->data_callback(filter->private_data, data, len))
+			dvbswdemux_remove_filter(demux, filter);
+	}
+}
+
+static void swdemux_pes_payload(struct dvbswdemux *demux, struct swdemux_pid *p,
+				uint8_t *payload, int len, int pdu_start)
+{
+	if (pdu_start) {
+		// an unbounded PES packet ends where the next one starts
+		if (p->pes_started && p->pes_header && (p->pes_len == 0))
+			swdemux_pes(demux, p, p->pes, p->pes_count);
+
+		p->pes_started = 1;
+		p->pes_header = 0;
+		p->pes_count = 0;
+		p->pes_len = 0;
+	}
+	if (!p->pes_started)
+		return;
+
+	if ((p->pes_count + len) > p->pes_size) {
+		size_t size = p->pes_size + SWDEMUX_PES_ALLOC_DELTA;
+		uint8_t *pes;
+
+		if ((size > SWDEMUX_MAX_PES_BYTES) || ((pes = realloc(p->pes, size)) == NULL)) {
+			p->pes_started = 0;
+			return;
+		}
+		p->pes = pes;
+		p->pes_size = size;
+	}
+	memcpy(p->pes + p->pes_count, payload, len);
+	p->pes_count += len;
+
+	if (!p->pes_header) {
+		if (p->pes_count < SWDEMUX_PES_HDR_SIZE)
+			return;
+
+		// packet_start_code_prefix
+		if ((p->pes[0] != 0x00) || (p->pes[1] != 0x00) || (p->pes[2] != 0x01)) {
+			p->pes_started = 0;
+			return;
+		}
+		p->pes_len = (p->pes[4] << 8) | p->pes[5];
+		if (p->pes_len)
+			p->pes_len += SWDEMUX_PES_HDR_SIZE;
+		p->pes_header = 1;
+	}
+
+	if (p->pes_len && (p->pes_count >= p->pes_len)) {
+		p->pes_started = 0;
+		swdemux_pes(demux, p, p->pes, p->pes_len);
+	}
+}
+
+static void swdemux_packet(struct dvbswdemux *demux, uint8_t *pkt,
+			   struct transport_packet_batch *batch, int idx)
+{
+	struct dvbswdemux_filter *filter;
+	struct swdemux_pid *p;
+	unsigned char cstate;
+	int discontinuity;
+	int offset;
+
+	for(filter = demux->all_filters; filter; filter = filter->next) {
+		if (!filter->removed && filter->ts_callback(filter->private_data, pkt))
+			dvbswdemux_remove_filter(demux, filter);
+	}
+
+	if ((p = demux->pids[batch->pid[idx]]) == NULL)
+		return;
+
+	for(filter = p->filters; filter; filter = filter->next) {
+		if ((filter->type != SWDEMUX_FILTER_TS) || filter->removed)
+			continue;
+		if (filter->ts_callback(filter->private_data, pkt))
+			dvbswdemux_remove_filter(demux, filter);
+	}
+
+	if ((p->section_filters == 0) && (p->pes_filters == 0))
+		return;
+
+	if (batch->transport_error[idx]) {
+		swdemux_reset(p);
+		return;
+	}
+
+	// on a continuity error, drop what was being reassembled but keep this packet
+	discontinuity = batch->adaptation_flags[idx] & transport_adaptation_flag_discontinuity;
+	cstate = p->cstate;
+	if (transport_packet_continuity_check((struct transport_packet *) pkt,
+					      discontinuity, &p->cstate)) {
+		swdemux_reset(p);
+		p->cstate = 0;
+		transport_packet_continuity_check((struct transport_packet *) pkt,
+						  discontinuity, &p->cstate);
+	} else if ((cstate & 0x80) && !discontinuity && (batch->adaptation[idx] & 1) &&
+		   ((cstate & 0x0f) == batch->continuity_counter[idx])) {
+		// a duplicate packet
+		return;
+	}
+
+	if (batch->scrambling[idx] || ((offset = batch->payload_offset[idx]) == 0))
+		return;
+
+	if (p->section_filters)
+		swdemux_section_payload(demux, p, pkt + offset, TRANSPORT_PACKET_LENGTH - offset,
+					batch->payload_unit_start[idx]);
+	if (p->pes_filters)
+		swdemux_pes_payload(demux, p, pkt + offset, TRANSPORT_PACKET_LENGTH - offset,
+				    batch->payload_unit_start[idx]);
+}
+
+static int swdemux_packets(struct dvbswdemux *demux, uint8_t *buf, int len)
+{
+	struct transport_packet_batch *batch = &demux->batch;
+	int used;
+	int i;
+
+	used = transport_packet_batch_extract(buf, len, batch);
+	for(i = 0; i < batch->count; i++)
+		swdemux_packet(demux, buf + (i * TRANSPORT_PACKET_LENGTH), batch, i);
+
+	return used;
+}
+
+void dvbswdemux_feed(struct dvbswdemux *demux, uint8_t *buf, int len)
+{
+	int offset;
+	int copy;
+
+	demux->dispatching++;
+
+	// finish off the packet left over from last time
+	if (demux->partial_len) {
+		copy = TRANSPORT_PACKET_LENGTH - demux->partial_len;
+		if (copy > len)
+			copy = len;
+		memcpy(demux->partial + demux->partial_len, buf, copy);
+		demux->partial_len += copy;
+		buf += copy;
+		len -= copy;
+
+		if (demux->partial_len == TRANSPORT_PACKET_LENGTH) {
+			demux->partial_len = 0;
+			swdemux_packets(demux, demux->partial, TRANSPORT_PACKET_LENGTH);
+		}
+	}
+
+	while(len > 0) {
+		if (buf[0] != TRANSPORT_PACKET_SYNC) {
+			if ((offset = transport_packet_find_sync(buf, len)) < 0)
+				break;
+			buf += offset;
+			len -= offset;
+		}
+
+		if (len < TRANSPORT_PACKET_LENGTH) {
+			memcpy(demux->partial, buf, len);
+			demux->partial_len = len;
+			break;
+		}
+
+		offset = swdemux_packets(demux, buf, len);
+		buf += offset;
+		len -= offset;
+	}
+
+	// now unlink anything removed by a callback
+	if (--demux->dispatching == 0) {
+		while(demux->garbage) {
+			struct dvbswdemux_filter *filter = demux->garbage;
+
+			demux->garbage = filter->next_garbage;
+			swdemux_unlink(demux, filter);
+		}
+	}
+}
+
+int dvbswdemux_read(struct dvbswdemux *demux, int fd)
+{
+	int len;
+
+	if ((len = read(fd, demux->readbuf, SWDEMUX_READ_SIZE)) > 0)
+		dvbswdemux_feed(demux, demux->readbuf, len);
+
+	return len;
+}
+
+void dvbswdemux_move_pid(struct dvbswdemux *from, struct dvbswdemux *to, int pid)
+{
+	to->pids[pid] = from->pids[pid];
+	from->pids[pid] = NULL;
+}
+
+int dvbswdemux_pid_wanted(struct dvbswdemux *demux, int pid)
+{
+	struct dvbswdemux_filter *filter;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return 0;
+
+	for(filter = demux->all_filters; filter; filter = filter->next) {
+		if (!filter->removed)
+			return 1;
+	}
+	if (demux->pids[pid] == NULL)
+		return 0;
+	for(filter = demux->pids[pid]->filters; filter; filter = filter->next) {
+		if (!filter->removed)
+			return 1;
+	}
+	return 0;
+}
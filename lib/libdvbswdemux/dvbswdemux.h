@@ -0,0 +1,182 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBSWDEMUX_H
+#define LIBDVBSWDEMUX_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * A demux running in userspace on a full transport stream, typically read
+ * from a DVR device after:
+ *
+ *	dvbdemux_set_pid_filter(demuxfd, -1, DVBDEMUX_INPUT_FRONTEND,
+ *				DVBDEMUX_OUTPUT_DVR, 1);
+ *
+ * There is no limit on the number of filters, and the whole stream is read
+ * with one syscall per chunk rather than one per PID. Filters on the same
+ * PID share a single section or PES reassembly.
+ *
+ * A demux is not thread safe. Filters may be added or removed from inside
+ * callbacks.
+ */
+struct dvbswdemux;
+
+/**
+ * A filter on a dvbswdemux.
+ */
+struct dvbswdemux_filter;
+
+/**
+ * Callback for transport packets.
+ *
+ * @param private_data Private data given when the filter was added.
+ * @param packet The 188 byte packet.
+ * @return 0 to keep the filter, nonzero to remove it.
+ */
+typedef int (*dvbswdemux_ts_callback)(void *private_data, uint8_t *packet);
+
+/**
+ * Callback for complete sections or PES packets.
+ *
+ * @param private_data Private data given when the filter was added.
+ * @param data The section or PES packet. It is only valid during the call,
+ * and is shared with other filters on the PID, so must not be modified.
+ * @param len Its length in bytes.
+ * @return 0 to keep the filter, nonzero to remove it.
+ */
+typedef int (*dvbswdemux_data_callback)(void *private_data, uint8_t *data, int len);
+
+/**
+ * Create a demux.
+ *
+ * @return The demux, or NULL on failure.
+ */
+extern struct dvbswdemux *dvbswdemux_create(void);
+
+/**
+ * Destroy a demux and all its filters.
+ *
+ * @param demux The demux.
+ */
+extern void dvbswdemux_destroy(struct dvbswdemux *demux);
+
+/**
+ * Add a filter for the transport packets of a PID.
+ *
+ * @param demux The demux.
+ * @param pid PID to retrieve, or -1 as a wildcard for ALL PIDs.
+ * @param callback Called for each packet.
+ * @param private_data Private data for the callback.
+ * @return The filter, or NULL on failure.
+ */
+extern struct dvbswdemux_filter *dvbswdemux_add_pid_filter(struct dvbswdemux *demux, int pid,
+							   dvbswdemux_ts_callback callback,
+							   void *private_data);
+
+/**
+ * Add a filter for SI table sections. This matches sections as
+ * dvbdemux_set_section_filter() does: bytes 1 and 2 are _not_ filtered, and
+ * for the others
+ *
+ * (filter[X].bit[Y] & mask[X].bit[Y]) == (header[X].bit[Y] & mask[X].bit[Y])
+ *
+ * @param demux The demux.
+ * @param pid PID of the stream.
+ * @param filter The filter values of the first 18 bytes of the desired sections.
+ * @param mask Bitmask indicating which bits in the filter array should be tested
+ * (if a bit is 1, it will be tested).
+ * @param checkcrc If 1, sections with the syntax indicator set and a bad CRC
+ * are dropped.
+ * @param callback Called for each matching section.
+ * @param private_data Private data for the callback.
+ * @return The filter, or NULL on failure.
+ */
+extern struct dvbswdemux_filter *dvbswdemux_add_section_filter(struct dvbswdemux *demux, int pid,
+							       uint8_t filter[18], uint8_t mask[18],
+							       int checkcrc,
+							       dvbswdemux_data_callback callback,
+							       void *private_data);
+
+/**
+ * Add a filter for the PES packets of a PID. PES packets of unbounded length
+ * (video) are passed on when the next one starts.
+ *
+ * @param demux The demux.
+ * @param pid PID of the stream.
+ * @param callback Called for each complete PES packet.
+ * @param private_data Private data for the callback.
+ * @return The filter, or NULL on failure.
+ */
+extern struct dvbswdemux_filter *dvbswdemux_add_pes_filter(struct dvbswdemux *demux, int pid,
+							   dvbswdemux_data_callback callback,
+							   void *private_data);
+
+/**
+ * Remove a filter.
+ *
+ * @param demux The demux.
+ * @param filter The filter.
+ */
+extern void dvbswdemux_remove_filter(struct dvbswdemux *demux, struct dvbswdemux_filter *filter);
+
+/**
+ * Feed transport stream data into the demux. The data need not start or end
+ * on a packet boundary: a partial packet at the end is kept until the next
+ * call, and the demux resynchronises on garbage.
+ *
+ * @param demux The demux.
+ * @param buf The data.
+ * @param len Its length in bytes.
+ */
+extern void dvbswdemux_feed(struct dvbswdemux *demux, uint8_t *buf, int len);
+
+/**
+ * Read one chunk of transport stream data from a file descriptor (e.g. a DVR
+ * device) with a single read() call and feed it into the demux.
+ *
+ * @param demux The demux.
+ * @param fd The file descriptor.
+ * @return Number of bytes read, 0 at end of file, or -1 on error (errno is
+ * set; EOVERFLOW from a DVR device means data was lost, and reading may
+ * simply continue).
+ */
+extern int dvbswdemux_read(struct dvbswdemux *demux, int fd);
+
+/**
+ * Find out whether the packets of a PID would be used by any filter, so that
+ * a source can leave the others out.
+ *
+ * @param demux The demux.
+ * @param pid The PID.
+ * @return 1 if a filter (including one on all PIDs) takes the PID, 0 if not.
+ */
+extern int dvbswdemux_pid_wanted(struct dvbswdemux *demux, int pid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
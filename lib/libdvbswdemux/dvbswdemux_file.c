@@ -0,0 +1,309 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libucsi/transport_packet.h>
+
+#include "dvbswdemux.h"
+#include "dvbswdemux_file.h"
+
+#define SWDEMUX_FILE_CHUNK_SIZE (4 * 1024 * 1024)
+#define SWDEMUX_FILE_MAX_THREADS 64
+#define SWDEMUX_FILE_SYNC_WINDOW (64 * 1024)
+
+struct swdemux_file_worker {
+	struct dvbswdemux_file *file;
+	pthread_t thread;
+	int threaded;				/* picked by thread, rather than inline */
+	size_t chunk;
+	int failed;
+
+	uint8_t *data;				/* the wanted packets of the chunk */
+	size_t len;
+	size_t size;
+};
+
+struct dvbswdemux_file {
+	struct dvbswdemux *demux;
+
+	uint8_t *map;
+	size_t size;
+	size_t chunk_count;
+	size_t next_chunk;
+	uint64_t passes;
+	uint64_t position;
+
+	int thread_count;
+	struct swdemux_file_worker *workers;
+
+	int all;				/* every PID is wanted */
+	uint8_t wanted[TRANSPORT_MAX_PIDS];
+};
+
+/*
+ * The first packet start at or after pos: a sync byte followed by two more a
+ * packet apart, as far as the file goes. Both threads needing a chunk
+ * boundary get the same answer.
+ */
+static size_t swdemux_file_resync(struct dvbswdemux_file *file, size_t pos)
+{
+	size_t window, p;
+	int off;
+
+	while(pos < file->size) {
+		window = file->size - pos;
+		if (window > SWDEMUX_FILE_SYNC_WINDOW)
+			window = SWDEMUX_FILE_SYNC_WINDOW;
+		if ((off = transport_packet_find_sync(file->map + pos, window)) < 0) {
+			pos += window;
+			continue;
+		}
+
+		p = pos + off;
+		if (((p + TRANSPORT_PACKET_LENGTH < file->size) &&
+		     (file->map[p + TRANSPORT_PACKET_LENGTH] != TRANSPORT_PACKET_SYNC)) ||
+		    ((p + 2 * TRANSPORT_PACKET_LENGTH < file->size) &&
+		     (file->map[p + 2 * TRANSPORT_PACKET_LENGTH] != TRANSPORT_PACKET_SYNC))) {
+			pos = p + 1;
+			continue;
+		}
+		return p;
+	}
+	return file->size;
+}
+
+static size_t swdemux_file_chunk_start(struct dvbswdemux_file *file, size_t chunk)
+{
+	if (chunk >= file->chunk_count)
+		return file->size;
+	return swdemux_file_resync(file, chunk * SWDEMUX_FILE_CHUNK_SIZE);
+}
+
+static int swdemux_file_append(struct swdemux_file_worker *w, uint8_t *pkt)
+{
+	if ((w->len + TRANSPORT_PACKET_LENGTH) > w->size) {
+		size_t size = w->size ? w->size * 2 : 64 * TRANSPORT_PACKET_LENGTH;
+		uint8_t *data;
+
+		if ((data = realloc(w->data, size)) == NULL)
+			return -1;
+		w->data = data;
+		w->size = size;
+	}
+	memcpy(w->data + w->len, pkt, TRANSPORT_PACKET_LENGTH);
+	w->len += TRANSPORT_PACKET_LENGTH;
+	return 0;
+}
+
+static void *swdemux_file_pick(void *arg)
+{
+	struct swdemux_file_worker *w = (struct swdemux_file_worker *) arg;
+	struct dvbswdemux_file *file = w->file;
+	size_t pos = swdemux_file_chunk_start(file, w->chunk);
+	size_t end = swdemux_file_chunk_start(file, w->chunk + 1);
+	uint8_t *pkt;
+
+	w->len = 0;
+	w->failed = 0;
+	while((pos + TRANSPORT_PACKET_LENGTH) <= end) {
+		pkt = file->map + pos;
+		if ((pkt[0] != TRANSPORT_PACKET_SYNC) ||
+		    (((pos + TRANSPORT_PACKET_LENGTH) < end) &&
+		     (pkt[TRANSPORT_PACKET_LENGTH] != TRANSPORT_PACKET_SYNC))) {
+			pos = swdemux_file_resync(file, pos + 1);
+			continue;
+		}
+		pos += TRANSPORT_PACKET_LENGTH;
+
+		if (file->wanted[((pkt[1] & 0x1f) << 8) | pkt[2]] &&
+		    swdemux_file_append(w, pkt)) {
+			w->failed = 1;
+			break;
+		}
+	}
+	return NULL;
+}
+
+struct dvbswdemux_file *dvbswdemux_file_open(const char *path,
+					     struct dvbswdemux *demux, int threads)
+{
+	struct dvbswdemux_file *file;
+	struct stat st;
+	int fd, err;
+	int i;
+
+	if (threads <= 0)
+		threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads <= 0)
+		threads = 1;
+	if (threads > SWDEMUX_FILE_MAX_THREADS)
+		threads = SWDEMUX_FILE_MAX_THREADS;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+	if (fstat(fd, &st) < 0)
+		goto error_close;
+	if (st.st_size < TRANSPORT_PACKET_LENGTH) {
+		errno = EINVAL;
+		goto error_close;
+	}
+
+	if ((file = calloc(1, sizeof(struct dvbswdemux_file))) == NULL)
+		goto error_close;
+	if ((file->workers = calloc(threads, sizeof(struct swdemux_file_worker))) == NULL)
+		goto error_free;
+	file->demux = demux;
+	file->size = st.st_size;
+	file->chunk_count = (file->size + SWDEMUX_FILE_CHUNK_SIZE - 1) / SWDEMUX_FILE_CHUNK_SIZE;
+	file->thread_count = threads;
+	for(i = 0; i < threads; i++)
+		file->workers[i].file = file;
+
+	if ((file->map = mmap(NULL, file->size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+		goto error_free;
+	madvise(file->map, file->size, MADV_SEQUENTIAL);
+	close(fd);
+
+	return file;
+
+error_free:
+	err = errno;
+	free(file->workers);
+	free(file);
+	errno = err;
+error_close:
+	err = errno;
+	close(fd);
+	errno = err;
+	return NULL;
+}
+
+void dvbswdemux_file_close(struct dvbswdemux_file *file)
+{
+	int i;
+
+	for(i = 0; i < file->thread_count; i++)
+		free(file->workers[i].data);
+	munmap(file->map, file->size);
+	free(file->workers);
+	free(file);
+}
+
+/*
+ * Has a filter been added on a PID left out of the round being fed?
+ */
+static int swdemux_file_grown(struct dvbswdemux_file *file)
+{
+	int pid;
+
+	if (file->all)
+		return 0;
+	for(pid = 0; pid < TRANSPORT_MAX_PIDS; pid++) {
+		if (!file->wanted[pid] && dvbswdemux_pid_wanted(file->demux, pid))
+			return 1;
+	}
+	return 0;
+}
+
+int dvbswdemux_file_feed(struct dvbswdemux_file *file)
+{
+	uint64_t base = file->passes * file->size;
+	size_t count = file->chunk_count - file->next_chunk;
+	size_t start, end;
+	int failed = 0;
+	size_t i;
+	int pid;
+
+	if (count > (size_t) file->thread_count)
+		count = file->thread_count;
+
+	file->all = 1;
+	for(pid = 0; pid < TRANSPORT_MAX_PIDS; pid++) {
+		file->wanted[pid] = dvbswdemux_pid_wanted(file->demux, pid);
+		if (!file->wanted[pid])
+			file->all = 0;
+	}
+
+	// a filter on all PIDs gets the file as it is
+	if (!file->all) {
+		for(i = 0; i < count; i++) {
+			struct swdemux_file_worker *w = &file->workers[i];
+
+			w->chunk = file->next_chunk + i;
+			w->threaded = (i != 0) &&
+				(pthread_create(&w->thread, NULL, swdemux_file_pick, w) == 0);
+		}
+		// the calling thread takes the first chunk, and any which got no thread
+		for(i = 0; i < count; i++) {
+			if (!file->workers[i].threaded)
+				swdemux_file_pick(&file->workers[i]);
+		}
+		for(i = 0; i < count; i++) {
+			if (file->workers[i].threaded)
+				pthread_join(file->workers[i].thread, NULL);
+			failed |= file->workers[i].failed;
+		}
+		if (failed)
+			return -1;
+	}
+
+	for(i = 0; i < count; i++) {
+		end = swdemux_file_chunk_start(file, file->next_chunk + 1);
+		file->position = base + end;
+
+		if (file->all) {
+			start = swdemux_file_chunk_start(file, file->next_chunk);
+			if (end > start)
+				dvbswdemux_feed(file->demux, file->map + start, end - start);
+		} else if (file->workers[i].len) {
+			dvbswdemux_feed(file->demux, file->workers[i].data, file->workers[i].len);
+		}
+		file->next_chunk++;
+
+		// the rest of the round was picked without the new PID: read it again
+		if (swdemux_file_grown(file))
+			break;
+	}
+
+	if (file->next_chunk == file->chunk_count) {
+		file->next_chunk = 0;
+		file->passes++;
+	}
+	file->position = (file->passes * file->size) +
+		swdemux_file_chunk_start(file, file->next_chunk);
+	return 0;
+}
+
+uint64_t dvbswdemux_file_position(struct dvbswdemux_file *file)
+{
+	return file->position;
+}
+
+uint64_t dvbswdemux_file_size(struct dvbswdemux_file *file)
+{
+	return file->size;
+}
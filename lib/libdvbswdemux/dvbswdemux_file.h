@@ -0,0 +1,95 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBSWDEMUX_FILE_H
+#define LIBDVBSWDEMUX_FILE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+struct dvbswdemux;
+
+/**
+ * A recorded capture as the source of a dvbswdemux, read as fast as the
+ * disk allows rather than at the broadcast rate.
+ *
+ * The file is mapped, and read a round of one chunk per thread at a time:
+ * the threads each pick the packets of the PIDs the demux has filters on out
+ * of their chunk, and the calling thread then feeds what they found to the
+ * demux, chunk by chunk, so the callbacks run in the calling thread just as
+ * for dvbswdemux_feed(). A filter on a new PID only sees the packets after
+ * the chunk it was added in.
+ *
+ * At the end of the file, reading starts again from the beginning, since a
+ * filter added late may need a table which only went by earlier. A filter
+ * has seen all of the capture once dvbswdemux_file_position() has moved on
+ * by dvbswdemux_file_size() since it was added, which is what a timeout
+ * should be based on instead of the time.
+ */
+struct dvbswdemux_file;
+
+/**
+ * Open a capture.
+ *
+ * @param path Name of the file.
+ * @param demux The demux to feed it to.
+ * @param threads Number of threads, or 0 for one per online CPU.
+ * @return The file, or NULL on failure (errno is set).
+ */
+extern struct dvbswdemux_file *dvbswdemux_file_open(const char *path,
+						    struct dvbswdemux *demux, int threads);
+
+/**
+ * Close a capture. The demux is left alone.
+ *
+ * @param file The file.
+ */
+extern void dvbswdemux_file_close(struct dvbswdemux_file *file);
+
+/**
+ * Read a round of chunks and feed it to the demux.
+ *
+ * @param file The file.
+ * @return 0 on success, or -1 if there was no memory for the packets.
+ */
+extern int dvbswdemux_file_feed(struct dvbswdemux_file *file);
+
+/**
+ * @param file The file.
+ * @return The number of bytes of the file read so far, counting every pass.
+ * Inside a callback, this takes in the rest of the chunk being fed.
+ */
+extern uint64_t dvbswdemux_file_position(struct dvbswdemux_file *file);
+
+/**
+ * @param file The file.
+ * @return The size of the file in bytes.
+ */
+extern uint64_t dvbswdemux_file_size(struct dvbswdemux_file *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,37 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ * internals shared between the parts of the library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef DVBSWDEMUX_INT_H
+#define DVBSWDEMUX_INT_H 1
+
+#include <libucsi/transport_packet.h>
+#include "dvbswdemux.h"
+
+#define SWDEMUX_READ_SIZE (TRANSPORT_PACKET_LENGTH * TRANSPORT_BATCH_MAX)
+
+/*
+ * Hand the filters of a PID, and what was being reassembled for it, from one
+ * demux to another which has none on it. Neither may be dispatching that
+ * PID, but the source may be in the middle of a feed of others.
+ */
+extern void dvbswdemux_move_pid(struct dvbswdemux *from, struct dvbswdemux *to, int pid);
+
+#endif
@@ -0,0 +1,368 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <libucsi/crc32.h>
+
+#include "dvbswdemux_pool.h"
+
+#define SWDEMUX_POOL_MAX_WORKERS 64
+#define SWDEMUX_POOL_DEFAULT_QUEUE 256
+#define SWDEMUX_POOL_MAX_QUEUE 65536
+#define SWDEMUX_POOL_PSI_QUEUE 64
+
+#define SWDEMUX_POOL_RING_PSI 0
+#define SWDEMUX_POOL_RING_MAIN 1
+#define SWDEMUX_POOL_RINGS 2
+
+struct swdemux_pool_slot {
+	int len;
+	uint8_t data[DVBSWDEMUX_POOL_MAX_SECTION];
+};
+
+/*
+ * tail is only written by the submitting thread and head only by the worker;
+ * each side sets its waiting flag before sleeping on cond, and the other
+ * side only takes the lock to wake it if the flag is set. The submitting
+ * side's flag is the number of sections queued it waits for, plus 1, so that
+ * a full queue is drained to half before it is woken rather than once per
+ * section.
+ */
+struct swdemux_pool_ring {
+	struct swdemux_pool_slot *slots;
+	uint32_t mask;
+
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t producer_waiting;
+
+	uint32_t head __attribute__((aligned(64)));
+};
+
+/*
+ * Each worker has a small ring for PSI and CA sections, which it always
+ * empties first, and a ring for everything else.
+ */
+struct swdemux_pool_worker {
+	struct dvbswdemux_pool *pool;
+	int index;
+	pthread_t thread;
+	struct swdemux_pool_ring rings[SWDEMUX_POOL_RINGS];
+
+	int worker_waiting __attribute__((aligned(64)));
+	int stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct dvbswdemux_pool {
+	int worker_count;
+	int checkcrc;
+	int shed;
+	dvbswdemux_pool_callback callback;
+	void *private_data;
+
+	struct swdemux_pool_worker *workers;
+
+	/* only written by the submitting thread */
+	struct dvbswdemux_pool_stats stats;
+};
+
+static inline void pool_count(uint64_t *counter)
+{
+	__atomic_store_n(counter, *counter + 1, __ATOMIC_RELAXED);
+}
+
+static void pool_wake(struct swdemux_pool_worker *w)
+{
+	pthread_mutex_lock(&w->lock);
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * Wait (on the submitting side) until a ring of a worker has no more than
+ * max sections queued.
+ */
+static void pool_wait_queued(struct swdemux_pool_worker *w, struct swdemux_pool_ring *r,
+			     uint32_t max)
+{
+	if ((r->tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE)) <= max)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	__atomic_store_n(&r->producer_waiting, max + 1, __ATOMIC_SEQ_CST);
+	while((r->tail - __atomic_load_n(&r->head, __ATOMIC_SEQ_CST)) > max)
+		pthread_cond_wait(&w->cond, &w->lock);
+	__atomic_store_n(&r->producer_waiting, 0, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* the first ring of a worker with anything queued, PSI first */
+static struct swdemux_pool_ring *pool_next_ring(struct swdemux_pool_worker *w)
+{
+	int i;
+
+	for(i = 0; i < SWDEMUX_POOL_RINGS; i++) {
+		if (__atomic_load_n(&w->rings[i].tail, __ATOMIC_SEQ_CST) != w->rings[i].head)
+			return &w->rings[i];
+	}
+	return NULL;
+}
+
+static void *pool_worker_func(void *arg)
+{
+	struct swdemux_pool_worker *w = arg;
+	struct dvbswdemux_pool *pool = w->pool;
+	struct swdemux_pool_ring *r;
+	struct swdemux_pool_slot *slot;
+	uint32_t head;
+	uint32_t waiting;
+
+	while(1) {
+		if ((r = pool_next_ring(w)) == NULL) {
+			pthread_mutex_lock(&w->lock);
+			__atomic_store_n(&w->worker_waiting, 1, __ATOMIC_SEQ_CST);
+			while(((r = pool_next_ring(w)) == NULL) && !w->stop)
+				pthread_cond_wait(&w->cond, &w->lock);
+			__atomic_store_n(&w->worker_waiting, 0, __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&w->lock);
+
+			// only stop once everything queued is done
+			if (r == NULL)
+				break;
+		}
+
+		head = r->head;
+		slot = &r->slots[head & r->mask];
+		if (!pool->checkcrc || !(slot->data[1] & 0x80) ||
+		    (crc32(CRC32_INIT, slot->data, slot->len) == 0))
+			pool->callback(pool->private_data, w->index, slot->data, slot->len);
+
+		// the slot is only handed back once the callback is finished with it
+		__atomic_store_n(&r->head, ++head, __ATOMIC_SEQ_CST);
+		if ((waiting = __atomic_load_n(&r->producer_waiting, __ATOMIC_SEQ_CST)) &&
+		    ((__atomic_load_n(&r->tail, __ATOMIC_SEQ_CST) - head) < waiting))
+			pool_wake(w);
+	}
+
+	return NULL;
+}
+
+static void pool_stop(struct dvbswdemux_pool *pool, int count)
+{
+	int i, j;
+
+	for(i = 0; i < count; i++) {
+		struct swdemux_pool_worker *w = &pool->workers[i];
+
+		pthread_mutex_lock(&w->lock);
+		w->stop = 1;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->thread, NULL);
+	}
+
+	for(i = 0; i < pool->worker_count; i++) {
+		pthread_mutex_destroy(&pool->workers[i].lock);
+		pthread_cond_destroy(&pool->workers[i].cond);
+		for(j = 0; j < SWDEMUX_POOL_RINGS; j++)
+			free(pool->workers[i].rings[j].slots);
+	}
+	free(pool->workers);
+	free(pool);
+}
+
+struct dvbswdemux_pool *dvbswdemux_pool_create(int workers, int queue_len, int checkcrc,
+					       dvbswdemux_pool_callback callback,
+					       void *private_data)
+{
+	struct dvbswdemux_pool *pool;
+	uint32_t size = 1;
+	int i, j;
+
+	if (workers <= 0)
+		workers = sysconf(_SC_NPROCESSORS_ONLN);
+	if (workers <= 0)
+		workers = 1;
+	if (workers > SWDEMUX_POOL_MAX_WORKERS)
+		workers = SWDEMUX_POOL_MAX_WORKERS;
+	if (queue_len <= 0)
+		queue_len = SWDEMUX_POOL_DEFAULT_QUEUE;
+	if (queue_len > SWDEMUX_POOL_MAX_QUEUE)
+		queue_len = SWDEMUX_POOL_MAX_QUEUE;
+	while(size < (uint32_t) queue_len)
+		size <<= 1;
+
+	if ((pool = calloc(1, sizeof(struct dvbswdemux_pool))) == NULL)
+		return NULL;
+	pool->worker_count = workers;
+	pool->checkcrc = checkcrc;
+	pool->callback = callback;
+	pool->private_data = private_data;
+
+	if ((pool->workers = calloc(workers, sizeof(struct swdemux_pool_worker))) == NULL) {
+		free(pool);
+		return NULL;
+	}
+	for(i = 0; i < workers; i++) {
+		struct swdemux_pool_worker *w = &pool->workers[i];
+
+		w->pool = pool;
+		w->index = i;
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, NULL);
+		w->rings[SWDEMUX_POOL_RING_PSI].mask = SWDEMUX_POOL_PSI_QUEUE - 1;
+		w->rings[SWDEMUX_POOL_RING_MAIN].mask = size - 1;
+		for(j = 0; j < SWDEMUX_POOL_RINGS; j++) {
+			w->rings[j].slots = malloc((w->rings[j].mask + 1) *
+						   sizeof(struct swdemux_pool_slot));
+			if (w->rings[j].slots == NULL) {
+				pool_stop(pool, 0);
+				return NULL;
+			}
+		}
+	}
+
+	for(i = 0; i < workers; i++) {
+		if (pthread_create(&pool->workers[i].thread, NULL, pool_worker_func, &pool->workers[i])) {
+			pool_stop(pool, i);
+			return NULL;
+		}
+	}
+
+	return pool;
+}
+
+void dvbswdemux_pool_destroy(struct dvbswdemux_pool *pool)
+{
+	pool_stop(pool, pool->worker_count);
+}
+
+int dvbswdemux_pool_workers(struct dvbswdemux_pool *pool)
+{
+	return pool->worker_count;
+}
+
+void dvbswdemux_pool_set_shed(struct dvbswdemux_pool *pool, int shed)
+{
+	pool->shed = shed;
+}
+
+int dvbswdemux_pool_priority(const uint8_t *section)
+{
+	uint8_t table_id = section[0];
+
+	// PAT, CAT, PMT, and the CA message sections
+	if ((table_id <= 0x02) || ((table_id >= 0x80) && (table_id <= 0x8f)))
+		return DVBSWDEMUX_POOL_PRIORITY_PSI;
+	// DVB EIT schedule, ATSC EIT and ETT
+	if (((table_id >= 0x50) && (table_id <= 0x6f)) ||
+	    (table_id == 0xcb) || (table_id == 0xcc))
+		return DVBSWDEMUX_POOL_PRIORITY_BULK;
+	return DVBSWDEMUX_POOL_PRIORITY_NORMAL;
+}
+
+int dvbswdemux_pool_submit(struct dvbswdemux_pool *pool, uint8_t *section, int len)
+{
+	if (len < 3)
+		return -1;
+
+	return dvbswdemux_pool_submit_priority(pool, section, len,
+					       dvbswdemux_pool_priority(section));
+}
+
+int dvbswdemux_pool_submit_priority(struct dvbswdemux_pool *pool, uint8_t *section, int len,
+				    int priority)
+{
+	struct swdemux_pool_worker *w;
+	struct swdemux_pool_ring *r;
+	struct swdemux_pool_slot *slot;
+	uint32_t queued;
+	uint32_t key;
+
+	if ((len < 3) || (len > DVBSWDEMUX_POOL_MAX_SECTION))
+		return -1;
+	if ((priority < 0) || (priority >= DVBSWDEMUX_POOL_PRIORITIES))
+		return -1;
+
+	// the table_id_extension only means anything in long sections
+	key = section[0] << 16;
+	if ((section[1] & 0x80) && (len >= 5))
+		key |= (section[3] << 8) | section[4];
+	key *= 2654435761U;
+	w = &pool->workers[((uint64_t) key * pool->worker_count) >> 32];
+	if (priority == DVBSWDEMUX_POOL_PRIORITY_PSI)
+		r = &w->rings[SWDEMUX_POOL_RING_PSI];
+	else
+		r = &w->rings[SWDEMUX_POOL_RING_MAIN];
+
+	// bulk sections may only fill half the queue, leaving the rest for the others
+	queued = r->tail - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+	if (pool->shed && (priority == DVBSWDEMUX_POOL_PRIORITY_BULK) &&
+	    (queued > (r->mask >> 1))) {
+		pool_count(&pool->stats.shed[priority]);
+		return 1;
+	}
+	if (queued > r->mask) {
+		pool_count(&pool->stats.waits[priority]);
+		pool_wait_queued(w, r, r->mask >> 1);
+	}
+
+	slot = &r->slots[r->tail & r->mask];
+	memcpy(slot->data, section, len);
+	slot->len = len;
+	__atomic_store_n(&r->tail, r->tail + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->worker_waiting, __ATOMIC_SEQ_CST))
+		pool_wake(w);
+	pool_count(&pool->stats.submitted[priority]);
+
+	return 0;
+}
+
+int dvbswdemux_pool_section_callback(void *pool, uint8_t *data, int len)
+{
+	dvbswdemux_pool_submit(pool, data, len);
+	return 0;
+}
+
+void dvbswdemux_pool_flush(struct dvbswdemux_pool *pool)
+{
+	int i, j;
+
+	for(i = 0; i < pool->worker_count; i++) {
+		for(j = 0; j < SWDEMUX_POOL_RINGS; j++)
+			pool_wait_queued(&pool->workers[i], &pool->workers[i].rings[j], 0);
+	}
+}
+
+void dvbswdemux_pool_get_stats(struct dvbswdemux_pool *pool, struct dvbswdemux_pool_stats *stats)
+{
+	int i;
+
+	for(i = 0; i < DVBSWDEMUX_POOL_PRIORITIES; i++) {
+		stats->submitted[i] = __atomic_load_n(&pool->stats.submitted[i], __ATOMIC_RELAXED);
+		stats->shed[i] = __atomic_load_n(&pool->stats.shed[i], __ATOMIC_RELAXED);
+		stats->waits[i] = __atomic_load_n(&pool->stats.waits[i], __ATOMIC_RELAXED);
+	}
+}
@@ -0,0 +1,204 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBSWDEMUX_POOL_H
+#define LIBDVBSWDEMUX_POOL_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * A pool of worker threads which CRC check and decode sections, for PIDs
+ * (full EIT schedules for example) carrying more than one thread can
+ * decode.
+ *
+ * The thread reading the stream submits sections, which are copied into
+ * the queue of one worker chosen from the table_id and, for sections with
+ * the syntax indicator set, the table_id_extension. All the sections of a
+ * table are therefore decoded in order by the same worker, so per table
+ * state such as a struct psi_table_state can be kept per worker, indexed by
+ * the worker number given to the callback, without any locking.
+ *
+ * Each queue is a ring with one producer and one consumer, which only
+ * takes a lock to sleep on when it is empty or full. Sections must be
+ * submitted from one thread at a time.
+ *
+ * Sections have a priority, by default from their table_id
+ * (dvbswdemux_pool_priority()). PSI and CA sections go to a queue of their
+ * own on each worker, which is emptied before anything else, so a zap or a
+ * descrambler is not kept waiting behind a backlog of EIT schedules. A
+ * pool reading a live stream, where waiting for room only moves the
+ * overflow to the DVR buffer, can also shed bulk sections (see
+ * dvbswdemux_pool_set_shed()).
+ */
+struct dvbswdemux_pool;
+
+/**
+ * Largest section a pool takes.
+ */
+#define DVBSWDEMUX_POOL_MAX_SECTION 4096
+
+/**
+ * Section priorities.
+ */
+enum dvbswdemux_pool_priority {
+	DVBSWDEMUX_POOL_PRIORITY_PSI,		/* PAT, CAT, PMT, CA: decoded first */
+	DVBSWDEMUX_POOL_PRIORITY_NORMAL,	/* other SI */
+	DVBSWDEMUX_POOL_PRIORITY_BULK,		/* EIT schedules, ATSC EIT and ETT */
+};
+#define DVBSWDEMUX_POOL_PRIORITIES 3
+
+/**
+ * Counters for a pool, indexed by priority.
+ */
+struct dvbswdemux_pool_stats {
+	uint64_t submitted[DVBSWDEMUX_POOL_PRIORITIES];	/* queued for a worker */
+	uint64_t shed[DVBSWDEMUX_POOL_PRIORITIES];	/* dropped, their queue being too full */
+	uint64_t waits[DVBSWDEMUX_POOL_PRIORITIES];	/* times submitting waited for room */
+};
+
+/**
+ * Callback for sections, run on a worker thread.
+ *
+ * @param private_data Private data given when the pool was created.
+ * @param worker Number of the worker thread, 0 to the number of workers - 1.
+ * @param section The section. It is only valid during the call, and may be
+ * modified (the libucsi codecs decode in place).
+ * @param len Its length in bytes.
+ */
+typedef void (*dvbswdemux_pool_callback)(void *private_data, int worker,
+					 uint8_t *section, int len);
+
+/**
+ * Create a pool and start its workers.
+ *
+ * @param workers Number of worker threads, or 0 for one per online CPU.
+ * @param queue_len Sections each worker may have queued before
+ * dvbswdemux_pool_submit() waits, rounded up to a power of 2, or 0 for a
+ * default of 256.
+ * @param checkcrc If 1, sections with the syntax indicator set and a bad CRC
+ * are dropped by the workers, rather than passed to the callback.
+ * @param callback Called for each section.
+ * @param private_data Private data for the callback.
+ * @return The pool, or NULL on failure.
+ */
+extern struct dvbswdemux_pool *dvbswdemux_pool_create(int workers, int queue_len, int checkcrc,
+						      dvbswdemux_pool_callback callback,
+						      void *private_data);
+
+/**
+ * Decode everything still queued, then stop the workers and destroy the pool.
+ *
+ * @param pool The pool.
+ */
+extern void dvbswdemux_pool_destroy(struct dvbswdemux_pool *pool);
+
+/**
+ * @param pool The pool.
+ * @return The number of worker threads.
+ */
+extern int dvbswdemux_pool_workers(struct dvbswdemux_pool *pool);
+
+/**
+ * Choose whether bulk sections are shed rather than waited for: once they
+ * fill half of a worker's queue, further ones are dropped (and counted) until
+ * it drains. This is off when a pool is created.
+ *
+ * @param pool The pool.
+ * @param shed 1 to shed bulk sections, 0 to wait for room for them.
+ */
+extern void dvbswdemux_pool_set_shed(struct dvbswdemux_pool *pool, int shed);
+
+/**
+ * Find the default priority of a section.
+ *
+ * @param section The section.
+ * @return One of enum dvbswdemux_pool_priority.
+ */
+extern int dvbswdemux_pool_priority(const uint8_t *section);
+
+/**
+ * Queue a copy of a section for its worker, with its default priority,
+ * waiting for room if that worker's queue is full.
+ *
+ * @param pool The pool.
+ * @param section The section.
+ * @param len Its length in bytes.
+ * @return 0 on success, 1 if the section was shed, or -1 if the length is
+ * outside 3 to DVBSWDEMUX_POOL_MAX_SECTION.
+ */
+extern int dvbswdemux_pool_submit(struct dvbswdemux_pool *pool, uint8_t *section, int len);
+
+/**
+ * Queue a copy of a section for its worker with a given priority, for
+ * sections whose table_id does not tell (a private table carrying CA data
+ * for example). All the sections of a table must be given the same
+ * priority, or they may be decoded out of order.
+ *
+ * @param pool The pool.
+ * @param section The section.
+ * @param len Its length in bytes.
+ * @param priority One of enum dvbswdemux_pool_priority.
+ * @return 0 on success, 1 if the section was shed, or -1 if the length is
+ * outside 3 to DVBSWDEMUX_POOL_MAX_SECTION or the priority is invalid.
+ */
+extern int dvbswdemux_pool_submit_priority(struct dvbswdemux_pool *pool, uint8_t *section,
+					   int len, int priority);
+
+/**
+ * A dvbswdemux_data_callback which submits sections to a pool, so that a
+ * section filter can feed it directly:
+ *
+ *	dvbswdemux_add_section_filter(demux, pid, filter, mask, 0,
+ *				      dvbswdemux_pool_section_callback, pool);
+ *
+ * The CRC is best left to the pool's workers.
+ *
+ * @param pool The pool.
+ * @return 0, to keep the filter.
+ */
+extern int dvbswdemux_pool_section_callback(void *pool, uint8_t *data, int len);
+
+/**
+ * Wait until every section submitted so far has been through the callback.
+ *
+ * @param pool The pool.
+ */
+extern void dvbswdemux_pool_flush(struct dvbswdemux_pool *pool);
+
+/**
+ * Retrieve the counters for a pool. They are kept by the submitting thread,
+ * so from any other thread they may be a little behind.
+ *
+ * @param pool The pool.
+ * @param stats Where to put them.
+ */
+extern void dvbswdemux_pool_get_stats(struct dvbswdemux_pool *pool,
+				      struct dvbswdemux_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,756 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <libucsi/transport_packet.h>
+
+#include "dvbswdemux_shard.h"
+#include "dvbswdemux_int.h"
+
+#define SWDEMUX_SHARD_MAX 64
+#define SWDEMUX_SHARD_DEFAULT_QUEUE 64
+#define SWDEMUX_SHARD_MAX_QUEUE 4096
+#define SWDEMUX_SHARD_BATCH 64			/* packets per slot */
+#define SWDEMUX_SHARD_REBALANCE 262144		/* packets routed between rebalances */
+#define SWDEMUX_SHARD_MAX_MOVES 16		/* in one rebalance */
+#define SWDEMUX_SHARD_NONE 0xff
+
+enum swdemux_shard_slot_type {
+	SWDEMUX_SHARD_PACKETS,
+	SWDEMUX_SHARD_ADD,
+	SWDEMUX_SHARD_REMOVE,
+	SWDEMUX_SHARD_MOVE,
+};
+
+enum swdemux_shard_filter_type {
+	SWDEMUX_SHARD_FILTER_TS,
+	SWDEMUX_SHARD_FILTER_SECTION,
+	SWDEMUX_SHARD_FILTER_PES,
+};
+
+struct dvbswdemux_shard_filter {
+	struct dvbswdemux_shard_filter *next;	/* only used by the feeding thread */
+
+	int pid;
+	enum swdemux_shard_filter_type type;
+	dvbswdemux_ts_callback ts_callback;
+	dvbswdemux_data_callback data_callback;
+	void *private_data;
+	int checkcrc;
+	uint8_t filter[18];
+	uint8_t mask[18];
+
+	/* only used by the shard owning the PID */
+	struct dvbswdemux_filter *demux_filter;
+	int done;				/* removed by its callback, or never added */
+};
+
+/*
+ * Commands travel through the same ring as the packets, so they take effect
+ * exactly between the packets fed before and after them.
+ */
+struct swdemux_shard_slot {
+	enum swdemux_shard_slot_type type;
+	int count;				/* SWDEMUX_SHARD_PACKETS */
+	struct dvbswdemux_shard_filter *filter;	/* SWDEMUX_SHARD_ADD and SWDEMUX_SHARD_REMOVE */
+	int pid;				/* SWDEMUX_SHARD_MOVE: the PID, */
+	int from;				/* the shard it comes from, */
+	uint32_t fence;				/* and that shard's tail after its last packet */
+	uint8_t packets[SWDEMUX_SHARD_BATCH * TRANSPORT_PACKET_LENGTH];
+};
+
+/*
+ * The ring works as a dvbswdemux_pool's does. The slot at tail is filled in
+ * place by the feeding thread, and only handed over, with open packets in
+ * it, when it is full or the feed ends.
+ */
+struct swdemux_shard_worker {
+	struct dvbswdemux_shard *sd;
+	int index;
+	pthread_t thread;
+	struct dvbswdemux *demux;
+
+	struct swdemux_shard_slot *slots;
+	uint32_t mask;
+
+	uint32_t tail __attribute__((aligned(64)));
+	uint32_t producer_waiting;
+	int open;
+	int pids;				/* PIDs owned */
+	uint32_t load;				/* packets since the last rebalance */
+	uint64_t routed;
+
+	uint32_t head __attribute__((aligned(64)));
+
+	int worker_waiting __attribute__((aligned(64)));
+	int stop;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+struct dvbswdemux_shard {
+	int shard_count;
+	int rebalance;
+	struct swdemux_shard_worker *shards;
+
+	/* only used by the feeding thread */
+	uint8_t route[TRANSPORT_MAX_PIDS];
+	uint16_t filters[TRANSPORT_MAX_PIDS];
+	uint32_t pid_load[TRANSPORT_MAX_PIDS];
+	uint32_t since_rebalance;
+	struct dvbswdemux_shard_filter *filter_list;
+
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int partial_len;
+	uint8_t *readbuf;
+
+	struct dvbswdemux_shard_stats stats;
+};
+
+static __thread int shard_self = -1;
+
+static inline void shard_count(uint64_t *counter, uint64_t n)
+{
+	__atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static void shard_wake(struct swdemux_shard_worker *w)
+{
+	pthread_mutex_lock(&w->lock);
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* wait (on the feeding side) until a shard has no more than max slots queued */
+static void shard_wait_queued(struct swdemux_shard_worker *w, uint32_t max)
+{
+	if ((w->tail - __atomic_load_n(&w->head, __ATOMIC_ACQUIRE)) <= max)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	__atomic_store_n(&w->producer_waiting, max + 1, __ATOMIC_SEQ_CST);
+	while((w->tail - __atomic_load_n(&w->head, __ATOMIC_SEQ_CST)) > max)
+		pthread_cond_wait(&w->cond, &w->lock);
+	__atomic_store_n(&w->producer_waiting, 0, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* the slot at tail, once the shard has finished with it */
+static struct swdemux_shard_slot *shard_slot(struct swdemux_shard_worker *w)
+{
+	if ((w->tail - __atomic_load_n(&w->head, __ATOMIC_ACQUIRE)) > w->mask) {
+		shard_count(&w->sd->stats.waits, 1);
+		shard_wait_queued(w, w->mask >> 1);
+	}
+	return &w->slots[w->tail & w->mask];
+}
+
+static void shard_publish(struct swdemux_shard_worker *w, enum swdemux_shard_slot_type type)
+{
+	struct swdemux_shard_slot *slot = &w->slots[w->tail & w->mask];
+
+	slot->type = type;
+	slot->count = w->open;
+	w->open = 0;
+	__atomic_store_n(&w->tail, w->tail + 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&w->worker_waiting, __ATOMIC_SEQ_CST))
+		shard_wake(w);
+}
+
+/* a command, after any packets queued before it */
+static struct swdemux_shard_slot *shard_command(struct swdemux_shard_worker *w)
+{
+	if (w->open)
+		shard_publish(w, SWDEMUX_SHARD_PACKETS);
+	return shard_slot(w);
+}
+
+static int shard_ts_callback(void *private_data, uint8_t *packet)
+{
+	struct dvbswdemux_shard_filter *f = private_data;
+
+	f->done = (f->ts_callback(f->private_data, packet) != 0);
+	return f->done;
+}
+
+static int shard_data_callback(void *private_data, uint8_t *data, int len)
+{
+	struct dvbswdemux_shard_filter *f = private_data;
+
+	f->done = (f->data_callback(f->private_data, data, len) != 0);
+	return f->done;
+}
+
+static void shard_add(struct swdemux_shard_worker *w, struct dvbswdemux_shard_filter *f)
+{
+	switch(f->type) {
+	case SWDEMUX_SHARD_FILTER_TS:
+		f->demux_filter = dvbswdemux_add_pid_filter(w->demux, f->pid, shard_ts_callback, f);
+		break;
+	case SWDEMUX_SHARD_FILTER_SECTION:
+		f->demux_filter = dvbswdemux_add_section_filter(w->demux, f->pid, f->filter, f->mask,
+								f->checkcrc, shard_data_callback, f);
+		break;
+	case SWDEMUX_SHARD_FILTER_PES:
+		f->demux_filter = dvbswdemux_add_pes_filter(w->demux, f->pid, shard_data_callback, f);
+		break;
+	}
+	if (f->demux_filter == NULL)
+		f->done = 1;
+}
+
+/*
+ * Take on a PID from another shard, once that has demuxed everything queued
+ * for it up to the move. The wait is short: the fence is at most a queue
+ * behind, and moves are rare.
+ */
+static void shard_take(struct swdemux_shard_worker *w, struct swdemux_shard_slot *slot)
+{
+	struct swdemux_shard_worker *from = &w->sd->shards[slot->from];
+
+	while((int32_t) (slot->fence - __atomic_load_n(&from->head, __ATOMIC_ACQUIRE)) > 0)
+		sched_yield();
+	dvbswdemux_move_pid(from->demux, w->demux, slot->pid);
+}
+
+/* the first slot queued for a shard, or NULL if there are none */
+static struct swdemux_shard_slot *shard_next(struct swdemux_shard_worker *w)
+{
+	if (__atomic_load_n(&w->tail, __ATOMIC_SEQ_CST) == w->head)
+		return NULL;
+	return &w->slots[w->head & w->mask];
+}
+
+static void *shard_worker_func(void *arg)
+{
+	struct swdemux_shard_worker *w = arg;
+	struct swdemux_shard_slot *slot;
+	uint32_t head;
+	uint32_t waiting;
+
+	shard_self = w->index;
+
+	while(1) {
+		if ((slot = shard_next(w)) == NULL) {
+			pthread_mutex_lock(&w->lock);
+			__atomic_store_n(&w->worker_waiting, 1, __ATOMIC_SEQ_CST);
+			while(((slot = shard_next(w)) == NULL) && !w->stop)
+				pthread_cond_wait(&w->cond, &w->lock);
+			__atomic_store_n(&w->worker_waiting, 0, __ATOMIC_SEQ_CST);
+			pthread_mutex_unlock(&w->lock);
+
+			// only stop once everything queued is done
+			if (slot == NULL)
+				break;
+		}
+
+		switch(slot->type) {
+		case SWDEMUX_SHARD_PACKETS:
+			dvbswdemux_feed(w->demux, slot->packets, slot->count * TRANSPORT_PACKET_LENGTH);
+			break;
+		case SWDEMUX_SHARD_ADD:
+			shard_add(w, slot->filter);
+			break;
+		case SWDEMUX_SHARD_REMOVE:
+			if (!slot->filter->done)
+				dvbswdemux_remove_filter(w->demux, slot->filter->demux_filter);
+			free(slot->filter);
+			break;
+		case SWDEMUX_SHARD_MOVE:
+			shard_take(w, slot);
+			break;
+		}
+
+		head = w->head + 1;
+		__atomic_store_n(&w->head, head, __ATOMIC_SEQ_CST);
+		if ((waiting = __atomic_load_n(&w->producer_waiting, __ATOMIC_SEQ_CST)) &&
+		    ((__atomic_load_n(&w->tail, __ATOMIC_SEQ_CST) - head) < waiting))
+			shard_wake(w);
+	}
+
+	return NULL;
+}
+
+static void shard_stop(struct dvbswdemux_shard *sd, int count)
+{
+	struct dvbswdemux_shard_filter *f;
+	int i;
+
+	for(i = 0; i < count; i++) {
+		struct swdemux_shard_worker *w = &sd->shards[i];
+
+		pthread_mutex_lock(&w->lock);
+		w->stop = 1;
+		pthread_cond_broadcast(&w->cond);
+		pthread_mutex_unlock(&w->lock);
+		pthread_join(w->thread, NULL);
+	}
+
+	for(i = 0; i < sd->shard_count; i++) {
+		struct swdemux_shard_worker *w = &sd->shards[i];
+
+		if (w->demux)
+			dvbswdemux_destroy(w->demux);
+		pthread_mutex_destroy(&w->lock);
+		pthread_cond_destroy(&w->cond);
+		free(w->slots);
+	}
+	while((f = sd->filter_list) != NULL) {
+		sd->filter_list = f->next;
+		free(f);
+	}
+	free(sd->readbuf);
+	free(sd->shards);
+	free(sd);
+}
+
+struct dvbswdemux_shard *dvbswdemux_shard_create(int shards, int queue_len, int rebalance)
+{
+	struct dvbswdemux_shard *sd;
+	uint32_t size = 1;
+	int i;
+
+	if (shards <= 0)
+		shards = sysconf(_SC_NPROCESSORS_ONLN);
+	if (shards <= 0)
+		shards = 1;
+	if (shards > SWDEMUX_SHARD_MAX)
+		shards = SWDEMUX_SHARD_MAX;
+	if (queue_len <= 0)
+		queue_len = SWDEMUX_SHARD_DEFAULT_QUEUE;
+	if (queue_len > SWDEMUX_SHARD_MAX_QUEUE)
+		queue_len = SWDEMUX_SHARD_MAX_QUEUE;
+	while(size < (uint32_t) queue_len)
+		size <<= 1;
+
+	if ((sd = calloc(1, sizeof(struct dvbswdemux_shard))) == NULL)
+		return NULL;
+	sd->shard_count = shards;
+	sd->rebalance = rebalance;
+	memset(sd->route, SWDEMUX_SHARD_NONE, sizeof(sd->route));
+
+	if ((sd->shards = calloc(shards, sizeof(struct swdemux_shard_worker))) == NULL) {
+		free(sd);
+		return NULL;
+	}
+	for(i = 0; i < shards; i++) {
+		struct swdemux_shard_worker *w = &sd->shards[i];
+
+		w->sd = sd;
+		w->index = i;
+		w->mask = size - 1;
+		pthread_mutex_init(&w->lock, NULL);
+		pthread_cond_init(&w->cond, NULL);
+	}
+	if ((sd->readbuf = malloc(SWDEMUX_READ_SIZE)) == NULL)
+		goto error;
+	for(i = 0; i < shards; i++) {
+		struct swdemux_shard_worker *w = &sd->shards[i];
+
+		if (((w->demux = dvbswdemux_create()) == NULL) ||
+		    ((w->slots = malloc(size * sizeof(struct swdemux_shard_slot))) == NULL))
+			goto error;
+	}
+
+	for(i = 0; i < shards; i++) {
+		if (pthread_create(&sd->shards[i].thread, NULL, shard_worker_func, &sd->shards[i])) {
+			shard_stop(sd, i);
+			return NULL;
+		}
+	}
+
+	return sd;
+
+error:
+	shard_stop(sd, 0);
+	return NULL;
+}
+
+void dvbswdemux_shard_destroy(struct dvbswdemux_shard *sd)
+{
+	dvbswdemux_shard_flush(sd);
+	shard_stop(sd, sd->shard_count);
+}
+
+int dvbswdemux_shard_count(struct dvbswdemux_shard *sd)
+{
+	return sd->shard_count;
+}
+
+int dvbswdemux_shard_self(void)
+{
+	return shard_self;
+}
+
+/* a new PID goes to the shard with the least load, then the fewest PIDs */
+static int shard_choose(struct dvbswdemux_shard *sd)
+{
+	int best = 0;
+	int i;
+
+	for(i = 1; i < sd->shard_count; i++) {
+		struct swdemux_shard_worker *w = &sd->shards[i];
+		struct swdemux_shard_worker *b = &sd->shards[best];
+
+		if ((w->load < b->load) || ((w->load == b->load) && (w->pids < b->pids)))
+			best = i;
+	}
+	return best;
+}
+
+static struct dvbswdemux_shard_filter *shard_add_filter(struct dvbswdemux_shard *sd, int pid,
+							enum swdemux_shard_filter_type type)
+{
+	struct dvbswdemux_shard_filter *f;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS) || (sd->filters[pid] == UINT16_MAX))
+		return NULL;
+	if ((f = calloc(1, sizeof(struct dvbswdemux_shard_filter))) == NULL)
+		return NULL;
+	f->pid = pid;
+	f->type = type;
+
+	return f;
+}
+
+static struct dvbswdemux_shard_filter *shard_queue_add(struct dvbswdemux_shard *sd,
+						       struct dvbswdemux_shard_filter *f)
+{
+	struct swdemux_shard_worker *w;
+	struct swdemux_shard_slot *slot;
+
+	if (sd->route[f->pid] == SWDEMUX_SHARD_NONE) {
+		sd->route[f->pid] = shard_choose(sd);
+		sd->shards[sd->route[f->pid]].pids++;
+	}
+	sd->filters[f->pid]++;
+	f->next = sd->filter_list;
+	sd->filter_list = f;
+
+	w = &sd->shards[sd->route[f->pid]];
+	slot = shard_command(w);
+	slot->filter = f;
+	shard_publish(w, SWDEMUX_SHARD_ADD);
+
+	return f;
+}
+
+struct dvbswdemux_shard_filter *dvbswdemux_shard_add_pid_filter(struct dvbswdemux_shard *sd, int pid,
+								dvbswdemux_ts_callback callback,
+								void *private_data)
+{
+	struct dvbswdemux_shard_filter *f;
+
+	if ((f = shard_add_filter(sd, pid, SWDEMUX_SHARD_FILTER_TS)) == NULL)
+		return NULL;
+	f->ts_callback = callback;
+	f->private_data = private_data;
+
+	return shard_queue_add(sd, f);
+}
+
+struct dvbswdemux_shard_filter *dvbswdemux_shard_add_section_filter(struct dvbswdemux_shard *sd,
+								    int pid,
+								    uint8_t filter[18],
+								    uint8_t mask[18],
+								    int checkcrc,
+								    dvbswdemux_data_callback callback,
+								    void *private_data)
+{
+	struct dvbswdemux_shard_filter *f;
+
+	if ((f = shard_add_filter(sd, pid, SWDEMUX_SHARD_FILTER_SECTION)) == NULL)
+		return NULL;
+	f->data_callback = callback;
+	f->private_data = private_data;
+	f->checkcrc = checkcrc;
+	memcpy(f->filter, filter, 18);
+	memcpy(f->mask, mask, 18);
+
+	return shard_queue_add(sd, f);
+}
+
+struct dvbswdemux_shard_filter *dvbswdemux_shard_add_pes_filter(struct dvbswdemux_shard *sd, int pid,
+								dvbswdemux_data_callback callback,
+								void *private_data)
+{
+	struct dvbswdemux_shard_filter *f;
+
+	if ((f = shard_add_filter(sd, pid, SWDEMUX_SHARD_FILTER_PES)) == NULL)
+		return NULL;
+	f->data_callback = callback;
+	f->private_data = private_data;
+
+	return shard_queue_add(sd, f);
+}
+
+void dvbswdemux_shard_remove_filter(struct dvbswdemux_shard *sd,
+				    struct dvbswdemux_shard_filter *filter)
+{
+	struct dvbswdemux_shard_filter **pos;
+	struct swdemux_shard_worker *w;
+	struct swdemux_shard_slot *slot;
+	int pid = filter->pid;
+
+	for(pos = &sd->filter_list; *pos != filter; pos = &(*pos)->next)
+		;
+	*pos = filter->next;
+
+	// the shard frees it, once it has demuxed everything before
+	w = &sd->shards[sd->route[pid]];
+	slot = shard_command(w);
+	slot->filter = filter;
+	shard_publish(w, SWDEMUX_SHARD_REMOVE);
+
+	if (--sd->filters[pid] == 0) {
+		sd->route[pid] = SWDEMUX_SHARD_NONE;
+		w->pids--;
+		w->load -= sd->pid_load[pid];
+		sd->pid_load[pid] = 0;
+	}
+}
+
+static void shard_move(struct dvbswdemux_shard *sd, int pid, int shard)
+{
+	struct swdemux_shard_worker *from = &sd->shards[sd->route[pid]];
+	struct swdemux_shard_worker *to = &sd->shards[shard];
+	struct swdemux_shard_slot *slot;
+
+	if (from->open)
+		shard_publish(from, SWDEMUX_SHARD_PACKETS);
+
+	slot = shard_command(to);
+	slot->pid = pid;
+	slot->from = from->index;
+	slot->fence = from->tail;
+	shard_publish(to, SWDEMUX_SHARD_MOVE);
+
+	sd->route[pid] = shard;
+	from->pids--;
+	to->pids++;
+	from->load -= sd->pid_load[pid];
+	to->load += sd->pid_load[pid];
+	shard_count(&sd->stats.moves, 1);
+}
+
+int dvbswdemux_shard_move_pid(struct dvbswdemux_shard *sd, int pid, int shard)
+{
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS) || (sd->route[pid] == SWDEMUX_SHARD_NONE))
+		return -1;
+	if ((shard < 0) || (shard >= sd->shard_count))
+		return -1;
+
+	if (sd->route[pid] != shard)
+		shard_move(sd, pid, shard);
+	return 0;
+}
+
+/*
+ * While the busiest shard has had over a quarter more than its share, move
+ * the PID of it which best halves the difference to the least busy one.
+ * PIDs with more than that are left alone, since moving them would only
+ * make another shard the busiest. Every move narrows the spread, so a PID
+ * cannot bounce between shards within one round.
+ */
+static void shard_rebalance(struct dvbswdemux_shard *sd)
+{
+	struct swdemux_shard_worker *busiest;
+	struct swdemux_shard_worker *idlest;
+	uint64_t total = 0;
+	uint32_t gap;
+	uint32_t best;
+	int best_pid;
+	int moves;
+	int i;
+
+	for(i = 0; i < sd->shard_count; i++)
+		total += sd->shards[i].load;
+
+	for(moves = 0; moves < SWDEMUX_SHARD_MAX_MOVES; moves++) {
+		busiest = idlest = &sd->shards[0];
+		for(i = 1; i < sd->shard_count; i++) {
+			struct swdemux_shard_worker *w = &sd->shards[i];
+
+			if (w->load > busiest->load)
+				busiest = w;
+			if (w->load < idlest->load)
+				idlest = w;
+		}
+		if (((uint64_t) busiest->load * sd->shard_count * 4) <= (total * 5))
+			break;
+
+		gap = (busiest->load - idlest->load) / 2;
+		best = 0;
+		best_pid = -1;
+		for(i = 0; i < TRANSPORT_MAX_PIDS; i++) {
+			if ((sd->route[i] == busiest->index) &&
+			    (sd->pid_load[i] > best) && (sd->pid_load[i] <= gap)) {
+				best = sd->pid_load[i];
+				best_pid = i;
+			}
+		}
+		if (best_pid == -1)
+			break;
+		shard_move(sd, best_pid, idlest->index);
+	}
+
+	for(i = 0; i < sd->shard_count; i++)
+		sd->shards[i].load = 0;
+	memset(sd->pid_load, 0, sizeof(sd->pid_load));
+	sd->since_rebalance = 0;
+}
+
+static void shard_packet(struct dvbswdemux_shard *sd, uint8_t *pkt)
+{
+	struct swdemux_shard_worker *w;
+	struct swdemux_shard_slot *slot;
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+
+	if (sd->route[pid] == SWDEMUX_SHARD_NONE)
+		return;
+
+	w = &sd->shards[sd->route[pid]];
+	slot = w->open ? &w->slots[w->tail & w->mask] : shard_slot(w);
+	memcpy(slot->packets + (w->open * TRANSPORT_PACKET_LENGTH), pkt, TRANSPORT_PACKET_LENGTH);
+	if (++w->open == SWDEMUX_SHARD_BATCH)
+		shard_publish(w, SWDEMUX_SHARD_PACKETS);
+
+	w->load++;
+	shard_count(&w->routed, 1);
+	sd->pid_load[pid]++;
+	if (sd->rebalance && (sd->shard_count > 1) &&
+	    (++sd->since_rebalance == SWDEMUX_SHARD_REBALANCE))
+		shard_rebalance(sd);
+}
+
+void dvbswdemux_shard_feed(struct dvbswdemux_shard *sd, uint8_t *buf, int len)
+{
+	uint64_t packets = 0;
+	int offset;
+	int copy;
+	int i;
+
+	// finish off the packet left over from last time
+	if (sd->partial_len) {
+		copy = TRANSPORT_PACKET_LENGTH - sd->partial_len;
+		if (copy > len)
+			copy = len;
+		memcpy(sd->partial + sd->partial_len, buf, copy);
+		sd->partial_len += copy;
+		buf += copy;
+		len -= copy;
+
+		if (sd->partial_len == TRANSPORT_PACKET_LENGTH) {
+			sd->partial_len = 0;
+			shard_packet(sd, sd->partial);
+			packets++;
+		}
+	}
+
+	while(len > 0) {
+		if (buf[0] != TRANSPORT_PACKET_SYNC) {
+			if ((offset = transport_packet_find_sync(buf, len)) < 0)
+				break;
+			buf += offset;
+			len -= offset;
+		}
+
+		if (len < TRANSPORT_PACKET_LENGTH) {
+			memcpy(sd->partial, buf, len);
+			sd->partial_len = len;
+			break;
+		}
+
+		shard_packet(sd, buf);
+		packets++;
+		buf += TRANSPORT_PACKET_LENGTH;
+		len -= TRANSPORT_PACKET_LENGTH;
+	}
+
+	// hand over the partly filled batches, rather than keep them to the next feed
+	for(i = 0; i < sd->shard_count; i++) {
+		struct swdemux_shard_worker *w = &sd->shards[i];
+
+		if (w->open)
+			shard_publish(w, SWDEMUX_SHARD_PACKETS);
+	}
+	shard_count(&sd->stats.packets, packets);
+}
+
+int dvbswdemux_shard_read(struct dvbswdemux_shard *sd, int fd)
+{
+	int len;
+
+	if ((len = read(fd, sd->readbuf, SWDEMUX_READ_SIZE)) > 0)
+		dvbswdemux_shard_feed(sd, sd->readbuf, len);
+
+	return len;
+}
+
+void dvbswdemux_shard_flush(struct dvbswdemux_shard *sd)
+{
+	int i;
+
+	for(i = 0; i < sd->shard_count; i++) {
+		if (sd->shards[i].open)
+			shard_publish(&sd->shards[i], SWDEMUX_SHARD_PACKETS);
+	}
+	for(i = 0; i < sd->shard_count; i++)
+		shard_wait_queued(&sd->shards[i], 0);
+}
+
+int dvbswdemux_shard_pid_wanted(struct dvbswdemux_shard *sd, int pid)
+{
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return 0;
+	return sd->filters[pid] != 0;
+}
+
+int dvbswdemux_shard_of(struct dvbswdemux_shard *sd, int pid)
+{
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS) || (sd->route[pid] == SWDEMUX_SHARD_NONE))
+		return -1;
+	return sd->route[pid];
+}
+
+void dvbswdemux_shard_get_stats(struct dvbswdemux_shard *sd, struct dvbswdemux_shard_stats *stats)
+{
+	uint64_t routed = 0;
+	int i;
+
+	for(i = 0; i < sd->shard_count; i++)
+		routed += dvbswdemux_shard_routed(sd, i);
+	stats->packets = __atomic_load_n(&sd->stats.packets, __ATOMIC_RELAXED);
+	stats->routed = routed;
+	stats->moves = __atomic_load_n(&sd->stats.moves, __ATOMIC_RELAXED);
+	stats->waits = __atomic_load_n(&sd->stats.waits, __ATOMIC_RELAXED);
+}
+
+uint64_t dvbswdemux_shard_routed(struct dvbswdemux_shard *sd, int shard)
+{
+	if ((shard < 0) || (shard >= sd->shard_count))
+		return 0;
+	return __atomic_load_n(&sd->shards[shard].routed, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,258 @@
+/*
+ * libdvbswdemux - a software DVB demux library
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBSWDEMUX_SHARD_H
+#define LIBDVBSWDEMUX_SHARD_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libdvbswdemux/dvbswdemux.h>
+
+/**
+ * A demux split across worker threads by PID, for input (several full muxes
+ * from one or more adapters) faster than one thread can demux.
+ *
+ * Each shard is a dvbswdemux of its own, run by a worker thread. The thread
+ * feeding the stream finds the packet boundaries and the PID of each packet
+ * once, and copies the packets into batches for the shard which owns their
+ * PID, through a ring with one producer and one consumer per shard. Packets
+ * of PIDs without a filter are dropped there. Every PID is owned by one
+ * shard at a time, so its packets are demuxed in order, and callbacks for a
+ * PID are never run on two threads at once.
+ *
+ * A PID is given to a shard when its first filter is added. Since
+ * bitrates are far from even (a video PID carries hundreds of times
+ * what a PSI PID does), the shards' loads are compared every so often and a
+ * PID of the busiest moved to the least busy one. Its filters and what
+ * was being reassembled go with it, and the new shard waits until the old
+ * one has demuxed the PID's last packet before taking it on, so nothing
+ * is lost or reordered.
+ *
+ * Filters are added and removed, and data fed in, from one thread at a
+ * time; callbacks run on the shards' threads, and may return nonzero to
+ * stop being called, but cannot add or remove filters.
+ */
+struct dvbswdemux_shard;
+
+/**
+ * A filter on a dvbswdemux_shard.
+ */
+struct dvbswdemux_shard_filter;
+
+/**
+ * Counters for a sharded demux.
+ */
+struct dvbswdemux_shard_stats {
+	uint64_t packets;		/* fed in */
+	uint64_t routed;		/* passed to a shard, the others having no filter */
+	uint64_t moves;			/* PIDs moved from one shard to another */
+	uint64_t waits;			/* times feeding waited for room in a shard's queue */
+};
+
+/**
+ * Create a sharded demux and start its workers.
+ *
+ * @param shards Number of shards, or 0 for one per online CPU.
+ * @param queue_len Batches of packets each shard may have queued before
+ * feeding waits, rounded up to a power of 2, or 0 for a default of 64.
+ * @param rebalance If 1, PIDs are moved between shards to even out their
+ * loads; if 0 a PID stays on the shard it was given to.
+ * @return The demux, or NULL on failure.
+ */
+extern struct dvbswdemux_shard *dvbswdemux_shard_create(int shards, int queue_len, int rebalance);
+
+/**
+ * Demux everything still queued, then stop the workers and destroy the
+ * demux and all its filters.
+ *
+ * @param sd The demux.
+ */
+extern void dvbswdemux_shard_destroy(struct dvbswdemux_shard *sd);
+
+/**
+ * @param sd The demux.
+ * @return The number of shards.
+ */
+extern int dvbswdemux_shard_count(struct dvbswdemux_shard *sd);
+
+/**
+ * Find out which shard the calling thread is, so that a callback can keep
+ * per shard state without locking.
+ *
+ * @return The shard, 0 to the number of shards - 1, or -1 if not called on
+ * a shard's thread.
+ */
+extern int dvbswdemux_shard_self(void);
+
+/**
+ * Add a filter for the transport packets of a PID. There is no wildcard
+ * for all PIDs: that would need every packet on every shard.
+ *
+ * The filter is set up on the shard's thread, so the callback is called for
+ * packets fed after this returns.
+ *
+ * @param sd The demux.
+ * @param pid PID to retrieve.
+ * @param callback Called for each packet, on the shard's thread.
+ * @param private_data Private data for the callback.
+ * @return The filter, or NULL on failure.
+ */
+extern struct dvbswdemux_shard_filter *dvbswdemux_shard_add_pid_filter(struct dvbswdemux_shard *sd,
+								       int pid,
+								       dvbswdemux_ts_callback callback,
+								       void *private_data);
+
+/**
+ * Add a filter for SI table sections, matching them as
+ * dvbswdemux_add_section_filter() does.
+ *
+ * @param sd The demux.
+ * @param pid PID of the stream.
+ * @param filter The filter values of the first 18 bytes of the desired sections.
+ * @param mask Bitmask indicating which bits in the filter array should be tested.
+ * @param checkcrc If 1, sections with the syntax indicator set and a bad CRC
+ * are dropped.
+ * @param callback Called for each matching section, on the shard's thread.
+ * @param private_data Private data for the callback.
+ * @return The filter, or NULL on failure.
+ */
+extern struct dvbswdemux_shard_filter *dvbswdemux_shard_add_section_filter(struct dvbswdemux_shard *sd,
+									   int pid,
+									   uint8_t filter[18],
+									   uint8_t mask[18],
+									   int checkcrc,
+									   dvbswdemux_data_callback callback,
+									   void *private_data);
+
+/**
+ * Add a filter for the PES packets of a PID, as dvbswdemux_add_pes_filter()
+ * does.
+ *
+ * @param sd The demux.
+ * @param pid PID of the stream.
+ * @param callback Called for each complete PES packet, on the shard's thread.
+ * @param private_data Private data for the callback.
+ * @return The filter, or NULL on failure.
+ */
+extern struct dvbswdemux_shard_filter *dvbswdemux_shard_add_pes_filter(struct dvbswdemux_shard *sd,
+								       int pid,
+								       dvbswdemux_data_callback callback,
+								       void *private_data);
+
+/**
+ * Remove a filter, including one whose callback returned nonzero. Its
+ * callback will not be called for packets fed after this, but may still be
+ * running for earlier ones when it returns: use dvbswdemux_shard_flush()
+ * before freeing what it uses.
+ *
+ * @param sd The demux.
+ * @param filter The filter.
+ */
+extern void dvbswdemux_shard_remove_filter(struct dvbswdemux_shard *sd,
+					   struct dvbswdemux_shard_filter *filter);
+
+/**
+ * Feed transport stream data into the demux. As with dvbswdemux_feed(), the
+ * data need not start or end on a packet boundary. The packets are queued
+ * for the shards, waiting for room if one's queue is full, and demuxed
+ * after this returns.
+ *
+ * @param sd The demux.
+ * @param buf The data.
+ * @param len Its length in bytes.
+ */
+extern void dvbswdemux_shard_feed(struct dvbswdemux_shard *sd, uint8_t *buf, int len);
+
+/**
+ * Read one chunk of transport stream data from a file descriptor with a
+ * single read() call and feed it into the demux.
+ *
+ * @param sd The demux.
+ * @param fd The file descriptor.
+ * @return Number of bytes read, 0 at end of file, or -1 on error (errno is
+ * set, as for dvbswdemux_read()).
+ */
+extern int dvbswdemux_shard_read(struct dvbswdemux_shard *sd, int fd);
+
+/**
+ * Wait until everything fed so far has been demuxed.
+ *
+ * @param sd The demux.
+ */
+extern void dvbswdemux_shard_flush(struct dvbswdemux_shard *sd);
+
+/**
+ * Find out whether the packets of a PID would be used by any filter.
+ *
+ * @param sd The demux.
+ * @param pid The PID.
+ * @return 1 if a filter takes the PID, 0 if not.
+ */
+extern int dvbswdemux_shard_pid_wanted(struct dvbswdemux_shard *sd, int pid);
+
+/**
+ * Find the shard which owns a PID.
+ *
+ * @param sd The demux.
+ * @param pid The PID.
+ * @return The shard, or -1 if the PID has no filters.
+ */
+extern int dvbswdemux_shard_of(struct dvbswdemux_shard *sd, int pid);
+
+/**
+ * Move a PID with filters to another shard, as rebalancing does. This is
+ * mostly for pinning a PID known to be busy, with rebalancing off.
+ *
+ * @param sd The demux.
+ * @param pid The PID.
+ * @param shard The shard to move it to.
+ * @return 0 on success, or -1 if the PID has no filters or the shard is
+ * invalid.
+ */
+extern int dvbswdemux_shard_move_pid(struct dvbswdemux_shard *sd, int pid, int shard);
+
+/**
+ * Retrieve the counters for a sharded demux. They are kept by the
+ * feeding thread, so from any other thread they may be a little behind.
+ *
+ * @param sd The demux.
+ * @param stats Where to put them.
+ */
+extern void dvbswdemux_shard_get_stats(struct dvbswdemux_shard *sd,
+				       struct dvbswdemux_shard_stats *stats);
+
+/**
+ * Retrieve the number of packets passed to one shard.
+ *
+ * @param sd The demux.
+ * @param shard The shard.
+ * @return The packets.
+ */
+extern uint64_t dvbswdemux_shard_routed(struct dvbswdemux_shard *sd, int shard);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
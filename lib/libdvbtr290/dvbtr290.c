@@ -0,0 +1,657 @@
+/*
+ * libdvbtr290 - ETSI TR 101 290 transport stream analyzer
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <libucsi/section_buf.h>
+#include <libucsi/section_view.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/mpeg/pat_section.h>
+#include <libucsi/mpeg/pmt_section.h>
+
+#include "dvbtr290.h"
+
+#define TR290_MAX_SECTION_BYTES 4096
+
+/* all times are in 27MHz PCR ticks */
+#define TR290_TICKS_PER_MS 27000ULL
+#define TR290_PCR_WRAP (300ULL << 33)
+#define TR290_TABLE_INTERVAL (500 * TR290_TICKS_PER_MS)
+#define TR290_PCR_INTERVAL (40 * TR290_TICKS_PER_MS)
+#define TR290_PCR_MAX_JUMP (100 * TR290_TICKS_PER_MS)
+#define TR290_PCR_ACCURACY 13.5			/* 500ns */
+#define TR290_PID_INTERVAL (5000 * TR290_TICKS_PER_MS)
+#define TR290_RATE_REBASE (30000 * TR290_TICKS_PER_MS)
+
+/* the stream is in sync after 5 good sync bytes, and lost after 2 bad ones */
+#define TR290_SYNC_GOOD 5
+#define TR290_SYNC_BAD 2
+
+#define TR290_TABLE_ID_PAT 0x00
+#define TR290_TABLE_ID_CAT 0x01
+#define TR290_TABLE_ID_PMT 0x02
+#define TR290_TABLE_ID_TOT 0x73			/* has a CRC without the syntax indicator */
+
+enum tr290_pid_flags {
+	TR290_PID_PMT		= 0x01,		/* listed in the PAT */
+	TR290_PID_ES		= 0x02,		/* listed in a PMT */
+	TR290_PID_PCR		= 0x04,		/* a PCR PID of a PMT */
+	TR290_PID_PCR_VALID	= 0x08,		/* pcr/pcr_pos hold the last PCR */
+};
+
+#define TR290_PID_WATCHED (TR290_PID_PMT | TR290_PID_ES | TR290_PID_PCR)
+
+struct tr290_pid {
+	uint64_t last_pos;			/* last packet on the PID */
+	uint64_t table_pos;			/* last PAT/PMT, for the interval check */
+	uint64_t pcr_check_pos;			/* last PCR, for the interval check */
+	uint64_t pcr_pos;			/* last PCR, for the accuracy check */
+	uint64_t pcr;
+	struct section_buf *section;
+	uint16_t ref_pmt;			/* PMT PID which listed it */
+	uint8_t flags;
+	uint8_t cstate;
+	uint8_t version;			/* of the PAT/PMT; 0xff => none yet */
+};
+
+struct dvbtr290 {
+	struct tr290_pid pids[TRANSPORT_MAX_PIDS];
+	struct dvbtr290_counters counters;
+
+	/* PIDs with interval checks, rebuilt when the tables change */
+	uint16_t watched[TRANSPORT_MAX_PIDS];
+	int watched_count;
+	int watched_dirty;
+
+	uint64_t pos;				/* packets so far, including lost ones */
+	int lost_bytes;
+
+	int sync;
+	int good_syncs;
+	int bad_syncs;
+
+	/* the transport rate, and the PCRs it is measured between */
+	uint64_t fixed_bitrate;
+	double ticks_per_packet;		/* 0 => not known yet */
+	int rate_pid;
+	int rate_anchors;
+	uint64_t ref_pcr;
+	uint64_t ref_pos;
+	uint64_t mid_pcr;
+	uint64_t mid_pos;
+
+	/* the intervals converted to packets, 0 until the rate is known */
+	uint64_t table_limit;
+	uint64_t pcr_limit;
+	uint64_t pid_limit;
+
+	int scrambled;
+	int cat_seen;
+	uint64_t cat_pos;
+
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int partial_len;
+
+	struct transport_packet_batch batch;
+};
+
+static const char *error_names[DVBTR290_ERROR_COUNT] = {
+	"ts_sync_loss",
+	"sync_byte_error",
+	"pat_error",
+	"continuity_count_error",
+	"pmt_error",
+	"pid_error",
+	"transport_error",
+	"crc_error",
+	"pcr_repetition_error",
+	"pcr_discontinuity_indicator_error",
+	"pcr_accuracy_error",
+	"cat_error",
+};
+
+static void tr290_add_section(struct tr290_pid *p)
+{
+	if (p->section)
+		return;
+
+	// not fatal: the tables on this PID just go unchecked
+	p->section = malloc(sizeof(struct section_buf) + TR290_MAX_SECTION_BYTES);
+	if (p->section)
+		section_buf_init(p->section, TR290_MAX_SECTION_BYTES);
+}
+
+struct dvbtr290 *dvbtr290_create(void)
+{
+	struct dvbtr290 *tr;
+	int i;
+
+	if ((tr = calloc(1, sizeof(struct dvbtr290))) == NULL)
+		return NULL;
+
+	for(i = 0; i < TRANSPORT_MAX_PIDS; i++)
+		tr->pids[i].version = 0xff;
+	tr->rate_pid = -1;
+
+	// PAT, CAT, and the DVB SI tables with CRCs
+	tr290_add_section(&tr->pids[0x00]);
+	tr290_add_section(&tr->pids[0x01]);
+	for(i = 0x10; i <= 0x14; i++)
+		tr290_add_section(&tr->pids[i]);
+
+	return tr;
+}
+
+void dvbtr290_destroy(struct dvbtr290 *tr)
+{
+	int i;
+
+	for(i = 0; i < TRANSPORT_MAX_PIDS; i++)
+		free(tr->pids[i].section);
+	free(tr);
+}
+
+static void tr290_set_rate(struct dvbtr290 *tr, double ticks_per_packet)
+{
+	tr->ticks_per_packet = ticks_per_packet;
+	if (ticks_per_packet <= 0) {
+		tr->table_limit = 0;
+		tr->pcr_limit = 0;
+		tr->pid_limit = 0;
+		tr->counters.bitrate = 0;
+		return;
+	}
+
+	tr->table_limit = TR290_TABLE_INTERVAL / ticks_per_packet;
+	tr->pcr_limit = TR290_PCR_INTERVAL / ticks_per_packet;
+	tr->pid_limit = TR290_PID_INTERVAL / ticks_per_packet;
+	tr->counters.bitrate = (TRANSPORT_PACKET_LENGTH * 8 * 27000000.0) / ticks_per_packet;
+}
+
+void dvbtr290_set_bitrate(struct dvbtr290 *tr, uint64_t bitrate)
+{
+	tr->fixed_bitrate = bitrate;
+	tr->rate_anchors = 0;
+	if (bitrate)
+		tr290_set_rate(tr, (TRANSPORT_PACKET_LENGTH * 8 * 27000000.0) / bitrate);
+	else
+		tr290_set_rate(tr, 0);
+}
+
+static void tr290_watch(struct dvbtr290 *tr, int pid, uint8_t flag, uint16_t ref_pmt)
+{
+	struct tr290_pid *p = &tr->pids[pid];
+
+	if (pid == TRANSPORT_NULL_PID)
+		return;
+
+	if (flag != TR290_PID_PMT)
+		p->ref_pmt = ref_pmt;
+	if (p->flags & flag)
+		return;
+
+	// the timers start when the PID is first listed
+	if (!(p->flags & TR290_PID_WATCHED)) {
+		p->last_pos = tr->pos;
+		p->table_pos = tr->pos;
+		p->pcr_check_pos = tr->pos;
+	}
+	p->flags |= flag;
+	tr->watched_dirty = 1;
+}
+
+static void tr290_unwatch_pmt(struct dvbtr290 *tr, int pmt_pid)
+{
+	int i;
+
+	for(i = 0; i < TRANSPORT_MAX_PIDS; i++) {
+		struct tr290_pid *p = &tr->pids[i];
+
+		if ((p->flags & (TR290_PID_ES | TR290_PID_PCR)) && (p->ref_pmt == pmt_pid))
+			p->flags &= ~(TR290_PID_ES | TR290_PID_PCR);
+	}
+	tr->watched_dirty = 1;
+}
+
+static void tr290_pat(struct dvbtr290 *tr, struct section_view *view)
+{
+	const uint8_t *program;
+	int i;
+
+	if (mpeg_pat_section_view_validate(view) ||
+	    !section_view_current_next_indicator(view))
+		return;
+
+	// a new version replaces the programs of the old one
+	if (section_view_version_number(view) != tr->pids[0].version) {
+		for(i = 0; i < TRANSPORT_MAX_PIDS; i++) {
+			if (tr->pids[i].flags & TR290_PID_PMT) {
+				tr->pids[i].flags &= ~TR290_PID_PMT;
+				tr->pids[i].version = 0xff;
+				tr290_unwatch_pmt(tr, i);
+			}
+		}
+		tr->pids[0].version = section_view_version_number(view);
+	}
+
+	mpeg_pat_view_programs_for_each(view, program) {
+		int pid = mpeg_pat_view_program_pid(program);
+
+		// program 0 is the NIT
+		if (mpeg_pat_view_program_number(program) == 0)
+			continue;
+
+		tr290_add_section(&tr->pids[pid]);
+		tr290_watch(tr, pid, TR290_PID_PMT, 0);
+	}
+}
+
+static void tr290_pmt(struct dvbtr290 *tr, int pid, struct section_view *view)
+{
+	struct tr290_pid *p = &tr->pids[pid];
+	const uint8_t *stream;
+
+	if (mpeg_pmt_section_view_validate(view) ||
+	    !section_view_current_next_indicator(view))
+		return;
+
+	if (section_view_version_number(view) != p->version) {
+		tr290_unwatch_pmt(tr, pid);
+		p->version = section_view_version_number(view);
+	}
+
+	// PIDs shared between programs are claimed by the last PMT seen
+	tr290_watch(tr, mpeg_pmt_view_pcr_pid(view), TR290_PID_PCR, pid);
+	mpeg_pmt_view_streams_for_each(view, stream)
+		tr290_watch(tr, mpeg_pmt_view_stream_pid(stream), TR290_PID_ES, pid);
+}
+
+/*
+ * Count the intervals which have run out since *last. As *last only moves on
+ * by whole intervals, a long gap counts the same however often it is checked.
+ */
+static int tr290_overdue(uint64_t *last, uint64_t pos, uint64_t limit)
+{
+	int count = 0;
+
+	if (limit == 0)
+		return 0;
+
+	while((pos - *last) > limit) {
+		*last += limit;
+		count++;
+	}
+	return count;
+}
+
+static void tr290_table_interval(struct dvbtr290 *tr, struct tr290_pid *p,
+				 enum dvbtr290_error error, uint64_t pos)
+{
+	tr->counters.errors[error] += tr290_overdue(&p->table_pos, pos, tr->table_limit);
+	p->table_pos = pos;
+}
+
+static void tr290_section(struct dvbtr290 *tr, int pid, uint8_t *data, int len, uint64_t pos)
+{
+	struct tr290_pid *p = &tr->pids[pid];
+	struct section_view view;
+	int table_id;
+
+	if (section_view_init(&view, data, len))
+		return;
+	table_id = section_view_table_id(&view);
+
+	if ((section_view_syntax_indicator(&view) || (table_id == TR290_TABLE_ID_TOT)) &&
+	    section_view_check_crc(&view)) {
+		tr->counters.errors[DVBTR290_CRC_ERROR]++;
+		return;
+	}
+
+	switch(pid) {
+	case 0x00:
+		if (table_id != TR290_TABLE_ID_PAT) {
+			tr->counters.errors[DVBTR290_PAT_ERROR]++;
+			return;
+		}
+		tr290_table_interval(tr, p, DVBTR290_PAT_ERROR, pos);
+		tr290_pat(tr, &view);
+		break;
+
+	case 0x01:
+		if (table_id != TR290_TABLE_ID_CAT) {
+			tr->counters.errors[DVBTR290_CAT_ERROR]++;
+			return;
+		}
+		tr->cat_seen = 1;
+		break;
+
+	default:
+		if (!(p->flags & TR290_PID_PMT) || (table_id != TR290_TABLE_ID_PMT))
+			return;
+		tr290_table_interval(tr, p, DVBTR290_PMT_ERROR, pos);
+		tr290_pmt(tr, pid, &view);
+		break;
+	}
+}
+
+static void tr290_section_payload(struct dvbtr290 *tr, int pid, uint8_t *payload, int len,
+				  int pdu_start, uint64_t pos)
+{
+	struct section_buf *section = tr->pids[pid].section;
+	int section_status;
+	int used;
+
+	while(len) {
+		used = section_buf_add_transport_payload(section, payload, len,
+							 pdu_start, &section_status);
+		pdu_start = 0;
+		len -= used;
+		payload += used;
+
+		if (section_status == 1) {
+			tr290_section(tr, pid, section_buf_data(section), section->len, pos);
+			section_buf_reset(section);
+		} else if (section_status < 0) {
+			section_buf_reset(section);
+		}
+	}
+}
+
+static void tr290_rate(struct dvbtr290 *tr, uint64_t pcr, uint64_t pos)
+{
+	uint64_t ticks;
+
+	if (tr->rate_anchors == 0) {
+		tr->ref_pcr = tr->mid_pcr = pcr;
+		tr->ref_pos = tr->mid_pos = pos;
+		tr->rate_anchors = 1;
+		return;
+	}
+
+	if (pos != tr->ref_pos) {
+		ticks = (pcr + TR290_PCR_WRAP - tr->ref_pcr) % TR290_PCR_WRAP;
+		tr290_set_rate(tr, (double) ticks / (pos - tr->ref_pos));
+	}
+
+	// measure over 30 to 60 seconds once there is that much, to follow drift
+	ticks = (pcr + TR290_PCR_WRAP - tr->mid_pcr) % TR290_PCR_WRAP;
+	if (ticks >= TR290_RATE_REBASE) {
+		tr->ref_pcr = tr->mid_pcr;
+		tr->ref_pos = tr->mid_pos;
+		tr->mid_pcr = pcr;
+		tr->mid_pos = pos;
+	}
+}
+
+static void tr290_pcr(struct dvbtr290 *tr, int pid, uint8_t *pkt, int discontinuity, uint64_t pos)
+{
+	struct tr290_pid *p = &tr->pids[pid];
+	struct transport_values values;
+	uint64_t ticks;
+	double error;
+
+	if (transport_packet_values_extract((struct transport_packet *) pkt, &values,
+					    transport_value_pcr) <= 0)
+		return;
+
+	if (tr->rate_pid < 0)
+		tr->rate_pid = pid;
+
+	if (p->flags & TR290_PID_PCR) {
+		tr->counters.errors[DVBTR290_PCR_REPETITION_ERROR] +=
+			tr290_overdue(&p->pcr_check_pos, pos, tr->pcr_limit);
+		p->pcr_check_pos = pos;
+	}
+
+	if (discontinuity) {
+		p->flags &= ~TR290_PID_PCR_VALID;
+	} else if (p->flags & TR290_PID_PCR_VALID) {
+		// a step backwards shows up as a huge step forwards
+		ticks = (values.pcr + TR290_PCR_WRAP - p->pcr) % TR290_PCR_WRAP;
+		if (ticks > TR290_PCR_MAX_JUMP) {
+			tr->counters.errors[DVBTR290_PCR_DISCONTINUITY_ERROR]++;
+			p->flags &= ~TR290_PID_PCR_VALID;
+		} else if (tr->ticks_per_packet > 0) {
+			error = ticks - ((pos - p->pcr_pos) * tr->ticks_per_packet);
+			if ((error > TR290_PCR_ACCURACY) || (error < -TR290_PCR_ACCURACY))
+				tr->counters.errors[DVBTR290_PCR_ACCURACY_ERROR]++;
+		}
+	}
+
+	if ((pid == tr->rate_pid) && !tr->fixed_bitrate) {
+		if (!(p->flags & TR290_PID_PCR_VALID))
+			tr->rate_anchors = 0;
+		tr290_rate(tr, values.pcr, pos);
+	}
+
+	p->pcr = values.pcr;
+	p->pcr_pos = pos;
+	p->flags |= TR290_PID_PCR_VALID;
+}
+
+static void tr290_packet(struct dvbtr290 *tr, uint8_t *pkt,
+			 struct transport_packet_batch *batch, int idx)
+{
+	int pid = batch->pid[idx];
+	struct tr290_pid *p = &tr->pids[pid];
+	uint64_t pos = tr->pos++;
+	unsigned char cstate;
+	int discontinuity;
+	int offset;
+
+	// nothing in the header can be trusted
+	if (batch->transport_error[idx]) {
+		tr->counters.errors[DVBTR290_TRANSPORT_ERROR]++;
+		return;
+	}
+
+	p->last_pos = pos;
+	if (pid == TRANSPORT_NULL_PID)
+		return;
+
+	discontinuity = batch->adaptation_flags[idx] & transport_adaptation_flag_discontinuity;
+	cstate = p->cstate;
+	if (transport_packet_continuity_check((struct transport_packet *) pkt,
+					      discontinuity, &p->cstate)) {
+		tr->counters.errors[DVBTR290_CONTINUITY_COUNT_ERROR]++;
+		if (p->section)
+			section_buf_reset(p->section);
+		p->cstate = 0;
+		transport_packet_continuity_check((struct transport_packet *) pkt,
+						  discontinuity, &p->cstate);
+	} else if ((cstate & 0x80) && !discontinuity && (batch->adaptation[idx] & 1) &&
+		   ((cstate & 0x0f) == batch->continuity_counter[idx])) {
+		// a duplicate packet
+		return;
+	}
+
+	// the adaptation field is never scrambled
+	if (batch->adaptation_flags[idx] & transport_adaptation_flag_pcr)
+		tr290_pcr(tr, pid, pkt, discontinuity, pos);
+
+	if (batch->scrambling[idx]) {
+		if (pid == 0x00)
+			tr->counters.errors[DVBTR290_PAT_ERROR]++;
+		else if (p->flags & TR290_PID_PMT)
+			tr->counters.errors[DVBTR290_PMT_ERROR]++;
+		tr->scrambled = 1;
+		return;
+	}
+
+	if (p->section && ((offset = batch->payload_offset[idx]) != 0))
+		tr290_section_payload(tr, pid, pkt + offset, TRANSPORT_PACKET_LENGTH - offset,
+				      batch->payload_unit_start[idx], pos);
+}
+
+static void tr290_rebuild_watched(struct dvbtr290 *tr)
+{
+	int i;
+
+	tr->watched_count = 0;
+	for(i = 0; i < TRANSPORT_MAX_PIDS; i++) {
+		if (tr->pids[i].flags & TR290_PID_WATCHED)
+			tr->watched[tr->watched_count++] = i;
+	}
+	tr->watched_dirty = 0;
+}
+
+/*
+ * Count the tables and PIDs which have been missing too long. Each one counts
+ * again after every further interval it stays missing.
+ */
+static void tr290_sweep(struct dvbtr290 *tr)
+{
+	uint64_t *errors = tr->counters.errors;
+	uint64_t pos = tr->pos;
+	int i;
+
+	if (tr->watched_dirty)
+		tr290_rebuild_watched(tr);
+
+	errors[DVBTR290_PAT_ERROR] += tr290_overdue(&tr->pids[0].table_pos, pos, tr->table_limit);
+
+	for(i = 0; i < tr->watched_count; i++) {
+		struct tr290_pid *p = &tr->pids[tr->watched[i]];
+
+		if (p->flags & TR290_PID_PMT)
+			errors[DVBTR290_PMT_ERROR] += tr290_overdue(&p->table_pos, pos, tr->table_limit);
+		if (p->flags & TR290_PID_PCR)
+			errors[DVBTR290_PCR_REPETITION_ERROR] +=
+				tr290_overdue(&p->pcr_check_pos, pos, tr->pcr_limit);
+		if (p->flags & (TR290_PID_ES | TR290_PID_PCR))
+			errors[DVBTR290_PID_ERROR] += tr290_overdue(&p->last_pos, pos, tr->pid_limit);
+	}
+
+	// scrambled packets with no CAT count once per table interval
+	if (tr->scrambled && !tr->cat_seen)
+		errors[DVBTR290_CAT_ERROR] += tr290_overdue(&tr->cat_pos, pos, tr->table_limit);
+	tr->scrambled = 0;
+}
+
+static void tr290_lost(struct dvbtr290 *tr, int len)
+{
+	// the time the lost data took still passes
+	tr->lost_bytes += len;
+	tr->pos += tr->lost_bytes / TRANSPORT_PACKET_LENGTH;
+	tr->lost_bytes %= TRANSPORT_PACKET_LENGTH;
+}
+
+/*
+ * Process packets at the start of a buffer of at least one packet, returning
+ * the number of bytes used.
+ */
+static int tr290_packets(struct dvbtr290 *tr, uint8_t *buf, int len)
+{
+	struct transport_packet_batch *batch = &tr->batch;
+	int offset;
+	int used;
+	int i;
+
+	if (buf[0] != TRANSPORT_PACKET_SYNC) {
+		if (tr->sync) {
+			tr->counters.errors[DVBTR290_SYNC_BYTE_ERROR]++;
+			if (++tr->bad_syncs < TR290_SYNC_BAD) {
+				// keep going on the assumption it is one corrupt packet
+				tr->pos++;
+				tr->counters.packets++;
+				return TRANSPORT_PACKET_LENGTH;
+			}
+			tr->counters.errors[DVBTR290_TS_SYNC_LOSS]++;
+			tr->sync = 0;
+			tr->good_syncs = 0;
+		}
+
+		if ((offset = transport_packet_find_sync(buf, len)) < 0)
+			offset = len;
+		tr290_lost(tr, offset);
+		return offset;
+	}
+
+	used = transport_packet_batch_extract(buf, len, batch);
+	for(i = 0; i < batch->count; i++)
+		tr290_packet(tr, buf + (i * TRANSPORT_PACKET_LENGTH), batch, i);
+	tr->counters.packets += batch->count;
+
+	tr->bad_syncs = 0;
+	if (!tr->sync) {
+		tr->good_syncs += batch->count;
+		if (tr->good_syncs >= TR290_SYNC_GOOD)
+			tr->sync = 1;
+	}
+
+	tr290_sweep(tr);
+	return used;
+}
+
+void dvbtr290_feed(struct dvbtr290 *tr, uint8_t *buf, int len)
+{
+	int offset;
+	int copy;
+
+	// finish off the packet left over from last time
+	if (tr->partial_len) {
+		copy = TRANSPORT_PACKET_LENGTH - tr->partial_len;
+		if (copy > len)
+			copy = len;
+		memcpy(tr->partial + tr->partial_len, buf, copy);
+		tr->partial_len += copy;
+		buf += copy;
+		len -= copy;
+
+		if (tr->partial_len == TRANSPORT_PACKET_LENGTH) {
+			tr->partial_len = 0;
+			offset = tr290_packets(tr, tr->partial, TRANSPORT_PACKET_LENGTH);
+			if (offset < TRANSPORT_PACKET_LENGTH)
+				tr290_lost(tr, TRANSPORT_PACKET_LENGTH - offset);
+		}
+	}
+
+	while(len >= TRANSPORT_PACKET_LENGTH) {
+		offset = tr290_packets(tr, buf, len);
+		buf += offset;
+		len -= offset;
+	}
+
+	// keep the tail if it could be the start of a packet
+	if (len > 0) {
+		if (!tr->sync && (buf[0] != TRANSPORT_PACKET_SYNC)) {
+			if ((offset = transport_packet_find_sync(buf, len)) < 0)
+				offset = len;
+			tr290_lost(tr, offset);
+			buf += offset;
+			len -= offset;
+		}
+		memcpy(tr->partial, buf, len);
+		tr->partial_len = len;
+	}
+}
+
+void dvbtr290_get_counters(struct dvbtr290 *tr, struct dvbtr290_counters *counters)
+{
+	// each counter has one writer and is naturally aligned, so none are torn
+	memcpy(counters, &tr->counters, sizeof(struct dvbtr290_counters));
+}
+
+const char *dvbtr290_error_name(enum dvbtr290_error error)
+{
+	if ((unsigned int) error >= DVBTR290_ERROR_COUNT)
+		return NULL;
+	return error_names[error];
+}
@@ -0,0 +1,133 @@
+/*
+ * libdvbtr290 - ETSI TR 101 290 transport stream analyzer
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBTR290_H
+#define LIBDVBTR290_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * An analyzer checking a full transport stream against the priority 1 and 2
+ * measurements of ETSI TR 101 290.
+ *
+ * Timing is taken from the stream itself rather than from when the data
+ * arrived: the position of each packet is converted to time using the
+ * transport rate, which is measured from the PCRs of the first PCR PID seen
+ * (or set with dvbtr290_set_bitrate()). Until it is known, the checks on
+ * repetition intervals are not made. This means a recording can be analyzed
+ * as fast as it can be read, with the same results as live.
+ *
+ * An analyzer is not thread safe, but its counters may be read from another
+ * thread with dvbtr290_get_counters() while it is being fed.
+ */
+struct dvbtr290;
+
+/**
+ * The error counters, in the order and with the names of TR 101 290.
+ */
+enum dvbtr290_error {
+	/* priority 1 */
+	DVBTR290_TS_SYNC_LOSS,		/* 1.1: two or more bad sync bytes in a row */
+	DVBTR290_SYNC_BYTE_ERROR,	/* 1.2: sync byte not 0x47 */
+	DVBTR290_PAT_ERROR,		/* 1.3: PAT interval > 0.5s, wrong table_id, scrambled */
+	DVBTR290_CONTINUITY_COUNT_ERROR,/* 1.4 */
+	DVBTR290_PMT_ERROR,		/* 1.5: PMT interval > 0.5s, scrambled */
+	DVBTR290_PID_ERROR,		/* 1.6: a PID in a PMT missing for 5s */
+
+	/* priority 2 */
+	DVBTR290_TRANSPORT_ERROR,	/* 2.1: transport_error_indicator set */
+	DVBTR290_CRC_ERROR,		/* 2.2: in a PSI/SI table */
+	DVBTR290_PCR_REPETITION_ERROR,	/* 2.3a: PCR interval > 40ms */
+	DVBTR290_PCR_DISCONTINUITY_ERROR,/* 2.3b: PCR jump > 100ms or backwards */
+	DVBTR290_PCR_ACCURACY_ERROR,	/* 2.4: PCR off by more than 500ns */
+	DVBTR290_CAT_ERROR,		/* 2.6: scrambled packets and no CAT, wrong table_id */
+
+	DVBTR290_ERROR_COUNT,
+};
+
+/**
+ * The counters of an analyzer.
+ */
+struct dvbtr290_counters {
+	uint64_t packets;		/* packets analyzed */
+	uint64_t bitrate;		/* measured transport rate (bits/s), 0 if unknown */
+	uint64_t errors[DVBTR290_ERROR_COUNT];
+};
+
+/**
+ * Create an analyzer.
+ *
+ * @return The analyzer, or NULL on failure.
+ */
+extern struct dvbtr290 *dvbtr290_create(void);
+
+/**
+ * Destroy an analyzer.
+ *
+ * @param tr The analyzer.
+ */
+extern void dvbtr290_destroy(struct dvbtr290 *tr);
+
+/**
+ * Set the transport rate instead of measuring it, e.g. when it is known from
+ * the tuning parameters.
+ *
+ * @param tr The analyzer.
+ * @param bitrate The rate in bits/s, or 0 to go back to measuring it.
+ */
+extern void dvbtr290_set_bitrate(struct dvbtr290 *tr, uint64_t bitrate);
+
+/**
+ * Feed transport stream data into the analyzer. The data need not start or
+ * end on a packet boundary: a partial packet at the end is kept until the
+ * next call.
+ *
+ * @param tr The analyzer.
+ * @param buf The data.
+ * @param len Its length in bytes.
+ */
+extern void dvbtr290_feed(struct dvbtr290 *tr, uint8_t *buf, int len);
+
+/**
+ * Retrieve a snapshot of the counters.
+ *
+ * @param tr The analyzer.
+ * @param counters Where to put them.
+ */
+extern void dvbtr290_get_counters(struct dvbtr290 *tr, struct dvbtr290_counters *counters);
+
+/**
+ * Retrieve the name of an error counter, suitable for exporting it.
+ *
+ * @param error The counter.
+ * @return Its name (e.g. "pat_error"), or NULL if it is out of range.
+ */
+extern const char *dvbtr290_error_name(enum dvbtr290_error error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
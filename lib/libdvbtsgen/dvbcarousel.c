@@ -0,0 +1,542 @@
+/*
+ * libdvbtsgen - PSI/SI carousel
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libucsi/section.h>
+#include <libucsi/transport_packet.h>
+
+#include "dvbcarousel.h"
+
+#define CAROUSEL_PACKET_BITS (TRANSPORT_PACKET_LENGTH * 8)
+
+/* one slot per tick (about a ms); later repetitions wait for their round */
+#define CAROUSEL_WHEEL_SIZE 4096
+#define CAROUSEL_HASH_SIZE 1024
+
+struct carousel_table {
+	uint32_t key;
+	uint16_t pid;
+	uint64_t interval;			/* in packets */
+	uint64_t bitrate;			/* of the latest version */
+	uint64_t gap;				/* DVBCAROUSEL_MIN_GAP, in packets */
+	uint64_t due;				/* packet position of the next repetition */
+	uint64_t last_start;
+	uint64_t ready_at;
+	int started;				/* sent at least once */
+
+	uint8_t *packets;
+	int count;
+	uint8_t *pending;			/* version waiting for the repetition being sent */
+	int pending_count;
+	uint16_t pending_pid;
+
+	int queued;				/* waiting to be sent */
+	int removed;				/* free once it has been sent */
+	struct carousel_table *hash_next;
+	struct carousel_table *slot_next;
+	struct carousel_table **slot_pprev;
+	struct carousel_table *ready_next;
+};
+
+struct dvbcarousel {
+	struct dvbcarousel_stats stats;
+	uint64_t bitrate;
+
+	uint64_t pos;				/* of the next packet */
+	uint64_t tick_packets;			/* packets per tick */
+	uint64_t tick;				/* next tick to expire */
+	uint64_t tick_pos;			/* its first packet */
+
+	struct carousel_table *wheel[CAROUSEL_WHEEL_SIZE];
+	struct carousel_table *hash[CAROUSEL_HASH_SIZE];
+	struct carousel_table *ready_head;
+	struct carousel_table *ready_tail;
+	struct carousel_table *current;		/* being sent */
+	int current_packet;
+
+	uint8_t cc[TRANSPORT_MAX_PIDS];
+	uint8_t null_packet[TRANSPORT_PACKET_LENGTH];
+};
+
+static inline int section_total_length(const uint8_t *sec)
+{
+	return (((sec[1] & 0x0f) << 8) | sec[2]) + sizeof(struct section);
+}
+
+int dvbcarousel_packetize(uint16_t pid, const uint8_t *sections, int len,
+			  uint8_t *packets, int max)
+{
+	uint8_t *pkt;
+	int pos = 0, next = 0;
+	int copy, off;
+	int count = 0;
+
+	/* the sections must exactly fill the data */
+	while (next < len) {
+		if ((len - next) < (int) sizeof(struct section))
+			return -1;
+		next += section_total_length(sections + next);
+	}
+	if (next != len)
+		return -1;
+
+	next = 0;
+	while (pos < len) {
+		if (packets == NULL) {
+			pkt = NULL;
+		} else if (count < max) {
+			pkt = packets + (count * TRANSPORT_PACKET_LENGTH);
+		} else {
+			return -1;
+		}
+		count++;
+		off = 4;
+		copy = TRANSPORT_PACKET_LENGTH - 4;
+
+		if (pkt) {
+			pkt[0] = TRANSPORT_PACKET_SYNC;
+			pkt[1] = pid >> 8;
+			pkt[2] = pid;
+			pkt[3] = 0x10;
+		}
+		if ((next < len) && ((next - pos) < (copy - 1))) {
+			if (pkt) {
+				pkt[1] |= 0x40;
+				pkt[off] = next - pos;
+			}
+			off++;
+			copy--;
+		} else if ((next < len) && ((next - pos) == (copy - 1))) {
+			/* the next section would start in a packet without a
+			 * payload_unit_start_indicator: push it into the next one */
+			if (pkt) {
+				pkt[3] = 0x30;
+				pkt[off] = 0;
+			}
+			off++;
+			copy--;
+		}
+
+		if (copy > (len - pos))
+			copy = len - pos;
+		if (pkt) {
+			memcpy(pkt + off, sections + pos, copy);
+			memset(pkt + off + copy, 0xff, TRANSPORT_PACKET_LENGTH - off - copy);
+		}
+		pos += copy;
+
+		while ((next < len) && (next < pos))
+			next += section_total_length(sections + next);
+	}
+	return count;
+}
+
+static uint64_t ms_to_packets(struct dvbcarousel *c, uint64_t ms)
+{
+	uint64_t packets = (ms * c->bitrate) / (CAROUSEL_PACKET_BITS * 1000ULL);
+
+	return packets ? packets : 1;
+}
+
+static uint64_t table_bitrate(int count, int interval)
+{
+	return ((uint64_t) count * CAROUSEL_PACKET_BITS * 1000 + interval - 1) / interval;
+}
+
+struct dvbcarousel *dvbcarousel_create(uint64_t bitrate)
+{
+	struct dvbcarousel *c;
+
+	if (bitrate == 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((c = calloc(1, sizeof(struct dvbcarousel))) == NULL)
+		return NULL;
+
+	c->bitrate = bitrate;
+	c->tick_packets = ms_to_packets(c, 1);
+
+	c->null_packet[0] = TRANSPORT_PACKET_SYNC;
+	c->null_packet[1] = TRANSPORT_NULL_PID >> 8;
+	c->null_packet[2] = TRANSPORT_NULL_PID & 0xff;
+	c->null_packet[3] = 0x10;
+	memset(c->null_packet + 4, 0xff, TRANSPORT_PACKET_LENGTH - 4);
+	return c;
+}
+
+static void table_free(struct carousel_table *t)
+{
+	free(t->packets);
+	free(t->pending);
+	free(t);
+}
+
+void dvbcarousel_destroy(struct dvbcarousel *c)
+{
+	struct carousel_table *t, *next;
+	int i;
+
+	for(i = 0; i < CAROUSEL_HASH_SIZE; i++) {
+		for(t = c->hash[i]; t; t = next) {
+			next = t->hash_next;
+			table_free(t);
+		}
+	}
+	/* removed tables are out of the hash, but may still be being sent */
+	if (c->current && c->current->removed)
+		table_free(c->current);
+	free(c);
+}
+
+static inline struct carousel_table **hash_slot(struct dvbcarousel *c, uint32_t key)
+{
+	return c->hash + ((key * 2654435761U) >> 22) % CAROUSEL_HASH_SIZE;
+}
+
+static struct carousel_table *find_table(struct dvbcarousel *c, uint32_t key)
+{
+	struct carousel_table *t;
+
+	for(t = *hash_slot(c, key); t; t = t->hash_next) {
+		if (t->key == key)
+			return t;
+	}
+	return NULL;
+}
+
+static void wheel_remove(struct carousel_table *t)
+{
+	if (t->slot_pprev == NULL)
+		return;
+	*t->slot_pprev = t->slot_next;
+	if (t->slot_next)
+		t->slot_next->slot_pprev = t->slot_pprev;
+	t->slot_next = NULL;
+	t->slot_pprev = NULL;
+}
+
+static void wheel_insert(struct dvbcarousel *c, struct carousel_table *t)
+{
+	struct carousel_table **slot;
+	uint64_t tick = t->due / c->tick_packets;
+
+	/* the current tick has been expired already */
+	if (tick < c->tick) {
+		tick = c->tick;
+		t->due = tick * c->tick_packets;
+	}
+	slot = c->wheel + (tick % CAROUSEL_WHEEL_SIZE);
+	t->slot_next = *slot;
+	if (*slot)
+		(*slot)->slot_pprev = &t->slot_next;
+	t->slot_pprev = slot;
+	*slot = t;
+}
+
+static void ready_remove(struct dvbcarousel *c, struct carousel_table *t)
+{
+	struct carousel_table **pos, *prev = NULL;
+
+	if (!t->queued)
+		return;
+	for(pos = &c->ready_head; *pos; prev = *pos, pos = &(*pos)->ready_next) {
+		if (*pos == t) {
+			*pos = t->ready_next;
+			if (c->ready_tail == t)
+				c->ready_tail = prev;
+			break;
+		}
+	}
+	t->ready_next = NULL;
+	t->queued = 0;
+}
+
+/*
+ * Send a new version as soon as the gap since the last repetition allows.
+ */
+static void schedule_soon(struct dvbcarousel *c, struct carousel_table *t)
+{
+	uint64_t due = c->pos;
+
+	if (t->started && ((t->last_start + t->gap) > due))
+		due = t->last_start + t->gap;
+	if (due < t->due) {
+		wheel_remove(t);
+		t->due = due;
+		wheel_insert(c, t);
+	}
+}
+
+int dvbcarousel_set_table(struct dvbcarousel *c, uint32_t key, uint16_t pid,
+			  const uint8_t *sections, int len, int interval)
+{
+	struct carousel_table *t;
+	uint8_t *packets;
+	int count;
+
+	if ((pid >= TRANSPORT_NULL_PID) || (interval <= 0) || (len <= 0)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((count = dvbcarousel_packetize(pid, sections, len, NULL, 0)) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if ((packets = malloc(count * TRANSPORT_PACKET_LENGTH)) == NULL)
+		return -1;
+	dvbcarousel_packetize(pid, sections, len, packets, count);
+
+	if ((t = find_table(c, key)) == NULL) {
+		if ((t = calloc(1, sizeof(struct carousel_table))) == NULL) {
+			free(packets);
+			return -1;
+		}
+		t->key = key;
+		t->pid = pid;
+		t->packets = packets;
+		t->count = count;
+		t->interval = ms_to_packets(c, interval);
+		t->gap = ms_to_packets(c, DVBCAROUSEL_MIN_GAP);
+		/* spread over the interval, so tables added together (and so
+		 * due together ever after) do not all go out in one burst */
+		t->due = c->pos + (((key * 2654435761U) * t->interval) >> 32);
+		t->hash_next = *hash_slot(c, key);
+		*hash_slot(c, key) = t;
+		wheel_insert(c, t);
+		t->bitrate = table_bitrate(count, interval);
+		c->stats.tables++;
+		c->stats.required += t->bitrate;
+		return 0;
+	}
+
+	c->stats.required -= t->bitrate;
+	t->bitrate = table_bitrate(count, interval);
+	c->stats.required += t->bitrate;
+	t->interval = ms_to_packets(c, interval);
+
+	if (t->pending && (t->pending_pid == pid) && (t->pending_count == count) &&
+	    !memcmp(t->pending, packets, count * TRANSPORT_PACKET_LENGTH)) {
+		free(packets);
+	} else if ((t->pid == pid) && !t->pending && (t->count == count) &&
+		   !memcmp(t->packets, packets, count * TRANSPORT_PACKET_LENGTH)) {
+		free(packets);
+	} else if (c->current == t) {
+		/* the repetition being sent is finished with the old version */
+		free(t->pending);
+		t->pending = packets;
+		t->pending_count = count;
+		t->pending_pid = pid;
+		c->stats.versions++;
+		schedule_soon(c, t);
+	} else {
+		free(t->packets);
+		free(t->pending);
+		t->pending = NULL;
+		t->packets = packets;
+		t->count = count;
+		t->pid = pid;
+		c->stats.versions++;
+		schedule_soon(c, t);
+	}
+	return 0;
+}
+
+int dvbcarousel_remove_table(struct dvbcarousel *c, uint32_t key)
+{
+	struct carousel_table **pos, *t;
+
+	for(pos = hash_slot(c, key); *pos; pos = &(*pos)->hash_next) {
+		if ((*pos)->key == key)
+			break;
+	}
+	if ((t = *pos) == NULL) {
+		errno = ENOENT;
+		return -1;
+	}
+	*pos = t->hash_next;
+
+	c->stats.tables--;
+	c->stats.required -= t->bitrate;
+	wheel_remove(t);
+	ready_remove(c, t);
+	if (c->current == t)
+		t->removed = 1;
+	else
+		table_free(t);
+	return 0;
+}
+
+/*
+ * Move the tables due in the next tick to the ready queue, and put them
+ * back on the wheel for their next repetition.
+ */
+static void expire_tick(struct dvbcarousel *c)
+{
+	struct carousel_table **slot = c->wheel + (c->tick % CAROUSEL_WHEEL_SIZE);
+	struct carousel_table *t, *next;
+	struct carousel_table *later = NULL;
+
+	t = *slot;
+	*slot = NULL;
+	for(; t; t = next) {
+		next = t->slot_next;
+		t->slot_next = NULL;
+		t->slot_pprev = NULL;
+
+		if ((t->due / c->tick_packets) > c->tick) {
+			/* a later round: back into the same slot afterwards */
+			t->slot_next = later;
+			later = t;
+			continue;
+		}
+
+		if (t->queued) {
+			c->stats.overruns++;
+		} else {
+			t->queued = 1;
+			t->ready_at = c->pos;
+			if (c->ready_tail)
+				c->ready_tail->ready_next = t;
+			else
+				c->ready_head = t;
+			c->ready_tail = t;
+		}
+
+		/* fixed rate: the next one is due an interval after this one
+		 * was, however long it waits to be sent */
+		t->due += t->interval;
+		if ((t->due / c->tick_packets) <= c->tick)
+			t->due = (c->tick + 1) * c->tick_packets;
+		wheel_insert(c, t);
+	}
+	for(t = later; t; t = next) {
+		next = t->slot_next;
+		wheel_insert(c, t);
+	}
+}
+
+static inline void advance(struct dvbcarousel *c)
+{
+	while (c->tick_pos <= c->pos) {
+		expire_tick(c);
+		c->tick++;
+		c->tick_pos += c->tick_packets;
+	}
+}
+
+static struct carousel_table *next_table(struct dvbcarousel *c)
+{
+	struct carousel_table *t;
+	uint64_t delay;
+
+	if ((t = c->ready_head) == NULL)
+		return NULL;
+	if ((c->ready_head = t->ready_next) == NULL)
+		c->ready_tail = NULL;
+	t->ready_next = NULL;
+	t->queued = 0;
+
+	if (t->pending) {
+		free(t->packets);
+		t->packets = t->pending;
+		t->count = t->pending_count;
+		t->pid = t->pending_pid;
+		t->pending = NULL;
+	}
+	t->started = 1;
+	t->last_start = c->pos;
+
+	delay = ((c->pos - t->ready_at) * CAROUSEL_PACKET_BITS * 1000000ULL) / c->bitrate;
+	if (delay > c->stats.max_delay_us)
+		c->stats.max_delay_us = delay;
+	c->stats.repetitions++;
+
+	c->current = t;
+	c->current_packet = 0;
+	return t;
+}
+
+/*
+ * Send the next packet of a due table, if there is one.
+ */
+static int emit(struct dvbcarousel *c, uint8_t *pkt)
+{
+	struct carousel_table *t;
+
+	advance(c);
+	c->pos++;
+	c->stats.packets++;
+
+	if (((t = c->current) == NULL) && ((t = next_table(c)) == NULL))
+		return 0;
+
+	memcpy(pkt, t->packets + (c->current_packet * TRANSPORT_PACKET_LENGTH),
+	       TRANSPORT_PACKET_LENGTH);
+	pkt[3] = (pkt[3] & 0xf0) | (c->cc[t->pid]++ & 0x0f);
+	c->stats.table_packets++;
+
+	if (++c->current_packet == t->count) {
+		c->current = NULL;
+		if (t->removed)
+			table_free(t);
+	}
+	return 1;
+}
+
+void dvbcarousel_generate(struct dvbcarousel *c, uint8_t *buf, int packets)
+{
+	int i;
+
+	for(i = 0; i < packets; i++, buf += TRANSPORT_PACKET_LENGTH) {
+		if (!emit(c, buf)) {
+			memcpy(buf, c->null_packet, TRANSPORT_PACKET_LENGTH);
+			c->stats.null_packets++;
+		}
+	}
+}
+
+int dvbcarousel_insert(struct dvbcarousel *c, uint8_t *buf, int packets)
+{
+	int replaced = 0;
+	int i;
+
+	for(i = 0; i < packets; i++, buf += TRANSPORT_PACKET_LENGTH) {
+		if ((buf[0] != TRANSPORT_PACKET_SYNC) ||
+		    ((((buf[1] & 0x1f) << 8) | buf[2]) != TRANSPORT_NULL_PID)) {
+			advance(c);
+			c->pos++;
+			c->stats.packets++;
+			continue;
+		}
+		if (emit(c, buf))
+			replaced++;
+		else
+			c->stats.null_packets++;
+	}
+	return replaced;
+}
+
+void dvbcarousel_get_stats(struct dvbcarousel *c, struct dvbcarousel_stats *stats)
+{
+	memcpy(stats, &c->stats, sizeof(struct dvbcarousel_stats));
+}
@@ -0,0 +1,162 @@
+/*
+ * libdvbtsgen - PSI/SI carousel
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBCAROUSEL_H
+#define LIBDVBCAROUSEL_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * A playout carousel of PSI/SI tables: each table is sent again and again
+ * at its own repetition interval, either as a stream of its own (padded
+ * with null packets) or into the null packets of an existing one.
+ *
+ * A table is any run of encoded sections (with their CRCs) for one PID,
+ * usually every section of one table version. It is split into packets
+ * once, when it is set; sending it is then a copy of each packet with its
+ * continuity counter filled in. Setting new sections for a table replaces
+ * the version in the carousel as a whole, between two repetitions, and
+ * sends the new one as soon as DVBCAROUSEL_MIN_GAP allows.
+ *
+ * The repetitions are kept on a timer wheel with one slot per ms of the
+ * stream, so the cost of a table does not depend on how many others there
+ * are. A new table starts at a point of its interval picked from its key,
+ * so tables added together are spread out; tables that do fall due
+ * together are sent one after the other, whole.
+ *
+ * As with dvbtsgen, time is the position of the packet in the stream at
+ * the configured rate, not the wall clock.
+ */
+struct dvbcarousel;
+
+/* the shortest time between two starts of a table, in ms */
+#define DVBCAROUSEL_MIN_GAP 25
+
+/**
+ * What a carousel has done so far.
+ */
+struct dvbcarousel_stats {
+	uint64_t packets;		/* generated, or passed to dvbcarousel_insert() */
+	uint64_t table_packets;
+	uint64_t null_packets;		/* generated or left untouched */
+	uint64_t repetitions;		/* tables sent */
+	uint64_t overruns;		/* repetitions dropped, the last was still waiting */
+	uint64_t versions;		/* new versions of tables */
+	uint64_t max_delay_us;		/* longest wait of a due table */
+	uint64_t required;		/* bits/s of all the tables */
+	int tables;
+};
+
+/**
+ * Create a carousel.
+ *
+ * @param bitrate Rate of the stream in bits/s, which sets the time of each
+ * packet.
+ * @return The carousel, or NULL on failure (errno is EINVAL for a rate of 0).
+ */
+extern struct dvbcarousel *dvbcarousel_create(uint64_t bitrate);
+
+/**
+ * Destroy a carousel.
+ *
+ * @param c The carousel.
+ */
+extern void dvbcarousel_destroy(struct dvbcarousel *c);
+
+/**
+ * Add a table, or set a new version of one. Sections identical to the
+ * current version only update the interval.
+ *
+ * @param c The carousel.
+ * @param key Caller's identifier for the table.
+ * @param pid PID to send it on.
+ * @param sections Consecutive encoded sections.
+ * @param len Their total length.
+ * @param interval Repetition interval in ms.
+ * @return 0 on success, or -1 with errno EINVAL (bad PID, interval or
+ * sections) or ENOMEM.
+ */
+extern int dvbcarousel_set_table(struct dvbcarousel *c, uint32_t key, uint16_t pid,
+				 const uint8_t *sections, int len, int interval);
+
+/**
+ * Remove a table. A repetition being sent is finished first.
+ *
+ * @param c The carousel.
+ * @param key Identifier of the table.
+ * @return 0 on success, or -1 with errno ENOENT.
+ */
+extern int dvbcarousel_remove_table(struct dvbcarousel *c, uint32_t key);
+
+/**
+ * Generate the next packets of the stream: the tables as they fall due,
+ * and null packets in between.
+ *
+ * @param c The carousel.
+ * @param buf Where to put them (packets * TRANSPORT_PACKET_LENGTH bytes).
+ * @param packets The number of packets.
+ */
+extern void dvbcarousel_generate(struct dvbcarousel *c, uint8_t *buf, int packets);
+
+/**
+ * Put the tables into the null packets of a stream at the carousel's rate.
+ * Every packet counts as time; only null packets are replaced.
+ *
+ * @param c The carousel.
+ * @param buf The packets, changed in place.
+ * @param packets The number of packets.
+ * @return The number of packets replaced.
+ */
+extern int dvbcarousel_insert(struct dvbcarousel *c, uint8_t *buf, int packets);
+
+/**
+ * Retrieve the statistics of a carousel.
+ *
+ * @param c The carousel.
+ * @param stats Where to put them.
+ */
+extern void dvbcarousel_get_stats(struct dvbcarousel *c, struct dvbcarousel_stats *stats);
+
+/**
+ * Split consecutive encoded sections into the packets of one PID. Sections
+ * are packed back to back and the last packet is padded with stuffing. The
+ * continuity counters are left 0.
+ *
+ * @param pid The PID.
+ * @param sections The sections.
+ * @param len Their total length.
+ * @param packets Where to put the packets, or NULL just to count them.
+ * @param max Room in packets for that many.
+ * @return The number of packets, or -1 if the sections do not fill exactly
+ * len bytes, or there is not enough room.
+ */
+extern int dvbcarousel_packetize(uint16_t pid, const uint8_t *sections, int len,
+				 uint8_t *packets, int max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
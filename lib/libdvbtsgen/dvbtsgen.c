@@ -0,0 +1,1050 @@
+/*
+ * libdvbtsgen - synthetic DVB transport stream generator
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libucsi/section.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+#include <libucsi/mpeg/descriptor.h>
+#include <libucsi/dvb/descriptor.h>
+#include <libucsi/dvb/types.h>
+
+#include "dvbtsgen.h"
+#include "dvbcarousel.h"
+
+/* times are kept in 27MHz ticks with this many bits of fraction */
+#define TSGEN_FRAC 8
+#define TSGEN_TICKS_PER_MS 27000ULL
+#define TSGEN_PCR_WRAP (300ULL << 33)
+#define TSGEN_PACKET_BITS (TRANSPORT_PACKET_LENGTH * 8)
+
+#define TSGEN_PID_PAT 0x0000
+#define TSGEN_PID_NIT 0x0010
+#define TSGEN_PID_SDT 0x0011
+#define TSGEN_PID_EIT 0x0012
+#define TSGEN_PID_PMT 0x0100
+#define TSGEN_PID_ES 0x1000
+
+/* repetition intervals of the tables, in ms */
+#define TSGEN_PAT_INTERVAL 100
+#define TSGEN_PMT_INTERVAL 100
+#define TSGEN_NIT_INTERVAL 1000
+#define TSGEN_SDT_INTERVAL 1000
+#define TSGEN_EIT_PF_INTERVAL 500
+
+#define TSGEN_FRAME_TICKS (40 * TSGEN_TICKS_PER_MS)	/* 25 frames/s */
+#define TSGEN_PTS_DELAY (500 * TSGEN_TICKS_PER_MS)	/* PTS ahead of the PCR */
+#define TSGEN_AUDIO_BITRATE 192000
+
+#define TSGEN_PSI_MAX_SECTION 1024
+#define TSGEN_EIT_MAX_SECTION 4096
+#define TSGEN_MAX_TABLE_SECTIONS 256
+#define TSGEN_MAX_HEADER 64
+#define TSGEN_NIT_MAX_SERVICES 85		/* in one service_list_descriptor */
+#define TSGEN_EIT_SEGMENT (3 * 60 * 60)
+#define TSGEN_EIT_MAX_SEGMENTS (16 * 32)
+
+enum tsgen_stream_type {
+	TSGEN_STREAM_TABLE,
+	TSGEN_STREAM_VIDEO,
+	TSGEN_STREAM_AUDIO,
+};
+
+struct tsgen_stream {
+	uint64_t due;				/* of the next packet */
+	uint64_t interval;			/* between packets */
+	uint64_t bitrate;
+	uint16_t pid;
+	uint8_t type;
+	uint8_t cc;
+
+	/* tables: the packets of the carousel, sent round and round */
+	uint8_t *packets;
+	int packet_count;
+	int next_packet;
+
+	/* video: in ticks */
+	uint64_t next_frame;
+	uint64_t next_pcr;
+};
+
+/*
+ * Sections are built one after the other into a single buffer, so all the
+ * tables of a PID end up ready to be packetized together.
+ */
+struct tsgen_builder {
+	uint8_t *data;
+	int len;
+	int size;
+
+	/* the table being built */
+	int starts[TSGEN_MAX_TABLE_SECTIONS];
+	int count;
+	int open;				/* a section is being added to */
+	int max_section;
+	uint8_t table_id;
+	uint16_t table_id_ext;
+	uint8_t private_indicator;
+	uint8_t header[TSGEN_MAX_HEADER];	/* the fields after the section_ext */
+	int header_len;
+	int loop_length;			/* offset in header of a 12 bit length, or -1 */
+	int section_number;			/* of the next section opened */
+};
+
+/* a growing array of packets */
+struct tsgen_packets {
+	uint8_t *data;
+	int count;
+	int size;
+};
+
+struct dvbtsgen {
+	struct dvbtsgen_config config;
+	struct dvbtsgen_stats stats;
+
+	struct tsgen_stream *streams;
+	int stream_count;
+	int *heap;				/* stream indices, earliest due first */
+
+	uint64_t required;			/* bits/s of all the streams */
+	uint64_t ticks_per_packet;
+	uint64_t pos;				/* packets generated */
+	uint64_t pcr_interval;
+	uint64_t pcr_jitter;			/* ticks */
+	uint32_t random;
+
+	uint8_t null_packet[TRANSPORT_PACKET_LENGTH];
+};
+
+static const uint8_t es_data[TRANSPORT_PACKET_LENGTH];
+
+static inline void put16(uint8_t *buf, int value)
+{
+	buf[0] = value >> 8;
+	buf[1] = value;
+}
+
+static inline uint32_t tsgen_random(struct dvbtsgen *gen)
+{
+	/* xorshift32: cheap, and the same sequence for the same seed */
+	gen->random ^= gen->random << 13;
+	gen->random ^= gen->random >> 17;
+	gen->random ^= gen->random << 5;
+	return gen->random;
+}
+
+static int builder_grow(struct tsgen_builder *b, int len)
+{
+	uint8_t *data;
+	int size;
+
+	if ((b->len + len) <= b->size)
+		return 0;
+
+	size = b->size ? b->size * 2 : 16384;
+	while (size < (b->len + len))
+		size *= 2;
+	if ((data = realloc(b->data, size)) == NULL)
+		return -1;
+	b->data = data;
+	b->size = size;
+	return 0;
+}
+
+static int builder_section(struct tsgen_builder *b, int section_number)
+{
+	if (b->count == TSGEN_MAX_TABLE_SECTIONS)
+		return -1;
+	if (b->open) {
+		/* space for the CRC */
+		if (builder_grow(b, CRC_SIZE))
+			return -1;
+		memset(b->data + b->len, 0, CRC_SIZE);
+		b->len += CRC_SIZE;
+	}
+	if (builder_grow(b, sizeof(struct section_ext) + b->header_len))
+		return -1;
+
+	b->starts[b->count++] = b->len;
+	memset(b->data + b->len, 0, sizeof(struct section_ext));
+	b->data[b->len + 6] = section_number;
+	memcpy(b->data + b->len + sizeof(struct section_ext), b->header, b->header_len);
+	b->len += sizeof(struct section_ext) + b->header_len;
+	b->section_number = section_number + 1;
+	b->open = 1;
+	return 0;
+}
+
+/*
+ * Add an entry to the loop of the table, starting a new section if it does
+ * not fit into the current one.
+ */
+static int builder_add(struct tsgen_builder *b, uint8_t *item, int len)
+{
+	if ((!b->open) ||
+	    (((b->len - b->starts[b->count - 1]) + len + CRC_SIZE) > b->max_section)) {
+		if (builder_section(b, b->section_number))
+			return -1;
+	}
+	if (builder_grow(b, len))
+		return -1;
+	memcpy(b->data + b->len, item, len);
+	b->len += len;
+	return 0;
+}
+
+/*
+ * Fill in the headers of the sections of the current table and encode them.
+ */
+static int builder_end_table(struct tsgen_builder *b)
+{
+	struct section_ext *ext;
+	uint8_t *sec;
+	int last = 0;
+	int end, loop;
+	int i;
+
+	if (!b->open)
+		return 0;
+	if (builder_grow(b, CRC_SIZE))
+		return -1;
+	memset(b->data + b->len, 0, CRC_SIZE);
+	b->len += CRC_SIZE;
+
+	for(i = 0; i < b->count; i++) {
+		if (b->data[b->starts[i] + 6] > last)
+			last = b->data[b->starts[i] + 6];
+	}
+
+	for(i = 0; i < b->count; i++) {
+		sec = b->data + b->starts[i];
+		end = (i + 1 < b->count) ? b->starts[i + 1] : b->len;
+
+		if (b->loop_length >= 0) {
+			loop = end - CRC_SIZE - (b->starts[i] + sizeof(struct section_ext) + b->header_len);
+			sec[sizeof(struct section_ext) + b->loop_length] = 0xf0 | (loop >> 8);
+			sec[sizeof(struct section_ext) + b->loop_length + 1] = loop;
+		}
+
+		ext = (struct section_ext *) sec;
+		ext->table_id = b->table_id;
+		ext->syntax_indicator = 1;
+		ext->private_indicator = b->private_indicator;
+		ext->reserved = 3;
+		ext->length = end - b->starts[i] - sizeof(struct section);
+		ext->table_id_ext = b->table_id_ext;
+		ext->reserved1 = 3;
+		ext->version_number = 0;
+		ext->current_next_indicator = 1;
+		ext->last_section_number = last;
+
+		section_ext_encode(ext, 1);
+		/* section_ext_encode() leaves the length in host order */
+		bswap16(sec + 1);
+	}
+
+	b->count = 0;
+	b->open = 0;
+	return 0;
+}
+
+static int builder_table(struct tsgen_builder *b, uint8_t table_id, uint16_t table_id_ext,
+			 int private_indicator, int max_section,
+			 uint8_t *header, int header_len, int loop_length)
+{
+	if (builder_end_table(b))
+		return -1;
+
+	b->table_id = table_id;
+	b->table_id_ext = table_id_ext;
+	b->private_indicator = private_indicator;
+	b->max_section = max_section;
+	if (header_len)
+		memcpy(b->header, header, header_len);
+	b->header_len = header_len;
+	b->loop_length = loop_length;
+	b->section_number = 0;
+	return 0;
+}
+
+static void builder_free(struct tsgen_builder *b)
+{
+	free(b->data);
+	memset(b, 0, sizeof(*b));
+}
+
+static int packets_grow(struct tsgen_packets *p, int count)
+{
+	uint8_t *data;
+	int size;
+
+	if ((p->count + count) <= p->size)
+		return 0;
+
+	size = p->size ? p->size * 2 : 64;
+	while (size < (p->count + count))
+		size *= 2;
+	if ((data = realloc(p->data, size * TRANSPORT_PACKET_LENGTH)) == NULL)
+		return -1;
+	p->data = data;
+	p->size = size;
+	return 0;
+}
+
+static inline int section_total_length(uint8_t *sec)
+{
+	return (((sec[1] & 0x0f) << 8) | sec[2]) + sizeof(struct section);
+}
+
+/*
+ * Add the packets of consecutive encoded sections. The continuity counters
+ * are filled in as the packets are sent.
+ */
+static int packetize(struct tsgen_packets *p, uint16_t pid, uint8_t *data, int len)
+{
+	int count;
+
+	if (((count = dvbcarousel_packetize(pid, data, len, NULL, 0)) < 0) ||
+	    packets_grow(p, count))
+		return -1;
+	dvbcarousel_packetize(pid, data, len, p->data + (p->count * TRANSPORT_PACKET_LENGTH), count);
+	p->count += count;
+	return 0;
+}
+
+static uint64_t stream_interval(uint64_t bitrate)
+{
+	return ((uint64_t) TSGEN_PACKET_BITS * 27000000ULL << TSGEN_FRAC) / bitrate;
+}
+
+static struct tsgen_stream *add_stream(struct dvbtsgen *gen, int type, uint16_t pid,
+				       uint64_t bitrate)
+{
+	struct tsgen_stream *s = gen->streams + gen->stream_count++;
+
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+	s->pid = pid;
+	s->bitrate = bitrate;
+	s->interval = stream_interval(bitrate);
+	gen->required += bitrate;
+	return s;
+}
+
+/*
+ * A table PID sends its packets round and round, spread evenly so the whole
+ * carousel takes interval ms.
+ */
+static int add_table_stream(struct dvbtsgen *gen, uint16_t pid, struct tsgen_packets *p,
+			    int interval)
+{
+	struct tsgen_stream *s;
+	uint64_t bitrate;
+
+	if (p->count == 0)
+		return 0;
+	bitrate = ((uint64_t) p->count * TSGEN_PACKET_BITS * 1000 + interval - 1) / interval;
+	s = add_stream(gen, TSGEN_STREAM_TABLE, pid, bitrate);
+	s->interval = ((uint64_t) interval * TSGEN_TICKS_PER_MS << TSGEN_FRAC) / p->count;
+	s->packets = p->data;
+	s->packet_count = p->count;
+	p->data = NULL;
+	p->count = p->size = 0;
+	return 0;
+}
+
+static int add_table(struct dvbtsgen *gen, uint16_t pid, struct tsgen_builder *b, int interval)
+{
+	struct tsgen_packets p;
+	int ret;
+
+	memset(&p, 0, sizeof(p));
+	if (builder_end_table(b) || packetize(&p, pid, b->data, b->len)) {
+		free(p.data);
+		return -1;
+	}
+	ret = add_table_stream(gen, pid, &p, interval);
+	free(p.data);
+	b->len = 0;
+	return ret;
+}
+
+static uint16_t service_id(int n)
+{
+	return n + 1;
+}
+
+static int build_pat(struct dvbtsgen *gen, struct tsgen_builder *b)
+{
+	uint8_t item[4];
+	int i;
+
+	if (builder_table(b, stag_mpeg_program_association, gen->config.transport_stream_id, 0,
+			  TSGEN_PSI_MAX_SECTION, NULL, 0, -1))
+		return -1;
+
+	put16(item, 0);
+	put16(item + 2, 0xe000 | TSGEN_PID_NIT);
+	if (builder_add(b, item, sizeof(item)))
+		return -1;
+	for(i = 0; i < gen->config.services; i++) {
+		put16(item, service_id(i));
+		put16(item + 2, 0xe000 | (TSGEN_PID_PMT + i));
+		if (builder_add(b, item, sizeof(item)))
+			return -1;
+	}
+	return add_table(gen, TSGEN_PID_PAT, b, TSGEN_PAT_INTERVAL);
+}
+
+static int build_pmt(struct dvbtsgen *gen, struct tsgen_builder *b, int n)
+{
+	uint16_t video = TSGEN_PID_ES + (2 * n);
+	uint8_t header[4];
+	uint8_t item[11];
+
+	put16(header, 0xe000 | video);
+	put16(header + 2, 0xf000);
+	if (builder_table(b, stag_mpeg_program_map, service_id(n), 0,
+			  TSGEN_PSI_MAX_SECTION, header, sizeof(header), -1))
+		return -1;
+
+	/* MPEG-2 video */
+	item[0] = 0x02;
+	put16(item + 1, 0xe000 | video);
+	put16(item + 3, 0xf000);
+	if (builder_add(b, item, 5))
+		return -1;
+
+	/* MPEG-1 audio with an ISO_639_language_descriptor */
+	item[0] = 0x03;
+	put16(item + 1, 0xe000 | (video + 1));
+	put16(item + 3, 0xf000 | 6);
+	item[5] = dtag_mpeg_iso_639_language;
+	item[6] = 4;
+	memcpy(item + 7, "eng", 3);
+	item[10] = 0;
+	if (builder_add(b, item, 11))
+		return -1;
+
+	return add_table(gen, TSGEN_PID_PMT + n, b, TSGEN_PMT_INTERVAL);
+}
+
+static void bcd(uint8_t *buf, uint32_t value, int digits)
+{
+	int i;
+
+	memset(buf, 0, (digits + 1) / 2);
+	for(i = digits - 1; i >= 0; i--) {
+		buf[i / 2] |= (value % 10) << ((i & 1) ? 0 : 4);
+		value /= 10;
+	}
+}
+
+static int build_nit(struct dvbtsgen *gen, struct tsgen_builder *b)
+{
+	static const char name[] = "dvbtsgen";
+	uint8_t header[2 + 2 + sizeof(name) + 2];
+	uint8_t item[6 + 2 + (3 * TSGEN_NIT_MAX_SERVICES) + 13];
+	int services = gen->config.services;
+	int namelen = sizeof(name) - 1;
+	int mux, i, len;
+
+	if (services > TSGEN_NIT_MAX_SERVICES)
+		services = TSGEN_NIT_MAX_SERVICES;
+
+	put16(header, 0xf000 | (2 + namelen));
+	header[2] = dtag_dvb_network_name;
+	header[3] = namelen;
+	memcpy(header + 4, name, namelen);
+	put16(header + 4 + namelen, 0xf000);
+	if (builder_table(b, stag_dvb_network_information_actual, gen->config.network_id, 1,
+			  TSGEN_PSI_MAX_SECTION, header, 6 + namelen, 4 + namelen))
+		return -1;
+
+	for(mux = 0; mux < gen->config.mux_count; mux++) {
+		len = 6;
+		put16(item, gen->config.transport_stream_id - gen->config.mux_index + mux);
+		put16(item + 2, gen->config.original_network_id);
+
+		item[len++] = dtag_dvb_service_list;
+		item[len++] = 3 * services;
+		for(i = 0; i < services; i++) {
+			put16(item + len, service_id(i));
+			item[len + 2] = 0x01;		/* digital television */
+			len += 3;
+		}
+
+		/* 256-QAM at 474MHz + 8MHz per mux, 6.9Msym/s */
+		item[len++] = dtag_dvb_cable_delivery_system;
+		item[len++] = 11;
+		bcd(item + len, 4740000 + (80000 * mux), 8);
+		put16(item + len + 4, 0xfff0);
+		item[len + 6] = 0x05;
+		bcd(item + len + 7, 69000, 7);
+		item[len + 10] |= 0x0f;
+		len += 11;
+
+		put16(item + 4, 0xf000 | (len - 6));
+		if (builder_add(b, item, len))
+			return -1;
+	}
+	return add_table(gen, TSGEN_PID_NIT, b, TSGEN_NIT_INTERVAL);
+}
+
+static int build_sdt(struct dvbtsgen *gen, struct tsgen_builder *b)
+{
+	static const char provider[] = "dvbtsgen";
+	uint8_t header[3];
+	uint8_t item[5 + 2 + 3 + sizeof(provider) + 32];
+	char name[32];
+	int i, len, namelen;
+
+	put16(header, gen->config.original_network_id);
+	header[2] = 0xff;
+	if (builder_table(b, stag_dvb_service_description_actual, gen->config.transport_stream_id, 1,
+			  TSGEN_PSI_MAX_SECTION, header, sizeof(header), -1))
+		return -1;
+
+	for(i = 0; i < gen->config.services; i++) {
+		namelen = snprintf(name, sizeof(name), "Service %u.%u",
+				   gen->config.transport_stream_id, service_id(i));
+
+		put16(item, service_id(i));
+		item[2] = 0xfc | (gen->config.eit_events ? 0x02 : 0) | 0x01;
+		len = 5;
+		item[len++] = dtag_dvb_service;
+		item[len++] = 3 + (sizeof(provider) - 1) + namelen;
+		item[len++] = 0x01;
+		item[len++] = sizeof(provider) - 1;
+		memcpy(item + len, provider, sizeof(provider) - 1);
+		len += sizeof(provider) - 1;
+		item[len++] = namelen;
+		memcpy(item + len, name, namelen);
+		len += namelen;
+		/* running, not scrambled */
+		put16(item + 3, 0x8000 | (len - 5));
+
+		if (builder_add(b, item, len))
+			return -1;
+	}
+	return add_table(gen, TSGEN_PID_SDT, b, TSGEN_SDT_INTERVAL);
+}
+
+static int event_item(struct dvbtsgen *gen, uint8_t *item, int n, int event, int running_status)
+{
+	time_t start = gen->config.start_time + ((time_t) event * gen->config.eit_event_length);
+	char name[32];
+	int namelen;
+	int len = 12;
+
+	namelen = snprintf(name, sizeof(name), "Event %u.%u", service_id(n), event + 1);
+
+	put16(item, event + 1);
+	unixtime_to_dvbdate(start, item + 2);
+	seconds_to_dvbduration(gen->config.eit_event_length, item + 7);
+
+	/* short_event_descriptor */
+	item[len++] = dtag_dvb_short_event;
+	item[len++] = 3 + 1 + namelen + 1;
+	memcpy(item + len, "eng", 3);
+	len += 3;
+	item[len++] = namelen;
+	memcpy(item + len, name, namelen);
+	len += namelen;
+	item[len++] = 0;
+
+	put16(item + 10, (running_status << 13) | (len - 12));
+	return len;
+}
+
+static void eit_header(struct dvbtsgen *gen, uint8_t *header, int segment_last, int last_table_id)
+{
+	put16(header, gen->config.transport_stream_id);
+	put16(header + 2, gen->config.original_network_id);
+	header[4] = segment_last;
+	header[5] = last_table_id;
+}
+
+static int build_eit_pf(struct dvbtsgen *gen, struct tsgen_builder *b)
+{
+	uint8_t header[6];
+	uint8_t item[64];
+	int n, len;
+
+	eit_header(gen, header, 1, stag_dvb_event_information_nownext_actual);
+	for(n = 0; n < gen->config.services; n++) {
+		if (builder_table(b, stag_dvb_event_information_nownext_actual, service_id(n), 1,
+				  TSGEN_EIT_MAX_SECTION, header, sizeof(header), -1))
+			return -1;
+
+		/* present (running), and following (not yet running) */
+		len = event_item(gen, item, n, 0, 4);
+		if (builder_section(b, 0) || builder_add(b, item, len))
+			return -1;
+		len = event_item(gen, item, n, 1, 1);
+		if (builder_section(b, 1) || builder_add(b, item, len))
+			return -1;
+	}
+	return builder_end_table(b);
+}
+
+/*
+ * The schedule of a service: each 3 hour segment (counted from midnight of
+ * the first day) starts at section segment * 8 of its table, and the events
+ * of a segment which do not fit in its 8 sections are left out.
+ */
+static int build_eit_schedule(struct dvbtsgen *gen, struct tsgen_builder *b, int n)
+{
+	time_t day = gen->config.start_time - (gen->config.start_time % (24 * 60 * 60));
+	uint8_t header[6];
+	uint8_t item[64];
+	int last_segment, last_table_id, table_id = -1;
+	int segment, section = 0, seg_first = 0;
+	int event, len, i;
+	time_t start;
+
+	start = gen->config.start_time +
+		((time_t) (gen->config.eit_events - 1) * gen->config.eit_event_length);
+	last_segment = (start - day) / TSGEN_EIT_SEGMENT;
+	if (last_segment >= TSGEN_EIT_MAX_SEGMENTS)
+		last_segment = TSGEN_EIT_MAX_SEGMENTS - 1;
+	last_table_id = stag_dvb_event_information_schedule_actual + (last_segment / 32);
+
+	for(event = 0; event < gen->config.eit_events; event++) {
+		start = gen->config.start_time + ((time_t) event * gen->config.eit_event_length);
+		segment = (start - day) / TSGEN_EIT_SEGMENT;
+		if (segment > last_segment)
+			break;
+
+		if ((stag_dvb_event_information_schedule_actual + (segment / 32)) != table_id) {
+			table_id = stag_dvb_event_information_schedule_actual + (segment / 32);
+			eit_header(gen, header, 0, last_table_id);
+			if (builder_table(b, table_id, service_id(n), 1, TSGEN_EIT_MAX_SECTION,
+					  header, sizeof(header), -1))
+				return -1;
+			section = -1;
+		}
+		if ((section < 0) || ((section / 8) != (segment % 32))) {
+			section = (segment % 32) * 8;
+			seg_first = b->count;
+			if (builder_section(b, section))
+				return -1;
+		}
+
+		len = event_item(gen, item, n, event, 0);
+		if ((b->len - b->starts[b->count - 1] + len + CRC_SIZE) > b->max_section) {
+			if ((section % 8) == 7)
+				continue;
+			if (builder_section(b, ++section))
+				return -1;
+		}
+		if (builder_add(b, item, len))
+			return -1;
+
+		/* segment_last_section_number of the segment so far */
+		for(i = seg_first; i < b->count; i++)
+			b->data[b->starts[i] + sizeof(struct section_ext) + 4] = section;
+	}
+	return builder_end_table(b);
+}
+
+/*
+ * EIT present/following and schedule share a PID, so they are sent as one
+ * carousel: the schedule is split into pieces, each preceded by all of
+ * present/following, such that present/following comes round every
+ * TSGEN_EIT_PF_INTERVAL.
+ */
+static int build_eit(struct dvbtsgen *gen, struct tsgen_builder *b)
+{
+	struct tsgen_builder sched;
+	struct tsgen_packets p;
+	int pieces, piece, pos, end, target;
+	int interval, ret = -1;
+	int n;
+
+	memset(&sched, 0, sizeof(sched));
+	memset(&p, 0, sizeof(p));
+
+	if (build_eit_pf(gen, b))
+		goto exit;
+
+	interval = TSGEN_EIT_PF_INTERVAL;
+	pieces = 1;
+	if (gen->config.eit_events) {
+		for(n = 0; n < gen->config.services; n++) {
+			if (build_eit_schedule(gen, &sched, n))
+				goto exit;
+		}
+		interval = gen->config.eit_interval;
+		pieces = interval / TSGEN_EIT_PF_INTERVAL;
+		if (pieces < 1)
+			pieces = 1;
+	}
+
+	pos = 0;
+	for(piece = 0; piece < pieces; piece++) {
+		if (packetize(&p, TSGEN_PID_EIT, b->data, b->len))
+			goto exit;
+
+		target = (int) (((int64_t) sched.len * (piece + 1)) / pieces);
+		end = pos;
+		while ((end < sched.len) && (end < target))
+			end += section_total_length(sched.data + end);
+		if ((end > pos) && packetize(&p, TSGEN_PID_EIT, sched.data + pos, end - pos))
+			goto exit;
+		pos = end;
+	}
+
+	ret = add_table_stream(gen, TSGEN_PID_EIT, &p, interval);
+	b->len = 0;
+
+exit:
+	free(p.data);
+	builder_free(&sched);
+	return ret;
+}
+
+static int build(struct dvbtsgen *gen)
+{
+	struct tsgen_builder b;
+	uint64_t audio, video;
+	struct tsgen_stream *s;
+	int ret = -1;
+	int n;
+
+	memset(&b, 0, sizeof(b));
+	if (build_pat(gen, &b) || build_nit(gen, &b) || build_sdt(gen, &b) || build_eit(gen, &b))
+		goto exit;
+	for(n = 0; n < gen->config.services; n++) {
+		if (build_pmt(gen, &b, n))
+			goto exit;
+	}
+
+	audio = TSGEN_AUDIO_BITRATE;
+	if (audio > (gen->config.service_bitrate / 4))
+		audio = gen->config.service_bitrate / 4;
+	video = gen->config.service_bitrate - audio;
+	for(n = 0; n < gen->config.services; n++) {
+		s = add_stream(gen, TSGEN_STREAM_VIDEO, TSGEN_PID_ES + (2 * n), video);
+		/* spread the frames and PCRs of the services out a bit */
+		s->next_frame = (TSGEN_FRAME_TICKS * n) / gen->config.services;
+		s->next_pcr = s->next_frame;
+		add_stream(gen, TSGEN_STREAM_AUDIO, TSGEN_PID_ES + (2 * n) + 1, audio);
+	}
+	ret = 0;
+
+exit:
+	builder_free(&b);
+	return ret;
+}
+
+static void heap_down(struct dvbtsgen *gen, int i)
+{
+	int *heap = gen->heap;
+	int n = gen->stream_count;
+	int child, tmp;
+
+	while ((child = (2 * i) + 1) < n) {
+		if (((child + 1) < n) &&
+		    (gen->streams[heap[child + 1]].due < gen->streams[heap[child]].due))
+			child++;
+		if (gen->streams[heap[i]].due <= gen->streams[heap[child]].due)
+			break;
+		tmp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = tmp;
+		i = child;
+	}
+}
+
+static int check_config(struct dvbtsgen_config *config)
+{
+	if (config->mux_count == 0)
+		config->mux_count = 1;
+	if (config->network_id == 0)
+		config->network_id = 1;
+	if (config->original_network_id == 0)
+		config->original_network_id = config->network_id;
+	if (config->transport_stream_id == 0)
+		config->transport_stream_id = config->mux_index + 1;
+	if (config->services == 0)
+		config->services = 8;
+	if (config->bitrate == 0)
+		config->bitrate = 38000000;
+	if (config->service_bitrate == 0)
+		config->service_bitrate = 4000000;
+	if (config->eit_event_length == 0)
+		config->eit_event_length = 1800;
+	if (config->eit_interval == 0)
+		config->eit_interval = 10000;
+	if (config->pcr_interval == 0)
+		config->pcr_interval = 30;
+
+	if ((config->mux_index < 0) || (config->mux_index >= config->mux_count) ||
+	    (config->services < 0) || (config->services > DVBTSGEN_MAX_SERVICES) ||
+	    (config->bitrate < TSGEN_PACKET_BITS) || (config->service_bitrate < 1000) ||
+	    (config->eit_events < 0) || (config->eit_event_length < 0) ||
+	    (config->eit_interval < 0) || (config->pcr_interval < 0) ||
+	    (config->pcr_jitter < 0) || (config->cc_error_interval < 0))
+		return -1;
+	if (config->transport_stream_id < config->mux_index)
+		return -1;
+	return 0;
+}
+
+static struct dvbtsgen *create(struct dvbtsgen_config *config)
+{
+	struct dvbtsgen *gen;
+	int max_streams;
+	int i;
+
+	if ((gen = calloc(1, sizeof(struct dvbtsgen))) == NULL)
+		return NULL;
+	gen->config = *config;
+	if (check_config(&gen->config)) {
+		free(gen);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	max_streams = 4 + (3 * gen->config.services);
+	gen->streams = calloc(max_streams, sizeof(struct tsgen_stream));
+	gen->heap = calloc(max_streams, sizeof(int));
+	if ((gen->streams == NULL) || (gen->heap == NULL) || build(gen)) {
+		dvbtsgen_destroy(gen);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	for(i = 0; i < gen->stream_count; i++)
+		gen->heap[i] = i;
+
+	gen->ticks_per_packet = stream_interval(gen->config.bitrate);
+	gen->pcr_interval = gen->config.pcr_interval * TSGEN_TICKS_PER_MS;
+	gen->pcr_jitter = ((uint64_t) gen->config.pcr_jitter * 27) / 1000;
+	gen->random = gen->config.seed ? gen->config.seed : 1;
+
+	gen->null_packet[0] = TRANSPORT_PACKET_SYNC;
+	gen->null_packet[1] = TRANSPORT_NULL_PID >> 8;
+	gen->null_packet[2] = TRANSPORT_NULL_PID & 0xff;
+	gen->null_packet[3] = 0x10;
+	memset(gen->null_packet + 4, 0xff, TRANSPORT_PACKET_LENGTH - 4);
+
+	return gen;
+}
+
+struct dvbtsgen *dvbtsgen_create(struct dvbtsgen_config *config)
+{
+	struct dvbtsgen *gen;
+
+	if ((gen = create(config)) == NULL)
+		return NULL;
+	if (gen->required > gen->config.bitrate) {
+		dvbtsgen_destroy(gen);
+		errno = EINVAL;
+		return NULL;
+	}
+	return gen;
+}
+
+void dvbtsgen_destroy(struct dvbtsgen *gen)
+{
+	int i;
+
+	if (gen->streams) {
+		for(i = 0; i < gen->stream_count; i++)
+			free(gen->streams[i].packets);
+	}
+	free(gen->streams);
+	free(gen->heap);
+	free(gen);
+}
+
+uint64_t dvbtsgen_required_bitrate(struct dvbtsgen_config *config)
+{
+	struct dvbtsgen *gen;
+	uint64_t required;
+
+	if ((gen = create(config)) == NULL)
+		return 0;
+	required = gen->required;
+	dvbtsgen_destroy(gen);
+	return required;
+}
+
+static inline uint8_t next_cc(struct dvbtsgen *gen, struct tsgen_stream *s)
+{
+	uint8_t cc = s->cc;
+
+	s->cc = (s->cc + 1) & 0x0f;
+	if (gen->config.cc_error_interval &&
+	    ((tsgen_random(gen) % gen->config.cc_error_interval) == 0)) {
+		s->cc = (s->cc + 1) & 0x0f;
+		gen->stats.cc_errors++;
+	}
+	return cc;
+}
+
+static inline void put_pts(uint8_t *buf, uint64_t ticks)
+{
+	uint64_t pts = (ticks / 300) & 0x1ffffffffULL;
+
+	buf[0] = 0x21 | ((pts >> 29) & 0x0e);
+	buf[1] = pts >> 22;
+	buf[2] = 0x01 | ((pts >> 14) & 0xfe);
+	buf[3] = pts >> 7;
+	buf[4] = 0x01 | ((pts << 1) & 0xfe);
+}
+
+static inline void put_pcr(uint8_t *buf, uint64_t ticks)
+{
+	uint64_t base = (ticks / 300) & 0x1ffffffffULL;
+	int ext = ticks % 300;
+
+	buf[0] = base >> 25;
+	buf[1] = base >> 17;
+	buf[2] = base >> 9;
+	buf[3] = base >> 1;
+	buf[4] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+	buf[5] = ext;
+}
+
+static void emit_video(struct dvbtsgen *gen, struct tsgen_stream *s, uint8_t *pkt, uint64_t now)
+{
+	uint64_t pcr;
+	int pos = 4;
+	int jitter;
+
+	pkt[0] = TRANSPORT_PACKET_SYNC;
+	pkt[1] = s->pid >> 8;
+	pkt[2] = s->pid;
+	pkt[3] = 0x10 | next_cc(gen, s);
+
+	if (now >= s->next_pcr) {
+		pcr = now;
+		if (gen->pcr_jitter) {
+			jitter = (int) (tsgen_random(gen) % ((2 * gen->pcr_jitter) + 1)) - gen->pcr_jitter;
+			if ((jitter >= 0) || ((uint64_t) -jitter <= pcr))
+				pcr += jitter;
+		}
+		pkt[3] |= 0x20;
+		pkt[pos++] = 7;
+		pkt[pos++] = transport_adaptation_flag_pcr;
+		put_pcr(pkt + pos, pcr % TSGEN_PCR_WRAP);
+		pos += 6;
+		s->next_pcr += gen->pcr_interval;
+		if (s->next_pcr <= now)
+			s->next_pcr = now + gen->pcr_interval;
+		gen->stats.pcrs++;
+	}
+
+	if (now >= s->next_frame) {
+		/* a PES packet of unbounded length per frame */
+		pkt[1] |= 0x40;
+		pkt[pos++] = 0x00;
+		pkt[pos++] = 0x00;
+		pkt[pos++] = 0x01;
+		pkt[pos++] = 0xe0;
+		pkt[pos++] = 0x00;
+		pkt[pos++] = 0x00;
+		pkt[pos++] = 0x80;
+		pkt[pos++] = 0x80;
+		pkt[pos++] = 5;
+		put_pts(pkt + pos, s->next_frame + TSGEN_PTS_DELAY);
+		pos += 5;
+		s->next_frame += TSGEN_FRAME_TICKS;
+		if (s->next_frame <= now)
+			s->next_frame = now + TSGEN_FRAME_TICKS;
+	}
+
+	memcpy(pkt + pos, es_data, TRANSPORT_PACKET_LENGTH - pos);
+}
+
+static void emit_audio(struct dvbtsgen *gen, struct tsgen_stream *s, uint8_t *pkt, uint64_t now)
+{
+	/* one complete PES packet per transport packet */
+	pkt[0] = TRANSPORT_PACKET_SYNC;
+	pkt[1] = 0x40 | (s->pid >> 8);
+	pkt[2] = s->pid;
+	pkt[3] = 0x10 | next_cc(gen, s);
+	pkt[4] = 0x00;
+	pkt[5] = 0x00;
+	pkt[6] = 0x01;
+	pkt[7] = 0xc0;
+	put16(pkt + 8, TRANSPORT_PACKET_LENGTH - 4 - 6);
+	pkt[10] = 0x80;
+	pkt[11] = 0x80;
+	pkt[12] = 5;
+	put_pts(pkt + 13, now + TSGEN_PTS_DELAY);
+	memcpy(pkt + 18, es_data, TRANSPORT_PACKET_LENGTH - 18);
+}
+
+static void emit_table(struct dvbtsgen *gen, struct tsgen_stream *s, uint8_t *pkt)
+{
+	memcpy(pkt, s->packets + (s->next_packet * TRANSPORT_PACKET_LENGTH),
+	       TRANSPORT_PACKET_LENGTH);
+	pkt[3] = (pkt[3] & 0xf0) | next_cc(gen, s);
+	if (++s->next_packet == s->packet_count)
+		s->next_packet = 0;
+}
+
+void dvbtsgen_generate(struct dvbtsgen *gen, uint8_t *buf, int packets)
+{
+	struct tsgen_stream *s;
+	uint64_t now;
+	uint8_t *pkt;
+	int i;
+
+	for(i = 0; i < packets; i++) {
+		pkt = buf + (i * TRANSPORT_PACKET_LENGTH);
+		now = gen->pos++ * gen->ticks_per_packet;
+
+		s = (gen->stream_count) ? gen->streams + gen->heap[0] : NULL;
+		if ((s == NULL) || (s->due > now)) {
+			memcpy(pkt, gen->null_packet, TRANSPORT_PACKET_LENGTH);
+			gen->stats.null_packets++;
+			continue;
+		}
+
+		switch(s->type) {
+		case TSGEN_STREAM_TABLE:
+			emit_table(gen, s, pkt);
+			break;
+		case TSGEN_STREAM_VIDEO:
+			emit_video(gen, s, pkt, now >> TSGEN_FRAC);
+			break;
+		case TSGEN_STREAM_AUDIO:
+			emit_audio(gen, s, pkt, now >> TSGEN_FRAC);
+			break;
+		}
+		s->due += s->interval;
+		heap_down(gen, 0);
+	}
+	gen->stats.packets += packets;
+}
+
+void dvbtsgen_get_stats(struct dvbtsgen *gen, struct dvbtsgen_stats *stats)
+{
+	*stats = gen->stats;
+}
@@ -0,0 +1,138 @@
+/*
+ * libdvbtsgen - synthetic DVB transport stream generator
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef LIBDVBTSGEN_H
+#define LIBDVBTSGEN_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * A generator for one multiplex of a synthetic DVB network, for exercising
+ * the tools without a tuner.
+ *
+ * The mux carries a PAT, a PMT per service, an NIT listing every mux of the
+ * network, an SDT and EIT present/following and (optionally) schedule
+ * tables, all with valid CRCs. Each service has an MPEG-2 video PID carrying
+ * the PCR and an audio PID, filled with PES packets of dummy data. Whatever
+ * is left of the mux rate is padded with null packets.
+ *
+ * All tables are built when the generator is created, and all timing
+ * (PCRs, PTSs, the spacing of packets) is derived from the position of the
+ * packet in the stream and the configured mux rate. The same configuration
+ * therefore always produces the same stream, however fast it is generated.
+ *
+ * PIDs: 0x0010 NIT, 0x0011 SDT, 0x0012 EIT, 0x0100 + n the PMT of service n,
+ * 0x1000 + 2n its video and 0x1001 + 2n its audio. Service n has
+ * service_id n + 1.
+ */
+struct dvbtsgen;
+
+#define DVBTSGEN_MAX_SERVICES 1024
+
+/**
+ * Configuration of a generator. Fields left as 0 take the defaults noted.
+ */
+struct dvbtsgen_config {
+	int mux_index;			/* this mux, 0 to mux_count - 1 */
+	int mux_count;			/* muxes listed in the NIT (default 1) */
+	uint16_t network_id;		/* default 1 */
+	uint16_t original_network_id;	/* default network_id */
+	uint16_t transport_stream_id;	/* default mux_index + 1 */
+
+	int services;			/* services in the mux (default 8) */
+	uint64_t bitrate;		/* mux rate in bits/s (default 38000000) */
+	uint64_t service_bitrate;	/* video + audio of each service (default 4000000) */
+
+	time_t start_time;		/* the time of the first packet (default the epoch) */
+	int eit_events;			/* schedule events per service, 0 => present/following only */
+	int eit_event_length;		/* length of each event in seconds (default 1800) */
+	int eit_interval;		/* repetition of the schedule in ms (default 10000) */
+
+	/* impairments, all off when 0 */
+	int pcr_interval;		/* ms between PCRs (default 30; > 40 is an error) */
+	int pcr_jitter;			/* maximum error of each PCR in ns */
+	int cc_error_interval;		/* skip a continuity count every N packets on average */
+	uint32_t seed;			/* of the impairments */
+};
+
+/**
+ * What a generator has produced so far.
+ */
+struct dvbtsgen_stats {
+	uint64_t packets;
+	uint64_t null_packets;
+	uint64_t pcrs;
+	uint64_t cc_errors;		/* continuity counts skipped */
+};
+
+/**
+ * Create a generator.
+ *
+ * @param config The configuration.
+ * @return The generator, or NULL on failure (errno is set to EINVAL if the
+ * configuration is invalid, or the services and tables do not fit into the
+ * mux rate).
+ */
+extern struct dvbtsgen *dvbtsgen_create(struct dvbtsgen_config *config);
+
+/**
+ * Destroy a generator.
+ *
+ * @param gen The generator.
+ */
+extern void dvbtsgen_destroy(struct dvbtsgen *gen);
+
+/**
+ * Generate the next packets of the stream.
+ *
+ * @param gen The generator.
+ * @param buf Where to put them (packets * TRANSPORT_PACKET_LENGTH bytes).
+ * @param packets The number of packets.
+ */
+extern void dvbtsgen_generate(struct dvbtsgen *gen, uint8_t *buf, int packets);
+
+/**
+ * Retrieve the statistics of a generator.
+ *
+ * @param gen The generator.
+ * @param stats Where to put them.
+ */
+extern void dvbtsgen_get_stats(struct dvbtsgen *gen, struct dvbtsgen_stats *stats);
+
+/**
+ * Retrieve the minimum mux rate the services and tables of a configuration
+ * need, e.g. to report why dvbtsgen_create() failed.
+ *
+ * @param config The configuration.
+ * @return The rate in bits/s, or 0 if the configuration is invalid.
+ */
+extern uint64_t dvbtsgen_required_bitrate(struct dvbtsgen_config *config);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
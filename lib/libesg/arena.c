@@ -0,0 +1,185 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libesg/arena.h>
+
+#define ESG_ARENA_DEFAULT_SIZE 4096
+#define ESG_ARENA_ALIGN 16
+
+struct esg_arena_block {
+	struct esg_arena_block *_next;
+	size_t size;
+	size_t used;
+};
+
+#define ESG_ARENA_BLOCK_HEADER \
+	((sizeof(struct esg_arena_block) + ESG_ARENA_ALIGN - 1) & ~(size_t) (ESG_ARENA_ALIGN - 1))
+
+struct esg_arena_release_entry {
+	void (*release)(void *object);
+	void *object;
+
+	struct esg_arena_release_entry *_next;
+};
+
+struct esg_arena {
+	struct esg_arena_block *block_list;	// the one in use first
+	size_t total;				// bytes used since the last release
+	struct esg_arena_release_entry *release_list;
+};
+
+static struct esg_arena_block *esg_arena_new_block(size_t size) {
+	struct esg_arena_block *block;
+
+	block = (struct esg_arena_block *) malloc(ESG_ARENA_BLOCK_HEADER + size);
+	if (block == NULL) {
+		return NULL;
+	}
+	block->_next = NULL;
+	block->size = size;
+	block->used = 0;
+
+	return block;
+}
+
+struct esg_arena *esg_arena_create(size_t size) {
+	struct esg_arena *arena;
+
+	if (size == 0) {
+		size = ESG_ARENA_DEFAULT_SIZE;
+	}
+
+	arena = (struct esg_arena *) malloc(sizeof(struct esg_arena));
+	if (arena == NULL) {
+		return NULL;
+	}
+	memset(arena, 0, sizeof(struct esg_arena));
+
+	arena->block_list = esg_arena_new_block(size);
+	if (arena->block_list == NULL) {
+		free(arena);
+		return NULL;
+	}
+
+	return arena;
+}
+
+void *esg_arena_alloc(struct esg_arena *arena, size_t size) {
+	struct esg_arena_block *block;
+	size_t block_size;
+	uint8_t *ptr;
+
+	if (arena == NULL) {
+		return calloc(1, size ? size : 1);
+	}
+
+	size = (size + ESG_ARENA_ALIGN - 1) & ~(size_t) (ESG_ARENA_ALIGN - 1);
+
+	block = arena->block_list;
+	if ((block == NULL) || (block->size - block->used < size)) {
+		block_size = block ? block->size * 2 : ESG_ARENA_DEFAULT_SIZE;
+		if (block_size < size) {
+			block_size = size;
+		}
+		block = esg_arena_new_block(block_size);
+		if (block == NULL) {
+			return NULL;
+		}
+		block->_next = arena->block_list;
+		arena->block_list = block;
+	}
+
+	ptr = (uint8_t *) block + ESG_ARENA_BLOCK_HEADER + block->used;
+	block->used += size;
+	arena->total += size;
+	memset(ptr, 0, size);
+
+	return ptr;
+}
+
+int esg_arena_add_release(struct esg_arena *arena, void (*release)(void *object), void *object) {
+	struct esg_arena_release_entry *entry;
+
+	entry = (struct esg_arena_release_entry *) esg_arena_alloc(arena, sizeof(struct esg_arena_release_entry));
+	if (entry == NULL) {
+		return -1;
+	}
+	entry->release = release;
+	entry->object = object;
+	entry->_next = arena->release_list;
+	arena->release_list = entry;
+
+	return 0;
+}
+
+static void esg_arena_run_release_list(struct esg_arena *arena) {
+	struct esg_arena_release_entry *entry;
+
+	for (entry = arena->release_list; entry; entry = entry->_next) {
+		entry->release(entry->object);
+	}
+	arena->release_list = NULL;
+}
+
+void esg_arena_release(struct esg_arena *arena) {
+	struct esg_arena_block *block;
+	struct esg_arena_block *next_block;
+
+	if (arena == NULL) {
+		return;
+	}
+
+	esg_arena_run_release_list(arena);
+
+	// If it did not fit in one block, swap them for one which would have
+	if ((arena->block_list != NULL) && (arena->block_list->_next != NULL)) {
+		for (block = arena->block_list; block; block = next_block) {
+			next_block = block->_next;
+			free(block);
+		}
+		arena->block_list = esg_arena_new_block(arena->total);
+	}
+
+	if (arena->block_list != NULL) {
+		arena->block_list->used = 0;
+	}
+	arena->total = 0;
+}
+
+void esg_arena_destroy(struct esg_arena *arena) {
+	struct esg_arena_block *block;
+	struct esg_arena_block *next_block;
+
+	if (arena == NULL) {
+		return;
+	}
+
+	esg_arena_run_release_list(arena);
+	for (block = arena->block_list; block; block = next_block) {
+		next_block = block->_next;
+		free(block);
+	}
+
+	free(arena);
+}
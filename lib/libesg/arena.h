@@ -0,0 +1,86 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_ARENA_H
+#define _ESG_ARENA_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+/**
+ * An arena holds everything decoded by the *_decode_arena() functions, so it
+ * can all go at once with esg_arena_release() instead of a walk through each
+ * structure's free function. The space is kept for the next decode: once an
+ * arena has grown to fit the containers of a carousel, decoding one more does
+ * not allocate at all.
+ */
+struct esg_arena;
+
+/**
+ * Create an arena.
+ *
+ * @param size Initial size in bytes, or 0 for a default.
+ * @return Pointer to the arena, or NULL on error.
+ */
+extern struct esg_arena *esg_arena_create(size_t size);
+
+/**
+ * Allocate zeroed memory from an arena.
+ *
+ * @param arena Pointer to an esg_arena, or NULL to use calloc() instead.
+ * @param size Number of bytes.
+ * @return Pointer to the memory, or NULL on error.
+ */
+extern void *esg_arena_alloc(struct esg_arena *arena, size_t size);
+
+/**
+ * Have a function called on an object by the next esg_arena_release(), for
+ * objects which live outside of the arena.
+ *
+ * @param arena Pointer to an esg_arena.
+ * @param release Function to call.
+ * @param object Its argument.
+ * @return 0 on success, or -1 on error (release is not registered).
+ */
+extern int esg_arena_add_release(struct esg_arena *arena, void (*release)(void *object), void *object);
+
+/**
+ * Release everything allocated from an arena. The arena can be used again.
+ *
+ * @param arena Pointer to an esg_arena.
+ */
+extern void esg_arena_release(struct esg_arena *arena);
+
+/**
+ * Release everything allocated from an arena, and the arena itself.
+ *
+ * @param arena Pointer to an esg_arena.
+ */
+extern void esg_arena_destroy(struct esg_arena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,28 +22,27 @@
 #include <string.h>
 
 #include <libesg/bootstrap/access_descriptor.h>
+#include <libesg/reader.h>
 
 struct esg_access_descriptor *esg_access_descriptor_decode(uint8_t *buffer, uint32_t size) {
-	uint32_t pos;
+	struct esg_reader reader;
 	struct esg_access_descriptor *access_descriptor;
 	struct esg_entry *entry;
 	struct esg_entry *last_entry;
 	uint32_t entry_length;
 	uint16_t entry_index;
-	uint8_t ip_index;
 
 	if ((buffer == NULL) || (size <= 2)) {
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
 	access_descriptor = (struct esg_access_descriptor *) malloc(sizeof(struct esg_access_descriptor));
 	memset(access_descriptor, 0, sizeof(struct esg_access_descriptor));
 	access_descriptor->entry_list = NULL;
 
-	access_descriptor->n_o_entries = (buffer[pos] << 8) | buffer[pos+1];
-	pos += 2;
+	access_descriptor->n_o_entries = esg_reader_u16(&reader);
 
     last_entry = NULL;
 	for (entry_index = 0; entry_index < access_descriptor->n_o_entries; entry_index++) {
@@ -58,41 +57,33 @@ struct esg_access_descriptor *esg_access_descriptor_decode(uint8_t *buffer, uint
 		}
 		last_entry = entry;
 
-		entry->version = buffer[pos];
-		pos += 1;
+		entry->version = esg_reader_u8(&reader);
+		entry_length = esg_reader_vluimsbf8(&reader);
 
-		pos += vluimsbf8(buffer + pos, size - pos, &entry_length);
-
-		if (size < pos + entry_length) {
+		if (!esg_reader_ok(&reader) || (esg_reader_remaining(&reader) < entry_length)) {
 			esg_access_descriptor_free(access_descriptor);
 			return NULL;
 		}
 
-		entry->multiple_stream_transport = (buffer[pos] & 0x80) ? 1 : 0;
-		entry->ip_version_6 = (buffer[pos] & 0x40) ? 1 : 0;
-		pos += 1;
-
-		entry->provider_id = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+		entry->multiple_stream_transport = esg_reader_bits(&reader, 1);
+		entry->ip_version_6 = esg_reader_bits(&reader, 1);
+		esg_reader_bits(&reader, 6); // reserved
+		entry->provider_id = esg_reader_u16(&reader);
 
 		if (entry->ip_version_6) {
-			for (ip_index = 0; ip_index < 16; ip_index++) {
-				entry->source_ip.ipv6[ip_index] = buffer[pos+ip_index];
-				entry->destination_ip.ipv6[ip_index] = buffer[pos+16+ip_index];
-			}
-			pos += 32;
+			esg_reader_copy(&reader, entry->source_ip.ipv6, 16);
+			esg_reader_copy(&reader, entry->destination_ip.ipv6, 16);
 		} else {
-			for (ip_index = 0; ip_index < 4; ip_index++) {
-				entry->source_ip.ipv4[ip_index] = buffer[pos+ip_index];
-				entry->destination_ip.ipv4[ip_index] = buffer[pos+4+ip_index];
-			}
-			pos += 8;
+			esg_reader_copy(&reader, entry->source_ip.ipv4, 4);
+			esg_reader_copy(&reader, entry->destination_ip.ipv4, 4);
 		}
-		entry->port = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+		entry->port = esg_reader_u16(&reader);
+		entry->tsi = esg_reader_u16(&reader);
+	}
 
-		entry->tsi = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+	if (!esg_reader_ok(&reader)) {
+		esg_access_descriptor_free(access_descriptor);
+		return NULL;
 	}
 
 	return access_descriptor;
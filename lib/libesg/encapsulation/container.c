@@ -20,6 +20,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <libdvbmisc/dvbstats.h>
 
 #include <libesg/encapsulation/container.h>
 #include <libesg/encapsulation/fragment_management_information.h>
@@ -27,8 +28,25 @@
 #include <libesg/encapsulation/string_repository.h>
 #include <libesg/representation/init_message.h>
 #include <libesg/transport/session_partition_declaration.h>
+#include <libesg/reader.h>
+#include <libesg/stats.h>
 
-struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
+static void esg_container_release_session_partition_declaration(void *object) {
+	esg_session_partition_declaration_free((struct esg_session_partition_declaration *) object);
+}
+
+static void esg_container_release_init_message(void *object) {
+	esg_init_message_free((struct esg_init_message *) object);
+}
+
+/*
+ * With an arena, everything is allocated from it and the repositories and the
+ * structure body are views of buffer. The session partition declaration and
+ * the init message have no arena decoders; they are freed by the arena's
+ * release.
+ */
+static struct esg_container *esg_container_decode_structures(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	struct esg_reader reader;
 	uint32_t pos;
 	struct esg_container *container;
 	struct esg_container_structure *structure;
@@ -39,27 +57,31 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
-	container = (struct esg_container *) malloc(sizeof(struct esg_container));
-	memset(container, 0, sizeof(struct esg_container));
+	container = (struct esg_container *) esg_arena_alloc(arena, sizeof(struct esg_container));
+	if (container == NULL) {
+		return NULL;
+	}
 
 	// Container header
-	container->header = (struct esg_container_header *) malloc(sizeof(struct esg_container_header));
-	memset(container->header, 0, sizeof(struct esg_container_header));
+	container->header = (struct esg_container_header *) esg_arena_alloc(arena, sizeof(struct esg_container_header));
+	if (container->header == NULL) {
+		goto error;
+	}
 
-	container->header->num_structures = buffer[pos];
-	pos += 1;
+	container->header->num_structures = esg_reader_u8(&reader);
 
-	if (size < pos + (container->header->num_structures * 8)) {
-		esg_container_free(container);
-		return NULL;
+	if (esg_reader_remaining(&reader) < (container->header->num_structures * 8)) {
+		goto error;
 	}
 
 	last_structure = NULL;
 	for (structure_index = 0; structure_index < container->header->num_structures; structure_index++) {
-		structure = (struct esg_container_structure *) malloc(sizeof(struct esg_container_structure));
-		memset(structure, 0, sizeof(struct esg_container_structure));
+		structure = (struct esg_container_structure *) esg_arena_alloc(arena, sizeof(struct esg_container_structure));
+		if (structure == NULL) {
+			goto error;
+		}
 		structure->_next = NULL;
 
 		if (last_structure == NULL) {
@@ -69,21 +91,13 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 		}
 		last_structure = structure;
 
-		structure->type = buffer[pos];
-		pos += 1;
-
-		structure->id = buffer[pos];
-		pos += 1;
-
-		structure->ptr = (buffer[pos] << 16) | (buffer[pos+1] << 8) | buffer[pos+2];
-		pos += 3;
-
-		structure->length = (buffer[pos] << 16) | (buffer[pos+1] << 8) | buffer[pos+2];
-		pos += 3;
+		structure->type = esg_reader_u8(&reader);
+		structure->id = esg_reader_u8(&reader);
+		structure->ptr = esg_reader_u24(&reader);
+		structure->length = esg_reader_u24(&reader);
 
 		if (size < (structure->ptr + structure->length)) {
-			esg_container_free(container);
-			return NULL;
+			goto error;
 		}
 
 		// Decode structure
@@ -91,12 +105,15 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0x01: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_encapsulation_structure_decode(buffer + structure->ptr, structure->length);
+						if (arena) {
+							structure->data = (void *) esg_encapsulation_structure_decode_arena(arena, buffer + structure->ptr, structure->length);
+						} else {
+							structure->data = (void *) esg_encapsulation_structure_decode(buffer + structure->ptr, structure->length);
+						}
 						break;
 					}
 					default: {
-						esg_container_free(container);
-						return NULL;
+						goto error;
 					}
 				}
 				break;
@@ -104,12 +121,15 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0x02: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_string_repository_decode(buffer + structure->ptr, structure->length);
+						if (arena) {
+							structure->data = (void *) esg_string_repository_decode_arena(arena, buffer + structure->ptr, structure->length);
+						} else {
+							structure->data = (void *) esg_string_repository_decode(buffer + structure->ptr, structure->length);
+						}
 						break;
 					}
 					default: {
-						esg_container_free(container);
-						return NULL;
+						goto error;
 					}
 				}
 				break;
@@ -129,12 +149,15 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 			case 0xE0: {
 				switch (structure->id) {
 					case 0x00: {
-						structure->data = (void *) esg_data_repository_decode(buffer + structure->ptr, structure->length);
+						if (arena) {
+							structure->data = (void *) esg_data_repository_decode_arena(arena, buffer + structure->ptr, structure->length);
+						} else {
+							structure->data = (void *) esg_data_repository_decode(buffer + structure->ptr, structure->length);
+						}
 						break;
 					}
 					default: {
-						esg_container_free(container);
-						return NULL;
+						goto error;
 					}
 				}
 				break;
@@ -143,11 +166,15 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 				switch (structure->id) {
 					case 0xFF: {
 						structure->data = (void *) esg_session_partition_declaration_decode(buffer + structure->ptr, structure->length);
+						if (arena && structure->data &&
+						    esg_arena_add_release(arena, esg_container_release_session_partition_declaration, structure->data)) {
+							esg_session_partition_declaration_free((struct esg_session_partition_declaration *) structure->data);
+							goto error;
+						}
 						break;
 					}
 					default: {
-						esg_container_free(container);
-						return NULL;
+						goto error;
 					}
 				}
 				break;
@@ -156,29 +183,100 @@ struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
 				switch (structure->id) {
 					case 0x00: {
 						structure->data = (void *) esg_init_message_decode(buffer + structure->ptr, structure->length);
+						if (arena && structure->data &&
+						    esg_arena_add_release(arena, esg_container_release_init_message, structure->data)) {
+							esg_init_message_free((struct esg_init_message *) structure->data);
+							goto error;
+						}
 						break;
 					}
 					default: {
-						esg_container_free(container);
-						return NULL;
+						goto error;
 					}
 				}
 				break;
 			}
 			default: {
-				esg_container_free(container);
-				return NULL;
+				goto error;
 			}
 		}
 	}
 
 	// Container structure body
+	pos = esg_reader_ptr(&reader) - buffer;
 	container->structure_body_ptr = pos;
 	container->structure_body_length = size - pos;
-	container->structure_body = (uint8_t *) malloc(size - pos);
-	memcpy(container->structure_body, buffer + pos, size - pos);
+	if (arena) {
+		container->structure_body = buffer + pos;
+	} else {
+		container->structure_body = (uint8_t *) malloc(size - pos);
+		if ((container->structure_body == NULL) && (size > pos)) {
+			goto error;
+		}
+		memcpy(container->structure_body, buffer + pos, size - pos);
+	}
 
 	return container;
+
+error:
+	// Anything from an arena goes with it
+	if (arena == NULL) {
+		esg_container_free(container);
+	}
+	return NULL;
+}
+
+static struct esg_container *esg_container_decode_into(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	struct esg_container *container = esg_container_decode_structures(arena, buffer, size);
+
+	if (container == NULL) {
+		dvbstats_inc(&esg_stats, ESG_STATS_DECODE_ERRORS);
+	} else {
+		dvbstats_inc(&esg_stats, ESG_STATS_CONTAINERS);
+		dvbstats_record(&esg_stats, ESG_STATS_CONTAINER_BYTES, size);
+	}
+	return container;
+}
+
+struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size) {
+	return esg_container_decode_into(NULL, buffer, size);
+}
+
+struct esg_container *esg_container_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	return esg_container_decode_into(arena, buffer, size);
+}
+
+static void esg_container_structure_data_free(struct esg_container_structure *structure) {
+	if (structure->data == NULL) {
+		return;
+	}
+
+	switch (structure->type) {
+		case 0x01: {
+			esg_encapsulation_structure_free((struct esg_encapsulation_structure *) structure->data);
+			break;
+		}
+		case 0x02: {
+			esg_string_repository_free((struct esg_string_repository *) structure->data);
+			break;
+		}
+		case 0xE0: {
+			esg_data_repository_free((struct esg_data_repository *) structure->data);
+			break;
+		}
+		case 0xE1: {
+			esg_session_partition_declaration_free((struct esg_session_partition_declaration *) structure->data);
+			break;
+		}
+		case 0xE2: {
+			esg_init_message_free((struct esg_init_message *) structure->data);
+			break;
+		}
+	}
 }
 
 void esg_container_free(struct esg_container *container) {
@@ -192,6 +290,7 @@ void esg_container_free(struct esg_container *container) {
 	if (container->header) {
 		for(structure = container->header->structure_list; structure; structure = next_structure) {
 			next_structure = structure->_next;
+			esg_container_structure_data_free(structure);
 			free(structure);
 		}
 
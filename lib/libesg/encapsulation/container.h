@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_container_structure structure.
@@ -70,7 +71,20 @@ struct esg_container {
 extern struct esg_container *esg_container_decode(uint8_t *buffer, uint32_t size);
 
 /**
- * Free an esg_container.
+ * Process an esg_container into an arena, with its structures. The string and
+ * data repositories and the structure body are not copied but point into
+ * buffer, which must be kept as long as the arena is not released. The
+ * result is freed by esg_arena_release(), not esg_container_free().
+ *
+ * @param arena Pointer to an esg_arena holding the result.
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return Pointer to an esg_container structure, or NULL on error.
+ */
+extern struct esg_container *esg_container_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size);
+
+/**
+ * Free an esg_container, with its structures.
  *
  * @param container Pointer to an esg_container structure.
  */
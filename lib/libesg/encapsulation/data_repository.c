@@ -40,6 +40,25 @@ struct esg_data_repository *esg_data_repository_decode(uint8_t *buffer, uint32_t
 	return data_repository;
 }
 
+struct esg_data_repository *esg_data_repository_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	struct esg_data_repository *data_repository;
+
+	if ((arena == NULL) || (buffer == NULL) || (size <= 0)) {
+		return NULL;
+	}
+
+	data_repository = (struct esg_data_repository *) esg_arena_alloc(arena, sizeof(struct esg_data_repository));
+	if (data_repository == NULL) {
+		return NULL;
+	}
+
+	// A view of the buffer, no copy
+	data_repository->length = size;
+	data_repository->data = buffer;
+
+	return data_repository;
+}
+
 void esg_data_repository_free(struct esg_data_repository *data_repository) {
 	if (data_repository == NULL) {
 		return;
@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_data_repository structure.
@@ -45,6 +46,17 @@ struct esg_data_repository {
  */
 extern struct esg_data_repository *esg_data_repository_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_data_repository into an arena. Its data is not copied but
+ * points into buffer, which must be kept as long as the arena is not released.
+ *
+ * @param arena Pointer to an esg_arena holding the result.
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return Pointer to an esg_data_repository structure, or NULL on error.
+ */
+extern struct esg_data_repository *esg_data_repository_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size);
+
 /**
  * Free an esg_data_repository.
  *
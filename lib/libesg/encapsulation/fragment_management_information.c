@@ -22,9 +22,10 @@
 #include <string.h>
 
 #include <libesg/encapsulation/fragment_management_information.h>
+#include <libesg/reader.h>
 
-struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *buffer, uint32_t size) {
-	uint32_t pos;
+static struct esg_encapsulation_structure *esg_encapsulation_structure_decode_into(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	struct esg_reader reader;
 	struct esg_encapsulation_structure *structure;
 	struct esg_encapsulation_entry *entry;
 	struct esg_encapsulation_entry *last_entry;
@@ -33,23 +34,29 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
-	structure = (struct esg_encapsulation_structure *) malloc(sizeof(struct esg_encapsulation_structure));
-	memset(structure, 0, sizeof(struct esg_encapsulation_structure));
+	structure = (struct esg_encapsulation_structure *) esg_arena_alloc(arena, sizeof(struct esg_encapsulation_structure));
+	if (structure == NULL) {
+		return NULL;
+	}
 	structure->entry_list = NULL;
 
 	// Encapsulation header
-	structure->header = (struct esg_encapsulation_header *) malloc(sizeof(struct esg_encapsulation_header));
-	// buffer[pos] reserved
-	structure->header->fragment_reference_format = buffer[pos+1];
-	pos += 2;
+	structure->header = (struct esg_encapsulation_header *) esg_arena_alloc(arena, sizeof(struct esg_encapsulation_header));
+	if (structure->header == NULL) {
+		goto error;
+	}
+	esg_reader_bits(&reader, 8); // reserved
+	structure->header->fragment_reference_format = esg_reader_u8(&reader);
 
 	// Encapsulation entry list
 	last_entry = NULL;
-	while (size > pos) {
-		entry = (struct esg_encapsulation_entry *) malloc(sizeof(struct esg_encapsulation_entry));
-		memset(entry, 0, sizeof(struct esg_encapsulation_entry));
+	while (esg_reader_remaining(&reader)) {
+		entry = (struct esg_encapsulation_entry *) esg_arena_alloc(arena, sizeof(struct esg_encapsulation_entry));
+		if (entry == NULL) {
+			goto error;
+		}
 		entry->_next = NULL;
 
 		if (last_entry == NULL) {
@@ -62,32 +69,50 @@ struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *
 		// Fragment reference
 		switch (structure->header->fragment_reference_format) {
 			case 0x21: {
-				entry->fragment_reference = (struct esg_fragment_reference *) malloc(sizeof(struct esg_fragment_reference));
-				memset(entry->fragment_reference, 0, sizeof(struct esg_fragment_reference));
+				if (esg_reader_remaining(&reader) < 8) {
+					goto error;
+				}
 
-				entry->fragment_reference->fragment_type = buffer[pos];
-				pos += 1;
+				entry->fragment_reference = (struct esg_fragment_reference *) esg_arena_alloc(arena, sizeof(struct esg_fragment_reference));
+				if (entry->fragment_reference == NULL) {
+					goto error;
+				}
 
-				entry->fragment_reference->data_repository_offset = (buffer[pos] << 16) | (buffer[pos+1] << 8) | buffer[pos+2];
-				pos += 3;
+				entry->fragment_reference->fragment_type = esg_reader_u8(&reader);
+				entry->fragment_reference->data_repository_offset = esg_reader_u24(&reader);
 
 				break;
 			}
 			default: {
-				esg_encapsulation_structure_free(structure);
-				return NULL;
+				goto error;
 			}
 		}
 
 		// Fragment version & id
-		entry->fragment_version = buffer[pos];
-		pos += 1;
-
-		entry->fragment_id = (buffer[pos] << 16) | (buffer[pos+1] << 8) | buffer[pos+2];
-		pos += 3;
+		entry->fragment_version = esg_reader_u8(&reader);
+		entry->fragment_id = esg_reader_u24(&reader);
 	}
 
 	return structure;
+
+error:
+	// Anything from an arena goes with it
+	if (arena == NULL) {
+		esg_encapsulation_structure_free(structure);
+	}
+	return NULL;
+}
+
+struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *buffer, uint32_t size) {
+	return esg_encapsulation_structure_decode_into(NULL, buffer, size);
+}
+
+struct esg_encapsulation_structure *esg_encapsulation_structure_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	if (arena == NULL) {
+		return NULL;
+	}
+
+	return esg_encapsulation_structure_decode_into(arena, buffer, size);
 }
 
 void esg_encapsulation_structure_free(struct esg_encapsulation_structure *structure) {
@@ -110,8 +135,6 @@ void esg_encapsulation_structure_free(struct esg_encapsulation_structure *struct
 			}
 			free(entry);
 		}
-
-		free(structure->entry_list);
 	}
 
 	free(structure);
@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
  * esg_encapsulation_header structure.
@@ -71,6 +72,16 @@ struct esg_encapsulation_structure {
  */
 extern struct esg_encapsulation_structure *esg_encapsulation_structure_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_encapsulation_structure into an arena.
+ *
+ * @param arena Pointer to an esg_arena holding the result.
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return Pointer to an esg_encapsulation_structure structure, or NULL on error.
+ */
+extern struct esg_encapsulation_structure *esg_encapsulation_structure_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size);
+
 /**
  * Free an esg_encapsulation_structure.
  *
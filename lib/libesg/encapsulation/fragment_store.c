@@ -0,0 +1,440 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libdvbmisc/dvbstats.h>
+
+#include <libesg/arena.h>
+#include <libesg/encapsulation/fragment_store.h>
+#include <libesg/encapsulation/fragment_management_information.h>
+#include <libesg/encapsulation/data_repository.h>
+#include <libesg/stats.h>
+
+#define ESG_FRAGMENT_STORE_HASH_SIZE 1024
+
+struct esg_fragment_store_worker {
+	struct esg_fragment_store *store;
+	pthread_t thread;
+	struct esg_arena *arena;
+};
+
+struct esg_fragment_store {
+	struct esg_fragment *hash[ESG_FRAGMENT_STORE_HASH_SIZE];
+	esg_fragment_store_callback callback;
+	void *arg;
+	struct esg_arena *arena;
+	pthread_mutex_t lock;
+
+	// Batch decoding: workers take the next buffer until there are none
+	int num_workers;
+	struct esg_fragment_store_worker workers[ESG_FRAGMENT_STORE_MAX_WORKERS];
+	pthread_mutex_t batch_lock;
+	pthread_cond_t batch_work;
+	pthread_cond_t batch_done;
+	int batch_stop;
+	uint8_t **batch_buffers;
+	uint32_t *batch_sizes;
+	struct esg_container **batch_containers;
+	int batch_count;
+	int batch_next;
+	int batch_pending;
+};
+
+struct esg_fragment_store *esg_fragment_store_create(esg_fragment_store_callback callback, void *arg) {
+	struct esg_fragment_store *store;
+
+	store = (struct esg_fragment_store *) malloc(sizeof(struct esg_fragment_store));
+	if (store == NULL) {
+		return NULL;
+	}
+	memset(store, 0, sizeof(struct esg_fragment_store));
+
+	store->callback = callback;
+	store->arg = arg;
+	pthread_mutex_init(&store->lock, NULL);
+	pthread_mutex_init(&store->batch_lock, NULL);
+	pthread_cond_init(&store->batch_work, NULL);
+	pthread_cond_init(&store->batch_done, NULL);
+
+	return store;
+}
+
+struct esg_fragment *esg_fragment_store_find(struct esg_fragment_store *store, uint32_t fragment_id) {
+	struct esg_fragment *fragment;
+
+	for (fragment = store->hash[fragment_id % ESG_FRAGMENT_STORE_HASH_SIZE]; fragment; fragment = fragment->_next) {
+		if (fragment->fragment_id == fragment_id) {
+			return fragment;
+		}
+	}
+
+	return NULL;
+}
+
+static int esg_fragment_store_compare_offset(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *) a;
+	uint32_t y = *(const uint32_t *) b;
+
+	return (x < y) ? -1 : (x > y);
+}
+
+/*
+ * A fragment runs from its offset in the data repository up to the next
+ * fragment's, or the end of the repository.
+ */
+static uint32_t esg_fragment_store_fragment_end(uint32_t *offsets, uint32_t count, uint32_t offset, uint32_t end) {
+	uint32_t lo = 0;
+	uint32_t hi = count;
+	uint32_t mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (offsets[mid] <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return (lo < count) ? offsets[lo] : end;
+}
+
+static int esg_fragment_store_update_locked(struct esg_fragment_store *store, struct esg_container *container) {
+	struct esg_container_structure *structure;
+	struct esg_encapsulation_structure *fmi = NULL;
+	struct esg_data_repository *data_repository = NULL;
+	struct esg_encapsulation_entry *entry;
+	struct esg_fragment *fragment;
+	uint32_t *offsets;
+	uint32_t count;
+	uint32_t offset;
+	uint32_t length;
+	uint8_t *data;
+	int updated;
+	int changes = 0;
+
+	if ((store == NULL) || (container == NULL) || (container->header == NULL)) {
+		return -1;
+	}
+
+	esg_container_header_structure_list_for_each(container->header, structure) {
+		if ((structure->type == 0x01) && (structure->id == 0x00)) {
+			fmi = (struct esg_encapsulation_structure *) structure->data;
+		} else if ((structure->type == 0xE0) && (structure->id == 0x00)) {
+			data_repository = (struct esg_data_repository *) structure->data;
+		}
+	}
+	if ((fmi == NULL) || (data_repository == NULL)) {
+		return 0;
+	}
+
+	count = 0;
+	esg_encapsulation_structure_entry_list_for_each(fmi, entry) {
+		count++;
+	}
+	if (count == 0) {
+		return 0;
+	}
+	offsets = (uint32_t *) malloc(count * sizeof(uint32_t));
+	if (offsets == NULL) {
+		return -1;
+	}
+	count = 0;
+	esg_encapsulation_structure_entry_list_for_each(fmi, entry) {
+		offsets[count++] = entry->fragment_reference->data_repository_offset;
+	}
+	qsort(offsets, count, sizeof(uint32_t), esg_fragment_store_compare_offset);
+
+	esg_encapsulation_structure_entry_list_for_each(fmi, entry) {
+		fragment = esg_fragment_store_find(store, entry->fragment_id);
+		if (fragment && (fragment->fragment_version == entry->fragment_version)) {
+			continue;
+		}
+
+		offset = entry->fragment_reference->data_repository_offset;
+		if (offset >= data_repository->length) {
+			continue;
+		}
+		length = esg_fragment_store_fragment_end(offsets, count, offset, data_repository->length) - offset;
+
+		updated = (fragment != NULL);
+		if (fragment == NULL) {
+			fragment = (struct esg_fragment *) malloc(sizeof(struct esg_fragment));
+			if (fragment == NULL) {
+				free(offsets);
+				return -1;
+			}
+			memset(fragment, 0, sizeof(struct esg_fragment));
+			fragment->fragment_id = entry->fragment_id;
+		}
+		data = (uint8_t *) realloc(fragment->data, length);
+		if (data == NULL) {
+			if (!updated) {
+				free(fragment);
+			}
+			free(offsets);
+			return -1;
+		}
+		if (!updated) {
+			fragment->_next = store->hash[fragment->fragment_id % ESG_FRAGMENT_STORE_HASH_SIZE];
+			store->hash[fragment->fragment_id % ESG_FRAGMENT_STORE_HASH_SIZE] = fragment;
+		}
+
+		memcpy(data, data_repository->data + offset, length);
+		fragment->data = data;
+		fragment->length = length;
+		fragment->fragment_type = entry->fragment_reference->fragment_type;
+		fragment->fragment_version = entry->fragment_version;
+		changes++;
+
+		if (store->callback) {
+			store->callback(store->arg, fragment, updated);
+		}
+	}
+
+	dvbstats_add(&esg_stats, ESG_STATS_FRAGMENTS_UPDATED, changes);
+	free(offsets);
+	return changes;
+}
+
+int esg_fragment_store_update(struct esg_fragment_store *store, struct esg_container *container) {
+	int changes;
+
+	if (store == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&store->lock);
+	changes = esg_fragment_store_update_locked(store, container);
+	pthread_mutex_unlock(&store->lock);
+
+	return changes;
+}
+
+static int esg_fragment_store_decode_locked(struct esg_fragment_store *store, uint8_t *buffer, uint32_t size) {
+	struct esg_container *container;
+	int changes;
+
+	if (store->arena == NULL) {
+		store->arena = esg_arena_create(0);
+		if (store->arena == NULL) {
+			return -1;
+		}
+	}
+
+	container = esg_container_decode_arena(store->arena, buffer, size);
+	changes = container ? esg_fragment_store_update_locked(store, container) : -1;
+	esg_arena_release(store->arena);
+
+	return changes;
+}
+
+int esg_fragment_store_decode(struct esg_fragment_store *store, uint8_t *buffer, uint32_t size) {
+	int changes;
+
+	pthread_mutex_lock(&store->lock);
+	changes = esg_fragment_store_decode_locked(store, buffer, size);
+	pthread_mutex_unlock(&store->lock);
+
+	return changes;
+}
+
+static void *esg_fragment_store_worker_func(void *arg) {
+	struct esg_fragment_store_worker *worker = (struct esg_fragment_store_worker *) arg;
+	struct esg_fragment_store *store = worker->store;
+	struct esg_container *container;
+	int i;
+
+	pthread_mutex_lock(&store->batch_lock);
+	while (1) {
+		while (!store->batch_stop && (store->batch_next >= store->batch_count)) {
+			pthread_cond_wait(&store->batch_work, &store->batch_lock);
+		}
+		if (store->batch_stop) {
+			break;
+		}
+		i = store->batch_next++;
+		pthread_mutex_unlock(&store->batch_lock);
+
+		container = esg_container_decode_arena(worker->arena, store->batch_buffers[i], store->batch_sizes[i]);
+
+		pthread_mutex_lock(&store->batch_lock);
+		store->batch_containers[i] = container;
+		if (--store->batch_pending == 0) {
+			pthread_cond_signal(&store->batch_done);
+		}
+	}
+	pthread_mutex_unlock(&store->batch_lock);
+
+	return NULL;
+}
+
+static void esg_fragment_store_stop_workers(struct esg_fragment_store *store) {
+	int i;
+
+	pthread_mutex_lock(&store->batch_lock);
+	store->batch_stop = 1;
+	pthread_cond_broadcast(&store->batch_work);
+	pthread_mutex_unlock(&store->batch_lock);
+
+	for (i = 0; i < store->num_workers; i++) {
+		pthread_join(store->workers[i].thread, NULL);
+		esg_arena_destroy(store->workers[i].arena);
+	}
+	store->num_workers = 0;
+	store->batch_stop = 0;
+}
+
+int esg_fragment_store_set_workers(struct esg_fragment_store *store, int workers) {
+	struct esg_fragment_store_worker *worker;
+
+	if ((store == NULL) || (workers < 0) || (workers > ESG_FRAGMENT_STORE_MAX_WORKERS)) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&store->lock);
+	esg_fragment_store_stop_workers(store);
+	while (store->num_workers < workers) {
+		worker = &store->workers[store->num_workers];
+		worker->store = store;
+		worker->arena = esg_arena_create(0);
+		if (worker->arena == NULL) {
+			break;
+		}
+		if (pthread_create(&worker->thread, NULL, esg_fragment_store_worker_func, worker)) {
+			esg_arena_destroy(worker->arena);
+			break;
+		}
+		store->num_workers++;
+	}
+	if (store->num_workers < workers) {
+		esg_fragment_store_stop_workers(store);
+		pthread_mutex_unlock(&store->lock);
+		return -1;
+	}
+	pthread_mutex_unlock(&store->lock);
+
+	return 0;
+}
+
+int esg_fragment_store_decode_batch(struct esg_fragment_store *store, uint8_t **buffers,
+				    uint32_t *sizes, int count, int *failed) {
+	struct esg_container **containers;
+	int changes = 0;
+	int result;
+	int bad = 0;
+	int i;
+
+	if ((store == NULL) || (buffers == NULL) || (sizes == NULL) || (count < 0)) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&store->lock);
+
+	// Without workers (or anything to share out), one after the other
+	if ((store->num_workers == 0) || (count < 2)) {
+		for (i = 0; i < count; i++) {
+			result = esg_fragment_store_decode_locked(store, buffers[i], sizes[i]);
+			if (result < 0) {
+				bad++;
+			} else {
+				changes += result;
+			}
+		}
+		goto done;
+	}
+
+	containers = (struct esg_container **) malloc(count * sizeof(struct esg_container *));
+	if (containers == NULL) {
+		pthread_mutex_unlock(&store->lock);
+		return -1;
+	}
+
+	pthread_mutex_lock(&store->batch_lock);
+	store->batch_buffers = buffers;
+	store->batch_sizes = sizes;
+	store->batch_containers = containers;
+	store->batch_next = 0;
+	store->batch_pending = count;
+	store->batch_count = count;
+	pthread_cond_broadcast(&store->batch_work);
+	while (store->batch_pending) {
+		pthread_cond_wait(&store->batch_done, &store->batch_lock);
+	}
+	store->batch_count = 0;
+	store->batch_next = 0;
+	pthread_mutex_unlock(&store->batch_lock);
+
+	// Merged in order, so a later container's fragment version wins
+	for (i = 0; i < count; i++) {
+		if (containers[i] == NULL) {
+			bad++;
+			continue;
+		}
+		result = esg_fragment_store_update_locked(store, containers[i]);
+		if (result < 0) {
+			bad++;
+		} else {
+			changes += result;
+		}
+	}
+
+	for (i = 0; i < store->num_workers; i++) {
+		esg_arena_release(store->workers[i].arena);
+	}
+	free(containers);
+
+done:
+	pthread_mutex_unlock(&store->lock);
+	if (failed) {
+		*failed = bad;
+	}
+
+	return changes;
+}
+
+void esg_fragment_store_free(struct esg_fragment_store *store) {
+	struct esg_fragment *fragment;
+	struct esg_fragment *next_fragment;
+	int i;
+
+	if (store == NULL) {
+		return;
+	}
+
+	esg_fragment_store_stop_workers(store);
+
+	for (i = 0; i < ESG_FRAGMENT_STORE_HASH_SIZE; i++) {
+		for (fragment = store->hash[i]; fragment; fragment = next_fragment) {
+			next_fragment = fragment->_next;
+			free(fragment->data);
+			free(fragment);
+		}
+	}
+
+	esg_arena_destroy(store->arena);
+	pthread_cond_destroy(&store->batch_done);
+	pthread_cond_destroy(&store->batch_work);
+	pthread_mutex_destroy(&store->batch_lock);
+	pthread_mutex_destroy(&store->lock);
+	free(store);
+}
@@ -0,0 +1,147 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_ENCAPSULATION_FRAGMENT_STORE_H
+#define _ESG_ENCAPSULATION_FRAGMENT_STORE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libesg/encapsulation/container.h>
+
+/**
+ * esg_fragment structure: the latest version of an ESG fragment.
+ */
+struct esg_fragment {
+	uint32_t fragment_id;
+	uint8_t fragment_type;
+	uint8_t fragment_version;
+	uint32_t length;
+	uint8_t *data;			// as in the data repository
+
+	struct esg_fragment *_next;
+};
+
+/**
+ * An in memory copy of the fragments of an ESG. Containers are applied to it
+ * as they come: only the fragments whose version (in the fragment management
+ * information) changed are copied from the data repository.
+ *
+ * A store may be updated from several threads; updates are applied one at a
+ * time, with the callback called under the store's lock. Finding fragments
+ * is not locked.
+ */
+struct esg_fragment_store;
+
+/**
+ * Most workers a store can have for batch decoding.
+ */
+#define ESG_FRAGMENT_STORE_MAX_WORKERS 32
+
+/**
+ * Called for each fragment added to or updated in a store.
+ *
+ * @param arg The argument given to esg_fragment_store_create().
+ * @param fragment The fragment.
+ * @param updated 0 if the fragment is new, 1 if it replaces an older version.
+ */
+typedef void (*esg_fragment_store_callback)(void *arg, struct esg_fragment *fragment, int updated);
+
+/**
+ * Create an esg_fragment_store.
+ *
+ * @param callback Called for each change, or NULL.
+ * @param arg Argument for callback.
+ * @return Pointer to the store, or NULL on error.
+ */
+extern struct esg_fragment_store *esg_fragment_store_create(esg_fragment_store_callback callback, void *arg);
+
+/**
+ * Apply a decoded container to a store.
+ *
+ * @param store Pointer to an esg_fragment_store.
+ * @param container The container.
+ * @return The number of fragments added or updated, or -1 on error.
+ */
+extern int esg_fragment_store_update(struct esg_fragment_store *store, struct esg_container *container);
+
+/**
+ * Decode a container and apply it to a store. The container is decoded in an
+ * arena kept by the store, without copying it.
+ *
+ * @param store Pointer to an esg_fragment_store.
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return The number of fragments added or updated, or -1 on error.
+ */
+extern int esg_fragment_store_decode(struct esg_fragment_store *store, uint8_t *buffer, uint32_t size);
+
+/**
+ * Set the number of worker threads esg_fragment_store_decode_batch() uses.
+ * Each worker decodes into an arena of its own. With no workers (the
+ * default), batches are decoded by the calling thread.
+ *
+ * @param store Pointer to an esg_fragment_store.
+ * @param workers Number of workers, 0 to ESG_FRAGMENT_STORE_MAX_WORKERS.
+ * @return 0 on success, or -1 on error (the store then has no workers).
+ */
+extern int esg_fragment_store_set_workers(struct esg_fragment_store *store, int workers);
+
+/**
+ * Decode a burst of containers and apply them to a store. The containers are
+ * decoded in parallel by the store's workers, without copying them, then
+ * applied in the order given, as esg_fragment_store_decode() would one
+ * after the other.
+ *
+ * @param store Pointer to an esg_fragment_store.
+ * @param buffers The binary buffers to decode.
+ * @param sizes Their sizes.
+ * @param count Number of buffers.
+ * @param failed Set to the number of containers which could not be decoded
+ * (and were skipped), or NULL.
+ * @return The number of fragments added or updated, or -1 on error.
+ */
+extern int esg_fragment_store_decode_batch(struct esg_fragment_store *store, uint8_t **buffers,
+					   uint32_t *sizes, int count, int *failed);
+
+/**
+ * Find a fragment in a store.
+ *
+ * @param store Pointer to an esg_fragment_store.
+ * @param fragment_id The fragment's id.
+ * @return Pointer to the fragment, or NULL if it is not there.
+ */
+extern struct esg_fragment *esg_fragment_store_find(struct esg_fragment_store *store, uint32_t fragment_id);
+
+/**
+ * Free an esg_fragment_store, with its fragments.
+ *
+ * @param store Pointer to an esg_fragment_store.
+ */
+extern void esg_fragment_store_free(struct esg_fragment_store *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
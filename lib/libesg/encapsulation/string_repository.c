@@ -23,6 +23,30 @@
 
 #include <libesg/encapsulation/string_repository.h>
 
+struct esg_string_repository_entry {
+	uint32_t ptr;
+	uint32_t length;
+	uint8_t *string;
+	uint32_t used;
+};
+
+struct esg_string_repository_lazy {
+	// Offsets of the terminating NULs, ascending
+	uint32_t num_strings;
+	uint32_t *terminators;
+
+	uint32_t clock;
+	struct esg_string_repository_entry cache[ESG_STRING_REPOSITORY_CACHE_SIZE];
+};
+
+static uint32_t esg_string_repository_unit(uint8_t encoding_type) {
+	return (encoding_type == ESG_STRING_REPOSITORY_UTF16) ? 2 : 1;
+}
+
+static int esg_string_repository_is_nul(const uint8_t *data, uint32_t unit) {
+	return (unit == 2) ? ((data[0] == 0) && (data[1] == 0)) : (data[0] == 0);
+}
+
 struct esg_string_repository *esg_string_repository_decode(uint8_t *buffer, uint32_t size) {
 	struct esg_string_repository *string_repository;
 
@@ -41,12 +65,240 @@ struct esg_string_repository *esg_string_repository_decode(uint8_t *buffer, uint
 	return string_repository;
 }
 
+struct esg_string_repository *esg_string_repository_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size) {
+	struct esg_string_repository *string_repository;
+
+	if ((arena == NULL) || (buffer == NULL) || (size <= 1)) {
+		return NULL;
+	}
+
+	string_repository = (struct esg_string_repository *) esg_arena_alloc(arena, sizeof(struct esg_string_repository));
+	if (string_repository == NULL) {
+		return NULL;
+	}
+
+	// A view of the buffer, no copy
+	string_repository->encoding_type = buffer[0];
+	string_repository->length = size-1;
+	string_repository->data = buffer+1;
+
+	return string_repository;
+}
+
+struct esg_string_repository *esg_string_repository_decode_lazy(uint8_t *buffer, uint32_t size) {
+	struct esg_string_repository *string_repository;
+	struct esg_string_repository_lazy *lazy;
+	uint32_t unit;
+	uint32_t pos;
+	uint32_t count;
+
+	if ((buffer == NULL) || (size <= 1)) {
+		return NULL;
+	}
+
+	string_repository = (struct esg_string_repository *) malloc(sizeof(struct esg_string_repository));
+	if (string_repository == NULL) {
+		return NULL;
+	}
+	memset(string_repository, 0, sizeof(struct esg_string_repository));
+
+	lazy = (struct esg_string_repository_lazy *) malloc(sizeof(struct esg_string_repository_lazy));
+	if (lazy == NULL) {
+		free(string_repository);
+		return NULL;
+	}
+	memset(lazy, 0, sizeof(struct esg_string_repository_lazy));
+
+	string_repository->encoding_type = buffer[0];
+	string_repository->length = size-1;
+	string_repository->data = buffer+1;
+	string_repository->lazy = lazy;
+
+	// Index the strings: count them, then note where each ends
+	unit = esg_string_repository_unit(string_repository->encoding_type);
+	count = 0;
+	for (pos = 0; pos + unit <= string_repository->length; pos += unit) {
+		if (esg_string_repository_is_nul(string_repository->data + pos, unit)) {
+			count++;
+		}
+	}
+	if (count == 0) {
+		return string_repository;
+	}
+
+	lazy->terminators = (uint32_t *) malloc(count * sizeof(uint32_t));
+	if (lazy->terminators == NULL) {
+		esg_string_repository_free(string_repository);
+		return NULL;
+	}
+	for (pos = 0; pos + unit <= string_repository->length; pos += unit) {
+		if (esg_string_repository_is_nul(string_repository->data + pos, unit)) {
+			lazy->terminators[lazy->num_strings++] = pos;
+		}
+	}
+
+	return string_repository;
+}
+
+static uint8_t *esg_string_repository_decode_utf16(const uint8_t *data, uint32_t units, uint32_t *length) {
+	uint8_t *string;
+	uint8_t *out;
+	uint32_t c, c2;
+	uint32_t i;
+
+	// At most 3 bytes a unit: a surrogate pair makes 4 of 2 units
+	string = (uint8_t *) malloc(units * 3 + 1);
+	if (string == NULL) {
+		return NULL;
+	}
+
+	out = string;
+	for (i = 0; i < units; i++) {
+		c = (data[i*2] << 8) | data[i*2+1];
+		if ((c >= 0xD800) && (c < 0xDC00) && (i + 1 < units)) {
+			c2 = (data[i*2+2] << 8) | data[i*2+3];
+			if ((c2 >= 0xDC00) && (c2 < 0xE000)) {
+				c = 0x10000 + ((c - 0xD800) << 10) + (c2 - 0xDC00);
+				i++;
+			}
+		}
+		if ((c >= 0xD800) && (c < 0xE000)) {
+			// Unpaired surrogate
+			c = 0xFFFD;
+		}
+
+		if (c < 0x80) {
+			*out++ = c;
+		} else if (c < 0x800) {
+			*out++ = 0xC0 | (c >> 6);
+			*out++ = 0x80 | (c & 0x3F);
+		} else if (c < 0x10000) {
+			*out++ = 0xE0 | (c >> 12);
+			*out++ = 0x80 | ((c >> 6) & 0x3F);
+			*out++ = 0x80 | (c & 0x3F);
+		} else {
+			*out++ = 0xF0 | (c >> 18);
+			*out++ = 0x80 | ((c >> 12) & 0x3F);
+			*out++ = 0x80 | ((c >> 6) & 0x3F);
+			*out++ = 0x80 | (c & 0x3F);
+		}
+	}
+	*out = 0;
+	*length = out - string;
+
+	return string;
+}
+
+static const uint8_t *esg_string_repository_get_lazy(struct esg_string_repository *string_repository, uint32_t ptr, uint32_t *length) {
+	struct esg_string_repository_lazy *lazy = string_repository->lazy;
+	struct esg_string_repository_entry *entry;
+	struct esg_string_repository_entry *victim;
+	uint32_t unit;
+	uint32_t low, high, mid;
+	int i;
+
+	unit = esg_string_repository_unit(string_repository->encoding_type);
+	if ((ptr % unit) != 0) {
+		return NULL;
+	}
+
+	// The first string ending at or after ptr holds it
+	low = 0;
+	high = lazy->num_strings;
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (lazy->terminators[mid] < ptr) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+	if (low == lazy->num_strings) {
+		return NULL;
+	}
+
+	if (string_repository->encoding_type == ESG_STRING_REPOSITORY_UTF8) {
+		*length = lazy->terminators[low] - ptr;
+		return string_repository->data + ptr;
+	}
+	if (string_repository->encoding_type != ESG_STRING_REPOSITORY_UTF16) {
+		return NULL;
+	}
+
+	// Decoded already, or decode over the least recently used entry
+	lazy->clock++;
+	victim = &lazy->cache[0];
+	for (i = 0; i < ESG_STRING_REPOSITORY_CACHE_SIZE; i++) {
+		entry = &lazy->cache[i];
+		if ((entry->string != NULL) && (entry->ptr == ptr)) {
+			entry->used = lazy->clock;
+			*length = entry->length;
+			return entry->string;
+		}
+		if (entry->used < victim->used) {
+			victim = entry;
+		}
+	}
+
+	if (victim->string) {
+		free(victim->string);
+	}
+	victim->ptr = ptr;
+	victim->used = lazy->clock;
+	victim->string = esg_string_repository_decode_utf16(string_repository->data + ptr,
+							    (lazy->terminators[low] - ptr) / 2,
+							    &victim->length);
+	if (victim->string == NULL) {
+		victim->used = 0;
+		return NULL;
+	}
+
+	*length = victim->length;
+	return victim->string;
+}
+
+const uint8_t *esg_string_repository_get(struct esg_string_repository *string_repository, uint32_t ptr, uint32_t *length) {
+	const uint8_t *end;
+
+	if ((string_repository == NULL) || (length == NULL)) {
+		return NULL;
+	}
+
+	if (string_repository->lazy) {
+		return esg_string_repository_get_lazy(string_repository, ptr, length);
+	}
+
+	if ((string_repository->encoding_type != ESG_STRING_REPOSITORY_UTF8) || (ptr >= string_repository->length)) {
+		return NULL;
+	}
+	end = (const uint8_t *) memchr(string_repository->data + ptr, 0, string_repository->length - ptr);
+	if (end == NULL) {
+		return NULL;
+	}
+	*length = end - (string_repository->data + ptr);
+
+	return string_repository->data + ptr;
+}
+
 void esg_string_repository_free(struct esg_string_repository *string_repository) {
+	int i;
+
 	if (string_repository == NULL) {
 		return;
 	}
 
-	if (string_repository->data) {
+	if (string_repository->lazy) {
+		// The data is a view of the buffer
+		for (i = 0; i < ESG_STRING_REPOSITORY_CACHE_SIZE; i++) {
+			if (string_repository->lazy->cache[i].string) {
+				free(string_repository->lazy->cache[i].string);
+			}
+		}
+		if (string_repository->lazy->terminators) {
+			free(string_repository->lazy->terminators);
+		}
+		free(string_repository->lazy);
+	} else if (string_repository->data) {
 		free(string_repository->data);
 	}
 
@@ -27,14 +27,31 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/arena.h>
 
 /**
- * esg_string_repository structure.
+ * String encoding types.
+ */
+#define ESG_STRING_REPOSITORY_UTF8 0x00
+#define ESG_STRING_REPOSITORY_UTF16 0x01
+
+/**
+ * Number of decoded strings a lazy string repository keeps.
+ */
+#define ESG_STRING_REPOSITORY_CACHE_SIZE 32
+
+struct esg_string_repository_lazy;
+
+/**
+ * esg_string_repository structure. The strings are NUL terminated and
+ * referenced by their byte offset into data.
  */
 struct esg_string_repository {
 	uint8_t encoding_type;
 	uint32_t length;
 	uint8_t *data;
+
+	struct esg_string_repository_lazy *lazy;
 };
 
 /**
@@ -46,6 +63,45 @@ struct esg_string_repository {
  */
 extern struct esg_string_repository *esg_string_repository_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Process an esg_string_repository into an arena. Its data is not copied but
+ * points into buffer, which must be kept as long as the arena is not released.
+ *
+ * @param arena Pointer to an esg_arena holding the result.
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return Pointer to an esg_string_repository structure, or NULL on error.
+ */
+extern struct esg_string_repository *esg_string_repository_decode_arena(struct esg_arena *arena, uint8_t *buffer, uint32_t size);
+
+/**
+ * Process an esg_string_repository lazily: only the string offsets are
+ * indexed, a string is decoded to UTF-8 when it is first got, and the last
+ * ESG_STRING_REPOSITORY_CACHE_SIZE decoded strings are kept. UTF-8 strings
+ * need no decoding and are returned in place. Its data is not copied but
+ * points into buffer, which must be kept as long as the repository.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return Pointer to an esg_string_repository structure, or NULL on error.
+ */
+extern struct esg_string_repository *esg_string_repository_decode_lazy(uint8_t *buffer, uint32_t size);
+
+/**
+ * Get a string of an esg_string_repository as UTF-8. Other encodings than
+ * UTF-8 are only decoded by a lazy repository.
+ *
+ * The string stays valid as long as the repository if it is UTF-8, otherwise
+ * until ESG_STRING_REPOSITORY_CACHE_SIZE other strings have been got since.
+ * Getting strings of a lazy repository is not thread safe.
+ *
+ * @param string_repository Pointer to an esg_string_repository structure.
+ * @param ptr Byte offset of the string.
+ * @param length Set to the length of the string, without the terminating NUL.
+ * @return Pointer to the NUL terminated string, or NULL on error.
+ */
+extern const uint8_t *esg_string_repository_get(struct esg_string_repository *string_repository, uint32_t ptr, uint32_t *length);
+
 /**
  * Free an esg_string_repository.
  *
@@ -0,0 +1,226 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_READER_H
+#define _ESG_READER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <endian.h>
+
+/**
+ * A big-endian bitstream reader over a buffer, shared by the decoders.
+ *
+ * Bits are served from a 64-bit cache, left aligned, which is refilled eight
+ * bytes at a time; the end of the buffer is only looked at on a refill.
+ * Reading past the end returns zeroes and sets overrun, which stays set, so
+ * a decoder reads a whole structure and checks esg_reader_ok() once, rather
+ * than testing the size before each field.
+ */
+struct esg_reader {
+	const uint8_t *pos;	/* next byte to load into the cache */
+	const uint8_t *end;
+	uint64_t cache;
+	unsigned int bits;	/* valid bits at the top of cache */
+	int overrun;
+};
+
+/**
+ * Start reading a buffer.
+ *
+ * @param reader The reader.
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ */
+static inline void esg_reader_init(struct esg_reader *reader, const uint8_t *buffer, uint32_t size) {
+	reader->pos = buffer;
+	reader->end = buffer + size;
+	reader->cache = 0;
+	reader->bits = 0;
+	reader->overrun = 0;
+}
+
+static inline void esg_reader_refill(struct esg_reader *reader) {
+	uint64_t value;
+
+	if (reader->end - reader->pos >= 8) {
+		// The bytes beyond the whole ones counted are loaded again next time
+		memcpy(&value, reader->pos, 8);
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+		value = bswap_64(value);
+#endif
+		reader->cache |= value >> reader->bits;
+		reader->pos += (63 - reader->bits) >> 3;
+		reader->bits |= 56;
+		return;
+	}
+
+	while ((reader->bits <= 56) && (reader->pos < reader->end)) {
+		reader->cache |= (uint64_t) *reader->pos++ << (56 - reader->bits);
+		reader->bits += 8;
+	}
+}
+
+/**
+ * Read bits.
+ *
+ * @param reader The reader.
+ * @param count Number of bits, 1 to 56.
+ * @return The value, or 0 past the end of the buffer.
+ */
+static inline uint64_t esg_reader_bits(struct esg_reader *reader, unsigned int count) {
+	uint64_t value;
+
+	if (reader->bits < count) {
+		esg_reader_refill(reader);
+		if (reader->bits < count) {
+			reader->overrun = 1;
+			reader->cache = 0;
+			reader->bits = 0;
+			reader->pos = reader->end;
+			return 0;
+		}
+	}
+
+	value = reader->cache >> (64 - count);
+	reader->cache <<= count;
+	reader->bits -= count;
+
+	return value;
+}
+
+static inline uint8_t esg_reader_u8(struct esg_reader *reader) {
+	return esg_reader_bits(reader, 8);
+}
+
+static inline uint16_t esg_reader_u16(struct esg_reader *reader) {
+	return esg_reader_bits(reader, 16);
+}
+
+static inline uint32_t esg_reader_u24(struct esg_reader *reader) {
+	return esg_reader_bits(reader, 24);
+}
+
+static inline uint32_t esg_reader_u32(struct esg_reader *reader) {
+	return esg_reader_bits(reader, 32);
+}
+
+/**
+ * Read a big-endian integer of 0 to 8 bytes.
+ */
+static inline uint64_t esg_reader_bytes(struct esg_reader *reader, unsigned int count) {
+	if (count > 4) {
+		uint64_t high = esg_reader_bits(reader, (count - 4) * 8);
+
+		return (high << 32) | esg_reader_bits(reader, 32);
+	}
+
+	return count ? esg_reader_bits(reader, count * 8) : 0;
+}
+
+/**
+ * Read a vluimsbf8 length.
+ *
+ * @param reader The reader.
+ * @return The length, or 0 past the end of the buffer.
+ */
+static inline uint32_t esg_reader_vluimsbf8(struct esg_reader *reader) {
+	uint32_t length = 0;
+	uint8_t byte;
+
+	do {
+		byte = esg_reader_u8(reader);
+		length = (length << 7) | (byte & 0x7F);
+	} while (byte & 0x80);
+
+	return reader->overrun ? 0 : length;
+}
+
+/**
+ * The current byte, for a view of the buffer; the reader must be byte aligned.
+ */
+static inline const uint8_t *esg_reader_ptr(struct esg_reader *reader) {
+	return reader->pos - (reader->bits >> 3);
+}
+
+/**
+ * Bytes left in the buffer; the reader must be byte aligned.
+ */
+static inline uint32_t esg_reader_remaining(struct esg_reader *reader) {
+	return reader->end - esg_reader_ptr(reader);
+}
+
+/**
+ * Skip bytes, typically after taking a view of them with esg_reader_ptr();
+ * the reader must be byte aligned.
+ *
+ * @param reader The reader.
+ * @param count Number of bytes.
+ */
+static inline void esg_reader_skip(struct esg_reader *reader, uint32_t count) {
+	const uint8_t *pos = esg_reader_ptr(reader);
+
+	if ((uint32_t) (reader->end - pos) < count) {
+		reader->overrun = 1;
+		pos = reader->end;
+	} else {
+		pos += count;
+	}
+	reader->pos = pos;
+	reader->cache = 0;
+	reader->bits = 0;
+}
+
+/**
+ * Copy bytes out of the buffer; the reader must be byte aligned.
+ *
+ * @param reader The reader.
+ * @param dest Where to put them; zeroed past the end of the buffer.
+ * @param count Number of bytes.
+ */
+static inline void esg_reader_copy(struct esg_reader *reader, void *dest, uint32_t count) {
+	const uint8_t *pos = esg_reader_ptr(reader);
+
+	if ((uint32_t) (reader->end - pos) < count) {
+		memset(dest, 0, count);
+	} else {
+		memcpy(dest, pos, count);
+	}
+	esg_reader_skip(reader, count);
+}
+
+/**
+ * @return Nonzero if nothing was read past the end of the buffer.
+ */
+static inline int esg_reader_ok(struct esg_reader *reader) {
+	return !reader->overrun;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,42 +21,62 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <libesg/types.h>
+#include <libesg/reader.h>
 #include <libesg/representation/encapsulated_textual_esg_xml_fragment.h>
 
 struct esg_encapsulated_textual_esg_xml_fragment *esg_encapsulated_textual_esg_xml_fragment_decode(uint8_t *buffer, uint32_t size) {
 	struct esg_encapsulated_textual_esg_xml_fragment *esg_xml_fragment;
-	uint32_t pos;
+	struct esg_reader reader;
 	uint32_t length;
-	uint8_t offset_pos;
 
 	if ((buffer == NULL) || (size <= 0)) {
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
 	esg_xml_fragment = (struct esg_encapsulated_textual_esg_xml_fragment *) malloc(sizeof(struct esg_encapsulated_textual_esg_xml_fragment));
 	memset(esg_xml_fragment, 0, sizeof(struct esg_encapsulated_textual_esg_xml_fragment));
 
-	offset_pos = vluimsbf8(buffer+pos+2, size-pos-2, &length);
+	esg_xml_fragment->esg_xml_fragment_type = esg_reader_u16(&reader);
+	length = esg_reader_vluimsbf8(&reader);
 
-	if (size-pos-2 < offset_pos+length) {
+	if (!esg_reader_ok(&reader) || (esg_reader_remaining(&reader) < length)) {
 		esg_encapsulated_textual_esg_xml_fragment_free(esg_xml_fragment);
 		return NULL;
 	}
 
-	esg_xml_fragment->esg_xml_fragment_type = (buffer[pos] << 8) | buffer[pos+1];
-	pos += 2+offset_pos;
-
 	esg_xml_fragment->data_length = length;
 	esg_xml_fragment->data = (uint8_t *) malloc(length);
-	memcpy(esg_xml_fragment->data, buffer+pos, length);
-	pos += length;
+	esg_reader_copy(&reader, esg_xml_fragment->data, length);
 
 	return esg_xml_fragment;
 }
 
+int esg_encapsulated_textual_esg_xml_fragment_parse(struct esg_xml_parser *parser, uint8_t *buffer, uint32_t size, uint16_t *esg_xml_fragment_type) {
+	struct esg_reader reader;
+	uint16_t type;
+	uint32_t length;
+
+	if ((buffer == NULL) || (size < 3)) {
+		return -1;
+	}
+
+	esg_reader_init(&reader, buffer, size);
+	type = esg_reader_u16(&reader);
+	length = esg_reader_vluimsbf8(&reader);
+
+	if (!esg_reader_ok(&reader) || (esg_reader_remaining(&reader) < length)) {
+		return -1;
+	}
+
+	if (esg_xml_fragment_type) {
+		*esg_xml_fragment_type = type;
+	}
+
+	return esg_xml_parser_parse(parser, (uint8_t *) esg_reader_ptr(&reader), length);
+}
+
 void esg_encapsulated_textual_esg_xml_fragment_free(struct esg_encapsulated_textual_esg_xml_fragment *esg_xml_fragment) {
 	if (esg_xml_fragment == NULL) {
 		return;
@@ -27,6 +27,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <libesg/representation/xml_parser.h>
 
 /**
  * esg_encapsulated_textual_esg_xml_fragment structure.
@@ -46,6 +47,18 @@ struct esg_encapsulated_textual_esg_xml_fragment {
  */
 extern struct esg_encapsulated_textual_esg_xml_fragment *esg_encapsulated_textual_esg_xml_fragment_decode(uint8_t *buffer, uint32_t size);
 
+/**
+ * Parse an esg_encapsulated_textual_esg_xml_fragment in place, without copying
+ * its data, passing its XML tokens to the handler of an esg_xml_parser.
+ *
+ * @param parser Pointer to an esg_xml_parser structure.
+ * @param buffer Binary buffer to parse.
+ * @param size Binary buffer size.
+ * @param esg_xml_fragment_type Where to store the fragment type, may be NULL.
+ * @return As esg_xml_parser_parse, -1 also when the buffer is too short.
+ */
+extern int esg_encapsulated_textual_esg_xml_fragment_parse(struct esg_xml_parser *parser, uint8_t *buffer, uint32_t size, uint16_t *esg_xml_fragment_type);
+
 /**
  * Free an esg_encapsulated_textual_esg_xml_fragment.
  *
@@ -24,32 +24,28 @@
 #include <libesg/representation/init_message.h>
 #include <libesg/representation/textual_decoder_init.h>
 #include <libesg/representation/bim_decoder_init.h>
+#include <libesg/reader.h>
 
 struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size) {
-	uint32_t pos;
+	struct esg_reader reader;
 	struct esg_init_message *init_message;
 
 	if ((buffer == NULL) || (size <= 3)) {
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
 	init_message = (struct esg_init_message *) malloc(sizeof(struct esg_init_message));
 	memset(init_message, 0, sizeof(struct esg_init_message));
 
-	init_message->encoding_version = buffer[pos];
-	pos += 1;
-
-	init_message->indexing_flag = (buffer[pos] & 0x80) >> 7;
-	pos += 1;
-
-	init_message->decoder_init_ptr = buffer[pos];
-	pos += 1;
+	init_message->encoding_version = esg_reader_u8(&reader);
+	init_message->indexing_flag = esg_reader_bits(&reader, 1);
+	esg_reader_bits(&reader, 7); // reserved
+	init_message->decoder_init_ptr = esg_reader_u8(&reader);
 
 	if (init_message->indexing_flag) {
-		init_message->indexing_version = buffer[pos];
-		pos += 1;
+		init_message->indexing_version = esg_reader_u8(&reader);
 	}
 
 	switch (init_message->encoding_version) {
@@ -58,16 +54,13 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 			memset(encoding_parameters, 0, sizeof(struct esg_bim_encoding_parameters));
 			init_message->encoding_parameters = (void *) encoding_parameters;
 
-			encoding_parameters->buffer_size_flag = (buffer[pos] & 0x80) >> 7;
-			encoding_parameters->position_code_flag = (buffer[pos] & 0x40) >> 6;
-			pos += 1;
-
-			encoding_parameters->character_encoding = buffer[pos];
-			pos += 1;
+			encoding_parameters->buffer_size_flag = esg_reader_bits(&reader, 1);
+			encoding_parameters->position_code_flag = esg_reader_bits(&reader, 1);
+			esg_reader_bits(&reader, 6); // reserved
+			encoding_parameters->character_encoding = esg_reader_u8(&reader);
 
 			if (encoding_parameters->buffer_size_flag) {
-				encoding_parameters->buffer_size = (buffer[pos] << 16) | (buffer[pos+1] << 8) | buffer[pos+2];
-				pos += 3;
+				encoding_parameters->buffer_size = esg_reader_u24(&reader);
 			}
 
 // TODO
@@ -80,8 +73,11 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 			memset(encoding_parameters, 0, sizeof(struct esg_textual_encoding_parameters));
 			init_message->encoding_parameters = (void *) encoding_parameters;
 
-			encoding_parameters->character_encoding = buffer[pos];
-			pos += 1;
+			encoding_parameters->character_encoding = esg_reader_u8(&reader);
+			if (!esg_reader_ok(&reader) || (size < init_message->decoder_init_ptr)) {
+				esg_init_message_free(init_message);
+				return NULL;
+			}
 
 			init_message->decoder_init = (void *) esg_textual_decoder_init_decode(buffer + init_message->decoder_init_ptr, size - init_message->decoder_init_ptr);
 			break;
@@ -92,6 +88,11 @@ struct esg_init_message *esg_init_message_decode(uint8_t *buffer, uint32_t size)
 		}
 	}
 
+	if (!esg_reader_ok(&reader)) {
+		esg_init_message_free(init_message);
+		return NULL;
+	}
+
 	return init_message;
 }
 
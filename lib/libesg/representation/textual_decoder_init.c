@@ -21,11 +21,11 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <libesg/types.h>
+#include <libesg/reader.h>
 #include <libesg/representation/textual_decoder_init.h>
 
 struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer, uint32_t size) {
-	uint32_t pos;
+	struct esg_reader reader;
 	struct esg_textual_decoder_init *decoder_init;
 	struct esg_namespace_prefix *namespace_prefix;
 	struct esg_namespace_prefix *last_namespace_prefix;
@@ -38,25 +38,25 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
 	decoder_init = (struct esg_textual_decoder_init *) malloc(sizeof(struct esg_textual_decoder_init));
 	memset(decoder_init, 0, sizeof(struct esg_textual_decoder_init));
 	decoder_init->namespace_prefix_list = NULL;
 	decoder_init->xml_fragment_type_list = NULL;
 
-	decoder_init->version = buffer[pos];
-	pos += 1;
+	decoder_init->version = esg_reader_u8(&reader);
+	decoder_init_length = esg_reader_vluimsbf8(&reader);
 
-	pos += vluimsbf8(buffer+pos, size-pos, &decoder_init_length);
-
-	if (size < pos + decoder_init_length) {
+	if (!esg_reader_ok(&reader) || (esg_reader_remaining(&reader) < decoder_init_length)) {
 		esg_textual_decoder_init_free(decoder_init);
 		return NULL;
 	}
 
-	decoder_init->num_namespace_prefixes = buffer[pos];
-	pos += 1;
+	// Only the decoder init is read, whatever follows it
+	esg_reader_init(&reader, esg_reader_ptr(&reader), decoder_init_length);
+
+	decoder_init->num_namespace_prefixes = esg_reader_u8(&reader);
 
 	last_namespace_prefix = NULL;
 	for (num_index = 0; num_index < decoder_init->num_namespace_prefixes; num_index++) {
@@ -71,15 +71,11 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 		}
 		last_namespace_prefix = namespace_prefix;
 
-		namespace_prefix->prefix_string_ptr = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
-
-		namespace_prefix->namespace_uri_ptr = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+		namespace_prefix->prefix_string_ptr = esg_reader_u16(&reader);
+		namespace_prefix->namespace_uri_ptr = esg_reader_u16(&reader);
 	}
 
-	decoder_init->num_fragment_types = buffer[pos];
-	pos += 1;
+	decoder_init->num_fragment_types = esg_reader_u8(&reader);
 
 	last_xml_fragment_type = NULL;
 	for (num_index = 0; num_index < decoder_init->num_fragment_types; num_index++) {
@@ -94,11 +90,13 @@ struct esg_textual_decoder_init *esg_textual_decoder_init_decode(uint8_t *buffer
 		}
 		last_xml_fragment_type = xml_fragment_type;
 
-		xml_fragment_type->xpath_ptr = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+		xml_fragment_type->xpath_ptr = esg_reader_u16(&reader);
+		xml_fragment_type->xml_fragment_type = esg_reader_u16(&reader);
+	}
 
-		xml_fragment_type->xml_fragment_type = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+	if (!esg_reader_ok(&reader)) {
+		esg_textual_decoder_init_free(decoder_init);
+		return NULL;
 	}
 
 	return decoder_init;
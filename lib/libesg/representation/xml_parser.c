@@ -0,0 +1,574 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <libesg/representation/xml_parser.h>
+
+static const char esg_xml_namespace_uri[] = "http://www.w3.org/XML/1998/namespace";
+
+static int esg_xml_is_space(uint8_t c) {
+	return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+}
+
+static int esg_xml_is_name(uint8_t c) {
+	return ((c >= 'a') && (c <= 'z')) || ((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')) ||
+	       (c == '_') || (c == ':') || (c == '-') || (c == '.') || (c >= 0x80);
+}
+
+static uint32_t esg_xml_skip_space(const uint8_t *buffer, uint32_t size, uint32_t pos) {
+	while ((pos < size) && esg_xml_is_space(buffer[pos])) {
+		pos++;
+	}
+
+	return pos;
+}
+
+static uint32_t esg_xml_name(const uint8_t *buffer, uint32_t size, uint32_t pos, struct esg_xml_string *name) {
+	name->data = buffer + pos;
+	while ((pos < size) && esg_xml_is_name(buffer[pos])) {
+		pos++;
+	}
+	name->length = buffer + pos - name->data;
+
+	return pos;
+}
+
+static uint32_t esg_xml_find(const uint8_t *buffer, uint32_t size, uint32_t pos, const char *token) {
+	uint32_t length = strlen(token);
+
+	for (; pos + length <= size; pos++) {
+		if (memcmp(buffer + pos, token, length) == 0) {
+			return pos;
+		}
+	}
+
+	return size;
+}
+
+static int esg_xml_starts_with(const uint8_t *buffer, uint32_t size, uint32_t pos, const char *token) {
+	uint32_t length = strlen(token);
+
+	return (pos + length <= size) && (memcmp(buffer + pos, token, length) == 0);
+}
+
+static int esg_xml_string_compare(struct esg_xml_string *a, struct esg_xml_string *b) {
+	return (a->length == b->length) && (memcmp(a->data, b->data, a->length) == 0);
+}
+
+int esg_xml_string_equal(struct esg_xml_string *string, const char *value) {
+	uint32_t length = strlen(value);
+
+	return (string->length == length) && (memcmp(string->data, value, length) == 0);
+}
+
+static void esg_xml_split(struct esg_xml_string *qname, struct esg_xml_string *prefix, struct esg_xml_string *name) {
+	const uint8_t *colon = (const uint8_t *) memchr(qname->data, ':', qname->length);
+
+	if (colon == NULL) {
+		prefix->data = qname->data;
+		prefix->length = 0;
+		*name = *qname;
+	} else {
+		prefix->data = qname->data;
+		prefix->length = colon - qname->data;
+		name->data = colon + 1;
+		name->length = qname->length - prefix->length - 1;
+	}
+}
+
+static int esg_xml_declare(struct esg_xml_parser *parser, struct esg_xml_string *prefix, struct esg_xml_string *uri, int depth) {
+	struct esg_xml_namespace *namespace;
+
+	if (parser->num_namespaces == ESG_XML_MAX_NAMESPACES) {
+		return -1;
+	}
+
+	namespace = &parser->namespaces[parser->num_namespaces++];
+	namespace->prefix = *prefix;
+	namespace->uri = *uri;
+	namespace->depth = depth;
+
+	return 0;
+}
+
+static int esg_xml_resolve(struct esg_xml_parser *parser, struct esg_xml_string *prefix, struct esg_xml_string *uri) {
+	int i;
+
+	for (i = parser->num_namespaces - 1; i >= 0; i--) {
+		if (esg_xml_string_compare(&parser->namespaces[i].prefix, prefix)) {
+			*uri = parser->namespaces[i].uri;
+			return 0;
+		}
+	}
+
+	if (esg_xml_string_equal(prefix, "xml")) {
+		uri->data = (const uint8_t *) esg_xml_namespace_uri;
+		uri->length = sizeof(esg_xml_namespace_uri) - 1;
+		return 0;
+	}
+
+	// no default namespace, an unknown prefix is an error
+	uri->data = prefix->data;
+	uri->length = 0;
+
+	return (prefix->length == 0) ? 0 : -1;
+}
+
+static int esg_xml_resolve_qname(struct esg_xml_parser *parser, struct esg_xml_string *qname, struct esg_xml_string *uri, struct esg_xml_string *name) {
+	struct esg_xml_string prefix;
+
+	esg_xml_split(qname, &prefix, name);
+	if (name->length == 0) {
+		return -1;
+	}
+
+	return esg_xml_resolve(parser, &prefix, uri);
+}
+
+static int esg_xml_end_element(struct esg_xml_parser *parser) {
+	struct esg_xml_string uri;
+	struct esg_xml_string name;
+	int result = 0;
+
+	if (esg_xml_resolve_qname(parser, &parser->elements[parser->depth - 1], &uri, &name)) {
+		return -1;
+	}
+
+	if (parser->handler->end_element) {
+		result = parser->handler->end_element(parser->arg, &uri, &name);
+	}
+
+	while ((parser->num_namespaces > parser->num_base_namespaces) &&
+	       (parser->namespaces[parser->num_namespaces - 1].depth == parser->depth)) {
+		parser->num_namespaces--;
+	}
+	parser->depth--;
+
+	return result;
+}
+
+static int esg_xml_start_element(struct esg_xml_parser *parser, const uint8_t *buffer, uint32_t size, uint32_t *ppos) {
+	struct esg_xml_string qname;
+	struct esg_xml_string attribute_qname;
+	struct esg_xml_string prefix;
+	struct esg_xml_string name;
+	struct esg_xml_string value;
+	struct esg_xml_string uri;
+	struct esg_xml_attribute *attribute;
+	uint32_t pos = *ppos;
+	uint32_t end;
+	int empty = 0;
+	int count = 0;
+	int result = 0;
+	int i;
+
+	pos = esg_xml_name(buffer, size, pos, &qname);
+	if ((qname.length == 0) || (parser->depth == ESG_XML_MAX_DEPTH)) {
+		return -1;
+	}
+
+	while (1) {
+		end = esg_xml_skip_space(buffer, size, pos);
+		if (end >= size) {
+			return -1;
+		}
+		if (buffer[end] == '>') {
+			pos = end + 1;
+			break;
+		}
+		if (buffer[end] == '/') {
+			if ((end + 1 >= size) || (buffer[end + 1] != '>')) {
+				return -1;
+			}
+			pos = end + 2;
+			empty = 1;
+			break;
+		}
+		if (end == pos) {
+			return -1;
+		}
+
+		pos = esg_xml_name(buffer, size, end, &attribute_qname);
+		if (attribute_qname.length == 0) {
+			return -1;
+		}
+		pos = esg_xml_skip_space(buffer, size, pos);
+		if ((pos >= size) || (buffer[pos] != '=')) {
+			return -1;
+		}
+		pos = esg_xml_skip_space(buffer, size, pos + 1);
+		if ((pos >= size) || ((buffer[pos] != '"') && (buffer[pos] != '\''))) {
+			return -1;
+		}
+		value.data = buffer + pos + 1;
+		value.length = 0;
+		for (end = pos + 1; (end < size) && (buffer[end] != buffer[pos]); end++) {
+			if (buffer[end] == '<') {
+				return -1;
+			}
+		}
+		if (end >= size) {
+			return -1;
+		}
+		value.length = end - pos - 1;
+		pos = end + 1;
+
+		esg_xml_split(&attribute_qname, &prefix, &name);
+		if (esg_xml_string_equal(&attribute_qname, "xmlns")) {
+			prefix.length = 0;
+			if (esg_xml_declare(parser, &prefix, &value, parser->depth + 1)) {
+				return -1;
+			}
+		} else if (esg_xml_string_equal(&prefix, "xmlns")) {
+			if ((name.length == 0) || esg_xml_declare(parser, &name, &value, parser->depth + 1)) {
+				return -1;
+			}
+		} else {
+			if (count == ESG_XML_MAX_ATTRIBUTES) {
+				return -1;
+			}
+			parser->attribute_qnames[count] = attribute_qname;
+			parser->attributes[count].value = value;
+			count++;
+		}
+	}
+
+	// the declarations of the element apply to its own names as well
+	for (i = 0; i < count; i++) {
+		attribute = &parser->attributes[i];
+		esg_xml_split(&parser->attribute_qnames[i], &prefix, &attribute->name);
+		if (prefix.length == 0) {
+			attribute->namespace_uri.data = prefix.data;
+			attribute->namespace_uri.length = 0;
+		} else if (esg_xml_resolve_qname(parser, &parser->attribute_qnames[i], &attribute->namespace_uri, &attribute->name)) {
+			return -1;
+		}
+	}
+	if (esg_xml_resolve_qname(parser, &qname, &uri, &name)) {
+		return -1;
+	}
+
+	parser->elements[parser->depth++] = qname;
+	*ppos = pos;
+
+	if (parser->handler->start_element) {
+		result = parser->handler->start_element(parser->arg, &uri, &name, parser->attributes, count);
+		if (result) {
+			return result;
+		}
+	}
+
+	if (empty) {
+		result = esg_xml_end_element(parser);
+	}
+
+	return result;
+}
+
+static int esg_xml_text(struct esg_xml_parser *parser, const uint8_t *data, uint32_t length, int cdata) {
+	struct esg_xml_string text;
+	uint32_t pos;
+
+	if ((parser->depth == 0) || (parser->handler->text == NULL)) {
+		return 0;
+	}
+
+	if (!cdata) {
+		pos = esg_xml_skip_space(data, length, 0);
+		if (pos == length) {
+			return 0;
+		}
+	}
+
+	text.data = data;
+	text.length = length;
+
+	return parser->handler->text(parser->arg, &text, cdata);
+}
+
+static int esg_xml_repository_string(struct esg_string_repository *string_repository, uint16_t ptr, struct esg_xml_string *string) {
+	string->data = esg_string_repository_get(string_repository, ptr, &string->length);
+	if (string->data == NULL) {
+		return -1;
+	}
+
+	return 0;
+}
+
+struct esg_xml_parser *esg_xml_parser_create(struct esg_textual_decoder_init *decoder_init,
+					     struct esg_string_repository *string_repository,
+					     struct esg_xml_handler *handler, void *arg) {
+	struct esg_xml_parser *parser;
+	struct esg_namespace_prefix *namespace_prefix;
+	struct esg_xml_namespace *namespace;
+	struct esg_xml_string prefix;
+	struct esg_xml_string uri;
+	uint8_t *copy;
+
+	if (handler == NULL) {
+		return NULL;
+	}
+
+	parser = (struct esg_xml_parser *) malloc(sizeof(struct esg_xml_parser));
+	if (parser == NULL) {
+		return NULL;
+	}
+	memset(parser, 0, sizeof(struct esg_xml_parser));
+
+	parser->handler = handler;
+	parser->arg = arg;
+
+	if ((decoder_init != NULL) && (string_repository != NULL)) {
+		esg_textual_decoder_namespace_prefix_list_for_each(decoder_init, namespace_prefix) {
+			if (esg_xml_repository_string(string_repository, namespace_prefix->prefix_string_ptr, &prefix) ||
+			    esg_xml_repository_string(string_repository, namespace_prefix->namespace_uri_ptr, &uri)) {
+				continue;
+			}
+			if (esg_xml_declare(parser, &prefix, &uri, 0)) {
+				esg_xml_parser_free(parser);
+				return NULL;
+			}
+
+			// Copied, a lazy repository may drop what it decoded
+			copy = (uint8_t *) malloc(prefix.length + uri.length + 1);
+			if (copy == NULL) {
+				esg_xml_parser_free(parser);
+				return NULL;
+			}
+			memcpy(copy, prefix.data, prefix.length);
+			memcpy(copy + prefix.length, uri.data, uri.length);
+			namespace = &parser->namespaces[parser->num_namespaces - 1];
+			namespace->prefix.data = copy;
+			namespace->uri.data = copy + prefix.length;
+			parser->base_strings[parser->num_namespaces - 1] = copy;
+		}
+	}
+	parser->num_base_namespaces = parser->num_namespaces;
+
+	return parser;
+}
+
+int esg_xml_parser_parse(struct esg_xml_parser *parser, const uint8_t *buffer, uint32_t size) {
+	struct esg_xml_string qname;
+	const uint8_t *text;
+	uint32_t pos;
+	uint32_t end;
+	int brackets;
+	int result;
+
+	if ((parser == NULL) || (buffer == NULL)) {
+		return -1;
+	}
+
+	parser->num_namespaces = parser->num_base_namespaces;
+	parser->depth = 0;
+
+	pos = 0;
+	while (pos < size) {
+		if (buffer[pos] != '<') {
+			text = buffer + pos;
+			while ((pos < size) && (buffer[pos] != '<')) {
+				pos++;
+			}
+			result = esg_xml_text(parser, text, buffer + pos - text, 0);
+		} else if (esg_xml_starts_with(buffer, size, pos, "<?")) {
+			end = esg_xml_find(buffer, size, pos + 2, "?>");
+			if (end == size) {
+				return -1;
+			}
+			pos = end + 2;
+			result = 0;
+		} else if (esg_xml_starts_with(buffer, size, pos, "<!--")) {
+			end = esg_xml_find(buffer, size, pos + 4, "-->");
+			if (end == size) {
+				return -1;
+			}
+			pos = end + 3;
+			result = 0;
+		} else if (esg_xml_starts_with(buffer, size, pos, "<![CDATA[")) {
+			end = esg_xml_find(buffer, size, pos + 9, "]]>");
+			if (end == size) {
+				return -1;
+			}
+			result = esg_xml_text(parser, buffer + pos + 9, end - pos - 9, 1);
+			pos = end + 3;
+		} else if (esg_xml_starts_with(buffer, size, pos, "<!")) {
+			// DOCTYPE, its internal subset is skipped
+			brackets = 0;
+			for (pos += 2; pos < size; pos++) {
+				if (buffer[pos] == '[') {
+					brackets++;
+				} else if (buffer[pos] == ']') {
+					brackets--;
+				} else if ((buffer[pos] == '>') && (brackets <= 0)) {
+					break;
+				}
+			}
+			if (pos == size) {
+				return -1;
+			}
+			pos++;
+			result = 0;
+		} else if (esg_xml_starts_with(buffer, size, pos, "</")) {
+			pos = esg_xml_name(buffer, size, pos + 2, &qname);
+			pos = esg_xml_skip_space(buffer, size, pos);
+			if ((pos >= size) || (buffer[pos] != '>') || (parser->depth == 0) ||
+			    !esg_xml_string_compare(&qname, &parser->elements[parser->depth - 1])) {
+				return -1;
+			}
+			pos++;
+			result = esg_xml_end_element(parser);
+		} else {
+			pos++;
+			result = esg_xml_start_element(parser, buffer, size, &pos);
+		}
+
+		if (result) {
+			return result;
+		}
+	}
+
+	return (parser->depth == 0) ? 0 : -1;
+}
+
+void esg_xml_parser_free(struct esg_xml_parser *parser) {
+	int i;
+
+	if (parser == NULL) {
+		return;
+	}
+
+	for (i = 0; i < ESG_XML_MAX_NAMESPACES; i++) {
+		if (parser->base_strings[i]) {
+			free(parser->base_strings[i]);
+		}
+	}
+	free(parser);
+}
+
+static uint32_t esg_xml_put_utf8(uint32_t c, uint8_t *utf8) {
+	if (c < 0x80) {
+		utf8[0] = c;
+		return 1;
+	} else if (c < 0x800) {
+		utf8[0] = 0xc0 | (c >> 6);
+		utf8[1] = 0x80 | (c & 0x3f);
+		return 2;
+	} else if (c < 0x10000) {
+		utf8[0] = 0xe0 | (c >> 12);
+		utf8[1] = 0x80 | ((c >> 6) & 0x3f);
+		utf8[2] = 0x80 | (c & 0x3f);
+		return 3;
+	}
+	utf8[0] = 0xf0 | ((c >> 18) & 0x07);
+	utf8[1] = 0x80 | ((c >> 12) & 0x3f);
+	utf8[2] = 0x80 | ((c >> 6) & 0x3f);
+	utf8[3] = 0x80 | (c & 0x3f);
+	return 4;
+}
+
+static uint32_t esg_xml_reference(const uint8_t *data, uint32_t length, uint8_t *out, uint32_t *out_length) {
+	static const struct {
+		const char *entity;
+		uint8_t c;
+	} entities[] = {
+		{ "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' },
+	};
+	uint32_t c = 0;
+	uint32_t pos;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(entities) / sizeof(entities[0]); i++) {
+		if (esg_xml_starts_with(data, length, 0, entities[i].entity)) {
+			out[0] = entities[i].c;
+			*out_length = 1;
+			return strlen(entities[i].entity);
+		}
+	}
+
+	if ((length < 4) || (data[1] != '#')) {
+		return 0;
+	}
+
+	if ((data[2] == 'x') || (data[2] == 'X')) {
+		for (pos = 3; (pos < length) && (pos < 11); pos++) {
+			if ((data[pos] >= '0') && (data[pos] <= '9')) {
+				c = (c << 4) | (data[pos] - '0');
+			} else if (((data[pos] | 0x20) >= 'a') && ((data[pos] | 0x20) <= 'f')) {
+				c = (c << 4) | ((data[pos] | 0x20) - 'a' + 10);
+			} else {
+				break;
+			}
+		}
+		if (pos == 3) {
+			return 0;
+		}
+	} else {
+		for (pos = 2; (pos < length) && (pos < 10) && (data[pos] >= '0') && (data[pos] <= '9'); pos++) {
+			c = c * 10 + (data[pos] - '0');
+		}
+		if (pos == 2) {
+			return 0;
+		}
+	}
+
+	if ((pos >= length) || (data[pos] != ';') || (c == 0) || (c > 0x10ffff)) {
+		return 0;
+	}
+
+	*out_length = esg_xml_put_utf8(c, out);
+	return pos + 1;
+}
+
+uint32_t esg_xml_unescape(struct esg_xml_string *string, char *buffer, uint32_t size) {
+	uint8_t out[4];
+	uint32_t out_length;
+	uint32_t length = 0;
+	uint32_t pos = 0;
+	uint32_t used;
+	uint32_t i;
+
+	while (pos < string->length) {
+		used = 0;
+		if (string->data[pos] == '&') {
+			used = esg_xml_reference(string->data + pos, string->length - pos, out, &out_length);
+		}
+		if (used == 0) {
+			out[0] = string->data[pos];
+			out_length = 1;
+			used = 1;
+		}
+		pos += used;
+
+		for (i = 0; i < out_length; i++, length++) {
+			if (length + 1 < size) {
+				buffer[length] = out[i];
+			}
+		}
+	}
+
+	if (size > 0) {
+		buffer[(length < size) ? length : size - 1] = 0;
+	}
+
+	return length;
+}
@@ -0,0 +1,170 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_REPRESENTATION_XML_PARSER_H
+#define _ESG_REPRESENTATION_XML_PARSER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libesg/encapsulation/string_repository.h>
+#include <libesg/representation/textual_decoder_init.h>
+
+/**
+ * Maximum element nesting depth of a fragment.
+ */
+#define ESG_XML_MAX_DEPTH 32
+
+/**
+ * Maximum number of attributes of an element.
+ */
+#define ESG_XML_MAX_ATTRIBUTES 32
+
+/**
+ * Maximum number of namespace prefixes in scope, including those of the
+ * textual decoder init.
+ */
+#define ESG_XML_MAX_NAMESPACES 64
+
+/**
+ * esg_xml_string structure. It points into the parsed buffer and is not
+ * NUL terminated.
+ */
+struct esg_xml_string {
+	const uint8_t *data;
+	uint32_t length;
+};
+
+/**
+ * esg_xml_attribute structure. The value is raw, entity and character
+ * references are not expanded (see esg_xml_unescape).
+ */
+struct esg_xml_attribute {
+	struct esg_xml_string namespace_uri;
+	struct esg_xml_string name;
+	struct esg_xml_string value;
+};
+
+/**
+ * esg_xml_handler structure. Any callback may be NULL. A callback returning
+ * non-zero stops the parsing, and esg_xml_parser_parse returns that value.
+ *
+ * Names are local names, the namespace_uri is empty if the name has none.
+ * Text is raw like attribute values unless it comes from a CDATA section,
+ * runs of white space only between tags are not reported.
+ */
+struct esg_xml_handler {
+	int (*start_element)(void *arg, struct esg_xml_string *namespace_uri, struct esg_xml_string *name,
+			     struct esg_xml_attribute *attributes, int attribute_count);
+	int (*end_element)(void *arg, struct esg_xml_string *namespace_uri, struct esg_xml_string *name);
+	int (*text)(void *arg, struct esg_xml_string *text, int cdata);
+};
+
+/**
+ * esg_xml_namespace structure.
+ */
+struct esg_xml_namespace {
+	struct esg_xml_string prefix;
+	struct esg_xml_string uri;
+	int depth;
+};
+
+/**
+ * esg_xml_parser structure. Its size is fixed, parsing allocates nothing.
+ */
+struct esg_xml_parser {
+	struct esg_xml_handler *handler;
+	void *arg;
+
+	int num_base_namespaces;
+	int num_namespaces;
+	struct esg_xml_namespace namespaces[ESG_XML_MAX_NAMESPACES];
+	uint8_t *base_strings[ESG_XML_MAX_NAMESPACES];
+
+	int depth;
+	struct esg_xml_string elements[ESG_XML_MAX_DEPTH];
+
+	struct esg_xml_string attribute_qnames[ESG_XML_MAX_ATTRIBUTES];
+	struct esg_xml_attribute attributes[ESG_XML_MAX_ATTRIBUTES];
+};
+
+/**
+ * Create an esg_xml_parser. The textual ESG fragments carry no namespace
+ * declarations of their own, the prefixes come from the decoder init, whose
+ * string pointers are offsets into the string repository. Both may be NULL;
+ * the prefixes are copied, so neither need be kept once the parser is
+ * created.
+ *
+ * @param decoder_init Pointer to an esg_textual_decoder_init structure.
+ * @param string_repository Pointer to the esg_string_repository of the decoder init.
+ * @param handler Pointer to an esg_xml_handler structure.
+ * @param arg Argument passed to the callbacks.
+ * @return Pointer to an esg_xml_parser structure, or NULL on error.
+ */
+extern struct esg_xml_parser *esg_xml_parser_create(struct esg_textual_decoder_init *decoder_init,
+						    struct esg_string_repository *string_repository,
+						    struct esg_xml_handler *handler, void *arg);
+
+/**
+ * Parse an XML document, calling the handler as its tokens are met. The
+ * strings passed to the callbacks point into buffer.
+ *
+ * @param parser Pointer to an esg_xml_parser structure.
+ * @param buffer XML buffer to parse.
+ * @param size XML buffer size.
+ * @return 0 on success, the non-zero value returned by a callback, or -1 if malformed.
+ */
+extern int esg_xml_parser_parse(struct esg_xml_parser *parser, const uint8_t *buffer, uint32_t size);
+
+/**
+ * Free an esg_xml_parser.
+ *
+ * @param parser Pointer to an esg_xml_parser structure.
+ */
+extern void esg_xml_parser_free(struct esg_xml_parser *parser);
+
+/**
+ * Expand the predefined entity and the character references of a raw string.
+ * The result is truncated to size-1 bytes and NUL terminated.
+ *
+ * @param string Pointer to an esg_xml_string structure.
+ * @param buffer Buffer receiving the result.
+ * @param size Buffer size.
+ * @return Length of the expanded string (which may be more than written).
+ */
+extern uint32_t esg_xml_unescape(struct esg_xml_string *string, char *buffer, uint32_t size);
+
+/**
+ * Compare an esg_xml_string with a NUL terminated string.
+ *
+ * @param string Pointer to an esg_xml_string structure.
+ * @param value String to compare with.
+ * @return 1 if equal, 0 if not.
+ */
+extern int esg_xml_string_equal(struct esg_xml_string *string, const char *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
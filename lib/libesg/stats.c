@@ -0,0 +1,36 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libdvbmisc/dvbstats.h>
+#include "stats.h"
+
+static const char * const esg_stats_names[] = {
+	"containers",
+	"decode_errors",
+	"fragments_updated",
+	"container_bytes",
+};
+
+DVBSTATS_SET(esg_stats, "libesg", esg_stats_names, ESG_STATS_COUNTERS, ESG_STATS_HISTOGRAMS);
+
+static void __attribute__((destructor)) esg_stats_exit(void)
+{
+	dvbstats_dump_at_exit(&esg_stats);
+}
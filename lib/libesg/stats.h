@@ -0,0 +1,54 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_STATS_H
+#define _ESG_STATS_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct dvbstats_set;
+
+/**
+ * The libesg performance counters. Dump them with dvbstats_dump() from
+ * libdvbmisc/dvbstats.h, or have them dumped at exit by setting DVB_STATS in
+ * the environment.
+ */
+extern struct dvbstats_set esg_stats;
+
+enum esg_stats_counter {
+	ESG_STATS_CONTAINERS,		/* containers decoded */
+	ESG_STATS_DECODE_ERRORS,	/* containers which failed to decode */
+	ESG_STATS_FRAGMENTS_UPDATED,	/* fragments added or updated in fragment stores */
+	ESG_STATS_COUNTERS
+};
+
+enum esg_stats_histogram {
+	ESG_STATS_CONTAINER_BYTES,	/* sizes of the containers decoded */
+	ESG_STATS_HISTOGRAMS
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,888 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <net/if.h>
+
+#include <libesg/transport/flute.h>
+#include <libesg/reader.h>
+
+#define ESG_LCT_EXT_FTI		64
+#define ESG_LCT_EXT_FDT		192
+#define ESG_LCT_EXT_CENC	193
+
+#define ESG_FLUTE_FDT_HISTORY	16	// FDT instance ids remembered as decoded
+#define ESG_FLUTE_FDT_PENDING	4	// FDT instances reassembled at once
+#define ESG_FLUTE_PACKET_SIZE	65536
+
+int esg_lct_header_decode(uint8_t *buffer, uint32_t size, struct esg_lct_header *header) {
+	struct esg_reader reader;
+	struct esg_reader extension;
+	const uint8_t *extension_ptr;
+	uint32_t header_length;
+	uint32_t cci_length;
+	uint32_t tsi_length;
+	uint32_t toi_length;
+	uint32_t extension_length;
+	uint8_t half_word;
+	uint8_t flags;
+
+	if ((buffer == NULL) || (size < 4) || (header == NULL)) {
+		return -1;
+	}
+
+	memset(header, 0, sizeof(struct esg_lct_header));
+
+	esg_reader_init(&reader, buffer, size);
+	header->version = esg_reader_bits(&reader, 4);
+	cci_length = (esg_reader_bits(&reader, 2) + 1) * 4;
+	esg_reader_bits(&reader, 2); // PSI
+	flags = esg_reader_u8(&reader);
+	header_length = esg_reader_u8(&reader) * 4;
+	header->codepoint = esg_reader_u8(&reader);
+
+	half_word = (flags & 0x10) ? 2 : 0;
+	tsi_length = ((flags & 0x80) ? 4 : 0) + half_word;
+	toi_length = (((flags >> 5) & 0x03) * 4) + half_word;
+	header->close_session = (flags & 0x02) ? 1 : 0;
+	header->close_object = (flags & 0x01) ? 1 : 0;
+
+	if ((header->version != 1) || (toi_length > 8)) {
+		return -1;
+	}
+	if ((size < header_length) || (header_length < 4 + cci_length + tsi_length + toi_length)) {
+		return -1;
+	}
+
+	// Only the header from here
+	esg_reader_init(&reader, buffer, header_length);
+	esg_reader_skip(&reader, 4 + cci_length);
+
+	header->tsi = esg_reader_bytes(&reader, tsi_length);
+	header->toi = esg_reader_bytes(&reader, toi_length);
+
+	// Sender Current Time, Expected Residual Time
+	if (flags & 0x08) {
+		esg_reader_skip(&reader, 4);
+	}
+	if (flags & 0x04) {
+		esg_reader_skip(&reader, 4);
+	}
+
+	// Header extensions
+	while (esg_reader_ok(&reader) && esg_reader_remaining(&reader)) {
+		if (esg_reader_remaining(&reader) < 4) {
+			return -1;
+		}
+		extension_ptr = esg_reader_ptr(&reader);
+		if (extension_ptr[0] <= 127) {
+			extension_length = extension_ptr[1] * 4;
+			if ((extension_length == 0) || (esg_reader_remaining(&reader) < extension_length)) {
+				return -1;
+			}
+		} else {
+			extension_length = 4;
+		}
+		esg_reader_init(&extension, extension_ptr, extension_length);
+
+		switch (esg_reader_u8(&extension)) {
+			case ESG_LCT_EXT_FTI: {
+				if (extension_length < 16) {
+					return -1;
+				}
+				header->has_fti = 1;
+				esg_reader_u8(&extension); // HEL
+				header->transfer_length = esg_reader_bytes(&extension, 6);
+				esg_reader_u16(&extension); // FEC Instance ID, unused by FEC Encoding ID 0
+				header->encoding_symbol_length = esg_reader_u16(&extension);
+				header->max_source_block_length = esg_reader_u32(&extension);
+				break;
+			}
+			case ESG_LCT_EXT_FDT: {
+				header->has_fdt = 1;
+				esg_reader_bits(&extension, 4); // FLUTE version
+				header->fdt_instance_id = esg_reader_bits(&extension, 20);
+				break;
+			}
+			case ESG_LCT_EXT_CENC: {
+				header->has_cenc = 1;
+				header->content_encoding = esg_reader_u8(&extension);
+				break;
+			}
+		}
+		esg_reader_skip(&reader, extension_length);
+	}
+	if (!esg_reader_ok(&reader)) {
+		return -1;
+	}
+
+	// FEC Payload ID (FEC Encoding ID 0)
+	if (header->codepoint != 0) {
+		return -1;
+	}
+	if (size < header_length + 4) {
+		// a packet only closing the session or object may have no payload
+		return (header->close_session || header->close_object) ? 0 : -1;
+	}
+
+	esg_reader_init(&reader, buffer + header_length, size - header_length);
+	header->source_block_number = esg_reader_u16(&reader);
+	header->encoding_symbol_id = esg_reader_u16(&reader);
+
+	header->payload = (uint8_t *) esg_reader_ptr(&reader);
+	header->payload_length = esg_reader_remaining(&reader);
+
+	return 0;
+}
+
+static void esg_flute_file_free_strings(struct esg_flute_file *file) {
+	free(file->content_location);
+	free(file->content_type);
+	free(file->content_encoding);
+}
+
+static void esg_fdt_xml_unescape(char *value) {
+	static const struct {
+		const char *entity;
+		char c;
+	} entities[] = {
+		{ "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' },
+	};
+	char *in;
+	char *out;
+	unsigned int i;
+
+	for (in = out = value; *in; ) {
+		if (*in == '&') {
+			for (i = 0; i < sizeof(entities) / sizeof(entities[0]); i++) {
+				if (strncmp(in, entities[i].entity, strlen(entities[i].entity)) == 0) {
+					break;
+				}
+			}
+			if (i < sizeof(entities) / sizeof(entities[0])) {
+				*out++ = entities[i].c;
+				in += strlen(entities[i].entity);
+				continue;
+			}
+		}
+		*out++ = *in++;
+	}
+	*out = 0;
+}
+
+static int esg_fdt_set_string(char **field, const char *value) {
+	free(*field);
+	*field = strdup(value);
+
+	return (*field == NULL) ? -1 : 0;
+}
+
+static int esg_fdt_attribute(struct esg_flute_file *file, uint32_t *expires, const char *name, const char *value) {
+	if (strcmp(name, "Content-Location") == 0) {
+		return esg_fdt_set_string(&file->content_location, value);
+	} else if (strcmp(name, "Content-Type") == 0) {
+		return esg_fdt_set_string(&file->content_type, value);
+	} else if (strcmp(name, "Content-Encoding") == 0) {
+		return esg_fdt_set_string(&file->content_encoding, value);
+	} else if (strcmp(name, "TOI") == 0) {
+		file->toi = strtoull(value, NULL, 10);
+	} else if (strcmp(name, "Content-Length") == 0) {
+		file->content_length = strtoull(value, NULL, 10);
+	} else if (strcmp(name, "Transfer-Length") == 0) {
+		file->transfer_length = strtoull(value, NULL, 10);
+	} else if (strcmp(name, "FEC-OTI-Encoding-Symbol-Length") == 0) {
+		file->encoding_symbol_length = strtoul(value, NULL, 10);
+	} else if (strcmp(name, "FEC-OTI-Maximum-Source-Block-Length") == 0) {
+		file->max_source_block_length = strtoul(value, NULL, 10);
+	} else if ((strcmp(name, "Expires") == 0) && expires) {
+		*expires = strtoul(value, NULL, 10);
+	}
+
+	return 0;
+}
+
+static int esg_fdt_inherit(struct esg_flute_file *file, struct esg_flute_file *defaults) {
+	if ((file->content_type == NULL) && defaults->content_type &&
+	    esg_fdt_set_string(&file->content_type, defaults->content_type)) {
+		return -1;
+	}
+	if ((file->content_encoding == NULL) && defaults->content_encoding &&
+	    esg_fdt_set_string(&file->content_encoding, defaults->content_encoding)) {
+		return -1;
+	}
+	if (file->encoding_symbol_length == 0) {
+		file->encoding_symbol_length = defaults->encoding_symbol_length;
+	}
+	if (file->max_source_block_length == 0) {
+		file->max_source_block_length = defaults->max_source_block_length;
+	}
+	if (file->transfer_length == 0) {
+		// no Content-Encoding: what is sent is the content
+		file->transfer_length = file->content_encoding ? 0 : file->content_length;
+	}
+
+	return 0;
+}
+
+struct esg_fdt_instance *esg_fdt_instance_decode(uint8_t *buffer, uint32_t size) {
+	struct esg_fdt_instance *fdt;
+	struct esg_flute_file defaults;
+	struct esg_flute_file *file;
+	struct esg_flute_file *last_file;
+	struct esg_flute_file *target;
+	char *text;
+	char *p;
+	char *name;
+	char *local;
+	char *value;
+	char quote;
+	int is_instance;
+	int is_file;
+
+	if ((buffer == NULL) || (size == 0)) {
+		return NULL;
+	}
+
+	fdt = (struct esg_fdt_instance *) malloc(sizeof(struct esg_fdt_instance));
+	text = (char *) malloc(size + 1);
+	if ((fdt == NULL) || (text == NULL)) {
+		free(fdt);
+		free(text);
+		return NULL;
+	}
+	memset(fdt, 0, sizeof(struct esg_fdt_instance));
+	memset(&defaults, 0, sizeof(struct esg_flute_file));
+	memcpy(text, buffer, size);
+	text[size] = 0;
+
+	last_file = NULL;
+	for (p = text; (p = strchr(p, '<')) != NULL; ) {
+		p++;
+		if ((*p == '/') || (*p == '?') || (*p == '!')) {
+			continue;
+		}
+
+		// Element name, without a namespace prefix
+		name = local = p;
+		while (*p && !isspace((unsigned char) *p) && (*p != '/') && (*p != '>')) {
+			if (*p == ':') {
+				local = p + 1;
+			}
+			p++;
+		}
+		is_instance = (p - local == 12) && (strncmp(local, "FDT-Instance", 12) == 0);
+		is_file = (p - local == 4) && (strncmp(local, "File", 4) == 0);
+		if (!is_instance && !is_file) {
+			continue;
+		}
+		if (is_instance && (fdt->file_list != NULL)) {
+			goto error;
+		}
+
+		target = &defaults;
+		if (is_file) {
+			file = (struct esg_flute_file *) malloc(sizeof(struct esg_flute_file));
+			if (file == NULL) {
+				goto error;
+			}
+			memset(file, 0, sizeof(struct esg_flute_file));
+			file->_next = NULL;
+
+			if (last_file == NULL) {
+				fdt->file_list = file;
+			} else {
+				last_file->_next = file;
+			}
+			last_file = file;
+			target = file;
+		}
+
+		// Attributes
+		for (;;) {
+			while (isspace((unsigned char) *p)) {
+				p++;
+			}
+			if ((*p == 0) || (*p == '/') || (*p == '>')) {
+				break;
+			}
+			name = p;
+			while (*p && (*p != '=') && !isspace((unsigned char) *p)) {
+				p++;
+			}
+			value = p;
+			while (isspace((unsigned char) *p)) {
+				p++;
+			}
+			if (*p != '=') {
+				goto error;
+			}
+			*value = 0;
+			p++;
+			while (isspace((unsigned char) *p)) {
+				p++;
+			}
+			quote = *p;
+			if ((quote != '"') && (quote != '\'')) {
+				goto error;
+			}
+			value = ++p;
+			if ((p = strchr(p, quote)) == NULL) {
+				goto error;
+			}
+			*p++ = 0;
+			esg_fdt_xml_unescape(value);
+
+			if (esg_fdt_attribute(target, is_instance ? &fdt->expires : NULL, name, value)) {
+				goto error;
+			}
+		}
+	}
+
+	esg_fdt_instance_file_list_for_each(fdt, file) {
+		if (esg_fdt_inherit(file, &defaults)) {
+			goto error;
+		}
+	}
+
+	esg_flute_file_free_strings(&defaults);
+	free(text);
+	return fdt;
+
+error:
+	esg_flute_file_free_strings(&defaults);
+	free(text);
+	esg_fdt_instance_free(fdt);
+	return NULL;
+}
+
+void esg_fdt_instance_free(struct esg_fdt_instance *fdt) {
+	struct esg_flute_file *file;
+	struct esg_flute_file *next_file;
+
+	if (fdt == NULL) {
+		return;
+	}
+
+	for (file = fdt->file_list; file; file = next_file) {
+		next_file = file->_next;
+		esg_flute_file_free_strings(file);
+		free(file);
+	}
+
+	free(fdt);
+}
+
+/*
+ * An object being reassembled or already delivered: a file declared by an FDT
+ * instance, or an FDT instance itself (TOI 0).
+ */
+struct esg_flute_object {
+	struct esg_flute_file file;
+	uint32_t fdt_instance_id;
+	uint8_t complete;
+
+	uint8_t *data;
+	uint8_t *received;		// a bit for each encoding symbol
+	uint32_t symbols;
+	uint32_t symbols_received;
+
+	struct esg_flute_object *_next;
+};
+
+struct esg_flute_receiver {
+	uint64_t tsi;
+	esg_flute_file_callback callback;
+	void *arg;
+
+	struct esg_flute_object *object_list;
+	uint32_t fdt_history[ESG_FLUTE_FDT_HISTORY];
+	uint32_t fdt_history_count;
+	uint32_t fdt_history_next;
+
+	struct esg_flute_stats stats;
+	uint8_t *packet;
+};
+
+struct esg_flute_receiver *esg_flute_receiver_create(uint64_t tsi, esg_flute_file_callback callback, void *arg) {
+	struct esg_flute_receiver *receiver;
+
+	receiver = (struct esg_flute_receiver *) malloc(sizeof(struct esg_flute_receiver));
+	if (receiver == NULL) {
+		return NULL;
+	}
+	memset(receiver, 0, sizeof(struct esg_flute_receiver));
+
+	receiver->tsi = tsi;
+	receiver->callback = callback;
+	receiver->arg = arg;
+
+	return receiver;
+}
+
+static void esg_flute_object_free(struct esg_flute_object *object) {
+	esg_flute_file_free_strings(&object->file);
+	free(object->data);
+	free(object->received);
+	free(object);
+}
+
+static void esg_flute_receiver_unlink(struct esg_flute_receiver *receiver, struct esg_flute_object *object) {
+	struct esg_flute_object **prev;
+
+	for (prev = &receiver->object_list; *prev; prev = &(*prev)->_next) {
+		if (*prev == object) {
+			*prev = object->_next;
+			return;
+		}
+	}
+}
+
+static struct esg_flute_object *esg_flute_receiver_find(struct esg_flute_receiver *receiver, uint64_t toi, uint32_t fdt_instance_id) {
+	struct esg_flute_object *object;
+
+	for (object = receiver->object_list; object; object = object->_next) {
+		if ((object->file.toi == toi) && ((toi != 0) || (object->fdt_instance_id == fdt_instance_id))) {
+			return object;
+		}
+	}
+
+	return NULL;
+}
+
+static int esg_flute_receiver_fdt_seen(struct esg_flute_receiver *receiver, uint32_t fdt_instance_id) {
+	uint32_t i;
+
+	for (i = 0; i < receiver->fdt_history_count; i++) {
+		if (receiver->fdt_history[i] == fdt_instance_id) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static struct esg_flute_object *esg_flute_receiver_new_fdt(struct esg_flute_receiver *receiver, uint32_t fdt_instance_id) {
+	struct esg_flute_object *object;
+	struct esg_flute_object *oldest = NULL;
+	uint32_t pending = 0;
+
+	// Don't follow too many FDT instances at once: drop the oldest
+	for (object = receiver->object_list; object; object = object->_next) {
+		if (object->file.toi == 0) {
+			oldest = object;
+			pending++;
+		}
+	}
+	if (pending >= ESG_FLUTE_FDT_PENDING) {
+		esg_flute_receiver_unlink(receiver, oldest);
+		esg_flute_object_free(oldest);
+	}
+
+	object = (struct esg_flute_object *) malloc(sizeof(struct esg_flute_object));
+	if (object == NULL) {
+		return NULL;
+	}
+	memset(object, 0, sizeof(struct esg_flute_object));
+	object->fdt_instance_id = fdt_instance_id;
+
+	object->_next = receiver->object_list;
+	receiver->object_list = object;
+
+	return object;
+}
+
+/*
+ * Apply a new FDT instance: its new TOIs are to be received, and an object
+ * with a new TOI for the same Content-Location replaces the old one.
+ */
+static void esg_flute_receiver_apply_fdt(struct esg_flute_receiver *receiver, struct esg_fdt_instance *fdt) {
+	struct esg_flute_file *file;
+	struct esg_flute_object *object;
+	struct esg_flute_object *next_object;
+
+	esg_fdt_instance_file_list_for_each(fdt, file) {
+		if ((file->toi == 0) || (file->content_location == NULL)) {
+			continue;
+		}
+
+		object = esg_flute_receiver_find(receiver, file->toi, 0);
+		if (object != NULL) {
+			// Already known: only complete what is missing
+			if (object->data == NULL) {
+				if (object->file.transfer_length == 0)
+					object->file.transfer_length = file->transfer_length;
+				if (object->file.encoding_symbol_length == 0)
+					object->file.encoding_symbol_length = file->encoding_symbol_length;
+				if (object->file.max_source_block_length == 0)
+					object->file.max_source_block_length = file->max_source_block_length;
+			}
+			continue;
+		}
+
+		for (object = receiver->object_list; object; object = next_object) {
+			next_object = object->_next;
+			if ((object->file.toi != 0) &&
+			    (strcmp(object->file.content_location, file->content_location) == 0)) {
+				esg_flute_receiver_unlink(receiver, object);
+				esg_flute_object_free(object);
+			}
+		}
+
+		object = (struct esg_flute_object *) malloc(sizeof(struct esg_flute_object));
+		if (object == NULL) {
+			return;
+		}
+		memset(object, 0, sizeof(struct esg_flute_object));
+		object->file = *file;
+		object->file.content_location = strdup(file->content_location);
+		object->file.content_type = file->content_type ? strdup(file->content_type) : NULL;
+		object->file.content_encoding = file->content_encoding ? strdup(file->content_encoding) : NULL;
+		object->file._next = NULL;
+		if ((object->file.content_location == NULL) ||
+		    (file->content_type && (object->file.content_type == NULL)) ||
+		    (file->content_encoding && (object->file.content_encoding == NULL))) {
+			esg_flute_object_free(object);
+			return;
+		}
+
+		object->_next = receiver->object_list;
+		receiver->object_list = object;
+	}
+}
+
+static void esg_flute_receiver_complete(struct esg_flute_receiver *receiver, struct esg_flute_object *object) {
+	struct esg_fdt_instance *fdt;
+
+	if (object->file.toi == 0) {
+		fdt = esg_fdt_instance_decode(object->data, object->file.transfer_length);
+
+		receiver->fdt_history[receiver->fdt_history_next] = object->fdt_instance_id;
+		receiver->fdt_history_next = (receiver->fdt_history_next + 1) % ESG_FLUTE_FDT_HISTORY;
+		if (receiver->fdt_history_count < ESG_FLUTE_FDT_HISTORY) {
+			receiver->fdt_history_count++;
+		}
+		esg_flute_receiver_unlink(receiver, object);
+		esg_flute_object_free(object);
+
+		if (fdt != NULL) {
+			receiver->stats.fdt_instances++;
+			esg_flute_receiver_apply_fdt(receiver, fdt);
+			esg_fdt_instance_free(fdt);
+		}
+		return;
+	}
+
+	// Only its TOI is kept, to know the repeats of the carousel
+	object->complete = 1;
+	receiver->stats.files++;
+	if (receiver->callback) {
+		receiver->callback(receiver->arg, &object->file, object->data, object->file.transfer_length);
+	}
+	free(object->data);
+	free(object->received);
+	object->data = NULL;
+	object->received = NULL;
+}
+
+static int esg_flute_object_alloc(struct esg_flute_object *object) {
+	struct esg_flute_file *file = &object->file;
+	uint64_t symbols;
+
+	if ((file->transfer_length == 0) || (file->transfer_length > ESG_FLUTE_MAX_OBJECT_LENGTH) ||
+	    (file->encoding_symbol_length == 0) || (file->max_source_block_length == 0)) {
+		return -1;
+	}
+
+	symbols = (file->transfer_length + file->encoding_symbol_length - 1) / file->encoding_symbol_length;
+	object->data = (uint8_t *) malloc(file->transfer_length);
+	object->received = (uint8_t *) calloc(1, (symbols + 7) / 8);
+	if ((object->data == NULL) || (object->received == NULL)) {
+		free(object->data);
+		free(object->received);
+		object->data = NULL;
+		object->received = NULL;
+		return -1;
+	}
+	object->symbols = symbols;
+	object->symbols_received = 0;
+
+	return 0;
+}
+
+/*
+ * The blocking algorithm of RFC 3926 (section 9.1): the object is split into
+ * the fewest blocks of at most max_source_block_length symbols, the first ones
+ * one symbol longer than the others if they don't divide evenly.
+ */
+static int esg_flute_object_symbol(struct esg_flute_object *object, uint32_t sbn, uint32_t esi,
+				   uint32_t *index, uint32_t *block_end) {
+	uint32_t blocks;
+	uint32_t large;
+	uint32_t small;
+	uint32_t large_blocks;
+	uint32_t start;
+	uint32_t length;
+
+	blocks = (object->symbols + object->file.max_source_block_length - 1) / object->file.max_source_block_length;
+	large = (object->symbols + blocks - 1) / blocks;
+	small = object->symbols / blocks;
+	large_blocks = object->symbols - small * blocks;
+
+	if (sbn >= blocks) {
+		return -1;
+	}
+	if (sbn < large_blocks) {
+		start = sbn * large;
+		length = large;
+	} else {
+		start = large_blocks * large + (sbn - large_blocks) * small;
+		length = small;
+	}
+	if (esi >= length) {
+		return -1;
+	}
+
+	*index = start + esi;
+	*block_end = start + length;
+	return 0;
+}
+
+int esg_flute_receiver_packet(struct esg_flute_receiver *receiver, uint8_t *buffer, uint32_t size) {
+	struct esg_lct_header header;
+	struct esg_flute_object *object;
+	uint32_t index;
+	uint32_t block_end;
+	uint32_t offset;
+	uint32_t length;
+	uint32_t pos;
+
+	receiver->stats.packets++;
+
+	if (esg_lct_header_decode(buffer, size, &header)) {
+		receiver->stats.bad_packets++;
+		return -1;
+	}
+	if ((header.tsi != receiver->tsi) || (header.payload_length == 0)) {
+		receiver->stats.ignored_packets++;
+		return 0;
+	}
+
+	if (header.toi == 0) {
+		if (!header.has_fdt) {
+			receiver->stats.bad_packets++;
+			return -1;
+		}
+		if (esg_flute_receiver_fdt_seen(receiver, header.fdt_instance_id)) {
+			receiver->stats.ignored_packets++;
+			return 0;
+		}
+		object = esg_flute_receiver_find(receiver, 0, header.fdt_instance_id);
+		if ((object == NULL) && ((object = esg_flute_receiver_new_fdt(receiver, header.fdt_instance_id)) == NULL)) {
+			return 0;
+		}
+	} else {
+		object = esg_flute_receiver_find(receiver, header.toi, 0);
+		if ((object == NULL) || object->complete) {
+			receiver->stats.ignored_packets++;
+			return 0;
+		}
+	}
+
+	if (object->data == NULL) {
+		if (header.has_fti) {
+			object->file.transfer_length = header.transfer_length;
+			object->file.encoding_symbol_length = header.encoding_symbol_length;
+			object->file.max_source_block_length = header.max_source_block_length;
+		}
+		if (esg_flute_object_alloc(object)) {
+			receiver->stats.ignored_packets++;
+			return 0;
+		}
+	}
+
+	if (esg_flute_object_symbol(object, header.source_block_number, header.encoding_symbol_id, &index, &block_end)) {
+		receiver->stats.bad_packets++;
+		return -1;
+	}
+
+	// One or more consecutive symbols of the block
+	for (pos = 0; (pos < header.payload_length) && (index < block_end); index++) {
+		offset = index * object->file.encoding_symbol_length;
+		length = object->file.encoding_symbol_length;
+		if (object->file.transfer_length - offset < length) {
+			length = object->file.transfer_length - offset;
+		}
+		if (header.payload_length - pos < length) {
+			break;
+		}
+
+		if (!(object->received[index / 8] & (1 << (index % 8)))) {
+			memcpy(object->data + offset, header.payload + pos, length);
+			object->received[index / 8] |= 1 << (index % 8);
+			object->symbols_received++;
+		}
+		pos += length;
+	}
+
+	if (object->symbols_received == object->symbols) {
+		esg_flute_receiver_complete(receiver, object);
+	}
+
+	return 0;
+}
+
+int esg_flute_receiver_read(struct esg_flute_receiver *receiver, int fd) {
+	ssize_t size;
+
+	if (receiver->packet == NULL) {
+		receiver->packet = (uint8_t *) malloc(ESG_FLUTE_PACKET_SIZE);
+		if (receiver->packet == NULL) {
+			return -1;
+		}
+	}
+
+	size = recv(fd, receiver->packet, ESG_FLUTE_PACKET_SIZE, 0);
+	if (size < 0) {
+		return -1;
+	}
+
+	return esg_flute_receiver_packet(receiver, receiver->packet, size);
+}
+
+void esg_flute_receiver_get_stats(struct esg_flute_receiver *receiver, struct esg_flute_stats *stats) {
+	*stats = receiver->stats;
+}
+
+void esg_flute_receiver_free(struct esg_flute_receiver *receiver) {
+	struct esg_flute_object *object;
+	struct esg_flute_object *next_object;
+
+	if (receiver == NULL) {
+		return;
+	}
+
+	for (object = receiver->object_list; object; object = next_object) {
+		next_object = object->_next;
+		esg_flute_object_free(object);
+	}
+
+	free(receiver->packet);
+	free(receiver);
+}
+
+int esg_flute_socket_open(const char *ifname, struct esg_entry *entry) {
+	struct group_source_req request;
+	struct sockaddr_storage address;
+	struct sockaddr_in *address4 = (struct sockaddr_in *) &address;
+	struct sockaddr_in6 *address6 = (struct sockaddr_in6 *) &address;
+	unsigned int ifindex = 0;
+	int has_source;
+	int multicast;
+	int level;
+	int fd;
+	int one = 1;
+	int i;
+
+	if (ifname != NULL) {
+		ifindex = if_nametoindex(ifname);
+		if (ifindex == 0) {
+			return -1;
+		}
+	}
+
+	memset(&address, 0, sizeof(address));
+	memset(&request, 0, sizeof(request));
+	has_source = 0;
+	if (entry->ip_version_6) {
+		address6->sin6_family = AF_INET6;
+		address6->sin6_port = htons(entry->port);
+		memcpy(&address6->sin6_addr, entry->destination_ip.ipv6, 16);
+		multicast = entry->destination_ip.ipv6[0] == 0xff;
+		level = IPPROTO_IPV6;
+
+		for (i = 0; i < 16; i++) {
+			has_source |= entry->source_ip.ipv6[i];
+		}
+		((struct sockaddr_in6 *) &request.gsr_source)->sin6_family = AF_INET6;
+		memcpy(&((struct sockaddr_in6 *) &request.gsr_source)->sin6_addr, entry->source_ip.ipv6, 16);
+	} else {
+		address4->sin_family = AF_INET;
+		address4->sin_port = htons(entry->port);
+		memcpy(&address4->sin_addr, entry->destination_ip.ipv4, 4);
+		multicast = (entry->destination_ip.ipv4[0] & 0xf0) == 0xe0;
+		level = IPPROTO_IP;
+
+		for (i = 0; i < 4; i++) {
+			has_source |= entry->source_ip.ipv4[i];
+		}
+		((struct sockaddr_in *) &request.gsr_source)->sin_family = AF_INET;
+		memcpy(&((struct sockaddr_in *) &request.gsr_source)->sin_addr, entry->source_ip.ipv4, 4);
+	}
+
+	fd = socket(address.ss_family, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	// Only root may bind to a device; the group is joined on it anyway
+	if (ifname != NULL) {
+		setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, ifname, strlen(ifname) + 1);
+	}
+
+	if (bind(fd, (struct sockaddr *) &address, (address.ss_family == AF_INET6) ?
+		 sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in))) {
+		goto error;
+	}
+
+	if (multicast) {
+		request.gsr_interface = ifindex;
+		memcpy(&request.gsr_group, &address, sizeof(address));
+		if (has_source) {
+			if (setsockopt(fd, level, MCAST_JOIN_SOURCE_GROUP, &request, sizeof(request))) {
+				goto error;
+			}
+		} else {
+			struct group_req group;
+
+			memset(&group, 0, sizeof(group));
+			group.gr_interface = ifindex;
+			memcpy(&group.gr_group, &address, sizeof(address));
+			if (setsockopt(fd, level, MCAST_JOIN_GROUP, &group, sizeof(group))) {
+				goto error;
+			}
+		}
+	}
+
+	return fd;
+
+error:
+	i = errno;
+	close(fd);
+	errno = i;
+	return -1;
+}
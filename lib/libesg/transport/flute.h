@@ -0,0 +1,218 @@
+/*
+ * ESG parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _ESG_TRANSPORT_FLUTE_H
+#define _ESG_TRANSPORT_FLUTE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libesg/bootstrap/access_descriptor.h>
+
+/**
+ * Largest object a FLUTE receiver reassembles.
+ */
+#define ESG_FLUTE_MAX_OBJECT_LENGTH (16 * 1024 * 1024)
+
+/**
+ * esg_lct_header structure: an ALC/LCT packet (RFC 3450, RFC 3451) with the
+ * FLUTE header extensions (RFC 3926). Only the Compact No-Code FEC scheme
+ * (FEC Encoding ID 0) is supported.
+ */
+struct esg_lct_header {
+	uint8_t version;
+	uint8_t close_session;
+	uint8_t close_object;
+	uint8_t codepoint;
+	uint64_t tsi;
+	uint64_t toi;
+
+	uint8_t has_fdt;
+	uint32_t fdt_instance_id;
+	uint8_t has_cenc;
+	uint8_t content_encoding;
+	uint8_t has_fti;
+	uint64_t transfer_length;
+	uint16_t encoding_symbol_length;
+	uint32_t max_source_block_length;
+
+	uint32_t source_block_number;
+	uint32_t encoding_symbol_id;
+	uint8_t *payload;
+	uint32_t payload_length;
+};
+
+/**
+ * Decode an ALC/LCT packet. The payload points into buffer.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @param header Where to put the result.
+ * @return 0 on success, or -1 on error.
+ */
+extern int esg_lct_header_decode(uint8_t *buffer, uint32_t size, struct esg_lct_header *header);
+
+/**
+ * esg_flute_file structure: a File element of an FDT instance.
+ */
+struct esg_flute_file {
+	uint64_t toi;
+	char *content_location;
+	char *content_type;
+	char *content_encoding;
+	uint64_t content_length;
+	uint64_t transfer_length;		// 0 if not given
+	uint16_t encoding_symbol_length;	// 0 if not given
+	uint32_t max_source_block_length;	// 0 if not given
+
+	struct esg_flute_file *_next;
+};
+
+/**
+ * esg_fdt_instance structure.
+ */
+struct esg_fdt_instance {
+	uint32_t expires;
+	struct esg_flute_file *file_list;
+};
+
+/**
+ * Process an FDT instance (XML). The attributes of the FDT-Instance element
+ * are taken as defaults for its files.
+ *
+ * @param buffer Binary buffer to decode.
+ * @param size Binary buffer size.
+ * @return Pointer to an esg_fdt_instance structure, or NULL on error.
+ */
+extern struct esg_fdt_instance *esg_fdt_instance_decode(uint8_t *buffer, uint32_t size);
+
+/**
+ * Free an esg_fdt_instance.
+ *
+ * @param fdt Pointer to an esg_fdt_instance structure.
+ */
+extern void esg_fdt_instance_free(struct esg_fdt_instance *fdt);
+
+/**
+ * Convenience iterator for file_list field of an esg_fdt_instance.
+ *
+ * @param fdt The esg_fdt_instance pointer.
+ * @param file Variable holding a pointer to the current esg_flute_file.
+ */
+#define esg_fdt_instance_file_list_for_each(fdt, file) \
+	for ((file) = (fdt)->file_list; \
+	     (file); \
+	     (file) = (file)->_next)
+
+/**
+ * A FLUTE receiver follows the FDT instances of one session and reassembles
+ * the files they declare. Each FDT instance is only decoded once, and each
+ * file (TOI) only reassembled once: the packets of the carousel repeating them
+ * are dropped straight away. A changed file gets a new TOI in FLUTE, so when
+ * an FDT instance declares another TOI for a Content-Location, the old one is
+ * forgotten and the new one reassembled.
+ */
+struct esg_flute_receiver;
+
+/**
+ * Called with every file completely received. The data is only valid during
+ * the call.
+ *
+ * @param arg The argument given to esg_flute_receiver_create().
+ * @param file The file, as declared by the FDT.
+ * @param data Its content (still content encoded, if it has a Content-Encoding).
+ * @param length Length of data.
+ */
+typedef void (*esg_flute_file_callback)(void *arg, struct esg_flute_file *file, uint8_t *data, uint32_t length);
+
+/**
+ * esg_flute_stats structure.
+ */
+struct esg_flute_stats {
+	uint32_t packets;
+	uint32_t bad_packets;		// malformed, or unsupported FEC
+	uint32_t ignored_packets;	// other sessions, known FDTs and files, unknown TOIs
+	uint32_t fdt_instances;		// decoded
+	uint32_t files;			// delivered
+};
+
+/**
+ * Create a FLUTE receiver.
+ *
+ * @param tsi Transport session identifier of the session.
+ * @param callback Called for each file received.
+ * @param arg Argument for callback.
+ * @return Pointer to the receiver, or NULL on error.
+ */
+extern struct esg_flute_receiver *esg_flute_receiver_create(uint64_t tsi, esg_flute_file_callback callback, void *arg);
+
+/**
+ * Process one ALC/LCT packet (a UDP payload).
+ *
+ * @param receiver Pointer to an esg_flute_receiver.
+ * @param buffer The packet.
+ * @param size Its size.
+ * @return 0 on success (the packet may have been ignored), or -1 if it was malformed.
+ */
+extern int esg_flute_receiver_packet(struct esg_flute_receiver *receiver, uint8_t *buffer, uint32_t size);
+
+/**
+ * Read one packet from a socket and process it.
+ *
+ * @param receiver Pointer to an esg_flute_receiver.
+ * @param fd The socket, e.g. from esg_flute_socket_open().
+ * @return 0 on success, or -1 on error (with errno set if the read failed).
+ */
+extern int esg_flute_receiver_read(struct esg_flute_receiver *receiver, int fd);
+
+/**
+ * Retrieve the counters of a receiver.
+ *
+ * @param receiver Pointer to an esg_flute_receiver.
+ * @param stats Where to put them.
+ */
+extern void esg_flute_receiver_get_stats(struct esg_flute_receiver *receiver, struct esg_flute_stats *stats);
+
+/**
+ * Free an esg_flute_receiver.
+ *
+ * @param receiver Pointer to an esg_flute_receiver.
+ */
+extern void esg_flute_receiver_free(struct esg_flute_receiver *receiver);
+
+/**
+ * Open a UDP socket receiving the session of an ESG entry point, joining its
+ * multicast group (source specific if the entry has a source address) on a
+ * network interface, usually one created with dvbnet for the MPE PID.
+ *
+ * @param ifname Name of the interface, or NULL for any.
+ * @param entry The entry point, e.g. from an esg_access_descriptor.
+ * @return The socket, or -1 on error with errno set.
+ */
+extern int esg_flute_socket_open(const char *ifname, struct esg_entry *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -22,9 +22,10 @@
 #include <string.h>
 
 #include <libesg/transport/session_partition_declaration.h>
+#include <libesg/reader.h>
 
 struct esg_session_partition_declaration *esg_session_partition_declaration_decode(uint8_t *buffer, uint32_t size) {
-	uint32_t pos;
+	struct esg_reader reader;
 	struct esg_session_partition_declaration *partition;
 	struct esg_session_field *field;
 	struct esg_session_field *last_field;
@@ -32,7 +33,6 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 	struct esg_session_ip_stream *ip_stream;
 	struct esg_session_ip_stream *last_ip_stream;
 	uint8_t ip_stream_index;
-	uint8_t ip_index;
 	struct esg_session_ip_stream_field *ip_stream_field;
 	struct esg_session_ip_stream_field *last_ip_stream_field;
 	uint8_t *field_buffer;
@@ -43,20 +43,18 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 		return NULL;
 	}
 
-	pos = 0;
+	esg_reader_init(&reader, buffer, size);
 
 	partition = (struct esg_session_partition_declaration *) malloc(sizeof(struct esg_session_partition_declaration));
 	memset(partition, 0, sizeof(struct esg_session_partition_declaration));
 	partition->field_list = NULL;
 	partition->ip_stream_list = NULL;
 
-	partition->num_fields = buffer[pos];
-	pos += 1;
+	partition->num_fields = esg_reader_u8(&reader);
+	partition->overlapping = esg_reader_bits(&reader, 1);
+	esg_reader_bits(&reader, 7); // reserved
 
-	partition->overlapping = (buffer[pos] & 0x80) ? 1 : 0;
-	pos += 1;
-
-	if (size < (pos + 5*(partition->num_fields))) {
+	if (esg_reader_remaining(&reader) < 5*(partition->num_fields)) {
 		esg_session_partition_declaration_free(partition);
 		return NULL;
 	}
@@ -74,21 +72,14 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 		}
 		last_field = field;
 
-		field->identifier = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
-
-		field->encoding = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
-
-		field->length = buffer[pos];
-		pos += 1;
+		field->identifier = esg_reader_u16(&reader);
+		field->encoding = esg_reader_u16(&reader);
+		field->length = esg_reader_u8(&reader);
 	}
 
-	partition->n_o_ip_streams = buffer[pos];
-	pos += 1;
-
-	partition->ip_version_6 = (buffer[pos] & 0x80) ? 1 : 0;
-	pos += 1;
+	partition->n_o_ip_streams = esg_reader_u8(&reader);
+	partition->ip_version_6 = esg_reader_bits(&reader, 1);
+	esg_reader_bits(&reader, 7); // reserved
 
 	last_ip_stream = NULL;
 	for (ip_stream_index = 0; ip_stream_index < partition->n_o_ip_streams; ip_stream_index++) {
@@ -103,27 +94,17 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 		}
 		last_ip_stream = ip_stream;
 
-		ip_stream->id = buffer[pos];
-		pos += 1;
+		ip_stream->id = esg_reader_u8(&reader);
 
 		if (partition->ip_version_6) {
-			for (ip_index = 0; ip_index < 16; ip_index++) {
-				ip_stream->source_ip.ipv6[ip_index] = buffer[pos+ip_index];
-				ip_stream->destination_ip.ipv6[ip_index] = buffer[pos+16+ip_index];
-			}
-			pos += 32;
+			esg_reader_copy(&reader, ip_stream->source_ip.ipv6, 16);
+			esg_reader_copy(&reader, ip_stream->destination_ip.ipv6, 16);
 		} else {
-			for (ip_index = 0; ip_index < 4; ip_index++) {
-				ip_stream->source_ip.ipv4[ip_index] = buffer[pos+ip_index];
-				ip_stream->destination_ip.ipv4[ip_index] = buffer[pos+4+ip_index];
-			}
-			pos += 8;
+			esg_reader_copy(&reader, ip_stream->source_ip.ipv4, 4);
+			esg_reader_copy(&reader, ip_stream->destination_ip.ipv4, 4);
 		}
-		ip_stream->port = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
-
-		ip_stream->session_id = (buffer[pos] << 8) | buffer[pos+1];
-		pos += 2;
+		ip_stream->port = esg_reader_u16(&reader);
+		ip_stream->session_id = esg_reader_u16(&reader);
 
 		last_ip_stream_field = NULL;
 		esg_session_partition_declaration_field_list_for_each(partition, field) {
@@ -141,10 +122,12 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 			last_ip_stream_field = ip_stream_field;
 
 			field_length = field->length;
-			if (field->length != 0) {
-				field_length = field->length;
-			} else {
-				pos += vluimsbf8(buffer + pos, size - pos, &field_length);
+			if (field->length == 0) {
+				field_length = esg_reader_vluimsbf8(&reader);
+			}
+			if (esg_reader_remaining(&reader) < (uint64_t) (partition->overlapping ? 2 : 1) * field_length) {
+				esg_session_partition_declaration_free(partition);
+				return NULL;
 			}
 
 			switch (field->encoding) {
@@ -155,40 +138,40 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 						ip_stream_field->start_field_value = field_value;
 
 						field_buffer = (uint8_t *) malloc(field_length);
-						memset(field_buffer, 0, field_length);
-						memcpy(field_buffer, buffer + pos, field_length);
+						esg_reader_copy(&reader, field_buffer, field_length);
 
 						ip_stream_field->start_field_value->string = field_buffer;
-						pos += field_length;
 					}
 					field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
 					memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
 					ip_stream_field->end_field_value = field_value;
 
 					field_buffer = (uint8_t *) malloc(field_length);
-					memset(field_buffer, 0, field_length);
-					memcpy(field_buffer, buffer + pos, field_length);
+					esg_reader_copy(&reader, field_buffer, field_length);
 
 					ip_stream_field->end_field_value->string = field_buffer;
-					pos += field_length;
 
 					break;
 				}
 				case 0x0101: {
+					if (field_length < 2) {
+						esg_session_partition_declaration_free(partition);
+						return NULL;
+					}
 					if (partition->overlapping == 1) {
 						field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
 						memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
 						ip_stream_field->start_field_value = field_value;
 
-						ip_stream_field->start_field_value->unsigned_short = (buffer[pos] << 8) | buffer[pos+1];
-						pos += field_length;
+						ip_stream_field->start_field_value->unsigned_short = esg_reader_u16(&reader);
+						esg_reader_skip(&reader, field_length - 2);
 					}
 					field_value = (union esg_session_ip_stream_field_value *) malloc(sizeof(union esg_session_ip_stream_field_value));
 					memset(field_value, 0, sizeof(union esg_session_ip_stream_field_value));
 					ip_stream_field->end_field_value = field_value;
 
-					ip_stream_field->end_field_value->unsigned_short = (buffer[pos] << 8) | buffer[pos+1];
-					pos += field_length;
+					ip_stream_field->end_field_value->unsigned_short = esg_reader_u16(&reader);
+					esg_reader_skip(&reader, field_length - 2);
 
 					break;
 				}
@@ -200,6 +183,11 @@ struct esg_session_partition_declaration *esg_session_partition_declaration_deco
 		}
 	}
 
+	if (!esg_reader_ok(&reader)) {
+		esg_session_partition_declaration_free(partition);
+		return NULL;
+	}
+
 	return partition;
 }
 
@@ -219,7 +207,7 @@ void esg_session_partition_declaration_free(struct esg_session_partition_declara
 		next_ip_stream = ip_stream->_next;
 
 		field = partition->field_list;
-		for(ip_stream_field = next_ip_stream->field_list; ip_stream_field; ip_stream_field = next_ip_stream_field) {
+		for(ip_stream_field = ip_stream->field_list; ip_stream_field; ip_stream_field = next_ip_stream_field) {
 			next_ip_stream_field = ip_stream_field->_next;
 
 			switch (field->encoding) {
@@ -236,6 +224,8 @@ void esg_session_partition_declaration_free(struct esg_session_partition_declara
 				}
 			}
 
+			free(ip_stream_field->start_field_value);
+			free(ip_stream_field->end_field_value);
 			free(ip_stream_field);
 
 			field = field->_next;
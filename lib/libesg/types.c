@@ -19,19 +19,16 @@
  */
 
 #include <libesg/types.h>
+#include <libesg/reader.h>
 
 uint8_t vluimsbf8(uint8_t *buffer, uint32_t size, uint32_t *length) {
-	uint8_t offset = 0;
-	*length = 0;
+	struct esg_reader reader;
 
-	do {
-		if (size < offset) {
-			offset = 0;
-			*length = 0;
-			break;
-		}
-		*length = (*length << 7) + (buffer[offset] & 0x7F);
-	} while (buffer[offset++] & 0x80);
+	esg_reader_init(&reader, buffer, size);
+	*length = esg_reader_vluimsbf8(&reader);
+	if (!esg_reader_ok(&reader)) {
+		return 0;
+	}
 
-	return offset;
+	return esg_reader_ptr(&reader) - buffer;
 }
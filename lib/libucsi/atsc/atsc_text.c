@@ -31,6 +31,10 @@
 
 #define DEST_ALLOC_DELTA 20
 
+#define HUFFDECODE_BITS 8
+#define HUFFDECODE_MASK ((1 << HUFFDECODE_BITS) - 1)
+#define HUFFDECODE_LITERAL 0x80
+
 struct hufftree_entry {
 	uint8_t left_idx;
 	uint8_t right_idx;
@@ -44,8 +48,27 @@ struct huffbuff {
 	uint8_t cur_bit;
 };
 
+struct huffdecode_entry {
+	uint8_t value;		/* the literal, or the node reached */
+	uint8_t bits;		/* bits used, | HUFFDECODE_LITERAL if value is a literal */
+};
+
+/* lookup tables for a tree, built on first use of each context */
+struct huffdecode_tables {
+	struct hufftree_entry (*tree)[128];
+	uint8_t built[128];
+	struct huffdecode_entry table[128][1 << HUFFDECODE_BITS];
+};
+
+struct huffdest {
+	uint8_t **buf;
+	size_t *len;
+	size_t *pos;
+	int fixed;		/* buf may not be realloc()ed */
+};
+
 
-static struct hufftree_entry program_description_hufftree[][128] = {
+static struct hufftree_entry program_description_hufftree[128][128] = {
 	{ {0x14, 0x15}, {0x9b, 0xd6}, {0xc9, 0xcf}, {0xd7, 0xc7}, {0x01, 0xa2},
 	{0xce, 0xcb}, {0x02, 0x03}, {0xc5, 0xcc}, {0xc6, 0xc8}, {0x04, 0xc4},
 	{0x05, 0xc2}, {0x06, 0xc3}, {0xd2, 0x07}, {0xd3, 0x08}, {0xca, 0xd4},
@@ -279,7 +302,7 @@ static struct hufftree_entry program_description_hufftree[][128] = {
 	{ {0x9b, 0x9b}, },
 };
 
-static struct hufftree_entry program_title_hufftree[][128] = {
+static struct hufftree_entry program_title_hufftree[128][128] = {
 	{ {0x1b, 0x1c}, {0xb4, 0xa4}, {0xb2, 0xb7}, {0xda, 0x01}, {0xd1, 0x02},
 	{0x03, 0x9b}, {0x04, 0xd5}, {0xd9, 0x05}, {0xcb, 0xd6}, {0x06, 0xcf},
 	{0x07, 0x08}, {0xca, 0x09}, {0xc9, 0xc5}, {0xc6, 0x0a}, {0xd2, 0xc4},
@@ -533,6 +556,14 @@ static struct hufftree_entry program_title_hufftree[][128] = {
 };
 
 
+static struct huffdecode_tables program_description_tables = {
+	.tree = program_description_hufftree,
+};
+
+static struct huffdecode_tables program_title_tables = {
+	.tree = program_title_hufftree,
+};
+
 
 static inline void huffbuff_init(struct huffbuff *hbuf, uint8_t *buf, uint32_t buf_len)
 {
@@ -566,8 +597,71 @@ static inline int huffbuff_bits(struct huffbuff *hbuf, uint8_t nbits)
 	return result;
 }
 
-static inline int append_unicode_char(uint8_t **destbuf, size_t *destbuflen, size_t *destbufpos,
-				      uint32_t c)
+static inline uint32_t huffbuff_remaining(struct huffbuff *hbuf)
+{
+	return ((hbuf->buf_len - hbuf->cur_byte) * 8) - hbuf->cur_bit;
+}
+
+/* the next HUFFDECODE_BITS bits, zero padded past the end. cur_byte must be valid */
+static inline uint32_t huffbuff_peek(struct huffbuff *hbuf)
+{
+	uint32_t word = hbuf->buf[hbuf->cur_byte] << 8;
+
+	if ((hbuf->cur_byte + 1) < hbuf->buf_len)
+		word |= hbuf->buf[hbuf->cur_byte + 1];
+
+	return ((word << hbuf->cur_bit) >> (16 - HUFFDECODE_BITS)) & HUFFDECODE_MASK;
+}
+
+static inline void huffbuff_skip(struct huffbuff *hbuf, uint8_t nbits)
+{
+	nbits += hbuf->cur_bit;
+	hbuf->cur_byte += nbits >> 3;
+	hbuf->cur_bit = nbits & 7;
+}
+
+/*
+ * Build the lookup table for one context of a tree: every HUFFDECODE_BITS bit
+ * prefix maps to the literal its code ends in, or to the node the walk has
+ * reached if the code is longer than that.
+ */
+static void huffdecode_build(struct huffdecode_tables *tables, int context)
+{
+	struct hufftree_entry *tree = tables->tree[context];
+	struct huffdecode_entry *table = tables->table[context];
+	uint32_t prefix;
+	int bit;
+
+	for(prefix = 0; prefix <= HUFFDECODE_MASK; prefix++) {
+		uint8_t treeidx = 0;
+		uint8_t treeval = 0;
+
+		for(bit = 0; bit < HUFFDECODE_BITS; bit++) {
+			if (prefix & (1 << (HUFFDECODE_BITS - 1 - bit)))
+				treeval = tree[treeidx].right_idx;
+			else
+				treeval = tree[treeidx].left_idx;
+
+			if (treeval & HUFFTREE_LITERAL_MASK)
+				break;
+			treeidx = treeval;
+		}
+
+		if (bit < HUFFDECODE_BITS) {
+			table[prefix].value = treeval & ~HUFFTREE_LITERAL_MASK;
+			table[prefix].bits = HUFFDECODE_LITERAL | (bit + 1);
+		} else {
+			table[prefix].value = treeidx;
+			table[prefix].bits = HUFFDECODE_BITS;
+		}
+	}
+
+	// concurrent builders write the same entries; publish the flag last
+	__sync_synchronize();
+	tables->built[context] = 1;
+}
+
+static inline int append_unicode_char(struct huffdest *dest, uint32_t c)
 {
 	uint8_t tmp[3];
 	int tmplen = 0;
@@ -590,39 +684,45 @@ static inline int append_unicode_char(uint8_t **destbuf, size_t *destbuflen, siz
 	}
 
 	// do we have enough buffer space?
-	if ((*destbufpos + tmplen) >= *destbuflen) {
-		uint8_t *new_dest = realloc(*destbuf, *destbuflen + DEST_ALLOC_DELTA);
+	if ((*dest->pos + tmplen) >= *dest->len) {
+		uint8_t *new_dest;
+
+		if (dest->fixed)
+			return -ENOSPC;
+
+		new_dest = realloc(*dest->buf, *dest->len + DEST_ALLOC_DELTA);
 		if (new_dest == NULL)
 			return -ENOMEM;
-		*destbuf = new_dest;
-		*destbuflen += DEST_ALLOC_DELTA;
+		*dest->buf = new_dest;
+		*dest->len += DEST_ALLOC_DELTA;
 	}
 
 	// copy it into position
-	memcpy(*destbuf + *destbufpos, tmp, tmplen);
-	*destbufpos += tmplen;
+	memcpy(*dest->buf + *dest->pos, tmp, tmplen);
+	*dest->pos += tmplen;
 
 	return 0;
 }
 
 static inline int unicode_decode(uint8_t *srcbuf, size_t srcbuflen, int mode,
-				 uint8_t **destbuf, size_t *destbuflen, size_t *destbufpos)
+				 struct huffdest *dest)
 {
 	size_t i;
 	uint32_t msb = mode << 8;
+	int ret;
 
 	for(i=0; i< srcbuflen; i++) {
-		if (append_unicode_char(destbuf, destbuflen, destbufpos, msb + srcbuf[i]))
-			return -1;
+		if ((ret = append_unicode_char(dest, msb + srcbuf[i])) < 0)
+			return ret;
 	}
 
-	return *destbufpos;
+	return *dest->pos;
 }
 
-static int huffman_decode_uncompressed(struct huffbuff *hbuf,
-				       uint8_t **destbuf, size_t *destbuflen, size_t *destbufpos)
+static int huffman_decode_uncompressed(struct huffbuff *hbuf, struct huffdest *dest)
 {
 	int c;
+	int ret;
 
 	while(hbuf->cur_byte < hbuf->buf_len) {
 		// get next byte
@@ -637,8 +737,8 @@ static int huffman_decode_uncompressed(struct huffbuff *hbuf,
 			return HUFFSTRING_ESCAPE;
 
 		default:
-			if (append_unicode_char(destbuf, destbuflen, destbufpos, c))
-				return -1;
+			if ((ret = append_unicode_char(dest, c)) < 0)
+				return ret;
 
 			// if it is 7 bit, we swap back to the compressed context
 			if ((c & 0x80) == 0)
@@ -653,67 +753,76 @@ static int huffman_decode_uncompressed(struct huffbuff *hbuf,
 	return HUFFSTRING_END;
 }
 
-static int huffman_decode(uint8_t *src, size_t srclen,
-			  uint8_t **destbuf, size_t *destbuflen, size_t *destbufpos,
-			  struct hufftree_entry hufftree[][128])
+static int huffman_decode(uint8_t *src, size_t srclen, struct huffdest *dest,
+			  struct huffdecode_tables *tables)
 {
 	struct huffbuff hbuf;
+	struct huffdecode_entry entry;
+	int context = 0;
 	int bit;
-	struct hufftree_entry *tree = hufftree[0];
-	uint8_t treeidx = 0;
+	uint8_t treeidx;
 	uint8_t treeval;
 	int tmp;
 
 	huffbuff_init(&hbuf, src, srclen);
 
 	while(hbuf.cur_byte < hbuf.buf_len) {
-		// get the next bit
-		if ((bit = huffbuff_bits(&hbuf, 1)) < 0)
-			return *destbufpos;
+		if (!tables->built[context])
+			huffdecode_build(tables, context);
+
+		// look up as many bits as possible at once
+		entry = tables->table[context][huffbuff_peek(&hbuf)];
+		if ((entry.bits & ~HUFFDECODE_LITERAL) > huffbuff_remaining(&hbuf))
+			return *dest->pos;
+		huffbuff_skip(&hbuf, entry.bits & ~HUFFDECODE_LITERAL);
 
-		if (!bit) {
-			treeval = tree[treeidx].left_idx;
+		if (entry.bits & HUFFDECODE_LITERAL) {
+			treeval = entry.value | HUFFTREE_LITERAL_MASK;
 		} else {
-			treeval = tree[treeidx].right_idx;
+			// long code: walk the rest of the tree bit by bit
+			treeidx = entry.value;
+			do {
+				if ((bit = huffbuff_bits(&hbuf, 1)) < 0)
+					return *dest->pos;
+
+				if (!bit) {
+					treeval = tables->tree[context][treeidx].left_idx;
+				} else {
+					treeval = tables->tree[context][treeidx].right_idx;
+				}
+				treeidx = treeval;
+			} while(!(treeval & HUFFTREE_LITERAL_MASK));
 		}
 
-		if (treeval & HUFFTREE_LITERAL_MASK) {
-			switch(treeval & ~HUFFTREE_LITERAL_MASK) {
-			case HUFFSTRING_END:
-				return 0;
-
-			case HUFFSTRING_ESCAPE:
-				if ((tmp =
-					huffman_decode_uncompressed(&hbuf,
-							destbuf, destbuflen, destbufpos)) < 0)
-					return tmp;
-				if (tmp == 0)
-					return *destbufpos;
-
-				tree = hufftree[tmp];
-				treeidx = 0;
-				break;
+		switch(treeval & ~HUFFTREE_LITERAL_MASK) {
+		case HUFFSTRING_END:
+			return *dest->pos;
 
-			default:
-				// stash it
-				if (append_unicode_char(destbuf, destbuflen, destbufpos,
-				    			treeval & ~HUFFTREE_LITERAL_MASK))
-					return -1;
-				tree = hufftree[treeval & ~HUFFTREE_LITERAL_MASK];
-				treeidx = 0;
-				break;
-			}
-		} else {
-			treeidx = treeval;
+		case HUFFSTRING_ESCAPE:
+			if ((tmp = huffman_decode_uncompressed(&hbuf, dest)) < 0)
+				return tmp;
+			if (tmp == 0)
+				return *dest->pos;
+
+			context = tmp;
+			break;
+
+		default:
+			// stash it
+			if ((tmp = append_unicode_char(dest, treeval & ~HUFFTREE_LITERAL_MASK)) < 0)
+				return tmp;
+			context = treeval & ~HUFFTREE_LITERAL_MASK;
+			break;
 		}
 	}
 
-	return *destbufpos;
+	return *dest->pos;
 }
 
-int atsc_text_segment_decode(struct atsc_text_string_segment *segment,
-			     uint8_t **destbuf, size_t *destbufsize, size_t *destbufpos)
+static int segment_decode(struct atsc_text_string_segment *segment, struct huffdest *dest)
 {
+	uint8_t *buf;
+
 	if (segment->mode > ATSC_TEXT_SEGMENT_MODE_UNICODE_RANGE_MAX)
 		return -1;
 
@@ -721,23 +830,72 @@ int atsc_text_segment_decode(struct atsc_text_string_segment *segment,
 	if ((segment->mode) && (segment->compression_type))
 		return -1;
 
-	uint8_t *buf = atsc_text_string_segment_bytes(segment);
+	buf = atsc_text_string_segment_bytes(segment);
 
 	switch(segment->compression_type) {
 	case ATSC_TEXT_COMPRESS_NONE:
-		return unicode_decode(buf, segment->number_bytes, segment->mode,
-				      destbuf, destbufsize, destbufpos);
+		return unicode_decode(buf, segment->number_bytes, segment->mode, dest);
 
 	case ATSC_TEXT_COMPRESS_PROGRAM_TITLE:
-		return huffman_decode(buf, segment->number_bytes,
-				      destbuf, destbufsize, destbufpos,
-				      program_title_hufftree);
+		return huffman_decode(buf, segment->number_bytes, dest,
+				      &program_title_tables);
 
 	case ATSC_TEXT_COMPRESS_PROGRAM_DESCRIPTION:
-		return huffman_decode(buf, segment->number_bytes,
-				      destbuf, destbufsize, destbufpos,
-				      program_description_hufftree);
+		return huffman_decode(buf, segment->number_bytes, dest,
+				      &program_description_tables);
 	}
 
 	return -1;
 }
+
+int atsc_text_segment_decode(struct atsc_text_string_segment *segment,
+			     uint8_t **destbuf, size_t *destbufsize, size_t *destbufpos)
+{
+	struct huffdest dest;
+
+	dest.buf = destbuf;
+	dest.len = destbufsize;
+	dest.pos = destbufpos;
+	dest.fixed = 0;
+
+	return segment_decode(segment, &dest);
+}
+
+int atsc_text_decode(struct atsc_text *txt, uint8_t *arena, size_t arena_len,
+		     uint8_t **strings, int max_strings)
+{
+	struct atsc_text_string *str;
+	struct atsc_text_string_segment *seg;
+	struct huffdest dest;
+	size_t pos = 0;
+	int i;
+	int j;
+	int ret;
+
+	if (arena_len == 0)
+		return -ENOSPC;
+
+	dest.buf = &arena;
+	dest.len = &arena_len;
+	dest.pos = &pos;
+	dest.fixed = 1;
+
+	atsc_text_strings_for_each(txt, str, i) {
+		if (pos >= arena_len)
+			return -ENOSPC;
+		if (i < max_strings)
+			strings[i] = arena + pos;
+
+		atsc_text_string_segments_for_each(str, seg, j) {
+			if ((ret = segment_decode(seg, &dest)) < 0) {
+				arena[pos] = 0;
+				return ret;
+			}
+		}
+
+		// append_unicode_char() always leaves room for this
+		arena[pos++] = 0;
+	}
+
+	return pos;
+}
@@ -0,0 +1,192 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libucsi/atsc/mgt_tracker.h>
+
+struct mgt_tracker_table {
+	uint16_t table_type;
+	uint16_t pid;
+	int8_t version;			/* listed by the MGT */
+	int8_t cached;			/* -1 => not held */
+	uint8_t listed;			/* by the latest MGT */
+};
+
+/* sorted by table_type */
+struct atsc_mgt_tracker {
+	int mgt_version;
+	int count;
+	int size;
+	struct mgt_tracker_table *tables;
+};
+
+struct atsc_mgt_tracker *atsc_mgt_tracker_create(void)
+{
+	struct atsc_mgt_tracker *tracker;
+
+	if ((tracker = calloc(1, sizeof(struct atsc_mgt_tracker))) == NULL)
+		return NULL;
+	tracker->mgt_version = -1;
+	return tracker;
+}
+
+void atsc_mgt_tracker_destroy(struct atsc_mgt_tracker *tracker)
+{
+	free(tracker->tables);
+	free(tracker);
+}
+
+void atsc_mgt_tracker_reset(struct atsc_mgt_tracker *tracker)
+{
+	tracker->mgt_version = -1;
+	tracker->count = 0;
+}
+
+static struct mgt_tracker_table *mgt_tracker_find(struct atsc_mgt_tracker *tracker,
+						  uint16_t table_type)
+{
+	int lo = 0, hi = tracker->count;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (tracker->tables[mid].table_type < table_type)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if ((lo < tracker->count) && (tracker->tables[lo].table_type == table_type))
+		return &tracker->tables[lo];
+	return NULL;
+}
+
+static struct mgt_tracker_table *mgt_tracker_add(struct atsc_mgt_tracker *tracker,
+						 uint16_t table_type)
+{
+	struct mgt_tracker_table *t;
+	int pos;
+
+	if (tracker->count == tracker->size) {
+		int size = tracker->size ? tracker->size * 2 : 32;
+
+		if ((t = realloc(tracker->tables, size * sizeof(struct mgt_tracker_table))) == NULL)
+			return NULL;
+		tracker->tables = t;
+		tracker->size = size;
+	}
+
+	for (pos = tracker->count; pos > 0; pos--) {
+		if (tracker->tables[pos - 1].table_type < table_type)
+			break;
+	}
+	memmove(&tracker->tables[pos + 1], &tracker->tables[pos],
+		(tracker->count - pos) * sizeof(struct mgt_tracker_table));
+	tracker->count++;
+
+	t = &tracker->tables[pos];
+	t->table_type = table_type;
+	t->cached = -1;
+	return t;
+}
+
+int atsc_mgt_tracker_update(struct atsc_mgt_tracker *tracker, struct atsc_mgt_section *mgt)
+{
+	struct atsc_mgt_table *cur;
+	struct mgt_tracker_table *t;
+	int stale = 0;
+	int idx, i, j;
+
+	if (mgt->head.ext_head.version_number != tracker->mgt_version) {
+		for (i = 0; i < tracker->count; i++)
+			tracker->tables[i].listed = 0;
+
+		atsc_mgt_section_tables_for_each(mgt, cur, idx) {
+			if (((t = mgt_tracker_find(tracker, cur->table_type)) == NULL) &&
+			    ((t = mgt_tracker_add(tracker, cur->table_type)) == NULL))
+				return -ENOMEM;
+			if (t->cached >= 0 && t->pid != cur->table_type_PID)
+				t->cached = -1;
+			t->pid = cur->table_type_PID;
+			t->version = cur->table_type_version_number;
+			t->listed = 1;
+		}
+
+		// drop what it no longer lists
+		for (i = 0, j = 0; i < tracker->count; i++) {
+			if (tracker->tables[i].listed)
+				tracker->tables[j++] = tracker->tables[i];
+		}
+		tracker->count = j;
+		tracker->mgt_version = mgt->head.ext_head.version_number;
+	}
+
+	for (i = 0; i < tracker->count; i++) {
+		if (tracker->tables[i].cached != tracker->tables[i].version)
+			stale++;
+	}
+	return stale;
+}
+
+int atsc_mgt_tracker_mgt_version(struct atsc_mgt_tracker *tracker)
+{
+	return tracker->mgt_version;
+}
+
+int atsc_mgt_tracker_stale(struct atsc_mgt_tracker *tracker, uint16_t table_type)
+{
+	struct mgt_tracker_table *t = mgt_tracker_find(tracker, table_type);
+
+	if (t == NULL)
+		return -1;
+	return t->cached != t->version;
+}
+
+int atsc_mgt_tracker_pid(struct atsc_mgt_tracker *tracker, uint16_t table_type)
+{
+	struct mgt_tracker_table *t = mgt_tracker_find(tracker, table_type);
+
+	return t ? t->pid : -1;
+}
+
+int atsc_mgt_tracker_version(struct atsc_mgt_tracker *tracker, uint16_t table_type)
+{
+	struct mgt_tracker_table *t = mgt_tracker_find(tracker, table_type);
+
+	return t ? t->version : -1;
+}
+
+void atsc_mgt_tracker_cached(struct atsc_mgt_tracker *tracker, uint16_t table_type,
+			     int version_number)
+{
+	struct mgt_tracker_table *t = mgt_tracker_find(tracker, table_type);
+
+	if (t)
+		t->cached = (version_number < 0) ? t->version : (version_number & 0x1f);
+}
+
+void atsc_mgt_tracker_forget(struct atsc_mgt_tracker *tracker, uint16_t table_type)
+{
+	struct mgt_tracker_table *t = mgt_tracker_find(tracker, table_type);
+
+	if (t)
+		t->cached = -1;
+}
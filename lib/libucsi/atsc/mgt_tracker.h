@@ -0,0 +1,141 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_ATSC_MGT_TRACKER_H
+#define _UCSI_ATSC_MGT_TRACKER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libucsi/atsc/mgt_section.h>
+
+/**
+ * PSIP acquisition by the MGT: the MGT lists the PID and version of every
+ * other PSIP table (TVCT/CVCT, channel ETT, EIT-k, ETT-k, RRT, ...), so a
+ * receiver holding those tables only has to read the MGT to know which of
+ * them changed. A tracker keeps, per table_type, what the latest MGT lists
+ * and which version the caller has cached, and says which tables need
+ * fetching again:
+ *
+ * 1) Decode an MGT and atsc_mgt_tracker_update() with it.
+ * 2) Fetch the tables for which atsc_mgt_tracker_stale() is 1, from
+ * atsc_mgt_tracker_pid().
+ * 3) Once one is complete, atsc_mgt_tracker_cached() it.
+ *
+ * An MGT of the version last seen only costs the version compare.
+ */
+struct atsc_mgt_tracker;
+
+/**
+ * Table types of the EIT-k and ETT-k.
+ */
+#define ATSC_MGT_TABLE_TYPE_EIT(k)	(0x0100 + (k))
+#define ATSC_MGT_TABLE_TYPE_ETT(k)	(0x0200 + (k))
+#define ATSC_MGT_TABLE_TYPE_RRT(region)	(0x0300 + (region))
+
+/**
+ * Create a new, empty tracker.
+ *
+ * @return The tracker, or NULL on error.
+ */
+extern struct atsc_mgt_tracker *atsc_mgt_tracker_create(void);
+
+/**
+ * Destroy a tracker.
+ *
+ * @param tracker The tracker.
+ */
+extern void atsc_mgt_tracker_destroy(struct atsc_mgt_tracker *tracker);
+
+/**
+ * Forget everything (e.g. after tuning to a different transport stream).
+ *
+ * @param tracker The tracker.
+ */
+extern void atsc_mgt_tracker_reset(struct atsc_mgt_tracker *tracker);
+
+/**
+ * Take in a decoded MGT. Tables it no longer lists are forgotten; a table
+ * whose listed PID changes is treated as not cached.
+ *
+ * @param tracker The tracker.
+ * @param mgt The decoded MGT.
+ * @return Number of tables now stale, or -ENOMEM.
+ */
+extern int atsc_mgt_tracker_update(struct atsc_mgt_tracker *tracker,
+				   struct atsc_mgt_section *mgt);
+
+/**
+ * @param tracker The tracker.
+ * @return The version of the MGT last taken in, or -1 if none.
+ */
+extern int atsc_mgt_tracker_mgt_version(struct atsc_mgt_tracker *tracker);
+
+/**
+ * Does a table need fetching?
+ *
+ * @param tracker The tracker.
+ * @param table_type MGT table_type of the table.
+ * @return 1 if the MGT lists a version other than the one cached, 0 if
+ * the cached version is current, or -1 if the MGT does not list it.
+ */
+extern int atsc_mgt_tracker_stale(struct atsc_mgt_tracker *tracker, uint16_t table_type);
+
+/**
+ * @param tracker The tracker.
+ * @param table_type MGT table_type of the table.
+ * @return The PID the MGT lists for the table, or -1 if it lists none.
+ */
+extern int atsc_mgt_tracker_pid(struct atsc_mgt_tracker *tracker, uint16_t table_type);
+
+/**
+ * @param tracker The tracker.
+ * @param table_type MGT table_type of the table.
+ * @return The version the MGT lists for the table, or -1 if it lists none.
+ */
+extern int atsc_mgt_tracker_version(struct atsc_mgt_tracker *tracker, uint16_t table_type);
+
+/**
+ * Record that a table has been fetched.
+ *
+ * @param tracker The tracker.
+ * @param table_type MGT table_type of the table.
+ * @param version_number Version that was fetched, or -1 for the one the
+ * MGT lists.
+ */
+extern void atsc_mgt_tracker_cached(struct atsc_mgt_tracker *tracker, uint16_t table_type,
+				    int version_number);
+
+/**
+ * Record that a table is no longer held, so it is stale again.
+ *
+ * @param tracker The tracker.
+ * @param table_type MGT table_type of the table.
+ */
+extern void atsc_mgt_tracker_forget(struct atsc_mgt_tracker *tracker, uint16_t table_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
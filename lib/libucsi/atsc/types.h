@@ -145,6 +145,25 @@ extern int atsc_text_validate(uint8_t *buf, int len);
 extern int atsc_text_segment_decode(struct atsc_text_string_segment *segment,
 				    uint8_t **destbuf, size_t *destbufsize, size_t *destbufpos);
 
+/**
+ * Decodes every string of an atsc_text structure in one go, into a buffer supplied by the
+ * caller which is never reallocated. Each string is written as NUL terminated UTF-8, one
+ * after the other, with the segments of a string joined together. The same restrictions
+ * on segment modes apply as for atsc_text_segment_decode().
+ *
+ * @param txt Pointer to the atsc_text structure.
+ * @param arena Buffer to write the strings to.
+ * @param arena_len Size of arena in bytes.
+ * @param strings Array set to the start of each string within arena, in the order of the
+ * strings in txt (may be NULL if max_strings is 0).
+ * @param max_strings Number of entries in strings.
+ * @return Number of bytes of arena used, -ENOSPC if it is too small, or another value < 0
+ * on error. On error, arena holds the strings decoded so far, the last one truncated
+ * but still NUL terminated.
+ */
+extern int atsc_text_decode(struct atsc_text *txt, uint8_t *arena, size_t arena_len,
+			    uint8_t **strings, int max_strings);
+
 /**
  * Convert from ATSC time to unix time_t.
  *
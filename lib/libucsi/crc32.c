@@ -19,6 +19,19 @@
  */
 
 #include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "crc32.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_HAVE_CLMUL 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define CRC32_HAVE_CLMUL 1
+#endif
 
 uint32_t crc32tbl[] =
 {
@@ -87,3 +100,340 @@ uint32_t crc32tbl[] =
 	0xafb010b1, 0xab710d06, 0xa6322bdf, 0xa2f33668,
 	0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
 };
+
+/* crc32tbl extended so crc32tbl8[k][b] is the CRC of byte b followed by k
+ * zero bytes. crc32tbl8[0] is a copy of crc32tbl. */
+static uint32_t crc32tbl8[8][256];
+
+/* folding constants: x^n mod P for the MPEG-2 polynomial 0x04c11db7 */
+#define CRC32_X128 0xe8a45605ULL
+#define CRC32_X192 0xc5b9cd4cULL
+#define CRC32_X512 0xe6228b11ULL
+#define CRC32_X576 0x8833794cULL
+
+typedef uint32_t (*crc32_fn)(uint32_t crc, uint8_t *buf, size_t len);
+
+static uint32_t crc32_resolve(uint32_t crc, uint8_t *buf, size_t len);
+
+static crc32_fn crc32_impl_fn = crc32_resolve;
+static enum crc32_impl crc32_impl_cur = crc32_impl_auto;
+
+static uint32_t crc32_table(uint32_t crc, uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i=0; i< len; i++) {
+		crc = (crc << 8) ^ crc32tbl[((crc >> 24) ^ buf[i]) & 0xff];
+	}
+
+	return crc;
+}
+
+static uint32_t crc32_slice8(uint32_t crc, uint8_t *buf, size_t len)
+{
+	uint32_t hi;
+	uint32_t lo;
+
+	while (len >= 8) {
+		hi = crc ^ (((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+			    ((uint32_t) buf[2] << 8) | buf[3]);
+		lo = ((uint32_t) buf[4] << 24) | ((uint32_t) buf[5] << 16) |
+		     ((uint32_t) buf[6] << 8) | buf[7];
+
+		crc = crc32tbl8[7][hi >> 24] ^
+		      crc32tbl8[6][(hi >> 16) & 0xff] ^
+		      crc32tbl8[5][(hi >> 8) & 0xff] ^
+		      crc32tbl8[4][hi & 0xff] ^
+		      crc32tbl8[3][lo >> 24] ^
+		      crc32tbl8[2][(lo >> 16) & 0xff] ^
+		      crc32tbl8[1][(lo >> 8) & 0xff] ^
+		      crc32tbl8[0][lo & 0xff];
+
+		buf += 8;
+		len -= 8;
+	}
+
+	return crc32_table(crc, buf, len);
+}
+
+/*
+ * The carry-less multiply implementations fold the buffer 64 bytes at a time
+ * into four 128 bit accumulators, then down to a single 128 bit remainder
+ * which is congruent to the message so far modulo P. That remainder and any
+ * trailing bytes are finished off with the slicing tables, which avoids
+ * needing a separate Barrett reduction step.
+ */
+
+#if defined(__x86_64__) || defined(__i386__)
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_clmul_load(uint8_t *buf, __m128i bswap)
+{
+	return _mm_shuffle_epi8(_mm_loadu_si128((__m128i *) buf), bswap);
+}
+
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i crc32_clmul_fold(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11),
+			     _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_clmul(uint32_t crc, uint8_t *buf, size_t len)
+{
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+					   8, 9, 10, 11, 12, 13, 14, 15);
+	const __m128i k512 = _mm_set_epi64x(CRC32_X576, CRC32_X512);
+	const __m128i k128 = _mm_set_epi64x(CRC32_X192, CRC32_X128);
+	__m128i x0, x1, x2, x3;
+	uint8_t tmp[16];
+
+	if (len < 64)
+		return crc32_slice8(crc, buf, len);
+
+	x0 = crc32_clmul_load(buf, bswap);
+	x1 = crc32_clmul_load(buf + 16, bswap);
+	x2 = crc32_clmul_load(buf + 32, bswap);
+	x3 = crc32_clmul_load(buf + 48, bswap);
+	x0 = _mm_xor_si128(x0, _mm_set_epi32(crc, 0, 0, 0));
+	buf += 64;
+	len -= 64;
+
+	while (len >= 64) {
+		x0 = _mm_xor_si128(crc32_clmul_fold(x0, k512), crc32_clmul_load(buf, bswap));
+		x1 = _mm_xor_si128(crc32_clmul_fold(x1, k512), crc32_clmul_load(buf + 16, bswap));
+		x2 = _mm_xor_si128(crc32_clmul_fold(x2, k512), crc32_clmul_load(buf + 32, bswap));
+		x3 = _mm_xor_si128(crc32_clmul_fold(x3, k512), crc32_clmul_load(buf + 48, bswap));
+		buf += 64;
+		len -= 64;
+	}
+
+	x1 = _mm_xor_si128(x1, crc32_clmul_fold(x0, k128));
+	x2 = _mm_xor_si128(x2, crc32_clmul_fold(x1, k128));
+	x3 = _mm_xor_si128(x3, crc32_clmul_fold(x2, k128));
+
+	while (len >= 16) {
+		x3 = _mm_xor_si128(crc32_clmul_fold(x3, k128), crc32_clmul_load(buf, bswap));
+		buf += 16;
+		len -= 16;
+	}
+
+	_mm_storeu_si128((__m128i *) tmp, _mm_shuffle_epi8(x3, bswap));
+	crc = crc32_slice8(0, tmp, sizeof(tmp));
+	return crc32_slice8(crc, buf, len);
+}
+
+static int crc32_clmul_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+#elif defined(__aarch64__)
+
+__attribute__((target("+crypto")))
+static inline uint64x2_t crc32_clmul_load(uint8_t *buf)
+{
+	uint8x16_t v = vrev64q_u8(vld1q_u8(buf));
+
+	/* lane 1 holds the high (earliest) 64 bits, as on x86 */
+	return vreinterpretq_u64_u8(vextq_u8(v, v, 8));
+}
+
+__attribute__((target("+crypto")))
+static inline uint64x2_t crc32_clmul_fold(uint64x2_t x, uint64_t khi, uint64_t klo)
+{
+	poly128_t hi = vmull_p64(vgetq_lane_u64(x, 1), khi);
+	poly128_t lo = vmull_p64(vgetq_lane_u64(x, 0), klo);
+
+	return veorq_u64(vreinterpretq_u64_p128(hi), vreinterpretq_u64_p128(lo));
+}
+
+__attribute__((target("+crypto")))
+static uint32_t crc32_clmul(uint32_t crc, uint8_t *buf, size_t len)
+{
+	uint64x2_t x0, x1, x2, x3;
+	uint8x16_t v;
+	uint8_t tmp[16];
+
+	if (len < 64)
+		return crc32_slice8(crc, buf, len);
+
+	x0 = crc32_clmul_load(buf);
+	x1 = crc32_clmul_load(buf + 16);
+	x2 = crc32_clmul_load(buf + 32);
+	x3 = crc32_clmul_load(buf + 48);
+	x0 = veorq_u64(x0, vcombine_u64(vcreate_u64(0), vcreate_u64((uint64_t) crc << 32)));
+	buf += 64;
+	len -= 64;
+
+	while (len >= 64) {
+		x0 = veorq_u64(crc32_clmul_fold(x0, CRC32_X576, CRC32_X512), crc32_clmul_load(buf));
+		x1 = veorq_u64(crc32_clmul_fold(x1, CRC32_X576, CRC32_X512), crc32_clmul_load(buf + 16));
+		x2 = veorq_u64(crc32_clmul_fold(x2, CRC32_X576, CRC32_X512), crc32_clmul_load(buf + 32));
+		x3 = veorq_u64(crc32_clmul_fold(x3, CRC32_X576, CRC32_X512), crc32_clmul_load(buf + 48));
+		buf += 64;
+		len -= 64;
+	}
+
+	x1 = veorq_u64(x1, crc32_clmul_fold(x0, CRC32_X192, CRC32_X128));
+	x2 = veorq_u64(x2, crc32_clmul_fold(x1, CRC32_X192, CRC32_X128));
+	x3 = veorq_u64(x3, crc32_clmul_fold(x2, CRC32_X192, CRC32_X128));
+
+	while (len >= 16) {
+		x3 = veorq_u64(crc32_clmul_fold(x3, CRC32_X192, CRC32_X128), crc32_clmul_load(buf));
+		buf += 16;
+		len -= 16;
+	}
+
+	v = vrev64q_u8(vreinterpretq_u8_u64(x3));
+	vst1q_u8(tmp, vextq_u8(v, v, 8));
+	crc = crc32_slice8(0, tmp, sizeof(tmp));
+	return crc32_slice8(crc, buf, len);
+}
+
+static int crc32_clmul_supported(void)
+{
+	return (getauxval(AT_HWCAP) & HWCAP_PMULL) != 0;
+}
+
+#endif
+
+static void crc32_init_tables(void)
+{
+	int i, k;
+
+	memcpy(crc32tbl8[0], crc32tbl, sizeof(crc32tbl8[0]));
+	for(k=1; k < 8; k++) {
+		for(i=0; i < 256; i++) {
+			uint32_t prev = crc32tbl8[k-1][i];
+			crc32tbl8[k][i] = (prev << 8) ^ crc32tbl[prev >> 24];
+		}
+	}
+}
+
+__attribute__((constructor))
+static void crc32_init(void)
+{
+	if (crc32_impl_cur == crc32_impl_auto)
+		crc32_select(crc32_impl_auto);
+}
+
+static uint32_t crc32_resolve(uint32_t crc, uint8_t *buf, size_t len)
+{
+	crc32_init();
+	return crc32_impl_fn(crc, buf, len);
+}
+
+uint32_t crc32_bulk(uint32_t crc, uint8_t *buf, size_t len)
+{
+	return crc32_impl_fn(crc, buf, len);
+}
+
+int crc32_select(enum crc32_impl impl)
+{
+	if (crc32_impl_cur == crc32_impl_auto)
+		crc32_init_tables();
+
+	switch(impl) {
+	case crc32_impl_auto:
+#ifdef CRC32_HAVE_CLMUL
+		if (crc32_clmul_supported())
+			return crc32_select(crc32_impl_clmul);
+#endif
+		return crc32_select(crc32_impl_slice8);
+
+	case crc32_impl_table:
+		crc32_impl_fn = crc32_table;
+		break;
+
+	case crc32_impl_slice8:
+		crc32_impl_fn = crc32_slice8;
+		break;
+
+	case crc32_impl_clmul:
+#ifdef CRC32_HAVE_CLMUL
+		if (!crc32_clmul_supported())
+			return -1;
+		crc32_impl_fn = crc32_clmul;
+		break;
+#else
+		return -1;
+#endif
+
+	default:
+		return -1;
+	}
+
+	crc32_impl_cur = impl;
+	return 0;
+}
+
+enum crc32_impl crc32_selected(void)
+{
+	crc32_init();
+	return crc32_impl_cur;
+}
+
+/* x^(8*2^k) mod P, for crc32_zeros() */
+static const uint32_t crc32_zeros_tbl[64] = {
+	0x00000100, 0x00010000, 0x04c11db7, 0x490d678d,
+	0xe8a45605, 0x75be46b7, 0xe6228b11, 0x567fddeb,
+	0x88fe2237, 0x0e857e71, 0x7001e426, 0x075de2b2,
+	0xf12a7f90, 0xf0b4a1c1, 0x58f46c0c, 0xc3395ade,
+	0x96837f8c, 0x544037f9, 0x23b7b136, 0xb2e16ba8,
+	0x725e7bfa, 0xec709b5d, 0xf77a7274, 0x2845d572,
+	0x034e2515, 0x79695942, 0x540cb128, 0x0b65d023,
+	0x3c344723, 0x00000002, 0x00000004, 0x00000010,
+	0x00000100, 0x00010000, 0x04c11db7, 0x490d678d,
+	0xe8a45605, 0x75be46b7, 0xe6228b11, 0x567fddeb,
+	0x88fe2237, 0x0e857e71, 0x7001e426, 0x075de2b2,
+	0xf12a7f90, 0xf0b4a1c1, 0x58f46c0c, 0xc3395ade,
+	0x96837f8c, 0x544037f9, 0x23b7b136, 0xb2e16ba8,
+	0x725e7bfa, 0xec709b5d, 0xf77a7274, 0x2845d572,
+	0x034e2515, 0x79695942, 0x540cb128, 0x0b65d023,
+	0x3c344723, 0x00000002, 0x00000004, 0x00000010,
+};
+
+/* a * b mod P, over GF(2) */
+static uint32_t crc32_mul(uint32_t a, uint32_t b)
+{
+	uint32_t r = 0;
+	int i;
+
+	for (i = 31; i >= 0; i--) {
+		r = (r << 1) ^ ((r & 0x80000000) ? 0x04c11db7 : 0);
+		if (b & (1u << i))
+			r ^= a;
+	}
+	return r;
+}
+
+uint32_t crc32_zeros(uint32_t crc, size_t len)
+{
+	int k;
+
+	if (len < 4) {
+		while (len--)
+			crc = (crc << 8) ^ crc32tbl[crc >> 24];
+		return crc;
+	}
+
+	for (k = 0; len; k++, len >>= 1) {
+		if (len & 1)
+			crc = crc32_mul(crc, crc32_zeros_tbl[k]);
+	}
+	return crc;
+}
+
+uint32_t crc32_patch(uint32_t crc, const uint8_t *delta, size_t len, size_t after)
+{
+	uint32_t d = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		d = (d << 8) ^ crc32tbl[((d >> 24) ^ delta[i]) & 0xff];
+
+	return crc ^ crc32_zeros(d, after);
+}
@@ -22,6 +22,7 @@
 #define _UCSI_CRC32_H 1
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C"
@@ -30,8 +31,75 @@ extern "C"
 
 #define CRC32_INIT (~0)
 
+/**
+ * Buffers shorter than this are processed inline with the plain table; longer
+ * ones are handed to crc32_bulk().
+ */
+#define CRC32_BULK_MIN 64
+
 extern uint32_t crc32tbl[];
 
+/**
+ * Implementations available for crc32_bulk().
+ */
+enum crc32_impl {
+	crc32_impl_auto,	/* best implementation supported by this CPU */
+	crc32_impl_table,	/* original one byte per iteration table */
+	crc32_impl_slice8,	/* slicing-by-8 tables */
+	crc32_impl_clmul,	/* PCLMULQDQ (x86) / PMULL (ARMv8) folding */
+};
+
+/**
+ * Calculate a CRC32 over a buffer using the fastest available implementation.
+ * This produces exactly the same result as the table loop in crc32().
+ *
+ * @param crc Current CRC value (use CRC32_INIT for first call).
+ * @param buf Buffer to calculate over.
+ * @param len Number of bytes.
+ * @return Calculated CRC.
+ */
+extern uint32_t crc32_bulk(uint32_t crc, uint8_t *buf, size_t len);
+
+/**
+ * Force the implementation used by crc32_bulk(). Mainly useful for testing
+ * and benchmarking - the best one is chosen automatically at startup.
+ *
+ * @param impl One of enum crc32_impl.
+ * @return 0 on success, or -1 if the implementation is not supported here.
+ */
+extern int crc32_select(enum crc32_impl impl);
+
+/**
+ * Retrieve the implementation currently used by crc32_bulk().
+ *
+ * @return One of enum crc32_impl (never crc32_impl_auto).
+ */
+extern enum crc32_impl crc32_selected(void);
+
+/**
+ * Run a CRC32 over len zero bytes, without touching memory. This is the
+ * CRC multiplied by x^(8*len), so it takes O(log len) steps.
+ *
+ * @param crc Current CRC value.
+ * @param len Number of zero bytes.
+ * @return The same value as crc32() over len zero bytes.
+ */
+extern uint32_t crc32_zeros(uint32_t crc, size_t len);
+
+/**
+ * Update the CRC32 of a buffer after some of its bytes have been changed,
+ * without running over the rest of it. The CRC is linear, so the change is
+ * the CRC (from 0) of the XOR of the old and new bytes, carried over the
+ * bytes that follow them.
+ *
+ * @param crc CRC of the buffer before the change.
+ * @param delta The old bytes XORed with the new ones.
+ * @param len Number of changed bytes.
+ * @param after Number of bytes after them which the CRC covers.
+ * @return The CRC of the changed buffer.
+ */
+extern uint32_t crc32_patch(uint32_t crc, const uint8_t *delta, size_t len, size_t after);
+
 /**
  * Calculate a CRC32 over a piece of data.
  *
@@ -44,6 +112,9 @@ static inline uint32_t crc32(uint32_t crc, uint8_t* buf, size_t len)
 {
 	size_t i;
 
+	if (len >= CRC32_BULK_MIN)
+		return crc32_bulk(crc, buf, len);
+
 	for (i=0; i< len; i++) {
 		crc = (crc << 8) ^ crc32tbl[((crc >> 24) ^ buf[i]) & 0xff];
 	}
@@ -0,0 +1,148 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_DESCRIPTOR_INDEX_H
+#define _UCSI_DESCRIPTOR_INDEX_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <libucsi/descriptor.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Tag index of one descriptor loop, built in a single walk of the loop.
+ *
+ * Afterwards, whether a tag is present and where its first descriptor is are
+ * answered without walking the loop again. It works on any descriptor loop:
+ * program info or a PMT stream, an SDT service, an EIT event and so on.
+ * Descriptor headers are never byte swapped, so the loop may come from a
+ * raw section or from one already passed through a *_section_codec().
+ *
+ * Building only clears the presence bitmap, so an index may be reused for
+ * every loop in a section at little cost.
+ */
+struct descriptor_index {
+	const uint8_t *buf;
+	size_t len;
+	uint32_t present[256 / 32];	/* bit set for each tag seen */
+	uint16_t first[256];		/* offset of the first descriptor with a tag */
+};
+
+/**
+ * Build the index for a descriptor loop.
+ *
+ * @param idx Index to fill in.
+ * @param buf Start of the descriptor loop.
+ * @param len Length of the loop.
+ * @return 0 on success, or -1 if the loop is malformed. Descriptors before
+ * the malformed one are still indexed.
+ */
+static inline int descriptor_index_build(struct descriptor_index *idx,
+					 const uint8_t *buf, size_t len)
+{
+	size_t pos = 0;
+	int i;
+
+	idx->buf = buf;
+	idx->len = 0;
+	for (i = 0; i < (256 / 32); i++)
+		idx->present[i] = 0;
+
+	while ((pos + 2) <= len) {
+		uint8_t tag = buf[pos];
+		size_t next = pos + 2 + buf[pos + 1];
+
+		if ((next > len) || (pos > 0xffff))
+			break;
+
+		if (!(idx->present[tag >> 5] & (1U << (tag & 31)))) {
+			idx->present[tag >> 5] |= 1U << (tag & 31);
+			idx->first[tag] = pos;
+		}
+		pos = next;
+	}
+	idx->len = pos;
+
+	if (pos != len)
+		return -1;
+	return 0;
+}
+
+/**
+ * Check if a descriptor loop holds a descriptor with a tag.
+ *
+ * @param idx The index.
+ * @param tag Descriptor tag.
+ * @return 1 if it does, 0 if not.
+ */
+static inline int descriptor_index_has(const struct descriptor_index *idx, uint8_t tag)
+{
+	return (idx->present[tag >> 5] >> (tag & 31)) & 1;
+}
+
+/**
+ * Retrieve the first descriptor with a tag.
+ *
+ * @param idx The index.
+ * @param tag Descriptor tag.
+ * @return Pointer to the descriptor, or NULL if there is none.
+ */
+static inline const struct descriptor *
+	descriptor_index_find(const struct descriptor_index *idx, uint8_t tag)
+{
+	if (!descriptor_index_has(idx, tag))
+		return NULL;
+
+	return (const struct descriptor *) (idx->buf + idx->first[tag]);
+}
+
+/**
+ * Retrieve the next descriptor with the same tag as pos, for tags which may
+ * appear more than once in a loop. This walks forward from pos.
+ *
+ * @param idx The index.
+ * @param pos A descriptor returned by descriptor_index_find() or by this.
+ * @return Pointer to the descriptor, or NULL if there are no more.
+ */
+static inline const struct descriptor *
+	descriptor_index_find_next(const struct descriptor_index *idx,
+				   const struct descriptor *pos)
+{
+	const uint8_t *end = idx->buf + idx->len;
+	const uint8_t *next = (const uint8_t *) pos + 2 + pos->len;
+
+	while (next < end) {
+		if (next[0] == pos->tag)
+			return (const struct descriptor *) next;
+		next += 2 + next[1];
+	}
+
+	return NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
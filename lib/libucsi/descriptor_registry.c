@@ -0,0 +1,167 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libucsi/mpeg/descriptor.h>
+#include <libucsi/dvb/descriptor.h>
+#include <libucsi/atsc/descriptor.h>
+#include "descriptor_registry.h"
+
+/*
+ * The descriptors of each standard, as (tag, name). Each name is both the
+ * structure and the prefix of its codec, name_codec().
+ */
+#define MPEG_DESCRIPTORS(X) \
+	X(dtag_mpeg_video_stream,			mpeg_video_stream_descriptor) \
+	X(dtag_mpeg_audio_stream,			mpeg_audio_stream_descriptor) \
+	X(dtag_mpeg_hierarchy,				mpeg_hierarchy_descriptor) \
+	X(dtag_mpeg_registration,			mpeg_registration_descriptor) \
+	X(dtag_mpeg_data_stream_alignment,		mpeg_data_stream_alignment_descriptor) \
+	X(dtag_mpeg_target_background_grid,		mpeg_target_background_grid_descriptor) \
+	X(dtag_mpeg_video_window,			mpeg_video_window_descriptor) \
+	X(dtag_mpeg_ca,					mpeg_ca_descriptor) \
+	X(dtag_mpeg_iso_639_language,			mpeg_iso_639_language_descriptor) \
+	X(dtag_mpeg_system_clock,			mpeg_system_clock_descriptor) \
+	X(dtag_mpeg_multiplex_buffer_utilization,	mpeg_multiplex_buffer_utilization_descriptor) \
+	X(dtag_mpeg_copyright,				mpeg_copyright_descriptor) \
+	X(dtag_mpeg_maximum_bitrate,			mpeg_maximum_bitrate_descriptor) \
+	X(dtag_mpeg_private_data_indicator,		mpeg_private_data_indicator_descriptor) \
+	X(dtag_mpeg_smoothing_buffer,			mpeg_smoothing_buffer_descriptor) \
+	X(dtag_mpeg_std,				mpeg_std_descriptor) \
+	X(dtag_mpeg_ibp,				mpeg_ibp_descriptor) \
+	X(dtag_mpeg_4_video,				mpeg4_video_descriptor) \
+	X(dtag_mpeg_4_audio,				mpeg4_audio_descriptor) \
+	X(dtag_mpeg_iod,				mpeg_iod_descriptor) \
+	X(dtag_mpeg_sl,					mpeg_sl_descriptor) \
+	X(dtag_mpeg_fmc,				mpeg_fmc_descriptor) \
+	X(dtag_mpeg_external_es_id,			mpeg_external_es_id_descriptor) \
+	X(dtag_mpeg_muxcode,				mpeg_muxcode_descriptor) \
+	X(dtag_mpeg_fmxbuffer_size,			mpeg_fmxbuffer_size_descriptor) \
+	X(dtag_mpeg_multiplex_buffer,			mpeg_multiplex_buffer_descriptor) \
+	X(dtag_mpeg_content_labelling,			mpeg_content_labelling_descriptor) \
+	X(dtag_mpeg_metadata_pointer,			mpeg_metadata_pointer_descriptor) \
+	X(dtag_mpeg_metadata,				mpeg_metadata_descriptor) \
+	X(dtag_mpeg_metadata_std,			mpeg_metadata_std_descriptor)
+
+#define DVB_DESCRIPTORS(X) \
+	X(dtag_dvb_network_name,			dvb_network_name_descriptor) \
+	X(dtag_dvb_service_list,			dvb_service_list_descriptor) \
+	X(dtag_dvb_stuffing,				dvb_stuffing_descriptor) \
+	X(dtag_dvb_satellite_delivery_system,		dvb_satellite_delivery_descriptor) \
+	X(dtag_dvb_cable_delivery_system,		dvb_cable_delivery_descriptor) \
+	X(dtag_dvb_vbi_data,				dvb_vbi_data_descriptor) \
+	X(dtag_dvb_vbi_teletext,			dvb_vbi_teletext_descriptor) \
+	X(dtag_dvb_bouquet_name,			dvb_bouquet_name_descriptor) \
+	X(dtag_dvb_service,				dvb_service_descriptor) \
+	X(dtag_dvb_country_availability,		dvb_country_availability_descriptor) \
+	X(dtag_dvb_linkage,				dvb_linkage_descriptor) \
+	X(dtag_dvb_nvod_reference,			dvb_nvod_reference_descriptor) \
+	X(dtag_dvb_time_shifted_service,		dvb_time_shifted_service_descriptor) \
+	X(dtag_dvb_short_event,				dvb_short_event_descriptor) \
+	X(dtag_dvb_extended_event,			dvb_extended_event_descriptor) \
+	X(dtag_dvb_time_shifted_event,			dvb_time_shifted_event_descriptor) \
+	X(dtag_dvb_component,				dvb_component_descriptor) \
+	X(dtag_dvb_mosaic,				dvb_mosaic_descriptor) \
+	X(dtag_dvb_stream_identifier,			dvb_stream_identifier_descriptor) \
+	X(dtag_dvb_ca_identifier,			dvb_ca_identifier_descriptor) \
+	X(dtag_dvb_content,				dvb_content_descriptor) \
+	X(dtag_dvb_parental_rating,			dvb_parental_rating_descriptor) \
+	X(dtag_dvb_teletext,				dvb_teletext_descriptor) \
+	X(dtag_dvb_telephone,				dvb_telephone_descriptor) \
+	X(dtag_dvb_local_time_offset,			dvb_local_time_offset_descriptor) \
+	X(dtag_dvb_subtitling,				dvb_subtitling_descriptor) \
+	X(dtag_dvb_terrestial_delivery_system,		dvb_terrestrial_delivery_descriptor) \
+	X(dtag_dvb_multilingual_network_name,		dvb_multilingual_network_name_descriptor) \
+	X(dtag_dvb_multilingual_bouquet_name,		dvb_multilingual_bouquet_name_descriptor) \
+	X(dtag_dvb_multilingual_service_name,		dvb_multilingual_service_name_descriptor) \
+	X(dtag_dvb_multilingual_component,		dvb_multilingual_component_descriptor) \
+	X(dtag_dvb_private_data_specifier,		dvb_private_data_specifier_descriptor) \
+	X(dtag_dvb_service_move,			dvb_service_move_descriptor) \
+	X(dtag_dvb_short_smoothing_buffer,		dvb_short_smoothing_buffer_descriptor) \
+	X(dtag_dvb_frequency_list,			dvb_frequency_list_descriptor) \
+	X(dtag_dvb_partial_transport_stream,		dvb_partial_transport_stream_descriptor) \
+	X(dtag_dvb_data_broadcast,			dvb_data_broadcast_descriptor) \
+	X(dtag_dvb_scrambling,				dvb_scrambling_descriptor) \
+	X(dtag_dvb_data_broadcast_id,			dvb_data_broadcast_id_descriptor) \
+	X(dtag_dvb_transport_stream,			dvb_transport_stream_descriptor) \
+	X(dtag_dvb_dsng,				dvb_dsng_descriptor) \
+	X(dtag_dvb_pdc,					dvb_pdc_descriptor) \
+	X(dtag_dvb_ac3,					dvb_ac3_descriptor) \
+	X(dtag_dvb_ancillary_data,			dvb_ancillary_data_descriptor) \
+	X(dtag_dvb_cell_list,				dvb_cell_list_descriptor) \
+	X(dtag_dvb_cell_frequency_link,			dvb_cell_frequency_link_descriptor) \
+	X(dtag_dvb_announcement_support,		dvb_announcement_support_descriptor) \
+	X(dtag_dvb_application_signalling,		dvb_application_signalling_descriptor) \
+	X(dtag_dvb_adaptation_field_data,		dvb_adaptation_field_data_descriptor) \
+	X(dtag_dvb_service_identifier,			dvb_service_identifier_descriptor) \
+	X(dtag_dvb_service_availability,		dvb_service_availability_descriptor) \
+	X(dtag_dvb_default_authority,			dvb_default_authority_descriptor) \
+	X(dtag_dvb_related_content,			dvb_related_content_descriptor) \
+	X(dtag_dvb_tva_id,				dvb_tva_id_descriptor) \
+	X(dtag_dvb_content_identifier,			dvb_content_identifier_descriptor) \
+	X(dtag_dvb_time_slice_fec_identifier,		dvb_time_slice_fec_identifier_descriptor) \
+	X(dtag_dvb_s2_satellite_delivery_descriptor,	dvb_s2_satellite_delivery_descriptor)
+
+#define ATSC_DESCRIPTORS(X) \
+	X(dtag_atsc_stuffing,				atsc_stuffing_descriptor) \
+	X(dtag_atsc_ac3_audio,				atsc_ac3_descriptor) \
+	X(dtag_atsc_caption_service,			atsc_caption_service_descriptor) \
+	X(dtag_atsc_content_advisory,			atsc_content_advisory_descriptor) \
+	X(dtag_atsc_extended_channel_name,		atsc_extended_channel_name_descriptor) \
+	X(dtag_atsc_service_location,			atsc_service_location_descriptor) \
+	X(dtag_atsc_time_shifted_service,		atsc_time_shifted_service_descriptor) \
+	X(dtag_atsc_component_name,			atsc_component_name_descriptor) \
+	X(dtag_atsc_dcc_departing_request,		atsc_dcc_departing_request_descriptor) \
+	X(dtag_atsc_dcc_arriving_request,		atsc_dcc_arriving_request_descriptor) \
+	X(dtag_atsc_redistribution_control,		atsc_rc_descriptor) \
+	X(dtag_atsc_genre,				atsc_genre_descriptor)
+
+/* the codecs are inline and typed, so each gets an untyped wrapper */
+#define DECODER(tag, type) \
+	static void *type##_decode(struct descriptor *d) \
+	{ \
+		return type##_codec(d); \
+	}
+
+#define MIN_LEN(tag, type)	[tag] = sizeof(struct type) - sizeof(struct descriptor),
+#define DECODE(tag, type)	[tag] = type##_decode,
+#define NAME(tag, type)		[tag] = #type,
+
+#define REGISTRY(regname, LIST1, LIST2) \
+	{ \
+		.name = regname, \
+		.min_len = { LIST1(MIN_LEN) LIST2(MIN_LEN) }, \
+		.decode = { LIST1(DECODE) LIST2(DECODE) }, \
+		.names = { LIST1(NAME) LIST2(NAME) }, \
+	}
+
+#define NO_DESCRIPTORS(X)
+
+MPEG_DESCRIPTORS(DECODER)
+DVB_DESCRIPTORS(DECODER)
+ATSC_DESCRIPTORS(DECODER)
+
+const struct descriptor_registry descriptor_registry_mpeg =
+	REGISTRY("mpeg", MPEG_DESCRIPTORS, NO_DESCRIPTORS);
+
+const struct descriptor_registry descriptor_registry_dvb =
+	REGISTRY("dvb", MPEG_DESCRIPTORS, DVB_DESCRIPTORS);
+
+const struct descriptor_registry descriptor_registry_atsc =
+	REGISTRY("atsc", MPEG_DESCRIPTORS, ATSC_DESCRIPTORS);
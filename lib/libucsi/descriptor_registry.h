@@ -0,0 +1,136 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_DESCRIPTOR_REGISTRY_H
+#define _UCSI_DESCRIPTOR_REGISTRY_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <libucsi/descriptor.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Table of the descriptor codecs of one standard, indexed by tag.
+ *
+ * The tables are generated from the lists in descriptor_registry.c, so a
+ * consumer that handles descriptors generically (dumping, counting,
+ * validating whole loops) dispatches on the tag with one load instead of a
+ * switch over every *_descriptor_codec().
+ *
+ * min_len is the length of the fixed part of each descriptor: no codec
+ * accepts a shorter one, so a loop can be checked against it without
+ * decoding anything. It is 0 for tags without a codec. The arrays are kept
+ * apart so that validation only touches the 256 byte min_len array.
+ *
+ * Only the tags of the main SI tables are included. The tags private to the
+ * AIT, INT and RNT overlap the MPEG ones and must still be decoded by hand.
+ */
+struct descriptor_registry {
+	const char *name;
+	uint8_t min_len[256];
+	void *(*decode[256])(struct descriptor *d);
+	const char *names[256];
+};
+
+/**
+ * The MPEG-2 descriptors (tags 0x02 to 0x3f).
+ */
+extern const struct descriptor_registry descriptor_registry_mpeg;
+
+/**
+ * The MPEG-2 and DVB SI descriptors.
+ */
+extern const struct descriptor_registry descriptor_registry_dvb;
+
+/**
+ * The MPEG-2 and ATSC PSIP descriptors.
+ */
+extern const struct descriptor_registry descriptor_registry_atsc;
+
+/**
+ * Decode a descriptor with the codec for its tag. As with the codecs
+ * themselves this works in place, so a descriptor must only be decoded once.
+ *
+ * @param reg The registry.
+ * @param d The descriptor.
+ * @return Pointer to the decoded descriptor (to be cast to the structure for
+ * its tag), or NULL if the tag is unknown or the descriptor is invalid.
+ */
+static inline void *descriptor_registry_decode(const struct descriptor_registry *reg,
+					       struct descriptor *d)
+{
+	if ((reg->decode[d->tag] == NULL) || (d->len < reg->min_len[d->tag]))
+		return NULL;
+
+	return reg->decode[d->tag](d);
+}
+
+/**
+ * Retrieve the name of the descriptor for a tag.
+ *
+ * @param reg The registry.
+ * @param tag The tag.
+ * @return The name, or NULL if the tag is unknown.
+ */
+static inline const char *descriptor_registry_name(const struct descriptor_registry *reg,
+						   uint8_t tag)
+{
+	return reg->names[tag];
+}
+
+/**
+ * Check a descriptor loop in one pass: the lengths must chain up to exactly
+ * the end of the loop, and no descriptor with a known tag may be shorter
+ * than its fixed part. Nothing is byte swapped.
+ *
+ * @param reg The registry.
+ * @param buf Start of the descriptor loop.
+ * @param len Length of the loop.
+ * @return The number of descriptors in the loop, or -1 if it is malformed.
+ */
+static inline int descriptor_registry_validate(const struct descriptor_registry *reg,
+					       const uint8_t *buf, size_t len)
+{
+	size_t pos = 0;
+	int count = 0;
+	int bad = 0;
+
+	/* accumulate instead of branching, the loop is almost always fine */
+	while ((pos + 2) <= len) {
+		bad |= buf[pos + 1] < reg->min_len[buf[pos]];
+		pos += 2 + buf[pos + 1];
+		count++;
+	}
+
+	if (bad || (pos != len))
+		return -1;
+
+	return count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
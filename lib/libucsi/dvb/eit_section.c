@@ -61,3 +61,21 @@ struct dvb_eit_section *dvb_eit_section_codec(struct section_ext * ext)
 
 	return (struct dvb_eit_section *) ext;
 }
+
+int dvb_eit_section_event_times(struct dvb_eit_section *eit,
+				struct dvb_eit_event_time *times, int max)
+{
+	struct dvb_eit_event *cur_event;
+	int count = 0;
+
+	dvb_eit_section_events_for_each(eit, cur_event) {
+		if (count == max)
+			break;
+		times[count].event_id = cur_event->event_id;
+		times[count].start_time = dvbdate_to_unixtime_fast(cur_event->start_time);
+		times[count].duration = dvbduration_to_seconds_fast(cur_event->duration);
+		count++;
+	}
+
+	return count;
+}
@@ -76,6 +76,27 @@ static inline uint16_t dvb_eit_section_service_id(struct dvb_eit_section *eit)
 	return eit->head.table_id_ext;
 }
 
+/**
+ * Times of an event, as decoded by dvb_eit_section_event_times().
+ */
+struct dvb_eit_event_time {
+	uint16_t event_id;
+	time_t start_time;		/* -1 if undefined */
+	uint32_t duration;		/* in seconds */
+};
+
+/**
+ * Decode the start times and durations of all the events of a section in
+ * one pass, with the integer conversions of dvbdate_to_unixtime_fast().
+ *
+ * @param eit dvb_eit_section pointer.
+ * @param times Where to put the times.
+ * @param max Size of the times array.
+ * @return Number of events decoded (at most max).
+ */
+extern int dvb_eit_section_event_times(struct dvb_eit_section *eit,
+				       struct dvb_eit_event_time *times, int max);
+
 /**
  * Iterator for the events field of a dvb_eit_section.
  *
@@ -0,0 +1,320 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mpe_fec_frame.h"
+
+/*
+ * The frame is kept as one table of rows * 255 bytes in column order, the
+ * application data table then the RS data table, so the addresses of the
+ * sections are offsets into it and each row is an RS(255,191) codeword.
+ * Bytes not received are erasures, of which RS can correct 64 per row.
+ */
+#define CODEWORD 255
+#define GF_POLY 0x11d
+
+struct mpe_fec_frame {
+	int rows;
+	mpe_fec_frame_callback callback;
+	void *private;
+
+	uint8_t *data;
+	uint8_t *valid;
+	int data_end;
+	int padding_columns;
+	int last_address;
+	int have_fec;
+	int empty;
+
+	struct mpe_fec_frame_stats stats;
+
+	uint8_t gf_log[256];
+	uint8_t gf_exp[2 * CODEWORD];
+};
+
+static inline uint8_t gf_mul(struct mpe_fec_frame *frame, uint8_t a, uint8_t b)
+{
+	if ((a == 0) || (b == 0))
+		return 0;
+	return frame->gf_exp[frame->gf_log[a] + frame->gf_log[b]];
+}
+
+static inline uint8_t gf_div(struct mpe_fec_frame *frame, uint8_t a, uint8_t b)
+{
+	if (a == 0)
+		return 0;
+	return frame->gf_exp[frame->gf_log[a] + CODEWORD - frame->gf_log[b]];
+}
+
+static void reset_frame(struct mpe_fec_frame *frame)
+{
+	memset(frame->valid, 0, frame->rows * CODEWORD);
+	frame->data_end = -1;
+	frame->padding_columns = 0;
+	frame->last_address = -1;
+	frame->have_fec = 0;
+	frame->empty = 1;
+}
+
+struct mpe_fec_frame *mpe_fec_frame_create(int rows, mpe_fec_frame_callback callback, void *private)
+{
+	struct mpe_fec_frame *frame;
+	int i, x;
+
+	if ((rows < 256) || (rows > 1024) || (rows % 256))
+		return NULL;
+
+	frame = (struct mpe_fec_frame *) malloc(sizeof(struct mpe_fec_frame));
+	if (frame == NULL)
+		return NULL;
+	memset(frame, 0, sizeof(struct mpe_fec_frame));
+
+	frame->data = (uint8_t *) malloc(rows * CODEWORD);
+	frame->valid = (uint8_t *) malloc(rows * CODEWORD);
+	if ((frame->data == NULL) || (frame->valid == NULL)) {
+		mpe_fec_frame_destroy(frame);
+		return NULL;
+	}
+
+	frame->rows = rows;
+	frame->callback = callback;
+	frame->private = private;
+
+	for (i = 0, x = 1; i < CODEWORD; i++) {
+		frame->gf_exp[i] = frame->gf_exp[i + CODEWORD] = x;
+		frame->gf_log[x] = i;
+		x <<= 1;
+		if (x & 0x100)
+			x ^= GF_POLY;
+	}
+
+	reset_frame(frame);
+	return frame;
+}
+
+void mpe_fec_frame_destroy(struct mpe_fec_frame *frame)
+{
+	if (frame == NULL)
+		return;
+
+	free(frame->data);
+	free(frame->valid);
+	free(frame);
+}
+
+static void add_bytes(struct mpe_fec_frame *frame, int pos, uint8_t *buf, int len)
+{
+	memcpy(frame->data + pos, buf, len);
+	memset(frame->valid + pos, 1, len);
+	frame->empty = 0;
+}
+
+int mpe_fec_frame_add_datagram(struct mpe_fec_frame *frame, struct datagram_section *d)
+{
+	uint8_t *buf = datagram_section_ip_data(d);
+	int len = datagram_section_ip_data_length(d);
+	int address;
+
+	/* the real time parameters replace MAC_address_4 to MAC_address_1 */
+	address = ((d->MAC_address_3 & 0x03) << 16) | (d->MAC_address_2 << 8) | d->MAC_address_1;
+
+	if (d->LLC_SNAP_flag || (len <= 0) ||
+	    (address + len > frame->rows * MPE_FEC_ADT_COLUMNS))
+		return -EINVAL;
+
+	if ((!frame->empty) && (frame->have_fec || (address <= frame->last_address)))
+		mpe_fec_frame_flush(frame);
+
+	add_bytes(frame, address, buf, len);
+	frame->last_address = address;
+	if (d->MAC_address_3 & 0x08)
+		frame->data_end = address + len;
+
+	return 0;
+}
+
+int mpe_fec_frame_add_fec(struct mpe_fec_frame *frame, struct mpe_fec_section *s)
+{
+	struct real_time_parameters rt = s->real_time_parameters;
+	int len = mpe_fec_section_rs_data_length(s);
+	int pos = frame->rows * MPE_FEC_ADT_COLUMNS + rt.address;
+
+	if ((len <= 0) || (s->padding_columns >= MPE_FEC_ADT_COLUMNS) ||
+	    (pos + len > frame->rows * CODEWORD))
+		return -EINVAL;
+
+	add_bytes(frame, pos, mpe_fec_section_rs_data(s), len);
+	frame->padding_columns = s->padding_columns;
+	frame->have_fec = 1;
+
+	if (rt.frame_boundary)
+		mpe_fec_frame_flush(frame);
+
+	return 0;
+}
+
+/*
+ * Erasure decoding of one codeword, its first byte being the coefficient of
+ * x^254. The roots of the generator polynomial are alpha^0 to alpha^63.
+ */
+static void correct_row(struct mpe_fec_frame *frame, uint8_t *c, int *erasures, int count)
+{
+	uint8_t syndrome[MPE_FEC_RS_COLUMNS];
+	uint8_t gamma[MPE_FEC_RS_COLUMNS + 1];
+	uint8_t omega[MPE_FEC_RS_COLUMNS];
+	uint8_t x, xinv, xpow, num, den, s;
+	int nonzero = 0;
+	int i, j, k;
+
+	for (j = 0; j < MPE_FEC_RS_COLUMNS; j++) {
+		for (i = 0, s = 0; i < CODEWORD; i++)
+			s = gf_mul(frame, s, frame->gf_exp[j]) ^ c[i];
+		syndrome[j] = s;
+		nonzero |= s;
+	}
+	if (!nonzero)
+		return;
+
+	// erasure locator polynomial, prod(1 + X_k x)
+	memset(gamma, 0, sizeof(gamma));
+	gamma[0] = 1;
+	for (k = 0; k < count; k++) {
+		x = frame->gf_exp[CODEWORD - 1 - erasures[k]];
+		for (j = k + 1; j > 0; j--)
+			gamma[j] ^= gf_mul(frame, x, gamma[j - 1]);
+	}
+
+	// evaluator, S(x) gamma(x) mod x^64
+	for (j = 0; j < MPE_FEC_RS_COLUMNS; j++) {
+		for (i = 0, s = 0; (i <= j) && (i <= count); i++)
+			s ^= gf_mul(frame, gamma[i], syndrome[j - i]);
+		omega[j] = s;
+	}
+
+	// Forney, e_k = X_k omega(1/X_k) / gamma'(1/X_k)
+	for (k = 0; k < count; k++) {
+		x = frame->gf_exp[CODEWORD - 1 - erasures[k]];
+		xinv = frame->gf_exp[CODEWORD - frame->gf_log[x]];
+
+		for (j = 0, num = 0, xpow = 1; j < MPE_FEC_RS_COLUMNS; j++) {
+			num ^= gf_mul(frame, omega[j], xpow);
+			xpow = gf_mul(frame, xpow, xinv);
+		}
+		for (j = 1, den = 0, xpow = 1; j <= count; j += 2) {
+			den ^= gf_mul(frame, gamma[j], xpow);
+			xpow = gf_mul(frame, xpow, gf_mul(frame, xinv, xinv));
+		}
+		if (den == 0)
+			continue;
+
+		c[erasures[k]] ^= gf_mul(frame, x, gf_div(frame, num, den));
+	}
+}
+
+static void correct_frame(struct mpe_fec_frame *frame)
+{
+	uint8_t c[CODEWORD];
+	int erasures[CODEWORD];
+	int rows = frame->rows;
+	int row, i, count, data_erasures;
+
+	for (row = 0; row < rows; row++) {
+		for (i = 0, count = 0, data_erasures = 0; i < CODEWORD; i++) {
+			if (frame->valid[i * rows + row]) {
+				c[i] = frame->data[i * rows + row];
+			} else {
+				c[i] = 0;
+				erasures[count++] = i;
+				if (i < MPE_FEC_ADT_COLUMNS)
+					data_erasures++;
+			}
+		}
+
+		// only the application data matters
+		if (data_erasures == 0)
+			continue;
+		if (count > MPE_FEC_RS_COLUMNS) {
+			frame->stats.rows_uncorrectable++;
+			continue;
+		}
+
+		correct_row(frame, c, erasures, count);
+		for (i = 0; i < MPE_FEC_ADT_COLUMNS; i++) {
+			frame->data[i * rows + row] = c[i];
+			frame->valid[i * rows + row] = 1;
+		}
+		frame->stats.rows_corrected++;
+	}
+}
+
+int mpe_fec_frame_flush(struct mpe_fec_frame *frame)
+{
+	int end = (MPE_FEC_ADT_COLUMNS - frame->padding_columns) * frame->rows;
+	int delivered = 0;
+	int pos, len;
+	uint8_t *p;
+
+	if (frame->empty)
+		return 0;
+
+	// padding after the last datagram and in the padding columns is zero
+	if ((frame->data_end >= 0) && (frame->data_end < end))
+		end = frame->data_end;
+	memset(frame->data + end, 0, MPE_FEC_ADT_COLUMNS * frame->rows - end);
+	memset(frame->valid + end, 1, MPE_FEC_ADT_COLUMNS * frame->rows - end);
+
+	correct_frame(frame);
+
+	for (pos = 0; pos + 20 <= end; pos += len) {
+		p = frame->data + pos;
+		if ((!frame->valid[pos]) || memchr(frame->valid + pos, 0, 6))
+			break;
+
+		if ((p[0] >> 4) == 4)
+			len = (p[2] << 8) | p[3];
+		else if ((p[0] >> 4) == 6)
+			len = 40 + ((p[4] << 8) | p[5]);
+		else
+			break;
+		if ((len < 20) || (pos + len > end))
+			break;
+
+		if (memchr(frame->valid + pos, 0, len)) {
+			frame->stats.datagrams_lost++;
+			continue;
+		}
+
+		if (frame->callback)
+			frame->callback(frame->private, p, len);
+		frame->stats.datagrams++;
+		delivered++;
+	}
+
+	frame->stats.frames++;
+	reset_frame(frame);
+	return delivered;
+}
+
+void mpe_fec_frame_get_stats(struct mpe_fec_frame *frame, struct mpe_fec_frame_stats *stats)
+{
+	*stats = frame->stats;
+}
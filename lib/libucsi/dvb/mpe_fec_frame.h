@@ -0,0 +1,130 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_DVB_MPE_FEC_FRAME_H
+#define _UCSI_DVB_MPE_FEC_FRAME_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libucsi/mpeg/datagram_section.h>
+#include <libucsi/dvb/mpe_fec_section.h>
+
+/**
+ * Number of columns of the application data table of an MPE-FEC frame.
+ */
+#define MPE_FEC_ADT_COLUMNS 191
+
+/**
+ * Number of columns of the RS data table of an MPE-FEC frame.
+ */
+#define MPE_FEC_RS_COLUMNS 64
+
+/**
+ * Opaque structure reassembling the MPE-FEC frames of one elementary stream.
+ */
+struct mpe_fec_frame;
+
+/**
+ * Statistics of an mpe_fec_frame.
+ */
+struct mpe_fec_frame_stats {
+	unsigned long frames;
+	unsigned long rows_corrected;
+	unsigned long rows_uncorrectable;
+	unsigned long datagrams;
+	unsigned long datagrams_lost;
+};
+
+/**
+ * Callback invoked for every IP datagram of a frame. The datagram points into
+ * the frame and is only valid until the callback returns.
+ *
+ * @param private Private pointer passed to mpe_fec_frame_create().
+ * @param datagram Pointer to the start of the datagram.
+ * @param len Length of the datagram in bytes.
+ */
+typedef void (*mpe_fec_frame_callback)(void *private, uint8_t *datagram, int len);
+
+/**
+ * Create a reassembler.
+ *
+ * @param rows Number of rows of the frames (256, 512, 768 or 1024, from the
+ * frame_size of the time_slice_fec_identifier_descriptor).
+ * @param callback Function called for every datagram.
+ * @param private Private pointer for callback.
+ * @return The mpe_fec_frame, or NULL on error.
+ */
+extern struct mpe_fec_frame *mpe_fec_frame_create(int rows, mpe_fec_frame_callback callback, void *private);
+
+/**
+ * Destroy a reassembler, discarding any partial frame.
+ *
+ * @param frame The mpe_fec_frame to destroy.
+ */
+extern void mpe_fec_frame_destroy(struct mpe_fec_frame *frame);
+
+/**
+ * Add a datagram section to the current frame. A datagram section of a new
+ * frame flushes the current one first.
+ *
+ * @param frame The mpe_fec_frame.
+ * @param d The datagram_section, not modified.
+ * @return 0 on success, -EINVAL if the section doesn't fit the frame or
+ * doesn't carry an IP datagram.
+ */
+extern int mpe_fec_frame_add_datagram(struct mpe_fec_frame *frame, struct datagram_section *d);
+
+/**
+ * Add an MPE-FEC section to the current frame. The section with the
+ * frame_boundary flag set flushes the frame.
+ *
+ * @param frame The mpe_fec_frame.
+ * @param s The mpe_fec_section, as returned by mpe_fec_section_codec().
+ * @return 0 on success, -EINVAL if the section doesn't fit the frame.
+ */
+extern int mpe_fec_frame_add_fec(struct mpe_fec_frame *frame, struct mpe_fec_section *s);
+
+/**
+ * Correct the erasures of the current frame and deliver its datagrams, for
+ * instance when its burst ended without a frame_boundary (see delta_t).
+ * The frame is then emptied.
+ *
+ * @param frame The mpe_fec_frame.
+ * @return Number of datagrams delivered.
+ */
+extern int mpe_fec_frame_flush(struct mpe_fec_frame *frame);
+
+/**
+ * Get the statistics of a reassembler.
+ *
+ * @param frame The mpe_fec_frame.
+ * @param stats Where to put them.
+ */
+extern void mpe_fec_frame_get_stats(struct mpe_fec_frame *frame, struct mpe_fec_frame_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libucsi/dvb/mpe_fec_section.h>
+
+struct mpe_fec_section *mpe_fec_section_codec(struct section *section)
+{
+	uint8_t *buf = (uint8_t *) section;
+	size_t len = section_length(section);
+
+	if (len < sizeof(struct mpe_fec_section) + CRC_SIZE)
+		return NULL;
+
+	bswap32(buf + 8);
+
+	return (struct mpe_fec_section *) section;
+}
@@ -30,14 +30,6 @@ extern "C"
 
 #include <libucsi/mpeg/section.h>
 
-/**
- * mpe_fec_section structure. TODO
- */
-struct mpe_fec_section {
-	struct section head;
-};
-
-
 /**
  * real_time_paramters
  * can also be found in datagram_section in MAC4-1-bytes */
@@ -48,6 +40,55 @@ struct real_time_parameters {
 	uint32_t address         : 18; )
 };
 
+/**
+ * mpe_fec_section structure.
+ */
+struct mpe_fec_section {
+	struct section head;
+
+	uint8_t padding_columns;
+	uint8_t reserved_for_future_use;
+  EBIT3(uint8_t reserved                  : 2; ,
+	uint8_t reserved_for_future_use_2 : 5; ,
+	uint8_t current_next_indicator    : 1; );
+	uint8_t section_number;
+	uint8_t last_section_number;
+	struct real_time_parameters real_time_parameters;
+	/* uint8_t rs_data[] */
+	/* CRC */
+} __ucsi_packed;
+
+/**
+ * Process an mpe_fec_section.
+ *
+ * @param section Pointer to a generic section header.
+ * @return Pointer to an mpe_fec_section, or NULL on error.
+ */
+extern struct mpe_fec_section *mpe_fec_section_codec(struct section *section);
+
+/**
+ * Accessor for the RS data of an mpe_fec_section, one column of the RS data
+ * table of the MPE-FEC frame.
+ *
+ * @param s mpe_fec_section pointer.
+ * @return Pointer to the RS data.
+ */
+static inline uint8_t *mpe_fec_section_rs_data(struct mpe_fec_section *s)
+{
+	return (uint8_t *) s + sizeof(struct mpe_fec_section);
+}
+
+/**
+ * Determine the number of bytes of RS data in an mpe_fec_section.
+ *
+ * @param s mpe_fec_section pointer.
+ * @return Length of the RS data in bytes.
+ */
+static inline size_t mpe_fec_section_rs_data_length(struct mpe_fec_section *s)
+{
+	return section_length(&s->head) - sizeof(struct mpe_fec_section) - CRC_SIZE;
+}
+
 
 static inline struct real_time_parameters * datagram_section_real_time_parameters_codec(struct datagram_section *d)
 {
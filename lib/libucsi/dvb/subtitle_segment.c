@@ -0,0 +1,242 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <string.h>
+#include <libucsi/endianops.h>
+#include <libucsi/dvb/subtitle_segment.h>
+
+int dvb_subtitle_pes_start(const uint8_t *buf, int len)
+{
+	if ((len < 2) ||
+	    (buf[0] != DVB_SUBTITLE_DATA_IDENTIFIER) || (buf[1] != DVB_SUBTITLE_STREAM_ID))
+		return -1;
+
+	return 2;
+}
+
+int dvb_subtitle_segment_decode(const uint8_t *buf, int len,
+				struct dvb_subtitle_segment *segment)
+{
+	if ((len < 1) || (buf[0] == DVB_SUBTITLE_END_OF_PES))
+		return 0;
+	if ((len < DVB_SUBTITLE_SEGMENT_HEADER) || (buf[0] != DVB_SUBTITLE_SYNC_BYTE))
+		return -1;
+
+	segment->segment_type = buf[1];
+	segment->page_id = ucsi_get16(buf + 2);
+	segment->segment_length = ucsi_get16(buf + 4);
+	segment->data = buf + DVB_SUBTITLE_SEGMENT_HEADER;
+	if ((DVB_SUBTITLE_SEGMENT_HEADER + segment->segment_length) > len)
+		return -1;
+
+	return DVB_SUBTITLE_SEGMENT_HEADER + segment->segment_length;
+}
+
+int dvb_subtitle_page_decode(const struct dvb_subtitle_segment *segment,
+			     struct dvb_subtitle_page *page)
+{
+	const uint8_t *buf = segment->data;
+
+	if ((segment->segment_length < 2) || ((segment->segment_length - 2) % 6))
+		return -1;
+
+	page->page_time_out = buf[0];
+	page->page_version_number = buf[1] >> 4;
+	page->page_state = (buf[1] >> 2) & 0x03;
+	page->region_count = (segment->segment_length - 2) / 6;
+	page->regions = buf + 2;
+
+	return 0;
+}
+
+void dvb_subtitle_page_region(const struct dvb_subtitle_page *page, int i,
+			      struct dvb_subtitle_page_region *region)
+{
+	const uint8_t *buf = page->regions + (i * 6);
+
+	region->region_id = buf[0];
+	region->region_horizontal_address = ucsi_get16(buf + 2);
+	region->region_vertical_address = ucsi_get16(buf + 4);
+}
+
+int dvb_subtitle_region_decode(const struct dvb_subtitle_segment *segment,
+			       struct dvb_subtitle_region *region)
+{
+	const uint8_t *buf = segment->data;
+
+	if (segment->segment_length < 10)
+		return -1;
+
+	region->region_id = buf[0];
+	region->region_version_number = buf[1] >> 4;
+	region->region_fill_flag = (buf[1] >> 3) & 0x01;
+	region->region_width = ucsi_get16(buf + 2);
+	region->region_height = ucsi_get16(buf + 4);
+	region->region_level_of_compatibility = buf[6] >> 5;
+	region->region_depth = (buf[6] >> 2) & 0x07;
+	region->clut_id = buf[7];
+	region->region_8_bit_pixel_code = buf[8];
+	region->region_4_bit_pixel_code = buf[9] >> 4;
+	region->region_2_bit_pixel_code = (buf[9] >> 2) & 0x03;
+	region->objects_length = segment->segment_length - 10;
+	region->objects = buf + 10;
+
+	return 0;
+}
+
+int dvb_subtitle_region_object_next(const struct dvb_subtitle_region *region, int pos,
+				    struct dvb_subtitle_region_object *object)
+{
+	const uint8_t *buf = region->objects + pos;
+	int size = 6;
+
+	if ((pos + size) > region->objects_length)
+		return -1;
+
+	object->object_id = ucsi_get16(buf);
+	object->object_type = buf[2] >> 6;
+	object->object_provider_flag = (buf[2] >> 4) & 0x03;
+	object->object_horizontal_position = ucsi_get16(buf + 2) & 0x0fff;
+	object->object_vertical_position = ucsi_get16(buf + 4) & 0x0fff;
+	object->foreground_pixel_code = 0;
+	object->background_pixel_code = 0;
+
+	// the character objects have their colours too
+	if ((object->object_type == 0x01) || (object->object_type == 0x02)) {
+		size = 8;
+		if ((pos + size) > region->objects_length)
+			return -1;
+		object->foreground_pixel_code = buf[6];
+		object->background_pixel_code = buf[7];
+	}
+
+	return pos + size;
+}
+
+int dvb_subtitle_clut_decode(const struct dvb_subtitle_segment *segment,
+			     struct dvb_subtitle_clut *clut)
+{
+	const uint8_t *buf = segment->data;
+
+	if (segment->segment_length < 2)
+		return -1;
+
+	clut->clut_id = buf[0];
+	clut->clut_version_number = buf[1] >> 4;
+	clut->entries_length = segment->segment_length - 2;
+	clut->entries = buf + 2;
+
+	return 0;
+}
+
+int dvb_subtitle_clut_entry_next(const struct dvb_subtitle_clut *clut, int pos,
+				 struct dvb_subtitle_clut_entry *entry)
+{
+	const uint8_t *buf = clut->entries + pos;
+
+	if ((pos + 4) > clut->entries_length)
+		return -1;
+
+	entry->clut_entry_id = buf[0];
+	entry->entry_flags = buf[1] >> 5;
+	entry->full_range_flag = buf[1] & 0x01;
+	if (entry->full_range_flag) {
+		if ((pos + 6) > clut->entries_length)
+			return -1;
+		entry->y = buf[2];
+		entry->cr = buf[3];
+		entry->cb = buf[4];
+		entry->t = buf[5];
+		return pos + 6;
+	}
+
+	// 6 bit Y, 4 bit Cr and Cb, 2 bit T
+	entry->y = buf[2] & 0xfc;
+	entry->cr = ((buf[2] & 0x03) << 6) | ((buf[3] & 0xc0) >> 2);
+	entry->cb = (buf[3] & 0x3c) << 2;
+	entry->t = (buf[3] & 0x03) << 6;
+	return pos + 4;
+}
+
+int dvb_subtitle_object_decode(const struct dvb_subtitle_segment *segment,
+			       struct dvb_subtitle_object *object)
+{
+	const uint8_t *buf = segment->data;
+	int len = segment->segment_length;
+
+	if (len < 3)
+		return -1;
+
+	memset(object, 0, sizeof(struct dvb_subtitle_object));
+	object->object_id = ucsi_get16(buf);
+	object->object_version_number = buf[2] >> 4;
+	object->object_coding_method = (buf[2] >> 2) & 0x03;
+	object->non_modifying_colour_flag = (buf[2] >> 1) & 0x01;
+
+	switch(object->object_coding_method) {
+	case dvb_subtitle_object_coding_pixels:
+		if (len < 7)
+			return -1;
+		object->top_field_data_block_length = ucsi_get16(buf + 3);
+		object->bottom_field_data_block_length = ucsi_get16(buf + 5);
+		if ((7 + object->top_field_data_block_length +
+		     object->bottom_field_data_block_length) > len)
+			return -1;
+		object->top_field = buf + 7;
+		object->bottom_field = object->top_field + object->top_field_data_block_length;
+		break;
+
+	case dvb_subtitle_object_coding_characters:
+		if (len < 4)
+			return -1;
+		object->number_of_codes = buf[3];
+		if ((4 + (object->number_of_codes * 2)) > len)
+			return -1;
+		object->character_codes = buf + 4;
+		break;
+	}
+
+	return 0;
+}
+
+int dvb_subtitle_display_decode(const struct dvb_subtitle_segment *segment,
+				struct dvb_subtitle_display *display)
+{
+	const uint8_t *buf = segment->data;
+
+	if (segment->segment_length < 5)
+		return -1;
+
+	memset(display, 0, sizeof(struct dvb_subtitle_display));
+	display->dds_version_number = buf[0] >> 4;
+	display->display_window_flag = (buf[0] >> 3) & 0x01;
+	display->display_width = ucsi_get16(buf + 1);
+	display->display_height = ucsi_get16(buf + 3);
+	if (display->display_window_flag) {
+		if (segment->segment_length < 13)
+			return -1;
+		display->display_window_horizontal_position_minimum = ucsi_get16(buf + 5);
+		display->display_window_horizontal_position_maximum = ucsi_get16(buf + 7);
+		display->display_window_vertical_position_minimum = ucsi_get16(buf + 9);
+		display->display_window_vertical_position_maximum = ucsi_get16(buf + 11);
+	}
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_DVB_SUBTITLE_SEGMENT_H
+#define _UCSI_DVB_SUBTITLE_SEGMENT_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * The segments of DVB subtitling (ETSI EN 300 743), as carried in the
+ * PES_data_field of private_stream_1 PES packets:
+ *
+ *	data_identifier (0x20), subtitle_stream_id (0x00),
+ *	segments..., end_of_PES_data_field_marker (0xff)
+ *
+ * Unlike the section codecs, these decode into structures of their own and
+ * never write to the buffer, since a PES payload is often still in the
+ * transport packets it came in, shared with everyone else on the PID.
+ * Loops (the regions of a page, the objects of a region, the entries of a
+ * CLUT) are left in wire format, and read one entry at a time.
+ */
+
+#define DVB_SUBTITLE_DATA_IDENTIFIER	0x20
+#define DVB_SUBTITLE_STREAM_ID		0x00
+#define DVB_SUBTITLE_SYNC_BYTE		0x0f
+#define DVB_SUBTITLE_END_OF_PES		0xff
+
+/**
+ * Bytes of a segment before its data.
+ */
+#define DVB_SUBTITLE_SEGMENT_HEADER	6
+
+/**
+ * Possible values for segment_type.
+ */
+enum dvb_subtitle_segment_type {
+	dvb_subtitle_segment_page_composition		= 0x10,
+	dvb_subtitle_segment_region_composition		= 0x11,
+	dvb_subtitle_segment_clut_definition		= 0x12,
+	dvb_subtitle_segment_object_data		= 0x13,
+	dvb_subtitle_segment_display_definition		= 0x14,
+	dvb_subtitle_segment_disparity_signalling	= 0x15,
+	dvb_subtitle_segment_alternative_clut		= 0x16,
+	dvb_subtitle_segment_end_of_display_set		= 0x80,
+	dvb_subtitle_segment_stuffing			= 0xff,
+};
+
+/**
+ * Possible values for page_state.
+ */
+enum dvb_subtitle_page_state {
+	dvb_subtitle_page_state_normal_case		= 0x00,
+	dvb_subtitle_page_state_acquisition_point	= 0x01,
+	dvb_subtitle_page_state_mode_change		= 0x02,
+};
+
+/**
+ * Possible values for object_coding_method.
+ */
+enum dvb_subtitle_object_coding {
+	dvb_subtitle_object_coding_pixels		= 0x00,
+	dvb_subtitle_object_coding_characters		= 0x01,
+	dvb_subtitle_object_coding_progressive		= 0x02,
+};
+
+/**
+ * A segment header, and where its data is.
+ */
+struct dvb_subtitle_segment {
+	uint8_t segment_type;
+	uint16_t page_id;
+	uint16_t segment_length;
+	const uint8_t *data;		/* segment_length bytes */
+};
+
+/**
+ * page_composition_segment.
+ */
+struct dvb_subtitle_page {
+	uint8_t page_time_out;		/* seconds */
+	uint8_t page_version_number;
+	uint8_t page_state;
+	int region_count;
+	const uint8_t *regions;		/* use dvb_subtitle_page_region() */
+};
+
+/**
+ * A region of a page_composition_segment.
+ */
+struct dvb_subtitle_page_region {
+	uint8_t region_id;
+	uint16_t region_horizontal_address;
+	uint16_t region_vertical_address;
+};
+
+/**
+ * region_composition_segment.
+ */
+struct dvb_subtitle_region {
+	uint8_t region_id;
+	uint8_t region_version_number;
+	uint8_t region_fill_flag;
+	uint16_t region_width;
+	uint16_t region_height;
+	uint8_t region_level_of_compatibility;
+	uint8_t region_depth;
+	uint8_t clut_id;
+	uint8_t region_8_bit_pixel_code;
+	uint8_t region_4_bit_pixel_code;
+	uint8_t region_2_bit_pixel_code;
+	int objects_length;
+	const uint8_t *objects;		/* use dvb_subtitle_region_object_next() */
+};
+
+/**
+ * An object of a region_composition_segment.
+ */
+struct dvb_subtitle_region_object {
+	uint16_t object_id;
+	uint8_t object_type;
+	uint8_t object_provider_flag;
+	uint16_t object_horizontal_position;
+	uint16_t object_vertical_position;
+	uint8_t foreground_pixel_code;	/* character objects (types 1 and 2) only */
+	uint8_t background_pixel_code;
+};
+
+/**
+ * CLUT_definition_segment.
+ */
+struct dvb_subtitle_clut {
+	uint8_t clut_id;
+	uint8_t clut_version_number;
+	int entries_length;
+	const uint8_t *entries;		/* use dvb_subtitle_clut_entry_next() */
+};
+
+/**
+ * An entry of a CLUT_definition_segment. A reduced range entry is scaled
+ * up to 8 bits.
+ */
+struct dvb_subtitle_clut_entry {
+	uint8_t clut_entry_id;
+	uint8_t entry_flags;		/* 0x04 2 bit, 0x02 4 bit, 0x01 8 bit CLUT */
+	uint8_t full_range_flag;
+	uint8_t y;
+	uint8_t cr;
+	uint8_t cb;
+	uint8_t t;
+};
+
+/**
+ * object_data_segment.
+ */
+struct dvb_subtitle_object {
+	uint16_t object_id;
+	uint8_t object_version_number;
+	uint8_t object_coding_method;
+	uint8_t non_modifying_colour_flag;
+
+	/* dvb_subtitle_object_coding_pixels */
+	uint16_t top_field_data_block_length;
+	uint16_t bottom_field_data_block_length;
+	const uint8_t *top_field;
+	const uint8_t *bottom_field;	/* 0 length => the top field is repeated */
+
+	/* dvb_subtitle_object_coding_characters */
+	uint8_t number_of_codes;
+	const uint8_t *character_codes;	/* 16 bits each */
+};
+
+/**
+ * display_definition_segment.
+ */
+struct dvb_subtitle_display {
+	uint8_t dds_version_number;
+	uint8_t display_window_flag;
+	uint16_t display_width;		/* less one, as transmitted */
+	uint16_t display_height;
+	uint16_t display_window_horizontal_position_minimum;
+	uint16_t display_window_horizontal_position_maximum;
+	uint16_t display_window_vertical_position_minimum;
+	uint16_t display_window_vertical_position_maximum;
+};
+
+/**
+ * Check the start of a PES_data_field.
+ *
+ * @param buf The PES packet's payload.
+ * @param len Its length.
+ * @return Offset of the first segment, or -1 if it is not DVB subtitling.
+ */
+extern int dvb_subtitle_pes_start(const uint8_t *buf, int len);
+
+/**
+ * Process a segment header, which must be followed by all its data.
+ *
+ * @param buf Start of the segment.
+ * @param len Bytes available from there.
+ * @param segment Where to put it.
+ * @return Bytes taken by the whole segment, 0 at the
+ * end_of_PES_data_field_marker (or the end of buf), or -1 if the segment is
+ * malformed or truncated.
+ */
+extern int dvb_subtitle_segment_decode(const uint8_t *buf, int len,
+				       struct dvb_subtitle_segment *segment);
+
+/**
+ * Process a page_composition_segment.
+ *
+ * @param segment The segment.
+ * @param page Where to put it.
+ * @return 0 on success, or -1 if it is malformed.
+ */
+extern int dvb_subtitle_page_decode(const struct dvb_subtitle_segment *segment,
+				    struct dvb_subtitle_page *page);
+
+/**
+ * Retrieve a region of a page_composition_segment.
+ *
+ * @param page The page.
+ * @param i Index of the region, 0 to region_count - 1.
+ * @param region Where to put it.
+ */
+extern void dvb_subtitle_page_region(const struct dvb_subtitle_page *page, int i,
+				     struct dvb_subtitle_page_region *region);
+
+/**
+ * Process a region_composition_segment.
+ *
+ * @param segment The segment.
+ * @param region Where to put it.
+ * @return 0 on success, or -1 if it is malformed.
+ */
+extern int dvb_subtitle_region_decode(const struct dvb_subtitle_segment *segment,
+				      struct dvb_subtitle_region *region);
+
+/**
+ * Retrieve the next object of a region_composition_segment.
+ *
+ * @param region The region.
+ * @param pos Offset of the object in the loop, 0 for the first.
+ * @param object Where to put it.
+ * @return Offset of the object after it, or -1 if there are no more (or the
+ * rest of the loop is truncated).
+ */
+extern int dvb_subtitle_region_object_next(const struct dvb_subtitle_region *region, int pos,
+					   struct dvb_subtitle_region_object *object);
+
+/**
+ * Process a CLUT_definition_segment.
+ *
+ * @param segment The segment.
+ * @param clut Where to put it.
+ * @return 0 on success, or -1 if it is malformed.
+ */
+extern int dvb_subtitle_clut_decode(const struct dvb_subtitle_segment *segment,
+				    struct dvb_subtitle_clut *clut);
+
+/**
+ * Retrieve the next entry of a CLUT_definition_segment.
+ *
+ * @param clut The CLUT.
+ * @param pos Offset of the entry in the loop, 0 for the first.
+ * @param entry Where to put it.
+ * @return Offset of the entry after it, or -1 if there are no more (or the
+ * rest of the loop is truncated).
+ */
+extern int dvb_subtitle_clut_entry_next(const struct dvb_subtitle_clut *clut, int pos,
+					struct dvb_subtitle_clut_entry *entry);
+
+/**
+ * Process an object_data_segment.
+ *
+ * @param segment The segment.
+ * @param object Where to put it.
+ * @return 0 on success, or -1 if it is malformed.
+ */
+extern int dvb_subtitle_object_decode(const struct dvb_subtitle_segment *segment,
+				      struct dvb_subtitle_object *object);
+
+/**
+ * Process a display_definition_segment.
+ *
+ * @param segment The segment.
+ * @param display Where to put it.
+ * @return 0 on success, or -1 if it is malformed.
+ */
+extern int dvb_subtitle_display_decode(const struct dvb_subtitle_segment *segment,
+				       struct dvb_subtitle_display *display);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,327 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <iconv.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "types.h"
+#include "text.h"
+
+#define DVB_TEXT_MAX_CHARSETS 24
+
+#define DVB_TEXT_COMBINING 0xff		/* ISO 6937 diacritic: combines with the next byte */
+
+#define DVB_TEXT_ONES 0x0101010101010101ULL
+#define DVB_TEXT_HIGHS (DVB_TEXT_ONES * 0x80)
+
+struct dvb_text_char {
+	uint8_t len;
+	uint8_t utf8[3];
+};
+
+struct dvb_text_charset {
+	const char *name;
+	iconv_t cd;
+	struct dvb_text_char *map;	/* single byte character sets only */
+};
+
+struct dvb_text_decoder {
+	char *default_charset;
+
+	int charset_count;
+	struct dvb_text_charset charsets[DVB_TEXT_MAX_CHARSETS];
+};
+
+struct dvb_text_decoder *dvb_text_decoder_create(const char *default_charset)
+{
+	struct dvb_text_decoder *decoder;
+
+	decoder = calloc(1, sizeof(struct dvb_text_decoder));
+	if (decoder == NULL)
+		return NULL;
+
+	if (default_charset) {
+		decoder->default_charset = strdup(default_charset);
+		if (decoder->default_charset == NULL) {
+			free(decoder);
+			return NULL;
+		}
+	}
+
+	return decoder;
+}
+
+void dvb_text_decoder_destroy(struct dvb_text_decoder *decoder)
+{
+	int i;
+
+	for(i = 0; i < decoder->charset_count; i++) {
+		if (decoder->charsets[i].cd != (iconv_t) -1)
+			iconv_close(decoder->charsets[i].cd);
+		free(decoder->charsets[i].map);
+	}
+	free(decoder->default_charset);
+	free(decoder);
+}
+
+static int dvb_text_iso6937(const char *name)
+{
+	return (!strcasecmp(name, "ISO6937")) || (!strcasecmp(name, "ISO-6937"));
+}
+
+static int dvb_text_single_byte(const char *name)
+{
+	if ((!strncasecmp(name, "ISO8859", 7)) || (!strncasecmp(name, "ISO-8859", 8)))
+		return 1;
+	return dvb_text_iso6937(name);
+}
+
+static struct dvb_text_char *dvb_text_build_map(iconv_t cd, const char *name)
+{
+	struct dvb_text_char *map;
+	int i;
+
+	map = calloc(256, sizeof(struct dvb_text_char));
+	if (map == NULL)
+		return NULL;
+
+	for(i = 0x20; i < 0x80; i++) {
+		map[i].len = 1;
+		map[i].utf8[0] = i;
+	}
+
+	// control codes are dropped, apart from CR/LF
+	map[0x8a].len = 1;
+	map[0x8a].utf8[0] = '\n';
+
+	for(i = 0xa0; i < 0x100; i++) {
+		char in = i;
+		char *inbuf = &in;
+		size_t inleft = 1;
+		char *outbuf = (char *) map[i].utf8;
+		size_t outleft = sizeof(map[i].utf8);
+
+		iconv(cd, NULL, NULL, NULL, NULL);
+		if (iconv(cd, &inbuf, &inleft, &outbuf, &outleft) == (size_t) -1) {
+			if (errno == EINVAL)
+				map[i].len = DVB_TEXT_COMBINING;
+			continue;
+		}
+		map[i].len = sizeof(map[i].utf8) - outleft;
+	}
+
+	// EN 300 468 puts the euro sign here in table 00
+	if (dvb_text_iso6937(name)) {
+		map[0xa4].len = 3;
+		map[0xa4].utf8[0] = 0xe2;
+		map[0xa4].utf8[1] = 0x82;
+		map[0xa4].utf8[2] = 0xac;
+	}
+
+	return map;
+}
+
+static struct dvb_text_charset *dvb_text_charset(struct dvb_text_decoder *decoder,
+						 const char *name)
+{
+	struct dvb_text_charset *cs;
+	int i;
+
+	for(i = 0; i < decoder->charset_count; i++) {
+		cs = &decoder->charsets[i];
+		if ((cs->name == name) || (!strcmp(cs->name, name)))
+			return cs;
+	}
+
+	if (decoder->charset_count == DVB_TEXT_MAX_CHARSETS)
+		return NULL;
+
+	// names come from dvb_charset() or are the default, so they stay valid
+	cs = &decoder->charsets[decoder->charset_count++];
+	cs->name = name;
+	cs->cd = iconv_open("UTF-8", name);
+	cs->map = NULL;
+	if ((cs->cd != (iconv_t) -1) && dvb_text_single_byte(name))
+		cs->map = dvb_text_build_map(cs->cd, name);
+
+	return cs;
+}
+
+static int dvb_text_decode_map(struct dvb_text_charset *cs,
+			       const uint8_t *in, const uint8_t *end,
+			       char *out, char *out_end)
+{
+	char *start = out;
+
+	while(in < end) {
+		struct dvb_text_char *c;
+
+		// copy runs of printable ASCII a word at a time
+		while(((end - in) >= 8) && ((out_end - out) >= 8)) {
+			uint64_t word;
+
+			memcpy(&word, in, 8);
+			if (word & DVB_TEXT_HIGHS)
+				break;
+			// with the high bits set, a byte < 0x20 borrows its own high bit
+			if ((((word | DVB_TEXT_HIGHS) - (DVB_TEXT_ONES * 0x20)) & DVB_TEXT_HIGHS) !=
+			    DVB_TEXT_HIGHS)
+				break;
+
+			memcpy(out, in, 8);
+			in += 8;
+			out += 8;
+		}
+		if (in == end)
+			break;
+
+		c = &cs->map[*in];
+		if (c->len == DVB_TEXT_COMBINING) {
+			char *inbuf = (char *) in;
+			size_t inleft = 2;
+			size_t outleft = out_end - out;
+
+			if ((end - in) < 2) {
+				in++;
+				continue;
+			}
+
+			iconv(cs->cd, NULL, NULL, NULL, NULL);
+			if (iconv(cs->cd, &inbuf, &inleft, &out, &outleft) == (size_t) -1) {
+				if (errno == E2BIG) {
+					*out = 0;
+					return -ENOSPC;
+				}
+				// no such combination: drop the diacritic
+				in++;
+				continue;
+			}
+			in += 2;
+			continue;
+		}
+
+		if ((out_end - out) < c->len) {
+			*out = 0;
+			return -ENOSPC;
+		}
+		memcpy(out, c->utf8, c->len);
+		out += c->len;
+		in++;
+	}
+
+	*out = 0;
+	return out - start;
+}
+
+static int dvb_text_decode_iconv(struct dvb_text_charset *cs,
+				 const uint8_t *in, const uint8_t *end,
+				 char *out, char *out_end)
+{
+	char *start = out;
+	char *inbuf = (char *) in;
+	size_t inleft = end - in;
+	size_t outleft = out_end - out;
+
+	iconv(cs->cd, NULL, NULL, NULL, NULL);
+	while(inleft && (iconv(cs->cd, &inbuf, &inleft, &out, &outleft) == (size_t) -1)) {
+		if (errno == E2BIG) {
+			*out = 0;
+			return -ENOSPC;
+		}
+		if (errno != EILSEQ)
+			break;
+
+		// skip what cannot be converted
+		inbuf++;
+		inleft--;
+	}
+
+	*out = 0;
+	return out - start;
+}
+
+int dvb_text_decode(struct dvb_text_decoder *decoder,
+		    const uint8_t *dvb_text, int dvb_text_length,
+		    char *dest, size_t dest_length)
+{
+	struct dvb_text_charset *cs;
+	const char *charset;
+	int consumed;
+	size_t len;
+
+	if (dest_length == 0)
+		return -ENOSPC;
+
+	charset = dvb_charset((char *) dvb_text, dvb_text_length, &consumed);
+	if ((consumed == 0) && decoder->default_charset &&
+	    ((dvb_text_length == 0) || (dvb_text[0] >= 0x20)))
+		charset = decoder->default_charset;
+	dvb_text += consumed;
+	dvb_text_length -= consumed;
+
+	cs = dvb_text_charset(decoder, charset);
+	if (cs && cs->map)
+		return dvb_text_decode_map(cs, dvb_text, dvb_text + dvb_text_length,
+					   dest, dest + dest_length - 1);
+	if (cs && (cs->cd != (iconv_t) -1))
+		return dvb_text_decode_iconv(cs, dvb_text, dvb_text + dvb_text_length,
+					     dest, dest + dest_length - 1);
+
+	// no converter: keep the bytes as they are
+	len = dvb_text_length;
+	if (len >= dest_length) {
+		memcpy(dest, dvb_text, dest_length - 1);
+		dest[dest_length - 1] = 0;
+		return -ENOSPC;
+	}
+	memcpy(dest, dvb_text, len);
+	dest[len] = 0;
+	return len;
+}
+
+int dvb_text_decode_batch(struct dvb_text_decoder *decoder,
+			  struct dvb_text_string *strings, int count,
+			  char *arena, size_t arena_length)
+{
+	size_t pos = 0;
+	int done;
+	int i;
+	int ret;
+
+	for(done = 0; done < count; done++) {
+		ret = dvb_text_decode(decoder, strings[done].text, strings[done].text_length,
+				      arena + pos, arena_length - pos);
+		if (ret < 0)
+			break;
+
+		strings[done].utf8 = arena + pos;
+		strings[done].utf8_length = ret;
+		pos += ret + 1;
+	}
+
+	for(i = done; i < count; i++) {
+		strings[i].utf8 = NULL;
+		strings[i].utf8_length = 0;
+	}
+
+	return done;
+}
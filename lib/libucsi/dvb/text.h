@@ -0,0 +1,106 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_DVB_TEXT_H
+#define _UCSI_DVB_TEXT_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Converts DVB text (EN 300 468 annex A) to UTF-8.
+ *
+ * A decoder keeps its conversion state across strings: an iconv handle is
+ * opened once for each character set met, and the single byte character
+ * sets (ISO 6937 and ISO 8859-x) are converted through a table built the
+ * first time they are used. Runs of ASCII are copied a word at a time.
+ *
+ * The single byte control codes are dropped, except for CR/LF (0x8a) which
+ * becomes a newline. A decoder must not be used by several threads at once.
+ */
+struct dvb_text_decoder;
+
+/**
+ * A string for dvb_text_decode_batch().
+ */
+struct dvb_text_string {
+	const uint8_t *text;		/* in: the DVB text */
+	int text_length;		/* in: its length */
+	char *utf8;			/* out: the NUL terminated UTF-8, or NULL */
+	int utf8_length;		/* out: its length, without the NUL */
+};
+
+/**
+ * Create a decoder.
+ *
+ * @param default_charset iconv name of the character set of strings without
+ * a character set selection byte, or NULL for the standard one (ISO 6937).
+ * @return The decoder, or NULL on failure.
+ */
+extern struct dvb_text_decoder *dvb_text_decoder_create(const char *default_charset);
+
+/**
+ * Destroy a decoder.
+ *
+ * @param decoder The decoder.
+ */
+extern void dvb_text_decoder_destroy(struct dvb_text_decoder *decoder);
+
+/**
+ * Convert one string. The output never needs more than three bytes for each
+ * byte of input, plus one for the NUL.
+ *
+ * @param decoder The decoder.
+ * @param dvb_text The DVB text, starting with its character set selection.
+ * @param dvb_text_length Length of the text.
+ * @param dest Buffer for the NUL terminated UTF-8.
+ * @param dest_length Size of dest in bytes.
+ * @return Length of the UTF-8 without the NUL, or -ENOSPC if dest is too
+ * small (dest then holds as much as fitted).
+ */
+extern int dvb_text_decode(struct dvb_text_decoder *decoder,
+			   const uint8_t *dvb_text, int dvb_text_length,
+			   char *dest, size_t dest_length);
+
+/**
+ * Convert a batch of strings, one after the other, into a single buffer.
+ *
+ * @param decoder The decoder.
+ * @param strings The strings. utf8 and utf8_length are filled in for each
+ * one converted, and utf8 is set to NULL for the others.
+ * @param count Number of strings.
+ * @param arena Buffer for the output.
+ * @param arena_length Size of arena in bytes.
+ * @return Number of strings converted: less than count if arena filled up.
+ */
+extern int dvb_text_decode_batch(struct dvb_text_decoder *decoder,
+				 struct dvb_text_string *strings, int count,
+				 char *arena, size_t arena_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -23,68 +23,17 @@
 
 time_t dvbdate_to_unixtime(dvbdate_t dvbdate)
 {
-	int k = 0;
-	struct tm tm;
-	double mjd;
-
-	/* check for the undefined value */
-	if ((dvbdate[0] == 0xff) &&
-	    (dvbdate[1] == 0xff) &&
-	    (dvbdate[2] == 0xff) &&
-	    (dvbdate[3] == 0xff) &&
-	    (dvbdate[4] == 0xff)) {
-		return -1;
-	}
-
-	memset(&tm, 0, sizeof(tm));
-	mjd = (dvbdate[0] << 8) | dvbdate[1];
-
-	tm.tm_year = (int) ((mjd - 15078.2) / 365.25);
-	tm.tm_mon = (int) (((mjd - 14956.1) - (int) (tm.tm_year * 365.25)) / 30.6001);
-	tm.tm_mday = (int) mjd - 14956 - (int) (tm.tm_year * 365.25) - (int) (tm.tm_mon * 30.6001);
-	if ((tm.tm_mon == 14) || (tm.tm_mon == 15)) k = 1;
-	tm.tm_year += k;
-	tm.tm_mon = tm.tm_mon - 2 - k * 12;
-	tm.tm_sec = bcd_to_integer(dvbdate[4]);
-	tm.tm_min = bcd_to_integer(dvbdate[3]);
-	tm.tm_hour = bcd_to_integer(dvbdate[2]);
-
-	return mktime(&tm);
+	return dvbdate_to_unixtime_fast(dvbdate);
 }
 
 void unixtime_to_dvbdate(time_t unixtime, dvbdate_t dvbdate)
 {
-	struct tm tm;
-	double l = 0;
-	int mjd;
-
-	/* the undefined value */
-	if (unixtime == -1) {
-		memset(dvbdate, 0xff, 5);
-		return;
-	}
-
-	gmtime_r(&unixtime, &tm);
-	tm.tm_mon++;
-	if ((tm.tm_mon == 1) || (tm.tm_mon == 2)) l = 1;
-	mjd = 14956 + tm.tm_mday + (int) ((tm.tm_year - l) * 365.25) + (int) ((tm.tm_mon + 1 + l * 12) * 30.6001);
-
-	dvbdate[0] = (mjd & 0xff00) >> 8;
-	dvbdate[1] = mjd & 0xff;
-	dvbdate[2] = integer_to_bcd(tm.tm_hour);
-	dvbdate[3] = integer_to_bcd(tm.tm_min);
-	dvbdate[4] = integer_to_bcd(tm.tm_sec);
+	unixtime_to_dvbdate_fast(unixtime, dvbdate);
 }
 
 int dvbduration_to_seconds(dvbduration_t dvbduration)
 {
-	int seconds = 0;
-
-	seconds += (bcd_to_integer(dvbduration[0]) * 60 * 60);
-	seconds += (bcd_to_integer(dvbduration[1]) * 60);
-	seconds += bcd_to_integer(dvbduration[2]);
-
-	return seconds;
+	return dvbduration_to_seconds_fast(dvbduration);
 }
 
 void seconds_to_dvbduration(int seconds, dvbduration_t dvbduration)
@@ -43,9 +43,102 @@ enum {
 	DVB_RUNNING_STATUS_RUNNING			= 0x04,
 };
 
+/**
+ * Modified Julian Date of the unix epoch, 1970-01-01.
+ */
+#define DVB_MJD_UNIX_EPOCH 40587
+
+/**
+ * Decode one byte of two BCD digits.
+ *
+ * @param bcd The byte.
+ * @return Its value.
+ */
+static inline int dvb_bcd8_to_integer(uint8_t bcd)
+{
+	return ((bcd >> 4) * 10) + (bcd & 0x0f);
+}
+
+/**
+ * Encode a value 0-99 as one byte of two BCD digits.
+ *
+ * @param val The value.
+ * @return The byte.
+ */
+static inline uint8_t dvb_integer_to_bcd8(int val)
+{
+	return ((val / 10) << 4) | (val % 10);
+}
+
+/**
+ * Convert from a 5 byte DVB UTC date to unix time, in integer arithmetic
+ * only: no locale or timezone state is touched, so it is cheap enough for
+ * every event of every EIT section, from any number of threads.
+ *
+ * @param dvbdate Pointer to DVB date, in network byte order.
+ * @return The unix timestamp, or -1 if the dvbdate was set to the 'undefined' value
+ */
+static inline time_t dvbdate_to_unixtime_fast(const uint8_t *dvbdate)
+{
+	if ((dvbdate[0] & dvbdate[1] & dvbdate[2] & dvbdate[3] & dvbdate[4]) == 0xff)
+		return -1;
+
+	return ((time_t) (((dvbdate[0] << 8) | dvbdate[1]) - DVB_MJD_UNIX_EPOCH) * 86400) +
+		(dvb_bcd8_to_integer(dvbdate[2]) * 3600) +
+		(dvb_bcd8_to_integer(dvbdate[3]) * 60) +
+		dvb_bcd8_to_integer(dvbdate[4]);
+}
+
+/**
+ * Convert from a unix timestamp to a 5 byte DVB UTC date, the inverse of
+ * dvbdate_to_unixtime_fast().
+ *
+ * @param unixtime The unix timestamp, or -1 for the 'undefined' value.
+ * @param dvbdate Pointer to 5 byte DVB date, written in network byte order.
+ */
+static inline void unixtime_to_dvbdate_fast(time_t unixtime, uint8_t *dvbdate)
+{
+	time_t days;
+	int seconds;
+	int mjd;
+
+	if (unixtime == -1) {
+		dvbdate[0] = dvbdate[1] = dvbdate[2] = dvbdate[3] = dvbdate[4] = 0xff;
+		return;
+	}
+
+	days = unixtime / 86400;
+	seconds = unixtime % 86400;
+	if (seconds < 0) {
+		seconds += 86400;
+		days--;
+	}
+	mjd = days + DVB_MJD_UNIX_EPOCH;
+
+	dvbdate[0] = mjd >> 8;
+	dvbdate[1] = mjd;
+	dvbdate[2] = dvb_integer_to_bcd8(seconds / 3600);
+	dvbdate[3] = dvb_integer_to_bcd8((seconds / 60) % 60);
+	dvbdate[4] = dvb_integer_to_bcd8(seconds % 60);
+}
+
+/**
+ * Convert from a DVB BCD duration to a number of seconds, inline.
+ *
+ * @param dvbduration Pointer to 3 byte DVB duration.
+ * @return Number of seconds.
+ */
+static inline int dvbduration_to_seconds_fast(const uint8_t *dvbduration)
+{
+	return (dvb_bcd8_to_integer(dvbduration[0]) * 3600) +
+		(dvb_bcd8_to_integer(dvbduration[1]) * 60) +
+		dvb_bcd8_to_integer(dvbduration[2]);
+}
+
 /**
  * Convert from a 5 byte DVB UTC date to unix time.
  * Note: this functions expects the DVB date in network byte order.
+ * It is dvbdate_to_unixtime_fast(), out of line.
  *
  * @param d Pointer to DVB date.
  * @return The unix timestamp, or -1 if the dvbdate was set to the 'undefined' value
@@ -57,6 +150,8 @@ extern time_t dvbdate_to_unixtime(dvbdate_t dvbdate);
  * Note: this function will always output the DVB date in
  * network byte order.
  *
+ * It is unixtime_to_dvbdate_fast(), out of line.
+ *
  * @param unixtime The unix timestamp, or -1 for the 'undefined' value.
  * @param utc Pointer to 5 byte DVB date.
  */
@@ -121,6 +121,23 @@ static inline void bswap48(uint8_t * buf) {
 
 #endif // __BYTE_ORDER
 
+/*
+ * Non-mutating big-endian readers, for use on buffers which have not been
+ * (and must not be) byte swapped in place.
+ */
+static inline uint16_t ucsi_get16(const uint8_t *buf) {
+	return (buf[0] << 8) | buf[1];
+}
+
+static inline uint32_t ucsi_get24(const uint8_t *buf) {
+	return ((uint32_t) buf[0] << 16) | (buf[1] << 8) | buf[2];
+}
+
+static inline uint32_t ucsi_get32(const uint8_t *buf) {
+	return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+	       (buf[2] << 8) | buf[3];
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -44,3 +44,14 @@ struct mpeg_pat_section *mpeg_pat_section_codec(struct section_ext * ext)
 
 	return (struct mpeg_pat_section *)ext;
 }
+
+int mpeg_pat_section_view_validate(const struct section_view *view)
+{
+	if (!section_view_is_ext(view))
+		return -1;
+
+	if (section_view_ext_data_length(view) % sizeof(struct mpeg_pat_program))
+		return -1;
+
+	return 0;
+}
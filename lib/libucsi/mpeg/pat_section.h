@@ -28,6 +28,7 @@ extern "C"
 #endif
 
 #include <libucsi/section.h>
+#include <libucsi/section_view.h>
 
 /**
  * mpeg_pat_section structure.
@@ -77,6 +78,59 @@ static inline uint16_t mpeg_pat_section_transport_stream_id(struct mpeg_pat_sect
 	     (pos); \
 	     (pos) = mpeg_pat_section_programs_next(pat, pos))
 
+/**
+ * Check an unswapped PAT through a read-only view. The buffer is not modified,
+ * so this may be used on shared or read-only data; use the mpeg_pat_view_*()
+ * accessors afterwards instead of mpeg_pat_section_codec().
+ *
+ * @param view View onto the section (CRC checking is up to the caller).
+ * @return 0 if the view holds a valid PAT, nonzero otherwise.
+ */
+extern int mpeg_pat_section_view_validate(const struct section_view *view);
+
+/**
+ * Accessor for the transport_stream_id field of a PAT view.
+ *
+ * @param view Validated PAT view.
+ * @return The transport_stream_id.
+ */
+static inline uint16_t mpeg_pat_view_transport_stream_id(const struct section_view *view)
+{
+	return section_view_table_id_ext(view);
+}
+
+/**
+ * Convenience iterator for the programs of a validated PAT view.
+ *
+ * @param view Validated PAT view.
+ * @param pos Variable holding a const uint8_t pointer to the current program entry.
+ */
+#define mpeg_pat_view_programs_for_each(view, pos) \
+	for ((pos) = mpeg_pat_view_programs_next(view, NULL); \
+	     (pos); \
+	     (pos) = mpeg_pat_view_programs_next(view, pos))
+
+/**
+ * Accessor for the program_number of a PAT view program entry.
+ *
+ * @param pos Program entry from mpeg_pat_view_programs_for_each().
+ * @return The program_number.
+ */
+static inline uint16_t mpeg_pat_view_program_number(const uint8_t *pos)
+{
+	return ucsi_get16(pos);
+}
+
+/**
+ * Accessor for the pid of a PAT view program entry.
+ *
+ * @param pos Program entry from mpeg_pat_view_programs_for_each().
+ * @return The PID.
+ */
+static inline uint16_t mpeg_pat_view_program_pid(const uint8_t *pos)
+{
+	return ucsi_get16(pos + 2) & 0x1fff;
+}
 
 
 
@@ -111,6 +165,22 @@ static inline
 	return (struct mpeg_pat_program *) next;
 }
 
+static inline const uint8_t *
+	mpeg_pat_view_programs_next(const struct section_view *view, const uint8_t *pos)
+{
+	const uint8_t *end = section_view_ext_data(view) + section_view_ext_data_length(view);
+
+	if (pos == NULL)
+		pos = section_view_ext_data(view);
+	else
+		pos += sizeof(struct mpeg_pat_program);
+
+	if (pos >= end)
+		return NULL;
+
+	return pos;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
  */
 
+#include <string.h>
 #include <libucsi/mpeg/pmt_section.h>
 
 struct mpeg_pmt_section * mpeg_pmt_section_codec(struct section_ext * ext)
@@ -69,3 +70,105 @@ struct mpeg_pmt_section * mpeg_pmt_section_codec(struct section_ext * ext)
 
 	return (struct mpeg_pmt_section *) ext;
 }
+
+int mpeg_pmt_section_view_validate(const struct section_view *view)
+{
+	const uint8_t *buf;
+	size_t pos = 0;
+	size_t len;
+	size_t info_length;
+
+	if (!section_view_is_ext(view))
+		return -1;
+
+	buf = section_view_ext_data(view);
+	len = section_view_ext_data_length(view);
+	if (len < 4)
+		return -1;
+
+	info_length = ucsi_get16(buf + 2) & 0x0fff;
+	pos += 4;
+	if ((pos + info_length) > len)
+		return -1;
+	if (verify_descriptors((uint8_t *) buf + pos, info_length))
+		return -1;
+	pos += info_length;
+
+	while (pos < len) {
+		if ((pos + sizeof(struct mpeg_pmt_stream)) > len)
+			return -1;
+
+		info_length = mpeg_pmt_view_stream_es_info_length(buf + pos);
+		pos += sizeof(struct mpeg_pmt_stream);
+
+		if ((pos + info_length) > len)
+			return -1;
+		if (verify_descriptors((uint8_t *) buf + pos, info_length))
+			return -1;
+		pos += info_length;
+	}
+
+	if (pos != len)
+		return -1;
+
+	return 0;
+}
+
+static struct mpeg_pmt_stream *find_stream(struct mpeg_pmt_section *pmt, int pid)
+{
+	struct mpeg_pmt_stream *cur_stream;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (cur_stream->pid == pid)
+			return cur_stream;
+	}
+	return NULL;
+}
+
+int mpeg_pmt_section_diff(struct mpeg_pmt_section *old_pmt,
+			  struct mpeg_pmt_section *new_pmt,
+			  mpeg_pmt_diff_callback callback, void *private)
+{
+	struct mpeg_pmt_stream *old_stream;
+	struct mpeg_pmt_stream *new_stream;
+	int result = 0;
+	int change;
+
+	if (old_pmt->pcr_pid != new_pmt->pcr_pid)
+		result |= MPEG_PMT_DIFF_PCR_PID;
+	if ((old_pmt->program_info_length != new_pmt->program_info_length) ||
+	    memcmp((uint8_t *) old_pmt + sizeof(struct mpeg_pmt_section),
+		   (uint8_t *) new_pmt + sizeof(struct mpeg_pmt_section),
+		   old_pmt->program_info_length))
+		result |= MPEG_PMT_DIFF_PROGRAM_INFO;
+
+	mpeg_pmt_section_streams_for_each(old_pmt, old_stream) {
+		if (find_stream(new_pmt, old_stream->pid) == NULL) {
+			result |= MPEG_PMT_DIFF_STREAMS;
+			if (callback)
+				callback(private, MPEG_PMT_DIFF_REMOVED, old_stream, NULL);
+		}
+	}
+
+	mpeg_pmt_section_streams_for_each(new_pmt, new_stream) {
+		old_stream = find_stream(old_pmt, new_stream->pid);
+
+		if (old_stream == NULL)
+			change = MPEG_PMT_DIFF_ADDED;
+		else if (old_stream->stream_type != new_stream->stream_type)
+			change = MPEG_PMT_DIFF_TYPE;
+		else if ((old_stream->es_info_length != new_stream->es_info_length) ||
+			 memcmp((uint8_t *) old_stream + sizeof(struct mpeg_pmt_stream),
+				(uint8_t *) new_stream + sizeof(struct mpeg_pmt_stream),
+				old_stream->es_info_length))
+			change = MPEG_PMT_DIFF_ES_INFO;
+		else
+			continue;
+
+		result |= MPEG_PMT_DIFF_STREAMS;
+		if (callback)
+			callback(private, change, old_stream, new_stream);
+	}
+
+	return result;
+}
@@ -28,6 +28,7 @@ extern "C"
 #endif
 
 #include <libucsi/section.h>
+#include <libucsi/section_view.h>
 
 /**
  * mpeg_pmt_section structure.
@@ -108,6 +109,146 @@ static inline uint16_t mpeg_pmt_section_program_number(struct mpeg_pmt_section *
 	     (pos); \
 	     (pos) = mpeg_pmt_stream_descriptors_next(stream, pos))
 
+/**
+ * Check an unswapped PMT through a read-only view. The buffer is not modified,
+ * so this may be used on shared or read-only data; use the mpeg_pmt_view_*()
+ * accessors afterwards instead of mpeg_pmt_section_codec().
+ *
+ * @param view View onto the section (CRC checking is up to the caller).
+ * @return 0 if the view holds a valid PMT, nonzero otherwise.
+ */
+extern int mpeg_pmt_section_view_validate(const struct section_view *view);
+
+/**
+ * Accessor for the program_number field of a PMT view.
+ *
+ * @param view Validated PMT view.
+ * @return The program_number.
+ */
+static inline uint16_t mpeg_pmt_view_program_number(const struct section_view *view)
+{
+	return section_view_table_id_ext(view);
+}
+
+/**
+ * Accessor for the pcr_pid field of a PMT view.
+ *
+ * @param view Validated PMT view.
+ * @return The pcr_pid.
+ */
+static inline uint16_t mpeg_pmt_view_pcr_pid(const struct section_view *view)
+{
+	return ucsi_get16(section_view_ext_data(view)) & 0x1fff;
+}
+
+/**
+ * Accessor for the length of the program info descriptor loop of a PMT view.
+ *
+ * @param view Validated PMT view.
+ * @return The program_info_length.
+ */
+static inline uint16_t mpeg_pmt_view_program_info_length(const struct section_view *view)
+{
+	return ucsi_get16(section_view_ext_data(view) + 2) & 0x0fff;
+}
+
+/**
+ * Accessor for the program info descriptor loop of a PMT view. Iterate it
+ * with section_view_descriptors_for_each().
+ *
+ * @param view Validated PMT view.
+ * @return Pointer to the descriptors.
+ */
+static inline const uint8_t *mpeg_pmt_view_program_info(const struct section_view *view)
+{
+	return section_view_ext_data(view) + 4;
+}
+
+/**
+ * Convenience iterator for the streams of a validated PMT view.
+ *
+ * @param view Validated PMT view.
+ * @param pos Variable holding a const uint8_t pointer to the current stream entry.
+ */
+#define mpeg_pmt_view_streams_for_each(view, pos) \
+	for ((pos) = mpeg_pmt_view_streams_next(view, NULL); \
+	     (pos); \
+	     (pos) = mpeg_pmt_view_streams_next(view, pos))
+
+static inline uint8_t mpeg_pmt_view_stream_type(const uint8_t *pos)
+{
+	return pos[0];
+}
+
+static inline uint16_t mpeg_pmt_view_stream_pid(const uint8_t *pos)
+{
+	return ucsi_get16(pos + 1) & 0x1fff;
+}
+
+static inline uint16_t mpeg_pmt_view_stream_es_info_length(const uint8_t *pos)
+{
+	return ucsi_get16(pos + 3) & 0x0fff;
+}
+
+/**
+ * Accessor for the descriptor loop of a PMT view stream entry. Iterate it
+ * with section_view_descriptors_for_each().
+ *
+ * @param pos Stream entry from mpeg_pmt_view_streams_for_each().
+ * @return Pointer to the descriptors.
+ */
+static inline const uint8_t *mpeg_pmt_view_stream_es_info(const uint8_t *pos)
+{
+	return pos + sizeof(struct mpeg_pmt_stream);
+}
+
+/**
+ * Possible values for the change argument of an mpeg_pmt_diff_callback.
+ */
+enum mpeg_pmt_diff_change {
+	MPEG_PMT_DIFF_ADDED = 1,		/* PID only in the new PMT */
+	MPEG_PMT_DIFF_REMOVED = 2,		/* PID only in the old PMT */
+	MPEG_PMT_DIFF_TYPE = 3,			/* stream_type changed */
+	MPEG_PMT_DIFF_ES_INFO = 4,		/* only the descriptors changed */
+};
+
+/**
+ * Bits of the return value of mpeg_pmt_section_diff().
+ */
+#define MPEG_PMT_DIFF_PCR_PID		0x01
+#define MPEG_PMT_DIFF_PROGRAM_INFO	0x02
+#define MPEG_PMT_DIFF_STREAMS		0x04
+
+/**
+ * Callback invoked by mpeg_pmt_section_diff() for every stream which differs.
+ *
+ * @param private Private pointer passed to mpeg_pmt_section_diff().
+ * @param change One of MPEG_PMT_DIFF_*.
+ * @param old_stream The stream in the old PMT, NULL if MPEG_PMT_DIFF_ADDED.
+ * @param new_stream The stream in the new PMT, NULL if MPEG_PMT_DIFF_REMOVED.
+ */
+typedef void (*mpeg_pmt_diff_callback)(void *private, int change,
+				       struct mpeg_pmt_stream *old_stream,
+				       struct mpeg_pmt_stream *new_stream);
+
+/**
+ * Compare two PMTs stream by stream, matching the streams by PID. Streams
+ * which are the same in both (type and descriptors) are not reported; the
+ * removed ones are reported first, then the rest in the new PMT's order.
+ * Both PMTs must have been through mpeg_pmt_section_codec().
+ *
+ * @param old_pmt The previous PMT.
+ * @param new_pmt The new PMT.
+ * @param callback Called for each stream which differs, may be NULL.
+ * @param private Passed to the callback.
+ * @return A combination of MPEG_PMT_DIFF_PCR_PID, MPEG_PMT_DIFF_PROGRAM_INFO
+ * and MPEG_PMT_DIFF_STREAMS (any stream reported), 0 if the PMTs carry the
+ * same program.
+ */
+extern int mpeg_pmt_section_diff(struct mpeg_pmt_section *old_pmt,
+				 struct mpeg_pmt_section *new_pmt,
+				 mpeg_pmt_diff_callback callback, void *private);
+
 
 
 
@@ -181,6 +322,22 @@ static inline struct descriptor *
 			       pos);
 }
 
+static inline const uint8_t *
+	mpeg_pmt_view_streams_next(const struct section_view *view, const uint8_t *pos)
+{
+	const uint8_t *end = section_view_ext_data(view) + section_view_ext_data_length(view);
+
+	if (pos == NULL)
+		pos = mpeg_pmt_view_program_info(view) + mpeg_pmt_view_program_info_length(view);
+	else
+		pos += sizeof(struct mpeg_pmt_stream) + mpeg_pmt_view_stream_es_info_length(pos);
+
+	if (pos >= end)
+		return NULL;
+
+	return pos;
+}
+
 #ifdef __cplusplus
 }
 #endif
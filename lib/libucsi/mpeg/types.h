@@ -55,6 +55,8 @@ enum {
 	MPEG_STREAM_TYPE_METADATA_DSMCC_DATA   = 0x17,
 	MPEG_STREAM_TYPE_METADATA_DSMCC_OBJECT = 0x18,
 	MPEG_STREAM_TYPE_METADATA_SYNCDOWNLOAD = 0x19,
+	MPEG_STREAM_TYPE_ISO14496_10_VIDEO   = 0x1b,
+	MPEG_STREAM_TYPE_ISO23008_2_VIDEO    = 0x24,
 };
 
 /**
@@ -0,0 +1,501 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "pes_reasm.h"
+
+#define PES_PREFIX_SIZE 6		/* start code prefix, stream_id, PES_packet_length */
+#define PES_HDR_SIZE 9			/* ... and the two flag bytes and header length */
+#define PES_MAX_HDR_SIZE (PES_HDR_SIZE + 255)
+#define SLOT_UNUSED 0xffff
+
+/* pieces of a PES packet kept in place in the current buffer, per PID */
+#define MAX_FRAGS 64
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+struct pes_reasm_slot {
+	int pid;
+	uint8_t continuity;
+	uint8_t active:1;
+	uint8_t started:1;		/* collecting a PES packet */
+	uint8_t lost:1;			/* a PES packet was dropped since the last one */
+	uint32_t length;		/* total bytes expected; 0 => unbounded */
+	uint32_t have;			/* bytes so far, copied and in place */
+	uint32_t copied;		/* bytes in the slot's buffer */
+	int nfrags;
+	struct iovec frags[MAX_FRAGS];
+};
+
+struct pes_reasm {
+	int max_pids;
+	int max_pes_size;
+	int flags;
+	uint16_t pid_slot[TRANSPORT_MAX_PIDS];
+	struct pes_reasm_slot *slots;
+	uint8_t *arena;
+	struct transport_packet_batch batch;
+};
+
+static inline uint8_t *slot_data(struct pes_reasm *reasm, int slot)
+{
+	return reasm->arena + ((size_t) slot * reasm->max_pes_size);
+}
+
+static void slot_reset(struct pes_reasm_slot *slot)
+{
+	slot->started = 0;
+	slot->length = 0;
+	slot->have = 0;
+	slot->copied = 0;
+	slot->nfrags = 0;
+}
+
+struct pes_reasm *pes_reasm_create(int max_pids, int max_pes_size, int flags)
+{
+	struct pes_reasm *reasm;
+	int i;
+
+	if ((max_pids < 1) || (max_pids > TRANSPORT_MAX_PIDS) ||
+	    (max_pes_size < PES_MAX_HDR_SIZE))
+		return NULL;
+
+	reasm = (struct pes_reasm *) malloc(sizeof(struct pes_reasm));
+	if (reasm == NULL)
+		return NULL;
+	memset(reasm, 0, sizeof(struct pes_reasm));
+	reasm->max_pids = max_pids;
+	reasm->max_pes_size = max_pes_size;
+	reasm->flags = flags;
+
+	reasm->slots = (struct pes_reasm_slot *) calloc(max_pids, sizeof(struct pes_reasm_slot));
+	reasm->arena = (uint8_t *) malloc((size_t) max_pids * max_pes_size);
+	if ((reasm->slots == NULL) || (reasm->arena == NULL)) {
+		pes_reasm_destroy(reasm);
+		return NULL;
+	}
+
+	for(i=0; i < TRANSPORT_MAX_PIDS; i++)
+		reasm->pid_slot[i] = SLOT_UNUSED;
+
+	return reasm;
+}
+
+void pes_reasm_destroy(struct pes_reasm *reasm)
+{
+	if (reasm == NULL)
+		return;
+
+	free(reasm->slots);
+	free(reasm->arena);
+	free(reasm);
+}
+
+int pes_reasm_add_pid(struct pes_reasm *reasm, int pid)
+{
+	int i;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return -EINVAL;
+	if (reasm->pid_slot[pid] != SLOT_UNUSED)
+		return 0;
+
+	for(i=0; i < reasm->max_pids; i++) {
+		if (!reasm->slots[i].active)
+			break;
+	}
+	if (i == reasm->max_pids)
+		return -ENOSPC;
+
+	reasm->slots[i].active = 1;
+	reasm->slots[i].pid = pid;
+	reasm->slots[i].continuity = 0;
+	reasm->slots[i].lost = 0;
+	slot_reset(&reasm->slots[i]);
+	reasm->pid_slot[pid] = i;
+
+	return 0;
+}
+
+void pes_reasm_remove_pid(struct pes_reasm *reasm, int pid)
+{
+	int slot;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return;
+	if ((slot = reasm->pid_slot[pid]) == SLOT_UNUSED)
+		return;
+
+	reasm->slots[slot].active = 0;
+	reasm->pid_slot[pid] = SLOT_UNUSED;
+}
+
+void pes_reasm_reset_pid(struct pes_reasm *reasm, int pid)
+{
+	int slot;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return;
+	if ((slot = reasm->pid_slot[pid]) == SLOT_UNUSED)
+		return;
+
+	reasm->slots[slot].continuity = 0;
+	reasm->slots[slot].lost = 0;
+	slot_reset(&reasm->slots[slot]);
+}
+
+/* move the pieces still in place into the slot's buffer */
+static void slot_copy(struct pes_reasm *reasm, int idx)
+{
+	struct pes_reasm_slot *slot = &reasm->slots[idx];
+	uint8_t *data = slot_data(reasm, idx);
+	int i;
+
+	for(i=0; i < slot->nfrags; i++) {
+		memcpy(data + slot->copied, slot->frags[i].iov_base, slot->frags[i].iov_len);
+		slot->copied += slot->frags[i].iov_len;
+	}
+	slot->nfrags = 0;
+}
+
+static void slot_drop(struct pes_reasm_slot *slot)
+{
+	if (slot->started)
+		slot->lost = 1;
+	slot_reset(slot);
+}
+
+/* copy len bytes from offset of a chain of pieces; returns bytes copied */
+static int iov_gather(const struct iovec *iov, int iovcnt, size_t offset, uint8_t *dst, size_t len)
+{
+	size_t done = 0;
+	int i;
+
+	for(i=0; (i < iovcnt) && (done < len); i++) {
+		size_t n;
+
+		if (offset >= iov[i].iov_len) {
+			offset -= iov[i].iov_len;
+			continue;
+		}
+		n = iov[i].iov_len - offset;
+		if (n > (len - done))
+			n = len - done;
+		memcpy(dst + done, (uint8_t *) iov[i].iov_base + offset, n);
+		done += n;
+		offset = 0;
+	}
+
+	return done;
+}
+
+static uint64_t pes_timestamp(const uint8_t *b)
+{
+	return ((uint64_t) ((b[0] >> 1) & 7) << 30) | ((uint64_t) b[1] << 22) |
+	       ((uint64_t) (b[2] >> 1) << 15) | ((uint64_t) b[3] << 7) | (b[4] >> 1);
+}
+
+/* streams without the optional PES header (ISO 13818-1 2.4.3.7) */
+static int pes_has_header(uint8_t stream_id)
+{
+	switch(stream_id) {
+	case 0xbc:	/* program_stream_map */
+	case 0xbe:	/* padding_stream */
+	case 0xbf:	/* private_stream_2 */
+	case 0xf0:	/* ECM */
+	case 0xf1:	/* EMM */
+	case 0xf2:	/* DSMCC */
+	case 0xf8:	/* H.222.1 type E */
+	case 0xff:	/* program_stream_directory */
+		return 0;
+	}
+	return 1;
+}
+
+/* parse the header of a complete PES packet and hand out its payload */
+static int slot_deliver(struct pes_reasm *reasm, int idx,
+			pes_reasm_callback callback, void *private)
+{
+	struct pes_reasm_slot *slot = &reasm->slots[idx];
+	struct iovec iov[1 + MAX_FRAGS];
+	struct pes_packet_info info;
+	uint8_t hdr[PES_MAX_HDR_SIZE];
+	size_t total = slot->have;
+	size_t skip;
+	int iovcnt = 0;
+	int first;
+	int i;
+
+	if (slot->copied) {
+		iov[iovcnt].iov_base = slot_data(reasm, idx);
+		iov[iovcnt].iov_len = slot->copied;
+		iovcnt++;
+	}
+	for(i=0; i < slot->nfrags; i++)
+		iov[iovcnt++] = slot->frags[i];
+
+	/* a bounded packet ends with its PES_packet_length */
+	if (slot->length && (total > slot->length)) {
+		size_t excess = total - slot->length;
+
+		while(excess && iovcnt) {
+			if (iov[iovcnt - 1].iov_len > excess) {
+				iov[iovcnt - 1].iov_len -= excess;
+				break;
+			}
+			excess -= iov[iovcnt - 1].iov_len;
+			iovcnt--;
+		}
+		total = slot->length;
+	}
+
+	memset(&info, 0, sizeof(info));
+	if (iov_gather(iov, iovcnt, 0, hdr, PES_HDR_SIZE) < PES_PREFIX_SIZE)
+		goto bad;
+	if ((hdr[0] != 0) || (hdr[1] != 0) || (hdr[2] != 1))
+		goto bad;
+	info.pid = slot->pid;
+	info.stream_id = hdr[3];
+	info.packet_length = (hdr[4] << 8) | hdr[5];
+	if (slot->lost)
+		info.flags |= pes_packet_flag_discontinuity;
+
+	skip = PES_PREFIX_SIZE;
+	if (pes_has_header(info.stream_id)) {
+		size_t hdrlen;
+
+		if ((total < PES_HDR_SIZE) || ((hdr[6] & 0xc0) != 0x80))
+			goto bad;
+		hdrlen = PES_HDR_SIZE + hdr[8];
+		if ((hdrlen > total) ||
+		    (iov_gather(iov, iovcnt, 0, hdr, hdrlen) != (int) hdrlen))
+			goto bad;
+
+		if (hdr[6] & 0x30)
+			info.flags |= pes_packet_flag_scrambled;
+		if (hdr[6] & 0x04)
+			info.flags |= pes_packet_flag_aligned;
+		if ((hdr[7] & 0x80) && (hdrlen >= PES_HDR_SIZE + 5)) {
+			info.pts = pes_timestamp(hdr + PES_HDR_SIZE);
+			info.flags |= pes_packet_flag_pts;
+		}
+		if (((hdr[7] & 0xc0) == 0xc0) && (hdrlen >= PES_HDR_SIZE + 10)) {
+			info.dts = pes_timestamp(hdr + PES_HDR_SIZE + 5);
+			info.flags |= pes_packet_flag_dts;
+		}
+		skip = hdrlen;
+	}
+	info.payload_length = total - skip;
+
+	/* drop the header from the front of the chain */
+	for(first = 0; (first < iovcnt) && skip; first++) {
+		if (iov[first].iov_len > skip) {
+			iov[first].iov_base = (uint8_t *) iov[first].iov_base + skip;
+			iov[first].iov_len -= skip;
+			break;
+		}
+		skip -= iov[first].iov_len;
+	}
+
+	callback(private, &info, iov + first, iovcnt - first);
+	slot->lost = 0;
+	slot_reset(slot);
+	return 1;
+
+bad:
+	slot_drop(slot);
+	return 0;
+}
+
+static int add_payload(struct pes_reasm *reasm, int idx, uint8_t *payload, int len)
+{
+	struct pes_reasm_slot *slot = &reasm->slots[idx];
+
+	if ((slot->have + len) > (uint32_t) reasm->max_pes_size) {
+		slot_drop(slot);
+		return -ERANGE;
+	}
+
+	if (reasm->flags & PES_REASM_COPY) {
+		memcpy(slot_data(reasm, idx) + slot->copied, payload, len);
+		slot->copied += len;
+	} else {
+		if (slot->nfrags == MAX_FRAGS)
+			slot_copy(reasm, idx);
+		slot->frags[slot->nfrags].iov_base = payload;
+		slot->frags[slot->nfrags].iov_len = len;
+		slot->nfrags++;
+	}
+	slot->have += len;
+	return 0;
+}
+
+static int add_packet(struct pes_reasm *reasm, uint8_t *pkt, int i,
+		      pes_reasm_callback callback, void *private)
+{
+	struct transport_packet_batch *batch = &reasm->batch;
+	struct pes_reasm_slot *slot;
+	uint8_t *payload;
+	int delivered = 0;
+	int len;
+	int idx;
+
+	if ((idx = reasm->pid_slot[batch->pid[i]]) == SLOT_UNUSED)
+		return 0;
+	slot = &reasm->slots[idx];
+
+	if (batch->transport_error[i] ||
+	    transport_packet_continuity_check((struct transport_packet *) pkt,
+					      batch->adaptation_flags[i] & transport_adaptation_flag_discontinuity,
+					      &slot->continuity)) {
+		slot->continuity = 0;
+		slot_drop(slot);
+		return 0;
+	}
+	if (batch->payload_offset[i] == 0)
+		return 0;
+
+	payload = pkt + batch->payload_offset[i];
+	len = TRANSPORT_PACKET_LENGTH - batch->payload_offset[i];
+
+	if (batch->payload_unit_start[i]) {
+		/* an unbounded packet ends where the next one starts */
+		if (slot->started) {
+			if (slot->length == 0)
+				delivered += slot_deliver(reasm, idx, callback, private);
+			else
+				slot_drop(slot);
+		}
+		slot->started = 1;
+		if (len >= PES_PREFIX_SIZE) {
+			uint32_t pes_len = (payload[4] << 8) | payload[5];
+
+			if (pes_len)
+				slot->length = PES_PREFIX_SIZE + pes_len;
+		}
+	} else if (!slot->started) {
+		return 0;
+	}
+
+	if (add_payload(reasm, idx, payload, len))
+		return delivered;
+	if (slot->length && (slot->have >= slot->length))
+		delivered += slot_deliver(reasm, idx, callback, private);
+
+	return delivered;
+}
+
+int pes_reasm_add_packets(struct pes_reasm *reasm, uint8_t *buf, int len,
+			  pes_reasm_callback callback, void *private)
+{
+	int used = 0;
+	int off;
+	int i;
+
+	while((len - used) >= TRANSPORT_PACKET_LENGTH) {
+		if (buf[used] != TRANSPORT_PACKET_SYNC) {
+			off = transport_packet_find_sync(buf + used, len - used);
+			if (off < 0) {
+				used = len;
+				break;
+			}
+			used += off;
+			continue;
+		}
+
+		off = transport_packet_batch_extract(buf + used, len - used, &reasm->batch);
+		for(i=0; i < reasm->batch.count; i++)
+			add_packet(reasm, buf + used + (i * TRANSPORT_PACKET_LENGTH), i,
+				   callback, private);
+		used += off;
+	}
+
+	/* the caller may reuse buf once we return */
+	for(i=0; i < reasm->max_pids; i++) {
+		if (reasm->slots[i].active && reasm->slots[i].nfrags)
+			slot_copy(reasm, i);
+	}
+
+	return used;
+}
+
+int pes_reasm_flush(struct pes_reasm *reasm, pes_reasm_callback callback, void *private)
+{
+	int delivered = 0;
+	int i;
+
+	for(i=0; i < reasm->max_pids; i++) {
+		struct pes_reasm_slot *slot = &reasm->slots[i];
+
+		if (!slot->active || !slot->started)
+			continue;
+		if (slot->length == 0)
+			delivered += slot_deliver(reasm, i, callback, private);
+		else
+			slot_drop(slot);
+	}
+
+	return delivered;
+}
+
+int pes_write_iov(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct iovec cur[MAX_FRAGS + 1];
+
+	while(iovcnt) {
+		int n = (iovcnt > (int) (sizeof(cur) / sizeof(cur[0]))) ?
+			(int) (sizeof(cur) / sizeof(cur[0])) : iovcnt;
+		ssize_t written;
+		int i;
+
+		if (n > IOV_MAX)
+			n = IOV_MAX;
+		memcpy(cur, iov, n * sizeof(struct iovec));
+		i = 0;
+		while(i < n) {
+			written = writev(fd, cur + i, n - i);
+			if (written < 0) {
+				if (errno == EINTR)
+					continue;
+				return -1;
+			}
+
+			/* step over what went, and trim a piece which went in part */
+			while((i < n) && (written >= (ssize_t) cur[i].iov_len)) {
+				written -= cur[i].iov_len;
+				i++;
+			}
+			if (written) {
+				cur[i].iov_base = (uint8_t *) cur[i].iov_base + written;
+				cur[i].iov_len -= written;
+			}
+		}
+		iov += n;
+		iovcnt -= n;
+	}
+
+	return 0;
+}
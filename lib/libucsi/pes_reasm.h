@@ -0,0 +1,179 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_PES_REASM_H
+#define _UCSI_PES_REASM_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include <libucsi/transport_packet.h>
+
+/**
+ * Opaque structure for reassembling PES packets from many PIDs at once.
+ */
+struct pes_reasm;
+
+/**
+ * Flags for pes_reasm_create().
+ */
+#define PES_REASM_COPY		1	/* hand out every PES packet in one piece */
+
+/**
+ * Flags of a PES packet.
+ */
+enum pes_packet_flags {
+	pes_packet_flag_pts		= 0x01,	/* pts is valid */
+	pes_packet_flag_dts		= 0x02,	/* dts is valid */
+	pes_packet_flag_aligned		= 0x04,	/* data_alignment_indicator */
+	pes_packet_flag_scrambled	= 0x08,	/* PES_scrambling_control != 0 */
+	pes_packet_flag_discontinuity	= 0x10,	/* data was lost before this packet */
+};
+
+/**
+ * A reassembled PES packet, as handed to the callback.
+ */
+struct pes_packet_info {
+	int pid;
+	uint8_t stream_id;
+	int flags;			/* enum pes_packet_flags */
+	uint64_t pts;			/* 90 kHz */
+	uint64_t dts;			/* 90 kHz */
+	uint32_t packet_length;		/* PES_packet_length; 0 => unbounded (video) */
+	uint32_t payload_length;	/* bytes of elementary stream in the iovecs */
+};
+
+/**
+ * Callback invoked for every complete PES packet, with its elementary stream
+ * payload (the PES header already removed) as a chain of pieces.
+ *
+ * The pieces point straight into the transport packets of the buffer passed
+ * to pes_reasm_add_packets() wherever they can. A packet started in an
+ * earlier buffer has its earlier part copied into the PID's own buffer,
+ * which is the first piece; with PES_REASM_COPY that buffer is the only
+ * piece. Either way they are only valid until the callback returns.
+ *
+ * @param private Private pointer passed to pes_reasm_add_packets().
+ * @param info Description of the PES packet.
+ * @param iov Pieces of the payload.
+ * @param iovcnt Number of pieces (0 for an empty payload).
+ */
+typedef void (*pes_reasm_callback)(void *private, const struct pes_packet_info *info,
+				   const struct iovec *iov, int iovcnt);
+
+/**
+ * Create a reassembler. All buffer space is allocated up front in one arena.
+ *
+ * @param max_pids Maximum number of PIDs which can be registered at once
+ * (1 to TRANSPORT_MAX_PIDS).
+ * @param max_pes_size Maximum size of a PES packet including its header;
+ * larger ones are discarded. 65536 + 6 holds any packet with a
+ * PES_packet_length; video (unbounded) needs room for its largest frame.
+ * @param flags PES_REASM_* flags.
+ * @return The pes_reasm, or NULL on error.
+ */
+extern struct pes_reasm *pes_reasm_create(int max_pids, int max_pes_size, int flags);
+
+/**
+ * Destroy a reassembler.
+ *
+ * @param reasm The pes_reasm to destroy.
+ */
+extern void pes_reasm_destroy(struct pes_reasm *reasm);
+
+/**
+ * Start reassembling PES packets on a PID.
+ *
+ * @param reasm The pes_reasm.
+ * @param pid The PID.
+ * @return 0 on success, -EINVAL on a bad PID, -ENOSPC if max_pids are already
+ * registered. Adding an already registered PID is not an error.
+ */
+extern int pes_reasm_add_pid(struct pes_reasm *reasm, int pid);
+
+/**
+ * Stop reassembling PES packets on a PID, discarding any partial packet.
+ *
+ * @param reasm The pes_reasm.
+ * @param pid The PID.
+ */
+extern void pes_reasm_remove_pid(struct pes_reasm *reasm, int pid);
+
+/**
+ * Discard any partial PES packet on a PID (e.g. after a retune). The next
+ * one will be accepted once a payload_unit_start_indicator is seen.
+ *
+ * @param reasm The pes_reasm.
+ * @param pid The PID.
+ */
+extern void pes_reasm_reset_pid(struct pes_reasm *reasm, int pid);
+
+/**
+ * Process a buffer of consecutive transport packets, resynchronising on
+ * sync loss. Any trailing partial packet is ignored. Packets on PIDs which
+ * have not been registered are skipped.
+ *
+ * A PES packet with a PES_packet_length is delivered as soon as it is
+ * complete; an unbounded one when the next one starts on its PID, or
+ * pes_reasm_flush() is called.
+ *
+ * @param reasm The pes_reasm.
+ * @param buf The buffer.
+ * @param len Length of buffer in bytes.
+ * @param callback Function called for every complete PES packet.
+ * @param private Private pointer for callback.
+ * @return Number of bytes consumed from buf.
+ */
+extern int pes_reasm_add_packets(struct pes_reasm *reasm, uint8_t *buf, int len,
+				 pes_reasm_callback callback, void *private);
+
+/**
+ * Deliver the unbounded PES packets still being collected, at the end of
+ * the stream.
+ *
+ * @param reasm The pes_reasm.
+ * @param callback Function called for every PES packet.
+ * @param private Private pointer for callback.
+ * @return Number of PES packets delivered.
+ */
+extern int pes_reasm_flush(struct pes_reasm *reasm,
+			   pes_reasm_callback callback, void *private);
+
+/**
+ * Write a chain of pieces (a PES payload, for instance) to a file
+ * descriptor with as few writev() calls as possible, carrying on after
+ * short writes.
+ *
+ * @param fd The file descriptor.
+ * @param iov Pieces to write.
+ * @param iovcnt Number of pieces.
+ * @return 0 on success, -1 with errno set on failure.
+ */
+extern int pes_write_iov(int fd, const struct iovec *iov, int iovcnt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -29,6 +29,7 @@ extern "C"
 #include <libucsi/endianops.h>
 #include <libucsi/descriptor.h>
 #include <libucsi/crc32.h>
+#include <libucsi/stats.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -141,8 +142,10 @@ static inline int section_check_crc(struct section *section)
 	/* the crc check includes the crc value,
 	 * the result should therefore be zero.
 	 */
-	if (crc)
+	if (crc) {
+		ucsi_stats_crc_error();
 		return -1;
+	}
 	return 0;
 }
 
@@ -20,6 +20,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <libdvbmisc/dvbprobe.h>
 #include "section_buf.h"
 
 #define SECTION_HDR_SIZE 3
@@ -102,8 +103,10 @@ int section_buf_add(struct section_buf *section, uint8_t* frag, int len, int *se
 	used += copy;
 
 	/* have we finished? */
-	if (section->header && (section->len == section->count))
+	if (section->header && (section->len == section->count)) {
 		*section_status = 1;
+		DVBPROBE2(section_complete, *section_buf_data(section), section->len);
+	}
 
 	/* return number of bytes used */
 	return used;
@@ -0,0 +1,406 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+
+#ifndef _UCSI_SECTION_BUILDER_H
+#define _UCSI_SECTION_BUILDER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <libucsi/crc32.h>
+#include <libucsi/section.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ * Builder for raw sections, for generating and rewriting PSI/SI tables.
+ *
+ * Fields are appended big-endian into a buffer supplied by the caller, and
+ * length fields (the section_length, 12 bit loop lengths and descriptor
+ * lengths) are filled in when the part they cover is closed. The CRC is
+ * kept up to date as bytes are written: length fields are written as 0
+ * first and the CRC corrected when they are filled in (crc32_patch()), so
+ * the section is never run over twice, and section_builder_finish() only
+ * has to append it.
+ *
+ * Nothing is ever written beyond the buffer: once a write does not fit the
+ * builder is marked as overflowed, further writes are dropped, and
+ * section_builder_finish() fails. section_builder_room() tells how much can
+ * still be added, for splitting a table across sections.
+ *
+ * Sections already built (or received) can be changed afterwards with
+ * section_patch() and friends, which fix the CRC up from the changed bytes
+ * alone.
+ */
+
+/**
+ * Maximum number of length fields open at once.
+ */
+#define SECTION_BUILDER_DEPTH 4
+
+struct section_builder {
+	uint8_t *buf;
+	size_t size;
+	size_t len;
+	uint32_t crc;		/* of buf[0..len), with open lengths still 0 */
+	int syntax;		/* long form: has a CRC */
+	int overflow;
+	int depth;
+	struct {
+		size_t pos;	/* of the length field */
+		int bits;	/* 8 or 12 */
+	} open[SECTION_BUILDER_DEPTH];
+};
+
+static inline void section_builder_put(struct section_builder *b,
+				       const uint8_t *data, size_t len)
+{
+	if (b->overflow || len > b->size - b->len) {
+		b->overflow = 1;
+		return;
+	}
+	memcpy(b->buf + b->len, data, len);
+	b->crc = crc32(b->crc, b->buf + b->len, len);
+	b->len += len;
+}
+
+/**
+ * Append an 8 bit field.
+ */
+static inline void section_builder_u8(struct section_builder *b, uint8_t v)
+{
+	section_builder_put(b, &v, 1);
+}
+
+/**
+ * Append a 16 bit field.
+ */
+static inline void section_builder_u16(struct section_builder *b, uint16_t v)
+{
+	uint8_t d[2] = { v >> 8, v };
+
+	section_builder_put(b, d, 2);
+}
+
+/**
+ * Append a 24 bit field.
+ */
+static inline void section_builder_u24(struct section_builder *b, uint32_t v)
+{
+	uint8_t d[3] = { v >> 16, v >> 8, v };
+
+	section_builder_put(b, d, 3);
+}
+
+/**
+ * Append a 32 bit field.
+ */
+static inline void section_builder_u32(struct section_builder *b, uint32_t v)
+{
+	uint8_t d[4] = { v >> 24, v >> 16, v >> 8, v };
+
+	section_builder_put(b, d, 4);
+}
+
+/**
+ * Append raw bytes (already encoded descriptors, for example).
+ */
+static inline void section_builder_bytes(struct section_builder *b,
+					 const uint8_t *data, size_t len)
+{
+	section_builder_put(b, data, len);
+}
+
+/**
+ * Start a short form section header (table_id and section_length). The
+ * private_indicator bit is set as given, with the reserved bits as 1s.
+ *
+ * @param b The builder.
+ * @param buf Buffer to build into.
+ * @param size Its size (at most 4096 is ever needed).
+ * @param table_id The table_id.
+ * @param private_indicator The private_indicator bit.
+ */
+static inline void section_builder_start(struct section_builder *b,
+					 uint8_t *buf, size_t size,
+					 uint8_t table_id, int private_indicator)
+{
+	b->buf = buf;
+	b->size = size;
+	b->len = 0;
+	b->crc = CRC32_INIT;
+	b->syntax = 0;
+	b->overflow = 0;
+	b->depth = 0;
+
+	section_builder_u8(b, table_id);
+	section_builder_u16(b, 0x3000 | (private_indicator ? 0x4000 : 0));
+}
+
+/**
+ * Start a long form section header, with current_next_indicator set. The
+ * CRC is appended by section_builder_finish().
+ *
+ * @param b The builder.
+ * @param buf Buffer to build into.
+ * @param size Its size.
+ * @param table_id The table_id.
+ * @param private_indicator The bit after the syntax_indicator (0 for the
+ * MPEG tables, 1 for most DVB ones).
+ * @param table_id_ext The table_id_extension.
+ * @param version The version_number.
+ * @param section_number The section_number.
+ * @param last_section_number The last_section_number; if not known yet,
+ * patch it in afterwards with section_patch_last_section_number().
+ */
+static inline void section_builder_start_ext(struct section_builder *b,
+					     uint8_t *buf, size_t size,
+					     uint8_t table_id, int private_indicator,
+					     uint16_t table_id_ext, int version,
+					     uint8_t section_number,
+					     uint8_t last_section_number)
+{
+	section_builder_start(b, buf, size, table_id, private_indicator);
+	b->buf[1] |= 0x80;
+	b->crc = crc32(CRC32_INIT, b->buf, b->len);
+	b->syntax = 1;
+
+	section_builder_u16(b, table_id_ext);
+	section_builder_u8(b, 0xc1 | ((version & 0x1f) << 1));
+	section_builder_u8(b, section_number);
+	section_builder_u8(b, last_section_number);
+}
+
+/**
+ * Bytes which can still be appended, allowing for the CRC.
+ */
+static inline size_t section_builder_room(struct section_builder *b)
+{
+	size_t crc = b->syntax ? CRC_SIZE : 0;
+
+	if (b->overflow || b->len + crc > b->size)
+		return 0;
+	return b->size - b->len - crc;
+}
+
+static inline void section_builder_open(struct section_builder *b, int bits)
+{
+	if (b->depth == SECTION_BUILDER_DEPTH) {
+		b->overflow = 1;
+		return;
+	}
+	b->open[b->depth].pos = b->len - (bits == 8 ? 1 : 2);
+	b->open[b->depth].bits = bits;
+	b->depth++;
+}
+
+/* fill in a length field already covered by the CRC */
+static inline void section_builder_set_length(struct section_builder *b,
+					      size_t pos, int bits, size_t length)
+{
+	uint8_t delta[2];
+
+	if (bits == 8) {
+		delta[0] = length;
+		b->buf[pos] ^= delta[0];
+		b->crc = crc32_patch(b->crc, delta, 1, b->len - pos - 1);
+	} else {
+		delta[0] = length >> 8;
+		delta[1] = length;
+		b->buf[pos] ^= delta[0];
+		b->buf[pos + 1] ^= delta[1];
+		b->crc = crc32_patch(b->crc, delta, 2, b->len - pos - 2);
+	}
+}
+
+/**
+ * Open a loop preceded by a 12 bit length (a descriptors_loop_length, for
+ * example). The top 4 bits of the field are written as given, normally the
+ * reserved 1s (0xf).
+ *
+ * @param b The builder.
+ * @param top The 4 bits above the length.
+ */
+static inline void section_builder_open_loop(struct section_builder *b, int top)
+{
+	section_builder_u16(b, (top & 0xf) << 12);
+	if (!b->overflow)
+		section_builder_open(b, 12);
+}
+
+/**
+ * Open a descriptor: append its tag, and the length once it is closed.
+ */
+static inline void section_builder_open_descriptor(struct section_builder *b,
+						   uint8_t tag)
+{
+	section_builder_u16(b, tag << 8);
+	if (!b->overflow)
+		section_builder_open(b, 8);
+}
+
+/**
+ * Close the innermost loop or descriptor, filling in its length.
+ */
+static inline void section_builder_close(struct section_builder *b)
+{
+	size_t pos, length;
+	int bits;
+
+	if (b->overflow)
+		return;
+	if (b->depth == 0) {
+		b->overflow = 1;
+		return;
+	}
+
+	b->depth--;
+	pos = b->open[b->depth].pos;
+	bits = b->open[b->depth].bits;
+	length = b->len - pos - (bits == 8 ? 1 : 2);
+	if (length > (bits == 8 ? 0xffu : 0xfffu)) {
+		b->overflow = 1;
+		return;
+	}
+	section_builder_set_length(b, pos, bits, length);
+}
+
+/**
+ * Append a whole descriptor.
+ */
+static inline void section_builder_descriptor(struct section_builder *b,
+					      uint8_t tag, const uint8_t *data,
+					      size_t len)
+{
+	section_builder_open_descriptor(b, tag);
+	section_builder_bytes(b, data, len);
+	section_builder_close(b);
+}
+
+/**
+ * Finish the section: fill in the section_length and, for long sections,
+ * append the CRC.
+ *
+ * @param b The builder.
+ * @return Total length of the section, or -1 if it did not fit the buffer,
+ * is longer than a section can be, or a loop or descriptor is still open.
+ */
+static inline int section_builder_finish(struct section_builder *b)
+{
+	size_t crc = b->syntax ? CRC_SIZE : 0;
+	size_t length;
+
+	if (b->overflow || b->depth || b->len + crc > b->size)
+		return -1;
+
+	length = b->len + crc - sizeof(struct section);
+	if (length > 4093)
+		return -1;
+
+	section_builder_set_length(b, 1, 12, length);
+	if (b->syntax) {
+		b->buf[b->len++] = b->crc >> 24;
+		b->buf[b->len++] = b->crc >> 16;
+		b->buf[b->len++] = b->crc >> 8;
+		b->buf[b->len++] = b->crc;
+	}
+	return b->len;
+}
+
+/**
+ * Overwrite bytes of a raw long form section, fixing its CRC up from the
+ * changed bytes instead of running over the whole section again. The
+ * section's CRC has to be right beforehand.
+ *
+ * @param section The raw section.
+ * @param offset Offset of the first byte to change.
+ * @param data New bytes.
+ * @param len Number of bytes; offset + len must lie before the CRC.
+ */
+static inline void section_patch(uint8_t *section, size_t offset,
+				 const uint8_t *data, size_t len)
+{
+	size_t crc_pos = sizeof(struct section) +
+		((((size_t) section[1] & 0x0f) << 8) | section[2]) - CRC_SIZE;
+	uint8_t delta[16];
+	uint32_t crc;
+	size_t n, i;
+
+	crc = ((uint32_t) section[crc_pos] << 24) | (section[crc_pos + 1] << 16) |
+	      (section[crc_pos + 2] << 8) | section[crc_pos + 3];
+
+	while (len) {
+		n = len < sizeof(delta) ? len : sizeof(delta);
+		for (i = 0; i < n; i++) {
+			delta[i] = section[offset + i] ^ data[i];
+			section[offset + i] = data[i];
+		}
+		crc = crc32_patch(crc, delta, n, crc_pos - offset - n);
+		offset += n;
+		data += n;
+		len -= n;
+	}
+
+	section[crc_pos] = crc >> 24;
+	section[crc_pos + 1] = crc >> 16;
+	section[crc_pos + 2] = crc >> 8;
+	section[crc_pos + 3] = crc;
+}
+
+/**
+ * Change the version_number of a raw long form section, fixing the CRC up.
+ */
+static inline void section_patch_version(uint8_t *section, int version)
+{
+	uint8_t b = (section[5] & 0xc1) | ((version & 0x1f) << 1);
+
+	section_patch(section, 5, &b, 1);
+}
+
+/**
+ * Change the current_next_indicator of a raw long form section, fixing
+ * the CRC up.
+ */
+static inline void section_patch_current_next(uint8_t *section, int current_next)
+{
+	uint8_t b = (section[5] & 0xfe) | (current_next ? 1 : 0);
+
+	section_patch(section, 5, &b, 1);
+}
+
+/**
+ * Change the last_section_number of a raw long form section, fixing the
+ * CRC up; for tables split across sections once the number is known.
+ */
+static inline void section_patch_last_section_number(uint8_t *section,
+						     uint8_t last_section_number)
+{
+	section_patch(section, 7, &last_section_number, 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
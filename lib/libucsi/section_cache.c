@@ -0,0 +1,286 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "section_cache.h"
+#include "endianops.h"
+
+#define SECTION_CACHE_HDR_SIZE 8
+#define SECTION_CACHE_INITIAL_SIZE 64
+#define SECTION_CACHE_NO_VERSION 0xff
+
+/* DVB EIT tables carry a segment_last_section_number */
+#define EIT_TABLE_ID_FIRST 0x4e
+#define EIT_TABLE_ID_LAST 0x6f
+#define EIT_SEGMENT_LAST_OFFSET 12
+
+struct section_cache_entry {
+	uint64_t key;			/* 0 => unused slot */
+	uint8_t version;
+	uint8_t last_section_number;
+	uint8_t complete:1;
+	uint8_t seen[32];		/* bitmap of section_numbers received */
+};
+
+struct section_cache {
+	struct section_cache_entry *entries;
+	uint32_t size;			/* always a power of 2 */
+	uint32_t used;
+	struct section_cache_stats stats;
+};
+
+/* the top bit is always set so a valid key is never 0 */
+static inline uint64_t section_cache_key(int pid, const uint8_t *buf)
+{
+	return (1ULL << 63) |
+	       ((uint64_t) (pid & 0x1fff) << 24) |
+	       ((uint64_t) buf[0] << 16) |
+	       ucsi_get16(buf + 3);
+}
+
+static inline uint32_t section_cache_hash(uint64_t key, uint32_t size)
+{
+	key *= 0x9e3779b97f4a7c15ULL;
+	return (uint32_t) (key >> 32) & (size - 1);
+}
+
+static struct section_cache_entry *section_cache_lookup(struct section_cache *cache,
+							uint64_t key)
+{
+	uint32_t i = section_cache_hash(key, cache->size);
+
+	while(cache->entries[i].key) {
+		if (cache->entries[i].key == key)
+			return &cache->entries[i];
+		i = (i + 1) & (cache->size - 1);
+	}
+
+	return &cache->entries[i];
+}
+
+static int section_cache_grow(struct section_cache *cache)
+{
+	struct section_cache_entry *old = cache->entries;
+	uint32_t oldsize = cache->size;
+	uint32_t i;
+
+	cache->entries = (struct section_cache_entry *)
+		calloc(oldsize * 2, sizeof(struct section_cache_entry));
+	if (cache->entries == NULL) {
+		cache->entries = old;
+		return -ENOMEM;
+	}
+	cache->size = oldsize * 2;
+
+	for(i=0; i < oldsize; i++) {
+		if (old[i].key)
+			*section_cache_lookup(cache, old[i].key) = old[i];
+	}
+
+	free(old);
+	return 0;
+}
+
+struct section_cache *section_cache_create(void)
+{
+	struct section_cache *cache;
+
+	cache = (struct section_cache *) malloc(sizeof(struct section_cache));
+	if (cache == NULL)
+		return NULL;
+	memset(cache, 0, sizeof(struct section_cache));
+
+	cache->entries = (struct section_cache_entry *)
+		calloc(SECTION_CACHE_INITIAL_SIZE, sizeof(struct section_cache_entry));
+	if (cache->entries == NULL) {
+		free(cache);
+		return NULL;
+	}
+	cache->size = SECTION_CACHE_INITIAL_SIZE;
+
+	return cache;
+}
+
+void section_cache_destroy(struct section_cache *cache)
+{
+	if (cache == NULL)
+		return;
+
+	free(cache->entries);
+	free(cache);
+}
+
+void section_cache_reset(struct section_cache *cache)
+{
+	memset(cache->entries, 0, cache->size * sizeof(struct section_cache_entry));
+	cache->used = 0;
+}
+
+void section_cache_forget_pid(struct section_cache *cache, int pid)
+{
+	struct section_cache_entry *old = cache->entries;
+	uint32_t i;
+
+	/* rehash the survivors, as open addressing has no cheap delete */
+	cache->entries = (struct section_cache_entry *)
+		calloc(cache->size, sizeof(struct section_cache_entry));
+	if (cache->entries == NULL) {
+		/* can't rehash - forget everything instead */
+		cache->entries = old;
+		section_cache_reset(cache);
+		return;
+	}
+
+	cache->used = 0;
+	for(i=0; i < cache->size; i++) {
+		if (old[i].key == 0)
+			continue;
+		if (((old[i].key >> 24) & 0x1fff) == (uint64_t) pid)
+			continue;
+		*section_cache_lookup(cache, old[i].key) = old[i];
+		cache->used++;
+	}
+
+	free(old);
+}
+
+static inline int section_cache_cacheable(const uint8_t *buf, size_t len)
+{
+	/* needs the extended header, and must be a currently applicable table */
+	if (len < SECTION_CACHE_HDR_SIZE)
+		return -EINVAL;
+	if (!(buf[1] & 0x80) || !(buf[5] & 0x01))
+		return 0;
+	return 1;
+}
+
+int section_cache_check(struct section_cache *cache, int pid,
+			const uint8_t *buf, size_t len)
+{
+	struct section_cache_entry *entry;
+	uint8_t version;
+	uint8_t section_number;
+	int ret;
+
+	cache->stats.checked++;
+	if ((ret = section_cache_cacheable(buf, len)) <= 0)
+		return ret < 0 ? ret : 1;
+
+	entry = section_cache_lookup(cache, section_cache_key(pid, buf));
+	if (entry->key == 0)
+		return 1;
+
+	version = (buf[5] >> 1) & 0x1f;
+	section_number = buf[6];
+	if ((entry->version != version) ||
+	    (entry->last_section_number != buf[7]) ||
+	    !(entry->seen[section_number >> 3] & (1 << (section_number & 7))))
+		return 1;
+
+	cache->stats.duplicates++;
+	return 0;
+}
+
+int section_cache_commit(struct section_cache *cache, int pid,
+			 const uint8_t *buf, size_t len)
+{
+	struct section_cache_entry *entry;
+	uint64_t key;
+	uint8_t version;
+	uint8_t section_number;
+	uint8_t last_section_number;
+	int events = 0;
+	int ret;
+	int i;
+
+	if ((ret = section_cache_cacheable(buf, len)) <= 0)
+		return ret;
+
+	key = section_cache_key(pid, buf);
+	entry = section_cache_lookup(cache, key);
+	if (entry->key == 0) {
+		if (((cache->used + 1) * 4) > (cache->size * 3)) {
+			if (section_cache_grow(cache))
+				return -ENOMEM;
+			entry = section_cache_lookup(cache, key);
+		}
+		memset(entry, 0, sizeof(struct section_cache_entry));
+		entry->key = key;
+		entry->version = SECTION_CACHE_NO_VERSION;
+		cache->used++;
+	}
+
+	version = (buf[5] >> 1) & 0x1f;
+	section_number = buf[6];
+	last_section_number = buf[7];
+
+	if ((entry->version != version) ||
+	    (entry->last_section_number != last_section_number)) {
+		if (entry->version != SECTION_CACHE_NO_VERSION)
+			events |= section_cache_event_changed;
+		events |= section_cache_event_new_version;
+
+		entry->version = version;
+		entry->last_section_number = last_section_number;
+		entry->complete = 0;
+		memset(entry->seen, 0, sizeof(entry->seen));
+
+		/* section numbers beyond the last will never arrive */
+		for(i = last_section_number + 1; i < 256; i++)
+			entry->seen[i >> 3] |= 1 << (i & 7);
+	}
+
+	entry->seen[section_number >> 3] |= 1 << (section_number & 7);
+
+	/* EIT sections after the end of this segment will never arrive either */
+	if ((buf[0] >= EIT_TABLE_ID_FIRST) && (buf[0] <= EIT_TABLE_ID_LAST) &&
+	    (len > EIT_SEGMENT_LAST_OFFSET)) {
+		int segment_last = buf[EIT_SEGMENT_LAST_OFFSET];
+		int segment_end = (section_number | 7);
+
+		if ((segment_last >= section_number) && (segment_last <= segment_end)) {
+			for(i = segment_last + 1; i <= segment_end; i++)
+				entry->seen[i >> 3] |= 1 << (i & 7);
+		}
+	}
+
+	if (!entry->complete) {
+		for(i=0; i < 32; i++) {
+			if (entry->seen[i] != 0xff)
+				break;
+		}
+		if (i == 32) {
+			entry->complete = 1;
+			events |= section_cache_event_complete;
+		}
+	}
+
+	cache->stats.committed++;
+	return events;
+}
+
+void section_cache_get_stats(struct section_cache *cache,
+			     struct section_cache_stats *stats)
+{
+	*stats = cache->stats;
+	stats->tables = cache->used;
+}
@@ -0,0 +1,141 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_SECTION_CACHE_H
+#define _UCSI_SECTION_CACHE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Events reported by section_cache_commit().
+ */
+enum section_cache_event {
+	section_cache_event_new_version		= 0x01, /* first section of a new table version */
+	section_cache_event_changed		= 0x02, /* version differs from a previously seen one */
+	section_cache_event_complete		= 0x04, /* all sections of the table have now been seen */
+};
+
+/**
+ * Counters maintained by a section_cache.
+ */
+struct section_cache_stats {
+	uint64_t checked;	/* calls to section_cache_check() */
+	uint64_t duplicates;	/* sections rejected as already seen */
+	uint64_t committed;	/* sections recorded by section_cache_commit() */
+	uint32_t tables;	/* number of distinct tables being tracked */
+};
+
+/**
+ * Opaque cache of which sections of which table versions have been processed,
+ * keyed by (pid, table_id, table_id_ext, section_number, version_number).
+ *
+ * Repeated copies of PSI/SI tables make up the bulk of SI bandwidth. The
+ * intended use is:
+ *
+ * 1) section_cache_check() on the raw section as soon as it arrives. This only
+ * looks at the 8 byte extended header, so duplicates are dropped before any
+ * CRC checking or decoding.
+ * 2) If it returned 1, CRC check and decode the section as normal.
+ * 3) If that succeeded, section_cache_commit() it to learn whether the table
+ * has changed or is now complete.
+ *
+ * Sections without the extended header, and those with current_next_indicator
+ * clear, are never cached.
+ */
+struct section_cache;
+
+/**
+ * Create a new, empty section_cache.
+ *
+ * @return The section_cache, or NULL on error.
+ */
+extern struct section_cache *section_cache_create(void);
+
+/**
+ * Destroy a section_cache.
+ *
+ * @param cache The section_cache.
+ */
+extern void section_cache_destroy(struct section_cache *cache);
+
+/**
+ * Forget everything (e.g. after tuning to a different transport stream).
+ *
+ * @param cache The section_cache.
+ */
+extern void section_cache_reset(struct section_cache *cache);
+
+/**
+ * Forget all tables carried on a particular PID.
+ *
+ * @param cache The section_cache.
+ * @param pid The PID.
+ */
+extern void section_cache_forget_pid(struct section_cache *cache, int pid);
+
+/**
+ * Decide whether a raw, unswapped section needs processing. Only the first 8
+ * bytes of buf are examined and nothing is written to it.
+ *
+ * @param cache The section_cache.
+ * @param pid PID the section was received on.
+ * @param buf The raw section.
+ * @param len Length of the section.
+ * @return 1 if the section should be processed, 0 if it is a duplicate of one
+ * already committed, or <0 if it is too short to be a section.
+ */
+extern int section_cache_check(struct section_cache *cache, int pid,
+			       const uint8_t *buf, size_t len);
+
+/**
+ * Record that a raw, unswapped section has been successfully processed. This
+ * should only be called after the section has passed its CRC check, so a
+ * corrupted header cannot be recorded. Call it before decoding the section in
+ * place, since it reads the raw header.
+ *
+ * @param cache The section_cache.
+ * @param pid PID the section was received on.
+ * @param buf The raw section.
+ * @param len Length of the section.
+ * @return Orred bitmask of enum section_cache_event, or <0 on error.
+ */
+extern int section_cache_commit(struct section_cache *cache, int pid,
+				const uint8_t *buf, size_t len);
+
+/**
+ * Retrieve the counters for a section_cache.
+ *
+ * @param cache The section_cache.
+ * @param stats Where to put them.
+ */
+extern void section_cache_get_stats(struct section_cache *cache,
+				    struct section_cache_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "section_decoder.h"
+#include "endianops.h"
+
+#define SECTION_DECODER_HDR_SIZE 8
+#define SECTION_DECODER_INITIAL_SIZE 64
+
+struct section_decoder_entry {
+	uint64_t key;			/* 0 => unused slot */
+	uint32_t len;
+	uint32_t crc;			/* the last 4 bytes, as they came */
+	uint8_t *copy;			/* decoded; followed by the raw section
+					 * unless the CRCs are verified */
+	void *view;
+};
+
+struct section_decoder {
+	int flags;
+	struct section_decoder_entry *entries;
+	uint32_t size;			/* always a power of 2 */
+	uint32_t used;
+	struct section_decoder_stats stats;
+};
+
+/* the top bit is always set so a valid key is never 0 */
+static inline uint64_t section_decoder_key(int pid, const uint8_t *buf)
+{
+	return (1ULL << 63) |
+	       ((uint64_t) (buf[5] & 0x01) << 45) |
+	       ((uint64_t) (pid & 0x1fff) << 32) |
+	       ((uint64_t) buf[0] << 24) |
+	       ((uint64_t) ucsi_get16(buf + 3) << 8) |
+	       buf[6];
+}
+
+static inline uint32_t section_decoder_hash(uint64_t key, uint32_t size)
+{
+	key *= 0x9e3779b97f4a7c15ULL;
+	return (uint32_t) (key >> 32) & (size - 1);
+}
+
+static struct section_decoder_entry *section_decoder_lookup(struct section_decoder *decoder,
+							    uint64_t key)
+{
+	uint32_t i = section_decoder_hash(key, decoder->size);
+
+	while(decoder->entries[i].key) {
+		if (decoder->entries[i].key == key)
+			return &decoder->entries[i];
+		i = (i + 1) & (decoder->size - 1);
+	}
+
+	return &decoder->entries[i];
+}
+
+static int section_decoder_grow(struct section_decoder *decoder)
+{
+	struct section_decoder_entry *old = decoder->entries;
+	uint32_t oldsize = decoder->size;
+	uint32_t i;
+
+	decoder->entries = (struct section_decoder_entry *)
+		calloc(oldsize * 2, sizeof(struct section_decoder_entry));
+	if (decoder->entries == NULL) {
+		decoder->entries = old;
+		return -ENOMEM;
+	}
+	decoder->size = oldsize * 2;
+
+	for(i=0; i < oldsize; i++) {
+		if (old[i].key)
+			*section_decoder_lookup(decoder, old[i].key) = old[i];
+	}
+
+	free(old);
+	return 0;
+}
+
+struct section_decoder *section_decoder_create(int flags)
+{
+	struct section_decoder *decoder;
+
+	decoder = (struct section_decoder *) malloc(sizeof(struct section_decoder));
+	if (decoder == NULL)
+		return NULL;
+	memset(decoder, 0, sizeof(struct section_decoder));
+	decoder->flags = flags;
+
+	decoder->entries = (struct section_decoder_entry *)
+		calloc(SECTION_DECODER_INITIAL_SIZE, sizeof(struct section_decoder_entry));
+	if (decoder->entries == NULL) {
+		free(decoder);
+		return NULL;
+	}
+	decoder->size = SECTION_DECODER_INITIAL_SIZE;
+
+	return decoder;
+}
+
+void section_decoder_reset(struct section_decoder *decoder)
+{
+	uint32_t i;
+
+	for(i=0; i < decoder->size; i++)
+		free(decoder->entries[i].copy);
+	memset(decoder->entries, 0, decoder->size * sizeof(struct section_decoder_entry));
+	decoder->used = 0;
+	decoder->stats.bytes = 0;
+}
+
+void section_decoder_destroy(struct section_decoder *decoder)
+{
+	if (decoder == NULL)
+		return;
+
+	section_decoder_reset(decoder);
+	free(decoder->entries);
+	free(decoder);
+}
+
+static inline int section_decoder_same(struct section_decoder *decoder,
+				       struct section_decoder_entry *entry,
+				       const uint8_t *buf, size_t len)
+{
+	if ((entry->copy == NULL) || (entry->len != len))
+		return 0;
+
+	/* a verified CRC over the whole section tells copies apart well enough */
+	if (decoder->flags & SECTION_DECODER_CRC_VERIFIED)
+		return entry->crc == ucsi_get32(buf + len - CRC_SIZE);
+
+	return !memcmp(entry->copy + len, buf, len);
+}
+
+void *section_decoder_decode(struct section_decoder *decoder, int pid,
+			     const uint8_t *buf, size_t len,
+			     section_decoder_codec codec, int *repeat)
+{
+	int check_crc = !(decoder->flags & SECTION_DECODER_CRC_VERIFIED);
+	struct section_decoder_entry *entry;
+	struct section_ext *ext;
+	struct section *section;
+	uint8_t *copy;
+	uint64_t key;
+	void *view;
+
+	if (repeat)
+		*repeat = 0;
+	if ((len < SECTION_DECODER_HDR_SIZE + CRC_SIZE) || !(buf[1] & 0x80)) {
+		decoder->stats.invalid++;
+		return NULL;
+	}
+
+	key = section_decoder_key(pid, buf);
+	entry = section_decoder_lookup(decoder, key);
+	if ((entry->key == key) && section_decoder_same(decoder, entry, buf, len)) {
+		decoder->stats.repeats++;
+		if (repeat)
+			*repeat = 1;
+		return entry->view;
+	}
+
+	/* decode a new copy, keeping the old one should this one be bad */
+	if ((copy = (uint8_t *) malloc(check_crc ? len * 2 : len)) == NULL)
+		return NULL;
+	memcpy(copy, buf, len);
+	if (check_crc)
+		memcpy(copy + len, buf, len);
+
+	decoder->stats.decoded++;
+	if (((section = section_codec(copy, len)) == NULL) ||
+	    ((ext = section_ext_decode(section, check_crc)) == NULL) ||
+	    ((view = codec(ext)) == NULL)) {
+		decoder->stats.invalid++;
+		free(copy);
+		return NULL;
+	}
+
+	if (entry->key == 0) {
+		if (((decoder->used + 1) * 4) > (decoder->size * 3)) {
+			if (section_decoder_grow(decoder)) {
+				free(copy);
+				return NULL;
+			}
+			entry = section_decoder_lookup(decoder, key);
+		}
+		entry->key = key;
+		decoder->used++;
+	} else {
+		free(entry->copy);
+		decoder->stats.bytes -= check_crc ? entry->len * 2 : entry->len;
+	}
+
+	entry->len = len;
+	entry->crc = ucsi_get32(buf + len - CRC_SIZE);
+	entry->copy = copy;
+	entry->view = view;
+	decoder->stats.bytes += check_crc ? len * 2 : len;
+	return view;
+}
+
+void section_decoder_get_stats(struct section_decoder *decoder,
+			       struct section_decoder_stats *stats)
+{
+	*stats = decoder->stats;
+	stats->sections = decoder->used;
+}
@@ -0,0 +1,138 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_SECTION_DECODER_H
+#define _UCSI_SECTION_DECODER_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <libucsi/section.h>
+
+/**
+ * Flags for section_decoder_create().
+ */
+enum section_decoder_flags {
+	/* the demux checked the CRC of every section (the checkcrc of
+	 * dvbdemux_set_section_filter()), so the decoder need not */
+	SECTION_DECODER_CRC_VERIFIED		= 0x01,
+};
+
+/**
+ * Counters maintained by a section_decoder.
+ */
+struct section_decoder_stats {
+	uint64_t decoded;	/* sections run through the codec */
+	uint64_t repeats;	/* sections given the view of an identical earlier copy */
+	uint64_t invalid;	/* sections which failed to decode */
+	uint32_t sections;	/* decoded copies held */
+	size_t bytes;		/* memory they take */
+};
+
+/**
+ * A table codec, such as mpeg_pmt_section_codec(), behind a wrapper of this
+ * type. It is given a CRC checked section_ext.
+ */
+typedef void *(*section_decoder_codec)(struct section_ext *ext);
+
+/**
+ * Opaque decode context, which keeps a decoded copy of the last section seen
+ * for each (pid, table_id, table_id_ext, section_number, current_next).
+ *
+ * Most sections received are repeats, byte for byte, of one already decoded,
+ * yet the codecs check the whole structure again (length checks and
+ * verify_descriptors() on every loop), and swap it in place, so it cannot
+ * even be decoded once and kept by the caller without copying. The decoder
+ * decodes a copy on the first sight of a section, and hands out that copy's
+ * view for as long as the section it gets is the same.
+ *
+ * Whether it is the same is decided by comparing it against a raw copy, or,
+ * with SECTION_DECODER_CRC_VERIFIED, just its length and CRC: since the demux
+ * verified the CRC, it is a hash of the section, so a repeat costs no more
+ * than a lookup.
+ *
+ * Only sections with the extended header are decoded.
+ */
+struct section_decoder;
+
+/**
+ * Create a new, empty section_decoder.
+ *
+ * @param flags Orred enum section_decoder_flags.
+ * @return The section_decoder, or NULL on error.
+ */
+extern struct section_decoder *section_decoder_create(int flags);
+
+/**
+ * Destroy a section_decoder, and the views it handed out.
+ *
+ * @param decoder The section_decoder.
+ */
+extern void section_decoder_destroy(struct section_decoder *decoder);
+
+/**
+ * Forget every section (e.g. after tuning to a different transport stream).
+ * The views handed out so far become invalid.
+ *
+ * @param decoder The section_decoder.
+ */
+extern void section_decoder_reset(struct section_decoder *decoder);
+
+/**
+ * Decode a raw, unswapped section, unless an identical copy of it has been
+ * decoded already.
+ *
+ * The view returned belongs to the decoder, and must not be modified. It
+ * stays valid until a section with the same pid, table_id, table_id_ext,
+ * section_number and current_next_indicator but different contents is
+ * decoded, or the decoder is reset or destroyed.
+ *
+ * @param decoder The section_decoder.
+ * @param pid PID the section was received on.
+ * @param buf The raw section, which is not modified.
+ * @param len Length of the section.
+ * @param codec The codec for the section's table.
+ * @param repeat If not NULL, set to 1 if the view is that of an earlier copy
+ * (so the caller may have nothing to do), or 0 if the section was new.
+ * @return What codec returned for the decoded copy, or NULL if the section
+ * is invalid, fails its CRC check, or memory ran out.
+ */
+extern void *section_decoder_decode(struct section_decoder *decoder, int pid,
+				    const uint8_t *buf, size_t len,
+				    section_decoder_codec codec, int *repeat);
+
+/**
+ * Retrieve the counters for a section_decoder.
+ *
+ * @param decoder The section_decoder.
+ * @param stats Where to put them.
+ */
+extern void section_decoder_get_stats(struct section_decoder *decoder,
+				      struct section_decoder_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
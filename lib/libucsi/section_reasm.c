@@ -0,0 +1,296 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libdvbmisc/dvbstats.h>
+#include <libdvbmisc/dvbprobe.h>
+#include "section_reasm.h"
+#include "stats.h"
+
+#define SECTION_HDR_SIZE 3
+#define SECTION_PAD 0xff
+#define SLOT_UNUSED 0xffff
+
+static inline void deliver(section_reasm_callback callback, void *private, int pid,
+			   uint8_t *section, int len)
+{
+	dvbstats_inc(&ucsi_stats, UCSI_STATS_SECTIONS);
+	dvbstats_record(&ucsi_stats, UCSI_STATS_SECTION_BYTES, len);
+	callback(private, pid, section, len);
+}
+
+struct section_reasm_slot {
+	int pid;
+	uint8_t continuity;
+	uint8_t active:1;
+};
+
+struct section_reasm {
+	int max_pids;
+	int max_section_size;
+	int slot_size;
+	uint16_t pid_slot[TRANSPORT_MAX_PIDS];
+	struct section_reasm_slot *slots;
+	uint8_t *arena;
+};
+
+static inline struct section_buf *slot_buf(struct section_reasm *reasm, int slot)
+{
+	return (struct section_buf *) (reasm->arena + (slot * reasm->slot_size));
+}
+
+struct section_reasm *section_reasm_create(int max_pids, int max_section_size)
+{
+	struct section_reasm *reasm;
+	int i;
+
+	if ((max_pids < 1) || (max_pids > TRANSPORT_MAX_PIDS) ||
+	    (max_section_size < SECTION_HDR_SIZE))
+		return NULL;
+
+	reasm = (struct section_reasm *) malloc(sizeof(struct section_reasm));
+	if (reasm == NULL)
+		return NULL;
+	memset(reasm, 0, sizeof(struct section_reasm));
+	reasm->max_pids = max_pids;
+	reasm->max_section_size = max_section_size;
+
+	/* keep each slot's section_buf header properly aligned */
+	reasm->slot_size = (sizeof(struct section_buf) + max_section_size + 7) & ~7;
+
+	reasm->slots = (struct section_reasm_slot *) calloc(max_pids, sizeof(struct section_reasm_slot));
+	reasm->arena = (uint8_t *) malloc((size_t) max_pids * reasm->slot_size);
+	if ((reasm->slots == NULL) || (reasm->arena == NULL)) {
+		section_reasm_destroy(reasm);
+		return NULL;
+	}
+
+	for(i=0; i < TRANSPORT_MAX_PIDS; i++)
+		reasm->pid_slot[i] = SLOT_UNUSED;
+
+	return reasm;
+}
+
+void section_reasm_destroy(struct section_reasm *reasm)
+{
+	if (reasm == NULL)
+		return;
+
+	free(reasm->slots);
+	free(reasm->arena);
+	free(reasm);
+}
+
+int section_reasm_add_pid(struct section_reasm *reasm, int pid)
+{
+	int i;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return -EINVAL;
+	if (reasm->pid_slot[pid] != SLOT_UNUSED)
+		return 0;
+
+	for(i=0; i < reasm->max_pids; i++) {
+		if (!reasm->slots[i].active)
+			break;
+	}
+	if (i == reasm->max_pids)
+		return -ENOSPC;
+
+	reasm->slots[i].active = 1;
+	reasm->slots[i].pid = pid;
+	reasm->slots[i].continuity = 0;
+	section_buf_init(slot_buf(reasm, i), reasm->max_section_size);
+	reasm->pid_slot[pid] = i;
+
+	return 0;
+}
+
+void section_reasm_remove_pid(struct section_reasm *reasm, int pid)
+{
+	int slot;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return;
+	if ((slot = reasm->pid_slot[pid]) == SLOT_UNUSED)
+		return;
+
+	reasm->slots[slot].active = 0;
+	reasm->pid_slot[pid] = SLOT_UNUSED;
+}
+
+void section_reasm_reset_pid(struct section_reasm *reasm, int pid)
+{
+	int slot;
+
+	if ((pid < 0) || (pid >= TRANSPORT_MAX_PIDS))
+		return;
+	if ((slot = reasm->pid_slot[pid]) == SLOT_UNUSED)
+		return;
+
+	reasm->slots[slot].continuity = 0;
+	section_buf_init(slot_buf(reasm, slot), reasm->max_section_size);
+}
+
+/*
+ * Deliver every section starting at pos. Sections which fit entirely in the
+ * payload are handed out in place; a trailing section which continues in the
+ * next packet is copied into the PID's section_buf.
+ */
+static int deliver_sections(struct section_reasm *reasm, struct section_buf *sbuf, int pid,
+			    uint8_t *pos, uint8_t *end,
+			    section_reasm_callback callback, void *private)
+{
+	int delivered = 0;
+	int status;
+	int len;
+
+	while((pos < end) && (*pos != SECTION_PAD)) {
+		if ((end - pos) < SECTION_HDR_SIZE)
+			break;
+
+		len = SECTION_HDR_SIZE + (((pos[1] & 0x0f) << 8) | pos[2]);
+		if (len > reasm->max_section_size)
+			return -ERANGE;
+		if ((pos + len) > end)
+			break;
+
+		DVBPROBE2(section_complete, pos[0], len);
+		deliver(callback, private, pid, pos, len);
+		delivered++;
+		pos += len;
+	}
+
+	/* start accumulating a section which spans packets */
+	if ((pos < end) && (*pos != SECTION_PAD)) {
+		section_buf_add(sbuf, pos, end - pos, &status);
+		if (status < 0) {
+			section_buf_init(sbuf, reasm->max_section_size);
+			return status;
+		}
+	}
+
+	return delivered;
+}
+
+int section_reasm_add_packet(struct section_reasm *reasm, uint8_t *pkt,
+			     section_reasm_callback callback, void *private)
+{
+	struct transport_packet *tspkt;
+	struct transport_values tsvals;
+	struct section_reasm_slot *slot;
+	struct section_buf *sbuf;
+	uint8_t *payload;
+	uint8_t *end;
+	int delivered = 0;
+	int pointer;
+	int status;
+	int pid;
+	int idx;
+
+	if ((tspkt = transport_packet_init(pkt)) == NULL)
+		return -EINVAL;
+	pid = transport_packet_pid(tspkt);
+	if ((idx = reasm->pid_slot[pid]) == SLOT_UNUSED)
+		return 0;
+	slot = &reasm->slots[idx];
+	sbuf = slot_buf(reasm, idx);
+	dvbstats_inc(&ucsi_stats, UCSI_STATS_PACKETS);
+
+	if (transport_packet_values_extract(tspkt, &tsvals, 0) < 0)
+		goto error;
+	if (tspkt->transport_error_indicator)
+		goto error;
+	if (transport_packet_continuity_check(tspkt,
+					      tsvals.flags & transport_adaptation_flag_discontinuity,
+					      &slot->continuity))
+		goto error;
+	if (tsvals.payload_length == 0)
+		return 0;
+
+	payload = tsvals.payload;
+	end = payload + tsvals.payload_length;
+
+	if (!tspkt->payload_unit_start_indicator) {
+		/* only useful if we're partway through a section */
+		if (sbuf->count == 0)
+			return 0;
+
+		section_buf_add(sbuf, payload, end - payload, &status);
+		if (status < 0)
+			goto error;
+		if (status == 1) {
+			deliver(callback, private, pid, section_buf_data(sbuf), sbuf->len);
+			section_buf_init(sbuf, reasm->max_section_size);
+			delivered++;
+		}
+		return delivered;
+	}
+
+	pointer = payload[0];
+	if ((payload + 1 + pointer) > end)
+		goto error;
+
+	/* finish off any section which ends in this packet */
+	if (sbuf->count != 0) {
+		section_buf_add(sbuf, payload + 1, pointer, &status);
+		if (status == 1) {
+			deliver(callback, private, pid, section_buf_data(sbuf), sbuf->len);
+			delivered++;
+		}
+		section_buf_init(sbuf, reasm->max_section_size);
+	}
+
+	status = deliver_sections(reasm, sbuf, pid, payload + 1 + pointer, end,
+				  callback, private);
+	if (status < 0)
+		return status;
+	return delivered + status;
+
+error:
+	dvbstats_inc(&ucsi_stats, UCSI_STATS_TS_ERRORS);
+	slot->continuity = 0;
+	section_buf_init(sbuf, reasm->max_section_size);
+	return -EINVAL;
+}
+
+int section_reasm_add_packets(struct section_reasm *reasm, uint8_t *buf, int len,
+			      section_reasm_callback callback, void *private)
+{
+	int used = 0;
+	int off;
+
+	while((len - used) >= TRANSPORT_PACKET_LENGTH) {
+		if (buf[used] != TRANSPORT_PACKET_SYNC) {
+			off = transport_packet_find_sync(buf + used, len - used);
+			if (off < 0)
+				return len;
+			used += off;
+			continue;
+		}
+
+		section_reasm_add_packet(reasm, buf + used, callback, private);
+		used += TRANSPORT_PACKET_LENGTH;
+	}
+
+	return used;
+}
@@ -0,0 +1,130 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_SECTION_REASM_H
+#define _UCSI_SECTION_REASM_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <libucsi/section_buf.h>
+#include <libucsi/transport_packet.h>
+
+/**
+ * Opaque structure for reassembling sections from many PIDs at once.
+ */
+struct section_reasm;
+
+/**
+ * Callback invoked for every complete section.
+ *
+ * The section pointer either points directly into the transport packet
+ * payload (if the section was contained entirely within one packet), or into
+ * the reassembler's own buffer for that PID. In both cases it is only valid
+ * until the callback returns. The data may be decoded in place.
+ *
+ * @param private Private pointer passed to section_reasm_add_packet().
+ * @param pid PID the section was received on.
+ * @param section Pointer to the start of the section.
+ * @param len Length of the section in bytes.
+ */
+typedef void (*section_reasm_callback)(void *private, int pid, uint8_t *section, int len);
+
+/**
+ * Create a reassembler. All buffer space is allocated up front in one arena.
+ *
+ * @param max_pids Maximum number of PIDs which can be registered at once
+ * (1 to TRANSPORT_MAX_PIDS).
+ * @param max_section_size Maximum size of a section; larger ones are
+ * discarded. Use DVB_MAX_SECTION_BYTES if unsure.
+ * @return The section_reasm, or NULL on error.
+ */
+extern struct section_reasm *section_reasm_create(int max_pids, int max_section_size);
+
+/**
+ * Destroy a reassembler.
+ *
+ * @param reasm The section_reasm to destroy.
+ */
+extern void section_reasm_destroy(struct section_reasm *reasm);
+
+/**
+ * Start reassembling sections on a PID.
+ *
+ * @param reasm The section_reasm.
+ * @param pid The PID.
+ * @return 0 on success, -EINVAL on a bad PID, -ENOSPC if max_pids are already
+ * registered. Adding an already registered PID is not an error.
+ */
+extern int section_reasm_add_pid(struct section_reasm *reasm, int pid);
+
+/**
+ * Stop reassembling sections on a PID, discarding any partial section.
+ *
+ * @param reasm The section_reasm.
+ * @param pid The PID.
+ */
+extern void section_reasm_remove_pid(struct section_reasm *reasm, int pid);
+
+/**
+ * Discard any partial section on a PID (e.g. after a retune). The next
+ * section will be accepted once a payload_unit_start_indicator is seen.
+ *
+ * @param reasm The section_reasm.
+ * @param pid The PID.
+ */
+extern void section_reasm_reset_pid(struct section_reasm *reasm, int pid);
+
+/**
+ * Process a single transport packet. Packets on PIDs which have not been
+ * registered are ignored.
+ *
+ * @param reasm The section_reasm.
+ * @param pkt Pointer to TRANSPORT_PACKET_LENGTH bytes of packet.
+ * @param callback Function called for every complete section.
+ * @param private Private pointer for callback.
+ * @return Number of sections delivered, or <0 if the packet was invalid or a
+ * reassembly error occurred on its PID.
+ */
+extern int section_reasm_add_packet(struct section_reasm *reasm, uint8_t *pkt,
+				    section_reasm_callback callback, void *private);
+
+/**
+ * Process a buffer of consecutive transport packets, resynchronising on
+ * sync loss. Any trailing partial packet is ignored.
+ *
+ * @param reasm The section_reasm.
+ * @param buf The buffer.
+ * @param len Length of buffer in bytes.
+ * @param callback Function called for every complete section.
+ * @param private Private pointer for callback.
+ * @return Number of bytes consumed from buf.
+ */
+extern int section_reasm_add_packets(struct section_reasm *reasm, uint8_t *buf, int len,
+				     section_reasm_callback callback, void *private);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
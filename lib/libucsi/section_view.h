@@ -0,0 +1,198 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_SECTION_VIEW_H
+#define _UCSI_SECTION_VIEW_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <libucsi/endianops.h>
+#include <libucsi/descriptor.h>
+#include <libucsi/section.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Read-only view onto a raw (unswapped) section.
+ *
+ * Unlike the *_section_codec() functions, nothing here ever writes to the
+ * buffer, so the same section data may be viewed any number of times, and
+ * shared between threads or mapped read-only. Fields are read through the
+ * endian-aware accessors below.
+ */
+struct section_view {
+	const uint8_t *buf;
+	size_t len;		/* total length, including header and any CRC */
+};
+
+#define SECTION_VIEW_HDR_SIZE 3
+#define SECTION_VIEW_EXT_HDR_SIZE 8
+
+/**
+ * Set up a view onto a section.
+ *
+ * @param view The view to initialise.
+ * @param buf Pointer to the section data.
+ * @param len Length of the data.
+ * @return 0 on success, or -1 if the length does not match the section header.
+ */
+static inline int section_view_init(struct section_view *view, const uint8_t *buf, size_t len)
+{
+	if (len < SECTION_VIEW_HDR_SIZE)
+		return -1;
+	if (len != (size_t) (SECTION_VIEW_HDR_SIZE + (ucsi_get16(buf + 1) & 0x0fff)))
+		return -1;
+
+	view->buf = buf;
+	view->len = len;
+	return 0;
+}
+
+static inline uint8_t section_view_table_id(const struct section_view *view)
+{
+	return view->buf[0];
+}
+
+static inline int section_view_syntax_indicator(const struct section_view *view)
+{
+	return view->buf[1] >> 7;
+}
+
+/**
+ * Determine whether a view is onto a valid extended (long form) section.
+ *
+ * @param view The view.
+ * @return Nonzero if the section has the extended header and room for a CRC.
+ */
+static inline int section_view_is_ext(const struct section_view *view)
+{
+	return section_view_syntax_indicator(view) &&
+	       (view->len >= SECTION_VIEW_EXT_HDR_SIZE + CRC_SIZE);
+}
+
+/* the following accessors are only valid if section_view_is_ext() */
+
+static inline uint16_t section_view_table_id_ext(const struct section_view *view)
+{
+	return ucsi_get16(view->buf + 3);
+}
+
+static inline uint8_t section_view_version_number(const struct section_view *view)
+{
+	return (view->buf[5] >> 1) & 0x1f;
+}
+
+static inline int section_view_current_next_indicator(const struct section_view *view)
+{
+	return view->buf[5] & 1;
+}
+
+static inline uint8_t section_view_section_number(const struct section_view *view)
+{
+	return view->buf[6];
+}
+
+static inline uint8_t section_view_last_section_number(const struct section_view *view)
+{
+	return view->buf[7];
+}
+
+/**
+ * Retrieve the data following the extended section header.
+ *
+ * @param view The view.
+ * @return Pointer to the data.
+ */
+static inline const uint8_t *section_view_ext_data(const struct section_view *view)
+{
+	return view->buf + SECTION_VIEW_EXT_HDR_SIZE;
+}
+
+/**
+ * Length of the data following the extended section header, excluding the CRC.
+ *
+ * @param view The view.
+ * @return The length.
+ */
+static inline size_t section_view_ext_data_length(const struct section_view *view)
+{
+	return view->len - SECTION_VIEW_EXT_HDR_SIZE - CRC_SIZE;
+}
+
+/**
+ * Check the CRC of a section without modifying it.
+ *
+ * @param view The view.
+ * @return Nonzero on error, or 0 if the CRC was correct.
+ */
+static inline int section_view_check_crc(const struct section_view *view)
+{
+	/* crc32() does not write to the buffer */
+	if (crc32(CRC32_INIT, (uint8_t *) view->buf, view->len)) {
+		ucsi_stats_crc_error();
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * Retrieve the next descriptor in a raw descriptor loop. Descriptor headers
+ * are never byte swapped, so the returned structure may be read directly.
+ *
+ * @param buf Start of the descriptor loop.
+ * @param len Length of the loop (already checked with verify_descriptors()).
+ * @param pos Current descriptor, or NULL to get the first one.
+ * @return Pointer to the descriptor, or NULL if there are no more.
+ */
+static inline const struct descriptor *
+	section_view_next_descriptor(const uint8_t *buf, size_t len, const struct descriptor *pos)
+{
+	const uint8_t *next;
+
+	if (pos == NULL)
+		next = buf;
+	else
+		next = (const uint8_t *) pos + 2 + pos->len;
+	if (next >= buf + len)
+		return NULL;
+
+	return (const struct descriptor *) next;
+}
+
+/**
+ * Convenience iterator for a raw descriptor loop.
+ *
+ * @param buf Start of the descriptor loop.
+ * @param len Length of the loop.
+ * @param pos Variable holding a const pointer to the current descriptor.
+ */
+#define section_view_descriptors_for_each(buf, len, pos) \
+	for ((pos) = section_view_next_descriptor(buf, len, NULL); \
+	     (pos); \
+	     (pos) = section_view_next_descriptor(buf, len, pos))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,396 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libucsi/endianops.h>
+#include <libucsi/dvb/types.h>
+#include "si_table.h"
+
+#define ALIGN(x) (((x) + 7) & ~((size_t) 7))
+
+/**
+ * Where things are in the data after the extended header of each type:
+ * fixed fields, then an optional table level loop (with its 12 bit length),
+ * then an optional 12 bit length of the entries, then the entries, each of
+ * a fixed size followed by a loop whose length is at entry_loop.
+ */
+struct si_layout {
+	int fixed;
+	int top_loop;
+	int entries_length;
+	int entry_size;
+	int entry_loop;			/* -1 => entries have no loop */
+	size_t entry_struct;
+};
+
+static const struct si_layout layouts[] = {
+	[SI_TABLE_PAT] = { 0, 0, 0, 4, -1, sizeof(struct si_pat_program) },
+	[SI_TABLE_PMT] = { 2, 1, 0, 5, 3, sizeof(struct si_pmt_stream) },
+	[SI_TABLE_SDT] = { 3, 0, 0, 5, 3, sizeof(struct si_sdt_service) },
+	[SI_TABLE_NIT] = { 0, 1, 1, 6, 4, sizeof(struct si_transport) },
+	[SI_TABLE_BAT] = { 0, 1, 1, 6, 4, sizeof(struct si_transport) },
+	[SI_TABLE_EIT] = { 6, 0, 0, 12, 10, sizeof(struct si_eit_event) },
+};
+
+struct si_build {
+	struct si_table *table;
+	uint32_t entries;
+	uint32_t descriptors;
+	size_t descriptor_bytes;
+	uint8_t *bytes;			/* next free byte of descriptor copies */
+};
+
+static int si_table_type(uint8_t table_id)
+{
+	switch(table_id) {
+	case 0x00:
+		return SI_TABLE_PAT;
+	case 0x02:
+		return SI_TABLE_PMT;
+	case 0x40:
+	case 0x41:
+		return SI_TABLE_NIT;
+	case 0x42:
+	case 0x46:
+		return SI_TABLE_SDT;
+	case 0x4a:
+		return SI_TABLE_BAT;
+	}
+	if ((table_id >= 0x4e) && (table_id <= 0x6f))
+		return SI_TABLE_EIT;
+	return -1;
+}
+
+/**
+ * Count a descriptor loop, or copy and index it.
+ */
+static int si_loop(struct si_build *b, const uint8_t *buf, size_t len, struct si_loop *loop)
+{
+	size_t pos = 0;
+
+	if (loop != NULL) {
+		memset(loop, 0, sizeof(struct si_loop));
+		loop->first = b->descriptors;
+	}
+
+	while (pos < len) {
+		uint8_t tag = buf[pos];
+		size_t dlen;
+
+		if ((pos + 2) > len)
+			return -1;
+		dlen = 2 + buf[pos + 1];
+		if ((pos + dlen) > len)
+			return -1;
+
+		if (loop != NULL) {
+			memcpy(b->bytes, buf + pos, dlen);
+			b->table->descriptor[b->descriptors] = (const struct descriptor *) b->bytes;
+			b->bytes += dlen;
+			loop->present[tag >> 5] |= 1U << (tag & 31);
+			loop->count++;
+		}
+		b->descriptors++;
+		b->descriptor_bytes += dlen;
+		pos += dlen;
+	}
+
+	return 0;
+}
+
+static void si_entry(struct si_table *table, uint32_t i, const uint8_t *buf)
+{
+	switch(table->type) {
+	case SI_TABLE_PAT:
+		table->programs[i].program_number = ucsi_get16(buf);
+		table->programs[i].pid = ucsi_get16(buf + 2) & 0x1fff;
+		break;
+
+	case SI_TABLE_PMT:
+		table->streams[i].stream_type = buf[0];
+		table->streams[i].pid = ucsi_get16(buf + 1) & 0x1fff;
+		break;
+
+	case SI_TABLE_SDT:
+		table->services[i].service_id = ucsi_get16(buf);
+		table->services[i].eit_schedule = (buf[2] >> 1) & 1;
+		table->services[i].eit_present_following = buf[2] & 1;
+		table->services[i].running_status = buf[3] >> 5;
+		table->services[i].free_ca_mode = (buf[3] >> 4) & 1;
+		break;
+
+	case SI_TABLE_NIT:
+	case SI_TABLE_BAT:
+		table->transports[i].transport_stream_id = ucsi_get16(buf);
+		table->transports[i].original_network_id = ucsi_get16(buf + 2);
+		break;
+
+	case SI_TABLE_EIT:
+		table->events[i].event_id = ucsi_get16(buf);
+		table->events[i].start_time = dvbdate_to_unixtime_fast(buf + 2);
+		table->events[i].duration = dvbduration_to_seconds_fast(buf + 7);
+		table->events[i].running_status = buf[10] >> 5;
+		table->events[i].free_ca_mode = (buf[10] >> 4) & 1;
+		break;
+	}
+}
+
+static struct si_loop *si_entry_loop(struct si_table *table, uint32_t i)
+{
+	switch(table->type) {
+	case SI_TABLE_PMT:
+		return &table->streams[i].descriptors;
+	case SI_TABLE_SDT:
+		return &table->services[i].descriptors;
+	case SI_TABLE_NIT:
+	case SI_TABLE_BAT:
+		return &table->transports[i].descriptors;
+	case SI_TABLE_EIT:
+		return &table->events[i].descriptors;
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Walk the table level loop of a section. Without b->table, only count.
+ *
+ * @return Offset of the entries part in the data, or -1 if malformed.
+ */
+static int si_section_top(struct si_build *b, const struct si_layout *layout,
+			  const uint8_t *data, size_t len, int top)
+{
+	size_t pos = layout->fixed;
+
+	if (pos > len)
+		return -1;
+	if (layout->top_loop) {
+		size_t loop_len;
+
+		if ((pos + 2) > len)
+			return -1;
+		loop_len = ucsi_get16(data + pos) & 0x0fff;
+		pos += 2;
+		if ((pos + loop_len) > len)
+			return -1;
+		if (top && si_loop(b, data + pos, loop_len, NULL))
+			return -1;
+		pos += loop_len;
+	}
+	return pos;
+}
+
+/**
+ * Walk the entries of a section. Without b->table, only count.
+ */
+static int si_section_entries(struct si_build *b, const struct si_layout *layout,
+			      const uint8_t *data, size_t len)
+{
+	struct si_table *table = b->table;
+	int pos = si_section_top(b, layout, data, len, 0);
+	size_t end = len;
+
+	if (pos < 0)
+		return -1;
+	if (layout->entries_length) {
+		if (((size_t) pos + 2) > len)
+			return -1;
+		end = pos + 2 + (ucsi_get16(data + pos) & 0x0fff);
+		pos += 2;
+		if (end > len)
+			return -1;
+	}
+
+	while ((size_t) pos < end) {
+		size_t loop_len = 0;
+
+		if (((size_t) pos + layout->entry_size) > end)
+			return -1;
+		if (layout->entry_loop >= 0)
+			loop_len = ucsi_get16(data + pos + layout->entry_loop) & 0x0fff;
+		if (((size_t) pos + layout->entry_size + loop_len) > end)
+			return -1;
+
+		if (table != NULL)
+			si_entry(table, b->entries, data + pos);
+		if ((layout->entry_loop >= 0) &&
+		    si_loop(b, data + pos + layout->entry_size, loop_len,
+			    table ? si_entry_loop(table, b->entries) : NULL))
+			return -1;
+		b->entries++;
+		pos += layout->entry_size + loop_len;
+	}
+
+	return 0;
+}
+
+static int si_section_number_cmp(const void *a, const void *b)
+{
+	const struct section_view *va = *(const struct section_view * const *) a;
+	const struct section_view *vb = *(const struct section_view * const *) b;
+
+	return (int) section_view_section_number(va) - (int) section_view_section_number(vb);
+}
+
+struct si_table *si_table_decode(const struct section_view *sections, int count)
+{
+	const struct section_view *order[256];
+	const struct si_layout *layout;
+	struct si_build b;
+	struct si_table *table;
+	size_t entries_offset, descriptor_offset, bytes_offset;
+	int type;
+	int used = 0;
+	int i;
+
+	if ((count < 1) || !section_view_is_ext(&sections[0]) ||
+	    ((type = si_table_type(section_view_table_id(&sections[0]))) < 0))
+		goto invalid;
+	layout = &layouts[type];
+
+	// one of each section number, in order
+	for (i = 0; i < count; i++) {
+		const struct section_view *v = &sections[i];
+		int j;
+
+		if (!section_view_is_ext(v) ||
+		    (v->len < (SECTION_VIEW_EXT_HDR_SIZE + CRC_SIZE)) ||
+		    (section_view_table_id(v) != section_view_table_id(&sections[0])) ||
+		    (section_view_table_id_ext(v) != section_view_table_id_ext(&sections[0])) ||
+		    (section_view_version_number(v) != section_view_version_number(&sections[0])))
+			goto invalid;
+		for (j = 0; j < used; j++) {
+			if (section_view_section_number(order[j]) == section_view_section_number(v))
+				break;
+		}
+		if ((j == used) && (used < 256))
+			order[used++] = v;
+	}
+	qsort(order, used, sizeof(order[0]), si_section_number_cmp);
+
+	// count, to size the allocation
+	memset(&b, 0, sizeof(b));
+	for (i = 0; i < used; i++) {
+		const uint8_t *data = section_view_ext_data(order[i]);
+		size_t len = section_view_ext_data_length(order[i]);
+
+		if ((si_section_top(&b, layout, data, len, 1) < 0) ||
+		    si_section_entries(&b, layout, data, len))
+			goto invalid;
+	}
+
+	entries_offset = ALIGN(sizeof(struct si_table));
+	descriptor_offset = entries_offset + ALIGN(b.entries * layout->entry_struct);
+	bytes_offset = descriptor_offset + ALIGN(b.descriptors * sizeof(struct descriptor *));
+	if ((table = calloc(1, bytes_offset + b.descriptor_bytes)) == NULL) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	table->type = type;
+	table->table_id = section_view_table_id(order[0]);
+	table->table_id_ext = section_view_table_id_ext(order[0]);
+	table->version_number = section_view_version_number(order[0]);
+	table->last_section_number = section_view_last_section_number(order[0]);
+	table->sections = used;
+	table->count = b.entries;
+	table->descriptor_count = b.descriptors;
+	table->descriptor = (const struct descriptor **) ((uint8_t *) table + descriptor_offset);
+	table->size = bytes_offset + b.descriptor_bytes;
+	switch(type) {
+	case SI_TABLE_PAT:
+		table->programs = (struct si_pat_program *) ((uint8_t *) table + entries_offset);
+		table->transport_stream_id = table->table_id_ext;
+		break;
+	case SI_TABLE_PMT:
+		table->streams = (struct si_pmt_stream *) ((uint8_t *) table + entries_offset);
+		table->pcr_pid = ucsi_get16(section_view_ext_data(order[0])) & 0x1fff;
+		break;
+	case SI_TABLE_SDT:
+		table->services = (struct si_sdt_service *) ((uint8_t *) table + entries_offset);
+		table->transport_stream_id = table->table_id_ext;
+		table->original_network_id = ucsi_get16(section_view_ext_data(order[0]));
+		break;
+	case SI_TABLE_NIT:
+	case SI_TABLE_BAT:
+		table->transports = (struct si_transport *) ((uint8_t *) table + entries_offset);
+		break;
+	case SI_TABLE_EIT:
+		table->events = (struct si_eit_event *) ((uint8_t *) table + entries_offset);
+		table->transport_stream_id = ucsi_get16(section_view_ext_data(order[0]));
+		table->original_network_id = ucsi_get16(section_view_ext_data(order[0]) + 2);
+		break;
+	}
+
+	// fill: the table level loops of all sections first, so they are one slice
+	memset(&b, 0, sizeof(b));
+	b.table = table;
+	b.bytes = (uint8_t *) table + bytes_offset;
+	memset(&table->descriptors, 0, sizeof(struct si_loop));
+	for (i = 0; i < used; i++) {
+		const uint8_t *data = section_view_ext_data(order[i]);
+		struct si_loop loop;
+		int j;
+
+		if (!layout->top_loop)
+			break;
+		si_loop(&b, data + layout->fixed + 2,
+			ucsi_get16(data + layout->fixed) & 0x0fff, &loop);
+		if (i == 0)
+			table->descriptors.first = loop.first;
+		table->descriptors.count += loop.count;
+		for (j = 0; j < (256 / 32); j++)
+			table->descriptors.present[j] |= loop.present[j];
+	}
+	for (i = 0; i < used; i++)
+		si_section_entries(&b, layout, section_view_ext_data(order[i]),
+				   section_view_ext_data_length(order[i]));
+
+	return table;
+
+invalid:
+	errno = EINVAL;
+	return NULL;
+}
+
+#define SI_REBASE(ptr, delta) \
+	do { if (ptr) (ptr) = (void *) ((uintptr_t) (ptr) + (delta)); } while(0)
+
+void si_table_rebase(struct si_table *table, const void *old_base, const void *new_base)
+{
+	uintptr_t delta = (uintptr_t) new_base - (uintptr_t) old_base;
+	const struct descriptor **descriptor;
+	uint32_t i;
+
+	SI_REBASE(table->programs, delta);
+	SI_REBASE(table->streams, delta);
+	SI_REBASE(table->services, delta);
+	SI_REBASE(table->transports, delta);
+	SI_REBASE(table->events, delta);
+	SI_REBASE(table->descriptor, delta);
+
+	// the array itself is in the copy, wherever its pointer now says
+	descriptor = (const struct descriptor **)
+		((uintptr_t) table + (uintptr_t) table->descriptor - (uintptr_t) new_base);
+	for (i = 0; i < table->descriptor_count; i++)
+		SI_REBASE(descriptor[i], delta);
+}
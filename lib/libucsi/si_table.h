@@ -0,0 +1,225 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_SI_TABLE_H
+#define _UCSI_SI_TABLE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <libucsi/descriptor.h>
+#include <libucsi/section_view.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * A whole table (every section of one PAT, PMT, SDT, NIT, BAT or EIT
+ * version) decoded into flat arrays, in one allocation.
+ *
+ * The entries of all the sections (programs, streams, services, transport
+ * streams or events) are in one array, in section order. Their descriptors
+ * are copied into the table too, still in wire order, and every loop is
+ * indexed: si_loop_has() answers from a bitmap, and the descriptors of a
+ * loop are an array slice. Nothing refers back to the sections, which may
+ * be freed once the table is built; the table itself is freed with free().
+ *
+ * The descriptors are never byte swapped. They may be read directly, or
+ * passed (once) to a *_descriptor_codec(), which swaps them in place.
+ */
+
+enum si_table_type {
+	SI_TABLE_PAT,
+	SI_TABLE_PMT,
+	SI_TABLE_SDT,
+	SI_TABLE_NIT,			/* actual or other */
+	SI_TABLE_BAT,
+	SI_TABLE_EIT,			/* p/f or schedule, actual or other */
+};
+
+/**
+ * A descriptor loop: descriptors[first] to descriptors[first + count - 1]
+ * of the table.
+ */
+struct si_loop {
+	uint32_t first;
+	uint32_t count;
+	uint32_t present[256 / 32];	/* bit set for each tag in the loop */
+};
+
+struct si_pat_program {
+	uint16_t program_number;	/* 0 => network PID */
+	uint16_t pid;
+};
+
+struct si_pmt_stream {
+	uint8_t stream_type;
+	uint16_t pid;
+	struct si_loop descriptors;
+};
+
+struct si_sdt_service {
+	uint16_t service_id;
+	uint8_t eit_schedule;
+	uint8_t eit_present_following;
+	uint8_t running_status;
+	uint8_t free_ca_mode;
+	struct si_loop descriptors;
+};
+
+/**
+ * A transport stream of a NIT or BAT.
+ */
+struct si_transport {
+	uint16_t transport_stream_id;
+	uint16_t original_network_id;
+	struct si_loop descriptors;
+};
+
+struct si_eit_event {
+	uint16_t event_id;
+	time_t start_time;		/* -1 if undefined */
+	uint32_t duration;		/* in seconds */
+	uint8_t running_status;
+	uint8_t free_ca_mode;
+	struct si_loop descriptors;
+};
+
+struct si_table {
+	enum si_table_type type;
+	uint8_t table_id;
+	uint16_t table_id_ext;
+	uint8_t version_number;
+	uint8_t last_section_number;
+	int sections;			/* sections it was built from */
+
+	/* from the headers, where the table has them */
+	uint16_t transport_stream_id;	/* PAT, SDT, EIT */
+	uint16_t original_network_id;	/* SDT, EIT */
+	uint16_t pcr_pid;		/* PMT */
+
+	/* PMT program info, or NIT network / BAT bouquet descriptors */
+	struct si_loop descriptors;
+
+	/* entries: the member for the table's type is set, the others NULL */
+	uint32_t count;
+	struct si_pat_program *programs;
+	struct si_pmt_stream *streams;
+	struct si_sdt_service *services;
+	struct si_transport *transports;
+	struct si_eit_event *events;
+
+	uint32_t descriptor_count;
+	const struct descriptor **descriptor;
+
+	size_t size;			/* of the allocation, this included */
+};
+
+/**
+ * Decode a complete table. The sections may be in any order; repeats of a
+ * section number are ignored. They must all have the same table_id,
+ * table_id_extension and version, and are not CRC checked here.
+ *
+ * @param sections Views of the sections, as from section_view_init().
+ * @param count Number of sections.
+ * @return The table, to be freed with free(), or NULL with errno EINVAL if
+ * the sections are not of one supported table or are malformed, or ENOMEM.
+ */
+extern struct si_table *si_table_decode(const struct section_view *sections, int count);
+
+/**
+ * Move the pointers of a table which has been copied whole (size bytes).
+ * With a new_base of NULL they become offsets, so the copy may be kept
+ * somewhere mapped at different addresses, e.g. in shared memory; a copy
+ * of that is made usable with an old_base of NULL and a new_base of itself.
+ *
+ * @param table The copy.
+ * @param old_base Address its pointers are into: the original, or NULL.
+ * @param new_base Address they are to be into: the copy, or NULL.
+ */
+extern void si_table_rebase(struct si_table *table, const void *old_base, const void *new_base);
+
+/**
+ * Check if a loop holds a descriptor with a tag.
+ *
+ * @param loop The loop.
+ * @param tag Descriptor tag.
+ * @return 1 if it does, 0 if not.
+ */
+static inline int si_loop_has(const struct si_loop *loop, uint8_t tag)
+{
+	return (loop->present[tag >> 5] >> (tag & 31)) & 1;
+}
+
+/**
+ * Retrieve a descriptor of a loop by its position in the loop.
+ *
+ * @param table The table.
+ * @param loop The loop.
+ * @param i Position (0 to loop->count - 1).
+ * @return The descriptor.
+ */
+static inline const struct descriptor *
+	si_loop_descriptor(const struct si_table *table, const struct si_loop *loop, uint32_t i)
+{
+	return table->descriptor[loop->first + i];
+}
+
+/**
+ * Retrieve the first descriptor with a tag in a loop.
+ *
+ * @param table The table.
+ * @param loop The loop.
+ * @param tag Descriptor tag.
+ * @return The descriptor, or NULL if there is none.
+ */
+static inline const struct descriptor *
+	si_loop_find(const struct si_table *table, const struct si_loop *loop, uint8_t tag)
+{
+	uint32_t i;
+
+	if (!si_loop_has(loop, tag))
+		return NULL;
+	for (i = 0; i < loop->count; i++) {
+		if (table->descriptor[loop->first + i]->tag == tag)
+			return table->descriptor[loop->first + i];
+	}
+	return NULL;
+}
+
+/**
+ * Iterator for the descriptors of a loop.
+ *
+ * @param table The table.
+ * @param loop Pointer to the loop.
+ * @param i Variable holding the position in the loop.
+ * @param pos Variable holding a const pointer to the current descriptor.
+ */
+#define si_loop_for_each(table, loop, i, pos) \
+	for ((i) = 0; \
+	     ((i) < (loop)->count) && ((pos) = si_loop_descriptor(table, loop, i)); \
+	     (i)++)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,369 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <libucsi/mpeg/types.h>
+#include "startcode.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define STARTCODE_HAVE_SSE2 1
+#define STARTCODE_HAVE_AVX2 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define STARTCODE_HAVE_NEON 1
+#endif
+
+#define STARTCODE_CARRY (STARTCODE_NEED - 1)
+
+typedef int (*startcode_fn)(const uint8_t *buf, int len);
+
+static int startcode_resolve(const uint8_t *buf, int len);
+
+static startcode_fn startcode_impl_fn = startcode_resolve;
+static enum startcode_impl startcode_impl_cur = startcode_impl_auto;
+
+static int startcode_scalar(const uint8_t *buf, int len)
+{
+	int i;
+
+	// step by the position of the third byte: anything but 00 or 01 there
+	// rules out the two prefixes it could belong to
+	for(i = 2; i < len; ) {
+		if (buf[i] > 1)
+			i += 3;
+		else if (buf[i] == 0)
+			i++;
+		else if (buf[i-1] || buf[i-2])
+			i += 3;
+		else
+			return i - 2;
+	}
+
+	return -1;
+}
+
+/*
+ * The vector versions compare a block, and the same block one and two bytes
+ * on, so bit k of the mask says whether a prefix starts at byte k. The loads
+ * reach two bytes past the block, which is why the loop stops early and
+ * leaves the end to the scalar one.
+ */
+
+#ifdef STARTCODE_HAVE_SSE2
+
+__attribute__((target("sse2")))
+static int startcode_sse2(const uint8_t *buf, int len)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	int i, found;
+
+	for(i = 0; i + 16 + 2 <= len; i += 16) {
+		__m128i b0 = _mm_loadu_si128((const __m128i *) (buf + i));
+		__m128i b1 = _mm_loadu_si128((const __m128i *) (buf + i + 1));
+		__m128i b2 = _mm_loadu_si128((const __m128i *) (buf + i + 2));
+		unsigned int mask;
+
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero),
+								     _mm_cmpeq_epi8(b1, zero)),
+						       _mm_cmpeq_epi8(b2, one)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+
+	if ((found = startcode_scalar(buf + i, len - i)) < 0)
+		return -1;
+	return i + found;
+}
+
+static int startcode_sse2_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+}
+
+#endif
+
+#ifdef STARTCODE_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static int startcode_avx2(const uint8_t *buf, int len)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i one = _mm256_set1_epi8(1);
+	int i, found;
+
+	for(i = 0; i + 32 + 2 <= len; i += 32) {
+		__m256i b0 = _mm256_loadu_si256((const __m256i *) (buf + i));
+		__m256i b1 = _mm256_loadu_si256((const __m256i *) (buf + i + 1));
+		__m256i b2 = _mm256_loadu_si256((const __m256i *) (buf + i + 2));
+		unsigned int mask;
+
+		mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(b0, zero),
+									      _mm256_cmpeq_epi8(b1, zero)),
+							     _mm256_cmpeq_epi8(b2, one)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+
+	if ((found = startcode_scalar(buf + i, len - i)) < 0)
+		return -1;
+	return i + found;
+}
+
+static int startcode_avx2_supported(void)
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+#ifdef STARTCODE_HAVE_NEON
+
+static int startcode_neon(const uint8_t *buf, int len)
+{
+	const uint8x16_t one = vdupq_n_u8(1);
+	int i, found;
+
+	for(i = 0; i + 16 + 2 <= len; i += 16) {
+		uint8x16_t m = vandq_u8(vandq_u8(vceqzq_u8(vld1q_u8(buf + i)),
+						 vceqzq_u8(vld1q_u8(buf + i + 1))),
+					vceqq_u8(vld1q_u8(buf + i + 2), one));
+		// narrow to four bits a byte, there being no movemask
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+
+		if (mask)
+			return i + (__builtin_ctzll(mask) >> 2);
+	}
+
+	if ((found = startcode_scalar(buf + i, len - i)) < 0)
+		return -1;
+	return i + found;
+}
+
+#endif
+
+__attribute__((constructor))
+static void startcode_init(void)
+{
+	if (startcode_impl_cur == startcode_impl_auto)
+		startcode_select(startcode_impl_auto);
+}
+
+static int startcode_resolve(const uint8_t *buf, int len)
+{
+	startcode_init();
+	return startcode_impl_fn(buf, len);
+}
+
+int startcode_find(const uint8_t *buf, int len)
+{
+	return startcode_impl_fn(buf, len);
+}
+
+int startcode_select(enum startcode_impl impl)
+{
+	switch(impl) {
+	case startcode_impl_auto:
+#ifdef STARTCODE_HAVE_AVX2
+		if (startcode_avx2_supported())
+			return startcode_select(startcode_impl_avx2);
+#endif
+#ifdef STARTCODE_HAVE_SSE2
+		if (startcode_sse2_supported())
+			return startcode_select(startcode_impl_sse2);
+#endif
+#ifdef STARTCODE_HAVE_NEON
+		return startcode_select(startcode_impl_neon);
+#endif
+		return startcode_select(startcode_impl_scalar);
+
+	case startcode_impl_scalar:
+		startcode_impl_fn = startcode_scalar;
+		break;
+
+	case startcode_impl_sse2:
+#ifdef STARTCODE_HAVE_SSE2
+		if (!startcode_sse2_supported())
+			return -1;
+		startcode_impl_fn = startcode_sse2;
+		break;
+#else
+		return -1;
+#endif
+
+	case startcode_impl_avx2:
+#ifdef STARTCODE_HAVE_AVX2
+		if (!startcode_avx2_supported())
+			return -1;
+		startcode_impl_fn = startcode_avx2;
+		break;
+#else
+		return -1;
+#endif
+
+	case startcode_impl_neon:
+#ifdef STARTCODE_HAVE_NEON
+		startcode_impl_fn = startcode_neon;
+		break;
+#else
+		return -1;
+#endif
+
+	default:
+		return -1;
+	}
+
+	startcode_impl_cur = impl;
+	return 0;
+}
+
+enum startcode_impl startcode_selected(void)
+{
+	startcode_init();
+	return startcode_impl_cur;
+}
+
+int startcode_codec(int stream_type)
+{
+	switch(stream_type) {
+	case MPEG_STREAM_TYPE_ISO11172_VIDEO:
+	case MPEG_STREAM_TYPE_ISO13818_2_VIDEO:
+		return startcode_codec_mpeg2;
+	case MPEG_STREAM_TYPE_ISO14496_10_VIDEO:
+		return startcode_codec_h264;
+	case MPEG_STREAM_TYPE_ISO23008_2_VIDEO:
+		return startcode_codec_hevc;
+	}
+
+	return -1;
+}
+
+/**
+ * What a unit says about the PES; buf is its prefix and the bytes after it.
+ */
+static int startcode_classify(int codec, const uint8_t *buf)
+{
+	int type;
+
+	switch(codec) {
+	case startcode_codec_mpeg2:
+		// a sequence header, or a picture with its picture_coding_type
+		if (buf[3] == 0xb3)
+			return STARTCODE_PARAMS;
+		if (buf[3] == 0x00) {
+			switch((buf[5] >> 3) & 7) {
+			case 1:
+				return STARTCODE_PICTURE|STARTCODE_KEYFRAME;
+			case 3:
+				return STARTCODE_PICTURE|STARTCODE_DISPOSABLE;
+			}
+			return STARTCODE_PICTURE;
+		}
+		break;
+
+	case startcode_codec_h264:
+		switch(buf[3] & 0x1f) {
+		case 1:
+		case 2:
+		case 3:
+		case 4:
+			return (buf[3] & 0x60) ? STARTCODE_PICTURE :
+						 STARTCODE_PICTURE|STARTCODE_DISPOSABLE;
+		case 5:
+			return STARTCODE_PICTURE|STARTCODE_KEYFRAME;
+		case 7:
+			return STARTCODE_PARAMS;
+		}
+		break;
+
+	case startcode_codec_hevc:
+		// VCL units are below 32, IRAP ones (reserved or not) 16 to 23
+		type = (buf[3] >> 1) & 0x3f;
+		if ((type >= 16) && (type <= 23))
+			return STARTCODE_PICTURE|STARTCODE_KEYFRAME;
+		if (type < 32)
+			return STARTCODE_PICTURE;
+		if ((type == 32) || (type == 33))
+			return STARTCODE_PARAMS;
+		break;
+	}
+
+	return 0;
+}
+
+/**
+ * Classify the units whose STARTCODE_NEED bytes are all in a buffer.
+ */
+static void startcode_scan_block(struct startcode_scanner *sc, const uint8_t *buf, int len)
+{
+	int pos = 0;
+	int found;
+
+	while ((len - pos) >= STARTCODE_NEED) {
+		found = startcode_impl_fn(buf + pos, len - pos - (STARTCODE_NEED - 3));
+		if (found < 0)
+			return;
+		pos += found;
+		sc->flags |= startcode_classify(sc->codec, buf + pos);
+		if (sc->flags & STARTCODE_PICTURE)
+			return;
+		pos += 3;
+	}
+}
+
+int startcode_scan(struct startcode_scanner *sc, const uint8_t *buf, int len)
+{
+	uint8_t tmp[STARTCODE_CARRY * 2];
+	int more, total;
+
+	if ((sc->codec < 0) || (sc->flags & STARTCODE_PICTURE) || (len <= 0))
+		return sc->flags;
+
+	// units starting in the carry, completed by the start of this piece
+	if (sc->carry_len) {
+		more = (len < STARTCODE_CARRY) ? len : STARTCODE_CARRY;
+		memcpy(tmp, sc->carry, sc->carry_len);
+		memcpy(tmp + sc->carry_len, buf, more);
+		total = sc->carry_len + more;
+		startcode_scan_block(sc, tmp, total);
+		if (sc->flags & STARTCODE_PICTURE)
+			return sc->flags;
+
+		if (len < STARTCODE_CARRY) {
+			sc->carry_len = (total < STARTCODE_CARRY) ? total : STARTCODE_CARRY;
+			memcpy(sc->carry, tmp + total - sc->carry_len, sc->carry_len);
+			return sc->flags;
+		}
+	} else if (len < STARTCODE_CARRY) {
+		memcpy(sc->carry, buf, len);
+		sc->carry_len = len;
+		return sc->flags;
+	}
+
+	startcode_scan_block(sc, buf, len);
+	memcpy(sc->carry, buf + len - STARTCODE_CARRY, STARTCODE_CARRY);
+	sc->carry_len = STARTCODE_CARRY;
+
+	return sc->flags;
+}
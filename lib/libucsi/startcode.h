@@ -0,0 +1,144 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_STARTCODE_H
+#define _UCSI_STARTCODE_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+
+/**
+ * Video elementary streams understood by the scanner.
+ */
+enum startcode_codec {
+	startcode_codec_mpeg2,		/* ISO 11172-2 and 13818-2 */
+	startcode_codec_h264,		/* ISO 14496-10 */
+	startcode_codec_hevc,		/* ISO 23008-2 */
+};
+
+/**
+ * What the scanner has found in a PES packet so far.
+ */
+#define STARTCODE_PICTURE	0x01	/* the first picture (or slice) has been seen */
+#define STARTCODE_KEYFRAME	0x02	/* ... and it is an I picture, IDR or IRAP picture */
+#define STARTCODE_PARAMS	0x04	/* a sequence header, SPS or VPS came before it */
+#define STARTCODE_DISPOSABLE	0x08	/* the picture is a reference for no other: an
+					   MPEG-2 B picture or H.264 nal_ref_idc 0 */
+
+/**
+ * Bytes from the start of the 00 00 01 prefix needed to classify a unit.
+ */
+#define STARTCODE_NEED 6
+
+/**
+ * Follows the start codes of one video PES packet, whose payload arrives in
+ * pieces (normally one per transport packet), until its first picture is
+ * found. A start code split between two pieces is found as if the payload
+ * were contiguous.
+ */
+struct startcode_scanner {
+	int codec;			/* enum startcode_codec, -1 => don't scan */
+	int flags;			/* STARTCODE_* */
+	int carry_len;
+	uint8_t carry[STARTCODE_NEED - 1];	/* the unscanned end of the last piece */
+};
+
+/**
+ * Implementations available for startcode_find().
+ */
+enum startcode_impl {
+	startcode_impl_auto,		/* best implementation supported by this CPU */
+	startcode_impl_scalar,		/* one byte at a time */
+	startcode_impl_sse2,		/* 16 bytes at a time (x86) */
+	startcode_impl_avx2,		/* 32 bytes at a time (x86) */
+	startcode_impl_neon,		/* 16 bytes at a time (ARMv8) */
+};
+
+/**
+ * Map an MPEG stream_type to the codec to scan it as.
+ *
+ * @param stream_type One of the MPEG_STREAM_TYPE_* values.
+ * @return One of enum startcode_codec, or -1 if it isn't a video stream known here.
+ */
+extern int startcode_codec(int stream_type);
+
+/**
+ * Find the first 00 00 01 start code prefix lying wholly within a buffer,
+ * using the fastest available implementation.
+ *
+ * @param buf Buffer to search.
+ * @param len Its length.
+ * @return Offset of the first zero byte of the prefix, or -1 if there is none.
+ */
+extern int startcode_find(const uint8_t *buf, int len);
+
+/**
+ * Start scanning a PES packet.
+ *
+ * @param sc The scanner.
+ * @param codec One of enum startcode_codec, or -1 to find nothing.
+ */
+static inline void startcode_scanner_init(struct startcode_scanner *sc, int codec)
+{
+	sc->codec = codec;
+	sc->flags = 0;
+	sc->carry_len = 0;
+}
+
+/**
+ * Scan the next piece of the PES packet's elementary stream payload (its
+ * PES header already skipped). Once STARTCODE_PICTURE is set nothing more is
+ * looked at, so this is cheap to keep calling.
+ *
+ * A unit whose start code is in the last STARTCODE_NEED - 1 bytes of the
+ * pieces seen so far is only classified once the bytes after it arrive.
+ *
+ * @param sc The scanner.
+ * @param buf The piece.
+ * @param len Its length.
+ * @return STARTCODE_* found so far.
+ */
+extern int startcode_scan(struct startcode_scanner *sc, const uint8_t *buf, int len);
+
+/**
+ * Force the implementation used by startcode_find(). Mainly useful for
+ * testing and benchmarking - the best one is chosen automatically at startup.
+ *
+ * @param impl One of enum startcode_impl.
+ * @return 0 on success, or -1 if the implementation is not supported here.
+ */
+extern int startcode_select(enum startcode_impl impl);
+
+/**
+ * Retrieve the implementation currently used by startcode_find().
+ *
+ * @return One of enum startcode_impl (never startcode_impl_auto).
+ */
+extern enum startcode_impl startcode_selected(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libdvbmisc/dvbstats.h>
+#include <libdvbmisc/dvbprobe.h>
+#include "stats.h"
+
+static const char * const ucsi_stats_names[] = {
+	"packets",
+	"sections",
+	"ts_errors",
+	"crc_errors",
+	"section_bytes",
+};
+
+DVBSTATS_SET(ucsi_stats, "libucsi", ucsi_stats_names, UCSI_STATS_COUNTERS, UCSI_STATS_HISTOGRAMS);
+
+static void __attribute__((destructor)) ucsi_stats_exit(void)
+{
+	dvbstats_dump_at_exit(&ucsi_stats);
+}
+
+void ucsi_stats_crc_error(void)
+{
+	dvbstats_inc(&ucsi_stats, UCSI_STATS_CRC_ERRORS);
+	DVBPROBE(section_crc_fail);
+}
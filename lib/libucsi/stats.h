@@ -0,0 +1,61 @@
+/*
+ * section and descriptor parser
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef _UCSI_STATS_H
+#define _UCSI_STATS_H 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+struct dvbstats_set;
+
+/**
+ * The libucsi performance counters. Dump them with dvbstats_dump() from
+ * libdvbmisc/dvbstats.h, or have them dumped at exit by setting DVB_STATS in
+ * the environment.
+ */
+extern struct dvbstats_set ucsi_stats;
+
+enum ucsi_stats_counter {
+	UCSI_STATS_PACKETS,		/* TS packets given to a section_reasm */
+	UCSI_STATS_SECTIONS,		/* sections a section_reasm delivered */
+	UCSI_STATS_TS_ERRORS,		/* packets a section_reasm dropped for errors */
+	UCSI_STATS_CRC_ERRORS,		/* failed section CRC checks */
+	UCSI_STATS_COUNTERS
+};
+
+enum ucsi_stats_histogram {
+	UCSI_STATS_SECTION_BYTES,	/* sizes of the sections delivered */
+	UCSI_STATS_HISTOGRAMS
+};
+
+/**
+ * Count a failed CRC check. For the inline checks in section.h and
+ * section_view.h.
+ */
+extern void ucsi_stats_crc_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
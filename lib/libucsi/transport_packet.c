@@ -18,8 +18,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
  */
 
+#include <string.h>
 #include "transport_packet.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define CONTINUITY_VALID 0x80
 #define CONTINUITY_DUPESEEN 0x40
 
@@ -254,3 +259,151 @@ int transport_packet_continuity_check(struct transport_packet *pkt,
 	/* continuity error */
 	return -1;
 }
+
+static inline uint32_t transport_packet_header(uint8_t *buf)
+{
+	return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+	       ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+#if defined(__SSE2__)
+/*
+ * Decode the headers of four packets at a time. Returns nonzero if all four
+ * had a valid sync byte, in which case their fields have been stored at
+ * index idx onwards.
+ */
+static inline int transport_packet_batch_extract4(uint8_t *buf,
+						  struct transport_packet_batch *batch,
+						  int idx)
+{
+	__m128i hdr = _mm_set_epi32(transport_packet_header(buf + (3 * TRANSPORT_PACKET_LENGTH)),
+				    transport_packet_header(buf + (2 * TRANSPORT_PACKET_LENGTH)),
+				    transport_packet_header(buf + TRANSPORT_PACKET_LENGTH),
+				    transport_packet_header(buf));
+	__m128i sync = _mm_cmpeq_epi32(_mm_srli_epi32(hdr, 24),
+				       _mm_set1_epi32(TRANSPORT_PACKET_SYNC));
+	__m128i mask1 = _mm_set1_epi32(0x01);
+	__m128i mask2 = _mm_set1_epi32(0x03);
+	__m128i pid, pusi, tei, scr, afc, cc;
+	__m128i tmp;
+	uint32_t out[4];
+
+	if (_mm_movemask_epi8(sync) != 0xffff)
+		return 0;
+
+	/* PIDs fit in 13 bits, so signed saturation is harmless */
+	pid = _mm_and_si128(_mm_srli_epi32(hdr, 8), _mm_set1_epi32(0x1fff));
+	_mm_storel_epi64((__m128i *) (batch->pid + idx), _mm_packs_epi32(pid, pid));
+
+	tei = _mm_and_si128(_mm_srli_epi32(hdr, 23), mask1);
+	pusi = _mm_and_si128(_mm_srli_epi32(hdr, 22), mask1);
+	scr = _mm_and_si128(_mm_srli_epi32(hdr, 6), mask2);
+	afc = _mm_and_si128(_mm_srli_epi32(hdr, 4), mask2);
+	cc = _mm_and_si128(hdr, _mm_set1_epi32(0x0f));
+
+	/* narrow each 32 bit lane to a byte and store four at a time */
+	tmp = _mm_packs_epi32(tei, pusi);
+	tmp = _mm_packus_epi16(tmp, tmp);
+	_mm_storel_epi64((__m128i *) out, tmp);
+	memcpy(batch->transport_error + idx, &out[0], 4);
+	memcpy(batch->payload_unit_start + idx, &out[1], 4);
+
+	tmp = _mm_packs_epi32(scr, afc);
+	tmp = _mm_packus_epi16(tmp, _mm_packs_epi32(cc, cc));
+	_mm_storeu_si128((__m128i *) out, tmp);
+	memcpy(batch->scrambling + idx, &out[0], 4);
+	memcpy(batch->adaptation + idx, &out[1], 4);
+	memcpy(batch->continuity_counter + idx, &out[2], 4);
+
+	return 1;
+}
+#endif
+
+static inline int transport_packet_batch_extract1(uint8_t *buf,
+						  struct transport_packet_batch *batch,
+						  int idx)
+{
+	uint32_t hdr = transport_packet_header(buf);
+
+	if ((hdr >> 24) != TRANSPORT_PACKET_SYNC)
+		return 0;
+
+	batch->pid[idx] = (hdr >> 8) & 0x1fff;
+	batch->transport_error[idx] = (hdr >> 23) & 1;
+	batch->payload_unit_start[idx] = (hdr >> 22) & 1;
+	batch->scrambling[idx] = (hdr >> 6) & 3;
+	batch->adaptation[idx] = (hdr >> 4) & 3;
+	batch->continuity_counter[idx] = hdr & 0x0f;
+
+	return 1;
+}
+
+int transport_packet_batch_extract(uint8_t *buf, int len,
+				   struct transport_packet_batch *batch)
+{
+	int max = len / TRANSPORT_PACKET_LENGTH;
+	int count = 0;
+	int i;
+
+	if (max > TRANSPORT_BATCH_MAX)
+		max = TRANSPORT_BATCH_MAX;
+
+	/* pass 1: the fixed four byte headers */
+#if defined(__SSE2__)
+	while ((count + 4) <= max) {
+		if (!transport_packet_batch_extract4(buf + (count * TRANSPORT_PACKET_LENGTH),
+						     batch, count))
+			break;
+		count += 4;
+	}
+#endif
+	while (count < max) {
+		if (!transport_packet_batch_extract1(buf + (count * TRANSPORT_PACKET_LENGTH),
+						     batch, count))
+			break;
+		count++;
+	}
+
+	/* pass 2: adaptation field length/flags and payload offsets */
+	for(i=0; i < count; i++) {
+		uint8_t *pkt = buf + (i * TRANSPORT_PACKET_LENGTH);
+		int afc = batch->adaptation[i];
+		int off = sizeof(struct transport_packet);
+
+		batch->adaptation_flags[i] = 0;
+		if (afc & 2) {
+			int adaplength = pkt[4];
+
+			off += 1 + adaplength;
+			if (off > TRANSPORT_PACKET_LENGTH) {
+				batch->payload_offset[i] = 0;
+				continue;
+			}
+			if (adaplength)
+				batch->adaptation_flags[i] = pkt[5];
+		}
+
+		if ((afc & 1) && (off < TRANSPORT_PACKET_LENGTH))
+			batch->payload_offset[i] = off;
+		else
+			batch->payload_offset[i] = 0;
+	}
+
+	batch->count = count;
+	return count * TRANSPORT_PACKET_LENGTH;
+}
+
+int transport_packet_find_sync(uint8_t *buf, int len)
+{
+	uint8_t *pos = buf;
+	uint8_t *end = buf + len;
+
+	while((pos = memchr(pos, TRANSPORT_PACKET_SYNC, end - pos)) != NULL) {
+		if (((pos + TRANSPORT_PACKET_LENGTH) >= end) ||
+		    (pos[TRANSPORT_PACKET_LENGTH] == TRANSPORT_PACKET_SYNC))
+			return pos - buf;
+		pos++;
+	}
+
+	return -1;
+}
@@ -33,6 +33,7 @@ extern "C"
 #define TRANSPORT_PACKET_SYNC   0x47
 #define TRANSPORT_MAX_PIDS      0x2000
 #define TRANSPORT_NULL_PID      0x1fff
+#define TRANSPORT_BATCH_MAX     512
 
 
 /**
@@ -131,6 +132,23 @@ struct transport_values {
 	uint64_t dts_next_au;
 };
 
+/**
+ * Structure-of-arrays holding the header fields of a run of transport packets,
+ * as filled in by transport_packet_batch_extract(). Entry i of each array
+ * describes the i'th packet of the buffer.
+ */
+struct transport_packet_batch {
+	int count;					/* number of packets extracted */
+	uint16_t pid[TRANSPORT_BATCH_MAX];
+	uint8_t payload_unit_start[TRANSPORT_BATCH_MAX];
+	uint8_t transport_error[TRANSPORT_BATCH_MAX];
+	uint8_t scrambling[TRANSPORT_BATCH_MAX];	/* enum transport_scrambling_control */
+	uint8_t adaptation[TRANSPORT_BATCH_MAX];	/* enum transport_adaptation_field_control */
+	uint8_t adaptation_flags[TRANSPORT_BATCH_MAX];	/* enum transport_adaptation_flags */
+	uint8_t continuity_counter[TRANSPORT_BATCH_MAX];
+	uint8_t payload_offset[TRANSPORT_BATCH_MAX];	/* 0 => no payload, or bad adaptation field */
+};
+
 /**
  * Extract the PID from a transport packet.
  *
@@ -174,6 +192,54 @@ static inline struct transport_packet *transport_packet_init(unsigned char *buf)
 extern int transport_packet_continuity_check(struct transport_packet *pkt,
 					     int discontinuity_indicator, unsigned char *cstate);
 
+/**
+ * Renumber the continuity counters of consecutive packets of one PID, as when
+ * resending a cached packetised section. Packets without a payload keep
+ * their counter, as the counter does not advance for them.
+ *
+ * @param buf The packets (188 bytes each).
+ * @param count Number of packets.
+ * @param cc Pointer to the next counter value; updated.
+ */
+static inline void transport_packet_set_continuity(unsigned char *buf, int count,
+						   unsigned char *cc)
+{
+	int i;
+
+	for (i = 0; i < count; i++, buf += TRANSPORT_PACKET_LENGTH) {
+		if (!(buf[3] & 0x10))
+			continue;
+		buf[3] = (buf[3] & 0xf0) | (*cc & 0x0f);
+		*cc = (*cc + 1) & 0x0f;
+	}
+}
+
+/**
+ * Classify a buffer of consecutive transport packets in one pass. Extraction
+ * stops at the end of the buffer, after TRANSPORT_BATCH_MAX packets, or at the
+ * first packet with a bad sync byte, whichever comes first. Any trailing
+ * partial packet is left unprocessed.
+ *
+ * @param buf Buffer of packets, starting on a packet boundary.
+ * @param len Length of buffer in bytes.
+ * @param batch Destination structure; batch->count is set to the number of
+ * packets extracted.
+ * @return Number of bytes consumed (batch->count * TRANSPORT_PACKET_LENGTH).
+ */
+extern int transport_packet_batch_extract(uint8_t *buf, int len,
+					  struct transport_packet_batch *batch);
+
+/**
+ * Find the next position in a buffer which looks like the start of a
+ * transport packet - that is, a sync byte which is followed by another sync
+ * byte TRANSPORT_PACKET_LENGTH bytes later (if the buffer is long enough).
+ *
+ * @param buf The buffer.
+ * @param len Length of buffer in bytes.
+ * @return Offset of the packet start, or -1 if none was found.
+ */
+extern int transport_packet_find_sync(uint8_t *buf, int len);
+
 /**
  * Extract selected fields from a transport packet.
  *
@@ -0,0 +1,502 @@
+/*
+ * fe_stress - tune several frontends at once through random channel
+ * sequences, and report how long they take to lock
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
+
+#include <libdvbapi/dvbfe.h>
+#include <libdvbsec/dvbsec_api.h>
+#include <libdvbsec/dvbsec_cfg.h>
+#include <libdvbcfg/dvbcfg_zapchannel.h>
+
+#define MAX_FRONTENDS	32
+#define MAX_CHANNELS	4096
+
+static char *usage_str =
+	"\nusage: fe_stress -c <channels.conf> [options]\n"
+	"  Tune frontends concurrently through random channels and report\n"
+	"  lock times, failure rates and ioctl latencies.\n"
+	"\n"
+	"  -c file   : zap format channel list to pick from\n"
+	"  -a a[.f]  : adapter (and frontend) to use; may be repeated (default 0.0)\n"
+	"  -n count  : tunes per frontend (default 100)\n"
+	"  -t ms     : lock timeout (default 2000)\n"
+	"  -d ms     : dwell after a lock (default 0)\n"
+	"  -s id     : SEC id to use for DVB-S (default UNIVERSAL)\n"
+	"  -S file   : SEC configuration file\n"
+	"  -R pct    : percentage of tunes forced to resend the full SEC sequence\n"
+	"              even if it hasn't changed (default 0)\n"
+	"  -r seed   : random seed (default: time)\n"
+	"  -o format : report as text, csv or json (default text)\n"
+	"  -q        : don't log each tune to stderr\n";
+
+/* a growable list of durations, in microseconds */
+struct samples {
+	int64_t *v;
+	int count;
+	int size;
+};
+
+struct frontend {
+	int adapter;
+	int frontend;
+	struct dvbfe_handle *fe;
+	struct dvbfe_info info;
+	struct dvbsec_config *sec;
+	unsigned int seed;
+	pthread_t thread;
+
+	int tunes;
+	int locked;
+	int failed_set;
+	int timed_out;
+	struct samples lock_us;		/* tune issued -> FE_HAS_LOCK */
+	struct samples set_us;		/* dvbsec_set(), SEC and FE_SET_FRONTEND */
+	struct samples status_us;	/* each FE_READ_STATUS */
+};
+
+static struct dvbcfg_zapchannel *channels;
+static int channel_count;
+static struct frontend frontends[MAX_FRONTENDS];
+static int frontend_count;
+static struct dvbsec_config sec;
+static int valid_sec;
+static int tune_count = 100;
+static int lock_timeout = 2000;
+static int dwell = 0;
+static int sec_reset_pct = 0;
+static int quiet = 0;
+static volatile sig_atomic_t interrupted;
+
+static int64_t now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+}
+
+static void samples_add(struct samples *s, int64_t v)
+{
+	if (s->count == s->size) {
+		int size = s->size ? s->size * 2 : 256;
+		int64_t *n = realloc(s->v, size * sizeof(int64_t));
+
+		if (n == NULL)
+			return;
+		s->v = n;
+		s->size = size;
+	}
+	s->v[s->count++] = v;
+}
+
+static void samples_merge(struct samples *dest, struct samples *src)
+{
+	int i;
+
+	for(i=0; i < src->count; i++)
+		samples_add(dest, src->v[i]);
+}
+
+static int cmp_int64(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *) a;
+	int64_t y = *(const int64_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+/* nearest rank; the samples must be sorted */
+static double samples_ms(struct samples *s, double pct)
+{
+	int i;
+
+	if (s->count == 0)
+		return 0;
+	i = (int) (pct / 100.0 * s->count + 0.5) - 1;
+	if (i < 0)
+		i = 0;
+	if (i >= s->count)
+		i = s->count - 1;
+	return s->v[i] / 1000.0;
+}
+
+static double samples_mean_ms(struct samples *s)
+{
+	double sum = 0;
+	int i;
+
+	for(i=0; i < s->count; i++)
+		sum += s->v[i];
+	return s->count ? sum / s->count / 1000.0 : 0;
+}
+
+static void sighandler(int sig)
+{
+	(void) sig;
+	interrupted = 1;
+}
+
+static int channel_cb(struct dvbcfg_zapchannel *channel, void *private_data)
+{
+	(void) private_data;
+
+	if (channel_count == MAX_CHANNELS)
+		return 1;
+	channels[channel_count++] = *channel;
+	return 0;
+}
+
+/* wait for a lock, timing each status read */
+static int wait_lock(struct frontend *f, int64_t start)
+{
+	struct dvbfe_info result;
+	int64_t t;
+
+	while (!interrupted) {
+		t = now_us();
+		memset(&result, 0, sizeof(result));
+		if (dvbfe_get_info(f->fe, DVBFE_INFO_LOCKSTATUS, &result,
+				   DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) & DVBFE_INFO_LOCKSTATUS)
+			samples_add(&f->status_us, now_us() - t);
+
+		t = now_us();
+		if (result.lock) {
+			samples_add(&f->lock_us, t - start);
+			return 0;
+		}
+		if (t - start >= (int64_t) lock_timeout * 1000)
+			return -1;
+		usleep(10000);
+	}
+	return -1;
+}
+
+static void *frontend_thread(void *arg)
+{
+	struct frontend *f = arg;
+	struct dvbcfg_zapchannel *ch;
+	int64_t start;
+	int i, tries;
+
+	for(i=0; (i < tune_count) && !interrupted; i++) {
+		// pick a channel this frontend can receive
+		for(tries = 0; tries < 100; tries++) {
+			ch = &channels[rand_r(&f->seed) % channel_count];
+			if (ch->fe_type == f->info.type)
+				break;
+		}
+		if (tries == 100) {
+			fprintf(stderr, "adapter%i/frontend%i: no %s channels in the list\n",
+				f->adapter, f->frontend, f->info.name);
+			break;
+		}
+
+		if (f->sec && ((int) (rand_r(&f->seed) % 100) < sec_reset_pct))
+			dvbfe_get_sec_state(f->fe)->valid = 0;
+
+		f->tunes++;
+		start = now_us();
+		if (dvbsec_set(f->fe, f->sec, ch->polarization,
+			       (ch->diseqc_switch & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+			       (ch->diseqc_switch & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+			       &ch->fe_params, 0)) {
+			f->failed_set++;
+			if (!quiet)
+				fprintf(stderr, "%i.%i %s: set failed: %s\n",
+					f->adapter, f->frontend, ch->name, strerror(errno));
+			continue;
+		}
+		samples_add(&f->set_us, now_us() - start);
+
+		if (wait_lock(f, start) == 0) {
+			f->locked++;
+			if (!quiet)
+				fprintf(stderr, "%i.%i %s: locked in %.1f ms\n", f->adapter, f->frontend,
+					ch->name, f->lock_us.v[f->lock_us.count - 1] / 1000.0);
+			if (dwell)
+				usleep(dwell * 1000);
+		} else if (!interrupted) {
+			f->timed_out++;
+			if (!quiet)
+				fprintf(stderr, "%i.%i %s: no lock\n", f->adapter, f->frontend, ch->name);
+		}
+	}
+
+	return NULL;
+}
+
+static void print_text_dist(const char *what, struct samples *s)
+{
+	printf("  %-8s n=%-6i mean %8.2f  p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f ms\n",
+	       what, s->count, samples_mean_ms(s), samples_ms(s, 50), samples_ms(s, 90),
+	       samples_ms(s, 99), samples_ms(s, 100));
+}
+
+static void print_json_dist(const char *what, struct samples *s, int last)
+{
+	printf("      \"%s_ms\": { \"count\": %i, \"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, "
+	       "\"p99\": %.3f, \"max\": %.3f }%s\n",
+	       what, s->count, samples_mean_ms(s), samples_ms(s, 50), samples_ms(s, 90),
+	       samples_ms(s, 99), samples_ms(s, 100), last ? "" : ",");
+}
+
+static void print_csv_dist(struct samples *s)
+{
+	printf(",%i,%.3f,%.3f,%.3f,%.3f,%.3f", s->count, samples_mean_ms(s), samples_ms(s, 50),
+	       samples_ms(s, 90), samples_ms(s, 99), samples_ms(s, 100));
+}
+
+static void json_string(const char *s)
+{
+	putchar('"');
+	for(; *s; s++) {
+		if ((*s == '"') || (*s == '\\'))
+			putchar('\\');
+		if ((unsigned char) *s >= 0x20)
+			putchar(*s);
+	}
+	putchar('"');
+}
+
+/*
+ * One report line per frontend, then one per driver (the frontends sharing a
+ * name, all added together).
+ */
+static void report(const char *format)
+{
+	struct frontend drivers[MAX_FRONTENDS];
+	int driver_count = 0;
+	struct frontend *f;
+	int i, j;
+
+	memset(drivers, 0, sizeof(drivers));
+	for(i=0; i < frontend_count; i++) {
+		f = &frontends[i];
+		for(j=0; j < driver_count; j++)
+			if (!strcmp(drivers[j].info.name, f->info.name))
+				break;
+		if (j == driver_count) {
+			drivers[j].info = f->info;
+			drivers[j].adapter = drivers[j].frontend = -1;
+			driver_count++;
+		}
+		drivers[j].tunes += f->tunes;
+		drivers[j].locked += f->locked;
+		drivers[j].failed_set += f->failed_set;
+		drivers[j].timed_out += f->timed_out;
+		samples_merge(&drivers[j].lock_us, &f->lock_us);
+		samples_merge(&drivers[j].set_us, &f->set_us);
+		samples_merge(&drivers[j].status_us, &f->status_us);
+	}
+
+	for(i=0; i < frontend_count + driver_count; i++) {
+		f = (i < frontend_count) ? &frontends[i] : &drivers[i - frontend_count];
+		qsort(f->lock_us.v, f->lock_us.count, sizeof(int64_t), cmp_int64);
+		qsort(f->set_us.v, f->set_us.count, sizeof(int64_t), cmp_int64);
+		qsort(f->status_us.v, f->status_us.count, sizeof(int64_t), cmp_int64);
+	}
+
+	if (!strcmp(format, "json")) {
+		printf("{\n  \"lock_timeout_ms\": %i,\n  \"results\": [\n", lock_timeout);
+	} else if (!strcmp(format, "csv")) {
+		printf("scope,adapter,frontend,driver,tunes,locked,set_failed,timed_out,failure_rate");
+		for(j=0; j < 3; j++) {
+			const char *what = (j == 0) ? "lock" : (j == 1) ? "set" : "status";
+			printf(",%s_n,%s_mean_ms,%s_p50_ms,%s_p90_ms,%s_p99_ms,%s_max_ms",
+			       what, what, what, what, what, what);
+		}
+		printf("\n");
+	}
+
+	for(i=0; i < frontend_count + driver_count; i++) {
+		int is_driver = (i >= frontend_count);
+		double failure_rate;
+
+		f = is_driver ? &drivers[i - frontend_count] : &frontends[i];
+		failure_rate = f->tunes ? (double) (f->failed_set + f->timed_out) / f->tunes : 0;
+
+		if (!strcmp(format, "json")) {
+			printf("    {\n      \"scope\": \"%s\",\n", is_driver ? "driver" : "frontend");
+			if (!is_driver)
+				printf("      \"adapter\": %i,\n      \"frontend\": %i,\n",
+				       f->adapter, f->frontend);
+			printf("      \"driver\": ");
+			json_string(f->info.name);
+			printf(",\n      \"tunes\": %i,\n      \"locked\": %i,\n      \"set_failed\": %i,\n"
+			       "      \"timed_out\": %i,\n      \"failure_rate\": %.4f,\n",
+			       f->tunes, f->locked, f->failed_set, f->timed_out, failure_rate);
+			print_json_dist("lock", &f->lock_us, 0);
+			print_json_dist("set", &f->set_us, 0);
+			print_json_dist("status", &f->status_us, 1);
+			printf("    }%s\n", (i == frontend_count + driver_count - 1) ? "" : ",");
+		} else if (!strcmp(format, "csv")) {
+			printf("%s,%i,%i,\"%s\",%i,%i,%i,%i,%.4f", is_driver ? "driver" : "frontend",
+			       f->adapter, f->frontend, f->info.name, f->tunes, f->locked,
+			       f->failed_set, f->timed_out, failure_rate);
+			print_csv_dist(&f->lock_us);
+			print_csv_dist(&f->set_us);
+			print_csv_dist(&f->status_us);
+			printf("\n");
+		} else {
+			if (is_driver)
+				printf("driver \"%s\"\n", f->info.name);
+			else
+				printf("adapter%i/frontend%i \"%s\"\n", f->adapter, f->frontend, f->info.name);
+			printf("  %i tunes, %i locked, %i set failures, %i timeouts (%.1f%% failed)\n",
+			       f->tunes, f->locked, f->failed_set, f->timed_out, failure_rate * 100);
+			print_text_dist("lock", &f->lock_us);
+			print_text_dist("set", &f->set_us);
+			print_text_dist("status", &f->status_us);
+		}
+	}
+
+	if (!strcmp(format, "json"))
+		printf("  ]\n}\n");
+}
+
+int main(int argc, char *argv[])
+{
+	char *chanfile = NULL;
+	char *secfile = NULL;
+	char *secid = "UNIVERSAL";
+	char *format = "text";
+	unsigned int seed = time(NULL);
+	FILE *f;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "c:a:n:t:d:s:S:R:r:o:q")) != -1) {
+		switch (opt) {
+		case 'c':
+			chanfile = optarg;
+			break;
+		case 'a':
+			if (frontend_count == MAX_FRONTENDS) {
+				fprintf(stderr, "Too many frontends\n");
+				exit(1);
+			}
+			if (sscanf(optarg, "%i.%i", &frontends[frontend_count].adapter,
+				   &frontends[frontend_count].frontend) < 1)
+				goto usage;
+			frontend_count++;
+			break;
+		case 'n':
+			tune_count = atoi(optarg);
+			break;
+		case 't':
+			lock_timeout = atoi(optarg);
+			break;
+		case 'd':
+			dwell = atoi(optarg);
+			break;
+		case 's':
+			secid = optarg;
+			break;
+		case 'S':
+			secfile = optarg;
+			break;
+		case 'R':
+			sec_reset_pct = atoi(optarg);
+			break;
+		case 'r':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			format = optarg;
+			if (strcmp(format, "text") && strcmp(format, "csv") && strcmp(format, "json"))
+				goto usage;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if ((chanfile == NULL) || (tune_count <= 0) || (lock_timeout <= 0))
+		goto usage;
+	if (frontend_count == 0)
+		frontend_count = 1;
+
+	// channels to pick from
+	if ((channels = malloc(MAX_CHANNELS * sizeof(struct dvbcfg_zapchannel))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	if ((f = fopen(chanfile, "r")) == NULL) {
+		fprintf(stderr, "Unable to open %s: %m\n", chanfile);
+		exit(1);
+	}
+	dvbcfg_zapchannel_parse(f, channel_cb, NULL);
+	fclose(f);
+	if (channel_count == 0) {
+		fprintf(stderr, "No channels in %s\n", chanfile);
+		exit(1);
+	}
+
+	if (dvbsec_cfg_find(secfile, secid, &sec) == 0)
+		valid_sec = 1;
+	else
+		fprintf(stderr, "Unable to find SEC id %s; DVB-S frontends are tuned without SEC\n", secid);
+
+	for(i=0; i < frontend_count; i++) {
+		struct frontend *fe = &frontends[i];
+
+		if ((fe->fe = dvbfe_open(fe->adapter, fe->frontend, 0)) == NULL) {
+			fprintf(stderr, "Unable to open adapter%i/frontend%i: %m\n",
+				fe->adapter, fe->frontend);
+			exit(1);
+		}
+		dvbfe_get_info(fe->fe, 0, &fe->info, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+		if (fe->info.name == NULL)
+			fe->info.name = "unknown";
+		if ((fe->info.type == DVBFE_TYPE_DVBS) && valid_sec)
+			fe->sec = &sec;
+		fe->seed = seed + i;
+	}
+
+	signal(SIGINT, sighandler);
+	signal(SIGTERM, sighandler);
+
+	for(i=0; i < frontend_count; i++) {
+		if (pthread_create(&frontends[i].thread, NULL, frontend_thread, &frontends[i])) {
+			fprintf(stderr, "Unable to start thread: %m\n");
+			exit(1);
+		}
+	}
+	for(i=0; i < frontend_count; i++)
+		pthread_join(frontends[i].thread, NULL);
+
+	report(format);
+
+	for(i=0; i < frontend_count; i++)
+		dvbfe_close(frontends[i].fe);
+	return 0;
+
+usage:
+	fprintf(stderr, "%s", usage_str);
+	exit(1);
+}
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <libdvbcfg/dvbcfg_zapchannel.h>
+#include <libdvbcfg/dvbcfg_zapindex.h>
 
 void syntax(void);
 
@@ -56,6 +57,75 @@ int main(int argc, char *argv[])
 		dvbcfg_zapchannel_save(f, zapsave_callback, NULL);
 		fclose(f);
 
+	} else if (!strcmp(argv[1], "-zapmerge")) {
+
+		FILE *f = fopen(argv[3], "r");
+		if (!f) {
+			fprintf(stderr, "Unable to load %s\n", argv[3]);
+			exit(1);
+		}
+		dvbcfg_zapchannel_parse(f, zapload_callback, NULL);
+		fclose(f);
+
+		struct dvbcfg_zapindex *index = dvbcfg_zapindex_open(argv[2], NULL);
+		if (!index) {
+			fprintf(stderr, "Unable to index %s\n", argv[2]);
+			exit(1);
+		}
+		int ret = dvbcfg_zapindex_merge(index, argv[2], NULL, channels, zapcount);
+		dvbcfg_zapindex_close(index);
+		if (ret) {
+			fprintf(stderr, "Unable to merge into %s: %s\n", argv[2], strerror(-ret));
+			exit(1);
+		}
+
+	} else if (!strcmp(argv[1], "-zappublish")) {
+
+		struct dvbcfg_zapindex *index = dvbcfg_zapindex_open(argv[2], NULL);
+		if (!index) {
+			fprintf(stderr, "Unable to index %s\n", argv[2]);
+			exit(1);
+		}
+		int ret = dvbcfg_zapindex_publish(index, argv[3]);
+		dvbcfg_zapindex_close(index);
+		if (ret) {
+			fprintf(stderr, "Unable to publish to %s: %s\n", argv[3], strerror(-ret));
+			exit(1);
+		}
+
+		index = dvbcfg_zapindex_attach(argv[3]);
+		if (!index) {
+			fprintf(stderr, "Unable to attach to %s\n", argv[3]);
+			exit(1);
+		}
+		printf("%i channels in %s\n", dvbcfg_zapindex_count(index), argv[3]);
+		dvbcfg_zapindex_close(index);
+
+	} else if (!strcmp(argv[1], "-zapsearch")) {
+
+		static const char *modes[] = { "prefix", "substring", "fuzzy" };
+		struct dvbcfg_zapindex *index = dvbcfg_zapindex_open(argv[2], NULL);
+		struct dvbcfg_zapchannel channel;
+		int numbers[10];
+		int mode;
+		int i;
+
+		if (!index) {
+			fprintf(stderr, "Unable to index %s\n", argv[2]);
+			exit(1);
+		}
+		for (mode = 0; mode < 3; mode++) {
+			int count = dvbcfg_zapindex_search(index, argv[3], mode, numbers, 10);
+
+			printf("%s:", modes[mode]);
+			for (i = 0; i < count; i++) {
+				dvbcfg_zapindex_get(index, numbers[i], &channel);
+				printf(" %s", channel.name);
+			}
+			printf("\n");
+		}
+		dvbcfg_zapindex_close(index);
+
 	} else {
                 syntax();
         }
@@ -95,6 +165,9 @@ int zapsave_callback(struct dvbcfg_zapchannel *channel, void *private)
 void syntax()
 {
         fprintf(stderr,
-                "Syntax: dvbcfg_test <-zapchannel> <input filename> <output filename>\n");
+                "Syntax: dvbcfg_test <-zapchannel> <input filename> <output filename>\n"
+                "       dvbcfg_test <-zapmerge> <channel filename> <changes filename>\n"
+                "       dvbcfg_test <-zappublish> <channel filename> <store name>\n"
+                "       dvbcfg_test <-zapsearch> <channel filename> <query>\n");
         exit(1);
 }
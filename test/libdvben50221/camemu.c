@@ -0,0 +1,747 @@
+/*
+    en50221 encoder An implementation for libdvb
+    an implementation for the en50221 transport layer
+
+    Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation; either version 2.1 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <libdvben50221/asn_1.h>
+#include <libdvben50221/en50221_app_tags.h>
+#include <libdvben50221/en50221_app_utils.h>
+#include <libdvben50221/en50221_app_ai.h>
+#include <libdvben50221/en50221_app_ca.h>
+#include <libdvben50221/en50221_app_datetime.h>
+#include <libdvben50221/en50221_app_mmi.h>
+#include <libdvben50221/en50221_app_rm.h>
+#include "camemu.h"
+
+// transport layer tags
+#define T_SB           0x80
+#define T_RCV          0x81
+#define T_CREATE_T_C   0x82
+#define T_C_T_C_REPLY  0x83
+#define T_DELETE_T_C   0x84
+#define T_D_T_C_REPLY  0x85
+#define T_DATA_LAST    0xA0
+#define T_DATA_MORE    0xA1
+
+// session layer tags
+#define ST_SESSION_NUMBER       0x90
+#define ST_OPEN_SESSION_REQ     0x91
+#define ST_OPEN_SESSION_RES     0x92
+#define ST_CREATE_SESSION       0x93
+#define ST_CREATE_SESSION_RES   0x94
+#define ST_CLOSE_SESSION_REQ    0x95
+#define ST_CLOSE_SESSION_RES    0x96
+
+#define S_STATUS_CLOSE_NO_RES   0xF0
+
+// the host reads link frames of up to 4096 bytes; longer SPDUs are sent as
+// T_DATA_MORE chains
+#define CAMEMU_FRAME_SIZE 4096
+#define CAMEMU_FRAGMENT 4000
+
+// largest frame the host may send: one TPDU of 64k
+#define CAMEMU_RX_SIZE (2 + 1 + 3 + 65536)
+
+// the resources the module opens sessions to, in this order
+#define RES_RM          0
+#define RES_AI          1
+#define RES_CA          2
+#define RES_DATETIME    3
+#define RES_MMI         4
+#define RES_COUNT       5
+
+#define SESSION_IDLE    0
+#define SESSION_OPENING 1
+#define SESSION_OPEN    2
+
+struct camemu_spdu {
+    struct camemu_spdu *next;
+    uint32_t length;
+    uint32_t sent;
+    uint8_t data[];
+};
+
+struct camemu_session {
+    int state;
+    uint16_t session_number;
+};
+
+struct camemu {
+    int fd;
+    uint8_t slot;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    struct camemu_stats stats;
+
+    uint8_t connection_id;
+    int connected;
+    struct camemu_session sessions[RES_COUNT];
+    int menu_pending;
+
+    // SPDUs waiting for a T_RCV
+    struct camemu_spdu *queue;
+    struct camemu_spdu *queue_tail;
+
+    // a T_DATA_MORE chain from the host
+    uint8_t *chain;
+    uint32_t chain_length;
+    uint32_t chain_size;
+
+    uint8_t rx[CAMEMU_RX_SIZE];
+    uint8_t tx[2 + CAMEMU_FRAME_SIZE];
+    uint32_t tx_length;
+};
+
+static const uint32_t camemu_resource_ids[RES_COUNT] = {
+    EN50221_APP_RM_RESOURCEID,
+    EN50221_APP_AI_RESOURCEID,
+    EN50221_APP_CA_RESOURCEID,
+    EN50221_APP_DATETIME_RESOURCEID,
+    EN50221_APP_MMI_RESOURCEID,
+};
+
+static void *camemu_thread(void *arg);
+static void camemu_frame(struct camemu *emu, uint8_t *data, uint32_t length);
+static void camemu_spdu(struct camemu *emu, uint8_t *data, uint32_t length);
+static void camemu_apdu(struct camemu *emu, int res, uint8_t *data, uint32_t length);
+static void camemu_ca_pmt(struct camemu *emu, uint8_t *data, uint32_t length);
+
+struct camemu *camemu_create(int fd, uint8_t slot)
+{
+    struct camemu *emu;
+
+    if ((emu = calloc(1, sizeof(struct camemu))) == NULL)
+        return NULL;
+    emu->fd = fd;
+    emu->slot = slot;
+    pthread_mutex_init(&emu->lock, NULL);
+
+    if (pthread_create(&emu->thread, NULL, camemu_thread, emu)) {
+        pthread_mutex_destroy(&emu->lock);
+        free(emu);
+        return NULL;
+    }
+
+    return emu;
+}
+
+static void camemu_flush(struct camemu *emu)
+{
+    while (emu->queue) {
+        struct camemu_spdu *next = emu->queue->next;
+        free(emu->queue);
+        emu->queue = next;
+    }
+    emu->queue_tail = NULL;
+    emu->chain_length = 0;
+}
+
+void camemu_destroy(struct camemu *emu)
+{
+    shutdown(emu->fd, SHUT_RDWR);
+    pthread_join(emu->thread, NULL);
+    close(emu->fd);
+
+    camemu_flush(emu);
+    free(emu->chain);
+    pthread_mutex_destroy(&emu->lock);
+    free(emu);
+}
+
+void camemu_get_stats(struct camemu *emu, struct camemu_stats *stats)
+{
+    pthread_mutex_lock(&emu->lock);
+    *stats = emu->stats;
+    pthread_mutex_unlock(&emu->lock);
+}
+
+static void *camemu_thread(void *arg)
+{
+    struct camemu *emu = (struct camemu *) arg;
+    int size;
+
+    // the host polls the module, so it only ever answers
+    while (1) {
+        if ((size = read(emu->fd, emu->rx, sizeof(emu->rx))) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (size == 0)
+            break;
+
+        pthread_mutex_lock(&emu->lock);
+        emu->stats.frames_in++;
+        if ((size < 2) || (emu->rx[0] != emu->slot))
+            emu->stats.errors++;
+        else
+            camemu_frame(emu, emu->rx + 2, size - 2);
+        pthread_mutex_unlock(&emu->lock);
+    }
+
+    return NULL;
+}
+
+static int camemu_is_resource(uint32_t resource_id, int res)
+{
+    struct en50221_app_public_resource_id a;
+    struct en50221_app_public_resource_id b;
+
+    if ((en50221_app_decode_public_resource_id(&a, resource_id) == NULL) ||
+        (en50221_app_decode_public_resource_id(&b, camemu_resource_ids[res]) == NULL))
+        return 0;
+    return (a.resource_class == b.resource_class) && (a.resource_type == b.resource_type);
+}
+
+static void camemu_queue(struct camemu *emu, uint8_t *hdr, uint32_t hdr_length,
+                         uint8_t *data, uint32_t data_length)
+{
+    struct camemu_spdu *spdu;
+
+    if ((spdu = malloc(sizeof(struct camemu_spdu) + hdr_length + data_length)) == NULL) {
+        emu->stats.errors++;
+        return;
+    }
+    spdu->next = NULL;
+    spdu->length = hdr_length + data_length;
+    spdu->sent = 0;
+    memcpy(spdu->data, hdr, hdr_length);
+    if (data_length)
+        memcpy(spdu->data + hdr_length, data, data_length);
+
+    if (emu->queue_tail)
+        emu->queue_tail->next = spdu;
+    else
+        emu->queue = spdu;
+    emu->queue_tail = spdu;
+}
+
+static void camemu_open_session(struct camemu *emu, int res)
+{
+    uint8_t hdr[6];
+
+    hdr[0] = ST_OPEN_SESSION_REQ;
+    hdr[1] = 4;
+    hdr[2] = camemu_resource_ids[res] >> 24;
+    hdr[3] = camemu_resource_ids[res] >> 16;
+    hdr[4] = camemu_resource_ids[res] >> 8;
+    hdr[5] = camemu_resource_ids[res];
+    camemu_queue(emu, hdr, 6, NULL, 0);
+    emu->sessions[res].state = SESSION_OPENING;
+}
+
+static void camemu_send_apdu(struct camemu *emu, int res, uint32_t tag,
+                             uint8_t *data, uint32_t data_length)
+{
+    uint8_t hdr[4 + 3 + 3];
+    int length_field_len;
+
+    if (emu->sessions[res].state != SESSION_OPEN) {
+        emu->stats.errors++;
+        return;
+    }
+
+    hdr[0] = ST_SESSION_NUMBER;
+    hdr[1] = 2;
+    hdr[2] = emu->sessions[res].session_number >> 8;
+    hdr[3] = emu->sessions[res].session_number;
+    hdr[4] = tag >> 16;
+    hdr[5] = tag >> 8;
+    hdr[6] = tag;
+    if ((length_field_len = asn_1_encode(data_length, hdr + 7, 3)) < 0) {
+        emu->stats.errors++;
+        return;
+    }
+    camemu_queue(emu, hdr, 7 + length_field_len, data, data_length);
+    emu->stats.apdus_out++;
+}
+
+static void camemu_send_menu(struct camemu *emu)
+{
+    static const char *texts[3 + CAMEMU_MENU_ITEMS] = {
+        CAMEMU_MENU_TITLE, "", "Select an item", "Subscription", "Settings"
+    };
+    uint8_t menu[256];
+    uint32_t pos = 0;
+    uint32_t split;
+    int i;
+
+    menu[pos++] = CAMEMU_MENU_ITEMS;
+    for (i = 0; i < 3 + CAMEMU_MENU_ITEMS; i++) {
+        const char *text = texts[i];
+        uint32_t len = strlen(text);
+
+        // the title comes in two text fragments
+        if ((i == 0) && (len > 1)) {
+            menu[pos++] = (TAG_TEXT_MORE >> 16) & 0xff;
+            menu[pos++] = (TAG_TEXT_MORE >> 8) & 0xff;
+            menu[pos++] = TAG_TEXT_MORE & 0xff;
+            menu[pos++] = len / 2;
+            memcpy(menu + pos, text, len / 2);
+            pos += len / 2;
+            text += len / 2;
+            len -= len / 2;
+        }
+        menu[pos++] = (TAG_TEXT_LAST >> 16) & 0xff;
+        menu[pos++] = (TAG_TEXT_LAST >> 8) & 0xff;
+        menu[pos++] = TAG_TEXT_LAST & 0xff;
+        menu[pos++] = len;
+        memcpy(menu + pos, text, len);
+        pos += len;
+    }
+
+    // and the menu in two APDUs
+    split = pos / 2;
+    camemu_send_apdu(emu, RES_MMI, TAG_MENU_MORE, menu, split);
+    camemu_send_apdu(emu, RES_MMI, TAG_MENU_LAST, menu + split, pos - split);
+    emu->menu_pending = 0;
+}
+
+/**
+ * Append the next fragment of the first queued SPDU to the reply.
+ */
+static void camemu_tx_data(struct camemu *emu)
+{
+    struct camemu_spdu *spdu = emu->queue;
+    uint32_t left;
+    uint32_t fragment;
+    int length_field_len;
+    uint8_t *out;
+
+    if (spdu == NULL)
+        return;
+    left = spdu->length - spdu->sent;
+    fragment = (left > CAMEMU_FRAGMENT) ? CAMEMU_FRAGMENT : left;
+
+    out = emu->tx + emu->tx_length;
+    out[0] = (fragment < left) ? T_DATA_MORE : T_DATA_LAST;
+    length_field_len = asn_1_encode(fragment + 1, out + 1, 3);
+    out[1 + length_field_len] = emu->connection_id;
+    memcpy(out + 2 + length_field_len, spdu->data + spdu->sent, fragment);
+    emu->tx_length += 2 + length_field_len + fragment;
+
+    spdu->sent += fragment;
+    if (spdu->sent == spdu->length) {
+        emu->queue = spdu->next;
+        if (emu->queue == NULL)
+            emu->queue_tail = NULL;
+        free(spdu);
+    }
+}
+
+static void camemu_tx_sb(struct camemu *emu)
+{
+    uint8_t *out = emu->tx + emu->tx_length;
+
+    out[0] = T_SB;
+    out[1] = 2;
+    out[2] = emu->connection_id;
+    out[3] = emu->queue ? 0x80 : 0x00;
+    emu->tx_length += 4;
+}
+
+static void camemu_tx_short(struct camemu *emu, uint8_t tag)
+{
+    uint8_t *out = emu->tx + emu->tx_length;
+
+    out[0] = tag;
+    out[1] = 1;
+    out[2] = emu->connection_id;
+    emu->tx_length += 3;
+}
+
+static void camemu_frame(struct camemu *emu, uint8_t *data, uint32_t length)
+{
+    uint16_t asn_data_length;
+    int length_field_len;
+    uint8_t tag;
+    int i;
+
+    emu->tx[0] = emu->slot;
+    emu->tx_length = 2;
+
+    while (length) {
+        // tag, length, connection id, body
+        tag = data[0];
+        if ((length < 3) ||
+            ((length_field_len = asn_1_decode(&asn_data_length, data + 1, length - 1)) < 0) ||
+            (asn_data_length < 1) ||
+            (asn_data_length > (length - 1 - length_field_len))) {
+            emu->stats.errors++;
+            return;
+        }
+        emu->connection_id = data[1 + length_field_len];
+        uint8_t *body = data + 2 + length_field_len;
+        uint32_t body_length = asn_data_length - 1;
+
+        switch (tag) {
+        case T_CREATE_T_C:
+            // a new connection: start again, with the resource manager
+            camemu_flush(emu);
+            for (i = 0; i < RES_COUNT; i++)
+                emu->sessions[i].state = SESSION_IDLE;
+            emu->menu_pending = 0;
+            emu->connected = 1;
+            camemu_open_session(emu, RES_RM);
+            camemu_tx_short(emu, T_C_T_C_REPLY);
+            camemu_tx_sb(emu);
+            break;
+
+        case T_DELETE_T_C:
+            emu->connected = 0;
+            camemu_flush(emu);
+            camemu_tx_short(emu, T_D_T_C_REPLY);
+            break;
+
+        case T_D_T_C_REPLY:
+            break;
+
+        case T_DATA_MORE:
+        case T_DATA_LAST:
+            if (!emu->connected) {
+                emu->stats.errors++;
+                return;
+            }
+            if (body_length && ((tag == T_DATA_MORE) || emu->chain_length)) {
+                if ((emu->chain_length + body_length) > emu->chain_size) {
+                    uint8_t *chain = realloc(emu->chain, emu->chain_length + body_length);
+                    if (chain == NULL) {
+                        emu->stats.errors++;
+                        return;
+                    }
+                    emu->chain = chain;
+                    emu->chain_size = emu->chain_length + body_length;
+                }
+                memcpy(emu->chain + emu->chain_length, body, body_length);
+                emu->chain_length += body_length;
+            }
+            if (tag == T_DATA_LAST) {
+                if (emu->chain_length) {
+                    camemu_spdu(emu, emu->chain, emu->chain_length);
+                    emu->chain_length = 0;
+                } else if (body_length) {
+                    camemu_spdu(emu, body, body_length);
+                }
+            }
+            camemu_tx_sb(emu);
+            break;
+
+        case T_RCV:
+            if (!emu->connected) {
+                emu->stats.errors++;
+                return;
+            }
+            camemu_tx_data(emu);
+            camemu_tx_sb(emu);
+            break;
+
+        default:
+            emu->stats.errors++;
+            return;
+        }
+
+        data += 1 + length_field_len + asn_data_length;
+        length -= 1 + length_field_len + asn_data_length;
+    }
+
+    if (emu->tx_length > 2) {
+        emu->tx[1] = emu->connection_id;
+        if (write(emu->fd, emu->tx, emu->tx_length) != (ssize_t) emu->tx_length)
+            emu->stats.errors++;
+        else
+            emu->stats.frames_out++;
+    }
+}
+
+static int camemu_find_session(struct camemu *emu, uint16_t session_number)
+{
+    int i;
+
+    for (i = 0; i < RES_COUNT; i++) {
+        if ((emu->sessions[i].state == SESSION_OPEN) &&
+            (emu->sessions[i].session_number == session_number))
+            return i;
+    }
+    return -1;
+}
+
+static void camemu_session_open(struct camemu *emu, int res)
+{
+    uint8_t response_interval = 0;
+
+    switch (res) {
+    case RES_DATETIME:
+        camemu_send_apdu(emu, res, TAG_DATE_TIME_ENQUIRY, &response_interval, 1);
+        break;
+
+    case RES_MMI:
+        if (emu->menu_pending)
+            camemu_send_menu(emu);
+        break;
+    }
+}
+
+static void camemu_spdu(struct camemu *emu, uint8_t *data, uint32_t length)
+{
+    uint8_t hdr[9];
+    uint16_t session_number;
+    uint32_t resource_id;
+    int res;
+
+    if ((length < 2) || (data[1] + 2U > length)) {
+        emu->stats.errors++;
+        return;
+    }
+
+    switch (data[0]) {
+    case ST_OPEN_SESSION_RES:
+        if (data[1] != 7) {
+            emu->stats.errors++;
+            return;
+        }
+        resource_id = (data[3] << 24) | (data[4] << 16) | (data[5] << 8) | data[6];
+        session_number = (data[7] << 8) | data[8];
+        for (res = 0; res < RES_COUNT; res++) {
+            if ((emu->sessions[res].state == SESSION_OPENING) &&
+                camemu_is_resource(resource_id, res))
+                break;
+        }
+        if (res == RES_COUNT) {
+            emu->stats.errors++;
+            return;
+        }
+        if (data[2] != 0) {
+            emu->sessions[res].state = SESSION_IDLE;
+            return;
+        }
+        emu->sessions[res].state = SESSION_OPEN;
+        emu->sessions[res].session_number = session_number;
+        emu->stats.sessions++;
+        camemu_session_open(emu, res);
+        break;
+
+    case ST_SESSION_NUMBER:
+        if (data[1] != 2) {
+            emu->stats.errors++;
+            return;
+        }
+        session_number = (data[2] << 8) | data[3];
+        if ((res = camemu_find_session(emu, session_number)) < 0) {
+            emu->stats.errors++;
+            return;
+        }
+        emu->stats.apdus_in++;
+        camemu_apdu(emu, res, data + 4, length - 4);
+        break;
+
+    case ST_CLOSE_SESSION_REQ:
+        if (data[1] != 2) {
+            emu->stats.errors++;
+            return;
+        }
+        session_number = (data[2] << 8) | data[3];
+        if ((res = camemu_find_session(emu, session_number)) >= 0)
+            emu->sessions[res].state = SESSION_IDLE;
+        hdr[0] = ST_CLOSE_SESSION_RES;
+        hdr[1] = 3;
+        hdr[2] = (res >= 0) ? 0x00 : S_STATUS_CLOSE_NO_RES;
+        hdr[3] = session_number >> 8;
+        hdr[4] = session_number;
+        camemu_queue(emu, hdr, 5, NULL, 0);
+        break;
+
+    case ST_CREATE_SESSION:
+        // the module offers no resources of its own
+        if (data[1] != 6) {
+            emu->stats.errors++;
+            return;
+        }
+        hdr[0] = ST_CREATE_SESSION_RES;
+        hdr[1] = 7;
+        hdr[2] = S_STATUS_CLOSE_NO_RES;
+        memcpy(hdr + 3, data + 2, 6);
+        camemu_queue(emu, hdr, 9, NULL, 0);
+        break;
+
+    case ST_CLOSE_SESSION_RES:
+        break;
+
+    default:
+        emu->stats.errors++;
+        break;
+    }
+}
+
+static void camemu_apdu(struct camemu *emu, int res, uint8_t *data, uint32_t length)
+{
+    static const uint16_t ca_ids[CAMEMU_CA_ID_COUNT] = CAMEMU_CA_IDS;
+    uint8_t reply[64];
+    uint16_t asn_data_length;
+    int length_field_len;
+    uint32_t tag;
+    uint32_t i;
+    int j;
+
+    if ((length < 4) ||
+        ((length_field_len = asn_1_decode(&asn_data_length, data + 3, length - 3)) < 0) ||
+        (asn_data_length > (length - 3 - length_field_len))) {
+        emu->stats.errors++;
+        return;
+    }
+    tag = (data[0] << 16) | (data[1] << 8) | data[2];
+    data += 3 + length_field_len;
+    length = asn_data_length;
+
+    switch (tag) {
+    case TAG_PROFILE_ENQUIRY:
+        camemu_send_apdu(emu, res, TAG_PROFILE, NULL, 0);
+        break;
+
+    case TAG_PROFILE_CHANGE:
+        camemu_send_apdu(emu, res, TAG_PROFILE_ENQUIRY, NULL, 0);
+        break;
+
+    case TAG_PROFILE:
+        // open what the host has, apart from the MMI which waits for a menu
+        for (i = 0; i + 4 <= length; i += 4) {
+            uint32_t resource_id =
+                (data[i] << 24) | (data[i + 1] << 16) | (data[i + 2] << 8) | data[i + 3];
+
+            for (j = RES_AI; j < RES_MMI; j++) {
+                if ((emu->sessions[j].state == SESSION_IDLE) &&
+                    camemu_is_resource(resource_id, j))
+                    camemu_open_session(emu, j);
+            }
+        }
+        break;
+
+    case TAG_APP_INFO_ENQUIRY:
+        reply[0] = 1;
+        reply[1] = CAMEMU_MANUFACTURER >> 8;
+        reply[2] = CAMEMU_MANUFACTURER & 0xff;
+        reply[3] = CAMEMU_MANUFACTURER_CODE >> 8;
+        reply[4] = CAMEMU_MANUFACTURER_CODE & 0xff;
+        reply[5] = strlen(CAMEMU_MENU_TITLE);
+        memcpy(reply + 6, CAMEMU_MENU_TITLE, reply[5]);
+        camemu_send_apdu(emu, res, TAG_APP_INFO, reply, 6 + reply[5]);
+        break;
+
+    case TAG_ENTER_MENU:
+        emu->menu_pending = 1;
+        if (emu->sessions[RES_MMI].state == SESSION_OPEN)
+            camemu_send_menu(emu);
+        else if (emu->sessions[RES_MMI].state == SESSION_IDLE)
+            camemu_open_session(emu, RES_MMI);
+        break;
+
+    case TAG_CA_INFO_ENQUIRY:
+        for (j = 0; j < CAMEMU_CA_ID_COUNT; j++) {
+            reply[j * 2] = ca_ids[j] >> 8;
+            reply[j * 2 + 1] = ca_ids[j];
+        }
+        camemu_send_apdu(emu, res, TAG_CA_INFO, reply, CAMEMU_CA_ID_COUNT * 2);
+        break;
+
+    case TAG_CA_PMT:
+        camemu_ca_pmt(emu, data, length);
+        break;
+
+    case TAG_DATE_TIME:
+        if (length < 5)
+            emu->stats.errors++;
+        else
+            emu->stats.date_times++;
+        break;
+
+    case TAG_MENU_ANSWER:
+        emu->stats.menu_answers++;
+        reply[0] = MMI_CLOSE_MMI_CMD_ID_IMMEDIATE;
+        camemu_send_apdu(emu, res, TAG_CLOSE_MMI, reply, 1);
+        break;
+
+    case TAG_CLOSE_MMI:
+        break;
+
+    default:
+        emu->stats.errors++;
+        break;
+    }
+}
+
+static void camemu_ca_pmt(struct camemu *emu, uint8_t *data, uint32_t length)
+{
+    uint8_t reply[4 + 3 * 128];
+    uint32_t reply_length = 4;
+    uint32_t info_length;
+    uint32_t pos;
+    uint8_t cmd_id = 0;
+
+    if (length < 6) {
+        emu->stats.errors++;
+        return;
+    }
+
+    // programme: the ca_pmt_cmd_id leads its descriptors, if it has any
+    info_length = ((data[4] & 0x0f) << 8) | data[5];
+    if ((6 + info_length) > length) {
+        emu->stats.errors++;
+        return;
+    }
+    if (info_length)
+        cmd_id = data[6];
+    reply[0] = data[1];
+    reply[1] = data[2];
+    reply[2] = data[3];
+    reply[3] = 0x81;        // descrambling possible
+    pos = 6 + info_length;
+
+    // and each stream
+    while (pos < length) {
+        if ((pos + 5) > length) {
+            emu->stats.errors++;
+            return;
+        }
+        info_length = ((data[pos + 3] & 0x0f) << 8) | data[pos + 4];
+        if ((pos + 5 + info_length) > length) {
+            emu->stats.errors++;
+            return;
+        }
+        if (info_length && !cmd_id)
+            cmd_id = data[pos + 5];
+        if (reply_length < sizeof(reply)) {
+            reply[reply_length++] = 0xe0 | (data[pos + 1] & 0x1f);
+            reply[reply_length++] = data[pos + 2];
+            reply[reply_length++] = 0x81;
+        }
+        pos += 5 + info_length;
+    }
+
+    emu->stats.ca_pmts++;
+    if (cmd_id == CA_PMT_CMD_ID_QUERY) {
+        emu->stats.ca_pmt_queries++;
+        camemu_send_apdu(emu, RES_CA, TAG_CA_PMT_REPLY, reply, reply_length);
+    }
+}
@@ -0,0 +1,105 @@
+/*
+    en50221 encoder An implementation for libdvb
+    an implementation for the en50221 transport layer
+
+    Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation; either version 2.1 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*/
+
+#ifndef CAMEMU_H
+#define CAMEMU_H 1
+
+#include <stdint.h>
+
+/**
+ * A software CAM: the module side of the EN 50221 transport, session and
+ * application layers, run by a thread of its own on one end of a
+ * SOCK_SEQPACKET socketpair. The other end is registered with
+ * en50221_tl_register_slot() in place of a CA device; each datagram is one
+ * link layer frame, [slot, connection_id] then the TPDU, as dvbca_link_read()
+ * and dvbca_link_write() exchange them with the kernel.
+ *
+ * Once the host has created a transport connection, the module opens a
+ * resource manager session, exchanges profiles, and then opens sessions to
+ * the application information, conditional access and date-time resources
+ * of the host's profile. It answers:
+ *
+ *  - profile enquiries, with an empty profile, and profile changes, with a
+ *    profile enquiry of its own;
+ *  - application_info enquiries;
+ *  - ca_info enquiries, with CAMEMU_CA_IDS;
+ *  - ca_pmts with a ca_pmt_cmd_id of query, with a ca_pmt_reply allowing
+ *    the descrambling of the programme and of each of its streams;
+ *  - enter_menu, by opening an MMI session and sending a menu, and the
+ *    menu_answ to it, with close_mmi. The menu is sent as a menu_more and a
+ *    menu_last, and its title as a text_more and a text_last.
+ *
+ * On opening the date-time session, it asks for the time once.
+ */
+struct camemu;
+
+#define CAMEMU_MENU_TITLE "Loopback CAM"
+#define CAMEMU_MENU_ITEMS 2
+
+#define CAMEMU_MANUFACTURER 0xcafe
+#define CAMEMU_MANUFACTURER_CODE 0x5001
+
+// the CA system ids it claims
+#define CAMEMU_CA_IDS { 0x0b00, 0x0100, 0x0500 }
+#define CAMEMU_CA_ID_COUNT 3
+
+/**
+ * What the module has received.
+ */
+struct camemu_stats {
+    uint32_t frames_in;         // link layer frames
+    uint32_t frames_out;
+    uint32_t apdus_in;          // on open sessions
+    uint32_t apdus_out;
+    uint32_t sessions;          // opened
+    uint32_t ca_pmts;
+    uint32_t ca_pmt_queries;
+    uint32_t date_times;
+    uint32_t menu_answers;
+    uint32_t errors;            // protocol violations seen
+};
+
+/**
+ * Start an emulated module.
+ *
+ * @param fd Its end of the socketpair. It belongs to the module from now on.
+ * @param slot The slot number the host registered the other end with.
+ * @return The module, or NULL on failure.
+ */
+extern struct camemu *camemu_create(int fd, uint8_t slot);
+
+/**
+ * Take the module out: its socket is shut down, so the host sees a read
+ * error, and its thread is waited for.
+ *
+ * @param emu The module.
+ */
+extern void camemu_destroy(struct camemu *emu);
+
+/**
+ * Get what the module has received so far.
+ *
+ * @param emu The module.
+ * @param stats Where to put it.
+ */
+extern void camemu_get_stats(struct camemu *emu, struct camemu_stats *stats);
+
+#endif
@@ -0,0 +1,652 @@
+/*
+    en50221 encoder An implementation for libdvb
+    an implementation for the en50221 transport layer
+
+    Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+    This library is free software; you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as
+    published by the Free Software Foundation; either version 2.1 of
+    the License, or (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+*/
+
+/*
+ * Runs the host stack against the loopback CAM of camemu.c, with no
+ * hardware: the RM/AI/CA/datetime session setup, a menu through the MMI,
+ * and then CA PMTs, timing
+ *
+ *  - session setup: from creating the transport connection until the CAM's
+ *    ca_info and the date-time enquiry have come in;
+ *  - CA PMT round trips: a query sent and its ca_pmt_reply received, one at
+ *    a time;
+ *  - APDU throughput: CA PMTs queued all at once, either ok_descrambling
+ *    (host to module only) or queries (both ways).
+ *
+ * The stack is polled with en50221_tl_poll_slot() on this thread, so every
+ * callback runs here. Exits non-zero if anything goes wrong.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <libdvben50221/en50221_session.h>
+#include <libdvben50221/en50221_app_utils.h>
+#include <libdvben50221/en50221_app_ai.h>
+#include <libdvben50221/en50221_app_ca.h>
+#include <libdvben50221/en50221_app_datetime.h>
+#include <libdvben50221/en50221_app_mmi.h>
+#include <libdvben50221/en50221_app_rm.h>
+#include "camemu.h"
+
+#define LOOPBACK_SLOT 0
+
+#define DEFAULT_SETUPS 100
+#define DEFAULT_QUERIES 10000
+
+// how long anything may take before it counts as a hang, in ms
+#define WAIT_TIMEOUT 5000
+
+int lookup_callback(void *arg, uint8_t slot_id, uint32_t requested_resource_id,
+                    en50221_sl_resource_callback *callback_out, void **arg_out, uint32_t *connected_resource_id);
+int session_callback(void *arg, int reason, uint8_t slot_id, uint16_t session_number, uint32_t resource_id);
+int rm_enq_callback(void *arg, uint8_t slot_id, uint16_t session_number);
+int rm_reply_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t resource_id_count, uint32_t *resource_ids);
+int rm_changed_callback(void *arg, uint8_t slot_id, uint16_t session_number);
+int datetime_enquiry_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint8_t response_interval);
+int ai_callback(void *arg, uint8_t slot_id, uint16_t session_number,
+                uint8_t application_type, uint16_t application_manufacturer,
+                uint16_t manufacturer_code, uint8_t menu_string_length,
+                uint8_t *menu_string);
+int ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t ca_id_count, uint16_t *ca_ids);
+int ca_pmt_reply_callback(void *arg, uint8_t slot_id, uint16_t session_number,
+                          struct en50221_app_pmt_reply *reply, uint32_t reply_size);
+int mmi_menu_callback(void *arg, uint8_t slot_id, uint16_t session_number,
+                      struct en50221_app_mmi_text *title,
+                      struct en50221_app_mmi_text *sub_title,
+                      struct en50221_app_mmi_text *bottom,
+                      uint32_t item_count, struct en50221_app_mmi_text *items,
+                      uint32_t item_raw_length, uint8_t *items_raw);
+int mmi_close_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint8_t cmd_id, uint8_t delay);
+
+struct en50221_transport_layer *tl;
+struct en50221_session_layer *sl;
+int cam_slot_id = -1;
+
+struct en50221_app_rm *rm_resource;
+struct en50221_app_datetime *datetime_resource;
+struct en50221_app_ai *ai_resource;
+struct en50221_app_ca *ca_resource;
+struct en50221_app_mmi *mmi_resource;
+
+// lookup table used in resource manager implementation
+struct resource {
+    struct en50221_app_public_resource_id resid;
+    uint32_t binary_resource_id;
+    en50221_sl_resource_callback callback;
+    void *arg;
+};
+struct resource resources[5];
+int resources_count = 0;
+
+uint32_t host_resource_ids[] = { EN50221_APP_RM_RESOURCEID,
+                            EN50221_APP_AI_RESOURCEID,
+                            EN50221_APP_CA_RESOURCEID,
+                            EN50221_APP_DATETIME_RESOURCEID,
+                            EN50221_APP_MMI_RESOURCEID, };
+int host_resource_ids_count = sizeof(host_resource_ids)/4;
+
+// what the host has seen of the CAM since it was inserted
+int ai_session_number;
+int ca_session_number;
+int mmi_session_number;
+int got_app_info;
+int got_ca_info;
+int got_datetime_enquiry;
+int got_menu;
+int got_close;
+int pmt_replies;
+int bad_replies;
+
+uint8_t ca_pmt_query[256];
+uint8_t ca_pmt_descramble[256];
+int ca_pmt_length;
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Build a CA PMT for a programme of a video, two audio and a teletext
+ * stream, each with a CA descriptor.
+ */
+static int build_ca_pmt(uint8_t *buf, uint8_t cmd_id)
+{
+    static const uint8_t streams[][3] = {
+        { 0x02, 0x01, 0x00 }, { 0x04, 0x01, 0x01 }, { 0x04, 0x01, 0x02 }, { 0x06, 0x01, 0x03 }
+    };
+    static const uint8_t ca_descriptor[] = { 0x09, 0x04, 0x0b, 0x00, 0xe1, 0x00 };
+    int pos = 0;
+    unsigned int i;
+
+    buf[pos++] = CA_LIST_MANAGEMENT_ONLY;
+    buf[pos++] = 0x01;          // program number
+    buf[pos++] = 0x2c;
+    buf[pos++] = (3 << 1) | 1;  // version, current
+    buf[pos++] = 0;
+    buf[pos++] = 1 + sizeof(ca_descriptor);
+    buf[pos++] = cmd_id;
+    memcpy(buf + pos, ca_descriptor, sizeof(ca_descriptor));
+    pos += sizeof(ca_descriptor);
+
+    for (i = 0; i < sizeof(streams) / sizeof(streams[0]); i++) {
+        buf[pos++] = streams[i][0];
+        buf[pos++] = 0xe0 | streams[i][1];
+        buf[pos++] = streams[i][2];
+        buf[pos++] = 0;
+        buf[pos++] = 1 + sizeof(ca_descriptor);
+        buf[pos++] = cmd_id;
+        memcpy(buf + pos, ca_descriptor, sizeof(ca_descriptor));
+        buf[pos + 4] = 0xe1;
+        buf[pos + 5] = 0x10 + i;
+        pos += sizeof(ca_descriptor);
+    }
+
+    return pos;
+}
+
+static void add_resource(uint32_t resource_id, en50221_sl_resource_callback callback, void *arg)
+{
+    en50221_app_decode_public_resource_id(&resources[resources_count].resid, resource_id);
+    resources[resources_count].binary_resource_id = resource_id;
+    resources[resources_count].callback = callback;
+    resources[resources_count].arg = arg;
+    resources_count++;
+}
+
+/**
+ * Run the stack until *counter reaches target.
+ *
+ * @return 0 on success, -1 on a stack error or timeout (which have been
+ * reported).
+ */
+static int wait_for(int *counter, int target, const char *what)
+{
+    double deadline = now() + WAIT_TIMEOUT / 1000.0;
+
+    while (*counter < target) {
+        if (en50221_tl_poll_slot(tl, cam_slot_id, 100) < 0) {
+            fprintf(stderr, "Transport layer error %i waiting for %s\n",
+                    en50221_tl_get_error(tl), what);
+            return -1;
+        }
+        if (now() > deadline) {
+            fprintf(stderr, "Timed out waiting for %s (%i of %i)\n", what, *counter, target);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void remove_cam(struct camemu *emu, int host_fd)
+{
+    en50221_tl_destroy_slot(tl, cam_slot_id);
+    camemu_destroy(emu);
+    close(host_fd);
+    cam_slot_id = -1;
+}
+
+/**
+ * Insert a new loopback CAM and bring its sessions up.
+ *
+ * @return The CAM, or NULL on failure (which has been reported).
+ */
+static struct camemu *insert_cam(int *host_fd)
+{
+    struct camemu *emu;
+    int fds[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds)) {
+        perror("socketpair");
+        return NULL;
+    }
+    if ((emu = camemu_create(fds[1], LOOPBACK_SLOT)) == NULL) {
+        fprintf(stderr, "Failed to start the loopback CAM\n");
+        close(fds[0]);
+        close(fds[1]);
+        return NULL;
+    }
+    if ((cam_slot_id = en50221_tl_register_slot(tl, fds[0], LOOPBACK_SLOT, 1000, 100)) < 0) {
+        fprintf(stderr, "Slot registration failed\n");
+        camemu_destroy(emu);
+        close(fds[0]);
+        return NULL;
+    }
+    *host_fd = fds[0];
+
+    ai_session_number = -1;
+    ca_session_number = -1;
+    mmi_session_number = -1;
+    got_app_info = 0;
+    got_ca_info = 0;
+    got_datetime_enquiry = 0;
+    if (en50221_tl_new_tc(tl, cam_slot_id) < 0) {
+        fprintf(stderr, "Failed to create a transport connection\n");
+        remove_cam(emu, *host_fd);
+        return NULL;
+    }
+    if (wait_for(&got_ca_info, 1, "ca_info") ||
+        wait_for(&got_app_info, 1, "application_info") ||
+        wait_for(&got_datetime_enquiry, 1, "date_time_enq")) {
+        remove_cam(emu, *host_fd);
+        return NULL;
+    }
+
+    return emu;
+}
+
+static int check_cam(struct camemu *emu, int ca_pmts, int queries)
+{
+    struct camemu_stats stats;
+
+    camemu_get_stats(emu, &stats);
+    if (stats.errors) {
+        fprintf(stderr, "The CAM saw %u protocol errors\n", stats.errors);
+        return -1;
+    }
+    if ((stats.ca_pmts != (uint32_t) ca_pmts) || (stats.ca_pmt_queries != (uint32_t) queries)) {
+        fprintf(stderr, "The CAM received %u CA PMTs (%u queries), not %i (%i)\n",
+                stats.ca_pmts, stats.ca_pmt_queries, ca_pmts, queries);
+        return -1;
+    }
+    if (bad_replies) {
+        fprintf(stderr, "%i bad ca_pmt_replies\n", bad_replies);
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[])
+{
+    struct en50221_app_send_functions sendfuncs;
+    struct camemu_stats stats;
+    struct camemu *emu;
+    int setups = DEFAULT_SETUPS;
+    int queries = DEFAULT_QUERIES;
+    int host_fd;
+    double *times;
+    double start;
+    double total;
+    int count;
+    int i;
+
+    if (argc > 3) {
+        fprintf(stderr, "Syntax: test-loopback [<setups> [<queries>]]\n");
+        exit(1);
+    }
+    if (argc > 1)
+        setups = atoi(argv[1]);
+    if (argc > 2)
+        queries = atoi(argv[2]);
+    if ((setups < 1) || (queries < 1)) {
+        fprintf(stderr, "Need at least one setup and one query\n");
+        exit(1);
+    }
+    if ((times = malloc(sizeof(double) * ((setups > queries) ? setups : queries))) == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    // create the stack
+    if ((tl = en50221_tl_create(1, 16)) == NULL) {
+        fprintf(stderr, "Failed to create transport layer\n");
+        exit(1);
+    }
+    if ((sl = en50221_sl_create(tl, 16)) == NULL) {
+        fprintf(stderr, "Failed to create session layer\n");
+        exit(1);
+    }
+    sendfuncs.arg        = sl;
+    sendfuncs.send_data  = (en50221_send_data) en50221_sl_send_data;
+    sendfuncs.send_datav = (en50221_send_datav) en50221_sl_send_datav;
+
+    // and the resources
+    rm_resource = en50221_app_rm_create(&sendfuncs);
+    en50221_app_rm_register_enq_callback(rm_resource, rm_enq_callback, NULL);
+    en50221_app_rm_register_reply_callback(rm_resource, rm_reply_callback, NULL);
+    en50221_app_rm_register_changed_callback(rm_resource, rm_changed_callback, NULL);
+    add_resource(EN50221_APP_RM_RESOURCEID, (en50221_sl_resource_callback) en50221_app_rm_message, rm_resource);
+
+    datetime_resource = en50221_app_datetime_create(&sendfuncs);
+    en50221_app_datetime_register_enquiry_callback(datetime_resource, datetime_enquiry_callback, NULL);
+    add_resource(EN50221_APP_DATETIME_RESOURCEID,
+                 (en50221_sl_resource_callback) en50221_app_datetime_message, datetime_resource);
+
+    ai_resource = en50221_app_ai_create(&sendfuncs);
+    en50221_app_ai_register_callback(ai_resource, ai_callback, NULL);
+    add_resource(EN50221_APP_AI_RESOURCEID, (en50221_sl_resource_callback) en50221_app_ai_message, ai_resource);
+
+    ca_resource = en50221_app_ca_create(&sendfuncs);
+    en50221_app_ca_register_info_callback(ca_resource, ca_info_callback, NULL);
+    en50221_app_ca_register_pmt_reply_callback(ca_resource, ca_pmt_reply_callback, NULL);
+    add_resource(EN50221_APP_CA_RESOURCEID, (en50221_sl_resource_callback) en50221_app_ca_message, ca_resource);
+
+    mmi_resource = en50221_app_mmi_create(&sendfuncs);
+    en50221_app_mmi_register_menu_callback(mmi_resource, mmi_menu_callback, NULL);
+    en50221_app_mmi_register_close_callback(mmi_resource, mmi_close_callback, NULL);
+    add_resource(EN50221_APP_MMI_RESOURCEID, (en50221_sl_resource_callback) en50221_app_mmi_message, mmi_resource);
+
+    en50221_sl_register_lookup_callback(sl, lookup_callback, sl);
+    en50221_sl_register_session_callback(sl, session_callback, sl);
+
+    ca_pmt_length = build_ca_pmt(ca_pmt_query, CA_PMT_CMD_ID_QUERY);
+    build_ca_pmt(ca_pmt_descramble, CA_PMT_CMD_ID_OK_DESCRAMBLING);
+
+    // session setup, with a fresh CAM each time
+    for (i = 0; i < setups; i++) {
+        start = now();
+        if ((emu = insert_cam(&host_fd)) == NULL)
+            exit(1);
+        times[i] = now() - start;
+        if (check_cam(emu, 0, 0) < 0) {
+            remove_cam(emu, host_fd);
+            exit(1);
+        }
+        if (i != (setups - 1))
+            remove_cam(emu, host_fd);
+    }
+    qsort(times, setups, sizeof(double), compare_doubles);
+    for (total = 0, i = 0; i < setups; i++)
+        total += times[i];
+    printf("session setup:        %6i  avg %8.1fus  min %8.1fus  max %8.1fus\n",
+           setups, total * 1e6 / setups, times[0] * 1e6, times[setups - 1] * 1e6);
+
+    // the menu
+    got_menu = 0;
+    got_close = 0;
+    if (en50221_app_ai_entermenu(ai_resource, ai_session_number) ||
+        wait_for(&got_menu, 1, "the menu"))
+        goto fail;
+    if (en50221_app_mmi_menu_answ(mmi_resource, mmi_session_number, 1) ||
+        wait_for(&got_close, 1, "close_mmi"))
+        goto fail;
+
+    // CA PMT round trips
+    pmt_replies = 0;
+    for (i = 0; i < queries; i++) {
+        start = now();
+        if (en50221_app_ca_pmt(ca_resource, ca_session_number, ca_pmt_query, ca_pmt_length) ||
+            wait_for(&pmt_replies, i + 1, "a ca_pmt_reply"))
+            goto fail;
+        times[i] = now() - start;
+    }
+    qsort(times, queries, sizeof(double), compare_doubles);
+    for (total = 0, i = 0; i < queries; i++)
+        total += times[i];
+    printf("ca_pmt round trip:    %6i  avg %8.1fus  p50 %8.1fus  p99 %8.1fus  max %8.1fus\n",
+           queries, total * 1e6 / queries, times[queries / 2] * 1e6,
+           times[(queries * 99) / 100] * 1e6, times[queries - 1] * 1e6);
+    count = queries;
+
+    // host to module: all the ok_descramblings at once, then a query to
+    // know they are in
+    start = now();
+    for (i = 0; i < queries; i++) {
+        if (en50221_app_ca_pmt(ca_resource, ca_session_number, ca_pmt_descramble, ca_pmt_length))
+            goto fail;
+    }
+    if (en50221_app_ca_pmt(ca_resource, ca_session_number, ca_pmt_query, ca_pmt_length) ||
+        wait_for(&pmt_replies, count + 1, "a ca_pmt_reply"))
+        goto fail;
+    total = now() - start;
+    printf("ca_pmt one-way:       %6i  %8.0f APDUs/s  %6.2f MB/s\n",
+           queries + 1, (queries + 1) / total, (queries + 1) * ca_pmt_length / total / 1e6);
+    count++;
+
+    // both ways
+    start = now();
+    for (i = 0; i < queries; i++) {
+        if (en50221_app_ca_pmt(ca_resource, ca_session_number, ca_pmt_query, ca_pmt_length))
+            goto fail;
+    }
+    if (wait_for(&pmt_replies, count + queries, "ca_pmt_replies"))
+        goto fail;
+    total = now() - start;
+    printf("ca_pmt query queued:  %6i  %8.0f APDUs/s\n", queries, 2 * queries / total);
+    count += queries;
+
+    if (check_cam(emu, queries * 3 + 1, queries * 2 + 1) < 0)
+        goto fail;
+    camemu_get_stats(emu, &stats);
+    if (stats.menu_answers != 1) {
+        fprintf(stderr, "The CAM got %u menu answers\n", stats.menu_answers);
+        goto fail;
+    }
+    printf("last CAM:             %u frames in, %u out, %u APDUs in, %u out\n",
+           stats.frames_in, stats.frames_out, stats.apdus_in, stats.apdus_out);
+
+    remove_cam(emu, host_fd);
+    en50221_app_mmi_destroy(mmi_resource);
+    en50221_app_ca_destroy(ca_resource);
+    en50221_app_ai_destroy(ai_resource);
+    en50221_app_datetime_destroy(datetime_resource);
+    en50221_app_rm_destroy(rm_resource);
+    en50221_sl_destroy(sl);
+    en50221_tl_destroy(tl);
+    free(times);
+    return 0;
+
+fail:
+    remove_cam(emu, host_fd);
+    exit(1);
+}
+
+int lookup_callback(void *arg, uint8_t slot_id, uint32_t requested_resource_id,
+                    en50221_sl_resource_callback *callback_out, void **arg_out, uint32_t *connected_resource_id)
+{
+    struct en50221_app_public_resource_id resid;
+    int i;
+    (void)arg;
+    (void)slot_id;
+
+    if (en50221_app_decode_public_resource_id(&resid, requested_resource_id) == NULL)
+        return -1;
+
+    for(i=0; i<resources_count; i++) {
+        if ((resid.resource_class == resources[i].resid.resource_class) &&
+            (resid.resource_type == resources[i].resid.resource_type)) {
+            *callback_out = resources[i].callback;
+            *arg_out = resources[i].arg;
+            *connected_resource_id = resources[i].binary_resource_id;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int session_callback(void *arg, int reason, uint8_t slot_id, uint16_t session_number, uint32_t resource_id)
+{
+    (void)arg;
+    (void)slot_id;
+
+    if (reason != S_SCALLBACK_REASON_CAMCONNECTED)
+        return 0;
+
+    if (resource_id == EN50221_APP_RM_RESOURCEID) {
+        en50221_app_rm_enq(rm_resource, session_number);
+    } else if (resource_id == EN50221_APP_AI_RESOURCEID) {
+        ai_session_number = session_number;
+        en50221_app_ai_enquiry(ai_resource, session_number);
+    } else if (resource_id == EN50221_APP_CA_RESOURCEID) {
+        ca_session_number = session_number;
+        en50221_app_ca_info_enq(ca_resource, session_number);
+    } else if (resource_id == EN50221_APP_MMI_RESOURCEID) {
+        mmi_session_number = session_number;
+    }
+    return 0;
+}
+
+int rm_enq_callback(void *arg, uint8_t slot_id, uint16_t session_number)
+{
+    (void)arg;
+    (void)slot_id;
+
+    return en50221_app_rm_reply(rm_resource, session_number, host_resource_ids_count, host_resource_ids);
+}
+
+int rm_reply_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t resource_id_count, uint32_t *resource_ids)
+{
+    (void)arg;
+    (void)slot_id;
+    (void)resource_id_count;
+    (void)resource_ids;
+
+    return en50221_app_rm_changed(rm_resource, session_number);
+}
+
+int rm_changed_callback(void *arg, uint8_t slot_id, uint16_t session_number)
+{
+    (void)arg;
+    (void)slot_id;
+
+    return en50221_app_rm_enq(rm_resource, session_number);
+}
+
+int datetime_enquiry_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint8_t response_interval)
+{
+    (void)arg;
+    (void)slot_id;
+    (void)response_interval;
+
+    got_datetime_enquiry++;
+    return en50221_app_datetime_send(datetime_resource, session_number, time(NULL), -1);
+}
+
+int ai_callback(void *arg, uint8_t slot_id, uint16_t session_number,
+                uint8_t application_type, uint16_t application_manufacturer,
+                uint16_t manufacturer_code, uint8_t menu_string_length,
+                uint8_t *menu_string)
+{
+    (void)arg;
+    (void)slot_id;
+    (void)session_number;
+    (void)application_type;
+
+    if ((application_manufacturer != CAMEMU_MANUFACTURER) ||
+        (manufacturer_code != CAMEMU_MANUFACTURER_CODE) ||
+        (menu_string_length != strlen(CAMEMU_MENU_TITLE)) ||
+        memcmp(menu_string, CAMEMU_MENU_TITLE, menu_string_length)) {
+        fprintf(stderr, "Bad application_info\n");
+        return -1;
+    }
+    got_app_info++;
+    return 0;
+}
+
+int ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t ca_id_count, uint16_t *ca_ids)
+{
+    static const uint16_t expected[CAMEMU_CA_ID_COUNT] = CAMEMU_CA_IDS;
+    uint32_t i;
+    (void)arg;
+    (void)slot_id;
+    (void)session_number;
+
+    if (ca_id_count != CAMEMU_CA_ID_COUNT) {
+        fprintf(stderr, "Bad ca_info: %u ids\n", ca_id_count);
+        return -1;
+    }
+    for (i = 0; i < ca_id_count; i++) {
+        if (ca_ids[i] != expected[i]) {
+            fprintf(stderr, "Bad ca_info: id %04x\n", ca_ids[i]);
+            return -1;
+        }
+    }
+    got_ca_info++;
+    return 0;
+}
+
+int ca_pmt_reply_callback(void *arg, uint8_t slot_id, uint16_t session_number,
+                          struct en50221_app_pmt_reply *reply, uint32_t reply_size)
+{
+    struct en50221_app_pmt_stream *pos;
+    int streams = 0;
+    (void)arg;
+    (void)slot_id;
+    (void)session_number;
+
+    pmt_replies++;
+    if ((reply->program_number != 0x012c) || !reply->CA_enable_flag) {
+        bad_replies++;
+        return 0;
+    }
+    en50221_app_pmt_reply_streams_for_each(reply, pos, reply_size) {
+        if ((pos->es_pid != (0x100 + streams)) || !pos->CA_enable_flag)
+            bad_replies++;
+        streams++;
+    }
+    if (streams != 4)
+        bad_replies++;
+    return 0;
+}
+
+int mmi_menu_callback(void *arg, uint8_t slot_id, uint16_t session_number,
+                      struct en50221_app_mmi_text *title,
+                      struct en50221_app_mmi_text *sub_title,
+                      struct en50221_app_mmi_text *bottom,
+                      uint32_t item_count, struct en50221_app_mmi_text *items,
+                      uint32_t item_raw_length, uint8_t *items_raw)
+{
+    (void)arg;
+    (void)slot_id;
+    (void)session_number;
+    (void)sub_title;
+    (void)bottom;
+    (void)items;
+    (void)item_raw_length;
+    (void)items_raw;
+
+    if ((title->text_length != strlen(CAMEMU_MENU_TITLE)) ||
+        memcmp(title->text, CAMEMU_MENU_TITLE, title->text_length) ||
+        (item_count != CAMEMU_MENU_ITEMS)) {
+        fprintf(stderr, "Bad menu\n");
+        return -1;
+    }
+    got_menu++;
+    return 0;
+}
+
+int mmi_close_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint8_t cmd_id, uint8_t delay)
+{
+    (void)arg;
+    (void)slot_id;
+    (void)session_number;
+    (void)cmd_id;
+    (void)delay;
+
+    got_close++;
+    return 0;
+}
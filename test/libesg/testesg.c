@@ -30,6 +30,7 @@
 #include <libesg/encapsulation/fragment_management_information.h>
 #include <libesg/encapsulation/data_repository.h>
 #include <libesg/encapsulation/string_repository.h>
+#include <libesg/encapsulation/fragment_store.h>
 #include <libesg/representation/encapsulated_textual_esg_xml_fragment.h>
 #include <libesg/representation/init_message.h>
 #include <libesg/representation/textual_decoder_init.h>
@@ -42,6 +43,7 @@ void usage(void) {
   static const char *_usage =
     "Usage: testesg [-a <ESGAccessDescriptor>]\n"
     "               [-c <ESGContainer with Textual ESG XML Fragment>]\n"
+    "               [-s <workers> <ESGContainer>...]\n"
     "               [-X XXXX]\n";
 
   fprintf(stderr, "%s", _usage);
@@ -77,12 +79,13 @@ void read_from_file(const char *filename, char **buffer, int *size) {
 int main(int argc, char *argv[]) {
 	char access_descriptor_filename[MAX_FILENAME] = "";
 	char container_filename[MAX_FILENAME] = "";
+	int workers = -1;
 	int c;
 	char *buffer = NULL;
 	int size;
 
 	// Read command line options
-	while ((c = getopt(argc, argv, "a:c:")) != -1) {
+	while ((c = getopt(argc, argv, "a:c:s:")) != -1) {
 		switch (c) {
 			case 'a':
 				strncpy(access_descriptor_filename, optarg, MAX_FILENAME);
@@ -90,6 +93,9 @@ int main(int argc, char *argv[]) {
 			case 'c':
 				strncpy(container_filename, optarg, MAX_FILENAME);
 				break;
+			case 's':
+				workers = atoi(optarg);
+				break;
 			default:
 				usage();
 		}
@@ -559,5 +565,44 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	// ESGContainers applied to a fragment store as one batch
+	if (workers >= 0) {
+		int count = argc - optind;
+		uint8_t *buffers[count ? count : 1];
+		uint32_t sizes[count ? count : 1];
+		int changes;
+		int failed;
+		int i;
+
+		fprintf(stdout, "**************************************************\n");
+		fprintf(stdout, "Batch decoding %d ESG Containers with %d workers\n", count, workers);
+		fprintf(stdout, "**************************************************\n\n");
+
+		struct esg_fragment_store *store = esg_fragment_store_create(NULL, NULL);
+		if ((store == NULL) || esg_fragment_store_set_workers(store, workers)) {
+			fprintf(stderr, "ESG Fragment Store create error\n");
+			exit(1);
+		}
+
+		for (i = 0; i < count; i++) {
+			read_from_file(argv[optind + i], &buffer, &size);
+			buffers[i] = (uint8_t *) buffer;
+			sizes[i] = size;
+		}
+
+		changes = esg_fragment_store_decode_batch(store, buffers, sizes, count, &failed);
+		if (changes < 0) {
+			fprintf(stderr, "ESG Fragment Store decode error\n");
+			exit(1);
+		}
+		fprintf(stdout, "Fragments added or updated %d\n", changes);
+		fprintf(stdout, "Containers not decoded %d\n", failed);
+
+		esg_fragment_store_free(store);
+		for (i = 0; i < count; i++) {
+			free(buffers[i]);
+		}
+	}
+
 	return 0;
 }
@@ -0,0 +1,654 @@
+/*
+ * pipeline benchmark: times the whole receive path, stage by stage.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/*
+ * Every chunk of the stream goes through each stage in turn, in one thread:
+ *
+ *  generate  dvbtsgen_generate() makes the packets
+ *  parse     transport_packet_batch_extract() over the chunk
+ *  demux     dvbswdemux_feed() with section filters on the PSI/SI PIDs;
+ *            the sections are copied out for the next stage
+ *  decode    section_decoder_decode() of each section
+ *  pes       pes_reasm_add_packets() on the video and audio PIDs
+ *  remux     the PIDs of the kept services are renumbered, the rest and
+ *            the null packets dropped, compacting the chunk in place
+ *  output    write() to a file and/or send() to a UDP socket, seven
+ *            packets per datagram
+ *
+ * Wall and thread CPU time are taken at each boundary, giving per stage
+ * throughput, CPU use, and latency percentiles over the chunks.
+ */
+
+#include <libdvbtsgen/dvbtsgen.h>
+#include <libdvbswdemux/dvbswdemux.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/section_decoder.h>
+#include <libucsi/pes_reasm.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/socket.h>
+
+#define DEFAULT_PACKETS		1000000
+#define DEFAULT_CHUNK		348
+#define DEFAULT_SERVICES	8
+#define DEFAULT_KEEP		2
+#define DEFAULT_THRESHOLD	10
+#define UDP_PACKETS		7
+
+/* the PIDs dvbtsgen uses */
+#define GEN_PMT_PID(n)		(0x0100 + (n))
+#define GEN_VIDEO_PID(n)	(0x1000 + (2 * (n)))
+#define GEN_AUDIO_PID(n)	(0x1001 + (2 * (n)))
+
+/* where the remux puts the kept services */
+#define OUT_PMT_PID(n)		(0x0020 + (n))
+#define OUT_VIDEO_PID(n)	(0x0200 + (2 * (n)))
+#define OUT_AUDIO_PID(n)	(0x0201 + (2 * (n)))
+
+#define PID_DROP		0xffff
+#define SECTION_QUEUE_BYTES	(256 * 1024)
+
+enum stage {
+	STAGE_GENERATE,
+	STAGE_PARSE,
+	STAGE_DEMUX,
+	STAGE_DECODE,
+	STAGE_PES,
+	STAGE_REMUX,
+	STAGE_OUTPUT,
+	STAGE_COUNT,
+};
+
+static const char *stage_names[STAGE_COUNT] = {
+	[STAGE_GENERATE] = "generate",
+	[STAGE_PARSE] = "parse",
+	[STAGE_DEMUX] = "demux",
+	[STAGE_DECODE] = "decode",
+	[STAGE_PES] = "pes",
+	[STAGE_REMUX] = "remux",
+	[STAGE_OUTPUT] = "output",
+};
+
+struct stage_time {
+	uint64_t wall;			/* ns, over the run */
+	uint64_t cpu;
+	uint32_t *latency;		/* ns, per chunk */
+};
+
+/* sections copied out of the demux, for the decode stage */
+struct section_queue {
+	uint8_t buf[SECTION_QUEUE_BYTES];
+	int pos;
+	int pids[SECTION_QUEUE_BYTES / 8];
+	int offsets[SECTION_QUEUE_BYTES / 8];
+	int count;
+	unsigned long dropped;
+};
+
+struct counts {
+	unsigned long sections;
+	unsigned long decoded;
+	unsigned long invalid;
+	unsigned long pes;
+	unsigned long pes_bytes;
+	unsigned long packets_out;
+	unsigned long datagrams;
+	unsigned long errors;
+};
+
+static unsigned long sink;
+static struct section_queue queue;
+static struct counts counts;
+static uint16_t pid_map[TRANSPORT_MAX_PIDS];
+
+static uint64_t clock_ns(clockid_t clk)
+{
+	struct timespec ts;
+
+	clock_gettime(clk, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static int queue_section(void *private_data, uint8_t *data, int len)
+{
+	int pid = (int) (long) private_data;
+
+	if ((queue.pos + len) > SECTION_QUEUE_BYTES) {
+		queue.dropped++;
+		return 0;
+	}
+	memcpy(queue.buf + queue.pos, data, len);
+	queue.pids[queue.count] = pid;
+	queue.offsets[queue.count++] = queue.pos;
+	queue.pos += len;
+	counts.sections++;
+	return 0;
+}
+
+static void *pat_codec(struct section_ext *ext)
+{
+	return mpeg_pat_section_codec(ext);
+}
+
+static void *pmt_codec(struct section_ext *ext)
+{
+	return mpeg_pmt_section_codec(ext);
+}
+
+static void *nit_codec(struct section_ext *ext)
+{
+	return dvb_nit_section_codec(ext);
+}
+
+static void *sdt_codec(struct section_ext *ext)
+{
+	return dvb_sdt_section_codec(ext);
+}
+
+static void *eit_codec(struct section_ext *ext)
+{
+	return dvb_eit_section_codec(ext);
+}
+
+static section_decoder_codec codec_for(int pid)
+{
+	switch (pid) {
+	case TRANSPORT_PAT_PID:
+		return pat_codec;
+	case TRANSPORT_NIT_PID:
+		return nit_codec;
+	case TRANSPORT_SDT_PID:
+		return sdt_codec;
+	case TRANSPORT_EIT_PID:
+		return eit_codec;
+	}
+	return pmt_codec;
+}
+
+static void decode_sections(struct section_decoder *decoder)
+{
+	uint8_t *section;
+	int i, len, repeat;
+
+	for (i = 0; i < queue.count; i++) {
+		section = queue.buf + queue.offsets[i];
+		len = (i + 1 < queue.count ? queue.offsets[i + 1] : queue.pos) - queue.offsets[i];
+		if (section_decoder_decode(decoder, queue.pids[i], section, len,
+					   codec_for(queue.pids[i]), &repeat) == NULL) {
+			counts.invalid++;
+			continue;
+		}
+		if (!repeat)
+			counts.decoded++;
+	}
+	queue.pos = 0;
+	queue.count = 0;
+}
+
+static void pes_packet(void *private, const struct pes_packet_info *info,
+		       const struct iovec *iov, int iovcnt)
+{
+	(void) private;
+	(void) iov;
+	(void) iovcnt;
+
+	sink += info->pts;
+	counts.pes++;
+	counts.pes_bytes += info->payload_length;
+}
+
+static void parse_chunk(uint8_t *buf, int len, struct transport_packet_batch *batch)
+{
+	int pos = 0, used, i;
+
+	while (pos < len) {
+		used = transport_packet_batch_extract(buf + pos, len - pos, batch);
+		if (used == 0) {
+			counts.errors++;
+			pos += TRANSPORT_PACKET_LENGTH;
+			continue;
+		}
+		for (i = 0; i < batch->count; i++)
+			sink += batch->pid[i] + batch->payload_offset[i];
+		pos += used;
+	}
+}
+
+/*
+ * A PID table remux in the manner of gnutv's, without regenerating the PSI:
+ * the PAT keeps listing every service.
+ */
+static int remux_chunk(uint8_t *buf, int len)
+{
+	uint8_t *in, *out = buf;
+	int pid, out_pid;
+
+	for (in = buf; in < buf + len; in += TRANSPORT_PACKET_LENGTH) {
+		pid = transport_packet_pid((struct transport_packet *) in);
+		if ((out_pid = pid_map[pid]) == PID_DROP)
+			continue;
+		if (out != in)
+			memcpy(out, in, TRANSPORT_PACKET_LENGTH);
+		if (out_pid != pid) {
+			out[1] = (out[1] & 0xe0) | (out_pid >> 8);
+			out[2] = out_pid & 0xff;
+		}
+		out += TRANSPORT_PACKET_LENGTH;
+	}
+	counts.packets_out += (out - buf) / TRANSPORT_PACKET_LENGTH;
+	return out - buf;
+}
+
+static void output_chunk(uint8_t *buf, int len, int fd, int sock)
+{
+	int pos, size;
+
+	if ((fd >= 0) && (write(fd, buf, len) != len))
+		counts.errors++;
+	if (sock < 0)
+		return;
+	for (pos = 0; pos < len; pos += size) {
+		size = len - pos;
+		if (size > UDP_PACKETS * TRANSPORT_PACKET_LENGTH)
+			size = UDP_PACKETS * TRANSPORT_PACKET_LENGTH;
+		/* with nobody listening, an ICMP error fails every other send */
+		if ((send(sock, buf + pos, size, 0) != size) && (errno != ECONNREFUSED))
+			counts.errors++;
+		else
+			counts.datagrams++;
+	}
+}
+
+static int open_udp(const char *spec)
+{
+	struct addrinfo hints, *ai;
+	char host[256];
+	const char *port;
+	int sock;
+
+	if (((port = strrchr(spec, ':')) == NULL) || ((port - spec) >= (int) sizeof(host)))
+		return -1;
+	memcpy(host, spec, port - spec);
+	host[port - spec] = 0;
+	port++;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, port, &hints, &ai))
+		return -1;
+	if ((sock = socket(ai->ai_family, SOCK_DGRAM, 0)) < 0) {
+		freeaddrinfo(ai);
+		return -1;
+	}
+	if (connect(sock, ai->ai_addr, ai->ai_addrlen) < 0) {
+		close(sock);
+		sock = -1;
+	}
+	freeaddrinfo(ai);
+	return sock;
+}
+
+
+static int uint32_cmp(const void *a, const void *b)
+{
+	uint32_t va = *(const uint32_t *) a;
+	uint32_t vb = *(const uint32_t *) b;
+
+	return (va > vb) - (va < vb);
+}
+
+/* the latencies are sorted in place */
+static double percentile_us(uint32_t *v, int n, int permille)
+{
+	int k = ((n * permille) + 999) / 1000 - 1;
+
+	if (k < 0)
+		k = 0;
+	return v[k] / 1000.0;
+}
+
+static void print_stage(const char *name, struct stage_time *t, int chunks,
+			uint64_t packets, uint64_t total_wall)
+{
+	double secs = t->wall / 1e9;
+
+	qsort(t->latency, chunks, sizeof(uint32_t), uint32_cmp);
+	printf("%-10s %12.0f %9.1f %9.1f %9.1f %9.1f %9.2f %6.1f%%\n", name,
+	       secs > 0 ? packets / secs : 0,
+	       percentile_us(t->latency, chunks, 500),
+	       percentile_us(t->latency, chunks, 990),
+	       percentile_us(t->latency, chunks, 999),
+	       t->latency[chunks - 1] / 1000.0,
+	       (double) t->cpu / packets,
+	       total_wall ? (t->cpu * 100.0) / total_wall : 0);
+}
+
+static int save_results(const char *filename, struct stage_time *stages,
+			struct stage_time *total, uint64_t packets)
+{
+	FILE *f;
+	int i;
+
+	if ((f = fopen(filename, "w")) == NULL)
+		return -1;
+	for (i = 0; i < STAGE_COUNT; i++)
+		fprintf(f, "%s %.3f\n", stage_names[i], (double) stages[i].wall / packets);
+	fprintf(f, "total %.3f\n", (double) total->wall / packets);
+	return fclose(f);
+}
+
+/*
+ * Compare against a file written by -s. Returns the number of stages which
+ * got slower by more than threshold percent, or -1 on error.
+ */
+static int compare_results(const char *filename, int threshold, struct stage_time *stages,
+			   struct stage_time *total, uint64_t packets)
+{
+	char name[32];
+	double ns, now;
+	FILE *f;
+	int regressed = 0;
+	int i;
+
+	if ((f = fopen(filename, "r")) == NULL)
+		return -1;
+	printf("\n%-10s %12s %12s %8s\n", "stage", "base ns/pkt", "ns/pkt", "change");
+	while (fscanf(f, "%31s %lf", name, &ns) == 2) {
+		if (!strcmp(name, "total")) {
+			now = (double) total->wall / packets;
+		} else {
+			for (i = 0; i < STAGE_COUNT; i++)
+				if (!strcmp(stage_names[i], name))
+					break;
+			if (i == STAGE_COUNT)
+				continue;
+			now = (double) stages[i].wall / packets;
+		}
+		printf("%-10s %12.2f %12.2f %+7.1f%%", name, ns, now,
+		       ns > 0 ? ((now - ns) * 100.0) / ns : 0);
+		if (now > (ns * (100 + threshold)) / 100) {
+			printf("  REGRESSED");
+			regressed++;
+		}
+		printf("\n");
+	}
+	fclose(f);
+	return regressed;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Syntax: benchpipe [<options>]\n"
+		" -n <packets>   Number of packets to run through (default %i)\n"
+		" -c <packets>   Packets per chunk (default %i)\n"
+		" -S <services>  Services in the generated mux (default %i)\n"
+		" -r <bit/s>     Mux rate of the generated stream (default dvbtsgen's)\n"
+		" -e <events>    EIT schedule events per service (default present/following only)\n"
+		" -k <services>  Services kept by the remux (default %i)\n"
+		" -o <file>      Write the remuxed stream to a file (default /dev/null)\n"
+		" -u <host:port> Also send it to a UDP destination\n"
+		" -s <file>      Save the results\n"
+		" -b <file>      Compare against saved results, failing on a regression\n"
+		" -t <percent>   Slowdown counted as a regression (default %i)\n",
+		DEFAULT_PACKETS, DEFAULT_CHUNK, DEFAULT_SERVICES, DEFAULT_KEEP, DEFAULT_THRESHOLD);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct transport_packet_batch batch;
+	static struct stage_time stages[STAGE_COUNT], total;
+	struct dvbtsgen_config config;
+	struct dvbtsgen *gen;
+	struct dvbswdemux *demux;
+	struct section_decoder *decoder;
+	struct pes_reasm *pes;
+	uint8_t filter[18], mask[18];
+	uint8_t *buf;
+	char *outfile = "/dev/null", *udp = NULL, *savefile = NULL, *basefile = NULL;
+	int packets = DEFAULT_PACKETS, chunk = DEFAULT_CHUNK, keep = DEFAULT_KEEP;
+	int threshold = DEFAULT_THRESHOLD;
+	int fd, sock = -1, status = 0;
+	int chunks, n, len, opt, pid, i, s;
+	uint64_t wall[STAGE_COUNT + 1], cpu[STAGE_COUNT + 1];
+	uint64_t done = 0;
+
+	memset(&config, 0, sizeof(config));
+	config.services = DEFAULT_SERVICES;
+
+	while ((opt = getopt(argc, argv, "n:c:S:r:e:k:o:u:s:b:t:")) != -1) {
+		switch (opt) {
+		case 'n':
+			packets = atoi(optarg);
+			break;
+		case 'c':
+			chunk = atoi(optarg);
+			break;
+		case 'S':
+			config.services = atoi(optarg);
+			break;
+		case 'r':
+			config.bitrate = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			config.eit_events = atoi(optarg);
+			break;
+		case 'k':
+			keep = atoi(optarg);
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		case 'u':
+			udp = optarg;
+			break;
+		case 's':
+			savefile = optarg;
+			break;
+		case 'b':
+			basefile = optarg;
+			break;
+		case 't':
+			threshold = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind != argc) || (packets < 1) || (chunk < 1) || (keep < 0) ||
+	    (config.services < 1) || (config.services > DVBTSGEN_MAX_SERVICES))
+		usage();
+	if (keep > config.services)
+		keep = config.services;
+	if (OUT_PMT_PID(keep) > OUT_VIDEO_PID(0)) {
+		fprintf(stderr, "Too many services kept\n");
+		exit(1);
+	}
+
+	if ((gen = dvbtsgen_create(&config)) == NULL) {
+		fprintf(stderr, "Unable to create the generator (needs %llu bit/s)\n",
+			(unsigned long long) dvbtsgen_required_bitrate(&config));
+		exit(1);
+	}
+	if (((demux = dvbswdemux_create()) == NULL) ||
+	    ((decoder = section_decoder_create(0)) == NULL) ||
+	    ((pes = pes_reasm_create(2 * config.services, 1024 * 1024, 0)) == NULL)) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	if ((fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		perror(outfile);
+		exit(1);
+	}
+	if (udp && ((sock = open_udp(udp)) < 0)) {
+		fprintf(stderr, "Unable to open UDP destination %s\n", udp);
+		exit(1);
+	}
+
+	/* every section on the PSI/SI PIDs, and the PES of every service */
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	dvbswdemux_add_section_filter(demux, TRANSPORT_PAT_PID, filter, mask, 1,
+				      queue_section, (void *) (long) TRANSPORT_PAT_PID);
+	dvbswdemux_add_section_filter(demux, TRANSPORT_NIT_PID, filter, mask, 1,
+				      queue_section, (void *) (long) TRANSPORT_NIT_PID);
+	dvbswdemux_add_section_filter(demux, TRANSPORT_SDT_PID, filter, mask, 1,
+				      queue_section, (void *) (long) TRANSPORT_SDT_PID);
+	dvbswdemux_add_section_filter(demux, TRANSPORT_EIT_PID, filter, mask, 1,
+				      queue_section, (void *) (long) TRANSPORT_EIT_PID);
+	for (s = 0; s < config.services; s++) {
+		dvbswdemux_add_section_filter(demux, GEN_PMT_PID(s), filter, mask, 1,
+					      queue_section, (void *) (long) GEN_PMT_PID(s));
+		pes_reasm_add_pid(pes, GEN_VIDEO_PID(s));
+		pes_reasm_add_pid(pes, GEN_AUDIO_PID(s));
+	}
+
+	/* the remux keeps the SI and the first services */
+	for (pid = 0; pid < TRANSPORT_MAX_PIDS; pid++)
+		pid_map[pid] = PID_DROP;
+	for (pid = 0; pid < 0x20; pid++)
+		pid_map[pid] = pid;
+	for (s = 0; s < keep; s++) {
+		pid_map[GEN_PMT_PID(s)] = OUT_PMT_PID(s);
+		pid_map[GEN_VIDEO_PID(s)] = OUT_VIDEO_PID(s);
+		pid_map[GEN_AUDIO_PID(s)] = OUT_AUDIO_PID(s);
+	}
+
+	chunks = (packets + chunk - 1) / chunk;
+	if ((buf = malloc((size_t) chunk * TRANSPORT_PACKET_LENGTH)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	for (i = 0; i < STAGE_COUNT; i++)
+		if ((stages[i].latency = malloc(chunks * sizeof(uint32_t))) == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	if ((total.latency = malloc(chunks * sizeof(uint32_t))) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	for (i = 0; i < chunks; i++) {
+		n = packets - (i * chunk);
+		if (n > chunk)
+			n = chunk;
+		len = n * TRANSPORT_PACKET_LENGTH;
+
+		wall[0] = clock_ns(CLOCK_MONOTONIC);
+		cpu[0] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		dvbtsgen_generate(gen, buf, n);
+		wall[1] = clock_ns(CLOCK_MONOTONIC);
+		cpu[1] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		parse_chunk(buf, len, &batch);
+		wall[2] = clock_ns(CLOCK_MONOTONIC);
+		cpu[2] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		dvbswdemux_feed(demux, buf, len);
+		wall[3] = clock_ns(CLOCK_MONOTONIC);
+		cpu[3] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		decode_sections(decoder);
+		wall[4] = clock_ns(CLOCK_MONOTONIC);
+		cpu[4] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		pes_reasm_add_packets(pes, buf, len, pes_packet, NULL);
+		wall[5] = clock_ns(CLOCK_MONOTONIC);
+		cpu[5] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		len = remux_chunk(buf, len);
+		wall[6] = clock_ns(CLOCK_MONOTONIC);
+		cpu[6] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		output_chunk(buf, len, fd, sock);
+		wall[7] = clock_ns(CLOCK_MONOTONIC);
+		cpu[7] = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+
+		for (s = 0; s < STAGE_COUNT; s++) {
+			stages[s].wall += wall[s + 1] - wall[s];
+			stages[s].cpu += cpu[s + 1] - cpu[s];
+			stages[s].latency[i] = wall[s + 1] - wall[s];
+		}
+		total.wall += wall[STAGE_COUNT] - wall[0];
+		total.cpu += cpu[STAGE_COUNT] - cpu[0];
+		total.latency[i] = wall[STAGE_COUNT] - wall[0];
+		done += n;
+	}
+	pes_reasm_flush(pes, pes_packet, NULL);
+
+	printf("synthetic: %llu packets in chunks of %i, %i services (%i kept)\n",
+	       (unsigned long long) done, chunk, config.services, keep);
+	printf("%-10s %12s %9s %9s %9s %9s %9s %7s\n", "stage", "packets/s",
+	       "p50 us", "p99 us", "p99.9 us", "max us", "cpu ns/pkt", "cpu");
+	for (s = 0; s < STAGE_COUNT; s++)
+		print_stage(stage_names[s], &stages[s], chunks, done, total.wall);
+	print_stage("total", &total, chunks, done, total.wall);
+	printf("\n%lu sections (%lu decoded, %lu invalid, %lu not queued), "
+	       "%lu PES packets (%lu bytes)\n",
+	       counts.sections, counts.decoded, counts.invalid, queue.dropped,
+	       counts.pes, counts.pes_bytes);
+	printf("%lu packets out, %lu datagrams, %lu errors\n",
+	       counts.packets_out, counts.datagrams, counts.errors);
+	if (counts.errors || counts.invalid)
+		status = 1;
+
+	if (savefile && save_results(savefile, stages, &total, done)) {
+		fprintf(stderr, "Unable to save results to %s\n", savefile);
+		status = 1;
+	}
+	if (basefile) {
+		switch (compare_results(basefile, threshold, stages, &total, done)) {
+		case -1:
+			fprintf(stderr, "Unable to read results from %s\n", basefile);
+			status = 1;
+			break;
+		case 0:
+			break;
+		default:
+			status = 1;
+			break;
+		}
+	}
+
+	for (i = 0; i < STAGE_COUNT; i++)
+		free(stages[i].latency);
+	free(total.latency);
+	free(buf);
+	if (sock >= 0)
+		close(sock);
+	close(fd);
+	pes_reasm_destroy(pes);
+	section_decoder_destroy(decoder);
+	dvbswdemux_destroy(demux);
+	dvbtsgen_destroy(gen);
+
+	return (sink == 0xdeadbeef) ? 2 : status;
+}
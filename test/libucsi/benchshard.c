@@ -0,0 +1,289 @@
+/*
+ * sharded demux benchmark: times dvbswdemux_shard against one dvbswdemux,
+ * and checks they give the same results.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+/*
+ * A big mux from dvbtsgen is demuxed once with a single dvbswdemux and once
+ * with a dvbswdemux_shard, with section filters on the PSI/SI PIDs and PES
+ * filters on every video and audio PID. Each callback runs a CRC over what
+ * it is given, carried on from the last call for the PID, so the results
+ * only match if every PID saw the same data in the same order. -m moves a
+ * PID every so many packets on top of any rebalancing, to try that
+ * harder.
+ */
+
+#include <libdvbtsgen/dvbtsgen.h>
+#include <libdvbswdemux/dvbswdemux.h>
+#include <libdvbswdemux/dvbswdemux_shard.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/crc32.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#define DEFAULT_PACKETS		400000
+#define DEFAULT_SERVICES	64
+#define DEFAULT_CHUNK		348
+
+/* the PIDs dvbtsgen uses */
+#define GEN_PMT_PID(n)		(0x0100 + (n))
+#define GEN_VIDEO_PID(n)	(0x1000 + (2 * (n)))
+#define GEN_AUDIO_PID(n)	(0x1001 + (2 * (n)))
+
+struct pid_result {
+	unsigned long count;
+	unsigned long bytes;
+	uint32_t crc;
+};
+
+static struct pid_result results[2][TRANSPORT_MAX_PIDS];
+static int pids[TRANSPORT_MAX_PIDS];
+static int pid_count;
+
+static uint64_t clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int data_callback(void *private_data, uint8_t *data, int len)
+{
+	struct pid_result *r = private_data;
+
+	r->count++;
+	r->bytes += len;
+	r->crc = crc32(r->crc, data, len);
+	return 0;
+}
+
+/* the PSI/SI PIDs take sections, the others PES */
+static int pid_is_psi(int pid)
+{
+	return pid < GEN_VIDEO_PID(0);
+}
+
+static double run_single(uint8_t *buf, int packets, int chunk)
+{
+	struct dvbswdemux *demux;
+	uint8_t filter[18], mask[18];
+	uint64_t start;
+	int i;
+
+	if ((demux = dvbswdemux_create()) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	for (i = 0; i < pid_count; i++) {
+		if (pid_is_psi(pids[i]))
+			dvbswdemux_add_section_filter(demux, pids[i], filter, mask, 1,
+						      data_callback, &results[0][pids[i]]);
+		else
+			dvbswdemux_add_pes_filter(demux, pids[i], data_callback, &results[0][pids[i]]);
+	}
+
+	start = clock_ns();
+	for (i = 0; i < packets; i += chunk) {
+		int n = (packets - i) < chunk ? (packets - i) : chunk;
+
+		dvbswdemux_feed(demux, buf + (i * TRANSPORT_PACKET_LENGTH), n * TRANSPORT_PACKET_LENGTH);
+	}
+	start = clock_ns() - start;
+
+	dvbswdemux_destroy(demux);
+	return start / 1e9;
+}
+
+static double run_sharded(uint8_t *buf, int packets, int chunk, int shards, int queue_len,
+			  int rebalance, int move_every)
+{
+	struct dvbswdemux_shard *sd;
+	struct dvbswdemux_shard_stats stats;
+	uint8_t filter[18], mask[18];
+	uint64_t start;
+	unsigned long next_move = move_every;
+	unsigned int moves = 0;
+	int i;
+
+	if ((sd = dvbswdemux_shard_create(shards, queue_len, rebalance)) == NULL) {
+		fprintf(stderr, "Unable to create the sharded demux\n");
+		exit(1);
+	}
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	for (i = 0; i < pid_count; i++) {
+		if (pid_is_psi(pids[i]))
+			dvbswdemux_shard_add_section_filter(sd, pids[i], filter, mask, 1,
+							    data_callback, &results[1][pids[i]]);
+		else
+			dvbswdemux_shard_add_pes_filter(sd, pids[i], data_callback,
+							&results[1][pids[i]]);
+	}
+
+	start = clock_ns();
+	for (i = 0; i < packets; i += chunk) {
+		int n = (packets - i) < chunk ? (packets - i) : chunk;
+
+		dvbswdemux_shard_feed(sd, buf + (i * TRANSPORT_PACKET_LENGTH),
+				      n * TRANSPORT_PACKET_LENGTH);
+
+		if (move_every && ((unsigned long) (i + n) >= next_move)) {
+			int pid = pids[(moves * 7919) % pid_count];
+
+			dvbswdemux_shard_move_pid(sd, pid, (dvbswdemux_shard_of(sd, pid) + 1) %
+						  dvbswdemux_shard_count(sd));
+			next_move += move_every;
+			moves++;
+		}
+	}
+	dvbswdemux_shard_flush(sd);
+	start = clock_ns() - start;
+
+	dvbswdemux_shard_get_stats(sd, &stats);
+	printf("shards %i: %llu packets, %llu routed (",
+	       dvbswdemux_shard_count(sd), (unsigned long long) stats.packets,
+	       (unsigned long long) stats.routed);
+	for (i = 0; i < dvbswdemux_shard_count(sd); i++)
+		printf("%s%.1f%%", i ? " " : "",
+		       stats.routed ? (100.0 * dvbswdemux_shard_routed(sd, i)) / stats.routed : 0.0);
+	printf("), %llu moves, %llu waits\n",
+	       (unsigned long long) stats.moves, (unsigned long long) stats.waits);
+
+	dvbswdemux_shard_destroy(sd);
+	return start / 1e9;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Syntax: benchshard [<options>]\n"
+		" -n <packets>   Number of packets to run through (default %i)\n"
+		" -S <services>  Services in the generated mux (default %i)\n"
+		" -c <packets>   Packets per feed (default %i)\n"
+		" -j <shards>    Shards (default one per CPU)\n"
+		" -q <batches>   Queue length of each shard (default the library's)\n"
+		" -R             Leave rebalancing off\n"
+		" -m <packets>   Also move a PID every so many packets\n",
+		DEFAULT_PACKETS, DEFAULT_SERVICES, DEFAULT_CHUNK);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct dvbtsgen_config config;
+	struct dvbtsgen *gen;
+	uint8_t *buf;
+	int packets = DEFAULT_PACKETS, chunk = DEFAULT_CHUNK;
+	int shards = 0, queue_len = 0, rebalance = 1, move_every = 0;
+	int opt, i, pid;
+	int mismatches = 0;
+	double single, sharded;
+
+	memset(&config, 0, sizeof(config));
+	config.services = DEFAULT_SERVICES;
+
+	while ((opt = getopt(argc, argv, "n:S:c:j:q:Rm:")) != -1) {
+		switch (opt) {
+		case 'n':
+			packets = atoi(optarg);
+			break;
+		case 'S':
+			config.services = atoi(optarg);
+			break;
+		case 'c':
+			chunk = atoi(optarg);
+			break;
+		case 'j':
+			shards = atoi(optarg);
+			break;
+		case 'q':
+			queue_len = atoi(optarg);
+			break;
+		case 'R':
+			rebalance = 0;
+			break;
+		case 'm':
+			move_every = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind != argc) || (packets < 1) || (chunk < 1) || (shards < 0) || (move_every < 0) ||
+	    (config.services < 1) || (config.services > DVBTSGEN_MAX_SERVICES))
+		usage();
+
+	// a mux just big enough for the services, as several muxes aggregated would be
+	config.bitrate = (dvbtsgen_required_bitrate(&config) * 21) / 20;
+	if ((gen = dvbtsgen_create(&config)) == NULL) {
+		fprintf(stderr, "Unable to create the generator\n");
+		exit(1);
+	}
+	if ((buf = malloc((size_t) packets * TRANSPORT_PACKET_LENGTH)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	dvbtsgen_generate(gen, buf, packets);
+	dvbtsgen_destroy(gen);
+
+	pids[pid_count++] = TRANSPORT_PAT_PID;
+	pids[pid_count++] = TRANSPORT_NIT_PID;
+	pids[pid_count++] = TRANSPORT_SDT_PID;
+	pids[pid_count++] = TRANSPORT_EIT_PID;
+	for (i = 0; i < config.services; i++) {
+		pids[pid_count++] = GEN_PMT_PID(i);
+		pids[pid_count++] = GEN_VIDEO_PID(i);
+		pids[pid_count++] = GEN_AUDIO_PID(i);
+	}
+
+	single = run_single(buf, packets, chunk);
+	sharded = run_sharded(buf, packets, chunk, shards, queue_len, rebalance, move_every);
+
+	for (i = 0; i < pid_count; i++) {
+		pid = pids[i];
+		if ((results[0][pid].count != results[1][pid].count) ||
+		    (results[0][pid].bytes != results[1][pid].bytes) ||
+		    (results[0][pid].crc != results[1][pid].crc)) {
+			fprintf(stderr, "PID 0x%04x: %lu units %lu bytes crc %08x, "
+				"sharded %lu units %lu bytes crc %08x\n", pid,
+				results[0][pid].count, results[0][pid].bytes, results[0][pid].crc,
+				results[1][pid].count, results[1][pid].bytes, results[1][pid].crc);
+			mismatches++;
+		}
+	}
+
+	printf("%-8s %10.1f Mbit/s\n", "single",
+	       (packets * TRANSPORT_PACKET_LENGTH * 8.0) / (single * 1e6));
+	printf("%-8s %10.1f Mbit/s  (x%.2f)\n", "sharded",
+	       (packets * TRANSPORT_PACKET_LENGTH * 8.0) / (sharded * 1e6), single / sharded);
+	if (mismatches) {
+		fprintf(stderr, "%i PIDs differ\n", mismatches);
+		exit(1);
+	}
+	printf("results match over %i PIDs\n", pid_count);
+
+	free(buf);
+	return 0;
+}
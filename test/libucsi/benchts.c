@@ -0,0 +1,803 @@
+/*
+ * transport stream benchmark: times libucsi's per-packet hot paths.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libucsi/crc32.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/section_buf.h>
+#include <libucsi/section_reasm.h>
+#include <libucsi/startcode.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+#endif
+
+#define DEFAULT_PACKETS		50000
+#define DEFAULT_PASSES		20
+#define DEFAULT_CRC_LENGTH	1024
+#define DEFAULT_THRESHOLD	10
+#define MAX_RESULTS		16
+
+/* the PIDs of the synthetic stream */
+#define SYNTH_PSI_PID		0x0012
+#define SYNTH_VIDEO_PID		0x0100
+
+struct input {
+	uint8_t *buf;
+	int len;
+	int packets;
+	uint8_t psi[TRANSPORT_MAX_PIDS];	/* PIDs carrying sections */
+};
+
+struct result {
+	char name[32];
+	double ns;			/* per packet */
+};
+
+struct counts {
+	unsigned long sections;
+	unsigned long errors;
+};
+
+static unsigned long sink;
+static struct section_buf *section_bufs[TRANSPORT_MAX_PIDS];
+static struct result results[MAX_RESULTS];
+static int num_results;
+static int crc_length = DEFAULT_CRC_LENGTH;
+
+static const char *crc32_impl_names[] = {
+	[crc32_impl_auto] = "auto",
+	[crc32_impl_table] = "table",
+	[crc32_impl_slice8] = "slice8",
+	[crc32_impl_clmul] = "clmul",
+};
+
+static const char *startcode_impl_names[] = {
+	[startcode_impl_auto] = "auto",
+	[startcode_impl_scalar] = "scalar",
+	[startcode_impl_sse2] = "sse2",
+	[startcode_impl_avx2] = "avx2",
+	[startcode_impl_neon] = "neon",
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void)
+{
+#ifdef HAVE_CYCLES
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+
+/*
+ * Synthetic input: one PSI PID carrying back to back sections of varying
+ * length (so some fit in a single packet and others span several), a video
+ * PID with a PCR every eighth packet, and some null packets.
+ */
+static uint8_t *synth_sections(int size, int *starts, int *num_starts)
+{
+	uint8_t *s;
+	uint32_t crc;
+	int pos = 0, n = 0, len;
+
+	if ((s = malloc(size)) == NULL)
+		return NULL;
+	while ((pos + DVB_MAX_SECTION_BYTES) <= size) {
+		len = 16 + ((n * 379) % 1000);
+		starts[n++] = pos;
+
+		s[pos+0] = 0x4e;
+		s[pos+1] = 0xb0 | ((len - 3) >> 8);
+		s[pos+2] = (len - 3) & 0xff;
+		s[pos+3] = n >> 8;
+		s[pos+4] = n & 0xff;
+		s[pos+5] = 0xc1;
+		s[pos+6] = 0;
+		s[pos+7] = 0;
+		memset(s + pos + 8, n & 0xff, len - 12);
+		crc = crc32(CRC32_INIT, s + pos, len - 4);
+		s[pos+len-4] = crc >> 24;
+		s[pos+len-3] = crc >> 16;
+		s[pos+len-2] = crc >> 8;
+		s[pos+len-1] = crc;
+		pos += len;
+	}
+	*num_starts = n;
+	return s;
+}
+
+static int synth_input(struct input *in, int packets)
+{
+	int psi_size = ((packets / 4) + 1) * TRANSPORT_PACKET_LENGTH + (2 * DVB_MAX_SECTION_BYTES);
+	int *starts;
+	int num_starts, next = 0;
+	uint8_t *sections, *pkt;
+	uint8_t cc_psi = 0, cc_video = 0;
+	int pos = 0, i;
+
+	if ((starts = malloc(sizeof(int) * (psi_size / 16))) == NULL)
+		return -1;
+	if ((sections = synth_sections(psi_size, starts, &num_starts)) == NULL)
+		return -1;
+	if ((in->buf = malloc(packets * TRANSPORT_PACKET_LENGTH)) == NULL)
+		return -1;
+
+	for (i = 0; i < packets; i++) {
+		pkt = in->buf + (i * TRANSPORT_PACKET_LENGTH);
+		pkt[0] = TRANSPORT_PACKET_SYNC;
+
+		switch (i & 7) {
+		case 0:
+		case 4:
+			pkt[1] = SYNTH_PSI_PID >> 8;
+			pkt[2] = SYNTH_PSI_PID & 0xff;
+			while ((next < num_starts) && (starts[next] < pos))
+				next++;
+			if ((next < num_starts) && ((starts[next] - pos) <= 182)) {
+				pkt[1] |= 0x40;
+				pkt[3] = 0x10 | cc_psi;
+				pkt[4] = starts[next] - pos;
+				memcpy(pkt + 5, sections + pos, 183);
+				pos += 183;
+			} else if ((next < num_starts) && ((starts[next] - pos) == 183)) {
+				/* a one byte adaptation field keeps the next start out */
+				pkt[3] = 0x30 | cc_psi;
+				pkt[4] = 0;
+				memcpy(pkt + 5, sections + pos, 183);
+				pos += 183;
+			} else {
+				pkt[3] = 0x10 | cc_psi;
+				memcpy(pkt + 4, sections + pos, 184);
+				pos += 184;
+			}
+			cc_psi = (cc_psi + 1) & 0x0f;
+			break;
+
+		case 7:
+			pkt[1] = TRANSPORT_NULL_PID >> 8;
+			pkt[2] = TRANSPORT_NULL_PID & 0xff;
+			pkt[3] = 0x10;
+			memset(pkt + 4, 0xff, 184);
+			break;
+
+		default:
+			pkt[1] = SYNTH_VIDEO_PID >> 8;
+			pkt[2] = SYNTH_VIDEO_PID & 0xff;
+			memset(pkt + 4, i & 0xff, 184);
+			if ((i & 63) == 1) {
+				pkt[3] = 0x30 | cc_video;
+				pkt[4] = 7;
+				pkt[5] = transport_adaptation_flag_pcr;
+				pkt[6] = (i >> 17) & 0xff;
+				pkt[7] = (i >> 9) & 0xff;
+				pkt[8] = (i >> 1) & 0xff;
+				pkt[9] = ((i & 1) << 7) | 0x7e;
+				pkt[10] = 0;
+			} else {
+				pkt[3] = 0x10 | cc_video;
+			}
+			cc_video = (cc_video + 1) & 0x0f;
+			break;
+		}
+	}
+
+	in->len = packets * TRANSPORT_PACKET_LENGTH;
+	in->packets = packets;
+	in->psi[SYNTH_PSI_PID] = 1;
+
+	free(sections);
+	free(starts);
+	return 0;
+}
+
+/*
+ * Recorded input: the whole file is read into memory first, so only the
+ * code under test is timed.
+ */
+static int file_input(struct input *in, const char *filename)
+{
+	struct stat st;
+	int fd, sync;
+	ssize_t got;
+	int len = 0;
+
+	if ((fd = open(filename, O_RDONLY)) < 0)
+		return -1;
+	if ((fstat(fd, &st) < 0) || (st.st_size < TRANSPORT_PACKET_LENGTH) ||
+	    ((in->buf = malloc(st.st_size)) == NULL)) {
+		close(fd);
+		return -1;
+	}
+	while (len < st.st_size) {
+		if ((got = read(fd, in->buf + len, st.st_size - len)) <= 0)
+			break;
+		len += got;
+	}
+	close(fd);
+
+	if ((sync = transport_packet_find_sync(in->buf, len)) < 0)
+		return -1;
+	len -= sync;
+	memmove(in->buf, in->buf + sync, len);
+
+	in->packets = len / TRANSPORT_PACKET_LENGTH;
+	in->len = in->packets * TRANSPORT_PACKET_LENGTH;
+	return (in->packets > 0) ? 0 : -1;
+}
+
+
+static void bench_crc32(struct input *in, struct counts *c)
+{
+	uint32_t crc = CRC32_INIT;
+	int pos, len;
+
+	for (pos = 0; pos < in->len; pos += crc_length) {
+		len = in->len - pos;
+		if (len > crc_length)
+			len = crc_length;
+		crc = crc32(crc, in->buf + pos, len);
+	}
+	sink += crc;
+	c->sections = crc;
+}
+
+/*
+ * Every start code in the payloads of the PIDs which aren't PSI, as the video
+ * indexers see them; the offsets found are summed, to compare implementations.
+ */
+static void bench_startcode(struct input *in, struct counts *c)
+{
+	struct transport_packet *pkt;
+	struct transport_values vals;
+	int i, pos, found;
+
+	for (i = 0; i < in->packets; i++) {
+		if ((pkt = transport_packet_init(in->buf + (i * TRANSPORT_PACKET_LENGTH))) == NULL) {
+			c->errors++;
+			continue;
+		}
+		if (in->psi[transport_packet_pid(pkt)] ||
+		    (transport_packet_pid(pkt) == TRANSPORT_NULL_PID))
+			continue;
+		if (transport_packet_values_extract(pkt, &vals, 0) < 0) {
+			c->errors++;
+			continue;
+		}
+		for (pos = 0; (found = startcode_find(vals.payload + pos, vals.payload_length - pos)) >= 0;
+		     pos += found + 3)
+			c->sections += (i * TRANSPORT_PACKET_LENGTH) + pos + found;
+	}
+	sink += c->sections;
+}
+
+static void bench_header(struct input *in, struct counts *c)
+{
+	struct transport_packet *pkt;
+	struct transport_values vals;
+	int i;
+
+	for (i = 0; i < in->packets; i++) {
+		if ((pkt = transport_packet_init(in->buf + (i * TRANSPORT_PACKET_LENGTH))) == NULL) {
+			c->errors++;
+			continue;
+		}
+		if (transport_packet_values_extract(pkt, &vals, 0) < 0) {
+			c->errors++;
+			continue;
+		}
+		sink += vals.payload_length + transport_packet_pid(pkt);
+	}
+}
+
+static void bench_header_pcr(struct input *in, struct counts *c)
+{
+	struct transport_packet *pkt;
+	struct transport_values vals;
+	int i;
+
+	for (i = 0; i < in->packets; i++) {
+		if ((pkt = transport_packet_init(in->buf + (i * TRANSPORT_PACKET_LENGTH))) == NULL) {
+			c->errors++;
+			continue;
+		}
+		if (transport_packet_values_extract(pkt, &vals, transport_value_pcr) < 0) {
+			c->errors++;
+			continue;
+		}
+		sink += vals.payload_length + vals.pcr;
+	}
+}
+
+static void bench_batch(struct input *in, struct transport_packet_batch *batch,
+			struct counts *c)
+{
+	int pos = 0, used, i;
+
+	while (pos < in->len) {
+		used = transport_packet_batch_extract(in->buf + pos, in->len - pos, batch);
+		if (used == 0) {
+			/* bad sync byte; step over the packet */
+			c->errors++;
+			pos += TRANSPORT_PACKET_LENGTH;
+			continue;
+		}
+		for (i = 0; i < batch->count; i++)
+			sink += batch->pid[i] + batch->payload_offset[i];
+		pos += used;
+	}
+}
+
+static void bench_continuity(struct input *in, struct counts *c)
+{
+	static unsigned char continuities[TRANSPORT_MAX_PIDS];
+	struct transport_packet *pkt;
+	int i, pid;
+
+	memset(continuities, 0, sizeof(continuities));
+	for (i = 0; i < in->packets; i++) {
+		pkt = (struct transport_packet *) (in->buf + (i * TRANSPORT_PACKET_LENGTH));
+		if (pkt->sync_byte != TRANSPORT_PACKET_SYNC) {
+			c->errors++;
+			continue;
+		}
+		pid = transport_packet_pid(pkt);
+		if (transport_packet_continuity_check(pkt, 0, continuities + pid)) {
+			c->errors++;
+			continuities[pid] = 0;
+		}
+	}
+}
+
+/*
+ * The same path as testucsi's receive_data(): header, continuity and then
+ * section_buf_add_transport_payload() on every PSI PID.
+ */
+static void bench_section_buf(struct input *in, struct counts *c)
+{
+	static unsigned char continuities[TRANSPORT_MAX_PIDS];
+	struct transport_packet *pkt;
+	struct transport_values vals;
+	int section_status;
+	int i, pid, used, pdu_start;
+
+	memset(continuities, 0, sizeof(continuities));
+	for (pid = 0; pid < TRANSPORT_MAX_PIDS; pid++)
+		if (section_bufs[pid])
+			section_buf_init(section_bufs[pid], DVB_MAX_SECTION_BYTES);
+
+	for (i = 0; i < in->packets; i++) {
+		if ((pkt = transport_packet_init(in->buf + (i * TRANSPORT_PACKET_LENGTH))) == NULL) {
+			c->errors++;
+			continue;
+		}
+		pid = transport_packet_pid(pkt);
+		if (!in->psi[pid])
+			continue;
+		if (transport_packet_values_extract(pkt, &vals, 0) < 0) {
+			c->errors++;
+			continue;
+		}
+		if (transport_packet_continuity_check(pkt,
+		    vals.flags & transport_adaptation_flag_discontinuity,
+		    continuities + pid)) {
+			c->errors++;
+			continuities[pid] = 0;
+			section_buf_reset(section_bufs[pid]);
+			continue;
+		}
+
+		pdu_start = pkt->payload_unit_start_indicator;
+		while (vals.payload_length) {
+			used = section_buf_add_transport_payload(section_bufs[pid],
+								 vals.payload,
+								 vals.payload_length,
+								 pdu_start,
+								 &section_status);
+			pdu_start = 0;
+			vals.payload_length -= used;
+			vals.payload += used;
+
+			if (section_status == 1) {
+				sink += section_buf_data(section_bufs[pid])[0];
+				c->sections++;
+				section_buf_reset(section_bufs[pid]);
+			} else if (section_status < 0) {
+				c->errors++;
+				section_buf_reset(section_bufs[pid]);
+			}
+		}
+	}
+}
+
+static void reasm_section(void *private, int pid, uint8_t *section, int len)
+{
+	struct counts *c = (struct counts *) private;
+
+	(void) pid;
+	sink += section[0] + len;
+	c->sections++;
+}
+
+static void bench_section_reasm(struct input *in, struct section_reasm *reasm,
+				struct counts *c)
+{
+	int pid;
+
+	for (pid = 0; pid < TRANSPORT_MAX_PIDS; pid++)
+		if (in->psi[pid])
+			section_reasm_reset_pid(reasm, pid);
+	section_reasm_add_packets(reasm, in->buf, in->len, reasm_section, c);
+}
+
+
+enum bench_type {
+	BENCH_CRC32,
+	BENCH_STARTCODE,
+	BENCH_HEADER,
+	BENCH_HEADER_PCR,
+	BENCH_BATCH,
+	BENCH_CONTINUITY,
+	BENCH_SECTION_BUF,
+	BENCH_SECTION_REASM,
+};
+
+struct bench_state {
+	struct transport_packet_batch batch;
+	struct section_reasm *reasm;
+};
+
+static void run_once(enum bench_type type, struct input *in, struct bench_state *state,
+		     struct counts *c)
+{
+	switch (type) {
+	case BENCH_CRC32:
+		bench_crc32(in, c);
+		break;
+	case BENCH_STARTCODE:
+		bench_startcode(in, c);
+		break;
+	case BENCH_HEADER:
+		bench_header(in, c);
+		break;
+	case BENCH_HEADER_PCR:
+		bench_header_pcr(in, c);
+		break;
+	case BENCH_BATCH:
+		bench_batch(in, &state->batch, c);
+		break;
+	case BENCH_CONTINUITY:
+		bench_continuity(in, c);
+		break;
+	case BENCH_SECTION_BUF:
+		bench_section_buf(in, c);
+		break;
+	case BENCH_SECTION_REASM:
+		bench_section_reasm(in, state->reasm, c);
+		break;
+	}
+}
+
+/*
+ * Run one benchmark: a warm up pass, then the timed ones. The counts of the
+ * warm up pass are returned, since every pass sees the same data.
+ */
+static void run(const char *name, enum bench_type type, struct input *in,
+		struct bench_state *state, int passes, struct counts *c)
+{
+	struct counts discard;
+	uint64_t start, cycles;
+	double secs, ns;
+	int pass;
+
+	memset(c, 0, sizeof(*c));
+	run_once(type, in, state, c);
+
+	start = now_ns();
+	cycles = now_cycles();
+	for (pass = 0; pass < passes; pass++) {
+		memset(&discard, 0, sizeof(discard));
+		run_once(type, in, state, &discard);
+	}
+	cycles = now_cycles() - cycles;
+	secs = (double) (now_ns() - start) / 1e9;
+
+	ns = (secs * 1e9) / ((double) in->packets * passes);
+	printf("%-16s %9i %8lu %14.0f %8.2f",
+	       name, in->packets, c->errors,
+	       secs > 0 ? ((double) in->packets * passes) / secs : 0,
+	       secs > 0 ? ((double) in->len * passes) / secs / 1e9 : 0);
+#ifdef HAVE_CYCLES
+	printf(" %10.1f\n", (double) cycles / ((double) in->packets * passes));
+#else
+	printf(" %10s\n", "-");
+#endif
+
+	if (num_results < MAX_RESULTS) {
+		snprintf(results[num_results].name, sizeof(results[0].name), "%s", name);
+		results[num_results++].ns = ns;
+	}
+}
+
+/*
+ * Time every crc32() implementation this CPU supports (or only the one
+ * chosen automatically), checking they all agree.
+ */
+static int run_crc32(struct input *in, struct bench_state *state, int passes, int compare)
+{
+	enum crc32_impl impl, first = crc32_selected();
+	char name[32];
+	struct counts c;
+	uint32_t expect = 0;
+	int have_expect = 0;
+	int status = 0;
+
+	for (impl = crc32_impl_table; impl <= crc32_impl_clmul; impl++) {
+		if (!compare && (impl != first))
+			continue;
+		if (crc32_select(impl) < 0)
+			continue;
+
+		snprintf(name, sizeof(name), "crc32-%s", crc32_impl_names[impl]);
+		run(name, BENCH_CRC32, in, state, passes, &c);
+		if (have_expect && ((uint32_t) c.sections != expect)) {
+			fprintf(stderr, "XXXX crc32 %s result %08x differs from %08x\n",
+				crc32_impl_names[impl], (uint32_t) c.sections, expect);
+			status = -1;
+		}
+		expect = c.sections;
+		have_expect = 1;
+	}
+	crc32_select(first);
+	return status;
+}
+
+/*
+ * The same for startcode_find().
+ */
+static int run_startcode(struct input *in, struct bench_state *state, int passes, int compare)
+{
+	enum startcode_impl impl, first = startcode_selected();
+	char name[32];
+	struct counts c;
+	unsigned long expect = 0;
+	int have_expect = 0;
+	int status = 0;
+
+	for (impl = startcode_impl_scalar; impl <= startcode_impl_neon; impl++) {
+		if (!compare && (impl != first))
+			continue;
+		if (startcode_select(impl) < 0)
+			continue;
+
+		snprintf(name, sizeof(name), "startcode-%s", startcode_impl_names[impl]);
+		run(name, BENCH_STARTCODE, in, state, passes, &c);
+		if (have_expect && (c.sections != expect)) {
+			fprintf(stderr, "XXXX startcode %s result %lu differs from %lu\n",
+				startcode_impl_names[impl], c.sections, expect);
+			status = -1;
+		}
+		expect = c.sections;
+		have_expect = 1;
+	}
+	startcode_select(first);
+	return status;
+}
+
+static int save_results(const char *filename)
+{
+	FILE *f;
+	int i;
+
+	if ((f = fopen(filename, "w")) == NULL)
+		return -1;
+	for (i = 0; i < num_results; i++)
+		fprintf(f, "%s %.3f\n", results[i].name, results[i].ns);
+	return fclose(f);
+}
+
+/*
+ * Compare against a file written by -s. Returns the number of benchmarks
+ * which got slower by more than threshold percent, or -1 on error.
+ */
+static int compare_results(const char *filename, int threshold)
+{
+	char name[32];
+	double ns;
+	FILE *f;
+	int regressed = 0;
+	int i;
+
+	if ((f = fopen(filename, "r")) == NULL)
+		return -1;
+	printf("\n%-16s %12s %12s %8s\n", "test", "base ns/pkt", "ns/pkt", "change");
+	while (fscanf(f, "%31s %lf", name, &ns) == 2) {
+		for (i = 0; i < num_results; i++) {
+			if (strcmp(results[i].name, name))
+				continue;
+			printf("%-16s %12.2f %12.2f %+7.1f%%", name, ns, results[i].ns,
+			       ns > 0 ? ((results[i].ns - ns) * 100.0) / ns : 0);
+			if (results[i].ns > (ns * (100 + threshold)) / 100) {
+				printf("  REGRESSED");
+				regressed++;
+			}
+			printf("\n");
+		}
+	}
+	fclose(f);
+	return regressed;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Syntax: benchts [<options>]\n"
+		" -f <file>      Use a recorded transport stream instead of synthetic packets\n"
+		" -n <packets>   Number of synthetic packets (default %i)\n"
+		" -p <passes>    Number of timed passes (default %i)\n"
+		" -P <pid>       Treat a PID of the recorded stream as PSI (default 0x00-0x1f)\n"
+		" -l <bytes>     Length of each crc32() call (default %i)\n"
+		" -c             Compare every supported crc32 and startcode implementation\n"
+		" -s <file>      Save the results\n"
+		" -b <file>      Compare against saved results, failing on a regression\n"
+		" -t <percent>   Slowdown counted as a regression (default %i)\n",
+		DEFAULT_PACKETS, DEFAULT_PASSES, DEFAULT_CRC_LENGTH, DEFAULT_THRESHOLD);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	static struct bench_state state;
+	static struct input in;
+	char *filename = NULL, *savefile = NULL, *basefile = NULL;
+	int packets = DEFAULT_PACKETS;
+	int passes = DEFAULT_PASSES;
+	int threshold = DEFAULT_THRESHOLD;
+	int compare = 0, user_pids = 0;
+	int status = 0;
+	struct counts c;
+	int opt, pid;
+
+	while ((opt = getopt(argc, argv, "f:n:p:P:l:cs:b:t:")) != -1) {
+		switch (opt) {
+		case 'f':
+			filename = optarg;
+			break;
+		case 'n':
+			packets = atoi(optarg);
+			break;
+		case 'p':
+			passes = atoi(optarg);
+			break;
+		case 'P':
+			pid = strtol(optarg, NULL, 0);
+			if ((pid < 0) || (pid >= TRANSPORT_NULL_PID))
+				usage();
+			in.psi[pid] = 1;
+			user_pids = 1;
+			break;
+		case 'l':
+			crc_length = atoi(optarg);
+			break;
+		case 'c':
+			compare = 1;
+			break;
+		case 's':
+			savefile = optarg;
+			break;
+		case 'b':
+			basefile = optarg;
+			break;
+		case 't':
+			threshold = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind != argc) || (packets < 1) || (crc_length < 1))
+		usage();
+	if (passes < 1)
+		passes = 1;
+
+	if (filename) {
+		if (file_input(&in, filename)) {
+			fprintf(stderr, "Unable to read transport stream %s\n", filename);
+			exit(1);
+		}
+		if (!user_pids)
+			for (pid = 0; pid < 0x20; pid++)
+				in.psi[pid] = 1;
+	} else if (synth_input(&in, packets)) {
+		fprintf(stderr, "Unable to generate synthetic packets\n");
+		exit(1);
+	}
+
+	if ((state.reasm = section_reasm_create(TRANSPORT_MAX_PIDS, DVB_MAX_SECTION_BYTES)) == NULL) {
+		fprintf(stderr, "Failed to create section reassembler\n");
+		exit(1);
+	}
+	for (pid = 0; pid < TRANSPORT_MAX_PIDS; pid++) {
+		if (!in.psi[pid])
+			continue;
+		section_reasm_add_pid(state.reasm, pid);
+		section_bufs[pid] = (struct section_buf *)
+			malloc(sizeof(struct section_buf) + DVB_MAX_SECTION_BYTES);
+		if (section_bufs[pid] == NULL) {
+			fprintf(stderr, "Failed to allocate section buf (pid:%04x)\n", pid);
+			exit(1);
+		}
+	}
+
+	printf("%s: %i packets, %i passes, crc32 %s\n", filename ? filename : "synthetic",
+	       in.packets, passes, crc32_impl_names[crc32_selected()]);
+	printf("%-16s %9s %8s %14s %8s %10s\n",
+	       "test", "packets", "errors", "packets/s", "GB/s", "cycles/pkt");
+
+	if (run_crc32(&in, &state, passes, compare))
+		status = 1;
+	if (run_startcode(&in, &state, passes, compare))
+		status = 1;
+	run("header", BENCH_HEADER, &in, &state, passes, &c);
+	run("header-pcr", BENCH_HEADER_PCR, &in, &state, passes, &c);
+	run("batch", BENCH_BATCH, &in, &state, passes, &c);
+	run("continuity", BENCH_CONTINUITY, &in, &state, passes, &c);
+	run("section_buf", BENCH_SECTION_BUF, &in, &state, passes, &c);
+	printf("%-16s %lu sections\n", "", c.sections);
+	run("section_reasm", BENCH_SECTION_REASM, &in, &state, passes, &c);
+	printf("%-16s %lu sections\n", "", c.sections);
+
+	if (savefile && save_results(savefile)) {
+		fprintf(stderr, "Unable to save results to %s\n", savefile);
+		status = 1;
+	}
+	if (basefile) {
+		switch (compare_results(basefile, threshold)) {
+		case -1:
+			fprintf(stderr, "Unable to read results from %s\n", basefile);
+			status = 1;
+			break;
+		case 0:
+			break;
+		default:
+			status = 1;
+			break;
+		}
+	}
+
+	section_reasm_destroy(state.reasm);
+	for (pid = 0; pid < TRANSPORT_MAX_PIDS; pid++)
+		free(section_bufs[pid]);
+	free(in.buf);
+
+	return (sink == 0xdeadbeef) ? 2 : status;
+}
@@ -0,0 +1,588 @@
+/*
+ * section decode benchmark: replays a section capture through the codecs.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+#include <libucsi/atsc/section.h>
+#include <libucsi/section_buf.h>
+#include <libucsi/descriptor_registry.h>
+#include <libdvbswdemux/dvbswdemux_pool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "seccap.h"
+
+#define DEFAULT_PASSES 100
+
+struct record {
+	uint8_t *data;
+	int len;
+};
+
+struct table {
+	const char *name;
+	int (*decode)(struct section *section);
+	const struct descriptor_registry *descriptors;
+};
+
+struct table_records {
+	int count;
+	int max;
+	struct record *records;
+};
+
+/* per thread, for the -workers run */
+static __thread unsigned long sink;
+static __thread const struct descriptor_registry *registry;
+static __thread unsigned long bad_descriptors;
+
+static unsigned long pool_errors[64];
+
+/* descriptors with a known tag are decoded too, through the registry */
+#define DESCRIPTORS(macro, ...) \
+	do { \
+		struct descriptor *curd; \
+		macro(__VA_ARGS__, curd) { \
+			sink += curd->tag; \
+			if (registry->decode[curd->tag] && \
+			    (descriptor_registry_decode(registry, curd) == NULL)) \
+				bad_descriptors++; \
+		} \
+	} while (0)
+
+static int decode_pat(struct section *section)
+{
+	struct section_ext *ext;
+	struct mpeg_pat_section *pat;
+	struct mpeg_pat_program *cur;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((pat = mpeg_pat_section_codec(ext)) == NULL))
+		return -1;
+	mpeg_pat_section_programs_for_each(pat, cur) {
+		sink += cur->pid;
+	}
+	return 0;
+}
+
+static int decode_cat(struct section *section)
+{
+	struct section_ext *ext;
+	struct mpeg_cat_section *cat;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((cat = mpeg_cat_section_codec(ext)) == NULL))
+		return -1;
+	DESCRIPTORS(mpeg_cat_section_descriptors_for_each, cat);
+	return 0;
+}
+
+static int decode_pmt(struct section *section)
+{
+	struct section_ext *ext;
+	struct mpeg_pmt_section *pmt;
+	struct mpeg_pmt_stream *cur;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((pmt = mpeg_pmt_section_codec(ext)) == NULL))
+		return -1;
+	DESCRIPTORS(mpeg_pmt_section_descriptors_for_each, pmt);
+	mpeg_pmt_section_streams_for_each(pmt, cur) {
+		DESCRIPTORS(mpeg_pmt_stream_descriptors_for_each, cur);
+	}
+	return 0;
+}
+
+static int decode_nit(struct section *section)
+{
+	struct section_ext *ext;
+	struct dvb_nit_section *nit;
+	struct dvb_nit_section_part2 *part2;
+	struct dvb_nit_transport *cur;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((nit = dvb_nit_section_codec(ext)) == NULL))
+		return -1;
+	DESCRIPTORS(dvb_nit_section_descriptors_for_each, nit);
+	part2 = dvb_nit_section_part2(nit);
+	dvb_nit_section_transports_for_each(nit, part2, cur) {
+		DESCRIPTORS(dvb_nit_transport_descriptors_for_each, cur);
+	}
+	return 0;
+}
+
+static int decode_sdt(struct section *section)
+{
+	struct section_ext *ext;
+	struct dvb_sdt_section *sdt;
+	struct dvb_sdt_service *cur;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((sdt = dvb_sdt_section_codec(ext)) == NULL))
+		return -1;
+	dvb_sdt_section_services_for_each(sdt, cur) {
+		DESCRIPTORS(dvb_sdt_service_descriptors_for_each, cur);
+	}
+	return 0;
+}
+
+static int decode_bat(struct section *section)
+{
+	struct section_ext *ext;
+	struct dvb_bat_section *bat;
+	struct dvb_bat_section_part2 *part2;
+	struct dvb_bat_transport *cur;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((bat = dvb_bat_section_codec(ext)) == NULL))
+		return -1;
+	DESCRIPTORS(dvb_bat_section_descriptors_for_each, bat);
+	part2 = dvb_bat_section_part2(bat);
+	dvb_bat_section_transports_for_each(part2, cur) {
+		DESCRIPTORS(dvb_bat_transport_descriptors_for_each, cur);
+	}
+	return 0;
+}
+
+static int decode_eit(struct section *section)
+{
+	struct section_ext *ext;
+	struct dvb_eit_section *eit;
+	struct dvb_eit_event *cur;
+
+	if (((ext = section_ext_decode(section, 1)) == NULL) ||
+	    ((eit = dvb_eit_section_codec(ext)) == NULL))
+		return -1;
+	dvb_eit_section_events_for_each(eit, cur) {
+		DESCRIPTORS(dvb_eit_event_descriptors_for_each, cur);
+	}
+	return 0;
+}
+
+static int decode_tdt(struct section *section)
+{
+	struct dvb_tdt_section *tdt;
+
+	if ((tdt = dvb_tdt_section_codec(section)) == NULL)
+		return -1;
+	sink += tdt->utc_time[0];
+	return 0;
+}
+
+static int decode_tot(struct section *section)
+{
+	struct dvb_tot_section *tot;
+
+	if ((tot = dvb_tot_section_codec(section)) == NULL)
+		return -1;
+	DESCRIPTORS(dvb_tot_section_descriptors_for_each, tot);
+	return 0;
+}
+
+static struct atsc_section_psip *psip_decode(struct section *section)
+{
+	struct section_ext *ext;
+
+	if ((ext = section_ext_decode(section, 1)) == NULL)
+		return NULL;
+	return atsc_section_psip_decode(ext);
+}
+
+static int decode_mgt(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_mgt_section *mgt;
+	struct atsc_mgt_table *cur;
+	struct atsc_mgt_section_part2 *part2;
+	int idx;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((mgt = atsc_mgt_section_codec(psip)) == NULL))
+		return -1;
+	atsc_mgt_section_tables_for_each(mgt, cur, idx) {
+		DESCRIPTORS(atsc_mgt_table_descriptors_for_each, cur);
+	}
+	part2 = atsc_mgt_section_part2(mgt);
+	DESCRIPTORS(atsc_mgt_section_part2_descriptors_for_each, part2);
+	return 0;
+}
+
+static int decode_tvct(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_tvct_section *tvct;
+	struct atsc_tvct_channel *cur;
+	struct atsc_tvct_section_part2 *part2;
+	int idx;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((tvct = atsc_tvct_section_codec(psip)) == NULL))
+		return -1;
+	atsc_tvct_section_channels_for_each(tvct, cur, idx) {
+		DESCRIPTORS(atsc_tvct_channel_descriptors_for_each, cur);
+	}
+	part2 = atsc_tvct_section_part2(tvct);
+	DESCRIPTORS(atsc_tvct_section_part2_descriptors_for_each, part2);
+	return 0;
+}
+
+static int decode_cvct(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_cvct_section *cvct;
+	struct atsc_cvct_channel *cur;
+	struct atsc_cvct_section_part2 *part2;
+	int idx;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((cvct = atsc_cvct_section_codec(psip)) == NULL))
+		return -1;
+	atsc_cvct_section_channels_for_each(cvct, cur, idx) {
+		DESCRIPTORS(atsc_cvct_channel_descriptors_for_each, cur);
+	}
+	part2 = atsc_cvct_section_part2(cvct);
+	DESCRIPTORS(atsc_cvct_section_part2_descriptors_for_each, part2);
+	return 0;
+}
+
+static int decode_rrt(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_rrt_section *rrt;
+	struct atsc_rrt_section_part2 *part2;
+	struct atsc_rrt_dimension *cur;
+	struct atsc_rrt_section_part3 *part3;
+	int idx;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((rrt = atsc_rrt_section_codec(psip)) == NULL))
+		return -1;
+	part2 = atsc_rrt_section_part2(rrt);
+	atsc_rrt_section_dimensions_for_each(part2, cur, idx) {
+		sink += atsc_rrt_dimension_part2(cur)->values_defined;
+	}
+	part3 = atsc_rrt_section_part3(part2);
+	DESCRIPTORS(atsc_rrt_section_part3_descriptors_for_each, part3);
+	return 0;
+}
+
+static int decode_atsc_eit(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_eit_section *eit;
+	struct atsc_eit_event *cur;
+	int idx;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((eit = atsc_eit_section_codec(psip)) == NULL))
+		return -1;
+	atsc_eit_section_events_for_each(eit, cur, idx) {
+		DESCRIPTORS(atsc_eit_event_part2_descriptors_for_each, atsc_eit_event_part2(cur));
+	}
+	return 0;
+}
+
+static int decode_ett(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_ett_section *ett;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((ett = atsc_ett_section_codec(psip)) == NULL))
+		return -1;
+	sink += ett->ETM_source_id;
+	return 0;
+}
+
+static int decode_stt(struct section *section)
+{
+	struct atsc_section_psip *psip;
+	struct atsc_stt_section *stt;
+
+	if (((psip = psip_decode(section)) == NULL) ||
+	    ((stt = atsc_stt_section_codec(psip)) == NULL))
+		return -1;
+	DESCRIPTORS(atsc_stt_section_descriptors_for_each, stt);
+	return 0;
+}
+
+static struct table tables[] = {
+	{ "PAT", decode_pat, &descriptor_registry_dvb },
+	{ "CAT", decode_cat, &descriptor_registry_dvb },
+	{ "PMT", decode_pmt, &descriptor_registry_dvb },
+	{ "NIT", decode_nit, &descriptor_registry_dvb },
+	{ "SDT", decode_sdt, &descriptor_registry_dvb },
+	{ "BAT", decode_bat, &descriptor_registry_dvb },
+	{ "EIT", decode_eit, &descriptor_registry_dvb },
+	{ "TDT", decode_tdt, &descriptor_registry_dvb },
+	{ "TOT", decode_tot, &descriptor_registry_dvb },
+	{ "MGT", decode_mgt, &descriptor_registry_atsc },
+	{ "TVCT", decode_tvct, &descriptor_registry_atsc },
+	{ "CVCT", decode_cvct, &descriptor_registry_atsc },
+	{ "RRT", decode_rrt, &descriptor_registry_atsc },
+	{ "ATSC EIT", decode_atsc_eit, &descriptor_registry_atsc },
+	{ "ETT", decode_ett, &descriptor_registry_atsc },
+	{ "STT", decode_stt, &descriptor_registry_atsc },
+};
+
+#define NUM_TABLES (sizeof(tables) / sizeof(tables[0]))
+
+static struct table_records records[NUM_TABLES];
+
+static int find_table(int table_id)
+{
+	switch(table_id) {
+	case stag_mpeg_program_association:
+		return 0;
+	case stag_mpeg_conditional_access:
+		return 1;
+	case stag_mpeg_program_map:
+		return 2;
+	case stag_dvb_network_information_actual:
+	case stag_dvb_network_information_other:
+		return 3;
+	case stag_dvb_service_description_actual:
+	case stag_dvb_service_description_other:
+		return 4;
+	case stag_dvb_bouquet_association:
+		return 5;
+	case stag_dvb_event_information_nownext_actual ... 0x6f:
+		return 6;
+	case stag_dvb_time_date:
+		return 7;
+	case stag_dvb_time_offset:
+		return 8;
+	case stag_atsc_master_guide:
+		return 9;
+	case stag_atsc_terrestrial_virtual_channel:
+		return 10;
+	case stag_atsc_cable_virtual_channel:
+		return 11;
+	case stag_atsc_rating_region:
+		return 12;
+	case stag_atsc_event_information:
+		return 13;
+	case stag_atsc_extended_text:
+		return 14;
+	case stag_atsc_system_time:
+		return 15;
+	}
+	return -1;
+}
+
+static void add_record(struct table_records *t, uint8_t *buf, int len)
+{
+	if (t->count == t->max) {
+		t->max = t->max ? t->max * 2 : 64;
+		t->records = realloc(t->records, t->max * sizeof(struct record));
+		if (t->records == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+	if ((t->records[t->count].data = malloc(len)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memcpy(t->records[t->count].data, buf, len);
+	t->records[t->count++].len = len;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * The codecs work in place, so each section is copied before decoding. The
+ * copy alone is timed too and taken off the result.
+ */
+static uint64_t run_table(int table, int passes, int decode, unsigned long *errors)
+{
+	struct table_records *t = &records[table];
+	uint8_t buf[DVB_MAX_SECTION_BYTES];
+	struct section *section;
+	uint64_t start;
+	int pass, i;
+
+	registry = tables[table].descriptors;
+	start = now_ns();
+	for (pass = 0; pass < passes; pass++) {
+		for (i = 0; i < t->count; i++) {
+			memcpy(buf, t->records[i].data, t->records[i].len);
+			if (!decode) {
+				sink += buf[0];
+				continue;
+			}
+			if (((section = section_codec(buf, t->records[i].len)) == NULL) ||
+			    tables[table].decode(section))
+				(*errors)++;
+		}
+	}
+	return now_ns() - start;
+}
+
+static void pool_section(void *private_data, int worker, uint8_t *data, int len)
+{
+	struct section *section;
+	int table = find_table(data[0]);
+
+	(void) private_data;
+
+	registry = tables[table].descriptors;
+	if (((section = section_codec(data, len)) == NULL) ||
+	    tables[table].decode(section))
+		pool_errors[worker]++;
+}
+
+/*
+ * Decode every table through a dvbswdemux_pool. The sections are copied into
+ * the worker queues, so this is timed against the inline decode with its copy.
+ */
+static uint64_t run_pool(int workers, int shed, int passes, unsigned long *sections,
+			 unsigned long *errors, struct dvbswdemux_pool_stats *stats)
+{
+	struct dvbswdemux_pool *pool;
+	uint64_t start, ns;
+	unsigned int table;
+	int pass, i;
+
+	if ((pool = dvbswdemux_pool_create(workers, 0, 0, pool_section, NULL)) == NULL) {
+		fprintf(stderr, "Unable to create pool\n");
+		exit(1);
+	}
+	dvbswdemux_pool_set_shed(pool, shed);
+
+	*sections = 0;
+	start = now_ns();
+	for (pass = 0; pass < passes; pass++) {
+		for (table = 0; table < NUM_TABLES; table++) {
+			for (i = 0; i < records[table].count; i++)
+				dvbswdemux_pool_submit(pool, records[table].records[i].data,
+						       records[table].records[i].len);
+			*sections += records[table].count;
+		}
+	}
+	dvbswdemux_pool_flush(pool);
+	ns = now_ns() - start;
+
+	*errors = 0;
+	for (i = 0; i < dvbswdemux_pool_workers(pool); i++)
+		*errors += pool_errors[i];
+	dvbswdemux_pool_get_stats(pool, stats);
+	dvbswdemux_pool_destroy(pool);
+	return ns;
+}
+
+int main(int argc, char *argv[])
+{
+	uint8_t buf[DVB_MAX_SECTION_BYTES];
+	uint32_t timestamp;
+	unsigned long errors, other = 0;
+	uint64_t copy_ns, total, inline_ns = 0, pool_ns;
+	unsigned long inline_sections = 0, pool_sections;
+	double ns;
+	struct dvbswdemux_pool_stats stats;
+	static const char *priorities[] = { "psi", "normal", "bulk" };
+	int passes = DEFAULT_PASSES;
+	int workers = -1;
+	int shed = 0;
+	int pid, len, table;
+	unsigned int i;
+	FILE *f;
+
+	if ((argc > 2) && !strcmp(argv[1], "-workers")) {
+		workers = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	if ((argc > 1) && !strcmp(argv[1], "-shed")) {
+		shed = 1;
+		argc--;
+		argv++;
+	}
+	if ((argc < 2) || (argc > 3) || (workers < -1) || (shed && (workers < 0))) {
+		fprintf(stderr, "Syntax: benchucsi [-workers <n> [-shed]] <capture file> [<passes>]\n");
+		fprintf(stderr, " -workers: also decode everything through a pool of n threads\n");
+		fprintf(stderr, "           (0 for one per CPU), against one thread\n");
+		fprintf(stderr, " -shed:    let the pool shed bulk (EIT schedule) sections it\n");
+		fprintf(stderr, "           cannot keep up with, as for a live stream\n");
+		exit(1);
+	}
+	if (argc == 3)
+		passes = atoi(argv[2]);
+	if (passes < 1)
+		passes = 1;
+
+	if ((f = seccap_open(argv[1])) == NULL) {
+		fprintf(stderr, "Unable to open capture file %s\n", argv[1]);
+		exit(1);
+	}
+	while((len = seccap_read(f, &timestamp, &pid, buf, sizeof(buf))) > 0) {
+		if ((len < 3) || ((table = find_table(buf[0])) < 0)) {
+			other++;
+			continue;
+		}
+		add_record(&records[table], buf, len);
+	}
+	if (len < 0)
+		fprintf(stderr, "XXXX Bad capture file record\n");
+	fclose(f);
+
+	printf("%-10s %9s %8s %9s %14s %12s\n", "table", "sections", "errors", "bad descs",
+	       "sections/s", "ns/section");
+	for (i = 0; i < NUM_TABLES; i++) {
+		if (records[i].count == 0)
+			continue;
+
+		errors = 0;
+		bad_descriptors = 0;
+		copy_ns = run_table(i, passes, 0, &errors);
+		total = run_table(i, passes, 1, &errors);
+		inline_ns += total;
+		inline_sections += (unsigned long) records[i].count * passes;
+		total = (total > copy_ns) ? total - copy_ns : 0;
+
+		ns = (double) total / ((double) records[i].count * passes);
+		printf("%-10s %9i %8lu %9lu %14.0f %12.1f\n", tables[i].name, records[i].count,
+		       errors / passes, bad_descriptors / passes,
+		       ns > 0 ? 1e9 / ns : 0, ns);
+	}
+	if (other)
+		printf("%lu sections of other tables skipped\n", other);
+
+	if ((workers >= 0) && inline_sections) {
+		pool_ns = run_pool(workers, shed, passes, &pool_sections, &errors, &stats);
+		printf("one thread: %14.0f sections/s\n", inline_sections * 1e9 / inline_ns);
+		printf("pool:       %14.0f sections/s, %lu errors\n",
+		       pool_sections * 1e9 / pool_ns, errors / passes);
+		for (i = 0; i < DVBSWDEMUX_POOL_PRIORITIES; i++) {
+			if (stats.submitted[i] || stats.shed[i])
+				printf("  %-8s %12llu queued %12llu shed %8llu waits\n", priorities[i],
+				       (unsigned long long) stats.submitted[i],
+				       (unsigned long long) stats.shed[i],
+				       (unsigned long long) stats.waits[i]);
+		}
+	}
+
+	return (sink == 0xdeadbeef) ? 2 : 0;
+}
@@ -0,0 +1,269 @@
+/*
+ * dvbtssplit check: splits one generated capture with several thread
+ * counts and chunk sizes, and checks every run writes the same files.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+/*
+ * The first run, on one thread with the whole capture in one chunk, is the
+ * reference. The others cut it into 1 to 3 MB chunks, which never end on a
+ * packet boundary, and sort them on up to 8 threads at once, so any state
+ * shared between the threads or carried across chunks shows up as a
+ * difference. Each is repeated, since a race need not show every time;
+ * one built with -fsanitize=thread, given with -d, fails on any race.
+ *
+ * dvbtssplit is linked against the shared libucsi, so LD_LIBRARY_PATH
+ * needs to point at lib/libucsi unless it is installed.
+ */
+
+#include <libdvbtsgen/dvbtsgen.h>
+#include <libucsi/transport_packet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define DEFAULT_PACKETS		60000
+#define DEFAULT_SERVICES	8
+#define DEFAULT_REPEATS		3
+#define DEFAULT_SPLITTER	"../../util/dvbtssplit/dvbtssplit"
+
+struct split_run {
+	int threads;
+	int chunk_mb;
+};
+
+static struct split_run split_runs[] = {
+	{ 1, 64 },
+	{ 1, 1 },
+	{ 2, 1 },
+	{ 3, 1 },
+	{ 4, 2 },
+	{ 3, 3 },
+	{ 8, 1 },
+};
+
+#define SPLIT_RUN_COUNT (sizeof(split_runs) / sizeof(struct split_run))
+
+static const char *splitter = DEFAULT_SPLITTER;
+static char dir[] = "/tmp/checksplit-XXXXXX";
+
+static int run_split(const char *capture, int run, int threads, int chunk_mb)
+{
+	char pattern[64], j[16], c[16];
+	int status;
+	pid_t pid;
+
+	snprintf(pattern, sizeof(pattern), "%s/run%i-%%d.ts", dir, run);
+	snprintf(j, sizeof(j), "%i", threads);
+	snprintf(c, sizeof(c), "%i", chunk_mb);
+
+	if ((pid = fork()) < 0) {
+		perror("fork");
+		return -1;
+	}
+	if (pid == 0) {
+		execl(splitter, splitter, "-q", "-o", pattern, "-j", j, "-c", c, capture, (char *) NULL);
+		fprintf(stderr, "checksplit: Could not run %s: %m\n", splitter);
+		_exit(127);
+	}
+	if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "checksplit: -j %i -c %i failed\n", threads, chunk_mb);
+		return -1;
+	}
+	return 0;
+}
+
+static uint8_t *read_file(const char *name, size_t *len)
+{
+	struct stat st;
+	uint8_t *data;
+	int fd;
+
+	if ((fd = open(name, O_RDONLY)) < 0) {
+		fprintf(stderr, "checksplit: Could not open %s: %m\n", name);
+		return NULL;
+	}
+	if ((fstat(fd, &st) < 0) || ((data = malloc(st.st_size + 1)) == NULL)) {
+		fprintf(stderr, "checksplit: Could not read %s\n", name);
+		close(fd);
+		return NULL;
+	}
+	if (read(fd, data, st.st_size) != st.st_size) {
+		fprintf(stderr, "checksplit: Could not read %s\n", name);
+		free(data);
+		close(fd);
+		return NULL;
+	}
+	close(fd);
+	*len = st.st_size;
+	return data;
+}
+
+/*
+ * @return 0 if the file of a service from a run matches the reference's.
+ */
+static int compare_service(int run, int service_id)
+{
+	char name[2][64];
+	uint8_t *data[2];
+	size_t len[2], pos;
+	int ret = -1;
+
+	snprintf(name[0], sizeof(name[0]), "%s/run0-%i.ts", dir, service_id);
+	snprintf(name[1], sizeof(name[1]), "%s/run%i-%i.ts", dir, run, service_id);
+	if ((data[0] = read_file(name[0], &len[0])) == NULL)
+		return -1;
+	if ((data[1] = read_file(name[1], &len[1])) == NULL) {
+		free(data[0]);
+		return -1;
+	}
+
+	if (len[0] != len[1]) {
+		fprintf(stderr, "checksplit: -j %i -c %i: service %i is %zu bytes, not %zu\n",
+			split_runs[run].threads, split_runs[run].chunk_mb, service_id, len[1], len[0]);
+	} else if (memcmp(data[0], data[1], len[0])) {
+		for (pos = 0; data[0][pos] == data[1][pos]; pos++);
+		fprintf(stderr, "checksplit: -j %i -c %i: service %i differs in packet %zu\n",
+			split_runs[run].threads, split_runs[run].chunk_mb, service_id,
+			pos / TRANSPORT_PACKET_LENGTH);
+	} else {
+		ret = 0;
+	}
+
+	free(data[0]);
+	free(data[1]);
+	return ret;
+}
+
+static void remove_run(int run, int services)
+{
+	char name[64];
+	int i;
+
+	for (i = 0; i < services; i++) {
+		snprintf(name, sizeof(name), "%s/run%i-%i.ts", dir, run, i + 1);
+		unlink(name);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Syntax: checksplit [<options>]\n"
+		" -n <packets>   Number of packets in the capture (default %i)\n"
+		" -S <services>  Services in the generated mux (default %i)\n"
+		" -r <repeats>   Times to repeat each run (default %i)\n"
+		" -d <path>      dvbtssplit to check (default %s)\n",
+		DEFAULT_PACKETS, DEFAULT_SERVICES, DEFAULT_REPEATS, DEFAULT_SPLITTER);
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct dvbtsgen_config config;
+	struct dvbtsgen *gen;
+	char capture[64];
+	uint8_t *buf;
+	int packets = DEFAULT_PACKETS, repeats = DEFAULT_REPEATS;
+	int opt, fd, i, run, repeat;
+	int mismatches = 0;
+
+	memset(&config, 0, sizeof(config));
+	config.services = DEFAULT_SERVICES;
+
+	while ((opt = getopt(argc, argv, "n:S:r:d:")) != -1) {
+		switch (opt) {
+		case 'n':
+			packets = atoi(optarg);
+			break;
+		case 'S':
+			config.services = atoi(optarg);
+			break;
+		case 'r':
+			repeats = atoi(optarg);
+			break;
+		case 'd':
+			splitter = optarg;
+			break;
+		default:
+			usage();
+		}
+	}
+	if ((optind != argc) || (packets < 1) || (repeats < 1) ||
+	    (config.services < 1) || (config.services > DVBTSGEN_MAX_SERVICES))
+		usage();
+
+	// a mux just big enough for the services, so there are few stuffing packets
+	config.bitrate = (dvbtsgen_required_bitrate(&config) * 21) / 20;
+	if ((gen = dvbtsgen_create(&config)) == NULL) {
+		fprintf(stderr, "Unable to create the generator\n");
+		exit(1);
+	}
+	if ((buf = malloc((size_t) packets * TRANSPORT_PACKET_LENGTH)) == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	dvbtsgen_generate(gen, buf, packets);
+	dvbtsgen_destroy(gen);
+
+	if (mkdtemp(dir) == NULL) {
+		perror("mkdtemp");
+		exit(1);
+	}
+	snprintf(capture, sizeof(capture), "%s/capture.ts", dir);
+	if (((fd = open(capture, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) ||
+	    (write(fd, buf, (size_t) packets * TRANSPORT_PACKET_LENGTH) !=
+	     (ssize_t) packets * TRANSPORT_PACKET_LENGTH) ||
+	    close(fd)) {
+		fprintf(stderr, "checksplit: Could not write %s\n", capture);
+		exit(1);
+	}
+	free(buf);
+
+	if (run_split(capture, 0, split_runs[0].threads, split_runs[0].chunk_mb))
+		mismatches++;
+	for (run = 1; !mismatches && (run < (int) SPLIT_RUN_COUNT); run++) {
+		for (repeat = 0; repeat < repeats; repeat++) {
+			if (run_split(capture, run, split_runs[run].threads, split_runs[run].chunk_mb)) {
+				mismatches++;
+				break;
+			}
+			// dvbtsgen numbers its services from 1
+			for (i = 0; i < config.services; i++) {
+				if (compare_service(run, i + 1))
+					mismatches++;
+			}
+			remove_run(run, config.services);
+		}
+		printf("-j %i -c %-2i %s\n", split_runs[run].threads, split_runs[run].chunk_mb,
+		       mismatches ? "differs" : "matches");
+	}
+
+	remove_run(0, config.services);
+	unlink(capture);
+	rmdir(dir);
+
+	if (mismatches) {
+		fprintf(stderr, "%i outputs differ\n", mismatches);
+		exit(1);
+	}
+	printf("all runs match over %i services\n", config.services);
+	return 0;
+}
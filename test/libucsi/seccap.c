@@ -0,0 +1,93 @@
+/*
+ * Section capture files, for replaying sections offline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#include <string.h>
+#include "seccap.h"
+
+FILE *seccap_create(const char *filename)
+{
+	FILE *f;
+
+	if ((f = fopen(filename, "wb")) == NULL)
+		return NULL;
+
+	if (fwrite(SECCAP_MAGIC, SECCAP_MAGIC_LEN, 1, f) != 1) {
+		fclose(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+int seccap_write(FILE *f, uint32_t timestamp, int pid, uint8_t *section, int len)
+{
+	uint8_t hdr[SECCAP_HEADER_LEN];
+
+	if ((len <= 0) || (len > 0xffff))
+		return -1;
+
+	hdr[0] = timestamp >> 24;
+	hdr[1] = timestamp >> 16;
+	hdr[2] = timestamp >> 8;
+	hdr[3] = timestamp;
+	hdr[4] = pid >> 8;
+	hdr[5] = pid;
+	hdr[6] = len >> 8;
+	hdr[7] = len;
+
+	if ((fwrite(hdr, sizeof(hdr), 1, f) != 1) ||
+	    (fwrite(section, len, 1, f) != 1))
+		return -1;
+
+	return 0;
+}
+
+FILE *seccap_open(const char *filename)
+{
+	char magic[SECCAP_MAGIC_LEN];
+	FILE *f;
+
+	if ((f = fopen(filename, "rb")) == NULL)
+		return NULL;
+
+	if ((fread(magic, sizeof(magic), 1, f) != 1) ||
+	    memcmp(magic, SECCAP_MAGIC, SECCAP_MAGIC_LEN)) {
+		fclose(f);
+		return NULL;
+	}
+
+	return f;
+}
+
+int seccap_read(FILE *f, uint32_t *timestamp, int *pid, uint8_t *buf, int bufsize)
+{
+	uint8_t hdr[SECCAP_HEADER_LEN];
+	int len;
+
+	if (fread(hdr, sizeof(hdr), 1, f) != 1)
+		return feof(f) ? 0 : -1;
+
+	*timestamp = (hdr[0] << 24) | (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+	*pid = (hdr[4] << 8) | hdr[5];
+	len = (hdr[6] << 8) | hdr[7];
+
+	if ((len == 0) || (len > bufsize) || (fread(buf, len, 1, f) != 1))
+		return -1;
+
+	return len;
+}
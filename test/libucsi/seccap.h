@@ -0,0 +1,67 @@
+/*
+ * Section capture files, for replaying sections offline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA
+ */
+
+#ifndef SECCAP_H
+#define SECCAP_H 1
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * A capture file is the 8 byte magic followed by one record per section:
+ * a big endian header of timestamp (uint32, milliseconds since the start of
+ * the capture), pid (uint16) and length (uint16), then the section bytes as
+ * received (not yet decoded in place).
+ */
+#define SECCAP_MAGIC "UCSISEC1"
+#define SECCAP_MAGIC_LEN 8
+#define SECCAP_HEADER_LEN 8
+
+/**
+ * Create a capture file.
+ *
+ * @param filename Name of the file.
+ * @return FILE pointer, or NULL on error.
+ */
+extern FILE *seccap_create(const char *filename);
+
+/**
+ * Append a section to a capture file.
+ *
+ * @return 0 on success, -1 on error.
+ */
+extern int seccap_write(FILE *f, uint32_t timestamp, int pid, uint8_t *section, int len);
+
+/**
+ * Open a capture file for reading.
+ *
+ * @param filename Name of the file.
+ * @return FILE pointer, or NULL if it can't be opened or isn't a capture.
+ */
+extern FILE *seccap_open(const char *filename);
+
+/**
+ * Read the next section of a capture file.
+ *
+ * @param buf Buffer to read the section into.
+ * @param bufsize Size of buf.
+ * @return Length of the section, 0 at the end of the file, or -1 on error.
+ */
+extern int seccap_read(FILE *f, uint32_t *timestamp, int *pid, uint8_t *buf, int bufsize);
+
+#endif
@@ -37,6 +37,8 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <fcntl.h>
+#include <sys/time.h>
+#include "seccap.h"
 
 void receive_data(int dvrfd, int timeout, int data_type);
 void parse_section(uint8_t *buf, int len, int pid, int data_type);
@@ -50,8 +52,11 @@ void hexdump(int indent, char *prefix, uint8_t *buf, int buflen);
 void atsctextdump(char *header, int indent, struct atsc_text *atext, int len);
 int channels_cb(struct dvbcfg_zapchannel *channel, void *private);
 void ts_from_file(char *filename, int data_type);
+void sections_from_file(char *filename, int data_type);
+void capture_section(uint8_t *buf, int len, int pid);
 
 #define TIME_CHECK_VAL 1131835761
+#define TIME_CHECK_MJD_VAL 750516300	// EN 300 468 annex C: 93/10/13 12:45:00
 #define DURATION_CHECK_VAL 5643
 
 #define MAX_TUNE_TIME 3000
@@ -66,6 +71,8 @@ struct dvbfe_handle *fe;
 struct dvbfe_info feinfo;
 int demuxfd;
 int dvrfd;
+FILE *capture;
+struct timeval capture_start;
 
 int main(int argc, char *argv[])
 {
@@ -76,14 +83,28 @@ int main(int argc, char *argv[])
 	dvbduration_t dvbduration;
 
 	// process arguments
+	if ((argc > 2) && !strcmp(argv[1], "-capture")) {
+		if ((capture = seccap_create(argv[2])) == NULL) {
+			fprintf(stderr, "Unable to create capture file %s\n", argv[2]);
+			exit(1);
+		}
+		gettimeofday(&capture_start, NULL);
+		argc -= 2;
+		argv += 2;
+	}
 	if ((argc < 3) || (argc > 4)) {
-		fprintf(stderr, "Syntax: testucsi <adapter id>|-atscfile <filename> <zapchannels file> [<pid to limit to>]\n");
+		fprintf(stderr, "Syntax: testucsi [-capture <capture file>] <adapter id>|-atscfile <filename> <zapchannels file> [<pid to limit to>]\n");
+		fprintf(stderr, "        testucsi -secfile <capture file> [dvb|atsc]\n");
 		exit(1);
 	}
 	if (!strcmp(argv[1], "-atscfile")) {
 		ts_from_file(argv[2], DATA_TYPE_ATSC);
 		exit(0);
 	}
+	if (!strcmp(argv[1], "-secfile")) {
+		sections_from_file(argv[2], ((argc == 4) && !strcmp(argv[3], "atsc")) ? DATA_TYPE_ATSC : DATA_TYPE_DVB);
+		exit(0);
+	}
 	adapter = atoi(argv[1]);
 	channelsfile = argv[2];
 	if (argc == 4)
@@ -97,6 +118,15 @@ int main(int argc, char *argv[])
 			TIME_CHECK_VAL, (int) dvbdate_to_unixtime(dvbdate));
 		exit(1);
 	}
+	{
+		uint8_t annex_c[5] = { 0xc0, 0x79, 0x12, 0x45, 0x00 };
+
+		if (dvbdate_to_unixtime_fast(annex_c) != TIME_CHECK_MJD_VAL) {
+			fprintf(stderr, "XXXX dvbdate MJD check failed (%i!=%i)\n",
+				TIME_CHECK_MJD_VAL, (int) dvbdate_to_unixtime_fast(annex_c));
+			exit(1);
+		}
+	}
 	seconds_to_dvbduration(DURATION_CHECK_VAL, dvbduration);
 	if (dvbduration_to_seconds(dvbduration) != DURATION_CHECK_VAL) {
 		fprintf(stderr, "XXXX dvbduration function check failed (%i!=%i)\n",
@@ -152,6 +182,8 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 	dvbcfg_zapchannel_parse(channels, channels_cb, (void*) (long) data_type);
+	if (capture)
+		fclose(capture);
         return 0;
 }
 
@@ -164,6 +196,41 @@ void ts_from_file(char *filename, int data_type) {
 	receive_data(fd, 1000000000, data_type);
 }
 
+void sections_from_file(char *filename, int data_type)
+{
+	uint8_t buf[DVB_MAX_SECTION_BYTES];
+	uint32_t timestamp;
+	int pid;
+	int len;
+	FILE *f;
+
+	if ((f = seccap_open(filename)) == NULL) {
+		fprintf(stderr, "Unable to open capture file %s\n", filename);
+		exit(1);
+	}
+	while((len = seccap_read(f, &timestamp, &pid, buf, sizeof(buf))) > 0) {
+		parse_section(buf, len, pid, data_type);
+	}
+	if (len < 0) {
+		fprintf(stderr, "XXXX Bad capture file record\n");
+	}
+	fclose(f);
+}
+
+void capture_section(uint8_t *buf, int len, int pid)
+{
+	struct timeval now;
+	uint32_t timestamp;
+
+	gettimeofday(&now, NULL);
+	timestamp = (now.tv_sec - capture_start.tv_sec) * 1000 +
+		    (now.tv_usec - capture_start.tv_usec) / 1000;
+	if (seccap_write(capture, timestamp, pid, buf, len)) {
+		fprintf(stderr, "Failed to write capture file\n");
+		exit(1);
+	}
+}
+
 int channels_cb(struct dvbcfg_zapchannel *channel, void *private)
 {
 	long data_type = (long) private;
@@ -273,6 +340,9 @@ void receive_data(int _dvrfd, int timeout, int data_type)
 				tsvals.payload += used;
 
 				if (section_status == 1) {
+					if (capture)
+						capture_section(section_buf_data(section_bufs[pid]),
+								section_bufs[pid]->len, pid);
 					parse_section(section_buf_data(section_bufs[pid]),
 						      section_bufs[pid]->len, pid, data_type);
 					section_buf_reset(section_bufs[pid]);
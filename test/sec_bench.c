@@ -0,0 +1,322 @@
+/*
+ * sec_bench - ramp up the number of section filters and their buffer sizes
+ * on a demux, and report how many sections it delivers before overflowing
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbfe.h>
+
+#define MAX_FILTERS	256
+#define MAX_PIDS	32
+#define MAX_BUFFERS	16
+#define MAX_STEPS	(MAX_BUFFERS * 16)
+
+static char *usage_str =
+	"\nusage: sec_bench [options]\n"
+	"  Open more and more section filters on an already tuned adapter and\n"
+	"  measure what the demux delivers, for each buffer size. The knee is\n"
+	"  the most filters before sections overflow, or the total section rate\n"
+	"  stops growing with the number of filters.\n"
+	"\n"
+	"  -a adapter : adapter to use (default 0)\n"
+	"  -d demux   : demux to use (default 0)\n"
+	"  -p pids    : comma separated PIDs the filters are spread over\n"
+	"               (default 0x11,0x12: SDT/BAT and EIT)\n"
+	"  -n count   : filters to ramp up to, doubling from 1 (default 64)\n"
+	"  -b sizes   : comma separated buffer sizes (default 8192,65536,262144)\n"
+	"  -t secs    : seconds per step (default 5)\n"
+	"  -o format  : report as text or csv (default text)\n";
+
+struct step {
+	int buffer;
+	int filters;		/* asked for */
+	int opened;		/* could be set up */
+	double seconds;
+	uint64_t sections;
+	uint64_t bytes;
+	uint64_t wakeups;	/* poll() returns with something ready */
+	uint64_t overflows;	/* EOVERFLOW reads: sections lost */
+	double cpu;		/* process CPU time / wall time */
+};
+
+static int adapter = 0;
+static int demux = 0;
+static int pids[MAX_PIDS] = { 0x11, 0x12 };
+static int pid_count = 2;
+static int buffers[MAX_BUFFERS] = { 8192, 65536, 262144 };
+static int buffer_count = 3;
+
+static int parse_list(char *str, int *values, int max)
+{
+	int count = 0;
+	char *tok;
+
+	for(tok = strtok(str, ","); tok; tok = strtok(NULL, ",")) {
+		if (count == max)
+			return -1;
+		values[count++] = strtol(tok, NULL, 0);
+	}
+	return count;
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static double cpu_s(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + (ru.ru_utime.tv_usec / 1e6) +
+	       ru.ru_stime.tv_sec + (ru.ru_stime.tv_usec / 1e6);
+}
+
+static void run_step(struct step *s, int seconds)
+{
+	struct pollfd pfds[MAX_FILTERS];
+	uint8_t filter[18];
+	uint8_t mask[18];
+	uint8_t buf[4096];
+	double start, end, cpu;
+	int fd;
+	int i;
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+
+	for(s->opened = 0; s->opened < s->filters; s->opened++) {
+		if ((fd = dvbdemux_open_demux(adapter, demux, 1)) < 0)
+			break;
+		if (dvbdemux_set_buffer(fd, s->buffer) ||
+		    dvbdemux_set_section_filter(fd, pids[s->opened % pid_count], filter, mask, 1, 0)) {
+			close(fd);
+			break;
+		}
+		pfds[s->opened].fd = fd;
+		pfds[s->opened].events = POLLIN | POLLPRI;
+	}
+
+	start = now_s();
+	end = start + seconds;
+	cpu = cpu_s();
+	while(s->opened && (now_s() < end)) {
+		if (poll(pfds, s->opened, 100) <= 0)
+			continue;
+		s->wakeups++;
+
+		for(i = 0; i < s->opened; i++) {
+			if (!pfds[i].revents)
+				continue;
+			while(1) {
+				int size = read(pfds[i].fd, buf, sizeof(buf));
+
+				if (size > 0) {
+					s->sections++;
+					s->bytes += size;
+					continue;
+				}
+				if ((size < 0) && (errno == EOVERFLOW)) {
+					s->overflows++;
+					continue;
+				}
+				break;
+			}
+		}
+	}
+	s->seconds = now_s() - start;
+	s->cpu = (cpu_s() - cpu) / s->seconds;
+
+	for(i = 0; i < s->opened; i++)
+		close(pfds[i].fd);
+}
+
+static double rate(struct step *s)
+{
+	return s->seconds ? s->sections / s->seconds : 0;
+}
+
+/* the last step of a buffer size's ramp before it stopped scaling */
+static struct step *knee(struct step *steps, int count)
+{
+	struct step *knee = NULL;
+	int i;
+
+	for(i = 0; i < count; i++) {
+		if (steps[i].overflows || (steps[i].opened < steps[i].filters))
+			break;
+		if (knee && (rate(&steps[i]) <
+			     0.9 * rate(knee) * steps[i].filters / knee->filters))
+			break;
+		knee = &steps[i];
+	}
+	return knee;
+}
+
+static void report(const char *driver, struct step *steps, int count, int csv)
+{
+	struct step *k;
+	int first;
+	int i;
+
+	if (csv)
+		printf("driver,buffer,filters,opened,seconds,sections,sections_per_s,bytes_per_s,"
+		       "wakeups_per_s,sections_per_wakeup,overflows,cpu,knee\n");
+	else
+		printf("driver \"%s\"\n", driver);
+
+	for(first = 0; first < count; first = i) {
+		for(i = first; (i < count) && (steps[i].buffer == steps[first].buffer); i++);
+		k = knee(steps + first, i - first);
+
+		if (!csv && k)
+			printf("  buffer %i: knee %i filters, %.0f sections/s\n", steps[first].buffer,
+			       k->filters, rate(k));
+		else if (!csv)
+			printf("  buffer %i: no knee, a single filter overflows\n", steps[first].buffer);
+
+		for(; first < i; first++) {
+			struct step *s = &steps[first];
+			double wakeups = s->seconds ? s->wakeups / s->seconds : 0;
+			double per = s->wakeups ? (double) s->sections / s->wakeups : 0;
+
+			if (csv) {
+				printf("\"%s\",%i,%i,%i,%.3f,%llu,%.1f,%.1f,%.1f,%.2f,%llu,%.4f,%i\n",
+				       driver, s->buffer, s->filters, s->opened, s->seconds,
+				       (unsigned long long) s->sections, rate(s),
+				       s->seconds ? s->bytes / s->seconds : 0, wakeups, per,
+				       (unsigned long long) s->overflows, s->cpu, s == k);
+				continue;
+			}
+			printf("    %3i filters%s: %9.0f sections/s %10.0f B/s %8.0f wakeups/s "
+			       "%6.2f per wakeup %6llu overflows  cpu %5.1f%%%s\n",
+			       s->opened, (s->opened < s->filters) ? " (max)" : "", rate(s),
+			       s->seconds ? s->bytes / s->seconds : 0, wakeups, per,
+			       (unsigned long long) s->overflows, s->cpu * 100,
+			       (s == k) ? "  <- knee" : "");
+		}
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct step steps[MAX_STEPS];
+	struct dvbfe_handle *fe;
+	struct dvbfe_info info;
+	char driver[128] = "unknown";
+	int max_filters = 64;
+	int seconds = 5;
+	int csv = 0;
+	int count = 0;
+	int opt;
+	int b;
+	int n;
+
+	while((opt = getopt(argc, argv, "a:d:p:n:b:t:o:")) != -1) {
+		switch(opt) {
+		case 'a':
+			adapter = atoi(optarg);
+			break;
+		case 'd':
+			demux = atoi(optarg);
+			break;
+		case 'p':
+			if ((pid_count = parse_list(optarg, pids, MAX_PIDS)) <= 0) {
+				fprintf(stderr, "%s", usage_str);
+				exit(1);
+			}
+			break;
+		case 'n':
+			max_filters = atoi(optarg);
+			if ((max_filters < 1) || (max_filters > MAX_FILTERS)) {
+				fprintf(stderr, "Number of filters must be 1 to %i\n", MAX_FILTERS);
+				exit(1);
+			}
+			break;
+		case 'b':
+			if ((buffer_count = parse_list(optarg, buffers, MAX_BUFFERS)) <= 0) {
+				fprintf(stderr, "%s", usage_str);
+				exit(1);
+			}
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'o':
+			if (!strcmp(optarg, "csv"))
+				csv = 1;
+			else if (strcmp(optarg, "text")) {
+				fprintf(stderr, "%s", usage_str);
+				exit(1);
+			}
+			break;
+		default:
+			fprintf(stderr, "%s", usage_str);
+			exit(1);
+		}
+	}
+	if (seconds < 1) {
+		fprintf(stderr, "%s", usage_str);
+		exit(1);
+	}
+
+	if ((fe = dvbfe_open(adapter, 0, 1)) != NULL) {
+		if (dvbfe_get_info(fe, 0, &info, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) >= 0)
+			snprintf(driver, sizeof(driver), "%s", info.name);
+		dvbfe_close(fe);
+	}
+
+	for(b = 0; b < buffer_count; b++) {
+		for(n = 1; ; n *= 2) {
+			struct step *s = &steps[count++];
+
+			if (n > max_filters)
+				n = max_filters;
+			memset(s, 0, sizeof(struct step));
+			s->buffer = buffers[b];
+			s->filters = n;
+
+			fprintf(stderr, "buffer %i, %i filters...\n", s->buffer, n);
+			run_step(s, seconds);
+			if (s->opened == 0) {
+				fprintf(stderr, "Unable to set up a section filter on adapter%i/demux%i: %m\n",
+					adapter, demux);
+				exit(1);
+			}
+			if ((s->opened < n) || (n == max_filters))
+				break;
+		}
+	}
+
+	report(driver, steps, count, csv);
+	return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ * startup_bench - time how long utilities take from being started to
+ * their first output (or a line of it), and to exiting
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAX_COMMANDS	32
+#define MAX_RUNS	10000
+#define OUTPUT_MAX	65536
+
+static char *usage_str =
+	"\nusage: startup_bench [options] <command> [args] [-- <command> [args]]...\n"
+	"  Start each command over and over, with its output to a pipe, and\n"
+	"  report how long it took to its first output and to exiting. Short\n"
+	"  lived tools are mostly startup, so this is what a script starting\n"
+	"  thousands of them waits for. Separate commands with --.\n"
+	"\n"
+	"  -n runs    : runs of each command (default 20)\n"
+	"  -w runs    : runs of each first, not counted (default 2)\n"
+	"  -m text    : time to the first output holding this (e.g. a line a\n"
+	"               zap prints once tuning), rather than to any output\n"
+	"  -s         : stop each run with SIGINT once it is seen (for those\n"
+	"               which carry on, like zap and femon)\n"
+	"  -t msecs   : kill a run which has not exited after this (default 10000)\n"
+	"  -o format  : report as text or csv (default text)\n";
+
+struct command {
+	char **argv;
+	double first[MAX_RUNS];		/* ms to the output, -1 => none */
+	double exited[MAX_RUNS];	/* ms to the exit */
+	int runs;
+	int failed;			/* runs which exited non-zero or were killed */
+};
+
+static struct command commands[MAX_COMMANDS];
+static int command_count;
+static int runs = 20;
+static int warmups = 2;
+static char *marker = NULL;
+static int stop_at_output = 0;
+static int timeout_ms = 10000;
+static int csv = 0;
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+/*
+ * Run a command once.
+ *
+ * @return 0 if it exited with 0.
+ */
+static int run_once(struct command *cmd, double *first, double *exited)
+{
+	char output[OUTPUT_MAX + 1];
+	int output_len = 0;
+	int pipefd[2];
+	int status;
+	int dead = 0;
+	int interrupted = 0;
+	double start;
+	pid_t pid;
+
+	*first = -1;
+	if (pipe(pipefd)) {
+		perror("pipe");
+		exit(1);
+	}
+
+	start = now_ms();
+	if ((pid = fork()) < 0) {
+		perror("fork");
+		exit(1);
+	}
+	if (pid == 0) {
+		int null = open("/dev/null", O_RDONLY);
+
+		dup2(null, 0);
+		dup2(pipefd[1], 1);
+		dup2(pipefd[1], 2);
+		close(pipefd[0]);
+		close(pipefd[1]);
+		execvp(cmd->argv[0], cmd->argv);
+		_exit(127);
+	}
+	close(pipefd[1]);
+
+	for (;;) {
+		struct pollfd pollfd;
+		int left = timeout_ms - (int) (now_ms() - start);
+		int len;
+
+		if (left <= 0) {
+			kill(pid, SIGKILL);
+			dead = 1;
+			break;
+		}
+		pollfd.fd = pipefd[0];
+		pollfd.events = POLLIN;
+		if (poll(&pollfd, 1, left) <= 0)
+			continue;
+
+		// what came before is kept, so a marker split across reads is found
+		if (output_len == OUTPUT_MAX)
+			output_len = 0;
+		if ((len = read(pipefd[0], output + output_len, OUTPUT_MAX - output_len)) <= 0)
+			break;
+		output_len += len;
+		output[output_len] = 0;
+
+		if ((*first < 0) && ((marker == NULL) || strstr(output, marker))) {
+			*first = now_ms() - start;
+			if (stop_at_output) {
+				kill(pid, SIGINT);
+				interrupted = 1;
+			}
+		}
+	}
+	close(pipefd[0]);
+
+	waitpid(pid, &status, 0);
+	*exited = now_ms() - start;
+	if (interrupted)
+		return 0;
+	return dead || !WIFEXITED(status) || WEXITSTATUS(status);
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double da = *(const double *) a;
+	double db = *(const double *) b;
+
+	return (da > db) - (da < db);
+}
+
+/* min, median, 90th percentile and max of the values >= 0 */
+static int summarise(const double *values, int count, double *out)
+{
+	double sorted[MAX_RUNS];
+	int n = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (values[i] >= 0)
+			sorted[n++] = values[i];
+	}
+	if (n == 0)
+		return 0;
+	qsort(sorted, n, sizeof(double), compare_double);
+	out[0] = sorted[0];
+	out[1] = sorted[n / 2];
+	out[2] = sorted[(n * 9) / 10];
+	out[3] = sorted[n - 1];
+	return n;
+}
+
+static void command_name(struct command *cmd, char *buf, size_t size)
+{
+	size_t len = 0;
+	int i;
+
+	buf[0] = 0;
+	for (i = 0; cmd->argv[i] && (len < size); i++)
+		len += snprintf(buf + len, size - len, "%s%s", i ? " " : "", cmd->argv[i]);
+}
+
+static void report(void)
+{
+	char name[256];
+	double first[4];
+	double exited[4];
+	int seen;
+	int i;
+
+	if (csv)
+		printf("command,runs,failed,output_runs,first_min,first_median,first_p90,first_max,"
+		       "exit_min,exit_median,exit_p90,exit_max\n");
+	else
+		printf("%-32s %5s %6s  %-31s  %s\n", "", "runs", "failed",
+		       "first output ms: min/med/p90/max", "exit ms: min/med/p90/max");
+
+	for (i = 0; i < command_count; i++) {
+		struct command *cmd = &commands[i];
+
+		command_name(cmd, name, sizeof(name));
+		seen = summarise(cmd->first, cmd->runs, first);
+		if (!seen)
+			memset(first, 0, sizeof(first));
+		summarise(cmd->exited, cmd->runs, exited);
+
+		if (csv) {
+			printf("\"%s\",%i,%i,%i,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			       name, cmd->runs, cmd->failed, seen,
+			       first[0], first[1], first[2], first[3],
+			       exited[0], exited[1], exited[2], exited[3]);
+			continue;
+		}
+		printf("%-32.32s %5i %6i  ", name, cmd->runs, cmd->failed);
+		if (seen)
+			printf("%7.2f %7.2f %7.2f %7.2f", first[0], first[1], first[2], first[3]);
+		else
+			printf("%-31s", "        (none)");
+		printf("  %7.2f %7.2f %7.2f %7.2f", exited[0], exited[1], exited[2], exited[3]);
+		if (seen && (seen != cmd->runs))
+			printf("  (output in %i runs)", seen);
+		printf("\n");
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	double first, exited;
+	int opt;
+	int i, j;
+
+	while ((opt = getopt(argc, argv, "+n:w:m:st:o:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			runs = strtol(optarg, NULL, 0);
+			if ((runs < 1) || (runs > MAX_RUNS)) {
+				fprintf(stderr, "%s", usage_str);
+				exit(1);
+			}
+			break;
+		case 'w':
+			warmups = strtol(optarg, NULL, 0);
+			break;
+		case 'm':
+			marker = optarg;
+			break;
+		case 's':
+			stop_at_output = 1;
+			break;
+		case 't':
+			timeout_ms = strtol(optarg, NULL, 0);
+			break;
+		case 'o':
+			if (!strcmp(optarg, "csv"))
+				csv = 1;
+			else if (strcmp(optarg, "text")) {
+				fprintf(stderr, "%s", usage_str);
+				exit(1);
+			}
+			break;
+		default:
+			fprintf(stderr, "%s", usage_str);
+			exit(1);
+		}
+	}
+	if (optind == argc) {
+		fprintf(stderr, "%s", usage_str);
+		exit(1);
+	}
+
+	// split the rest into commands at each --
+	for (i = optind; i < argc; i = j + 1) {
+		for (j = i; (j < argc) && strcmp(argv[j], "--"); j++)
+			;
+		argv[j < argc ? j : argc] = NULL;
+		if (j == i)
+			continue;
+		if (command_count == MAX_COMMANDS) {
+			fprintf(stderr, "Too many commands\n");
+			exit(1);
+		}
+		commands[command_count++].argv = argv + i;
+	}
+	signal(SIGPIPE, SIG_IGN);
+
+	for (i = 0; i < command_count; i++) {
+		struct command *cmd = &commands[i];
+
+		for (j = 0; j < warmups; j++)
+			run_once(cmd, &first, &exited);
+		for (j = 0; j < runs; j++) {
+			if (run_once(cmd, &cmd->first[j], &cmd->exited[j]))
+				cmd->failed++;
+			cmd->runs++;
+		}
+	}
+
+	report();
+	return 0;
+}
@@ -47,6 +47,9 @@
 #include <linux/dvb/audio.h>
 #include <sys/poll.h>
 
+#include "tsfile.h"
+#include "tspace.h"
+
 static char dolby;
 static char audio;
 static char black;
@@ -511,11 +514,11 @@ out:
 	return buf - start;
 }
 
-#define BUFFY 32768
-static void play_file_av(int filefd, int vfd, int afd)
+#define BUFFY (1024 * 1024)
+static void play_file_av(struct tsfile_reader *file, int vfd, int afd, struct tspace *pacer)
 {
-	unsigned char buf[BUFFY];
-	int count;
+	uint8_t *buf;
+	int count, pos, span;
 
 	audioSetMute(afd, 1);
 	videoBlank(vfd, 1);
@@ -552,12 +555,14 @@ static void play_file_av(int filefd, int vfd, int afd)
 		volset = 1;
 	}
 
-#ifndef __stub_posix_fadvise
-	posix_fadvise(filefd, 0, 0, POSIX_FADV_SEQUENTIAL);
-#endif
-
-	while ((count = read(filefd,buf,BUFFY)) > 0)
-		scan_file_av(vfd,afd,buf,count);
+	while ((count = tsfile_read(file, &buf, BUFFY)) > 0) {
+		for (pos = 0; pos < count; pos += span) {
+			span = count - pos;
+			if (pacer)
+				span = tspace_pes_span(pacer, buf + pos, span);
+			scan_file_av(vfd, afd, buf + pos, span);
+		}
+	}
 }
 
 static struct termios term;
@@ -570,7 +575,9 @@ static void restore(void)
 int main(int argc, char **argv)
 {
 	int vfd, afd, c;
-	int filefd;
+	struct tsfile_reader file;
+	struct tspace pacer;
+	int paced;
 	const char *videodev = "/dev/dvb/adapter0/video0";
 	const char *audiodev = "/dev/dvb/adapter0/audio0";
 
@@ -600,7 +607,11 @@ int main(int argc, char **argv)
 			black++;
 			break;
 		case '?':
-			fprintf(stderr, "usage: test_av_play [-d] [-a] [-A] mpeg_A+V_PES_file\n");
+			fprintf(stderr, "usage: test_av_play [-d] [-a] [-A] mpeg_A+V_PES_file\n"
+					"       Setting PACE to a speed (1 = real time, 2 = twice as\n"
+					"       fast) writes the file when its SCRs (or PTSs) say,\n"
+					"       running up to LEAD ms (default %d) ahead.\n",
+					TSPACE_LEAD_MS);
 			return 1;
 		default:
 			break;
@@ -613,6 +624,7 @@ int main(int argc, char **argv)
 		videodev = getenv("VIDEO");
 	if (getenv("AUDIO"))
 		audiodev = getenv("AUDIO");
+	paced = tspace_init_env(&pacer);
 
 	printf("using video device '%s'\n", videodev);
 	printf("using audio device '%s'\n", audiodev);
@@ -633,7 +645,7 @@ int main(int argc, char **argv)
 	putchar('\n');
 
 	errno = ENOENT;
-	if (!argv[0] || (filefd = open(argv[0], O_RDONLY)) < 0) {
+	if (!argv[0] || tsfile_reader_open(&file, argv[0], BUFFY)) {
 		perror("File open:");
 		return -1;
 	}
@@ -646,9 +658,9 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
-	play_file_av(filefd, vfd, afd);
+	play_file_av(&file, vfd, afd, paced ? &pacer : NULL);
 	close(vfd);
 	close(afd);
-	close(filefd);
+	tsfile_reader_close(&file);
 	return 0;
 }
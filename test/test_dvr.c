@@ -32,11 +32,23 @@
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <time.h>
+#include <signal.h>
 
 #include <linux/dvb/dmx.h>
+#include <libdvbapi/dvbdemux.h>
+
+#include "tsfile.h"
 
 static unsigned long BUF_SIZE = 64 * 1024;
 static unsigned long long total_bytes;
+static struct dvbdemux_dvr_stats stats;
+static int stats_interval;
+static time_t stats_time;
+static unsigned long long stats_bytes;
+static volatile sig_atomic_t quit;
+static struct dvbdemux_tts tts;
+static uint8_t *tts_buf;
 
 static void usage(void)
 {
@@ -48,9 +60,22 @@ static void usage(void)
 			"       The demux and dvr devices used can be changed by setting\n"
 			"       the environment variables DEMUX and DVR.\n"
 			"       You can override the input buffer size by setting BUF_SIZE to\n"
-			"       the number of bytes wanted.\n"
-			"       Note: There is no output buffering, so writing to stdout is\n"
-			"       not really supported, but you can try something like:\n"
+			"       the number of bytes wanted, and allocate it from huge pages\n"
+			"       by setting HUGEPAGES=1. DVR_BUFFER sets the size of the\n"
+			"       kernel's DVR buffer.\n"
+			"       Where the kernel supports it, the data is taken straight\n"
+			"       from mapped DVR buffers of BUF_SIZE bytes, without read();\n"
+			"       set NOMMAP=1 to read anyway.\n"
+			"       Setting STATS to a number of seconds replaces the output\n"
+			"       for every read with the estimated DVR fill level, overflow\n"
+			"       count and throughput every STATS seconds.\n"
+			"       A file is written in batches of WRITE_BATCH bytes (default\n"
+			"       4MB), and the disk space is reserved ahead of the data.\n"
+			"       Setting TTS=1 writes 192 byte packets instead, each after\n"
+			"       a 4 byte 27 MHz arrival timestamp (as in M2TS files), for\n"
+			"       jitter analysis and for test_dvr_play to replay as it came.\n"
+			"       Anything else is written straight through, so you can try\n"
+			"       something like:\n"
 			"       BUF_SIZE=188 ./test_dvr /dev/stdout 0 2>/dev/null | xxd\n"
 			"       ./test_dvr /dev/stdout 0x100 0x110 2>/dev/null| xine stdin://mpeg2\n"
 			"\n");
@@ -58,13 +83,41 @@ static void usage(void)
 }
 
 
-static void process_data(int dvrfd, int tsfd)
+static void print_stats(void)
+{
+	time_t now = time(NULL);
+
+	if (now < stats_time + stats_interval)
+		return;
+
+	fprintf(stderr, "DVR fill %d%% (peak %d%%) of %d bytes, %llu overflows, %.2f Mbit/s\n",
+		dvbdemux_dvr_stats_fill(&stats, 0), dvbdemux_dvr_stats_fill(&stats, 1),
+		stats.buffer_size, (unsigned long long) stats.overflows,
+		(total_bytes - stats_bytes) * 8.0 / 1000000.0 / (now - stats_time));
+	stats_time = now;
+	stats_bytes = total_bytes;
+}
+
+static void signal_handler(int sig)
+{
+	(void) sig;
+
+	quit = 1;
+}
+
+static void process_data(int dvrfd, struct dvbdemux_stream *stream,
+			 struct tsfile_writer *ts, uint8_t *buf)
 {
-	uint8_t buf[BUF_SIZE];
-	int bytes, b2;
+	int bytes, out;
 
-	bytes = read(dvrfd, buf, sizeof(buf));
+	if (stream)
+		bytes = dvbdemux_stream_get(stream, &buf);
+	else
+		bytes = read(dvrfd, buf, BUF_SIZE);
+	dvbdemux_dvr_stats_update(&stats, BUF_SIZE, bytes);
 	if (bytes < 0) {
+		if (errno == EINTR)
+			return;
 		perror("read");
 		if (errno == EOVERFLOW)
 			return;
@@ -72,12 +125,16 @@ static void process_data(int dvrfd, int tsfd)
 		exit(1);
 	}
 	total_bytes += bytes;
-	b2 = write(tsfd, buf, bytes);
-	if (b2 == -1) {
+	out = bytes;
+	if (tts_buf) {
+		out = dvbdemux_tts_stamp(&tts, buf, bytes, tts_buf, dvbdemux_tts_now());
+		buf = tts_buf;
+	}
+	if (tsfile_write(ts, buf, out)) {
 		perror("write");
 		exit(1);
-	} else if (b2 < bytes)
-		fprintf(stderr, "warning: read %d, but wrote only %d bytes\n", bytes, b2);
+	} else if (stats_interval)
+		print_stats();
 	else
 		fprintf(stderr, "got %d bytes (%llu total)\n", bytes, total_bytes);
 }
@@ -112,12 +169,20 @@ static int add_filter(unsigned int pid, const char* dmxdev)
 
 int main(int argc, char *argv[])
 {
-	int dvrfd, tsfd;
+	int dvrfd;
+	struct dvbdemux_stream *stream = NULL;
+	struct tsfile_writer ts;
+	struct sigaction sa;
+	size_t batch = 0;
 	unsigned int pid;
 	char *dmxdev = "/dev/dvb/adapter0/demux0";
 	char *dvrdev = "/dev/dvb/adapter0/dvr0";
 	int i;
 	char *chkp;
+	uint8_t *buf;
+	size_t buf_size;
+	int hugepages = 0;
+	int dvr_buffer = DVBDEMUX_DVR_DEFAULT_BUFFER;
 
 	if (argc < 3)
 		usage();
@@ -129,8 +194,9 @@ int main(int argc, char *argv[])
 
 	fprintf(stderr, "using '%s' and '%s'\n"
 		"writing to '%s'\n", dmxdev, dvrdev, argv[1]);
-	tsfd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0664);
-	if (tsfd == -1) {
+	if (getenv("WRITE_BATCH"))
+		batch = strtoul(getenv("WRITE_BATCH"), NULL, 0);
+	if (tsfile_writer_open(&ts, argv[1], batch)) {
 		perror("cannot write output file");
 		return 1;
 	}
@@ -144,6 +210,49 @@ int main(int argc, char *argv[])
 	if (getenv("BUF_SIZE") && ((BUF_SIZE = strtoul(getenv("BUF_SIZE"), NULL, 0)) > 0))
 		fprintf(stderr, "BUF_SIZE = %lu\n", BUF_SIZE);
 
+	if (getenv("HUGEPAGES"))
+		hugepages = atoi(getenv("HUGEPAGES"));
+	buf_size = BUF_SIZE;
+	buf = dvbdemux_alloc_buffer(&buf_size, &hugepages);
+	if (buf == NULL) {
+		perror("cannot allocate buffer");
+		return 1;
+	}
+	if (hugepages)
+		fprintf(stderr, "buffer is in huge pages\n");
+
+	if (getenv("TTS") && atoi(getenv("TTS"))) {
+		tts_buf = malloc(DVBDEMUX_TTS_SIZE(BUF_SIZE));
+		if (tts_buf == NULL) {
+			perror("cannot allocate buffer");
+			return 1;
+		}
+		dvbdemux_tts_init(&tts);
+		fprintf(stderr, "writing timestamped packets\n");
+	}
+
+	if (getenv("DVR_BUFFER")) {
+		dvr_buffer = strtoul(getenv("DVR_BUFFER"), NULL, 0);
+		if (ioctl(dvrfd, DMX_SET_BUFFER_SIZE, dvr_buffer) == -1) {
+			perror("DMX_SET_BUFFER_SIZE");
+			return 1;
+		}
+	}
+	dvbdemux_dvr_stats_init(&stats, dvr_buffer);
+	if (getenv("STATS"))
+		stats_interval = atoi(getenv("STATS"));
+	stats_time = time(NULL);
+
+	if (!getenv("NOMMAP") || !atoi(getenv("NOMMAP"))) {
+		stream = dvbdemux_stream_open(dvrfd, 0, BUF_SIZE);
+		if (stream && !dvbdemux_stream_mapped(stream)) {
+			dvbdemux_stream_close(stream);
+			stream = NULL;
+		}
+		if (stream)
+			fprintf(stderr, "streaming from mapped DVR buffers\n");
+	}
+
 	for (i = 2; i < argc; i++) {
 		pid = strtoul(argv[i], &chkp, 0);
 		if (pid > 0x2000 || chkp == argv[i])
@@ -154,10 +263,22 @@ int main(int argc, char *argv[])
 			return 1;
 	}
 
-	for (;;) {
-		process_data(dvrfd, tsfd);
+	/* the last batch is still to be written when we are stopped */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	while (!quit) {
+		process_data(dvrfd, stream, &ts, buf);
 	}
+	if (stream)
+		dvbdemux_stream_close(stream);
 
+	if (tsfile_writer_close(&ts)) {
+		perror("write");
+		return 1;
+	}
 	close(dvrfd);
 	return 0;
 }
@@ -37,32 +37,149 @@
 
 #include <linux/dvb/dmx.h>
 
+#include "tsfile.h"
+#include "tspace.h"
+
 
 #define BUFSIZE (512*188)
+#define TTS_SIZE 192
 
-void play_file_dvr(int filefd, int dvrfd)
+/* sleep until the data so far is due at rate bits/s */
+static void pace(struct timespec *start, unsigned long long total, unsigned long long rate)
 {
-	char buf[BUFSIZE];
-	int count, written, bytes, total = 0;
+	unsigned long long ns = total * 8 * 1000000000ULL / rate;
+	struct timespec due;
 
-	while ((count = read(filefd, buf, BUFSIZE)) > 0) {
-		total += count;
-		fprintf(stderr, "read  %d (%d total)\n", count, total);
-		written = 0;
-		while (written < count) {
-			bytes = write(dvrfd, buf + written, count - written);
+	due.tv_sec = start->tv_sec + ns / 1000000000ULL;
+	due.tv_nsec = start->tv_nsec + ns % 1000000000ULL;
+	if (due.tv_nsec >= 1000000000L) {
+		due.tv_sec++;
+		due.tv_nsec -= 1000000000L;
+	}
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+		;
+}
+
+static int write_dvr(int dvrfd, const uint8_t *buf, int count, int verbose)
+{
+	int written = 0, bytes;
+
+	while (written < count) {
+		bytes = write(dvrfd, buf + written, count - written);
+		if (verbose)
 			fprintf(stderr, "write %d\n", bytes);
-			if (bytes < 0) {
-				perror("write dvr");
-				return;
+		if (bytes < 0) {
+			perror("write dvr");
+			return -1;
+		}
+		else if (bytes == 0) {
+			fprintf(stderr, "write dvr: 0 bytes !");
+			return -1;
+		}
+		written += bytes;
+	}
+	return 0;
+}
+
+/* write whole timestamped packets without their stamps, len bytes of them */
+static int write_tts(int dvrfd, const uint8_t *buf, int count, int verbose)
+{
+	static uint8_t ts[BUFSIZE];
+	int pos, len;
+
+	while (count >= TTS_SIZE) {
+		for (pos = 0, len = 0; pos + TTS_SIZE <= count && len + 188 <= BUFSIZE; pos += TTS_SIZE) {
+			memcpy(ts + len, buf + pos + 4, 188);
+			len += 188;
+		}
+		if (write_dvr(dvrfd, ts, len, verbose))
+			return -1;
+		buf += pos;
+		count -= pos;
+	}
+	return 0;
+}
+
+/* write count bytes at buf, timestamped or not, as pacer says */
+static int play_span(int dvrfd, const uint8_t *buf, int count, int tts,
+		     struct tspace *pacer, int verbose)
+{
+	int pos, span;
+
+	for (pos = 0; pos < count; pos += span) {
+		span = count - pos;
+		if (tts) {
+			if (pacer)
+				span = tspace_tts_span(pacer, buf + pos, span);
+			if (write_tts(dvrfd, buf + pos, span, verbose))
+				return -1;
+		} else {
+			if (pacer)
+				span = tspace_ts_span(pacer, buf + pos, span);
+			if (write_dvr(dvrfd, buf + pos, span, verbose))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+void play_file_dvr(struct tsfile_reader *file, int dvrfd, unsigned long long rate,
+		   struct tspace *pacer, int verbose)
+{
+	uint8_t *buf;
+	struct timespec start;
+	unsigned long long total = 0;
+	struct tspace tts_pacer;
+	uint8_t carry[TTS_SIZE];
+	int carried = 0;
+	int tts = -1;
+	int count, pos;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while ((count = tsfile_read(file, &buf, BUFSIZE)) > 0) {
+		/* timestamped packets are played as they came, but for RATE */
+		if (tts == -1 && (tts = tspace_is_tts(buf, count))) {
+			fprintf(stderr, "timestamped packets, playing at their arrival times\n");
+			if (!rate && !pacer) {
+				tspace_init(&tts_pacer, 1.0, 0, -1);
+				pacer = &tts_pacer;
+				verbose = 0;
 			}
-			else if (bytes == 0) {
-				fprintf(stderr, "write dvr: 0 bytes !");
+		}
+		if (rate)
+			pace(&start, total, rate);
+		total += count;
+		if (verbose)
+			fprintf(stderr, "read  %d (%llu total)\n", count, total);
+
+		if (!tts) {
+			if (play_span(dvrfd, buf, count, 0, pacer, verbose))
 				return;
-			}
-			written += bytes;
+			continue;
+		}
+
+		/* a packet split between reads is put together first */
+		pos = 0;
+		if (carried) {
+			pos = TTS_SIZE - carried;
+			if (pos > count)
+				pos = count;
+			memcpy(carry + carried, buf, pos);
+			carried += pos;
+			if (carried < TTS_SIZE)
+				continue;
+			if (play_span(dvrfd, carry, TTS_SIZE, 1, pacer, verbose))
+				return;
+			carried = 0;
 		}
+		count -= pos;
+		if (play_span(dvrfd, buf + pos, count - count % TTS_SIZE, 1, pacer, verbose))
+			return;
+		carried = count % TTS_SIZE;
+		memcpy(carry, buf + pos + count - carried, carried);
 	}
+	if (count < 0)
+		perror("read");
 }
 
 void set_pid(int fd, int pid, int type)
@@ -90,17 +207,30 @@ int main(int argc, char **argv)
 	char *dmxdev = "/dev/dvb/adapter0/demux0";
 	char *dvrdev = "/dev/dvb/adapter0/dvr0";
 	int vpid, apid;
-	int filefd, dvrfd, vfd, afd;
+	int dvrfd, vfd, afd;
+	struct tsfile_reader file;
+	unsigned long long rate = 0;
+	struct tspace pacer;
+	int paced;
 
 	if (argc < 4) {
-		fprintf(stderr, "usage: test_dvr_play TS-file video-PID audio-PID\n");
+		fprintf(stderr, "usage: test_dvr_play TS-file video-PID audio-PID\n"
+				"       Setting RATE to a number of bits/s writes the file\n"
+				"       at that rate rather than as fast as the device takes\n"
+				"       it, and turns off the output for every write.\n"
+				"       Setting PACE to a speed (1 = real time, 2 = twice as\n"
+				"       fast) writes it when its PCRs say, running up to LEAD\n"
+				"       ms (default %d) ahead; PCRPID picks the PCRs to use.\n"
+				"       A file of 192 byte timestamped packets (M2TS, or\n"
+				"       test_dvr with TTS=1) is played at their arrival times\n"
+				"       instead, i.e. as if PACE=1 LEAD=0, unless RATE is set.\n",
+				TSPACE_LEAD_MS);
 		return 1;
 	}
 	vpid = strtoul(argv[2], NULL, 0);
 	apid = strtoul(argv[3], NULL, 0);
 
-	filefd = open(argv[1], O_RDONLY);
-	if (filefd == -1) {
+	if (tsfile_reader_open(&file, argv[1], BUFSIZE)) {
 		fprintf(stderr, "Failed to open '%s': %d %m\n", argv[1], errno);
 		return 1;
 	}
@@ -112,6 +242,9 @@ int main(int argc, char **argv)
 		dmxdev = getenv("DEMUX");
 	if (getenv("DVR"))
 		dvrdev = getenv("DVR");
+	if (getenv("RATE"))
+		rate = strtoull(getenv("RATE"), NULL, 0);
+	paced = tspace_init_env(&pacer);
 
 	if ((dvrfd = open(dvrdev, O_WRONLY)) == -1) {
 		fprintf(stderr, "Failed to open '%s': %d %m\n", dvrdev, errno);
@@ -133,11 +266,11 @@ int main(int argc, char **argv)
 	set_pid(afd, apid, DMX_PES_AUDIO);
 	set_pid(vfd, vpid, DMX_PES_VIDEO);
 
-	play_file_dvr(filefd, dvrfd);
+	play_file_dvr(&file, dvrfd, rate, paced ? &pacer : NULL, (rate == 0) && !paced);
 
 	close(dvrfd);
 	close(afd);
 	close(vfd);
-	close(filefd);
+	tsfile_reader_close(&file);
 	return 0;
 }
@@ -23,6 +23,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -31,17 +32,23 @@
 #include <errno.h>
 
 #include <linux/dvb/dmx.h>
+#include <libucsi/pes_reasm.h>
 
 #include "hex_dump.h"
 
 #define MAX_PES_SIZE (4*1024)
+#define TS_BUF_SIZE (512*188)
+#define MAX_ES_PES_SIZE (1024*1024)
 
 
 void usage(void)
 {
-	fprintf(stderr, "usage: test_pes PID [filename]\n");
+	fprintf(stderr, "usage: test_pes [-t] PID [filename]\n");
 	fprintf(stderr, "       Print a hexdump of PES packets from PID to stdout.\n");
-	fprintf(stderr, "  filename : Write binary PES data to file (no hexdump).\n");
+	fprintf(stderr, "  -t       : Take the PID as TS packets and reassemble the PES\n");
+	fprintf(stderr, "             packets here; print their PTS/DTS instead.\n");
+	fprintf(stderr, "  filename : Write binary PES data to file (no hexdump);\n");
+	fprintf(stderr, "             with -t, the elementary stream.\n");
 	fprintf(stderr, "       The default demux device used can be changed\n");
 	fprintf(stderr, "       using the DEMUX environment variable\n");
 	exit(1);
@@ -75,13 +82,49 @@ void process_pes(int fd, FILE *out)
 	}
 }
 
-int set_filter(int fd, unsigned int pid)
+static void es_ready(void *private, const struct pes_packet_info *info,
+		     const struct iovec *iov, int iovcnt)
+{
+	int *outfd = (int *) private;
+
+	printf("stream 0x%02x %6u bytes", info->stream_id, info->payload_length);
+	if (info->flags & pes_packet_flag_pts)
+		printf(" pts %10llu", (unsigned long long) info->pts);
+	if (info->flags & pes_packet_flag_dts)
+		printf(" dts %10llu", (unsigned long long) info->dts);
+	if (info->flags & pes_packet_flag_discontinuity)
+		printf(" (data lost)");
+	printf("\n");
+
+	if ((*outfd != -1) && pes_write_iov(*outfd, iov, iovcnt))
+		perror("write output");
+}
+
+void process_ts(int fd, struct pes_reasm *reasm, int *outfd)
+{
+	uint8_t buf[TS_BUF_SIZE];
+	int bytes;
+
+	bytes = read(fd, buf, sizeof(buf));
+	if (bytes < 0) {
+		if (errno == EOVERFLOW) {
+			fprintf(stderr, "read error: buffer overflow (%d)\n",
+					EOVERFLOW);
+			return;
+		}
+		perror("read");
+		exit(1);
+	}
+	pes_reasm_add_packets(reasm, buf, bytes, es_ready, outfd);
+}
+
+int set_filter(int fd, unsigned int pid, int ts)
 {
 	struct dmx_pes_filter_params f;
 
 	f.pid = (uint16_t) pid;
 	f.input = DMX_IN_FRONTEND;
-	f.output = DMX_OUT_TAP;
+	f.output = ts ? DMX_OUT_TSDEMUX_TAP : DMX_OUT_TAP;
 	f.pes_type = DMX_PES_OTHER;
 	f.flags = DMX_IMMEDIATE_START;
 	if (ioctl(fd, DMX_SET_PES_FILTER, &f) == -1) {
@@ -98,7 +141,15 @@ int main(int argc, char *argv[])
 	unsigned long pid;
 	char *dmxdev = "/dev/dvb/adapter0/demux0";
 	FILE *out = stdout;
-
+	struct pes_reasm *reasm = NULL;
+	int outfd = -1;
+	int ts = 0;
+
+	if (argc > 1 && !strcmp(argv[1], "-t")) {
+		ts = 1;
+		argc--;
+		argv++;
+	}
 	if (argc != 2 && argc != 3)
 		usage();
 
@@ -118,6 +169,15 @@ int main(int argc, char *argv[])
 			exit(1);
 		}
 		fprintf(stderr, "          output to '%s'\n", argv[2]);
+		outfd = fileno(out);
+	}
+
+	if (ts) {
+		if ((reasm = pes_reasm_create(1, MAX_ES_PES_SIZE, 0)) == NULL ||
+		    pes_reasm_add_pid(reasm, pid)) {
+			fprintf(stderr, "failed to create PES reassembler\n");
+			return 1;
+		}
 	}
 
 	if ((dmxfd = open(dmxdev, O_RDWR)) < 0){
@@ -125,11 +185,14 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	if (set_filter(dmxfd, pid) != 0)
+	if (set_filter(dmxfd, pid, ts) != 0)
 		return 1;
 
 	for (;;) {
-		process_pes(dmxfd, out);
+		if (ts)
+			process_ts(dmxfd, reasm, &outfd);
+		else
+			process_pes(dmxfd, out);
 	}
 
 	close(dmxfd);
@@ -37,11 +37,15 @@
 #include <sys/ioctl.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <signal.h>
 
 #include <linux/dvb/dmx.h>
 
+#include "tsfile.h"
+
 static unsigned long BUF_SIZE = 64 * 1024;
 static unsigned long long total_bytes;
+static volatile sig_atomic_t quit;
 
 static void usage(void)
 {
@@ -54,8 +58,10 @@ static void usage(void)
 			"       the environment variable DEMUX.\n"
 			"       You can override the input buffer size by setting BUF_SIZE to\n"
 			"       the number of bytes wanted.\n"
-			"       Note: There is no output buffering, so writing to stdout is\n"
-			"       not really supported, but you can try something like:\n"
+			"       A file is written in batches of WRITE_BATCH bytes (default\n"
+			"       4MB), and the disk space is reserved ahead of the data.\n"
+			"       Anything else is written straight through, so you can try\n"
+			"       something like:\n"
 			"       BUF_SIZE=188 ./test_tapdmx /dev/stdout 0 2>/dev/null | xxd\n"
 			"       ./test_tapdmx /dev/stdout 0x100 0x110 2>/dev/null| xine stdin://mpeg2\n"
 			"\n");
@@ -63,13 +69,21 @@ static void usage(void)
 }
 
 
-static void process_data(int dvrfd, int tsfd)
+static void signal_handler(int sig)
+{
+	(void) sig;
+
+	quit = 1;
+}
+
+static void process_data(int dvrfd, struct tsfile_writer *ts, uint8_t *buf)
 {
-	uint8_t buf[BUF_SIZE];
-	int bytes, b2;
+	int bytes;
 
-	bytes = read(dvrfd, buf, sizeof(buf));
+	bytes = read(dvrfd, buf, BUF_SIZE);
 	if (bytes < 0) {
+		if (errno == EINTR)
+			return;
 		perror("read");
 		if (errno == EOVERFLOW)
 			return;
@@ -77,19 +91,20 @@ static void process_data(int dvrfd, int tsfd)
 		exit(1);
 	}
 	total_bytes += bytes;
-	b2 = write(tsfd, buf, bytes);
-	if (b2 == -1) {
+	if (tsfile_write(ts, buf, bytes)) {
 		perror("write");
 		exit(1);
-	} else if (b2 < bytes)
-		fprintf(stderr, "warning: read %d, but wrote only %d bytes\n", bytes, b2);
-	else
+	} else
 		fprintf(stderr, "got %d bytes (%llu total)\n", bytes, total_bytes);
 }
 
 int main(int argc, char *argv[])
 {
-	int dmxfd, tsfd;
+	int dmxfd;
+	struct tsfile_writer ts;
+	struct sigaction sa;
+	size_t batch = 0;
+	uint8_t *buf;
 	unsigned int pid;
 	struct dmx_pes_filter_params f;
 	char *dmxdev = "/dev/dvb/adapter0/demux0";
@@ -104,8 +119,9 @@ int main(int argc, char *argv[])
 
 	fprintf(stderr, "using '%s'\n"
 		"writing to '%s'\n", dmxdev, argv[1]);
-	tsfd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC | O_LARGEFILE, 0664);
-	if (tsfd == -1) {
+	if (getenv("WRITE_BATCH"))
+		batch = strtoul(getenv("WRITE_BATCH"), NULL, 0);
+	if (tsfile_writer_open(&ts, argv[1], batch)) {
 		perror("cannot write output file");
 		return 1;
 	}
@@ -118,6 +134,11 @@ int main(int argc, char *argv[])
 
 	if (getenv("BUF_SIZE") && ((BUF_SIZE = strtoul(getenv("BUF_SIZE"), NULL, 0)) > 0))
 		fprintf(stderr, "BUF_SIZE = %lu\n", BUF_SIZE);
+	buf = malloc(BUF_SIZE);
+	if (buf == NULL) {
+		perror("cannot allocate buffer");
+		return 1;
+	}
 
 	pid = strtoul(argv[2], &chkp, 0);
 	if (pid > 0x2000 || chkp == argv[2])
@@ -151,10 +172,21 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	for (;;) {
-		process_data(dmxfd, tsfd);
+	/* the last batch is still to be written when we are stopped */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	while (!quit) {
+		process_data(dmxfd, &ts, buf);
 	}
 
+	if (tsfile_writer_close(&ts)) {
+		perror("write");
+		return 1;
+	}
+	free(buf);
 	close(dmxfd);
 	return 0;
 }
@@ -36,6 +36,9 @@
 #include <linux/dvb/video.h>
 #include <sys/poll.h>
 
+#include "tsfile.h"
+#include "tspace.h"
+
 int videoStop(int fd)
 {
 	int ans;
@@ -221,13 +224,13 @@ int videoStillPicture(int fd, struct video_still_picture *sp)
 	return 0;
 }
 
-#define BUFFY 32768
+#define BUFFY (1024 * 1024)
 #define NFD   2
-void play_file_video(int filefd, int fd)
+void play_file_video(struct tsfile_reader *file, int fd, struct tspace *pacer)
 {
-	char buf[BUFFY];
-	int count;
-	int written;
+	uint8_t *buf;
+	int count, pos, span;
+	int written, bytes;
 	struct pollfd pfd[NFD];
 //	int stopped = 0;
 
@@ -241,63 +244,67 @@ void play_file_video(int filefd, int fd)
 	videoPlay(fd);
 
 
-	count = read(filefd,buf,BUFFY);
-	write(fd,buf,count);
-
-	while ( (count = read(filefd,buf,BUFFY)) >= 0  ){
-		written = 0;
-		while(written < count){
-			if (poll(pfd,NFD,1)){
-				if (pfd[1].revents & POLLOUT){
-					written += write(fd,buf+written,
-							count-written);
-				}
-				if (pfd[0].revents & POLLIN){
-					int c = getchar();
-					switch(c){
-					case 'z':
-						videoFreeze(fd);
-						printf("playback frozen\n");
-//						stopped = 1;
-						break;
-
-					case 's':
-						videoStop(fd);
-						printf("playback stopped\n");
-//						stopped = 1;
-						break;
-
-					case 'c':
-						videoContinue(fd);
-						printf("playback continued\n");
-//						stopped = 0;
-						break;
-
-					case 'p':
-						videoPlay(fd);
-						printf("playback started\n");
-//						stopped = 0;
-						break;
-
-					case 'f':
-						videoFastForward(fd,0);
-						printf("fastforward\n");
-//						stopped = 0;
-						break;
-
-					case 'm':
-						videoSlowMotion(fd,2);
-						printf("slowmotion\n");
-//						stopped = 0;
-						break;
-
-					case 'q':
-						videoContinue(fd);
-						exit(0);
-						break;
+	while ((count = tsfile_read(file, &buf, BUFFY)) > 0) {
+		for (pos = 0; pos < count; pos += span) {
+			span = count - pos;
+			if (pacer)
+				span = tspace_pes_span(pacer, buf + pos, span);
+			written = 0;
+			while(written < span){
+				if (poll(pfd,NFD,1)){
+					if (pfd[1].revents & POLLOUT){
+						bytes = write(fd, buf + pos + written,
+							      span - written);
+						if (bytes > 0)
+							written += bytes;
+					}
+					if (pfd[0].revents & POLLIN){
+						int c = getchar();
+						switch(c){
+						case 'z':
+							videoFreeze(fd);
+							printf("playback frozen\n");
+//							stopped = 1;
+							break;
+
+						case 's':
+							videoStop(fd);
+							printf("playback stopped\n");
+//							stopped = 1;
+							break;
+
+						case 'c':
+							videoContinue(fd);
+							printf("playback continued\n");
+//							stopped = 0;
+							break;
+
+						case 'p':
+							videoPlay(fd);
+							printf("playback started\n");
+//							stopped = 0;
+							break;
+
+						case 'f':
+							videoFastForward(fd,0);
+							printf("fastforward\n");
+//							stopped = 0;
+							break;
+
+						case 'm':
+							videoSlowMotion(fd,2);
+							printf("slowmotion\n");
+//							stopped = 0;
+							break;
+
+						case 'q':
+							videoContinue(fd);
+							exit(0);
+							break;
+						}
 					}
-				}
 
+				}
 			}
 		}
 	}
@@ -329,11 +336,20 @@ void load_iframe(int filefd, int fd)
 int main(int argc, char **argv)
 {
 	int fd;
-	int filefd;
-
-	if (argc < 2) return -1;
+	struct tsfile_reader file;
+	struct tspace pacer;
+	int paced;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: test_video video_PES_file\n"
+				"       Setting PACE to a speed (1 = real time, 2 = twice as\n"
+				"       fast) writes the file when its PTSs say, running up to\n"
+				"       LEAD ms (default %d) ahead.\n", TSPACE_LEAD_MS);
+		return -1;
+	}
+	paced = tspace_init_env(&pacer);
 
-	if ( (filefd = open(argv[1],O_RDONLY)) < 0){
+	if (tsfile_reader_open(&file, argv[1], BUFFY)){
 		perror("File open:");
 		return -1;
 	}
@@ -356,10 +372,10 @@ int main(int argc, char **argv)
 	videoGetStatus(fd);
 
 
-	//load_iframe(filefd, fd);
-	play_file_video(filefd, fd);
+	//load_iframe(file.fd, fd);
+	play_file_video(&file, fd, paced ? &pacer : NULL);
 	close(fd);
-	close(filefd);
+	tsfile_reader_close(&file);
 	return 0;
 
 
@@ -0,0 +1,174 @@
+/* tsfile.c -- streaming TS file reader and writer for the test tools
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "tsfile.h"
+
+
+int tsfile_reader_open(struct tsfile_reader *r, const char *filename, size_t chunk)
+{
+	struct stat st;
+
+	memset(r, 0, sizeof(*r));
+	r->fd = open(filename, O_RDONLY);
+	if (r->fd == -1)
+		return -1;
+
+	if (fstat(r->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    (uint64_t) st.st_size <= (size_t) -1) {
+		r->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, r->fd, 0);
+		if (r->map != MAP_FAILED) {
+			r->size = st.st_size;
+			madvise(r->map, r->size, MADV_SEQUENTIAL);
+			return 0;
+		}
+		r->map = NULL;
+	}
+
+	r->buf_size = chunk;
+	r->buf = malloc(chunk);
+	if (r->buf == NULL) {
+		close(r->fd);
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+ssize_t tsfile_read(struct tsfile_reader *r, uint8_t **data, size_t max)
+{
+	ssize_t count;
+
+	if (r->map) {
+		if (max > r->size - r->pos)
+			max = r->size - r->pos;
+		*data = r->map + r->pos;
+		r->pos += max;
+		return max;
+	}
+
+	if (max > r->buf_size)
+		max = r->buf_size;
+	do {
+		count = read(r->fd, r->buf, max);
+	} while (count == -1 && errno == EINTR);
+	*data = r->buf;
+	return count;
+}
+
+void tsfile_reader_close(struct tsfile_reader *r)
+{
+	if (r->map)
+		munmap(r->map, r->size);
+	free(r->buf);
+	close(r->fd);
+}
+
+int tsfile_writer_open(struct tsfile_writer *w, const char *filename, size_t batch)
+{
+	struct stat st;
+
+	memset(w, 0, sizeof(*w));
+	w->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+	if (w->fd == -1)
+		return -1;
+	w->regular = fstat(w->fd, &st) == 0 && S_ISREG(st.st_mode);
+
+	w->buf_size = batch ? batch : TSFILE_WRITE_BATCH;
+	if (posix_memalign((void **) &w->buf, 4096, w->buf_size)) {
+		close(w->fd);
+		errno = ENOMEM;
+		return -1;
+	}
+	return 0;
+}
+
+int tsfile_flush(struct tsfile_writer *w)
+{
+	size_t done = 0;
+	ssize_t count;
+
+	if (w->regular && w->allocated >= 0 && w->offset + (int64_t) w->buf_len > w->allocated) {
+		/* only the blocks are reserved, the size follows the data */
+		if (fallocate(w->fd, FALLOC_FL_KEEP_SIZE, w->offset, w->buf_len + TSFILE_ALLOC_STEP) == 0)
+			w->allocated = w->offset + w->buf_len + TSFILE_ALLOC_STEP;
+		else
+			w->allocated = -1;	/* not supported here, don't try again */
+	}
+
+	while (done < w->buf_len) {
+		if (w->regular)
+			count = pwrite(w->fd, w->buf + done, w->buf_len - done, w->offset);
+		else
+			count = write(w->fd, w->buf + done, w->buf_len - done);
+		if (count == -1) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += count;
+		w->offset += count;
+	}
+	w->buf_len = 0;
+	return 0;
+}
+
+int tsfile_write(struct tsfile_writer *w, const uint8_t *data, size_t len)
+{
+	size_t copy;
+
+	while (len) {
+		copy = w->buf_size - w->buf_len;
+		if (copy > len)
+			copy = len;
+		memcpy(w->buf + w->buf_len, data, copy);
+		w->buf_len += copy;
+		data += copy;
+		len -= copy;
+
+		/* a pipe's reader wants the data now */
+		if ((w->buf_len == w->buf_size || !w->regular) && tsfile_flush(w))
+			return -1;
+	}
+	return 0;
+}
+
+int tsfile_writer_close(struct tsfile_writer *w)
+{
+	int ret = tsfile_flush(w);
+
+	/* give back the space reserved past the end */
+	if (w->regular && w->allocated > w->offset && ftruncate(w->fd, w->offset) && !ret)
+		ret = -1;
+	free(w->buf);
+	if (close(w->fd) && !ret)
+		ret = -1;
+	return ret;
+}
@@ -0,0 +1,73 @@
+#ifndef _TSFILE_H_
+#define _TSFILE_H_
+/* tsfile.h -- streaming TS file reader and writer for the test tools
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* default size of the batches written to disk */
+#define TSFILE_WRITE_BATCH	(4 * 1024 * 1024)
+
+/* how far ahead of the data disk space is reserved */
+#define TSFILE_ALLOC_STEP	(64 * 1024 * 1024)
+
+/*
+ * A regular file is mmap()ed and handed out in place, so reading it costs
+ * no copies; anything else (a pipe, /dev/stdin) is read() into a buffer.
+ */
+struct tsfile_reader {
+	int fd;
+	uint8_t *map;
+	size_t size;
+	size_t pos;
+	uint8_t *buf;
+	size_t buf_size;
+};
+
+/*
+ * Data is collected into large batches before it is written, and the file is
+ * extended with fallocate() ahead of it so the filesystem can lay it out in
+ * one piece. Neither is done for anything other than a regular file, which
+ * is written straight through.
+ */
+struct tsfile_writer {
+	int fd;
+	int regular;
+	uint8_t *buf;
+	size_t buf_size;
+	size_t buf_len;
+	int64_t offset;
+	int64_t allocated;
+};
+
+/* all return -1 with errno set on error */
+extern int tsfile_reader_open(struct tsfile_reader *r, const char *filename, size_t chunk);
+/* sets *data to up to max bytes of the file; returns the count, 0 at the end */
+extern ssize_t tsfile_read(struct tsfile_reader *r, uint8_t **data, size_t max);
+extern void tsfile_reader_close(struct tsfile_reader *r);
+
+/* batch 0 selects TSFILE_WRITE_BATCH */
+extern int tsfile_writer_open(struct tsfile_writer *w, const char *filename, size_t batch);
+extern int tsfile_write(struct tsfile_writer *w, const uint8_t *data, size_t len);
+extern int tsfile_flush(struct tsfile_writer *w);
+extern int tsfile_writer_close(struct tsfile_writer *w);
+
+
+#endif /* _TSFILE_H_ */
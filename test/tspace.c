@@ -0,0 +1,254 @@
+/* tspace.c -- pace stream playback to the stream's own clock
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "tspace.h"
+
+#define CLOCK_HZ	27000000ULL
+#define CLOCK_WRAP	((1ULL << 33) * 300)
+#define MAX_STEP	CLOCK_HZ		/* bigger jumps are discontinuities */
+
+#define TS_SIZE		188
+#define TS_SYNC		0x47
+
+/* 192 byte packets: 30 bits of 27 MHz arrival time, then the TS packet */
+#define TTS_SIZE	192
+#define TTS_WRAP	(1ULL << 30)
+#define TTS_GRANULE	(CLOCK_HZ / 1000)	/* packets written together */
+
+
+static int64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void tspace_init(struct tspace *p, double speed, unsigned int lead_ms, int source)
+{
+	memset(p, 0, sizeof(*p));
+	p->speed = (speed > 0) ? speed : 1.0;
+	p->lead_ns = (int64_t) lead_ms * 1000000LL;
+	p->source = source;
+}
+
+int tspace_init_env(struct tspace *p)
+{
+	unsigned int lead_ms = TSPACE_LEAD_MS;
+	int source = -1;
+
+	if (getenv("PACE") == NULL)
+		return 0;
+	if (getenv("LEAD"))
+		lead_ms = strtoul(getenv("LEAD"), NULL, 0);
+	if (getenv("PCRPID"))
+		source = strtol(getenv("PCRPID"), NULL, 0);
+	tspace_init(p, strtod(getenv("PACE"), NULL), lead_ms, source);
+	return 1;
+}
+
+/* wait for clock, which wraps at wrap; forward steps over max_step are jumps */
+static void tspace_clock_wrap(struct tspace *p, uint64_t clock, int discontinuity,
+			      uint64_t wrap, uint64_t max_step)
+{
+	struct timespec due;
+	uint64_t step;
+	int64_t ns;
+
+	if (!p->started) {
+		p->started = 1;
+		p->start_ns = now_ns();
+		p->last = clock;
+		return;
+	}
+
+	step = (clock + wrap - p->last) % wrap;
+	if (step > wrap / 2) {
+		/* a little back is reordering; keep the later clock */
+		if (!discontinuity && (wrap - step) < max_step)
+			return;
+		step = 0;
+	} else if (discontinuity || step > max_step) {
+		step = 0;
+	}
+	p->last = clock;
+	p->elapsed += step;
+
+	ns = p->start_ns - p->lead_ns +
+	     (int64_t) ((double) p->elapsed * 1e9 / CLOCK_HZ / p->speed);
+	due.tv_sec = ns / 1000000000LL;
+	due.tv_nsec = ns % 1000000000LL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+		;
+}
+
+void tspace_clock(struct tspace *p, uint64_t clock, int discontinuity)
+{
+	tspace_clock_wrap(p, clock, discontinuity, CLOCK_WRAP, MAX_STEP);
+}
+
+/* PCR of a TS packet, if it carries one */
+static int ts_pcr(const uint8_t *pkt, int *pid, uint64_t *pcr, int *discontinuity)
+{
+	uint64_t base;
+
+	if (!(pkt[3] & 0x20) || (pkt[4] < 7) || !(pkt[5] & 0x10))
+		return 0;
+
+	base = ((uint64_t) pkt[6] << 25) | (pkt[7] << 17) | (pkt[8] << 9) |
+	       (pkt[9] << 1) | (pkt[10] >> 7);
+	*pcr = base * 300 + (((pkt[10] & 1) << 8) | pkt[11]);
+	*pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	*discontinuity = (pkt[5] & 0x80) != 0;
+	return 1;
+}
+
+size_t tspace_ts_span(struct tspace *p, const uint8_t *data, size_t len)
+{
+	size_t pos;
+	uint64_t pcr;
+	int pid, discontinuity;
+
+	for (pos = 0; pos + TS_SIZE <= len; pos += TS_SIZE) {
+		if (data[pos] != TS_SYNC)
+			break;
+		if (!ts_pcr(data + pos, &pid, &pcr, &discontinuity))
+			continue;
+		if (p->source == -1)
+			p->source = pid;
+		if (pid != p->source)
+			continue;
+		if (pos)
+			return pos;
+		tspace_clock(p, pcr, discontinuity);
+	}
+	return len;
+}
+
+static uint64_t tts_stamp(const uint8_t *pkt)
+{
+	return (((uint64_t) pkt[0] << 24) | (pkt[1] << 16) | (pkt[2] << 8) | pkt[3]) & (TTS_WRAP - 1);
+}
+
+int tspace_is_tts(const uint8_t *data, size_t len)
+{
+	size_t pos;
+
+	if (len < 4 * TTS_SIZE)
+		return 0;
+	for (pos = 0; pos < 4 * TTS_SIZE; pos += TTS_SIZE) {
+		if (data[pos + 4] != TS_SYNC)
+			return 0;
+	}
+	/* a stamp can hold 0x47 too, but not also at the 188 byte step */
+	return data[0] != TS_SYNC || data[TS_SIZE] != TS_SYNC;
+}
+
+size_t tspace_tts_span(struct tspace *p, const uint8_t *data, size_t len)
+{
+	uint64_t first, ahead;
+	size_t pos;
+
+	if (len < TTS_SIZE)
+		return len;
+
+	/* the stamps are all due, and wrap, alike */
+	first = tts_stamp(data);
+	tspace_clock_wrap(p, first, 0, TTS_WRAP, TTS_WRAP / 2);
+	for (pos = TTS_SIZE; pos + TTS_SIZE <= len; pos += TTS_SIZE) {
+		ahead = (tts_stamp(data + pos) + TTS_WRAP - first) % TTS_WRAP;
+		if (ahead >= TTS_GRANULE && ahead < TTS_WRAP / 2)
+			break;
+	}
+	return pos;
+}
+
+/* 33 bit timestamp in the format shared by PTS and MPEG-1 SCR */
+static uint64_t pes_timestamp(const uint8_t *b)
+{
+	return ((uint64_t) ((b[0] >> 1) & 7) << 30) | (b[1] << 22) |
+	       ((b[2] >> 1) << 15) | (b[3] << 7) | (b[4] >> 1);
+}
+
+/* clock of a start code at b, with len bytes of data there */
+static int pes_clock(struct tspace *p, const uint8_t *b, size_t len, uint64_t *clock)
+{
+	uint8_t id = b[3];
+
+	if (id == 0xba) {
+		if (len < 10)
+			return 0;
+		if ((b[4] & 0xc4) == 0x44 && (b[6] & 4) && (b[8] & 4) && (b[9] & 1)) {
+			/* MPEG-2 pack header */
+			uint64_t base = ((uint64_t) ((b[4] >> 3) & 7) << 30) |
+					((uint64_t) (b[4] & 3) << 28) | (b[5] << 20) |
+					((b[6] >> 3) << 15) | ((b[6] & 3) << 13) |
+					(b[7] << 5) | (b[8] >> 3);
+			*clock = base * 300 + (((b[8] & 3) << 7) | (b[9] >> 1));
+		} else if ((b[4] & 0xf1) == 0x21 && (b[6] & 1) && (b[8] & 1)) {
+			/* MPEG-1 pack header */
+			*clock = pes_timestamp(b + 4) * 300;
+		} else {
+			return 0;
+		}
+		p->have_scr = 1;
+		return 1;
+	}
+
+	/* without packs, the PTS of one of the streams will do */
+	if (p->have_scr || id < 0xbd || id > 0xef || id == 0xbe || id == 0xbf)
+		return 0;
+	if ((p->source != -1) && (id != p->source))
+		return 0;
+	if (len < 14 || (b[6] & 0xc0) != 0x80 || !(b[7] & 0x80) ||
+	    (b[9] & 0x21) != 0x21 || !(b[11] & 1) || !(b[13] & 1))
+		return 0;
+	if (p->source == -1)
+		p->source = id;
+	*clock = pes_timestamp(b + 9) * 300;
+	return 1;
+}
+
+size_t tspace_pes_span(struct tspace *p, const uint8_t *data, size_t len)
+{
+	size_t pos;
+	uint64_t clock;
+
+	for (pos = 0; pos + 4 <= len; pos++) {
+		if (data[pos + 2] > 1) {
+			pos += 2;
+			continue;
+		}
+		if (data[pos] || data[pos + 1] || data[pos + 2] != 1 || data[pos + 3] < 0xba)
+			continue;
+		if (!pes_clock(p, data + pos, len - pos, &clock))
+			continue;
+		if (pos)
+			return pos;
+		tspace_clock(p, clock, 0);
+		pos += 3;
+	}
+	return len;
+}
@@ -0,0 +1,74 @@
+#ifndef _TSPACE_H_
+#define _TSPACE_H_
+/* tspace.h -- pace stream playback to the stream's own clock
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; either version 2.1
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* default for how far the data may run ahead of its clock */
+#define TSPACE_LEAD_MS		200
+
+/*
+ * The clock references of the stream (PCRs of a TS; SCRs of a program
+ * stream, or failing those the PTSs of a PES file) say when each part of
+ * it is due. The data is cut into spans at the clock references, and each
+ * span is held back until it is due against CLOCK_MONOTONIC, scaled by
+ * speed (2.0 plays at twice the rate). Data may be up to lead_ns ahead, so
+ * that the decoder's buffers are kept filled without running over.
+ *
+ * Backwards steps of less than a second (PTS reordering) are ignored, and
+ * bigger jumps either way (splices, wrap of a damaged stream) are bridged
+ * without a pause.
+ */
+struct tspace {
+	double speed;
+	int64_t lead_ns;
+	int source;		/* PCR PID, or PES stream id; -1 => first one seen */
+	int started;
+	int have_scr;
+	int64_t start_ns;
+	uint64_t last;		/* 27 MHz */
+	uint64_t elapsed;	/* 27 MHz ticks of stream played */
+};
+
+/* speed <= 0 selects 1.0, source -1 takes the first clock in the stream */
+extern void tspace_init(struct tspace *p, double speed, unsigned int lead_ms, int source);
+/* sets up from the PACE (speed), LEAD (ms) and PCRPID environment variables;
+ * returns 0 if PACE is not set, so nothing is to be paced */
+extern int tspace_init_env(struct tspace *p);
+
+/* wait until a clock reference in 27 MHz units is due */
+extern void tspace_clock(struct tspace *p, uint64_t clock, int discontinuity);
+
+/* wait until the start of data is due, and return how much of it may be
+ * written now: up to the next clock reference, or all of it */
+extern size_t tspace_ts_span(struct tspace *p, const uint8_t *data, size_t len);
+extern size_t tspace_pes_span(struct tspace *p, const uint8_t *data, size_t len);
+
+/* whether data starts with 192 byte timestamped packets (M2TS/TTS, as
+ * recorded by test_dvr with TTS=1) rather than plain TS */
+extern int tspace_is_tts(const uint8_t *data, size_t len);
+
+/* the same for timestamped packets, which are paced to their arrival
+ * stamps instead of the PCRs: waits until the first is due, and returns
+ * how many bytes of whole packets are due within a millisecond of it */
+extern size_t tspace_tts_span(struct tspace *p, const uint8_t *data, size_t len);
+
+#endif /* _TSPACE_H_ */
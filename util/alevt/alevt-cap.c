@@ -4,10 +4,13 @@
 #include <locale.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
 #include "vt.h"
 #include "misc.h"
 #include "fdset.h"
 #include "vbi.h"
+#include "cache.h"
 #include "lang.h"
 #include "dllist.h"
 #include "export.h"
@@ -25,7 +28,37 @@ struct req
     char *pgno_str; // the pgno as given on the cmdline
     int pgno, subno; // decoded pgno
     struct export *export; // export data
+    char *fmt_str; // its format, for the export workers
     struct vt_page vtp[1]; // the capture page data
+    u32 hash; // of its contents (see page_hash)
+    char *fname; // the file it goes to, with -changed
+    int failed; // its export failed
+};
+
+
+/*  The hash journal of -changed: the hash of the page each file was
+    last written with, one "hash filename" line per file.  A page whose
+    file already holds the same contents is not exported again. */
+
+struct journal_ent
+{
+    char *fname;
+    u32 hash;
+};
+
+struct journal
+{
+    char *name;
+    struct journal_ent *ents; // open addressing on the file name
+    int nents, size;
+};
+
+
+struct job
+{
+    struct req **reqs; // the captured pages
+    int nreqs;
+    int next; // the next one to export, taken atomically
 };
 
 
@@ -48,9 +81,18 @@ static void usage(FILE *fp, int exitval)
 		"                 \t\t/dev/vbi0\n"
 		"                 \t\t/dev/video0\n"
 		"                 \t\t/dev/dvb/adapter0/demux0\n"
+	    "    -a -all\t\t\t(off;needs -timeout)\n"
+	    "    -j -jobs <n>\t\t1\n"
+	    "    -ch -changed <journal>\t(off)\n"
 	    "\n"
 	    "  ppp.ss stands for a page number and an\n"
 	    "  optional subpage number (ie 123.4).\n"
+	    "  With -all every page and subpage received\n"
+	    "  until the timeout is saved, named %%s = ppp.ss.\n"
+	    "  -jobs exports the pages with n threads.\n"
+	    "  -changed only exports the pages which changed\n"
+	    "  since the run which last wrote their files,\n"
+	    "  as the journal file remembers them.\n"
 	);
     exit(exitval);
 }
@@ -115,6 +157,9 @@ static int option(int argc, char **argv, int *ind, char **arg)
 	{ "-timeout", "-to", 1 },
 	{ "-ttpid", "-t", 1 },
 	{ "-vbi", "-v", 1 },
+	{ "-all", "-a", 0 },
+	{ "-jobs", "-j", 1 },
+	{ "-changed", "-ch", 1 },
     };
     int i;
 
@@ -158,6 +203,7 @@ static void event(struct dl_head *reqs, struct vt_event *ev)
 		    if (req->subno == ANY_SUB || req->subno == vtp->subno)
 		    {
 			*req->vtp = *vtp;
+			req->hash = page_hash(vtp);
 			dl_insert_last(reqs + 1, dl_remove(req->node));
 	    }
 	}
@@ -165,6 +211,284 @@ static void event(struct dl_head *reqs, struct vt_event *ev)
 }
 
 
+static void alarm_handler(int sig)
+{
+    timed_out = 1;
+}
+
+
+// take a copy of every broadcast page and subpage in the cache
+static void snapshot(struct cache *ca, struct dl_head *caps, char *fname,
+    char *out_fmt, struct export *fmt)
+{
+    struct cache_pg *pg;
+    struct vt_page *vtp;
+    struct req *req;
+    int pgno, i;
+
+    for (pgno = CACHE_FIRST_PGNO; pgno < 0x900; ++pgno)
+    {
+	pg = ca->pg + pgno - CACHE_FIRST_PGNO;
+	for (i = 0; i < pg->nsub; ++i)
+	{
+	    if (not(vtp = ca->op->get(ca, pgno, pg->sub[i]->subno)))
+		continue;
+	    if (not(req = malloc(sizeof(*req))))
+		out_of_mem(sizeof(*req));
+	    if (not(req->pgno_str = malloc(16)))
+		out_of_mem(16);
+	    sprintf(req->pgno_str, "%03x.%02x", vtp->pgno, vtp->subno);
+	    req->name = fname;
+	    req->pgno = vtp->pgno;
+	    req->subno = vtp->subno;
+	    req->export = fmt;
+	    req->fmt_str = out_fmt;
+	    *req->vtp = *vtp;
+	    req->hash = pg->sub[i]->hash;
+	    req->fname = 0;
+	    req->failed = 0;
+	    dl_insert_last(caps, req->node);
+	}
+    }
+}
+
+
+static u32 hash_name(char *s)
+{
+    u32 hash = 2166136261U;
+
+    while (*s)
+	hash = (hash ^ (u8)*s++) * 16777619U;
+    return hash;
+}
+
+
+static struct journal_ent * journal_find(struct journal *jn, char *fname)
+{
+    u32 i = hash_name(fname) & (jn->size - 1);
+
+    while (jn->ents[i].fname && not streq(jn->ents[i].fname, fname))
+	i = (i + 1) & (jn->size - 1);
+    return jn->ents + i;
+}
+
+
+static void journal_set(struct journal *jn, char *fname, u32 hash)
+{
+    struct journal_ent *ent;
+
+    // keep it at most half full
+    if (jn->nents * 2 >= jn->size)
+    {
+	struct journal_ent *old = jn->ents;
+	int i, size = jn->size;
+
+	jn->size = size * 2;
+	if (not(jn->ents = calloc(jn->size, sizeof(*jn->ents))))
+	    out_of_mem(jn->size * sizeof(*jn->ents));
+	for (i = 0; i < size; ++i)
+	    if (old[i].fname)
+		*journal_find(jn, old[i].fname) = old[i];
+	free(old);
+    }
+
+    ent = journal_find(jn, fname);
+    if (not ent->fname)
+    {
+	if (not(ent->fname = strdup(fname)))
+	    out_of_mem(strlen(fname) + 1);
+	jn->nents++;
+    }
+    ent->hash = hash;
+}
+
+
+static void journal_load(struct journal *jn, char *name)
+{
+    char line[1100], fname[1024];
+    u32 hash;
+    FILE *fp;
+
+    jn->name = name;
+    jn->nents = 0;
+    jn->size = 1024;
+    if (not(jn->ents = calloc(jn->size, sizeof(*jn->ents))))
+	out_of_mem(jn->size * sizeof(*jn->ents));
+    if (not(fp = fopen(name, "r")))
+    {
+	if (errno != ENOENT)
+	    ioerror(name);
+	return;
+    }
+    while (fgets(line, sizeof(line), fp))
+	if (sscanf(line, "%x %1023[^\n]", &hash, fname) == 2)
+	    journal_set(jn, fname, hash);
+    fclose(fp);
+}
+
+
+// written to a new file, renamed over the old one when it is complete
+static void journal_save(struct journal *jn)
+{
+    char *tmp;
+    FILE *fp;
+    int i;
+
+    if (not(tmp = malloc(strlen(jn->name) + 5)))
+	out_of_mem(strlen(jn->name) + 5);
+    sprintf(tmp, "%s.new", jn->name);
+    if (not(fp = fopen(tmp, "w")))
+    {
+	ioerror(tmp);
+	free(tmp);
+	return;
+    }
+    for (i = 0; i < jn->size; ++i)
+	if (jn->ents[i].fname)
+	    fprintf(fp, "%08x %s\n", jn->ents[i].hash, jn->ents[i].fname);
+    if (ferror(fp) | fclose(fp) || rename(tmp, jn->name))
+    {
+	ioerror(jn->name);
+	unlink(tmp);
+    }
+    free(tmp);
+}
+
+
+/*  Drop the captured pages whose files already hold the same contents.
+    The rest keep their file name, for the journal to be updated with. */
+
+static void journal_filter(struct journal *jn, struct dl_head *caps)
+{
+    struct req *req, *nxt;
+    struct journal_ent *ent;
+
+    for (req = PTR caps->first; nxt = PTR req->node->next; req = nxt)
+    {
+	if (not(req->fname = export_mkname(req->export, req->name, req->vtp,
+		req->pgno_str)))
+	    continue; // export_req says so
+	ent = journal_find(jn, req->fname);
+	if (ent->fname && ent->hash == req->hash && access(req->fname, F_OK) == 0)
+	{
+	    dl_remove(req->node);
+	    free(req->fname);
+	    free(req);
+	}
+    }
+}
+
+
+static void journal_update(struct journal *jn, struct dl_head *caps)
+{
+    struct req *req;
+
+    for (req = PTR caps->first; req->node->next; req = PTR req->node->next)
+	if (req->fname && not req->failed)
+	    journal_set(jn, req->fname, req->hash);
+    journal_save(jn);
+}
+
+
+static void export_req(struct export *e, struct req *req)
+{
+    char *fname = req->fname;
+
+    if (not fname)
+	fname = export_mkname(e, req->name, req->vtp, req->pgno_str);
+    if (not fname || export(e, req->vtp, fname))
+    {
+	error("error saving page %s: %s", req->pgno_str, export_errstr());
+	req->failed = 1;
+    }
+    if (fname && fname != req->fname)
+	free(fname);
+}
+
+
+/*  An export worker.  The exporters keep per-page state (the open file,
+    the current attributes), so each worker opens its own, one for each
+    format it comes across. */
+static void *export_worker(void *arg)
+{
+    struct job *job = arg;
+    struct export **exps = 0;
+    char **fmts = 0;
+    int nexps = 0, n, i;
+
+    while ((n = __sync_fetch_and_add(&job->next, 1)) < job->nreqs)
+    {
+	struct req *req = job->reqs[n];
+
+	for (i = 0; i < nexps; ++i)
+	    if (fmts[i] == req->fmt_str)
+		break;
+	if (i == nexps)
+	{
+	    if (not(exps = realloc(exps, (nexps + 1) * sizeof(*exps))))
+		out_of_mem((nexps + 1) * sizeof(*exps));
+	    if (not(fmts = realloc(fmts, (nexps + 1) * sizeof(*fmts))))
+		out_of_mem((nexps + 1) * sizeof(*fmts));
+	    fmts[i] = req->fmt_str;
+	    exps[i] = export_open(req->fmt_str);
+	    nexps++;
+	}
+	if (exps[i])
+	    export_req(exps[i], req);
+	else
+	    error("error saving page %s: %s", req->pgno_str, export_errstr());
+    }
+
+    for (i = 0; i < nexps; ++i)
+	if (exps[i])
+	    export_close(exps[i]);
+    free(exps);
+    free(fmts);
+    return 0;
+}
+
+
+static void export_all(struct dl_head *caps, int jobs)
+{
+    pthread_t *tids;
+    struct job job[1];
+    struct req *req;
+    int i;
+
+    job->nreqs = 0;
+    for (req = PTR caps->first; req->node->next; req = PTR req->node->next)
+	job->nreqs++;
+
+    if (jobs > job->nreqs)
+	jobs = job->nreqs;
+    if (jobs <= 1)
+    {
+	for (req = PTR caps->first; req->node->next; req = PTR req->node->next)
+	    export_req(req->export, req);
+	return;
+    }
+
+    if (not(job->reqs = malloc(job->nreqs * sizeof(*job->reqs))))
+	out_of_mem(job->nreqs * sizeof(*job->reqs));
+    i = 0;
+    for (req = PTR caps->first; req->node->next; req = PTR req->node->next)
+	job->reqs[i++] = req;
+    job->next = 0;
+
+    if (not(tids = malloc(jobs * sizeof(*tids))))
+	out_of_mem(jobs * sizeof(*tids));
+    for (i = 0; i < jobs; ++i)
+	if (pthread_create(tids + i, 0, export_worker, job))
+	    break;
+    if (i == 0)
+	export_worker(job); // no threads, do it here
+    while (i--)
+	pthread_join(tids[i], 0);
+    free(tids);
+    free(job->reqs);
+}
+
+
 int main(int argc, char **argv)
 {
     char *vbi_name = NULL;
@@ -178,6 +502,10 @@ int main(int argc, char **argv)
     struct req *req;
     struct dl_head reqs[2]; // simple linear lists of requests & captures
     int ttpid = -1;
+    int all = 0, jobs = 1;
+    struct cache *ca = 0;
+    char *journal_name = 0;
+    struct journal jn[1];
 
     setlocale (LC_CTYPE, "");
     setprgname(argv[0]);
@@ -239,23 +567,52 @@ int main(int argc, char **argv)
 		req->pgno_str = arg;
 		req->pgno = arg_pgno(arg, &req->subno);
 		req->export = fmt;
+		req->fmt_str = out_fmt;
+		req->fname = 0;
+		req->failed = 0;
 		dl_insert_last(reqs, req->node);
 		break;
+	    case 9: // all
+		all = 1;
+		break;
+	    case 10: // jobs
+		jobs = strtol(arg, 0, 10);
+		if (jobs < 1 || jobs > 256)
+		    fatal("bad jobs value");
+		break;
+	    case 11: // changed
+		journal_name = arg;
+		break;
 	}
 
-    if (dl_empty(reqs))
+    if (all)
+    {
+	if (not dl_empty(reqs))
+	    fatal("-all takes no page numbers");
+	if (not timeout)
+	    fatal("-all needs a -timeout");
+	if (not(fmt = export_open(out_fmt)))
+	    fatal("%s", export_errstr());
+	if (not(ca = cache_open()))
+	    fatal("cannot create the page cache");
+	ca->op->mode(ca, CACHE_MODE_LIMIT, 65536); // keep all we see
+    }
+    else if (dl_empty(reqs))
 	fatal("no pages requested");
 
     // setup device
-    if (not(vbi = vbi_open(vbi_name, 0, channel, outfile, sid, ttpid)))
+    if (not(vbi = vbi_open(vbi_name, ca, channel, outfile, sid, ttpid)))
 	fatal("cannot open %s", vbi_name);
     vbi_add_handler(vbi, event, reqs); // register event handler
 
     if (timeout)
+    {
+	signal(SIGALRM, alarm_handler);
 	alarm(timeout);
+    }
 
     // capture pages (moves requests from reqs[0] to reqs[1])
-    while (not dl_empty(reqs) && not timed_out)
+    while ((all || not dl_empty(reqs)) && not timed_out)
 	if (fdset_select(fds, 30000) == 0) // 30sec select time out
 	{
 	    error("no signal.");
@@ -264,17 +621,19 @@ int main(int argc, char **argv)
 
     alarm(0);
     vbi_del_handler(vbi, event, reqs);
+    if (all)
+	snapshot(ca, reqs + 1, fname, out_fmt, fmt);
     vbi_close(vbi);
     if (not dl_empty(reqs))
 	error("capture aborted. Some pages are missing.");
 
-    for (req = PTR reqs[1].first; req->node->next; req = PTR req->node->next)
+    if (journal_name)
     {
-	fname = export_mkname(req->export, req->name, req->vtp, req->pgno_str);
-	if (not fname || export(req->export, req->vtp, fname))
-	    error("error saving page %s: %s", req->pgno_str, export_errstr());
-	if (fname)
-	    free(fname);
+	journal_load(jn, journal_name);
+	journal_filter(jn, reqs + 1);
     }
+    export_all(reqs + 1, jobs);
+    if (journal_name)
+	journal_update(jn, reqs + 1);
     exit(dl_empty(reqs) ? 0 : 1);
 }
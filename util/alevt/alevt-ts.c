@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include "vt.h"
+#include "misc.h"
+#include "fdset.h"
+#include "vbi.h"
+#include "tsvbi.h"
+#include "lang.h"
+#include "dllist.h"
+#include "export.h"
+
+static volatile int timed_out = 0;
+static char *fname = "ttext-%s.%e";
+static struct export *fmt;
+static struct dl_head reqs[1]; // pages asked for, else the subtitle pages
+
+
+struct req
+{
+    struct dl_node node[1];
+    int pgno, subno;
+};
+
+/*  The last page saved of each page number of a service, so a page
+    sent again unchanged (as subtitles are) is only saved once. */
+
+struct saved
+{
+    struct dl_node node[1];
+    int pgno;
+    int count;
+    u8 data[H - 1][W];		// rows 1-24
+};
+
+
+struct service
+{
+    struct tsvbi_service *svc;
+    struct dl_head saved[1];
+};
+
+
+static void usage(FILE *fp, int exitval)
+{
+    fprintf(fp, "\nUsage: %s [options] [ppp.ss...]\n", prgname);
+    fprintf(fp,
+	    "\n"
+	    "  Valid options:\t\tDefault:\n"
+	    "    -cs -charset\t\tlatin-1\n"
+	    "    <latin-1/2/koi8-r/iso8859-7>\n"
+	    "    -f -format <fmt,options>\tascii\n"
+	    "    -h -help\n"
+	    "    -i -input <ts>\t\t/dev/dvb/adapter0/demux0\n"
+	    "    -n -name <filename>\t\tttext-%%s.%%e\n"
+	    "    -to -timeout <secs>\t\t(none)\n"
+	    "\n"
+	    "  Every teletext stream of the transport stream is\n"
+	    "  decoded, and each time one of the pages comes with\n"
+	    "  new contents it is saved; %%s in the file name is\n"
+	    "  sid-ppp.ss-count. Without pages, the subtitle pages\n"
+	    "  from the teletext descriptors are saved.\n"
+	    "  The input may be a demux, a DVR, a file or - for\n"
+	    "  stdin.\n"
+	);
+    exit(exitval);
+}
+
+
+static void timeout_handler(int sig)
+{
+    timed_out = 1;
+}
+
+
+static int arg_pgno(char *p, int *subno)
+{
+    char *end;
+    int pgno;
+
+    *subno = ANY_SUB;
+    if (*p)
+    {
+	pgno = strtol(p, &end, 16);
+	if ((*end == ':' || *end == '/' || *end == '.') && end[1])
+	    *subno = strtol(end + 1, &end, 16);
+	if (*end == 0)
+	    if (pgno >= 0x100 && pgno <= 0x899)
+		if (*subno == ANY_SUB || (*subno >= 0x00 && *subno <= 0x3f7f))
+		    return pgno;
+    }
+    fatal("%s: invalid page number", p);
+}
+
+
+static int option(int argc, char **argv, int *ind, char **arg)
+{
+    static struct { char *nam, *altnam; int arg; } opts[] = {
+	{ "-charset", "-cs", 1 },
+	{ "-format", "-f", 1 },
+	{ "-help", "-h", 0 },
+	{ "-input", "-i", 1 },
+	{ "-name", "-n", 1 },
+	{ "-timeout", "-to", 1 },
+    };
+    int i;
+
+    if (*ind >= argc)
+	return 0;
+
+    *arg = argv[(*ind)++];
+    for (i = 0; i < NELEM(opts); ++i)
+	if (streq(*arg, opts[i].nam) || streq(*arg, opts[i].altnam))
+	{
+	    if (opts[i].arg)
+		if (*ind < argc)
+		    *arg = argv[(*ind)++];
+		else
+		    fatal("option %s requires an argument", *arg);
+	    return i+1;
+	}
+
+    if (**arg == '-')
+    {
+	fatal("%s: invalid option", *arg);
+	usage(stderr, 2);
+    }
+
+    return -1;
+}
+
+
+static int wanted(struct tsvbi_service *svc, struct vt_page *vtp)
+{
+    struct req *req;
+    int i;
+
+    if (dl_empty(reqs))
+    {
+	for (i = 0; i < svc->nr_pages; ++i)
+	    if (svc->pages[i] == vtp->pgno)
+		return 1;
+	return 0;
+    }
+    for (req = PTR reqs->first; req->node->next; req = PTR req->node->next)
+	if (req->pgno == vtp->pgno)
+	    if (req->subno == ANY_SUB || req->subno == vtp->subno)
+		return 1;
+    return 0;
+}
+
+
+static void save_page(struct service *s, struct vt_page *vtp)
+{
+    struct saved *sv;
+    char usr[64], *name;
+    int l;
+
+    // a subtitle page without text only clears the screen
+    for (l = 1; l < H; ++l)
+	if (vtp->lines & (1 << l))
+	    break;
+    if (l == H)
+	return;
+
+    for (sv = PTR s->saved->first; sv->node->next; sv = PTR sv->node->next)
+	if (sv->pgno == vtp->pgno)
+	    break;
+    if (sv->node->next == 0)
+    {
+	if (not(sv = malloc(sizeof(*sv))))
+	    out_of_mem(sizeof(*sv));
+	sv->pgno = vtp->pgno;
+	sv->count = 0;
+	memset(sv->data, 0, sizeof(sv->data));
+	dl_insert_first(s->saved, sv->node);
+    }
+    else if (memcmp(sv->data, vtp->data[1], sizeof(sv->data)) == 0)
+	return;
+    memcpy(sv->data, vtp->data[1], sizeof(sv->data));
+
+    snprintf(usr, sizeof(usr), "%d-%x.%02x-%d", s->svc->sid, vtp->pgno,
+	vtp->subno & 0xff, ++sv->count);
+    name = export_mkname(fmt, fname, vtp, usr);
+    if (not name || export(fmt, vtp, name))
+	error("error saving page %x of %s: %s", vtp->pgno,
+	    s->svc->name, export_errstr());
+    else
+	printf("%ld %d %s %s\n", (long) time(0), s->svc->sid, name,
+	    s->svc->name);
+    if (name)
+	free(name);
+    fflush(stdout);
+}
+
+
+static void event(struct service *s, struct vt_event *ev)
+{
+    switch (ev->type)
+    {
+	case EV_PAGE: // new page
+	{
+	    struct vt_page *vtp = ev->p1;
+
+	    if (wanted(s->svc, vtp))
+		save_page(s, vtp);
+	    break;
+	}
+    }
+}
+
+
+static void service(void *data, struct tsvbi_service *svc, int what)
+{
+    struct service *s;
+    struct saved *sv;
+    int i;
+
+    switch (what)
+    {
+	case TSVBI_NEW:
+	    if (not(s = malloc(sizeof(*s))))
+		out_of_mem(sizeof(*s));
+	    s->svc = svc;
+	    dl_init(s->saved);
+	    svc->user = s;
+	    vbi_add_handler(svc->vbi, event, s);
+	    fprintf(stderr, "service %d (%s): teletext pid %d lang %s, subtitles",
+		svc->sid, svc->name, svc->ttpid, svc->lang);
+	    for (i = 0; i < svc->nr_pages; ++i)
+		fprintf(stderr, " %x", svc->pages[i]);
+	    fprintf(stderr, "\n");
+	    break;
+
+	case TSVBI_GONE:
+	    s = svc->user;
+	    vbi_del_handler(svc->vbi, event, s);
+	    while (not dl_empty(s->saved))
+	    {
+		sv = PTR s->saved->first;
+		dl_remove(sv->node);
+		free(sv);
+	    }
+	    free(s);
+	    svc->user = 0;
+	    break;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    char *ts_name = "/dev/dvb/adapter0/demux0";
+    int timeout = 0;
+    char *out_fmt = "ascii";
+    int opt, ind;
+    char *arg;
+    struct tsvbi *ts;
+    struct req *req;
+
+    setlocale (LC_CTYPE, "");
+    setprgname(argv[0]);
+
+    fdset_init(fds);
+    dl_init(reqs);
+
+    ind = 1;
+    while (opt = option(argc, argv, &ind, &arg))
+	switch (opt)
+	{
+	    case 1: // charset
+		if (streq(arg, "latin-1") || streq(arg, "1"))
+		    latin1 = LATIN1;
+		else if (streq(arg, "latin-2") || streq(arg, "2"))
+		    latin1 = LATIN2;
+		else if (streq(arg, "koi8-r") || streq(arg, "koi"))
+		    latin1 = KOI8;
+		else if (streq(arg, "iso8859-7") || streq(arg, "el"))
+		    latin1 = GREEK;
+		else
+		    fatal("bad charset (not latin-1/2/koi8-r/iso8859-7)");
+		break;
+	    case 2: // format
+		out_fmt = arg;
+		break;
+	    case 3: // help
+		usage(stdout, 0);
+		break;
+	    case 4: // input
+		ts_name = arg;
+		break;
+	    case 5: // name
+		fname = arg;
+		break;
+	    case 6: // timeout
+		timeout = strtol(arg, 0, 10);
+		if (timeout < 1 || timeout > 999999)
+		fatal("bad timeout value", timeout);
+		break;
+	    case -1: // non-option arg
+		if (not(req = malloc(sizeof(*req))))
+		out_of_mem(sizeof(*req));
+		req->pgno = arg_pgno(arg, &req->subno);
+		dl_insert_last(reqs, req->node);
+		break;
+	}
+
+    if (not(fmt = export_open(out_fmt)))
+	fatal("%s", export_errstr());
+
+    if (not(ts = tsvbi_open(ts_name, service, 0)))
+	fatal("cannot open %s", ts_name);
+
+    signal(SIGALRM, timeout_handler);
+    if (timeout)
+	alarm(timeout);
+
+    while (not ts->eof && not timed_out)
+	if (fdset_select(fds, 30000) == 0) // 30sec select time out
+	{
+	    error("no signal.");
+	    break;
+	}
+
+    alarm(0);
+    tsvbi_close(ts);
+    export_close(fmt);
+    exit(0);
+}
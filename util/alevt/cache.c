@@ -3,13 +3,123 @@
 #include "misc.h"
 #include "dllist.h"
 #include "cache.h"
+#include "ngram.h"
 #include "help.h"
 
+#define is_help(pgno) ((pgno) / 256 == 9)
 
-static inline int hash(int pgno)
+
+static inline struct cache_pg * cache_pg(struct cache *ca, int pgno)
+{
+    if (pgno < CACHE_FIRST_PGNO || pgno > CACHE_LAST_PGNO)
+	return 0;
+    return ca->pg + (pgno - CACHE_FIRST_PGNO);
+}
+
+/*  Find a subpage in the sorted vector. If it isn't there, -1 is
+    returned and *pos is where it would go. */
+
+
+static int find_sub(struct cache_pg *pg, int subno, int *pos)
+{
+    int lo = 0, hi = pg->nsub;
+
+    while (lo < hi)
+    {
+	int mid = (lo + hi) / 2;
+
+	if (pg->sub[mid]->subno < subno)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (pos)
+	*pos = lo;
+    if (lo < pg->nsub && pg->sub[lo]->subno == subno)
+	return lo;
+    return -1;
+}
+
+
+static int blank_row(u8 *p)
+{
+    int c;
+
+    for (c = 0; c < W; ++c)
+	if (p[c] != ' ')
+	    return 0;
+    return 1;
+}
+
+
+u32 page_hash(struct vt_page *vtp)
 {
-    // very simple...
-    return pgno % HASH_SIZE;
+    u32 hash = 2166136261U;
+    u8 *p;
+    int i;
+
+    for (p = vtp->data[1]; p < vtp->data[H]; ++p)
+	hash = (hash ^ *p) * 16777619U;
+    hash = (hash ^ vtp->lang) * 16777619U;
+    if (vtp->flof)
+	for (i = 0; i < 6; ++i)
+	    hash = (hash ^ (vtp->link[i].pgno << 16 ^ vtp->link[i].subno)) * 16777619U;
+    return hash;
+}
+
+
+static struct cache_page * pack(struct vt_page *vtp)
+{
+    struct cache_page *cp;
+    u32 rows = 0;
+    int l, n = 0, size;
+
+    for (l = 0; l < H; ++l)
+	if (not blank_row(vtp->data[l]))
+	    rows |= 1 << l, n++;
+
+    size = sizeof(*cp) + n * W;
+    if (not(cp = malloc(size)))
+	return 0;
+
+    cp->pgno = vtp->pgno;
+    cp->subno = vtp->subno;
+    cp->lang = vtp->lang;
+    cp->flags = vtp->flags;
+    cp->errors = vtp->errors;
+    cp->lines = vtp->lines;
+    cp->rows = rows;
+    cp->flof = vtp->flof;
+    memcpy(cp->link, vtp->link, sizeof(cp->link));
+    cp->hash = page_hash(vtp);
+    cp->size = size;
+    cp->ngrams = 0;
+    cp->grams = 0;
+    for (l = n = 0; l < H; ++l)
+	if (rows & (1 << l))
+	    memcpy(cp->data[n++], vtp->data[l], W);
+    return cp;
+}
+
+
+static struct vt_page * unpack(struct cache_page *cp, struct vt_page *vtp)
+{
+    int l, n = 0;
+
+    vtp->pgno = cp->pgno;
+    vtp->subno = cp->subno;
+    vtp->lang = cp->lang;
+    vtp->flags = cp->flags;
+    vtp->errors = cp->errors;
+    vtp->lines = cp->lines;
+    vtp->flof = cp->flof;
+    memcpy(vtp->link, cp->link, sizeof(vtp->link));
+    for (l = 0; l < H; ++l)
+	if (cp->rows & (1 << l))
+	    memcpy(vtp->data[l], cp->data[n++], W);
+	else
+	    memset(vtp->data[l], ' ', W);
+    return vtp;
 }
 
 
@@ -32,37 +142,153 @@ static void do_erc(struct vt_page *ovtp, struct vt_page *nvtp)
     nvtp->lines |= ovtp->lines;
 }
 
+/*  Forget the index, if building or keeping it runs out of memory.
+    The next foreach_match tries again. */
 
-static void cache_close(struct cache *ca)
+
+static void drop_index(struct cache *ca)
 {
+    struct cache_pg *pg;
     struct cache_page *cp;
-    int i;
+    int i, size;
 
-    for (i = 0; i < HASH_SIZE; ++i)
-	while (not dl_empty(ca->hash + i))
+    for (pg = ca->pg; pg < ca->pg + CACHE_NR_PGNO; ++pg)
+	for (i = 0; i < pg->nsub; ++i)
 	{
-	    cp = PTR ca->hash[i].first;
-	    dl_remove(cp->node);
-	    free(cp);
+	    cp = pg->sub[i];
+	    size = cp->ngrams * (sizeof(*cp->grams) + sizeof(void *));
+	    cp->size -= size;
+	    if (not is_help(cp->pgno))
+		ca->mem -= size;
+	    free(cp->grams);
+	    cp->grams = 0;
+	    cp->ngrams = 0;
 	}
+    ngram_close(ca->index);
+    ca->index = 0;
+}
+
+/*  Put a new subpage in the index. The index entries are counted in
+    its size. */
+
+
+static void index_page(struct cache *ca, struct cache_page *cp,
+    struct vt_page *vtp)
+{
+    int n;
+
+    if (ca->index == 0)
+	return;
+
+    n = ngram_page(PTR vtp->data, &cp->grams);
+    if (n < 0 || ngram_add(ca->index, cp, cp->grams, n) < 0)
+    {
+	free(cp->grams);
+	cp->grams = 0;
+	drop_index(ca);
+	return;
+    }
+    cp->ngrams = n;
+    cp->size += n * (sizeof(*cp->grams) + sizeof(void *));
+}
+
+
+static void unindex_page(struct cache *ca, struct cache_page *cp)
+{
+    if (cp->grams)
+	ngram_remove(ca->index, cp, cp->grams, cp->ngrams);
+    free(cp->grams);
+}
+
+
+static int build_index(struct cache *ca)
+{
+    struct cache_pg *pg;
+    struct cache_page *cp;
+    int i, size;
+
+    if (not(ca->index = ngram_open()))
+	return -1;
+
+    for (pg = ca->pg; pg < ca->pg + CACHE_NR_PGNO; ++pg)
+	for (i = 0; i < pg->nsub; ++i)
+	{
+	    cp = pg->sub[i];
+	    size = cp->size;
+	    index_page(ca, cp, unpack(cp, ca->page));
+	    if (ca->index == 0)
+		return -1;
+	    if (not is_help(cp->pgno))
+		ca->mem += cp->size - size;
+	}
+    return 0;
+}
+
+/*  Take a subpage out of the cache and free it. */
+
+
+static void drop(struct cache *ca, struct cache_page *cp)
+{
+    struct cache_pg *pg = cache_pg(ca, cp->pgno);
+    int i = find_sub(pg, cp->subno, 0);
+
+    memmove(pg->sub + i, pg->sub + i + 1,
+	(pg->nsub - i - 1) * sizeof(*pg->sub));
+    if (--pg->nsub == 0)
+    {
+	free(pg->sub);
+	pg->sub = 0;
+	pg->maxsub = 0;
+	pg->newest = 0;
+    }
+    else if (pg->newest == cp)
+	pg->newest = pg->sub[pg->nsub - 1];
+
+    if (not is_help(cp->pgno))
+    {
+	dl_remove(cp->node);
+	ca->mem -= cp->size;
+    }
+    ca->mag_pages[cp->pgno / 256]--;
+    ca->npages--;
+    unindex_page(ca, cp);
+    free(cp);
+}
+
+/*  Evict the least recently used subpages until the limit is kept.
+    The one just put (at the front) always stays. */
+
+
+static void evict(struct cache *ca)
+{
+    while (ca->mem > ca->limit && ca->lru->last != ca->lru->first)
+	drop(ca, PTR ca->lru->last);
+}
+
+
+static void cache_close(struct cache *ca)
+{
+    struct cache_pg *pg;
+
+    for (pg = ca->pg; pg < ca->pg + CACHE_NR_PGNO; ++pg)
+	while (pg->nsub)
+	    drop(ca, pg->sub[0]);
+    if (ca->index)
+	ngram_close(ca->index);
     free(ca);
 }
 
 
 static void cache_reset(struct cache *ca)
 {
-    struct cache_page *cp, *cpn;
-    int i;
+    struct cache_page *cp;
 
-    for (i = 0; i < HASH_SIZE; ++i)
-	for (cp = PTR ca->hash[i].first; cpn = PTR cp->node->next; cp = cpn)
-	    if (cp->page->pgno / 256 != 9) // don't remove help pages
-	    {
-		dl_remove(cp->node);
-		free(cp);
-		ca->npages--;
-	    }
-    memset(ca->hi_subno, 0, sizeof(ca->hi_subno[0]) * 0x900);
+    // help pages aren't in the LRU list, so they stay
+    while (not dl_empty(ca->lru))
+    {
+	cp = PTR ca->lru->first;
+	drop(ca, cp);
+    }
 }
 
 /*  Get a page from the cache.
@@ -71,18 +297,25 @@ static void cache_reset(struct cache *ca)
 
 static struct vt_page * cache_get(struct cache *ca, int pgno, int subno)
 {
+    struct cache_pg *pg = cache_pg(ca, pgno);
     struct cache_page *cp;
-    int h = hash(pgno);
-
-    for (cp = PTR ca->hash[h].first; cp->node->next; cp = PTR cp->node->next)
-	if (cp->page->pgno == pgno)
-	    if (subno == ANY_SUB || cp->page->subno == subno)
-	    {
-		// found, move to front (make it 'new')
-		dl_insert_first(ca->hash + h, dl_remove(cp->node));
-		return cp->page;
-	    }
-    return 0;
+    int i;
+
+    if (pg == 0 || pg->nsub == 0)
+	return 0;
+
+    if (subno == ANY_SUB)
+	cp = pg->newest;
+    else if ((i = find_sub(pg, subno, 0)) >= 0)
+	cp = pg->sub[i];
+    else
+	return 0;
+
+    // found, move to front (make it 'new')
+    pg->newest = cp;
+    if (not is_help(pgno))
+	dl_insert_first(ca->lru, dl_remove(cp->node));
+    return unpack(cp, ca->page);
 }
 
 /*  Put a page in the cache.
@@ -91,86 +324,191 @@ static struct vt_page * cache_get(struct cache *ca, int pgno, int subno)
 
 static struct vt_page * cache_put(struct cache *ca, struct vt_page *vtp)
 {
-    struct cache_page *cp;
-    int h = hash(vtp->pgno);
-    
-    for (cp = PTR ca->hash[h].first; cp->node->next; cp = PTR cp->node->next)
-	if (cp->page->pgno == vtp->pgno && cp->page->subno == vtp->subno)
-	    break;
+    struct cache_pg *pg = cache_pg(ca, vtp->pgno);
+    struct cache_page *cp, *ocp = 0;
+    int i, pos;
+
+    if (pg == 0)
+	return 0;
 
-    if (cp->node->next)
+    if ((i = find_sub(pg, vtp->subno, &pos)) >= 0)
     {
-	// move to front.
-	dl_insert_first(ca->hash + h, dl_remove(cp->node));
+	ocp = pg->sub[i];
 	if (ca->erc)
-	    do_erc(cp->page, vtp);
+	    do_erc(unpack(ocp, ca->page), vtp);
     }
-    else
+    else if (pg->nsub == pg->maxsub)
     {
-	cp = malloc(sizeof(*cp));
-	if (cp == 0)
+	int max = pg->maxsub ? pg->maxsub * 2 : 4;
+	struct cache_page **sub = realloc(pg->sub, max * sizeof(*sub));
+
+	if (sub == 0)
 	    return 0;
-	if (vtp->subno >= ca->hi_subno[vtp->pgno])
-	    ca->hi_subno[vtp->pgno] = vtp->subno + 1;
-	ca->npages++;
-	dl_insert_first(ca->hash + h, cp->node);
+	pg->sub = sub;
+	pg->maxsub = max;
     }
 
-    *cp->page = *vtp;
-    return cp->page;
-}
-
-/* Same as cache_get but doesn't make the found entry new */
+    if (not(cp = pack(vtp)))
+	return 0;
+    index_page(ca, cp, vtp);
 
+    if (ocp)
+    {
+	pg->sub[i] = cp;
+	if (not is_help(ocp->pgno))
+	{
+	    dl_remove(ocp->node);
+	    ca->mem -= ocp->size;
+	}
+	unindex_page(ca, ocp);
+	free(ocp);
+    }
+    else
+    {
+	memmove(pg->sub + pos + 1, pg->sub + pos,
+	    (pg->nsub - pos) * sizeof(*pg->sub));
+	pg->sub[pos] = cp;
+	pg->nsub++;
+	ca->mag_pages[cp->pgno / 256]++;
+	ca->npages++;
+    }
+    pg->newest = cp;
 
-static struct vt_page * cache_lookup(struct cache *ca, int pgno, int subno)
-{
-    struct cache_page *cp;
-    int h = hash(pgno);
+    if (not is_help(cp->pgno))
+    {
+	dl_insert_first(ca->lru, cp->node);
+	ca->mem += cp->size;
+	evict(ca);
+    }
 
-    for (cp = PTR ca->hash[h].first; cp->node->next; cp = PTR cp->node->next)
-	if (cp->page->pgno == pgno)
-	    if (subno == ANY_SUB || cp->page->subno == subno)
-		return cp->page;
-    return 0;
+    *ca->page = *vtp;
+    return ca->page;
 }
 
 
 static struct vt_page * cache_foreach_pg(struct cache *ca, int pgno, int subno,
     int dir, int (*func)(), void *data)
 {
-    struct vt_page *vtp, *s_vtp = 0;
+    struct cache_pg *pg;
+    struct cache_page *cp, *s_cp = 0;
+    int i;
 
     if (ca->npages == 0)
 	return 0;
+    if (not(pg = cache_pg(ca, pgno)))
+	return 0;
 
-    if (vtp = cache_lookup(ca, pgno, subno))
-	subno = vtp->subno;
+    // i is the position to step from
+    if (subno == ANY_SUB && pg->newest)
+	i = find_sub(pg, pg->newest->subno, 0);
     else if (subno == ANY_SUB)
-	subno = dir < 0 ? 0 : 0xffff;
+	i = dir < 0 ? 0 : pg->nsub - 1;
+    else if (find_sub(pg, subno, &i) < 0 && dir > 0)
+	i--;
 
     for (;;)
     {
-	subno += dir;
-	while (subno < 0 || subno >= ca->hi_subno[pgno])
+	i += dir;
+	while (i < 0 || i >= pg->nsub)
 	{
 	    pgno += dir;
-	    if (pgno < 0x100)
-		pgno = 0x9ff;
-	    if (pgno > 0x9ff)
-		pgno = 0x100;
-	    subno = dir < 0 ? ca->hi_subno[pgno] - 1 : 0;
+	    if (pgno < CACHE_FIRST_PGNO)
+		pgno = CACHE_LAST_PGNO;
+	    if (pgno > CACHE_LAST_PGNO)
+		pgno = CACHE_FIRST_PGNO;
+	    // skip the rest of an empty magazine
+	    if (ca->mag_pages[pgno / 256] == 0)
+		pgno = dir < 0 ? pgno & ~0xff : pgno | 0xff;
+	    pg = cache_pg(ca, pgno);
+	    i = dir < 0 ? pg->nsub - 1 : 0;
 	}
-	if (vtp = cache_lookup(ca, pgno, subno))
+	cp = pg->sub[i];
+	if (s_cp == cp)
+	    return 0;
+	if (s_cp == 0)
+	    s_cp = cp;
+	if (func(data, unpack(cp, ca->page)))
+	    return ca->page;
+    }
+}
+
+
+static int cmp_page(const void *a, const void *b)
+{
+    struct cache_page *x = *(struct cache_page **)a;
+    struct cache_page *y = *(struct cache_page **)b;
+
+    if (x->pgno != y->pgno)
+	return x->pgno - y->pgno;
+    return x->subno - y->subno;
+}
+
+/*  Is page cp after the position pgno/subno? */
+
+
+static inline int after(struct cache_page *cp, int pgno, int subno)
+{
+    return cp->pgno > pgno || (cp->pgno == pgno && cp->subno > subno);
+}
+
+/*  Like foreach_pg, but only the candidates of the index are tried,
+    in the same order: from the one after the position in direction
+    dir round to the position itself. */
+
+
+static struct vt_page * cache_foreach_match(struct cache *ca, int pgno,
+    int subno, int dir, u32 *grams, int ngrams, int (*func)(), void *data)
+{
+    struct cache_pg *pg;
+    struct cache_page **cand;
+    int i, j, n;
+
+    if (ngrams == 0 || (ca->index == 0 && build_index(ca) < 0))
+	return cache_foreach_pg(ca, pgno, subno, dir, func, data);
+
+    if (ca->npages == 0)
+	return 0;
+    if (not(pg = cache_pg(ca, pgno)))
+	return 0;
+
+    if ((n = ngram_query(ca->index, grams, ngrams, PTR &cand)) < 0)
+	return cache_foreach_pg(ca, pgno, subno, dir, func, data);
+    if (n == 0)
+    {
+	free(cand);
+	return 0;
+    }
+    qsort(cand, n, sizeof(*cand), cmp_page);
+
+    // the same position as foreach_pg steps from
+    if (subno == ANY_SUB && pg->newest)
+	subno = pg->newest->subno;
+    else if (subno == ANY_SUB)
+	subno = dir < 0 ? -1 : 0x10000;
+
+    if (dir > 0)
+    {
+	for (j = 0; j < n && not after(cand[j], pgno, subno); ++j)
+	    ;
+	if (j == n)
+	    j = 0;
+    }
+    else
+    {
+	for (j = n - 1; j >= 0 && after(cand[j], pgno, subno - 1); --j)
+	    ;
+	if (j < 0)
+	    j = n - 1;
+    }
+
+    for (i = 0; i < n; ++i, j = (j + dir + n) % n)
+	if (func(data, unpack(cand[j], ca->page)))
 	{
-	    if (s_vtp == vtp)
-		return 0;
-	    if (s_vtp == 0)
-		s_vtp = vtp;
-	    if (func(data, vtp))
-		return vtp;
+	    free(cand);
+	    return ca->page;
 	}
-    }
+    free(cand);
+    return 0;
 }
 
 
@@ -184,6 +522,11 @@ static int cache_mode(struct cache *ca, int mode, int arg)
 	    res = ca->erc;
 	    ca->erc = arg ? 1 : 0;
 	    break;
+	case CACHE_MODE_LIMIT:
+	    res = ca->limit / 1024;
+	    ca->limit = arg * 1024;
+	    evict(ca);
+	    break;
     }
     return res;
 }
@@ -197,6 +540,7 @@ static struct cache_ops cops =
     cache_reset,
     cache_foreach_pg,
     cache_mode,
+    cache_foreach_match,
 };
 
 
@@ -204,17 +548,18 @@ struct cache * cache_open(void)
 {
     struct cache *ca;
     struct vt_page *vtp;
-    int i;
 
     if (not(ca = malloc(sizeof(*ca))))
 	goto fail1;
 
-    for (i = 0; i < HASH_SIZE; ++i)
-	dl_init(ca->hash + i);
-
-    memset(ca->hi_subno, 0, sizeof(ca->hi_subno));
+    memset(ca->pg, 0, sizeof(ca->pg));
+    memset(ca->mag_pages, 0, sizeof(ca->mag_pages));
+    dl_init(ca->lru);
     ca->erc = 1;
     ca->npages = 0;
+    ca->mem = 0;
+    ca->limit = CACHE_DEFAULT_LIMIT * 1024;
+    ca->index = 0;
     ca->op = &cops;
 
     for (vtp = help_pages; vtp < help_pages + nr_help_pages; vtp++)
@@ -222,8 +567,6 @@ struct cache * cache_open(void)
 
     return ca;
 
-fail2:
-    free(ca);
 fail1:
     return 0;
 }
@@ -5,25 +5,65 @@
 #include "misc.h"
 #include "dllist.h"
 
-#define HASH_SIZE 113
+#define CACHE_FIRST_PGNO 0x100
+#define CACHE_LAST_PGNO 0x9ff	// 0x100-0x8ff broadcast, 0x900-0x9ff help
+#define CACHE_NR_PGNO (CACHE_LAST_PGNO - CACHE_FIRST_PGNO + 1)
+#define CACHE_DEFAULT_LIMIT 4096 // KB of broadcast pages kept
+
+
+/*  One stored subpage. Only the rows which are not blank are kept,
+    in row order, a bit in rows for each. */
+
+struct cache_page
+{
+    struct dl_node node[1];	// in the LRU list (help pages aren't)
+    int pgno, subno;
+    int lang;
+    int flags;
+    int errors;
+    u32 lines;
+    u32 rows;
+    int flof;
+    struct {
+    int pgno;
+    int subno;
+    } link[6];
+    u32 hash;			// of the contents, see page_hash
+    int size;			// bytes allocated (with the index entries)
+    int ngrams;
+    u32 *grams;			// in the index, if there is one
+    u8 data[0][W];
+};
+
+
+struct cache_pg
+{
+    int nsub, maxsub;
+    struct cache_page **sub;	// sorted by subno
+    struct cache_page *newest;	// last one put or got, for ANY_SUB
+};
 
 
 struct cache
 {
-    struct dl_head hash[HASH_SIZE];
+    struct cache_pg pg[CACHE_NR_PGNO]; // indexed by pgno - CACHE_FIRST_PGNO
+    int mag_pages[10];		// subpages in each magazine (9: help)
+    struct dl_head lru[1];	// broadcast subpages, most recently used first
     int erc; // error reduction circuit on
     int npages;
-    u16 hi_subno[0x9ff + 1]; // 0:pg not in cache, 1-3f80:highest subno + 1
+    int mem;			// bytes used by the subpages in lru
+    int limit;			// and their limit
+    struct vt_page page[1];	// pages are returned in here
+    struct ngram_index *index;	// built by the first foreach_match
     struct cache_ops *op;
 };
 
 
-struct cache_page
-{
-    struct dl_node node[1];
-    struct vt_page page[1];
-};
+/*  A page returned by get, put or foreach_pg is only valid until the
+    next call of the cache: take a copy to keep it.
 
+    foreach_match is foreach_pg, but func is only given the pages having
+    all the trigrams (see ngram.h). The index is kept from then on. */
 
 struct cache_ops
 {
@@ -34,8 +74,16 @@ struct cache_ops
     struct vt_page *(*foreach_pg)(struct cache *ca, int pgno, int subno, int dir,
     int (*func)(), void *data);
     int (*mode)(struct cache *ca, int mode, int arg);
+    struct vt_page *(*foreach_match)(struct cache *ca, int pgno, int subno,
+    int dir, u32 *grams, int ngrams, int (*func)(), void *data);
 };
 
 struct cache *cache_open(void);
+
+/*  A hash of what a page shows: rows 1-24, the language and the FLOF
+    links. The header row is left out, its clock changes every second. */
+
+u32 page_hash(struct vt_page *vtp);
 #define CACHE_MODE_ERC 1
+#define CACHE_MODE_LIMIT 2	// arg: KB, the least recently used go first
 #endif
@@ -10,32 +10,53 @@
 #define WH (H*CH) /* pixel hegiht of window */
 
 
+/* The glyphs unpacked to one byte per pixel, plain and separated graphics,
+   for both fonts.  Built once by the first open, so the exporters of
+   several threads may share it. */
+static u8 glyphs[2][2][256][CH][CW];
+static int glyphs_built;
+
+
+static void build_glyphs(void)
+{
+  int f, c, x, y;
+
+  if (glyphs_built)
+    return;
+  for (f = 0; f < 2; f++)
+    {
+      unsigned char *src = (f == 0 ? font1_bits : font2_bits);
+
+      for (c = 0; c < 256; c++)
+	for (y = 0; y < CH; y++)
+	  for (x = 0; x < CW; x++)
+	    {
+	      int bitnr, bit, maskbitnr, maskbit;
+	      bitnr=(c/32*CH + y)*CW*32+ c%32*CW +x;
+	      bit=(*(src+bitnr/8))&(1<<bitnr%8);
+	      maskbitnr=(0xa0/32*CH + y)*CW*32+ 0xa0%32*CW +x;
+	      maskbit=(*(src+maskbitnr/8))&(1<<maskbitnr%8);
+	      glyphs[f][0][c][y][x] = bit != 0;
+	      glyphs[f][1][c][y][x] = bit && !maskbit;
+	    }
+    }
+  glyphs_built = 1;
+}
+
+
 static inline void draw_char(unsigned char * colour_matrix, int fg, int bg,
     int c, int dbl, int _x, int _y, int sep)
 {
   int x,y;
-  unsigned char* src= (latin1==LATIN1 ? font1_bits : font2_bits);
-  int dest_x=_x*CW;
-  int dest_y=_y*CH;
-      
-  for(y=0;y<(CH<<dbl); y++)
+  u8 (*glyph)[CW] = glyphs[latin1==LATIN1 ? 0 : 1][sep][c & 0xff];
+  unsigned char *dest = colour_matrix + WW*_y*CH + _x*CW;
+
+  for(y=0;y<(CH<<dbl); y++, dest += WW)
     {
+      u8 *row = glyph[y>>dbl];
+
       for(x=0;x<CW; x++)
-	{
-	  int bitnr, bit, maskbitnr, maskbit;
-	  bitnr=(c/32*CH + (y>>dbl))*CW*32+ c%32*CW +x;
-	  bit=(*(src+bitnr/8))&(1<<bitnr%8);
-	  if (sep)
-	    {
-	      maskbitnr=(0xa0/32*CH + (y>>dbl))*CW*32+ 0xa0%32*CW +x;
-	      maskbit=(*(src+maskbitnr/8))&(1<<maskbitnr%8);
-	      *(colour_matrix+WW*(dest_y+y)+dest_x+x)=
-		(char)((bit && (!maskbit)) ? fg : bg);
-	    }
-	  else 
-	    *(colour_matrix+WW*(dest_y+y)+dest_x+x)=
-	      (char)(bit ? fg : bg);
-	}
+	dest[x] = row[x] ? fg : bg;
     }
   return;
 }
@@ -75,6 +96,7 @@ static void prepare_colour_matrix(/*struct export *e,*/
 }
 
 
+static int ppm_open(struct export *e);
 static int ppm_output(struct export *e, char *name, struct fmt_page *pg);
 
 struct export_module export_ppm = // exported module definition
@@ -83,13 +105,20 @@ struct export_module export_ppm = // exported module definition
     "ppm",			// extension
     0,				// options
     0,				// size
-    0,				// open
+    ppm_open,			// open
     0,				// close
     0,				// option
     ppm_output			// output
 };
 
 
+static int ppm_open(struct export *e)
+{
+    build_glyphs();
+    return 0;
+}
+
+
 static int ppm_output(struct export *e, char *name, struct fmt_page *pg)
 {
   FILE *fp;
@@ -104,7 +133,7 @@ static int ppm_output(struct export *e, char *name, struct fmt_page *pg)
 		      {1,1,1}};
   unsigned char *colour_matrix;
 
-  if (!(colour_matrix=malloc(WH*WW))) 
+  if (!(colour_matrix=malloc(3*WH*WW))) 
     {
       export_error("cannot allocate memory");
       return 0;
@@ -119,15 +148,15 @@ static int ppm_output(struct export *e, char *name, struct fmt_page *pg)
     }
   fprintf(fp,"P6 %d %d 1\n", WW, WH);
 
-  for(n=0;n<WH*WW;n++)
+  // expand in place, from the end: pixel n becomes bytes 3n..3n+2
+  for(n=WH*WW-1;n>=0;n--)
+    memcpy(colour_matrix+3*n, rgb1[colour_matrix[n]], 3);
+  if (!fwrite(colour_matrix, 3*WH*WW, 1, fp))
     {
-      if (!fwrite(rgb1[(int) *(colour_matrix+n)], 3, 1, fp))
-	{
-	  export_error("error while writting to file");
-	  free(colour_matrix);
-	  fclose(fp);
-	  return -1;
-	}
+      export_error("error while writting to file");
+      free(colour_matrix);
+      fclose(fp);
+      return -1;
     }
   free(colour_matrix);
   fclose(fp);
@@ -170,6 +199,7 @@ struct export_module export_png =	// exported module definition
 static int png_open(struct export *e)
 {
     D->compression = Z_DEFAULT_COMPRESSION;
+    build_glyphs();
     return 0;
 }
 
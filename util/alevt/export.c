@@ -31,7 +31,7 @@ static char *glbl_opts[] =
     0
 };
 
-static char errbuf[64];
+static __thread char errbuf[64]; // per thread: alevt-cap exports in parallel
 
 
 void export_error(char *str, ...)
@@ -0,0 +1,8 @@
+#define font1_width 288
+#define font1_height 128
+#define font2_width 288
+#define font2_height 128
+#define font3_width 288
+#define font3_height 128
+#define font4_width 288
+#define font4_height 128
@@ -1,4 +1,6 @@
+#include <string.h>
 #include "vt.h"
+#include "misc.h"
 #include "hamm.h"
 
 // table to decode hamm8/4 encoded bytes.
@@ -216,8 +218,64 @@ int hamm24(u8 *p, int *err)
     return x ^ hamm24cor[e];
 }
 
+/*  Decode n hamm8/4 bytes into n nibbles. The errors are added to *err
+    like hamm8 does, but the counts stop at 15 instead of overflowing
+    into each other, so a whole row may be done at once. Returns a mask
+    of the bytes (the first 32) with an uncorrectable error. */
 
-int chk_parity(u8 *p, int n)
+
+u32 hamm8_row(u8 *p, u8 *d, int n, int *err)
+{
+    int i, a, single = 0, dbl = 0;
+    u32 mask = 0;
+
+    for (i = 0; i < n; ++i)
+    {
+	a = hammtab[p[i]];
+	d[i] = a & 15;
+	if (a & 0x1000)
+	{
+	    dbl++;
+	    if (i < 32)
+		mask |= 1u << i;
+	}
+	else
+	    single += a >> 8;
+    }
+    *err += min(single, 15) << 8 | min(dbl, 15) << 12;
+    return mask;
+}
+
+/*  Decode n hamm24/18 triplets into t[]. The errors are added to *err
+    as by hamm24. Returns a mask of the triplets (the first 32) with an
+    uncorrectable error. */
+
+
+u32 hamm24_row(u8 *p, int *t, int n, int *err)
+{
+    int i, e, single = 0, dbl = 0;
+    u32 mask = 0;
+
+    for (i = 0; i < n; ++i, p += 3)
+    {
+	e = hamm24par[0][p[0]] ^ hamm24par[1][p[1]] ^ hamm24par[2][p[2]];
+	t[i] = (hamm24val[p[0]] + p[1] % 128 * 16 + p[2] % 128 * 2048)
+	    ^ hamm24cor[e];
+	if (hamm24err[e] & 0x1000)
+	{
+	    dbl++;
+	    if (i < 32)
+		mask |= 1u << i;
+	}
+	else if (hamm24err[e])
+	    single++;
+    }
+    *err += min(single, 15) << 8 | min(dbl, 15) << 12;
+    return mask;
+}
+
+
+static int chk_parity_bytes(u8 *p, int n)
 {
     int err;
     for (err = 0; n--; p++)
@@ -227,3 +285,32 @@ int chk_parity(u8 *p, int n)
 	    *p = BAD_CHAR, err++;
     return err;
 }
+
+/*  Check the odd parity of n bytes and strip it; bytes with bad parity
+    become BAD_CHAR. Eight bytes are checked at once: the bits of each
+    byte are folded onto its bit 0 within a 64 bit word, and only a word
+    with an error goes through the table byte by byte. */
+
+
+int chk_parity(u8 *p, int n)
+{
+    const unsigned long long lsb = 0x0101010101010101ULL;
+    unsigned long long x, y;
+    int err = 0;
+
+    for (; n >= 8; p += 8, n -= 8)
+    {
+	memcpy(&x, p, 8);
+	y = x ^ (x >> 4);
+	y ^= y >> 2;
+	y ^= y >> 1;
+	if ((y & lsb) == lsb)
+	{
+	    x &= lsb * 0x7f;
+	    memcpy(p, &x, 8);
+	}
+	else
+	    err += chk_parity_bytes(p, 8);
+    }
+    return err + chk_parity_bytes(p, n);
+}
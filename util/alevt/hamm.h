@@ -4,4 +4,6 @@ int hamm8(u8 *p, int *err);
 int hamm16(u8 *p, int *err);
 int hamm24(u8 *p, int *err);
 int chk_parity(u8 *p, int n);
+u32 hamm8_row(u8 *p, u8 *d, int n, int *err);
+u32 hamm24_row(u8 *p, int *t, int n, int *err);
 #endif
@@ -17,6 +17,7 @@ static char *vbi_name = NULL;
 static struct xio *xio;
 static struct vbi *vbi;
 static int erc = 1;
+static int cache_kb = CACHE_DEFAULT_LIMIT;
 char *outfile = "";
 static char *channel;
 static int ttpid = -1;
@@ -30,6 +31,7 @@ static void usage(FILE *fp, int exitval)
 	    "\n"
 	    "  Valid options:\t\tDefault:\n"
 	    "    -c <channel name>\t\t(none;dvb only)\n"
+	    "    -ca -cache <KB>\t\t%d\n"
 	    "    -ch -child <ppp.ss>\t\t(none)\n"
 	    "    -cs -charset\t\tlatin-1\n"
 	    "    <latin-1/2/koi8-r/iso8859-7>\n"
@@ -48,7 +50,8 @@ static void usage(FILE *fp, int exitval)
 	    "\n"
 	    "  The -child option requires a parent\n"
 	    "  window. So it must be preceded by\n"
-	    "  a parent or another child window.\n"
+	    "  a parent or another child window.\n",
+	    CACHE_DEFAULT_LIMIT
 	);
     exit(exitval);
 }
@@ -92,7 +95,10 @@ static struct vtwin * start(int argc, char **argv, struct vtwin *parent,
     	vbi = open_null_vbi(cache_open());
     }
     if (vbi->cache)
+    {
 	vbi->cache->op->mode(vbi->cache, CACHE_MODE_ERC, erc);
+	vbi->cache->op->mode(vbi->cache, CACHE_MODE_LIMIT, cache_kb);
+    }
 
     if (xio == 0)
 	xio = xio_open_dpy(dpy_name, argc, argv);
@@ -127,6 +133,7 @@ static int option(int argc, char **argv, int *ind, char **arg)
 	{ "-sid", "-s", 1 },
 	{ "-ttpid", "-t", 1 },
 	{ "-vbi", "-v", 1 },
+	{ "-cache", "-ca", 1 },
     };
     int i;
     if (*ind >= argc)
@@ -212,6 +219,11 @@ int main(int argc, char **argv)
 		vbi = 0;
 		parent = 0;
 		break;
+	    case 10: // cache
+		cache_kb = strtoul(arg, NULL, 0);
+		if (cache_kb <= 0)
+		    fatal("%s: invalid cache size", arg);
+		break;
 	}
 
     if (parent == 0)
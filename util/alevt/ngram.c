@@ -0,0 +1,360 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vt.h"
+#include "misc.h"
+#include "ngram.h"
+
+/*  The searchable text of a page: rows 1-24, each as 40 chars and a
+    newline, without the rows hidden by double height ones. line[] gets
+    the row number of each text line. */
+
+
+void ngram_page_text(u8 *p, u8 *buf, int *line)
+{
+    int x, y, c, ch, gfx, hid = 0;
+
+    for (y = 1, p += 40; y < 25; ++y)
+    {
+	if (not hid)
+	{
+	    gfx = 0;
+	    for (x = 0; x < 40; ++x)
+	    {
+		c = ' ';
+		switch (ch = *p++)
+		{
+		    case 0x00 ... 0x07:
+			gfx = 0;
+			break;
+		    case 0x10 ... 0x17:
+			gfx = 1;
+			break;
+		    case 0x0c:
+			hid = 1;
+			break;
+		    case 0x7f:
+			c = '*';
+			break;
+		    case 0x20 ... 0x7e:
+			if (gfx && ch != ' ' && (ch & 0xa0) == 0x20)
+			    ch = '#';
+		    case 0xa0 ... 0xff:
+			c= ch;
+		}
+		*buf++ = c;
+	    }
+	    *buf++ = '\n';
+	    *line++ = y;
+	}
+	else
+	{
+	    p += 40;
+	    hid = 0;
+	}
+    }
+    *line = y;
+    *buf = 0;
+}
+
+
+static inline int gram_class(int c)
+{
+    if (c >= 'a' && c <= 'z')
+	return c - 'a' + 1;
+    if (c >= 'A' && c <= 'Z')
+	return c - 'A' + 1;
+    if (c >= '0' && c <= '9')
+	return c - '0' + 27;
+    if (c == ' ')
+	return 0;
+    if (c < 0x80)
+	return 37 + c % 26;
+    return 63;
+}
+
+// three blanks (0) are everywhere and not indexed
+
+static inline u32 gram(u8 *p)
+{
+    return gram_class(p[0]) << 12 | gram_class(p[1]) << 6 | gram_class(p[2]);
+}
+
+
+static int cmp_gram(const void *a, const void *b)
+{
+    u32 x = *(u32 *)a, y = *(u32 *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+
+static int uniq(u32 *g, int n)
+{
+    int i, j = 0;
+
+    qsort(g, n, sizeof(*g), cmp_gram);
+    for (i = 0; i < n; ++i)
+	if (g[i] && (j == 0 || g[i] != g[j-1]))
+	    g[j++] = g[i];
+    return j;
+}
+
+/*  The distinct trigrams of a page's text, in a malloced vector.
+    Returns their number, or -1 if out of memory. */
+
+
+int ngram_page(u8 *data, u32 **grams)
+{
+    u8 buf[H * (W+1) + 1], *p;
+    int line[H];
+    u32 g[H * W];
+    int i, n = 0;
+
+    ngram_page_text(data, buf, line);
+    for (p = buf; *p; p += W + 1)
+	for (i = 0; i + 3 <= W; ++i)
+	    g[n++] = gram(p + i);
+    n = uniq(g, n);
+
+    *grams = 0;
+    if (n == 0)
+	return 0;
+    if (not(*grams = malloc(n * sizeof(*g))))
+	return -1;
+    memcpy(*grams, g, n * sizeof(*g));
+    return n;
+}
+
+
+static int pattern_run(u8 *run, int len, u32 *grams, int n)
+{
+    int i;
+
+    for (i = 0; i + 3 <= len && n < NGRAM_MAX_PATTERN; ++i)
+	grams[n++] = gram(run + i);
+    return n;
+}
+
+/*  The trigrams every match of a basic regular expression has: those
+    of its runs of plain characters outside of groups, less the ones
+    made optional by a repeat. Returns 0 if nothing is known (an
+    alternation, or no runs of three). */
+
+
+int ngram_pattern(u8 *p, u32 *grams)
+{
+    u8 run[256];
+    int len = 0, depth = 0, n = 0;
+
+    for (; *p; ++p)
+    {
+	switch (*p)
+	{
+	    case '*':
+		if (len)
+		    len--;
+		break;
+	    case '.': case '^': case '$':
+		break;
+	    case '[':
+		if (*++p == '^')
+		    p++;
+		if (*p == ']')
+		    p++;
+		for (; *p && *p != ']'; ++p)
+		    if (*p == '[' && (p[1] == ':' || p[1] == '.' || p[1] == '='))
+		    {
+			u8 *e = (u8 *)strchr((char *)p + 2, p[1]);
+			while (e && e[1] != ']')
+			    e = (u8 *)strchr((char *)e + 1, p[1]);
+			if (not e)
+			    return 0;
+			p = e + 1;
+		    }
+		if (*p == 0)
+		    return 0;
+		break;
+	    case '\\':
+		switch (*++p)
+		{
+		    case '|':
+			return 0;
+		    case '(':
+			depth++;
+			break;
+		    case ')':
+			depth--;
+			break;
+		    case '{': case '?': case '+':
+			if (len)
+			    len--;
+			if (*p == '{' && (p = (u8 *)strstr((char *)p, "\\}")) == 0)
+			    return 0;
+			if (*p == '\\')
+			    p++;
+			break;
+		    case '.': case '[': case ']': case '*':
+		    case '^': case '$': case '\\':
+			if (depth == 0 && len < NELEM(run))
+			{
+			    run[len++] = *p;
+			    continue;
+			}
+			break;
+		    case 0:
+			return 0;
+		}
+		break;
+	    default:
+		if (depth == 0 && len < NELEM(run))
+		{
+		    run[len++] = *p;
+		    continue;
+		}
+		break;
+	}
+	n = pattern_run(run, len, grams, n);
+	len = 0;
+    }
+    n = pattern_run(run, len, grams, n);
+    return uniq(grams, n);
+}
+
+
+struct ngram_index * ngram_open(void)
+{
+    struct ngram_index *ni;
+
+    if (not(ni = calloc(1, sizeof(*ni))))
+	return 0;
+    return ni;
+}
+
+
+void ngram_close(struct ngram_index *ni)
+{
+    int i;
+
+    for (i = 0; i < NELEM(ni->list); ++i)
+	if (ni->list[i])
+	{
+	    free(ni->list[i]->item);
+	    free(ni->list[i]);
+	}
+    free(ni);
+}
+
+/*  Where item is in a list, or -1 if it isn't and *pos where it
+    would go. */
+
+
+static int find_item(struct ngram_list *l, void *item, int *pos)
+{
+    int lo = 0, hi = l->n;
+
+    while (lo < hi)
+    {
+	int mid = (lo + hi) / 2;
+
+	if ((char *)l->item[mid] < (char *)item)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    if (pos)
+	*pos = lo;
+    if (lo < l->n && l->item[lo] == item)
+	return lo;
+    return -1;
+}
+
+/*  Add an item under each of its (distinct) trigrams. If out of
+    memory, -1 is returned and the item is only partly in. */
+
+
+int ngram_add(struct ngram_index *ni, void *item, u32 *grams, int n)
+{
+    struct ngram_list *l;
+    int i, pos;
+
+    for (i = 0; i < n; ++i)
+    {
+	if (not(l = ni->list[grams[i]]))
+	{
+	    if (not(l = calloc(1, sizeof(*l))))
+		return -1;
+	    ni->list[grams[i]] = l;
+	}
+	if (find_item(l, item, &pos) >= 0)
+	    continue;
+	if (l->n == l->max)
+	{
+	    int max = l->max ? l->max * 2 : 4;
+	    void **it = realloc(l->item, max * sizeof(*it));
+
+	    if (it == 0)
+		return -1;
+	    l->item = it;
+	    l->max = max;
+	}
+	memmove(l->item + pos + 1, l->item + pos, (l->n - pos) * sizeof(*l->item));
+	l->item[pos] = item;
+	l->n++;
+    }
+    return 0;
+}
+
+
+void ngram_remove(struct ngram_index *ni, void *item, u32 *grams, int n)
+{
+    struct ngram_list *l;
+    int i, j;
+
+    for (i = 0; i < n; ++i)
+    {
+	if (not(l = ni->list[grams[i]]))
+	    continue;
+	if ((j = find_item(l, item, 0)) < 0)
+	    continue;
+	memmove(l->item + j, l->item + j + 1, (l->n - j - 1) * sizeof(*l->item));
+	if (--l->n == 0)
+	{
+	    free(l->item);
+	    free(l);
+	    ni->list[grams[i]] = 0;
+	}
+    }
+}
+
+/*  The items having all the trigrams, in a malloced vector (sorted by
+    address). Returns their number, or -1 if out of memory. */
+
+
+int ngram_query(struct ngram_index *ni, u32 *grams, int n, void ***items)
+{
+    struct ngram_list *s = 0, *l;
+    int i, j, k = 0;
+
+    *items = 0;
+    for (i = 0; i < n; ++i)
+    {
+	if (not(l = ni->list[grams[i]]))
+	    return 0;
+	if (s == 0 || l->n < s->n)
+	    s = l;
+    }
+    if (s == 0)
+	return 0;
+    if (not(*items = malloc(s->n * sizeof(**items))))
+	return -1;
+
+    for (j = 0; j < s->n; ++j)
+    {
+	for (i = 0; i < n; ++i)
+	    if ((l = ni->list[grams[i]]) != s && find_item(l, s->item[j], 0) < 0)
+		break;
+	if (i == n)
+	    (*items)[k++] = s->item[j];
+    }
+    return k;
+}
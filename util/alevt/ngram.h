@@ -0,0 +1,34 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+
+#include "vt.h"
+
+/*  A trigram index of the text of pages. The characters are folded
+    into 6 bit classes (case is ignored, rare ones share a class), so
+    the index only finds candidates: a page having all the trigrams of
+    a pattern may still not match it, but one without them never does. */
+
+#define NGRAM_BITS 18
+#define NGRAM_MAX_PATTERN 64	// most trigrams taken from a pattern
+
+struct ngram_list
+{
+    int n, max;
+    void **item;		// sorted by address
+};
+
+struct ngram_index
+{
+    struct ngram_list *list[1 << NGRAM_BITS];
+};
+
+void ngram_page_text(u8 *data, u8 *buf, int *line);
+int ngram_page(u8 *data, u32 **grams);
+int ngram_pattern(u8 *pattern, u32 *grams);
+
+struct ngram_index *ngram_open(void);
+void ngram_close(struct ngram_index *ni);
+int ngram_add(struct ngram_index *ni, void *item, u32 *grams, int n);
+void ngram_remove(struct ngram_index *ni, void *item, u32 *grams, int n);
+int ngram_query(struct ngram_index *ni, u32 *grams, int n, void ***items);
+#endif
@@ -3,64 +3,17 @@
 #include "vt.h"
 #include "misc.h"
 #include "cache.h"
+#include "ngram.h"
 #include "search.h"
 
 
-static void convert(u8 *p, u8 *buf, int *line)
-{
-    int x, y, c, ch, gfx, hid = 0;
-
-    for (y = 1, p += 40; y < 25; ++y)
-    {
-	if (not hid)
-	{
-	    gfx = 0;
-	    for (x = 0; x < 40; ++x)
-	    {
-		c = ' ';
-		switch (ch = *p++)
-		{
-		    case 0x00 ... 0x07:
-			gfx = 0;
-			break;
-		    case 0x10 ... 0x17:
-			gfx = 1;
-			break;
-		    case 0x0c:
-			hid = 1;
-			break;
-		    case 0x7f:
-			c = '*';
-			break;
-		    case 0x20 ... 0x7e:
-			if (gfx && ch != ' ' && (ch & 0xa0) == 0x20)
-			    ch = '#';
-		    case 0xa0 ... 0xff:
-			c= ch;
-		}
-		*buf++ = c;
-	    }
-	    *buf++ = '\n';
-	    *line++ = y;
-	}
-	else
-	{
-	    p += 40;
-	    hid = 0;
-	}
-    }
-    *line = y;
-    *buf = 0;
-}
-
-
 static int search_pg(struct search *s, struct vt_page *vtp)
 {
     regmatch_t m[1];
     u8 buf[H *(W+1) + 1];
     int line[H];
 
-    convert(PTR vtp->data, buf, line);
+    ngram_page_text(PTR vtp->data, buf, line);
     if (regexec(s->pattern, buf, 1, m, 0) == 0)
     {
 	s->len = 0;
@@ -95,6 +48,7 @@ struct search * search_start(struct cache *ca, u8 *pattern)
 	goto fail2;
 
     s->cache = ca;
+    s->ngrams = ngram_pattern(pattern, s->grams);
     return s;
 
 fail2:
@@ -116,8 +70,8 @@ int search_next(struct search *s, int *pgno, int *subno, int dir)
     struct vt_page *vtp = 0;
 
     if (s->cache)
-	vtp = s->cache->op->foreach_pg(s->cache, *pgno, *subno, dir,
-	search_pg, s);
+	vtp = s->cache->op->foreach_match(s->cache, *pgno, *subno, dir,
+	s->grams, s->ngrams, search_pg, s);
     if (vtp == 0)
 	return -1;
 
@@ -2,12 +2,15 @@
 #define SEARCH_H
 
 #include <regex.h>
+#include "ngram.h"
 
 struct search
 {
     struct cache *cache;
     regex_t pattern[1];
     int x, y, len; // the position of the match
+    int ngrams;
+    u32 grams[NGRAM_MAX_PATTERN]; // every match has these
 };
 
 struct search *search_start(struct cache *ca, u8 *pattern);
@@ -0,0 +1,568 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <linux/dvb/dmx.h>
+#include "vt.h"
+#include "misc.h"
+#include "dllist.h"
+#include "fdset.h"
+#include "cache.h"
+#include "vbi.h"
+#include "tsvbi.h"
+
+#define TSVBI_PSI	1
+#define TSVBI_PES	2
+
+#define PSI_SIZE	4096		// longest private section
+#define PES_SIZE	(65535 + 6)	// longest PES packet with a length
+#define DMX_BUFFER	(1024 * 1024)
+
+
+static u32 crc32(u8 *p, int len)
+{
+    u32 crc = 0xffffffff;
+    int i;
+
+    while (len--)
+    {
+	crc ^= (u32) *p++ << 24;
+	for (i = 0; i < 8; ++i)
+	    crc = crc & 0x80000000 ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+    }
+    return crc;
+}
+
+
+static struct tsvbi_service * find_service(struct tsvbi *ts, int sid)
+{
+    struct tsvbi_service *svc;
+
+    for (svc = PTR ts->services->first; svc->node->next; svc = PTR svc->node->next)
+	if (svc->sid == sid)
+	    return svc;
+    return 0;
+}
+
+
+static void close_decoder(struct tsvbi *ts, struct tsvbi_service *svc)
+{
+    if (svc->vbi == 0)
+	return;
+    ts->handler(ts->data, svc, TSVBI_GONE);
+    vbi_close(svc->vbi);	// and its cache
+    svc->vbi = 0;
+}
+
+
+static void open_decoder(struct tsvbi *ts, struct tsvbi_service *svc)
+{
+    struct cache *ca;
+
+    if (not(ca = cache_open()))
+	return;
+    if (not(svc->vbi = vbi_open_pes(ca)))
+    {
+	ca->op->close(ca);
+	return;
+    }
+    // DVB is error corrected, and merging would keep old subtitle rows
+    ca->op->mode(ca, CACHE_MODE_ERC, 0);
+    ts->handler(ts->data, svc, TSVBI_NEW);
+}
+
+/*  Follow the PIDs which are wanted now: PAT, SDT and the PMTs as
+    sections, the teletext streams as PES packets. */
+
+
+static void update_pids(struct tsvbi *ts)
+{
+    struct tsvbi_service *svc;
+    struct tsvbi_buf *b;
+    u8 want[0x2000];
+    int pid;
+
+    memset(want, 0, sizeof(want));
+    want[0x00] = want[0x11] = TSVBI_PSI;
+    for (svc = PTR ts->services->first; svc->node->next; svc = PTR svc->node->next)
+	if (svc->pmtpid < 0x1fff)
+	    want[svc->pmtpid] = TSVBI_PSI;
+    for (svc = PTR ts->services->first; svc->node->next; svc = PTR svc->node->next)
+	if (svc->vbi && not want[svc->ttpid])
+	    want[svc->ttpid] = TSVBI_PES;
+
+    for (pid = 0; pid < 0x2000; ++pid)
+    {
+	if ((b = ts->pids[pid]) && b->type != want[pid])
+	{
+	    free(b->data);
+	    free(b);
+	    ts->pids[pid] = 0;
+	}
+	if (want[pid] && ts->pids[pid] == 0)
+	{
+	    int size = want[pid] == TSVBI_PSI ? PSI_SIZE : 4096;
+
+	    if (not(b = malloc(sizeof(*b))))
+		continue;
+	    if (not(b->data = malloc(size)))
+	    {
+		free(b);
+		continue;
+	    }
+	    b->type = want[pid];
+	    b->cc = -1;
+	    b->len = 0;
+	    b->need = 0;
+	    b->size = size;
+	    ts->pids[pid] = b;
+	}
+    }
+}
+
+
+static void drop_service(struct tsvbi *ts, struct tsvbi_service *svc)
+{
+    close_decoder(ts, svc);
+    dl_remove(svc->node);
+    free(svc);
+}
+
+
+static int do_pat(struct tsvbi *ts, u8 *s, int len)
+{
+    struct tsvbi_service *svc, *nxt;
+    int version = (s[5] >> 1) & 0x1f;
+    int i, changed = 0;
+
+    if (version != ts->pat_version)
+    {
+	ts->pat_version = version;
+	ts->pat_gen++;
+    }
+
+    for (i = 8; i + 4 <= len - 4; i += 4)
+    {
+	int sid = (s[i] << 8) | s[i + 1];
+	int pmtpid = ((s[i + 2] & 0x1f) << 8) | s[i + 3];
+
+	if (sid == 0) // this is the NIT pointer
+	    continue;
+	if (not(svc = find_service(ts, sid)))
+	{
+	    if (not(svc = malloc(sizeof(*svc))))
+		continue;
+	    memset(svc, 0, sizeof(*svc));
+	    svc->sid = sid;
+	    svc->pmtpid = 0x1fff;
+	    svc->ttpid = 0x1fff;
+	    dl_insert_last(ts->services, svc->node);
+	}
+	if (svc->pmtpid != pmtpid)
+	{
+	    svc->pmtpid = pmtpid;
+	    svc->pmt_version = -1;
+	    changed = 1;
+	}
+	svc->pat_gen = ts->pat_gen;
+    }
+
+    // last section: the services no longer announced are dropped
+    if (s[6] == s[7])
+	for (svc = PTR ts->services->first; nxt = PTR svc->node->next; svc = nxt)
+	    if (svc->pat_gen != ts->pat_gen)
+	    {
+		drop_service(ts, svc);
+		changed = 1;
+	    }
+    return changed;
+}
+
+
+static int do_pmt(struct tsvbi *ts, int pid, u8 *s, int len)
+{
+    struct tsvbi_service *svc = find_service(ts, (s[3] << 8) | s[4]);
+    int version = (s[5] >> 1) & 0x1f;
+    int i, j, k, e, end = len - 4;
+    int ttpid = 0x1fff, nr_pages = 0, pages[TSVBI_MAX_PAGES];
+    char lang[4] = "";
+
+    if (svc == 0 || svc->pmtpid != pid || svc->pmt_version == version)
+	return 0;
+    svc->pmt_version = version;
+
+    i = 12 + (((s[10] & 0x0f) << 8) | s[11]); // skip program info
+    while (i + 5 <= end)
+    {
+	int type = s[i];
+	int espid = ((s[i + 1] & 0x1f) << 8) | s[i + 2];
+
+	j = i + 5;
+	e = j + (((s[i + 3] & 0x0f) << 8) | s[i + 4]);
+	if (e > end)
+	    break;
+	i = e;
+	// teletext streams have type 0x06; the first one is used
+	if (type != 0x06 || ttpid != 0x1fff)
+	    continue;
+	for (; j + 2 <= e && j + 2 + s[j + 1] <= e; j += 2 + s[j + 1])
+	{
+	    if (s[j] != 0x56) // EBU teletext descriptor
+		continue;
+	    ttpid = espid;
+	    for (k = j + 2; k + 5 <= j + 2 + s[j + 1]; k += 5)
+	    {
+		int txttype = s[k + 3] >> 3;
+		int magazine = s[k + 3] & 7;
+
+		if (lang[0] == 0)
+		    sprintf(lang, "%.3s", s + k);
+		// subtitles, and subtitles for the hearing impaired
+		if ((txttype == 2 || txttype == 5) && nr_pages < TSVBI_MAX_PAGES)
+		    pages[nr_pages++] = (magazine ?: 8) * 256 + s[k + 4];
+	    }
+	}
+    }
+
+    if (ttpid != svc->ttpid)
+	close_decoder(ts, svc);
+    svc->ttpid = ttpid;
+    strcpy(svc->lang, lang);
+    memcpy(svc->pages, pages, nr_pages * sizeof(*pages));
+    svc->nr_pages = nr_pages;
+    if (ttpid != 0x1fff && svc->vbi == 0)
+	open_decoder(ts, svc);
+    return 1;
+}
+
+
+static void do_sdt(struct tsvbi *ts, u8 *s, int len)
+{
+    struct tsvbi_service *svc;
+    int i = 11, j, e, end = len - 4;
+
+    while (i + 5 <= end)
+    {
+	svc = find_service(ts, (s[i] << 8) | s[i + 1]);
+	j = i + 5;
+	e = j + (((s[i + 3] & 0x0f) << 8) | s[i + 4]);
+	if (e > end)
+	    break;
+	i = e;
+	if (svc == 0)
+	    continue;
+	for (; j + 2 <= e && j + 2 + s[j + 1] <= e; j += 2 + s[j + 1])
+	{
+	    u8 *d = s + j + 2, *name;
+	    int dlen = s[j + 1], plen, nlen;
+
+	    if (s[j] != 0x48 || dlen < 3) // service descriptor
+		continue;
+	    plen = d[1];
+	    if (3 + plen > dlen)
+		continue;
+	    nlen = d[2 + plen];
+	    name = d + 3 + plen;
+	    if (3 + plen + nlen > dlen)
+		continue;
+	    // skip the character table code (table A.3)
+	    if (nlen && name[0] < 0x20)
+	    {
+		int skip = name[0] == 0x10 ? 3 : 1;
+
+		skip = min(skip, nlen);
+		name += skip;
+		nlen -= skip;
+	    }
+	    snprintf(svc->name, sizeof(svc->name), "%.*s", nlen, name);
+	}
+    }
+}
+
+
+static void section(struct tsvbi *ts, int pid, u8 *s, int len)
+{
+    int changed = 0;
+
+    // long form, current and intact only
+    if (len < 12 || (~s[1] & 0x80) || (~s[5] & 1) || crc32(s, len))
+	return;
+
+    if (pid == 0x00 && s[0] == 0x00)
+	changed = do_pat(ts, s, len);
+    else if (pid == 0x11 && s[0] == 0x42)
+	do_sdt(ts, s, len);
+    else if (s[0] == 0x02)
+	changed = do_pmt(ts, pid, s, len);
+
+    if (changed)
+	update_pids(ts);
+}
+
+/*  Add to the section being collected. Returns the number of bytes
+    used; a complete section is handed on and b->len is 0 again. */
+
+
+static int psi_add(struct tsvbi *ts, int pid, struct tsvbi_buf *b, u8 *d, int n)
+{
+    int used = 0, take;
+
+    if (b->len < 3)
+    {
+	take = min(n, 3 - b->len);
+	memcpy(b->data + b->len, d, take);
+	b->len += take;
+	used += take;
+	if (b->len < 3)
+	    return used;
+	b->need = 3 + (((b->data[1] & 0x0f) << 8) | b->data[2]);
+	if (b->need > b->size)
+	{
+	    b->len = 0;
+	    return n;
+	}
+    }
+
+    take = min(n - used, b->need - b->len);
+    memcpy(b->data + b->len, d + used, take);
+    b->len += take;
+    used += take;
+    if (b->len == b->need)
+    {
+	b->len = 0;
+	section(ts, pid, b->data, b->need);
+    }
+    return used;
+}
+
+
+static void psi_data(struct tsvbi *ts, int pid, struct tsvbi_buf *b,
+    u8 *d, int n, int start)
+{
+    int ptr, used;
+
+    if (not start)
+    {
+	if (b->len)
+	    psi_add(ts, pid, b, d, n);
+	return;
+    }
+
+    ptr = d[0];
+    d++, n--;
+    if (ptr >= n)
+    {
+	b->len = 0;
+	return;
+    }
+    // the end of the previous section, then the new ones
+    if (b->len)
+	psi_add(ts, pid, b, d, ptr);
+    b->len = 0;
+    d += ptr, n -= ptr;
+    while (n > 0 && d[0] != 0xff)
+    {
+	used = psi_add(ts, pid, b, d, n);
+	if (b->len) // continued in the next packet
+	    break;
+	d += used, n -= used;
+    }
+}
+
+
+static void pes_done(struct tsvbi *ts, int pid, u8 *pes, int len)
+{
+    struct tsvbi_service *svc;
+
+    // a teletext stream may be shared by several services
+    for (svc = PTR ts->services->first; svc->node->next; svc = PTR svc->node->next)
+	if (svc->vbi && svc->ttpid == pid)
+	    vbi_pes_data(svc->vbi, pes, len);
+}
+
+
+static void pes_data(struct tsvbi *ts, int pid, struct tsvbi_buf *b,
+    u8 *d, int n, int start)
+{
+    if (start)
+    {
+	if (b->len && b->need < 0) // one without a length ends here
+	    pes_done(ts, pid, b->data, b->len);
+	b->len = 0;
+	b->need = 0;
+    }
+    else if (b->len == 0)
+	return; // wait for the start of one
+
+    if (b->len + n > b->size)
+    {
+	int size = max(b->size * 2, b->len + n);
+	u8 *data;
+
+	if (size > PES_SIZE || not(data = realloc(b->data, size)))
+	{
+	    b->len = 0;
+	    return;
+	}
+	b->data = data;
+	b->size = size;
+    }
+    memcpy(b->data + b->len, d, n);
+    b->len += n;
+
+    if (b->need == 0 && b->len >= 6)
+    {
+	int plen = (b->data[4] << 8) | b->data[5];
+
+	b->need = plen ? 6 + plen : -1;
+    }
+    if (b->need > 0 && b->len >= b->need)
+    {
+	pes_done(ts, pid, b->data, b->need);
+	b->len = 0;
+    }
+}
+
+
+static void ts_packet(struct tsvbi *ts, u8 *p)
+{
+    int pid = ((p[1] & 0x1f) << 8) | p[2];
+    struct tsvbi_buf *b = ts->pids[pid];
+    int cc, off = 4;
+
+    if (b == 0 || (p[1] & 0x80)) // not wanted, or a transport error
+	return;
+    if (~p[3] & 0x10) // no payload
+	return;
+    if (p[3] & 0x20) // adaptation field
+	if ((off += 1 + p[4]) >= 188)
+	    return;
+
+    cc = p[3] & 0x0f;
+    if (cc == b->cc) // duplicate
+	return;
+    if (b->len && cc != ((b->cc + 1) & 0x0f)) // lost some
+	b->len = 0;
+    b->cc = cc;
+
+    if (b->type == TSVBI_PSI)
+	psi_data(ts, pid, b, p + off, 188 - off, p[1] & 0x40);
+    else
+	pes_data(ts, pid, b, p + off, 188 - off, p[1] & 0x40);
+}
+
+
+static void ts_handler(struct tsvbi *ts, int fd)
+{
+    int n, i;
+
+    n = read(fd, ts->buf + ts->fill, sizeof(ts->buf) - ts->fill);
+    if (n < 0)
+    {
+	if (errno == EINTR || errno == EAGAIN || errno == EOVERFLOW)
+	    return;
+	ioerror("read");
+    }
+    if (n <= 0)
+    {
+	ts->eof = 1;
+	fdset_del_fd(fds, fd);
+	return;
+    }
+    ts->fill += n;
+
+    for (i = 0; i + 188 <= ts->fill; )
+	if (ts->buf[i] == 0x47)
+	{
+	    ts_packet(ts, ts->buf + i);
+	    i += 188;
+	}
+	else
+	    i++; // resync
+
+    memmove(ts->buf, ts->buf + i, ts->fill - i);
+    ts->fill -= i;
+}
+
+
+struct tsvbi * tsvbi_open(char *name,
+    void (*handler)(void *data, struct tsvbi_service *svc, int what),
+    void *data)
+{
+    struct tsvbi *ts;
+    struct stat st;
+    int fd;
+
+    if (streq(name, "-"))
+	fd = 0;
+    else if ((fd = open(name, O_RDONLY)) == -1)
+    {
+	ioerror(name);
+	return 0;
+    }
+
+    // a demux is asked for the whole TS; a DVR or a file is read as it is
+    if (fstat(fd, &st) == 0 && S_ISCHR(st.st_mode))
+    {
+	struct dmx_pes_filter_params filterpar;
+
+	memset(&filterpar, 0, sizeof(filterpar));
+	filterpar.pid = 0x2000;
+	filterpar.input = DMX_IN_FRONTEND;
+	filterpar.output = DMX_OUT_TSDEMUX_TAP;
+	filterpar.pes_type = DMX_PES_OTHER;
+	filterpar.flags = DMX_IMMEDIATE_START;
+	ioctl(fd, DMX_SET_BUFFER_SIZE, DMX_BUFFER);
+	ioctl(fd, DMX_SET_PES_FILTER, &filterpar);
+    }
+
+    if (not(ts = malloc(sizeof(*ts))))
+    {
+	error("out of memory");
+	goto fail1;
+    }
+    memset(ts, 0, sizeof(*ts));
+    ts->fd = fd;
+    ts->handler = handler;
+    ts->data = data;
+    ts->pat_version = -1;
+    dl_init(ts->services);
+    update_pids(ts);
+
+    if (fdset_add_fd(fds, fd, ts_handler, ts))
+	goto fail2;
+    return ts;
+
+fail2:
+    tsvbi_close(ts);
+    return 0;
+fail1:
+    if (fd)
+	close(fd);
+    return 0;
+}
+
+
+void tsvbi_close(struct tsvbi *ts)
+{
+    int pid;
+
+    if (not ts->eof)
+	fdset_del_fd(fds, ts->fd);
+    while (not dl_empty(ts->services))
+	drop_service(ts, PTR ts->services->first);
+    for (pid = 0; pid < 0x2000; ++pid)
+	if (ts->pids[pid])
+	{
+	    free(ts->pids[pid]->data);
+	    free(ts->pids[pid]);
+	}
+    if (ts->fd)
+	close(ts->fd);
+    free(ts);
+}
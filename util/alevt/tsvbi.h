@@ -0,0 +1,67 @@
+#ifndef TSVBI_H
+#define TSVBI_H
+
+#include "vt.h"
+#include "misc.h"
+#include "dllist.h"
+#include "vbi.h"
+
+#define TSVBI_MAX_PAGES 8
+
+
+/*  Teletext from every service of a transport stream at once. The PAT,
+    PMTs and SDT are followed as they come, and each service with a
+    teletext stream gets a decoder with a cache of its own. */
+
+struct tsvbi_service
+{
+    struct dl_node node[1];
+    int sid;
+    int pmtpid;
+    int ttpid;			// 0x1fff: no teletext (yet)
+    char name[64];		// from the SDT, "" until it is seen
+    char lang[4];		// of the first teletext descriptor entry
+    int nr_pages;		// subtitle pages from the descriptor
+    int pages[TSVBI_MAX_PAGES];
+    struct vbi *vbi;		// the decoder; 0 without teletext
+    void *user;			// free for the caller
+    // internal
+    int pat_gen;
+    int pmt_version;
+};
+
+
+struct tsvbi_buf /*internal*/
+{
+    int type;			// TSVBI_PSI or TSVBI_PES
+    int cc;
+    int len;			// bytes collected, 0: not started
+    int need;			// length of the section or PES, 0: unknown
+    int size;
+    u8 *data;
+};
+
+
+struct tsvbi
+{
+    int fd;
+    int eof;			// end of the input or a fatal read error
+    struct dl_head services[1];
+    void (*handler)(void *data, struct tsvbi_service *svc, int what);
+    void *data;
+    // internal
+    struct tsvbi_buf *pids[0x2000];
+    int pat_version;
+    int pat_gen;
+    int fill;
+    u8 buf[188 * 64];
+};
+
+#define TSVBI_NEW	1	// svc->vbi was created: add your handlers
+#define TSVBI_GONE	2	// svc->vbi will be closed after this
+
+struct tsvbi *tsvbi_open(char *name,
+    void (*handler)(void *data, struct tsvbi_service *svc, int what),
+    void *data);
+void tsvbi_close(struct tsvbi *ts);
+#endif
@@ -651,7 +651,8 @@ static void vtwin_event(struct vtwin *w, struct vt_event *ev)
 		    if (w->subno == ANY_SUB || vtp->subno == w->subno)
 		{
 			w->searching = 0;
-			w->vtp = vtp;
+			*w->page = *vtp;
+			w->vtp = w->page;
 			put_head_line(w, vtp->data[0]);
 			for (i = 1; i < 24; ++i)
 			    xio_put_line(w->xw, i, vtp->data[i]);
@@ -23,6 +23,7 @@ struct vtwin
     int hold;
     int pgno, subno;
     struct vt_page *vtp;
+    struct vt_page page[1];	// copy of the page shown, vtp points here
     struct search *search;
     int searchdir;
     int status;
@@ -110,10 +110,12 @@ static int vt_line(struct vbi *vbi, u8 *p)
 	case 0:
 	{
 	    int b1, b2, b3, b4;
-	    b1 = hamm16(p, &err); // page number
-	    b2 = hamm16(p+2, &err); // subpage number + flags
-	    b3 = hamm16(p+4, &err); // subpage number + flags
-	    b4 = hamm16(p+6, &err); // language code + more flags
+	    u8 n[8];
+	    hamm8_row(p, n, 8, &err);
+	    b1 = n[0] | n[1] << 4; // page number
+	    b2 = n[2] | n[3] << 4; // subpage number + flags
+	    b3 = n[4] | n[5] << 4; // subpage number + flags
+	    b4 = n[6] | n[7] << 4; // language code + more flags
 	    if (vbi->ppage->page->flags & PG_MAGSERIAL)
 		vbi_send_page(vbi, vbi->ppage, b1);
 	    vbi_send_page(vbi, rvtp, b1);
@@ -168,9 +170,7 @@ static int vt_line(struct vbi *vbi, u8 *p)
 	    if (err & 0xf000)
 		return 4;
 
-	    for (i = 0; i < 13; ++i)
-		t[i] = hamm24(p + 1 + 3*i, &err);
-	    if (err & 0xf000)
+	    if (hamm24_row(p + 1, t, 13, &err))
 		return 4;
 
 	    add_enhance(rvtp->enh, d, t);
@@ -179,6 +179,7 @@ static int vt_line(struct vbi *vbi, u8 *p)
 	case 27:
 	{
 	    int b1,b2,b3,x;
+	    u8 n[6];
 	    if (~cvtp->flags & PG_ACTIVE)
 		return 0; // -1 flushes all pages. We may never resync again
 
@@ -191,12 +192,11 @@ static int vt_line(struct vbi *vbi, u8 *p)
 
 	    for (i = 0; i < 6; ++i)
 	    {
-		err = 0;
-		b1 = hamm16(p+1+6*i, &err);
-		b2 = hamm16(p+3+6*i, &err);
-		b3 = hamm16(p+5+6*i, &err);
-		if (err & 0xf000)
+		if (hamm8_row(p+1+6*i, n, 6, &err))
 		    return 1;
+		b1 = n[0] | n[1] << 4;
+		b2 = n[2] | n[3] << 4;
+		b3 = n[4] | n[5] << 4;
 		x = (b2 >> 7) | ((b3 >> 5) & 0x06);
 		cvtp->link[i].pgno = ((mag ^ x) ?: 8) * 256 + b1;
 		cvtp->link[i].subno = (b2 + b3 * 256) & 0x3f7f;
@@ -276,6 +276,7 @@ void vbi_del_handler(struct vbi *vbi, void *handler, void *data)
 	if (cl->handler == handler && cl->data == data)
 	{
 	    dl_remove(cl->node);
+	    free(cl);
 	    break;
 	}
     return;
@@ -534,7 +535,12 @@ static void dvb_handle_pes_payload(struct vbi *vbi, const u_int8_t *buf,
 
 	if (buf[0] < 0x10 || buf[0] > 0x1f)
 		return;  /* no EBU teletext data */
-	for (p = 1; p < len; p += /*6 + 40*/ 2 + buf[p + 1]) {
+	for (p = 1; p + 2 <= len && p + 2 + buf[p + 1] <= len;
+	     p += /*6 + 40*/ 2 + buf[p + 1]) {
+		/* EBU teletext (subtitle) data units only, not stuffing */
+		if ((buf[p] != 0x02 && buf[p] != 0x03) ||
+		    buf[p + 1] < 2 + sizeof(data))
+			continue;
 #if 0
 	printf("Txt Line:\n"
 	       "  data_unit_id		   0x%02x\n"
@@ -614,6 +620,20 @@ static void dvb_handler(struct vbi *vbi, int fd)
 }
 
 
+/* Decode one teletext PES packet, complete with its header. */
+void vbi_pes_data(struct vbi *vbi, const u_int8_t *pes, unsigned int len)
+{
+	unsigned int p;
+
+	if (len < 9 || pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01 ||
+	    pes[3] != 0xbd)
+		return;
+	p = 9 + pes[8];
+	if (p < len)
+		dvb_handle_pes_payload(vbi, pes + p, len - p);
+}
+
+
 static int vbi_dvb_open(struct vbi *vbi, const char *vbi_name,
 	const char *channel, char *outfile, u_int16_t sid, int ttpid)
 {
@@ -926,6 +946,33 @@ fail1:
 }
 
 
+/* A decoder without a device of its own: the caller hands it the
+   PES packets of one teletext PID with vbi_pes_data(). */
+struct vbi *vbi_open_pes(struct cache *ca)
+{
+    static int inited = 0;
+    struct vbi *vbi;
+
+    if (not inited)
+    lang_init();
+    inited = 1;
+
+    if (not(vbi = malloc(sizeof(*vbi))))
+    {
+	error("out of memory");
+	return 0;
+    }
+    vbi->fd = -1;
+    vbi->ttpid = -1;
+    vbi->sid = 0;
+    vbi->cache = ca;
+    dl_init(vbi->clients);
+    out_of_sync(vbi);
+    vbi->ppage = vbi->rpage;
+    return vbi;
+}
+
+
 void send_errmsg(struct vbi *vbi, char *errmsg, ...)
 {
 	va_list args;
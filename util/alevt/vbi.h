@@ -43,5 +43,7 @@ void vbi_del_handler(struct vbi *vbi, void *handler, void *data);
 struct vt_page *vbi_query_page(struct vbi *vbi, int pgno, int subno);
 
 struct vbi *open_null_vbi(struct cache *ca);
+struct vbi *vbi_open_pes(struct cache *ca);
+void vbi_pes_data(struct vbi *vbi, const u_int8_t *pes, unsigned int len);
 void send_errmsg(struct vbi *vbi, char *errmsg, ...);
 #endif
@@ -7,10 +7,13 @@
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
 #include <X11/Xatom.h>
+#include <X11/extensions/XShm.h>
 #define XK_MISCELLANY
 #define XK_LATIN1
 #include <X11/keysymdef.h>
 #include <sys/time.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
 #include "vt.h"
 #include "misc.h"
 #include "dllist.h"
@@ -129,6 +132,7 @@ static int get_fonts(struct xio *xio)
         case GREEK: font_bits=font4_bits; break;
         default: font_bits=font1_bits; break;
     }
+    xio->font_bits = font_bits;
 
     xio->font[0] = XCreateBitmapFromData(xio->dpy, xio->root,
 					 font_bits, font_width, font_height);
@@ -192,6 +196,10 @@ struct xio * xio_open_dpy(char *dpy, int argc, char **argv)
     if (get_fonts(xio) == -1)
 	goto fail3;
 
+    xio->shm_event = 0;
+    if (XShmQueryExtension(xio->dpy))
+	xio->shm_event = XShmGetEventBase(xio->dpy) + ShmCompletion;
+
     if (fdset_add_fd(fds, xio->fd, handle_event, xio) == -1)
 	goto fail3;
     
@@ -250,6 +258,91 @@ static void set_user_geometry(struct xio_win *xw, char *geom, XSizeHints *sh, in
 }
 
 
+static int shm_error;
+
+static int shm_error_handler(Display *dpy, XErrorEvent *ev)
+{
+    shm_error = 1;
+    return 0;
+}
+
+
+/* Create the MIT-SHM backbuffer of a window.  Pages are composed into it
+   client side and pushed with one XShmPutImage per update, instead of an
+   XCopyPlane per character.  Attaching fails for remote displays; the
+   window is then drawn the old way. */
+static void img_open(struct xio_win *xw)
+{
+    struct xio *xio = xw->xio;
+    int (*old_handler)(Display *, XErrorEvent *);
+    XImage *img;
+    int one = 1;
+
+    img = XShmCreateImage(xio->dpy, DefaultVisual(xio->dpy, xio->screen),
+			    xio->depth, ZPixmap, 0, xw->shm, WW, WH);
+    if (not img)
+	goto fail1;
+
+    xw->shm->shmid = shmget(IPC_PRIVATE, img->bytes_per_line * img->height,
+							    IPC_CREAT | 0600);
+    if (xw->shm->shmid == -1)
+	goto fail2;
+    xw->shm->shmaddr = img->data = shmat(xw->shm->shmid, 0, 0);
+    if (img->data == (char *)-1)
+	goto fail3;
+    xw->shm->readOnly = True;
+
+    XSync(xio->dpy, False);
+    shm_error = 0;
+    old_handler = XSetErrorHandler(shm_error_handler);
+    XShmAttach(xio->dpy, xw->shm);
+    XSync(xio->dpy, False);
+    XSetErrorHandler(old_handler);
+    if (shm_error)
+	goto fail4;
+
+    /* the server has it now, let the segment go with the last user */
+    shmctl(xw->shm->shmid, IPC_RMID, 0);
+
+    xw->img = img;
+    xw->img_direct = img->bits_per_pixel == 32 &&
+			img->byte_order == (*(char *)&one ? LSBFirst : MSBFirst);
+    return;
+
+fail4:
+    shmdt(xw->shm->shmaddr);
+fail3:
+    shmctl(xw->shm->shmid, IPC_RMID, 0);
+fail2:
+    img->data = 0;
+    XDestroyImage(img);
+fail1:
+    return;
+}
+
+
+static void img_close(struct xio_win *xw)
+{
+    struct xio *xio = xw->xio;
+
+    XShmDetach(xio->dpy, xw->shm);
+    XDestroyImage(xw->img);
+    shmdt(xw->shm->shmaddr);
+    xw->img = 0;
+}
+
+
+/* wait until the server has finished with the last XShmPutImage */
+static void img_wait(struct xio_win *xw)
+{
+    if (xw->img_busy)
+    {
+	XSync(xw->xio->dpy, False);
+	xw->img_busy = 0;
+    }
+}
+
+
 struct xio_win * xio_open_win(struct xio *xio, char *geom)
 {
     struct xio_win *xw;
@@ -303,6 +396,11 @@ struct xio_win * xio_open_win(struct xio *xio, char *geom)
     gcval.graphics_exposures = False;
     xw->gc = XCreateGC(xio->dpy, xw->win, GCGraphicsExposures, &gcval);
 
+    xw->img = 0;
+    xw->img_busy = 0;
+    if (xio->shm_event)
+	img_open(xw);
+
     xw->tstamp = CurrentTime;
     xw->fg = xw->bg = -1;	/* unknown colors */
 
@@ -333,6 +431,8 @@ void xio_close_win(struct xio_win *xw, int dpy_too)
 {
     struct xio *xio = xw->xio;
 
+    if (xw->img)
+	img_close(xw);
     XDestroyWindow(xio->dpy, xw->win);
     dl_remove(xw->node);
     free(xw);
@@ -484,11 +584,50 @@ void xio_set_cursor(struct xio_win *xw, int x, int y)
 }
 
 
+/* draw a character into the backbuffer, from the font bitmap */
+static void img_char(struct xio_win *xw, int fg, int bg, int c, int dbl,
+    int x, int y)
+{
+    struct xio *xio = xw->xio;
+    XImage *img = xw->img;
+    unsigned long f = xio->color[fg], b = xio->color[bg];
+    int bpl = (font_width + 7) / 8;
+    int sx = c%32*CW;
+    int h = dbl ? 2*CH : CH;
+    int i, j;
+
+    for (i = 0; i < h; ++i)
+    {
+	u8 *row = xio->font_bits + (c/32*CH + (dbl ? i/2 : i)) * bpl;
+	int dy = y*CH + i;
+
+	if (xw->img_direct)
+	{
+	    u32 *d = (u32 *)(img->data + dy * img->bytes_per_line) + x*CW;
+
+	    for (j = 0; j < CW; ++j)
+		d[j] = row[(sx+j)/8] & (1 << ((sx+j)&7)) ? f : b;
+	}
+	else
+	    for (j = 0; j < CW; ++j)
+		XPutPixel(img, x*CW + j, dy,
+				row[(sx+j)/8] & (1 << ((sx+j)&7)) ? f : b);
+    }
+}
+
 static inline void draw_char(struct xio_win *xw, Window win, int fg, int bg,
     int c, int dbl, int x, int y, int ry)
 {
     struct xio *xio = xw->xio;
 
+    if (win == xw->win && xw->img)
+    {
+	img_char(xw, fg, bg, c, dbl, x, y);
+	if (not dbl && (xw->dheight & (1<<ry)))
+	    img_char(xw, fg, bg, ' ', 0, x, y+1);
+	return;
+    }
+
     if (fg != xw->fg)
 	XSetForeground(xio->dpy, xw->gc, xio->color[xw->fg = fg]);
     if (bg != xw->bg)
@@ -509,10 +648,30 @@ static inline void draw_char(struct xio_win *xw, Window win, int fg, int bg,
     }
 }
 
-static void draw_cursor(struct xio_win *xw, int x, int y, int dbl)
+static void draw_cursor(struct xio_win *xw, int x, int y, int dbl,
+    int fg, int bg)
 {
     struct xio *xio = xw->xio;
 
+    if (xw->img)
+    {
+	unsigned long c = xio->color[xw->blink_on ? bg ^ 8 : fg];
+	int h = dbl ? 2*CH : CH;
+	int i;
+
+	for (i = 0; i < CW; ++i)
+	{
+	    XPutPixel(xw->img, x*CW + i, y*CH, c);
+	    XPutPixel(xw->img, x*CW + i, y*CH + h-1, c);
+	}
+	for (i = 0; i < h; ++i)
+	{
+	    XPutPixel(xw->img, x*CW, y*CH + i, c);
+	    XPutPixel(xw->img, x*CW + CW-1, y*CH + i, c);
+	}
+	return;
+    }
+
     if (xw->blink_on)
 	XSetForeground(xio->dpy, xw->gc, xio->color[xw->fg = xw->bg ^ 8]);
     XDrawRectangle(xio->dpy, xw->win, xw->gc, x * CW, y * CH, CW-1,
@@ -525,9 +684,12 @@ void xio_update_win(struct xio_win *xw)
     u8 *p = xw->ch;
     lbits yb, redraw;
     int x, y, c;
+    int y1 = H, y2 = 0;			/* rows composed into img */
 
     if (xw->modified == 0)
 	return;
+    if (xw->img_busy && not xw->sel_pixmap)
+	return;				/* again on ShmCompletion */
 
     redraw = xw->modified; // all modified lines
     redraw |= xw->lhidden; // all previously hidden lines
@@ -543,6 +705,11 @@ void xio_update_win(struct xio_win *xw)
 	if (redraw & yb)
 	{
 	    int fg = 7, bg = 0, _fg, _bg;
+
+	    if (y < y1)
+		y1 = y;
+	    y2 = y + (xw->dheight & yb ? 2 : 1);
+
 	    int dbl = 0, blk = 0, con = 0, gfx = 0, sep = 0, hld = 0;
 	    int last_ch = ' ';
 
@@ -637,7 +804,7 @@ void xio_update_win(struct xio_win *xw)
 		draw_char(xw, xw->win, _fg, _bg, c, dbl, x, y, y);
 
 		if (y == xw->curs_y && x == xw->curs_x)
-		    draw_cursor(xw, xw->curs_x, xw->curs_y, dbl);
+		    draw_cursor(xw, xw->curs_x, xw->curs_y, dbl, _fg, _bg);
 
 		if (xw->sel_pixmap && (_bg & 8))
 		    draw_char(xw, xw->sel_pixmap, con ? bg : fg, bg, c, dbl,
@@ -646,6 +813,13 @@ void xio_update_win(struct xio_win *xw)
 	}
 	else
 	    p += 40;
+
+    if (xw->img && y1 < y2)
+    {
+	XShmPutImage(xw->xio->dpy, xw->win, xw->gc, xw->img, 0, y1*CH,
+					0, y1*CH, WW, (y2 - y1) * CH, True);
+	xw->img_busy = 1;
+    }
 }
 
 
@@ -817,6 +991,7 @@ static Pixmap sel_convert2pixmap(struct xio_win *xw)
     pm = XCreatePixmap(xio->dpy, xio->root, (xw->sel_x2 - xw->sel_x1) * CW,
 					    (xw->sel_y2 - xw->sel_y1) * CH,
 								 xio->depth);
+    img_wait(xw);
     xw->sel_pixmap = pm;
     dirty(xw, xw->sel_y1, xw->sel_y2);
     xio_update_win(xw);
@@ -987,6 +1162,12 @@ static void handle_event(struct xio *xio, int fd)
     if (xw->node->next == 0)
 	return;
 
+    if (xio->shm_event && ev->type == xio->shm_event)
+    {
+	xw->img_busy = 0;
+	return;
+    }
+
     vtev->resource = xw;
 
     switch(ev->type)
@@ -2,6 +2,7 @@
 #define VTXIO_H
 
 #include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
 #include "vt.h"
 #include "dllist.h"
 
@@ -29,6 +30,8 @@ struct xio
     Colormap cmap;
     int color[16];			/* 8 normal, 8 dim intensity */
     Pixmap font[2];			/* normal, dbl-height */
+    unsigned char *font_bits;		/* the same, for client side drawing */
+    int shm_event;			/* ShmCompletion type, 0 if no MIT-SHM */
     Pixmap icon;			/* icon pixmap */
     struct dl_head windows[1];		/* all windows on this display */
 };
@@ -57,6 +60,11 @@ struct xio_win
     Time sel_set_t;			/* time we got selection owner */
     int sel_x1, sel_y1, sel_x2, sel_y2;	/* selected area */
     Pixmap sel_pixmap;			/* for pixmap-selection requests */
+    // MIT-SHM backbuffer
+    XImage *img;			/* the page, 0 if drawn by XCopyPlane */
+    XShmSegmentInfo shm[1];
+    int img_direct;			/* 32bpp in our byte order */
+    int img_busy;			/* server may still be reading img */
 };
 
 struct xio *xio_open_dpy(char *dpy, int argc, char **argv);
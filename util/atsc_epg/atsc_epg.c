@@ -37,17 +37,23 @@
 #include <libucsi/dvb/section.h>
 #include <libucsi/atsc/section.h>
 #include <libucsi/atsc/types.h>
+#include <libucsi/atsc/mgt_tracker.h>
+#include <libdvbepg/dvbepg.h>
+#include <libdvbswdemux/dvbswdemux.h>
+#include <libdvbswdemux/dvbswdemux_file.h>
 
 #define TIMEOUT				60
 #define RRT_TIMEOUT			60
 #define MAX_NUM_EVENT_TABLES		128
 #define TITLE_BUFFER_LEN		4096
 #define MESSAGE_BUFFER_LEN		(16 * 1024)
-#define MAX_NUM_CHANNELS		16
-#define MAX_NUM_EVENTS_PER_CHANNEL	(4 * 24 * 7)
+#define MAX_NUM_CHANNELS		1024
+#define MAX_NUM_TABLE_FILTERS		32
+#define GUIDE_ARENA_CHUNK		(256 * 1024)
 
 static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 	void **table_section);
+static void *decode_table(uint8_t *sibuf, int size, enum atsc_section_tag tag);
 
 static const char *program;
 static int adapter = 0;
@@ -56,6 +62,15 @@ static int frequency;
 static int enable_ett = 0;
 static int ctrl_c = 0;
 static const char *modulation = NULL;
+static const char *snapshot = NULL;
+static int compress_snapshot = 0;
+static const char *xmltv_file = NULL;
+static struct dvbepg *epg = NULL;
+static const char *capture_file = NULL;
+static struct dvbswdemux *swdemux = NULL;
+static struct dvbswdemux_file *capture = NULL;
+static int refresh = 0; /* minutes, 0 => once */
+static struct atsc_mgt_tracker *tracker = NULL;
 static char separator[80];
 void (*old_handler)(int);
 
@@ -65,14 +80,22 @@ struct atsc_string_buffer {
 	char *string;
 };
 
+struct atsc_eit_section_info;
+
 struct atsc_event_info {
 	uint16_t id;
+	uint16_t src_id;
+	uint8_t index;			/* of the EIT it came in */
+	uint8_t dropped;		/* repeat of the previous EIT's last event */
+	struct atsc_eit_section_info *section;
+	struct atsc_event_info *hash_next;
 	struct tm start;
 	struct tm end;
 	int title_pos;
 	int title_len;
 	int msg_pos;
 	int msg_len;
+	int has_etm;
 };
 
 struct atsc_eit_section_info {
@@ -83,11 +106,17 @@ struct atsc_eit_section_info {
 	struct atsc_event_info **events;
 };
 
+/* section[] is indexed by section_number; only those in section_pattern
+ * have been received
+ */
 struct atsc_eit_info {
-	int num_eit_sections;
+	int num_sections;		/* 0 until the first section is seen */
+	uint32_t section_pattern;	/* sections received */
 	struct atsc_eit_section_info *section;
 };
 
+#define eit_has_section(ei, k)	((ei)->section_pattern & (1U << (k)))
+
 struct atsc_channel_info {
 	uint8_t num_eits;
 	uint8_t service_type;
@@ -98,18 +127,32 @@ struct atsc_channel_info {
 	uint16_t prog_num;
 	uint16_t src_id;
 	struct atsc_eit_info *eit;
-	struct atsc_event_info *last_event;
-	int event_info_index;
-	struct atsc_event_info e[MAX_NUM_EVENTS_PER_CHANNEL];
-	struct atsc_string_buffer title_buf;
-	struct atsc_string_buffer msg_buf;
 };
 
+struct guide_arena_chunk {
+	struct guide_arena_chunk *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+/*
+ * Everything but the channel list and the text lives in an arena, freed in
+ * one go; the events are found again through a hash on (EIT, source_id,
+ * event_id), and the channels through their source_id.
+ */
 struct atsc_virtual_channels_info {
 	int num_channels;
 	uint16_t eit_pid[MAX_NUM_EVENT_TABLES];
 	uint16_t ett_pid[MAX_NUM_EVENT_TABLES];
 	struct atsc_channel_info ch[MAX_NUM_CHANNELS];
+	uint16_t channel_by_source[0x10000];	/* index + 1, 0 => none */
+	struct atsc_string_buffer title_buf;
+	struct atsc_string_buffer msg_buf;
+	struct guide_arena_chunk *arena;
+	struct atsc_event_info **event_hash;
+	unsigned int event_hash_size;		/* a power of 2 */
+	unsigned int num_events;
 } guide;
 
 struct mgt_table_name {
@@ -174,6 +217,101 @@ static void int_handler(int sig_num)
 	ctrl_c = 1;
 }
 
+/* zeroed memory which lasts as long as the guide */
+static void *guide_alloc(size_t size)
+{
+	struct guide_arena_chunk *chunk = guide.arena;
+	void *p;
+
+	size = (size + 7) & ~(size_t)7;
+	if(NULL == chunk || chunk->size - chunk->used < size) {
+		size_t chunk_size = size > GUIDE_ARENA_CHUNK ?
+			size : GUIDE_ARENA_CHUNK;
+
+		if(NULL == (chunk = malloc(sizeof(struct guide_arena_chunk) +
+			chunk_size))) {
+			return NULL;
+		}
+		chunk->size = chunk_size;
+		chunk->used = 0;
+		chunk->next = guide.arena;
+		guide.arena = chunk;
+	}
+	p = chunk->data + chunk->used;
+	chunk->used += size;
+	memset(p, 0, size);
+	return p;
+}
+
+static unsigned int event_hash(int index, uint16_t src_id, uint16_t id)
+{
+	uint32_t key = ((uint32_t)src_id << 16) | id;
+
+	key ^= (uint32_t)index * 0x9E3779B1U;
+	key ^= key >> 16;
+	key *= 0x85EBCA6BU;
+	key ^= key >> 13;
+	return key & (guide.event_hash_size - 1);
+}
+
+static int event_hash_add(struct atsc_event_info *event)
+{
+	unsigned int h;
+
+	if(guide.num_events >= guide.event_hash_size / 2) {
+		unsigned int i, old_size = guide.event_hash_size;
+		struct atsc_event_info **old = guide.event_hash;
+		struct atsc_event_info *e, *next;
+
+		guide.event_hash_size = old_size ? old_size * 2 : 1024;
+		if(NULL == (guide.event_hash = calloc(guide.event_hash_size,
+			sizeof(struct atsc_event_info *)))) {
+			guide.event_hash = old;
+			guide.event_hash_size = old_size;
+			return -1;
+		}
+		for(i = 0; i < old_size; i++) {
+			for(e = old[i]; e; e = next) {
+				next = e->hash_next;
+				h = event_hash(e->index, e->src_id, e->id);
+				e->hash_next = guide.event_hash[h];
+				guide.event_hash[h] = e;
+			}
+		}
+		free(old);
+	}
+
+	h = event_hash(event->index, event->src_id, event->id);
+	event->hash_next = guide.event_hash[h];
+	guide.event_hash[h] = event;
+	guide.num_events++;
+	return 0;
+}
+
+static struct atsc_event_info *event_hash_find(int index, uint16_t src_id,
+	uint16_t id)
+{
+	struct atsc_event_info *e;
+
+	if(0 == guide.event_hash_size) {
+		return NULL;
+	}
+	for(e = guide.event_hash[event_hash(index, src_id, id)]; e;
+		e = e->hash_next) {
+		if(e->id == id && e->src_id == src_id && e->index == index) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+static struct atsc_channel_info *channel_by_source(uint16_t src_id)
+{
+	uint16_t c = guide.channel_by_source[src_id];
+
+	return c ? &guide.ch[c - 1] : NULL;
+}
+
 /* shamelessly stolen from dvbsnoop, but almost not modified */
 static uint32_t get_bits(const uint8_t *buf, int startbit, int bitlen)
 {
@@ -201,22 +339,46 @@ static uint32_t get_bits(const uint8_t *buf, int startbit, int bitlen)
 static void usage(void)
 {
 	fprintf(stderr, "usage: %s [-a <n>] -f <frequency> [-p <period>]"
-		" [-m <modulation>] [-t] [-h]\n", program);
+		" [-m <modulation>] [-t] [-s <file> [-z]] [-x <file>] [-r <file> | -R <minutes>] [-h]\n",
+		program);
 }
 
 static void help(void)
 {
 	fprintf(stderr,
 	"\nhelp:\n"
-	"%s [-a <n>] -f <frequency> [-p <period>] [-m <modulation>] [-t] [-h]\n"
+	"%s [-a <n>] -f <frequency> [-p <period>] [-m <modulation>] [-t] [-s <file> [-z]]\n"
+	"	[-x <file>] [-r <file> | -R <minutes>] [-h]\n"
 	"  -a: adapter index to use, (default 0)\n"
 	"  -f: tuning frequency\n"
 	"  -p: period in hours, (default 12)\n"
 	"  -m: modulation ATSC vsb_8|vsb_16 (default vsb_8)\n"
 	"  -t: enable ETT to receive program details, if available\n"
+	"  -s: keep the guide in an EPG snapshot file across runs\n"
+	"  -z: compress the snapshot's titles and texts with a dictionary of\n"
+	"      the phrases they share\n"
+	"  -x: write the guide to <file> as XMLTV instead of printing it\n"
+	"  -r: read the tables from a capture file instead of tuning, as fast\n"
+	"      as the disk allows; a table is given up once the whole capture\n"
+	"      has gone by without it\n"
+	"  -R: stay tuned, and every <minutes> read the MGT and fetch again\n"
+	"      only the tables whose version it says have changed, then print\n"
+	"      the guide (and save the snapshot) again if any had\n"
 	"  -h: display this message\n", program);
 }
 
+/* how long a table was waited for, for the messages */
+static const char *timeout_text(void)
+{
+	static char text[32];
+
+	if(capture) {
+		return "the capture";
+	}
+	snprintf(text, sizeof(text), "%d seconds", TIMEOUT);
+	return text;
+}
+
 static int close_frontend(struct dvbfe_handle *fe)
 {
 	if(NULL == fe) {
@@ -333,7 +495,7 @@ static int parse_stt(int dmxfd)
 		return -1;
 	}
 	if(0 == ret) {
-		fprintf(stdout, "no STT in %d seconds\n", TIMEOUT);
+		fprintf(stdout, "no STT in %s\n", timeout_text());
 		return 0;
 	}
 
@@ -366,7 +528,7 @@ static int parse_tvct(int dmxfd)
 			return -1;
 		}
 		if(0 == ret) {
-			fprintf(stdout, "no TVCT in %d seconds\n", TIMEOUT);
+			fprintf(stdout, "no TVCT in %s\n", timeout_text());
 			return 0;
 		}
 
@@ -415,29 +577,12 @@ static int parse_tvct(int dmxfd)
 				"during initialization", __FUNCTION__);
 			return -1;
 		}
-		if(NULL == (curr_info->eit = calloc(curr_info->num_eits,
-			sizeof(struct atsc_eit_info)))) {
-			fprintf(stderr, "%s(): error calling calloc()\n",
-				__FUNCTION__);
-			return -1;
-		}
-		if(NULL == (curr_info->title_buf.string = calloc(TITLE_BUFFER_LEN,
-			sizeof(char)))) {
-			fprintf(stderr, "%s(): error calling calloc()\n",
-				__FUNCTION__);
-			return -1;
-		}
-		curr_info->title_buf.buf_len = TITLE_BUFFER_LEN;
-		curr_info->title_buf.buf_pos = 0;
-
-		if(NULL == (curr_info->msg_buf.string = calloc(MESSAGE_BUFFER_LEN,
-			sizeof(char)))) {
-			fprintf(stderr, "%s(): error calling calloc()\n",
+		if(curr_info->num_eits && NULL == (curr_info->eit = guide_alloc(
+			curr_info->num_eits * sizeof(struct atsc_eit_info)))) {
+			fprintf(stderr, "%s(): error calling guide_alloc()\n",
 				__FUNCTION__);
 			return -1;
 		}
-		curr_info->msg_buf.buf_len = MESSAGE_BUFFER_LEN;
-		curr_info->msg_buf.buf_pos = 0;
 
 		for(k = 0; k < 7; k++) {
 			curr_info->short_name[k] =
@@ -450,6 +595,8 @@ static int parse_tvct(int dmxfd)
 		curr_info->tsid = ch->channel_TSID;
 		curr_info->prog_num = ch->program_number;
 		curr_info->src_id = ch->source_id;
+		guide.channel_by_source[ch->source_id] =
+			curr_info - guide.ch + 1;
 		curr_info++;
 		}
 	} while(section_pattern != (uint32_t)((1 << num_sections) - 1));
@@ -457,36 +604,6 @@ static int parse_tvct(int dmxfd)
 	return 0;
 }
 
-static int match_event(struct atsc_eit_info *eit, uint16_t event_id,
-	struct atsc_event_info **event, uint8_t *curr_index)
-{
-	int j, k;
-	struct atsc_eit_section_info *section;
-
-	if(NULL == eit || NULL == event || NULL == curr_index) {
-		fprintf(stderr, "%s(): NULL pointer detected\n", __FUNCTION__);
-		return -1;
-	}
-
-	for(j = 0; j < eit->num_eit_sections; j++) {
-		section = &eit->section[j];
-
-		for(k = 0; k < section->num_events; k++) {
-			if(section->events[k] && section->events[k]->id ==
-				event_id) {
-				*event = section->events[k];
-				break;
-			}
-		}
-		if(*event) {
-			*curr_index = j;
-			break;
-		}
-	}
-
-	return 0;
-}
-
 static int parse_message(struct atsc_channel_info *channel,
 	struct atsc_ett_section *ett, struct atsc_event_info *event)
 {
@@ -504,17 +621,17 @@ static int parse_message(struct atsc_channel_info *channel,
 		struct atsc_text_string_segment *seg;
 
 		atsc_text_string_segments_for_each(str, seg, j) {
-			event->msg_pos = channel->msg_buf.buf_pos;
+			event->msg_pos = guide.msg_buf.buf_pos;
 			if(0 > atsc_text_segment_decode(seg,
-				(uint8_t **)&channel->msg_buf.string,
-				(size_t *)&channel->msg_buf.buf_len,
-				(size_t *)&channel->msg_buf.buf_pos)) {
+				(uint8_t **)&guide.msg_buf.string,
+				(size_t *)&guide.msg_buf.buf_len,
+				(size_t *)&guide.msg_buf.buf_pos)) {
 				fprintf(stderr, "%s(): error calling "
 					"atsc_text_segment_decode()\n",
 					__FUNCTION__);
 				return -1;
 			}
-			event->msg_len = 1 + channel->msg_buf.buf_pos -
+			event->msg_len = 1 + guide.msg_buf.buf_pos -
 				event->msg_pos;
 		}
 	}
@@ -522,89 +639,55 @@ static int parse_message(struct atsc_channel_info *channel,
 	return 0;
 }
 
-static int parse_ett(int dmxfd, int index, uint16_t pid)
+/* take in one ETT section of ETT-index; 1 if it filled in a message */
+static int ett_section(int index, struct atsc_ett_section *ett)
 {
-	uint8_t curr_index;
-	uint32_t section_pattern;
-	const enum atsc_section_tag tag = stag_atsc_extended_text;
-	struct atsc_eit_info *eit;
-	struct atsc_ett_section *ett;
 	struct atsc_channel_info *channel;
 	struct atsc_event_info *event;
-	struct atsc_eit_section_info *section;
-	uint16_t source_id, event_id;
-	int c, ret;
 
-	if(0xFFFF == guide.ett_pid[index]) {
+	if(NULL == (channel = channel_by_source(ett->ETM_source_id))) {
 		return 0;
 	}
+	if(epg) {
+		dvbepg_add_atsc_ett(epg, channel->tsid, ett);
+	}
 
-	for(c = 0; c < guide.num_channels; c++) {
-		channel = &guide.ch[c];
-		eit = &channel->eit[index];
+	event = event_hash_find(index, ett->ETM_source_id, ett->ETM_sub_id);
+	if(NULL == event || event->dropped || event->msg_len) {
+		/* unknown, or the message has been filled */
+		return 0;
+	}
 
-		section_pattern = 0;
-		while(section_pattern !=
-			(uint32_t)((1 << eit->num_eit_sections) - 1)) {
-			if(ctrl_c) {
-				return 0;
-			}
-			ret = atsc_scan_table(dmxfd, pid, tag, (void **)&ett);
-			fprintf(stdout, ".");
-			fflush(stdout);
-			if(0 > ret) {
-				fprintf(stderr, "%s(): error calling "
-					"atsc_scan_table()\n", __FUNCTION__);
-				return -1;
-			}
-			if(0 == ret) {
-				fprintf(stdout, "no ETT %d in %d seconds\n",
-					index, TIMEOUT);
-				return 0;
-			}
+	if(parse_message(channel, ett, event)) {
+		fprintf(stderr, "%s(): error calling "
+			"parse_message()\n", __FUNCTION__);
+		return -1;
+	}
+	event->section->num_received_etms++;
+	return 1;
+}
 
-			source_id = ett->ETM_source_id;
-			event_id = ett->ETM_sub_id;
-			if(source_id != channel->src_id) {
-				continue;
-			}
+/* have all the messages of the events in EIT-index arrived? */
+static int ett_complete(int index)
+{
+	int c, k;
 
-			event = NULL;
-			if(match_event(eit, event_id, &event, &curr_index)) {
-				fprintf(stderr, "%s(): error calling "
-					"match_event()\n", __FUNCTION__);
-				return -1;
-			}
-			if(NULL == event) {
-				continue;
-			}
-			if(section_pattern & (1 << curr_index)) {
-				/* the section has been filled, so skip,
-				 * not consider version yet
-				 */
-				continue;
-			}
-			if(event->msg_len) {
-				/* the message has been filled */
-				continue;
-			}
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_eit_info *eit = &guide.ch[c].eit[index];
 
-			if(parse_message(channel, ett, event)) {
-				fprintf(stderr, "%s(): error calling "
-					"parse_message()\n", __FUNCTION__);
-				return -1;
-			}
-			section = &eit->section[curr_index];
-			if(++section->num_received_etms == section->num_etms) {
-				section_pattern |= 1 << curr_index;
+		for(k = 0; k < eit->num_sections; k++) {
+			if(eit_has_section(eit, k) &&
+				eit->section[k].num_received_etms <
+				eit->section[k].num_etms) {
+				return 0;
 			}
 		}
 	}
 
-	return 0;
+	return 1;
 }
 
-static int parse_events(struct atsc_channel_info *curr_info,
+static int parse_events(struct atsc_channel_info *curr_info, int index,
 	struct atsc_eit_section *eit, struct atsc_eit_section_info *section)
 {
 	int i, j, k;
@@ -619,21 +702,23 @@ static int parse_events(struct atsc_channel_info *curr_info,
 	atsc_eit_section_events_for_each(eit, e, i) {
 		struct atsc_text *title;
 		struct atsc_text_string *str;
-		struct atsc_event_info *e_info =
-			&curr_info->e[curr_info->event_info_index];
-
-		if(0 == i && curr_info->last_event) {
-			if(e->event_id == curr_info->last_event->id) {
-				section->events[i] = NULL;
-				/* skip if it's the same event spanning
-				 * over sections
-				 */
-				continue;
-			}
+		struct atsc_event_info *e_info;
+
+		if(NULL == (e_info = guide_alloc(sizeof(struct atsc_event_info)))) {
+			fprintf(stderr, "%s(): error calling guide_alloc()\n",
+				__FUNCTION__);
+			return -1;
 		}
-		curr_info->event_info_index += 1;
 		section->events[i] = e_info;
 		e_info->id = e->event_id;
+		e_info->src_id = curr_info->src_id;
+		e_info->index = index;
+		e_info->section = section;
+		if(event_hash_add(e_info)) {
+			fprintf(stderr, "%s(): error calling calloc()\n",
+				__FUNCTION__);
+			return -1;
+		}
 		start_time = atsctime_to_unixtime(e->start_time);
 		end_time = start_time + e->length_in_seconds;
 		localtime_r(&start_time, &e_info->start);
@@ -641,6 +726,7 @@ static int parse_events(struct atsc_channel_info *curr_info,
 		if(0 != e->ETM_location && 3 != e->ETM_location) {
 			/* FIXME assume 1 and 2 is interchangable as of now */
 			section->num_etms++;
+			e_info->has_etm = 1;
 		}
 
 		title = atsc_eit_event_name_title_text(e);
@@ -650,17 +736,17 @@ static int parse_events(struct atsc_channel_info *curr_info,
 			struct atsc_text_string_segment *seg;
 
 			atsc_text_string_segments_for_each(str, seg, k) {
-				e_info->title_pos = curr_info->title_buf.buf_pos;
+				e_info->title_pos = guide.title_buf.buf_pos;
 				if(0 > atsc_text_segment_decode(seg,
-					(uint8_t **)&curr_info->title_buf.string,
-					(size_t *)&curr_info->title_buf.buf_len,
-					(size_t *)&curr_info->title_buf.buf_pos)) {
+					(uint8_t **)&guide.title_buf.string,
+					(size_t *)&guide.title_buf.buf_len,
+					(size_t *)&guide.title_buf.buf_pos)) {
 					fprintf(stderr, "%s(): error calling "
 						"atsc_text_segment_decode()\n",
 						__FUNCTION__);
 					return -1;
 				}
-				e_info->title_len = curr_info->title_buf.buf_pos -
+				e_info->title_len = guide.title_buf.buf_pos -
 					e_info->title_pos + 1;
 			}
 		}
@@ -669,262 +755,719 @@ static int parse_events(struct atsc_channel_info *curr_info,
 	return 0;
 }
 
-static int parse_eit(int dmxfd, int index, uint16_t pid)
+/* take in one EIT section of EIT-index; 1 if it was a new one */
+static int eit_section(int index, struct atsc_eit_section *eit)
 {
-	int num_sections;
 	uint8_t section_num;
-	uint8_t curr_channel_index;
-	uint32_t section_pattern;
-	const enum atsc_section_tag tag = stag_atsc_event_information;
-	struct atsc_eit_section *eit;
 	struct atsc_channel_info *curr_info;
 	struct atsc_eit_info *eit_info;
 	struct atsc_eit_section_info *section;
-	uint16_t source_id;
-	uint32_t eit_instance_pattern = 0;
-	int i, k, ret;
-
-	while(eit_instance_pattern !=
-		(uint32_t)((1 << guide.num_channels) - 1)) {
-		source_id = 0xFFFF;
-		section_pattern = 0;
-		num_sections = -1;
-
-		do {
-			ret = atsc_scan_table(dmxfd, pid, tag, (void **)&eit);
-			fprintf(stdout, ".");
-			fflush(stdout);
-			if(0 > ret) {
-				fprintf(stderr, "%s(): error calling "
-					"atsc_scan_table()\n", __FUNCTION__);
-				return -1;
-			}
-			if(0 == ret) {
-				fprintf(stdout, "no EIT %d in %d seconds\n",
-					index, TIMEOUT);
-				return 0;
-			}
-
-			if(0xFFFF == source_id) {
-			source_id = atsc_eit_section_source_id(eit);
-			for(k = 0; k < guide.num_channels; k++) {
-				if(source_id == guide.ch[k].src_id) {
-					curr_info = &guide.ch[k];
-					curr_channel_index = k;
-					if(0 == index) {
-						curr_info->last_event = NULL;
-					}
-					break;
-				}
-			}
-			if(k == guide.num_channels) {
-				fprintf(stderr, "%s(): cannot find source_id "
-					"0x%04X in the EIT\n",
-					__FUNCTION__, source_id);
-				return -1;
-			}
-			} else {
-				if(source_id !=
-					atsc_eit_section_source_id(eit)) {
-					continue;
-				}
-			}
-			if(eit_instance_pattern & (1 << curr_channel_index)) {
-				/* we have received this instance,
-				 * so quit quick
-				 */
-				break;
-			}
-
-			if(-1 == num_sections) {
-				num_sections = 1 +
-					eit->head.ext_head.last_section_number;
-				if(32 < num_sections) {
-					fprintf(stderr,
-						"%s(): no support yet for "
-						"tables having more than "
-						"32 sections\n", __FUNCTION__);
-					return -1;
-				}
-			} else {
-				if(num_sections != 1 +
-					eit->head.ext_head.last_section_number) {
-					fprintf(stderr,
-						"%s(): last section number "
-						"does not match\n",
-						__FUNCTION__);
-					return -1;
-				}
-			}
-			if(section_pattern &
-				(1 << eit->head.ext_head.section_number)) {
-				continue;
-			}
-			section_pattern |= 1 << eit->head.ext_head.section_number;
-
-			eit_info = &curr_info->eit[index];
-			if(NULL == (eit_info->section =
-				realloc(eit_info->section,
-				(eit_info->num_eit_sections + 1) *
-				sizeof(struct atsc_eit_section_info)))) {
-				fprintf(stderr,
-					"%s(): error calling realloc()\n",
-					__FUNCTION__);
-				return -1;
-			}
-			section_num = eit->head.ext_head.section_number;
-			if(0 == eit_info->num_eit_sections) {
-				eit_info->num_eit_sections = 1;
-				section = eit_info->section;
-			} else {
-				/* have to sort it into section order
-				 * (temporal order)
-				 */
-				for(i = 0; i < eit_info->num_eit_sections; i++) {
-					if(eit_info->section[i].section_num >
-						section_num) {
-						break;
-					}
-				}
-				memmove(&eit_info->section[i + 1],
-					&eit_info->section[i],
-					(eit_info->num_eit_sections - i) *
-					sizeof(struct atsc_eit_section_info));
-				section = &eit_info->section[i - 1];
-				section = &eit_info->section[i];
-				eit_info->num_eit_sections += 1;
-			}
 
-			section->section_num = section_num;
-			section->num_events = eit->num_events_in_section;
-			section->num_etms = 0;
-			section->num_received_etms = 0;
-			if(NULL == (section->events = calloc(section->num_events,
-				sizeof(struct atsc_event_info *)))) {
-				fprintf(stderr, "%s(): error calling calloc()\n",
-					__FUNCTION__);
-				return -1;
-			}
-			if(parse_events(curr_info, eit, section)) {
-				fprintf(stderr, "%s(): error calling "
-					"parse_events()\n", __FUNCTION__);
-				return -1;
-			}
-		} while(section_pattern != (uint32_t)((1 << num_sections) - 1));
-		eit_instance_pattern |= 1 << curr_channel_index;
+	if(NULL == (curr_info = channel_by_source(
+		atsc_eit_section_source_id(eit)))) {
+		/* not a channel of this transport stream */
+		return 0;
 	}
-
-	for(i = 0; i < guide.num_channels; i++) {
-		struct atsc_channel_info *channel = &guide.ch[i];
-		struct atsc_eit_info *ei = &channel->eit[index];
-		struct atsc_eit_section_info *s;
-
-		if(0 == ei->num_eit_sections) {
-			channel->last_event = NULL;
-			continue;
+	eit_info = &curr_info->eit[index];
+
+	if(0 == eit_info->num_sections) {
+		eit_info->num_sections = 1 +
+			eit->head.ext_head.last_section_number;
+		if(32 < eit_info->num_sections) {
+			fprintf(stderr,
+				"%s(): no support yet for "
+				"tables having more than "
+				"32 sections\n", __FUNCTION__);
+			return -1;
 		}
-		s = &ei->section[ei->num_eit_sections - 1];
-		/* BUG: it's incorrect when last section has no event */
-		if(0 == s->num_events) {
-			channel->last_event = NULL;
-			continue;
+		if(NULL == (eit_info->section = guide_alloc(
+			eit_info->num_sections *
+			sizeof(struct atsc_eit_section_info)))) {
+			fprintf(stderr, "%s(): error calling guide_alloc()\n",
+				__FUNCTION__);
+			return -1;
+		}
+	} else {
+		if(eit_info->num_sections != 1 +
+			eit->head.ext_head.last_section_number) {
+			fprintf(stderr,
+				"%s(): last section number "
+				"does not match\n",
+				__FUNCTION__);
+			return -1;
 		}
-		channel->last_event = s->events[s->num_events - 1];
+	}
+	section_num = eit->head.ext_head.section_number;
+	if(eit_has_section(eit_info, section_num)) {
+		return 0;
+	}
+	eit_info->section_pattern |= 1U << section_num;
+	if(epg && 0 > dvbepg_add_atsc_eit(epg, curr_info->tsid,
+		index, eit)) {
+		fprintf(stderr, "%s(): error calling "
+			"dvbepg_add_atsc_eit()\n", __FUNCTION__);
 	}
 
-	return 0;
-}
-
-static int parse_mgt(int dmxfd)
-{
-	const enum atsc_section_tag tag = stag_atsc_master_guide;
-	struct atsc_mgt_section *mgt;
-	struct atsc_mgt_table *t;
-	int i, j, ret;
-
-	ret = atsc_scan_table(dmxfd, ATSC_BASE_PID, tag, (void **)&mgt);
-	if(0 > ret) {
-		fprintf(stderr, "%s(): error calling atsc_scan_table()\n",
+	section = &eit_info->section[section_num];
+	section->section_num = section_num;
+	section->num_events = eit->num_events_in_section;
+	if(section->num_events && NULL == (section->events = guide_alloc(
+		section->num_events * sizeof(struct atsc_event_info *)))) {
+		fprintf(stderr, "%s(): error calling guide_alloc()\n",
 			__FUNCTION__);
 		return -1;
 	}
-	if(0 == ret) {
-		fprintf(stdout, "no MGT in %d seconds\n", TIMEOUT);
-		return 0;
+	if(parse_events(curr_info, index, eit, section)) {
+		fprintf(stderr, "%s(): error calling "
+			"parse_events()\n", __FUNCTION__);
+		return -1;
 	}
 
-	fprintf(stdout, "MGT table:\n");
-	atsc_mgt_section_tables_for_each(mgt, t, i) {
-		struct mgt_table_name table;
+	return 1;
+}
 
-	for(j = 0; j < (int)(sizeof(mgt_tab_name_array) /
-		sizeof(struct mgt_table_name)); j++) {
-		if(t->table_type > mgt_tab_name_array[j].range) {
-			continue;
-		}
-		table = mgt_tab_name_array[j];
-		if(0 == j || mgt_tab_name_array[j - 1].range + 1 ==
-			mgt_tab_name_array[j].range) {
-			j = -1;
-		} else {
-			j = t->table_type - mgt_tab_name_array[j - 1].range - 1;
-			if(0x017F == table.range) {
-				guide.eit_pid[j] = t->table_type_PID;
-			} else if (0x027F == table.range) {
-				guide.ett_pid[j] = t->table_type_PID;
-			}
-		}
-		break;
-	}
+/* have all the channels' instances of EIT-index arrived? */
+static int eit_complete(int index)
+{
+	int c;
 
-		fprintf(stdout, "  %2d: type = 0x%04X, PID = 0x%04X, %s", i,
-		    t->table_type, t->table_type_PID, table.string);
-		if(-1 != j) {
-		    fprintf(stdout, " %d", j);
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_eit_info *eit = &guide.ch[c].eit[index];
+
+		if(0 == eit->num_sections || eit->section_pattern !=
+			(uint32_t)((1ULL << eit->num_sections) - 1)) {
+			return 0;
 		}
-		fprintf(stdout, "\n");
 	}
 
-	return 0;
+	return 1;
 }
 
-static int cleanup_guide(void)
+/*
+ * An event running across the boundary of two EITs is in both; drop it from
+ * the later one. The tables arrive in any order, so this is done once they
+ * are all in.
+ */
+static void merge_spanning_events(void)
 {
-	int i, j, k;
+	struct atsc_event_info *last_event;
+	int c, j, k;
 
-	for(i = 0; i < guide.num_channels; i++) {
-		struct atsc_channel_info *channel = &guide.ch[i];
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_channel_info *channel = &guide.ch[c];
 
-		if(channel->title_buf.string) {
-			free(channel->title_buf.string);
-		}
-		if(channel->msg_buf.string) {
-			free(channel->msg_buf.string);
-		}
+		last_event = NULL;
 		for(j = 0; j < channel->num_eits; j++) {
-			struct atsc_eit_info *eit = &channel->eit[j];
+			struct atsc_eit_info *ei = &channel->eit[j];
+			struct atsc_eit_section_info *s = NULL;
 
-			for(k = 0; k < eit->num_eit_sections; k++) {
-				struct atsc_eit_section_info *section =
-					&eit->section[k];
-				if(section->num_events) {
-					free(section->events);
+			for(k = 0; k < ei->num_sections; k++) {
+				if(!eit_has_section(ei, k)) {
+					continue;
+				}
+				s = &ei->section[k];
+				if(last_event && s->num_events && s->events[0] &&
+					s->events[0]->id == last_event->id) {
+					if(s->events[0]->has_etm) {
+						s->num_etms--;
+					}
+					s->events[0]->dropped = 1;
+					s->events[0] = NULL;
+				}
+			}
+
+			last_event = NULL;
+			/* BUG: it's incorrect when last section has no event */
+			if(s && s->num_events) {
+				last_event = s->events[s->num_events - 1];
+			}
+		}
+	}
+}
+
+struct table_filter {
+	int fd;
+	int index;
+	time_t last_progress;
+};
+
+/*
+ * -r: the state of a table being collected from the capture
+ */
+struct capture_filter {
+	struct dvbswdemux_filter *filter;
+	enum atsc_section_tag tag;
+	int index;
+	int done;
+	int failed;
+	uint64_t last_progress;		/* capture position */
+};
+
+static int capture_table_section(void *private_data, uint8_t *data, int len)
+{
+	struct capture_filter *f = (struct capture_filter *) private_data;
+	unsigned char sibuf[4096];
+	void *table;
+	int ret;
+
+	/* the section is shared with the demux, and decoded in place */
+	if(f->done || len > (int)sizeof(sibuf)) {
+		return 0;
+	}
+	memcpy(sibuf, data, len);
+	if(NULL == (table = decode_table(sibuf, len, f->tag))) {
+		return 0;
+	}
+	ret = (stag_atsc_event_information == f->tag) ?
+		eit_section(f->index, table) :
+		ett_section(f->index, table);
+	if(0 > ret) {
+		f->failed = 1;
+		f->done = 1;
+		return 0;
+	}
+	if(ret) {
+		f->last_progress = dvbswdemux_file_position(capture);
+		fprintf(stdout, ".");
+		fflush(stdout);
+	}
+	return 0;
+}
+
+/*
+ * -r: as acquire_tables(), with a filter on every PID at once, and a table
+ * given up once a whole pass over the capture has brought nothing new
+ */
+static int acquire_capture_tables(enum atsc_section_tag tag, uint16_t *pids, int count)
+{
+	struct capture_filter *filters;
+	const char *name = (stag_atsc_event_information == tag) ? "EIT" : "ETT";
+	uint8_t filter[18];
+	uint8_t mask[18];
+	int i, active = 0, ret = 0;
+
+	if(NULL == (filters = calloc(count ? count : 1, sizeof(struct capture_filter)))) {
+		fprintf(stderr, "%s(): error calling calloc()\n", __FUNCTION__);
+		return -1;
+	}
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = tag;
+	mask[0] = 0xFF;
+	for(i = 0; i < count; i++) {
+		filters[i].tag = tag;
+		filters[i].index = i;
+		filters[i].last_progress = dvbswdemux_file_position(capture);
+		if(0xFFFF == pids[i]) {
+			filters[i].done = 1;
+			continue;
+		}
+		if(NULL == (filters[i].filter = dvbswdemux_add_section_filter(swdemux,
+			pids[i], filter, mask, 1, capture_table_section, &filters[i]))) {
+			fprintf(stderr, "%s(): error calling "
+				"dvbswdemux_add_section_filter()\n", __FUNCTION__);
+			ret = -1;
+			goto out;
+		}
+		active++;
+	}
+
+	while(active && !ctrl_c) {
+		if(dvbswdemux_file_feed(capture)) {
+			fprintf(stderr, "%s(): error calling dvbswdemux_file_feed()\n",
+				__FUNCTION__);
+			ret = -1;
+			break;
+		}
+
+		for(i = 0; i < count; i++) {
+			if(NULL == filters[i].filter) {
+				continue;
+			}
+			if(!filters[i].done) {
+				filters[i].done = (stag_atsc_event_information == tag) ?
+					eit_complete(i) : ett_complete(i);
+			}
+			if(!filters[i].done && dvbswdemux_file_position(capture) -
+				filters[i].last_progress >= dvbswdemux_file_size(capture)) {
+				fprintf(stdout, "no %s %d in the capture\n", name, i);
+				filters[i].done = 1;
+			}
+			if(filters[i].done) {
+				if(filters[i].failed) {
+					ret = -1;
+				}
+				dvbswdemux_remove_filter(swdemux, filters[i].filter);
+				filters[i].filter = NULL;
+				active--;
+			}
+		}
+	}
+
+out:
+	for(i = 0; i < count; i++) {
+		if(filters[i].filter) {
+			dvbswdemux_remove_filter(swdemux, filters[i].filter);
+		}
+	}
+	free(filters);
+	return ret;
+}
+
+/*
+ * Collect EIT-k or ETT-k for every k at once: a section filter on each of
+ * the PIDs (as many as the demux will give us, the rest as those finish),
+ * each done when its section bitmap says so, or when nothing new has come
+ * in on it for TIMEOUT seconds.
+ */
+static int acquire_tables(enum atsc_section_tag tag, uint16_t *pids, int count)
+{
+	struct table_filter filters[MAX_NUM_TABLE_FILTERS];
+	struct pollfd pollfds[MAX_NUM_TABLE_FILTERS];
+	const char *name = (stag_atsc_event_information == tag) ? "EIT" : "ETT";
+	int max_filters = MAX_NUM_TABLE_FILTERS;
+	int active = 0, next = 0;
+	unsigned char sibuf[4096];
+	uint8_t filter[18];
+	uint8_t mask[18];
+	void *table;
+	time_t now;
+	int i, fd, size, ret;
+
+	if(capture) {
+		return acquire_capture_tables(tag, pids, count);
+	}
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = tag;
+	mask[0] = 0xFF;
+
+	while(!ctrl_c) {
+		/* start filters on the tables still to come */
+		while(active < max_filters && next < count) {
+			if(0xFFFF == pids[next]) {
+				next++;
+				continue;
+			}
+			if(0 > (fd = dvbdemux_open_demux(adapter, 0, 0))) {
+				if(0 == active) {
+					fprintf(stderr, "%s(): error calling "
+						"dvbdemux_open_demux()\n",
+						__FUNCTION__);
+					return -1;
+				}
+				max_filters = active;
+				break;
+			}
+			if(dvbdemux_set_section_filter(fd, pids[next], filter,
+				mask, 1, 1)) {
+				close(fd);
+				if(0 == active) {
+					fprintf(stderr, "%s(): error calling "
+						"dvbdemux_set_section_filter()\n",
+						__FUNCTION__);
+					return -1;
+				}
+				max_filters = active;
+				break;
+			}
+			filters[active].fd = fd;
+			filters[active].index = next;
+			filters[active].last_progress = time(NULL);
+			pollfds[active].fd = fd;
+			pollfds[active].events = POLLIN | POLLERR | POLLPRI;
+			active++;
+			next++;
+		}
+		if(0 == active) {
+			break;
+		}
+
+		if(0 > poll(pollfds, active, 1000)) {
+			if(EINTR == errno) {
+				continue;
+			}
+			fprintf(stderr, "%s(): error calling poll()\n",
+				__FUNCTION__);
+			return -1;
+		}
+
+		now = time(NULL);
+		for(i = 0; i < active; i++) {
+			int done;
+
+			if(pollfds[i].revents & (POLLIN | POLLERR | POLLPRI)) {
+				/* an overflow only loses sections, which come
+				 * round again
+				 */
+				size = read(pollfds[i].fd, sibuf, sizeof(sibuf));
+				if(0 > size && EOVERFLOW != errno &&
+					EAGAIN != errno) {
+					fprintf(stderr, "%s(): error calling "
+						"read()\n", __FUNCTION__);
+					return -1;
+				}
+				if(0 < size &&
+					NULL != (table = decode_table(sibuf, size, tag))) {
+					ret = (stag_atsc_event_information == tag) ?
+						eit_section(filters[i].index, table) :
+						ett_section(filters[i].index, table);
+					if(0 > ret) {
+						return -1;
+					}
+					if(ret) {
+						filters[i].last_progress = now;
+						fprintf(stdout, ".");
+						fflush(stdout);
+					}
 				}
 			}
-			if(k) {
-				free(eit->section);
+
+			done = (stag_atsc_event_information == tag) ?
+				eit_complete(filters[i].index) :
+				ett_complete(filters[i].index);
+			if(!done && now - filters[i].last_progress >= TIMEOUT) {
+				fprintf(stdout, "no %s %d in %d seconds\n",
+					name, filters[i].index, TIMEOUT);
+				done = 1;
+			}
+			if(done) {
+				close(filters[i].fd);
+				active--;
+				filters[i] = filters[active];
+				pollfds[i] = pollfds[active];
+				i--;
 			}
 		}
-		if(j) {
-			free(channel->eit);
+	}
+
+	for(i = 0; i < active; i++) {
+		close(filters[i].fd);
+	}
+	return 0;
+}
+
+static int parse_mgt(int dmxfd)
+{
+	const enum atsc_section_tag tag = stag_atsc_master_guide;
+	struct atsc_mgt_section *mgt;
+	struct atsc_mgt_table *t;
+	int i, j, ret;
+
+	ret = atsc_scan_table(dmxfd, ATSC_BASE_PID, tag, (void **)&mgt);
+	if(0 > ret) {
+		fprintf(stderr, "%s(): error calling atsc_scan_table()\n",
+			__FUNCTION__);
+		return -1;
+	}
+	if(0 == ret) {
+		fprintf(stdout, "no MGT in %s\n", timeout_text());
+		return 0;
+	}
+	if(0 > atsc_mgt_tracker_update(tracker, mgt)) {
+		fprintf(stderr, "%s(): error calling atsc_mgt_tracker_update()\n",
+			__FUNCTION__);
+		return -1;
+	}
+
+	fprintf(stdout, "MGT table:\n");
+	atsc_mgt_section_tables_for_each(mgt, t, i) {
+		struct mgt_table_name table;
+
+	for(j = 0; j < (int)(sizeof(mgt_tab_name_array) /
+		sizeof(struct mgt_table_name)); j++) {
+		if(t->table_type > mgt_tab_name_array[j].range) {
+			continue;
+		}
+		table = mgt_tab_name_array[j];
+		if(0 == j || mgt_tab_name_array[j - 1].range + 1 ==
+			mgt_tab_name_array[j].range) {
+			j = -1;
+		} else {
+			j = t->table_type - mgt_tab_name_array[j - 1].range - 1;
+			if(0x017F == table.range) {
+				guide.eit_pid[j] = t->table_type_PID;
+			} else if (0x027F == table.range) {
+				guide.ett_pid[j] = t->table_type_PID;
+			}
+		}
+		break;
+	}
+
+		fprintf(stdout, "  %2d: type = 0x%04X, PID = 0x%04X, %s", i,
+		    t->table_type, t->table_type_PID, table.string);
+		if(-1 != j) {
+		    fprintf(stdout, " %d", j);
 		}
+		fprintf(stdout, "\n");
 	}
 
 	return 0;
 }
 
-static int print_events(struct atsc_channel_info *channel,
-	struct atsc_eit_section_info *section)
+/* record the EIT-k or ETT-k which are complete as held by the guide */
+static void tables_cached(enum atsc_section_tag tag, int count)
+{
+	int k, done;
+
+	for(k = 0; k < count; k++) {
+		if(stag_atsc_event_information == tag) {
+			done = eit_complete(k);
+			if(done) {
+				atsc_mgt_tracker_cached(tracker,
+					ATSC_MGT_TABLE_TYPE_EIT(k), -1);
+			}
+		} else {
+			done = ett_complete(k);
+			if(done) {
+				atsc_mgt_tracker_cached(tracker,
+					ATSC_MGT_TABLE_TYPE_ETT(k), -1);
+			}
+		}
+	}
+}
+
+/*
+ * Forget EIT-index, so that it is collected again: its events leave the
+ * hash, and their memory stays in the arena until the guide is cleaned up.
+ */
+static void drop_eit(int index)
+{
+	struct atsc_event_info **e;
+	unsigned int h;
+	int c;
+
+	for(c = 0; c < guide.num_channels; c++) {
+		if(index < guide.ch[c].num_eits) {
+			memset(&guide.ch[c].eit[index], 0,
+				sizeof(struct atsc_eit_info));
+		}
+	}
+	for(h = 0; h < guide.event_hash_size; h++) {
+		for(e = &guide.event_hash[h]; *e; ) {
+			if((*e)->index == index) {
+				*e = (*e)->hash_next;
+				guide.num_events--;
+			} else {
+				e = &(*e)->hash_next;
+			}
+		}
+	}
+	atsc_mgt_tracker_forget(tracker, ATSC_MGT_TABLE_TYPE_EIT(index));
+	atsc_mgt_tracker_forget(tracker, ATSC_MGT_TABLE_TYPE_ETT(index));
+}
+
+/* forget the messages of the events in EIT-index */
+static void drop_ett(int index)
+{
+	int c, k, m;
+
+	for(c = 0; c < guide.num_channels; c++) {
+		struct atsc_eit_info *eit;
+
+		if(index >= guide.ch[c].num_eits) {
+			continue;
+		}
+		eit = &guide.ch[c].eit[index];
+		for(k = 0; k < eit->num_sections; k++) {
+			struct atsc_eit_section_info *s = &eit->section[k];
+
+			if(!eit_has_section(eit, k)) {
+				continue;
+			}
+			s->num_received_etms = 0;
+			for(m = 0; m < s->num_events; m++) {
+				if(s->events[m]) {
+					s->events[m]->msg_len = 0;
+				}
+			}
+		}
+	}
+	atsc_mgt_tracker_forget(tracker, ATSC_MGT_TABLE_TYPE_ETT(index));
+}
+
+/* the PIDs of the EIT-k or ETT-k the tracker says have changed */
+static int stale_pids(uint16_t table_type, uint16_t *pids, uint16_t *stale)
+{
+	int k, count = 0;
+
+	for(k = 0; k < guide.ch[0].num_eits; k++) {
+		stale[k] = 0xFFFF;
+		if(0xFFFF != pids[k] && 1 == atsc_mgt_tracker_stale(tracker,
+			table_type + k)) {
+			stale[k] = pids[k];
+			count++;
+		}
+	}
+	return count;
+}
+
+/* the EIT-k and ETT-k PIDs, from the MGT last read */
+static void tracker_pids(void)
+{
+	int k, pid;
+
+	for(k = 0; k < MAX_NUM_EVENT_TABLES; k++) {
+		pid = atsc_mgt_tracker_pid(tracker, ATSC_MGT_TABLE_TYPE_EIT(k));
+		guide.eit_pid[k] = (0 > pid) ? 0xFFFF : pid;
+		pid = atsc_mgt_tracker_pid(tracker, ATSC_MGT_TABLE_TYPE_ETT(k));
+		guide.ett_pid[k] = (0 > pid) ? 0xFFFF : pid;
+	}
+}
+
+static int init_guide(void);
+static int cleanup_guide(void);
+
+/*
+ * -R: read the MGT again, and fetch just what it says has changed.
+ *
+ * @return 1 if the guide changed, 0 if not, -1 on error.
+ */
+static int refresh_guide(int dmxfd)
+{
+	const enum atsc_section_tag tag = stag_atsc_master_guide;
+	struct atsc_mgt_section *mgt;
+	uint16_t stale[MAX_NUM_EVENT_TABLES];
+	int k, ret;
+
+	ret = atsc_scan_table(dmxfd, ATSC_BASE_PID, tag, (void **)&mgt);
+	if(0 >= ret) {
+		return ret;
+	}
+	if(0 > (ret = atsc_mgt_tracker_update(tracker, mgt))) {
+		fprintf(stderr, "%s(): error calling atsc_mgt_tracker_update()\n",
+			__FUNCTION__);
+		return -1;
+	}
+	if(1 != atsc_mgt_tracker_stale(tracker, ATSC_MGT_TABLE_TYPE_TVCT_CURRENT)) {
+		/* those the guide doesn't use, e.g. the RRT, don't count */
+		ret = 0;
+		for(k = 0; k < guide.ch[0].num_eits; k++) {
+			ret |= 1 == atsc_mgt_tracker_stale(tracker,
+				ATSC_MGT_TABLE_TYPE_EIT(k));
+			ret |= enable_ett && 1 == atsc_mgt_tracker_stale(tracker,
+				ATSC_MGT_TABLE_TYPE_ETT(k));
+		}
+		if(0 == ret) {
+			return 0;
+		}
+	}
+	fprintf(stdout, "MGT version %d\n", atsc_mgt_tracker_mgt_version(tracker));
+	tracker_pids();
+
+	/* a new channel list: start the guide again */
+	if(1 == atsc_mgt_tracker_stale(tracker, ATSC_MGT_TABLE_TYPE_TVCT_CURRENT)) {
+		fprintf(stdout, "TVCT changed, receiving everything\n");
+		if(cleanup_guide() || init_guide()) {
+			return -1;
+		}
+		tracker_pids();
+		if(parse_tvct(dmxfd)) {
+			return -1;
+		}
+		for(k = 0; k < MAX_NUM_EVENT_TABLES; k++) {
+			atsc_mgt_tracker_forget(tracker, ATSC_MGT_TABLE_TYPE_EIT(k));
+			atsc_mgt_tracker_forget(tracker, ATSC_MGT_TABLE_TYPE_ETT(k));
+		}
+		atsc_mgt_tracker_cached(tracker, ATSC_MGT_TABLE_TYPE_TVCT_CURRENT, -1);
+	}
+	if(0 == guide.num_channels) {
+		return 1;
+	}
+
+	if(stale_pids(ATSC_MGT_TABLE_TYPE_EIT(0), guide.eit_pid, stale)) {
+		for(k = 0; k < guide.ch[0].num_eits; k++) {
+			if(0xFFFF != stale[k]) {
+				drop_eit(k);
+			}
+		}
+		fprintf(stdout, "receiving EIT ");
+		if(acquire_tables(stag_atsc_event_information, stale,
+			guide.ch[0].num_eits)) {
+			return -1;
+		}
+		fprintf(stdout, "\n");
+		merge_spanning_events();
+		tables_cached(stag_atsc_event_information, guide.ch[0].num_eits);
+	}
+
+	if(enable_ett && stale_pids(ATSC_MGT_TABLE_TYPE_ETT(0), guide.ett_pid,
+		stale)) {
+		for(k = 0; k < guide.ch[0].num_eits; k++) {
+			if(0xFFFF != stale[k]) {
+				drop_ett(k);
+			}
+		}
+		fprintf(stdout, "receiving ETT ");
+		if(acquire_tables(stag_atsc_extended_text, stale,
+			guide.ch[0].num_eits)) {
+			return -1;
+		}
+		fprintf(stdout, "\n");
+		tables_cached(stag_atsc_extended_text, guide.ch[0].num_eits);
+	}
+
+	return 1;
+}
+
+static int init_guide(void)
+{
+	memset(&guide, 0, sizeof(struct atsc_virtual_channels_info));
+	memset(guide.eit_pid, 0xFF, MAX_NUM_EVENT_TABLES * sizeof(uint16_t));
+	memset(guide.ett_pid, 0xFF, MAX_NUM_EVENT_TABLES * sizeof(uint16_t));
+	if(NULL == (guide.title_buf.string = calloc(TITLE_BUFFER_LEN,
+		sizeof(char))) ||
+		NULL == (guide.msg_buf.string = calloc(MESSAGE_BUFFER_LEN,
+		sizeof(char)))) {
+		fprintf(stderr, "%s(): error calling calloc()\n",
+			__FUNCTION__);
+		return -1;
+	}
+	guide.title_buf.buf_len = TITLE_BUFFER_LEN;
+	guide.msg_buf.buf_len = MESSAGE_BUFFER_LEN;
+
+	return 0;
+}
+
+static void save_snapshot(void)
+{
+	if(NULL == snapshot) {
+		return;
+	}
+	dvbepg_expire(epg, time(NULL));
+	if(compress_snapshot &&
+		dvbepg_compress(epg, DVBEPG_DICTIONARY_MAX)) {
+		fprintf(stderr, "%s(): error calling dvbepg_compress()\n",
+			__FUNCTION__);
+	}
+	if(dvbepg_save(epg, snapshot)) {
+		fprintf(stderr, "%s(): error calling dvbepg_save()\n",
+			__FUNCTION__);
+	}
+}
+
+static int cleanup_guide(void)
+{
+	struct guide_arena_chunk *chunk, *next;
+
+	for(chunk = guide.arena; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	guide.arena = NULL;
+	free(guide.event_hash);
+	guide.event_hash = NULL;
+	guide.event_hash_size = 0;
+	free(guide.title_buf.string);
+	free(guide.msg_buf.string);
+	guide.title_buf.string = guide.msg_buf.string = NULL;
+
+	return 0;
+}
+
+static int print_events(struct atsc_eit_section_info *section)
 {
 	int m;
 	char line[256];
@@ -944,7 +1487,7 @@ static int print_events(struct atsc_channel_info *channel,
 			event->start.tm_hour, event->start.tm_min,
 			event->end.tm_hour, event->end.tm_min);
 		snprintf(line, event->title_len, "%s",
-			&channel->title_buf.string[event->title_pos]);
+			&guide.title_buf.string[event->title_pos]);
 		line[event->title_len] = '\0';
 		fprintf(stdout, "%s\n", line);
 		if(event->msg_len) {
@@ -955,7 +1498,7 @@ static int print_events(struct atsc_channel_info *channel,
 			do {
 				part = len > 255 ? 255 : len;
 				snprintf(line, part, "%s",
-					&channel->msg_buf.string[pos]);
+					&guide.msg_buf.string[pos]);
 				line[part] = '\0';
 				fprintf(stdout, "%s", line);
 				len -= part;
@@ -967,10 +1510,53 @@ static int print_events(struct atsc_channel_info *channel,
 	return 0;
 }
 
+/* an XMLTV channel is named as the guide prints it */
+static const char *export_channel_name(void *private_data,
+	const struct dvbepg_service_id *service)
+{
+	static char name[32];
+	struct atsc_channel_info *channel = channel_by_source(service->service_id);
+
+	(void) private_data;
+	if(NULL == channel || channel->tsid != service->transport_stream_id) {
+		return NULL;
+	}
+	snprintf(name, sizeof(name), "%d.%d %s", channel->major_num,
+		channel->minor_num, channel->short_name);
+	return name;
+}
+
+static int export_guide(void)
+{
+	struct dvbepg_export_params params;
+	int fd;
+	int ret;
+
+	if(0 > (fd = open(xmltv_file, O_WRONLY | O_CREAT | O_TRUNC, 0644))) {
+		fprintf(stderr, "%s(): error opening %s: %s\n", __FUNCTION__,
+			xmltv_file, strerror(errno));
+		return -1;
+	}
+	memset(&params, 0, sizeof(params));
+	params.format = DVBEPG_EXPORT_XMLTV;
+	params.service_name = export_channel_name;
+	if(0 > (ret = dvbepg_export(epg, fd, &params))) {
+		fprintf(stderr, "%s(): error calling dvbepg_export(): %s\n",
+			__FUNCTION__, strerror(-ret));
+	}
+	close(fd);
+
+	return ret ? -1 : 0;
+}
+
 static int print_guide(void)
 {
 	int i, j, k;
 
+	if(xmltv_file) {
+		return export_guide();
+	}
+
 	fprintf(stdout, "%s\n", separator);
 	for(i = 0; i < guide.num_channels; i++) {
 		struct atsc_channel_info *channel = &guide.ch[i];
@@ -980,10 +1566,14 @@ static int print_guide(void)
 		for(j = 0; j < channel->num_eits; j++) {
 			struct atsc_eit_info *eit = &channel->eit[j];
 
-			for(k = 0; k < eit->num_eit_sections; k++) {
+			for(k = 0; k < eit->num_sections; k++) {
 				struct atsc_eit_section_info *section =
 					&eit->section[k];
-				if(print_events(channel, section)) {
+
+				if(!eit_has_section(eit, k)) {
+					continue;
+				}
+				if(print_events(section)) {
 					fprintf(stderr, "%s(): error calling "
 						"print_events()\n", __FUNCTION__);
 					return -1;
@@ -1016,25 +1606,109 @@ static int close_demux(int dmxfd)
 	return 0;
 }
 
+/* parse a section read from the demux into the table it is part of */
+static void *decode_table(uint8_t *sibuf, int size, enum atsc_section_tag tag)
+{
+	struct section *section;
+	struct section_ext *section_ext;
+	struct atsc_section_psip *psip;
+	void *table_section;
+
+	section = section_codec(sibuf, size);
+	if(NULL == section) {
+		fprintf(stderr, "%s(): error calling section_codec()\n",
+			__FUNCTION__);
+		return NULL;
+	}
+
+	section_ext = section_ext_decode(section, 0);
+	if(NULL == section_ext) {
+		fprintf(stderr, "%s(): error calling section_ext_decode()\n",
+			__FUNCTION__);
+		return NULL;
+	}
+
+	psip = atsc_section_psip_decode(section_ext);
+	if(NULL == psip) {
+		fprintf(stderr,
+			"%s(): error calling atsc_section_psip_decode()\n",
+			__FUNCTION__);
+		return NULL;
+	}
+
+	table_section = table_callback[tag & 0x0F](psip);
+	if(NULL == table_section) {
+		fprintf(stderr, "%s(): error decode table section\n",
+			__FUNCTION__);
+		return NULL;
+	}
+
+	return table_section;
+}
+
+struct capture_section {
+	uint8_t *buf;
+	int size;
+};
+
+static int capture_first_section(void *private_data, uint8_t *data, int len)
+{
+	struct capture_section *s = (struct capture_section *) private_data;
+
+	if(s->size || len > 4096) {
+		return 0;
+	}
+	memcpy(s->buf, data, len);
+	s->size = len;
+	return 0;
+}
+
 /* used other utilities as template and generalized here */
 static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 	void **table_section)
 {
 	uint8_t filter[18];
 	uint8_t mask[18];
-	unsigned char sibuf[4096];
+	/* the decoded table points into it */
+	static unsigned char sibuf[4096];
 	int size;
 	int ret;
 	struct pollfd pollfd;
-	struct section *section;
-	struct section_ext *section_ext;
-	struct atsc_section_psip *psip;
 
 	/* create a section filter for the table */
 	memset(filter, 0, sizeof(filter));
 	memset(mask, 0, sizeof(mask));
 	filter[0] = tag;
 	mask[0] = 0xFF;
+
+	/* -r: the first section from here on, within a pass over the capture */
+	if(capture) {
+		struct capture_section s = { sibuf, 0 };
+		struct dvbswdemux_filter *f;
+		uint64_t start = dvbswdemux_file_position(capture);
+
+		if(NULL == (f = dvbswdemux_add_section_filter(swdemux, pid,
+			filter, mask, 1, capture_first_section, &s))) {
+			fprintf(stderr, "%s(): error calling "
+				"dvbswdemux_add_section_filter()\n", __FUNCTION__);
+			return -1;
+		}
+		while(0 == s.size && !ctrl_c && dvbswdemux_file_position(capture) -
+			start < dvbswdemux_file_size(capture)) {
+			if(dvbswdemux_file_feed(capture)) {
+				break;
+			}
+		}
+		dvbswdemux_remove_filter(swdemux, f);
+		if(0 == s.size) {
+			return 0;
+		}
+		if(NULL == (*table_section = decode_table(sibuf, s.size, tag))) {
+			return -1;
+		}
+		return 1;
+	}
+
 	if(dvbdemux_set_section_filter(dmxfd, pid, filter, mask, 1, 1)) {
 		fprintf(stderr, "%s(): error calling atsc_scan_table()\n",
 			__FUNCTION__);
@@ -1062,33 +1736,7 @@ static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 		return -1;
 	}
 
-	/* parse section */
-	section = section_codec(sibuf, size);
-	if(NULL == section) {
-		fprintf(stderr, "%s(): error calling section_codec()\n",
-			__FUNCTION__);
-		return -1;
-	}
-
-	section_ext = section_ext_decode(section, 0);
-	if(NULL == section_ext) {
-		fprintf(stderr, "%s(): error calling section_ext_decode()\n",
-			__FUNCTION__);
-		return -1;
-	}
-
-	psip = atsc_section_psip_decode(section_ext);
-	if(NULL == psip) {
-		fprintf(stderr,
-			"%s(): error calling atsc_section_psip_decode()\n",
-			__FUNCTION__);
-		return -1;
-	}
-
-	*table_section = table_callback[tag & 0x0F](psip);
-	if(NULL == *table_section) {
-		fprintf(stderr, "%s(): error decode table section\n",
-			__FUNCTION__);
+	if(NULL == (*table_section = decode_table(sibuf, size, tag))) {
 		return -1;
 	}
 
@@ -1097,7 +1745,7 @@ static int atsc_scan_table(int dmxfd, uint16_t pid, enum atsc_section_tag tag,
 
 int main(int argc, char *argv[])
 {
-	int i, dmxfd;
+	int dmxfd;
 	struct dvbfe_handle *fe;
 
 	program = argv[0];
@@ -1110,7 +1758,7 @@ int main(int argc, char *argv[])
 	for( ; ; ) {
 		char c;
 
-		if(-1 == (c = getopt(argc, argv, "a:f:p:m:th"))) {
+		if(-1 == (c = getopt(argc, argv, "a:f:p:m:ts:zx:r:R:h"))) {
 			break;
 		}
 
@@ -1140,6 +1788,26 @@ int main(int argc, char *argv[])
 			enable_ett = 1;
 			break;
 
+		case 's':
+			snapshot = optarg;
+			break;
+
+		case 'z':
+			compress_snapshot = 1;
+			break;
+
+		case 'x':
+			xmltv_file = optarg;
+			break;
+
+		case 'r':
+			capture_file = optarg;
+			break;
+
+		case 'R':
+			refresh = strtol(optarg, NULL, 0);
+			break;
+
 		case 'h':
 			help();
 			exit(0);
@@ -1152,17 +1820,51 @@ int main(int argc, char *argv[])
 
 	memset(separator, '-', sizeof(separator));
 	separator[79] = '\0';
-	memset(&guide, 0, sizeof(struct atsc_virtual_channels_info));
-	memset(guide.eit_pid, 0xFF, MAX_NUM_EVENT_TABLES * sizeof(uint16_t));
-	memset(guide.ett_pid, 0xFF, MAX_NUM_EVENT_TABLES * sizeof(uint16_t));
+	if(capture_file && refresh) {
+		usage();
+		exit(-1);
+	}
+	if(init_guide()) {
+		return -1;
+	}
+	if(NULL == (tracker = atsc_mgt_tracker_create())) {
+		fprintf(stderr, "%s(): error calling atsc_mgt_tracker_create()\n",
+			__FUNCTION__);
+		return -1;
+	}
 
-	if(open_frontend(&fe)) {
-		fprintf(stderr, "%s(): error calling open_frontend()\n",
+	if(snapshot) {
+		/* sections already in the snapshot are skipped when they
+		 * come round again unchanged
+		 */
+		if(NULL == (epg = dvbepg_load(snapshot)) &&
+			NULL == (epg = dvbepg_create())) {
+			fprintf(stderr, "%s(): error calling dvbepg_create()\n",
+				__FUNCTION__);
+			return -1;
+		}
+	} else if(xmltv_file && NULL == (epg = dvbepg_create())) {
+		/* the export is made from a store of this run only */
+		fprintf(stderr, "%s(): error calling dvbepg_create()\n",
 			__FUNCTION__);
 		return -1;
 	}
 
-	if(open_demux(&dmxfd)) {
+	if(capture_file) {
+		if(NULL == (swdemux = dvbswdemux_create()) ||
+			NULL == (capture = dvbswdemux_file_open(capture_file,
+			swdemux, 0))) {
+			fprintf(stderr, "%s(): could not read %s\n",
+				__FUNCTION__, capture_file);
+			return -1;
+		}
+		fe = NULL;
+		dmxfd = -1;
+	} else if(open_frontend(&fe)) {
+		fprintf(stderr, "%s(): error calling open_frontend()\n",
+			__FUNCTION__);
+		return -1;
+	} else if(open_demux(&dmxfd)) {
 		fprintf(stderr, "%s(): error calling open_demux()\n",
 			__FUNCTION__);
 		return -1;
@@ -1185,6 +1887,7 @@ int main(int argc, char *argv[])
 			__FUNCTION__);
 		return -1;
 	}
+	atsc_mgt_tracker_cached(tracker, ATSC_MGT_TABLE_TYPE_TVCT_CURRENT, -1);
 
 #ifdef ENABLE_RRT
 	if(parse_rrt(dmxfd)) {
@@ -1195,39 +1898,69 @@ int main(int argc, char *argv[])
 #endif
 
 	fprintf(stdout, "receiving EIT ");
-	for(i = 0; i < guide.ch[0].num_eits; i++) {
-		if(parse_eit(dmxfd, i, guide.eit_pid[i])) {
-			fprintf(stderr, "%s(): error calling parse_eit()\n",
-				__FUNCTION__);
-			return -1;
-		}
+	if(acquire_tables(stag_atsc_event_information, guide.eit_pid,
+		guide.ch[0].num_eits)) {
+		fprintf(stderr, "%s(): error calling acquire_tables()\n",
+			__FUNCTION__);
+		return -1;
 	}
 	fprintf(stdout, "\n");
+	merge_spanning_events();
+	tables_cached(stag_atsc_event_information, guide.ch[0].num_eits);
 
 	old_handler = signal(SIGINT, int_handler);
 	if(enable_ett) {
 		fprintf(stdout, "receiving ETT ");
-		for(i = 0; i < guide.ch[0].num_eits; i++) {
-			if(0xFFFF != guide.ett_pid[i]) {
-				if(parse_ett(dmxfd, i, guide.ett_pid[i])) {
-					fprintf(stderr, "%s(): error calling "
-						"parse_eit()\n", __FUNCTION__);
-					return -1;
-				}
-			}
-			if(ctrl_c) {
-				break;
-			}
+		if(acquire_tables(stag_atsc_extended_text, guide.ett_pid,
+			guide.ch[0].num_eits)) {
+			fprintf(stderr, "%s(): error calling "
+				"acquire_tables()\n", __FUNCTION__);
+			return -1;
 		}
 		fprintf(stdout, "\n");
+		tables_cached(stag_atsc_extended_text, guide.ch[0].num_eits);
 	}
-	signal(SIGINT, old_handler);
 
 	if(print_guide()) {
 		fprintf(stderr, "%s(): error calling print_guide()\n",
 			__FUNCTION__);
 		return -1;
 	}
+	save_snapshot();
+
+	/* -R: from now on, a refresh costs an MGT unless the tables changed */
+	while(refresh && !ctrl_c) {
+		time_t next = time(NULL) + 60 * refresh;
+		int ret;
+
+		while(!ctrl_c && time(NULL) < next) {
+			sleep(1);
+		}
+		if(ctrl_c) {
+			break;
+		}
+		if(0 > (ret = refresh_guide(dmxfd))) {
+			fprintf(stderr, "%s(): error calling refresh_guide()\n",
+				__FUNCTION__);
+			return -1;
+		}
+		if(0 == ret) {
+			fprintf(stdout, "guide unchanged\n");
+			continue;
+		}
+		if(print_guide()) {
+			fprintf(stderr, "%s(): error calling print_guide()\n",
+				__FUNCTION__);
+			return -1;
+		}
+		save_snapshot();
+	}
+	signal(SIGINT, old_handler);
+
+	if(epg) {
+		dvbepg_destroy(epg);
+	}
+	atsc_mgt_tracker_destroy(tracker);
 
 	if(cleanup_guide()) {
 		fprintf(stderr, "%s(): error calling cleanup_guide()\n",
@@ -1235,6 +1968,12 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
+	if(capture) {
+		dvbswdemux_file_close(capture);
+		dvbswdemux_destroy(swdemux);
+		return 0;
+	}
+
 	if(close_demux(dmxfd)) {
 		fprintf(stderr, "%s(): error calling close_demux()\n",
 			__FUNCTION__);
@@ -40,4 +40,6 @@ struct i2c_rdwr_ioctl_data {
 	__u32 nmsgs;
 };
 
+#define I2C_RDWR_IOCTL_MAX_MSGS 42
+
 #endif
@@ -34,6 +34,8 @@
 #include <math.h>
 
 #include <fcntl.h>
+#include <time.h>
+#include <stddef.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -48,10 +50,13 @@
 void usage (void)
 {
 	verb("usage: dib3000-watch -d <i2c-device> -a <i2c-address> [-o <type>] [-i <seconds>]\n"
+		 "                     [-s <milliseconds>] [-n <samples>]\n"
 		 "   -d    normally one of /dev/i2c-[0-255]\n"
 		 "   -a    is 8 for DiB3000M-B and 9, 10, 11 or 12 for DiB3000M-C or DiB3000-P\n"
 		 "   -o    output type (print|csv) (default: print)\n"
 		 "   -i    query interval in seconds (default: 0.1)\n"
+		 "   -s    sample the demod every <milliseconds> in between (default: the query interval)\n"
+		 "   -n    keep the last <samples> for the min/avg/max summary (default: 1000)\n"
 		 "\n"
 		 "Don't forget to run tzap or any other dvb-tune program (vdr, kaxtv) in order to tune a channel,\n"
 		 "tuning isn't done by this tool.\n"
@@ -87,6 +92,46 @@ __u16 dib_read_reg(struct dib_demod *dib,__u16 reg)
 	return (rb[0] << 8)| rb[1];
 };
 
+/* read a set of registers with as few I2C_RDWR transactions as possible */
+int dib_read_regs(struct dib_demod *dib, const __u16 *regs, __u16 *vals, int count)
+{
+	struct i2c_msg msg[I2C_RDWR_IOCTL_MAX_MSGS];
+	__u8 wb[I2C_RDWR_IOCTL_MAX_MSGS / 2][2];
+	__u8 rb[I2C_RDWR_IOCTL_MAX_MSGS / 2][2];
+	struct i2c_rdwr_ioctl_data i2c_data = { .msgs  = msg };
+	int i, n, ret;
+
+	while (count > 0) {
+		n = count < I2C_RDWR_IOCTL_MAX_MSGS / 2 ? count : I2C_RDWR_IOCTL_MAX_MSGS / 2;
+
+		for (i = 0; i < n; i++) {
+			wb[i][0] = ((regs[i] >> 8) | 0x80) & 0xff;
+			wb[i][1] = regs[i] & 0xff;
+			msg[i*2].addr    = dib->i2c_addr;
+			msg[i*2].flags   = 0;
+			msg[i*2].buf     = wb[i];
+			msg[i*2].len     = 2;
+			msg[i*2+1].addr  = dib->i2c_addr;
+			msg[i*2+1].flags = I2C_M_RD;
+			msg[i*2+1].buf   = rb[i];
+			msg[i*2+1].len   = 2;
+		}
+		i2c_data.nmsgs = n * 2;
+
+		if ((ret = ioctl(dib->fd,I2C_RDWR,&i2c_data)) != n * 2) {
+			err("i2c_rdwr read failed. (%d)\n",ret);
+			return -1;
+		}
+
+		for (i = 0; i < n; i++)
+			vals[i] = (rb[i][0] << 8) | rb[i][1];
+		regs += n;
+		vals += n;
+		count -= n;
+	}
+	return 0;
+}
+
 int dib_write_reg(struct dib_demod *dib, __u16 reg, __u16 val)
 {
 	int ret;
@@ -109,40 +154,65 @@ int dib_write_reg(struct dib_demod *dib, __u16 reg, __u16 val)
 	return 0;
 }
 
+/* everything one sample needs, read in one go */
+enum {
+	MB_AGC_POWER = 0, MB_RF_POWER, MB_DDS_INV, MB_TPS_FFT,
+	MB_AGC_LOCK, MB_CARRIER_LOCK, MB_TPS_LOCK, MB_VIT_LCK, MB_TS_SYNC_LOCK, MB_TS_RS_LOCK,
+	MB_DDS_FREQ_MSB, MB_DDS_FREQ_LSB, MB_DDS_VALUE_MSB, MB_DDS_VALUE_LSB,
+	MB_BER_MSB, MB_BER_LSB, MB_PER, MB_UNC, MB_FFT_POS,
+	MB_SIGNAL_POWER, MB_NOISE_POWER_MSB, MB_NOISE_POWER_LSB, MB_MER_MSB, MB_MER_LSB,
+	MB_TIMING_OFFSET_MSB, MB_TIMING_OFFSET_LSB,
+	MB_NREGS
+};
+
+static const __u16 dib3000mb_regs[MB_NREGS] = {
+	DIB3000MB_REG_AGC_POWER, DIB3000MB_REG_RF_POWER, DIB3000MB_REG_DDS_INV, DIB3000MB_REG_TPS_FFT,
+	DIB3000MB_REG_AGC_LOCK, DIB3000MB_REG_CARRIER_LOCK, DIB3000MB_REG_TPS_LOCK, DIB3000MB_REG_VIT_LCK,
+	DIB3000MB_REG_TS_SYNC_LOCK, DIB3000MB_REG_TS_RS_LOCK,
+	DIB3000MB_REG_DDS_FREQ_MSB, DIB3000MB_REG_DDS_FREQ_LSB, DIB3000MB_REG_DDS_VALUE_MSB, DIB3000MB_REG_DDS_VALUE_LSB,
+	DIB3000MB_REG_BER_MSB, DIB3000MB_REG_BER_LSB, DIB3000MB_REG_PACKET_ERROR_RATE, DIB3000MB_REG_UNC,
+	DIB3000MB_REG_FFT_WINDOW_POS,
+	DIB3000MB_REG_SIGNAL_POWER, DIB3000MB_REG_NOISE_POWER_MSB, DIB3000MB_REG_NOISE_POWER_LSB,
+	DIB3000MB_REG_MER_MSB, DIB3000MB_REG_MER_LSB,
+	DIB3000MB_REG_TIMING_OFFSET_MSB, DIB3000MB_REG_TIMING_OFFSET_LSB,
+};
+
 int dib3000mb_monitoring(struct dib_demod *dib,struct dib3000mb_monitoring *m)
 {
-	int dds_freq, p_dds_freq,
-		n_agc_power = dib_read_reg(dib,DIB3000MB_REG_AGC_POWER),
-		rf_power = dib_read_reg(dib,DIB3000MB_REG_RF_POWER),
-		timing_offset;
+	__u16 r[MB_NREGS];
+	int dds_freq, p_dds_freq, n_agc_power, rf_power, timing_offset;
 	double ad_power_dB, minor_power;
 
-	m->invspec = dib_read_reg(dib,DIB3000MB_REG_DDS_INV);
-	m->nfft = dib_read_reg(dib,DIB3000MB_REG_TPS_FFT);
+	if (dib_read_regs(dib,dib3000mb_regs,r,MB_NREGS) < 0)
+		return -1;
+
+	n_agc_power = r[MB_AGC_POWER];
+	rf_power = r[MB_RF_POWER];
 
-	m->agc_lock = dib_read_reg(dib,DIB3000MB_REG_AGC_LOCK);
-	m->carrier_lock = dib_read_reg(dib,DIB3000MB_REG_CARRIER_LOCK);
-	m->tps_lock = dib_read_reg(dib,DIB3000MB_REG_TPS_LOCK);
-	m->vit_lock = dib_read_reg(dib,DIB3000MB_REG_VIT_LCK);
-	m->ts_sync_lock = dib_read_reg(dib,DIB3000MB_REG_TS_SYNC_LOCK);
-	m->ts_data_lock = dib_read_reg(dib,DIB3000MB_REG_TS_RS_LOCK);
+	m->invspec = r[MB_DDS_INV];
+	m->nfft = r[MB_TPS_FFT];
 
-	p_dds_freq = ((dib_read_reg(dib,DIB3000MB_REG_DDS_FREQ_MSB) & 0xff) << 8) |
-				 ((dib_read_reg(dib,DIB3000MB_REG_DDS_FREQ_LSB) & 0xff00) >> 8);
-	dds_freq =   ((dib_read_reg(dib,DIB3000MB_REG_DDS_VALUE_MSB) & 0xff) << 8) |
-				 ((dib_read_reg(dib,DIB3000MB_REG_DDS_VALUE_LSB) & 0xff00) >> 8);
+	m->agc_lock = r[MB_AGC_LOCK];
+	m->carrier_lock = r[MB_CARRIER_LOCK];
+	m->tps_lock = r[MB_TPS_LOCK];
+	m->vit_lock = r[MB_VIT_LCK];
+	m->ts_sync_lock = r[MB_TS_SYNC_LOCK];
+	m->ts_data_lock = r[MB_TS_RS_LOCK];
+
+	p_dds_freq = ((r[MB_DDS_FREQ_MSB] & 0xff) << 8) | ((r[MB_DDS_FREQ_LSB] & 0xff00) >> 8);
+	dds_freq =   ((r[MB_DDS_VALUE_MSB] & 0xff) << 8) | ((r[MB_DDS_VALUE_LSB] & 0xff00) >> 8);
 	if (m->invspec)
 		dds_freq = (1 << 16) - dds_freq;
 	m->carrier_offset = (double)(dds_freq - p_dds_freq) / (double)(1 << 16) * DEF_SampFreq_KHz;
 
-	m->ber = (double)((dib_read_reg(dib,DIB3000MB_REG_BER_MSB) << 16) | dib_read_reg(dib,DIB3000MB_REG_BER_LSB)) / (double) 1e8;
-	m->per = dib_read_reg(dib,DIB3000MB_REG_PACKET_ERROR_RATE);
-	m->unc = dib_read_reg(dib,DIB3000MB_REG_UNC);
-	m->fft_pos = dib_read_reg(dib,DIB3000MB_REG_FFT_WINDOW_POS);
-	m->snr = 10.0 * log10( (double)(dib_read_reg(dib,DIB3000MB_REG_SIGNAL_POWER) << 8) /
-		(double)((dib_read_reg(dib,DIB3000MB_REG_NOISE_POWER_MSB) << 16) + dib_read_reg(dib,DIB3000MB_REG_NOISE_POWER_LSB)));
+	m->ber = (double)((r[MB_BER_MSB] << 16) | r[MB_BER_LSB]) / (double) 1e8;
+	m->per = r[MB_PER];
+	m->unc = r[MB_UNC];
+	m->fft_pos = r[MB_FFT_POS];
+	m->snr = 10.0 * log10( (double)(r[MB_SIGNAL_POWER] << 8) /
+		(double)((r[MB_NOISE_POWER_MSB] << 16) + r[MB_NOISE_POWER_LSB]));
 
-	m->mer = (double) ((dib_read_reg(dib,DIB3000MB_REG_MER_MSB) << 16) + dib_read_reg(dib,DIB3000MB_REG_MER_LSB))
+	m->mer = (double) ((r[MB_MER_MSB] << 16) + r[MB_MER_LSB])
 		/ (double) (1<<9) / (m->nfft ? 767.0 : 191.0);
 
 	if (n_agc_power == 0)
@@ -151,8 +221,7 @@ int dib3000mb_monitoring(struct dib_demod *dib,struct dib3000mb_monitoring *m)
 	minor_power = ad_power_dB - DEF_agc_ref_dB ;
 	m->rf_power = -DEF_gain_slope_dB * (double)rf_power/(double)(1<<16) + DEF_gain_delta_dB + minor_power;
 
-	timing_offset =
-		(dib_read_reg(dib,DIB3000MB_REG_TIMING_OFFSET_MSB) << 16) + dib_read_reg(dib,DIB3000MB_REG_TIMING_OFFSET_LSB);
+	timing_offset = (r[MB_TIMING_OFFSET_MSB] << 16) + r[MB_TIMING_OFFSET_LSB];
 	if (timing_offset >= 0x800000)
 		timing_offset |= 0xff000000;
 	m->timing_offset_ppm = -(double)timing_offset / (double)(m->nfft ? 8192 : 2048) * 1e6 / (double)(1<<20);
@@ -189,6 +258,94 @@ int dib3000mb_print_monitoring(struct dib3000mb_monitoring *m)
 
 int interrupted;
 
+/* the values summarized over the history */
+#define MB_INT(f)    { #f, offsetof(struct dib3000mb_monitoring,f), 1 }
+#define MB_DOUBLE(f) { #f, offsetof(struct dib3000mb_monitoring,f), 0 }
+
+static const struct {
+	const char *name;
+	size_t offset;
+	int is_int;
+} dib3000mb_fields[] = {
+	MB_INT(agc_lock), MB_INT(carrier_lock), MB_INT(tps_lock), MB_INT(vit_lock),
+	MB_INT(ts_sync_lock), MB_INT(ts_data_lock),
+	MB_DOUBLE(carrier_offset), MB_DOUBLE(ber), MB_INT(per), MB_INT(unc), MB_INT(fft_pos),
+	MB_DOUBLE(snr), MB_DOUBLE(mer), MB_DOUBLE(rf_power), MB_DOUBLE(timing_offset_ppm),
+};
+
+static double dib3000mb_field(struct dib3000mb_monitoring *m, int i)
+{
+	char *p = (char *) m + dib3000mb_fields[i].offset;
+
+	return dib3000mb_fields[i].is_int ? *(int *) p : *(double *) p;
+}
+
+int dib_history_init(struct dib_history *h, int size, double period)
+{
+	memset(h,0,sizeof(struct dib_history));
+	if ((h->samples = calloc(size,sizeof(struct dib3000mb_monitoring))) == NULL)
+		return -1;
+	h->size = size;
+	h->period = period;
+	return 0;
+}
+
+void dib_history_add(struct dib_history *h, struct dib3000mb_monitoring *m)
+{
+	struct dib3000mb_monitoring *prev = h->count ? &h->samples[(h->head + h->size - 1) % h->size] : NULL;
+
+	if (prev && prev->ts_data_lock && !m->ts_data_lock)
+		h->lock_drops++;
+
+	h->samples[h->head] = *m;
+	h->head = (h->head + 1) % h->size;
+	if (h->count < h->size)
+		h->count++;
+}
+
+int dib_history_print(struct dib_history *h)
+{
+	unsigned int f;
+	int i;
+
+	printf("\n\n");
+	printf(" last %d samples (%.1f s), every %g ms, slowest read %.2f ms, %lu late, %lu TS lock drops\n\n",
+		h->count, h->count * h->period, h->period * 1000, h->worst_read * 1000, h->late, h->lock_drops);
+	printf(" %-24s %12s %12s %12s\n","","min","avg","max");
+
+	for (f = 0; f < sizeof(dib3000mb_fields) / sizeof(dib3000mb_fields[0]); f++) {
+		double v, min = 0, max = 0, sum = 0;
+
+		for (i = 0; i < h->count; i++) {
+			v = dib3000mb_field(&h->samples[i],f);
+			if (i == 0 || v < min)
+				min = v;
+			if (i == 0 || v > max)
+				max = v;
+			sum += v;
+		}
+		printf(" %-24s %12.6g %12.6g %12.6g\n",dib3000mb_fields[f].name,min,
+			h->count ? sum / h->count : 0,max);
+	}
+	return 0;
+}
+
+static double dib_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void dib_sleep_until(double t)
+{
+	struct timespec ts;
+	ts.tv_sec = (time_t) t;
+	ts.tv_nsec = (long) ((t - ts.tv_sec) * 1e9);
+	while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR && !interrupted)
+		;
+}
+
 void sighandler (int sig)
 {
 	(void)sig;
@@ -204,12 +361,16 @@ int main (int argc, char * const argv[])
 {
 	struct dib_demod dib;
 	struct dib3000mb_monitoring mon;
+	struct dib_history hist;
 	const char *dev = NULL;
 	float intervall = 0.1;
+	float sample_ms = 0;
+	int history = 1000;
+	double next_sample, next_print, t;
 	dib3000m_output_t out = OUT_PRINT;
 	int c;
 
-	while ((c = getopt(argc,argv,"d:a:o:i:")) != -1) {
+	while ((c = getopt(argc,argv,"d:a:o:i:s:n:")) != -1) {
 		switch (c) {
 			case 'd':
 				dev = optarg;
@@ -225,13 +386,21 @@ int main (int argc, char * const argv[])
 			case 'i':
 				intervall = atof(optarg);
 				break;
+			case 's':
+				sample_ms = atof(optarg);
+				break;
+			case 'n':
+				history = atoi(optarg);
+				break;
 			default:
 				usage();
 		}
 	}
 
-	if (dev == NULL)
+	if (dev == NULL || history < 1 || sample_ms < 0)
 		usage();
+	if (sample_ms == 0 || sample_ms > intervall * 1000)
+		sample_ms = intervall * 1000;
 
 	interrupted = 0;
 	signal(SIGINT, sighandler);
@@ -272,22 +441,47 @@ int main (int argc, char * const argv[])
 			err("unsupported demodulator found.\n");
 	}
 
+	if (dib.rev != DIB3000MB) {
+		err("no monitoring writting for this demod, yet.\n");
+		exit(1);
+	}
+
+	memset(&mon,0,sizeof(mon));
+	if (dib_history_init(&hist,history,sample_ms / 1000.0) < 0) {
+		err("could not allocate the history\n");
+		exit(1);
+	}
+
+	/* sample on a fixed grid (not sleep after each), redraw every intervall */
+	next_sample = next_print = dib_now();
 	while (!interrupted) {
-		switch (dib.rev) {
-			case DIB3000MB:
-				dib3000mb_monitoring(&dib,&mon);
-				if (out == OUT_PRINT) {
-					printf("\E[H\E[2J");
-					dib3000mb_print_monitoring(&mon);
-				} else if (out == OUT_CSV) {
-					printf("no csv output implemented yet.\n");
-				}
-				break;
-			default:
-				interrupted=1;
-				err("no monitoring writting for this demod, yet.\n");
+		t = dib_now();
+		if (dib3000mb_monitoring(&dib,&mon) == 0) {
+			dib_history_add(&hist,&mon);
+			if (dib_now() - t > hist.worst_read)
+				hist.worst_read = dib_now() - t;
+		}
+
+		if (t >= next_print) {
+			if (out == OUT_PRINT) {
+				printf("\E[H\E[2J");
+				dib3000mb_print_monitoring(&mon);
+				dib_history_print(&hist);
+			} else if (out == OUT_CSV) {
+				printf("no csv output implemented yet.\n");
+			}
+			fflush(stdout);
+			next_print += intervall;
+			if (next_print < t)
+				next_print = t + intervall;
+		}
+
+		next_sample += hist.period;
+		if (next_sample < dib_now()) {
+			hist.late++;
+			next_sample = dib_now();
 		}
-		usleep((int) (intervall * 1000000));
+		dib_sleep_until(next_sample);
 	}
 
 	close(dib.fd);
@@ -43,4 +43,17 @@ struct dib3000mb_monitoring {
 	double timing_offset_ppm;
 };
 
+/* the last samples taken, oldest first from head - count */
+struct dib_history {
+	int size;
+	int head;
+	int count;
+	struct dib3000mb_monitoring *samples;
+
+	double period;           /* seconds between samples */
+	double worst_read;       /* slowest register read, seconds */
+	unsigned long late;      /* samples taken late, since start */
+	unsigned long lock_drops; /* TS data lock went away, since start */
+};
+
 #endif
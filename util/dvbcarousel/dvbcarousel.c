@@ -0,0 +1,473 @@
+/*
+	dvbcarousel utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <libucsi/transport_packet.h>
+#include <libdvbtsgen/dvbcarousel.h>
+
+#define MAX_TABLES 4096
+#define CHUNK_PACKETS (TRANSPORT_BATCH_MAX * 4)
+#define UDP_PACKETS 7				/* per datagram */
+
+struct table {
+	const char *path;
+	uint16_t pid;
+	int interval;
+};
+
+static struct table tables[MAX_TABLES];
+static int table_count = 0;
+static volatile sig_atomic_t quit = 0;
+static volatile sig_atomic_t reload = 0;
+
+static void usage(FILE *output)
+{
+	fprintf(output,
+		"Usage: dvbcarousel [OPTION]... PID:MS:FILE...\n"
+		"Play out PSI/SI tables, each FILE of encoded sections sent on PID every MS ms.\n"
+		"The files are read again on SIGHUP; changed ones go out as new versions.\n"
+		"Options:\n"
+		"	-o FILE	 write to FILE, a FIFO or - for stdout (default)\n"
+		"	-u HOST:PORT\n"
+		"		 send over UDP, %i packets a datagram\n"
+		"	-a N[:D] write into the DVR D (default 0) of dvb adapter N\n"
+		"	-i FILE	 put the tables into the null packets of the stream in FILE\n"
+		"		 (- for stdin) instead of generating one\n"
+		"	-b RATE	 stream rate in bits/s, k/M/G suffixes allowed (default 38M)\n"
+		"	-t SECS	 length of the stream (default 10, 0 => until interrupted)\n"
+		"	-R	 pace the output at the stream rate instead of as fast as possible\n"
+		"	-q	 do not print statistics at the end\n"
+		"	-h	 display this help\n", UDP_PACKETS);
+}
+
+static void signal_handler(int sig)
+{
+	if (sig == SIGHUP)
+		reload = 1;
+	else
+		quit = 1;
+}
+
+static uint64_t parse_rate(const char *str)
+{
+	char *end;
+	double rate = strtod(str, &end);
+
+	switch(*end) {
+	case 'k':
+	case 'K':
+		rate *= 1e3;
+		break;
+	case 'm':
+	case 'M':
+		rate *= 1e6;
+		break;
+	case 'g':
+	case 'G':
+		rate *= 1e9;
+		break;
+	case 0:
+		break;
+	default:
+		return 0;
+	}
+	return (rate > 0) ? (uint64_t) rate : 0;
+}
+
+static int parse_table(struct table *t, char *spec)
+{
+	unsigned int pid;
+	int interval, pos = 0;
+
+	if ((sscanf(spec, "%i:%i:%n", &pid, &interval, &pos) < 2) || (pos == 0) ||
+	    (pid >= TRANSPORT_NULL_PID) || (interval <= 0) || (spec[pos] == 0))
+		return -1;
+	t->pid = pid;
+	t->interval = interval;
+	t->path = spec + pos;
+	return 0;
+}
+
+static uint8_t *read_file(const char *path, int *len)
+{
+	struct stat st;
+	uint8_t *data = NULL;
+	ssize_t got;
+	int fd, pos = 0;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return NULL;
+	if (fstat(fd, &st) || (st.st_size <= 0) || (st.st_size > INT_MAX) ||
+	    ((data = malloc(st.st_size)) == NULL))
+		goto error;
+	while (pos < st.st_size) {
+		if ((got = read(fd, data + pos, st.st_size - pos)) < 0) {
+			if (errno == EINTR)
+				continue;
+			goto error;
+		}
+		if (got == 0)
+			break;
+		pos += got;
+	}
+	close(fd);
+	*len = pos;
+	return data;
+
+error:
+	free(data);
+	close(fd);
+	return NULL;
+}
+
+static int load_tables(struct dvbcarousel *c)
+{
+	uint8_t *data;
+	int len, i;
+	int errors = 0;
+
+	for(i = 0; i < table_count; i++) {
+		if ((data = read_file(tables[i].path, &len)) == NULL) {
+			fprintf(stderr, "dvbcarousel: Could not read %s: %m\n", tables[i].path);
+			errors++;
+			continue;
+		}
+		if (dvbcarousel_set_table(c, i, tables[i].pid, data, len, tables[i].interval)) {
+			fprintf(stderr, "dvbcarousel: %s: %s\n", tables[i].path,
+				(errno == EINVAL) ? "not a run of sections" : strerror(errno));
+			errors++;
+		}
+		free(data);
+	}
+	return errors;
+}
+
+static int open_udp(const char *dest)
+{
+	struct addrinfo hints, *res, *ai;
+	char host[256];
+	const char *port;
+	int fd = -1;
+
+	/* the port follows the last colon, so [v6]:port and v4:port both work */
+	if (((port = strrchr(dest, ':')) == NULL) || ((port - dest) >= (int) sizeof(host))) {
+		fprintf(stderr, "dvbcarousel: Bad UDP destination %s\n", dest);
+		return -1;
+	}
+	if ((dest[0] == '[') && (port[-1] == ']'))
+		snprintf(host, sizeof(host), "%.*s", (int) (port - dest) - 2, dest + 1);
+	else
+		snprintf(host, sizeof(host), "%.*s", (int) (port - dest), dest);
+	port++;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, port, &hints, &res)) {
+		fprintf(stderr, "dvbcarousel: Could not resolve %s\n", dest);
+		return -1;
+	}
+	for(ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+			continue;
+		if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if (fd < 0)
+		fprintf(stderr, "dvbcarousel: Could not open %s: %m\n", dest);
+	return fd;
+}
+
+static int open_output(const char *output, const char *udp, int adapter, int dvr)
+{
+	char name[PATH_MAX];
+	int fd;
+
+	if (udp)
+		return open_udp(udp);
+
+	if (adapter >= 0) {
+		/* the DVR only accepts data when opened write-only */
+		snprintf(name, sizeof(name), "/dev/dvb/adapter%i/dvr%i", adapter, dvr);
+		if ((fd = open(name, O_WRONLY)) < 0) {
+			snprintf(name, sizeof(name), "/dev/dvb%i.dvr%i", adapter, dvr);
+			fd = open(name, O_WRONLY);
+		}
+	} else if (strcmp(output, "-") == 0) {
+		snprintf(name, sizeof(name), "stdout");
+		fd = STDOUT_FILENO;
+	} else {
+		snprintf(name, sizeof(name), "%s", output);
+		fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	if (fd < 0)
+		fprintf(stderr, "dvbcarousel: Could not open %s: %m\n", name);
+	return fd;
+}
+
+static int write_all(int fd, uint8_t *buf, size_t len, int datagrams)
+{
+	size_t chunk = datagrams ? (UDP_PACKETS * TRANSPORT_PACKET_LENGTH) : len;
+	ssize_t written;
+
+	while (len) {
+		if ((written = write(fd, buf, (len < chunk) ? len : chunk)) < 0) {
+			if (errno == EINTR)
+				continue;
+			/* nobody listening (yet) is not fatal for UDP */
+			if (datagrams && (errno == ECONNREFUSED))
+				written = (len < chunk) ? len : chunk;
+			else {
+				if (errno != EPIPE)
+					fprintf(stderr, "dvbcarousel: write failed: %m\n");
+				return -1;
+			}
+		}
+		buf += written;
+		len -= written;
+	}
+	return 0;
+}
+
+static int read_packets(int fd, uint8_t *buf, int count)
+{
+	size_t len = (size_t) count * TRANSPORT_PACKET_LENGTH;
+	size_t pos = 0;
+	ssize_t got;
+
+	while (pos < len) {
+		if ((got = read(fd, buf + pos, len - pos)) < 0) {
+			if (errno == EINTR) {
+				if (quit)
+					break;
+				continue;
+			}
+			fprintf(stderr, "dvbcarousel: read failed: %m\n");
+			return -1;
+		}
+		if (got == 0)
+			break;
+		pos += got;
+	}
+	return pos / TRANSPORT_PACKET_LENGTH;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void pace(uint64_t start, uint64_t packets, uint64_t bitrate)
+{
+	uint64_t due = start + (uint64_t) ((double) packets * TRANSPORT_PACKET_LENGTH * 8 *
+					   1e9 / bitrate);
+	struct timespec ts;
+
+	ts.tv_sec = due / 1000000000ULL;
+	ts.tv_nsec = due % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+		if (quit)
+			break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct dvbcarousel *c;
+	struct dvbcarousel_stats stats;
+	struct sigaction sa;
+	const char *output = "-";
+	const char *udp = NULL;
+	const char *input = NULL;
+	uint64_t bitrate = 38000000;
+	uint64_t limit, start, elapsed;
+	int adapter = -1, dvr = 0;
+	int seconds = 10;
+	int realtime = 0, quiet = 0;
+	int in_fd = -1, out_fd;
+	uint8_t *buf;
+	int count;
+	int opt, i;
+
+	while((opt = getopt(argc, argv, "o:u:a:i:b:t:Rqh")) != -1) {
+		switch(opt) {
+		case 'o':
+			output = optarg;
+			break;
+		case 'u':
+			udp = optarg;
+			break;
+		case 'a':
+			if (sscanf(optarg, "%i:%i", &adapter, &dvr) < 1) {
+				fprintf(stderr, "dvbcarousel: Bad adapter %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'i':
+			input = optarg;
+			break;
+		case 'b':
+			if ((bitrate = parse_rate(optarg)) == 0) {
+				fprintf(stderr, "dvbcarousel: Bad rate %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'R':
+			realtime = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+			usage(stdout);
+			exit(0);
+		default:
+			usage(stderr);
+			exit(1);
+		}
+	}
+	if ((optind == argc) || ((argc - optind) > MAX_TABLES) || (seconds < 0)) {
+		usage(stderr);
+		exit(1);
+	}
+	for(i = optind; i < argc; i++) {
+		if (parse_table(tables + table_count++, argv[i])) {
+			fprintf(stderr, "dvbcarousel: Bad table %s\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	if ((c = dvbcarousel_create(bitrate)) == NULL) {
+		fprintf(stderr, "dvbcarousel: Could not create carousel: %m\n");
+		exit(1);
+	}
+	if (load_tables(c))
+		exit(1);
+	dvbcarousel_get_stats(c, &stats);
+	if (stats.required > bitrate) {
+		fprintf(stderr, "dvbcarousel: The tables need %llu bits/s, more than the stream rate\n",
+			(unsigned long long) stats.required);
+		exit(1);
+	}
+
+	if (input) {
+		if (strcmp(input, "-") == 0)
+			in_fd = STDIN_FILENO;
+		else if ((in_fd = open(input, O_RDONLY)) < 0) {
+			fprintf(stderr, "dvbcarousel: Could not open %s: %m\n", input);
+			exit(1);
+		}
+	}
+	if ((out_fd = open_output(output, udp, adapter, dvr)) < 0)
+		exit(1);
+	if ((buf = malloc(CHUNK_PACKETS * TRANSPORT_PACKET_LENGTH)) == NULL) {
+		fprintf(stderr, "dvbcarousel: Out of memory\n");
+		exit(1);
+	}
+
+	/* no SA_RESTART: a SIGHUP should not wait for a blocked read */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	limit = ((uint64_t) seconds * bitrate) / (TRANSPORT_PACKET_LENGTH * 8);
+	start = now_ns();
+	while (!quit) {
+		if (reload) {
+			reload = 0;
+			load_tables(c);
+		}
+
+		count = CHUNK_PACKETS;
+		dvbcarousel_get_stats(c, &stats);
+		if (seconds) {
+			if ((limit - stats.packets) < (uint64_t) count)
+				count = limit - stats.packets;
+			if (count == 0)
+				break;
+		}
+
+		if (in_fd >= 0) {
+			if ((count = read_packets(in_fd, buf, count)) <= 0)
+				break;
+			dvbcarousel_insert(c, buf, count);
+		} else {
+			dvbcarousel_generate(c, buf, count);
+		}
+		if (write_all(out_fd, buf, count * TRANSPORT_PACKET_LENGTH, udp != NULL))
+			break;
+		if (realtime) {
+			dvbcarousel_get_stats(c, &stats);
+			pace(start, stats.packets, bitrate);
+		}
+	}
+	elapsed = now_ns() - start;
+
+	if (!quiet) {
+		dvbcarousel_get_stats(c, &stats);
+		fprintf(stderr, "%llu packets, %llu of tables, %llu null; %llu repetitions, "
+			"%llu overruns, %llu new versions, longest wait %llu us\n",
+			(unsigned long long) stats.packets,
+			(unsigned long long) stats.table_packets,
+			(unsigned long long) stats.null_packets,
+			(unsigned long long) stats.repetitions,
+			(unsigned long long) stats.overruns,
+			(unsigned long long) stats.versions,
+			(unsigned long long) stats.max_delay_us);
+		if (elapsed)
+			fprintf(stderr, "%llu packets in %.3fs: %.1f Mbit/s\n",
+				(unsigned long long) stats.packets, elapsed / 1e9,
+				((double) stats.packets * TRANSPORT_PACKET_LENGTH * 8 * 1000) / elapsed);
+	}
+
+	if (out_fd != STDOUT_FILENO)
+		close(out_fd);
+	if ((in_fd >= 0) && (in_fd != STDIN_FILENO))
+		close(in_fd);
+	dvbcarousel_destroy(c);
+	free(buf);
+	return 0;
+}
@@ -40,22 +40,34 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/poll.h>
+#include <sys/time.h>
+#include <time.h>
 #include <errno.h>
 #include <getopt.h>
 #include <stdarg.h>
 #include <libdvbapi/dvbfe.h>
+#include <libdvbapi/dvbtopo.h>
+#include <libdvbapi/dvbremote.h>
 #include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbsistore.h>
 #include <libucsi/dvb/section.h>
 #include <libucsi/atsc/section.h>
 
 /* How many seconds can the system clock be out before we get warned? */
 #define ALLOWABLE_DELTA 30*60
 
+/* Largest offset (in seconds) --slew corrects without stepping the clock */
+#define MAX_SLEW 0.5
+
 char *ProgName;
 int do_print;
 int do_set;
 int do_force;
 int do_quiet;
+int do_multi;
+int do_slew;
+int do_store;
+int samples = 1;
 int timeout = 25;
 int adapter = 0;
 
@@ -71,7 +83,7 @@ void errmsg(char *message, ...)
 
 void usage(void)
 {
-	fprintf(stderr, "usage: %s [-a] [-p] [-s] [-f] [-q] [-h]\n", ProgName);
+	fprintf(stderr, "usage: %s [-a] [-p] [-s] [-f] [-q] [-m] [-n n] [-S] [-d] [-h]\n", ProgName);
 	_exit(1);
 }
 
@@ -79,12 +91,19 @@ void help(void)
 {
 	fprintf(stderr,
 		"\nhelp:\n"
-		"%s [-a] [-p] [-s] [-f] [-q] [-h] [-t n]\n"
+		"%s [-a] [-p] [-s] [-f] [-q] [-m] [-n n] [-S] [-d] [-h] [-t n]\n"
 		"  --adapter	(adapter to use, default: 0)\n"
 		"  --print	(print current time, received time and delta)\n"
 		"  --set	(set the system clock to received time)\n"
 		"  --force	(force the setting of the clock)\n"
 		"  --quiet	(be silent)\n"
+		"  --multi	(take whichever of the TDT, TOT and STT arrives first,\n"
+		"		 and measure the offset to a fraction of a second)\n"
+		"  --samples n	(with --multi, narrow the offset down over n sections, default: 1)\n"
+		"  --slew	(with --multi, slew rather than step the clock if it is\n"
+		"		 less than half a second out)\n"
+		"  --store	(take the TDT from the dvbsid daemon of the adapter\n"
+		"		 rather than opening a section filter)\n"
 		"  --help	(display this message)\n"
 		"  --timeout n	(max seconds to wait, default: 25)\n", ProgName);
 	_exit(1);
@@ -100,13 +119,17 @@ int do_options(int arg_count, char **arg_strings)
 		{"help", 0, 0, 'h'},
 		{"timeout", 1, 0, 't'},
 		{"adapter", 1, 0, 'a'},
+		{"multi", 0, 0, 'm'},
+		{"samples", 1, 0, 'n'},
+		{"slew", 0, 0, 'S'},
+		{"store", 0, 0, 'd'},
 		{0, 0, 0, 0}
 	};
 	int c;
 	int Option_Index = 0;
 
 	while (1) {
-		c = getopt_long(arg_count, arg_strings, "a:psfqht:", Long_Options, &Option_Index);
+		c = getopt_long(arg_count, arg_strings, "a:psfqht:mn:Sd", Long_Options, &Option_Index);
 		if (c == EOF)
 			break;
 		switch (c) {
@@ -120,6 +143,22 @@ int do_options(int arg_count, char **arg_strings)
 		case 'a':
 			adapter = atoi(optarg);
 			break;
+		case 'm':
+			do_multi = 1;
+			break;
+		case 'n':
+			samples = atoi(optarg);
+			if (samples <= 0) {
+				fprintf(stderr, "%s: invalid sample count\n", ProgName);
+				usage();
+			}
+			break;
+		case 'S':
+			do_slew = 1;
+			break;
+		case 'd':
+			do_store = 1;
+			break;
 		case 'p':
 			do_print = 1;
 			break;
@@ -153,6 +192,10 @@ int do_options(int arg_count, char **arg_strings)
 			case 4:	/* Help */
 			case 5:	/* timeout */
 			case 6:	/* adapter */
+			case 7:	/* multi */
+			case 8:	/* samples */
+			case 9:	/* slew */
+			case 10: /* store */
 				break;
 			default:
 				fprintf(stderr, "%s: unknown long option %d\n", ProgName, Option_Index);
@@ -232,6 +275,58 @@ int dvb_scan_date(time_t *rx_time, unsigned int to)
 }
 
 
+/*
+ * Get the next UTC date from the TDT published by dvbsid
+ */
+int store_scan_date(time_t *rx_time, unsigned int to)
+{
+	struct dvbsistore *store;
+	struct dvbsistore_info info;
+	unsigned char sibuf[4096];
+	uint64_t serial = 0;
+	time_t end = time(NULL) + to;
+	int size;
+
+	if ((store = dvbsistore_attach(adapter, 0, DVBSISTORE_MASK(DVBSISTORE_TDT))) == NULL)
+		return -1;
+
+	// the TDT already there is however old it is: wait for the next
+	if (dvbsistore_find(store, TRANSPORT_TDT_PID, stag_dvb_time_date, 0, &info) == 0)
+		serial = info.serial;
+
+	while (time(NULL) < end) {
+		struct pollfd pollfd;
+
+		pollfd.fd = dvbsistore_fd(store);
+		pollfd.events = POLLIN;
+		if (poll(&pollfd, 1, (end - time(NULL)) * 1000) != 1)
+			break;
+		dvbsistore_ack(store);
+		if (!dvbsistore_next(store, &serial, DVBSISTORE_MASK(DVBSISTORE_TDT), &info))
+			continue;
+
+		size = dvbsistore_read(store, TRANSPORT_TDT_PID, stag_dvb_time_date, 0, 0,
+				       sibuf, sizeof(sibuf), NULL);
+		if (size < 0)
+			continue;
+
+		struct section *section = section_codec(sibuf, size);
+		if (section == NULL)
+			continue;
+		struct dvb_tdt_section *tdt = dvb_tdt_section_codec(section);
+		if (tdt == NULL)
+			continue;
+
+		*rx_time = dvbdate_to_unixtime(tdt->utc_time);
+		dvbsistore_detach(store);
+		return 0;
+	}
+
+	dvbsistore_detach(store);
+	return -1;
+}
+
+
 /*
  * Get the next date packet from the STT section
  */
@@ -304,12 +399,215 @@ int atsc_scan_date(time_t *rx_time, unsigned int to)
 }
 
 
+/*
+ * Seconds on the given clock
+ */
+static double clock_now(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/*
+ * Open a section filter on one of the time table PIDs
+ */
+static int open_time_filter(int pid, uint8_t table_id, uint8_t table_mask)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+	int fd;
+
+	if ((fd = dvbdemux_open_demux(adapter, 0, 0)) < 0)
+		return -1;
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = table_id;
+	mask[0] = table_mask;
+	if (dvbdemux_set_section_filter(fd, pid, filter, mask, 1, 1)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * Get the UTC time out of a TDT, TOT or STT
+ */
+static int decode_time_section(unsigned char *sibuf, int size, time_t *utc)
+{
+	struct section *section = section_codec(sibuf, size);
+	if (section == NULL)
+		return -1;
+
+	switch(section->table_id) {
+	case stag_dvb_time_date:
+	{
+		struct dvb_tdt_section *tdt = dvb_tdt_section_codec(section);
+		if (tdt == NULL)
+			return -1;
+		*utc = dvbdate_to_unixtime(tdt->utc_time);
+		return 0;
+	}
+
+	case stag_dvb_time_offset:
+	{
+		struct dvb_tot_section *tot = dvb_tot_section_codec(section);
+		if (tot == NULL)
+			return -1;
+		*utc = dvbdate_to_unixtime(tot->utc_time);
+		return 0;
+	}
+
+	case stag_atsc_system_time:
+	{
+		struct section_ext *section_ext = section_ext_decode(section, 0);
+		if (section_ext == NULL)
+			return -1;
+		struct atsc_section_psip *psip = atsc_section_psip_decode(section_ext);
+		if (psip == NULL)
+			return -1;
+		struct atsc_stt_section *stt = atsc_stt_section_codec(psip);
+		if (stt == NULL)
+			return -1;
+
+		// the STT counts GPS seconds, which include leap seconds
+		*utc = atsctime_to_unixtime(stt->system_time) - stt->gps_utc_offset;
+		return 0;
+	}
+	}
+
+	return -1;
+}
+
+/*
+ * Measure how far the system clock is behind the multiplex, from whichever
+ * of the TDT, TOT (PID 0x14) and STT (PID 0x1ffb) the multiplex carries.
+ *
+ * The tables hold whole seconds, so a section stamped utc that arrives at
+ * system time t bounds the offset to [utc - t, utc + 1 - t). Every further
+ * sample narrows that down; the result is the middle of what is left, and
+ * error is half its width. Arrivals are stamped on the monotonic clock as
+ * poll() returns, so nothing else adjusting the clock meanwhile can skew
+ * the samples.
+ */
+int multi_scan_offset(double *offset, double *error, unsigned int to, int count)
+{
+	struct pollfd pollfds[2];
+	unsigned char sibuf[4096];
+	double mono_to_real;
+	double deadline;
+	double low = 0;
+	double high = 0;
+	int got = 0;
+	int i;
+
+	// open the DVB (TDT and TOT share 0x70-0x73) and ATSC filters
+	pollfds[0].fd = open_time_filter(TRANSPORT_TDT_PID, stag_dvb_time_date, 0xFC);
+	pollfds[1].fd = open_time_filter(ATSC_BASE_PID, stag_atsc_system_time, 0xFF);
+	if ((pollfds[0].fd < 0) && (pollfds[1].fd < 0))
+		return -1;
+	for (i = 0; i < 2; i++)
+		pollfds[i].events = POLLIN|POLLERR|POLLPRI;
+
+	mono_to_real = clock_now(CLOCK_REALTIME) - clock_now(CLOCK_MONOTONIC);
+	deadline = clock_now(CLOCK_MONOTONIC) + to;
+
+	while (got < count) {
+		double now = clock_now(CLOCK_MONOTONIC);
+		double arrival;
+		int ret;
+
+		if (now >= deadline)
+			break;
+		ret = poll(pollfds, 2, (int) ((deadline - now) * 1000) + 1);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		if (ret == 0)
+			break;
+		arrival = clock_now(CLOCK_MONOTONIC) + mono_to_real;
+
+		for (i = 0; i < 2; i++) {
+			time_t utc;
+			int size;
+
+			if ((pollfds[i].fd < 0) || !pollfds[i].revents)
+				continue;
+			if ((size = read(pollfds[i].fd, sibuf, sizeof(sibuf))) <= 0)
+				continue;
+			if (decode_time_section(sibuf, size, &utc))
+				continue;
+
+			if ((got == 0) || ((utc - arrival) > low))
+				low = utc - arrival;
+			if ((got == 0) || ((utc + 1 - arrival) < high))
+				high = utc + 1 - arrival;
+			got++;
+		}
+	}
+
+	for (i = 0; i < 2; i++)
+		if (pollfds[i].fd >= 0)
+			close(pollfds[i].fd);
+	if (got == 0)
+		return -1;
+
+	// transmission delay only ever makes a section late: trust the lower bound
+	if (high < low)
+		high = low;
+	*offset = (low + high) / 2;
+	*error = (high - low) / 2;
+	return 0;
+}
+
 /*
  * Set the system time
  */
 int set_time(time_t * new_time)
 {
-	if (stime(new_time)) {
+	struct timespec ts;
+
+	ts.tv_sec = *new_time;
+	ts.tv_nsec = 0;
+	if (clock_settime(CLOCK_REALTIME, &ts)) {
+		perror("Unable to set time");
+		return -1;
+	}
+	return 0;
+}
+
+
+/*
+ * Move the system clock on by delta seconds: slewed if that was asked for
+ * and it is close enough, stepped otherwise
+ */
+int adjust_time(double delta)
+{
+	if (do_slew && (delta > -MAX_SLEW) && (delta < MAX_SLEW)) {
+		long long usec = (long long) ((delta * 1e6) + ((delta < 0) ? -0.5 : 0.5));
+		struct timeval tv;
+
+		tv.tv_sec = usec / 1000000;
+		tv.tv_usec = usec % 1000000;
+		if (adjtime(&tv, NULL)) {
+			perror("Unable to slew time");
+			return -1;
+		}
+		return 0;
+	}
+
+	double target = clock_now(CLOCK_REALTIME) + delta;
+	struct timespec ts;
+
+	ts.tv_sec = (time_t) target;
+	ts.tv_nsec = (long) ((target - ts.tv_sec) * 1e9);
+	if (clock_settime(CLOCK_REALTIME, &ts)) {
 		perror("Unable to set time");
 		return -1;
 	}
@@ -317,14 +615,82 @@ int set_time(time_t * new_time)
 }
 
 
+/*
+ * --multi: measure the offset from any of the time tables, and correct it
+ */
+int multi_date(void)
+{
+	double offset;
+	double error;
+	time_t real_time;
+	time_t rx_time;
+
+	if (multi_scan_offset(&offset, &error, timeout, samples)) {
+		errmsg("Unable to get time from multiplex.\n");
+		return 1;
+	}
+	time(&real_time);
+	rx_time = real_time + (time_t) (offset + ((offset < 0) ? -0.5 : 0.5));
+
+	if (do_print) {
+		fprintf(stdout, "System time: %s", ctime(&real_time));
+		fprintf(stdout, "    RX time: %s", ctime(&rx_time));
+		fprintf(stdout, "     Offset: %.3f +/- %.3f seconds\n", offset, error);
+	} else if (!do_quiet) {
+		fprintf(stdout, "%s", ctime(&rx_time));
+	}
+	if (do_set) {
+		if (((offset > ALLOWABLE_DELTA) || (offset < -ALLOWABLE_DELTA)) && !do_force) {
+			errmsg("multiplex time differs by more than %d from system.\n", ALLOWABLE_DELTA);
+			errmsg("use -f to force system clock to new time.\n");
+			return 1;
+		}
+		if (adjust_time(offset)) {
+			errmsg("setting the time failed\n");
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * The frontend type, from the lsdvb cache if there is one, so the frontend
+ * need not be opened (a remote one always is, since it is not cached).
+ */
+static enum dvbfe_type frontend_type(void)
+{
+	struct dvbtopo *topo;
+	const struct dvbtopo_frontend *topo_fe;
+	struct dvbfe_handle *fe;
+	struct dvbfe_info fe_info;
+
+	if (!dvbremote_lookup(adapter, NULL) &&
+	    ((topo = dvbtopo_open(DVBTOPO_CACHE_ONLY)) != NULL)) {
+		topo_fe = dvbtopo_find_frontend(topo, adapter, 0);
+		if (topo_fe != NULL) {
+			fe_info.type = topo_fe->type;
+			dvbtopo_close(topo);
+			return fe_info.type;
+		}
+		dvbtopo_close(topo);
+	}
+
+	if ((fe = dvbfe_open(adapter, 0, 1)) == NULL) {
+		errmsg("Unable to open frontend.\n");
+		exit(1);
+	}
+	dvbfe_get_info(fe, 0, &fe_info, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+	dvbfe_close(fe);
+	return fe_info.type;
+}
+
+
 int main(int argc, char **argv)
 {
 	time_t rx_time;
 	time_t real_time;
 	time_t offset;
 	int ret;
-	struct dvbfe_handle *fe;
-	struct dvbfe_info fe_info;
 
 	do_print = 0;
 	do_force = 0;
@@ -340,24 +706,20 @@ int main(int argc, char **argv)
 		errmsg("quiet and print options are mutually exclusive.\n");
 		exit(1);
 	}
-
-/*
- * Find the frontend type
- */
-	if ((fe = dvbfe_open(adapter, 0, 1)) == NULL) {
-		errmsg("Unable to open frontend.\n");
-		exit(1);
-	}
-	dvbfe_get_info(fe, 0, &fe_info, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+	if (do_multi)
+		return multi_date();
 
 /*
  * Get the date from the currently tuned multiplex
  */
-	switch(fe_info.type) {
+	switch(frontend_type()) {
 	case DVBFE_TYPE_DVBS:
 	case DVBFE_TYPE_DVBC:
 	case DVBFE_TYPE_DVBT:
-		ret = dvb_scan_date(&rx_time, timeout);
+		if (do_store)
+			ret = store_scan_date(&rx_time, timeout);
+		else
+			ret = dvb_scan_date(&rx_time, timeout);
 		break;
 
 	case DVBFE_TYPE_ATSC:
@@ -0,0 +1,221 @@
+/*
+	dvbfepoold utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <libdvbapi/dvbfepool.h>
+#include <libdvbapi/dvbtopo.h>
+
+#define MAX_POLLFDS		(DVBFEPOOL_MAX_CLIENTS + 1)
+#define RETRY_MS		5000
+
+/**
+ * A frontend to keep warm.
+ */
+struct wanted {
+	int adapter;
+	int frontend;
+	int held;
+};
+
+static struct wanted wanted[DVBFEPOOL_MAX_FRONTENDS];
+static int wanted_count;
+static int verbose;
+static volatile int stop;
+
+static void usage(void)
+{
+	static const char *_usage =
+		"\n"
+		" dvbfepoold: Keep frontends open so that programs tune them warm\n"
+		"\n"
+		" usage: dvbfepoold <options>\n"
+		" -a <adapter>[.<frontend>]	Frontend to keep (may be repeated; default\n"
+		"				every frontend of every adapter)\n"
+		" -v				Report each frontend once it is held\n"
+		"\n"
+		" Opening a frontend from cold can load the driver's firmware and power up\n"
+		" the tuner, which takes up to seconds. Each frontend is opened read-write\n"
+		" and held, and programs opening it through libdvbapi are handed the open\n"
+		" fd over " DVBFEPOOL_SOCKET " instead (see libdvbapi/dvbfepool.h); it\n"
+		" is taken back when they exit. A frontend another program has open\n"
+		" read-write is tried again every few seconds.\n";
+	fprintf(stderr, "%s\n", _usage);
+
+	exit(1);
+}
+
+static void signal_handler(int _signal)
+{
+	(void) _signal;
+
+	stop = 1;
+}
+
+static void want(int adapter, int frontend)
+{
+	int i;
+
+	for (i = 0; i < wanted_count; i++) {
+		if ((wanted[i].adapter == adapter) && (wanted[i].frontend == frontend))
+			return;
+	}
+	if (wanted_count == DVBFEPOOL_MAX_FRONTENDS) {
+		fprintf(stderr, "Too many frontends, adapter %i frontend %i left out\n",
+			adapter, frontend);
+		return;
+	}
+	wanted[wanted_count].adapter = adapter;
+	wanted[wanted_count].frontend = frontend;
+	wanted[wanted_count++].held = 0;
+}
+
+static void want_all(int adapter)
+{
+	const struct dvbtopo_adapter *a;
+	struct dvbtopo *topo;
+	int i, j;
+
+	if ((topo = dvbtopo_open(0)) == NULL) {
+		fprintf(stderr, "Failed to find the adapters: %m\n");
+		exit(1);
+	}
+	for (i = 0; i < dvbtopo_adapter_count(topo); i++) {
+		a = dvbtopo_adapter(topo, i);
+		if ((adapter != -1) && (a->id != adapter))
+			continue;
+		for (j = 0; j < a->frontend_count; j++)
+			want(a->id, a->frontends[j].id);
+	}
+	dvbtopo_close(topo);
+}
+
+/**
+ * Open whatever isn't held yet.
+ *
+ * @return Number of frontends still not held.
+ */
+static int hold(struct dvbfepool *pool, int report)
+{
+	int missing = 0;
+	int i;
+
+	for (i = 0; i < wanted_count; i++) {
+		if (wanted[i].held)
+			continue;
+		if (dvbfepool_add(pool, wanted[i].adapter, wanted[i].frontend)) {
+			if (report)
+				fprintf(stderr, "Adapter %i frontend %i not held: %m\n",
+					wanted[i].adapter, wanted[i].frontend);
+			missing++;
+			continue;
+		}
+		wanted[i].held = 1;
+		if (verbose)
+			fprintf(stderr, "Holding adapter %i frontend %i\n",
+				wanted[i].adapter, wanted[i].frontend);
+	}
+	return missing;
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd pollfds[MAX_POLLFDS];
+	struct dvbfepool *pool;
+	int argpos = 1;
+	int all = 1;
+	int missing;
+
+	while(argpos != argc) {
+		if (!strcmp(argv[argpos], "-h")) {
+			usage();
+		} else if (!strcmp(argv[argpos], "-a")) {
+			int adapter, frontend;
+
+			if ((argc - argpos) < 2)
+				usage();
+			switch(sscanf(argv[argpos+1], "%i.%i", &adapter, &frontend)) {
+			case 2:
+				want(adapter, frontend);
+				break;
+			case 1:
+				want_all(adapter);
+				break;
+			default:
+				usage();
+			}
+			all = 0;
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-v")) {
+			verbose = 1;
+			argpos++;
+		} else {
+			usage();
+		}
+	}
+	if (all)
+		want_all(-1);
+	if (wanted_count == 0) {
+		fprintf(stderr, "No frontends to keep\n");
+		exit(1);
+	}
+
+	if ((pool = dvbfepool_create()) == NULL) {
+		fprintf(stderr, "Failed to listen on the socket: %m\n");
+		exit(1);
+	}
+	missing = hold(pool, 1);
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	while(!stop) {
+		int count = dvbfepool_get_pollfds(pool, pollfds, MAX_POLLFDS);
+		int result;
+		int j;
+
+		if ((result = poll(pollfds, count, missing ? RETRY_MS : -1)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "poll failed: %m\n");
+			break;
+		}
+		if (result == 0) {
+			missing = hold(pool, 0);
+			continue;
+		}
+
+		for (j = 0; j < count; j++) {
+			if (!pollfds[j].revents)
+				continue;
+			dvbfepool_process(pool, pollfds[j].fd);
+		}
+	}
+
+	dvbfepool_destroy(pool);
+	return 0;
+}
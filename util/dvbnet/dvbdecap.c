@@ -0,0 +1,576 @@
+/*
+ * dvbdecap.c
+ *
+ * Userspace MPE/ULE decapsulator: IP over DVB from a TS tap to a tun device.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ * Or, point your browser to http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <linux/virtio_net.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libucsi/crc32.h>
+#include <libucsi/section.h>
+#include <libucsi/section_reasm.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/dvb/mpe_fec_frame.h>
+
+#define OK    0
+#define FAIL -1
+
+#define MAX_PIDS 32
+#define READ_SIZE (TRANSPORT_PACKET_LENGTH * 348)
+#define DVR_BUFFER_SIZE (TRANSPORT_PACKET_LENGTH * 8192)
+#define ULE_MAX_SNDU (4 + 0x7fff)
+
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_IPV6 0x86dd
+
+
+struct decap_pid {
+	int pid;
+	int ule;
+	struct mpe_fec_frame *fec;
+
+	/* ULE SNDU reassembly, RFC 4326 */
+	unsigned char cstate;
+	int synced;
+	int have;
+	int need;
+	uint8_t sndu[ULE_MAX_SNDU];
+
+	unsigned long packets;
+	unsigned long errors;
+};
+
+static int adapter = 0;
+static int demux = 0;
+static char *input_file;
+static char *tun_name = "dvb%d";
+static int vnet_hdr = 0;
+static int fec_rows = 0;
+
+static int tun_fd = -1;
+static int npids = 0;
+static struct decap_pid *pids[MAX_PIDS];
+static struct decap_pid *pid_map[TRANSPORT_MAX_PIDS];
+static unsigned long tun_errors;
+static volatile sig_atomic_t quit;
+
+static void usage(char *);
+static void parse_args(int, char **);
+
+
+static void sighandler(int sig)
+{
+	(void) sig;
+	quit = 1;
+}
+
+
+static int open_tun(char *name)
+{
+	struct ifreq ifr;
+	int fd, size;
+
+	if ((fd = open("/dev/net/tun", O_RDWR)) < 0) {
+		fprintf(stderr, "Error: couldn't open /dev/net/tun: %d %m\n", errno);
+		return -1;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+	if (vnet_hdr)
+		ifr.ifr_flags |= IFF_VNET_HDR;
+	strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+
+	if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+		fprintf(stderr, "Error: couldn't create tun device %s: %d %m\n", name, errno);
+		close(fd);
+		return -1;
+	}
+
+	if (vnet_hdr) {
+		size = sizeof(struct virtio_net_hdr);
+		if (ioctl(fd, TUNSETVNETHDRSZ, &size) < 0) {
+			fprintf(stderr, "Error: couldn't set vnet header size: %d %m\n", errno);
+			close(fd);
+			return -1;
+		}
+	}
+
+	printf("Status: writing IP packets to %s\n", ifr.ifr_name);
+	return fd;
+}
+
+
+/*
+ * Each write() to a tun device is one packet, so packets go out straight from
+ * the reassembly buffers, with the (empty) vnet header gathered in front.
+ */
+static void output_ip(struct decap_pid *p, uint8_t *ip, int len)
+{
+	static struct virtio_net_hdr hdr;
+	struct iovec iov[2];
+	int n = 0;
+
+	if (len < 20)
+		return;
+
+	if (vnet_hdr) {
+		iov[n].iov_base = &hdr;
+		iov[n++].iov_len = sizeof(hdr);
+	}
+	iov[n].iov_base = ip;
+	iov[n++].iov_len = len;
+
+	if (tun_fd >= 0 && writev(tun_fd, iov, n) < 0)
+		tun_errors++;
+	else
+		p->packets++;
+}
+
+
+static void fec_datagram(void *private, uint8_t *datagram, int len)
+{
+	output_ip((struct decap_pid *) private, datagram, len);
+}
+
+
+static void mpe_section(void *private, int pid, uint8_t *buf, int len)
+{
+	struct decap_pid *p = pid_map[pid];
+	struct section *section;
+	struct datagram_section *d;
+	struct mpe_fec_section *fec;
+	uint8_t *ip;
+	int iplen;
+
+	(void) private;
+
+	if ((section = section_codec(buf, len)) == NULL)
+		goto error;
+	if (section->syntax_indicator && section_check_crc(section))
+		goto error;
+
+	switch (section->table_id) {
+	case stag_mpeg_datagram:
+		if (len < (int) (sizeof(struct datagram_section) + CRC_SIZE))
+			goto error;
+		d = datagram_section_codec(section);
+		if (p->fec) {
+			if (mpe_fec_frame_add_datagram(p->fec, d))
+				goto error;
+			break;
+		}
+
+		ip = datagram_section_ip_data(d);
+		iplen = datagram_section_ip_data_length(d);
+		if (d->LLC_SNAP_flag) {
+			/* AA AA 03 00 00 00, then the ethertype */
+			if ((iplen < 8) || (((ip[6] << 8) | ip[7]) != ETHERTYPE_IPV4 &&
+					    ((ip[6] << 8) | ip[7]) != ETHERTYPE_IPV6))
+				break;
+			ip += 8;
+			iplen -= 8;
+		}
+		output_ip(p, ip, iplen);
+		break;
+
+	case stag_dvb_mpe_fec:
+		if (p->fec == NULL)
+			break;
+		if ((fec = mpe_fec_section_codec(section)) == NULL ||
+		    mpe_fec_frame_add_fec(p->fec, fec))
+			goto error;
+		break;
+	}
+	return;
+
+error:
+	p->errors++;
+}
+
+
+static void ule_sndu(struct decap_pid *p)
+{
+	int type = (p->sndu[2] << 8) | p->sndu[3];
+	int pos = 4;
+
+	if (crc32(CRC32_INIT, p->sndu, p->need)) {
+		p->errors++;
+		return;
+	}
+
+	/* D bit clear: a receiver destination NPA address follows */
+	if (!(p->sndu[0] & 0x80))
+		pos += 6;
+
+	if ((type == ETHERTYPE_IPV4) || (type == ETHERTYPE_IPV6))
+		output_ip(p, p->sndu + pos, p->need - pos - 4);
+}
+
+
+static void ule_bytes(struct decap_pid *p, uint8_t *buf, int len)
+{
+	int count;
+
+	while ((len > 0) && p->synced) {
+		if (p->have < 4) {
+			p->sndu[p->have++] = *buf++;
+			len--;
+
+			if (p->have == 2) {
+				/* End Indicator: the rest of the packet is padding */
+				if ((p->sndu[0] == 0xff) && (p->sndu[1] == 0xff)) {
+					p->synced = 0;
+					p->have = 0;
+					return;
+				}
+				p->need = 4 + (((p->sndu[0] & 0x7f) << 8) | p->sndu[1]);
+				if (p->need < 4 + 4 + ((p->sndu[0] & 0x80) ? 0 : 6)) {
+					p->errors++;
+					p->synced = 0;
+					p->have = 0;
+					return;
+				}
+			}
+			continue;
+		}
+
+		count = p->need - p->have;
+		if (count > len)
+			count = len;
+		memcpy(p->sndu + p->have, buf, count);
+		p->have += count;
+		buf += count;
+		len -= count;
+
+		if (p->have == p->need) {
+			ule_sndu(p);
+			p->have = 0;
+		}
+	}
+}
+
+
+static void ule_packet(struct decap_pid *p, uint8_t *pkt)
+{
+	struct transport_packet *tp = (struct transport_packet *) pkt;
+	struct transport_values tv;
+	unsigned char cstate = p->cstate;
+	int pp;
+
+	if (tp->transport_error_indicator ||
+	    transport_packet_values_extract(tp, &tv, 0) < 0)
+		goto error;
+
+	/* a duplicate packet carries nothing new */
+	if ((cstate & 0x80) && (tp->adaptation_field_control & 1) &&
+	    ((cstate & 0x0f) == tp->continuity_counter))
+		return;
+	if (transport_packet_continuity_check(tp, tv.flags & transport_adaptation_flag_discontinuity,
+					      &p->cstate)) {
+		p->cstate = 0;
+		goto error;
+	}
+
+	if ((tv.payload == NULL) || (tv.payload_length == 0))
+		return;
+
+	if (tp->payload_unit_start_indicator) {
+		pp = tv.payload[0];
+		if (pp + 1 > tv.payload_length)
+			goto error;
+
+		/* the bytes before the pointer end the current SNDU */
+		if (p->synced && p->have) {
+			ule_bytes(p, tv.payload + 1, pp);
+			if (p->have)
+				p->errors++;
+		}
+
+		p->synced = 1;
+		p->have = 0;
+		ule_bytes(p, tv.payload + 1 + pp, tv.payload_length - 1 - pp);
+	} else {
+		ule_bytes(p, tv.payload, tv.payload_length);
+	}
+	return;
+
+error:
+	p->errors++;
+	p->synced = 0;
+	p->have = 0;
+}
+
+
+static int add_pid(char *arg)
+{
+	struct decap_pid *p;
+	char *s;
+	long pid;
+
+	pid = strtol(arg, &s, 0);
+	if ((s == arg) || (pid < 0) || (pid >= TRANSPORT_NULL_PID)) {
+		fprintf(stderr, "Error: bad PID %s\n", arg);
+		return -1;
+	}
+	if (npids == MAX_PIDS || pid_map[pid]) {
+		fprintf(stderr, "Error: too many or duplicate PIDs\n");
+		return -1;
+	}
+
+	if ((p = calloc(1, sizeof(struct decap_pid))) == NULL)
+		return -1;
+	p->pid = pid;
+
+	if (*s == ':') {
+		if (strcasecmp(s + 1, "ule") == 0)
+			p->ule = 1;
+		else if (strcasecmp(s + 1, "mpe") != 0) {
+			fprintf(stderr, "Error: unknown encapsulation %s\n", s + 1);
+			free(p);
+			return -1;
+		}
+	} else if (*s) {
+		fprintf(stderr, "Error: bad PID %s\n", arg);
+		free(p);
+		return -1;
+	}
+
+	if (!p->ule && fec_rows &&
+	    (p->fec = mpe_fec_frame_create(fec_rows, fec_datagram, p)) == NULL) {
+		fprintf(stderr, "Error: bad MPE-FEC frame size %d\n", fec_rows);
+		free(p);
+		return -1;
+	}
+
+	pids[npids++] = p;
+	pid_map[pid] = p;
+	return 0;
+}
+
+
+static int open_input(int *demux_fds)
+{
+	int i, fd;
+
+	if (input_file) {
+		if (strcmp(input_file, "-") == 0)
+			return 0;
+		if ((fd = open(input_file, O_RDONLY)) < 0)
+			fprintf(stderr, "Error: couldn't open %s: %d %m\n", input_file, errno);
+		return fd;
+	}
+
+	for (i = 0; i < npids; i++) {
+		if ((demux_fds[i] = dvbdemux_open_demux(adapter, demux, 0)) < 0) {
+			fprintf(stderr, "Error: couldn't open demux: %d %m\n", errno);
+			return -1;
+		}
+		if (dvbdemux_set_pid_filter(demux_fds[i], pids[i]->pid,
+					    DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DVR, 1)) {
+			fprintf(stderr, "Error: couldn't filter pid %d: %d %m\n",
+				pids[i]->pid, errno);
+			return -1;
+		}
+	}
+
+	if ((fd = dvbdemux_open_dvr(adapter, demux, 1, 0)) < 0) {
+		fprintf(stderr, "Error: couldn't open dvr: %d %m\n", errno);
+		return -1;
+	}
+	if (dvbdemux_set_buffer(fd, DVR_BUFFER_SIZE))
+		fprintf(stderr, "Warning: couldn't set dvr buffer size: %d %m\n", errno);
+
+	return fd;
+}
+
+
+static void decap(int fd, struct section_reasm *reasm)
+{
+	static uint8_t buf[READ_SIZE];
+	struct decap_pid *p;
+	int len = 0, pos, count, sync;
+
+	while (!quit) {
+		count = read(fd, buf + len, sizeof(buf) - len);
+		if (count < 0) {
+			if ((errno == EINTR) || (errno == EOVERFLOW))
+				continue;
+			fprintf(stderr, "Error: read failed: %d %m\n", errno);
+			break;
+		}
+		if (count == 0)
+			break;
+		len += count;
+
+		pos = 0;
+		while (pos + TRANSPORT_PACKET_LENGTH <= len) {
+			if (buf[pos] != TRANSPORT_PACKET_SYNC) {
+				sync = transport_packet_find_sync(buf + pos, len - pos);
+				if (sync < 0) {
+					pos = len;
+					break;
+				}
+				pos += sync;
+				continue;
+			}
+
+			p = pid_map[transport_packet_pid((struct transport_packet *) (buf + pos))];
+			if (p && p->ule)
+				ule_packet(p, buf + pos);
+			else if (p)
+				section_reasm_add_packet(reasm, buf + pos, mpe_section, NULL);
+			pos += TRANSPORT_PACKET_LENGTH;
+		}
+
+		memmove(buf, buf + pos, len - pos);
+		len -= pos;
+	}
+}
+
+
+int main(int argc, char **argv)
+{
+	struct section_reasm *reasm;
+	struct mpe_fec_frame_stats stats;
+	int demux_fds[MAX_PIDS];
+	int fd, i;
+
+	parse_args(argc, argv);
+
+	if ((reasm = section_reasm_create(MAX_PIDS, DVB_MAX_SECTION_BYTES)) == NULL)
+		return FAIL;
+	for (i = 0; i < npids; i++) {
+		if (!pids[i]->ule)
+			section_reasm_add_pid(reasm, pids[i]->pid);
+		demux_fds[i] = -1;
+	}
+
+	if (tun_name[0] && (tun_fd = open_tun(tun_name)) < 0)
+		return FAIL;
+
+	if ((fd = open_input(demux_fds)) < 0)
+		return FAIL;
+
+	signal(SIGINT, sighandler);
+	signal(SIGTERM, sighandler);
+
+	decap(fd, reasm);
+
+	for (i = 0; i < npids; i++) {
+		if (pids[i]->fec) {
+			mpe_fec_frame_flush(pids[i]->fec);
+			mpe_fec_frame_get_stats(pids[i]->fec, &stats);
+			printf("Status: pid %d: %lu frames, %lu rows corrected, %lu uncorrectable, "
+			       "%lu datagrams lost\n", pids[i]->pid, stats.frames,
+			       stats.rows_corrected, stats.rows_uncorrectable, stats.datagrams_lost);
+			mpe_fec_frame_destroy(pids[i]->fec);
+		}
+		printf("Status: pid %d (%s): %lu IP packets, %lu errors\n", pids[i]->pid,
+		       pids[i]->ule ? "ULE" : "MPE", pids[i]->packets, pids[i]->errors);
+		if (demux_fds[i] >= 0)
+			close(demux_fds[i]);
+		free(pids[i]);
+	}
+	if (tun_errors)
+		printf("Status: %lu tun write errors\n", tun_errors);
+
+	if (fd)
+		close(fd);
+	if (tun_fd >= 0)
+		close(tun_fd);
+	section_reasm_destroy(reasm);
+	return OK;
+}
+
+
+void parse_args(int argc, char **argv)
+{
+	int c;
+	char *s;
+
+	while ((c = getopt(argc, argv, "a:n:r:t:f:Vh")) != EOF) {
+		switch (c) {
+		case 'a':
+			adapter = strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			demux = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			input_file = optarg;
+			break;
+		case 't':
+			tun_name = optarg;
+			break;
+		case 'f':
+			fec_rows = strtol(optarg, NULL, 0);
+			break;
+		case 'V':
+			vnet_hdr = 1;
+			break;
+		case 'h':
+		default:
+			s = strrchr(argv[0], '/');
+			usage(s ? s + 1 : argv[0]);
+			exit(FAIL);
+		}
+	}
+
+	if (optind == argc) {
+		s = strrchr(argv[0], '/');
+		usage(s ? s + 1 : argv[0]);
+		exit(FAIL);
+	}
+
+	for (; optind < argc; optind++)
+		if (add_pid(argv[optind]))
+			exit(FAIL);
+}
+
+
+void usage(char *prog_name)
+{
+	fprintf(stderr, "Usage: %s [options] PID[:mpe|:ule] ...\n", prog_name);
+	fprintf(stderr, "Where options are:\n");
+	fprintf(stderr, "\t-a AD   : Adapter card (default 0)\n");
+	fprintf(stderr, "\t-n DD   : Demux and dvr (default 0)\n");
+	fprintf(stderr, "\t-r FILE : Read a transport stream from FILE (- for stdin)\n");
+	fprintf(stderr, "\t          instead of the dvr\n");
+	fprintf(stderr, "\t-t NAME : tun device to write to (default dvb%%d, \"\" for none)\n");
+	fprintf(stderr, "\t-f ROWS : MPE-FEC frames of ROWS rows (256, 512, 768 or 1024)\n");
+	fprintf(stderr, "\t-V      : Prepend virtio-net headers (IFF_VNET_HDR)\n\n");
+}
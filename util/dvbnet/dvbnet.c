@@ -30,6 +30,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <errno.h>
 
@@ -46,7 +47,8 @@ enum Mode {
 	UNKNOWN,
 	LST_INTERFACE,
 	ADD_INTERFACE,
-	DEL_INTERFACE
+	DEL_INTERFACE,
+	SET_INTERFACES
 } op_mode;
 
 static int adapter = 0;
@@ -56,10 +58,13 @@ static void hello(void);
 static void usage(char *);
 static void parse_args(int, char **);
 static void queryInterface(int);
+static int readInterfaces(char *, struct dvbnet_interface *);
+static int setInterfaces(int, char *);
 
 int ifnum;
 int pid;
 int encapsulation;
+char *set_file;
 
 int main(int argc, char **argv)
 {
@@ -101,6 +106,13 @@ int main(int argc, char **argv)
 		queryInterface(fd_net);
 		break;
 
+	case SET_INTERFACES:
+		if (setInterfaces(fd_net, set_file)) {
+			close(fd_net);
+			return FAIL;
+		}
+		break;
+
 	default:
 		usage(argv[0]);
 		return FAIL;
@@ -111,38 +123,136 @@ int main(int argc, char **argv)
 }
 
 
+static char *encapName(enum dvbnet_encap _encapsulation)
+{
+	switch(_encapsulation) {
+	case DVBNET_ENCAP_MPE:
+		return "MPE";
+	case DVBNET_ENCAP_ULE:
+		return "ULE";
+	}
+	return "???";
+}
+
+
 void queryInterface(int fd_net)
 {
-	int IF, nIFaces = 0;
-	char *encap;
+	struct dvbnet_interface ifaces[DVBNET_MAX_INTERFACES];
+	int i, nIFaces;
 
 	printf("Query DVB network interfaces:\n");
 	printf("-----------------------------\n");
-	for (IF = 0; IF < DVBNET_MAX_INTERFACES; IF++) {
-		uint16_t _pid;
-		enum dvbnet_encap _encapsulation;
-		if (dvbnet_get_interface(fd_net, IF, &_pid, &_encapsulation))
+	nIFaces = dvbnet_get_interfaces(fd_net, ifaces, DVBNET_MAX_INTERFACES);
+	for (i = 0; i < nIFaces; i++) {
+		printf("Found device %d: interface dvb%d_%d, "
+		       "listening on PID %d, encapsulation %s\n",
+		       ifaces[i].ifnum, adapter, ifaces[i].ifnum, ifaces[i].pid,
+		       encapName(ifaces[i].encapsulation));
+	}
+
+	printf("-----------------------------\n");
+	printf("Found %d interface(s).\n\n", nIFaces);
+}
+
+
+/*
+ * Read the wanted interface set: one "PID [MPE|ULE]" per line, '#' starts
+ * a comment. Returns the number of interfaces, or -1 on error.
+ */
+int readInterfaces(char *filename, struct dvbnet_interface *ifaces)
+{
+	FILE *f;
+	char line[256];
+	char encap[16];
+	char *s;
+	int lineno = 0, count = 0, i, n;
+	long _pid;
+
+	if (strcmp(filename, "-") == 0)
+		f = stdin;
+	else if ((f = fopen(filename, "r")) == NULL) {
+		fprintf(stderr, "Error: couldn't open %s: %d %m\n", filename, errno);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if ((s = strchr(line, '#')) != NULL)
+			*s = 0;
+
+		encap[0] = 0;
+		n = sscanf(line, "%li %15s", &_pid, encap);
+		if (n <= 0)
 			continue;
 
-		encap = "???";
-		switch(_encapsulation) {
-		case DVBNET_ENCAP_MPE:
-			encap = "MPE";
-			break;
-		case DVBNET_ENCAP_ULE:
-			encap = "ULE";
-			break;
+		if ((_pid < 0) || (_pid > 0x1fff)) {
+			fprintf(stderr, "Error: %s:%d: bad PID\n", filename, lineno);
+			goto error;
 		}
 
-		printf("Found device %d: interface dvb%d_%d, "
-		       "listening on PID %d, encapsulation %s\n",
-		       IF, adapter, IF, _pid, encap);
+		if (count == DVBNET_MAX_INTERFACES) {
+			fprintf(stderr, "Error: %s:%d: more than %d interfaces\n",
+				filename, lineno, DVBNET_MAX_INTERFACES);
+			goto error;
+		}
+
+		ifaces[count].pid = _pid;
+		ifaces[count].encapsulation = encapsulation;
+		if ((n == 2) && (strcasecmp(encap, "MPE") == 0))
+			ifaces[count].encapsulation = DVBNET_ENCAP_MPE;
+		else if ((n == 2) && (strcasecmp(encap, "ULE") == 0))
+			ifaces[count].encapsulation = DVBNET_ENCAP_ULE;
+		else if (n == 2) {
+			fprintf(stderr, "Error: %s:%d: unknown encapsulation %s\n",
+				filename, lineno, encap);
+			goto error;
+		}
 
-		nIFaces++;
+		for (i = 0; i < count; i++) {
+			if ((ifaces[i].pid == ifaces[count].pid) &&
+			    (ifaces[i].encapsulation == ifaces[count].encapsulation))
+				break;
+		}
+		if (i == count)
+			count++;
 	}
 
-	printf("-----------------------------\n");
-	printf("Found %d interface(s).\n\n", nIFaces);
+	if (f != stdin)
+		fclose(f);
+	return count;
+
+error:
+	if (f != stdin)
+		fclose(f);
+	return -1;
+}
+
+
+int setInterfaces(int fd_net, char *filename)
+{
+	struct dvbnet_interface ifaces[DVBNET_MAX_INTERFACES];
+	int count, added, removed, i, status = OK;
+
+	if ((count = readInterfaces(filename, ifaces)) < 0)
+		return FAIL;
+
+	if (dvbnet_set_interfaces(fd_net, ifaces, count, &added, &removed)) {
+		fprintf(stderr, "Error: couldn't apply all interface changes: %d %m.\n", errno);
+		status = FAIL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (ifaces[i].ifnum < 0)
+			fprintf(stderr, "Error: no interface for pid %d (%s).\n",
+				ifaces[i].pid, encapName(ifaces[i].encapsulation));
+		else
+			printf("Status: device dvb%d_%d listening on pid %d (%s).\n",
+			       adapter, ifaces[i].ifnum, ifaces[i].pid,
+			       encapName(ifaces[i].encapsulation));
+	}
+	printf("Status: %d interface(s) added, %d removed.\n", added, removed);
+
+	return status;
 }
 
 
@@ -152,7 +262,7 @@ void parse_args(int argc, char **argv)
 	char *s;
 	op_mode = UNKNOWN;
 	encapsulation = DVBNET_ENCAP_MPE;
-	while ((c = getopt(argc, argv, "a:n:p:d:lUvh")) != EOF) {
+	while ((c = getopt(argc, argv, "a:n:p:d:f:lUvh")) != EOF) {
 		switch (c) {
 		case 'a':
 			adapter = strtol(optarg, NULL, 0);
@@ -168,6 +278,10 @@ void parse_args(int argc, char **argv)
 			ifnum = strtol(optarg, NULL, 0);
 			op_mode = DEL_INTERFACE;
 			break;
+		case 'f':
+			set_file = optarg;
+			op_mode = SET_INTERFACES;
+			break;
 		case 'l':
 			op_mode = LST_INTERFACE;
 			break;
@@ -194,6 +308,8 @@ void usage(char *prog_name)
 	fprintf(stderr, "\t-n DD  : Demux (default 0)\n");
 	fprintf(stderr, "\t-p PID : Add interface listening on PID\n");
 	fprintf(stderr, "\t-d NUM : Remove interface NUM\n");
+	fprintf(stderr, "\t-f FILE: Set the interfaces to those listed in FILE (- for stdin),\n");
+	fprintf(stderr, "\t         one \"PID [MPE|ULE]\" per line, removing all others\n");
 	fprintf(stderr,	"\t-l     : List currently available interfaces\n");
 	fprintf(stderr, "\t-U     : use ULE framing (default: MPE)\n" );
 	fprintf(stderr, "\t-v     : Print current version\n\n");
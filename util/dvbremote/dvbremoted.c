@@ -0,0 +1,638 @@
+/*
+	dvbremoted - serve dvb adapters to libdvbapi on other hosts
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/dvb/frontend.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbremote.h>
+
+#define MAX_CLIENTS		64
+#define PACKETS_PER_DATAGRAM	7
+#define READ_PACKETS		(PACKETS_PER_DATAGRAM * 64)
+#define FILE_TICK_MS		10
+#define ALL_PIDS		0x2000
+
+enum client_type {
+	CLIENT_NEW,
+	CLIENT_FRONTEND,
+	CLIENT_DEMUX,
+};
+
+struct client {
+	int fd;
+	enum client_type type;
+	char name[64];
+
+	/* frontend */
+	int fe;
+	int notified;		/* an event was announced and not read yet */
+
+	/* demux */
+	int adapter;
+	struct dvbdemux_pidset *pidset;
+	int ts;			/* where the packets are read from */
+	int all;		/* the filter for all PIDs, -1 if none */
+	int udp;
+	uint8_t wanted[ALL_PIDS + 1];
+	uint16_t rtp_seq;
+	uint32_t rtp_ssrc;
+	uint8_t buf[READ_PACKETS * 188];
+	int buf_len;
+	off_t file_pos;
+};
+
+static struct client *clients[MAX_CLIENTS];
+static int rtp = 0;
+static const char *input_file = NULL;
+static uint64_t file_rate = 20000000;
+static int buffer_size = 4 * 1024 * 1024;
+static volatile sig_atomic_t quit = 0;
+
+static void usage(FILE *output)
+{
+	fprintf(output,
+		"Usage: dvbremoted [OPTION]...\n"
+		"Serve the dvb adapters of this host to libdvbapi programs elsewhere\n"
+		"(see DVBREMOTE_CONFIG_FILE in libdvbapi/dvbremote.h).\n"
+		"Options:\n"
+		"	-l ADDR	 listen on ADDR only (default all addresses)\n"
+		"	-p PORT	 listen on PORT (default %i)\n"
+		"	-r	 send the packets as RTP (RFC 2250) rather than bare UDP\n"
+		"	-B SIZE	 kernel buffer of each demux, in bytes (default 4MiB)\n"
+		"	-i FILE	 serve the packets of a transport stream file, looped, instead\n"
+		"		 of an adapter (for testing); there is no frontend\n"
+		"	-b RATE	 rate of the file, in bits/s (default 20000000)\n"
+		"	-h	 display this help\n", DVBREMOTE_DEFAULT_PORT);
+}
+
+static void signal_handler(int sig)
+{
+	(void) sig;
+
+	quit = 1;
+}
+
+static int read_all(int fd, void *buf, size_t len)
+{
+	uint8_t *pos = buf;
+
+	while(len) {
+		ssize_t count = recv(fd, pos, len, 0);
+
+		if (count <= 0) {
+			if ((count < 0) && (errno == EINTR))
+				continue;
+			return -1;
+		}
+		pos += count;
+		len -= count;
+	}
+	return 0;
+}
+
+static int send_msg(struct client *c, uint32_t type, int32_t value, const void *payload, uint32_t length)
+{
+	struct dvbremote_msg msg;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.type = type;
+	msg.value = value;
+	msg.length = length;
+	if (send(c->fd, &msg, sizeof(msg), MSG_NOSIGNAL) != sizeof(msg))
+		return -1;
+	if (length && (send(c->fd, payload, length, MSG_NOSIGNAL) != (ssize_t) length))
+		return -1;
+	return 0;
+}
+
+static void client_free(struct client *c)
+{
+	fprintf(stderr, "dvbremoted: %s disconnected\n", c->name);
+	if (c->fe != -1)
+		close(c->fe);
+	if (c->all != -1)
+		close(c->all);
+	if (c->ts != -1 && (c->pidset == NULL || c->ts != dvbdemux_pidset_fd(c->pidset)))
+		close(c->ts);
+	if (c->pidset)
+		dvbdemux_pidset_close(c->pidset);
+	if (c->udp != -1)
+		close(c->udp);
+	close(c->fd);
+	free(c);
+}
+
+static int open_frontend(struct client *c, struct dvbremote_msg *msg)
+{
+	char filename[64];
+
+	if (input_file)
+		return -ENODEV;
+	sprintf(filename, "/dev/dvb/adapter%i/frontend%i", msg->adapter, msg->value);
+	if ((c->fe = open(filename, (msg->request ? O_RDONLY : O_RDWR) | O_NONBLOCK | O_CLOEXEC)) < 0)
+		return -errno;
+
+	c->type = CLIENT_FRONTEND;
+	return 0;
+}
+
+static int open_demux(struct client *c, struct dvbremote_msg *msg)
+{
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+
+	// the packets go to the client's address, on the port it asked for
+	if (getpeername(c->fd, (struct sockaddr *) &addr, &addr_len))
+		return -errno;
+	if (addr.ss_family == AF_INET6)
+		((struct sockaddr_in6 *) &addr)->sin6_port = htons(msg->value);
+	else
+		((struct sockaddr_in *) &addr)->sin_port = htons(msg->value);
+	if (((c->udp = socket(addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0) ||
+	    connect(c->udp, (struct sockaddr *) &addr, addr_len))
+		return -errno;
+	c->rtp_ssrc = random();
+
+	if (input_file) {
+		if ((c->ts = open(input_file, O_RDONLY | O_CLOEXEC)) < 0)
+			return -errno;
+	} else {
+		c->adapter = msg->adapter;
+		if ((c->pidset = dvbdemux_pidset_open(msg->adapter, 0, 0, buffer_size)) == NULL)
+			return -ENODEV;
+		c->ts = dvbdemux_pidset_fd(c->pidset);
+		if (c->ts == -1) {
+			// no PIDs can be added to a filter: a DVR of our own
+			if ((c->ts = dvbdemux_open_dvr(msg->adapter, 0, 1, 1)) < 0)
+				return -errno;
+			dvbdemux_set_buffer(c->ts, buffer_size);
+		} else {
+			fcntl(c->ts, F_SETFL, O_NONBLOCK);
+		}
+	}
+
+	c->type = CLIENT_DEMUX;
+	return 0;
+}
+
+static void change_pid(struct client *c, int pid, int add)
+{
+	if ((c->type != CLIENT_DEMUX) || (pid < 0) || (pid > ALL_PIDS) || (c->wanted[pid] == add))
+		return;
+	c->wanted[pid] = add;
+	if (input_file)
+		return;
+
+	if (pid != ALL_PIDS) {
+		if (add)
+			dvbdemux_pidset_add(c->pidset, pid);
+		else
+			dvbdemux_pidset_remove(c->pidset, pid);
+		return;
+	}
+
+	// every PID: a filter of its own, and the set is left out meanwhile
+	if (add) {
+		if ((c->all = dvbdemux_open_demux(c->adapter, 0, 1)) < 0)
+			return;
+		dvbdemux_set_buffer(c->all, buffer_size);
+		if (dvbdemux_set_pid_filter(c->all, ALL_PIDS, DVBDEMUX_INPUT_FRONTEND,
+					    DVBDEMUX_OUTPUT_TS_DEMUX, 1)) {
+			close(c->all);
+			c->all = -1;
+		}
+	} else if (c->all != -1) {
+		close(c->all);
+		c->all = -1;
+	}
+}
+
+/*
+ * Only ioctls which read the frontend state or set up reception are passed
+ * on, whatever a client asks for.
+ */
+static int allowed_ioctl(unsigned long request)
+{
+	switch(request) {
+	case FE_GET_INFO:
+	case FE_READ_STATUS:
+	case FE_READ_BER:
+	case FE_READ_SNR:
+	case FE_READ_SIGNAL_STRENGTH:
+	case FE_READ_UNCORRECTED_BLOCKS:
+	case FE_SET_FRONTEND:
+	case FE_GET_FRONTEND:
+	case FE_GET_EVENT:
+	case FE_SET_FRONTEND_TUNE_MODE:
+	case FE_SET_TONE:
+	case FE_SET_VOLTAGE:
+	case FE_ENABLE_HIGH_LNB_VOLTAGE:
+	case FE_DISEQC_SEND_MASTER_CMD:
+	case FE_DISEQC_RECV_SLAVE_REPLY:
+	case FE_DISEQC_SEND_BURST:
+	case FE_DISHNETWORK_SEND_LEGACY_CMD:
+	case FE_SET_PROPERTY:
+	case FE_GET_PROPERTY:
+		return 1;
+	}
+	return 0;
+}
+
+static int frontend_ioctl(struct client *c, struct dvbremote_msg *msg, uint8_t *buf)
+{
+	unsigned long request = msg->request;
+	size_t size = _IOC_SIZE(request);
+	uint32_t length = 0;
+	int ret;
+
+	if ((c->type != CLIENT_FRONTEND) || !allowed_ioctl(request))
+		return send_msg(c, DVBREMOTE_MSG_REPLY, -EINVAL, NULL, 0);
+
+	if ((request == FE_SET_PROPERTY) || (request == FE_GET_PROPERTY)) {
+		struct dtv_properties props;
+
+		props.num = msg->length / sizeof(struct dtv_property);
+		props.props = (struct dtv_property *) buf;
+		if (props.num * sizeof(struct dtv_property) != msg->length)
+			return send_msg(c, DVBREMOTE_MSG_REPLY, -EINVAL, NULL, 0);
+		ret = ioctl(c->fe, request, &props);
+		length = msg->length;
+	} else if (_IOC_DIR(request) == _IOC_NONE) {
+		ret = ioctl(c->fe, request, (unsigned long) msg->value);
+	} else {
+		if ((_IOC_DIR(request) & _IOC_WRITE) && (msg->length != size))
+			return send_msg(c, DVBREMOTE_MSG_REPLY, -EINVAL, NULL, 0);
+		ret = ioctl(c->fe, request, buf);
+		if (_IOC_DIR(request) & _IOC_READ)
+			length = size;
+	}
+	if (ret < 0)
+		ret = -errno;
+
+	// an event read is announced again if there are more
+	if (request == FE_GET_EVENT)
+		c->notified = 0;
+	return send_msg(c, DVBREMOTE_MSG_REPLY, ret, buf, length);
+}
+
+static int client_request(struct client *c)
+{
+	struct dvbremote_msg msg;
+	uint8_t buf[DVBREMOTE_MAX_PAYLOAD];
+	int ret;
+
+	if (read_all(c->fd, &msg, sizeof(msg)) || (msg.length > sizeof(buf)))
+		return -1;
+	memset(buf, 0, sizeof(buf));
+	if (msg.length && read_all(c->fd, buf, msg.length))
+		return -1;
+
+	switch(msg.type) {
+	case DVBREMOTE_MSG_OPEN_FRONTEND:
+	case DVBREMOTE_MSG_OPEN_DEMUX:
+		if (c->type != CLIENT_NEW)
+			return -1;
+		if (msg.type == DVBREMOTE_MSG_OPEN_FRONTEND)
+			ret = open_frontend(c, &msg);
+		else
+			ret = open_demux(c, &msg);
+		fprintf(stderr, "dvbremoted: %s opened %s of adapter %i: %s\n", c->name,
+			(msg.type == DVBREMOTE_MSG_OPEN_FRONTEND) ? "the frontend" : "the demux",
+			msg.adapter, ret ? strerror(-ret) : "ok");
+		if (send_msg(c, DVBREMOTE_MSG_REPLY, ret, NULL, 0) || ret)
+			return -1;
+		return 0;
+
+	case DVBREMOTE_MSG_IOCTL:
+		return frontend_ioctl(c, &msg, buf);
+
+	case DVBREMOTE_MSG_ADD_PID:
+	case DVBREMOTE_MSG_REMOVE_PID:
+		change_pid(c, msg.value, msg.type == DVBREMOTE_MSG_ADD_PID);
+		return 0;
+	}
+
+	return -1;
+}
+
+static void send_packets(struct client *c, uint8_t *data, int count)
+{
+	uint8_t datagram[12 + (PACKETS_PER_DATAGRAM * 188)];
+	struct timespec now;
+	int i;
+
+	while(count > 0) {
+		int packets = (count < PACKETS_PER_DATAGRAM) ? count : PACKETS_PER_DATAGRAM;
+		uint8_t *pos = datagram;
+
+		if (rtp) {
+			uint32_t stamp;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			stamp = (now.tv_sec * 90000) + (now.tv_nsec / (1000000000 / 90000));
+			*pos++ = 0x80;
+			*pos++ = 33;	/* MP2T */
+			*pos++ = c->rtp_seq >> 8;
+			*pos++ = c->rtp_seq;
+			for(i = 24; i >= 0; i -= 8)
+				*pos++ = stamp >> i;
+			for(i = 24; i >= 0; i -= 8)
+				*pos++ = c->rtp_ssrc >> i;
+			c->rtp_seq++;
+		}
+		memcpy(pos, data, packets * 188);
+		pos += packets * 188;
+
+		// a client which does not keep up loses packets, as from a demux
+		send(c->udp, datagram, pos - datagram, MSG_DONTWAIT);
+		data += packets * 188;
+		count -= packets;
+	}
+}
+
+/*
+ * Send what a demux client's filters delivered. The file input is filtered
+ * here, the adapter's by the kernel.
+ */
+static int client_packets(struct client *c, int fd, size_t max)
+{
+	ssize_t len;
+	int count;
+	int out;
+	int i;
+
+	if (max > sizeof(c->buf) - c->buf_len)
+		max = sizeof(c->buf) - c->buf_len;
+	if ((len = read(fd, c->buf + c->buf_len, max)) < 0) {
+		if ((errno == EAGAIN) || (errno == EINTR) || (errno == EOVERFLOW))
+			return 0;
+		return -1;
+	}
+	if ((len == 0) && input_file) {
+		lseek(fd, 0, SEEK_SET);
+		return 0;
+	}
+	c->buf_len += len;
+	count = c->buf_len / 188;
+
+	if (input_file) {
+		for(i = 0, out = 0; i < count; i++) {
+			uint8_t *pkt = c->buf + (i * 188);
+			int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+
+			if (c->wanted[ALL_PIDS] || c->wanted[pid])
+				memmove(c->buf + (out++ * 188), pkt, 188);
+		}
+	} else {
+		out = count;
+	}
+	send_packets(c, c->buf, out);
+
+	c->buf_len -= count * 188;
+	memmove(c->buf, c->buf + (count * 188), c->buf_len);
+	return 0;
+}
+
+static int listen_on(const char *address, int port)
+{
+	struct addrinfo hints;
+	struct addrinfo *res;
+	char service[16];
+	int one = 1;
+	int fd;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = address ? AF_UNSPEC : AF_INET6;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	sprintf(service, "%i", port);
+	if (getaddrinfo(address, service, &hints, &res) &&
+	    (address || (hints.ai_family = AF_INET, getaddrinfo(address, service, &hints, &res)))) {
+		fprintf(stderr, "dvbremoted: Unknown address %s\n", address ? address : "");
+		return -1;
+	}
+
+	if ((fd = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol)) < 0) {
+		freeaddrinfo(res);
+		return -1;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, res->ai_addr, res->ai_addrlen) || listen(fd, 16)) {
+		freeaddrinfo(res);
+		close(fd);
+		return -1;
+	}
+	freeaddrinfo(res);
+	return fd;
+}
+
+static void client_add(int listener)
+{
+	struct sockaddr_storage addr;
+	socklen_t addr_len = sizeof(addr);
+	struct timeval timeout = { 1, 0 };
+	char host[INET6_ADDRSTRLEN];
+	struct client *c;
+	int one = 1;
+	int fd;
+	int i;
+
+	if ((fd = accept4(listener, (struct sockaddr *) &addr, &addr_len, SOCK_CLOEXEC)) < 0)
+		return;
+	for(i = 0; (i < MAX_CLIENTS) && clients[i]; i++);
+	if ((i == MAX_CLIENTS) || ((c = calloc(1, sizeof(struct client))) == NULL)) {
+		close(fd);
+		return;
+	}
+
+	// a request arrives whole, or the client is given up on
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	c->fd = fd;
+	c->fe = -1;
+	c->ts = -1;
+	c->all = -1;
+	c->udp = -1;
+	if (getnameinfo((struct sockaddr *) &addr, addr_len, host, sizeof(host), NULL, 0, NI_NUMERICHOST))
+		strcpy(host, "?");
+	snprintf(c->name, sizeof(c->name), "%s", host);
+	clients[i] = c;
+	fprintf(stderr, "dvbremoted: %s connected\n", c->name);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd pollfds[1 + (MAX_CLIENTS * 2)];
+	struct client *polled[1 + (MAX_CLIENTS * 2)];
+	const char *address = NULL;
+	struct timespec last;
+	struct timespec now;
+	int port = DVBREMOTE_DEFAULT_PORT;
+	int listener;
+	int count;
+	int opt;
+	int i;
+
+	while((opt = getopt(argc, argv, "l:p:rB:i:b:h")) != -1) {
+		switch(opt) {
+		case 'l':
+			address = optarg;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			break;
+		case 'r':
+			rtp = 1;
+			break;
+		case 'B':
+			buffer_size = atoi(optarg);
+			break;
+		case 'i':
+			input_file = optarg;
+			break;
+		case 'b':
+			file_rate = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(stdout);
+			exit(0);
+		default:
+			usage(stderr);
+			exit(1);
+		}
+	}
+	if ((optind != argc) || (port <= 0) || (port > 65535) || (file_rate == 0)) {
+		usage(stderr);
+		exit(1);
+	}
+
+	if ((listener = listen_on(address, port)) < 0) {
+		fprintf(stderr, "dvbremoted: Unable to listen on port %i: %m\n", port);
+		exit(1);
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+	srandom(time(NULL) ^ getpid());
+	clock_gettime(CLOCK_MONOTONIC, &last);
+
+	while(!quit) {
+		pollfds[0].fd = listener;
+		pollfds[0].events = POLLIN;
+		count = 1;
+		for(i = 0; i < MAX_CLIENTS; i++) {
+			struct client *c = clients[i];
+
+			if (c == NULL)
+				continue;
+			polled[count] = c;
+			pollfds[count].fd = c->fd;
+			pollfds[count++].events = POLLIN;
+
+			if ((c->type == CLIENT_FRONTEND) && !c->notified) {
+				polled[count] = c;
+				pollfds[count].fd = c->fe;
+				pollfds[count++].events = POLLIN | POLLPRI;
+			} else if ((c->type == CLIENT_DEMUX) && !input_file) {
+				polled[count] = c;
+				pollfds[count].fd = (c->all != -1) ? c->all : c->ts;
+				pollfds[count++].events = POLLIN;
+			}
+		}
+
+		if (poll(pollfds, count, input_file ? FILE_TICK_MS : -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (pollfds[0].revents)
+			client_add(listener);
+
+		// the file goes out at its rate
+		if (input_file) {
+			size_t bytes;
+
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			bytes = (((now.tv_sec - last.tv_sec) * 1000000000LL) + (now.tv_nsec - last.tv_nsec)) *
+				(file_rate / 8) / 1000000000LL;
+			if (bytes >= 188) {
+				last = now;
+				for(i = 0; i < MAX_CLIENTS; i++) {
+					if (clients[i] && (clients[i]->type == CLIENT_DEMUX) &&
+					    client_packets(clients[i], clients[i]->ts, bytes)) {
+						client_free(clients[i]);
+						clients[i] = NULL;
+					}
+				}
+			}
+		}
+
+		for(i = 1; i < count; i++) {
+			struct client *c = polled[i];
+			int slot;
+			int ret = 0;
+
+			if (!pollfds[i].revents)
+				continue;
+			for(slot = 0; (slot < MAX_CLIENTS) && (clients[slot] != c); slot++);
+			if (slot == MAX_CLIENTS)
+				continue;
+
+			if (pollfds[i].fd == c->fd) {
+				ret = client_request(c);
+			} else if (c->type == CLIENT_FRONTEND) {
+				c->notified = 1;
+				ret = send_msg(c, DVBREMOTE_MSG_EVENT, 0, NULL, 0);
+			} else {
+				ret = client_packets(c, pollfds[i].fd, sizeof(c->buf));
+			}
+			if (ret) {
+				client_free(c);
+				clients[slot] = NULL;
+			}
+		}
+	}
+
+	for(i = 0; i < MAX_CLIENTS; i++) {
+		if (clients[i])
+			client_free(clients[i]);
+	}
+	close(listener);
+	return 0;
+}
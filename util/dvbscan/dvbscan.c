@@ -23,6 +23,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <time.h>
 #include <libdvbsec/dvbsec_cfg.h>
 #include <libdvbcfg/dvbcfg_scanfile.h>
@@ -51,6 +52,9 @@ static struct transponder *toscan_end = NULL;
 static struct transponder *scanned = NULL;
 static struct transponder *scanned_end = NULL;
 
+// every transponder ever queued, so none is queued twice
+static struct transponder_set known;
+
 
 static void usage(void)
 {
@@ -73,9 +77,16 @@ static void usage(void)
 		"			 * C-MULTI - Big Dish - Multipoint LNBf, 3700 to 4200 MHz,\n"
 		"						Dual LO, H:5150MHz, V:5750MHz.\n"
 		"			 * One of the sec definitions from the secfile if supplied\n"
-		" -satpos <position>	Specify DISEQC switch position for DVB-S.\n"
+		" -satpos <position>|auto Specify DISEQC switch position for DVB-S. With auto, the\n"
+		"			switches and LNBs are discovered from their DiSEqC 2.x replies\n"
+		"			(or taken from the cache of an earlier discovery), and each\n"
+		"			transponder is tried on the ports an LNB answered on.\n"
+		" -rediscover		Discover the switches again rather than use the cache.\n"
 		" -inversion <on|off|auto> Specify inversion (default: auto) (note: this option is ignored).\n"
 		" -uk-ordering 		Use UK DVB-T channel ordering if present (note: this option is ignored).\n"
+		" -capture <filename>	Read the tables of one transponder from a capture instead of\n"
+		"			tuning (no initial scan file is needed then).\n"
+		" -fetype <dvbs|dvbc|dvbt> Delivery system of the capture (default dvbt).\n"
 		" -timeout <secs>	Specify filter timeout to use (standard specced values will be used by default)\n"
 		" -filter <filter>	Specify service filter, a comma seperated list of the following tokens:\n"
 		" 			 (If no filter is supplied, all services will be output)\n"
@@ -95,6 +106,92 @@ static void usage(void)
 }
 
 
+/**
+ * Tune the frontend to each frequency of a transponder in turn, until one
+ * locks.
+ *
+ * @return 1 if it locked, 0 if not.
+ */
+static int tune_transponder(struct dvbfe_handle *fe, struct dvbsec_config *psec,
+			    struct transponder *t,
+			    enum dvbsec_diseqc_switch sat_pos,
+			    enum dvbsec_diseqc_switch switch_option,
+			    struct dvbfe_info *feinfo)
+{
+	uint32_t i;
+
+	for(i=0; i < t->frequency_count; i++) {
+		t->params.frequency = t->frequencies[i];
+		if (dvbsec_set(fe,
+				psec,
+				t->polarization,
+				sat_pos,
+				switch_option,
+				&t->params,
+				0)) {
+			fprintf(stderr, "Failed to set frontend\n");
+			exit(1);
+		}
+
+		// wait for lock
+		time_t starttime = time(NULL);
+		while((time(NULL) - starttime) < TIMEOUT_WAIT_LOCK) {
+			if (dvbfe_get_info(fe, DVBFE_INFO_LOCKSTATUS, feinfo,
+					DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) !=
+				DVBFE_INFO_QUERYTYPE_IMMEDIATE) {
+				fprintf(stderr, "Unable to query frontend status\n");
+				exit(1);
+			}
+			if (feinfo->lock)
+				return 1;
+			usleep(100000);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Get the topology of the frontend's switches, and pick the ports to scan:
+ * those with an LNB which answered, or all of them if none did (as with
+ * DiSEqC 1.x LNBs behind a 2.x switch).
+ *
+ * @return Number of ports put in ports, 0 if there is nothing to choose from.
+ */
+static int discover_ports(struct dvbfe_handle *fe, int adapter_id, int frontend_id,
+			  int flags, struct dvbsec_topo *topo, int *ports)
+{
+	struct dvbsec_cfg_store *store;
+	int count = 0;
+	int i;
+
+	if ((store = dvbsec_cfg_store_open(NULL)) == NULL)
+		return 0;
+	if (dvbsec_cfg_store_topo(store, fe, adapter_id, frontend_id, flags, topo)) {
+		dvbsec_cfg_store_close(store);
+		return 0;
+	}
+	dvbsec_cfg_store_close(store);
+	if (!topo->replies)
+		return 0;
+
+	for(i=0; i < topo->port_count; i++) {
+		struct dvbsec_topo_port *p = &topo->ports[i];
+
+		fprintf(stderr, "port %i: committed %i uncommitted %i", i, p->committed, p->uncommitted);
+		if (p->lnb_address)
+			fprintf(stderr, " LNB 0x%02x, LOF %u/%u kHz", p->lnb_address, p->lof_lo, p->lof_hi);
+		fprintf(stderr, "\n");
+		if (p->lnb_address)
+			ports[count++] = i;
+	}
+	if (count == 0)
+		for(i=0; i < topo->port_count; i++)
+			ports[count++] = i;
+
+	return count;
+}
+
 static int scan_load_callback(struct dvbcfg_scanfile *channel, void *private_data)
 {
 	struct dvbfe_info *feinfo = (struct dvbfe_info *) private_data;
@@ -103,18 +200,26 @@ static int scan_load_callback(struct dvbcfg_scanfile *channel, void *private_dat
 		return 0;
 
 	struct transponder *t = new_transponder();
-	append_transponder(t, &toscan, &toscan_end);
 	memcpy(&t->params, &channel->fe_params, sizeof(struct dvbfe_parameters));
+	if (channel->fe_type == DVBFE_TYPE_DVBS)
+		t->polarization = tolower(channel->polarization);
 
 	add_frequency(t, t->params.frequency);
 	t->params.frequency = 0;
 
+	// skip duplicates now, rather than tuning to them
+	if (transponder_set_contains(&known, t)) {
+		free_transponder(t);
+		return 0;
+	}
+	transponder_set_add(&known, t);
+	append_transponder(t, &toscan, &toscan_end);
+
 	return 0;
 }
 
 int main(int argc, char *argv[])
 {
-	uint32_t i;
 	int argpos = 1;
 	int adapter_id = 0;
 	int frontend_id = 0;
@@ -123,10 +228,18 @@ int main(int argc, char *argv[])
 	char *secid = NULL;
 	int satpos = 0;
 	int service_filter = -1;
-	int timeout = 5;
+	int timeout = 0;
 	char *scan_filename = NULL;
+	char *capture = NULL;
+	enum dvbfe_type capture_type = DVBFE_TYPE_DVBT;
 	struct dvbsec_config sec;
 	int valid_sec = 0;
+	int topo_flags = 0;
+	struct dvbsec_topo topo;
+	int ports[DVBSEC_TOPO_MAX_PORTS];
+	int port_count = 0;
+	int last_port = 0;
+	int i;
 
 	while(argpos != argc) {
 		if (!strcmp(argv[argpos], "-h")) {
@@ -162,9 +275,14 @@ int main(int argc, char *argv[])
 		} else if (!strcmp(argv[argpos], "-satpos")) {
 			if ((argc - argpos) < 2)
 				usage();
-			if (sscanf(argv[argpos+1], "%i", &satpos) != 1)
+			if (!strcmp(argv[argpos+1], "auto"))
+				satpos = -1;
+			else if (sscanf(argv[argpos+1], "%i", &satpos) != 1)
 				usage();
 			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-rediscover")) {
+			topo_flags |= DVBSEC_TOPO_REDISCOVER;
+			argpos++;
 		} else if (!strcmp(argv[argpos], "-inversion")) {
 			if ((argc - argpos) < 2)
 				usage();
@@ -172,6 +290,23 @@ int main(int argc, char *argv[])
 		} else if (!strcmp(argv[argpos], "-uk-ordering")) {
 			if ((argc - argpos) < 1)
 				usage();
+		} else if (!strcmp(argv[argpos], "-capture")) {
+			if ((argc - argpos) < 2)
+				usage();
+			capture = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-fetype")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (!strcmp(argv[argpos+1], "dvbs"))
+				capture_type = DVBFE_TYPE_DVBS;
+			else if (!strcmp(argv[argpos+1], "dvbc"))
+				capture_type = DVBFE_TYPE_DVBC;
+			else if (!strcmp(argv[argpos+1], "dvbt"))
+				capture_type = DVBFE_TYPE_DVBT;
+			else
+				usage();
+			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-timeout")) {
 			if ((argc - argpos) < 2)
 				usage();
@@ -206,6 +341,17 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	// a capture is a single transponder, with nothing to tune
+	if (capture != NULL) {
+		struct transponder *t = new_transponder();
+
+		transponder_set_init(&known, capture_type);
+		if (dvbscan_scan_file(capture, capture_type, t, &toscan, &toscan_end, &known))
+			exit(1);
+		append_transponder(t, &scanned, &scanned_end);
+		return 0;
+	}
+
 	// open the frontend & get its type
 	struct dvbfe_handle *fe = dvbfe_open(adapter_id, frontend_id, 0);
 	if (fe == NULL) {
@@ -231,7 +377,17 @@ int main(int argc, char *argv[])
 		valid_sec = 1;
 	}
 
+	// find the ports worth trying
+	if ((satpos < 0) && (feinfo.type == DVBFE_TYPE_DVBS)) {
+		port_count = discover_ports(fe, adapter_id, frontend_id, topo_flags, &topo, ports);
+		if (port_count == 0)
+			fprintf(stderr, "No DiSEqC 2.x replies; using switch position 0\n");
+	}
+	if (satpos < 0)
+		satpos = 0;
+
 	// load the initial scan file
+	transponder_set_init(&known, feinfo.type);
 	FILE *scan_file = fopen(scan_filename, "r");
 	if (scan_file == NULL) {
 		fprintf(stderr, "Could not open scan file %s\n", scan_filename);
@@ -248,12 +404,6 @@ int main(int argc, char *argv[])
 		// get the first item on the toscan list
 		struct transponder *tmp = first_transponder(&toscan, &toscan_end);
 
-		// have we already seen this transponder?
-		if (seen_transponder(tmp, scanned)) {
-			free_transponder(tmp);
-			continue;
-		}
-
 		// do we have a valid SEC configuration?
 		struct dvbsec_config *psec = NULL;
 		if (valid_sec)
@@ -261,33 +411,24 @@ int main(int argc, char *argv[])
 
 		// tune it
 		int tuned_ok = 0;
-		for(i=0; i < tmp->frequency_count; i++) {
-			tmp->params.frequency = tmp->frequencies[i];
-			if (dvbsec_set(fe,
-					psec,
-					tmp->polarization,
+		if (port_count == 0) {
+			tuned_ok = tune_transponder(fe, psec, tmp,
 					(satpos & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
 					(satpos & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
-					&tmp->params,
-					0)) {
-				fprintf(stderr, "Failed to set frontend\n");
-				exit(1);
-			}
+					&feinfo);
+		} else {
+			// the port which locked last is the likeliest
+			for(i=0; (i < port_count) && !tuned_ok; i++) {
+				int port = (last_port + i) % port_count;
+				enum dvbsec_diseqc_switch sat_pos, switch_option;
 
-			// wait for lock
-			time_t starttime = time(NULL);
-			while((time(NULL) - starttime) < TIMEOUT_WAIT_LOCK) {
-				if (dvbfe_get_info(fe, DVBFE_INFO_LOCKSTATUS, &feinfo,
-				    			DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) !=
-					DVBFE_INFO_QUERYTYPE_IMMEDIATE) {
-					fprintf(stderr, "Unable to query frontend status\n");
+				if (dvbsec_topo_select(fe, &topo, ports[port], &sat_pos, &switch_option)) {
+					fprintf(stderr, "Failed to set switches\n");
 					exit(1);
 				}
-				if (feinfo.lock) {
-					tuned_ok = 1;
-					break;
-				}
-				usleep(100000);
+				if ((tuned_ok = tune_transponder(fe, psec, tmp, sat_pos, switch_option,
+								 &feinfo)))
+					last_port = port;
 			}
 		}
 		if (!tuned_ok) {
@@ -300,7 +441,8 @@ int main(int argc, char *argv[])
 		case DVBFE_TYPE_DVBS:
 		case DVBFE_TYPE_DVBC:
 		case DVBFE_TYPE_DVBT:
-			dvbscan_scan_dvb(fe);
+			dvbscan_scan_dvb(fe, adapter_id, demux_id, timeout, tmp,
+					 &toscan, &toscan_end, &known);
 			break;
 
 		case DVBFE_TYPE_ATSC:
@@ -91,6 +91,7 @@ struct transponder
 	 */
 	uint32_t *frequencies;
 	uint32_t frequency_count;
+	uint32_t frequency_alloc;
 
 	/**
 	 * The rest of the tuning parameters.
@@ -122,15 +123,63 @@ struct transponder
 	struct transponder *next;
 };
 
+/**
+ * A hashed set of transponders, for telling in O(1) whether one has been
+ * seen before. A transponder is keyed on its delivery system, frequency
+ * (in 2MHz steps for DVB-S, 2kHz otherwise, as for seen_transponder()),
+ * polarization and symbol rate (in 100 kSym/s steps, DVB-S and DVB-C only).
+ * Every one of its frequencies is added, and it matches if any does.
+ */
+struct transponder_set
+{
+	enum dvbfe_type type;
+	uint64_t *keys;
+	uint32_t size;
+	uint32_t count;
+};
+
 extern void append_transponder(struct transponder *t, struct transponder **tlist, struct transponder **tlist_end);
 extern struct transponder *new_transponder(void);
 extern void free_transponder(struct transponder *t);
 extern int seen_transponder(struct transponder *t, struct transponder *checklist);
+
+extern void transponder_set_init(struct transponder_set *set, enum dvbfe_type type);
+extern void transponder_set_free(struct transponder_set *set);
+extern void transponder_set_add(struct transponder_set *set, struct transponder *t);
+extern int transponder_set_contains(struct transponder_set *set, struct transponder *t);
 extern void add_frequency(struct transponder *t, uint32_t frequency);
 extern struct transponder *first_transponder(struct transponder **tlist, struct transponder **tlist_end);
 
+extern struct service *new_service(uint16_t service_id);
+extern void free_service(struct service *s);
+extern struct service *find_service(struct transponder *t, uint16_t service_id, int create);
+extern void add_stream(struct service *s, uint8_t stream_type, iso639lang_t language);
+extern void add_ca_id(struct service *s, uint16_t ca_id);
+
 extern int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t table_id);
-extern void dvbscan_scan_dvb(struct dvbfe_handle *fe);
+
+/**
+ * Scan the tables of one transponder from a capture file rather than the
+ * demux, as fast as the file can be read. type says which delivery system
+ * descriptors of the NIT make new transponders.
+ *
+ * @return 0 on success, -1 if the file could not be read.
+ */
+extern int dvbscan_scan_file(const char *filename, enum dvbfe_type type,
+			     struct transponder *t,
+			     struct transponder **toscan, struct transponder **toscan_end,
+			     struct transponder_set *known);
+
+/**
+ * Scan the DVB tables of the transponder which is tuned, and fill in its ids
+ * and services. Transponders found in the NIT which are not in known are
+ * appended to toscan and added to it. timeout is in seconds; 0 uses the
+ * standard values.
+ */
+extern void dvbscan_scan_dvb(struct dvbfe_handle *fe, int adapter, int demux, int timeout,
+			     struct transponder *t,
+			     struct transponder **toscan, struct transponder **toscan_end,
+			     struct transponder_set *known);
 extern void dvbscan_scan_atsc(struct dvbfe_handle *fe);
 
 #endif
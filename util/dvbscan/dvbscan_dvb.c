@@ -22,9 +22,781 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <iconv.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+#include <libucsi/mpeg/descriptor.h>
+#include <libucsi/dvb/descriptor.h>
+#include <libucsi/dvb/types.h>
+#include <libdvbswdemux/dvbswdemux.h>
+#include <libdvbswdemux/dvbswdemux_file.h>
 #include "dvbscan.h"
 
-void dvbscan_scan_dvb(struct dvbfe_handle *fe)
+/*
+ * All the tables of a transponder are collected at once: the PAT, SDT and
+ * NIT filters are started together, and the PMT filters are started in bulk
+ * as soon as the PAT is complete, while the SDT and NIT are still arriving.
+ * Transponders in the NIT are queued as soon as it is parsed, and the scan
+ * of a transponder ends the moment its last table is complete rather than
+ * when the timeouts run out.
+ *
+ * From a capture file, the tables come from the software demux instead, and
+ * a table times out once its filter has seen the whole capture.
+ */
+
+// timeouts in ms, from the maximum repetition intervals of EN 300 468 / TR 101 211
+#define TIMEOUT_PAT	2000
+#define TIMEOUT_PMT	2000
+#define TIMEOUT_SDT	5000
+#define TIMEOUT_NIT	12000
+
+#define MAX_PMT_FILTERS	32
+
+/**
+ * A (possibly multi section) table being collected from one filter.
+ */
+struct table {
+	struct scan *scan;
+	int fd;
+	struct dvbswdemux_filter *filter;	// capture file
+	uint64_t start;				// capture file position when started
+	int complete;
+	int version;
+	int last_section;
+	uint8_t seen[256 / 8];
+	uint16_t pid;
+	uint8_t table_id;
+	long deadline;
+};
+
+/**
+ * A program from the PAT, waiting for its PMT.
+ */
+struct program {
+	struct service *service;
+	uint16_t pmt_pid;
+	int done;
+};
+
+struct scan {
+	struct transponder *t;
+	enum dvbfe_type type;
+	int adapter;
+	int demux;
+	int timeout;
+	struct dvbswdemux *swdemux;		// capture file, else NULL
+	struct dvbswdemux_file *file;
+
+	struct table pat;
+	struct table sdt;
+	struct table nit;
+	struct table pmts[MAX_PMT_FILTERS];
+	int pmt_count;
+
+	struct program *programs;
+	int program_count;
+
+	struct transponder **toscan;
+	struct transponder **toscan_end;
+	struct transponder_set *known;
+	int queued;
+};
+
+static long now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000L + ts.tv_nsec / 1000000;
+}
+
+static char *dvbtext_to_utf8(uint8_t *text, int len)
+{
+	int consumed;
+	const char *charset = dvb_charset((char *) text, len, &consumed);
+	char *out = malloc((len * 3) + 1);
+	char *inbuf = (char *) text + consumed;
+	char *outbuf = out;
+	size_t inleft = len - consumed;
+	size_t outleft = len * 3;
+	iconv_t cd;
+
+	if (out == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+
+	if ((cd = iconv_open("UTF-8", charset)) != (iconv_t) -1) {
+		iconv(cd, &inbuf, &inleft, &outbuf, &outleft);
+		iconv_close(cd);
+	} else {
+		memcpy(out, inbuf, inleft);
+		outbuf += inleft;
+	}
+	*outbuf = 0;
+
+	return out;
+}
+
+static void process(struct scan *scan, struct table *table, uint8_t *buf, int len);
+
+static int table_file_section(void *private_data, uint8_t *data, int len)
+{
+	struct table *table = (struct table *) private_data;
+	uint8_t buf[4096];
+
+	// the codecs decode in place, and the demux's copy is shared
+	if (table->complete || (len > (int) sizeof(buf)))
+		return 0;
+	memcpy(buf, data, len);
+	process(table->scan, table, buf, len);
+	return 0;
+}
+
+static void table_start(struct scan *scan, struct table *table, uint16_t pid, uint8_t table_id,
+			int timeout)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+
+	memset(table, 0, sizeof(struct table));
+	table->scan = scan;
+	table->fd = -1;
+	table->pid = pid;
+	table->table_id = table_id;
+	table->version = -1;
+	table->deadline = now_ms() + (scan->timeout ? scan->timeout * 1000 : timeout);
+
+	if (scan->file) {
+		memset(filter, 0, sizeof(filter));
+		memset(mask, 0, sizeof(mask));
+		filter[0] = table_id;
+		mask[0] = 0xff;
+		table->start = dvbswdemux_file_position(scan->file);
+		if ((table->filter = dvbswdemux_add_section_filter(scan->swdemux, pid, filter, mask, 1,
+								   table_file_section, table)) == NULL) {
+			fprintf(stderr, "dvbscan: Failed to create filter for pid %i\n", pid);
+			table->complete = 1;
+		}
+		return;
+	}
+
+	if ((table->fd = create_section_filter(scan->adapter, scan->demux, pid, table_id)) < 0) {
+		fprintf(stderr, "dvbscan: Failed to create filter for pid %i: %m\n", pid);
+		table->complete = 1;
+		return;
+	}
+}
+
+static void table_stop(struct table *table)
+{
+	if (table->filter) {
+		dvbswdemux_remove_filter(table->scan->swdemux, table->filter);
+		table->filter = NULL;
+	}
+	if (table->fd >= 0) {
+		close(table->fd);
+		table->fd = -1;
+	}
+	table->complete = 1;
+}
+
+/*
+ * Account for one section of a table. Returns 1 if it is new and should be
+ * parsed; marks the table complete once every section has been seen.
+ */
+static int table_section(struct table *table, struct section_ext *ext)
+{
+	int i;
+
+	if (!ext->current_next_indicator)
+		return 0;
+
+	if ((ext->version_number != table->version) ||
+	    (ext->last_section_number != table->last_section)) {
+		memset(table->seen, 0, sizeof(table->seen));
+		table->version = ext->version_number;
+		table->last_section = ext->last_section_number;
+	}
+	if (table->seen[ext->section_number >> 3] & (1 << (ext->section_number & 7)))
+		return 0;
+	table->seen[ext->section_number >> 3] |= 1 << (ext->section_number & 7);
+
+	for(i=0; i <= table->last_section; i++) {
+		if (!(table->seen[i >> 3] & (1 << (i & 7))))
+			return 1;
+	}
+	table_stop(table);
+	return 1;
+}
+
+static void start_pmts(struct scan *scan)
+{
+	int i, j;
+
+	// one filter per PMT PID, however many programs share it
+	for(i=0; i < scan->program_count; i++) {
+		struct program *p = &scan->programs[i];
+
+		if (p->done)
+			continue;
+		for(j=0; j < scan->pmt_count; j++) {
+			if (scan->pmts[j].pid == p->pmt_pid)
+				break;
+		}
+		if (j < scan->pmt_count)
+			continue;
+
+		// the slot of a finished filter is reused before adding another
+		for(j=0; j < scan->pmt_count; j++) {
+			if (scan->pmts[j].complete)
+				break;
+		}
+		if (j == MAX_PMT_FILTERS)
+			return;
+		if (j == scan->pmt_count)
+			scan->pmt_count++;
+		table_start(scan, &scan->pmts[j], p->pmt_pid,
+			    stag_mpeg_program_map, TIMEOUT_PMT);
+	}
+}
+
+static void parse_pat(struct scan *scan, struct section_ext *ext)
+{
+	struct mpeg_pat_section *pat;
+	struct mpeg_pat_program *cur;
+
+	if ((pat = mpeg_pat_section_codec(ext)) == NULL)
+		return;
+	scan->t->transport_stream_id = mpeg_pat_section_transport_stream_id(pat);
+
+	mpeg_pat_section_programs_for_each(pat, cur) {
+		struct program *tmp;
+
+		int i;
+
+		if (cur->program_number == 0)
+			continue;
+		for(i=0; i < scan->program_count; i++) {
+			if (scan->programs[i].service->service_id == cur->program_number)
+				break;
+		}
+		if (i < scan->program_count)
+			continue;
+
+		tmp = realloc(scan->programs, sizeof(struct program) * (scan->program_count + 1));
+		if (tmp == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		scan->programs = tmp;
+		tmp = &scan->programs[scan->program_count++];
+		tmp->service = find_service(scan->t, cur->program_number, 1);
+		tmp->service->pmt_pid = cur->pid;
+		tmp->pmt_pid = cur->pid;
+		tmp->done = 0;
+	}
+}
+
+static void parse_ca_descriptor(struct service *s, struct descriptor *d)
+{
+	struct mpeg_ca_descriptor *dx;
+
+	if ((dx = mpeg_ca_descriptor_codec(d)) != NULL)
+		add_ca_id(s, dx->ca_system_id);
+}
+
+static void parse_pmt(struct scan *scan, struct table *table, struct section_ext *ext)
+{
+	struct mpeg_pmt_section *pmt;
+	struct mpeg_pmt_stream *cur_stream;
+	struct descriptor *curd;
+	struct program *p = NULL;
+	int i, pending = 0;
+
+	if ((pmt = mpeg_pmt_section_codec(ext)) == NULL)
+		return;
+	for(i=0; i < scan->program_count; i++) {
+		if ((scan->programs[i].pmt_pid == table->pid) &&
+		    (scan->programs[i].service->service_id == mpeg_pmt_section_program_number(pmt)) &&
+		    !scan->programs[i].done)
+			p = &scan->programs[i];
+	}
+	if (p == NULL)
+		return;
+
+	p->service->pcr_pid = pmt->pcr_pid;
+	mpeg_pmt_section_descriptors_for_each(pmt, curd) {
+		if (curd->tag == dtag_mpeg_ca)
+			parse_ca_descriptor(p->service, curd);
+	}
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		uint8_t *language = NULL;
+
+		mpeg_pmt_stream_descriptors_for_each(cur_stream, curd) {
+			struct mpeg_iso_639_language_descriptor *dx;
+			struct mpeg_iso_639_language_code *lang;
+
+			switch(curd->tag) {
+			case dtag_mpeg_ca:
+				parse_ca_descriptor(p->service, curd);
+				break;
+
+			case dtag_mpeg_iso_639_language:
+				if ((dx = mpeg_iso_639_language_descriptor_codec(curd)) == NULL)
+					break;
+				mpeg_iso_639_language_descriptor_languages_for_each(dx, lang) {
+					language = lang->language_code;
+					break;
+				}
+				break;
+			}
+		}
+		add_stream(p->service, cur_stream->stream_type, language);
+	}
+	p->done = 1;
+
+	// the filter is finished once all the programs sharing its PID are
+	for(i=0; i < scan->program_count; i++) {
+		if ((scan->programs[i].pmt_pid == table->pid) && !scan->programs[i].done)
+			pending = 1;
+	}
+	if (!pending) {
+		table_stop(table);
+		start_pmts(scan);
+	}
+}
+
+static void parse_sdt(struct scan *scan, struct section_ext *ext)
 {
-	(void)fe; // FIXME
+	struct dvb_sdt_section *sdt;
+	struct dvb_sdt_service *cur;
+	struct descriptor *curd;
+
+	if ((sdt = dvb_sdt_section_codec(ext)) == NULL)
+		return;
+	scan->t->original_network_id = sdt->original_network_id;
+
+	dvb_sdt_section_services_for_each(sdt, cur) {
+		struct service *s = find_service(scan->t, cur->service_id, 1);
+
+		s->is_scrambled = cur->free_ca_mode;
+		dvb_sdt_service_descriptors_for_each(cur, curd) {
+			struct dvb_service_descriptor *dx;
+			struct dvb_service_descriptor_part2 *part2;
+
+			if (curd->tag != dtag_dvb_service)
+				continue;
+			if ((dx = dvb_service_descriptor_codec(curd)) == NULL)
+				continue;
+			part2 = dvb_service_descriptor_part2(dx);
+
+			if (s->provider_name)
+				free(s->provider_name);
+			if (s->service_name)
+				free(s->service_name);
+			s->provider_name = dvbtext_to_utf8(dvb_service_descriptor_service_provider_name(dx),
+							   dx->service_provider_name_length);
+			s->service_name = dvbtext_to_utf8(dvb_service_descriptor_service_name(part2),
+							  part2->service_name_length);
+		}
+	}
+}
+
+static enum dvbfe_code_rate fec_inner(int fec)
+{
+	switch(fec) {
+	case 1: return DVBFE_FEC_1_2;
+	case 2: return DVBFE_FEC_2_3;
+	case 3: return DVBFE_FEC_3_4;
+	case 4: return DVBFE_FEC_5_6;
+	case 5: return DVBFE_FEC_7_8;
+	case 6: return DVBFE_FEC_8_9;
+	case 7: return DVBFE_FEC_3_5;
+	case 8: return DVBFE_FEC_4_5;
+	case 9: return DVBFE_FEC_9_10;
+	case 15: return DVBFE_FEC_NONE;
+	}
+	return DVBFE_FEC_AUTO;
+}
+
+static enum dvbfe_code_rate fec_terrestrial(int fec)
+{
+	switch(fec) {
+	case 0: return DVBFE_FEC_1_2;
+	case 1: return DVBFE_FEC_2_3;
+	case 2: return DVBFE_FEC_3_4;
+	case 3: return DVBFE_FEC_5_6;
+	case 4: return DVBFE_FEC_7_8;
+	}
+	return DVBFE_FEC_AUTO;
+}
+
+/*
+ * Fill in the tuning parameters of a transponder from a delivery system
+ * descriptor. Returns 0 if the descriptor is for the frontend's type.
+ */
+static int parse_delivery(struct scan *scan, struct transponder *t, struct descriptor *d)
+{
+	static const enum dvbfe_dvbc_mod cable_mod[] = {
+		DVBFE_DVBC_MOD_AUTO, DVBFE_DVBC_MOD_QAM_16, DVBFE_DVBC_MOD_QAM_32,
+		DVBFE_DVBC_MOD_QAM_64, DVBFE_DVBC_MOD_QAM_128, DVBFE_DVBC_MOD_QAM_256,
+	};
+	static const enum dvbfe_dvbt_bandwidth bandwidth[] = {
+		DVBFE_DVBT_BANDWIDTH_8_MHZ, DVBFE_DVBT_BANDWIDTH_7_MHZ,
+		DVBFE_DVBT_BANDWIDTH_6_MHZ, DVBFE_DVBT_BANDWIDTH_5_MHZ,
+	};
+	static const enum dvbfe_dvbt_const constellation[] = {
+		DVBFE_DVBT_CONST_QPSK, DVBFE_DVBT_CONST_QAM_16,
+		DVBFE_DVBT_CONST_QAM_64, DVBFE_DVBT_CONST_AUTO,
+	};
+	static const enum dvbfe_dvbt_guard_interval guard[] = {
+		DVBFE_DVBT_GUARD_INTERVAL_1_32, DVBFE_DVBT_GUARD_INTERVAL_1_16,
+		DVBFE_DVBT_GUARD_INTERVAL_1_8, DVBFE_DVBT_GUARD_INTERVAL_1_4,
+	};
+	static const enum dvbfe_dvbt_transmit_mode transmission_mode[] = {
+		DVBFE_DVBT_TRANSMISSION_MODE_2K, DVBFE_DVBT_TRANSMISSION_MODE_8K,
+		DVBFE_DVBT_TRANSMISSION_MODE_AUTO, DVBFE_DVBT_TRANSMISSION_MODE_AUTO,
+	};
+	static const enum dvbfe_dvbt_hierarchy hierarchy[] = {
+		DVBFE_DVBT_HIERARCHY_NONE, DVBFE_DVBT_HIERARCHY_1,
+		DVBFE_DVBT_HIERARCHY_2, DVBFE_DVBT_HIERARCHY_4,
+	};
+	static const enum dvbsec_diseqc_polarization polarization[] = {
+		DISEQC_POLARIZATION_H, DISEQC_POLARIZATION_V,
+		DISEQC_POLARIZATION_L, DISEQC_POLARIZATION_R,
+	};
+	static const enum dvbfe_dvbs_rolloff rolloff[] = {
+		DVBFE_DVBS_ROLLOFF_35, DVBFE_DVBS_ROLLOFF_25,
+		DVBFE_DVBS_ROLLOFF_20, DVBFE_DVBS_ROLLOFF_AUTO,
+	};
+	static const enum dvbfe_dvbs_mod dvbs_mod[] = {
+		DVBFE_DVBS_MOD_AUTO, DVBFE_DVBS_MOD_QPSK,
+		DVBFE_DVBS_MOD_8PSK, DVBFE_DVBS_MOD_AUTO,
+	};
+
+	switch(d->tag) {
+	case dtag_dvb_satellite_delivery_system:
+	{
+		struct dvb_satellite_delivery_descriptor *dx;
+		int position;
+
+		if ((scan->type != DVBFE_TYPE_DVBS) ||
+		    ((dx = dvb_satellite_delivery_descriptor_codec(d)) == NULL))
+			return -1;
+		add_frequency(t, bcd_to_integer(dx->frequency) * 10);
+		position = bcd_to_integer(dx->orbital_position);
+		t->oribital_position = dx->west_east_flag ? position : -position;
+		t->polarization = polarization[dx->polarization];
+		t->params.inversion = DVBFE_INVERSION_AUTO;
+		t->params.u.dvbs.symbol_rate = bcd_to_integer(dx->symbol_rate) * 100;
+		t->params.u.dvbs.fec_inner = fec_inner(dx->fec_inner);
+		if (dx->modulation_system) {
+			t->params.delivery_system = DVBFE_DELSYS_DVBS2;
+			t->params.stream_id = DVBFE_STREAM_ID_NONE;
+			t->params.u.dvbs.modulation = dvbs_mod[dx->modulation_type];
+			t->params.u.dvbs.rolloff = rolloff[dx->roll_off];
+			t->params.u.dvbs.pilot = DVBFE_DVBS_PILOT_AUTO;
+		}
+		return 0;
+	}
+
+	case dtag_dvb_cable_delivery_system:
+	{
+		struct dvb_cable_delivery_descriptor *dx;
+
+		if ((scan->type != DVBFE_TYPE_DVBC) ||
+		    ((dx = dvb_cable_delivery_descriptor_codec(d)) == NULL))
+			return -1;
+		add_frequency(t, bcd_to_integer(dx->frequency) * 100);
+		t->params.inversion = DVBFE_INVERSION_AUTO;
+		t->params.u.dvbc.symbol_rate = bcd_to_integer(dx->symbol_rate) * 100;
+		t->params.u.dvbc.fec_inner = fec_inner(dx->fec_inner);
+		t->params.u.dvbc.modulation = (dx->modulation < 6) ?
+			cable_mod[dx->modulation] : DVBFE_DVBC_MOD_AUTO;
+		return 0;
+	}
+
+	case dtag_dvb_terrestial_delivery_system:
+	{
+		struct dvb_terrestrial_delivery_descriptor *dx;
+
+		if ((scan->type != DVBFE_TYPE_DVBT) ||
+		    ((dx = dvb_terrestrial_delivery_descriptor_codec(d)) == NULL))
+			return -1;
+		add_frequency(t, dx->centre_frequency * 10);
+		t->params.inversion = DVBFE_INVERSION_AUTO;
+		t->params.u.dvbt.bandwidth = (dx->bandwidth < 4) ?
+			bandwidth[dx->bandwidth] : DVBFE_DVBT_BANDWIDTH_AUTO;
+		t->params.u.dvbt.code_rate_HP = fec_terrestrial(dx->code_rate_hp_stream);
+		t->params.u.dvbt.code_rate_LP = fec_terrestrial(dx->code_rate_lp_stream);
+		t->params.u.dvbt.constellation = constellation[dx->constellation];
+		t->params.u.dvbt.transmission_mode = transmission_mode[dx->transmission_mode];
+		t->params.u.dvbt.guard_interval = guard[dx->guard_interval];
+		t->params.u.dvbt.hierarchy_information = hierarchy[dx->hierarchy_information & 3];
+		return 0;
+	}
+	}
+
+	return -1;
+}
+
+static void parse_frequency_list(struct transponder *t, struct descriptor *d)
+{
+	struct dvb_frequency_list_descriptor *dx;
+	uint8_t *freqs;
+	uint32_t freq;
+	int i;
+
+	if ((dx = dvb_frequency_list_descriptor_codec(d)) == NULL)
+		return;
+	freqs = (uint8_t *) dvb_frequency_list_descriptor_centre_frequencies(dx);
+	for(i=0; i < dvb_frequency_list_descriptor_centre_frequencies_count(dx); i++) {
+		memcpy(&freq, freqs + (i * 4), 4);
+		switch(dx->coding_type) {
+		case DVB_CODING_TYPE_SATELLITE:
+			add_frequency(t, bcd_to_integer(freq) * 10);
+			break;
+		case DVB_CODING_TYPE_CABLE:
+			add_frequency(t, bcd_to_integer(freq) * 100);
+			break;
+		case DVB_CODING_TYPE_TERRESTRIAL:
+			add_frequency(t, freq * 10);
+			break;
+		}
+	}
+}
+
+static void parse_nit(struct scan *scan, struct section_ext *ext)
+{
+	struct dvb_nit_section *nit;
+	struct dvb_nit_section_part2 *part2;
+	struct dvb_nit_transport *cur;
+	struct descriptor *curd;
+
+	if ((nit = dvb_nit_section_codec(ext)) == NULL)
+		return;
+	scan->t->network_id = dvb_nit_section_network_id(nit);
+
+	part2 = dvb_nit_section_part2(nit);
+	dvb_nit_section_transports_for_each(nit, part2, cur) {
+		struct transponder *t;
+		int delivery = -1;
+
+		// the SDT giving our own original_network_id may not be in yet
+		if ((cur->transport_stream_id == scan->t->transport_stream_id) &&
+		    ((cur->original_network_id == scan->t->original_network_id) ||
+		     (scan->t->original_network_id == 0)))
+			continue;
+
+		t = new_transponder();
+		t->network_id = scan->t->network_id;
+		t->original_network_id = cur->original_network_id;
+		t->transport_stream_id = cur->transport_stream_id;
+		dvb_nit_transport_descriptors_for_each(cur, curd) {
+			if (parse_delivery(scan, t, curd) == 0)
+				delivery = 0;
+		}
+		// the alternative frequencies go after the main one
+		dvb_nit_transport_descriptors_for_each(cur, curd) {
+			if ((delivery == 0) && (curd->tag == dtag_dvb_frequency_list))
+				parse_frequency_list(t, curd);
+		}
+
+		// queue it straight away: the next tune need not wait for this one
+		if ((delivery < 0) || (t->frequency_count == 0) ||
+		    transponder_set_contains(scan->known, t)) {
+			free_transponder(t);
+			continue;
+		}
+		transponder_set_add(scan->known, t);
+		append_transponder(t, scan->toscan, scan->toscan_end);
+		scan->queued++;
+	}
+}
+
+static void process(struct scan *scan, struct table *table, uint8_t *buf, int len)
+{
+	struct section *section;
+	struct section_ext *ext;
+
+	if (((section = section_codec(buf, len)) == NULL) ||
+	    ((ext = section_ext_decode(section, 0)) == NULL) ||
+	    (section->table_id != table->table_id))
+		return;
+
+	if (table == &scan->pat) {
+		if (!table_section(table, ext))
+			return;
+		parse_pat(scan, ext);
+		if (table->complete)
+			start_pmts(scan);
+	} else if (table == &scan->sdt) {
+		if (table_section(table, ext))
+			parse_sdt(scan, ext);
+	} else if (table == &scan->nit) {
+		if (table_section(table, ext))
+			parse_nit(scan, ext);
+	} else {
+		parse_pmt(scan, table, ext);
+	}
+}
+
+static void read_table(struct scan *scan, struct table *table)
+{
+	uint8_t buf[4096];
+	int len;
+
+	if ((len = read(table->fd, buf, sizeof(buf))) < 0) {
+		if (errno != EOVERFLOW && errno != EAGAIN && errno != EINTR) {
+			fprintf(stderr, "dvbscan: Read error on pid %i: %m\n", table->pid);
+			table_stop(table);
+		}
+		return;
+	}
+	process(scan, table, buf, len);
+}
+
+static int table_expired(struct scan *scan, struct table *table, long now)
+{
+	if (scan->file)
+		return (dvbswdemux_file_position(scan->file) - table->start) >=
+			dvbswdemux_file_size(scan->file);
+	return now >= table->deadline;
+}
+
+static void scan_tables(struct scan *scan);
+
+void dvbscan_scan_dvb(struct dvbfe_handle *fe, int adapter, int demux, int timeout,
+		      struct transponder *t,
+		      struct transponder **toscan, struct transponder **toscan_end,
+		      struct transponder_set *known)
+{
+	struct dvbfe_info feinfo;
+	struct scan scan;
+
+	memset(&scan, 0, sizeof(scan));
+	if (dvbfe_get_info(fe, 0, &feinfo, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) != 0)
+		return;
+	scan.t = t;
+	scan.type = feinfo.type;
+	scan.adapter = adapter;
+	scan.demux = demux;
+	scan.timeout = timeout;
+	scan.toscan = toscan;
+	scan.toscan_end = toscan_end;
+	scan.known = known;
+	scan_tables(&scan);
+}
+
+int dvbscan_scan_file(const char *filename, enum dvbfe_type type,
+		      struct transponder *t,
+		      struct transponder **toscan, struct transponder **toscan_end,
+		      struct transponder_set *known)
+{
+	struct scan scan;
+
+	memset(&scan, 0, sizeof(scan));
+	scan.t = t;
+	scan.type = type;
+	scan.toscan = toscan;
+	scan.toscan_end = toscan_end;
+	scan.known = known;
+	if ((scan.swdemux = dvbswdemux_create()) == NULL)
+		return -1;
+	if ((scan.file = dvbswdemux_file_open(filename, scan.swdemux, 0)) == NULL) {
+		fprintf(stderr, "dvbscan: Could not read %s: %m\n", filename);
+		dvbswdemux_destroy(scan.swdemux);
+		return -1;
+	}
+
+	scan_tables(&scan);
+
+	dvbswdemux_file_close(scan.file);
+	dvbswdemux_destroy(scan.swdemux);
+	return 0;
+}
+
+static void scan_tables(struct scan *scan)
+{
+	struct pollfd pollfds[3 + MAX_PMT_FILTERS];
+	struct table *tables[3 + MAX_PMT_FILTERS];
+	struct transponder *t = scan->t;
+	struct service *s;
+	int count, i;
+
+	table_start(scan, &scan->pat, TRANSPORT_PAT_PID, stag_mpeg_program_association, TIMEOUT_PAT);
+	table_start(scan, &scan->sdt, TRANSPORT_SDT_PID, stag_dvb_service_description_actual, TIMEOUT_SDT);
+	table_start(scan, &scan->nit, TRANSPORT_NIT_PID, stag_dvb_network_information_actual, TIMEOUT_NIT);
+
+	while(1) {
+		long now = now_ms();
+		long wait = -1;
+
+		// gather the tables still outstanding, dropping the ones timed out
+		count = 0;
+		for(i=0; i < 3 + scan->pmt_count; i++) {
+			struct table *table = (i < 3) ? (&scan->pat + i) : &scan->pmts[i - 3];
+
+			if (table->complete)
+				continue;
+			if (table_expired(scan, table, now)) {
+				table_stop(table);
+				if (table == &scan->pat)
+					start_pmts(scan);
+				else if (i >= 3) {
+					int j;
+					for(j=0; j < scan->program_count; j++) {
+						if (scan->programs[j].pmt_pid == table->pid)
+							scan->programs[j].done = 1;
+					}
+					start_pmts(scan);
+				}
+				continue;
+			}
+			if ((wait < 0) || ((table->deadline - now) < wait))
+				wait = table->deadline - now;
+			tables[count] = table;
+			pollfds[count].fd = table->fd;
+			pollfds[count].events = POLLIN;
+			count++;
+		}
+		if (count == 0)
+			break;
+
+		if (scan->file) {
+			if (dvbswdemux_file_feed(scan->file) < 0) {
+				fprintf(stderr, "dvbscan: Out of memory\n");
+				break;
+			}
+			continue;
+		}
+		if (poll(pollfds, count, wait) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "dvbscan: Poll failed: %m\n");
+			break;
+		}
+		for(i=0; i < count; i++) {
+			if (pollfds[i].revents & (POLLIN | POLLPRI | POLLERR))
+				read_table(scan, tables[i]);
+		}
+	}
+
+	table_stop(&scan->pat);
+	table_stop(&scan->sdt);
+	table_stop(&scan->nit);
+	for(i=0; i < scan->pmt_count; i++)
+		table_stop(&scan->pmts[i]);
+	free(scan->programs);
+
+	count = 0;
+	for(s = t->services; s; s = s->next)
+		count++;
+	fprintf(stderr, "dvbscan: tsid 0x%04x onid 0x%04x: %i services, %i new transponders\n",
+		t->transport_stream_id, t->original_network_id, count, scan->queued);
 }
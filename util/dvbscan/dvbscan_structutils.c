@@ -49,9 +49,15 @@ struct transponder *new_transponder(void)
 
 void free_transponder(struct transponder *t)
 {
+	struct service *s = t->services;
+
+	while(s) {
+		struct service *next = s->next;
+		free_service(s);
+		s = next;
+	}
 	if (t->frequencies)
 		free(t->frequencies);
-	// FIXME: free services
 	free(t);
 }
 
@@ -78,13 +84,135 @@ void add_frequency(struct transponder *t, uint32_t frequency)
 {
 	uint32_t *tmp;
 
-	tmp = (uint32_t*) realloc(t->frequencies, sizeof(uint32_t) * (t->frequency_count + 1));
-	if (tmp == NULL) {
-		fprintf(stderr, "Out of memory\n");
-		exit(1);
+	if (t->frequency_count == t->frequency_alloc) {
+		uint32_t alloc = t->frequency_alloc ? t->frequency_alloc * 2 : 4;
+
+		tmp = (uint32_t*) realloc(t->frequencies, sizeof(uint32_t) * alloc);
+		if (tmp == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		t->frequencies = tmp;
+		t->frequency_alloc = alloc;
+	}
+	t->frequencies[t->frequency_count++] = frequency;
+}
+
+static uint64_t transponder_key(struct transponder_set *set, struct transponder *t,
+				uint32_t frequency)
+{
+	uint64_t key;
+	uint32_t symbol_rate = 0;
+
+	switch(set->type) {
+	case DVBFE_TYPE_DVBS:
+		symbol_rate = t->params.u.dvbs.symbol_rate;
+		break;
+	case DVBFE_TYPE_DVBC:
+		symbol_rate = t->params.u.dvbc.symbol_rate;
+		break;
+	default:
+		break;
 	}
-	tmp[t->frequency_count++] = frequency;
-	t->frequencies = tmp;
+
+	key = frequency / 2000;
+	key |= (uint64_t) (t->polarization & 0xff) << 32;
+	key |= (uint64_t) ((symbol_rate / 100000) & 0x3fff) << 40;
+	key |= (uint64_t) (t->params.delivery_system & 0x7f) << 54;
+	key |= 1ULL << 63;		// never 0, which marks an empty slot
+
+	return key;
+}
+
+static uint32_t transponder_hash(uint64_t key, uint32_t size)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+
+	return (uint32_t) key & (size - 1);
+}
+
+static int transponder_set_insert(struct transponder_set *set, uint64_t key)
+{
+	uint32_t pos = transponder_hash(key, set->size);
+
+	while(set->keys[pos]) {
+		if (set->keys[pos] == key)
+			return 0;
+		pos = (pos + 1) & (set->size - 1);
+	}
+	set->keys[pos] = key;
+	set->count++;
+
+	return 1;
+}
+
+void transponder_set_init(struct transponder_set *set, enum dvbfe_type type)
+{
+	memset(set, 0, sizeof(struct transponder_set));
+	set->type = type;
+}
+
+void transponder_set_free(struct transponder_set *set)
+{
+	if (set->keys)
+		free(set->keys);
+	set->keys = NULL;
+	set->size = 0;
+	set->count = 0;
+}
+
+void transponder_set_add(struct transponder_set *set, struct transponder *t)
+{
+	uint32_t i;
+
+	// keep the load under a half, so the probe sequences stay short
+	if ((set->count + t->frequency_count) * 2 > set->size) {
+		uint64_t *old = set->keys;
+		uint32_t old_size = set->size;
+		uint32_t size = set->size ? set->size : 64;
+
+		while((set->count + t->frequency_count) * 2 > size)
+			size *= 2;
+		set->keys = (uint64_t*) calloc(size, sizeof(uint64_t));
+		if (set->keys == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+		set->size = size;
+		set->count = 0;
+		for(i=0; i < old_size; i++) {
+			if (old[i])
+				transponder_set_insert(set, old[i]);
+		}
+		if (old)
+			free(old);
+	}
+
+	for(i=0; i < t->frequency_count; i++)
+		transponder_set_insert(set, transponder_key(set, t, t->frequencies[i]));
+}
+
+int transponder_set_contains(struct transponder_set *set, struct transponder *t)
+{
+	uint32_t i;
+
+	if (set->size == 0)
+		return 0;
+
+	for(i=0; i < t->frequency_count; i++) {
+		uint64_t key = transponder_key(set, t, t->frequencies[i]);
+		uint32_t pos = transponder_hash(key, set->size);
+
+		while(set->keys[pos]) {
+			if (set->keys[pos] == key)
+				return 1;
+			pos = (pos + 1) & (set->size - 1);
+		}
+	}
+
+	return 0;
 }
 
 struct transponder *first_transponder(struct transponder **tlist, struct transponder **tlist_end)
@@ -97,3 +225,96 @@ struct transponder *first_transponder(struct transponder **tlist, struct transpo
 
 	return t;
 }
+
+struct service *new_service(uint16_t service_id)
+{
+	struct service *s = (struct service *) malloc(sizeof(struct service));
+	if (s == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memset(s, 0, sizeof(struct service));
+	s->service_id = service_id;
+	s->bbc_channel_number = -1;
+
+	return s;
+}
+
+void free_service(struct service *s)
+{
+	struct stream *cur = s->streams;
+
+	while(cur) {
+		struct stream *next = cur->next;
+		free(cur);
+		cur = next;
+	}
+	if (s->provider_name)
+		free(s->provider_name);
+	if (s->service_name)
+		free(s->service_name);
+	if (s->ca_ids)
+		free(s->ca_ids);
+	free(s);
+}
+
+struct service *find_service(struct transponder *t, uint16_t service_id, int create)
+{
+	struct service *s;
+
+	for(s = t->services; s; s = s->next) {
+		if (s->service_id == service_id)
+			return s;
+	}
+	if (!create)
+		return NULL;
+
+	s = new_service(service_id);
+	if (t->services_end == NULL) {
+		t->services = s;
+	} else {
+		t->services_end->next = s;
+	}
+	t->services_end = s;
+
+	return s;
+}
+
+void add_stream(struct service *s, uint8_t stream_type, iso639lang_t language)
+{
+	struct stream *str = (struct stream *) malloc(sizeof(struct stream));
+	if (str == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	memset(str, 0, sizeof(struct stream));
+	str->stream_type = stream_type;
+	if (language)
+		memcpy(str->language, language, sizeof(iso639lang_t));
+
+	if (s->streams_end == NULL) {
+		s->streams = str;
+	} else {
+		s->streams_end->next = str;
+	}
+	s->streams_end = str;
+}
+
+void add_ca_id(struct service *s, uint16_t ca_id)
+{
+	uint16_t *tmp;
+	uint32_t i;
+
+	for(i=0; i < s->ca_ids_count; i++) {
+		if (s->ca_ids[i] == ca_id)
+			return;
+	}
+
+	tmp = (uint16_t*) realloc(s->ca_ids, sizeof(uint16_t) * (s->ca_ids_count + 1));
+	if (tmp == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	tmp[s->ca_ids_count++] = ca_id;
+	s->ca_ids = tmp;
+}
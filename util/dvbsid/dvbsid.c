@@ -0,0 +1,468 @@
+/*
+	dvbsid utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <poll.h>
+#include <libdvbapi/dvbsecfilter.h>
+#include <libdvbapi/dvbsistore.h>
+#include <libucsi/section_view.h>
+#include <libucsi/si_table.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/dvb/section.h>
+
+#define DEFAULT_FILTERS		8
+#define DEFAULT_SLOTS		1024
+#define DEFAULT_DATA_MB		8
+#define MAX_POLLFDS		(64 + 64 + 1)
+
+/**
+ * A table being collected: the sections of its latest version so far.
+ */
+struct table {
+	int pid;
+	int table_id;
+	int table_id_ext;
+	enum dvbsistore_kind kind;
+	int version;			// being collected, -1 => none
+	int published;			// -1 => none yet
+	int have;
+	int last_section;
+	uint8_t *sections[256];
+	int lens[256];
+};
+
+/**
+ * What a section filter want is for.
+ */
+struct want {
+	int id;
+	int pid;
+	int table_id;
+	enum dvbsistore_kind kind;
+};
+
+static struct dvbsecfilter *sf;
+static struct dvbsistore *store;
+static struct table *tables;
+static int table_count;
+static int table_alloc;
+static struct want *pmt_wants;
+static int pmt_want_count;
+static struct si_pat_program *new_programs;	// of a new PAT, for the main loop
+static int new_program_count = -1;
+static int transport_stream_id = -1;
+static int verbose;
+static volatile int stop;
+
+// the tables which are always there; the PMTs follow the PAT
+static struct want fixed_wants[] = {
+	{ -1, TRANSPORT_PAT_PID, 0x00, DVBSISTORE_PAT },
+	{ -1, TRANSPORT_NIT_PID, 0x40, DVBSISTORE_NIT },
+	{ -1, TRANSPORT_SDT_PID, 0x42, DVBSISTORE_SDT },
+	{ -1, TRANSPORT_TDT_PID, 0x70, DVBSISTORE_TDT },
+	{ -1, TRANSPORT_TDT_PID, 0x73, DVBSISTORE_TOT },
+	{ -1, TRANSPORT_EIT_PID, 0x4e, DVBSISTORE_EIT },
+};
+#define FIXED_WANTS (sizeof(fixed_wants) / sizeof(fixed_wants[0]))
+
+static void usage(void)
+{
+	static const char *_usage =
+		"\n"
+		" dvbsid: Keep the SI tables of a demux in shared memory for other programs\n"
+		"\n"
+		" usage: dvbsid <options>\n"
+		" -a <adapter>		Adapter to use (default 0)\n"
+		" -d <demux>		Demux to use (default 0)\n"
+		" -filters <count>	Most section filters to use (default 8)\n"
+		" -noeit		Do not collect the present/following EIT\n"
+		" -slots <count>		Tables the store can hold (default 1024)\n"
+		" -mb <MB>		Size of the store's data (default 8)\n"
+		" -v			Report each table version published\n"
+		"\n"
+		" Whatever the adapter is tuned to, the PAT, the PMTs it lists, the NIT,\n"
+		" SDT and present/following EIT of the multiplex, the TDT and TOT are\n"
+		" collected, each through one section filter however many programs read\n"
+		" it. Every new version is published raw and decoded into\n"
+		" " DVBSISTORE_DIR "/dvbsi-<adapter>.<demux>, and programs subscribed on\n"
+		" " DVBSISTORE_SOCKET_DIR "/dvbsi-<adapter>.<demux>.sock are woken through an\n"
+		" eventfd (see libdvbapi/dvbsistore.h).\n";
+	fprintf(stderr, "%s\n", _usage);
+
+	exit(1);
+}
+
+static void signal_handler(int _signal)
+{
+	(void) _signal;
+
+	stop = 1;
+}
+
+static void table_clear(struct table *t)
+{
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		free(t->sections[i]);
+		t->sections[i] = NULL;
+	}
+	t->have = 0;
+	t->version = -1;
+}
+
+static struct table *table_get(int pid, int table_id, int table_id_ext, enum dvbsistore_kind kind)
+{
+	struct table *t;
+	int i;
+
+	for (i = 0; i < table_count; i++) {
+		t = &tables[i];
+		if ((t->pid == pid) && (t->table_id == table_id) && (t->table_id_ext == table_id_ext))
+			return t;
+	}
+
+	if (table_count == table_alloc) {
+		int count = table_alloc ? table_alloc * 2 : 64;
+
+		if ((t = realloc(tables, count * sizeof(struct table))) == NULL)
+			return NULL;
+		tables = t;
+		table_alloc = count;
+	}
+	t = &tables[table_count++];
+	memset(t, 0, sizeof(struct table));
+	t->pid = pid;
+	t->table_id = table_id;
+	t->table_id_ext = table_id_ext;
+	t->kind = kind;
+	t->version = -1;
+	t->published = -1;
+	return t;
+}
+
+/**
+ * Forget every table, on a new multiplex.
+ */
+static void tables_reset(void)
+{
+	int i;
+
+	for (i = 0; i < table_count; i++)
+		table_clear(&tables[i]);
+	table_count = 0;
+	dvbsistore_reset(store);
+}
+
+static void section_callback(void *arg, int id, uint8_t *section, int len);
+
+static void publish(struct table *t, uint8_t *raw, int raw_len, struct si_table *decoded)
+{
+	struct dvbsistore_info info;
+	uint32_t decoded_len = 0;
+
+	memset(&info, 0, sizeof(info));
+	info.pid = t->pid;
+	info.table_id = t->table_id;
+	info.table_id_ext = t->table_id_ext;
+	info.kind = t->kind;
+	info.version = t->version;
+
+	if (decoded) {
+		decoded_len = decoded->size;
+		si_table_rebase(decoded, decoded, NULL);
+	}
+	if (dvbsistore_publish(store, &info, raw, raw_len, decoded, decoded_len)) {
+		fprintf(stderr, "Failed to publish table 0x%02x/%i on PID %i: %m\n",
+			t->table_id, t->table_id_ext, t->pid);
+		return;
+	}
+	if (verbose && (t->kind != DVBSISTORE_TDT) && (t->kind != DVBSISTORE_TOT))
+		fprintf(stderr, "Published table 0x%02x/%i on PID %i version %i (%i bytes)\n",
+			t->table_id, t->table_id_ext, t->pid, t->version, raw_len);
+}
+
+/**
+ * A version is complete: put its sections together, decode them and
+ * publish both.
+ */
+static void table_complete(struct table *t)
+{
+	struct section_view views[256];
+	struct si_table *decoded;
+	uint8_t *raw;
+	int raw_len = 0;
+	int count = 0;
+	int i;
+
+	for (i = 0; i <= t->last_section; i++)
+		raw_len += t->lens[i];
+	if ((raw = malloc(raw_len)) == NULL)
+		return;
+	raw_len = 0;
+	for (i = 0; i <= t->last_section; i++) {
+		memcpy(raw + raw_len, t->sections[i], t->lens[i]);
+		section_view_init(&views[count++], raw + raw_len, t->lens[i]);
+		raw_len += t->lens[i];
+	}
+
+	decoded = si_table_decode(views, count);
+	t->published = t->version;
+
+	// a new multiplex starts from nothing, then the PMTs follow the PAT
+	if (t->kind == DVBSISTORE_PAT) {
+		if ((transport_stream_id != -1) && (transport_stream_id != t->table_id_ext)) {
+			int version = t->version;
+			int tsid = t->table_id_ext;
+
+			tables_reset();
+			if ((t = table_get(TRANSPORT_PAT_PID, 0x00, tsid, DVBSISTORE_PAT)) == NULL)
+				goto out;
+			t->version = t->published = version;
+		}
+		transport_stream_id = t->table_id_ext;
+		if (decoded) {
+			free(new_programs);
+			if ((new_programs = malloc((decoded->count + 1) * sizeof(struct si_pat_program))) != NULL) {
+				memcpy(new_programs, decoded->programs,
+				       decoded->count * sizeof(struct si_pat_program));
+				new_program_count = decoded->count;
+			}
+		}
+	}
+	publish(t, raw, raw_len, decoded);
+
+out:
+	free(decoded);
+	free(raw);
+	table_clear(t);
+}
+
+/**
+ * Read the PMTs of the programs of a new PAT. Not from a section callback,
+ * as the filters are changed.
+ */
+static void pmts_update(void)
+{
+	struct want *wants;
+	int i;
+
+	for (i = 0; i < pmt_want_count; i++)
+		dvbsecfilter_remove(sf, pmt_wants[i].id);
+	pmt_want_count = 0;
+
+	// the wants are the callbacks' arguments, so are not moved while in use
+	free(pmt_wants);
+	if ((pmt_wants = wants = malloc((new_program_count + 1) * sizeof(struct want))) == NULL)
+		goto out;
+	for (i = 0; i < new_program_count; i++) {
+		struct want *w = &wants[pmt_want_count];
+
+		if (new_programs[i].program_number == 0)
+			continue;
+		w->pid = new_programs[i].pid;
+		w->table_id = 0x02;
+		w->kind = DVBSISTORE_PMT;
+		w->id = dvbsecfilter_add(sf, w->pid, 0x02, new_programs[i].program_number, -1,
+					 section_callback, w);
+		if (w->id != -1)
+			pmt_want_count++;
+	}
+	if (dvbsecfilter_commit(sf) < 0)
+		fprintf(stderr, "Failed to set the section filters for the PMTs: %m\n");
+
+out:
+	free(new_programs);
+	new_programs = NULL;
+	new_program_count = -1;
+}
+
+static void section_callback(void *arg, int id, uint8_t *section, int len)
+{
+	struct want *w = arg;
+	struct section_view view;
+	struct table *t;
+	int number;
+
+	(void) id;
+	if (section_view_init(&view, section, len))
+		return;
+
+	// the time tables have no versions: each one is news
+	if (!section_view_is_ext(&view)) {
+		if ((t = table_get(w->pid, section_view_table_id(&view), 0, w->kind)) == NULL)
+			return;
+		t->version = 0;
+		publish(t, section, len, NULL);
+		return;
+	}
+	if (!section_view_current_next_indicator(&view))
+		return;
+
+	t = table_get(w->pid, section_view_table_id(&view), section_view_table_id_ext(&view), w->kind);
+	if ((t == NULL) || (section_view_version_number(&view) == t->published))
+		return;
+	if (section_view_version_number(&view) != t->version) {
+		table_clear(t);
+		t->version = section_view_version_number(&view);
+		t->last_section = section_view_last_section_number(&view);
+	}
+
+	number = section_view_section_number(&view);
+	if ((number > t->last_section) || t->sections[number])
+		return;
+	if ((t->sections[number] = malloc(len)) == NULL)
+		return;
+	memcpy(t->sections[number], section, len);
+	t->lens[number] = len;
+	if (++t->have == t->last_section + 1)
+		table_complete(t);
+}
+
+int main(int argc, char *argv[])
+{
+	struct pollfd pollfds[MAX_POLLFDS];
+	int argpos = 1;
+	int adapter = 0;
+	int demux = 0;
+	int filters = DEFAULT_FILTERS;
+	int slots = DEFAULT_SLOTS;
+	int data_mb = DEFAULT_DATA_MB;
+	int eit = 1;
+	unsigned int i;
+
+	while(argpos != argc) {
+		if (!strcmp(argv[argpos], "-h")) {
+			usage();
+		} else if (!strcmp(argv[argpos], "-a")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &adapter) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-d")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &demux) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-filters")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &filters) != 1) || (filters < 1))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-noeit")) {
+			eit = 0;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-slots")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &slots) != 1) || (slots < 16))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-mb")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &data_mb) != 1) || (data_mb < 1) || (data_mb > 1024))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-v")) {
+			verbose = 1;
+			argpos++;
+		} else {
+			usage();
+		}
+	}
+
+	if ((sf = dvbsecfilter_create(adapter, demux, filters)) == NULL) {
+		fprintf(stderr, "Failed to open the demux: %m\n");
+		exit(1);
+	}
+	if ((store = dvbsistore_create(adapter, demux, slots, data_mb * 1024 * 1024)) == NULL) {
+		fprintf(stderr, "Failed to create the SI store: %m\n");
+		exit(1);
+	}
+
+	for (i = 0; i < FIXED_WANTS; i++) {
+		struct want *w = &fixed_wants[i];
+
+		if (!eit && (w->kind == DVBSISTORE_EIT))
+			continue;
+		if ((w->id = dvbsecfilter_add(sf, w->pid, w->table_id, -1, -1,
+					      section_callback, w)) < 0) {
+			fprintf(stderr, "Failed to add a section filter: %m\n");
+			exit(1);
+		}
+	}
+	if (dvbsecfilter_commit(sf) < 0) {
+		fprintf(stderr, "Failed to set the section filters: %m\n");
+		exit(1);
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	while(!stop) {
+		int demux_count = dvbsecfilter_get_pollfds(sf, pollfds, MAX_POLLFDS);
+		int count = demux_count +
+			dvbsistore_get_pollfds(store, pollfds + demux_count, MAX_POLLFDS - demux_count);
+		int j;
+
+		if (poll(pollfds, count, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "poll failed: %m\n");
+			break;
+		}
+
+		for (j = 0; j < count; j++) {
+			if (!pollfds[j].revents)
+				continue;
+			if (j >= demux_count) {
+				dvbsistore_process(store, pollfds[j].fd);
+				continue;
+			}
+			if ((dvbsecfilter_process(sf, pollfds[j].fd) < 0) && verbose &&
+			    (errno == EOVERFLOW))
+				fprintf(stderr, "Section filter overflow\n");
+		}
+
+		// the pollfds may be stale after this, so it is the last thing
+		if (new_program_count >= 0)
+			pmts_update();
+	}
+
+	dvbsistore_destroy(store);
+	dvbsecfilter_destroy(sf);
+	for (i = 0; i < (unsigned int) table_count; i++)
+		table_clear(&tables[i]);
+	free(tables);
+	free(pmt_wants);
+	free(new_programs);
+	return 0;
+}
@@ -0,0 +1,783 @@
+/*
+	dvbsubs utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/*
+ * Extracts the DVB subtitles (EN 300 743) of every service of one or more
+ * multiplexes, with a thread per multiplex.
+ *
+ * Each thread follows the PAT and PMTs of its multiplex, and reassembles
+ * the PES packets of every PID a subtitling_descriptor names. The segments
+ * of each subtitle stream (a composition page of a service, with its
+ * ancillary page) are written to a file of their own, found in the PES
+ * payload where it lies in the transport packets, and handed to writev()
+ * from there.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/poll.h>
+#include <sys/uio.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libucsi/section.h>
+#include <libucsi/section_reasm.h>
+#include <libucsi/pes_reasm.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/mpeg/types.h>
+#include <libucsi/dvb/descriptor.h>
+#include <libucsi/dvb/subtitle_segment.h>
+
+#define MAX_MUXES		16
+#define MAX_SERVICES		256
+#define MAX_STREAMS		256
+#define MAX_PIDS		(1 + MAX_SERVICES + MAX_STREAMS)
+#define MAX_PES_SIZE		(65536 + 6)
+#define READ_SIZE		(TRANSPORT_PACKET_LENGTH * 512)
+#define NO_PTS			0xffffffffffffffffULL
+
+struct service {
+	uint16_t service_id;
+	int pmt_pid;			// -1 => no longer in the PAT
+	int pmt_version;		// -1 => not seen yet
+};
+
+/**
+ * A subtitle stream: one entry of a subtitling_descriptor.
+ */
+struct stream {
+	uint16_t service_id;
+	uint16_t pid;
+	uint16_t composition_page_id;
+	uint16_t ancillary_page_id;
+	uint8_t subtitling_type;
+	char lang[4];
+	int fd;
+	int listed;			// still in the service's PMT
+
+	uint64_t segments;
+	uint64_t display_sets;
+	uint64_t bad_pes;
+	int write_failed;
+};
+
+/**
+ * A multiplex, and the thread extracting its subtitles.
+ */
+struct mux {
+	char name[64];
+	int adapter;			// -1 => a capture
+	int fd;
+	struct dvbdemux_pidset *pidset;
+	pthread_t thread;
+
+	struct section_reasm *psi;
+	struct pes_reasm *pes;
+	uint8_t section[DVB_MAX_SECTION_BYTES];
+	int transport_stream_id;	// -1 => no PAT yet
+	int pat_version;
+
+	struct service services[MAX_SERVICES];
+	int service_count;
+	struct stream streams[MAX_STREAMS];
+	int stream_count;
+
+	struct iovec *out;		// what each stream's records are written from
+	int out_size;
+	uint8_t scratch[DVB_SUBTITLE_SEGMENT_HEADER + 65536];
+
+	uint8_t buf[READ_SIZE];
+	int fill;
+	uint64_t overflows;
+};
+
+static struct mux muxes[MAX_MUXES];
+static int mux_count;
+static char *outdir = ".";
+static int verbose;
+static volatile int stop;
+
+static void usage(void)
+{
+	static const char *_usage =
+		"\n"
+		" dvbsubs: Extract the DVB subtitles of every service of one or more multiplexes\n"
+		"\n"
+		" usage: dvbsubs <options> [<capture>...]\n"
+		" -a <adapter>[.<demux>]	Read the multiplex the adapter is tuned to (may be\n"
+		"			repeated)\n"
+		" -o <dir>		Directory for the subtitle streams (default .)\n"
+		" -v			Print each segment\n"
+		" <capture>		A transport stream capture of a multiplex, - for stdin\n"
+		"\n"
+		" Every entry of the subtitling descriptors of every PMT is a stream of its\n"
+		" own, written to <dir>/<tsid>-<service id>-<pid>-<composition page>-<lang>.sub\n"
+		" as records of an 8 byte big endian PTS (all ones if the PES packet had\n"
+		" none), then one segment of its composition or ancillary page as\n"
+		" transmitted, sync_byte to the end of segment_data_field. Each multiplex is\n"
+		" handled by a thread of its own, and the tuning is left to other programs.\n";
+	fprintf(stderr, "%s\n", _usage);
+
+	exit(1);
+}
+
+static void signal_handler(int _signal)
+{
+	(void) _signal;
+
+	stop = 1;
+}
+
+static void mux_want_pid(struct mux *mux, int pid)
+{
+	if (mux->pidset && dvbdemux_pidset_add(mux->pidset, pid))
+		fprintf(stderr, "%s: failed to filter PID %i: %m\n", mux->name, pid);
+}
+
+static void mux_unwant_pid(struct mux *mux, int pid)
+{
+	if (mux->pidset)
+		dvbdemux_pidset_remove(mux->pidset, pid);
+}
+
+static int stream_pid_used(struct mux *mux, int pid)
+{
+	int i;
+
+	for (i = 0; i < mux->stream_count; i++) {
+		if (mux->streams[i].pid == pid)
+			return 1;
+	}
+	return 0;
+}
+
+static void stream_open(struct mux *mux, uint16_t service_id, uint16_t pid,
+			struct dvb_subtitling_entry *entry)
+{
+	char filename[PATH_MAX];
+	struct stream *st;
+	int i;
+
+	for (i = 0; i < mux->stream_count; i++) {
+		st = &mux->streams[i];
+		if ((st->service_id == service_id) && (st->pid == pid) &&
+		    (st->composition_page_id == entry->composition_page_id) &&
+		    (st->ancillary_page_id == entry->ancillary_page_id)) {
+			st->listed = 1;
+			return;
+		}
+	}
+	if (mux->stream_count == MAX_STREAMS)
+		return;
+
+	st = &mux->streams[mux->stream_count];
+	memset(st, 0, sizeof(struct stream));
+	st->service_id = service_id;
+	st->pid = pid;
+	st->composition_page_id = entry->composition_page_id;
+	st->ancillary_page_id = entry->ancillary_page_id;
+	st->subtitling_type = entry->subtitling_type;
+	for (i = 0; i < 3; i++)
+		st->lang[i] = ((entry->language_code[i] >= 'a') && (entry->language_code[i] <= 'z')) ?
+			      entry->language_code[i] : '_';
+	st->listed = 1;
+
+	// a stream which comes back is appended to
+	snprintf(filename, sizeof(filename), "%s/%i-%u-%u-%u-%s.sub", outdir,
+		 mux->transport_stream_id, service_id, pid, st->composition_page_id, st->lang);
+	if ((st->fd = open(filename, O_WRONLY | O_CREAT | O_APPEND, 0644)) < 0) {
+		fprintf(stderr, "%s: failed to open %s: %m\n", mux->name, filename);
+		return;
+	}
+
+	if (!stream_pid_used(mux, pid)) {
+		pes_reasm_add_pid(mux->pes, pid);
+		mux_want_pid(mux, pid);
+	}
+	mux->stream_count++;
+	if (verbose)
+		fprintf(stderr, "%s: service %u: subtitles on PID %u, page %u/%u, %s, type 0x%02x\n",
+			mux->name, service_id, pid, st->composition_page_id,
+			st->ancillary_page_id, st->lang, st->subtitling_type);
+}
+
+/**
+ * Close the streams of a service its PMT no longer lists.
+ */
+static void streams_prune(struct mux *mux, uint16_t service_id)
+{
+	struct stream *st;
+	int pid;
+	int i = 0;
+
+	while (i < mux->stream_count) {
+		st = &mux->streams[i];
+		if ((st->service_id != service_id) || st->listed) {
+			i++;
+			continue;
+		}
+		if (verbose)
+			fprintf(stderr, "%s: service %u: subtitles on PID %u page %u gone\n",
+				mux->name, service_id, st->pid, st->composition_page_id);
+		close(st->fd);
+		pid = st->pid;
+		*st = mux->streams[--mux->stream_count];
+		if (!stream_pid_used(mux, pid)) {
+			pes_reasm_remove_pid(mux->pes, pid);
+			mux_unwant_pid(mux, pid);
+		}
+	}
+}
+
+static void handle_pat(struct mux *mux, struct section_ext *ext)
+{
+	struct mpeg_pat_section *pat;
+	struct mpeg_pat_program *program;
+	struct service *s;
+	int i;
+
+	// nearly always a single section: anything else is only added to
+	if ((ext->last_section_number == 0) && (ext->version_number == mux->pat_version))
+		return;
+	if ((pat = mpeg_pat_section_codec(ext)) == NULL)
+		return;
+	mux->transport_stream_id = mpeg_pat_section_transport_stream_id(pat);
+
+	mpeg_pat_section_programs_for_each(pat, program) {
+		if (program->program_number == 0)
+			continue;
+
+		for (i = 0; i < mux->service_count; i++) {
+			if (mux->services[i].service_id == program->program_number)
+				break;
+		}
+		if (i == mux->service_count) {
+			if (i == MAX_SERVICES)
+				continue;
+			mux->services[i].service_id = program->program_number;
+			mux->services[i].pmt_pid = -1;
+			mux->service_count++;
+		}
+		s = &mux->services[i];
+		if (s->pmt_pid != program->pid) {
+			if (s->pmt_pid != -1)
+				mux_unwant_pid(mux, s->pmt_pid);
+			s->pmt_pid = program->pid;
+			s->pmt_version = -1;
+			section_reasm_add_pid(mux->psi, program->pid);
+			mux_want_pid(mux, program->pid);
+		}
+	}
+
+	if (ext->last_section_number == 0)
+		mux->pat_version = ext->version_number;
+}
+
+static void handle_pmt(struct mux *mux, int pid, struct section_ext *ext)
+{
+	struct mpeg_pmt_section *pmt;
+	struct mpeg_pmt_stream *stream;
+	struct descriptor *d;
+	struct dvb_subtitling_descriptor *dx;
+	struct dvb_subtitling_entry *entry;
+	struct service *s = NULL;
+	int i;
+
+	for (i = 0; i < mux->service_count; i++) {
+		s = &mux->services[i];
+		if ((s->service_id == ext->table_id_ext) && (s->pmt_pid == pid))
+			break;
+	}
+	if ((i == mux->service_count) || (s->pmt_version == ext->version_number))
+		return;
+	if ((pmt = mpeg_pmt_section_codec(ext)) == NULL)
+		return;
+	s->pmt_version = ext->version_number;
+
+	for (i = 0; i < mux->stream_count; i++) {
+		if (mux->streams[i].service_id == s->service_id)
+			mux->streams[i].listed = 0;
+	}
+	mpeg_pmt_section_streams_for_each(pmt, stream) {
+		if (stream->stream_type != MPEG_STREAM_TYPE_ISO13818_1_PRIVATE_PES)
+			continue;
+		mpeg_pmt_stream_descriptors_for_each(stream, d) {
+			if (d->tag != dtag_dvb_subtitling)
+				continue;
+			if ((dx = dvb_subtitling_descriptor_codec(d)) == NULL)
+				continue;
+			dvb_subtitling_descriptor_subtitles_for_each(dx, entry) {
+				stream_open(mux, s->service_id, stream->pid, entry);
+			}
+		}
+	}
+	streams_prune(mux, s->service_id);
+}
+
+static void handle_section(void *private, int pid, uint8_t *data, int len)
+{
+	struct mux *mux = private;
+	struct section *section;
+	struct section_ext *ext;
+
+	// decoded in place, and a section within one packet is still in the
+	// read buffer, which the PES pass over it reads afterwards
+	memcpy(mux->section, data, len);
+	if ((section = section_codec(mux->section, len)) == NULL)
+		return;
+	if ((ext = section_ext_decode(section, 1)) == NULL)
+		return;
+	if (!ext->current_next_indicator)
+		return;
+
+	if ((pid == TRANSPORT_PAT_PID) && (ext->table_id == stag_mpeg_program_association))
+		handle_pat(mux, ext);
+	else if (ext->table_id == stag_mpeg_program_map)
+		handle_pmt(mux, pid, ext);
+}
+
+/**
+ * A position in a chain of pieces.
+ */
+struct cursor {
+	const struct iovec *iov;
+	int iovcnt;
+	int index;
+	size_t offset;			// into iov[index]
+	size_t left;			// bytes from here to the end of the chain
+};
+
+static void cursor_init(struct cursor *c, const struct iovec *iov, int iovcnt)
+{
+	int i;
+
+	c->iov = iov;
+	c->iovcnt = iovcnt;
+	c->index = 0;
+	c->offset = 0;
+	c->left = 0;
+	for (i = 0; i < iovcnt; i++)
+		c->left += iov[i].iov_len;
+}
+
+/**
+ * Move on by len bytes, describing them as pieces in out if it isn't NULL.
+ *
+ * @return Number of pieces put in out.
+ */
+static int cursor_take(struct cursor *c, size_t len, struct iovec *out)
+{
+	int count = 0;
+
+	c->left -= len;
+	while (len) {
+		size_t avail = c->iov[c->index].iov_len - c->offset;
+		size_t n = (len < avail) ? len : avail;
+
+		if (n && out) {
+			out[count].iov_base = (uint8_t *) c->iov[c->index].iov_base + c->offset;
+			out[count++].iov_len = n;
+		}
+		len -= n;
+		c->offset += n;
+		if (c->offset == c->iov[c->index].iov_len) {
+			c->index++;
+			c->offset = 0;
+		}
+	}
+	return count;
+}
+
+/**
+ * Copy the next len bytes without moving on.
+ */
+static void cursor_peek(struct cursor *c, uint8_t *dst, size_t len)
+{
+	struct cursor tmp = *c;
+	struct iovec pieces[DVB_SUBTITLE_SEGMENT_HEADER];
+	int count;
+	int i;
+
+	count = cursor_take(&tmp, len, pieces);
+	for (i = 0; i < count; i++) {
+		memcpy(dst, pieces[i].iov_base, pieces[i].iov_len);
+		dst += pieces[i].iov_len;
+	}
+}
+
+static const char *segment_type_name(int type)
+{
+	switch(type) {
+	case dvb_subtitle_segment_page_composition:	return "page composition";
+	case dvb_subtitle_segment_region_composition:	return "region composition";
+	case dvb_subtitle_segment_clut_definition:	return "CLUT definition";
+	case dvb_subtitle_segment_object_data:		return "object data";
+	case dvb_subtitle_segment_display_definition:	return "display definition";
+	case dvb_subtitle_segment_disparity_signalling:	return "disparity signalling";
+	case dvb_subtitle_segment_alternative_clut:	return "alternative CLUT";
+	case dvb_subtitle_segment_end_of_display_set:	return "end of display set";
+	case dvb_subtitle_segment_stuffing:		return "stuffing";
+	}
+	return "reserved";
+}
+
+static void print_segment(struct mux *mux, struct stream *st, uint64_t pts,
+			  const struct iovec *pieces, int count)
+{
+	struct dvb_subtitle_segment seg;
+	struct dvb_subtitle_page page;
+	struct dvb_subtitle_region region;
+	struct dvb_subtitle_region_object object;
+	struct dvb_subtitle_object obj;
+	struct dvb_subtitle_display display;
+	struct dvb_subtitle_clut clut;
+	struct dvb_subtitle_clut_entry entry;
+	char detail[128] = "";
+	char when[32] = "-";
+	int len = 0;
+	int n, pos;
+	int i;
+
+	// decoding needs the segment in one piece
+	for (i = 0; i < count; i++) {
+		memcpy(mux->scratch + len, pieces[i].iov_base, pieces[i].iov_len);
+		len += pieces[i].iov_len;
+	}
+	if (dvb_subtitle_segment_decode(mux->scratch, len, &seg) <= 0)
+		return;
+	if (pts != NO_PTS)
+		snprintf(when, sizeof(when), "%.3f", pts / 90000.0);
+
+	switch(seg.segment_type) {
+	case dvb_subtitle_segment_page_composition:
+		if (dvb_subtitle_page_decode(&seg, &page))
+			break;
+		snprintf(detail, sizeof(detail), " version %u, %s, time out %us, %i regions",
+			 page.page_version_number,
+			 (page.page_state == dvb_subtitle_page_state_normal_case) ? "normal case" :
+			 (page.page_state == dvb_subtitle_page_state_acquisition_point) ? "acquisition point" :
+			 (page.page_state == dvb_subtitle_page_state_mode_change) ? "mode change" : "reserved",
+			 page.page_time_out, page.region_count);
+		break;
+
+	case dvb_subtitle_segment_region_composition:
+		if (dvb_subtitle_region_decode(&seg, &region))
+			break;
+		for (n = 0, pos = 0; (pos = dvb_subtitle_region_object_next(&region, pos, &object)) > 0; n++)
+			;
+		snprintf(detail, sizeof(detail), " %u version %u, %ux%u, CLUT %u, %i objects",
+			 region.region_id, region.region_version_number, region.region_width,
+			 region.region_height, region.clut_id, n);
+		break;
+
+	case dvb_subtitle_segment_clut_definition:
+		if (dvb_subtitle_clut_decode(&seg, &clut))
+			break;
+		for (n = 0, pos = 0; (pos = dvb_subtitle_clut_entry_next(&clut, pos, &entry)) > 0; n++)
+			;
+		snprintf(detail, sizeof(detail), " %u version %u, %i entries",
+			 clut.clut_id, clut.clut_version_number, n);
+		break;
+
+	case dvb_subtitle_segment_object_data:
+		if (dvb_subtitle_object_decode(&seg, &obj))
+			break;
+		if (obj.object_coding_method == dvb_subtitle_object_coding_characters)
+			snprintf(detail, sizeof(detail), " %u version %u, %u characters",
+				 obj.object_id, obj.object_version_number, obj.number_of_codes);
+		else
+			snprintf(detail, sizeof(detail), " %u version %u, %u+%u bytes of pixels",
+				 obj.object_id, obj.object_version_number,
+				 obj.top_field_data_block_length, obj.bottom_field_data_block_length);
+		break;
+
+	case dvb_subtitle_segment_display_definition:
+		if (dvb_subtitle_display_decode(&seg, &display))
+			break;
+		snprintf(detail, sizeof(detail), " version %u, %ux%u",
+			 display.dds_version_number, display.display_width + 1,
+			 display.display_height + 1);
+		break;
+	}
+
+	fprintf(stderr, "%s: service %u PID %u page %u pts %s: %s%s\n", mux->name,
+		st->service_id, st->pid, seg.page_id, when, segment_type_name(seg.segment_type),
+		detail);
+}
+
+/**
+ * Write the segments of a PES packet which belong to a stream, from where
+ * they are in the pieces, each after the PTS.
+ */
+static void stream_pes(struct mux *mux, struct stream *st, uint8_t *pts_be, uint64_t pts,
+		       const struct iovec *iov, int iovcnt)
+{
+	uint8_t hdr[DVB_SUBTITLE_SEGMENT_HEADER];
+	struct cursor c;
+	int count = 0;
+	int pieces;
+
+	cursor_init(&c, iov, iovcnt);
+	if (c.left < 2)
+		goto bad;
+	cursor_peek(&c, hdr, 2);
+	if (dvb_subtitle_pes_start(hdr, 2) < 0)
+		goto bad;
+	cursor_take(&c, 2, NULL);
+
+	while (c.left >= DVB_SUBTITLE_SEGMENT_HEADER) {
+		size_t len;
+		uint16_t page_id;
+
+		cursor_peek(&c, hdr, DVB_SUBTITLE_SEGMENT_HEADER);
+		if (hdr[0] != DVB_SUBTITLE_SYNC_BYTE)
+			break;
+		page_id = (hdr[2] << 8) | hdr[3];
+		len = DVB_SUBTITLE_SEGMENT_HEADER + ((hdr[4] << 8) | hdr[5]);
+		if (len > c.left)
+			goto bad;
+
+		if ((page_id != st->composition_page_id) && (page_id != st->ancillary_page_id)) {
+			cursor_take(&c, len, NULL);
+			continue;
+		}
+
+		// a segment spans no more pieces than there are
+		if ((count + 1 + iovcnt) > mux->out_size) {
+			int size = (count + 1 + iovcnt) * 2;
+			struct iovec *out;
+
+			if ((out = realloc(mux->out, size * sizeof(struct iovec))) == NULL)
+				return;
+			mux->out = out;
+			mux->out_size = size;
+		}
+		mux->out[count].iov_base = pts_be;
+		mux->out[count++].iov_len = 8;
+		pieces = cursor_take(&c, len, mux->out + count);
+		if (verbose)
+			print_segment(mux, st, pts, mux->out + count, pieces);
+		count += pieces;
+
+		st->segments++;
+		if (hdr[1] == dvb_subtitle_segment_end_of_display_set)
+			st->display_sets++;
+	}
+
+	if (count && pes_write_iov(st->fd, mux->out, count) && !st->write_failed) {
+		fprintf(stderr, "%s: failed to write service %u PID %u page %u: %m\n",
+			mux->name, st->service_id, st->pid, st->composition_page_id);
+		st->write_failed = 1;
+	}
+	return;
+
+bad:
+	st->bad_pes++;
+}
+
+static void handle_pes(void *private, const struct pes_packet_info *info,
+		       const struct iovec *iov, int iovcnt)
+{
+	struct mux *mux = private;
+	uint64_t pts = NO_PTS;
+	uint8_t pts_be[8];
+	int i;
+
+	if ((info->stream_id != 0xbd) || (info->flags & pes_packet_flag_scrambled))
+		return;
+	if (info->flags & pes_packet_flag_pts)
+		pts = info->pts;
+	for (i = 0; i < 8; i++)
+		pts_be[i] = pts >> (56 - (i * 8));
+
+	for (i = 0; i < mux->stream_count; i++) {
+		if ((mux->streams[i].pid == info->pid) && (mux->streams[i].fd >= 0))
+			stream_pes(mux, &mux->streams[i], pts_be, pts, iov, iovcnt);
+	}
+}
+
+static int mux_open(struct mux *mux)
+{
+	if ((mux->psi = section_reasm_create(1 + MAX_SERVICES, DVB_MAX_SECTION_BYTES)) == NULL)
+		return -1;
+	if ((mux->pes = pes_reasm_create(MAX_STREAMS, MAX_PES_SIZE, 0)) == NULL)
+		return -1;
+	mux->transport_stream_id = -1;
+	mux->pat_version = -1;
+
+	if (mux->adapter != -1) {
+		if ((mux->pidset = dvbdemux_pidset_open(mux->adapter, mux->fd, 0, 0)) == NULL)
+			return -1;
+		mux_want_pid(mux, TRANSPORT_PAT_PID);
+		if ((mux->fd = dvbdemux_pidset_fd(mux->pidset)) < 0)
+			mux->fd = dvbdemux_open_dvr(mux->adapter, mux->fd, 1, 0);
+	}
+	section_reasm_add_pid(mux->psi, TRANSPORT_PAT_PID);
+
+	return mux->fd;
+}
+
+static void *mux_run(void *arg)
+{
+	struct mux *mux = arg;
+	struct pollfd pollfd;
+	int len, used;
+
+	while (!stop) {
+		// a demux can be quiet for ever, so the stop is looked at now and then
+		if (mux->adapter != -1) {
+			pollfd.fd = mux->fd;
+			pollfd.events = POLLIN;
+			if (poll(&pollfd, 1, 200) <= 0)
+				continue;
+		}
+
+		if ((len = read(mux->fd, mux->buf + mux->fill, sizeof(mux->buf) - mux->fill)) < 0) {
+			if (errno == EOVERFLOW) {
+				mux->overflows++;
+				continue;
+			}
+			if ((errno == EINTR) || (errno == EAGAIN))
+				continue;
+			fprintf(stderr, "%s: read failed: %m\n", mux->name);
+			break;
+		}
+		if (len == 0)
+			break;
+
+		len += mux->fill;
+		used = section_reasm_add_packets(mux->psi, mux->buf, len, handle_section, mux);
+		pes_reasm_add_packets(mux->pes, mux->buf, used, handle_pes, mux);
+		mux->fill = len - used;
+		memmove(mux->buf, mux->buf + used, mux->fill);
+	}
+	pes_reasm_flush(mux->pes, handle_pes, mux);
+
+	return NULL;
+}
+
+static void mux_close(struct mux *mux)
+{
+	int i;
+
+	for (i = 0; i < mux->stream_count; i++) {
+		struct stream *st = &mux->streams[i];
+
+		printf("%s: service %u PID %u page %u %s: %llu segments, %llu display sets, %llu bad PES packets\n",
+		       mux->name, st->service_id, st->pid, st->composition_page_id, st->lang,
+		       (unsigned long long) st->segments, (unsigned long long) st->display_sets,
+		       (unsigned long long) st->bad_pes);
+		close(st->fd);
+	}
+	if (mux->overflows)
+		printf("%s: %llu buffer overflows\n", mux->name, (unsigned long long) mux->overflows);
+
+	if (mux->pidset)
+		dvbdemux_pidset_close(mux->pidset);
+	if ((mux->fd > 0) && ((mux->pidset == NULL) || (mux->fd != dvbdemux_pidset_fd(mux->pidset))))
+		close(mux->fd);
+	if (mux->pes)
+		pes_reasm_destroy(mux->pes);
+	if (mux->psi)
+		section_reasm_destroy(mux->psi);
+	free(mux->out);
+}
+
+int main(int argc, char *argv[])
+{
+	int argpos = 1;
+	int i;
+
+	while(argpos != argc) {
+		struct mux *mux = &muxes[mux_count];
+
+		if (!strcmp(argv[argpos], "-h")) {
+			usage();
+		} else if (!strcmp(argv[argpos], "-a")) {
+			int demux = 0;
+
+			if ((argc - argpos) < 2)
+				usage();
+			if (mux_count == MAX_MUXES)
+				usage();
+			if (sscanf(argv[argpos+1], "%i.%i", &mux->adapter, &demux) < 1)
+				usage();
+			mux->fd = demux;
+			snprintf(mux->name, sizeof(mux->name), "adapter%i.%i", mux->adapter, demux);
+			mux_count++;
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-o")) {
+			if ((argc - argpos) < 2)
+				usage();
+			outdir = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-v")) {
+			verbose = 1;
+			argpos++;
+		} else if ((argv[argpos][0] != '-') || !strcmp(argv[argpos], "-")) {
+			if (mux_count == MAX_MUXES)
+				usage();
+			mux->adapter = -1;
+			if (!strcmp(argv[argpos], "-"))
+				mux->fd = STDIN_FILENO;
+			else if ((mux->fd = open(argv[argpos], O_RDONLY)) < 0) {
+				fprintf(stderr, "Failed to open %s: %m\n", argv[argpos]);
+				exit(1);
+			}
+			snprintf(mux->name, sizeof(mux->name), "%s", argv[argpos]);
+			mux_count++;
+			argpos++;
+		} else {
+			usage();
+		}
+	}
+	if (mux_count == 0)
+		usage();
+
+	for (i = 0; i < mux_count; i++) {
+		if (mux_open(&muxes[i]) < 0) {
+			fprintf(stderr, "%s: failed to open: %m\n", muxes[i].name);
+			exit(1);
+		}
+	}
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	for (i = 0; i < mux_count; i++) {
+		if (pthread_create(&muxes[i].thread, NULL, mux_run, &muxes[i])) {
+			fprintf(stderr, "%s: failed to start a thread\n", muxes[i].name);
+			exit(1);
+		}
+	}
+	for (i = 0; i < mux_count; i++) {
+		pthread_join(muxes[i].thread, NULL);
+		mux_close(&muxes[i]);
+	}
+
+	return 0;
+}
@@ -0,0 +1,342 @@
+/*
+	dvbtr290 utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libucsi/transport_packet.h>
+#include <libdvbtr290/dvbtr290.h>
+
+#define MAX_MUXES 64
+#define READ_SIZE (TRANSPORT_PACKET_LENGTH * TRANSPORT_BATCH_MAX * 8)
+
+struct mux {
+	char name[64];
+	int fd;
+	int demux_fd;				/* -1 for a file */
+	struct dvbtr290 *tr;
+	pthread_t thread;
+	volatile int done;
+};
+
+static struct mux muxes[MAX_MUXES];
+static int mux_count;
+static volatile sig_atomic_t quit = 0;
+
+static void usage(FILE *output)
+{
+	fprintf(output,
+		"Usage: dvbtr290 [OPTION]... [FILE]...\n"
+		"Check transport streams against ETSI TR 101 290 priorities 1 and 2,\n"
+		"one thread per stream.\n"
+		"Options:\n"
+		"	-a N[:D] analyze the stream of dvb adapter N (demux D), may be repeated\n"
+		"	FILE	 analyze a recorded stream, as fast as it can be read\n"
+		"	-b N	 DVR buffer size in MB (default 8)\n"
+		"	-c N	 pin the first stream to CPU N, the next to N+1 and so on (default 0)\n"
+		"	-n	 do not pin the threads to CPUs\n"
+		"	-i N	 export the counters every N seconds (default 1)\n"
+		"	-o FILE	 export the counters to FILE, replacing it each time (default stdout)\n"
+		"	-h	 display this help\n");
+}
+
+static void signal_handler(int sig)
+{
+	(void) sig;
+
+	quit = 1;
+}
+
+static void *mux_thread(void *arg)
+{
+	struct mux *mux = arg;
+	struct pollfd pollfd;
+	uint8_t *buf;
+	int len;
+
+	if ((buf = malloc(READ_SIZE)) == NULL) {
+		fprintf(stderr, "dvbtr290: Out of memory\n");
+		mux->done = 1;
+		return NULL;
+	}
+
+	pollfd.fd = mux->fd;
+	pollfd.events = POLLIN;
+	while(!quit) {
+		// a device may go quiet, so wake up now and then to check for quitting
+		if ((mux->demux_fd != -1) && (poll(&pollfd, 1, 100) != 1))
+			continue;
+
+		if ((len = read(mux->fd, buf, READ_SIZE)) > 0) {
+			dvbtr290_feed(mux->tr, buf, len);
+			continue;
+		}
+
+		if ((len < 0) && ((errno == EOVERFLOW) || (errno == EINTR) || (errno == EAGAIN))) {
+			if (errno == EOVERFLOW)
+				fprintf(stderr, "dvbtr290: %s: DVR buffer overflow, data lost\n", mux->name);
+			continue;
+		}
+		if (len < 0)
+			fprintf(stderr, "dvbtr290: %s: read failed: %m\n", mux->name);
+		break;
+	}
+
+	free(buf);
+	mux->done = 1;
+	return NULL;
+}
+
+static int running(void)
+{
+	int i;
+
+	for(i = 0; i < mux_count; i++) {
+		if (!muxes[i].done)
+			return 1;
+	}
+	return 0;
+}
+
+static int open_adapter(struct mux *mux, const char *spec, int buffer_mb)
+{
+	int adapter;
+	int demux = 0;
+
+	if (sscanf(spec, "%i:%i", &adapter, &demux) < 1) {
+		fprintf(stderr, "dvbtr290: Bad adapter %s\n", spec);
+		return -1;
+	}
+	sprintf(mux->name, "adapter%i.demux%i", adapter, demux);
+
+	if ((mux->fd = dvbdemux_open_dvr(adapter, demux, 1, 1)) < 0) {
+		fprintf(stderr, "dvbtr290: Could not open dvr device of %s: %m\n", mux->name);
+		return -1;
+	}
+	dvbdemux_set_buffer(mux->fd, buffer_mb * 1024 * 1024);
+
+	if ((mux->demux_fd = dvbdemux_open_demux(adapter, demux, 0)) < 0) {
+		fprintf(stderr, "dvbtr290: Could not open demux device of %s: %m\n", mux->name);
+		close(mux->fd);
+		return -1;
+	}
+	if (dvbdemux_set_pid_filter(mux->demux_fd, -1, DVBDEMUX_INPUT_FRONTEND,
+				    DVBDEMUX_OUTPUT_DVR, 1)) {
+		fprintf(stderr, "dvbtr290: Could not set filter on %s: %m\n", mux->name);
+		close(mux->demux_fd);
+		close(mux->fd);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int open_file(struct mux *mux, const char *filename)
+{
+	snprintf(mux->name, sizeof(mux->name), "%s", filename);
+	mux->demux_fd = -1;
+
+	if ((mux->fd = open(filename, O_RDONLY)) < 0) {
+		fprintf(stderr, "dvbtr290: Could not open %s: %m\n", filename);
+		return -1;
+	}
+
+	return 0;
+}
+
+static void export_counters(FILE *f)
+{
+	struct dvbtr290_counters counters;
+	int i;
+	int j;
+
+	for(i = 0; i < mux_count; i++) {
+		dvbtr290_get_counters(muxes[i].tr, &counters);
+
+		fprintf(f, "dvbtr290_packets{mux=\"%s\"} %llu\n",
+			muxes[i].name, (unsigned long long) counters.packets);
+		fprintf(f, "dvbtr290_bitrate{mux=\"%s\"} %llu\n",
+			muxes[i].name, (unsigned long long) counters.bitrate);
+		for(j = 0; j < DVBTR290_ERROR_COUNT; j++) {
+			fprintf(f, "dvbtr290_%s{mux=\"%s\"} %llu\n",
+				dvbtr290_error_name(j), muxes[i].name,
+				(unsigned long long) counters.errors[j]);
+		}
+	}
+}
+
+static void export(const char *filename)
+{
+	char tmpname[PATH_MAX];
+	FILE *f;
+
+	if (filename == NULL) {
+		export_counters(stdout);
+		fprintf(stdout, "\n");
+		fflush(stdout);
+		return;
+	}
+
+	// readers only ever see a complete set
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename);
+	if ((f = fopen(tmpname, "w")) == NULL) {
+		fprintf(stderr, "dvbtr290: Could not create %s: %m\n", tmpname);
+		return;
+	}
+	export_counters(f);
+	if (fclose(f) || rename(tmpname, filename))
+		fprintf(stderr, "dvbtr290: Could not write %s: %m\n", filename);
+}
+
+int main(int argc, char *argv[])
+{
+	struct sigaction sa;
+	char *adapters[MAX_MUXES];
+	int adapter_count = 0;
+	char *outfile = NULL;
+	int buffer_mb = 8;
+	int interval = 1;
+	int first_cpu = 0;
+	int pin = 1;
+	int cpus;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "a:b:c:hi:no:")) != -1) {
+		switch (opt) {
+		case 'a':
+			if (adapter_count == MAX_MUXES) {
+				fprintf(stderr, "dvbtr290: Too many streams\n");
+				exit(1);
+			}
+			adapters[adapter_count++] = optarg;
+			break;
+		case 'b':
+			buffer_mb = atoi(optarg);
+			break;
+		case 'c':
+			first_cpu = atoi(optarg);
+			break;
+		case 'h':
+			usage(stdout);
+			exit(0);
+		case 'i':
+			interval = atoi(optarg);
+			break;
+		case 'n':
+			pin = 0;
+			break;
+		case 'o':
+			outfile = optarg;
+			break;
+		default:
+			usage(stderr);
+			exit(1);
+		}
+	}
+	if ((interval <= 0) || (buffer_mb <= 0) || (first_cpu < 0)) {
+		usage(stderr);
+		exit(1);
+	}
+
+	for(i = 0; i < adapter_count; i++) {
+		if (open_adapter(&muxes[mux_count], adapters[i], buffer_mb))
+			exit(1);
+		mux_count++;
+	}
+	for(; optind < argc; optind++) {
+		if (mux_count == MAX_MUXES) {
+			fprintf(stderr, "dvbtr290: Too many streams\n");
+			exit(1);
+		}
+		if (open_file(&muxes[mux_count], argv[optind]))
+			exit(1);
+		mux_count++;
+	}
+	if (mux_count == 0) {
+		usage(stderr);
+		exit(1);
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if ((cpus = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+		cpus = 1;
+	for(i = 0; i < mux_count; i++) {
+		struct mux *mux = &muxes[i];
+		pthread_attr_t attr;
+		cpu_set_t cpuset;
+
+		if ((mux->tr = dvbtr290_create()) == NULL) {
+			fprintf(stderr, "dvbtr290: Out of memory\n");
+			exit(1);
+		}
+
+		// pinned from the start, so a stream never moves between caches
+		pthread_attr_init(&attr);
+		if (pin) {
+			CPU_ZERO(&cpuset);
+			CPU_SET((first_cpu + i) % cpus, &cpuset);
+			pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+		}
+		if (pthread_create(&mux->thread, &attr, mux_thread, mux)) {
+			fprintf(stderr, "dvbtr290: Could not create thread for %s\n", mux->name);
+			exit(1);
+		}
+		pthread_attr_destroy(&attr);
+	}
+
+	while(!quit && running()) {
+		for(i = 0; (i < interval * 10) && !quit && running(); i++)
+			usleep(100000);
+		if (!quit && running())
+			export(outfile);
+	}
+
+	quit = 1;
+	for(i = 0; i < mux_count; i++)
+		pthread_join(muxes[i].thread, NULL);
+
+	// the final totals
+	export(outfile);
+
+	for(i = 0; i < mux_count; i++) {
+		dvbtr290_destroy(muxes[i].tr);
+		if (muxes[i].demux_fd != -1)
+			close(muxes[i].demux_fd);
+		close(muxes[i].fd);
+	}
+
+	return 0;
+}
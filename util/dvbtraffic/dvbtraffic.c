@@ -2,21 +2,81 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <errno.h>
 #include <time.h>
 #include <sys/poll.h>
 #include <sys/time.h>
 #include <string.h>
 #include <limits.h>
+#include <signal.h>
 #include <libdvbapi/dvbdemux.h>
+#include "dvbtraffic_profile.h"
+#include "dvbtraffic_plan.h"
 
-#define BSIZE 188
+#define TS_PACKET_SIZE 188
 
-static int pidt[0x2001];
+/* packets per read(): ~3MB, so a full DVB-S2 mux needs a few dozen reads a second */
+#define CHUNK_PACKETS (16 * 1024)
+
+/* carried over from one buffer to the next: the start of a split packet */
+static uint8_t carry[2 * TS_PACKET_SIZE];
+static int carry_len;
+
+#define MAX_WINDOW 64
+
+#define PCR_HZ 27000000ULL
+#define PCR_WRAP ((1ULL << 33) * 300)
+
+/* PCRs further apart than this (0.1s is the maximum allowed) restart the measurement */
+#define PCR_MAX_GAP (PCR_HZ / 2)
+
+struct pid_stats {
+	uint32_t packets;		/* in the current interval */
+	uint32_t scrambled;
+	uint32_t cc_errors;
+	uint32_t pcr_jitter_max;	/* in 27MHz ticks */
+
+	int last_cc;			/* -1 => none yet */
+
+	int have_pcr;
+	uint64_t last_pcr;
+	uint64_t last_pcr_packet;	/* stream position of last_pcr */
+	double pcr_bitrate;		/* mux bitrate estimated from the PCRs */
+
+	uint32_t *window;		/* packets per interval, the last window_len intervals */
+};
+
+static struct pid_stats pids[0x2000];
+static struct pid_stats total;
+static uint64_t packet_pos;
+static uint64_t desync_bytes;
+
+static int window_len = 10;
+static int window_pos;
+static int window_filled;
+static int window_ms[MAX_WINDOW];	/* length of each interval in the window */
+
+static char *search;
+static int search_len;
+
+// -S: per service profile, and -P: a packing plan from it
+static struct profile *profile;
+static struct profile_params profile_params = {
+	.windows = { 100, 1000, 10000 },
+	.window_count = 3,
+};
+static uint64_t plan_capacity[32];
+static int plan_links;
+static enum plan_metric plan_metric = PLAN_PEAK;
+static int plan_window;		/* ms, 0 => the shortest window */
+
+static volatile sig_atomic_t stop;
 
 static void usage(FILE *output)
 {
@@ -25,126 +85,596 @@ static void usage(FILE *output)
 		"Options:\n"
 		"	-a N	use dvb adapter N\n"
 		"	-d N	use demux N\n"
+		"	-f FILE	read the transport stream from FILE (- for stdin) instead\n"
+		"	-b N	DVR buffer size in MB (default 8)\n"
+		"	-i N	report every N ms (default 1000)\n"
+		"	-w N	also report the average over the last N reports (default 10)\n"
+		"	-s STR	only count packets containing STR\n"
+		"	-S	report per service (through the PAT and PMTs) instead of per PID\n"
+		"	-W LIST	-S windows in ms, the first dividing the others (default 100,1000,10000)\n"
+		"	-H N	keep N seconds of -S history for -P (default 600)\n"
+		"	-r N	time -S by a mux rate of N kbit/s instead of by the PCRs\n"
+		"	-P LIST	plan which services go on links of these kbit/s capacities (implies -S)\n"
+		"	-m M	what has to fit a link: peak, p99 or mean, :MS for the window (default peak)\n"
 		"	-h	display this help\n");
 }
 
+static int parse_list(char *arg, uint64_t *values, int max)
+{
+	char *end;
+	int count = 0;
+
+	while (*arg) {
+		if (count == max)
+			return -1;
+		values[count] = strtoull(arg, &end, 10);
+		if ((end == arg) || (values[count] == 0))
+			return -1;
+		count++;
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -1;
+		arg = end;
+	}
+	return count;
+}
+
+static int parse_metric(char *arg)
+{
+	char *colon = strchr(arg, ':');
+	int len = colon ? colon - arg : (int) strlen(arg);
+
+	if ((len == 4) && !strncmp(arg, "peak", 4))
+		plan_metric = PLAN_PEAK;
+	else if ((len == 3) && !strncmp(arg, "p99", 3))
+		plan_metric = PLAN_P99;
+	else if ((len == 4) && !strncmp(arg, "mean", 4))
+		plan_metric = PLAN_MEAN;
+	else
+		return -1;
+	if (colon && ((plan_window = atoi(colon + 1)) <= 0))
+		return -1;
+	return 0;
+}
+
+static void stop_handler(int sig)
+{
+	(void) sig;
+	stop = 1;
+}
+
+static void count_cc(struct pid_stats *p, const uint8_t *pkt, int discontinuity)
+{
+	int cc = pkt[3] & 0x0f;
+	int has_payload = pkt[3] & 0x10;
+
+	if (discontinuity || (p->last_cc < 0)) {
+		p->last_cc = cc;
+		return;
+	}
+
+	if (has_payload) {
+		// one duplicate packet is allowed
+		if ((cc != ((p->last_cc + 1) & 0x0f)) && (cc != p->last_cc))
+			p->cc_errors++;
+	} else if (cc != p->last_cc) {
+		p->cc_errors++;
+	}
+	p->last_cc = cc;
+}
+
+static void count_pcr(struct pid_stats *p, const uint8_t *pkt)
+{
+	uint64_t pcr;
+	uint64_t delta;
+	double bits;
+
+	pcr = (((uint64_t) pkt[6]) << 25) | (pkt[7] << 17) | (pkt[8] << 9) |
+	      (pkt[9] << 1) | (pkt[10] >> 7);
+	pcr = (pcr * 300) + (((pkt[10] & 1) << 8) | pkt[11]);
+
+	if (p->have_pcr) {
+		delta = (pcr + PCR_WRAP - p->last_pcr) % PCR_WRAP;
+		bits = (double) (packet_pos - p->last_pcr_packet) * TS_PACKET_SIZE * 8;
+
+		if ((delta == 0) || (delta > PCR_MAX_GAP)) {
+			p->pcr_bitrate = 0;
+		} else {
+			// how far the PCR is from where the bytes in between say it should be
+			if (p->pcr_bitrate > 0) {
+				double expected = (bits * PCR_HZ) / p->pcr_bitrate;
+				double jitter = (double) delta - expected;
+
+				if (jitter < 0)
+					jitter = -jitter;
+				if (jitter > p->pcr_jitter_max)
+					p->pcr_jitter_max = jitter;
+				p->pcr_bitrate = (p->pcr_bitrate * 0.9) + (((bits * PCR_HZ) / delta) * 0.1);
+			} else {
+				p->pcr_bitrate = (bits * PCR_HZ) / delta;
+			}
+		}
+	}
+
+	p->have_pcr = 1;
+	p->last_pcr = pcr;
+	p->last_pcr_packet = packet_pos;
+}
+
+static int search_packet(const uint8_t *pkt, int pid)
+{
+	int i;
+
+	if (pid == 0x1fff)
+		return 0;
+	for (i = 0; i < (TS_PACKET_SIZE - search_len); ++i) {
+		if (!memcmp(pkt + i, search, search_len))
+			return 1;
+	}
+	return 0;
+}
+
+static void count_packet(const uint8_t *pkt)
+{
+	struct pid_stats *p;
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	int afc = (pkt[3] >> 4) & 3;
+	int discontinuity = 0;
+
+	packet_pos++;
+	if (search && !search_packet(pkt, pid))
+		return;
+
+	p = &pids[pid];
+	p->packets++;
+	total.packets++;
+	if (pid == 0x1fff)
+		return;
+
+	if (pkt[3] & 0xc0) {
+		p->scrambled++;
+		total.scrambled++;
+	}
+
+	// adaptation field: discontinuity indicator and PCR
+	if ((afc & 2) && (pkt[4] > 0)) {
+		discontinuity = pkt[5] & 0x80;
+		if (discontinuity)
+			p->have_pcr = 0;
+		if ((pkt[4] >= 7) && (pkt[5] & 0x10))
+			count_pcr(p, pkt);
+	}
+
+	if (afc) {
+		uint32_t before = p->cc_errors;
+
+		count_cc(p, pkt, discontinuity);
+		total.cc_errors += p->cc_errors - before;
+	}
+}
+
+/**
+ * Count the packets in a buffer, peeling off packets one sync byte at a
+ * time and resynchronising on anything else.
+ *
+ * @return Number of bytes consumed; the rest is an incomplete packet.
+ */
+static int count_buffer(const uint8_t *buf, int len)
+{
+	int pos = 0;
+	int run;
+
+	while ((len - pos) >= TS_PACKET_SIZE) {
+		// the common case: a run of packets in sync
+		run = pos;
+		while (((len - pos) >= TS_PACKET_SIZE) && (buf[pos] == 0x47)) {
+			count_packet(buf + pos);
+			pos += TS_PACKET_SIZE;
+		}
+		if (profile && (pos > run))
+			profile_add(profile, buf + run, pos - run);
+		if ((len - pos) < TS_PACKET_SIZE)
+			break;
+
+		// lost sync: find the next sync byte
+		while (((len - pos) >= TS_PACKET_SIZE) && (buf[pos] != 0x47)) {
+			pos++;
+			desync_bytes++;
+		}
+	}
+
+	return pos;
+}
+
+/**
+ * Count the packets in the next buffer of the stream, completing the packet
+ * split off the end of the previous one first.
+ */
+static void count_data(const uint8_t *buf, int len)
+{
+	int n, used, pos = 0;
+
+	if (carry_len) {
+		n = (len < TS_PACKET_SIZE) ? len : TS_PACKET_SIZE;
+		memcpy(carry + carry_len, buf, n);
+		used = count_buffer(carry, carry_len + n);
+		if (used < carry_len) {
+			// all of buf went in, and still no whole packet
+			carry_len += n - used;
+			memmove(carry, carry + used, carry_len);
+			return;
+		}
+		pos = used - carry_len;
+	}
+
+	pos += count_buffer(buf + pos, len - pos);
+	carry_len = len - pos;
+	memcpy(carry, buf + pos, carry_len);
+}
+
+static uint32_t window_sum(struct pid_stats *p)
+{
+	uint32_t sum = 0;
+	int i;
+
+	for (i = 0; i < window_filled; i++)
+		sum += p->window[i];
+	return sum;
+}
+
+static void print_line(const char *name, struct pid_stats *p, int diff, int window_total)
+{
+	uint64_t packets = p->packets;
+	uint64_t avg = 0;
+
+	if (window_total)
+		avg = (uint64_t) window_sum(p) * 8 * 1000 / window_total * TS_PACKET_SIZE / 1000;
+
+	printf("%s %5llu p/s %5llu kb/s %5llu kbit %7llu kbit %6u %4u%%",
+	       name,
+	       (unsigned long long) (packets * 1000 / diff),
+	       (unsigned long long) (packets * 1000 / diff * TS_PACKET_SIZE / 1024),
+	       (unsigned long long) (packets * 8 * 1000 / diff * TS_PACKET_SIZE / 1000),
+	       (unsigned long long) avg,
+	       p->cc_errors,
+	       p->packets ? (p->scrambled * 100) / p->packets : 0);
+	if (p->pcr_jitter_max)
+		printf(" %8.1f us", (p->pcr_jitter_max * 1000000.0) / PCR_HZ);
+	printf("\n");
+}
+
+static void report_services(void)
+{
+	struct profile_stats stats;
+	int count = profile_service_count(profile);
+	char name[8], pid_text[8];
+	int i, w, pid_count;
+
+	for (i = 0; i <= count; i++) {
+		int idx = (i < count) ? i : PROFILE_OTHER;
+
+		if (idx == PROFILE_OTHER) {
+			strcpy(name, "other");
+			strcpy(pid_text, "-");
+		} else {
+			sprintf(name, "%d", profile_service_id(profile, idx, &pid_count));
+			sprintf(pid_text, "%d", pid_count);
+		}
+		for (w = 0; w < profile_params.window_count; w++) {
+			profile_stats(profile, idx, w, &stats);
+			if (!stats.windows)
+				continue;
+			printf("%5s %4s %9d %10llu %10llu %10llu\n",
+			       name, pid_text, profile_params.windows[w],
+			       (unsigned long long) (stats.mean / 1000),
+			       (unsigned long long) (stats.p99 / 1000),
+			       (unsigned long long) (stats.peak / 1000));
+			name[0] = pid_text[0] = 0;
+		}
+	}
+	printf("--SID-PIDS-WINDOW(ms)-MEAN(kbit)--P99(kbit)-PEAK(kbit)\n");
+}
+
+static void report_plan(void)
+{
+	static const char *metric_names[] = { "peak", "p99", "mean" };
+	struct plan_link links[32];
+	int unplaced[PROFILE_MAX_SERVICES];
+	int window = plan_window ? plan_window : profile_params.windows[0];
+	int i, l, lost;
+
+	for (l = 0; l < plan_links; l++)
+		links[l].capacity = plan_capacity[l] * 1000;
+	if ((lost = plan_pack(profile, window, plan_metric, links, plan_links, unplaced)) < 0) {
+		printf("plan: not enough history for %d ms windows\n", window);
+		return;
+	}
+
+	printf("plan: %s over %d ms windows\n", metric_names[plan_metric], window);
+	for (l = 0; l < plan_links; l++) {
+		printf("link %d: %llu kbit/s, %llu kbit/s used (%llu kbit/s apart):", l + 1,
+		       (unsigned long long) plan_capacity[l],
+		       (unsigned long long) (links[l].load / 1000),
+		       (unsigned long long) (links[l].sum / 1000));
+		for (i = 0; i < links[l].service_count; i++)
+			printf(" %d", profile_service_id(profile, links[l].services[i], NULL));
+		printf("\n");
+	}
+	if (lost) {
+		printf("unplaced:");
+		for (i = 0; i < lost; i++)
+			printf(" %d (%lld kbit/s)", profile_service_id(profile, unplaced[i], NULL),
+			       (long long) (plan_metric_of(profile, unplaced[i], window, plan_metric) / 1000));
+		printf("\n");
+	}
+}
+
+static void report(int diff)
+{
+	char name[8];
+	int window_total = 0;
+	int pid;
+	int i;
+
+	// the interval that just ended enters the window
+	if (window_filled < window_len)
+		window_filled++;
+	window_ms[window_pos] = diff;
+	for (i = 0; i < window_filled; i++)
+		window_total += window_ms[i];
+
+	for (pid = 0; pid < 0x2000; pid++) {
+		struct pid_stats *p = &pids[pid];
+
+		if (p->window == NULL) {
+			if (!p->packets)
+				continue;
+			if ((p->window = calloc(window_len, sizeof(uint32_t))) == NULL)
+				continue;
+		}
+		p->window[window_pos] = p->packets;
+
+		if (!profile && window_sum(p)) {
+			sprintf(name, "%04x", pid);
+			print_line(name, p, diff, window_total);
+		}
+		p->packets = 0;
+		p->scrambled = 0;
+		p->cc_errors = 0;
+		p->pcr_jitter_max = 0;
+	}
+
+	if (total.window == NULL)
+		total.window = calloc(window_len, sizeof(uint32_t));
+	if (total.window)
+		total.window[window_pos] = total.packets;
+	if (profile) {
+		report_services();
+	} else {
+		print_line("2000", &total, diff, total.window ? window_total : 0);
+		printf("-PID--FREQ-----BANDWIDTH-BANDWIDTH--AVG(%ds)--CC-ERR-SCRAMBLED-PCR-JITTER\n",
+		       (window_total + 500) / 1000);
+	}
+	if (desync_bytes)
+		printf("desync: %llu bytes skipped\n", (unsigned long long) desync_bytes);
+	fflush(stdout);
+
+	total.packets = 0;
+	total.scrambled = 0;
+	total.cc_errors = 0;
+	desync_bytes = 0;
+	window_pos = (window_pos + 1) % window_len;
+}
+
 int main(int argc, char **argv)
 {
 	struct timeval startt;
 	int adapter = 0, demux = 0;
-	char *search = NULL;
-	int fd, ffd, packets = 0;
+	char *filename = NULL;
+	int buffer_mb = 8;
+	int interval = 1000;
+	int fd, ffd = -1;
 	int opt;
+	int pid, i;
+	struct dvbdemux_stream *stream;
+	int buffer_size = CHUNK_PACKETS * TS_PACKET_SIZE;
+	struct sigaction sa;
+	uint64_t values[PROFILE_MAX_WINDOWS];
+	int profile_mode = 0;
+	int history = 600;
+	int mux_rate = 0;
 
-	while ((opt = getopt(argc, argv, "a:d:hs:")) != -1) {
+	while ((opt = getopt(argc, argv, "a:b:d:f:hi:s:w:SW:H:r:P:m:")) != -1) {
 		switch (opt) {
 		case 'a':
 			adapter = atoi(optarg);
 			break;
+		case 'b':
+			buffer_mb = atoi(optarg);
+			break;
 		case 'd':
 			demux = atoi(optarg);
 			break;
+		case 'f':
+			filename = optarg;
+			break;
 		case 'h':
 			usage(stdout);
 			exit(0);
+		case 'i':
+			interval = atoi(optarg);
+			break;
 		case 's':
 			search = strdup(optarg);
+			search_len = strlen(search);
+			break;
+		case 'w':
+			window_len = atoi(optarg);
+			break;
+		case 'S':
+			profile_mode = 1;
+			break;
+		case 'W':
+			if ((profile_params.window_count = parse_list(optarg, values, PROFILE_MAX_WINDOWS)) < 0) {
+				usage(stderr);
+				exit(1);
+			}
+			for (i = 0; i < profile_params.window_count; i++)
+				profile_params.windows[i] = (values[i] < INT_MAX) ? values[i] : 0;
+			break;
+		case 'H':
+			history = atoi(optarg);
+			break;
+		case 'r':
+			mux_rate = atoi(optarg);
+			break;
+		case 'P':
+			if ((plan_links = parse_list(optarg, plan_capacity, 32)) < 0) {
+				usage(stderr);
+				exit(1);
+			}
+			profile_mode = 1;
+			break;
+		case 'm':
+			if (parse_metric(optarg)) {
+				usage(stderr);
+				exit(1);
+			}
 			break;
 		default:
 			usage(stderr);
 			exit(1);
 		}
 	}
-
-	// open the DVR device
-	fd = dvbdemux_open_dvr(adapter, demux, 1, 0);
-	if (fd < 0) {
- 		fprintf(stderr, "dvbtraffic: Could not open dvr device: %m\n");
+	if ((interval <= 0) || (window_len <= 0) || (window_len > MAX_WINDOW) || (buffer_mb <= 0) ||
+	    (search_len >= TS_PACKET_SIZE)) {
+		usage(stderr);
 		exit(1);
 	}
-	dvbdemux_set_buffer(fd, 1024 * 1024);
 
-	ffd = dvbdemux_open_demux(adapter, demux, 0);
-	if (ffd < 0) {
-		fprintf(stderr, "dvbtraffic: Could not open demux device: %m\n");
-		exit(1);
-	}
+	for (pid = 0; pid < 0x2000; pid++)
+		pids[pid].last_cc = -1;
 
-	if (dvbdemux_set_pid_filter(ffd, -1, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DVR, 1)) {
-		perror("dvbdemux_set_pid_filter");
-		return -1;
+	if (profile_mode) {
+		if ((history < 0) || (mux_rate < 0) || (plan_window % profile_params.windows[0])) {
+			usage(stderr);
+			exit(1);
+		}
+		profile_params.history_slots = ((uint64_t) history * 1000) / profile_params.windows[0];
+		profile_params.mux_rate = (uint64_t) mux_rate * 1000;
+		if ((profile = profile_create(&profile_params)) == NULL) {
+			fprintf(stderr, "dvbtraffic: Bad -W windows, or out of memory\n");
+			exit(1);
+		}
 	}
 
-	gettimeofday(&startt, 0);
+	// stop at the end of a read to give the final figures
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
 
-	while (1) {
-		unsigned char buffer[BSIZE];
-		int pid, ok;
-		ssize_t r;
+	if (filename) {
+		if (!strcmp(filename, "-"))
+			fd = 0;
+		else if ((fd = open(filename, O_RDONLY)) < 0) {
+			fprintf(stderr, "dvbtraffic: Could not open %s: %m\n", filename);
+			exit(1);
+		}
+	} else {
+		// open the DVR device
+		fd = dvbdemux_open_dvr(adapter, demux, 1, 0);
+		if (fd < 0) {
+			fprintf(stderr, "dvbtraffic: Could not open dvr device: %m\n");
+			exit(1);
+		}
+		dvbdemux_set_buffer(fd, buffer_mb * 1024 * 1024);
 
-		if ((r = read(fd, buffer, BSIZE)) <= 0) {
-			perror("read");
-			break;
+		ffd = dvbdemux_open_demux(adapter, demux, 0);
+		if (ffd < 0) {
+			fprintf(stderr, "dvbtraffic: Could not open demux device: %m\n");
+			exit(1);
 		}
-		if (r != BSIZE) {
-			fprintf(stderr, "dvbtraffic: only read %zd bytes\n", r);
-			break;
+
+		if (dvbdemux_set_pid_filter(ffd, -1, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DVR, 1)) {
+			perror("dvbdemux_set_pid_filter");
+			return -1;
 		}
-		if (buffer[0] != 0x47) {
-			continue;
-			printf("desync (%x)\n", buffer[0]);
-			while (buffer[0] != 0x47)
-				read(fd, buffer, 1);
-			continue;
-		}
-		ok = 1;
-		pid = ((((unsigned) buffer[1]) << 8) |
-		       ((unsigned) buffer[2])) & 0x1FFF;
-
-		if (search) {
-			int i, sl = strlen(search);
-			ok = 0;
-			if (pid != 0x1fff) {
-				for (i = 0; i < (188 - sl); ++i) {
-					if (!memcmp(buffer + i, search, sl))
-						ok = 1;
-				}
-			}
+	}
+
+	// a DVR is streamed from mapped kernel buffers when it can be, which
+	// then make up the -b size between them
+	if (filename)
+		stream = dvbdemux_stream_open(fd, -1, buffer_size);
+	else
+		stream = dvbdemux_stream_open(fd, DVBDEMUX_STREAM_BUFFERS,
+					      ((buffer_mb * 1024 * 1024 / DVBDEMUX_STREAM_BUFFERS) /
+					       TS_PACKET_SIZE) * TS_PACKET_SIZE);
+	if (stream == NULL) {
+		fprintf(stderr, "dvbtraffic: Out of memory\n");
+		exit(1);
+	}
+	if (!filename && !dvbdemux_stream_mapped(stream)) {
+		// reading after all: in the usual size
+		dvbdemux_stream_close(stream);
+		if ((stream = dvbdemux_stream_open(fd, -1, buffer_size)) == NULL) {
+			fprintf(stderr, "dvbtraffic: Out of memory\n");
+			exit(1);
 		}
+	}
+
+	gettimeofday(&startt, 0);
 
-		if (ok) {
-			pidt[pid]++;
-			pidt[0x2000]++;
-		}
-
-		packets++;
-
-		if (!(packets & 0xFF)) {
-			struct timeval now;
-			int diff;
-			gettimeofday(&now, 0);
-			diff =
-			    (now.tv_sec - startt.tv_sec) * 1000 +
-			    (now.tv_usec - startt.tv_usec) / 1000;
-			if (diff > 1000) {
-				int _pid = 0;
-				for (_pid = 0; _pid < 0x2001; _pid++) {
-					if (pidt[_pid]) {
-						printf("%04x %5d p/s %5d kb/s %5d kbit\n",
-						     _pid,
-						     pidt[_pid] * 1000 / diff,
-						     pidt[_pid] * 1000 / diff * 188 / 1024,
-						     pidt[_pid] * 8 * 1000 / diff * 188 / 1000);
-					}
-					pidt[_pid] = 0;
-				}
-				printf("-PID--FREQ-----BANDWIDTH-BANDWIDTH-\n");
-				startt = now;
+	while (!stop) {
+		struct timeval now;
+		uint8_t *data;
+		int r;
+		int diff;
+
+		if ((r = dvbdemux_stream_get(stream, &data)) <= 0) {
+			if ((r < 0) && (errno == EOVERFLOW)) {
+				fprintf(stderr, "dvbtraffic: DVR buffer overflow, data lost\n");
+				continue;
 			}
+			if ((r < 0) && !stop)
+				perror("read");
+			break;
+		}
+
+		count_data(data, r);
+		dvbdemux_stream_release(stream);
+
+		gettimeofday(&now, 0);
+		diff = (now.tv_sec - startt.tv_sec) * 1000 +
+		       (now.tv_usec - startt.tv_usec) / 1000;
+		if (diff >= interval) {
+			report(diff);
+			startt = now;
 		}
 	}
 
-	close(ffd);
+	// what is left of a file
+	if (filename && total.packets && !profile) {
+		struct timeval now;
+		int diff;
+
+		gettimeofday(&now, 0);
+		diff = (now.tv_sec - startt.tv_sec) * 1000 +
+		       (now.tv_usec - startt.tv_usec) / 1000;
+		report(diff ? diff : 1);
+	}
+
+	if (profile) {
+		report_services();
+		if (plan_links)
+			report_plan();
+		profile_destroy(profile);
+	}
+
+	dvbdemux_stream_close(stream);
+	if (ffd >= 0)
+		close(ffd);
 	close(fd);
 	return 0;
 }
@@ -0,0 +1,207 @@
+/* This file is released into the public domain by its authors */
+
+#include <stdlib.h>
+#include <string.h>
+#include "dvbtraffic_plan.h"
+
+#define PACKET_BITS (188 * 8)
+
+// k'th smallest of v[0..n), reordering v
+static uint32_t select_kth(uint32_t *v, int n, int k)
+{
+	int lo = 0, hi = n - 1;
+
+	while (lo < hi) {
+		uint32_t pivot = v[(lo + hi) / 2];
+		int i = lo, j = hi;
+
+		while (i <= j) {
+			while (v[i] < pivot)
+				i++;
+			while (v[j] > pivot)
+				j--;
+			if (i <= j) {
+				uint32_t t = v[i];
+
+				v[i++] = v[j];
+				v[j--] = t;
+			}
+		}
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;
+	}
+	return v[k];
+}
+
+// the metric of a per window series, in bit/s
+static uint64_t series_metric(const uint32_t *series, int n, int window_ms,
+			      enum plan_metric metric, uint32_t *scratch)
+{
+	uint64_t scale = (uint64_t) PACKET_BITS * 1000;
+	uint64_t sum = 0;
+	uint32_t max = 0;
+	int i;
+
+	switch (metric) {
+	case PLAN_PEAK:
+		for(i=0; i < n; i++) {
+			if (series[i] > max)
+				max = series[i];
+		}
+		return ((uint64_t) max * scale) / window_ms;
+
+	case PLAN_P99:
+		memcpy(scratch, series, n * sizeof(uint32_t));
+		return ((uint64_t) select_kth(scratch, n, ((n * 99) + 99) / 100 - 1) * scale) / window_ms;
+
+	case PLAN_MEAN:
+		for(i=0; i < n; i++)
+			sum += series[i];
+		return (sum * scale) / ((uint64_t) n * window_ms);
+	}
+	return 0;
+}
+
+/**
+ * The history of a service in windows of window_ms.
+ *
+ * @return Number of windows, or -1.
+ */
+static int service_series(struct profile *prof, int idx, int window_ms,
+			  uint32_t *slots, uint32_t *series)
+{
+	int per = window_ms / profile_slot_ms(prof);
+	int n = profile_history(prof, idx, slots) / per;
+	int i, j;
+
+	for(i=0; i < n; i++) {
+		series[i] = 0;
+		for(j=0; j < per; j++)
+			series[i] += slots[(i * per) + j];
+	}
+	return n;
+}
+
+static int plan_check(struct profile *prof, int window_ms)
+{
+	return (window_ms > 0) && ((window_ms % profile_slot_ms(prof)) == 0);
+}
+
+int64_t plan_metric_of(struct profile *prof, int idx, int window_ms, enum plan_metric metric)
+{
+	uint32_t *slots, *series;
+	int64_t result = -1;
+	int n = profile_history(prof, idx, NULL) + 1;
+
+	if (!plan_check(prof, window_ms))
+		return -1;
+	if (((slots = malloc(n * sizeof(uint32_t))) == NULL) ||
+	    ((series = malloc(n * sizeof(uint32_t))) == NULL)) {
+		free(slots);
+		return -1;
+	}
+
+	if ((n = service_series(prof, idx, window_ms, slots, series)) > 0)
+		result = series_metric(series, n, window_ms, metric, slots);
+
+	free(series);
+	free(slots);
+	return result;
+}
+
+struct candidate {
+	int idx;
+	uint64_t metric;
+};
+
+static int candidate_cmp(const void *a, const void *b)
+{
+	const struct candidate *ca = a;
+	const struct candidate *cb = b;
+
+	if (ca->metric != cb->metric)
+		return (ca->metric < cb->metric) ? 1 : -1;
+	return ca->idx - cb->idx;
+}
+
+int plan_pack(struct profile *prof, int window_ms, enum plan_metric metric,
+	      struct plan_link *links, int link_count, int *unplaced)
+{
+	int count = profile_service_count(prof);
+	int slot_count, n = 0, i, l, w;
+	struct candidate candidates[PROFILE_MAX_SERVICES];
+	uint32_t *slots = NULL, *series = NULL, *loads = NULL, *trial = NULL;
+	int result = -1;
+	int lost = 0;
+
+	if (!plan_check(prof, window_ms) || (count == 0))
+		return -1;
+	slot_count = profile_history(prof, 0, NULL);
+	if ((slot_count / (window_ms / profile_slot_ms(prof))) == 0)
+		return -1;
+
+	// a series per service, and per link what is on it so far
+	if (((slots = malloc((slot_count + 1) * sizeof(uint32_t))) == NULL) ||
+	    ((series = malloc((size_t) count * (slot_count + 1) * sizeof(uint32_t))) == NULL) ||
+	    ((loads = calloc((size_t) link_count * (slot_count + 1), sizeof(uint32_t))) == NULL) ||
+	    ((trial = malloc((slot_count + 1) * sizeof(uint32_t))) == NULL))
+		goto out;
+
+	for(i=0; i < count; i++) {
+		n = service_series(prof, i, window_ms, slots, series + ((size_t) i * slot_count));
+		candidates[i].idx = i;
+		candidates[i].metric = series_metric(series + ((size_t) i * slot_count), n,
+						     window_ms, metric, slots);
+	}
+	qsort(candidates, count, sizeof(struct candidate), candidate_cmp);
+
+	for(l=0; l < link_count; l++) {
+		links[l].load = 0;
+		links[l].sum = 0;
+		links[l].service_count = 0;
+	}
+
+	// best fit decreasing, on what the link would carry with the service added
+	for(i=0; i < count; i++) {
+		uint32_t *s = series + ((size_t) candidates[i].idx * slot_count);
+		uint64_t best_room = 0, best_load = 0;
+		int best = -1;
+
+		for(l=0; l < link_count; l++) {
+			uint32_t *load = loads + ((size_t) l * slot_count);
+			uint64_t m;
+
+			for(w=0; w < n; w++)
+				trial[w] = load[w] + s[w];
+			if ((m = series_metric(trial, n, window_ms, metric, slots)) > links[l].capacity)
+				continue;
+			if ((best < 0) || ((links[l].capacity - m) < best_room)) {
+				best = l;
+				best_room = links[l].capacity - m;
+				best_load = m;
+			}
+		}
+
+		if (best < 0) {
+			unplaced[lost++] = candidates[i].idx;
+			continue;
+		}
+		for(w=0; w < n; w++)
+			loads[((size_t) best * slot_count) + w] += s[w];
+		links[best].services[links[best].service_count++] = candidates[i].idx;
+		links[best].load = best_load;
+		links[best].sum += candidates[i].metric;
+	}
+	result = lost;
+
+out:
+	free(trial);
+	free(loads);
+	free(series);
+	free(slots);
+	return result;
+}
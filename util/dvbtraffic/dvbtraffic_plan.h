@@ -0,0 +1,56 @@
+/* This file is released into the public domain by its authors */
+
+#ifndef DVBTRAFFIC_PLAN_H
+#define DVBTRAFFIC_PLAN_H 1
+
+#include <stdint.h>
+#include "dvbtraffic_profile.h"
+
+/**
+ * Packing planner: groups the profiled services onto links of given
+ * capacities (best fit decreasing). Whether a service fits on a link is
+ * decided on the services of the link added up window by window over the
+ * profile's history, rather than on the sum of their own figures: their
+ * peaks rarely coincide, so links can be packed tighter than the sum of
+ * the peaks would allow.
+ */
+
+enum plan_metric {
+	PLAN_PEAK,
+	PLAN_P99,
+	PLAN_MEAN,
+};
+
+struct plan_link {
+	uint64_t capacity;		/* bit/s; filled in by the caller */
+	uint64_t load;			/* the metric of its services together */
+	uint64_t sum;			/* the sum of the metrics of its services alone */
+	int service_count;
+	int services[PROFILE_MAX_SERVICES];	/* profile indexes */
+};
+
+/**
+ * Plan the links.
+ *
+ * @param prof The profiler, with some history.
+ * @param window_ms Window the metric is taken over: a multiple of the slot.
+ * @param metric What has to fit the capacity.
+ * @param links The links, with their capacities set.
+ * @param link_count How many.
+ * @param unplaced Filled in with the indexes of the services which did not
+ * fit anywhere.
+ * @return Number of unplaced services, or -1 if the history is shorter than
+ * the window or out of memory.
+ */
+extern int plan_pack(struct profile *prof, int window_ms, enum plan_metric metric,
+		     struct plan_link *links, int link_count, int *unplaced);
+
+/**
+ * The metric of a single service over its history, as the planner sees it.
+ *
+ * @return The metric in bit/s, or -1 as plan_pack().
+ */
+extern int64_t plan_metric_of(struct profile *prof, int idx, int window_ms,
+			      enum plan_metric metric);
+
+#endif
@@ -0,0 +1,473 @@
+/* This file is released into the public domain by its authors */
+
+#include <stdlib.h>
+#include <string.h>
+#include <libucsi/section.h>
+#include <libucsi/section_reasm.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/mpeg/section.h>
+#include "dvbtraffic_profile.h"
+
+#define PCR_HZ 27000000ULL
+#define PCR_WRAP ((1ULL << 33) * 300)
+#define PCR_MAX_GAP (PCR_HZ / 2)
+
+#define PACKET_BITS (TRANSPORT_PACKET_LENGTH * 8)
+
+/*
+ * Histogram of packets per window: exact below 64, then 32 buckets per
+ * power of two.
+ */
+#define HIST_EXACT 64
+#define HIST_SUB 32
+#define HIST_BUCKETS (HIST_EXACT + (26 * HIST_SUB))
+
+struct window_stats {
+	uint32_t acc;			/* packets in the current window */
+	uint32_t max;
+	uint64_t count;
+	uint64_t sum;
+	uint32_t hist[HIST_BUCKETS];
+};
+
+struct service {
+	int service_id;
+	int pmt_pid;			/* -1 => no longer in the PAT */
+	int pmt_version;		/* -1 => none yet */
+	int pid_count;
+	uint64_t first_slot;
+	uint32_t slot;			/* packets in the current slot */
+	uint32_t *history;
+	struct window_stats win[PROFILE_MAX_WINDOWS];
+};
+
+struct profile {
+	struct profile_params params;
+	int slots_per_window[PROFILE_MAX_WINDOWS];
+	struct section_reasm *reasm;
+	struct transport_packet_batch batch;
+	uint8_t section[DVB_MAX_SECTION_BYTES];
+
+	uint64_t pid_services[TRANSPORT_MAX_PIDS];
+	uint8_t psi_pid[TRANSPORT_MAX_PIDS];
+	struct service services[PROFILE_MAX_SERVICES];
+	int service_count;
+	struct service other;
+	int pat_version;
+
+	// the slot clock, in packets of the stream and unwrapped 27MHz ticks
+	uint64_t pos;
+	int ref_pid;			/* -1 => the first PID with a PCR */
+	int have_pcr;
+	uint64_t last_pcr;
+	uint64_t last_pos;
+	double last_time;
+	uint64_t anchor_pos;
+	double anchor_time;
+	double ticks_per_packet;	/* 0 => not known yet */
+	int started;
+	double slot_ticks;
+	double boundary_time;		/* end of the current slot */
+	double boundary_pos;
+	uint64_t slot_index;		/* slots closed */
+};
+
+static int hist_bucket(uint32_t v)
+{
+	int shift;
+
+	if (v < HIST_EXACT)
+		return v;
+	shift = (31 - __builtin_clz(v)) - 5;
+	return HIST_EXACT + ((shift - 1) * HIST_SUB) + ((v >> shift) - HIST_SUB);
+}
+
+// the largest value counted in a bucket
+static uint32_t hist_value(int bucket)
+{
+	int shift, sub;
+
+	if (bucket < HIST_EXACT)
+		return bucket;
+	shift = ((bucket - HIST_EXACT) / HIST_SUB) + 1;
+	sub = ((bucket - HIST_EXACT) % HIST_SUB) + HIST_SUB;
+	return (((uint64_t) (sub + 1)) << shift) - 1;
+}
+
+static void service_init(struct profile *prof, struct service *s)
+{
+	memset(s, 0, sizeof(struct service));
+	s->pmt_pid = -1;
+	s->pmt_version = -1;
+	s->first_slot = prof->slot_index;
+	if (prof->params.history_slots)
+		s->history = calloc(prof->params.history_slots, sizeof(uint32_t));
+}
+
+struct profile *profile_create(struct profile_params *params)
+{
+	struct profile *prof;
+	int i;
+
+	if ((params->window_count < 1) || (params->window_count > PROFILE_MAX_WINDOWS) ||
+	    (params->windows[0] <= 0) || (params->history_slots < 0))
+		return NULL;
+	for(i=0; i < params->window_count; i++) {
+		if ((params->windows[i] <= 0) || (params->windows[i] % params->windows[0]))
+			return NULL;
+	}
+
+	if ((prof = calloc(1, sizeof(struct profile))) == NULL)
+		return NULL;
+	prof->params = *params;
+	for(i=0; i < params->window_count; i++)
+		prof->slots_per_window[i] = params->windows[i] / params->windows[0];
+	if ((prof->reasm = section_reasm_create(PROFILE_MAX_SERVICES + 1,
+						DVB_MAX_SECTION_BYTES)) == NULL) {
+		free(prof);
+		return NULL;
+	}
+	section_reasm_add_pid(prof->reasm, TRANSPORT_PAT_PID);
+	prof->psi_pid[TRANSPORT_PAT_PID] = 1;
+	prof->pat_version = -1;
+	prof->ref_pid = -1;
+	prof->slot_ticks = (double) params->windows[0] * (PCR_HZ / 1000);
+	service_init(prof, &prof->other);
+
+	if (params->mux_rate) {
+		prof->ticks_per_packet = ((double) PACKET_BITS * PCR_HZ) / params->mux_rate;
+		prof->started = 1;
+		prof->boundary_time = prof->slot_ticks;
+		prof->boundary_pos = prof->slot_ticks / prof->ticks_per_packet;
+	}
+
+	return prof;
+}
+
+void profile_destroy(struct profile *prof)
+{
+	int i;
+
+	for(i=0; i < prof->service_count; i++)
+		free(prof->services[i].history);
+	free(prof->other.history);
+	section_reasm_destroy(prof->reasm);
+	free(prof);
+}
+
+static void service_clear_pids(struct profile *prof, int idx)
+{
+	uint64_t mask = ~(1ULL << idx);
+	int pid;
+
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++)
+		prof->pid_services[pid] &= mask;
+	prof->services[idx].pid_count = 0;
+}
+
+static void service_add_pid(struct profile *prof, int idx, int pid)
+{
+	if ((pid >= TRANSPORT_NULL_PID) || (prof->pid_services[pid] & (1ULL << idx)))
+		return;
+	prof->pid_services[pid] |= 1ULL << idx;
+	prof->services[idx].pid_count++;
+}
+
+static void handle_pat(struct profile *prof, struct section_ext *ext)
+{
+	struct mpeg_pat_section *pat;
+	struct mpeg_pat_program *program;
+	uint64_t listed = 0;
+	int i;
+
+	// nearly always a single section: anything else is only added to
+	if ((ext->last_section_number == 0) && (ext->version_number == prof->pat_version))
+		return;
+	if ((pat = mpeg_pat_section_codec(ext)) == NULL)
+		return;
+
+	mpeg_pat_section_programs_for_each(pat, program) {
+		if (program->program_number == 0)
+			continue;
+
+		for(i=0; i < prof->service_count; i++) {
+			if (prof->services[i].service_id == program->program_number)
+				break;
+		}
+		if (i == prof->service_count) {
+			if (i == PROFILE_MAX_SERVICES)
+				continue;
+			service_init(prof, &prof->services[i]);
+			prof->services[i].service_id = program->program_number;
+			prof->service_count++;
+		}
+		listed |= 1ULL << i;
+
+		if (prof->services[i].pmt_pid != program->pid) {
+			service_clear_pids(prof, i);
+			prof->services[i].pmt_pid = program->pid;
+			prof->services[i].pmt_version = -1;
+			if (section_reasm_add_pid(prof->reasm, program->pid) == 0)
+				prof->psi_pid[program->pid] = 1;
+		}
+	}
+
+	if (ext->last_section_number == 0) {
+		for(i=0; i < prof->service_count; i++) {
+			if ((listed & (1ULL << i)) || (prof->services[i].pmt_pid < 0))
+				continue;
+			service_clear_pids(prof, i);
+			prof->services[i].pmt_pid = -1;
+			prof->services[i].pmt_version = -1;
+		}
+		prof->pat_version = ext->version_number;
+	}
+}
+
+static void handle_pmt(struct profile *prof, int pid, struct section_ext *ext)
+{
+	struct mpeg_pmt_section *pmt;
+	struct mpeg_pmt_stream *stream;
+	struct service *s;
+	int i;
+
+	for(i=0; i < prof->service_count; i++) {
+		s = &prof->services[i];
+		if ((s->service_id == ext->table_id_ext) && (s->pmt_pid == pid))
+			break;
+	}
+	if ((i == prof->service_count) || (s->pmt_version == ext->version_number))
+		return;
+	if ((pmt = mpeg_pmt_section_codec(ext)) == NULL)
+		return;
+
+	service_clear_pids(prof, i);
+	service_add_pid(prof, i, pid);
+	service_add_pid(prof, i, pmt->pcr_pid);
+	mpeg_pmt_section_streams_for_each(pmt, stream) {
+		service_add_pid(prof, i, stream->pid);
+	}
+	s->pmt_version = ext->version_number;
+}
+
+static void handle_section(void *private, int pid, uint8_t *data, int len)
+{
+	struct profile *prof = private;
+	struct section *section;
+	struct section_ext *ext;
+
+	// decoded in place, and a section within one packet is still in the
+	// caller's buffer, which may be a read-only mapping
+	memcpy(prof->section, data, len);
+	if ((section = section_codec(prof->section, len)) == NULL)
+		return;
+	if ((ext = section_ext_decode(section, 1)) == NULL)
+		return;
+	if (!ext->current_next_indicator)
+		return;
+
+	if ((pid == TRANSPORT_PAT_PID) && (ext->table_id == stag_mpeg_program_association))
+		handle_pat(prof, ext);
+	else if (ext->table_id == stag_mpeg_program_map)
+		handle_pmt(prof, pid, ext);
+}
+
+static void window_record(struct window_stats *win, uint32_t packets)
+{
+	win->count++;
+	win->sum += packets;
+	if (packets > win->max)
+		win->max = packets;
+	win->hist[hist_bucket(packets)]++;
+}
+
+static void service_end_slot(struct profile *prof, struct service *s)
+{
+	uint64_t slots = prof->slot_index + 1;
+	int w;
+
+	if (s->history)
+		s->history[prof->slot_index % prof->params.history_slots] = s->slot;
+
+	for(w=0; w < prof->params.window_count; w++) {
+		struct window_stats *win = &s->win[w];
+		uint64_t len = prof->slots_per_window[w];
+
+		win->acc += s->slot;
+		if (slots % len)
+			continue;
+		// windows which began before the service came along are not whole
+		if (slots - len >= s->first_slot)
+			window_record(win, win->acc);
+		win->acc = 0;
+	}
+	s->slot = 0;
+}
+
+static void profile_end_slot(struct profile *prof)
+{
+	int i;
+
+	for(i=0; i < prof->service_count; i++)
+		service_end_slot(prof, &prof->services[i]);
+	service_end_slot(prof, &prof->other);
+	prof->slot_index++;
+
+	prof->boundary_time += prof->slot_ticks;
+	prof->boundary_pos = prof->last_pos +
+		((prof->boundary_time - prof->last_time) / prof->ticks_per_packet);
+}
+
+static void profile_pcr(struct profile *prof, uint8_t *pkt)
+{
+	uint64_t pcr, delta;
+
+	pcr = (((uint64_t) pkt[6]) << 25) | (pkt[7] << 17) | (pkt[8] << 9) |
+	      (pkt[9] << 1) | (pkt[10] >> 7);
+	pcr = (pcr * 300) + (((pkt[10] & 1) << 8) | pkt[11]);
+
+	if (prof->have_pcr) {
+		delta = (pcr + PCR_WRAP - prof->last_pcr) % PCR_WRAP;
+		if ((delta == 0) || (delta > PCR_MAX_GAP) || (pkt[5] & transport_adaptation_flag_discontinuity)) {
+			// carry the time on over the jump at the rate so far
+			if (prof->ticks_per_packet > 0)
+				prof->last_time += (prof->pos - prof->last_pos) * prof->ticks_per_packet;
+			prof->anchor_pos = prof->pos;
+			prof->anchor_time = prof->last_time;
+		} else {
+			prof->last_time += delta;
+			if (prof->pos > prof->anchor_pos)
+				prof->ticks_per_packet = (prof->last_time - prof->anchor_time) /
+							 (prof->pos - prof->anchor_pos);
+		}
+	} else {
+		prof->anchor_pos = prof->pos;
+		prof->anchor_time = prof->last_time;
+	}
+	prof->have_pcr = 1;
+	prof->last_pcr = pcr;
+	prof->last_pos = prof->pos;
+
+	if (prof->ticks_per_packet <= 0)
+		return;
+	if (!prof->started) {
+		// what came before the rate was known is not counted
+		int i;
+
+		for(i=0; i < prof->service_count; i++)
+			prof->services[i].slot = 0;
+		prof->other.slot = 0;
+		prof->started = 1;
+		prof->boundary_time = prof->last_time + prof->slot_ticks;
+	}
+	prof->boundary_pos = prof->last_pos +
+		((prof->boundary_time - prof->last_time) / prof->ticks_per_packet);
+}
+
+void profile_add(struct profile *prof, const uint8_t *data, int len)
+{
+	struct transport_packet_batch *batch = &prof->batch;
+	uint8_t *buf = (uint8_t *) data;	// only read
+	int used, i;
+
+	while (len >= TRANSPORT_PACKET_LENGTH) {
+		if ((used = transport_packet_batch_extract(buf, len, batch)) == 0) {
+			buf++;
+			len--;
+			continue;
+		}
+
+		for(i=0; i < batch->count; i++) {
+			uint8_t *pkt = buf + (i * TRANSPORT_PACKET_LENGTH);
+			int pid = batch->pid[i];
+			uint64_t mask;
+
+			if ((batch->adaptation_flags[i] & transport_adaptation_flag_pcr) &&
+			    (pkt[4] >= 7) && !prof->params.mux_rate) {
+				if (prof->ref_pid < 0)
+					prof->ref_pid = pid;
+				if (pid == prof->ref_pid)
+					profile_pcr(prof, pkt);
+			}
+			while (prof->started && (prof->pos >= prof->boundary_pos))
+				profile_end_slot(prof);
+			prof->pos++;
+
+			if (prof->psi_pid[pid])
+				section_reasm_add_packet(prof->reasm, pkt, handle_section, prof);
+
+			if (pid == TRANSPORT_NULL_PID)
+				continue;
+			if ((mask = prof->pid_services[pid]) == 0) {
+				prof->other.slot++;
+				continue;
+			}
+			while (mask) {
+				prof->services[__builtin_ctzll(mask)].slot++;
+				mask &= mask - 1;
+			}
+		}
+
+		buf += used;
+		len -= used;
+	}
+}
+
+int profile_service_count(struct profile *prof)
+{
+	return prof->service_count;
+}
+
+int profile_service_id(struct profile *prof, int idx, int *pid_count)
+{
+	if (pid_count)
+		*pid_count = prof->services[idx].pid_count;
+	return prof->services[idx].service_id;
+}
+
+void profile_stats(struct profile *prof, int idx, int window, struct profile_stats *stats)
+{
+	struct service *s = (idx == PROFILE_OTHER) ? &prof->other : &prof->services[idx];
+	struct window_stats *win = &s->win[window];
+	uint64_t scale = (uint64_t) PACKET_BITS * 1000;
+	uint64_t want, seen = 0;
+	int ms = prof->params.windows[window];
+	int b;
+
+	memset(stats, 0, sizeof(struct profile_stats));
+	if ((stats->windows = win->count) == 0)
+		return;
+
+	stats->mean = (win->sum * scale) / (win->count * ms);
+	stats->peak = ((uint64_t) win->max * scale) / ms;
+
+	want = ((win->count * 99) + 99) / 100;
+	for(b=0; b < HIST_BUCKETS; b++) {
+		if ((seen += win->hist[b]) >= want)
+			break;
+	}
+	if ((b == HIST_BUCKETS) || (hist_value(b) > win->max))
+		stats->p99 = stats->peak;
+	else
+		stats->p99 = ((uint64_t) hist_value(b) * scale) / ms;
+}
+
+int profile_history(struct profile *prof, int idx, uint32_t *slots)
+{
+	struct service *s = &prof->services[idx];
+	uint64_t n = prof->params.history_slots;
+	uint64_t start, i;
+
+	if (prof->slot_index < n)
+		n = prof->slot_index;
+	start = prof->slot_index - n;
+
+	for(i=0; slots && (i < n); i++)
+		slots[i] = s->history ? s->history[(start + i) % prof->params.history_slots] : 0;
+	return n;
+}
+
+int profile_slot_ms(struct profile *prof)
+{
+	return prof->params.windows[0];
+}
@@ -0,0 +1,99 @@
+/* This file is released into the public domain by its authors */
+
+#ifndef DVBTRAFFIC_PROFILE_H
+#define DVBTRAFFIC_PROFILE_H 1
+
+#include <stdint.h>
+
+/**
+ * Per-service bitrate profiler. PIDs are mapped to services through the PAT
+ * and PMTs carried in the stream (the PMT PID, the PCR PID and the
+ * elementary streams; a PID shared between services counts for each), and
+ * the packets of each service are counted in slots of the shortest window.
+ *
+ * Slots are timed from the stream rather than the clock: from the PCRs of
+ * the first PID carrying them, interpolating over the packets in between,
+ * or from a fixed mux rate. So a capture file gives the same profile as
+ * the live mux did.
+ *
+ * For every window length the rate over each window is put in a
+ * log-linear histogram (to within 1/32), from which the p99 comes; the
+ * peak and mean are exact. The last history_slots slots of each service
+ * are also kept, for the planner to add services up slot by slot.
+ */
+
+#define PROFILE_MAX_SERVICES 64
+#define PROFILE_MAX_WINDOWS 4
+
+struct profile_params {
+	int windows[PROFILE_MAX_WINDOWS];	/* in ms; multiples of the first, on which slots are timed */
+	int window_count;
+	int history_slots;			/* 0 => keep none */
+	uint64_t mux_rate;			/* bit/s, 0 => time from the PCRs */
+};
+
+struct profile_stats {
+	uint64_t windows;			/* measured so far */
+	uint64_t mean;				/* bit/s */
+	uint64_t p99;
+	uint64_t peak;
+};
+
+struct profile;
+
+/**
+ * Create a profiler.
+ *
+ * @param params The windows and history.
+ * @return The profiler, or NULL on bad parameters or out of memory.
+ */
+extern struct profile *profile_create(struct profile_params *params);
+
+extern void profile_destroy(struct profile *prof);
+
+/**
+ * Count a run of whole transport packets.
+ */
+extern void profile_add(struct profile *prof, const uint8_t *buf, int len);
+
+/**
+ * @return Number of services seen so far; services keep their index once
+ * seen, even if they leave the PAT.
+ */
+extern int profile_service_count(struct profile *prof);
+
+/**
+ * Describe a service.
+ *
+ * @param prof The profiler.
+ * @param idx Its index.
+ * @param pid_count Set to the number of PIDs it currently has.
+ * @return Its service_id.
+ */
+extern int profile_service_id(struct profile *prof, int idx, int *pid_count);
+
+/**
+ * Statistics of a service over one window length. idx may also be
+ * PROFILE_OTHER, for the packets (other than stuffing) of no service: the
+ * SI, and PIDs no PMT refers to.
+ */
+#define PROFILE_OTHER -1
+extern void profile_stats(struct profile *prof, int idx, int window, struct profile_stats *stats);
+
+/**
+ * Retrieve the slot history of a service, oldest first.
+ *
+ * @param prof The profiler.
+ * @param idx Its index.
+ * @param slots Filled in with up to history_slots packet counts; NULL
+ * to only count them.
+ * @return Number of slots filled in; the same for every service.
+ */
+extern int profile_history(struct profile *prof, int idx, uint32_t *slots);
+
+/**
+ * @return Length of a slot in ms.
+ */
+extern int profile_slot_ms(struct profile *prof);
+
+#endif
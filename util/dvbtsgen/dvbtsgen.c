@@ -0,0 +1,363 @@
+/*
+	dvbtsgen utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <libucsi/transport_packet.h>
+#include <libdvbtsgen/dvbtsgen.h>
+
+#define MAX_MUXES 64
+#define CHUNK_PACKETS (TRANSPORT_BATCH_MAX * 4)
+
+struct mux {
+	char name[PATH_MAX];
+	int fd;
+	struct dvbtsgen *gen;
+	uint64_t packets;			/* to generate, 0 => no limit */
+};
+
+static struct mux muxes[MAX_MUXES];
+static int mux_count = 1;
+static volatile sig_atomic_t quit = 0;
+
+static void usage(FILE *output)
+{
+	fprintf(output,
+		"Usage: dvbtsgen [OPTION]...\n"
+		"Generate synthetic DVB transport streams, one per mux of a network.\n"
+		"Options:\n"
+		"	-o FILE	 write to FILE, a FIFO or - for stdout (default); with several\n"
+		"		 muxes, a %%d in FILE is replaced by the mux number\n"
+		"	-a N[:D] write into the DVR D (default 0) of dvb adapter N, and of\n"
+		"		 adapters N+1 and so on for further muxes\n"
+		"	-m N	 number of muxes (default 1)\n"
+		"	-s N	 services per mux (default 8, max %i)\n"
+		"	-b RATE	 mux rate in bits/s, k/M/G suffixes allowed (default 38M)\n"
+		"	-S RATE	 video + audio rate of each service (default 4M)\n"
+		"	-e N	 EIT schedule events per service (default 0: present/following only)\n"
+		"	-E SECS	 length of each event (default 1800)\n"
+		"	-I MS	 repetition interval of the EIT schedule (default 10000)\n"
+		"	-T TIME	 start time, in seconds since the epoch (default now)\n"
+		"	-P MS	 PCR interval (default 30)\n"
+		"	-j NS	 maximum PCR jitter (default 0)\n"
+		"	-c N	 skip a continuity count every N packets on average (default never)\n"
+		"	-r SEED	 seed of the impairments (default 1)\n"
+		"	-t SECS	 length of each stream (default 10, 0 => until interrupted)\n"
+		"	-R	 pace the output at the mux rate instead of as fast as possible\n"
+		"	-q	 do not print statistics at the end\n"
+		"	-h	 display this help\n", DVBTSGEN_MAX_SERVICES);
+}
+
+static void signal_handler(int sig)
+{
+	(void) sig;
+
+	quit = 1;
+}
+
+static uint64_t parse_rate(const char *str)
+{
+	char *end;
+	double rate = strtod(str, &end);
+
+	switch(*end) {
+	case 'k':
+	case 'K':
+		rate *= 1e3;
+		break;
+	case 'm':
+	case 'M':
+		rate *= 1e6;
+		break;
+	case 'g':
+	case 'G':
+		rate *= 1e9;
+		break;
+	case 0:
+		break;
+	default:
+		return 0;
+	}
+	return (rate > 0) ? (uint64_t) rate : 0;
+}
+
+static int open_output(struct mux *mux, int i, const char *output, int adapter, int dvr)
+{
+	if (adapter >= 0) {
+		/* the DVR only accepts data when opened write-only */
+		snprintf(mux->name, sizeof(mux->name), "/dev/dvb/adapter%i/dvr%i", adapter + i, dvr);
+		if ((mux->fd = open(mux->name, O_WRONLY)) < 0) {
+			snprintf(mux->name, sizeof(mux->name), "/dev/dvb%i.dvr%i", adapter + i, dvr);
+			mux->fd = open(mux->name, O_WRONLY);
+		}
+	} else if (strcmp(output, "-") == 0) {
+		snprintf(mux->name, sizeof(mux->name), "stdout");
+		mux->fd = STDOUT_FILENO;
+	} else {
+		const char *pos = strstr(output, "%d");
+
+		if (pos)
+			snprintf(mux->name, sizeof(mux->name), "%.*s%i%s",
+				 (int) (pos - output), output, i, pos + 2);
+		else
+			snprintf(mux->name, sizeof(mux->name), "%s", output);
+		mux->fd = open(mux->name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	}
+
+	if (mux->fd < 0) {
+		fprintf(stderr, "dvbtsgen: Could not open %s: %m\n", mux->name);
+		return -1;
+	}
+	return 0;
+}
+
+static int write_all(struct mux *mux, uint8_t *buf, size_t len)
+{
+	ssize_t written;
+
+	while (len) {
+		if ((written = write(mux->fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno != EPIPE)
+				fprintf(stderr, "dvbtsgen: %s: write failed: %m\n", mux->name);
+			return -1;
+		}
+		buf += written;
+		len -= written;
+	}
+	return 0;
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void pace(uint64_t start, uint64_t packets, uint64_t bitrate)
+{
+	uint64_t due = start + (uint64_t) ((double) packets * TRANSPORT_PACKET_LENGTH * 8 *
+					   1e9 / bitrate);
+	struct timespec ts;
+
+	ts.tv_sec = due / 1000000000ULL;
+	ts.tv_nsec = due % 1000000000ULL;
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+		if (quit)
+			break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct dvbtsgen_config config;
+	struct dvbtsgen_stats stats;
+	const char *output = "-";
+	int adapter = -1, dvr = 0;
+	int seconds = 10;
+	int realtime = 0, quiet = 0;
+	uint64_t start, elapsed;
+	uint64_t total = 0;
+	uint8_t *buf;
+	int count, active;
+	int opt, i;
+
+	memset(&config, 0, sizeof(config));
+	config.start_time = time(NULL);
+
+	while((opt = getopt(argc, argv, "o:a:m:s:b:S:e:E:I:T:P:j:c:r:t:Rqh")) != -1) {
+		switch(opt) {
+		case 'o':
+			output = optarg;
+			break;
+		case 'a':
+			if (sscanf(optarg, "%i:%i", &adapter, &dvr) < 1) {
+				fprintf(stderr, "dvbtsgen: Bad adapter %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'm':
+			mux_count = atoi(optarg);
+			break;
+		case 's':
+			config.services = atoi(optarg);
+			break;
+		case 'b':
+			if ((config.bitrate = parse_rate(optarg)) == 0) {
+				fprintf(stderr, "dvbtsgen: Bad rate %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'S':
+			if ((config.service_bitrate = parse_rate(optarg)) == 0) {
+				fprintf(stderr, "dvbtsgen: Bad rate %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'e':
+			config.eit_events = atoi(optarg);
+			break;
+		case 'E':
+			config.eit_event_length = atoi(optarg);
+			break;
+		case 'I':
+			config.eit_interval = atoi(optarg);
+			break;
+		case 'T':
+			config.start_time = strtol(optarg, NULL, 0);
+			break;
+		case 'P':
+			config.pcr_interval = atoi(optarg);
+			break;
+		case 'j':
+			config.pcr_jitter = atoi(optarg);
+			break;
+		case 'c':
+			config.cc_error_interval = atoi(optarg);
+			break;
+		case 'r':
+			config.seed = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			seconds = atoi(optarg);
+			break;
+		case 'R':
+			realtime = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 'h':
+			usage(stdout);
+			exit(0);
+		default:
+			usage(stderr);
+			exit(1);
+		}
+	}
+	if ((optind != argc) || (mux_count < 1) || (mux_count > MAX_MUXES) || (seconds < 0)) {
+		usage(stderr);
+		exit(1);
+	}
+	if ((mux_count > 1) && (adapter < 0) && (strstr(output, "%d") == NULL)) {
+		fprintf(stderr, "dvbtsgen: Several muxes need -a, or a %%d in the output name\n");
+		exit(1);
+	}
+	if ((buf = malloc(CHUNK_PACKETS * TRANSPORT_PACKET_LENGTH)) == NULL) {
+		fprintf(stderr, "dvbtsgen: Out of memory\n");
+		exit(1);
+	}
+
+	config.mux_count = mux_count;
+	for(i = 0; i < mux_count; i++) {
+		config.mux_index = i;
+		if ((muxes[i].gen = dvbtsgen_create(&config)) == NULL) {
+			if (errno == EINVAL && dvbtsgen_required_bitrate(&config))
+				fprintf(stderr, "dvbtsgen: The services and tables need %llu bits/s, "
+					"more than the mux rate\n",
+					(unsigned long long) dvbtsgen_required_bitrate(&config));
+			else
+				fprintf(stderr, "dvbtsgen: Could not create generator: %m\n");
+			exit(1);
+		}
+		if (open_output(muxes + i, i, output, adapter, dvr))
+			exit(1);
+	}
+	if (config.bitrate == 0)
+		config.bitrate = 38000000;
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	for(i = 0; i < mux_count; i++)
+		muxes[i].packets = ((uint64_t) seconds * config.bitrate) / (TRANSPORT_PACKET_LENGTH * 8);
+
+	// the muxes are generated in turn, a chunk at a time
+	start = now_ns();
+	active = mux_count;
+	while(active && !quit) {
+		active = 0;
+		for(i = 0; i < mux_count; i++) {
+			if (muxes[i].fd < 0)
+				continue;
+
+			count = CHUNK_PACKETS;
+			if (seconds) {
+				dvbtsgen_get_stats(muxes[i].gen, &stats);
+				if ((muxes[i].packets - stats.packets) < (uint64_t) count)
+					count = muxes[i].packets - stats.packets;
+			}
+			if (count == 0) {
+				close(muxes[i].fd);
+				muxes[i].fd = -1;
+				continue;
+			}
+
+			dvbtsgen_generate(muxes[i].gen, buf, count);
+			if (write_all(muxes + i, buf, count * TRANSPORT_PACKET_LENGTH)) {
+				close(muxes[i].fd);
+				muxes[i].fd = -1;
+				continue;
+			}
+			total += count;
+			active++;
+		}
+		if (realtime && (mux_count > 0)) {
+			dvbtsgen_get_stats(muxes[0].gen, &stats);
+			pace(start, stats.packets, config.bitrate);
+		}
+	}
+	elapsed = now_ns() - start;
+
+	for(i = 0; i < mux_count; i++) {
+		if (!quiet) {
+			dvbtsgen_get_stats(muxes[i].gen, &stats);
+			fprintf(stderr, "%s: %llu packets, %llu null, %llu PCRs, %llu CC errors\n",
+				muxes[i].name,
+				(unsigned long long) stats.packets,
+				(unsigned long long) stats.null_packets,
+				(unsigned long long) stats.pcrs,
+				(unsigned long long) stats.cc_errors);
+		}
+		if (muxes[i].fd >= 0)
+			close(muxes[i].fd);
+		dvbtsgen_destroy(muxes[i].gen);
+	}
+	if (!quiet && elapsed)
+		fprintf(stderr, "%llu packets in %.3fs: %.1f Mbit/s\n",
+			(unsigned long long) total, elapsed / 1e9,
+			((double) total * TRANSPORT_PACKET_LENGTH * 8 * 1000) / elapsed);
+
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,586 @@
+/*
+	dvbtssplit utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+/*
+ * Splits a capture of a whole multiplex into one single program transport
+ * stream per service.
+ *
+ * The PAT and PMTs at the start of the capture say which PIDs belong to
+ * which service. The capture is then mapped and cut into chunks, which are
+ * handled a round of one chunk per thread at a time: each thread copies the
+ * packets of its chunk into a buffer per service, and once the round is
+ * done, each thread appends the buffers of its share of the services to
+ * their files, in chunk order.
+ *
+ * Each packet of the PAT is replaced by a packet with the same continuity
+ * counter: the start of each PAT by a PAT listing only the service, the rest
+ * by stuffing. The service's own PMT PID is passed through unchanged, so
+ * later versions of the PMT survive, but the PIDs are only classified from
+ * the first one.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <libucsi/section.h>
+#include <libucsi/section_buf.h>
+#include <libucsi/section_builder.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/mpeg/section.h>
+
+#define MAX_SERVICES 64
+#define DEFAULT_CHUNK_SIZE (32 * 1024 * 1024)
+#define SYNC_WINDOW (1024 * 1024)
+
+struct service {
+	uint16_t service_id;
+	uint16_t pmt_pid;
+	int found;				/* the PMT has been seen */
+	char name[PATH_MAX];
+	int fd;
+	uint8_t pat[2][TRANSPORT_PACKET_LENGTH];	/* PAT start, PAT stuffing */
+	uint64_t packets;
+};
+
+struct outbuf {
+	uint8_t *data;
+	size_t len;
+	size_t size;
+};
+
+struct worker {
+	pthread_t thread;
+	int index;
+	struct outbuf *bufs;			/* one per service */
+	uint64_t resyncs;
+	int failed;
+};
+
+static uint8_t *map;
+static size_t map_size;
+static size_t chunk_size = DEFAULT_CHUNK_SIZE;
+static size_t chunk_count;
+
+static struct service services[MAX_SERVICES];
+static int service_count;
+static uint64_t pid_services[TRANSPORT_MAX_PIDS];	/* bitmask of the services of each PID */
+
+static struct worker *workers;
+static int worker_count;
+static pthread_barrier_t barrier;
+
+static void usage(FILE *output)
+{
+	fprintf(output,
+		"Usage: dvbtssplit [OPTION]... FILE\n"
+		"Split a transport stream capture of a multiplex into one file per service.\n"
+		"Options:\n"
+		"	-o PATTERN output file names; %%d is replaced by the service id\n"
+		"		   (default service-%%d.ts)\n"
+		"	-s SID,... only split out these services (default all, up to %i)\n"
+		"	-j N	   number of threads (default one per CPU)\n"
+		"	-c MB	   chunk size in megabytes (default %i)\n"
+		"	-q	   do not print statistics at the end\n"
+		"	-h	   display this help\n",
+		MAX_SERVICES, DEFAULT_CHUNK_SIZE / (1024 * 1024));
+}
+
+/*
+ * The first packet start at or after pos: a sync byte followed by two more
+ * a packet apart, as far as the capture goes. Every thread which needs the
+ * start of a chunk gets the same answer.
+ */
+static size_t resync(size_t pos)
+{
+	size_t window, p;
+	int off;
+
+	while (pos < map_size) {
+		window = map_size - pos;
+		if (window > SYNC_WINDOW)
+			window = SYNC_WINDOW;
+		if ((off = transport_packet_find_sync(map + pos, window)) < 0) {
+			pos += window;
+			continue;
+		}
+
+		p = pos + off;
+		if (((p + TRANSPORT_PACKET_LENGTH < map_size) &&
+		     (map[p + TRANSPORT_PACKET_LENGTH] != TRANSPORT_PACKET_SYNC)) ||
+		    ((p + 2 * TRANSPORT_PACKET_LENGTH < map_size) &&
+		     (map[p + 2 * TRANSPORT_PACKET_LENGTH] != TRANSPORT_PACKET_SYNC))) {
+			pos = p + 1;
+			continue;
+		}
+		return p;
+	}
+	return map_size;
+}
+
+static size_t chunk_start(size_t chunk)
+{
+	if (chunk == 0)
+		return resync(0);
+	if (chunk >= chunk_count)
+		return map_size;
+	return resync(chunk * chunk_size);
+}
+
+static int outbuf_append(struct outbuf *buf, uint8_t *data)
+{
+	if (buf->len + TRANSPORT_PACKET_LENGTH > buf->size) {
+		size_t size = buf->size ? buf->size * 2 : 1024 * TRANSPORT_PACKET_LENGTH;
+		uint8_t *tmp;
+
+		if ((tmp = realloc(buf->data, size)) == NULL)
+			return -1;
+		buf->data = tmp;
+		buf->size = size;
+	}
+	memcpy(buf->data + buf->len, data, TRANSPORT_PACKET_LENGTH);
+	buf->len += TRANSPORT_PACKET_LENGTH;
+	return 0;
+}
+
+static void make_pat(struct service *service, uint16_t transport_stream_id, int version)
+{
+	uint8_t *pkt = service->pat[0];
+	struct section_builder b;
+
+	// PAT start: a single program PAT, then stuffing
+	memset(pkt, 0xff, TRANSPORT_PACKET_LENGTH);
+	pkt[0] = TRANSPORT_PACKET_SYNC;
+	pkt[1] = 0x40;
+	pkt[2] = 0x00;
+	pkt[3] = 0x10;
+	pkt[4] = 0;
+	section_builder_start_ext(&b, pkt + 5, TRANSPORT_PACKET_LENGTH - 5,
+				  stag_mpeg_program_association, 0, transport_stream_id, version, 0, 0);
+	section_builder_u16(&b, service->service_id);
+	section_builder_u16(&b, 0xe000 | service->pmt_pid);
+	section_builder_finish(&b);
+
+	// the rest of a PAT: nothing but stuffing after the end of the section
+	pkt = service->pat[1];
+	memset(pkt, 0xff, TRANSPORT_PACKET_LENGTH);
+	pkt[0] = TRANSPORT_PACKET_SYNC;
+	pkt[1] = 0x00;
+	pkt[2] = 0x00;
+	pkt[3] = 0x10;
+}
+
+static int add_service(uint16_t service_id, uint16_t pmt_pid, const char *pattern)
+{
+	struct service *service;
+	const char *pos;
+
+	if (service_count == MAX_SERVICES) {
+		fprintf(stderr, "dvbtssplit: Too many services, ignoring %i\n", service_id);
+		return 0;
+	}
+	service = &services[service_count];
+	service->service_id = service_id;
+	service->pmt_pid = pmt_pid;
+
+	if ((pos = strstr(pattern, "%d")) != NULL)
+		snprintf(service->name, sizeof(service->name), "%.*s%i%s",
+			 (int) (pos - pattern), pattern, service_id, pos + 2);
+	else
+		snprintf(service->name, sizeof(service->name), "%s.%i", pattern, service_id);
+	if ((service->fd = open(service->name, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "dvbtssplit: Could not open %s: %m\n", service->name);
+		return -1;
+	}
+	service_count++;
+	return 0;
+}
+
+static int wanted(int *sids, int sid_count, uint16_t service_id)
+{
+	int i;
+
+	if (sid_count == 0)
+		return 1;
+	for(i=0; i < sid_count; i++) {
+		if (sids[i] == service_id)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Read the PAT and then the PMTs of the wanted services from the start of
+ * the capture, and fill in pid_services.
+ */
+static int read_psi(int *sids, int sid_count, const char *pattern)
+{
+	struct section_buf *bufs[TRANSPORT_MAX_PIDS];
+	struct transport_packet *pkt;
+	struct transport_values vals;
+	uint16_t transport_stream_id = 0;
+	int pat_version = 0;
+	int have_pat = 0, missing = 0;
+	int pid, used, status, pdu_start;
+	size_t pos;
+	int i;
+
+	memset(bufs, 0, sizeof(bufs));
+	if ((bufs[TRANSPORT_PAT_PID] = malloc(sizeof(struct section_buf) + DVB_MAX_SECTION_BYTES)) == NULL)
+		return -1;
+	section_buf_init(bufs[TRANSPORT_PAT_PID], DVB_MAX_SECTION_BYTES);
+
+	pos = resync(0);
+	while ((pos + TRANSPORT_PACKET_LENGTH <= map_size) && (!have_pat || missing)) {
+		if ((pkt = transport_packet_init(map + pos)) == NULL) {
+			pos = resync(pos + 1);
+			continue;
+		}
+		pos += TRANSPORT_PACKET_LENGTH;
+
+		pid = transport_packet_pid(pkt);
+		if ((bufs[pid] == NULL) || pkt->transport_error_indicator)
+			continue;
+		if (transport_packet_values_extract(pkt, &vals, 0) < 0)
+			continue;
+
+		pdu_start = pkt->payload_unit_start_indicator;
+		while (vals.payload_length) {
+			used = section_buf_add_transport_payload(bufs[pid], vals.payload,
+								 vals.payload_length,
+								 pdu_start, &status);
+			pdu_start = 0;
+			vals.payload_length -= used;
+			vals.payload += used;
+			if (status < 0) {
+				section_buf_reset(bufs[pid]);
+				continue;
+			}
+			if (status != 1)
+				continue;
+
+			uint8_t *data = section_buf_data(bufs[pid]);
+			struct section *section = section_codec(data, bufs[pid]->len);
+			struct section_ext *ext = section ? section_ext_decode(section, 1) : NULL;
+			section_buf_reset(bufs[pid]);
+			if (ext == NULL)
+				continue;
+
+			if ((pid == TRANSPORT_PAT_PID) && !have_pat) {
+				struct mpeg_pat_section *pat;
+				struct mpeg_pat_program *program;
+
+				if ((pat = mpeg_pat_section_codec(ext)) == NULL)
+					continue;
+				if (ext->section_number != 0)
+					continue;
+				transport_stream_id = mpeg_pat_section_transport_stream_id(pat);
+				pat_version = ext->version_number;
+				mpeg_pat_section_programs_for_each(pat, program) {
+					if ((program->program_number == 0) ||
+					    !wanted(sids, sid_count, program->program_number))
+						continue;
+					if (add_service(program->program_number, program->pid, pattern))
+						return -1;
+					if ((bufs[program->pid] == NULL) &&
+					    ((bufs[program->pid] = malloc(sizeof(struct section_buf) +
+									  DVB_MAX_SECTION_BYTES)) == NULL))
+						return -1;
+					section_buf_init(bufs[program->pid], DVB_MAX_SECTION_BYTES);
+				}
+				missing = service_count;
+				have_pat = 1;
+			} else if (ext->table_id == stag_mpeg_program_map) {
+				struct mpeg_pmt_section *pmt;
+				struct mpeg_pmt_stream *stream;
+
+				for(i=0; i < service_count; i++) {
+					if ((services[i].pmt_pid == pid) &&
+					    (services[i].service_id == ext->table_id_ext) &&
+					    !services[i].found)
+						break;
+				}
+				if (i == service_count)
+					continue;
+				if ((pmt = mpeg_pmt_section_codec(ext)) == NULL)
+					continue;
+
+				pid_services[pid] |= 1ULL << i;
+				pid_services[pmt->pcr_pid] |= 1ULL << i;
+				mpeg_pmt_section_streams_for_each(pmt, stream) {
+					pid_services[stream->pid] |= 1ULL << i;
+				}
+				services[i].found = 1;
+				missing--;
+			}
+		}
+	}
+
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++)
+		free(bufs[pid]);
+
+	if (!have_pat) {
+		fprintf(stderr, "dvbtssplit: No PAT found\n");
+		return -1;
+	}
+	if (service_count == 0) {
+		fprintf(stderr, "dvbtssplit: None of the services are in the PAT\n");
+		return -1;
+	}
+	for(i=0; i < service_count; i++) {
+		if (!services[i].found)
+			fprintf(stderr, "dvbtssplit: No PMT for service %i, only its PAT is written\n",
+				services[i].service_id);
+		make_pat(&services[i], transport_stream_id, pat_version);
+	}
+
+	// the PAT is regenerated per service, and the null packets are dropped
+	pid_services[TRANSPORT_PAT_PID] = 0;
+	pid_services[TRANSPORT_NULL_PID] = 0;
+	return 0;
+}
+
+static int split_chunk(struct worker *worker, size_t chunk)
+{
+	size_t pos = chunk_start(chunk);
+	size_t end = chunk_start(chunk + 1);
+	uint8_t *pkt;
+	uint64_t mask;
+	int pid, which, i;
+
+	while (pos + TRANSPORT_PACKET_LENGTH <= end) {
+		pkt = map + pos;
+		if ((pkt[0] != TRANSPORT_PACKET_SYNC) ||
+		    ((pos + TRANSPORT_PACKET_LENGTH < end) &&
+		     (pkt[TRANSPORT_PACKET_LENGTH] != TRANSPORT_PACKET_SYNC))) {
+			worker->resyncs++;
+			pos = resync(pos + 1);
+			continue;
+		}
+		pos += TRANSPORT_PACKET_LENGTH;
+
+		pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+		if (pid == TRANSPORT_PAT_PID) {
+			which = (pkt[1] & 0x40) ? 0 : 1;
+			for(i=0; i < service_count; i++) {
+				struct outbuf *buf = &worker->bufs[i];
+
+				// the templates are shared: the CC goes in this thread's copy
+				if (outbuf_append(buf, services[i].pat[which]))
+					return -1;
+				buf->data[buf->len - TRANSPORT_PACKET_LENGTH + 3] = 0x10 | (pkt[3] & 0x0f);
+			}
+			continue;
+		}
+
+		for(mask = pid_services[pid]; mask; mask &= mask - 1) {
+			if (outbuf_append(&worker->bufs[__builtin_ctzll(mask)], pkt))
+				return -1;
+		}
+	}
+	return 0;
+}
+
+static int write_all(struct service *service, uint8_t *buf, size_t len)
+{
+	ssize_t written;
+
+	while (len) {
+		if ((written = write(service->fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "dvbtssplit: %s: write failed: %m\n", service->name);
+			return -1;
+		}
+		buf += written;
+		len -= written;
+	}
+	return 0;
+}
+
+static void *worker_thread(void *arg)
+{
+	struct worker *worker = (struct worker *) arg;
+	size_t round, chunk;
+	int failed = 0;
+	int i, j;
+
+	for (round = 0; round * worker_count < chunk_count; round++) {
+		chunk = round * worker_count + worker->index;
+		if ((chunk < chunk_count) && split_chunk(worker, chunk)) {
+			fprintf(stderr, "dvbtssplit: Out of memory\n");
+			worker->failed = 1;
+		}
+		pthread_barrier_wait(&barrier);
+
+		// a failure anywhere stops everyone at the same round
+		for(j=0; j < worker_count; j++)
+			failed |= workers[j].failed;
+
+		// each thread writes its share of the services, in chunk order
+		for(i = worker->index; i < service_count; i += worker_count) {
+			for(j=0; j < worker_count; j++) {
+				struct outbuf *buf = &workers[j].bufs[i];
+
+				if (!failed && buf->len && write_all(&services[i], buf->data, buf->len))
+					failed = worker->failed = 1;
+				services[i].packets += buf->len / TRANSPORT_PACKET_LENGTH;
+				buf->len = 0;
+			}
+		}
+		pthread_barrier_wait(&barrier);
+		if (failed)
+			break;
+	}
+	return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+	const char *pattern = "service-%d.ts";
+	int sids[MAX_SERVICES];
+	int sid_count = 0;
+	int quiet = 0;
+	uint64_t resyncs = 0;
+	struct stat st;
+	char *tok, *save;
+	int fd, opt, i;
+	int failed = 0;
+
+	worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	while((opt = getopt(argc, argv, "o:s:j:c:qh")) != -1) {
+		switch(opt) {
+		case 'o':
+			pattern = optarg;
+			break;
+
+		case 's':
+			for (tok = strtok_r(optarg, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+				if (sid_count == MAX_SERVICES) {
+					fprintf(stderr, "dvbtssplit: Too many services\n");
+					exit(1);
+				}
+				sids[sid_count++] = strtol(tok, NULL, 0);
+			}
+			break;
+
+		case 'j':
+			worker_count = atoi(optarg);
+			break;
+
+		case 'c':
+			chunk_size = (size_t) atoi(optarg) * 1024 * 1024;
+			break;
+
+		case 'q':
+			quiet = 1;
+			break;
+
+		case 'h':
+			usage(stdout);
+			exit(0);
+
+		default:
+			usage(stderr);
+			exit(1);
+		}
+	}
+	if ((optind != argc - 1) || (chunk_size == 0)) {
+		usage(stderr);
+		exit(1);
+	}
+	if (worker_count < 1)
+		worker_count = 1;
+
+	// map the capture
+	if ((fd = open(argv[optind], O_RDONLY)) < 0) {
+		fprintf(stderr, "dvbtssplit: Could not open %s: %m\n", argv[optind]);
+		exit(1);
+	}
+	if (fstat(fd, &st) < 0) {
+		fprintf(stderr, "dvbtssplit: %s: %m\n", argv[optind]);
+		exit(1);
+	}
+	if ((map_size = st.st_size) < TRANSPORT_PACKET_LENGTH) {
+		fprintf(stderr, "dvbtssplit: %s is too short\n", argv[optind]);
+		exit(1);
+	}
+	if ((map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "dvbtssplit: Could not map %s: %m\n", argv[optind]);
+		exit(1);
+	}
+	madvise(map, map_size, MADV_SEQUENTIAL);
+	close(fd);
+
+	if (read_psi(sids, sid_count, pattern))
+		exit(1);
+
+	// split it
+	chunk_count = (map_size + chunk_size - 1) / chunk_size;
+	if ((size_t) worker_count > chunk_count)
+		worker_count = chunk_count;
+	if ((workers = calloc(worker_count, sizeof(struct worker))) == NULL) {
+		fprintf(stderr, "dvbtssplit: Out of memory\n");
+		exit(1);
+	}
+	pthread_barrier_init(&barrier, NULL, worker_count);
+	for(i=0; i < worker_count; i++) {
+		workers[i].index = i;
+		if ((workers[i].bufs = calloc(service_count, sizeof(struct outbuf))) == NULL) {
+			fprintf(stderr, "dvbtssplit: Out of memory\n");
+			exit(1);
+		}
+	}
+	for(i=0; i < worker_count; i++) {
+		if (pthread_create(&workers[i].thread, NULL, worker_thread, &workers[i])) {
+			fprintf(stderr, "dvbtssplit: Could not create a thread\n");
+			exit(1);
+		}
+	}
+	for(i=0; i < worker_count; i++) {
+		pthread_join(workers[i].thread, NULL);
+		failed |= workers[i].failed;
+		resyncs += workers[i].resyncs;
+	}
+
+	for(i=0; i < service_count; i++) {
+		if (close(services[i].fd) < 0) {
+			fprintf(stderr, "dvbtssplit: %s: %m\n", services[i].name);
+			failed = 1;
+		}
+		if (!quiet)
+			fprintf(stderr, "%s: service %i, %llu packets\n", services[i].name,
+				services[i].service_id, (unsigned long long) services[i].packets);
+	}
+	if (!quiet && resyncs)
+		fprintf(stderr, "dvbtssplit: lost sync %llu times\n", (unsigned long long) resyncs);
+
+	munmap(map, map_size);
+	return failed ? 1 : 0;
+}
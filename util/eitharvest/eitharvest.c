@@ -0,0 +1,1440 @@
+/*
+	eitharvest utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <libdvbapi/dvbfe.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbtuner.h>
+#include <libdvbsec/dvbsec_api.h>
+#include <libdvbsec/dvbsec_cfg.h>
+#include <libdvbcfg/dvbcfg_scanfile.h>
+#include <libdvbepg/dvbepg.h>
+#include <libucsi/section_decoder.h>
+#include <libucsi/section.h>
+#include <libucsi/dvb/section.h>
+
+#define MAX_ADAPTERS			16
+#define TIMEOUT_WAIT_LOCK		2
+#define EIT_PID				0x12
+#define DEMUX_BUFFER_SIZE		(1024 * 1024)
+#define TABLE_BUCKETS			16384
+
+#define DEFAULT_SETTLE			10	// first day of schedule repeats every 10s (TR 101 211)
+#define DEFAULT_MAX_DWELL		60
+#define DEFAULT_MAX_PASSES		3
+#define DEFAULT_WATCH			30	// other days repeat every 30s
+#define DEFAULT_FULL_EVERY		6
+#define DEFAULT_PRIORITY		0
+
+#define MAX_WATCH			32	// version filters per dwell
+#define WATCH_BUFFER_SIZE		(64 * 1024)
+#define MAX_CLIENTS			16
+#define CLIENT_LINE_SIZE		256
+
+
+/**
+ * A multiplex from the scan file.
+ */
+struct mux {
+	struct dvbcfg_scanfile channel;
+	int passes;		// dwells so far
+	int busy;		// an adapter is on it
+	int done;
+	int remaining;		// sections known to be missing, -1 if never seen
+	int sections;		// sections received from it
+
+	// service mode
+	time_t due;		// next visit
+	int visits;		// dwells since it was first complete
+	struct eit_table **watch; // its actual schedule tables, as of the last full dwell
+	int watch_count;
+
+	struct mux *next;
+};
+
+/**
+ * Completeness of one EIT schedule table (a table_id for a service), tracked
+ * the way section_ext_useful() does for PSI tables, but as a bitmap: schedule
+ * sections come in any order, in segments of 8 which need not be full.
+ */
+struct eit_table {
+	uint16_t network_id;
+	uint16_t transport_stream_id;
+	uint16_t service_id;
+	uint8_t table_id;
+
+	uint8_t version_number;		// 0xff until a section is seen
+	uint8_t last_section_number;
+	uint32_t segments_seen;		// bit per segment of 8 sections
+	uint8_t segment_last[32];	// segment_last_section_number of each segment
+	uint32_t received[8];		// bit per section
+	int received_count;
+
+	int dwell;			// last dwell which saw it
+	struct eit_table *next;
+};
+
+/**
+ * Sections a dwell has seen tables for, to decide when it is complete.
+ */
+struct dwell {
+	int id;
+	struct eit_table **tables;
+	int count;
+	int alloc;
+	time_t last_new;		// last time a new section or table turned up
+	int sections;
+	struct section_decoder *decoder;	// the EIT repeats are not decoded again
+};
+
+struct adapter {
+	int id;
+	struct dvbfe_handle *fe;
+	struct dvbtuner_lease *lease;	// service mode only
+	pthread_t thread;
+};
+
+struct client {
+	int fd;
+	char line[CLIENT_LINE_SIZE];
+	int len;
+};
+
+
+// everything below is shared between the adapter threads, under lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct mux *muxes = NULL;
+static struct eit_table *tables[TABLE_BUCKETS];
+static struct dvbepg *epg = NULL;
+static int next_dwell_id = 1;
+static int total_sections = 0;
+static int muxes_seen = 0;
+
+// the same for all adapters
+static struct dvbsec_config sec;
+static int valid_sec = 0;
+static int satpos = 0;
+static int settle = DEFAULT_SETTLE;
+static int max_dwell = DEFAULT_MAX_DWELL;
+static int max_passes = DEFAULT_MAX_PASSES;
+static enum dvbfe_type fe_type;
+static char *secid = NULL;
+static int refresh = 0;			// service mode if nonzero
+static int watch_time = DEFAULT_WATCH;
+static int full_every = DEFAULT_FULL_EVERY;
+static int priority = DEFAULT_PRIORITY;
+static int compress = 0;		// dictionary entries, 0 for plain strings
+static uint32_t compressed_strings = 0;	// strings in the store when it was last trained
+static char *export_filename = NULL;
+static enum dvbepg_export_format export_format;
+static int incremental = 0;
+static uint32_t exported_serial = 0;	// change serial as of the last export
+static volatile sig_atomic_t stop = 0;
+
+
+static void usage(void)
+{
+	static const char *_usage = "\n"
+		" eitharvest: Collect EIT schedules from all multiplexes, with all adapters at once\n\n"
+		" usage: eitharvest <options> as follows:\n"
+		" -h			help\n"
+		" -adapters <list>	comma separated adapters to use (default: every adapter\n"
+		"			 with a frontend of the scan file's type)\n"
+		" -secfile <filename>	Optional sec.conf file.\n"
+		" -secid <secid>	ID of the SEC configuration to use (see dvbscan)\n"
+		" -satpos <position>	Specify DISEQC switch position for DVB-S.\n"
+		" -settle <secs>	A dwell ends once its tables are complete and no new\n"
+		"			 table has turned up for this long (default 10)\n"
+		" -dwell <secs>		Longest time to stay on a multiplex at once (default 60)\n"
+		" -passes <count>	Most dwells on an incomplete multiplex (default 3)\n"
+		" -out <filename>	EPG snapshot to update (required)\n"
+		" -refresh <secs>	Keep running: revisit each multiplex this long after\n"
+		"			 the last visit, saving the snapshot as often\n"
+		" -watch <secs>		How long a refresh watches for changed tables (default 30)\n"
+		" -full <count>		Every this many refreshes read the whole EIT, to find\n"
+		"			 new services (default 6)\n"
+		" -priority <prio>	Tuner lease priority when refreshing (default 0)\n"
+		" -serve <path>		Answer guide queries on this unix socket\n"
+		" -compress <entries>	Keep the guide's strings compressed with a dictionary\n"
+		"			 of this many phrases (at most 1785), trained when\n"
+		"			 the snapshot is saved\n"
+		" -xmltv <filename>	Write the guide as XMLTV whenever the snapshot is saved\n"
+		" -json <filename>	The same as JSON\n"
+		" -arrow <filename>	The same as an Arrow IPC stream, one row per event\n"
+		" -incremental		Each export after the first of a run only lists the\n"
+		"			 events added or changed since the one before; Arrow\n"
+		"			 exports then each go to a new <filename>.<serial>\n"
+		" <initial scan file>\n"
+		"\n"
+		" All adapters must receive the same signal (e.g. share a dish).\n"
+		"\n"
+		" With -refresh, tuners are leased for each visit and given back after it, so\n"
+		" other jobs can have them; a multiplex already tuned by one is read without\n"
+		" retuning. A refresh of a complete multiplex only sets a filter per known\n"
+		" schedule table which passes nothing until that table's version changes.\n"
+		"\n"
+		" The socket takes one command per line, and answers with tab separated\n"
+		" lines ended by a line holding a single '.':\n"
+		"  SERVICES					onid tsid sid per service\n"
+		"  NOW <onid> <tsid> <sid> [<time>]		the event on air\n"
+		"  EVENT <onid> <tsid> <sid> <event id>\n"
+		"  RANGE <onid> <tsid> <sid> <from> <to>	events overlapping the range\n"
+		"  STATUS					frequency, sections missing, seconds\n"
+		"						 until next visit per multiplex\n"
+		"  STATS					services, events, strings, dictionary\n"
+		"						 entries, text bytes, stored bytes\n"
+		" Events are given as: event id, start, duration, language, title, text.\n"
+		" Times are seconds since the epoch.\n";
+	fprintf(stderr, "%s\n", _usage);
+
+	exit(1);
+}
+
+static void signal_handler(int _signal)
+{
+	(void) _signal;
+
+	stop = 1;
+}
+
+
+
+
+/*
+ * EIT table tracking (called with lock held)
+ */
+
+static struct eit_table *get_table(uint16_t network_id, uint16_t transport_stream_id,
+				   uint16_t service_id, uint8_t table_id, int *created)
+{
+	uint32_t hash = (((((uint32_t) network_id * 31) + transport_stream_id) * 31 + service_id) * 31) + table_id;
+	struct eit_table *t;
+
+	*created = 0;
+	for (t = tables[hash % TABLE_BUCKETS]; t; t = t->next) {
+		if ((t->network_id == network_id) &&
+		    (t->transport_stream_id == transport_stream_id) &&
+		    (t->service_id == service_id) &&
+		    (t->table_id == table_id))
+			return t;
+	}
+
+	if ((t = calloc(1, sizeof(struct eit_table))) == NULL)
+		return NULL;
+	t->network_id = network_id;
+	t->transport_stream_id = transport_stream_id;
+	t->service_id = service_id;
+	t->table_id = table_id;
+	t->version_number = 0xff;
+	t->next = tables[hash % TABLE_BUCKETS];
+	tables[hash % TABLE_BUCKETS] = t;
+	*created = 1;
+	return t;
+}
+
+static void free_tables(void)
+{
+	int i;
+
+	for (i = 0; i < TABLE_BUCKETS; i++) {
+		while (tables[i]) {
+			struct eit_table *t = tables[i];
+
+			tables[i] = t->next;
+			free(t);
+		}
+	}
+}
+
+/**
+ * Number of sections of a table still to come. Segments not seen yet count
+ * as one section: each segment has at least one, and we do not know more.
+ */
+static int table_missing(struct eit_table *t)
+{
+	int expected = 0;
+	int seg;
+
+	if (t->version_number == 0xff)
+		return 1;
+
+	for (seg = 0; seg <= (t->last_section_number >> 3); seg++) {
+		if ((t->segments_seen & (1U << seg)) && (t->segment_last[seg] >= (seg * 8)))
+			expected += t->segment_last[seg] - (seg * 8) + 1;
+		else
+			expected++;
+	}
+
+	// sections past their segment's end are not expected, but still counted
+	if (t->received_count >= expected)
+		return 0;
+	return expected - t->received_count;
+}
+
+static void dwell_add_table(struct dwell *d, struct eit_table *t)
+{
+	if (t->dwell == d->id)
+		return;
+	t->dwell = d->id;
+
+	if (d->count == d->alloc) {
+		int alloc = d->alloc ? d->alloc * 2 : 256;
+		struct eit_table **tmp = realloc(d->tables, alloc * sizeof(struct eit_table *));
+
+		if (tmp == NULL)
+			return;
+		d->tables = tmp;
+		d->alloc = alloc;
+	}
+	d->tables[d->count++] = t;
+}
+
+static int dwell_missing(struct dwell *d)
+{
+	int missing = 0;
+	int i;
+
+	for (i = 0; i < d->count; i++)
+		missing += table_missing(d->tables[i]);
+	return missing;
+}
+
+/**
+ * Account for a schedule section.
+ *
+ * @return 1 if it was new, 0 if it was seen already.
+ */
+static int table_section(struct dwell *d, struct dvb_eit_section *eit)
+{
+	uint8_t table_id = eit->head.table_id;
+	uint8_t section_number = eit->head.section_number;
+	uint8_t seg = section_number >> 3;
+	uint8_t last_table_id;
+	struct eit_table *t;
+	int created;
+	int is_new = 0;
+
+	t = get_table(eit->original_network_id, eit->transport_stream_id,
+		      dvb_eit_section_service_id(eit), table_id, &created);
+	if (t == NULL)
+		return 0;
+	dwell_add_table(d, t);
+
+	if (t->version_number != eit->head.version_number) {
+		// a new version (or the first): start again
+		t->version_number = eit->head.version_number;
+		t->segments_seen = 0;
+		t->received_count = 0;
+		memset(t->received, 0, sizeof(t->received));
+		is_new = 1;
+	}
+	t->last_section_number = eit->head.last_section_number;
+	t->segments_seen |= 1U << seg;
+	t->segment_last[seg] = eit->segment_last_section_number;
+	if (!(t->received[section_number >> 5] & (1U << (section_number & 31)))) {
+		t->received[section_number >> 5] |= 1U << (section_number & 31);
+		t->received_count++;
+		is_new = 1;
+	}
+
+	// the service has tables up to last_table_id: wait for them as well
+	last_table_id = eit->last_table_id;
+	if ((last_table_id & 0xf0) == (table_id & 0xf0)) {
+		uint8_t tid;
+
+		for (tid = (table_id & 0xf0); tid <= last_table_id; tid++) {
+			struct eit_table *other = get_table(t->network_id, t->transport_stream_id,
+							    t->service_id, tid, &created);
+			if (other == NULL)
+				continue;
+			if (created)
+				is_new = 1;
+			dwell_add_table(d, other);
+		}
+	}
+
+	return is_new;
+}
+
+
+
+
+/*
+ * scheduling
+ */
+
+/**
+ * Pick the multiplex with the most sections expected to be left. Multiplexes
+ * never visited are expected to hold as much as the average one so far, and
+ * go first while nothing is known. In service mode, done multiplexes come
+ * back once they are due.
+ */
+static struct mux *pick_mux(void)
+{
+	struct mux *m;
+	struct mux *best = NULL;
+	int best_expected = -1;
+	int average = muxes_seen ? (total_sections / muxes_seen) : INT_MAX;
+	time_t now = time(NULL);
+
+	pthread_mutex_lock(&lock);
+	for (m = muxes; m; m = m->next) {
+		int expected;
+
+		if (m->busy)
+			continue;
+		if (m->done) {
+			if (!refresh || (now < m->due))
+				continue;
+			m->done = 0;
+			m->passes = 0;
+		}
+		expected = (m->remaining < 0) ? average : m->remaining;
+		if (expected > best_expected) {
+			best = m;
+			best_expected = expected;
+		}
+	}
+	if (best)
+		best->busy = 1;
+	pthread_mutex_unlock(&lock);
+
+	return best;
+}
+
+static void release_mux(struct mux *m, int complete, int remaining, int sections)
+{
+	pthread_mutex_lock(&lock);
+	if (m->remaining < 0) {
+		total_sections += sections;
+		muxes_seen++;
+	}
+	m->busy = 0;
+	m->passes++;
+	m->sections += sections;
+	m->remaining = remaining;
+	if (m->watch_count)
+		m->visits++;
+	if (complete || (m->passes >= max_passes)) {
+		m->done = 1;
+		m->due = time(NULL) + refresh;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Put back a multiplex which could not be visited, without counting a pass.
+ */
+static void return_mux(struct mux *m)
+{
+	pthread_mutex_lock(&lock);
+	m->busy = 0;
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Remember the actual schedule tables a full dwell saw on a multiplex, for
+ * later refreshes to watch (called with lock held).
+ */
+static void mux_set_watch(struct mux *m, struct dwell *d)
+{
+	struct eit_table **tmp;
+	int i;
+
+	if ((tmp = realloc(m->watch, d->count * sizeof(struct eit_table *))) == NULL)
+		return;
+	m->watch = tmp;
+	m->watch_count = 0;
+	for (i = 0; i < d->count; i++) {
+		struct eit_table *t = d->tables[i];
+
+		if (((t->table_id & 0xf0) == 0x50) && (t->version_number != 0xff))
+			m->watch[m->watch_count++] = t;
+	}
+}
+
+static int tune(struct dvbfe_handle *fe, struct mux *m)
+{
+	struct dvbfe_info feinfo;
+	time_t starttime;
+
+	if (dvbsec_set(fe,
+		       valid_sec ? &sec : NULL,
+		       m->channel.polarization,
+		       (satpos & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       (satpos & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       &m->channel.fe_params,
+		       0))
+		return -1;
+
+	starttime = time(NULL);
+	while(((time(NULL) - starttime) < TIMEOUT_WAIT_LOCK) && !stop) {
+		if (dvbfe_get_info(fe, DVBFE_INFO_LOCKSTATUS, &feinfo,
+				   DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) !=
+		    DVBFE_INFO_QUERYTYPE_IMMEDIATE)
+			return -1;
+		if (feinfo.lock)
+			return 0;
+		usleep(100000);
+	}
+
+	return -1;
+}
+
+static void *eit_codec(struct section_ext *ext)
+{
+	return dvb_eit_section_codec(ext);
+}
+
+/**
+ * Decode a section read from the EIT PID and apply it. A repeat of one
+ * already applied in this dwell has nothing new and is skipped.
+ */
+static void feed_section(struct dwell *d, uint8_t *buf, int size)
+{
+	struct dvb_eit_section *eit;
+	int repeat;
+
+	if ((size < 1) ||
+	    (buf[0] < stag_dvb_event_information_nownext_actual) ||
+	    (buf[0] > 0x6f))
+		return;
+	eit = (struct dvb_eit_section *)
+		section_decoder_decode(d->decoder, EIT_PID, buf, size, eit_codec, &repeat);
+	if ((eit == NULL) || repeat)
+		return;
+
+	pthread_mutex_lock(&lock);
+	dvbepg_add_dvb_eit(epg, eit);
+	if ((eit->head.table_id >= 0x50) && table_section(d, eit)) {
+		d->last_new = time(NULL);
+		d->sections++;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+static int lease_revoked(struct adapter *a)
+{
+	return (a->lease != NULL) && dvbtuner_lease_revoked(a->lease);
+}
+
+/**
+ * Stay on a multiplex until its schedule is complete, or the dwell is up.
+ *
+ * @return Number of sections still missing.
+ */
+static int harvest(struct adapter *a, struct mux *m, int *sections)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+	uint8_t buf[4096];
+	struct dwell d;
+	struct pollfd pollfd;
+	time_t start;
+	int missing = -1;
+	int fd;
+
+	if ((fd = dvbdemux_open_demux(a->id, 0, 1)) < 0)
+		return -1;
+	dvbdemux_set_buffer(fd, DEMUX_BUFFER_SIZE);
+
+	// everything from 0x40 to 0x7f: p/f and schedule EITs, actual and other
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = 0x40;
+	mask[0] = 0xc0;
+	if (dvbdemux_set_section_filter(fd, EIT_PID, filter, mask, 1, 1)) {
+		close(fd);
+		return -1;
+	}
+
+	// the demux checks the CRCs
+	memset(&d, 0, sizeof(d));
+	if ((d.decoder = section_decoder_create(SECTION_DECODER_CRC_VERIFIED)) == NULL) {
+		close(fd);
+		return -1;
+	}
+	pthread_mutex_lock(&lock);
+	d.id = next_dwell_id++;
+	pthread_mutex_unlock(&lock);
+	start = d.last_new = time(NULL);
+
+	pollfd.fd = fd;
+	pollfd.events = POLLIN | POLLPRI;
+	while(!stop && !lease_revoked(a)) {
+		time_t now;
+		int size;
+
+		if (poll(&pollfd, 1, 1000) > 0) {
+			size = read(fd, buf, sizeof(buf));
+			if (size > 0)
+				feed_section(&d, buf, size);
+		}
+
+		now = time(NULL);
+		if ((now - start) >= max_dwell)
+			break;
+		if ((d.count == 0) || ((now - d.last_new) < settle))
+			continue;
+
+		// nothing new for a while: done if nothing is missing
+		pthread_mutex_lock(&lock);
+		missing = dwell_missing(&d);
+		pthread_mutex_unlock(&lock);
+		if (missing == 0)
+			break;
+	}
+
+	pthread_mutex_lock(&lock);
+	missing = dwell_missing(&d);
+	if (missing == 0)
+		mux_set_watch(m, &d);
+	pthread_mutex_unlock(&lock);
+
+	fprintf(stderr, "adapter %i: %u: %i tables, %i new sections, %i missing after %lis\n",
+		a->id, m->channel.fe_params.frequency, d.count, d.sections, missing,
+		(long) (time(NULL) - start));
+
+	free(d.tables);
+	section_decoder_destroy(d.decoder);
+	close(fd);
+	*sections = d.sections;
+	return missing;
+}
+
+/**
+ * Refresh a complete multiplex: one filter per known actual schedule table,
+ * passing only sections of a version other than the one held. Unchanged
+ * tables cost nothing; a changed one comes through whole, since the filter
+ * keeps comparing against the old version. Falls back to harvest() if the
+ * tables do not fit in MAX_WATCH filters, or the demux runs out of them.
+ *
+ * @return Number of sections still missing.
+ */
+static int watch(struct adapter *a, struct mux *m, int *sections)
+{
+	struct eit_table *watched[MAX_WATCH];
+	uint8_t versions[MAX_WATCH];
+	struct pollfd pollfds[MAX_WATCH];
+	uint8_t buf[4096];
+	struct dwell d;
+	time_t start;
+	int missing = -1;
+	int count;
+	int i;
+
+	pthread_mutex_lock(&lock);
+	count = m->watch_count;
+	if (count <= MAX_WATCH) {
+		for (i = 0; i < count; i++) {
+			watched[i] = m->watch[i];
+			versions[i] = m->watch[i]->version_number;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	if (count > MAX_WATCH)
+		return harvest(a, m, sections);
+
+	for (i = 0; i < count; i++) {
+		struct eit_table *t = watched[i];
+		uint8_t filter[18];
+		uint8_t mask[18];
+		int fd;
+
+		memset(filter, 0, sizeof(filter));
+		memset(mask, 0, sizeof(mask));
+		filter[0] = t->table_id;
+		filter[3] = t->service_id >> 8;
+		filter[4] = t->service_id;
+		filter[8] = t->transport_stream_id >> 8;
+		filter[9] = t->transport_stream_id;
+		filter[10] = t->network_id >> 8;
+		filter[11] = t->network_id;
+		mask[0] = mask[3] = mask[4] = 0xff;
+		memset(mask + 8, 0xff, 4);
+
+		if ((fd = dvbdemux_open_demux(a->id, 0, 1)) < 0)
+			break;
+		dvbdemux_set_buffer(fd, WATCH_BUFFER_SIZE);
+		if (dvbdemux_set_section_filter_changed(fd, EIT_PID, filter, mask,
+							versions[i], 1, 1)) {
+			close(fd);
+			break;
+		}
+		pollfds[i].fd = fd;
+		pollfds[i].events = POLLIN | POLLPRI;
+	}
+	if (i < count) {
+		while(i--)
+			close(pollfds[i].fd);
+		return harvest(a, m, sections);
+	}
+
+	memset(&d, 0, sizeof(d));
+	if ((d.decoder = section_decoder_create(SECTION_DECODER_CRC_VERIFIED)) == NULL) {
+		for (i = 0; i < count; i++)
+			close(pollfds[i].fd);
+		return -1;
+	}
+	pthread_mutex_lock(&lock);
+	d.id = next_dwell_id++;
+	pthread_mutex_unlock(&lock);
+	start = d.last_new = time(NULL);
+
+	while(!stop && !lease_revoked(a)) {
+		time_t now;
+
+		if (poll(pollfds, count, 1000) > 0) {
+			for (i = 0; i < count; i++) {
+				int size;
+
+				if (!(pollfds[i].revents & (POLLIN | POLLPRI)))
+					continue;
+				size = read(pollfds[i].fd, buf, sizeof(buf));
+				if (size > 0)
+					feed_section(&d, buf, size);
+			}
+		}
+
+		// unchanged tables are only known to be so after a full cycle
+		now = time(NULL);
+		if ((now - start) >= max_dwell)
+			break;
+		if ((now - d.last_new) < (d.count ? settle : watch_time))
+			continue;
+
+		pthread_mutex_lock(&lock);
+		missing = dwell_missing(&d);
+		pthread_mutex_unlock(&lock);
+		if (missing == 0)
+			break;
+	}
+
+	pthread_mutex_lock(&lock);
+	missing = dwell_missing(&d);
+	pthread_mutex_unlock(&lock);
+
+	fprintf(stderr, "adapter %i: %u: %i of %i tables changed, %i new sections, %i missing after %lis\n",
+		a->id, m->channel.fe_params.frequency, d.count, count, d.sections, missing,
+		(long) (time(NULL) - start));
+
+	free(d.tables);
+	section_decoder_destroy(d.decoder);
+	for (i = 0; i < count; i++)
+		close(pollfds[i].fd);
+	*sections = d.sections;
+	return missing;
+}
+
+/**
+ * Lease the adapter's frontend for a multiplex, and open it.
+ *
+ * @return 0 if it is ours to tune, 1 if another holder has it on the
+ * multiplex already, -1 if it could not be had.
+ */
+static int lease_mux(struct adapter *a, struct mux *m)
+{
+	struct dvbtuner_request request;
+	int shared;
+
+	memset(&request, 0, sizeof(request));
+	request.mux.type = fe_type;
+	request.mux.delivery_system = m->channel.fe_params.delivery_system;
+	request.mux.frequency = m->channel.fe_params.frequency;
+	request.mux.stream_id = m->channel.fe_params.stream_id;
+	if (fe_type == DVBFE_TYPE_DVBS) {
+		request.mux.polarization = m->channel.polarization;
+		request.mux.diseqc_switch = satpos;
+		snprintf(request.mux.wiring, sizeof(request.mux.wiring), "%s", secid);
+	}
+	request.priority = priority;
+	request.adapter = a->id;
+	request.frontend = 0;
+	if ((a->lease = dvbtuner_acquire(&request, 0)) == NULL)
+		return -1;
+
+	shared = dvbtuner_lease_shared(a->lease);
+	if ((a->fe = dvbfe_open(a->id, 0, shared)) == NULL) {
+		dvbtuner_release(a->lease);
+		a->lease = NULL;
+		return -1;
+	}
+	return shared;
+}
+
+static void release_lease(struct adapter *a)
+{
+	dvbfe_close(a->fe);
+	a->fe = NULL;
+	dvbtuner_release(a->lease);
+	a->lease = NULL;
+}
+
+static void *adapter_thread(void *arg)
+{
+	struct adapter *a = arg;
+	struct mux *m;
+
+	while(!stop) {
+		int sections = 0;
+		int shared = 0;
+		int missing;
+
+		if ((m = pick_mux()) == NULL) {
+			if (!refresh)
+				break;
+			sleep(1);
+			continue;
+		}
+
+		// in service mode the frontend is only ours for the visit
+		if (refresh && ((shared = lease_mux(a, m)) < 0)) {
+			return_mux(m);
+			sleep(settle);
+			continue;
+		}
+
+		if (!shared && tune(a->fe, m)) {
+			fprintf(stderr, "adapter %i: %u: no lock\n", a->id,
+				m->channel.fe_params.frequency);
+			release_mux(m, 0, m->remaining, 0);
+			if (refresh)
+				release_lease(a);
+			continue;
+		}
+
+		if (refresh && (m->remaining == 0) && m->watch_count && (m->visits % full_every))
+			missing = watch(a, m, &sections);
+		else
+			missing = harvest(a, m, &sections);
+		if (lease_revoked(a)) {
+			// cut short: not a pass, try again elsewhere or later
+			fprintf(stderr, "adapter %i: tuner taken by a higher priority job\n", a->id);
+			pthread_mutex_lock(&lock);
+			m->sections += sections;
+			pthread_mutex_unlock(&lock);
+			return_mux(m);
+		} else {
+			release_mux(m, missing == 0, missing, sections);
+		}
+		if (refresh)
+			release_lease(a);
+	}
+
+	return NULL;
+}
+
+
+
+
+/*
+ * query socket
+ */
+
+static void print_string(FILE *out, const char *str)
+{
+	if (str == NULL)
+		return;
+	for (; *str; str++)
+		fputc(((*str == '\t') || (*str == '\n') || (*str == '\r')) ? ' ' : *str, out);
+}
+
+static int print_event(void *private_data, const struct dvbepg_event *event)
+{
+	FILE *out = private_data;
+
+	fprintf(out, "%u\t%li\t%u\t%s\t", event->event_id, (long) event->start_time,
+		event->duration, event->language);
+	print_string(out, event->title);
+	fputc('\t', out);
+	print_string(out, event->text);
+	fputc('\n', out);
+	return 0;
+}
+
+static int print_service(void *private_data, const struct dvbepg_service_id *service)
+{
+	FILE *out = private_data;
+
+	if (service->source == DVBEPG_SOURCE_DVB)
+		fprintf(out, "%u\t%u\t%u\n", service->network_id,
+			service->transport_stream_id, service->service_id);
+	return 0;
+}
+
+/**
+ * Answer one command (called with lock held).
+ */
+static void query(FILE *out, char *line)
+{
+	struct dvbepg_service_id service;
+	const struct dvbepg_event *event;
+	char command[16];
+	unsigned int onid, tsid, sid;
+	long arg1, arg2;
+	int args;
+
+	args = sscanf(line, "%15s %u %u %u %li %li", command, &onid, &tsid, &sid, &arg1, &arg2);
+	if (args < 1)
+		return;
+	memset(&service, 0, sizeof(service));
+	service.source = DVBEPG_SOURCE_DVB;
+	service.network_id = onid;
+	service.transport_stream_id = tsid;
+	service.service_id = sid;
+
+	if (!strcmp(command, "SERVICES")) {
+		dvbepg_for_each_service(epg, print_service, out);
+	} else if (!strcmp(command, "NOW") && (args >= 4)) {
+		if ((event = dvbepg_find_event_at(epg, &service, (args >= 5) ? arg1 : time(NULL))) != NULL)
+			print_event(out, event);
+	} else if (!strcmp(command, "EVENT") && (args >= 5)) {
+		if ((event = dvbepg_find_event(epg, &service, arg1)) != NULL)
+			print_event(out, event);
+	} else if (!strcmp(command, "RANGE") && (args >= 6)) {
+		dvbepg_for_each_event(epg, &service, arg1, arg2, print_event, out);
+	} else if (!strcmp(command, "STATS")) {
+		struct dvbepg_stats stats;
+
+		dvbepg_stats(epg, &stats);
+		fprintf(out, "%u\t%u\t%u\t%u\t%llu\t%llu\n", stats.services, stats.events,
+			stats.strings, stats.dictionary_entries,
+			(unsigned long long) stats.text_size, (unsigned long long) stats.stored_size);
+	} else if (!strcmp(command, "STATUS")) {
+		time_t now = time(NULL);
+		struct mux *m;
+
+		for (m = muxes; m; m = m->next)
+			fprintf(out, "%u\t%i\t%li\n", m->channel.fe_params.frequency, m->remaining,
+				(m->done && (m->due > now)) ? (long) (m->due - now) : 0L);
+	} else {
+		fprintf(out, "ERR bad command\n");
+	}
+}
+
+/**
+ * Answer the complete lines a client has sent. The answers are formatted
+ * under lock, but written after it is dropped, so a slow client cannot hold
+ * up the adapters.
+ *
+ * @return -1 if the client has gone.
+ */
+static int client_lines(struct client *c)
+{
+	char *line = c->line;
+	char *end;
+
+	while((end = memchr(line, '\n', c->len - (line - c->line))) != NULL) {
+		char *answer = NULL;
+		size_t answer_len = 0;
+		FILE *out;
+		int err;
+
+		*end = 0;
+		if ((end > line) && (end[-1] == '\r'))
+			end[-1] = 0;
+		if ((out = open_memstream(&answer, &answer_len)) == NULL)
+			return -1;
+		pthread_mutex_lock(&lock);
+		query(out, line);
+		pthread_mutex_unlock(&lock);
+		fputs(".\n", out);
+		fclose(out);
+
+		err = (send(c->fd, answer, answer_len, MSG_NOSIGNAL) != (ssize_t) answer_len);
+		free(answer);
+		if (err)
+			return -1;
+		line = end + 1;
+	}
+
+	c->len -= line - c->line;
+	memmove(c->line, line, c->len);
+	if (c->len == sizeof(c->line))
+		return -1;
+	return 0;
+}
+
+static void *serve_thread(void *arg)
+{
+	int listenfd = *(int *) arg;
+	struct pollfd pollfds[MAX_CLIENTS + 1];
+	struct client clients[MAX_CLIENTS];
+	int count = 0;
+	int i;
+
+	while(!stop) {
+		pollfds[0].fd = listenfd;
+		pollfds[0].events = POLLIN;
+		for (i = 0; i < count; i++) {
+			pollfds[i + 1].fd = clients[i].fd;
+			pollfds[i + 1].events = POLLIN;
+		}
+		if (poll(pollfds, count + 1, 1000) <= 0)
+			continue;
+
+		for (i = count - 1; i >= 0; i--) {
+			struct client *c = &clients[i];
+			int size;
+
+			if (!pollfds[i + 1].revents)
+				continue;
+			size = read(c->fd, c->line + c->len, sizeof(c->line) - c->len);
+			if (size > 0) {
+				c->len += size;
+				if (client_lines(c) == 0)
+					continue;
+			}
+			close(c->fd);
+			clients[i] = clients[--count];
+		}
+
+		if (pollfds[0].revents & POLLIN) {
+			int fd = accept(listenfd, NULL, NULL);
+
+			if (fd < 0)
+				continue;
+			if (count == MAX_CLIENTS) {
+				close(fd);
+				continue;
+			}
+			clients[count].fd = fd;
+			clients[count].len = 0;
+			count++;
+		}
+	}
+
+	for (i = 0; i < count; i++)
+		close(clients[i].fd);
+	return NULL;
+}
+
+static int serve_open(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		return -1;
+	unlink(path);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, MAX_CLIENTS)) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* write the guide out, replacing the file atomically (called with lock held) */
+static int export_guide(void)
+{
+	struct dvbepg_export_params params;
+	char filename[PATH_MAX];
+	char tmpname[PATH_MAX];
+	int fd;
+	int ret;
+
+	// Arrow increments are loaded one after the other, so each is a file of
+	// its own, named by the serial it is up to; one with nothing in is skipped
+	if (incremental && (export_format == DVBEPG_EXPORT_ARROW)) {
+		if (exported_serial && (exported_serial == dvbepg_change_serial(epg)))
+			return 0;
+		if (snprintf(filename, sizeof(filename), "%s.%u", export_filename,
+			     dvbepg_change_serial(epg)) >= (int) sizeof(filename))
+			return -ENAMETOOLONG;
+	} else if (snprintf(filename, sizeof(filename), "%s", export_filename) >= (int) sizeof(filename)) {
+		return -ENAMETOOLONG;
+	}
+
+	if (snprintf(tmpname, sizeof(tmpname), "%s.XXXXXX", filename) >= (int) sizeof(tmpname))
+		return -ENAMETOOLONG;
+	if ((fd = mkstemp(tmpname)) < 0)
+		return -errno;
+	fchmod(fd, 0644);
+
+	memset(&params, 0, sizeof(params));
+	params.format = export_format;
+	params.since = incremental ? exported_serial : 0;
+	ret = dvbepg_export(epg, fd, &params);
+	if (close(fd) && !ret)
+		ret = -errno;
+	if (!ret && rename(tmpname, filename))
+		ret = -errno;
+	if (ret) {
+		unlink(tmpname);
+		return ret;
+	}
+
+	exported_serial = dvbepg_change_serial(epg);
+	return 0;
+}
+
+static int save(const char *filename)
+{
+	int ret;
+	int export_ret = 0;
+
+	pthread_mutex_lock(&lock);
+	dvbepg_expire(epg, time(NULL));
+	if (compress) {
+		struct dvbepg_stats stats;
+
+		// train again once the guide has grown by half since
+		dvbepg_stats(epg, &stats);
+		if ((stats.strings > compressed_strings + (compressed_strings / 2)) &&
+		    (dvbepg_compress(epg, compress) == 0))
+			compressed_strings = stats.strings;
+	}
+	ret = dvbepg_save(epg, filename);
+	if (export_filename != NULL)
+		export_ret = export_guide();
+	pthread_mutex_unlock(&lock);
+
+	if (ret)
+		fprintf(stderr, "Failed to write %s: %s\n", filename, strerror(-ret));
+	if (export_ret)
+		fprintf(stderr, "Failed to write %s: %s\n", export_filename, strerror(-export_ret));
+	return ret ? ret : export_ret;
+}
+
+
+
+
+/*
+ * setup
+ */
+
+static int scan_load_callback(struct dvbcfg_scanfile *channel, void *private_data)
+{
+	struct mux ***tail = private_data;
+	struct mux *m;
+
+	if (channel->fe_type != fe_type)
+		return 0;
+
+	if ((m = calloc(1, sizeof(struct mux))) == NULL)
+		return 0;
+	memcpy(&m->channel, channel, sizeof(struct dvbcfg_scanfile));
+	m->remaining = -1;
+
+	// keep the scan file order
+	**tail = m;
+	*tail = &m->next;
+	return 0;
+}
+
+static int parse_adapters(char *list, int *ids)
+{
+	int count = 0;
+	char *tok;
+	char *save = NULL;
+
+	for (tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+		if (count == MAX_ADAPTERS)
+			break;
+		if (sscanf(tok, "%i", &ids[count]) != 1)
+			return -1;
+		count++;
+	}
+
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	int argpos = 1;
+	char *secfile = NULL;
+	char *scan_filename = NULL;
+	char *out_filename = NULL;
+	char *serve_path = NULL;
+	pthread_t serve;
+	int listenfd = -1;
+	int adapter_ids[MAX_ADAPTERS];
+	int adapter_count = -1;
+	struct adapter adapters[MAX_ADAPTERS];
+	int running = 0;
+	int i;
+
+	while(argpos != argc) {
+		if (!strcmp(argv[argpos], "-h")) {
+			usage();
+		} else if (!strcmp(argv[argpos], "-adapters")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((adapter_count = parse_adapters(argv[argpos+1], adapter_ids)) <= 0)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-secfile")) {
+			if ((argc - argpos) < 2)
+				usage();
+			secfile = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-secid")) {
+			if ((argc - argpos) < 2)
+				usage();
+			secid = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-satpos")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &satpos) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-settle")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &settle) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-dwell")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &max_dwell) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-passes")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &max_passes) != 1) || (max_passes < 1))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-out")) {
+			if ((argc - argpos) < 2)
+				usage();
+			out_filename = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-refresh")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &refresh) != 1) || (refresh < 1))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-watch")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &watch_time) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-full")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &full_every) != 1) || (full_every < 1))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-priority")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &priority) != 1)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-compress")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &compress) != 1) || (compress < 1) ||
+			    (compress > DVBEPG_DICTIONARY_MAX))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-xmltv") || !strcmp(argv[argpos], "-json") ||
+			   !strcmp(argv[argpos], "-arrow")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (!strcmp(argv[argpos], "-json"))
+				export_format = DVBEPG_EXPORT_JSON;
+			else if (!strcmp(argv[argpos], "-arrow"))
+				export_format = DVBEPG_EXPORT_ARROW;
+			else
+				export_format = DVBEPG_EXPORT_XMLTV;
+			export_filename = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-incremental")) {
+			incremental = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-serve")) {
+			if ((argc - argpos) < 2)
+				usage();
+			serve_path = argv[argpos+1];
+			argpos+=2;
+		} else {
+			if ((argc - argpos) != 1)
+				usage();
+			scan_filename = argv[argpos];
+			argpos++;
+		}
+	}
+	if ((scan_filename == NULL) || (out_filename == NULL))
+		usage();
+
+	// open the adapters; the first one decides the frontend type
+	if (adapter_count < 0) {
+		for (i = 0; i < MAX_ADAPTERS; i++)
+			adapter_ids[i] = i;
+	}
+	for (i = 0; i < ((adapter_count < 0) ? MAX_ADAPTERS : adapter_count); i++) {
+		struct dvbfe_handle *fe = dvbfe_open(adapter_ids[i], 0, 0);
+		struct dvbfe_info feinfo;
+
+		if (fe == NULL)
+			continue;
+		if ((dvbfe_get_info(fe, 0, &feinfo, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) != 0) ||
+		    (running && (feinfo.type != fe_type))) {
+			dvbfe_close(fe);
+			continue;
+		}
+		fe_type = feinfo.type;
+		adapters[running].id = adapter_ids[i];
+		adapters[running].fe = fe;
+		adapters[running].lease = NULL;
+		running++;
+
+		// in service mode it is opened for each visit under a lease
+		if (refresh) {
+			dvbfe_close(fe);
+			adapters[running - 1].fe = NULL;
+		}
+	}
+	if (running == 0) {
+		fprintf(stderr, "Failed to open any frontend\n");
+		exit(1);
+	}
+
+	// default SEC with a DVBS card
+	if ((secid == NULL) && (fe_type == DVBFE_TYPE_DVBS))
+		secid = "UNIVERSAL";
+	if (secid != NULL) {
+		if (dvbsec_cfg_find(secfile, secid, &sec)) {
+			fprintf(stderr, "Unable to find suitable sec/lnb configuration for channel\n");
+			exit(1);
+		}
+		valid_sec = 1;
+	}
+
+	// load the multiplexes
+	FILE *scan_file = fopen(scan_filename, "r");
+	if (scan_file == NULL) {
+		fprintf(stderr, "Could not open scan file %s\n", scan_filename);
+		exit(1);
+	}
+	struct mux **tail = &muxes;
+	if (dvbcfg_scanfile_parse(scan_file, scan_load_callback, &tail) < 0) {
+		fprintf(stderr, "Could not parse scan file %s\n", scan_filename);
+		exit(1);
+	}
+	fclose(scan_file);
+
+	// carry on from the last run: unchanged sections are skipped by the store
+	if ((epg = dvbepg_load(out_filename)) == NULL) {
+		if ((epg = dvbepg_create()) == NULL) {
+			fprintf(stderr, "Failed to create EPG store\n");
+			exit(1);
+		}
+	}
+	dvbepg_expire(epg, time(NULL));
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	if (serve_path != NULL) {
+		if ((listenfd = serve_open(serve_path)) < 0) {
+			fprintf(stderr, "Failed to open socket %s: %s\n", serve_path, strerror(errno));
+			exit(1);
+		}
+		if (pthread_create(&serve, NULL, serve_thread, &listenfd)) {
+			fprintf(stderr, "Failed to create query thread\n");
+			exit(1);
+		}
+	}
+
+	for (i = 0; i < running; i++) {
+		if (pthread_create(&adapters[i].thread, NULL, adapter_thread, &adapters[i])) {
+			fprintf(stderr, "Failed to create thread for adapter %i\n", adapters[i].id);
+			exit(1);
+		}
+	}
+
+	// service mode: keep the snapshot fresh until told to stop
+	if (refresh) {
+		time_t next_save = time(NULL) + refresh;
+
+		while(!stop) {
+			sleep(1);
+			if (time(NULL) >= next_save) {
+				save(out_filename);
+				next_save = time(NULL) + refresh;
+			}
+		}
+	}
+
+	for (i = 0; i < running; i++) {
+		pthread_join(adapters[i].thread, NULL);
+		if (adapters[i].fe != NULL)
+			dvbfe_close(adapters[i].fe);
+	}
+	if (serve_path != NULL) {
+		// a run-once harvest keeps answering until interrupted
+		if (!refresh && !stop)
+			save(out_filename);
+		while(!stop)
+			sleep(1);
+		pthread_join(serve, NULL);
+		close(listenfd);
+		unlink(serve_path);
+	}
+
+	// report and save what we have, even if interrupted
+	struct mux *m;
+	for (m = muxes; m; m = m->next) {
+		if (m->remaining != 0)
+			fprintf(stderr, "%u: incomplete after %i passes (%i sections missing)\n",
+				m->channel.fe_params.frequency, m->passes, m->remaining);
+	}
+	if (save(out_filename))
+		exit(1);
+
+	dvbepg_destroy(epg);
+	free_tables();
+	while(muxes) {
+		m = muxes;
+		muxes = m->next;
+		free(m->watch);
+		free(m);
+	}
+
+	return 0;
+}
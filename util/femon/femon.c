@@ -36,6 +36,7 @@
 #include <sys/time.h>
 
 #include <libdvbapi/dvbfe.h>
+#include "femon_daemon.h"
 
 #define FE_STATUS_PARAMS (DVBFE_INFO_LOCKSTATUS|DVBFE_INFO_SIGNAL_STRENGTH|DVBFE_INFO_BER|DVBFE_INFO_SNR|DVBFE_INFO_UNCORRECTED_BLOCKS)
 
@@ -48,7 +49,11 @@ static char *usage_str =
     "                 machine but. The user has to be root.\n"
     "     -a number : use given adapter (default 0)\n"
     "     -f number : use given frontend (default 0)\n"
-    "     -c number : samples to take (default 0 = infinite)\n\n";
+    "     -c number : samples to take (default 0 = infinite)\n"
+    "     -D name   : daemon mode: monitor every frontend, publishing the samples\n"
+    "                 into the shared memory object <name> (e.g. /femon)\n"
+    "     -i ms     : daemon mode sampling interval (default 1000)\n"
+    "     -R number : daemon mode ring size in samples (default 4096)\n\n";
 
 int sleep_time=1000000;
 int acoustical_mode=0;
@@ -185,10 +190,12 @@ int do_mon(unsigned int adapter, unsigned int frontend, int human_readable, unsi
 int main(int argc, char *argv[])
 {
 	unsigned int adapter = 0, frontend = 0, count = 0;
+	unsigned int interval_ms = 1000, ring_size = 4096;
+	char *shm_name = NULL;
 	int human_readable = 0;
 	int opt;
 
-       while ((opt = getopt(argc, argv, "rAHa:f:c:")) != -1) {
+       while ((opt = getopt(argc, argv, "rAHa:f:c:D:i:R:")) != -1) {
 		switch (opt)
 		{
 		default:
@@ -215,9 +222,21 @@ int main(int argc, char *argv[])
 		case 'r':
 			remote=1;
 			break;
+		case 'D':
+			shm_name = optarg;
+			break;
+		case 'i':
+			interval_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			ring_size = strtoul(optarg, NULL, 0);
+			break;
 		}
 	}
 
+	if (shm_name)
+		return femon_daemon(shm_name, interval_ms, ring_size);
+
 	do_mon(adapter, frontend, human_readable, count);
 
 	return 0;
@@ -0,0 +1,278 @@
+/* femon -- monitor frontend status
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <libdvbapi/dvbfe.h>
+#include "femon_daemon.h"
+
+/*
+ * The wheel spreads the frontends evenly over the sampling interval, so the
+ * ioctls of a rack full of tuners do not all land in the same millisecond.
+ */
+#define FEMON_WHEEL_SLOTS 64
+
+struct femon_frontend {
+	struct femon_frontend *next;	/* in the same wheel slot */
+	struct dvbfe_handle *fe;
+	uint16_t adapter;
+	uint16_t frontend;
+};
+
+static volatile sig_atomic_t femon_quit = 0;
+
+static void femon_signal(int sig)
+{
+	(void) sig;
+
+	femon_quit = 1;
+}
+
+static int femon_parse_index(const char *name, const char *prefix)
+{
+	size_t len = strlen(prefix);
+	char *end;
+	long val;
+
+	if (strncmp(name, prefix, len) || (name[len] < '0') || (name[len] > '9'))
+		return -1;
+	val = strtol(name + len, &end, 10);
+	if (*end || (val > 0xffff))
+		return -1;
+	return val;
+}
+
+static struct femon_frontend *femon_find_frontends(unsigned int *count)
+{
+	struct femon_frontend *frontends = NULL;
+	struct femon_frontend *cur;
+	struct dirent *dentry;
+	struct dirent *fentry;
+	DIR *dvbdir;
+	DIR *adapterdir;
+	char path[64];
+	int adapter;
+	int frontend;
+
+	*count = 0;
+	if ((dvbdir = opendir("/dev/dvb")) == NULL)
+		return NULL;
+
+	while((dentry = readdir(dvbdir)) != NULL) {
+		if ((adapter = femon_parse_index(dentry->d_name, "adapter")) < 0)
+			continue;
+
+		sprintf(path, "/dev/dvb/adapter%i", adapter);
+		if ((adapterdir = opendir(path)) == NULL)
+			continue;
+
+		while((fentry = readdir(adapterdir)) != NULL) {
+			struct dvbfe_handle *fe;
+
+			if ((frontend = femon_parse_index(fentry->d_name, "frontend")) < 0)
+				continue;
+			if ((fe = dvbfe_open(adapter, frontend, 1)) == NULL) {
+				fprintf(stderr, "Unable to open adapter %i frontend %i: %m\n",
+					adapter, frontend);
+				continue;
+			}
+
+			cur = malloc(sizeof(struct femon_frontend));
+			if (cur == NULL) {
+				dvbfe_close(fe);
+				continue;
+			}
+			cur->fe = fe;
+			cur->adapter = adapter;
+			cur->frontend = frontend;
+			cur->next = frontends;
+			frontends = cur;
+			(*count)++;
+		}
+		closedir(adapterdir);
+	}
+	closedir(dvbdir);
+
+	return frontends;
+}
+
+static void femon_sample(struct femon_shm_header *shm, struct femon_frontend *cur)
+{
+	struct femon_shm_sample *sample;
+	struct dvbfe_info fe_info;
+	struct timeval now;
+	uint64_t pos;
+	int valid;
+
+	memset(&fe_info, 0, sizeof(fe_info));
+	valid = dvbfe_get_stats(cur->fe, &fe_info);
+	gettimeofday(&now, NULL);
+
+	pos = shm->head;
+	sample = &shm->ring[pos & (shm->ring_size - 1)];
+
+	// invalidate the slot before touching it, and publish it when done
+	sample->seq = 0;
+	__sync_synchronize();
+	sample->timestamp_us = ((uint64_t) now.tv_sec * 1000000) + now.tv_usec;
+	sample->adapter = cur->adapter;
+	sample->frontend = cur->frontend;
+	sample->status = 0;
+	if (valid & DVBFE_INFO_LOCKSTATUS) {
+		sample->status =
+			(fe_info.signal ? FEMON_STATUS_SIGNAL : 0) |
+			(fe_info.carrier ? FEMON_STATUS_CARRIER : 0) |
+			(fe_info.viterbi ? FEMON_STATUS_VITERBI : 0) |
+			(fe_info.sync ? FEMON_STATUS_SYNC : 0) |
+			(fe_info.lock ? FEMON_STATUS_LOCK : 0);
+	}
+	sample->valid = valid;
+	sample->signal_strength = fe_info.signal_strength;
+	sample->snr = fe_info.snr;
+	sample->ber = fe_info.ber;
+	sample->ucblocks = fe_info.ucblocks;
+	sample->reserved = 0;
+	__sync_synchronize();
+	sample->seq = pos + 1;
+	__sync_synchronize();
+	shm->head = pos + 1;
+}
+
+static void femon_timespec_add(struct timespec *ts, uint64_t ns)
+{
+	ns += ts->tv_nsec;
+	ts->tv_sec += ns / 1000000000;
+	ts->tv_nsec = ns % 1000000000;
+}
+
+int femon_daemon(const char *shm_name, unsigned int interval_ms, unsigned int ring_size)
+{
+	struct femon_frontend *wheel[FEMON_WHEEL_SLOTS];
+	struct femon_frontend *frontends;
+	struct femon_frontend *cur;
+	struct femon_shm_header *shm;
+	struct sigaction sa;
+	struct timespec next;
+	unsigned int count;
+	unsigned int slots;
+	unsigned int slot;
+	unsigned int i;
+	uint64_t tick_ns;
+	size_t shm_size;
+	int fd;
+
+	// the ring is indexed with a mask
+	if (ring_size < 2)
+		ring_size = 2;
+	for(i = 1; i < ring_size; i <<= 1);
+	ring_size = i;
+
+	frontends = femon_find_frontends(&count);
+	if (count == 0) {
+		fprintf(stderr, "No frontends found\n");
+		return 1;
+	}
+
+	// create and size the shared memory
+	shm_size = sizeof(struct femon_shm_header) + (ring_size * sizeof(struct femon_shm_sample));
+	if ((fd = shm_open(shm_name, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "Unable to create shared memory %s: %m\n", shm_name);
+		return 1;
+	}
+	if (ftruncate(fd, shm_size)) {
+		fprintf(stderr, "Unable to size shared memory: %m\n");
+		close(fd);
+		shm_unlink(shm_name);
+		return 1;
+	}
+	shm = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		fprintf(stderr, "Unable to map shared memory: %m\n");
+		shm_unlink(shm_name);
+		return 1;
+	}
+	shm->ring_size = ring_size;
+	shm->frontend_count = count;
+	shm->interval_ms = interval_ms;
+	shm->pid = getpid();
+	shm->head = 0;
+	shm->version = FEMON_SHM_VERSION;
+	__sync_synchronize();
+	shm->magic = FEMON_SHM_MAGIC;
+
+	// one wheel slot per millisecond at most, spreading the frontends evenly
+	slots = FEMON_WHEEL_SLOTS;
+	if (interval_ms < slots)
+		slots = interval_ms ? interval_ms : 1;
+	memset(wheel, 0, sizeof(wheel));
+	for(i = 0, cur = frontends; cur; i++) {
+		struct femon_frontend *next_fe = cur->next;
+
+		slot = (i * slots) / count;
+		cur->next = wheel[slot];
+		wheel[slot] = cur;
+		cur = next_fe;
+	}
+	tick_ns = ((uint64_t) interval_ms * 1000000) / slots;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = femon_signal;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	fprintf(stderr, "Monitoring %u frontends every %ums into %s\n", count, interval_ms, shm_name);
+
+	// absolute deadlines so sampling does not drift
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	slot = 0;
+	while(!femon_quit) {
+		for(cur = wheel[slot]; cur; cur = cur->next)
+			femon_sample(shm, cur);
+
+		slot = (slot + 1) % slots;
+		femon_timespec_add(&next, tick_ns);
+		while((clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR) &&
+		      (!femon_quit));
+	}
+
+	// exporters still mapping it keep their copy
+	shm_unlink(shm_name);
+	munmap(shm, shm_size);
+	for(slot = 0; slot < slots; slot++) {
+		while(wheel[slot]) {
+			cur = wheel[slot];
+			wheel[slot] = cur->next;
+			dvbfe_close(cur->fe);
+			free(cur);
+		}
+	}
+
+	return 0;
+}
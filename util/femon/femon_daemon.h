@@ -0,0 +1,85 @@
+/* femon -- monitor frontend status
+ *
+ * Copyright (C) 2026 linuxtv.org dvb-apps contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ */
+
+#ifndef FEMON_DAEMON_H
+#define FEMON_DAEMON_H 1
+
+#include <stdint.h>
+
+/**
+ * Layout of the shared memory object published by "femon -D <name>".
+ *
+ * The daemon is the only writer. Exporters shm_open() the object read only,
+ * mmap() it, and then read samples without any syscalls:
+ *
+ *	1. read head, then issue a read barrier.
+ *	2. for each wanted position p (head - ring_size < p < head), copy
+ *	   ring[p & (ring_size - 1)] and check its seq: it must equal p + 1 both
+ *	   before and after the copy (with read barriers in between), otherwise
+ *	   the slot was overwritten meanwhile and the copy is discarded.
+ *
+ * All fields are in host byte order.
+ */
+#define FEMON_SHM_MAGIC		0x464d4f4e	/* "FMON" */
+#define FEMON_SHM_VERSION	1
+
+/* femon_shm_sample.status */
+#define FEMON_STATUS_SIGNAL	0x01
+#define FEMON_STATUS_CARRIER	0x02
+#define FEMON_STATUS_VITERBI	0x04
+#define FEMON_STATUS_SYNC	0x08
+#define FEMON_STATUS_LOCK	0x10
+
+struct femon_shm_sample {
+	volatile uint64_t seq;		/* ring position + 1, 0 while being written */
+	uint64_t timestamp_us;		/* CLOCK_REALTIME when sampled */
+	uint16_t adapter;
+	uint16_t frontend;
+	uint16_t status;		/* FEMON_STATUS_* */
+	uint16_t valid;			/* DVBFE_INFO_* that were read successfully */
+	uint16_t signal_strength;
+	uint16_t snr;
+	uint32_t ber;
+	uint32_t ucblocks;
+	uint32_t reserved;
+};
+
+struct femon_shm_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t ring_size;		/* entries in ring; a power of 2 */
+	uint32_t frontend_count;	/* frontends being monitored */
+	uint32_t interval_ms;		/* each frontend is sampled this often */
+	uint32_t pid;			/* of the daemon */
+	volatile uint64_t head;		/* samples written so far */
+	struct femon_shm_sample ring[0];
+};
+
+/**
+ * Monitor every frontend in the system from one thread, publishing the
+ * samples into a shared memory ring. Runs until SIGINT or SIGTERM.
+ *
+ * @param shm_name Name of the shared memory object (e.g. "/femon").
+ * @param interval_ms Time between two samples of the same frontend.
+ * @param ring_size Number of samples kept (rounded up to a power of 2).
+ * @return 0 on success, nonzero on failure.
+ */
+extern int femon_daemon(const char *shm_name, unsigned int interval_ms, unsigned int ring_size);
+
+#endif
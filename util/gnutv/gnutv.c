@@ -24,24 +24,58 @@
 #include <unistd.h>
 #include <limits.h>
 #include <string.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <pthread.h>
 #include <sys/poll.h>
 #include <libdvbapi/dvbdemux.h>
 #include <libdvbapi/dvbaudio.h>
+#include <libdvbapi/dvblatency.h>
+#include <libdvbapi/dvbtuner.h>
 #include <libdvbsec/dvbsec_cfg.h>
+#include <libdvbcfg/dvbcfg_zapindex.h>
 #include <libucsi/mpeg/section.h>
 #include "gnutv.h"
 #include "gnutv_dvb.h"
 #include "gnutv_ca.h"
 #include "gnutv_data.h"
+#include "gnutv_server.h"
+#include "gnutv_satip.h"
+#include "gnutv_affinity.h"
+#include "gnutv_remux.h"
+#include "gnutv_http.h"
+#include "gnutv_fec.h"
+#include "gnutv_monitor.h"
+#include "gnutv_shed.h"
+#include "gnutv_store.h"
+#include "gnutv_xdp.h"
+#include "gnutv_tee.h"
+#include "gnutv_standby.h"
 
 
 static void signal_handler(int _signal);
 
 static int quit_app = 0;
 
+struct service_arg {
+	char *channel_name;
+	int output_type;
+	char *outfile;
+	char *outhost;
+	char *outport;
+	int usertp;
+};
+
+struct tee_arg {
+	int output_type;		// OUTPUT_TYPE_FILE, _STDOUT, _UDP or _HTTP
+	char *outfile;
+	char *outhost;
+	char *outport;
+	char *outif;
+	int usertp;
+};
+
 void usage(void)
 {
 	static const char *_usage = "\n"
@@ -52,9 +86,12 @@ void usage(void)
 		" -h			help\n"
 		" -adapter <id>		adapter to use (default 0)\n"
 		" -frontend <id>	frontend to use (default 0)\n"
-		" -demux <id>		demux to use (default 0)\n"
+		" -demux <id>		demux to use (default 0). With -daemon, \"auto\" spreads\n"
+		"				each tuner's filters over all its demuxes\n"
 		" -caslotnum <id>	ca slot number to use (default 0)\n"
 		" -channels <filename>	channels.conf file.\n"
+		" -chanstore <name>	Look channels up in the shared store <name> rather\n"
+		"				than the channels.conf file\n"
 		" -secfile <filename>	Optional sec.conf file.\n"
 		" -secid <secid>	ID of the SEC configuration to use, one of:\n"
 		"			 * UNIVERSAL (default) - Europe, 10800 to 11800 MHz and 11600 to 12700 Mhz,\n"
@@ -67,38 +104,196 @@ void usage(void)
 		"						Dual LO, H:5150MHz, V:5750MHz.\n"
 		"			 * One of the sec definitions from the secfile if supplied\n"
 		" -buffer <size>	Custom DVR buffer size\n"
+		" -ring <size>		Drain the DVR into a <size> byte ring buffer from a thread\n"
+		"				of its own, so output stalls don't overflow the DVR\n"
+		" -ringdrop		Drop data when the ring is full, rather than waiting\n"
+		" -hugepages		Back the ring with huge pages\n"
+		" -shed			With file, stdout, timeshift, segment, udp, rtp, http or\n"
+		"				tee output, leave out the less important streams as\n"
+		"				the -ring (16MB by default) fills: from half full,\n"
+		"				teletext, subtitles, data and EIT; then extra audio and\n"
+		"				video; then B pictures. They come back as it empties\n"
+		" -extent <MB>		Collect each -service or -daemon file recording into <MB>\n"
+		"				megabyte extents, written by a thread of their own\n"
+		"				(default 4; 0 => write as the data comes)\n"
+		" -stats <secs>		Print DVR fill level, overflows and throughput every <secs>\n"
+		" -latency		Print tune, lock, PAT and PMT latency histograms on exit\n"
+		" -numa			Run on the CPUs, and allocate from the memory, of the\n"
+		"				adapter's NUMA node\n"
+		" -cpus <list>		Run on the given CPUs (e.g. 0-3,8)\n"
+		" -fifo <prio>		Read the DVR (from the -ring drain thread if used) in a\n"
+		"				SCHED_FIFO thread of priority <prio> (1-99)\n"
 		" -out decoder		Output to hardware decoder (default)\n"
 		"      decoderabypass	Output to hardware decoder using audio bypass\n"
 		"      dvr		Output stream to dvr device\n"
 		"      null		Do not output anything\n"
 		"      stdout		Output to stdout\n"
 		"      file <filename>	Output stream to file\n"
+		"      timeshift <filename> <MB>	Record into a <MB> megabyte ring file, with an\n"
+		"				index (<filename>.idx) of times and keyframes for seeking\n"
+		"      segment <prefix> <secs>	Record into <prefix>-NNNNNN.ts segments of about\n"
+		"				<secs> seconds, cut at keyframes, each with an index\n"
+		"				of its keyframes; <prefix>.segments lists them\n"
 		"      udp <address> <port>			Output stream to address:port using udp\n"
 		"      udpif <address> <port> <interface> 	Output stream to address:port using udp\n"
 		"							forcing the specified interface\n"
 		"      rtp <address> <port>			Output stream to address:port using udp-rtp\n"
 		"      rtpif <address> <port> <interface> 	Output stream to address:port using udp-rtp\n"
 		"							forcing the specified interface\n"
+		"      http <address> <port>			Serve the stream over HTTP on address:port\n"
+		"							(0.0.0.0 for all) to any number of clients\n"
+		" -service <channel name> udp|rtp <address> <port>\n"
+		"      or -service <channel name> file <filename>\n"
+		"			Stream a service of the channel's multiplex; may be\n"
+		"				repeated (up to 32 times) to stream several services\n"
+		"				from one tuner, each to its own destination\n"
+		" -tee <output>		Instead of -out, send the channel to several outputs at\n"
+		"				once (repeated, up to 8 times); <output> is one of\n"
+		"				stdout, file, udp, udpif, rtp, rtpif or http, with the\n"
+		"				arguments of -out. Each output reads the -ring (16MB\n"
+		"				by default) in a thread of its own; a file output\n"
+		"				holds the ring back if it stalls, the others skip\n"
+		"				ahead if they get half the ring behind\n"
+		" -tts			Write file/stdout output as 192 byte packets, each after\n"
+		"				a 4 byte 27 MHz arrival timestamp (M2TS/TTS style)\n"
+		" -rotate <secs>|<MB>M	Split file output without a gap into files cut at every\n"
+		"				multiple of <secs> seconds of local time, or of at\n"
+		"				most <MB> megabytes. The file name goes through\n"
+		"				strftime() with each file's start time; without a\n"
+		"				conversion, or cut on size, .NNNNNN is appended\n"
+		" -rotatekey		With -rotate, cut before a video keyframe\n"
+		" -nonull		Remove null packets from udp/rtp output; with rtp, a\n"
+		"				header extension (0x444e) holds, for each TS packet,\n"
+		"				the number removed before it\n"
+		" -mtu <bytes>|auto	Fill udp/rtp datagrams up to <bytes>, or to the MTU of\n"
+		"				the route, rather than with 7 TS packets\n"
+		" -fec <L>x<D>		Send SMPTE 2022-1 column FEC of rtp output, over\n"
+		"				matrices of L columns (1-20) by D rows (4-20), to the\n"
+		"				port + 2\n"
+		" -fecrow		With -fec, send row FEC as well, to the port + 4\n"
+		" -standby <adapter>[:<frontend>]\n"
+		"			Lock a second tuner (ideally on another dish) on the\n"
+		"				same multiplex, and switch to its stream at once,\n"
+		"				without a gap, when the first one's has transport or\n"
+		"				continuity errors, turns scrambled, stops or loses\n"
+		"				lock; not with decoder or dvr output, or -tts\n"
+		" -monitor <percent>	With file, stdout, timeshift, segment, udp, rtp or http\n"
+		"				output, watch for the CAM to stop descrambling (a\n"
+		"				stream PID with <percent>% of its packets scrambled\n"
+		"				over a second), then resend the CA PMT, and if that\n"
+		"				doesn't help, reset the CAM\n"
+		" -pace <ms>		Pace udp/rtp output to the stream's PCRs, buffering\n"
+		"				<ms> milliseconds to absorb jitter\n"
+		" -txtime		With -pace, let the kernel (fq qdisc) space the\n"
+		"				datagrams using SO_TXTIME\n"
+		" -xdp <if>[:<q>[-<q>]]	Send udp/rtp output to IPv4 multicast groups through\n"
+		"				AF_XDP sockets on interface <if>, on NIC TX queue\n"
+		"				<q> (default 0) or spread over a range of them\n"
+		" -pidmap <list>	With file, stdout, timeshift, segment, udp, rtp or http output, drop or\n"
+		"				renumber PIDs, as IN:OUT pairs (OUT a PID or \"drop\")\n"
+		"				separated by commas; the PAT/PMT are rewritten to match\n"
+		" -cbr <bits/s>	Pad the output with null packets to a constant rate,\n"
+		"				restamping the PCRs\n"
+		" -vbr		Remove null packets from the output\n"
 		" -timeout <secs>	Number of seconds to output channel for\n"
 		"				(0=>exit immediately after successful tuning, default is to output forever)\n"
 		" -cammenu		Show the CAM menu\n"
 		" -nomoveca		Do not attempt to move CA descriptors from stream to programme level\n"
+		" -cw <fifo>		Descramble with the CA device's descramblers, reading control\n"
+		"				words from <fifo> (created if need be) as lines of\n"
+		"				<ECM PID> even|odd <16 hex digits>\n"
+		" -daemon <socket>	Run as a recording server, taking jobs on the unix socket\n"
+		"				<socket> instead of tuning to a channel (no CA support)\n"
+		" -adapters <ids>	With -daemon, the adapters to use (e.g. 0,1,2,3; default\n"
+		"				the -adapter one)\n"
+		" -threads <n>		With -daemon, the number of DVR reader threads\n"
+		"				(default one per adapter, up to the number of CPUs)\n"
+		" -prefetch		With -daemon, keep tuners without jobs on the multiplexes\n"
+		"				of the channels likely to be started next\n"
+		" -satip [<host>:]<port>	Run as a SAT>IP server, tuning the host's tuners for RTSP\n"
+		"				clients on <port> (usually 554) and sending them RTP;\n"
+		"				-adapter/-frontend narrow the choice of tuner, and\n"
+		"				-secid names the LNB (no CA support)\n"
+		" -pool <prio>		Lease any suitable tuner of the host instead of using\n"
+		"				-adapter/-frontend (which then only narrow the choice),\n"
+		"				sharing one already on the multiplex, or taking one\n"
+		"				from lower <prio> jobs if all are busy\n"
 		" <channel name>\n";
 	fprintf(stderr, "%s\n", _usage);
 
 	exit(1);
 }
 
-int find_channel(struct dvbcfg_zapchannel *channel, void *private_data)
+static void lookup_channel(char *chanfile, char *chanstore, char *channel_name,
+			   struct dvbcfg_zapchannel *channel)
 {
-	struct dvbcfg_zapchannel *tmpchannel = private_data;
+	struct dvbcfg_zapindex *index;
 
-	if (strcmp(channel->name, tmpchannel->name) == 0) {
-		memcpy(tmpchannel, channel, sizeof(struct dvbcfg_zapchannel));
-		return 1;
+	if (strlen(channel_name) >= sizeof(channel->name)) {
+		fprintf(stderr, "Channel name is too long %s\n", channel_name);
+		exit(1);
+	}
+	if (chanstore != NULL) {
+		if ((index = dvbcfg_zapindex_attach(chanstore)) == NULL) {
+			fprintf(stderr, "Could not attach to channel store %s\n", chanstore);
+			exit(1);
+		}
+	} else if ((index = dvbcfg_zapindex_open(chanfile, NULL)) == NULL) {
+		fprintf(stderr, "Could open channel file %s\n", chanfile);
+		exit(1);
 	}
+	if (dvbcfg_zapindex_find_name(index, channel_name, channel)) {
+		fprintf(stderr, "Unable to find requested channel %s\n", channel_name);
+		exit(1);
+	}
+	dvbcfg_zapindex_close(index);
+}
+
+static struct addrinfo *resolve(char *host, char *port)
+{
+	struct addrinfo *addrs = NULL;
+	struct addrinfo hints;
+	int res;
 
-	return 0;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if ((res = getaddrinfo(host, port, &hints, &addrs)) != 0) {
+		fprintf(stderr, "Unable to resolve requested address: %s\n", gai_strerror(res));
+		exit(1);
+	}
+
+	return addrs;
+}
+
+/**
+ * Set up the -service outputs. Every service has to come from the multiplex
+ * of the first one, which is the one tuned to.
+ */
+static void setup_services(char *chanfile, char *chanstore, struct service_arg *services, int count,
+			   struct gnutv_dvb_params *params)
+{
+	struct dvbcfg_zapchannel channel;
+	int i;
+
+	params->service_count = count;
+	for(i=0; i < count; i++) {
+		lookup_channel(chanfile, chanstore, services[i].channel_name, &channel);
+		if ((channel.fe_type != params->channel.fe_type) ||
+		    (channel.fe_params.frequency != params->channel.fe_params.frequency) ||
+		    (channel.polarization != params->channel.polarization)) {
+			fprintf(stderr, "Channel %s is not on the same multiplex as %s\n",
+				services[i].channel_name, services[0].channel_name);
+			exit(1);
+		}
+		params->service_ids[i] = channel.service_id;
+
+		if (gnutv_data_add_service(channel.service_id, services[i].output_type,
+					   services[i].outfile, NULL,
+					   services[i].outhost ? resolve(services[i].outhost, services[i].outport) : NULL,
+					   services[i].usertp))
+			exit(1);
+	}
 }
 
 int main(int argc, char *argv[])
@@ -108,17 +303,21 @@ int main(int argc, char *argv[])
 	int demux_id = 0;
 	int caslot_num = 0;
 	char *chanfile = "/etc/channels.conf";
+	char *chanstore = NULL;
 	char *secfile = NULL;
 	char *secid = NULL;
 	char *channel_name = NULL;
 	int output_type = OUTPUT_TYPE_DECODER;
 	char *outfile = NULL;
+	int timeshift_mb = 0;
+	int segment_secs = 0;
 	char *outhost = NULL;
 	char *outport = NULL;
 	char *outif = NULL;
 	struct addrinfo *outaddrs = NULL;
 	int timeout = -1;
 	int moveca = 1;
+	char *cw_path = NULL;
 	int cammenu = 0;
 	int argpos = 1;
 	struct gnutv_dvb_params gnutv_dvb_params;
@@ -126,6 +325,61 @@ int main(int argc, char *argv[])
 	int ffaudiofd = -1;
 	int usertp = 0;
 	int buffer_size = 0;
+	int pace_ms = -1;
+	int usetxtime = 0;
+	char *xdp_if = NULL;
+	int xdp_first = 0;
+	int xdp_last = 0;
+	struct gnutv_xdp *xdp = NULL;
+	int ring_size = 0;
+	int ring_drop = 0;
+	int ring_hugepages = 0;
+	int stats_interval = 0;
+	int extent_mb = 4;
+	struct gnutv_store *store = NULL;
+	int show_latency = 0;
+	char *pidmap = NULL;
+	unsigned long long cbr_rate = 0;
+	int vbr = 0;
+	int nonull = 0;
+	int tts = 0;
+	int rotate_secs = 0;
+	int rotate_mb = 0;
+	int rotate_key = 0;
+	int mtu = 0;
+	int fec_columns = 0;
+	int fec_rows = 0;
+	int fec_row = 0;
+	int monitor_percent = 0;
+	struct gnutv_monitor *monitor = NULL;
+	int shed_streams = 0;
+	struct gnutv_shed *shed = NULL;
+	int standby_adapter = -1;
+	int standby_frontend = 0;
+	struct gnutv_standby *standby = NULL;
+	struct gnutv_remux *remux = NULL;
+	struct gnutv_http *http = NULL;
+	struct service_arg services[GNUTV_MAX_SERVICES];
+	int service_count = 0;
+	struct tee_arg tees[GNUTV_TEE_MAX_SINKS];
+	int tee_count = 0;
+	struct gnutv_tee *tee = NULL;
+	int out_set = 0;
+	int i;
+	struct gnutv_server_params server_params;
+	struct gnutv_affinity_params affinity_params;
+	int numa = 0;
+	char *cpus = NULL;
+	int fifo_priority = 0;
+	char *daemon_socket = NULL;
+	char *satip_addr = NULL;
+	char *adapter_list = NULL;
+	int threads = 0;
+	int prefetch = 0;
+	int pool_priority = -1;
+	int adapter_set = 0;
+	int frontend_set = 0;
+	struct dvbtuner_lease *lease = NULL;
 
 	while(argpos != argc) {
 		if (!strcmp(argv[argpos], "-h")) {
@@ -135,17 +389,21 @@ int main(int argc, char *argv[])
 				usage();
 			if (sscanf(argv[argpos+1], "%i", &adapter_id) != 1)
 				usage();
+			adapter_set = 1;
 			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-frontend")) {
 			if ((argc - argpos) < 2)
 				usage();
 			if (sscanf(argv[argpos+1], "%i", &frontend_id) != 1)
 				usage();
+			frontend_set = 1;
 			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-demux")) {
 			if ((argc - argpos) < 2)
 				usage();
-			if (sscanf(argv[argpos+1], "%i", &demux_id) != 1)
+			if (!strcmp(argv[argpos+1], "auto"))
+				demux_id = -1;
+			else if (sscanf(argv[argpos+1], "%i", &demux_id) != 1)
 				usage();
 			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-caslotnum")) {
@@ -159,6 +417,17 @@ int main(int argc, char *argv[])
 				usage();
 			chanfile = argv[argpos+1];
 			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-chanstore")) {
+			if ((argc - argpos) < 2)
+				usage();
+			chanstore = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-pool")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &pool_priority) != 1) || (pool_priority < 0))
+				usage();
+			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-secfile")) {
 			if ((argc - argpos) < 2)
 				usage();
@@ -177,9 +446,42 @@ int main(int argc, char *argv[])
 			if (buffer_size < 0)
 				usage();
 			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-ring")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &ring_size) != 1)
+				usage();
+			if (ring_size < 0)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-ringdrop")) {
+			ring_drop = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-hugepages")) {
+			ring_hugepages = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-shed")) {
+			shed_streams = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-extent")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &extent_mb) != 1) || (extent_mb < 0) ||
+			    (extent_mb > 256))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-stats")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &stats_interval) != 1)
+				usage();
+			if (stats_interval < 0)
+				usage();
+			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-out")) {
 			if ((argc - argpos) < 2)
 				usage();
+			out_set = 1;
 			if (!strcmp(argv[argpos+1], "decoder")) {
 				output_type = OUTPUT_TYPE_DECODER;
 			} else if (!strcmp(argv[argpos+1], "decoderabypass")) {
@@ -196,6 +498,22 @@ int main(int argc, char *argv[])
 					usage();
 				outfile = argv[argpos+2];
 				argpos++;
+			} else if (!strcmp(argv[argpos+1], "timeshift")) {
+				output_type = OUTPUT_TYPE_TIMESHIFT;
+				if ((argc - argpos) < 4)
+					usage();
+				outfile = argv[argpos+2];
+				if ((sscanf(argv[argpos+3], "%i", &timeshift_mb) != 1) || (timeshift_mb <= 0))
+					usage();
+				argpos+=2;
+			} else if (!strcmp(argv[argpos+1], "segment")) {
+				output_type = OUTPUT_TYPE_SEGMENT;
+				if ((argc - argpos) < 4)
+					usage();
+				outfile = argv[argpos+2];
+				if ((sscanf(argv[argpos+3], "%i", &segment_secs) != 1) || (segment_secs <= 0))
+					usage();
+				argpos+=2;
 			} else if ((!strcmp(argv[argpos+1], "udp")) ||
 				   (!strcmp(argv[argpos+1], "rtp"))) {
 				output_type = OUTPUT_TYPE_UDP;
@@ -219,10 +537,187 @@ int main(int argc, char *argv[])
 				outport = argv[argpos+3];
 				outif = argv[argpos+4];
 				argpos+=3;
+			} else if (!strcmp(argv[argpos+1], "http")) {
+				output_type = OUTPUT_TYPE_HTTP;
+				if ((argc - argpos) < 4)
+					usage();
+				outhost = argv[argpos+2];
+				outport = argv[argpos+3];
+				argpos+=2;
 			} else {
 				usage();
 			}
 			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-service")) {
+			if ((argc - argpos) < 4)
+				usage();
+			if (service_count == GNUTV_MAX_SERVICES)
+				usage();
+			memset(&services[service_count], 0, sizeof(struct service_arg));
+			services[service_count].channel_name = argv[argpos+1];
+			if (!strcmp(argv[argpos+2], "file")) {
+				services[service_count].output_type = OUTPUT_TYPE_FILE;
+				services[service_count].outfile = argv[argpos+3];
+				argpos+=4;
+			} else if ((!strcmp(argv[argpos+2], "udp")) ||
+				   (!strcmp(argv[argpos+2], "rtp"))) {
+				if ((argc - argpos) < 5)
+					usage();
+				services[service_count].output_type = OUTPUT_TYPE_UDP;
+				services[service_count].usertp = !strcmp(argv[argpos+2], "rtp");
+				services[service_count].outhost = argv[argpos+3];
+				services[service_count].outport = argv[argpos+4];
+				argpos+=5;
+			} else {
+				usage();
+			}
+			service_count++;
+		} else if (!strcmp(argv[argpos], "-tee")) {
+			struct tee_arg *t = &tees[tee_count];
+			int args;
+
+			if (((argc - argpos) < 2) || (tee_count == GNUTV_TEE_MAX_SINKS))
+				usage();
+			memset(t, 0, sizeof(struct tee_arg));
+			if (!strcmp(argv[argpos+1], "stdout")) {
+				t->output_type = OUTPUT_TYPE_STDOUT;
+				args = 0;
+			} else if (!strcmp(argv[argpos+1], "file")) {
+				t->output_type = OUTPUT_TYPE_FILE;
+				args = 1;
+			} else if (!strcmp(argv[argpos+1], "udp") || !strcmp(argv[argpos+1], "rtp") ||
+				   !strcmp(argv[argpos+1], "http")) {
+				t->output_type = strcmp(argv[argpos+1], "http") ? OUTPUT_TYPE_UDP : OUTPUT_TYPE_HTTP;
+				args = 2;
+			} else if (!strcmp(argv[argpos+1], "udpif") || !strcmp(argv[argpos+1], "rtpif")) {
+				t->output_type = OUTPUT_TYPE_UDP;
+				args = 3;
+			} else {
+				usage();
+			}
+			if ((argc - argpos) < 2 + args)
+				usage();
+			t->usertp = !strncmp(argv[argpos+1], "rtp", 3);
+			if (args == 1)
+				t->outfile = argv[argpos+2];
+			if (args >= 2) {
+				t->outhost = argv[argpos+2];
+				t->outport = argv[argpos+3];
+			}
+			if (args == 3)
+				t->outif = argv[argpos+4];
+			tee_count++;
+			argpos += 2 + args;
+		} else if (!strcmp(argv[argpos], "-pace")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &pace_ms) != 1)
+				usage();
+			if (pace_ms < 0)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-nonull")) {
+			nonull = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-tts")) {
+			tts = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-rotate")) {
+			char unit = 0;
+
+			if ((argc - argpos) < 2)
+				usage();
+			switch(sscanf(argv[argpos+1], "%i%c", &rotate_secs, &unit)) {
+			case 1:
+				break;
+			case 2:
+				if ((unit != 'M') && (unit != 'm'))
+					usage();
+				rotate_mb = rotate_secs;
+				rotate_secs = 0;
+				break;
+			default:
+				usage();
+			}
+			if ((rotate_secs < 0) || (rotate_mb < 0) || (!rotate_secs && !rotate_mb))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-rotatekey")) {
+			rotate_key = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-fec")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%ix%i", &fec_columns, &fec_rows) != 2) ||
+			    (fec_columns < 1) || (fec_columns > GNUTV_FEC_MAX_L) ||
+			    (fec_rows < GNUTV_FEC_MIN_D) || (fec_rows > GNUTV_FEC_MAX_D) ||
+			    (fec_columns * fec_rows > GNUTV_FEC_MAX_MATRIX))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-fecrow")) {
+			fec_row = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-standby")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i:%i", &standby_adapter, &standby_frontend) < 1) ||
+			    (standby_adapter < 0))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-monitor")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%i", &monitor_percent) != 1) ||
+			    (monitor_percent < 1) || (monitor_percent > 100))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-mtu")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (!strcmp(argv[argpos+1], "auto"))
+				mtu = -1;
+			else if ((sscanf(argv[argpos+1], "%i", &mtu) != 1) || (mtu < 256) || (mtu > 65535))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-txtime")) {
+			usetxtime = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-xdp")) {
+			char *colon;
+
+			if ((argc - argpos) < 2)
+				usage();
+			xdp_if = argv[argpos+1];
+			if ((colon = strchr(xdp_if, ':')) != NULL) {
+				*colon = 0;
+				switch (sscanf(colon + 1, "%i-%i", &xdp_first, &xdp_last)) {
+				case 1:
+					xdp_last = xdp_first;
+					break;
+				case 2:
+					break;
+				default:
+					usage();
+				}
+				if ((xdp_first < 0) || (xdp_last < xdp_first) ||
+				    ((xdp_last - xdp_first) >= GNUTV_XDP_MAX_QUEUES))
+					usage();
+			}
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-pidmap")) {
+			if ((argc - argpos) < 2)
+				usage();
+			pidmap = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-cbr")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if ((sscanf(argv[argpos+1], "%llu", &cbr_rate) != 1) || (cbr_rate == 0))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-vbr")) {
+			vbr = 1;
+			argpos++;
 		} else if (!strcmp(argv[argpos], "-timeout")) {
 			if ((argc - argpos) < 2)
 				usage();
@@ -232,9 +727,59 @@ int main(int argc, char *argv[])
 		} else if (!strcmp(argv[argpos], "-nomoveca")) {
 			moveca = 0;
 			argpos++;
+		} else if (!strcmp(argv[argpos], "-latency")) {
+			show_latency = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-numa")) {
+			numa = 1;
+			argpos++;
+		} else if (!strcmp(argv[argpos], "-cpus")) {
+			if ((argc - argpos) < 2)
+				usage();
+			cpus = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-fifo")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &fifo_priority) != 1)
+				usage();
+			if ((fifo_priority < 1) || (fifo_priority > 99))
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-daemon")) {
+			if ((argc - argpos) < 2)
+				usage();
+			daemon_socket = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-satip")) {
+			if ((argc - argpos) < 2)
+				usage();
+			satip_addr = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-adapters")) {
+			if ((argc - argpos) < 2)
+				usage();
+			adapter_list = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-threads")) {
+			if ((argc - argpos) < 2)
+				usage();
+			if (sscanf(argv[argpos+1], "%i", &threads) != 1)
+				usage();
+			if (threads < 0)
+				usage();
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-prefetch")) {
+			prefetch = 1;
+			argpos++;
 		} else if (!strcmp(argv[argpos], "-cammenu")) {
 			cammenu = 1;
 			argpos++;
+		} else if (!strcmp(argv[argpos], "-cw")) {
+			if ((argc - argpos) < 2)
+				usage();
+			cw_path = argv[argpos+1];
+			argpos+=2;
 		} else {
 			if ((argc - argpos) != 1)
 				usage();
@@ -243,52 +788,225 @@ int main(int argc, char *argv[])
 		}
 	}
 
+	// -xdp: SO_TXTIME pacing needs the kernel's qdisc
+	if (xdp_if != NULL) {
+		if (usetxtime)
+			usage();
+		if ((xdp = gnutv_xdp_open(xdp_if, xdp_first, xdp_last - xdp_first + 1)) == NULL)
+			exit(1);
+		gnutv_data_set_xdp(xdp);
+	}
+
+	// SAT>IP mode tunes to whatever its clients ask for
+	if (satip_addr != NULL) {
+		struct gnutv_satip_params satip_params;
+		char *colon = strrchr(satip_addr, ':');
+
+		if ((channel_name != NULL) || service_count || tee_count || cammenu ||
+		    (daemon_socket != NULL) || (standby_adapter != -1))
+			usage();
+
+		memset(&satip_params, 0, sizeof(satip_params));
+		satip_params.port = satip_addr;
+		if (colon != NULL) {
+			*colon = 0;
+			satip_params.host = satip_addr;
+			satip_params.port = colon + 1;
+			if ((satip_addr[0] == '[') && (colon[-1] == ']')) {
+				colon[-1] = 0;
+				satip_params.host++;
+			}
+		}
+		satip_params.secfile = secfile;
+		satip_params.secid = secid;
+		satip_params.adapter = adapter_set ? adapter_id : -1;
+		satip_params.frontend = frontend_set ? frontend_id : -1;
+		satip_params.buffer_size = buffer_size;
+		satip_params.priority = pool_priority;
+		exit(gnutv_satip_run(&satip_params));
+	}
+
+	// daemon mode takes its channels from the control socket
+	if (daemon_socket != NULL) {
+		if ((channel_name != NULL) || service_count || tee_count || cammenu ||
+		    (standby_adapter != -1))
+			usage();
+
+		memset(&server_params, 0, sizeof(server_params));
+		server_params.socket_path = daemon_socket;
+		server_params.chanfile = chanfile;
+		server_params.chanstore = chanstore;
+		server_params.secfile = secfile;
+		server_params.secid = secid;
+		server_params.frontend_id = frontend_id;
+		server_params.demux_id = demux_id;
+		server_params.buffer_size = buffer_size;
+		server_params.threads = threads;
+		server_params.prefetch = prefetch;
+		if (adapter_list == NULL) {
+			server_params.adapters[server_params.tuner_count++] = adapter_id;
+		} else {
+			char *cur = strtok(adapter_list, ",");
+
+			while(cur != NULL) {
+				if ((server_params.tuner_count == GNUTV_SERVER_MAX_TUNERS) ||
+				    (sscanf(cur, "%i", &server_params.adapters[server_params.tuner_count]) != 1))
+					usage();
+				server_params.tuner_count++;
+				cur = strtok(NULL, ",");
+			}
+			if (server_params.tuner_count == 0)
+				usage();
+		}
+
+		if (extent_mb && ((server_params.store = gnutv_store_create(extent_mb * 1024 * 1024)) == NULL))
+			fprintf(stderr, "Failed to start the extent writer, writing recordings directly\n");
+		int result = gnutv_server_run(&server_params);
+		if (server_params.store)
+			gnutv_store_destroy(server_params.store);
+		if (xdp)
+			gnutv_xdp_close(xdp);
+		exit(result);
+	}
+
+	// a single channel is one stream: there is nothing to spread
+	if (demux_id < 0)
+		demux_id = 0;
+
+	// -service replaces -out and <channel name>; the first one is tuned to
+	if (service_count) {
+		if (channel_name != NULL)
+			usage();
+		channel_name = services[0].channel_name;
+		output_type = OUTPUT_TYPE_MULTI;
+	}
+
+	// -tee replaces -out; its outputs get the stream as it comes
+	if (tee_count) {
+		if (out_set || service_count || (pace_ms >= 0) || cammenu)
+			usage();
+		output_type = OUTPUT_TYPE_TEE;
+	}
+
 	// the user didn't select anything!
 	if ((channel_name == NULL) && (!cammenu))
 		usage();
 
-	// resolve host/port
-	if ((outhost != NULL) && (outport != NULL)) {
-		int res;
-		struct addrinfo hints;
-		memset(&hints, 0, sizeof(hints));
-		hints.ai_family = AF_UNSPEC;
-		hints.ai_socktype = SOCK_DGRAM;
-		if ((res = getaddrinfo(outhost, outport, &hints, &outaddrs)) != 0) {
-			fprintf(stderr, "Unable to resolve requested address: %s\n", gai_strerror(res));
+	if ((nonull || mtu) && (output_type != OUTPUT_TYPE_UDP))
+		usage();
+	// stamped after the -ring, the times would be those of the ring
+	if (tts && (((output_type != OUTPUT_TYPE_FILE) && (output_type != OUTPUT_TYPE_STDOUT)) ||
+		    ring_size))
+		usage();
+	if ((rotate_secs || rotate_mb) && (output_type != OUTPUT_TYPE_FILE))
+		usage();
+	// keyframes are looked for on the PIDs of the PMT, which -pidmap moves
+	if (rotate_key && (!(rotate_secs || rotate_mb) || pidmap))
+		usage();
+	if ((fec_columns || fec_row) && ((output_type != OUTPUT_TYPE_UDP) || !usertp || !fec_columns))
+		usage();
+
+	// the standby is merged in ahead of the ring, which the decoder and dvr
+	// outputs don't have
+	if ((standby_adapter != -1) &&
+	    (cammenu || tts || (output_type == OUTPUT_TYPE_DECODER) ||
+	     (output_type == OUTPUT_TYPE_DECODER_ABYPASS) || (output_type == OUTPUT_TYPE_DVR) ||
+	     (output_type == OUTPUT_TYPE_NULL)))
+		usage();
+
+	// the monitor reads the single service outputs, as the remux does
+	if (monitor_percent) {
+		if ((output_type != OUTPUT_TYPE_FILE) && (output_type != OUTPUT_TYPE_STDOUT) &&
+		    (output_type != OUTPUT_TYPE_TIMESHIFT) && (output_type != OUTPUT_TYPE_SEGMENT) &&
+		    (output_type != OUTPUT_TYPE_UDP) && (output_type != OUTPUT_TYPE_HTTP))
+			usage();
+		if ((monitor = gnutv_monitor_create(monitor_percent)) == NULL) {
+			fprintf(stderr, "Out of memory for monitor\n");
 			exit(1);
 		}
 	}
 
-	// setup any signals
-	signal(SIGINT, signal_handler);
-	signal(SIGPIPE, SIG_IGN);
-
-	// start the CA stuff
-	gnutv_ca_params.adapter_id = adapter_id;
-	gnutv_ca_params.caslot_num = caslot_num;
-	gnutv_ca_params.cammenu = cammenu;
-	gnutv_ca_params.moveca = moveca;
-	gnutv_ca_start(&gnutv_ca_params);
+	// the shedder goes by the PMT, on what goes into the ring
+	if (shed_streams) {
+		if (tts ||
+		    ((output_type != OUTPUT_TYPE_FILE) && (output_type != OUTPUT_TYPE_STDOUT) &&
+		     (output_type != OUTPUT_TYPE_TIMESHIFT) && (output_type != OUTPUT_TYPE_SEGMENT) &&
+		     (output_type != OUTPUT_TYPE_UDP) && (output_type != OUTPUT_TYPE_HTTP) &&
+		     (output_type != OUTPUT_TYPE_TEE)))
+			usage();
+		if ((shed = gnutv_shed_create()) == NULL) {
+			fprintf(stderr, "Out of memory for shedder\n");
+			exit(1);
+		}
+	}
 
-	// frontend setup if a channel name was supplied
-	if ((!cammenu) && (channel_name != NULL)) {
-		// find the requested channel
-		if (strlen(channel_name) >= sizeof(gnutv_dvb_params.channel.name)) {
-			fprintf(stderr, "Channel name is too long %s\n", channel_name);
+	// the remux works on the single service outputs
+	if (pidmap || cbr_rate || vbr) {
+		if ((cbr_rate && vbr) ||
+		    ((output_type != OUTPUT_TYPE_FILE) && (output_type != OUTPUT_TYPE_STDOUT) &&
+		     (output_type != OUTPUT_TYPE_TIMESHIFT) && (output_type != OUTPUT_TYPE_SEGMENT) &&
+		     (output_type != OUTPUT_TYPE_UDP) &&
+		     (output_type != OUTPUT_TYPE_HTTP)))
+			usage();
+		if ((remux = gnutv_remux_create(cbr_rate, vbr)) == NULL) {
+			fprintf(stderr, "Out of memory for remux\n");
 			exit(1);
 		}
-		FILE *channel_file = fopen(chanfile, "r");
-		if (channel_file == NULL) {
-			fprintf(stderr, "Could open channel file %s\n", chanfile);
+		if (pidmap && gnutv_remux_set_map(remux, pidmap)) {
+			fprintf(stderr, "Bad -pidmap %s: %s\n", pidmap,
+				(errno == EEXIST) ? "two PIDs map to one" : "expected IN:OUT,...");
 			exit(1);
 		}
-		memcpy(gnutv_dvb_params.channel.name, channel_name, strlen(channel_name) + 1);
-		if (dvbcfg_zapchannel_parse(channel_file, find_channel, &gnutv_dvb_params.channel) != 1) {
-			fprintf(stderr, "Unable to find requested channel %s\n", channel_name);
+	}
+
+	// resolve host/port; the HTTP server binds its own
+	if (output_type == OUTPUT_TYPE_HTTP) {
+		if ((http = gnutv_http_start(outhost, outport)) == NULL)
 			exit(1);
+	} else if ((outhost != NULL) && (outport != NULL)) {
+		outaddrs = resolve(outhost, outport);
+	}
+
+	// the -tee outputs; the udp ones after -xdp is set up
+	if (tee_count) {
+		if ((tee = gnutv_tee_create()) == NULL) {
+			fprintf(stderr, "Out of memory for tee\n");
+			exit(1);
+		}
+		for(i=0; i < tee_count; i++) {
+			struct gnutv_http *tee_http;
+			int result = 0;
+
+			switch(tees[i].output_type) {
+			case OUTPUT_TYPE_STDOUT:
+			case OUTPUT_TYPE_FILE:
+				result = gnutv_tee_add_file(tee, tees[i].outfile);
+				break;
+			case OUTPUT_TYPE_UDP:
+				result = gnutv_tee_add_udp(tee, resolve(tees[i].outhost, tees[i].outport),
+							   tees[i].outif, tees[i].usertp);
+				break;
+			case OUTPUT_TYPE_HTTP:
+				if ((tee_http = gnutv_http_start(tees[i].outhost, tees[i].outport)) == NULL)
+					exit(1);
+				result = gnutv_tee_add_http(tee, tee_http);
+				break;
+			}
+			if (result)
+				exit(1);
 		}
-		fclose(channel_file);
+	}
+
+	// setup any signals
+	signal(SIGINT, signal_handler);
+	signal(SIGPIPE, SIG_IGN);
+
+	// find the requested channel; the tuner to use may depend on it
+	memset(&gnutv_dvb_params, 0, sizeof(gnutv_dvb_params));
+	if ((!cammenu) && (channel_name != NULL)) {
+		lookup_channel(chanfile, chanstore, channel_name, &gnutv_dvb_params.channel);
+		gnutv_dvb_params.service_count = 1;
+		gnutv_dvb_params.service_ids[0] = gnutv_dvb_params.channel.service_id;
 
 		// default SEC with a DVBS card
 		if ((secid == NULL) && (gnutv_dvb_params.channel.fe_type == DVBFE_TYPE_DVBS))
@@ -305,13 +1023,83 @@ int main(int argc, char *argv[])
 			gnutv_dvb_params.valid_sec = 1;
 		}
 
-		// open the frontend
-		gnutv_dvb_params.fe = dvbfe_open(adapter_id, frontend_id, 0);
+		// lease a tuner for the channel's multiplex
+		if (pool_priority != -1) {
+			struct dvbtuner_request request;
+
+			memset(&request, 0, sizeof(request));
+			request.mux.type = gnutv_dvb_params.channel.fe_type;
+			request.mux.delivery_system = gnutv_dvb_params.channel.fe_params.delivery_system;
+			request.mux.frequency = gnutv_dvb_params.channel.fe_params.frequency;
+			request.mux.stream_id = gnutv_dvb_params.channel.fe_params.stream_id;
+			if (request.mux.type == DVBFE_TYPE_DVBS) {
+				request.mux.polarization = gnutv_dvb_params.channel.polarization;
+				request.mux.diseqc_switch = gnutv_dvb_params.channel.diseqc_switch;
+				snprintf(request.mux.wiring, sizeof(request.mux.wiring), "%s", secid);
+			}
+			request.priority = pool_priority;
+			request.adapter = adapter_set ? adapter_id : -1;
+			request.frontend = frontend_set ? frontend_id : -1;
+			if ((lease = dvbtuner_acquire(&request, DVBTUNER_PREEMPT)) == NULL) {
+				fprintf(stderr, "No tuner available for channel: %s\n", strerror(errno));
+				exit(1);
+			}
+			adapter_id = dvbtuner_lease_adapter(lease);
+			frontend_id = dvbtuner_lease_frontend(lease);
+			fprintf(stderr, "Leased adapter %i frontend %i%s\n", adapter_id, frontend_id,
+				dvbtuner_lease_shared(lease) ? " (shared)" : "");
+		}
+	}
+
+	// before any threads are started or buffers allocated
+	affinity_params.adapter_id = adapter_id;
+	affinity_params.demux_id = demux_id;
+	affinity_params.numa = numa;
+	affinity_params.cpus = cpus;
+	affinity_params.fifo_priority = fifo_priority;
+	gnutv_affinity_setup(&affinity_params);
+
+	// start the CA stuff
+	gnutv_ca_params.adapter_id = adapter_id;
+	gnutv_ca_params.caslot_num = caslot_num;
+	gnutv_ca_params.cammenu = cammenu;
+	gnutv_ca_params.moveca = moveca;
+	gnutv_ca_params.cw_path = cw_path;
+	gnutv_ca_start(&gnutv_ca_params);
+
+	// frontend setup if a channel name was supplied
+	if ((!cammenu) && (channel_name != NULL)) {
+		if (service_count)
+			setup_services(chanfile, chanstore, services, service_count, &gnutv_dvb_params);
+
+		// open the frontend; only to watch it if someone else tuned it
+		gnutv_dvb_params.notune = (lease != NULL) && dvbtuner_lease_shared(lease);
+		gnutv_dvb_params.fe = dvbfe_open(adapter_id, frontend_id, gnutv_dvb_params.notune);
 		if (gnutv_dvb_params.fe == NULL) {
 			fprintf(stderr, "Failed to open frontend\n");
 			exit(1);
 		}
 
+		// the standby tuner, on the same multiplex
+		if (standby_adapter != -1) {
+			struct gnutv_standby_params standby_params;
+
+			if ((standby_adapter == adapter_id) && (standby_frontend == frontend_id)) {
+				fprintf(stderr, "The standby tuner is the one in use\n");
+				exit(1);
+			}
+			memset(&standby_params, 0, sizeof(standby_params));
+			standby_params.adapter_id = standby_adapter;
+			standby_params.frontend_id = standby_frontend;
+			standby_params.demux_id = 0;
+			standby_params.buffer_size = buffer_size;
+			standby_params.channel = gnutv_dvb_params.channel;
+			standby_params.sec = gnutv_dvb_params.sec;
+			standby_params.valid_sec = gnutv_dvb_params.valid_sec;
+			if ((standby = gnutv_standby_create(&standby_params)) == NULL)
+				exit(1);
+		}
+
 		// failover decoder to dvr output if decoder not available
 		if ((output_type == OUTPUT_TYPE_DECODER) ||
 		    (output_type == OUTPUT_TYPE_DECODER_ABYPASS)) {
@@ -322,15 +1110,37 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		// start the data stuff; before the DVB thread can deliver a PAT/PMT
+		if (remux)
+			gnutv_data_set_remux(remux);
+		gnutv_data_set_udp(nonull, mtu);
+		gnutv_data_set_tts(tts);
+		gnutv_data_set_rotate(rotate_secs, (uint64_t) rotate_mb * 1024 * 1024, rotate_key);
+		gnutv_data_set_fec(fec_columns, fec_rows, fec_row);
+		if (monitor)
+			gnutv_data_set_monitor(monitor);
+		if (shed)
+			gnutv_data_set_shed(shed);
+		if (http)
+			gnutv_data_set_http(http);
+		if (tee)
+			gnutv_data_set_tee(tee);
+		if (standby)
+			gnutv_data_set_standby(standby);
+		gnutv_data_set_segment(segment_secs);
+		if (service_count && extent_mb) {
+			if ((store = gnutv_store_create(extent_mb * 1024 * 1024)) == NULL)
+				fprintf(stderr, "Failed to start the extent writer, writing recordings directly\n");
+			gnutv_data_set_store(store);
+		}
+		gnutv_data_start(output_type, ffaudiofd, adapter_id, demux_id, buffer_size, outfile, outif, outaddrs, usertp, pace_ms, usetxtime, ring_size, ring_drop, ring_hugepages, stats_interval, timeshift_mb);
+
 		// start the DVB stuff
 		gnutv_dvb_params.adapter_id = adapter_id;
 		gnutv_dvb_params.frontend_id = frontend_id;
 		gnutv_dvb_params.demux_id = demux_id;
 		gnutv_dvb_params.output_type = output_type;
 		gnutv_dvb_start(&gnutv_dvb_params);
-
-		// start the data stuff
-		gnutv_data_start(output_type, ffaudiofd, adapter_id, demux_id, buffer_size, outfile, outif, outaddrs, usertp);
 	}
 
 	// the UI
@@ -345,6 +1155,12 @@ int main(int argc, char *argv[])
 				break;
 		}
 
+		// a higher priority job wants the tuner
+		if ((lease != NULL) && dvbtuner_lease_revoked(lease)) {
+			fprintf(stderr, "Tuner taken by a higher priority job\n");
+			break;
+		}
+
 		if (cammenu)
 			gnutv_ca_ui();
 		else
@@ -353,6 +1169,10 @@ int main(int argc, char *argv[])
 
 	// stop data handling
 	gnutv_data_stop();
+	if (store)
+		gnutv_store_destroy(store);
+	if (xdp)
+		gnutv_xdp_close(xdp);
 
 	// shutdown DVB stuff
 	if (channel_name != NULL)
@@ -361,6 +1181,12 @@ int main(int argc, char *argv[])
 	// shutdown CA stuff
 	gnutv_ca_stop();
 
+	if (lease != NULL)
+		dvbtuner_release(lease);
+
+	if (show_latency)
+		dvblatency_dump(stderr);
+
 	// done
 	exit(0);
 }
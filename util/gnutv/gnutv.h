@@ -33,5 +33,13 @@
 #define OUTPUT_TYPE_FILE 4
 #define OUTPUT_TYPE_UDP 5
 #define OUTPUT_TYPE_STDOUT 6
+#define OUTPUT_TYPE_MULTI 7
+#define OUTPUT_TYPE_TIMESHIFT 8
+#define OUTPUT_TYPE_HTTP 9
+#define OUTPUT_TYPE_SEGMENT 10
+#define OUTPUT_TYPE_TEE 11
+
+// services which can be streamed at once with -service
+#define GNUTV_MAX_SERVICES 32
 
 #endif
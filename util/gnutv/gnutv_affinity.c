@@ -0,0 +1,214 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "gnutv_affinity.h"
+
+#define DVB_SYSFS_DIR		"/sys/class/dvb"
+#define NODE_SYSFS_DIR		"/sys/devices/system/node"
+
+static cpu_set_t cpus;
+static int use_cpus = 0;
+static int fifo_priority = 0;
+
+/**
+ * Read a single integer from a sysfs file.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int read_sysfs_int(char *filename, int *value)
+{
+	FILE *f;
+	int result;
+
+	if ((f = fopen(filename, "r")) == NULL)
+		return -1;
+	result = fscanf(f, "%i", value);
+	fclose(f);
+
+	return (result == 1) ? 0 : -1;
+}
+
+/**
+ * Parse a CPU list as found in sysfs ("0-3,8,10-11").
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int parse_cpulist(char *list, cpu_set_t *set)
+{
+	char *end;
+	long first;
+	long last;
+
+	CPU_ZERO(set);
+	while(*list && (*list != '\n')) {
+		first = strtol(list, &end, 10);
+		if ((end == list) || (first < 0))
+			return -1;
+		last = first;
+		if (*end == '-') {
+			list = end + 1;
+			last = strtol(list, &end, 10);
+			if ((end == list) || (last < first))
+				return -1;
+		}
+		if (last >= CPU_SETSIZE)
+			return -1;
+		for(; first <= last; first++)
+			CPU_SET(first, set);
+
+		list = end;
+		if (*list == ',')
+			list++;
+		else if (*list && (*list != '\n'))
+			return -1;
+	}
+
+	return CPU_COUNT(set) ? 0 : -1;
+}
+
+int gnutv_affinity_adapter_node(int adapter_id, int demux_id)
+{
+	char path[PATH_MAX];
+	char filename[PATH_MAX + 16];
+	char *slash;
+	int node;
+
+	/*
+	 * /sys/class/dvb/dvbA.dvrD/device is the card; a PCI device has a
+	 * numa_node entry, and for a USB stick the host controller's is used.
+	 */
+	snprintf(filename, sizeof(filename), "%s/dvb%i.dvr%i/device", DVB_SYSFS_DIR, adapter_id, demux_id);
+	if (realpath(filename, path) == NULL)
+		return -1;
+
+	while(strcmp(path, "/sys/devices") && ((slash = strrchr(path, '/')) != NULL)) {
+		snprintf(filename, sizeof(filename), "%s/numa_node", path);
+		if (read_sysfs_int(filename, &node) == 0)
+			return node;
+		*slash = 0;
+	}
+
+	return -1;
+}
+
+/**
+ * Get the CPUs of a NUMA node.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int node_cpus(int node, cpu_set_t *set)
+{
+	char filename[PATH_MAX];
+	char list[1024];
+	FILE *f;
+	int result = -1;
+
+	snprintf(filename, sizeof(filename), "%s/node%i/cpulist", NODE_SYSFS_DIR, node);
+	if ((f = fopen(filename, "r")) == NULL)
+		return -1;
+	if (fgets(list, sizeof(list), f) != NULL)
+		result = parse_cpulist(list, set);
+	fclose(f);
+
+	return result;
+}
+
+void gnutv_affinity_setup(struct gnutv_affinity_params *params)
+{
+	unsigned long nodemask;
+	int node = -1;
+
+	fifo_priority = params->fifo_priority;
+
+	if (params->numa) {
+		node = gnutv_affinity_adapter_node(params->adapter_id, params->demux_id);
+		if (node < 0) {
+			fprintf(stderr, "NUMA node of adapter %i is not known\n", params->adapter_id);
+		} else if (node_cpus(node, &cpus) == 0) {
+			use_cpus = 1;
+			fprintf(stderr, "Adapter %i is on NUMA node %i\n", params->adapter_id, node);
+		} else {
+			fprintf(stderr, "Failed to read the CPUs of NUMA node %i\n", node);
+		}
+	}
+
+	if (params->cpus != NULL) {
+		if (parse_cpulist(params->cpus, &cpus)) {
+			fprintf(stderr, "Invalid CPU list %s\n", params->cpus);
+			exit(1);
+		}
+		use_cpus = 1;
+	}
+
+	/*
+	 * The buffers (DVR ring, output batches) are allocated and first
+	 * touched by the main thread, or by threads it creates, which inherit
+	 * its memory policy: preferring the node makes them node-local.
+	 */
+	if ((node >= 0) && (node < (int) (sizeof(nodemask) * 8))) {
+		nodemask = 1UL << node;
+		if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &nodemask, sizeof(nodemask) * 8))
+			fprintf(stderr, "Failed to prefer memory of NUMA node %i: %m\n", node);
+	}
+}
+
+int gnutv_affinity_thread_create(pthread_t *thread, int type,
+				 void *(*func)(void *), void *arg)
+{
+	struct sched_param sched;
+	pthread_attr_t attr;
+	int result;
+
+	pthread_attr_init(&attr);
+	if (use_cpus)
+		pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+
+	if ((type == GNUTV_THREAD_REALTIME) && (fifo_priority > 0)) {
+		memset(&sched, 0, sizeof(sched));
+		sched.sched_priority = fifo_priority;
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &sched);
+
+		if ((result = pthread_create(thread, &attr, func, arg)) != EPERM) {
+			pthread_attr_destroy(&attr);
+			return result;
+		}
+		fprintf(stderr, "Not permitted to use SCHED_FIFO, using the normal scheduler\n");
+		pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+	}
+
+	result = pthread_create(thread, &attr, func, arg);
+	pthread_attr_destroy(&attr);
+
+	return result;
+}
@@ -0,0 +1,69 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_AFFINITY_H
+#define gnutv_AFFINITY_H 1
+
+#include <pthread.h>
+
+/**
+ * Where gnutv's threads run. By default nothing is changed; with a NUMA node
+ * or a CPU list, every thread is created bound to those CPUs, and memory is
+ * preferably allocated from the node, so the DVR is read and buffered on the
+ * same node as the adapter's PCIe slot.
+ */
+struct gnutv_affinity_params {
+	int adapter_id;
+	int demux_id;
+	int numa;		// 1 => bind to the NUMA node of the adapter
+	char *cpus;		// CPU list (e.g. "0-3,8"), overriding the node's; NULL for none
+	int fifo_priority;	// > 0 => SCHED_FIFO at this priority for the DVR reader
+};
+
+/**
+ * Find the NUMA node an adapter is attached to, from the numa_node entry of
+ * its device (or the nearest parent which has one) in sysfs.
+ *
+ * @return The node, or -1 if it is not known.
+ */
+extern int gnutv_affinity_adapter_node(int adapter_id, int demux_id);
+
+/**
+ * Apply the affinity settings; call before any threads are created or
+ * buffers allocated. Problems are reported, and the defaults kept.
+ */
+extern void gnutv_affinity_setup(struct gnutv_affinity_params *params);
+
+#define GNUTV_THREAD_NORMAL 0
+#define GNUTV_THREAD_REALTIME 1	// the DVR reader: SCHED_FIFO if so configured
+
+/**
+ * pthread_create() with the configured affinity and scheduling. A realtime
+ * thread which may not be created (e.g. without CAP_SYS_NICE) is created
+ * as a normal one instead.
+ *
+ * @param type GNUTV_THREAD_NORMAL or GNUTV_THREAD_REALTIME.
+ * @return As pthread_create().
+ */
+extern int gnutv_affinity_thread_create(pthread_t *thread, int type,
+					void *(*func)(void *), void *arg);
+
+#endif
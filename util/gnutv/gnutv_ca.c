@@ -22,12 +22,20 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/poll.h>
+#include <sys/stat.h>
 #include <pthread.h>
+#include <libdvbapi/dvbca.h>
+#include <libucsi/mpeg/descriptor.h>
 #include <libdvben50221/en50221_stdcam.h>
+#include <libdvben50221/en50221_camgr.h>
 #include "gnutv.h"
 #include "gnutv_ca.h"
+#include "gnutv_affinity.h"
 
 
 
@@ -36,6 +44,8 @@
 #define MMI_STATE_ENQ 2
 #define MMI_STATE_MENU 3
 
+#define CAMTHREAD_MAX_WAIT_MS 500	// bounds how long shutdown takes to be noticed
+
 static int gnutv_ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t ca_id_count, uint16_t *ca_ids);
 static int gnutv_ai_callback(void *arg, uint8_t slot_id, uint16_t session_number,
 			     uint8_t application_type, uint16_t application_manufacturer,
@@ -56,28 +66,230 @@ static int gnutv_mmi_menu_callback(void *arg, uint8_t slot_id, uint16_t session_
 				   uint32_t item_count, struct en50221_app_mmi_text *items,
 				   uint32_t item_raw_length, uint8_t *items_raw);
 static void *camthread_func(void* arg);
+static void *cwthread_func(void* arg);
 
 static struct en50221_transport_layer *tl = NULL;
 static struct en50221_session_layer *sl = NULL;
 static struct en50221_stdcam *stdcam = NULL;
+static struct en50221_camgr *camgr = NULL;
 
 static int ca_resource_connected = 0;
+static volatile int ca_reset_requested = 0;
 static int mmi_state = MMI_STATE_CLOSED;
 static int mmi_enq_blind;
 static int mmi_enq_length;
 
 static int camthread_shutdown = 0;
 static pthread_t camthread;
-int moveca = 0;
-int seenpmt = 0;
 int cammenu = 0;
 
 char ui_line[256];
 uint32_t ui_linepos = 0;
 
+// descramblers, fed control words through a FIFO
+#define MAX_ECM_ALIASES 32
+
+struct ecm_alias {
+	uint16_t ecm_pid;		// of another CA system...
+	uint16_t primary;		// ...for the same PIDs as this one
+};
+
+static pthread_mutex_t descr_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct dvbca_descr descr;
+static int descr_fd = -1;
+static struct ecm_alias ecm_aliases[MAX_ECM_ALIASES];
+static int ecm_alias_count = 0;
+static int cw_fd = -1;
+static int cwthread_shutdown = 0;
+static pthread_t cwthread;
+
+
+static void gnutv_ca_descr_start(struct gnutv_ca_params *params)
+{
+	if ((descr_fd = dvbca_open(params->adapter_id, 0)) < 0) {
+		fprintf(stderr, "Failed to open CA device for descrambling\n");
+		return;
+	}
+	if (dvbca_descr_init(&descr, descr_fd) < 0) {
+		fprintf(stderr, "CA device has no descramblers\n");
+		goto fail;
+	}
+
+	// open read/write, so it is not at EOF whenever no writer has it open
+	if ((mkfifo(params->cw_path, 0600) < 0) && (errno != EEXIST)) {
+		fprintf(stderr, "Failed to create %s: %s\n", params->cw_path, strerror(errno));
+		goto fail;
+	}
+	if ((cw_fd = open(params->cw_path, O_RDWR | O_NONBLOCK)) < 0) {
+		fprintf(stderr, "Failed to open %s: %s\n", params->cw_path, strerror(errno));
+		goto fail;
+	}
+
+	// a late control word shows, so it gets the priority of the DVR reader
+	fprintf(stderr, "Descrambling with %i descramblers\n", descr.num);
+	gnutv_affinity_thread_create(&cwthread, GNUTV_THREAD_REALTIME, cwthread_func, NULL);
+	return;
+
+fail:
+	close(descr_fd);
+	descr_fd = -1;
+}
+
+static void gnutv_ca_descr_stop(void)
+{
+	if (descr_fd < 0)
+		return;
+
+	cwthread_shutdown = 1;
+	pthread_join(cwthread, NULL);
+	close(cw_fd);
+
+	dvbca_descr_clear(&descr);
+	close(descr_fd);
+	descr_fd = -1;
+}
+
+/**
+ * Account for a descriptor of a loop: the first CA descriptor gives the ECM
+ * PID of the loop, and those of any other CA systems are remembered as
+ * aliases of it. The descriptors are read in wire order, as the CAM code
+ * leaves them.
+ */
+static void descr_ca_descriptor(struct descriptor *cur, int *primary)
+{
+	int ecm_pid;
+
+	if ((cur->tag != dtag_mpeg_ca) || (cur->len < 4))
+		return;
+	ecm_pid = ((((uint8_t *) cur)[4] & 0x1f) << 8) | ((uint8_t *) cur)[5];
+	if (*primary < 0) {
+		*primary = ecm_pid;
+	} else if ((ecm_pid != *primary) && (ecm_alias_count < MAX_ECM_ALIASES)) {
+		ecm_aliases[ecm_alias_count].ecm_pid = ecm_pid;
+		ecm_aliases[ecm_alias_count].primary = *primary;
+		ecm_alias_count++;
+	}
+}
+
+static void gnutv_ca_descr_pmt(struct mpeg_pmt_section *pmt)
+{
+	struct dvbca_descr_pid pids[DVBCA_DESCR_MAX_PIDS];
+	struct mpeg_pmt_stream *cur_stream;
+	struct descriptor *cur_descriptor;
+	int program_ecm_pid = -1;
+	int count = 0;
+	int unassigned;
+
+	pthread_mutex_lock(&descr_lock);
+	ecm_alias_count = 0;
+	mpeg_pmt_section_descriptors_for_each(pmt, cur_descriptor)
+		descr_ca_descriptor(cur_descriptor, &program_ecm_pid);
+
+	// a stream's own CA descriptors override the programme's
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		int ecm_pid = -1;
+
+		mpeg_pmt_stream_descriptors_for_each(cur_stream, cur_descriptor)
+			descr_ca_descriptor(cur_descriptor, &ecm_pid);
+		if (count == DVBCA_DESCR_MAX_PIDS)
+			break;
+		pids[count].pid = cur_stream->pid;
+		pids[count].ecm_pid = (ecm_pid < 0) ? program_ecm_pid : ecm_pid;
+		count++;
+	}
+
+	unassigned = dvbca_descr_set_pids(&descr, pids, count);
+	pthread_mutex_unlock(&descr_lock);
+
+	if (unassigned < 0)
+		fprintf(stderr, "Failed to set descrambler PIDs\n");
+	else if (unassigned)
+		fprintf(stderr, "Not enough descramblers: %i PIDs left scrambled\n", unassigned);
+}
+
+/**
+ * Load one control word, given as "<ECM PID> even|odd <16 hex digits>".
+ */
+static void gnutv_ca_descr_cw(char *line)
+{
+	char parity[8];
+	char hex[17];
+	uint8_t cw[8];
+	int ecm_pid;
+	int index;
+	int i;
+
+	if ((sscanf(line, "%i %7s %16s", &ecm_pid, parity, hex) != 3) ||
+	    (strcmp(parity, "even") && strcmp(parity, "odd")) || (strlen(hex) != 16)) {
+		fprintf(stderr, "Bad control word line: %s\n", line);
+		return;
+	}
+	for (i = 0; i < 8; i++) {
+		unsigned int byte;
+
+		if (sscanf(hex + (i * 2), "%2x", &byte) != 1)
+			return;
+		cw[i] = byte;
+	}
+
+	pthread_mutex_lock(&descr_lock);
+	for (i = 0; i < ecm_alias_count; i++) {
+		if (ecm_aliases[i].ecm_pid == ecm_pid) {
+			ecm_pid = ecm_aliases[i].primary;
+			break;
+		}
+	}
+	index = dvbca_descr_find(&descr, ecm_pid);
+	if ((index >= 0) &&
+	    (dvbca_descr_set_key(&descr, index, strcmp(parity, "even") ? DVBCA_PARITY_ODD :
+				 DVBCA_PARITY_EVEN, cw) < 0))
+		fprintf(stderr, "Failed to set control word for ECM PID %i\n", ecm_pid);
+	pthread_mutex_unlock(&descr_lock);
+}
+
+static void *cwthread_func(void* arg)
+{
+	(void) arg;
+	char line[128];
+	int len = 0;
+	struct pollfd pollfd;
+
+	pollfd.fd = cw_fd;
+	pollfd.events = POLLIN;
+	while(!cwthread_shutdown) {
+		char *end;
+		int size;
+
+		if (poll(&pollfd, 1, CAMTHREAD_MAX_WAIT_MS) <= 0)
+			continue;
+		if ((size = read(cw_fd, line + len, sizeof(line) - 1 - len)) <= 0)
+			continue;
+		len += size;
+		line[len] = 0;
+
+		// act on each line as soon as it is complete
+		char *start = line;
+		while((end = strchr(start, '\n')) != NULL) {
+			*end = 0;
+			if (end > start)
+				gnutv_ca_descr_cw(start);
+			start = end + 1;
+		}
+		len -= start - line;
+		memmove(line, start, len);
+		if (len == (int) sizeof(line) - 1)
+			len = 0;
+	}
+
+	return NULL;
+}
+
 
 void gnutv_ca_start(struct gnutv_ca_params *params)
 {
+	if (params->cw_path != NULL)
+		gnutv_ca_descr_start(params);
+
 	// create transport layer
 	tl = en50221_tl_create(1, 16);
 	if (tl == NULL) {
@@ -101,6 +313,20 @@ void gnutv_ca_start(struct gnutv_ca_params *params)
 		return;
 	}
 
+	// the CAM is sent each program just once, and then only its changes
+	camgr = en50221_camgr_create(1, 1, params->moveca);
+	if (camgr == NULL) {
+		if (stdcam->destroy)
+			stdcam->destroy(stdcam, 1);
+		en50221_sl_destroy(sl);
+		en50221_tl_destroy(tl);
+		stdcam = NULL;
+		return;
+	}
+
+	// and the CAM is sent them the moment it is ready for them
+	en50221_stdcam_set_camgr(stdcam, camgr, 0, 0, 1);
+
 	// hook up the AI callbacks
 	if (stdcam->ai_resource) {
 		en50221_app_ai_register_callback(stdcam->ai_resource, gnutv_ai_callback, stdcam);
@@ -126,15 +352,15 @@ void gnutv_ca_start(struct gnutv_ca_params *params)
 	}
 
 	// any other stuff
-	moveca = params->moveca;
 	cammenu = params->cammenu;
 
 	// start the cam thread
-	pthread_create(&camthread, NULL, camthread_func, NULL);
+	gnutv_affinity_thread_create(&camthread, GNUTV_THREAD_NORMAL, camthread_func, NULL);
 }
 
 void gnutv_ca_stop(void)
 {
+	gnutv_ca_descr_stop();
 	if (stdcam == NULL)
 		return;
 
@@ -145,6 +371,7 @@ void gnutv_ca_stop(void)
 	// destroy the stdcam
 	if (stdcam->destroy)
 		stdcam->destroy(stdcam, 1);
+	en50221_camgr_destroy(camgr);
 
 	// destroy session layer
 	en50221_sl_destroy(sl);
@@ -212,39 +439,47 @@ void gnutv_ca_ui(void)
 
 int gnutv_ca_new_pmt(struct mpeg_pmt_section *pmt)
 {
-	uint8_t capmt[4096];
-	int size;
-
+	if (descr_fd >= 0)
+		gnutv_ca_descr_pmt(pmt);
 	if (stdcam == NULL)
+		return (descr_fd >= 0) ? 1 : -1;
+
+	if (en50221_camgr_set_pmt(camgr, pmt)) {
+		fprintf(stderr, "Failed to format PMT\n");
 		return -1;
+	}
 
-	if (ca_resource_connected) {
+	// it waits in the manager until the CAM is ready for it
+	if (ca_resource_connected)
 		fprintf(stderr, "Received new PMT - sending to CAM...\n");
+	if (en50221_camgr_flush(camgr) < 0) {
+		fprintf(stderr, "Failed to send PMT\n");
+		return -1;
+	}
 
-		// translate it into a CA PMT
-		int listmgmt = CA_LIST_MANAGEMENT_ONLY;
-		if (seenpmt) {
-			listmgmt = CA_LIST_MANAGEMENT_UPDATE;
-		}
-		seenpmt = 1;
+	// we've seen this PMT
+	return en50221_camgr_get_slot(camgr, mpeg_pmt_section_program_number(pmt)) != -1;
+}
 
-		if ((size = en50221_ca_format_pmt(pmt, capmt, sizeof(capmt), moveca, listmgmt,
-						  CA_PMT_CMD_ID_OK_DESCRAMBLING)) < 0) {
-			fprintf(stderr, "Failed to format PMT\n");
-			return -1;
-		}
+int gnutv_ca_ready(void)
+{
+	return ca_resource_connected;
+}
 
-		// set it
-		if (en50221_app_ca_pmt(stdcam->ca_resource, stdcam->ca_session_number, capmt, size)) {
-			fprintf(stderr, "Failed to send PMT\n");
-			return -1;
-		}
+void gnutv_ca_recover(int reset)
+{
+	if (stdcam == NULL)
+		return;
 
-		// we've seen this PMT
-		return 1;
+	// the manager can be flushed from any thread, but only the CA thread
+	// may touch the stdcam
+	if (!reset) {
+		en50221_camgr_resend(camgr, 0);
+		if (en50221_camgr_flush(camgr) < 0)
+			fprintf(stderr, "Failed to resend PMT\n");
+	} else if (stdcam->reset) {
+		ca_reset_requested = 1;
 	}
-
-	return 0;
 }
 
 void gnutv_ca_new_dvbtime(time_t dvb_time)
@@ -261,8 +496,27 @@ static void *camthread_func(void* arg)
 	(void) arg;
 	int entered_menu = 0;
 
+	struct pollfd pollfd;
+	int timeout;
+
 	while(!camthread_shutdown) {
-		stdcam->poll(stdcam);
+		// sleep until the CAM needs servicing
+		pollfd.fd = stdcam->get_pollfd(stdcam, &timeout);
+		pollfd.events = POLLIN | POLLPRI;
+		if ((timeout < 0) || (timeout > CAMTHREAD_MAX_WAIT_MS))
+			timeout = CAMTHREAD_MAX_WAIT_MS;
+		poll(&pollfd, 1, timeout);
+
+		// a reset asked for by the stream monitor
+		if (ca_reset_requested) {
+			ca_reset_requested = 0;
+			ca_resource_connected = 0;
+			stdcam->reset(stdcam);
+		}
+
+		// a CAM which goes away must send its ca_info again
+		if (stdcam->poll(stdcam) != EN50221_STDCAM_CAM_OK)
+			ca_resource_connected = 0;
 
 		if ((!entered_menu) && cammenu && ca_resource_connected && stdcam->mmi_resource) {
 			en50221_app_ai_entermenu(stdcam->ai_resource, stdcam->ai_session_number);
@@ -301,6 +555,8 @@ static int gnutv_ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_n
 	for(i=0; i< ca_id_count; i++) {
 		fprintf(stderr, "  0x%04x\n", ca_ids[i]);
 	}
+
+	// the stdcam has already sent it whatever PMT came before it was ready
 	ca_resource_connected = 1;
 	return 0;
 }
@@ -28,6 +28,7 @@ struct gnutv_ca_params {
 	int caslot_num;
 	int cammenu;
 	int moveca;
+	char *cw_path;		// control words FIFO for the descramblers, or NULL
 };
 
 extern void gnutv_ca_start(struct gnutv_ca_params *params);
@@ -37,4 +38,16 @@ extern void gnutv_ca_stop(void);
 extern int gnutv_ca_new_pmt(struct mpeg_pmt_section *pmt);
 extern void gnutv_ca_new_dvbtime(time_t dvb_time);
 
+/**
+ * @return Nonzero if the CAM's CA resource is up.
+ */
+extern int gnutv_ca_ready(void);
+
+/**
+ * Get a CAM which has stopped descrambling going again: send it its CA
+ * PMTs again, or (reset) reset it, in the CA thread, after which the CA
+ * PMTs are sent as soon as it is ready.
+ */
+extern void gnutv_ca_recover(int reset);
+
 #endif
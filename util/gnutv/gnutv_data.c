@@ -20,11 +20,13 @@
 	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
 */
 
+#define _GNU_SOURCE 1
 #define _FILE_OFFSET_BITS 64
 #define _LARGEFILE_SOURCE 1
 #define _LARGEFILE64_SOURCE 1
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <limits.h>
 #include <string.h>
@@ -32,60 +34,259 @@
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
+#include <linux/net_tstamp.h>
 #include <libdvbapi/dvbdemux.h>
 #include <libdvbapi/dvbaudio.h>
+#include <libdvbapi/dvbcapture.h>
+#include <libdvbapi/dvbclock.h>
 #include <libucsi/mpeg/section.h>
+#include <libucsi/section_builder.h>
+#include <libucsi/transport_packet.h>
+#include <libdvbmisc/dvbprobe.h>
 #include "gnutv.h"
 #include "gnutv_dvb.h"
 #include "gnutv_ca.h"
 #include "gnutv_data.h"
+#include "gnutv_ring.h"
+#include "gnutv_timeshift.h"
+#include "gnutv_segment.h"
+#include "gnutv_rotate.h"
+#include "gnutv_store.h"
+#include "gnutv_affinity.h"
+#include "gnutv_remux.h"
+#include "gnutv_http.h"
+#include "gnutv_monitor.h"
+#include "gnutv_shed.h"
+#include "gnutv_fec.h"
+#include "gnutv_xdp.h"
+#include "gnutv_tee.h"
+#include "gnutv_standby.h"
 
 static void *fileoutputthread_func(void* arg);
 static void *udpoutputthread_func(void* arg);
+static void *httpoutputthread_func(void* arg);
+static void *multioutputthread_func(void* arg);
+static void *drainthread_func(void* arg);
+static void gnutv_data_start_ring(void);
+static void gnutv_data_start_output(void *(*func)(void *));
+static void gnutv_data_stop_ring(void);
+static int64_t gnutv_data_now(void);
+static int gnutv_data_udp_payload(struct addrinfo *addrs, char *outif);
 
 static int gnutv_data_create_decoder_filter(int adapter, int demux, uint16_t pid, int pestype);
-static int gnutv_data_create_dvr_filter(int adapter, int demux, uint16_t pid);
 
 static void gnutv_data_decoder_pmt(struct mpeg_pmt_section *pmt);
 static void gnutv_data_dvr_pmt(struct mpeg_pmt_section *pmt);
-
-static void gnutv_data_append_pid_fd(int pid, int fd);
+static void gnutv_data_multi_pat(int transport_stream_id, int program_number, int pmt_pid);
+static void gnutv_data_multi_pmt(struct mpeg_pmt_section *pmt);
+static void gnutv_data_open_services(void);
+static void gnutv_data_multi_stop(void);
+
+static void gnutv_data_append_pid_fd(int pid, int fd, int type);
+static void gnutv_data_remove_pid_fd(int i);
+static int gnutv_data_find_pid_fd(int pid, int type);
 static void gnutv_data_free_pid_fds(void);
 
 static pthread_t outputthread;
 static int outfd = -1;
 static int dvrfd = -1;
-static int pat_fd_dvrout = -1;
-static int pmt_fd_dvrout = -1;
+static int pmt_pid_dvrout = -1;
+
+// every PID recorded, on one demux filter if the kernel can (dvrfd is then
+// that filter's FD), otherwise a DVR filter each
+static struct dvbdemux_pidset *pidset = NULL;
 static int outputthread_shutdown = 0;
 
 static int usertp = 0;
+static int pace_ms = -1;
+static int usetxtime = 0;
 static int adapter_id = -1;
 static int demux_id = -1;
 static int output_type = 0;
 static struct addrinfo *outaddrs = NULL;
 
+// OUTPUT_TYPE_TIMESHIFT recording
+static struct gnutv_timeshift *timeshift = NULL;
+
+// segmenting output
+static struct gnutv_segment *segment = NULL;
+static int segment_duration = 0;
+
+// rotating file output
+static struct gnutv_rotate *rotate = NULL;
+static int rotate_secs = 0;
+static uint64_t rotate_bytes = 0;
+static int rotate_keyframe = 0;
+
+// write combining for -service file outputs, if set
+static struct gnutv_store *store = NULL;
+
+// file/stdout output of 192 byte packets, stamped with their arrival
+static int tts = 0;
+
+// optional ring between a DVR drain thread and the output thread
+static pthread_t drainthread;
+static struct gnutv_ring *ring = NULL;
+static int ring_size = 0;
+static int ring_drop = 0;
+static int ring_hugepages = 0;
+
+// DVR fill level/throughput, printed every stats_interval seconds if set
+static struct dvbdemux_dvr_stats dvr_stats;
+static int stats_interval = 0;
+static int64_t stats_time;
+static uint64_t stats_bytes;
+static struct dvbclock *stats_clock = NULL;	// recovered PCR clock (UDP output)
+
+// single service outputs: the remux stage, and what it needs from the PAT
+static struct gnutv_remux *remux = NULL;
+static pthread_mutex_t remux_lock = PTHREAD_MUTEX_INITIALIZER;
+static int remux_tsid = 0;
+static int remux_pmt_pid = -1;
+
+// udp/rtp output: -nonull, and TS bytes per datagram (0 => 7 packets)
+static int udp_nonull = 0;
+static int udp_mtu = 0;
+static int fec_columns = 0;		// 0 => no FEC
+static int fec_rows = 0;
+static int fec_row = 0;
+static int fec_fd = -1;
+static int udp_payload = 0;
+static struct gnutv_xdp *xdp = NULL;	// -xdp: multicast goes out through AF_XDP
+
+// HTTP output
+static struct gnutv_http *http = NULL;
+
+// -tee: the sinks, each a consumer of the ring
+static struct gnutv_tee *tee_sinks = NULL;
+
+// the scrambled stream detector, run on everything read
+static struct gnutv_monitor *monitor = NULL;
+
+// -standby: a second tuner, merged with the DVR by the drain thread
+static struct gnutv_standby *standby = NULL;
+
+// -shed: the streams left out of the ring as it fills
+static struct gnutv_shed *shed = NULL;
+
 struct pid_fd {
 	int pid;
-	int fd;
+	int fd;				// -1 for a PID of the pidset
+	int type;			// decoder PES type, -1 for the pidset
 };
 static struct pid_fd *pid_fds = NULL;
 static int pid_fds_count = 0;
+static int pid_fds_size = 0;
+
+// the PMT the filters were made from: a new version only changes the
+// filters of the streams which differ, so there is no gap in the output
+static struct mpeg_pmt_section *pid_fds_pmt = NULL;
+
+static int gnutv_data_open_socket(struct addrinfo *addrs, char *outif)
+{
+	int fd;
+
+	// open output socket
+	fd = socket(addrs->ai_family, addrs->ai_socktype, addrs->ai_protocol);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open output socket\n");
+		exit(1);
+	}
+
+	// bind to local interface if requested
+	if (outif != NULL) {
+		if (setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, outif, strlen(outif)) < 0) {
+			fprintf(stderr, "Failed to bind to interface %s\n", outif);
+			exit(1);
+		}
+	}
+
+	return fd;
+}
+
+/**
+ * Add a PID to the DVR, and to the standby tuner's if there is one.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int gnutv_data_pidset_add(int pid)
+{
+	if (dvbdemux_pidset_add(pidset, pid))
+		return -1;
+	if (standby)
+		gnutv_standby_add_pid(standby, pid);
+	return 0;
+}
+
+static void gnutv_data_pidset_remove(int pid)
+{
+	dvbdemux_pidset_remove(pidset, pid);
+	if (standby)
+		gnutv_standby_remove_pid(standby, pid);
+}
+
+static void gnutv_data_open_dvr(int buffer_size)
+{
+	// the demux filter of the PID set has the packets if there is one
+	if ((dvrfd = dvbdemux_pidset_fd(pidset)) != -1)
+		goto done;
+
+	// open dvr device
+	dvrfd = dvbdemux_open_dvr(adapter_id, demux_id, 1, 0);
+	if (dvrfd < 0) {
+		fprintf(stderr, "Failed to open DVR device\n");
+		exit(1);
+	}
+
+	// optionally set dvr buffer size
+	if (buffer_size > 0) {
+		if (dvbdemux_set_buffer(dvrfd, buffer_size) != 0) {
+			fprintf(stderr, "Failed to set DVR buffer size\n");
+			exit(1);
+		}
+	}
+
+done:
+	dvbdemux_dvr_stats_init(&dvr_stats, (buffer_size > 0) ? buffer_size : DVBDEMUX_DVR_DEFAULT_BUFFER);
+	stats_time = gnutv_data_now();
+}
 
 void gnutv_data_start(int _output_type,
 		    int ffaudiofd, int _adapter_id, int _demux_id, int buffer_size,
 		    char *outfile,
-		    char* outif, struct addrinfo *_outaddrs, int _usertp)
+		    char* outif, struct addrinfo *_outaddrs, int _usertp,
+		    int _pace_ms, int _usetxtime, int _ring_size, int _ring_drop,
+		    int _ring_hugepages, int _stats_interval, int timeshift_mb)
 {
 	usertp = _usertp;
+	ring_size = _ring_size;
+	ring_drop = _ring_drop;
+	ring_hugepages = _ring_hugepages;
+	stats_interval = _stats_interval;
+	srandom(time(NULL));
+	pace_ms = _pace_ms;
+	usetxtime = _usetxtime;
 	demux_id = _demux_id;
 	adapter_id = _adapter_id;
 	output_type = _output_type;
 
+	// DVR output is read by someone else, so it needs DVR filters
+	if (output_type != OUTPUT_TYPE_DECODER &&
+	    output_type != OUTPUT_TYPE_DECODER_ABYPASS) {
+		pidset = dvbdemux_pidset_open(adapter_id, demux_id,
+					      output_type == OUTPUT_TYPE_DVR, buffer_size);
+		if (pidset == NULL) {
+			fprintf(stderr, "Out of memory when creating the PID set\n");
+			exit(1);
+		}
+	}
+
 	// setup output
 	switch(output_type) {
 	case OUTPUT_TYPE_DECODER:
@@ -96,7 +297,12 @@ void gnutv_data_start(int _output_type,
 
 	case OUTPUT_TYPE_STDOUT:
 	case OUTPUT_TYPE_FILE:
-		if (output_type == OUTPUT_TYPE_FILE) {
+		if ((output_type == OUTPUT_TYPE_FILE) && (rotate_secs || rotate_bytes)) {
+			rotate = gnutv_rotate_open(outfile, rotate_secs, rotate_bytes, rotate_keyframe,
+						   tts ? DVBDEMUX_TTS_PACKET_SIZE : TRANSPORT_PACKET_LENGTH);
+			if (rotate == NULL)
+				exit(1);
+		} else if (output_type == OUTPUT_TYPE_FILE) {
 			// open output file
 			outfd = open(outfile, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644);
 			if (outfd < 0) {
@@ -107,68 +313,78 @@ void gnutv_data_start(int _output_type,
 			outfd = STDOUT_FILENO;
 		}
 
-		// open dvr device
-		dvrfd = dvbdemux_open_dvr(adapter_id, 0, 1, 0);
-		if (dvrfd < 0) {
-			fprintf(stderr, "Failed to open DVR device\n");
-			exit(1);
-		}
+		gnutv_data_open_dvr(buffer_size);
+		gnutv_data_start_ring();
+		gnutv_data_start_output(fileoutputthread_func);
+		break;
 
-		// optionally set dvr buffer size
-		if (buffer_size > 0) {
-			if (dvbdemux_set_buffer(dvrfd, buffer_size) != 0) {
-				fprintf(stderr, "Failed to set DVR buffer size\n");
-				exit(1);
-			}
-		}
+	case OUTPUT_TYPE_TIMESHIFT:
+		if ((timeshift = gnutv_timeshift_open(outfile, timeshift_mb)) == NULL)
+			exit(1);
 
-		pthread_create(&outputthread, NULL, fileoutputthread_func, NULL);
+		gnutv_data_open_dvr(buffer_size);
+		gnutv_data_start_ring();
+		gnutv_data_start_output(fileoutputthread_func);
 		break;
 
-	case OUTPUT_TYPE_UDP:
-		outaddrs = _outaddrs;
-
-		// open output socket
-		outfd = socket(outaddrs->ai_family, outaddrs->ai_socktype, outaddrs->ai_protocol);
-		if (outfd < 0) {
-			fprintf(stderr, "Failed to open output socket\n");
+	case OUTPUT_TYPE_SEGMENT:
+		if ((segment = gnutv_segment_open(outfile, segment_duration)) == NULL)
 			exit(1);
-		}
 
-		// bind to local interface if requested
-		if (outif != NULL) {
-			if (setsockopt(outfd, SOL_SOCKET, SO_BINDTODEVICE, outif, strlen(outif)) < 0) {
-				fprintf(stderr, "Failed to bind to interface %s\n", outif);
-				exit(1);
-			}
-		}
+		gnutv_data_open_dvr(buffer_size);
+		gnutv_data_start_ring();
+		gnutv_data_start_output(fileoutputthread_func);
+		break;
 
-		// open dvr device
-		dvrfd = dvbdemux_open_dvr(adapter_id, 0, 1, 0);
-		if (dvrfd < 0) {
-			fprintf(stderr, "Failed to open DVR device\n");
-			exit(1);
+	case OUTPUT_TYPE_UDP:
+	case OUTPUT_TYPE_MULTI:
+		if (output_type == OUTPUT_TYPE_UDP) {
+			outaddrs = _outaddrs;
+			outfd = gnutv_data_open_socket(outaddrs, outif);
+			udp_payload = gnutv_data_udp_payload(outaddrs, outif);
+			if (fec_columns)
+				fec_fd = gnutv_data_open_socket(outaddrs, outif);
+		} else {
+			gnutv_data_open_services();
 		}
 
-		// optionally set dvr buffer size
-		if (buffer_size > 0) {
-			if (dvbdemux_set_buffer(dvrfd, buffer_size) != 0) {
-				fprintf(stderr, "Failed to set DVR buffer size\n");
-				exit(1);
-			}
-		}
+		gnutv_data_open_dvr(buffer_size);
+		gnutv_data_start_ring();
+		if (output_type == OUTPUT_TYPE_UDP)
+			gnutv_data_start_output(udpoutputthread_func);
+		else
+			gnutv_data_start_output(multioutputthread_func);
+		break;
+
+	case OUTPUT_TYPE_HTTP:
+		gnutv_data_open_dvr(buffer_size);
+		gnutv_data_start_ring();
+		gnutv_data_start_output(httpoutputthread_func);
+		break;
 
-		pthread_create(&outputthread, NULL, udpoutputthread_func, NULL);
+	case OUTPUT_TYPE_TEE:
+		// the sinks are the ring's consumers: there is no output thread
+		gnutv_data_open_dvr(buffer_size);
+		gnutv_data_start_ring();
+		if (gnutv_tee_start(tee_sinks, ring))
+			exit(1);
 		break;
 	}
 
-	// output PAT to DVR if requested
+	// output PAT to DVR if requested; the remux makes its own
+	if (remux)
+		return;
 	switch(output_type) {
 	case OUTPUT_TYPE_DVR:
 	case OUTPUT_TYPE_FILE:
 	case OUTPUT_TYPE_STDOUT:
+	case OUTPUT_TYPE_TIMESHIFT:
+	case OUTPUT_TYPE_SEGMENT:
 	case OUTPUT_TYPE_UDP:
-		pat_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, TRANSPORT_PAT_PID);
+	case OUTPUT_TYPE_HTTP:
+	case OUTPUT_TYPE_TEE:
+		if (gnutv_data_pidset_add(TRANSPORT_PAT_PID))
+			fprintf(stderr, "Unable to create dvr filter for PID %i\n", TRANSPORT_PAT_PID);
 	}
 }
 
@@ -177,37 +393,183 @@ void gnutv_data_stop()
 	// shutdown output thread if necessary
 	if (dvrfd != -1) {
 		outputthread_shutdown = 1;
-		pthread_join(outputthread, NULL);
+		if (tee_sinks == NULL)
+			pthread_join(outputthread, NULL);
+		gnutv_data_stop_ring();
+	}
+	if (tee_sinks) {
+		gnutv_tee_destroy(tee_sinks);
+		tee_sinks = NULL;
+	}
+	if (http) {
+		gnutv_http_stop(http);
+		http = NULL;
+	}
+	if (timeshift)
+		gnutv_timeshift_close(timeshift);
+	if (segment)
+		gnutv_segment_close(segment);
+	if (rotate) {
+		gnutv_rotate_close(rotate);
+		rotate = NULL;
+	}
+	if (monitor) {
+		gnutv_monitor_destroy(monitor);
+		monitor = NULL;
+	}
+	if (shed) {
+		gnutv_shed_destroy(shed);
+		shed = NULL;
 	}
 	gnutv_data_free_pid_fds();
-	if (pat_fd_dvrout != -1)
-		close(pat_fd_dvrout);
-	if (pmt_fd_dvrout != -1)
-		close(pmt_fd_dvrout);
+	gnutv_data_multi_stop();
+	if (pidset) {
+		dvbdemux_pidset_close(pidset);
+		pidset = NULL;
+	}
+	if (standby) {
+		gnutv_standby_destroy(standby);
+		standby = NULL;
+	}
+	pmt_pid_dvrout = -1;
 	if (outaddrs)
 		freeaddrinfo(outaddrs);
+	if (fec_fd != -1)
+		close(fec_fd);
+	if (remux) {
+		struct gnutv_remux_stats stats;
+
+		gnutv_remux_get_stats(remux, &stats);
+		fprintf(stderr, "Remux: %llu packets in, %llu out, %llu dropped, %llu nulls removed, "
+			"%llu inserted, %llu PCRs restamped (%llu late), %llu resyncs\n",
+			(unsigned long long) stats.packets_in, (unsigned long long) stats.packets_out,
+			(unsigned long long) stats.dropped, (unsigned long long) stats.nulls_removed,
+			(unsigned long long) stats.nulls_inserted, (unsigned long long) stats.pcrs,
+			(unsigned long long) stats.late, (unsigned long long) stats.resyncs);
+		gnutv_remux_destroy(remux);
+		remux = NULL;
+	}
+}
+
+void gnutv_data_set_remux(struct gnutv_remux *_remux)
+{
+	remux = _remux;
+}
+
+void gnutv_data_set_segment(int duration)
+{
+	segment_duration = duration;
+}
+
+void gnutv_data_set_rotate(int seconds, uint64_t bytes, int keyframe)
+{
+	rotate_secs = seconds;
+	rotate_bytes = bytes;
+	rotate_keyframe = keyframe;
+}
+
+void gnutv_data_set_store(struct gnutv_store *_store)
+{
+	store = _store;
+}
+
+void gnutv_data_set_tts(int _tts)
+{
+	tts = _tts;
+}
+
+void gnutv_data_set_http(struct gnutv_http *_http)
+{
+	http = _http;
+}
+
+void gnutv_data_set_udp(int nonull, int mtu)
+{
+	udp_nonull = nonull;
+	udp_mtu = mtu;
+}
+
+void gnutv_data_set_tee(struct gnutv_tee *tee)
+{
+	tee_sinks = tee;
+}
+
+void gnutv_data_set_monitor(struct gnutv_monitor *_monitor)
+{
+	monitor = _monitor;
+}
+
+void gnutv_data_set_shed(struct gnutv_shed *_shed)
+{
+	shed = _shed;
+}
+
+static void gnutv_data_standby_output(void *arg, const uint8_t *buf, int size);
+
+void gnutv_data_set_standby(struct gnutv_standby *_standby)
+{
+	standby = _standby;
+	gnutv_standby_set_output(standby, gnutv_data_standby_output, NULL);
+}
+
+void gnutv_data_set_xdp(struct gnutv_xdp *_xdp)
+{
+	xdp = _xdp;
+}
+
+void gnutv_data_set_fec(int columns, int rows, int row)
+{
+	fec_columns = columns;
+	fec_rows = rows;
+	fec_row = row;
 }
 
-void gnutv_data_new_pat(int pmt_pid)
+void gnutv_data_new_pat(int transport_stream_id, int program_number, int pmt_pid)
 {
+	// each service gets a PAT of its own
+	if (output_type == OUTPUT_TYPE_MULTI) {
+		gnutv_data_multi_pat(transport_stream_id, program_number, pmt_pid);
+		return;
+	}
+
+	if (remux) {
+		pthread_mutex_lock(&remux_lock);
+		remux_tsid = transport_stream_id;
+		remux_pmt_pid = pmt_pid;
+		pthread_mutex_unlock(&remux_lock);
+		return;
+	}
+
 	// output PMT to DVR if requested
 	switch(output_type) {
 	case OUTPUT_TYPE_DVR:
 	case OUTPUT_TYPE_FILE:
 	case OUTPUT_TYPE_STDOUT:
+	case OUTPUT_TYPE_TIMESHIFT:
+	case OUTPUT_TYPE_SEGMENT:
 	case OUTPUT_TYPE_UDP:
-		if (pmt_fd_dvrout != -1)
-			close(pmt_fd_dvrout);
-		pmt_fd_dvrout = gnutv_data_create_dvr_filter(adapter_id, demux_id, pmt_pid);
+	case OUTPUT_TYPE_HTTP:
+	case OUTPUT_TYPE_TEE:
+		// the new one first, in case they are the same
+		if (gnutv_data_pidset_add(pmt_pid)) {
+			fprintf(stderr, "Unable to create dvr filter for PID %i\n", pmt_pid);
+			pmt_pid = -1;
+		}
+		if (pmt_pid_dvrout != -1)
+			gnutv_data_pidset_remove(pmt_pid_dvrout);
+		pmt_pid_dvrout = pmt_pid;
 	}
 }
 
 int gnutv_data_new_pmt(struct mpeg_pmt_section *pmt)
 {
-	// close all old PID FDs
-	gnutv_data_free_pid_fds();
+	// the services' PIDs come and go individually
+	if (output_type == OUTPUT_TYPE_MULTI) {
+		gnutv_data_multi_pmt(pmt);
+		return 1;
+	}
 
-	// deal with the PMT appropriately
+	// deal with the PMT appropriately; the PID filters are updated in place
 	switch(output_type) {
 	case OUTPUT_TYPE_DECODER:
 	case OUTPUT_TYPE_DECODER_ABYPASS:
@@ -217,171 +579,2272 @@ int gnutv_data_new_pmt(struct mpeg_pmt_section *pmt)
 	case OUTPUT_TYPE_DVR:
 	case OUTPUT_TYPE_FILE:
 	case OUTPUT_TYPE_STDOUT:
+	case OUTPUT_TYPE_TIMESHIFT:
+	case OUTPUT_TYPE_SEGMENT:
 	case OUTPUT_TYPE_UDP:
+	case OUTPUT_TYPE_HTTP:
+	case OUTPUT_TYPE_TEE:
 		gnutv_data_dvr_pmt(pmt);
+		if (timeshift)
+			gnutv_timeshift_set_pmt(timeshift, pmt);
+		if (rotate)
+			gnutv_rotate_set_pmt(rotate, pmt);
+		if (monitor)
+			gnutv_monitor_set_pmt(monitor, pmt);
+		if (shed)
+			gnutv_shed_set_pmt(shed, pmt);
+		if (remux) {
+			pthread_mutex_lock(&remux_lock);
+			if (gnutv_remux_set_pmt(remux, remux_tsid, remux_pmt_pid, pmt))
+				fprintf(stderr, "PMT too large to remux\n");
+			pthread_mutex_unlock(&remux_lock);
+		}
 		break;
 	}
 
 	return 1;
 }
 
-static void *fileoutputthread_func(void* arg)
+// bytes moved per splice() call, and the pipe size requested for it
+#define SPLICE_CHUNK (188*1024)
+
+// file output batches DVR reads into writes of this size; a multiple of
+// the alignment O_DIRECT needs
+#define WRITE_BATCH_SIZE (1024*1024)
+#define WRITE_BATCH_ALIGN 4096
+
+// and rotated file output into writes of at least this size
+#define ROTATE_BATCH_SIZE (TRANSPORT_PACKET_LENGTH * 348)
+
+// with the remux, reads fill no more than this fraction of the buffers, so
+// there is room for CBR stuffing and PSI to expand the data into
+#define REMUX_EXPANSION 4
+
+// io_uring output: DVR read size, and how many may wait to be written
+#define CAPTURE_BUFFER_SIZE (188*1024)
+#define CAPTURE_BUFFERS 16
+
+/**
+ * Wait up to a second for fd to become readable.
+ *
+ * @return 1 if it is readable, 0 to try again, -1 on failure.
+ */
+static int gnutv_data_wait(int fd)
 {
-	(void)arg;
-	uint8_t buf[4096];
 	struct pollfd pollfd;
-	int written;
 
-	pollfd.fd = dvrfd;
+	pollfd.fd = fd;
 	pollfd.events = POLLIN|POLLPRI|POLLERR;
 
-	while(!outputthread_shutdown) {
-		if (poll(&pollfd, 1, 1000) == -1) {
+	if (poll(&pollfd, 1, 1000) == -1) {
+		if (errno == EINTR)
+			return 0;
+		fprintf(stderr, "DVR device poll failure\n");
+		return -1;
+	}
+
+	return pollfd.revents ? 1 : 0;
+}
+
+/**
+ * Print the DVR (and ring) statistics if stats_interval has passed.
+ */
+static void gnutv_data_print_stats(void)
+{
+	struct gnutv_ring_stats stats;
+	int64_t now = gnutv_data_now();
+	double mbits;
+
+	if (now < stats_time + stats_interval * 1000000000LL)
+		return;
+
+	mbits = (double) (dvr_stats.bytes - stats_bytes) * 8000.0 / (now - stats_time);
+	fprintf(stderr, "DVR: fill %i%% (peak %i%%) of %i bytes, %llu overflows, %.2f Mbit/s",
+		dvbdemux_dvr_stats_fill(&dvr_stats, 0), dvbdemux_dvr_stats_fill(&dvr_stats, 1),
+		dvr_stats.buffer_size, (unsigned long long) dvr_stats.overflows, mbits);
+	if (ring) {
+		gnutv_ring_get_stats(ring, &stats);
+		fprintf(stderr, "; ring: fill %zu%% (peak %zu%%), %llu bytes dropped",
+			stats.fill * 100 / stats.size, stats.high_water * 100 / stats.size,
+			(unsigned long long) stats.dropped);
+	}
+	if (stats_clock && dvbclock_valid(stats_clock)) {
+		fprintf(stderr, "; PCR: drift %+.1f ppm, jitter %.2f ms, offset %+.2f ms, %u discontinuities",
+			stats_clock->drift_ppm, stats_clock->jitter_ns / 1e6,
+			stats_clock->offset_ns / 1e6, stats_clock->discontinuities);
+	}
+	fprintf(stderr, "\n");
+
+	stats_time = now;
+	stats_bytes = dvr_stats.bytes;
+}
+
+/**
+ * Account for a read()/splice() from the DVR.
+ */
+static void gnutv_data_dvr_account(int requested, int result)
+{
+	dvbdemux_dvr_stats_update(&dvr_stats, requested, result);
+	if (stats_interval)
+		gnutv_data_print_stats();
+}
+
+/**
+ * The fd the output thread waits on for data: the DVR, or the ring fed
+ * from it.
+ */
+static int gnutv_data_dvr_fd(void)
+{
+	return ring ? gnutv_ring_fd(ring, 0) : dvrfd;
+}
+
+static int gnutv_data_wait_dvr(void)
+{
+	return gnutv_data_wait(gnutv_data_dvr_fd());
+}
+
+/**
+ * read() for the output thread, from the DVR or the ring.
+ */
+static int gnutv_data_read_dvr(uint8_t *buf, int size)
+{
+	int count;
+
+	if (ring == NULL) {
+		count = read(dvrfd, buf, size);
+		gnutv_data_dvr_account(size, count);
+	} else if ((count = gnutv_ring_read(ring, 0, buf, size, 0)) < 0) {
+		// the ring is closed once shutting down; otherwise the drain failed
+		if (outputthread_shutdown)
+			return 0;
+		errno = EPIPE;
+	}
+
+	if (monitor && (count > 0)) {
+		switch(gnutv_monitor_scan(monitor, buf, count, gnutv_data_now(), gnutv_ca_ready())) {
+		case GNUTV_MONITOR_RESEND:
+			gnutv_ca_recover(0);
+			break;
+		case GNUTV_MONITOR_RESET:
+			gnutv_ca_recover(1);
+			break;
+		}
+	}
+	return count;
+}
+
+/**
+ * Write a whole buffer to fd. If an O_DIRECT write is refused, O_DIRECT
+ * is switched off and the write retried.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+int gnutv_data_write(int fd, uint8_t *buf, int size, int *direct)
+{
+	int written = 0;
+
+	DVBPROBE2(output_write, fd, size);
+	while(written < size) {
+		int tmp = write(fd, buf + written, size - written);
+		if (tmp == -1) {
 			if (errno == EINTR)
 				continue;
-			fprintf(stderr, "DVR device poll failure\n");
-			return 0;
+			if ((errno == EINVAL) && *direct) {
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+				*direct = 0;
+				continue;
+			}
+			fprintf(stderr, "Write error: %m\n");
+			return -1;
 		}
+		written += tmp;
+	}
+
+	return 0;
+}
+
+/**
+ * Zero-copy output: move the data from the DVR to outfd through a pipe with
+ * splice(), so it never passes through userspace.
+ *
+ * @return 0 when shut down, -1 on failure, 1 if splice() is not supported
+ * by the DVR or output, and the caller should copy the data instead.
+ */
+static int gnutv_data_splice_output(void)
+{
+	int pipefd[2];
+	int spliced = 0;
+	int result = 0;
+	ssize_t size;
+	ssize_t tmp;
 
-		if (pollfd.revents == 0)
+	if (pipe(pipefd))
+		return 1;
+	fcntl(pipefd[1], F_SETPIPE_SZ, SPLICE_CHUNK);
+
+	while(!outputthread_shutdown) {
+		if ((result = gnutv_data_wait_dvr()) <= 0) {
+			if (result < 0)
+				break;
 			continue;
+		}
+		result = 0;
 
-		int size = read(dvrfd, buf, sizeof(buf));
+		size = splice(dvrfd, NULL, pipefd[1], NULL, SPLICE_CHUNK, SPLICE_F_MOVE);
+		gnutv_data_dvr_account(SPLICE_CHUNK, size);
 		if (size < 0) {
 			if (errno == EINTR)
 				continue;
-
 			if (errno == EOVERFLOW) {
 				// The error flag has been cleared, next read should succeed.
 				fprintf(stderr, "DVR overflow\n");
 				continue;
 			}
-
+			if (((errno == EINVAL) || (errno == ENOSYS)) && !spliced) {
+				result = 1;
+				break;
+			}
 			fprintf(stderr, "DVR device read failure\n");
-			return 0;
+			result = -1;
+			break;
 		}
 
-		written = 0;
-		while(written < size) {
-			int tmp = write(outfd, buf + written, size - written);
+		while(size > 0) {
+			tmp = splice(pipefd[0], NULL, outfd, NULL, size, SPLICE_F_MOVE|SPLICE_F_MORE);
 			if (tmp == -1) {
-				if (errno != EINTR) {
+				if (errno == EINTR)
+					continue;
+				if ((errno == EINVAL) && !spliced) {
+					// output can't be spliced to: copy what's in the pipe
+					uint8_t buf[4096];
+					int direct = 0;
+
+					while(size > 0) {
+						tmp = read(pipefd[0], buf, sizeof(buf) < (size_t) size ? sizeof(buf) : (size_t) size);
+						if ((tmp <= 0) || gnutv_data_write(outfd, buf, tmp, &direct))
+							break;
+						size -= tmp;
+					}
+					result = 1;
+				} else {
 					fprintf(stderr, "Write error: %m\n");
-					break;
+					result = -1;
 				}
-			} else {
-				written += tmp;
+				break;
 			}
+			size -= tmp;
 		}
+		if (result)
+			break;
+		spliced = 1;
 	}
 
-	return 0;
+	close(pipefd[0]);
+	close(pipefd[1]);
+	return result;
 }
 
-#define TS_PAYLOAD_SIZE (188*7)
+static void gnutv_data_capture_read(void *arg, int requested, int result)
+{
+	(void) arg;
 
-static void *udpoutputthread_func(void* arg)
+	gnutv_data_dvr_account(requested, result);
+	if ((result < 0) && (errno == EOVERFLOW))
+		fprintf(stderr, "DVR overflow\n");
+}
+
+/**
+ * io_uring output: a DVR read is always in flight, with the writes of what
+ * was read before it queued behind it, so the thread only wakes up to pass
+ * buffers from one to the other.
+ *
+ * @return 0 when shut down, -1 on failure, 1 if io_uring is not available,
+ * and the caller should copy the data instead.
+ */
+static int gnutv_data_capture_output(void)
 {
-	(void)arg;
-	uint8_t buf[12 + TS_PAYLOAD_SIZE];
-	struct pollfd pollfd;
-	int bufsize = 0;
-	int bufbase = 0;
-	int readsize;
-	uint16_t rtpseq = 0;
+	struct dvbcapture *cap;
+	int result = 0;
+	int err;
 
-	pollfd.fd = dvrfd;
-	pollfd.events = POLLIN|POLLPRI|POLLERR;
+	if ((cap = dvbcapture_create(1, CAPTURE_BUFFERS, CAPTURE_BUFFER_SIZE)) == NULL)
+		return 1;
+	dvbcapture_add(cap, dvrfd, outfd, gnutv_data_capture_read, NULL);
+
+	while(!outputthread_shutdown) {
+		switch(dvbcapture_run(cap, 1000)) {
+		case -1:
+			fprintf(stderr, "DVR capture failure: %m\n");
+			result = -1;
+			break;
+		case 0:
+			err = dvbcapture_get_error(cap, 0);
+			fprintf(stderr, "DVR capture failure: %s\n", err ? strerror(err) : "end of stream");
+			result = -1;
+			break;
+		default:
+			continue;
+		}
+		break;
+	}
+
+	dvbcapture_destroy(cap);
+	return result;
+}
+
+/**
+ * Run the whole packets of buf read since *done through the remux, then put
+ * the partial packet after them (if any) back behind the output. *done and
+ * *fill are moved on to the end of the output and of the data.
+ *
+ * @param size Room at buf.
+ */
+static void gnutv_data_remux(uint8_t *buf, int *done, int *fill, int size)
+{
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int tail = (*fill - *done) % TRANSPORT_PACKET_LENGTH;
+	int whole = *fill - *done - tail;
+
+	memcpy(partial, buf + *done + whole, tail);
+	pthread_mutex_lock(&remux_lock);
+	*done += gnutv_remux_process(remux, buf + *done, whole, size - *done - tail, gnutv_data_now());
+	pthread_mutex_unlock(&remux_lock);
+	memcpy(buf + *done, partial, tail);
+	*fill = *done + tail;
+}
+
+/**
+ * Timestamped output: read into the staging buffer instead, and remux
+ * there if need be; then stamp the packets into buf. The time is taken
+ * straight after the read, so nothing else comes between the two.
+ *
+ * @param stage The staging buffer, of WRITE_BATCH_SIZE bytes; *stage_fill
+ * is the partial packet the remux kept back in it.
+ * @param room Bytes free at buf.
+ * @return The number of bytes read, with those put at buf in *stamped, or
+ * -1 as for read().
+ */
+static int gnutv_data_read_tts(struct dvbdemux_tts *stamper, uint8_t *stage, int *stage_fill,
+			       uint8_t *buf, int room, int *stamped)
+{
+	int packets = room / DVBDEMUX_TTS_PACKET_SIZE;
+	int done = 0;
+	int size;
+
+	// the remux may complete the packet it kept back as well
+	if (remux)
+		packets = packets / REMUX_EXPANSION - 1;
+	size = packets * TRANSPORT_PACKET_LENGTH;
+	if ((size = gnutv_data_read_dvr(stage + *stage_fill, size)) < 0)
+		return size;
+
+	*stage_fill += size;
+	if (remux)
+		gnutv_data_remux(stage, &done, stage_fill, WRITE_BATCH_SIZE);
+	else
+		done = *stage_fill;
+	*stamped = dvbdemux_tts_stamp(stamper, stage, done, buf, dvbdemux_tts_now());
+	*stage_fill -= done;
+	memmove(stage, stage + done, *stage_fill);
+	return size;
+}
 
-	if (usertp) {
-		srandom(time(NULL));
-		int ssrc = random();
-		rtpseq = random();
-		buf[0x0] = 0x80;
-		buf[0x1] = 0x21;
-		buf[0x4] = 0x00; // }
-		buf[0x5] = 0x00; // } FIXME: should really be a valid stamp
-		buf[0x6] = 0x00; // }
-		buf[0x7] = 0x00; // }
-		buf[0x8] = ssrc >> 24;
-		buf[0x9] = ssrc >> 16;
-		buf[0xa] = ssrc >> 8;
-		buf[0xb] = ssrc;
-		bufbase = 12;
+/**
+ * Copying output, used where neither splice() nor io_uring is available.
+ * Output to a file is batched into large aligned writes, using O_DIRECT if
+ * the filesystem allows it; anything else gets the data as soon as it is
+ * read.
+ */
+static void gnutv_data_copy_output(void)
+{
+	struct dvbdemux_tts stamper;
+	uint8_t *stage = NULL;
+	int stage_fill = 0;
+	uint8_t *buf;
+	int batch = 1;
+	int direct = 0;
+	int limit = WRITE_BATCH_SIZE;
+	int done = 0;
+	int fill = 0;
+	int result;
+
+	if (posix_memalign((void **) &buf, WRITE_BATCH_ALIGN, WRITE_BATCH_SIZE)) {
+		fprintf(stderr, "Out of memory for output buffer\n");
+		return;
+	}
+	if (tts && ((stage = malloc(WRITE_BATCH_SIZE)) == NULL)) {
+		fprintf(stderr, "Out of memory for output buffer\n");
+		free(buf);
+		return;
+	}
+	dvbdemux_tts_init(&stamper);
+
+	// remuxed output is not in whole blocks, so not for O_DIRECT; nor is
+	// timestamped output, which is batched up to half the buffer so
+	// there's always room for a decent read
+	if (remux && !tts)
+		limit = WRITE_BATCH_SIZE / REMUX_EXPANSION;
+	// a rotated file checks the time once per write, so those are kept small
+	// enough for the cut to fall close to it
+	if (rotate) {
+		batch = ROTATE_BATCH_SIZE;
+	} else if (output_type == OUTPUT_TYPE_FILE) {
+		batch = tts ? limit / 2 : limit;
+		if (!remux && !tts && (fcntl(outfd, F_SETFL, fcntl(outfd, F_GETFL) | O_DIRECT) == 0))
+			direct = 1;
 	}
 
 	while(!outputthread_shutdown) {
-		if (poll(&pollfd, 1, 1000) != 1)
+		if ((result = gnutv_data_wait_dvr()) <= 0) {
+			if (result < 0)
+				break;
 			continue;
-		if (pollfd.revents & POLLERR) {
-			if (errno == EINTR)
-				continue;
-			fprintf(stderr, "DVR device read failure\n");
-			return 0;
 		}
 
-		readsize = TS_PAYLOAD_SIZE - bufsize;
-		readsize = read(dvrfd, buf + bufbase + bufsize, readsize);
-		if (readsize < 0) {
+		int stamped;
+		int size;
+		if (tts)
+			size = gnutv_data_read_tts(&stamper, stage, &stage_fill,
+						   buf + fill, limit - fill, &stamped);
+		else
+			size = gnutv_data_read_dvr(buf + fill, limit - fill);
+		if (size < 0) {
 			if (errno == EINTR)
 				continue;
+
+			if (errno == EOVERFLOW) {
+				// The error flag has been cleared, next read should succeed.
+				fprintf(stderr, "DVR overflow\n");
+				continue;
+			}
+
 			fprintf(stderr, "DVR device read failure\n");
-			return 0;
+			break;
 		}
-		bufsize += readsize;
 
-		if (bufsize == TS_PAYLOAD_SIZE) {
-			if (usertp) {
-				buf[2] = rtpseq >> 8;
-				buf[3] = rtpseq;
-			}
-			if (sendto(outfd, buf, bufbase + bufsize, 0, outaddrs->ai_addr, outaddrs->ai_addrlen) < 0) {
-				if (errno != EINTR) {
-					fprintf(stderr, "Socket send failure: %m\n");
-					return 0;
-				}
-			}
-			rtpseq++;
-			bufsize = 0;
+		if (tts) {
+			fill += stamped;
+			done = fill;
+		} else {
+			fill += size;
+			if (remux)
+				gnutv_data_remux(buf, &done, &fill, WRITE_BATCH_SIZE);
+			else
+				done = fill;
+		}
+		if (timeshift || segment || (fill >= batch)) {
+			if (timeshift)
+				gnutv_timeshift_write(timeshift, buf, done);
+			else if (segment)
+				gnutv_segment_write(segment, buf, done);
+			else if (rotate)
+				gnutv_rotate_write(rotate, buf, done);
+			else
+				gnutv_data_write(outfd, buf, done, &direct);
+			fill -= done;
+			memmove(buf, buf + done, fill);
+			done = 0;
 		}
 	}
 
-	if (bufsize) {
-		if (usertp) {
-			buf[2] = rtpseq >> 8;
-			buf[3] = rtpseq;
-		}
-		if (sendto(outfd, buf, bufbase + bufsize, 0, outaddrs->ai_addr, outaddrs->ai_addrlen) < 0) {
-			if (errno != EINTR)
-				fprintf(stderr, "Socket send failure: %m\n");
+	// the tail is not a whole number of blocks
+	if (fill && rotate) {
+		gnutv_rotate_write(rotate, buf, fill);
+	} else if (fill) {
+		if (direct) {
+			fcntl(outfd, F_SETFL, fcntl(outfd, F_GETFL) & ~O_DIRECT);
+			direct = 0;
 		}
+		gnutv_data_write(outfd, buf, fill, &direct);
 	}
 
-	return 0;
+	free(stage);
+	free(buf);
 }
 
-static int gnutv_data_create_decoder_filter(int adapter, int demux, uint16_t pid, int pestype)
+static void *fileoutputthread_func(void* arg)
 {
-	int demux_fd = -1;
-
-	// open the demuxer
-	if ((demux_fd = dvbdemux_open_demux(adapter, demux, 0)) < 0) {
-		return -1;
-	}
+	(void)arg;
 
-	// create a section filter
-	if (dvbdemux_set_pes_filter(demux_fd, pid, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DECODER, pestype, 1)) {
-		close(demux_fd);
-		return -1;
-	}
+	// the data has to pass through userspace to get into the ring, or be
+	// indexed, cut, remuxed, timestamped or monitored
+	if (ring || timeshift || segment || rotate || remux || tts || monitor ||
+	    ((gnutv_data_splice_output() == 1) && (gnutv_data_capture_output() == 1)))
+		gnutv_data_copy_output();
 
-	// done
-	return demux_fd;
+	return 0;
 }
 
-static int gnutv_data_create_dvr_filter(int adapter, int demux, uint16_t pid)
+/**
+ * HTTP output: the DVR is read straight into the server's ring, which the
+ * clients are sent from.
+ */
+static void *httpoutputthread_func(void* arg)
 {
-	int demux_fd = -1;
+	uint8_t *buf;
+	size_t avail;
+	int pending = 0;
+	int done;
+	int result;
+	(void)arg;
+
+	while(!outputthread_shutdown) {
+		if ((result = gnutv_data_wait_dvr()) <= 0) {
+			if (result < 0)
+				break;
+			continue;
+		}
+
+		// the partial packet of the last read is already in place
+		buf = gnutv_http_write_ptr(http, &avail);
+		int size = gnutv_data_read_dvr(buf + pending,
+					       (remux ? avail / REMUX_EXPANSION : avail) - pending);
+		if (size < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EOVERFLOW) {
+				// The error flag has been cleared, next read should succeed.
+				fprintf(stderr, "DVR overflow\n");
+				continue;
+			}
+
+			fprintf(stderr, "DVR device read failure\n");
+			break;
+		}
+
+		pending += size;
+		if (remux) {
+			done = 0;
+			gnutv_data_remux(buf, &done, &pending, avail);
+		} else {
+			done = pending - (pending % TRANSPORT_PACKET_LENGTH);
+		}
+		if (done) {
+			gnutv_http_write_commit(http, done);
+			pending -= done;
+		}
+	}
+
+	return 0;
+}
+
+#define TS_PAYLOAD_SIZE (188*7)
+#define RTP_HEADER_SIZE 12
+
+// -mtu: the most TS packets a datagram may carry, as fit a 9000 byte
+// jumbo frame
+#define UDP_MAX_PACKETS 47
+
+// -nonull: with RTP, each datagram carries a header extension of this
+// profile holding one byte per TS packet: the number of null packets
+// removed before it. A run of more than 255 keeps every 256th.
+#define RTP_DNP_PROFILE 0x444e
+#define RTP_MAX_HEADER (RTP_HEADER_SIZE + 4 + ((UDP_MAX_PACKETS + 3) & ~3))
+
+// datagrams sent per sendmmsg()/GSO send; a single GSO send is limited
+// to 64k, which 48 RTP datagrams of 7 packets still fit into
+#define UDP_BATCH 48
+#define UDP_GSO_MAX 65000
+
+// -fec: FEC packets sent per sendmmsg(), and the ports of the column and
+// row streams, after the media's
+#define FEC_BATCH 64
+#define FEC_COLUMN_PORT 2
+#define FEC_ROW_PORT 4
+
+// datagrams of 7 packets the -pace jitter buffer can hold (~700ms at
+// 80Mbit/s); it holds the same amount of data when they are larger
+#define UDP_QUEUE_SIZE 8192
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SO_TXTIME
+#define SO_TXTIME 61
+#define SCM_TXTIME SO_TXTIME
+#endif
+
+// if the stream gets further ahead of the pacer than this, the clock jumped
+#define PACE_MAX_AHEAD 5000000000LL
+
+// the PCR counts at 27MHz and wraps at 2^33 * 300
+#define PCR_HZ 27000000LL
+#define PCR_WRAP (300LL << 33)
+
+/**
+ * Recovers the stream clock from the PCRs in the outgoing TS, so every byte
+ * offset in the output stream can be given a 27MHz time.
+ */
+struct pcr_clock {
+	int pid;			// PCR PID in use, -1 until one is seen
+	uint64_t bytes;			// stream offset of the next byte
+	int64_t last_pcr;		// -1 until a PCR is seen
+	uint64_t last_pcr_pos;		// stream offset of last_pcr's packet
+	int64_t last_pcr_wall;		// CLOCK_MONOTONIC when it was seen
+	double ticks_per_byte;		// 0 until two PCRs have been seen
+	int discontinuity;		// clock jumped since the pacer anchored
+	struct dvbclock rec;		// the PCRs against local time
+};
+
+struct udp_datagram {
+	int64_t due;			// CLOCK_MONOTONIC send time, ns
+	int len;
+	uint8_t *data;
+};
+
+struct udp_output {
+	int fd;
+	struct addrinfo *addr;
+	int hdrsize;			// RTP_HEADER_SIZE, or 0 for plain UDP
+	int payload;			// TS bytes per datagram
+	int gso;			// UDP_SEGMENT is in use
+	int gso_count;			// datagrams per GSO send
+	int pace;			// datagrams get a due time
+	int txtime;			// ... which the kernel (fq) enforces
+	uint16_t rtpseq;
+	uint32_t ssrc;
+	struct pcr_clock clk;
+
+	// pacer: stream time pcr0 is sent at wall0 (if anchored)
+	int64_t jitter_ns;
+	int anchored;
+	int64_t wall0;
+	int64_t pcr0;
+
+	// jitter buffer for timer paced output
+	struct udp_datagram *queue;
+	uint8_t *qdata;
+	int qsize;
+	int qhead;
+	int qcount;
+
+	// -nonull: the count before each packet of the data being sent, and
+	// the nulls removed since the last packet kept
+	int nonull;
+	uint8_t *dnp;
+	uint8_t dnp_counts[UDP_BATCH * UDP_MAX_PACKETS];
+	int nulls;
+	uint64_t nulls_removed;
+
+	// -fec: SMPTE 2022-1 FEC of the datagrams sent, from a socket of its own
+	struct gnutv_fec *fec;
+	int fec_fd;
+	struct sockaddr_storage fec_addr[2];
+	socklen_t fec_addrlen;
+	int fec_failed;
+	uint64_t fec_sent;
+
+	// -xdp: the datagrams are framed here and queued to the NIC directly
+	struct gnutv_xdp_flow xflow;
+	struct iovec fec_iov[FEC_BATCH];
+	struct mmsghdr fec_msgs[FEC_BATCH];
+
+	uint8_t rtphdr[UDP_BATCH][RTP_MAX_HEADER];
+	union {
+		char buf[CMSG_SPACE(sizeof(uint64_t))];
+		struct cmsghdr align;
+	} ctrl[UDP_BATCH];
+	struct iovec iov[UDP_BATCH * 2];
+	struct mmsghdr msgs[UDP_BATCH];
+};
+
+static int64_t gnutv_data_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+/**
+ * Pick up any PCRs in a chunk of the outgoing stream. The first PID seen
+ * carrying a PCR is used from then on.
+ */
+static void gnutv_data_pcr_scan(struct pcr_clock *clk, uint8_t *buf, int size, int64_t now)
+{
+	struct transport_packet *pkt;
+	struct transport_values values;
+	int64_t pcr, dpcr;
+	uint64_t pos;
+	int i;
+
+	for(i=0; i + TRANSPORT_PACKET_LENGTH <= size; i += TRANSPORT_PACKET_LENGTH) {
+		// cheap checks first: adaptation field with the PCR flag
+		if ((buf[i] != TRANSPORT_PACKET_SYNC) || !(buf[i+3] & 0x20) ||
+		    (buf[i+4] == 0) || !(buf[i+5] & transport_adaptation_flag_pcr))
+			continue;
+		if ((pkt = transport_packet_init(buf + i)) == NULL)
+			continue;
+		if ((clk->pid != -1) && (transport_packet_pid(pkt) != clk->pid))
+			continue;
+		if (!(transport_packet_values_extract(pkt, &values, transport_value_pcr) & transport_value_pcr))
+			continue;
+
+		clk->pid = transport_packet_pid(pkt);
+		pcr = values.pcr;
+		pos = clk->bytes + i;
+
+		if (clk->last_pcr != -1) {
+			dpcr = (pcr - clk->last_pcr + PCR_WRAP) % PCR_WRAP;
+
+			// PCRs are at most 100ms apart; anything else is a jump
+			if ((dpcr > 0) && (dpcr < PCR_HZ / 2) && (pos > clk->last_pcr_pos)) {
+				double rate = (double) dpcr / (double) (pos - clk->last_pcr_pos);
+
+				if (clk->ticks_per_byte == 0)
+					clk->ticks_per_byte = rate;
+				else
+					clk->ticks_per_byte += (rate - clk->ticks_per_byte) / 8;
+			} else {
+				clk->discontinuity = 1;
+			}
+		}
+
+		if (dvbclock_add(&clk->rec, pcr, now))
+			clk->discontinuity = 1;
+
+		clk->last_pcr = pcr;
+		clk->last_pcr_pos = pos;
+		clk->last_pcr_wall = now;
+	}
+
+	clk->bytes += size;
+}
+
+/**
+ * Work out the 27MHz stream time of a byte offset, extrapolating from the
+ * last PCR at the current bitrate. Until the bitrate is known, the
+ * recovered clock (or local time since the last PCR) is used instead.
+ *
+ * @return 0 on success, -1 if no PCR has been seen yet.
+ */
+static int gnutv_data_pcr_time(struct pcr_clock *clk, uint64_t pos, int64_t now, int64_t *t)
+{
+	if (clk->last_pcr == -1)
+		return -1;
+
+	if (clk->ticks_per_byte == 0) {
+		uint64_t clock;
+
+		if (dvbclock_stream_time(&clk->rec, now, &clock) == 0) {
+			*t = clock;
+			return 0;
+		}
+		*t = (clk->last_pcr + ((now - clk->last_pcr_wall) * 27) / 1000) % PCR_WRAP;
+		return 0;
+	}
+
+	*t = clk->last_pcr + (int64_t) (((double) pos - (double) clk->last_pcr_pos) * clk->ticks_per_byte);
+	return 0;
+}
+
+/**
+ * Work out when a datagram with stream time t should be sent: jitter_ns
+ * after the first, then at the pace of the stream clock (as it runs
+ * against the local one, once that is known, so the far end's buffer
+ * neither fills nor drains as the two drift apart). The pacer is
+ * re-anchored on clock jumps, and when output falls too far behind or
+ * ahead of the stream.
+ */
+static int64_t gnutv_data_pace(struct udp_output *out, int64_t t, int64_t now)
+{
+	int64_t due;
+	int64_t dt;
+
+	if (out->anchored && !out->clk.discontinuity) {
+		dt = t - out->pcr0;
+		if (dt > PCR_WRAP / 2)
+			dt -= PCR_WRAP;
+		else if (dt < -PCR_WRAP / 2)
+			dt += PCR_WRAP;
+
+		due = out->wall0 + dvbclock_ticks_to_ns(&out->clk.rec, dt);
+		if ((due >= now - out->jitter_ns) &&
+		    (due <= now + out->jitter_ns + PACE_MAX_AHEAD))
+			return due;
+	}
+
+	out->anchored = 1;
+	out->clk.discontinuity = 0;
+	out->wall0 = now + out->jitter_ns;
+	out->pcr0 = t;
+	return out->wall0;
+}
+
+/**
+ * Prepare the next datagram of the stream: track the PCR clock, fill in the
+ * RTP header (if any) and work out the send time (if pacing).
+ *
+ * @param dnp With -nonull, the null packets removed before each packet.
+ * @return Length of the header.
+ */
+static int gnutv_data_udp_stamp(struct udp_output *out, uint8_t *data, int len,
+				const uint8_t *dnp, uint8_t *hdr, int64_t *due)
+{
+	int packets = len / TRANSPORT_PACKET_LENGTH;
+	int64_t now = gnutv_data_now();
+	int hdrsize = out->hdrsize;
+	uint64_t pos;
+	int64_t t;
+	int valid;
+	int i;
+
+	// the removed nulls still count as stream time
+	if (out->nonull) {
+		for(i=0; i < packets; i++)
+			out->clk.bytes += dnp[i] * TRANSPORT_PACKET_LENGTH;
+	}
+	pos = out->clk.bytes;
+
+	gnutv_data_pcr_scan(&out->clk, data, len, now);
+	valid = (gnutv_data_pcr_time(&out->clk, pos, now, &t) == 0);
+
+	if (out->hdrsize) {
+		// the 90kHz RTP clock is the PCR base; local time until known
+		uint32_t stamp = valid ? (uint32_t) (t / 300) : (uint32_t) (now / 100000 * 9);
+
+		hdr[0x0] = 0x80;
+		hdr[0x1] = 0x21;
+		hdr[0x2] = out->rtpseq >> 8;
+		hdr[0x3] = out->rtpseq;
+		hdr[0x4] = stamp >> 24;
+		hdr[0x5] = stamp >> 16;
+		hdr[0x6] = stamp >> 8;
+		hdr[0x7] = stamp;
+		hdr[0x8] = out->ssrc >> 24;
+		hdr[0x9] = out->ssrc >> 16;
+		hdr[0xa] = out->ssrc >> 8;
+		hdr[0xb] = out->ssrc;
+
+		if (out->nonull) {
+			int words = (packets + 3) / 4;
+
+			hdr[0x0] |= 0x10;
+			hdr[0xc] = RTP_DNP_PROFILE >> 8;
+			hdr[0xd] = RTP_DNP_PROFILE & 0xff;
+			hdr[0xe] = words >> 8;
+			hdr[0xf] = words;
+			memcpy(hdr + 0x10, dnp, packets);
+			memset(hdr + 0x10 + packets, 0, words * 4 - packets);
+			hdrsize += 4 + words * 4;
+		}
+	}
+	out->rtpseq++;
+
+	if (out->pace)
+		*due = valid ? gnutv_data_pace(out, t, now) : now;
+	return hdrsize;
+}
+
+/**
+ * The interface queue is full (ENOBUFS): wait a moment rather than fail, so
+ * the stall backs up into the ring, where -shed or -ringdrop deal with it.
+ *
+ * @return 1 to try again, 0 if shutting down.
+ */
+static int gnutv_data_udp_backoff(void)
+{
+	if (outputthread_shutdown)
+		return 0;
+	usleep(1000);
+	return 1;
+}
+
+/**
+ * -fec: send the FEC packets which are ready. FEC is best effort: a send
+ * failure is reported once, and the media carries on.
+ */
+static void gnutv_data_udp_send_fec(struct udp_output *out)
+{
+	uint8_t *pkt;
+	int stream;
+	int len;
+	int count;
+	int sent;
+	int i;
+
+	do {
+		count = 0;
+		while((count < FEC_BATCH) && ((pkt = gnutv_fec_next(out->fec, &stream, &len)) != NULL)) {
+			memset(&out->fec_msgs[count], 0, sizeof(out->fec_msgs[count]));
+			out->fec_iov[count].iov_base = pkt;
+			out->fec_iov[count].iov_len = len;
+			out->fec_msgs[count].msg_hdr.msg_name = &out->fec_addr[stream];
+			out->fec_msgs[count].msg_hdr.msg_namelen = out->fec_addrlen;
+			out->fec_msgs[count].msg_hdr.msg_iov = &out->fec_iov[count];
+			out->fec_msgs[count].msg_hdr.msg_iovlen = 1;
+			count++;
+		}
+
+		i = 0;
+		while(i < count) {
+			sent = sendmmsg(out->fec_fd, &out->fec_msgs[i], count - i, 0);
+			if (sent < 0) {
+				if (errno == EINTR)
+					continue;
+				if (!out->fec_failed)
+					fprintf(stderr, "FEC send failure: %m\n");
+				out->fec_failed = 1;
+				break;
+			}
+			i += sent;
+		}
+		out->fec_sent += i;
+	} while(count == FEC_BATCH);
+}
+
+/**
+ * Send (up to) out->payload byte datagrams straight from buf, each with its
+ * own RTP header if required. With -nonull, out->dnp holds the counts for
+ * the packets of buf.
+ *
+ * @return 0 on success, -1 on a send error.
+ */
+int gnutv_data_udp_send(struct udp_output *out, uint8_t *buf, int size)
+{
+	int count = (size + out->payload - 1) / out->payload;
+	int per = out->hdrsize ? 2 : 1;
+	uint8_t *dnp = out->dnp;
+	int niov = 0;
+	int64_t due;
+	int sent;
+	int i;
+
+	DVBPROBE2(output_udp_send, size, count);
+	for(i=0; i < count; i++) {
+		int len = (size < out->payload) ? size : out->payload;
+		struct msghdr *msg = &out->msgs[i].msg_hdr;
+		int hdrsize;
+
+		memset(&out->msgs[i], 0, sizeof(out->msgs[i]));
+		msg->msg_name = out->addr->ai_addr;
+		msg->msg_namelen = out->addr->ai_addrlen;
+		msg->msg_iov = &out->iov[niov];
+
+		hdrsize = gnutv_data_udp_stamp(out, buf, len, dnp, out->rtphdr[i], &due);
+		if (dnp)
+			dnp += len / TRANSPORT_PACKET_LENGTH;
+		if (out->fec)
+			gnutv_fec_add(out->fec, out->rtphdr[i], hdrsize, buf, len);
+		if (out->hdrsize) {
+			out->iov[niov].iov_base = out->rtphdr[i];
+			out->iov[niov].iov_len = hdrsize;
+			niov++;
+		}
+		out->iov[niov].iov_base = buf;
+		out->iov[niov].iov_len = len;
+		niov++;
+		msg->msg_iovlen = &out->iov[niov] - msg->msg_iov;
+
+		if (out->txtime) {
+			struct cmsghdr *cmsg;
+
+			msg->msg_control = out->ctrl[i].buf;
+			msg->msg_controllen = sizeof(out->ctrl[i].buf);
+			cmsg = CMSG_FIRSTHDR(msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_TXTIME;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+			*((uint64_t *) CMSG_DATA(cmsg)) = due;
+		}
+
+		buf += len;
+		size -= len;
+	}
+
+	// with GSO, up to gso_count datagrams at a time go down the stack as
+	// one, and the kernel (or the NIC) cuts them up at the UDP_SEGMENT size
+	i = 0;
+	while(out->gso && (count > 1) && (i < count)) {
+		struct msghdr *msg = &out->msgs[i].msg_hdr;
+		int n = ((count - i) < out->gso_count) ? (count - i) : out->gso_count;
+
+		msg->msg_iovlen = n * per;
+		if (sendmsg(out->fd, msg, 0) >= 0) {
+			i += n;
+			continue;
+		}
+		msg->msg_iovlen = per;
+		if (errno == EINTR)
+			continue;
+		if ((errno == ENOBUFS) && gnutv_data_udp_backoff())
+			continue;
+		if ((errno == EIO) || (errno == EINVAL) || (errno == EOPNOTSUPP)) {
+			// not supported on this route: fall back to sendmmsg
+			int zero = 0;
+			setsockopt(out->fd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero));
+			out->gso = 0;
+			break;
+		}
+		fprintf(stderr, "Socket send failure: %m\n");
+		return -1;
+	}
+
+	if (out->xflow.queue && (gnutv_xdp_sendmmsg(&out->xflow, out->msgs, count) < 0)) {
+		fprintf(stderr, "XDP send failure: %m\n");
+		return -1;
+	}
+	while(!out->xflow.queue && (i < count)) {
+		sent = sendmmsg(out->fd, &out->msgs[i], count - i, 0);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == ENOBUFS) && gnutv_data_udp_backoff())
+				continue;
+			fprintf(stderr, "Socket send failure: %m\n");
+			return -1;
+		}
+		i += sent;
+	}
+
+	if (out->fec)
+		gnutv_data_udp_send_fec(out);
+	return 0;
+}
+
+/**
+ * Send the datagrams from the jitter buffer whose time has come.
+ *
+ * @param force Send at least one datagram, even if it isn't due yet.
+ * @return 0 on success, -1 on a send error.
+ */
+static int gnutv_data_udp_flush(struct udp_output *out, int force)
+{
+	int64_t now = gnutv_data_now();
+	int count = 0;
+	int sent;
+	int i;
+
+	while ((count < out->qcount) && (count < UDP_BATCH)) {
+		struct udp_datagram *d = &out->queue[(out->qhead + count) % out->qsize];
+
+		// anything due within the next half millisecond goes now
+		if ((d->due > now + 500000) && !(force && (count == 0)))
+			break;
+
+		memset(&out->msgs[count], 0, sizeof(out->msgs[count]));
+		out->iov[count].iov_base = d->data;
+		out->iov[count].iov_len = d->len;
+		out->msgs[count].msg_hdr.msg_name = out->addr->ai_addr;
+		out->msgs[count].msg_hdr.msg_namelen = out->addr->ai_addrlen;
+		out->msgs[count].msg_hdr.msg_iov = &out->iov[count];
+		out->msgs[count].msg_hdr.msg_iovlen = 1;
+		if (out->fec)
+			gnutv_fec_add(out->fec, d->data, RTP_HEADER_SIZE, d->data + RTP_HEADER_SIZE,
+				      d->len - RTP_HEADER_SIZE);
+		count++;
+	}
+
+	if (out->xflow.queue && (gnutv_xdp_sendmmsg(&out->xflow, out->msgs, count) < 0)) {
+		fprintf(stderr, "XDP send failure: %m\n");
+		return -1;
+	}
+	i = 0;
+	while(!out->xflow.queue && (i < count)) {
+		sent = sendmmsg(out->fd, &out->msgs[i], count - i, 0);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == ENOBUFS) && gnutv_data_udp_backoff())
+				continue;
+			fprintf(stderr, "Socket send failure: %m\n");
+			return -1;
+		}
+		i += sent;
+	}
+
+	out->qhead = (out->qhead + count) % out->qsize;
+	out->qcount -= count;
+	if (out->fec)
+		gnutv_data_udp_send_fec(out);
+	return 0;
+}
+
+/**
+ * Put datagrams into the jitter buffer, to be sent at their due time.
+ *
+ * @return 0 on success, -1 on a send error.
+ */
+static int gnutv_data_udp_queue(struct udp_output *out, uint8_t *buf, int size)
+{
+	struct udp_datagram *d;
+	uint8_t *dnp = out->dnp;
+	int hdrsize;
+	int len;
+
+	while(size > 0) {
+		// a full buffer means we're behind: make room regardless
+		if ((out->qcount == out->qsize) && gnutv_data_udp_flush(out, 1))
+			return -1;
+
+		len = (size < out->payload) ? size : out->payload;
+		d = &out->queue[(out->qhead + out->qcount) % out->qsize];
+
+		hdrsize = gnutv_data_udp_stamp(out, buf, len, dnp, d->data, &d->due);
+		if (dnp)
+			dnp += len / TRANSPORT_PACKET_LENGTH;
+		memcpy(d->data + hdrsize, buf, len);
+		d->len = hdrsize + len;
+		out->qcount++;
+
+		buf += len;
+		size -= len;
+	}
+
+	return 0;
+}
+
+/**
+ * How long to sleep until the next queued datagram is due (ms).
+ */
+static int gnutv_data_udp_wait(struct udp_output *out)
+{
+	int64_t wait;
+
+	if (out->qcount == 0)
+		return 1000;
+
+	wait = (out->queue[out->qhead].due - gnutv_data_now()) / 1000000;
+	if (wait < 0)
+		return 0;
+	if (wait > 1000)
+		return 1000;
+	return wait;
+}
+
+/**
+ * Set up a UDP/RTP output. Pacing uses SO_TXTIME if requested and supported;
+ * otherwise the caller has to provide a jitter buffer.
+ *
+ * @param payload TS bytes per datagram, 0 for TS_PAYLOAD_SIZE.
+ * @param nonull Null packets are removed by the caller (see
+ * gnutv_data_udp_strip()).
+ */
+static void gnutv_data_udp_init(struct udp_output *out, int fd, struct addrinfo *addr,
+				int rtp, int pace, int payload, int nonull)
+{
+	int segsize;
+
+	memset(out, 0, sizeof(struct udp_output));
+	out->fd = fd;
+	out->addr = addr;
+	out->payload = payload ? payload : TS_PAYLOAD_SIZE;
+	out->nonull = nonull;
+	if (nonull)
+		out->dnp = out->dnp_counts;
+	out->clk.pid = -1;
+	out->clk.last_pcr = -1;
+	dvbclock_init(&out->clk.rec);
+	if (rtp) {
+		out->ssrc = random();
+		out->rtpseq = random();
+		out->hdrsize = RTP_HEADER_SIZE;
+	}
+
+	if (pace) {
+		out->pace = 1;
+		out->jitter_ns = pace_ms * 1000000LL;
+
+		// let the fq qdisc release the datagrams, or do it ourselves
+		if (usetxtime) {
+			struct sock_txtime txtime;
+
+			txtime.clockid = CLOCK_MONOTONIC;
+			txtime.flags = 0;
+			if (setsockopt(fd, SOL_SOCKET, SO_TXTIME, &txtime, sizeof(txtime)) == 0)
+				out->txtime = 1;
+			else
+				fprintf(stderr, "SO_TXTIME not supported, pacing in userspace\n");
+		}
+	} else {
+		// GSO would send a whole batch at once: only without pacing
+		segsize = out->hdrsize + out->payload;
+		if (out->hdrsize && nonull)
+			segsize += 4 + ((out->payload / TRANSPORT_PACKET_LENGTH + 3) & ~3);
+		out->gso_count = UDP_GSO_MAX / segsize;
+		if (out->gso_count < 1)
+			out->gso_count = 1;
+		if (setsockopt(fd, SOL_UDP, UDP_SEGMENT, &segsize, sizeof(segsize)) == 0)
+			out->gso = 1;
+	}
+
+	// -xdp bypasses the stack, and so GSO and SO_TXTIME, for multicast
+	if (xdp && !out->txtime) {
+		segsize = out->hdrsize + out->payload;
+		if (out->hdrsize && nonull)
+			segsize += 4 + ((out->payload / TRANSPORT_PACKET_LENGTH + 3) & ~3);
+		if (gnutv_xdp_flow_init(xdp, &out->xflow, fd, addr->ai_addr, segsize) == 0) {
+			if (out->gso) {
+				int zero = 0;
+				setsockopt(fd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero));
+				out->gso = 0;
+			}
+		} else if ((addr->ai_family == AF_INET) &&
+			   IN_MULTICAST(ntohl(((struct sockaddr_in *) addr->ai_addr)->sin_addr.s_addr))) {
+			fprintf(stderr, "Not an XDP destination, sending through the kernel\n");
+		}
+	}
+}
+
+/**
+ * -fec: set up the FEC of an RTP output, sent from fd to the media port +
+ * FEC_COLUMN_PORT and FEC_ROW_PORT.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int gnutv_data_udp_init_fec(struct udp_output *out, int fd)
+{
+	int i;
+
+	if ((out->fec = gnutv_fec_create(fec_columns, fec_rows, fec_row)) == NULL)
+		return -1;
+	out->fec_fd = fd;
+
+	out->fec_addrlen = out->addr->ai_addrlen;
+	for(i=0; i < 2; i++) {
+		int offset = (i == GNUTV_FEC_COLUMN) ? FEC_COLUMN_PORT : FEC_ROW_PORT;
+
+		memcpy(&out->fec_addr[i], out->addr->ai_addr, out->fec_addrlen);
+		if (out->addr->ai_family == AF_INET6) {
+			struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *) &out->fec_addr[i];
+
+			sin6->sin6_port = htons(ntohs(sin6->sin6_port) + offset);
+		} else {
+			struct sockaddr_in *sin = (struct sockaddr_in *) &out->fec_addr[i];
+
+			sin->sin_port = htons(ntohs(sin->sin_port) + offset);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * How many TS bytes fit into a datagram to addrs: per udp_mtu, which is a
+ * size in bytes, or -1 for the MTU of the route there.
+ *
+ * @return The size, or 0 for the default.
+ */
+static int gnutv_data_udp_payload(struct addrinfo *addrs, char *outif)
+{
+	int mtu = udp_mtu;
+	int overhead;
+	int packets;
+
+	if (mtu == 0)
+		return 0;
+
+	// connecting a datagram socket finds the route, without sending
+	if (mtu < 0) {
+		int ipv6 = (addrs->ai_family == AF_INET6);
+		socklen_t len = sizeof(mtu);
+		int fd;
+
+		if ((fd = socket(addrs->ai_family, SOCK_DGRAM, 0)) < 0)
+			return 0;
+		if (outif != NULL)
+			setsockopt(fd, SOL_SOCKET, SO_BINDTODEVICE, outif, strlen(outif));
+		if (connect(fd, addrs->ai_addr, addrs->ai_addrlen) ||
+		    getsockopt(fd, ipv6 ? IPPROTO_IPV6 : IPPROTO_IP, ipv6 ? IPV6_MTU : IP_MTU,
+			       &mtu, &len)) {
+			fprintf(stderr, "Unable to find the path MTU, using 7 packets a datagram\n");
+			close(fd);
+			return 0;
+		}
+		close(fd);
+	}
+
+	overhead = ((addrs->ai_family == AF_INET6) ? 40 : 20) + 8 + (usertp ? RTP_HEADER_SIZE : 0);
+	packets = (mtu - overhead) / TRANSPORT_PACKET_LENGTH;
+	if (packets > UDP_MAX_PACKETS)
+		packets = UDP_MAX_PACKETS;
+	while(usertp && udp_nonull && (packets > 1) &&
+	      ((overhead + 4 + ((packets + 3) & ~3) + packets * TRANSPORT_PACKET_LENGTH) > mtu))
+		packets--;
+	if (packets < 1)
+		packets = 1;
+
+	fprintf(stderr, "Sending %i TS packets a datagram for an MTU of %i\n", packets, mtu);
+	return packets * TRANSPORT_PACKET_LENGTH;
+}
+
+/**
+ * Allocate the jitter buffer of a paced output.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int gnutv_data_udp_alloc_queue(struct udp_output *out)
+{
+	int stride = RTP_MAX_HEADER + out->payload;
+	int i;
+
+	out->qsize = (int) (((int64_t) UDP_QUEUE_SIZE * TS_PAYLOAD_SIZE) / out->payload);
+	out->queue = malloc(out->qsize * sizeof(struct udp_datagram));
+	out->qdata = malloc((size_t) out->qsize * stride);
+	if ((out->queue == NULL) || (out->qdata == NULL)) {
+		free(out->queue);
+		free(out->qdata);
+		out->queue = NULL;
+		return -1;
+	}
+	for(i=0; i < out->qsize; i++)
+		out->queue[i].data = out->qdata + (size_t) i * stride;
+
+	return 0;
+}
+
+/**
+ * -nonull: remove the null packets from the whole packets of buf between
+ * *from and *to, moving the rest of the data (up to *size) down over them,
+ * and note in out->dnp how many went before each packet kept. *from is
+ * moved on to the end of what has been done, and *to and *size back by
+ * what was removed.
+ */
+static void gnutv_data_udp_strip(struct udp_output *out, uint8_t *buf,
+				 int *from, int *to, int *size)
+{
+	int end = *to - ((*to - *from) % TRANSPORT_PACKET_LENGTH);
+	int dst = *from;
+	int src;
+
+	for(src = *from; src < end; src += TRANSPORT_PACKET_LENGTH) {
+		uint8_t *pkt = buf + src;
+
+		if ((pkt[0] == TRANSPORT_PACKET_SYNC) &&
+		    ((((pkt[1] & 0x1f) << 8) | pkt[2]) == TRANSPORT_NULL_PID) &&
+		    (out->nulls < 255)) {
+			out->nulls++;
+			out->nulls_removed++;
+			continue;
+		}
+
+		out->dnp[dst / TRANSPORT_PACKET_LENGTH] = out->nulls;
+		out->nulls = 0;
+		if (dst != src)
+			memcpy(buf + dst, pkt, TRANSPORT_PACKET_LENGTH);
+		dst += TRANSPORT_PACKET_LENGTH;
+	}
+
+	memmove(buf + dst, buf + end, *size - end);
+	*size -= end - dst;
+	*to -= end - dst;
+	*from = dst;
+}
+
+struct udp_output *gnutv_data_udp_new(int fd, struct addrinfo *addr, int rtp)
+{
+	struct udp_output *out;
+
+	if ((out = malloc(sizeof(struct udp_output))) == NULL)
+		return NULL;
+	gnutv_data_udp_init(out, fd, addr, rtp, 0, 0, 0);
+
+	return out;
+}
+
+uint32_t gnutv_data_udp_ssrc(struct udp_output *out)
+{
+	return out->ssrc;
+}
+
+static void *udpoutputthread_func(void* arg)
+{
+	(void)arg;
+	static struct udp_output out;
+	struct pollfd pollfd;
+	uint8_t *buf;
+	int bufmax;
+	int limit;
+	int bufsize = 0;
+	int done = 0;			// remuxed
+	int ready = 0;			// and with the nulls removed
+	int readsize;
+	int sendsize;
+	int result;
+
+	pollfd.fd = gnutv_data_dvr_fd();
+	pollfd.events = POLLIN|POLLPRI|POLLERR;
+
+	gnutv_data_udp_init(&out, outfd, outaddrs, usertp, pace_ms >= 0, udp_payload, udp_nonull);
+	stats_clock = &out.clk.rec;
+	bufmax = UDP_BATCH * out.payload;
+	limit = remux ? bufmax / REMUX_EXPANSION : bufmax;
+	if ((buf = malloc(bufmax)) == NULL) {
+		fprintf(stderr, "Out of memory for output buffer\n");
+		return 0;
+	}
+	if (out.pace && !out.txtime && gnutv_data_udp_alloc_queue(&out)) {
+		fprintf(stderr, "Out of memory for jitter buffer\n");
+		free(buf);
+		return 0;
+	}
+	if (fec_columns && gnutv_data_udp_init_fec(&out, fec_fd)) {
+		fprintf(stderr, "Out of memory for FEC\n");
+		free(out.queue);
+		free(out.qdata);
+		free(buf);
+		return 0;
+	}
+
+	while(!outputthread_shutdown) {
+		result = poll(&pollfd, 1, out.queue ? gnutv_data_udp_wait(&out) : 1000);
+		if (out.queue && gnutv_data_udp_flush(&out, 0))
+			break;
+		if (result != 1)
+			continue;
+		if (pollfd.revents & POLLERR) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "DVR device read failure\n");
+			break;
+		}
+
+		readsize = gnutv_data_read_dvr(buf + bufsize, limit - bufsize);
+		if (readsize < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "DVR device read failure\n");
+			break;
+		}
+		bufsize += readsize;
+		if (remux)
+			gnutv_data_remux(buf, &done, &bufsize, bufmax);
+		else
+			done = bufsize;
+		if (out.nonull)
+			gnutv_data_udp_strip(&out, buf, &ready, &done, &bufsize);
+		else
+			ready = done;
+
+		// send/queue all the complete datagrams, keep the rest for next time
+		sendsize = ready - (ready % out.payload);
+		if (sendsize) {
+			if (out.queue)
+				result = gnutv_data_udp_queue(&out, buf, sendsize);
+			else
+				result = gnutv_data_udp_send(&out, buf, sendsize);
+			if (result)
+				break;
+			bufsize -= sendsize;
+			memmove(buf, buf + sendsize, bufsize);
+			if (out.nonull)
+				memmove(out.dnp, out.dnp + sendsize / TRANSPORT_PACKET_LENGTH,
+					(ready - sendsize) / TRANSPORT_PACKET_LENGTH);
+		}
+		done -= sendsize;
+		ready -= sendsize;
+	}
+
+	if (out.queue) {
+		if (ready)
+			gnutv_data_udp_queue(&out, buf, ready);
+		while (out.qcount && !gnutv_data_udp_flush(&out, 1))
+			;
+		free(out.queue);
+		free(out.qdata);
+	} else if (ready) {
+		gnutv_data_udp_send(&out, buf, ready);
+	}
+	if (out.nonull)
+		fprintf(stderr, "UDP: %llu null packets removed\n", (unsigned long long) out.nulls_removed);
+	if (out.fec) {
+		fprintf(stderr, "UDP: %llu FEC packets sent\n", (unsigned long long) out.fec_sent);
+		gnutv_fec_destroy(out.fec);
+	}
+
+	free(buf);
+	return 0;
+}
+
+// -service outputs: all the PIDs of all the services share the one DVR,
+// and are sorted out again by multioutputthread_func()
+#define MULTI_READ_SIZE (TRANSPORT_PACKET_LENGTH * TRANSPORT_BATCH_MAX)
+#define MULTI_BUFFER_SIZE (UDP_BATCH * TS_PAYLOAD_SIZE)
+#define MULTI_MAX_PIDS 64
+
+// PAT and PMT are repeated this often (ns) in each output
+#define PSI_INTERVAL 100000000LL
+#define PSI_MAX_SECTION GNUTV_DATA_MAX_PMT
+#define PSI_MAX_PACKETS 6
+
+struct service_output {
+	int service_id;
+	int type;			// OUTPUT_TYPE_FILE or OUTPUT_TYPE_UDP
+	char *outfile;
+	char *outif;
+	struct addrinfo *addrs;
+	int rtp;
+
+	int fd;
+	struct udp_output *udp;		// NULL for file output
+	struct gnutv_store_file *file;	// file output through the store
+	int failed;			// output failed, stop sending to it
+	int direct;
+
+	// regenerated PSI; pmt_len is 0 until the service's PMT is seen
+	int pmt_pid;
+	int pat_version;
+	uint8_t pat[GNUTV_DATA_PAT_SIZE];
+	uint8_t pmt[PSI_MAX_SECTION];
+	int pmt_len;
+	uint8_t pat_cc;
+	uint8_t pmt_cc;
+	int64_t next_psi;
+
+	int pids[MULTI_MAX_PIDS];
+	int pid_count;
+
+	uint8_t buf[MULTI_BUFFER_SIZE];
+	int bufsize;
+};
+
+static struct service_output *services[GNUTV_MAX_SERVICES];
+static int service_count = 0;
+
+// which services want each PID; it is in the pidset while any do
+static uint32_t pid_services[TRANSPORT_MAX_PIDS];
+
+// protects the above against the DVB thread's PAT/PMT updates
+static pthread_mutex_t services_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int gnutv_data_add_service(int service_id, int type, char *outfile,
+			   char *outif, struct addrinfo *addrs, int rtp)
+{
+	struct service_output *s;
+
+	if (service_count == GNUTV_MAX_SERVICES) {
+		fprintf(stderr, "Too many services\n");
+		return -1;
+	}
+
+	if ((s = calloc(1, sizeof(struct service_output))) == NULL) {
+		fprintf(stderr, "Out of memory for service output\n");
+		return -1;
+	}
+	s->service_id = service_id;
+	s->type = type;
+	s->outfile = outfile;
+	s->outif = outif;
+	s->addrs = addrs;
+	s->rtp = rtp;
+	s->fd = -1;
+	s->pmt_pid = -1;
+	s->pat_version = -1;
+
+	services[service_count++] = s;
+	return 0;
+}
+
+static void gnutv_data_open_services(void)
+{
+	struct service_output *s;
+	int i;
+
+	for(i=0; i < service_count; i++) {
+		s = services[i];
+
+		if (s->type == OUTPUT_TYPE_FILE) {
+			s->fd = open(s->outfile, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644);
+			if (s->fd < 0) {
+				fprintf(stderr, "Failed to open output file %s\n", s->outfile);
+				exit(1);
+			}
+			if (store)
+				s->file = gnutv_store_open(store, s->fd);
+			continue;
+		}
+
+		if ((s->udp = malloc(sizeof(struct udp_output))) == NULL) {
+			fprintf(stderr, "Out of memory for service output\n");
+			exit(1);
+		}
+		s->fd = gnutv_data_open_socket(s->addrs, s->outif);
+
+		// there is no jitter buffer per service: only SO_TXTIME pacing
+		gnutv_data_udp_init(s->udp, s->fd, s->addrs, s->rtp, usetxtime && (pace_ms >= 0), 0, 0);
+		if (s->udp->pace && !s->udp->txtime)
+			s->udp->pace = 0;
+	}
+}
+
+static struct service_output *gnutv_data_find_service(int service_id, int *idx)
+{
+	int i;
+
+	for(i=0; i < service_count; i++) {
+		if (services[i]->service_id == service_id) {
+			*idx = i;
+			return services[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void gnutv_data_service_add_pid(int idx, int pid)
+{
+	struct service_output *s = services[idx];
+	int i;
+
+	for(i=0; i < s->pid_count; i++) {
+		if (s->pids[i] == pid)
+			return;
+	}
+	if (s->pid_count == MULTI_MAX_PIDS) {
+		fprintf(stderr, "Too many PIDs in service %i\n", s->service_id);
+		return;
+	}
+
+	// the first service to want a PID adds it
+	if ((pid_services[pid] == 0) && gnutv_data_pidset_add(pid)) {
+		fprintf(stderr, "Unable to create dvr filter for PID %i\n", pid);
+		return;
+	}
+
+	pid_services[pid] |= 1U << idx;
+	s->pids[s->pid_count++] = pid;
+}
+
+static void gnutv_data_service_remove_pid(int idx, int pid)
+{
+	struct service_output *s = services[idx];
+	int i;
+
+	for(i=0; i < s->pid_count; i++) {
+		if (s->pids[i] != pid)
+			continue;
+
+		pid_services[pid] &= ~(1U << idx);
+		if (pid_services[pid] == 0)
+			gnutv_data_pidset_remove(pid);
+		s->pids[i] = s->pids[--s->pid_count];
+		return;
+	}
+}
+
+static void gnutv_data_service_free_pids(int idx)
+{
+	struct service_output *s = services[idx];
+	int i;
+
+	for(i=0; i < s->pid_count; i++) {
+		int pid = s->pids[i];
+
+		pid_services[pid] &= ~(1U << idx);
+		if (pid_services[pid] == 0)
+			gnutv_data_pidset_remove(pid);
+	}
+	s->pid_count = 0;
+}
+
+int gnutv_data_build_pat(uint8_t *sec, int transport_stream_id, int program_number, int pmt_pid,
+			 int version)
+{
+	struct section_builder b;
+
+	section_builder_start_ext(&b, sec, GNUTV_DATA_PAT_SIZE, stag_mpeg_program_association, 0,
+				  transport_stream_id, version, 0, 0);
+	section_builder_u16(&b, program_number);
+	section_builder_u16(&b, 0xe000 | pmt_pid);
+
+	return section_builder_finish(&b);
+}
+
+static void gnutv_data_multi_pat(int transport_stream_id, int program_number, int pmt_pid)
+{
+	struct service_output *s;
+	int idx;
+
+	pthread_mutex_lock(&services_lock);
+	s = gnutv_data_find_service(program_number, &idx);
+	if ((s == NULL) || (s->pmt_pid == pmt_pid)) {
+		pthread_mutex_unlock(&services_lock);
+		return;
+	}
+
+	// a PAT holding nothing but this service
+	s->pmt_pid = pmt_pid;
+	s->pat_version = (s->pat_version + 1) & 0x1f;
+	gnutv_data_build_pat(s->pat, transport_stream_id, program_number, pmt_pid, s->pat_version);
+
+	// wait for the new PMT, and send the new PAT right away
+	s->pmt_len = 0;
+	s->next_psi = 0;
+	pthread_mutex_unlock(&services_lock);
+}
+
+/**
+ * Re-encode a PMT which has been through mpeg_pmt_section_codec(). The
+ * descriptors are copied untouched.
+ *
+ * @return Length of the section, or -1 if it doesn't fit.
+ */
+int gnutv_data_build_pmt(uint8_t *sec, struct mpeg_pmt_section *pmt, const uint16_t *pid_map)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	struct section_builder b;
+	int pcr_pid = pmt->pcr_pid;
+	int pid;
+
+	// no PCR is 0x1fff
+	if (pid_map)
+		pcr_pid = (pid_map[pcr_pid] == GNUTV_REMUX_DROP) ? TRANSPORT_NULL_PID : pid_map[pcr_pid];
+
+	section_builder_start_ext(&b, sec, PSI_MAX_SECTION, stag_mpeg_program_map, 0,
+				  pmt->head.table_id_ext, pmt->head.version_number, 0, 0);
+	section_builder_u16(&b, 0xe000 | pcr_pid);
+	section_builder_open_loop(&b, 0xf);
+	section_builder_bytes(&b, (uint8_t *) pmt + sizeof(struct mpeg_pmt_section),
+			      pmt->program_info_length);
+	section_builder_close(&b);
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		pid = cur_stream->pid;
+		if (pid_map && ((pid = pid_map[pid]) == GNUTV_REMUX_DROP))
+			continue;
+
+		section_builder_u8(&b, cur_stream->stream_type);
+		section_builder_u16(&b, 0xe000 | pid);
+		section_builder_open_loop(&b, 0xf);
+		section_builder_bytes(&b, (uint8_t *) cur_stream + sizeof(struct mpeg_pmt_stream),
+				      cur_stream->es_info_length);
+		section_builder_close(&b);
+	}
+
+	return section_builder_finish(&b);
+}
+
+static int gnutv_data_pmt_has_pid(struct mpeg_pmt_section *pmt, int pid)
+{
+	struct mpeg_pmt_stream *cur_stream;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (cur_stream->pid == pid)
+			return 1;
+	}
+	return 0;
+}
+
+static void gnutv_data_multi_pmt(struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	struct service_output *s;
+	int old_pids[MULTI_MAX_PIDS];
+	int old_count;
+	int idx;
+	int i;
+
+	pthread_mutex_lock(&services_lock);
+	s = gnutv_data_find_service(pmt->head.table_id_ext, &idx);
+	if (s == NULL) {
+		pthread_mutex_unlock(&services_lock);
+		return;
+	}
+
+	// the PMT PID itself is not passed on: the PMT is regenerated. The new
+	// PIDs are added before the old ones go, so those in both keep their
+	// filters
+	old_count = s->pid_count;
+	memcpy(old_pids, s->pids, old_count * sizeof(int));
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		gnutv_data_service_add_pid(idx, cur_stream->pid);
+	}
+	gnutv_data_service_add_pid(idx, pmt->pcr_pid);
+	for(i=0; i < old_count; i++) {
+		if (old_pids[i] == pmt->pcr_pid)
+			continue;
+		if (gnutv_data_pmt_has_pid(pmt, old_pids[i]))
+			continue;
+		gnutv_data_service_remove_pid(idx, old_pids[i]);
+	}
+
+	s->pmt_len = gnutv_data_build_pmt(s->pmt, pmt, NULL);
+	if (s->pmt_len < 0) {
+		fprintf(stderr, "PMT of service %i is too large\n", s->service_id);
+		s->pmt_len = 0;
+	}
+	s->next_psi = 0;
+	pthread_mutex_unlock(&services_lock);
+}
+
+/**
+ * Cut a section up into TS packets.
+ *
+ * @return Number of bytes of packets put into buf.
+ */
+int gnutv_data_packetise(uint8_t *buf, int pid, uint8_t *cc, uint8_t *section, int len)
+{
+	int size = 0;
+	int pos = 0;
+
+	while(pos < len) {
+		uint8_t *pkt = buf + size;
+		int hdr = 4;
+		int count;
+
+		pkt[0] = TRANSPORT_PACKET_SYNC;
+		pkt[1] = ((pos == 0) ? 0x40 : 0) | (pid >> 8);
+		pkt[2] = pid;
+		pkt[3] = 0x10 | *cc;
+		*cc = (*cc + 1) & 0x0f;
+		if (pos == 0)
+			pkt[hdr++] = 0;	// pointer_field
+
+		count = TRANSPORT_PACKET_LENGTH - hdr;
+		if (count > (len - pos))
+			count = len - pos;
+		memcpy(pkt + hdr, section + pos, count);
+		memset(pkt + hdr + count, 0xff, TRANSPORT_PACKET_LENGTH - hdr - count);
+
+		pos += count;
+		size += TRANSPORT_PACKET_LENGTH;
+	}
+
+	return size;
+}
+
+/**
+ * Pass the complete datagrams (or everything, for a file or if force is set)
+ * in a service's buffer on to its output.
+ */
+static void gnutv_data_service_flush(struct service_output *s, int force)
+{
+	int size = s->bufsize;
+	int result;
+
+	if (s->udp && !force)
+		size -= size % TS_PAYLOAD_SIZE;
+	if ((size == 0) || s->failed) {
+		if (s->failed)
+			s->bufsize = 0;
+		return;
+	}
+
+	if (s->udp)
+		result = gnutv_data_udp_send(s->udp, s->buf, size);
+	else if (s->file)
+		result = gnutv_store_write(s->file, s->buf, size);
+	else
+		result = gnutv_data_write(s->fd, s->buf, size, &s->direct);
+	if (result) {
+		fprintf(stderr, "Output for service %i failed\n", s->service_id);
+		s->failed = 1;
+	}
+
+	s->bufsize -= size;
+	memmove(s->buf, s->buf + size, s->bufsize);
+}
+
+static void gnutv_data_service_put(struct service_output *s, uint8_t *pkt, int64_t now)
+{
+	// room for one packet, and the PSI which may precede it
+	if ((s->bufsize + TRANSPORT_PACKET_LENGTH * (PSI_MAX_PACKETS + 2)) > MULTI_BUFFER_SIZE)
+		gnutv_data_service_flush(s, 0);
+
+	if (s->pmt_len && (now >= s->next_psi)) {
+		s->bufsize += gnutv_data_packetise(s->buf + s->bufsize, TRANSPORT_PAT_PID, &s->pat_cc,
+						   s->pat, sizeof(s->pat));
+		s->bufsize += gnutv_data_packetise(s->buf + s->bufsize, s->pmt_pid, &s->pmt_cc,
+						   s->pmt, s->pmt_len);
+		s->next_psi = now + PSI_INTERVAL;
+	}
+
+	memcpy(s->buf + s->bufsize, pkt, TRANSPORT_PACKET_LENGTH);
+	s->bufsize += TRANSPORT_PACKET_LENGTH;
+}
+
+static void *multioutputthread_func(void* arg)
+{
+	(void)arg;
+	static uint8_t buf[MULTI_READ_SIZE];
+	static struct transport_packet_batch batch;
+	int bufsize = 0;
+	int64_t now;
+	int result;
+	int pos;
+	int used;
+	int i;
+	int j;
+
+	while(!outputthread_shutdown) {
+		if ((result = gnutv_data_wait_dvr()) <= 0) {
+			if (result < 0)
+				break;
+			continue;
+		}
+
+		int size = gnutv_data_read_dvr(buf + bufsize, sizeof(buf) - bufsize);
+		if (size < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EOVERFLOW) {
+				// The error flag has been cleared, next read should succeed.
+				fprintf(stderr, "DVR overflow\n");
+				continue;
+			}
+
+			fprintf(stderr, "DVR device read failure\n");
+			break;
+		}
+		bufsize += size;
+
+		// hand each packet to every service which wants its PID
+		now = gnutv_data_now();
+		pos = 0;
+		pthread_mutex_lock(&services_lock);
+		while((bufsize - pos) >= TRANSPORT_PACKET_LENGTH) {
+			if (buf[pos] != TRANSPORT_PACKET_SYNC) {
+				if ((result = transport_packet_find_sync(buf + pos, bufsize - pos)) < 0) {
+					pos = bufsize - (TRANSPORT_PACKET_LENGTH - 1);
+					break;
+				}
+				pos += result ? result : 1;
+				continue;
+			}
+
+			used = transport_packet_batch_extract(buf + pos, bufsize - pos, &batch);
+			for(i=0; i < batch.count; i++) {
+				uint32_t wanted = pid_services[batch.pid[i]];
+
+				for(j=0; wanted; j++, wanted >>= 1) {
+					if (wanted & 1)
+						gnutv_data_service_put(services[j],
+								       buf + pos + i * TRANSPORT_PACKET_LENGTH, now);
+				}
+			}
+			pos += used;
+		}
+		pthread_mutex_unlock(&services_lock);
+
+		bufsize -= pos;
+		memmove(buf, buf + pos, bufsize);
+
+		for(i=0; i < service_count; i++)
+			gnutv_data_service_flush(services[i], 0);
+	}
+
+	for(i=0; i < service_count; i++)
+		gnutv_data_service_flush(services[i], 1);
+
+	return 0;
+}
+
+static void gnutv_data_multi_stop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&services_lock);
+	for(i=0; i < service_count; i++) {
+		gnutv_data_service_free_pids(i);
+		if (services[i]->file && gnutv_store_close(services[i]->file))
+			fprintf(stderr, "Output for service %i failed: %m\n", services[i]->service_id);
+		if (services[i]->fd != -1)
+			close(services[i]->fd);
+		if (services[i]->addrs)
+			freeaddrinfo(services[i]->addrs);
+		free(services[i]->udp);
+		free(services[i]);
+	}
+	service_count = 0;
+	pthread_mutex_unlock(&services_lock);
+}
+
+// the drain thread's DVR reads, and what it reads to discard data
+#define DRAIN_READ_SIZE (TRANSPORT_PACKET_LENGTH * TRANSPORT_BATCH_MAX)
+
+static void gnutv_data_start_ring(void)
+{
+	// -tee always needs one, with a consumer per sink; so does -standby,
+	// which is merged in by the drain thread
+	if (tee_sinks && (ring_size <= 0))
+		ring_size = GNUTV_TEE_RING_SIZE;
+	if (standby && (ring_size <= 0))
+		ring_size = GNUTV_STANDBY_RING_SIZE;
+	if (shed && (ring_size <= 0))
+		ring_size = GNUTV_SHED_RING_SIZE;
+	if (ring_size <= 0)
+		return;
+
+	ring = gnutv_ring_create(ring_size, TRANSPORT_PACKET_LENGTH, tee_sinks ? gnutv_tee_count(tee_sinks) : 1,
+				 ring_drop ? GNUTV_RING_DROP : GNUTV_RING_BLOCK, ring_hugepages);
+	if (ring == NULL) {
+		fprintf(stderr, "Failed to create DVR ring buffer\n");
+		exit(1);
+	}
+
+	gnutv_affinity_thread_create(&drainthread, GNUTV_THREAD_REALTIME, drainthread_func, NULL);
+}
+
+/**
+ * Start the output thread, which reads the DVR itself unless there's a ring.
+ */
+static void gnutv_data_start_output(void *(*func)(void *))
+{
+	gnutv_affinity_thread_create(&outputthread, ring ? GNUTV_THREAD_NORMAL : GNUTV_THREAD_REALTIME,
+				     func, NULL);
+}
+
+static void gnutv_data_print_ring_stats(const char *prefix)
+{
+	struct gnutv_ring_stats stats;
+
+	gnutv_ring_get_stats(ring, &stats);
+	fprintf(stderr, "%s: high water %zu of %zu bytes (%zu%%), %llu bytes in, "
+		"%llu bytes dropped in %llu chunks\n", prefix,
+		stats.high_water, stats.size, stats.high_water * 100 / stats.size,
+		(unsigned long long) stats.bytes, (unsigned long long) stats.dropped,
+		(unsigned long long) stats.drops);
+}
+
+static void gnutv_data_stop_ring(void)
+{
+	if (ring == NULL)
+		return;
+
+	pthread_join(drainthread, NULL);
+	if (tee_sinks)
+		gnutv_tee_stop(tee_sinks);
+	gnutv_data_print_ring_stats("DVR ring");
+	if (shed) {
+		struct gnutv_shed_stats stats;
+
+		gnutv_shed_get_stats(shed, &stats);
+		fprintf(stderr, "Shed: %llu ancillary, %llu secondary and %llu video packets of %llu, "
+			"%llu level changes\n",
+			(unsigned long long) stats.shed[0], (unsigned long long) stats.shed[1],
+			(unsigned long long) stats.shed[2], (unsigned long long) stats.packets,
+			(unsigned long long) stats.changes);
+	}
+	gnutv_ring_destroy(ring);
+	ring = NULL;
+}
+
+/**
+ * With -shed, take the packets shed at the ring's fill level out of data
+ * just written into it.
+ *
+ * @return Length of what is left.
+ */
+static int gnutv_data_shed(uint8_t *data, int size)
+{
+	struct gnutv_ring_stats stats;
+
+	if (shed == NULL)
+		return size;
+	gnutv_ring_get_stats(ring, &stats);
+	return gnutv_shed_process(shed, data, size, stats.fill * 100 / stats.size,
+				  gnutv_data_now());
+}
+
+/**
+ * Copy data into the ring, waiting for room, or with the drop policy
+ * throwing away what doesn't fit.
+ */
+static void gnutv_data_ring_put(const uint8_t *data, int size)
+{
+	uint8_t *ptr;
+	size_t avail;
+	int pos = 0;
+
+	while((pos < size) && !outputthread_shutdown) {
+		if ((ptr = gnutv_ring_write_ptr(ring, &avail, 100)) == NULL) {
+			if (!ring_drop)
+				continue;
+			gnutv_ring_dropped(ring, size - pos);
+			break;
+		}
+		if (avail > (size_t) (size - pos))
+			avail = size - pos;
+		memcpy(ptr, data + pos, avail);
+		gnutv_ring_write_commit(ring, gnutv_data_shed(ptr, avail));
+		pos += avail;
+	}
+}
+
+/**
+ * Move one mapped DVR buffer into the ring.
+ *
+ * @return 0 to carry on, -1 if the DVR failed.
+ */
+static int gnutv_data_drain_stream(struct dvbdemux_stream *stream)
+{
+	uint8_t *data;
+	int size;
+
+	size = dvbdemux_stream_get(stream, &data);
+	gnutv_data_dvr_account(DRAIN_READ_SIZE, size);
+	if (size < 0) {
+		if ((errno == EINTR) || (errno == EAGAIN))
+			return 0;
+		if (errno == EOVERFLOW) {
+			fprintf(stderr, "DVR overflow\n");
+			return 0;
+		}
+		fprintf(stderr, "DVR device read failure\n");
+		return -1;
+	}
+
+	// the kernel's buffer stays ours until released, so it may take a few goes
+	gnutv_data_ring_put(data, size);
+	dvbdemux_stream_release(stream);
+	return 0;
+}
+
+static void gnutv_data_standby_output(void *arg, const uint8_t *buf, int size)
+{
+	(void) arg;
+	gnutv_data_ring_put(buf, size);
+}
+
+/**
+ * With -standby, read both DVRs and let the standby pass one stream on into
+ * the ring.
+ */
+static void gnutv_data_drain_standby(void)
+{
+	static uint8_t buf[DRAIN_READ_SIZE];
+	struct pollfd pollfds[2];
+	int64_t now;
+	int size;
+	int i;
+
+	pollfds[GNUTV_STANDBY_PRIMARY].fd = dvrfd;
+	pollfds[GNUTV_STANDBY_SECONDARY].fd = gnutv_standby_fd(standby);
+	for(i=0; i < 2; i++)
+		pollfds[i].events = POLLIN|POLLPRI|POLLERR;
+
+	while(!outputthread_shutdown) {
+		if (poll(pollfds, 2, GNUTV_STANDBY_STALL_MS / 2) == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "DVR device poll failure\n");
+			return;
+		}
+
+		now = gnutv_data_now() / 1000000;
+		for(i=0; i < 2; i++) {
+			if (!pollfds[i].revents)
+				continue;
+
+			size = read(pollfds[i].fd, buf, sizeof(buf));
+			if (i == GNUTV_STANDBY_PRIMARY)
+				gnutv_data_dvr_account(sizeof(buf), size);
+			if (size < 0) {
+				if ((errno == EINTR) || (errno == EAGAIN))
+					continue;
+				if (errno == EOVERFLOW) {
+					fprintf(stderr, "%s overflow\n", i ? "Standby DVR" : "DVR");
+					continue;
+				}
+				fprintf(stderr, "%s device read failure\n", i ? "Standby DVR" : "DVR");
+				return;
+			}
+			gnutv_standby_input(standby, i, buf, size, now);
+		}
+		gnutv_standby_check(standby, gnutv_dvb_locked(), now);
+	}
+}
+
+/**
+ * Keep the DVR empty, whatever the output thread is doing: the data goes
+ * into the ring, or (with the drop policy) is thrown away when that is full.
+ * The drain thread is the DVR's only reader, so it streams it from mapped
+ * kernel buffers where the kernel has them.
+ */
+static void *drainthread_func(void* arg)
+{
+	(void)arg;
+	static uint8_t discard[DRAIN_READ_SIZE];
+	struct gnutv_ring_stats stats;
+	struct dvbdemux_stream *stream;
+	size_t next_warning;
+	size_t avail;
+	uint8_t *ptr;
+	int result;
+	int size;
+
+	gnutv_ring_get_stats(ring, &stats);
+	next_warning = stats.size / 2;
+
+	if (standby) {
+		gnutv_data_drain_standby();
+		gnutv_ring_close(ring);
+		return 0;
+	}
+
+	if (((stream = dvbdemux_stream_open(dvrfd, 0, DRAIN_READ_SIZE)) != NULL) &&
+	    !dvbdemux_stream_mapped(stream)) {
+		dvbdemux_stream_close(stream);
+		stream = NULL;
+	}
+
+	while(!outputthread_shutdown) {
+		if ((result = gnutv_data_wait(dvrfd)) <= 0) {
+			if (result < 0)
+				break;
+			continue;
+		}
+
+		if (stream != NULL) {
+			if (gnutv_data_drain_stream(stream) < 0)
+				break;
+			goto check;
+		}
+
+		if ((ptr = gnutv_ring_write_ptr(ring, &avail, 100)) == NULL) {
+			// still full when blocking: try again, the DVR buffers meanwhile
+			if (!ring_drop)
+				continue;
+			ptr = discard;
+			avail = sizeof(discard);
+		}
+		if (avail > DRAIN_READ_SIZE)
+			avail = DRAIN_READ_SIZE;
+
+		size = read(dvrfd, ptr, avail);
+		gnutv_data_dvr_account(avail, size);
+		if (size < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno == EOVERFLOW) {
+				// The error flag has been cleared, next read should succeed.
+				fprintf(stderr, "DVR overflow\n");
+				continue;
+			}
+
+			fprintf(stderr, "DVR device read failure\n");
+			break;
+		}
+
+		if (size == 0)
+			continue;
+		if (ptr == discard) {
+			gnutv_ring_dropped(ring, size);
+			continue;
+		}
+		gnutv_ring_write_commit(ring, gnutv_data_shed(ptr, size));
+
+check:
+		// report each new high water mark past half full, in 10% steps
+		gnutv_ring_get_stats(ring, &stats);
+		if (stats.high_water >= next_warning) {
+			gnutv_data_print_ring_stats("DVR ring filling up");
+			next_warning = stats.high_water + stats.size / 10;
+		}
+	}
+
+	if (stream != NULL)
+		dvbdemux_stream_close(stream);
+	gnutv_ring_close(ring);
+	return 0;
+}
+
+static int gnutv_data_create_decoder_filter(int adapter, int demux, uint16_t pid, int pestype)
+{
+	int demux_fd = -1;
 
 	// open the demuxer
 	if ((demux_fd = dvbdemux_open_demux(adapter, demux, 0)) < 0) {
@@ -389,7 +2852,7 @@ static int gnutv_data_create_dvr_filter(int adapter, int demux, uint16_t pid)
 	}
 
 	// create a section filter
-	if (dvbdemux_set_pid_filter(demux_fd, pid, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DVR, 1)) {
+	if (dvbdemux_set_pes_filter(demux_fd, pid, DVBDEMUX_INPUT_FRONTEND, DVBDEMUX_OUTPUT_DECODER, pestype, 1)) {
 		close(demux_fd);
 		return -1;
 	}
@@ -398,6 +2861,26 @@ static int gnutv_data_create_dvr_filter(int adapter, int demux, uint16_t pid)
 	return demux_fd;
 }
 
+static void gnutv_data_decoder_pid(int pid, int pestype)
+{
+	int i = gnutv_data_find_pid_fd(-1, pestype);
+
+	if (i != -1) {
+		if (pid_fds[i].pid == pid)
+			return;
+		gnutv_data_remove_pid_fd(i);
+	}
+	if (pid == -1)
+		return;
+
+	int fd = gnutv_data_create_decoder_filter(adapter_id, demux_id, pid, pestype);
+	if (fd < 0) {
+		fprintf(stderr, "Unable to create dvr filter for PID %i\n", pid);
+	} else {
+		gnutv_data_append_pid_fd(pid, fd, pestype);
+	}
+}
+
 static void gnutv_data_decoder_pmt(struct mpeg_pmt_section *pmt)
 {
 	int audio_pid = -1;
@@ -417,54 +2900,116 @@ static void gnutv_data_decoder_pmt(struct mpeg_pmt_section *pmt)
 		}
 	}
 
-	if (audio_pid != -1) {
-		int fd = gnutv_data_create_decoder_filter(adapter_id, demux_id, audio_pid, DVBDEMUX_PESTYPE_AUDIO);
-		if (fd < 0) {
-			fprintf(stderr, "Unable to create dvr filter for PID %i\n", audio_pid);
-		} else {
-			gnutv_data_append_pid_fd(audio_pid, fd);
-		}
-	}
-	if (video_pid != -1) {
-		int fd = gnutv_data_create_decoder_filter(adapter_id, demux_id, video_pid, DVBDEMUX_PESTYPE_VIDEO);
-		if (fd < 0) {
-			fprintf(stderr, "Unable to create dvr filter for PID %i\n", video_pid);
-		} else {
-			gnutv_data_append_pid_fd(video_pid, fd);
-		}
-	}
-	int fd = gnutv_data_create_decoder_filter(adapter_id, demux_id, pmt->pcr_pid, DVBDEMUX_PESTYPE_PCR);
-	if (fd < 0) {
-		fprintf(stderr, "Unable to create dvr filter for PID %i\n", pmt->pcr_pid);
+	gnutv_data_decoder_pid(audio_pid, DVBDEMUX_PESTYPE_AUDIO);
+	gnutv_data_decoder_pid(video_pid, DVBDEMUX_PESTYPE_VIDEO);
+	gnutv_data_decoder_pid(pmt->pcr_pid, DVBDEMUX_PESTYPE_PCR);
+}
+
+static void gnutv_data_dvr_add_pid(int pid)
+{
+	if (remux && (gnutv_remux_map(remux, pid) == GNUTV_REMUX_DROP))
+		return;
+
+	if (gnutv_data_pidset_add(pid)) {
+		fprintf(stderr, "Unable to create dvr filter for PID %i\n", pid);
 	} else {
-		gnutv_data_append_pid_fd(pmt->pcr_pid, fd);
+		gnutv_data_append_pid_fd(pid, -1, -1);
+	}
+}
+
+static void gnutv_data_dvr_pmt_stream(void *private, int change,
+				      struct mpeg_pmt_stream *old_stream,
+				      struct mpeg_pmt_stream *new_stream)
+{
+	int i;
+
+	(void) private;
+
+	// a stream whose type or descriptors changed keeps its filter
+	switch(change) {
+	case MPEG_PMT_DIFF_REMOVED:
+		if ((i = gnutv_data_find_pid_fd(old_stream->pid, -1)) != -1)
+			gnutv_data_remove_pid_fd(i);
+		break;
+
+	case MPEG_PMT_DIFF_ADDED:
+		gnutv_data_dvr_add_pid(new_stream->pid);
+		break;
 	}
 }
 
 static void gnutv_data_dvr_pmt(struct mpeg_pmt_section *pmt)
 {
 	struct mpeg_pmt_stream *cur_stream;
-	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
-		int fd = gnutv_data_create_dvr_filter(adapter_id, demux_id, cur_stream->pid);
-		if (fd < 0) {
-			fprintf(stderr, "Unable to create dvr filter for PID %i\n", cur_stream->pid);
-		} else {
-			gnutv_data_append_pid_fd(cur_stream->pid, fd);
+	size_t len = section_ext_length(&pmt->head) + CRC_SIZE;
+
+	if (pid_fds_pmt) {
+		mpeg_pmt_section_diff(pid_fds_pmt, pmt, gnutv_data_dvr_pmt_stream, NULL);
+		free(pid_fds_pmt);
+	} else {
+		mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+			gnutv_data_dvr_add_pid(cur_stream->pid);
 		}
 	}
+
+	// keep it to compare the next version with
+	if ((pid_fds_pmt = malloc(len)) == NULL) {
+		fprintf(stderr, "Out of memory when saving the PMT\n");
+		exit(1);
+	}
+	memcpy(pid_fds_pmt, pmt, len);
 }
 
-static void gnutv_data_append_pid_fd(int pid, int fd)
+static void gnutv_data_append_pid_fd(int pid, int fd, int type)
 {
-	struct pid_fd *tmp;
-	if ((tmp = realloc(pid_fds, (pid_fds_count +1) * sizeof(struct pid_fd))) == NULL) {
-		fprintf(stderr, "Out of memory when adding a new pid_fd\n");
-		exit(1);
+	if (pid_fds_count == pid_fds_size) {
+		int size = pid_fds_size ? pid_fds_size * 2 : 16;
+		struct pid_fd *tmp;
+
+		if ((tmp = realloc(pid_fds, size * sizeof(struct pid_fd))) == NULL) {
+			fprintf(stderr, "Out of memory when adding a new pid_fd\n");
+			exit(1);
+		}
+		pid_fds = tmp;
+		pid_fds_size = size;
 	}
-	tmp[pid_fds_count].pid = pid;
-	tmp[pid_fds_count].fd = fd;
+	pid_fds[pid_fds_count].pid = pid;
+	pid_fds[pid_fds_count].fd = fd;
+	pid_fds[pid_fds_count].type = type;
 	pid_fds_count++;
-	pid_fds = tmp;
+}
+
+/**
+ * Find a PID filter.
+ *
+ * @param pid The PID, or -1 for any.
+ * @param type Its type.
+ * @return Its index in pid_fds, or -1 if there is none.
+ */
+static int gnutv_data_find_pid_fd(int pid, int type)
+{
+	int i;
+
+	for(i=0; i < pid_fds_count; i++) {
+		if (((pid == -1) || (pid_fds[i].pid == pid)) && (pid_fds[i].type == type))
+			return i;
+	}
+	return -1;
+}
+
+static void gnutv_data_close_pid_fd(struct pid_fd *pid_fd)
+{
+	if (pid_fd->fd == -1)
+		gnutv_data_pidset_remove(pid_fd->pid);
+	else
+		close(pid_fd->fd);
+}
+
+static void gnutv_data_remove_pid_fd(int i)
+{
+	gnutv_data_close_pid_fd(pid_fds + i);
+	memmove(pid_fds + i, pid_fds + i + 1, (pid_fds_count - i - 1) * sizeof(struct pid_fd));
+	pid_fds_count--;
 }
 
 static void gnutv_data_free_pid_fds()
@@ -472,12 +3017,16 @@ static void gnutv_data_free_pid_fds()
 	if (pid_fds_count) {
 		int i;
 		for(i=0; i< pid_fds_count; i++) {
-			close(pid_fds[i].fd);
+			gnutv_data_close_pid_fd(pid_fds + i);
 		}
 	}
 	if (pid_fds)
 		free(pid_fds);
 
 	pid_fds_count = 0;
+	pid_fds_size = 0;
 	pid_fds = NULL;
+
+	free(pid_fds_pmt);
+	pid_fds_pmt = NULL;
 }
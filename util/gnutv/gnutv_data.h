@@ -23,17 +23,201 @@
 #ifndef gnutv_DATA_H
 #define gnutv_DATA_H 1
 
+#include <stdint.h>
 #include <netdb.h>
 
 extern void gnutv_data_start(int output_type,
 			   int ffaudiofd, int adapter_id, int demux_id, int buffer_size,
 			   char *outfile,
-			   char* outif, struct addrinfo *outaddrs, int usertp);
+			   char* outif, struct addrinfo *outaddrs, int usertp,
+			   int pace_ms, int usetxtime, int ring_size, int ring_drop,
+			   int ring_hugepages, int stats_interval, int timeshift_mb);
 extern void gnutv_data_stop(void);
 
-extern void gnutv_data_new_pat(int pmt_pid);
+/**
+ * Add a service to stream with OUTPUT_TYPE_MULTI; call before
+ * gnutv_data_start(). type is OUTPUT_TYPE_FILE (outfile is used) or
+ * OUTPUT_TYPE_UDP (outif, addrs and rtp are used). addrs is freed by
+ * gnutv_data_stop().
+ *
+ * @return 0 on success, -1 on failure.
+ */
+extern int gnutv_data_add_service(int service_id, int type, char *outfile,
+				  char *outif, struct addrinfo *addrs, int rtp);
+
+/**
+ * Pass the output (file, stdout, timeshift, segment, udp/rtp or http) through a remux (see
+ * gnutv_remux.h), which gnutv_data_stop() destroys; call before
+ * gnutv_data_start().
+ */
+struct gnutv_remux;
+extern void gnutv_data_set_remux(struct gnutv_remux *remux);
+
+/**
+ * Target segment length in seconds of OUTPUT_TYPE_SEGMENT (see
+ * gnutv_segment.h); call before gnutv_data_start().
+ */
+extern void gnutv_data_set_segment(int duration);
+
+/**
+ * Split OUTPUT_TYPE_FILE into files every seconds, or of at most bytes,
+ * cut before a keyframe if keyframe is 1 (see gnutv_rotate.h); call before
+ * gnutv_data_start(). Both 0 for a single file.
+ */
+extern void gnutv_data_set_rotate(int seconds, uint64_t bytes, int keyframe);
+
+/**
+ * Record -service file outputs through a store (see gnutv_store.h), which
+ * stays the caller's; call before gnutv_data_start().
+ */
+struct gnutv_store;
+extern void gnutv_data_set_store(struct gnutv_store *store);
+
+/**
+ * Write file/stdout output as 192 byte packets, each with a 27 MHz arrival
+ * timestamp (see dvbdemux_tts_stamp()); call before gnutv_data_start().
+ */
+extern void gnutv_data_set_tts(int tts);
+
+/**
+ * The server (see gnutv_http.h) for OUTPUT_TYPE_HTTP, which
+ * gnutv_data_stop() stops; call before gnutv_data_start().
+ */
+struct gnutv_http;
+extern void gnutv_data_set_http(struct gnutv_http *http);
+
+/**
+ * Options of udp/rtp output; call before gnutv_data_start().
+ *
+ * @param nonull Remove null packets. With RTP, each datagram says how many
+ * were removed before each of its packets, in a header extension.
+ * @param mtu Fill datagrams up to this size in bytes, -1 for the MTU of
+ * the route, or 0 for the usual 7 TS packets.
+ */
+extern void gnutv_data_set_udp(int nonull, int mtu);
+
+/**
+ * SMPTE 2022-1 FEC (see gnutv_fec.h) for rtp output, sent to the media
+ * port + 2 (columns) and + 4 (rows); call before gnutv_data_start().
+ *
+ * @param columns L, 0 for no FEC.
+ * @param rows D.
+ * @param row Send row FEC as well.
+ */
+extern void gnutv_data_set_fec(int columns, int rows, int row);
+
+/**
+ * Send udp/rtp output to IPv4 multicast groups through AF_XDP (see
+ * gnutv_xdp.h) rather than the kernel; call before gnutv_data_start(), or
+ * before creating outputs with gnutv_data_udp_new(). NULL for the kernel.
+ */
+struct gnutv_xdp;
+extern void gnutv_data_set_xdp(struct gnutv_xdp *xdp);
+
+/**
+ * The sinks of OUTPUT_TYPE_TEE (see gnutv_tee.h), which gnutv_data_stop()
+ * destroys; call before gnutv_data_start().
+ */
+struct gnutv_tee;
+extern void gnutv_data_set_tee(struct gnutv_tee *tee);
+
+/**
+ * Merge the DVR with that of a standby tuner (see gnutv_standby.h), which
+ * gnutv_data_stop() destroys; call before gnutv_data_start(). Outputs fed
+ * from the ring only: not the decoder or dvr ones.
+ */
+struct gnutv_standby;
+extern void gnutv_data_set_standby(struct gnutv_standby *standby);
+
+/**
+ * Watch what is read for a CAM which has stopped descrambling, with a
+ * monitor (see gnutv_monitor.h) which gnutv_data_stop() destroys; call
+ * before gnutv_data_start(). Single service outputs only.
+ */
+struct gnutv_monitor;
+extern void gnutv_data_set_monitor(struct gnutv_monitor *monitor);
+
+/**
+ * Shed the less important streams as the -ring fills (see gnutv_shed.h),
+ * with a shedder which gnutv_data_stop() destroys; call before
+ * gnutv_data_start(). A ring is made if there isn't one. Single service
+ * outputs fed from the ring only.
+ */
+struct gnutv_shed;
+extern void gnutv_data_set_shed(struct gnutv_shed *shed);
+
+extern void gnutv_data_new_pat(int transport_stream_id, int program_number, int pmt_pid);
 extern int gnutv_data_new_pmt(struct mpeg_pmt_section *pmt);
 
+/*
+ * Helpers shared with the daemon (gnutv_server.c), which regenerates the PSI
+ * of each of its jobs the same way as -service does.
+ */
+#define GNUTV_DATA_PAT_SIZE 16
+#define GNUTV_DATA_MAX_PMT 1024
+
+struct udp_output;
+struct mpeg_pmt_section;
+
+/**
+ * Build a PAT section holding nothing but one program.
+ *
+ * @return GNUTV_DATA_PAT_SIZE, the length of the section.
+ */
+extern int gnutv_data_build_pat(uint8_t *sec, int transport_stream_id, int program_number,
+				int pmt_pid, int version);
+
+/**
+ * Re-encode a PMT into sec, which has room for GNUTV_DATA_MAX_PMT bytes.
+ * With a pid_map (see gnutv_remux.h), the PIDs are renumbered through it
+ * and the streams it drops left out.
+ *
+ * @return Length of the section, or -1 if it doesn't fit.
+ */
+extern int gnutv_data_build_pmt(uint8_t *sec, struct mpeg_pmt_section *pmt,
+				const uint16_t *pid_map);
+
+/**
+ * Cut a section up into TS packets on pid.
+ *
+ * @return Number of bytes of packets put into buf.
+ */
+extern int gnutv_data_packetise(uint8_t *buf, int pid, uint8_t *cc, uint8_t *section, int len);
+
+/**
+ * write() all of buf, dropping O_DIRECT if *direct is set and the write
+ * turns out not to be suitable for it.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+extern int gnutv_data_write(int fd, uint8_t *buf, int size, int *direct);
+
+/**
+ * Create an unpaced UDP/RTP output on a socket; free() it when done.
+ *
+ * @return The output, or NULL if out of memory.
+ */
+extern struct udp_output *gnutv_data_udp_new(int fd, struct addrinfo *addr, int rtp);
+
+/**
+ * The most TS data one gnutv_data_udp_send() may be given: a batch of 48
+ * datagrams.
+ */
+#define GNUTV_DATA_UDP_MAX_SEND (48 * 7 * 188)
+
+/**
+ * Send TS data as datagrams of 7 packets; size should be a multiple of
+ * that, except at the very end.
+ *
+ * @return 0 on success, -1 on a send error.
+ */
+extern int gnutv_data_udp_send(struct udp_output *out, uint8_t *buf, int size);
+
+/**
+ * The RTP SSRC of an output, for its RTCP.
+ */
+extern uint32_t gnutv_data_udp_ssrc(struct udp_output *out);
+
 
 
 #endif
@@ -27,44 +27,118 @@
 #include <signal.h>
 #include <pthread.h>
 #include <errno.h>
-#include <sys/poll.h>
+#include <time.h>
 #include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvblatency.h>
 #include <libucsi/section.h>
 #include <libucsi/mpeg/section.h>
 #include <libucsi/dvb/section.h>
+#include <libdvbmisc/dvbreactor.h>
 #include "gnutv.h"
 #include "gnutv_dvb.h"
 #include "gnutv_data.h"
 #include "gnutv_ca.h"
+#include "gnutv_affinity.h"
 
 #define FE_STATUS_PARAMS (DVBFE_INFO_LOCKSTATUS|DVBFE_INFO_SIGNAL_STRENGTH|DVBFE_INFO_BER|DVBFE_INFO_SNR|DVBFE_INFO_UNCORRECTED_BLOCKS)
 
-static int dvbthread_shutdown = 0;
+// how often the status line is updated until the frontend locks (ms)
+#define STATUS_INTERVAL 500
+
+// how often a locked frontend's status is read, for drivers which raise no
+// event when they lose lock (ms)
+#define LOCK_WATCH_INTERVAL 250
+
+// after losing lock: how often the status is read, how long the
+// demodulator gets to relock by itself, and how long each retune gets
+// before the next. Retunes reuse the parameters it last locked with and
+// leave the SEC alone, except every RETUNE_FULL_EVERYth, which retunes as
+// at the start (ms)
+#define REACQUIRE_INTERVAL 50
+#define RELOCK_GRACE 150
+#define RETUNE_FAST_WAIT 400
+#define RETUNE_FULL_WAIT 1500
+#define RETUNE_FULL_EVERY 4
+
+struct pmt_filter {
+	struct gnutv_dvb_params *params;
+	int service;			// index into params->service_ids
+	int fd;
+	int pid;
+};
+
+static struct dvbreactor *reactor;
 static pthread_t dvbthread;
-static int tune_state = 0;
+static int tune_state = 0;		// 1 => tuning, 2 => locked, 3 => lost lock
+static struct dvbreactor_timer *status_timer = NULL;
+static struct dvbreactor_timer *lock_timer = NULL;		// watching the lock, or reacquiring it
+
+// the parameters the frontend locked with, for fast retunes
+static struct dvbfe_parameters locked_params;
+static int have_locked_params = 0;
+
+// the current outage, and all of them
+static int64_t outage_start;
+static int64_t next_retune;
+static int outage_retunes;
+static struct {
+	int count;
+	int retunes;
+	int64_t total_ms;
+	int64_t longest_ms;
+} outages;
+
+static int pat_filter_fd = -1;
+static int tdt_filter_fd = -1;
+static struct pmt_filter pmt_filters[GNUTV_MAX_SERVICES];
 
 static int pat_version = -1;
 static int ca_pmt_version = -1;
-static int data_pmt_version = -1;
+static int data_pmt_version[GNUTV_MAX_SERVICES];
 
 static void *dvbthread_func(void* arg);
 
-static void process_pat(int pat_fd, struct gnutv_dvb_params *params, int *pmt_fd, struct pollfd *pollfd);
+static void tune(struct gnutv_dvb_params *params);
+static void show_status(struct gnutv_dvb_params *params);
+static void status_tick(void *arg, uint32_t events);
+static void frontend_event(void *arg, uint32_t events);
+static void lock_gained(struct gnutv_dvb_params *params);
+static void lock_tick(void *arg, uint32_t events);
+static void check_lock(struct gnutv_dvb_params *params);
+static void pat_ready(void *arg, uint32_t events);
+static void tdt_ready(void *arg, uint32_t events);
+static void pmt_ready(void *arg, uint32_t events);
+static void process_pat(int pat_fd, struct gnutv_dvb_params *params);
 static void process_tdt(int tdt_fd);
-static void process_pmt(int pmt_fd, struct gnutv_dvb_params *params);
+static void process_pmt(int pmt_fd, struct gnutv_dvb_params *params, int service);
+static int add_section_filter(struct gnutv_dvb_params *params, uint16_t pid, uint8_t table_id,
+			      dvbreactor_callback callback, void *arg);
+static void remove_section_filter(int fd);
 static int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t table_id);
+static void watch_section_filter(int fd, uint16_t pid, uint8_t table_id, int table_id_ext, int version);
 
 
 int gnutv_dvb_start(struct gnutv_dvb_params *params)
 {
-	pthread_create(&dvbthread, NULL, dvbthread_func, (void*) params);
+	if ((reactor = dvbreactor_create()) == NULL) {
+		fprintf(stderr, "Failed to create DVB event loop\n");
+		exit(1);
+	}
+
+	gnutv_affinity_thread_create(&dvbthread, GNUTV_THREAD_NORMAL, dvbthread_func, (void*) params);
 	return 0;
 }
 
 void gnutv_dvb_stop(void)
 {
-	dvbthread_shutdown = 1;
+	dvbreactor_stop(reactor);
 	pthread_join(dvbthread, NULL);
+	dvbreactor_destroy(reactor);
+
+	if (outages.count)
+		fprintf(stderr, "Lost lock %i times: %lli ms without lock, longest %lli ms, %i retunes\n",
+			outages.count, (long long) outages.total_ms, (long long) outages.longest_ms,
+			outages.retunes);
 }
 
 int gnutv_dvb_locked(void)
@@ -72,154 +146,320 @@ int gnutv_dvb_locked(void)
 	return tune_state == 2;
 }
 
+/*
+ * Everything in the DVB thread is driven by its reactor: the section
+ * filters, frontend events, and the status timer. More tables only need
+ * another add_section_filter().
+ */
 static void *dvbthread_func(void* arg)
 {
-	int pat_fd = -1;
-	int pmt_fd = -1;
-	int tdt_fd = -1;
-	struct pollfd pollfds[3];
+	int i;
 
 	struct gnutv_dvb_params *params = (struct gnutv_dvb_params *) arg;
 
 	tune_state = 0;
+	for(i=0; i < params->service_count; i++) {
+		pmt_filters[i].params = params;
+		pmt_filters[i].service = i;
+		pmt_filters[i].fd = -1;
+		pmt_filters[i].pid = -1;
+		data_pmt_version[i] = -1;
+	}
 
 	// create PAT filter
-	if ((pat_fd = create_section_filter(params->adapter_id, params->demux_id,
-	     TRANSPORT_PAT_PID, stag_mpeg_program_association)) < 0) {
+	if ((pat_filter_fd = add_section_filter(params, TRANSPORT_PAT_PID, stag_mpeg_program_association,
+					 pat_ready, params)) < 0) {
 		fprintf(stderr, "Failed to create PAT section filter\n");
 		exit(1);
 	}
-	pollfds[0].fd = pat_fd;
-	pollfds[0].events = POLLIN|POLLPRI|POLLERR;
 
 	// create TDT filter
-	if ((tdt_fd = create_section_filter(params->adapter_id, params->demux_id, TRANSPORT_TDT_PID, stag_dvb_time_date)) < 0) {
+	if ((tdt_filter_fd = add_section_filter(params, TRANSPORT_TDT_PID, stag_dvb_time_date,
+					 tdt_ready, params)) < 0) {
 		fprintf(stderr, "Failed to create TDT section filter\n");
 		exit(1);
 	}
-	pollfds[1].fd = tdt_fd;
-	pollfds[1].events = POLLIN|POLLPRI|POLLERR;
 
-	// zero PMT filter
-	pollfds[2].fd = 0;
-	pollfds[2].events = 0;
+	// tune frontend, then follow its lock status through its events; a
+	// read only frontend gets no events, the status timer has to do
+	tune(params);
+	if ((!params->notune) &&
+	    dvbreactor_add(reactor, dvbfe_get_pollfd(params->fe), EPOLLIN|EPOLLPRI,
+			      frontend_event, params)) {
+		fprintf(stderr, "Failed to watch frontend events\n");
+		exit(1);
+	}
+	status_timer = dvbreactor_add_timer(reactor, STATUS_INTERVAL, STATUS_INTERVAL, status_tick, params);
+	show_status(params);
 
 	// the DVB loop
-	while(!dvbthread_shutdown) {
-		// tune frontend + monitor lock status
-		if (tune_state == 0) {
-			// get the type of frontend
-			struct dvbfe_info result;
-			char *types;
-			memset(&result, 0, sizeof(result));
-			dvbfe_get_info(params->fe, 0, &result, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
-			switch(result.type) {
-			case DVBFE_TYPE_DVBS:
-				types = "DVB-S";
-				break;
-			case DVBFE_TYPE_DVBC:
-				types = "DVB-C";
-				break;
-			case DVBFE_TYPE_DVBT:
-				types = "DVB-T";
-				break;
-			case DVBFE_TYPE_ATSC:
-				types = "ATSC";
-				break;
-			default:
-				types = "Unknown";
-			}
-			fprintf(stderr, "Using frontend \"%s\", type %s\n", result.name, types);
-
-			// do we have a valid SEC configuration?
-			struct dvbsec_config *sec = NULL;
-			if (params->valid_sec)
-				sec = &params->sec;
-
-			// tune!
-			if (dvbsec_set(params->fe,
-			    		  sec,
-					  params->channel.polarization,
-					  (params->channel.diseqc_switch & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
-					  (params->channel.diseqc_switch & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
-					  &params->channel.fe_params,
-					  0)) {
-				fprintf(stderr, "Failed to set frontend\n");
-				exit(1);
-			}
+	dvbreactor_run(reactor);
 
-			tune_state++;
-		} else if (tune_state == 1) {
-			struct dvbfe_info result;
-			memset(&result, 0, sizeof(result));
-			dvbfe_get_info(params->fe,
-				       FE_STATUS_PARAMS,
-				       &result,
-				       DVBFE_INFO_QUERYTYPE_IMMEDIATE,
-				       0);
-
-			fprintf(stderr, "status %c%c%c%c%c | signal %04x | snr %04x | ber %08x | unc %08x | %s\r",
-				result.signal ? 'S' : ' ',
-				result.carrier ? 'C' : ' ',
-				result.viterbi ? 'V' : ' ',
-				result.sync ? 'Y' : ' ',
-				result.lock ? 'L' : ' ',
-				result.signal_strength,
-				result.snr,
-				result.ber,
-				result.ucblocks,
-				result.lock ? "FE_HAS_LOCK" : "");
-			fflush(stderr);
-
-			if (result.lock) {
-				tune_state++;
-				fprintf(stderr, "\n");
-				fflush(stderr);
-			} else {
-				usleep(500000);
-			}
-		}
+	// close demuxers
+	if (status_timer)
+		dvbreactor_remove_timer(reactor, status_timer);
+	if (lock_timer)
+		dvbreactor_remove_timer(reactor, lock_timer);
+	if (!params->notune)
+		dvbreactor_remove(reactor, dvbfe_get_pollfd(params->fe));
+	remove_section_filter(pat_filter_fd);
+	for(i=0; i < params->service_count; i++) {
+		if (pmt_filters[i].fd != -1)
+			remove_section_filter(pmt_filters[i].fd);
+	}
+	remove_section_filter(tdt_filter_fd);
 
-		// is there SI data?
-		int count = poll(pollfds, 3, 100);
-		if (count < 0) {
-			if (errno != EINTR)
-				fprintf(stderr, "Poll error: %m\n");
-			break;
-		}
-		if (count == 0) {
-			continue;
-		}
+	return 0;
+}
 
-		// PAT
-		if (pollfds[0].revents & (POLLIN|POLLPRI)) {
-			process_pat(pat_fd, params, &pmt_fd, &pollfds[2]);
-		}
+static void tune(struct gnutv_dvb_params *params)
+{
+	// get the type of frontend
+	struct dvbfe_info result;
+	char *types;
+	memset(&result, 0, sizeof(result));
+	dvbfe_get_info(params->fe, 0, &result, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+	switch(result.type) {
+	case DVBFE_TYPE_DVBS:
+		types = "DVB-S";
+		break;
+	case DVBFE_TYPE_DVBC:
+		types = "DVB-C";
+		break;
+	case DVBFE_TYPE_DVBT:
+		types = "DVB-T";
+		break;
+	case DVBFE_TYPE_ATSC:
+		types = "ATSC";
+		break;
+	default:
+		types = "Unknown";
+	}
+	fprintf(stderr, "Using frontend \"%s\", type %s\n", result.name, types);
 
-		// TDT
-		if (pollfds[1].revents & (POLLIN|POLLPRI)) {
-			process_tdt(tdt_fd);
-		}
+	// someone else has it on the multiplex already
+	if (params->notune) {
+		fprintf(stderr, "Sharing the frontend, not tuning it\n");
+		tune_state++;
+		return;
+	}
+
+	// do we have a valid SEC configuration?
+	struct dvbsec_config *sec = NULL;
+	if (params->valid_sec)
+		sec = &params->sec;
+
+	// tune!
+	if (dvbsec_set(params->fe,
+		       sec,
+		       params->channel.polarization,
+		       (params->channel.diseqc_switch & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       (params->channel.diseqc_switch & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       &params->channel.fe_params,
+		       0)) {
+		fprintf(stderr, "Failed to set frontend\n");
+		exit(1);
+	}
+
+	tune_state++;
+}
 
-		//  PMT
-		if (pollfds[2].revents & (POLLIN|POLLPRI)) {
-			process_pmt(pmt_fd, params);
+static void show_status(struct gnutv_dvb_params *params)
+{
+	struct dvbfe_info result;
+	memset(&result, 0, sizeof(result));
+	dvbfe_get_info(params->fe,
+		       FE_STATUS_PARAMS,
+		       &result,
+		       DVBFE_INFO_QUERYTYPE_IMMEDIATE,
+		       0);
+
+	fprintf(stderr, "status %c%c%c%c%c | signal %04x | snr %04x | ber %08x | unc %08x | %s\r",
+		result.signal ? 'S' : ' ',
+		result.carrier ? 'C' : ' ',
+		result.viterbi ? 'V' : ' ',
+		result.sync ? 'Y' : ' ',
+		result.lock ? 'L' : ' ',
+		result.signal_strength,
+		result.snr,
+		result.ber,
+		result.ucblocks,
+		result.lock ? "FE_HAS_LOCK" : "");
+	fflush(stderr);
+
+	// locked: no more status updates
+	if (result.lock) {
+		tune_state++;
+		fprintf(stderr, "\n");
+		fflush(stderr);
+		if (status_timer) {
+			dvbreactor_remove_timer(reactor, status_timer);
+			status_timer = NULL;
 		}
+		lock_gained(params);
 	}
+}
 
-	// close demuxers
-	if (pat_fd != -1)
-		close(pat_fd);
-	if (pmt_fd != -1)
-		close(pmt_fd);
-	if (tdt_fd != -1)
-		close(tdt_fd);
+static int64_t now_ms(void)
+{
+	struct timespec ts;
 
-	return 0;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static void set_lock_timer(struct gnutv_dvb_params *params, int interval)
+{
+	if (lock_timer)
+		dvbreactor_remove_timer(reactor, lock_timer);
+	lock_timer = dvbreactor_add_timer(reactor, interval, interval, lock_tick, params);
+}
+
+/*
+ * Locked, or locked again: remember what with, and watch for it going.
+ */
+static void lock_gained(struct gnutv_dvb_params *params)
+{
+	struct dvbfe_info result;
+
+	memset(&result, 0, sizeof(result));
+	if ((!params->notune) &&
+	    (dvbfe_get_info(params->fe, DVBFE_INFO_FEPARAMS, &result,
+			    DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) & DVBFE_INFO_FEPARAMS)) {
+		// what the AUTO values came out as; the system is as asked
+		locked_params = result.feparams;
+		locked_params.delivery_system = params->channel.fe_params.delivery_system;
+		locked_params.stream_id = params->channel.fe_params.stream_id;
+		have_locked_params = 1;
+	}
+
+	set_lock_timer(params, LOCK_WATCH_INTERVAL);
 }
 
-static void process_pat(int pat_fd, struct gnutv_dvb_params *params, int *pmt_fd, struct pollfd *pollfd)
+static void lock_lost(struct gnutv_dvb_params *params)
 {
+	tune_state = 3;
+	outage_start = now_ms();
+	next_retune = outage_start + RELOCK_GRACE;
+	outage_retunes = 0;
+	outages.count++;
+	fprintf(stderr, "Lost lock\n");
+
+	set_lock_timer(params, REACQUIRE_INTERVAL);
+}
+
+static void lock_regained(struct gnutv_dvb_params *params)
+{
+	int64_t outage = now_ms() - outage_start;
+
+	tune_state = 2;
+	outages.total_ms += outage;
+	if (outage > outages.longest_ms)
+		outages.longest_ms = outage;
+	fprintf(stderr, "Lock regained after %lli ms, %i retunes\n", (long long) outage, outage_retunes);
+
+	lock_gained(params);
+}
+
+/*
+ * The section filters and DVR are left as they are throughout: they carry
+ * on with the same multiplex once it is back.
+ */
+static void retune(struct gnutv_dvb_params *params)
+{
+	struct dvbsec_config *sec = params->valid_sec ? &params->sec : NULL;
+	int full = (!have_locked_params) || ((outage_retunes % RETUNE_FULL_EVERY) == RETUNE_FULL_EVERY - 1);
+
+	outage_retunes++;
+	outages.retunes++;
+	if (full) {
+		dvbsec_set(params->fe,
+			   sec,
+			   params->channel.polarization,
+			   (params->channel.diseqc_switch & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+			   (params->channel.diseqc_switch & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+			   &params->channel.fe_params,
+			   0);
+		next_retune = now_ms() + RETUNE_FULL_WAIT;
+	} else {
+		dvbfe_set(params->fe, &locked_params, 0);
+		next_retune = now_ms() + RETUNE_FAST_WAIT;
+	}
+}
+
+static void check_lock(struct gnutv_dvb_params *params)
+{
+	struct dvbfe_info result;
+
+	memset(&result, 0, sizeof(result));
+	if (!(dvbfe_get_info(params->fe, DVBFE_INFO_LOCKSTATUS, &result,
+			     DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0) & DVBFE_INFO_LOCKSTATUS))
+		return;
+
+	if ((tune_state == 2) && !result.lock)
+		lock_lost(params);
+	else if ((tune_state == 3) && result.lock)
+		lock_regained(params);
+	else if ((tune_state == 3) && (!params->notune) && (now_ms() >= next_retune))
+		retune(params);
+}
+
+static void lock_tick(void *arg, uint32_t events)
+{
+	(void) events;
+	check_lock((struct gnutv_dvb_params *) arg);
+}
+
+static void status_tick(void *arg, uint32_t events)
+{
+	(void) events;
+
+	if (tune_state == 1)
+		show_status((struct gnutv_dvb_params *) arg);
+}
+
+static void frontend_event(void *arg, uint32_t events)
+{
+	struct gnutv_dvb_params *params = (struct gnutv_dvb_params *) arg;
+	struct dvbfe_info result;
+	(void) events;
+
+	// dequeue the event; a lock shows up right away, not at the next tick,
+	// and so does losing it. Events may be stale, so later on the status
+	// is read afresh
+	memset(&result, 0, sizeof(result));
+	dvbfe_get_info(params->fe, DVBFE_INFO_LOCKSTATUS, &result, DVBFE_INFO_QUERYTYPE_LOCKCHANGE, 0);
+	if ((tune_state == 1) && result.lock)
+		show_status(params);
+	else if (tune_state > 1)
+		check_lock(params);
+}
+
+static void pat_ready(void *arg, uint32_t events)
+{
+	(void) events;
+	process_pat(pat_filter_fd, (struct gnutv_dvb_params *) arg);
+}
+
+static void tdt_ready(void *arg, uint32_t events)
+{
+	(void) arg;
+	(void) events;
+	process_tdt(tdt_filter_fd);
+}
+
+static void pmt_ready(void *arg, uint32_t events)
+{
+	struct pmt_filter *filter = (struct pmt_filter *) arg;
+	(void) events;
+
+	process_pmt(filter->fd, filter->params, filter->service);
+}
+
+static void process_pat(int pat_fd, struct gnutv_dvb_params *params)
+{
+	int i;
+
 	int size;
 	uint8_t sibuf[4096];
 
@@ -248,34 +488,46 @@ static void process_pat(int pat_fd, struct gnutv_dvb_params *params, int *pmt_fd
 	if (pat == NULL) {
 		return;
 	}
+	dvblatency_mark(dvbfe_get_latency(params->fe), DVBLATENCY_FIRST_PAT);
 
-	// try and find the requested program
+	// try and find the requested programs
 	struct mpeg_pat_program *cur_program;
 	mpeg_pat_section_programs_for_each(pat, cur_program) {
-		if (cur_program->program_number == params->channel.service_id) {
-			// close old PMT fd
-			if (*pmt_fd != -1)
-				close(*pmt_fd);
+		for(i=0; i < params->service_count; i++) {
+			struct pmt_filter *filter = &pmt_filters[i];
+
+			if (cur_program->program_number != params->service_ids[i])
+				continue;
+
+			// the PMT hasn't moved: leave its filter running
+			if (cur_program->pid == filter->pid)
+				continue;
+
+			// close old PMT filter
+			if (filter->fd != -1) {
+				remove_section_filter(filter->fd);
+				filter->pid = -1;
+			}
 
 			// create PMT filter
-			if ((*pmt_fd = create_section_filter(params->adapter_id, params->demux_id,
-							     cur_program->pid, stag_mpeg_program_map)) < 0) {
+			if ((filter->fd = add_section_filter(params, cur_program->pid, stag_mpeg_program_map,
+							     pmt_ready, filter)) < 0) {
 				return;
 			}
-			pollfd->fd = *pmt_fd;
-			pollfd->events = POLLIN|POLLPRI|POLLERR;
+			filter->pid = cur_program->pid;
 
-			gnutv_data_new_pat(cur_program->pid);
+			gnutv_data_new_pat(pat->head.table_id_ext, cur_program->program_number, cur_program->pid);
 
-			// we have a new PMT pid
-			data_pmt_version = -1;
-			ca_pmt_version = -1;
-			break;
+			// we have a new PMT pid; only the first service is descrambled
+			data_pmt_version[i] = -1;
+			if (i == 0)
+				ca_pmt_version = -1;
 		}
 	}
 
-	// remember the PAT version
+	// remember the PAT version, and sleep until the next one
 	pat_version = section_ext->version_number;
+	watch_section_filter(pat_fd, TRANSPORT_PAT_PID, stag_mpeg_program_association, -1, pat_version);
 }
 
 static void process_tdt(int tdt_fd)
@@ -304,7 +556,7 @@ static void process_tdt(int tdt_fd)
 	gnutv_ca_new_dvbtime(dvbdate_to_unixtime(tdt->utc_time));
 }
 
-static void process_pmt(int pmt_fd, struct gnutv_dvb_params *params)
+static void process_pmt(int pmt_fd, struct gnutv_dvb_params *params, int service)
 {
 	int size;
 	uint8_t sibuf[4096];
@@ -325,9 +577,9 @@ static void process_pmt(int pmt_fd, struct gnutv_dvb_params *params)
 	if (section_ext == NULL) {
 		return;
 	}
-	if ((section_ext->table_id_ext != params->channel.service_id) ||
-	    ((section_ext->version_number == data_pmt_version) &&
-	     (section_ext->version_number == ca_pmt_version))) {
+	if ((section_ext->table_id_ext != params->service_ids[service]) ||
+	    ((section_ext->version_number == data_pmt_version[service]) &&
+	     ((service != 0) || (section_ext->version_number == ca_pmt_version)))) {
 		return;
 	}
 
@@ -336,18 +588,47 @@ static void process_pmt(int pmt_fd, struct gnutv_dvb_params *params)
 	if (pmt == NULL) {
 		return;
 	}
+	dvblatency_mark(dvbfe_get_latency(params->fe), DVBLATENCY_FIRST_PMT);
 
 	// do data handling
-	if (section_ext->version_number != data_pmt_version) {
+	if (section_ext->version_number != data_pmt_version[service]) {
 		if (gnutv_data_new_pmt(pmt) == 1)
-			data_pmt_version = pmt->head.version_number;
+			data_pmt_version[service] = pmt->head.version_number;
 	}
 
 	// do ca handling
-	if (section_ext->version_number != ca_pmt_version) {
+	if ((service == 0) && (section_ext->version_number != ca_pmt_version)) {
 		if (gnutv_ca_new_pmt(pmt) == 1)
 			ca_pmt_version = pmt->head.version_number;
 	}
+
+	// everything has this version: sleep until the next one
+	if ((data_pmt_version[service] == section_ext->version_number) &&
+	    ((service != 0) || (ca_pmt_version == section_ext->version_number)))
+		watch_section_filter(pmt_fd, pmt_filters[service].pid, stag_mpeg_program_map,
+				     params->service_ids[service], section_ext->version_number);
+}
+
+static int add_section_filter(struct gnutv_dvb_params *params, uint16_t pid, uint8_t table_id,
+			      dvbreactor_callback callback, void *arg)
+{
+	int fd;
+
+	if ((fd = create_section_filter(params->adapter_id, params->demux_id, pid, table_id)) < 0)
+		return -1;
+
+	if (dvbreactor_add(reactor, fd, EPOLLIN|EPOLLPRI|EPOLLERR, callback, arg)) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void remove_section_filter(int fd)
+{
+	dvbreactor_remove(reactor, fd);
+	close(fd);
 }
 
 static int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t table_id)
@@ -374,3 +655,27 @@ static int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t t
 	// done
 	return demux_fd;
 }
+
+/*
+ * Once a table has been dealt with, re-arm its filter to pass only other
+ * version_numbers, so a table which doesn't change no longer wakes the DVB
+ * thread every time it is repeated. If that fails, the filter just goes on
+ * passing everything.
+ */
+static void watch_section_filter(int fd, uint16_t pid, uint8_t table_id, int table_id_ext, int version)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = table_id;
+	mask[0] = 0xFF;
+	if (table_id_ext != -1) {
+		filter[3] = table_id_ext >> 8;
+		filter[4] = table_id_ext & 0xFF;
+		mask[3] = 0xFF;
+		mask[4] = 0xFF;
+	}
+	dvbdemux_set_section_filter_changed(fd, pid, filter, mask, version, 1, 1);
+}
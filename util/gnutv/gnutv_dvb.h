@@ -25,16 +25,20 @@
 
 #include <libdvbcfg/dvbcfg_zapchannel.h>
 #include <libdvbsec/dvbsec_api.h>
+#include "gnutv.h"
 
 struct gnutv_dvb_params {
 	int adapter_id;
 	int frontend_id;
 	int demux_id;
 	struct dvbcfg_zapchannel channel;
+	int service_count;		// services to receive from channel's mux
+	int service_ids[GNUTV_MAX_SERVICES];
 	struct dvbsec_config sec;
 	int valid_sec;
 	int output_type;
 	struct dvbfe_handle *fe;
+	int notune;			// fe is shared and read only: watch it, don't tune it
 };
 
 extern int gnutv_dvb_start(struct gnutv_dvb_params *params);
@@ -0,0 +1,263 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "gnutv_fec.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// RTP payload type of the FEC streams
+#define FEC_PAYLOAD_TYPE 96
+
+// FEC packets which may be ready at once: a column per datagram added and
+// a row per L, over a batch of sends
+#define FEC_QUEUE_SIZE 128
+
+/**
+ * The XOR of the datagrams of one column or row so far, kept in the layout
+ * of the FEC packet it will become.
+ */
+struct fec_accumulator {
+	uint8_t pkt[GNUTV_FEC_MAX_PACKET];
+	int count;
+	int max_len;			// of the payloads; beyond it pkt is zero
+	uint16_t snbase;
+	uint16_t length;
+	uint8_t pt;
+	uint32_t ts;
+};
+
+struct gnutv_fec {
+	int columns;
+	int rows;
+	int row_fec;
+	int pos;			// of the next datagram in the matrix
+	uint32_t last_ts;
+	uint16_t seq[2];
+
+	struct fec_accumulator column[GNUTV_FEC_MAX_L];
+	struct fec_accumulator row;
+
+	uint8_t (*queue)[GNUTV_FEC_MAX_PACKET];
+	int queue_len[FEC_QUEUE_SIZE];
+	int queue_stream[FEC_QUEUE_SIZE];
+	int qhead;
+	int qcount;
+};
+
+struct gnutv_fec *gnutv_fec_create(int columns, int rows, int row_fec)
+{
+	struct gnutv_fec *fec;
+
+	if ((columns < 1) || (columns > GNUTV_FEC_MAX_L) ||
+	    (rows < GNUTV_FEC_MIN_D) || (rows > GNUTV_FEC_MAX_D) ||
+	    (columns * rows > GNUTV_FEC_MAX_MATRIX)) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((fec = calloc(1, sizeof(struct gnutv_fec))) == NULL)
+		return NULL;
+	if ((fec->queue = malloc(FEC_QUEUE_SIZE * GNUTV_FEC_MAX_PACKET)) == NULL) {
+		free(fec);
+		return NULL;
+	}
+	fec->columns = columns;
+	fec->rows = rows;
+	fec->row_fec = row_fec;
+	fec->seq[GNUTV_FEC_COLUMN] = random();
+	fec->seq[GNUTV_FEC_ROW] = random();
+
+	return fec;
+}
+
+void gnutv_fec_destroy(struct gnutv_fec *fec)
+{
+	free(fec->queue);
+	free(fec);
+}
+
+/**
+ * dst ^= src, 16 bytes at a time where possible.
+ */
+static void gnutv_fec_xor(uint8_t *dst, const uint8_t *src, int len)
+{
+	int i = 0;
+
+#if defined(__SSE2__)
+	for(; i + 64 <= len; i += 64) {
+		__m128i a0 = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i a1 = _mm_loadu_si128((const __m128i *) (src + i + 16));
+		__m128i a2 = _mm_loadu_si128((const __m128i *) (src + i + 32));
+		__m128i a3 = _mm_loadu_si128((const __m128i *) (src + i + 48));
+
+		_mm_storeu_si128((__m128i *) (dst + i),
+				 _mm_xor_si128(a0, _mm_loadu_si128((__m128i *) (dst + i))));
+		_mm_storeu_si128((__m128i *) (dst + i + 16),
+				 _mm_xor_si128(a1, _mm_loadu_si128((__m128i *) (dst + i + 16))));
+		_mm_storeu_si128((__m128i *) (dst + i + 32),
+				 _mm_xor_si128(a2, _mm_loadu_si128((__m128i *) (dst + i + 32))));
+		_mm_storeu_si128((__m128i *) (dst + i + 48),
+				 _mm_xor_si128(a3, _mm_loadu_si128((__m128i *) (dst + i + 48))));
+	}
+	for(; i + 16 <= len; i += 16)
+		_mm_storeu_si128((__m128i *) (dst + i),
+				 _mm_xor_si128(_mm_loadu_si128((const __m128i *) (src + i)),
+					       _mm_loadu_si128((__m128i *) (dst + i))));
+#else
+	for(; i + 8 <= len; i += 8) {
+		uint64_t a, b;
+
+		memcpy(&a, src + i, 8);
+		memcpy(&b, dst + i, 8);
+		a ^= b;
+		memcpy(dst + i, &a, 8);
+	}
+#endif
+	for(; i < len; i++)
+		dst[i] ^= src[i];
+}
+
+static void gnutv_fec_accumulate(struct fec_accumulator *acc, const uint8_t *hdr, int hdrlen,
+				 const uint8_t *data, int len)
+{
+	uint8_t *payload = acc->pkt + GNUTV_FEC_HEADER_SIZE;
+	int extlen = hdrlen - 12;
+
+	if (acc->count == 0)
+		acc->snbase = (hdr[2] << 8) | hdr[3];
+	acc->count++;
+
+	gnutv_fec_xor(payload, hdr + 12, extlen);
+	gnutv_fec_xor(payload + extlen, data, len);
+	if (extlen + len > acc->max_len)
+		acc->max_len = extlen + len;
+
+	acc->length ^= extlen + len;
+	acc->pt ^= hdr[1] & 0x7f;
+	acc->ts ^= ((uint32_t) hdr[4] << 24) | (hdr[5] << 16) | (hdr[6] << 8) | hdr[7];
+}
+
+/**
+ * Turn a complete accumulator into a FEC packet on the queue, and start
+ * it again.
+ *
+ * @param offset, na The 2022-1 fields: the distance between the datagrams
+ * protected, and their number.
+ */
+static void gnutv_fec_finish(struct gnutv_fec *fec, struct fec_accumulator *acc, int stream,
+			     int offset, int na)
+{
+	uint8_t *pkt = acc->pkt;
+	uint16_t seq = fec->seq[stream]++;
+	int len = GNUTV_FEC_HEADER_SIZE + acc->max_len;
+	int slot;
+
+	// RTP header
+	pkt[0x0] = 0x80;
+	pkt[0x1] = FEC_PAYLOAD_TYPE;
+	pkt[0x2] = seq >> 8;
+	pkt[0x3] = seq;
+	pkt[0x4] = fec->last_ts >> 24;
+	pkt[0x5] = fec->last_ts >> 16;
+	pkt[0x6] = fec->last_ts >> 8;
+	pkt[0x7] = fec->last_ts;
+	memset(pkt + 0x8, 0, 4);
+
+	// FEC header: SNBase, length, E and PT recovery, mask, TS recovery,
+	// then N, D, type, index, offset, NA and the SNBase extension
+	pkt[0xc] = acc->snbase >> 8;
+	pkt[0xd] = acc->snbase;
+	pkt[0xe] = acc->length >> 8;
+	pkt[0xf] = acc->length;
+	pkt[0x10] = 0x80 | acc->pt;
+	pkt[0x11] = 0;
+	pkt[0x12] = 0;
+	pkt[0x13] = 0;
+	pkt[0x14] = acc->ts >> 24;
+	pkt[0x15] = acc->ts >> 16;
+	pkt[0x16] = acc->ts >> 8;
+	pkt[0x17] = acc->ts;
+	pkt[0x18] = (stream == GNUTV_FEC_ROW) ? 0x40 : 0x00;
+	pkt[0x19] = offset;
+	pkt[0x1a] = na;
+	pkt[0x1b] = 0;
+
+	// if nobody has taken the oldest, it is too late for it anyway
+	if (fec->qcount == FEC_QUEUE_SIZE) {
+		fec->qhead = (fec->qhead + 1) % FEC_QUEUE_SIZE;
+		fec->qcount--;
+	}
+	slot = (fec->qhead + fec->qcount) % FEC_QUEUE_SIZE;
+	memcpy(fec->queue[slot], pkt, len);
+	fec->queue_len[slot] = len;
+	fec->queue_stream[slot] = stream;
+	fec->qcount++;
+
+	memset(pkt + GNUTV_FEC_HEADER_SIZE, 0, acc->max_len);
+	acc->max_len = 0;
+	acc->count = 0;
+	acc->length = 0;
+	acc->pt = 0;
+	acc->ts = 0;
+}
+
+void gnutv_fec_add(struct gnutv_fec *fec, const uint8_t *hdr, int hdrlen,
+		   const uint8_t *data, int len)
+{
+	int column = fec->pos % fec->columns;
+	int row = fec->pos / fec->columns;
+
+	if (hdrlen - 12 + len > GNUTV_FEC_MAX_PAYLOAD)
+		len = GNUTV_FEC_MAX_PAYLOAD - (hdrlen - 12);
+	fec->last_ts = ((uint32_t) hdr[4] << 24) | (hdr[5] << 16) | (hdr[6] << 8) | hdr[7];
+
+	gnutv_fec_accumulate(&fec->column[column], hdr, hdrlen, data, len);
+	if (row == fec->rows - 1)
+		gnutv_fec_finish(fec, &fec->column[column], GNUTV_FEC_COLUMN,
+				 fec->columns, fec->rows);
+
+	if (fec->row_fec) {
+		gnutv_fec_accumulate(&fec->row, hdr, hdrlen, data, len);
+		if (column == fec->columns - 1)
+			gnutv_fec_finish(fec, &fec->row, GNUTV_FEC_ROW, 1, fec->columns);
+	}
+
+	fec->pos = (fec->pos + 1) % (fec->columns * fec->rows);
+}
+
+uint8_t *gnutv_fec_next(struct gnutv_fec *fec, int *stream, int *len)
+{
+	int slot = fec->qhead;
+
+	if (fec->qcount == 0)
+		return NULL;
+	fec->qhead = (fec->qhead + 1) % FEC_QUEUE_SIZE;
+	fec->qcount--;
+
+	*stream = fec->queue_stream[slot];
+	*len = fec->queue_len[slot];
+	return fec->queue[slot];
+}
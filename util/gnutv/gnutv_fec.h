@@ -0,0 +1,93 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_FEC_H
+#define gnutv_FEC_H 1
+
+#include <stdint.h>
+
+/**
+ * SMPTE 2022-1 FEC for an RTP stream. The media datagrams are taken as a
+ * matrix of L columns by D rows, in sequence number order. Each column's
+ * FEC packet is the XOR of its D datagrams, each row's (if wanted) that of
+ * its L; a receiver can rebuild any one lost datagram of a column or row.
+ *
+ * The XOR covers the RTP payload (everything after the fixed 12 byte
+ * header), its length, payload type and timestamp. It is folded into the
+ * accumulators of the datagram's column and row as each datagram is sent,
+ * so the media is only read once. A column's FEC packet is ready as soon
+ * as its last datagram has been added, which spreads the column FEC over
+ * the last row of the matrix; a row's once the row is complete.
+ */
+struct gnutv_fec;
+
+#define GNUTV_FEC_COLUMN 0
+#define GNUTV_FEC_ROW 1
+
+// the limits of 2022-1
+#define GNUTV_FEC_MAX_L 20
+#define GNUTV_FEC_MIN_D 4
+#define GNUTV_FEC_MAX_D 20
+#define GNUTV_FEC_MAX_MATRIX 100
+
+// largest RTP payload protected
+#define GNUTV_FEC_MAX_PAYLOAD 9000
+
+// FEC packet: RTP header, FEC header, XOR of the payloads
+#define GNUTV_FEC_HEADER_SIZE (12 + 16)
+#define GNUTV_FEC_MAX_PACKET (GNUTV_FEC_HEADER_SIZE + GNUTV_FEC_MAX_PAYLOAD)
+
+/**
+ * Create the FEC of a stream.
+ *
+ * @param columns L.
+ * @param rows D.
+ * @param row_fec Generate row FEC as well as column FEC.
+ * @return The FEC, or NULL with errno EINVAL (L or D out of range) or
+ * ENOMEM.
+ */
+extern struct gnutv_fec *gnutv_fec_create(int columns, int rows, int row_fec);
+
+extern void gnutv_fec_destroy(struct gnutv_fec *fec);
+
+/**
+ * Add the next media datagram of the stream, whose RTP header and payload
+ * may be apart. The sequence number must follow on from the last one.
+ *
+ * @param hdr The RTP header, with any extension.
+ * @param hdrlen Its length (at least 12).
+ * @param data The rest of the datagram.
+ * @param len Its length.
+ */
+extern void gnutv_fec_add(struct gnutv_fec *fec, const uint8_t *hdr, int hdrlen,
+			  const uint8_t *data, int len);
+
+/**
+ * Take the next FEC packet which is ready, if any. It remains valid until
+ * the next call to gnutv_fec_add().
+ *
+ * @param stream Set to GNUTV_FEC_COLUMN or GNUTV_FEC_ROW.
+ * @param len Set to its length.
+ * @return The packet, or NULL if none is ready.
+ */
+extern uint8_t *gnutv_fec_next(struct gnutv_fec *fec, int *stream, int *len);
+
+#endif
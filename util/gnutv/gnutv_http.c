@@ -0,0 +1,600 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+#include "gnutv_http.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY 5
+#endif
+
+// the most sent to a client at a time, and the least worth MSG_ZEROCOPY
+#define HTTP_SEND_MAX (256*1024)
+#define HTTP_ZEROCOPY_MIN (16*1024)
+
+// MSG_ZEROCOPY sends a client may have in flight
+#define HTTP_ZEROCOPY_MAX 64
+
+// the writer is handed this much of the ring at a time
+#define HTTP_WRITE_CHUNK (GNUTV_HTTP_RING_SIZE / 16)
+
+// a request has to arrive within this long, and fit this size
+#define HTTP_REQUEST_TIMEOUT 5000000000LL
+#define HTTP_REQUEST_MAX 4096
+
+#define HTTP_STATE_REQUEST 0
+#define HTTP_STATE_STREAM 1
+
+struct http_client {
+	int fd;
+	int state;
+	int slot;
+	char peer[64];
+	int64_t connected;
+
+	char request[HTTP_REQUEST_MAX];
+	int request_len;
+
+	uint64_t pos;			// next byte of the stream to send
+	int blocked;			// socket full: wait for EPOLLOUT
+	uint64_t sent;
+
+	// MSG_ZEROCOPY: the sends in flight, by completion id; the ring must
+	// not come round to the oldest before it is done with
+	int zerocopy;
+	uint32_t zc_next;
+	uint32_t zc_done;
+	uint64_t zc_pos[HTTP_ZEROCOPY_MAX];
+};
+
+struct gnutv_http {
+	uint8_t *buf;			// mapped twice: buf[i] == buf[i + size]
+	size_t size;
+	uint64_t head;			// bytes of the stream written, ever
+
+	int listen_fd;
+	int data_fd;			// eventfd: new data, or stop
+	int epoll_fd;
+	int shutdown;
+	pthread_t thread;
+
+	struct http_client *clients[GNUTV_HTTP_MAX_CLIENTS];
+	int client_count;
+	struct gnutv_http_stats stats;
+};
+
+static const char *http_ok =
+	"HTTP/1.0 200 OK\r\n"
+	"Content-Type: video/mp2t\r\n"
+	"Cache-Control: no-cache\r\n"
+	"Connection: close\r\n"
+	"\r\n";
+
+static int64_t http_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+/**
+ * Map size bytes of shared memory twice, one mapping right after the other.
+ */
+static uint8_t *http_map_ring(size_t size)
+{
+	uint8_t *base;
+	int fd;
+
+	if ((fd = memfd_create("gnutv-http", 0)) < 0)
+		return NULL;
+	if (ftruncate(fd, size)) {
+		close(fd);
+		return NULL;
+	}
+
+	base = mmap(NULL, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+	if ((mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | MAP_POPULATE,
+		  fd, 0) == MAP_FAILED) ||
+	    (mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED | MAP_POPULATE,
+		  fd, 0) == MAP_FAILED)) {
+		munmap(base, size * 2);
+		close(fd);
+		return NULL;
+	}
+
+	// the mappings keep the memory
+	close(fd);
+	return base;
+}
+
+static int http_listen(const char *host, const char *port)
+{
+	struct addrinfo hints;
+	struct addrinfo *addrs;
+	int one = 1;
+	int res;
+	int fd;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if ((res = getaddrinfo(host, port, &hints, &addrs)) != 0) {
+		fprintf(stderr, "Unable to resolve HTTP address: %s\n", gai_strerror(res));
+		return -1;
+	}
+
+	fd = socket(addrs->ai_family, addrs->ai_socktype | SOCK_NONBLOCK, addrs->ai_protocol);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open HTTP socket: %m\n");
+		goto fail;
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(fd, addrs->ai_addr, addrs->ai_addrlen) || listen(fd, 128)) {
+		fprintf(stderr, "Failed to listen on HTTP port %s: %m\n", port);
+		close(fd);
+		fd = -1;
+	}
+
+fail:
+	freeaddrinfo(addrs);
+	return fd;
+}
+
+static void http_client_close(struct gnutv_http *http, struct http_client *client, const char *why)
+{
+	if (client->state == HTTP_STATE_STREAM) {
+		fprintf(stderr, "HTTP client %s %s after %llu bytes\n", client->peer, why,
+			(unsigned long long) client->sent);
+		http->stats.clients--;
+	}
+
+	epoll_ctl(http->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+	close(client->fd);
+	http->clients[client->slot] = NULL;
+	http->client_count--;
+	free(client);
+}
+
+/**
+ * Collect the MSG_ZEROCOPY completions of a client. TCP completes its sends
+ * in order, so a range completing means all before it have too.
+ */
+static void http_client_reap(struct http_client *client)
+{
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + 64];
+	struct sock_extended_err *err;
+	struct cmsghdr *cmsg;
+	struct msghdr msg;
+
+	while(client->zc_done != client->zc_next) {
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(client->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			err = (struct sock_extended_err *) CMSG_DATA(cmsg);
+			if ((err->ee_errno != 0) || (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+				continue;
+			if ((int32_t) (err->ee_data + 1 - client->zc_done) > 0)
+				client->zc_done = err->ee_data + 1;
+		}
+	}
+}
+
+/**
+ * Send a client what it has not had yet, until it is up to date or its
+ * socket is full.
+ *
+ * @return 0 on success, -1 if the client has been dropped.
+ */
+static int http_client_send(struct gnutv_http *http, struct http_client *client)
+{
+	uint64_t head = __atomic_load_n(&http->head, __ATOMIC_ACQUIRE);
+	uint64_t oldest;
+	int flags;
+	ssize_t n;
+	size_t len;
+
+	if (client->zerocopy)
+		http_client_reap(client);
+
+	// the writer may be about to overwrite what it still needs
+	oldest = client->pos;
+	if (client->zc_done != client->zc_next)
+		oldest = client->zc_pos[client->zc_done % HTTP_ZEROCOPY_MAX];
+	if (head - oldest > GNUTV_HTTP_MAX_LAG) {
+		http->stats.slow++;
+		http_client_close(http, client, "dropped: too slow");
+		return -1;
+	}
+
+	while(!client->blocked && (client->pos != head)) {
+		len = head - client->pos;
+		if (len > HTTP_SEND_MAX)
+			len = HTTP_SEND_MAX;
+
+		flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+		if (client->zerocopy && (len >= HTTP_ZEROCOPY_MIN) &&
+		    ((client->zc_next - client->zc_done) < HTTP_ZEROCOPY_MAX))
+			flags |= MSG_ZEROCOPY;
+
+		n = send(client->fd, http->buf + (client->pos % http->size), len, flags);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EAGAIN) || (errno == ENOBUFS)) {
+				client->blocked = 1;
+				break;
+			}
+			http_client_close(http, client, "disconnected");
+			return -1;
+		}
+
+		// every MSG_ZEROCOPY send gets a completion id, even a short one
+		if (flags & MSG_ZEROCOPY)
+			client->zc_pos[client->zc_next++ % HTTP_ZEROCOPY_MAX] = client->pos;
+		client->pos += n;
+		client->sent += n;
+		http->stats.bytes += n;
+	}
+
+	return 0;
+}
+
+static void http_client_reply(struct http_client *client, const char *reply)
+{
+	// a new connection always has room for the headers
+	if (send(client->fd, reply, strlen(reply), MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+		// nothing to be done; it is closed anyway
+	}
+}
+
+/**
+ * Read what there is of a client's request, and answer it once complete.
+ *
+ * @return 0 on success, -1 if the client has been closed.
+ */
+static int http_client_request(struct gnutv_http *http, struct http_client *client)
+{
+	int one = 1;
+	ssize_t n;
+
+	// edge triggered: read until there is no more
+	while(1) {
+		n = recv(client->fd, client->request + client->request_len,
+			 sizeof(client->request) - 1 - client->request_len, MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return 0;
+		}
+		if (n <= 0) {
+			http_client_close(http, client, "closed");
+			return -1;
+		}
+		client->request_len += n;
+		client->request[client->request_len] = 0;
+
+		if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n"))
+			break;
+		if (client->request_len == (int) sizeof(client->request) - 1) {
+			http_client_reply(client, "HTTP/1.0 413 Request Too Large\r\n\r\n");
+			http_client_close(http, client, "closed");
+			return -1;
+		}
+	}
+
+	if (!strncmp(client->request, "HEAD ", 5)) {
+		http_client_reply(client, http_ok);
+		http_client_close(http, client, "closed");
+		return -1;
+	}
+	if (strncmp(client->request, "GET ", 4)) {
+		http_client_reply(client, "HTTP/1.0 405 Method Not Allowed\r\nAllow: GET, HEAD\r\n\r\n");
+		http_client_close(http, client, "closed");
+		return -1;
+	}
+
+	// the stream from here on
+	http_client_reply(client, http_ok);
+	client->state = HTTP_STATE_STREAM;
+	client->pos = __atomic_load_n(&http->head, __ATOMIC_ACQUIRE);
+	if (setsockopt(client->fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+		client->zerocopy = 1;
+	http->stats.connections++;
+	http->stats.clients++;
+	fprintf(stderr, "HTTP client %s connected\n", client->peer);
+	return 0;
+}
+
+static void http_accept(struct gnutv_http *http)
+{
+	struct sockaddr_storage addr;
+	struct http_client *client;
+	struct epoll_event event;
+	socklen_t addrlen;
+	int slot;
+	int fd;
+
+	while(1) {
+		addrlen = sizeof(addr);
+		if ((fd = accept4(http->listen_fd, (struct sockaddr *) &addr, &addrlen, SOCK_NONBLOCK)) < 0)
+			return;
+
+		if (http->client_count == GNUTV_HTTP_MAX_CLIENTS) {
+			if (send(fd, "HTTP/1.0 503 Too Many Clients\r\n\r\n", 33, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+				// nothing to be done
+			}
+			close(fd);
+			continue;
+		}
+		if ((client = calloc(1, sizeof(struct http_client))) == NULL) {
+			close(fd);
+			continue;
+		}
+		for(slot=0; http->clients[slot]; slot++);
+
+		client->fd = fd;
+		client->slot = slot;
+		client->state = HTTP_STATE_REQUEST;
+		client->connected = http_now();
+		if (getnameinfo((struct sockaddr *) &addr, addrlen, client->peer, sizeof(client->peer),
+				NULL, 0, NI_NUMERICHOST))
+			strcpy(client->peer, "?");
+
+		// edge triggered: EPOLLOUT only comes after a send has filled the socket
+		memset(&event, 0, sizeof(event));
+		event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		event.data.ptr = client;
+		if (epoll_ctl(http->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+			close(fd);
+			free(client);
+			continue;
+		}
+		http->clients[slot] = client;
+		http->client_count++;
+	}
+}
+
+static void http_client_event(struct gnutv_http *http, struct http_client *client, uint32_t events)
+{
+	char discard[256];
+
+	if (client->state == HTTP_STATE_REQUEST) {
+		if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+			if (http_client_request(http, client))
+				return;
+			if (client->state == HTTP_STATE_REQUEST)
+				return;
+		} else {
+			return;
+		}
+	} else if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+		// nothing more is expected from a client, bar it going away
+		ssize_t n;
+
+		while((n = recv(client->fd, discard, sizeof(discard), MSG_DONTWAIT)) > 0);
+		if ((n == 0) || (events & EPOLLHUP)) {
+			http_client_close(http, client, "disconnected");
+			return;
+		}
+	}
+
+	if (events & EPOLLOUT)
+		client->blocked = 0;
+	http_client_send(http, client);
+}
+
+/**
+ * Drop the clients which have not sent a request in time.
+ */
+static void http_expire(struct gnutv_http *http)
+{
+	int64_t now = http_now();
+	int i;
+
+	for(i=0; i < GNUTV_HTTP_MAX_CLIENTS; i++) {
+		struct http_client *client = http->clients[i];
+
+		if (client && (client->state == HTTP_STATE_REQUEST) &&
+		    (now - client->connected > HTTP_REQUEST_TIMEOUT))
+			http_client_close(http, client, "timed out");
+	}
+}
+
+static void *http_thread_func(void *arg)
+{
+	struct gnutv_http *http = (struct gnutv_http *) arg;
+	struct epoll_event events[64];
+	uint64_t count;
+	int64_t last_expire = http_now();
+	int n;
+	int i;
+
+	while(!__atomic_load_n(&http->shutdown, __ATOMIC_ACQUIRE)) {
+		if ((n = epoll_wait(http->epoll_fd, events, 64, 1000)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "HTTP epoll failure: %m\n");
+			break;
+		}
+
+		for(i=0; i < n; i++) {
+			if (events[i].data.ptr == &http->listen_fd) {
+				http_accept(http);
+			} else if (events[i].data.ptr == &http->data_fd) {
+				int j;
+
+				if (read(http->data_fd, &count, sizeof(count)) < 0) {
+					// EAGAIN: already cleared
+				}
+				for(j=0; j < GNUTV_HTTP_MAX_CLIENTS; j++) {
+					if (http->clients[j] && (http->clients[j]->state == HTTP_STATE_STREAM))
+						http_client_send(http, http->clients[j]);
+				}
+			} else {
+				http_client_event(http, (struct http_client *) events[i].data.ptr,
+						  events[i].events);
+			}
+		}
+
+		if (http_now() - last_expire > 1000000000LL) {
+			http_expire(http);
+			last_expire = http_now();
+		}
+	}
+
+	return NULL;
+}
+
+struct gnutv_http *gnutv_http_start(const char *host, const char *port)
+{
+	struct gnutv_http *http;
+	struct epoll_event event;
+
+	if ((http = calloc(1, sizeof(struct gnutv_http))) == NULL) {
+		fprintf(stderr, "Out of memory for HTTP server\n");
+		return NULL;
+	}
+	http->size = GNUTV_HTTP_RING_SIZE;
+	http->listen_fd = -1;
+	http->data_fd = -1;
+	http->epoll_fd = -1;
+
+	if ((http->buf = http_map_ring(http->size)) == NULL) {
+		fprintf(stderr, "Failed to map HTTP ring: %m\n");
+		goto fail;
+	}
+	if ((http->listen_fd = http_listen(host, port)) < 0)
+		goto fail;
+	if (((http->data_fd = eventfd(0, EFD_NONBLOCK)) < 0) ||
+	    ((http->epoll_fd = epoll_create1(0)) < 0)) {
+		fprintf(stderr, "Failed to set up HTTP server: %m\n");
+		goto fail;
+	}
+
+	// the two fds of the server itself are told apart by their address
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = &http->listen_fd;
+	epoll_ctl(http->epoll_fd, EPOLL_CTL_ADD, http->listen_fd, &event);
+	event.data.ptr = &http->data_fd;
+	epoll_ctl(http->epoll_fd, EPOLL_CTL_ADD, http->data_fd, &event);
+
+	if (pthread_create(&http->thread, NULL, http_thread_func, http)) {
+		fprintf(stderr, "Failed to start HTTP server thread\n");
+		goto fail;
+	}
+
+	return http;
+
+fail:
+	if (http->epoll_fd != -1)
+		close(http->epoll_fd);
+	if (http->data_fd != -1)
+		close(http->data_fd);
+	if (http->listen_fd != -1)
+		close(http->listen_fd);
+	if (http->buf)
+		munmap(http->buf, http->size * 2);
+	free(http);
+	return NULL;
+}
+
+void gnutv_http_stop(struct gnutv_http *http)
+{
+	uint64_t one = 1;
+	int i;
+
+	__atomic_store_n(&http->shutdown, 1, __ATOMIC_RELEASE);
+	if (write(http->data_fd, &one, sizeof(one)) < 0) {
+		// only fails if the counter is saturated: it's signalled anyway
+	}
+	pthread_join(http->thread, NULL);
+
+	for(i=0; i < GNUTV_HTTP_MAX_CLIENTS; i++) {
+		if (http->clients[i])
+			http_client_close(http, http->clients[i], "stopped");
+	}
+
+	fprintf(stderr, "HTTP: %llu clients served, %llu dropped as too slow, %llu bytes sent\n",
+		(unsigned long long) http->stats.connections, (unsigned long long) http->stats.slow,
+		(unsigned long long) http->stats.bytes);
+
+	close(http->epoll_fd);
+	close(http->data_fd);
+	close(http->listen_fd);
+	munmap(http->buf, http->size * 2);
+	free(http);
+}
+
+uint8_t *gnutv_http_write_ptr(struct gnutv_http *http, size_t *avail)
+{
+	*avail = HTTP_WRITE_CHUNK;
+	return http->buf + (http->head % http->size);
+}
+
+void gnutv_http_write_commit(struct gnutv_http *http, size_t len)
+{
+	uint64_t one = 1;
+
+	__atomic_store_n(&http->head, http->head + len, __ATOMIC_RELEASE);
+	if (write(http->data_fd, &one, sizeof(one)) < 0) {
+		// only fails if the counter is saturated: it's signalled anyway
+	}
+}
+
+void gnutv_http_get_stats(struct gnutv_http *http, struct gnutv_http_stats *stats)
+{
+	stats->connections = __atomic_load_n(&http->stats.connections, __ATOMIC_RELAXED);
+	stats->slow = __atomic_load_n(&http->stats.slow, __ATOMIC_RELAXED);
+	stats->bytes = __atomic_load_n(&http->stats.bytes, __ATOMIC_RELAXED);
+	stats->clients = __atomic_load_n(&http->stats.clients, __ATOMIC_RELAXED);
+}
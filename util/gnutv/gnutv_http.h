@@ -0,0 +1,83 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_HTTP_H
+#define gnutv_HTTP_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * An HTTP server handing one TS out to any number of clients. A GET of any
+ * path gets the stream from the moment of the request, until the client
+ * goes away.
+ *
+ * The TS is written once into a ring which is mapped twice in a row, so any
+ * stretch of it is contiguous in memory. Clients are just read positions
+ * into the ring, and are sent to straight from it by a thread of their own
+ * running an epoll loop (with MSG_ZEROCOPY where the socket allows it). The
+ * writer never waits for them: a client which falls more than
+ * GNUTV_HTTP_MAX_LAG of the ring behind is dropped.
+ */
+struct gnutv_http;
+
+#define GNUTV_HTTP_RING_SIZE (32*1024*1024)
+#define GNUTV_HTTP_MAX_LAG (GNUTV_HTTP_RING_SIZE / 2)
+#define GNUTV_HTTP_MAX_CLIENTS 256
+
+struct gnutv_http_stats {
+	uint64_t connections;		// requests for the stream
+	uint64_t slow;			// clients dropped for falling behind
+	uint64_t bytes;			// sent to all the clients
+	int clients;			// being sent to now
+};
+
+/**
+ * Start serving on a TCP address.
+ *
+ * @param host Address to listen on, or NULL for all.
+ * @param port Port to listen on.
+ * @return The server, or NULL on failure (which has been reported).
+ */
+extern struct gnutv_http *gnutv_http_start(const char *host, const char *port);
+
+/**
+ * Stop serving, dropping any clients.
+ */
+extern void gnutv_http_stop(struct gnutv_http *http);
+
+/**
+ * Writer: where to put the next data of the stream, which need not be
+ * committed all at once.
+ *
+ * @param avail Set to the number of bytes which may be written there.
+ */
+extern uint8_t *gnutv_http_write_ptr(struct gnutv_http *http, size_t *avail);
+
+/**
+ * Writer: hand len bytes at gnutv_http_write_ptr() to the clients. Only
+ * whole TS packets should be committed, so new clients start on one.
+ */
+extern void gnutv_http_write_commit(struct gnutv_http *http, size_t len);
+
+extern void gnutv_http_get_stats(struct gnutv_http *http, struct gnutv_http_stats *stats);
+
+#endif
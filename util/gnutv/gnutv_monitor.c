@@ -0,0 +1,211 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/mpeg/pmt_section.h>
+#include "gnutv_monitor.h"
+
+// elementary streams watched
+#define MONITOR_MAX_PIDS 32
+
+// fewer packets than this in a window says nothing about a PID
+#define MONITOR_MIN_PACKETS 16
+
+#define MONITOR_STAGE_CLEAR 0
+#define MONITOR_STAGE_RESENT 1
+#define MONITOR_STAGE_RESET 2
+
+struct monitor_pid {
+	uint16_t pid;
+	uint32_t clear;
+	uint32_t scrambled;
+};
+
+struct gnutv_monitor {
+	int threshold;
+
+	// PID => index in pids + 1, or 0 if it is not watched
+	uint8_t watched[TRANSPORT_MAX_PIDS];
+	struct monitor_pid pids[MONITOR_MAX_PIDS];
+	int pid_count;
+	pthread_mutex_t lock;
+
+	int skip;			// bytes of a packet begun in the last buffer
+	int64_t window_start;
+	int stage;
+	int64_t stage_time;
+};
+
+struct gnutv_monitor *gnutv_monitor_create(int threshold)
+{
+	struct gnutv_monitor *mon;
+
+	if ((mon = calloc(1, sizeof(struct gnutv_monitor))) == NULL)
+		return NULL;
+	mon->threshold = threshold;
+	mon->window_start = -1;
+	pthread_mutex_init(&mon->lock, NULL);
+
+	return mon;
+}
+
+void gnutv_monitor_destroy(struct gnutv_monitor *mon)
+{
+	pthread_mutex_destroy(&mon->lock);
+	free(mon);
+}
+
+void gnutv_monitor_set_pmt(struct gnutv_monitor *mon, struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	int i;
+
+	pthread_mutex_lock(&mon->lock);
+	for(i = 0; i < mon->pid_count; i++)
+		mon->watched[mon->pids[i].pid] = 0;
+	mon->pid_count = 0;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (mon->pid_count == MONITOR_MAX_PIDS)
+			break;
+		if (mon->watched[cur_stream->pid])
+			continue;
+		mon->pids[mon->pid_count].pid = cur_stream->pid;
+		mon->pids[mon->pid_count].clear = 0;
+		mon->pids[mon->pid_count].scrambled = 0;
+		mon->pid_count++;
+		mon->watched[cur_stream->pid] = mon->pid_count;
+	}
+	pthread_mutex_unlock(&mon->lock);
+}
+
+/**
+ * Judge the window just ended, and start the next.
+ *
+ * @return As for gnutv_monitor_scan().
+ */
+static int gnutv_monitor_window(struct gnutv_monitor *mon, int64_t now, int ca_ready)
+{
+	struct monitor_pid *worst = NULL;
+	int worst_percent = 0;
+	int action = GNUTV_MONITOR_OK;
+	int i;
+
+	for(i = 0; i < mon->pid_count; i++) {
+		struct monitor_pid *p = &mon->pids[i];
+		uint32_t total = p->clear + p->scrambled;
+
+		if (total >= MONITOR_MIN_PACKETS) {
+			int percent = (uint64_t) p->scrambled * 100 / total;
+			if ((worst == NULL) || (percent > worst_percent)) {
+				worst = p;
+				worst_percent = percent;
+			}
+		}
+		p->clear = 0;
+		p->scrambled = 0;
+	}
+	mon->window_start = now;
+	if (worst == NULL)
+		return GNUTV_MONITOR_OK;
+
+	if (worst_percent < mon->threshold) {
+		if (mon->stage != MONITOR_STAGE_CLEAR)
+			fprintf(stderr, "Stream descrambled again\n");
+		mon->stage = MONITOR_STAGE_CLEAR;
+		return GNUTV_MONITOR_OK;
+	}
+
+	// a CAM which isn't up yet can't be expected to descramble
+	if (!ca_ready)
+		return GNUTV_MONITOR_OK;
+
+	switch(mon->stage) {
+	case MONITOR_STAGE_CLEAR:
+		fprintf(stderr, "PID %i %i%% scrambled - resending CA PMT\n", worst->pid, worst_percent);
+		action = GNUTV_MONITOR_RESEND;
+		mon->stage = MONITOR_STAGE_RESENT;
+		mon->stage_time = now;
+		break;
+
+	case MONITOR_STAGE_RESENT:
+		if (now - mon->stage_time < GNUTV_MONITOR_RESEND_WAIT_MS * 1000000LL)
+			break;
+		fprintf(stderr, "PID %i %i%% scrambled - resetting CAM\n", worst->pid, worst_percent);
+		action = GNUTV_MONITOR_RESET;
+		mon->stage = MONITOR_STAGE_RESET;
+		mon->stage_time = now;
+		break;
+
+	case MONITOR_STAGE_RESET:
+		if (now - mon->stage_time >= GNUTV_MONITOR_RESET_WAIT_MS * 1000000LL)
+			mon->stage = MONITOR_STAGE_CLEAR;
+		break;
+	}
+
+	return action;
+}
+
+int gnutv_monitor_scan(struct gnutv_monitor *mon, const uint8_t *buf, int size,
+		       int64_t now, int ca_ready)
+{
+	int action = GNUTV_MONITOR_OK;
+	int pos;
+
+	// the rest of the packet the last buffer ended in the middle of
+	pos = mon->skip;
+	if (pos > size) {
+		mon->skip -= size;
+		return GNUTV_MONITOR_OK;
+	}
+
+	pthread_mutex_lock(&mon->lock);
+	while(pos + TRANSPORT_PACKET_LENGTH <= size) {
+		struct transport_packet *pkt = (struct transport_packet *) (buf + pos);
+		int idx;
+
+		if (pkt->sync_byte != TRANSPORT_PACKET_SYNC) {
+			pos++;
+			continue;
+		}
+		if ((idx = mon->watched[transport_packet_pid(pkt)]) &&
+		    (pkt->adaptation_field_control & transport_adaptation_field_control_payload_only)) {
+			if (pkt->transport_scrambling_control)
+				mon->pids[idx - 1].scrambled++;
+			else
+				mon->pids[idx - 1].clear++;
+		}
+		pos += TRANSPORT_PACKET_LENGTH;
+	}
+	mon->skip = (pos < size) ? pos + TRANSPORT_PACKET_LENGTH - size : 0;
+
+	if (mon->window_start < 0)
+		mon->window_start = now;
+	else if (now - mon->window_start >= GNUTV_MONITOR_WINDOW_MS * 1000000LL)
+		action = gnutv_monitor_window(mon, now, ca_ready);
+	pthread_mutex_unlock(&mon->lock);
+
+	return action;
+}
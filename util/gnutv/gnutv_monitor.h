@@ -0,0 +1,85 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_MONITOR_H
+#define gnutv_MONITOR_H 1
+
+#include <stdint.h>
+
+/**
+ * Watches the recorded stream for a CAM which has stopped descrambling.
+ * The packets with a payload on each elementary stream PID of the PMT are
+ * counted, as clear or scrambled (from their transport_scrambling_control
+ * bits), over windows of GNUTV_MONITOR_WINDOW_MS. A window in which any PID
+ * has at least the threshold percentage of its packets scrambled is a bad
+ * one.
+ *
+ * While the CA resource is up, the first bad window asks for the CA PMTs
+ * to be resent; if the windows are still bad GNUTV_MONITOR_RESEND_WAIT_MS
+ * later, for the CAM to be reset; and once it has had
+ * GNUTV_MONITOR_RESET_WAIT_MS to come back, it starts again from the
+ * resend. A good window ends it.
+ *
+ * The scan is a few operations per packet, so it can run on everything
+ * that is recorded.
+ */
+struct gnutv_monitor;
+struct mpeg_pmt_section;
+
+#define GNUTV_MONITOR_WINDOW_MS 1000
+#define GNUTV_MONITOR_RESEND_WAIT_MS 5000
+#define GNUTV_MONITOR_RESET_WAIT_MS 30000
+
+// what gnutv_monitor_scan() asks for
+#define GNUTV_MONITOR_OK 0
+#define GNUTV_MONITOR_RESEND 1
+#define GNUTV_MONITOR_RESET 2
+
+/**
+ * Create a monitor.
+ *
+ * @param threshold Percentage of a PID's packets in a window which makes it
+ * a bad one (1-100).
+ * @return The monitor, or NULL if out of memory.
+ */
+extern struct gnutv_monitor *gnutv_monitor_create(int threshold);
+
+extern void gnutv_monitor_destroy(struct gnutv_monitor *mon);
+
+/**
+ * Watch the elementary streams of a PMT, in place of those of the last one.
+ * May be called from another thread than gnutv_monitor_scan().
+ */
+extern void gnutv_monitor_set_pmt(struct gnutv_monitor *mon, struct mpeg_pmt_section *pmt);
+
+/**
+ * Count the packets of the next piece of the stream, which needn't start
+ * or end on a packet boundary.
+ *
+ * @param now The time in nanoseconds, from a monotonic clock.
+ * @param ca_ready Nonzero if the CA resource is up, and so able to recover.
+ * @return GNUTV_MONITOR_RESEND or GNUTV_MONITOR_RESET if that should be done
+ * now, otherwise GNUTV_MONITOR_OK.
+ */
+extern int gnutv_monitor_scan(struct gnutv_monitor *mon, const uint8_t *buf, int size,
+			      int64_t now, int ca_ready);
+
+#endif
@@ -0,0 +1,432 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/section_builder.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_data.h"
+#include "gnutv_remux.h"
+
+// the PCR counts at 27MHz and wraps at 2^33 * 300
+#define PCR_HZ 27000000LL
+#define PCR_WRAP (300LL << 33)
+
+// insertion points (runs of stuffing) one gnutv_remux_process() can make
+#define REMUX_MAX_INSERTS 64
+
+// packets of a section once cut up by gnutv_data_packetise()
+#define PSI_PACKETS(len) (((len) + 1 + TRANSPORT_PACKET_LENGTH - 5) / (TRANSPORT_PACKET_LENGTH - 4))
+
+struct remux_program {
+	int program_number;
+	int pmt_pid;			// coming in
+	int out_pid;			// going out
+	uint8_t pmt[GNUTV_DATA_MAX_PMT];
+	int pmt_len;
+	uint8_t cc;
+};
+
+struct remux_insert {
+	int pos;			// in packets, in the compacted input
+	int count;			// null packets before it
+};
+
+struct gnutv_remux {
+	struct gnutv_remux_stats stats;
+	uint16_t map[TRANSPORT_MAX_PIDS];
+	uint8_t psi_pid[TRANSPORT_MAX_PIDS];	// regenerated: drop what comes in
+
+	// regenerated PSI
+	struct remux_program programs[GNUTV_REMUX_MAX_PROGRAMS];
+	int program_count;
+	int transport_stream_id;
+	uint8_t pat[GNUTV_DATA_MAX_PMT];
+	int pat_len;
+	int pat_version;
+	uint8_t pat_cc;
+	int psi_packets;
+	uint8_t psi[(GNUTV_REMUX_MAX_PROGRAMS + 1) * PSI_PACKETS(GNUTV_DATA_MAX_PMT) *
+		    TRANSPORT_PACKET_LENGTH];	// of psi_packets, CCs renumbered as sent
+	int64_t next_psi;
+
+	// CBR: the PCR anchor_pcr was output as packet anchor_index
+	uint64_t cbr_rate;
+	double ticks_per_packet;
+	int64_t max_gap;		// packets the schedule may be out by before a resync
+	int pcr_pid;			// output PID, -1 until known
+	int anchored;
+	int64_t anchor_pcr;
+	uint64_t anchor_index;
+
+	struct remux_insert inserts[REMUX_MAX_INSERTS];
+	uint8_t null_packet[TRANSPORT_PACKET_LENGTH];
+};
+
+struct gnutv_remux *gnutv_remux_create(uint64_t cbr_rate, int vbr)
+{
+	struct gnutv_remux *r;
+	int pid;
+
+	if ((r = calloc(1, sizeof(struct gnutv_remux))) == NULL)
+		return NULL;
+
+	for(pid=0; pid < TRANSPORT_MAX_PIDS; pid++)
+		r->map[pid] = pid;
+	if (cbr_rate || vbr)
+		r->map[TRANSPORT_NULL_PID] = GNUTV_REMUX_DROP;
+	r->pat_version = -1;
+	r->pcr_pid = -1;
+
+	r->cbr_rate = cbr_rate;
+	if (cbr_rate) {
+		r->ticks_per_packet = (double) TRANSPORT_PACKET_LENGTH * 8 * PCR_HZ / cbr_rate;
+		r->max_gap = cbr_rate / (TRANSPORT_PACKET_LENGTH * 8);
+	}
+
+	r->null_packet[0] = TRANSPORT_PACKET_SYNC;
+	r->null_packet[1] = TRANSPORT_NULL_PID >> 8;
+	r->null_packet[2] = TRANSPORT_NULL_PID & 0xff;
+	r->null_packet[3] = 0x10;
+	memset(r->null_packet + 4, 0xff, TRANSPORT_PACKET_LENGTH - 4);
+	return r;
+}
+
+void gnutv_remux_destroy(struct gnutv_remux *r)
+{
+	free(r);
+}
+
+static int gnutv_remux_parse_pid(const char *str, char **end)
+{
+	long pid = strtol(str, end, 0);
+
+	if ((*end == str) || (pid < 0) || (pid >= TRANSPORT_NULL_PID))
+		return -1;
+	return pid;
+}
+
+int gnutv_remux_set_map(struct gnutv_remux *r, const char *spec)
+{
+	uint16_t map[TRANSPORT_MAX_PIDS];
+	uint8_t listed[TRANSPORT_MAX_PIDS];
+	uint8_t used[TRANSPORT_MAX_PIDS];
+	const char *pos = spec;
+	char *end;
+	int in, out;
+	int pid;
+
+	memcpy(map, r->map, sizeof(map));
+	memset(listed, 0, sizeof(listed));
+	memset(used, 0, sizeof(used));
+	while(*pos) {
+		if (((in = gnutv_remux_parse_pid(pos, &end)) < 0) || (*end != ':'))
+			goto invalid;
+		pos = end + 1;
+		if (!strncmp(pos, "drop", 4)) {
+			out = GNUTV_REMUX_DROP;
+			end = (char *) pos + 4;
+		} else if ((out = gnutv_remux_parse_pid(pos, &end)) < 0) {
+			goto invalid;
+		}
+		map[in] = out;
+		listed[in] = 1;
+
+		if (*end == ',')
+			end++;
+		else if (*end)
+			goto invalid;
+		pos = end;
+	}
+
+	// renumbering is only undone at the far end if it is one to one: two
+	// PIDs of the list may not meet, and one left as it is gives way
+	for(pid=0; pid < TRANSPORT_NULL_PID; pid++) {
+		if (listed[pid] && (map[pid] != GNUTV_REMUX_DROP) && used[map[pid]]++) {
+			errno = EEXIST;
+			return -1;
+		}
+	}
+	for(pid=0; pid < TRANSPORT_NULL_PID; pid++) {
+		if (!listed[pid] && (map[pid] != GNUTV_REMUX_DROP) && used[map[pid]])
+			map[pid] = GNUTV_REMUX_DROP;
+	}
+
+	memcpy(r->map, map, sizeof(map));
+	return 0;
+
+invalid:
+	errno = EINVAL;
+	return -1;
+}
+
+int gnutv_remux_map(struct gnutv_remux *r, int pid)
+{
+	return r->map[pid];
+}
+
+/**
+ * Rebuild the PAT from the programs, and the PSI packets sent out.
+ */
+static void gnutv_remux_build_pat(struct gnutv_remux *r)
+{
+	struct section_builder b;
+	uint8_t *pos = r->psi;
+	uint8_t cc = 0;
+	int i;
+
+	r->pat_version = (r->pat_version + 1) & 0x1f;
+	section_builder_start_ext(&b, r->pat, sizeof(r->pat), stag_mpeg_program_association, 0,
+				  r->transport_stream_id, r->pat_version, 0, 0);
+	for(i=0; i < r->program_count; i++) {
+		section_builder_u16(&b, r->programs[i].program_number);
+		section_builder_u16(&b, 0xe000 | r->programs[i].out_pid);
+	}
+	r->pat_len = section_builder_finish(&b);
+
+	// the counters are filled in as the packets go out
+	pos += gnutv_data_packetise(pos, TRANSPORT_PAT_PID, &cc, r->pat, r->pat_len);
+	for(i=0; i < r->program_count; i++)
+		pos += gnutv_data_packetise(pos, r->programs[i].out_pid, &cc,
+					    r->programs[i].pmt, r->programs[i].pmt_len);
+	r->psi_packets = (pos - r->psi) / TRANSPORT_PACKET_LENGTH;
+}
+
+int gnutv_remux_set_pmt(struct gnutv_remux *r, int transport_stream_id, int pmt_pid,
+			struct mpeg_pmt_section *pmt)
+{
+	struct remux_program *prog;
+	int i;
+
+	for(i=0; i < r->program_count; i++) {
+		if (r->programs[i].program_number == pmt->head.table_id_ext)
+			break;
+	}
+	if (i == GNUTV_REMUX_MAX_PROGRAMS)
+		return -1;
+	prog = &r->programs[i];
+
+	if ((prog->pmt_len = gnutv_data_build_pmt(prog->pmt, pmt, r->map)) < 0) {
+		prog->pmt_len = 0;
+		return -1;
+	}
+	if (i == r->program_count)
+		r->program_count++;
+	prog->program_number = pmt->head.table_id_ext;
+	prog->pmt_pid = pmt_pid;
+	prog->out_pid = (r->map[pmt_pid] == GNUTV_REMUX_DROP) ? pmt_pid : r->map[pmt_pid];
+
+	// the PSI coming in is replaced wholesale
+	memset(r->psi_pid, 0, sizeof(r->psi_pid));
+	r->psi_pid[TRANSPORT_PAT_PID] = 1;
+	for(i=0; i < r->program_count; i++)
+		r->psi_pid[r->programs[i].pmt_pid] = 1;
+
+	if ((r->pcr_pid == -1) && (r->map[pmt->pcr_pid] != GNUTV_REMUX_DROP))
+		r->pcr_pid = r->map[pmt->pcr_pid];
+
+	r->transport_stream_id = transport_stream_id;
+	gnutv_remux_build_pat(r);
+	r->next_psi = 0;
+	return 0;
+}
+
+static inline int gnutv_remux_has_pcr(uint8_t *pkt)
+{
+	return (pkt[3] & 0x20) && (pkt[4] >= 7) && (pkt[5] & transport_adaptation_flag_pcr);
+}
+
+static inline int64_t gnutv_remux_get_pcr(uint8_t *pkt)
+{
+	uint64_t base = ((uint64_t) pkt[6] << 25) | (pkt[7] << 17) | (pkt[8] << 9) |
+			(pkt[9] << 1) | (pkt[10] >> 7);
+
+	return base * 300 + (((pkt[10] & 1) << 8) | pkt[11]);
+}
+
+static inline void gnutv_remux_put_pcr(uint8_t *pkt, int64_t pcr)
+{
+	uint64_t base = pcr / 300;
+	int ext = pcr % 300;
+
+	pkt[6] = base >> 25;
+	pkt[7] = base >> 17;
+	pkt[8] = base >> 9;
+	pkt[9] = base >> 1;
+	pkt[10] = ((base & 1) << 7) | 0x7e | (ext >> 8);
+	pkt[11] = ext;
+}
+
+/**
+ * CBR: work out how many null packets have to go before a PCR packet which
+ * would otherwise be output packet number index for its PCR to be on time,
+ * and restamp it for where it ends up.
+ *
+ * @param room Most null packets there is room for.
+ * @return Number of null packets to insert.
+ */
+static int gnutv_remux_pcr(struct gnutv_remux *r, uint8_t *pkt, uint64_t index, int room)
+{
+	int64_t pcr = gnutv_remux_get_pcr(pkt);
+	int64_t dt;
+	int64_t nulls;
+
+	if (!r->anchored)
+		goto anchor;
+
+	dt = (pcr - r->anchor_pcr + PCR_WRAP) % PCR_WRAP;
+	nulls = (int64_t) (r->anchor_index + (uint64_t) (dt / r->ticks_per_packet)) - (int64_t) index;
+	if ((dt > PCR_WRAP / 2) || (nulls > r->max_gap) || (nulls < -r->max_gap)) {
+		r->stats.resyncs++;
+		goto anchor;
+	}
+	if (nulls < 0) {
+		r->stats.late++;
+		nulls = 0;
+	}
+	if (nulls > room)
+		nulls = room;
+
+	index += nulls;
+	gnutv_remux_put_pcr(pkt, (r->anchor_pcr + (int64_t) ((index - r->anchor_index) *
+			     r->ticks_per_packet)) % PCR_WRAP);
+	r->stats.pcrs++;
+	return nulls;
+
+anchor:
+	r->anchored = 1;
+	r->anchor_pcr = pcr;
+	r->anchor_index = index;
+	return 0;
+}
+
+int gnutv_remux_process(struct gnutv_remux *r, uint8_t *buf, int size, int room, int64_t now)
+{
+	int count = size / TRANSPORT_PACKET_LENGTH;
+	int limit = room / TRANSPORT_PACKET_LENGTH;
+	int inserts = 0;
+	int extra = 0;
+	int kept = 0;
+	int psi = 0;
+	int src_end, dst_end;
+	int total;
+	int i, j;
+
+	// the PSI goes first, when due and if it fits
+	if (r->program_count && (now >= r->next_psi) && ((count + r->psi_packets) <= limit)) {
+		psi = r->psi_packets;
+		r->next_psi = now + GNUTV_REMUX_PSI_INTERVAL;
+	}
+
+	// drop and renumber, moving what is kept down over what is not
+	for(i=0; i < count; i++) {
+		uint8_t *pkt = buf + i * TRANSPORT_PACKET_LENGTH;
+		uint8_t *dst = buf + kept * TRANSPORT_PACKET_LENGTH;
+		int pid, out;
+
+		if (pkt[0] != TRANSPORT_PACKET_SYNC) {
+			r->stats.dropped++;
+			continue;
+		}
+		pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+		if ((out = r->map[pid]) == GNUTV_REMUX_DROP) {
+			if (pid == TRANSPORT_NULL_PID)
+				r->stats.nulls_removed++;
+			else
+				r->stats.dropped++;
+			continue;
+		}
+		if (r->psi_pid[pid]) {
+			r->stats.dropped++;
+			continue;
+		}
+
+		if (dst != pkt)
+			memcpy(dst, pkt, TRANSPORT_PACKET_LENGTH);
+		if (out != pid) {
+			dst[1] = (dst[1] & 0xe0) | (out >> 8);
+			dst[2] = out;
+		}
+
+		if (r->cbr_rate && gnutv_remux_has_pcr(dst) &&
+		    ((r->pcr_pid == -1) || (r->pcr_pid == out)) &&
+		    (inserts < REMUX_MAX_INSERTS)) {
+			int nulls;
+
+			r->pcr_pid = out;
+			nulls = gnutv_remux_pcr(r, dst, r->stats.packets_out + psi + extra + kept,
+						limit - (psi + extra + kept + (count - i)));
+			if (nulls) {
+				r->inserts[inserts].pos = kept;
+				r->inserts[inserts].count = nulls;
+				inserts++;
+				extra += nulls;
+			}
+		}
+		kept++;
+	}
+
+	// then open up the gaps for the PSI and stuffing, from the end
+	total = psi + extra + kept;
+	src_end = kept;
+	dst_end = total;
+	for(i = inserts - 1; i >= 0; i--) {
+		int seg = src_end - r->inserts[i].pos;
+
+		dst_end -= seg;
+		memmove(buf + dst_end * TRANSPORT_PACKET_LENGTH,
+			buf + r->inserts[i].pos * TRANSPORT_PACKET_LENGTH, seg * TRANSPORT_PACKET_LENGTH);
+		for(j=0; j < r->inserts[i].count; j++) {
+			dst_end--;
+			memcpy(buf + dst_end * TRANSPORT_PACKET_LENGTH, r->null_packet,
+			       TRANSPORT_PACKET_LENGTH);
+		}
+		src_end = r->inserts[i].pos;
+	}
+	if (psi) {
+		uint8_t *pos = buf;
+
+		memmove(buf + psi * TRANSPORT_PACKET_LENGTH, buf, src_end * TRANSPORT_PACKET_LENGTH);
+		memcpy(pos, r->psi, psi * TRANSPORT_PACKET_LENGTH);
+		transport_packet_set_continuity(pos, PSI_PACKETS(r->pat_len), &r->pat_cc);
+		pos += PSI_PACKETS(r->pat_len) * TRANSPORT_PACKET_LENGTH;
+		for(i=0; i < r->program_count; i++) {
+			if (r->programs[i].pmt_len == 0)
+				continue;
+			transport_packet_set_continuity(pos, PSI_PACKETS(r->programs[i].pmt_len),
+							&r->programs[i].cc);
+			pos += PSI_PACKETS(r->programs[i].pmt_len) * TRANSPORT_PACKET_LENGTH;
+		}
+	}
+
+	r->stats.packets_in += count;
+	r->stats.packets_out += total;
+	r->stats.nulls_inserted += extra;
+	return total * TRANSPORT_PACKET_LENGTH;
+}
+
+void gnutv_remux_get_stats(struct gnutv_remux *r, struct gnutv_remux_stats *stats)
+{
+	memcpy(stats, &r->stats, sizeof(struct gnutv_remux_stats));
+}
@@ -0,0 +1,117 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_REMUX_H
+#define gnutv_REMUX_H 1
+
+#include <stdint.h>
+
+/**
+ * A remultiplexing pass over the TS on its way to an output, done in place
+ * on buffers of whole packets:
+ *
+ * - PIDs are dropped or renumbered through a table indexed by PID.
+ * - Once the PMTs of the programs are known, the PAT and PMTs coming in are
+ *   dropped, and tables holding just those programs (with the new PIDs) are
+ *   sent instead, every GNUTV_REMUX_PSI_INTERVAL.
+ * - VBR: null packets are removed.
+ * - CBR: the null packets coming in are replaced by enough of them before
+ *   each PCR to put it where it belongs in a stream of the given rate, and
+ *   the PCR is restamped for the exact place it ends up in.
+ *
+ * Packets whose PID is kept and unchanged are not touched, nor copied unless
+ * a packet before them was dropped.
+ */
+struct gnutv_remux;
+struct mpeg_pmt_section;
+
+#define GNUTV_REMUX_DROP 0xffff
+#define GNUTV_REMUX_MAX_PROGRAMS 32
+#define GNUTV_REMUX_PSI_INTERVAL 100000000LL	// ns
+
+struct gnutv_remux_stats {
+	uint64_t packets_in;
+	uint64_t packets_out;
+	uint64_t dropped;		// by the PID table, or as stale PSI
+	uint64_t nulls_removed;
+	uint64_t nulls_inserted;
+	uint64_t pcrs;			// restamped
+	uint64_t late;			// PCRs already past their place at the CBR rate
+	uint64_t resyncs;		// PCR jumps, or too far adrift to recover
+};
+
+/**
+ * Create a remux. With neither cbr_rate nor vbr, null packets are passed
+ * on like any other.
+ *
+ * @param cbr_rate Output rate in bits/s, 0 for none.
+ * @param vbr Remove the null packets.
+ * @return The remux, or NULL if out of memory.
+ */
+extern struct gnutv_remux *gnutv_remux_create(uint64_t cbr_rate, int vbr);
+
+extern void gnutv_remux_destroy(struct gnutv_remux *r);
+
+/**
+ * Set the PID table from a list of IN:OUT pairs separated by commas, where
+ * OUT is a PID or "drop". PIDs not in the list are passed on as they are,
+ * unless one of the list is moved onto them, which drops them.
+ *
+ * @return 0 on success, or -1 with errno EINVAL (bad list) or EEXIST (two
+ * PIDs of the list would end up on one).
+ */
+extern int gnutv_remux_set_map(struct gnutv_remux *r, const char *spec);
+
+/**
+ * @return What a PID is sent out as: itself, another PID, or
+ * GNUTV_REMUX_DROP.
+ */
+extern int gnutv_remux_map(struct gnutv_remux *r, int pid);
+
+/**
+ * Set (or replace) the PMT of a program, which starts the regeneration of
+ * the PSI. The PMT must have been through mpeg_pmt_section_codec(); it is
+ * copied. Streams on dropped PIDs are left out of the new PMT.
+ *
+ * @param transport_stream_id For the PAT.
+ * @param pmt_pid PID the PMT comes in on.
+ * @return 0 on success, -1 if there are too many programs or the PMT is
+ * too large.
+ */
+extern int gnutv_remux_set_pmt(struct gnutv_remux *r, int transport_stream_id, int pmt_pid,
+			       struct mpeg_pmt_section *pmt);
+
+/**
+ * Run packets through the remux, in place.
+ *
+ * @param buf The packets; the output is written over them.
+ * @param size Their length, a multiple of TRANSPORT_PACKET_LENGTH.
+ * @param room Bytes available at buf for the output: with CBR stuffing or
+ * PSI to insert it may be longer than the input. Stuffing which does not
+ * fit is made up at the next PCR.
+ * @param now CLOCK_MONOTONIC time in ns, for the PSI repetition.
+ * @return Length of the output.
+ */
+extern int gnutv_remux_process(struct gnutv_remux *r, uint8_t *buf, int size, int room, int64_t now);
+
+extern void gnutv_remux_get_stats(struct gnutv_remux *r, struct gnutv_remux_stats *stats);
+
+#endif
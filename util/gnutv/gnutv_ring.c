@@ -0,0 +1,349 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/poll.h>
+#include <sys/eventfd.h>
+#include <libdvbapi/dvbdemux.h>
+#include "gnutv_ring.h"
+
+#define CACHE_LINE 64
+
+/*
+ * Positions are free running byte counts; only the producer writes head,
+ * and only its consumer writes each tail. The eventfds are just for
+ * sleeping: the data itself is handed over with the atomic positions.
+ */
+struct ring_consumer {
+	uint64_t tail;
+	int efd;
+} __attribute__((aligned(CACHE_LINE)));
+
+struct gnutv_ring {
+	uint8_t *buf;
+	size_t buf_size;		// as allocated, >= size
+	size_t size;
+	size_t align;
+	int policy;
+	int consumer_count;
+
+	uint64_t head __attribute__((aligned(CACHE_LINE)));
+	int closed;
+	int producer_waiting;
+	int producer_efd;
+
+	// statistics, updated by the producer
+	size_t high_water;
+	uint64_t dropped;
+	uint64_t drops;
+
+	struct ring_consumer consumers[];
+};
+
+static void ring_signal(int efd)
+{
+	uint64_t one = 1;
+
+	if (write(efd, &one, sizeof(one)) < 0) {
+		// only fails if the counter is saturated: it's signalled anyway
+	}
+}
+
+static void ring_clear(int efd)
+{
+	uint64_t count;
+
+	if (read(efd, &count, sizeof(count)) < 0) {
+		// EAGAIN: nothing to clear
+	}
+}
+
+static int ring_wait(int efd, int timeout)
+{
+	struct pollfd pollfd;
+
+	pollfd.fd = efd;
+	pollfd.events = POLLIN;
+
+	return poll(&pollfd, 1, timeout) > 0;
+}
+
+static uint64_t ring_min_tail(struct gnutv_ring *ring)
+{
+	uint64_t min = __atomic_load_n(&ring->consumers[0].tail, __ATOMIC_SEQ_CST);
+	uint64_t tail;
+	int i;
+
+	for(i=1; i < ring->consumer_count; i++) {
+		tail = __atomic_load_n(&ring->consumers[i].tail, __ATOMIC_SEQ_CST);
+		if (tail < min)
+			min = tail;
+	}
+
+	return min;
+}
+
+struct gnutv_ring *gnutv_ring_create(size_t size, size_t align, int consumers, int policy,
+				     int hugepages)
+{
+	struct gnutv_ring *ring;
+	int i;
+
+	if ((consumers < 1) || (align == 0))
+		return NULL;
+	size = ((size + align - 1) / align) * align;
+
+	if (posix_memalign((void **) &ring, CACHE_LINE,
+			   sizeof(struct gnutv_ring) + consumers * sizeof(struct ring_consumer)))
+		return NULL;
+	memset(ring, 0, sizeof(struct gnutv_ring) + consumers * sizeof(struct ring_consumer));
+	ring->size = size;
+	ring->align = align;
+	ring->policy = policy;
+	ring->consumer_count = consumers;
+	ring->producer_efd = -1;
+	for(i=0; i < consumers; i++)
+		ring->consumers[i].efd = -1;
+
+	// prefaulted: the producer must never stall on a page fault
+	ring->buf_size = size;
+	if ((ring->buf = dvbdemux_alloc_buffer(&ring->buf_size, &hugepages)) == NULL)
+		goto error;
+
+	if ((ring->producer_efd = eventfd(0, EFD_NONBLOCK)) < 0)
+		goto error;
+	for(i=0; i < consumers; i++) {
+		if ((ring->consumers[i].efd = eventfd(0, EFD_NONBLOCK)) < 0)
+			goto error;
+	}
+
+	return ring;
+
+error:
+	gnutv_ring_destroy(ring);
+	return NULL;
+}
+
+void gnutv_ring_destroy(struct gnutv_ring *ring)
+{
+	int i;
+
+	for(i=0; i < ring->consumer_count; i++) {
+		if (ring->consumers[i].efd != -1)
+			close(ring->consumers[i].efd);
+	}
+	if (ring->producer_efd != -1)
+		close(ring->producer_efd);
+	if (ring->buf)
+		dvbdemux_free_buffer(ring->buf, ring->buf_size);
+	free(ring);
+}
+
+uint8_t *gnutv_ring_write_ptr(struct gnutv_ring *ring, size_t *avail, int timeout)
+{
+	uint64_t head = ring->head;
+	uint64_t tail;
+	size_t space;
+	size_t offset;
+
+	while(1) {
+		tail = ring_min_tail(ring);
+		space = ring->size - (head - tail);
+		if (space)
+			break;
+		if ((ring->policy == GNUTV_RING_DROP) || (timeout == 0))
+			return NULL;
+
+		// ask the consumers for a wakeup, then make sure we didn't miss it
+		ring_clear(ring->producer_efd);
+		__atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_SEQ_CST);
+		if (ring_min_tail(ring) == tail) {
+			if (!ring_wait(ring->producer_efd, timeout)) {
+				__atomic_store_n(&ring->producer_waiting, 0, __ATOMIC_SEQ_CST);
+				return NULL;
+			}
+		}
+		__atomic_store_n(&ring->producer_waiting, 0, __ATOMIC_SEQ_CST);
+	}
+
+	offset = head % ring->size;
+	*avail = ring->size - offset;
+	if (*avail > space)
+		*avail = space;
+
+	return ring->buf + offset;
+}
+
+void gnutv_ring_write_commit(struct gnutv_ring *ring, size_t len)
+{
+	uint64_t head = ring->head + len;
+	size_t fill;
+	int i;
+
+	__atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+
+	fill = head - ring_min_tail(ring);
+	if (fill > ring->high_water)
+		ring->high_water = fill;
+
+	for(i=0; i < ring->consumer_count; i++)
+		ring_signal(ring->consumers[i].efd);
+}
+
+void gnutv_ring_dropped(struct gnutv_ring *ring, size_t len)
+{
+	ring->dropped += len;
+	ring->drops++;
+}
+
+void gnutv_ring_close(struct gnutv_ring *ring)
+{
+	int i;
+
+	__atomic_store_n(&ring->closed, 1, __ATOMIC_SEQ_CST);
+	for(i=0; i < ring->consumer_count; i++)
+		ring_signal(ring->consumers[i].efd);
+}
+
+int gnutv_ring_fd(struct gnutv_ring *ring, int consumer)
+{
+	return ring->consumers[consumer].efd;
+}
+
+int gnutv_ring_read(struct gnutv_ring *ring, int consumer, uint8_t *buf, size_t size, int timeout)
+{
+	struct ring_consumer *c = &ring->consumers[consumer];
+	uint64_t head;
+	size_t offset;
+	size_t count;
+	size_t part;
+
+	// clear the wakeup before looking, so none is lost
+	ring_clear(c->efd);
+	head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+	if ((head == c->tail) && timeout) {
+		ring_wait(c->efd, timeout);
+		ring_clear(c->efd);
+		head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+	}
+	if (head == c->tail) {
+		if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST) &&
+		    (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == c->tail))
+			return -1;
+		return 0;
+	}
+
+	count = head - c->tail;
+	if (count > size)
+		count = size;
+
+	// the data may wrap around the end of the ring
+	offset = c->tail % ring->size;
+	part = ring->size - offset;
+	if (part > count)
+		part = count;
+	memcpy(buf, ring->buf + offset, part);
+	memcpy(buf + part, ring->buf, count - part);
+
+	__atomic_store_n(&c->tail, c->tail + count, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST))
+		ring_signal(ring->producer_efd);
+
+	// there's more left, so stay readable
+	if (head != c->tail)
+		ring_signal(c->efd);
+
+	return count;
+}
+
+int gnutv_ring_peek(struct gnutv_ring *ring, int consumer, uint8_t **data, int timeout)
+{
+	struct ring_consumer *c = &ring->consumers[consumer];
+	uint64_t head;
+	size_t offset;
+	size_t count;
+
+	// as gnutv_ring_read()
+	ring_clear(c->efd);
+	head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+	if ((head == c->tail) && timeout) {
+		ring_wait(c->efd, timeout);
+		ring_clear(c->efd);
+		head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+	}
+	if (head == c->tail) {
+		if (__atomic_load_n(&ring->closed, __ATOMIC_SEQ_CST) &&
+		    (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == c->tail))
+			return -1;
+		return 0;
+	}
+
+	offset = c->tail % ring->size;
+	count = head - c->tail;
+	if (count > ring->size - offset)
+		count = ring->size - offset;
+
+	*data = ring->buf + offset;
+	return count;
+}
+
+void gnutv_ring_consume(struct gnutv_ring *ring, int consumer, size_t len)
+{
+	struct ring_consumer *c = &ring->consumers[consumer];
+
+	__atomic_store_n(&c->tail, c->tail + len, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST))
+		ring_signal(ring->producer_efd);
+
+	// there's more left, so stay readable
+	if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) != c->tail)
+		ring_signal(c->efd);
+}
+
+size_t gnutv_ring_skip(struct gnutv_ring *ring, int consumer, size_t lag)
+{
+	struct ring_consumer *c = &ring->consumers[consumer];
+	uint64_t waiting = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) - c->tail;
+	size_t skip;
+
+	if (waiting <= lag)
+		return 0;
+
+	skip = ((waiting - lag + ring->align - 1) / ring->align) * ring->align;
+	if (skip > waiting)
+		skip -= ring->align;
+	gnutv_ring_consume(ring, consumer, skip);
+	return skip;
+}
+
+void gnutv_ring_get_stats(struct gnutv_ring *ring, struct gnutv_ring_stats *stats)
+{
+	stats->size = ring->size;
+	stats->fill = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) - ring_min_tail(ring);
+	stats->high_water = ring->high_water;
+	stats->bytes = ring->head;
+	stats->dropped = ring->dropped;
+	stats->drops = ring->drops;
+}
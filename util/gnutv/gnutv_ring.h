@@ -0,0 +1,132 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_RING_H
+#define gnutv_RING_H 1
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * A lock-free single producer, multiple consumer ring buffer. The producer
+ * (the DVR drain thread) writes straight into the ring, and each consumer
+ * has its own read position; space is only freed once every consumer is
+ * done with it.
+ */
+struct gnutv_ring;
+
+// what the producer does when the ring is full
+#define GNUTV_RING_BLOCK 0	// wait for the consumers to make room
+#define GNUTV_RING_DROP 1	// throw the new data away
+
+struct gnutv_ring_stats {
+	size_t size;
+	size_t fill;			// current fill level (of the slowest consumer)
+	size_t high_water;		// highest fill level seen
+	uint64_t bytes;			// bytes written
+	uint64_t dropped;		// bytes thrown away because the ring was full
+	uint64_t drops;			// ... in this many chunks
+};
+
+/**
+ * Create a ring. The size is rounded up so that it holds a whole number of
+ * align byte units; the producer gets contiguous space in multiples of it
+ * as long as it only writes multiples of it.
+ *
+ * @param size Size in bytes.
+ * @param align Unit size, e.g. a TS packet.
+ * @param consumers Number of consumers.
+ * @param policy GNUTV_RING_BLOCK or GNUTV_RING_DROP.
+ * @param hugepages If 1, back the ring with huge pages if possible.
+ * @return The ring, or NULL on error.
+ */
+extern struct gnutv_ring *gnutv_ring_create(size_t size, size_t align, int consumers, int policy,
+					    int hugepages);
+
+extern void gnutv_ring_destroy(struct gnutv_ring *ring);
+
+/**
+ * Producer: get the contiguous free space. With GNUTV_RING_BLOCK, waits up
+ * to timeout ms for some to become free.
+ *
+ * @param avail Set to the number of bytes which may be written.
+ * @return Pointer to write to, or NULL if there is no space.
+ */
+extern uint8_t *gnutv_ring_write_ptr(struct gnutv_ring *ring, size_t *avail, int timeout);
+
+/**
+ * Producer: publish len bytes written at gnutv_ring_write_ptr().
+ */
+extern void gnutv_ring_write_commit(struct gnutv_ring *ring, size_t len);
+
+/**
+ * Producer: account for len bytes which were dropped for lack of space.
+ */
+extern void gnutv_ring_dropped(struct gnutv_ring *ring, size_t len);
+
+/**
+ * Producer: no more data will be written; wakes up the consumers.
+ */
+extern void gnutv_ring_close(struct gnutv_ring *ring);
+
+/**
+ * Consumer: a file descriptor which becomes readable (for poll()) when
+ * there is new data for the consumer.
+ */
+extern int gnutv_ring_fd(struct gnutv_ring *ring, int consumer);
+
+/**
+ * Consumer: copy out up to size bytes, waiting up to timeout ms for some.
+ *
+ * @return Number of bytes copied, 0 on timeout, -1 if the ring is closed
+ * and empty.
+ */
+extern int gnutv_ring_read(struct gnutv_ring *ring, int consumer, uint8_t *buf, size_t size, int timeout);
+
+/**
+ * Consumer: get at the data waiting in the ring itself, up to the end of
+ * the ring, waiting up to timeout ms for some. It stays in place until
+ * passed on with gnutv_ring_consume().
+ *
+ * @param data Set to the data.
+ * @return Number of bytes at *data, 0 on timeout, -1 if the ring is closed
+ * and empty.
+ */
+extern int gnutv_ring_peek(struct gnutv_ring *ring, int consumer, uint8_t **data, int timeout);
+
+/**
+ * Consumer: done with len bytes from gnutv_ring_peek().
+ */
+extern void gnutv_ring_consume(struct gnutv_ring *ring, int consumer, size_t len);
+
+/**
+ * Consumer: if more than lag bytes are waiting, skip the oldest, in whole
+ * align units, so that no more than lag are left. A consumer which may
+ * lose data doing this never holds the producer (or the other consumers)
+ * back for long.
+ *
+ * @return Number of bytes skipped.
+ */
+extern size_t gnutv_ring_skip(struct gnutv_ring *ring, int consumer, size_t lag);
+
+extern void gnutv_ring_get_stats(struct gnutv_ring *ring, struct gnutv_ring_stats *stats);
+
+#endif
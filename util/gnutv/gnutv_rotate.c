@@ -0,0 +1,468 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <libucsi/section.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/mpeg/pmt_section.h>
+#include <libucsi/mpeg/types.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_rotate.h"
+#include "gnutv_timeshift.h"
+#include "gnutv_data.h"
+
+/**
+ * A finished file, waiting for the helper to hand it off.
+ */
+struct rotate_done {
+	struct rotate_done *next;
+	int fd;
+	uint64_t written;
+	uint64_t allocated;
+};
+
+struct gnutv_rotate {
+	char name[PATH_MAX];
+	int seconds;
+	uint64_t bytes;
+	int keyframe;
+	int packet_size;
+	unsigned int seq;		// of the file being written
+	time_t started;			// when the recording started
+
+	// by gnutv_rotate_set_pmt(), possibly from another thread:
+	// (stream_type << 16) | pid, or -1
+	volatile int video;
+
+	// the file being written, by the writer alone
+	char cur_name[PATH_MAX];
+	int fd;
+	uint64_t written;
+	uint64_t allocated;
+	time_t file_start;		// when its first byte came
+	time_t deadline;		// of a cut on time
+	int cutting;			// 1 => cut at the next boundary (or keyframe)
+	time_t cut_since;
+
+	// shared with the helper, under lock
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	pthread_t thread;
+	int shutdown;
+	int want_next;			// 1 => the helper is to open next_name
+	int creating;			// 1 => the helper is opening it
+	char next_name[PATH_MAX];
+	uint64_t next_size;		// to preallocate
+	int next_fd;			// -1 => none open
+	uint64_t next_allocated;
+	struct rotate_done *done_head;
+	struct rotate_done **done_tail;
+	uint64_t late;			// cuts the next file was not ready for
+};
+
+/**
+ * The first multiple of seconds in local time after t.
+ */
+static time_t gnutv_rotate_boundary(int seconds, time_t t)
+{
+	struct tm tm;
+	long offset;
+
+	localtime_r(&t, &tm);
+	offset = tm.tm_gmtoff;
+	return (((t + offset) / seconds) + 1) * seconds - offset;
+}
+
+/**
+ * The name of file seq, due to start at start.
+ */
+static void gnutv_rotate_name(struct gnutv_rotate *rot, unsigned int seq, time_t start,
+			      char *name, size_t size)
+{
+	struct tm tm;
+	size_t len;
+
+	if (rot->seconds == 0)
+		start = rot->started;
+	localtime_r(&start, &tm);
+	if ((len = strftime(name, size, rot->name, &tm)) == 0)
+		len = snprintf(name, size, "%s", rot->name);
+	if ((rot->seconds == 0) || !strcmp(name, rot->name))
+		snprintf(name + len, size - len, ".%06u", seq);
+}
+
+/**
+ * Open a file for the recording, preallocating size bytes of it where the
+ * filesystem allows.
+ *
+ * @return The file descriptor, or -1 (reported).
+ */
+static int gnutv_rotate_create(const char *name, uint64_t size, uint64_t *allocated)
+{
+	int fd;
+
+	*allocated = 0;
+	if ((fd = open(name, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "Failed to open output file %s: %m\n", name);
+		return -1;
+	}
+	if (size && (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, size) == 0))
+		*allocated = size;
+	return fd;
+}
+
+/**
+ * Hand a finished file off: nothing preallocated past its end is kept, and
+ * it is on disk before it is closed.
+ */
+static void gnutv_rotate_finish(struct rotate_done *done)
+{
+	if (done->allocated > done->written)
+		fallocate(done->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			  done->written, done->allocated - done->written);
+	if (fdatasync(done->fd))
+		fprintf(stderr, "Failed to sync output file: %m\n");
+	close(done->fd);
+}
+
+static void *gnutv_rotate_thread(void *arg)
+{
+	struct gnutv_rotate *rot = arg;
+	struct rotate_done *done;
+	char name[PATH_MAX];
+	uint64_t size;
+	uint64_t allocated;
+	int fd;
+
+	pthread_mutex_lock(&rot->lock);
+	while(1) {
+		if ((done = rot->done_head) != NULL) {
+			if ((rot->done_head = done->next) == NULL)
+				rot->done_tail = &rot->done_head;
+			pthread_mutex_unlock(&rot->lock);
+			gnutv_rotate_finish(done);
+			free(done);
+			pthread_mutex_lock(&rot->lock);
+			continue;
+		}
+
+		if (rot->shutdown)
+			break;
+
+		if (rot->want_next) {
+			rot->want_next = 0;
+			rot->creating = 1;
+			snprintf(name, sizeof(name), "%s", rot->next_name);
+			size = rot->next_size;
+			pthread_mutex_unlock(&rot->lock);
+			fd = gnutv_rotate_create(name, size, &allocated);
+			pthread_mutex_lock(&rot->lock);
+			rot->creating = 0;
+			rot->next_fd = fd;
+			rot->next_allocated = allocated;
+			pthread_cond_broadcast(&rot->cond);
+			continue;
+		}
+
+		pthread_cond_wait(&rot->cond, &rot->lock);
+	}
+
+	// a file opened ahead of time, and never written, is not wanted
+	if (rot->next_fd != -1) {
+		close(rot->next_fd);
+		unlink(rot->next_name);
+		rot->next_fd = -1;
+	}
+	pthread_mutex_unlock(&rot->lock);
+	return NULL;
+}
+
+/**
+ * Ask the helper for the file after the one being written. Call locked.
+ */
+static void gnutv_rotate_want_next(struct gnutv_rotate *rot, uint64_t size)
+{
+	size_t len;
+
+	gnutv_rotate_name(rot, rot->seq + 1, rot->deadline, rot->next_name, sizeof(rot->next_name));
+	// a name of coarser time than the period must not truncate this file
+	if (!strcmp(rot->next_name, rot->cur_name)) {
+		len = strlen(rot->next_name);
+		snprintf(rot->next_name + len, sizeof(rot->next_name) - len, ".%06u", rot->seq + 1);
+	}
+	rot->next_size = size;
+	rot->want_next = 1;
+	pthread_cond_broadcast(&rot->cond);
+}
+
+struct gnutv_rotate *gnutv_rotate_open(const char *name, int seconds, uint64_t bytes,
+				       int keyframe, int packet_size)
+{
+	struct gnutv_rotate *rot;
+
+	if ((rot = calloc(1, sizeof(struct gnutv_rotate))) == NULL) {
+		fprintf(stderr, "Out of memory for rotating recording\n");
+		return NULL;
+	}
+	snprintf(rot->name, sizeof(rot->name), "%s", name);
+	rot->seconds = seconds;
+	rot->bytes = bytes;
+	if (bytes && (bytes < (uint64_t) packet_size))
+		rot->bytes = packet_size;
+	rot->keyframe = keyframe;
+	rot->packet_size = packet_size;
+	rot->video = -1;
+	rot->next_fd = -1;
+	rot->done_tail = &rot->done_head;
+	pthread_mutex_init(&rot->lock, NULL);
+	pthread_cond_init(&rot->cond, NULL);
+
+	rot->started = rot->file_start = time(NULL);
+	if (seconds)
+		rot->deadline = gnutv_rotate_boundary(seconds, rot->file_start);
+	gnutv_rotate_name(rot, 0, rot->file_start, rot->cur_name, sizeof(rot->cur_name));
+	if ((rot->fd = gnutv_rotate_create(rot->cur_name, bytes, &rot->allocated)) < 0)
+		goto fail;
+
+	if (pthread_create(&rot->thread, NULL, gnutv_rotate_thread, rot)) {
+		fprintf(stderr, "Failed to start the file rotation thread\n");
+		close(rot->fd);
+		goto fail;
+	}
+
+	// how much a file on time holds is not known until one is complete
+	pthread_mutex_lock(&rot->lock);
+	gnutv_rotate_want_next(rot, bytes);
+	pthread_mutex_unlock(&rot->lock);
+	return rot;
+
+fail:
+	pthread_cond_destroy(&rot->cond);
+	pthread_mutex_destroy(&rot->lock);
+	free(rot);
+	return NULL;
+}
+
+void gnutv_rotate_set_pmt(struct gnutv_rotate *rot, struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	int video = -1;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		switch(cur_stream->stream_type) {
+		case MPEG_STREAM_TYPE_ISO11172_VIDEO:
+		case MPEG_STREAM_TYPE_ISO13818_2_VIDEO:
+		case MPEG_STREAM_TYPE_ISO14496_10_VIDEO:
+		case MPEG_STREAM_TYPE_ISO23008_2_VIDEO:
+			if (video == -1)
+				video = (cur_stream->stream_type << 16) | cur_stream->pid;
+			break;
+		}
+	}
+
+	rot->video = video;
+}
+
+/**
+ * Switch to the next file, which the helper has normally opened already;
+ * the finished one is queued for it to hand off.
+ *
+ * @return 0 on success, -1 if no file could be opened.
+ */
+static int gnutv_rotate_switch(struct gnutv_rotate *rot, time_t now)
+{
+	struct rotate_done *done;
+	uint64_t size = rot->bytes;
+	uint64_t allocated;
+	double elapsed;
+	int fd;
+
+	if ((done = malloc(sizeof(struct rotate_done))) == NULL) {
+		fprintf(stderr, "Out of memory for rotating recording\n");
+		return -1;
+	}
+	done->next = NULL;
+	done->fd = rot->fd;
+	done->written = rot->written;
+	done->allocated = rot->allocated;
+
+	// a file on time preallocates at the rate of the last complete one
+	elapsed = difftime(now, rot->file_start);
+	if (rot->seconds && (elapsed >= rot->seconds / 2) && (elapsed > 0))
+		size = (uint64_t) ((rot->written / elapsed) * rot->seconds);
+
+	pthread_mutex_lock(&rot->lock);
+	if (rot->next_fd == -1) {
+		rot->late++;
+		while(rot->creating)
+			pthread_cond_wait(&rot->cond, &rot->lock);
+	}
+	fd = rot->next_fd;
+	allocated = rot->next_allocated;
+	rot->next_fd = -1;
+	if (fd == -1) {
+		// not picked up yet, or it failed: open it here rather than lose data
+		rot->want_next = 0;
+		pthread_mutex_unlock(&rot->lock);
+		fd = gnutv_rotate_create(rot->next_name, size, &allocated);
+		pthread_mutex_lock(&rot->lock);
+		if (fd == -1) {
+			pthread_mutex_unlock(&rot->lock);
+			free(done);
+			return -1;
+		}
+	}
+	*rot->done_tail = done;
+	rot->done_tail = &done->next;
+
+	rot->seq++;
+	snprintf(rot->cur_name, sizeof(rot->cur_name), "%s", rot->next_name);
+	rot->fd = fd;
+	rot->written = 0;
+	rot->allocated = allocated;
+	rot->file_start = now;
+	rot->cutting = 0;
+	if (rot->seconds)
+		rot->deadline = gnutv_rotate_boundary(rot->seconds,
+						      (now > rot->deadline) ? now : rot->deadline);
+	gnutv_rotate_want_next(rot, size);
+	pthread_mutex_unlock(&rot->lock);
+	return 0;
+}
+
+static int gnutv_rotate_put(struct gnutv_rotate *rot, uint8_t *buf, int len)
+{
+	int direct = 0;
+
+	if (len == 0)
+		return 0;
+	if (gnutv_data_write(rot->fd, buf, len, &direct))
+		return -1;
+	rot->written += len;
+	return 0;
+}
+
+/**
+ * Where to cut in buf: the first packet boundary, or the start of the
+ * first whole packet beginning a video keyframe.
+ *
+ * @return The offset, or -1 to look again in the next data.
+ */
+static int gnutv_rotate_cut(struct gnutv_rotate *rot, uint8_t *buf, int len, time_t now)
+{
+	int ps = rot->packet_size;
+	int pos = (ps - (int) (rot->written % ps)) % ps;
+	int video = rot->video;
+	uint64_t pts;
+	uint8_t *pkt;
+	int flags;
+
+	if (!rot->keyframe || (video == -1) || (now - rot->cut_since >= GNUTV_ROTATE_KEY_WAIT))
+		return (pos <= len) ? pos : -1;
+
+	for(; pos + ps <= len; pos += ps) {
+		pkt = buf + pos + ps - TRANSPORT_PACKET_LENGTH;
+		if ((pkt[0] != TRANSPORT_PACKET_SYNC) ||
+		    ((((pkt[1] & 0x1f) << 8) | pkt[2]) != (video & 0x1fff)) ||
+		    !(pkt[1] & 0x40) || (pkt[3] & 0xc0))
+			continue;
+		flags = gnutv_timeshift_keyframe(video >> 16, pkt, &pts);
+		if ((flags != -1) && (flags & GNUTV_TIMESHIFT_KEYFRAME))
+			return pos;
+	}
+	return -1;
+}
+
+int gnutv_rotate_write(struct gnutv_rotate *rot, uint8_t *buf, int len)
+{
+	time_t now = time(NULL);
+	uint64_t room;
+	int cut;
+
+	while(len) {
+		if (!rot->cutting) {
+			if (rot->seconds && (now >= rot->deadline)) {
+				rot->cutting = 1;
+				rot->cut_since = now;
+			} else if (rot->bytes && (rot->written + len > rot->bytes)) {
+				// up to the last whole packet that fits
+				room = rot->bytes - rot->written;
+				room -= (rot->written + room) % rot->packet_size;
+				if (gnutv_rotate_put(rot, buf, room))
+					return -1;
+				buf += room;
+				len -= room;
+				rot->cutting = 1;
+				rot->cut_since = now;
+			} else {
+				return gnutv_rotate_put(rot, buf, len);
+			}
+		}
+
+		if ((cut = gnutv_rotate_cut(rot, buf, len, now)) < 0)
+			return gnutv_rotate_put(rot, buf, len);
+		if (gnutv_rotate_put(rot, buf, cut) || gnutv_rotate_switch(rot, now))
+			return -1;
+		buf += cut;
+		len -= cut;
+	}
+	return 0;
+}
+
+void gnutv_rotate_close(struct gnutv_rotate *rot)
+{
+	struct rotate_done *done;
+
+	pthread_mutex_lock(&rot->lock);
+	if ((done = malloc(sizeof(struct rotate_done))) != NULL) {
+		done->next = NULL;
+		done->fd = rot->fd;
+		done->written = rot->written;
+		done->allocated = rot->allocated;
+		*rot->done_tail = done;
+		rot->done_tail = &done->next;
+	}
+	rot->shutdown = 1;
+	pthread_cond_broadcast(&rot->cond);
+	pthread_mutex_unlock(&rot->lock);
+	pthread_join(rot->thread, NULL);
+
+	if (done == NULL)
+		close(rot->fd);
+	if (rot->late)
+		fprintf(stderr, "Rotation: %llu files opened late\n", (unsigned long long) rot->late);
+	pthread_cond_destroy(&rot->cond);
+	pthread_mutex_destroy(&rot->lock);
+	free(rot);
+}
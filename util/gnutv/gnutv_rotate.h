@@ -0,0 +1,84 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_ROTATE_H
+#define gnutv_ROTATE_H 1
+
+#include <stdint.h>
+
+struct mpeg_pmt_section;
+
+/**
+ * A continuous recording split into files, for recording round the clock:
+ * no packet is lost or repeated between one file and the next.
+ *
+ * Files are cut on time, at every multiple of the period in local time (so
+ * -rotate 3600 cuts on the hour), or on size. The cut is made at a packet
+ * boundary, or, if asked, just before the next video keyframe, waiting up
+ * to GNUTV_ROTATE_KEY_WAIT seconds for one.
+ *
+ * The names of the files come from passing the name given through
+ * strftime() with the local time each file is due to start; if that gives
+ * no conversion, or the files are cut on size, ".NNNNNN" is appended.
+ *
+ * The writer never waits on the filesystem at a cut: a helper thread
+ * opens the next file ahead of time, preallocating what the last complete
+ * file held (or the size limit), and hands each finished file off by
+ * releasing what was preallocated past its end, then fdatasync() and
+ * close().
+ */
+struct gnutv_rotate;
+
+#define GNUTV_ROTATE_KEY_WAIT 10
+
+/**
+ * Start a rotating recording.
+ *
+ * @param name Name of the files, as above.
+ * @param seconds Cut every this many seconds, or 0.
+ * @param bytes Cut before a file would exceed this, or 0. Exactly one of
+ * seconds and bytes is set.
+ * @param keyframe If 1, cut before a keyframe rather than any packet.
+ * @param packet_size 188, or 192 for timestamped packets.
+ * @return The recording, or NULL on failure (which has been reported).
+ */
+extern struct gnutv_rotate *gnutv_rotate_open(const char *name, int seconds, uint64_t bytes,
+					      int keyframe, int packet_size);
+
+/**
+ * Tell the recording the PMT, whose first video stream keyframes are
+ * looked for in. May be called from another thread than the writer.
+ */
+extern void gnutv_rotate_set_pmt(struct gnutv_rotate *rot, struct mpeg_pmt_section *pmt);
+
+/**
+ * Add data to the recording.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+extern int gnutv_rotate_write(struct gnutv_rotate *rot, uint8_t *buf, int len);
+
+/**
+ * Finish the recording, waiting for its last file to be handed off.
+ */
+extern void gnutv_rotate_close(struct gnutv_rotate *rot);
+
+#endif
@@ -0,0 +1,1502 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbfe.h>
+#include <libdvbapi/dvbtuner.h>
+#include <libdvbapi/dvbtopo.h>
+#include <libdvbsec/dvbsec_api.h>
+#include <libdvbsec/dvbsec_cfg.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/transport_packet.h>
+#include <libdvbmisc/dvbreactor.h>
+#include "gnutv_data.h"
+#include "gnutv_satip.h"
+
+// sessions: each has a bit in the PID maps of the tuners
+#define SATIP_MAX_SESSIONS 64
+#define SATIP_MAX_TUNERS 16
+#define SATIP_MAX_CLIENTS 32
+#define SATIP_REQUEST_MAX 4096
+#define SATIP_ALL_PIDS TRANSPORT_MAX_PIDS
+
+#define SATIP_READ_SIZE (TRANSPORT_PACKET_LENGTH * TRANSPORT_BATCH_MAX)
+#define SATIP_DATAGRAM_SIZE (TRANSPORT_PACKET_LENGTH * 7)
+#define SATIP_SESSION_BUFFER (SATIP_DATAGRAM_SIZE * 48)
+
+// a partly filled datagram is sent after this long (ns), so that sessions
+// on a few quiet PIDs (a scan of the PAT, say) see them promptly
+#define SATIP_FLUSH_DELAY 20000000LL
+
+// how often the tuner status is read, RTCP sent and sessions expired (ms)
+#define SATIP_TICK_INTERVAL 1000
+
+struct satip_tune {
+	int fe;					// fe=, 0 => any
+	int src;				// src=, 1 to 4
+	char polarization;			// DVB-S only
+	enum dvbfe_type type;
+	struct dvbfe_parameters params;
+};
+
+struct satip_reader {
+	int fd;
+	uint8_t buf[SATIP_READ_SIZE];
+	int bufsize;
+	struct transport_packet_batch batch;
+};
+
+struct satip_tuner {
+	int users;				// 0 => slot free
+	int adapter;
+	int frontend;
+	struct dvbfe_handle *fe;
+	int level;				// from the last tick, 0 to 255
+	int quality;				// 0 to 15
+	int locked;
+
+	uint64_t pid_sessions[TRANSPORT_MAX_PIDS];	// bit n => sessions[n] wants it
+	uint64_t all_sessions;			// ... wants every PID, from all
+	struct dvbdemux_pidset *pidset;
+	struct satip_reader dvr;		// the PID set's filter, or the DVR
+	struct satip_reader all;		// a filter of every PID, fd -1 if none
+	uint64_t overflows;
+};
+
+struct satip_session {
+	char id[16];
+	int stream_id;
+	int slot;				// in sessions
+	struct satip_tune tune;
+	struct dvbtuner_lease *lease;
+	struct satip_tuner *tuner;
+	uint8_t wanted[SATIP_ALL_PIDS + 1];	// the last for pids=all
+	int playing;
+	int64_t expires;
+
+	char peer[INET6_ADDRSTRLEN];
+	int client_port;			// RTP; RTCP is the next
+	int server_port;
+	int fd;
+	int rtcp_fd;
+	struct addrinfo *addrs;
+	struct addrinfo *rtcp_addrs;
+	struct udp_output *udp;
+	uint32_t rtp_packets;
+	uint32_t rtp_octets;
+
+	uint8_t buf[SATIP_SESSION_BUFFER];
+	int bufsize;
+	int64_t pending;			// when buf got a partial datagram
+};
+
+struct satip_client {
+	int fd;					// -1 => slot free
+	char peer[INET6_ADDRSTRLEN];
+	char local[INET6_ADDRSTRLEN];
+	char buf[SATIP_REQUEST_MAX];
+	int len;
+};
+
+struct satip_request {
+	char *method;
+	char *url;
+	int stream_id;				// stream=N in the URL, -1 if none
+	char *query;				// after the ?, or NULL
+	int cseq;
+	char *session;
+	char *transport;
+};
+
+struct satip_name {
+	const char *name;
+	int value;
+};
+
+static struct gnutv_satip_params *params;
+static struct dvbreactor *reactor;
+static struct dvbsec_cfg_store *secstore;
+static struct dvbsec_config sec;
+static struct satip_tuner tuners[SATIP_MAX_TUNERS];
+static struct satip_session *sessions[SATIP_MAX_SESSIONS];
+static struct satip_client clients[SATIP_MAX_CLIENTS];
+static int listen_fd = -1;
+static struct dvbreactor_timer *tick_timer = NULL;
+static int next_stream_id = 1;
+static int frontend_counts[3];			// DVB-S2, DVB-T, DVB-C for DESCRIBE
+
+static const struct satip_name satip_msys[] = {
+	{ "dvbs", DVBFE_TYPE_DVBS }, { "dvbs2", DVBFE_TYPE_DVBS },
+	{ "dvbt", DVBFE_TYPE_DVBT }, { "dvbt2", DVBFE_TYPE_DVBT },
+	{ "dvbc", DVBFE_TYPE_DVBC }, { NULL, 0 } };
+static const struct satip_name satip_fec[] = {
+	{ "12", DVBFE_FEC_1_2 }, { "23", DVBFE_FEC_2_3 }, { "34", DVBFE_FEC_3_4 },
+	{ "35", DVBFE_FEC_3_5 }, { "45", DVBFE_FEC_4_5 }, { "56", DVBFE_FEC_5_6 },
+	{ "67", DVBFE_FEC_6_7 }, { "78", DVBFE_FEC_7_8 }, { "89", DVBFE_FEC_8_9 },
+	{ "910", DVBFE_FEC_9_10 }, { NULL, 0 } };
+static const struct satip_name satip_dvbs_mod[] = {
+	{ "qpsk", DVBFE_DVBS_MOD_QPSK }, { "8psk", DVBFE_DVBS_MOD_8PSK },
+	{ "16apsk", DVBFE_DVBS_MOD_16APSK }, { "32apsk", DVBFE_DVBS_MOD_32APSK }, { NULL, 0 } };
+static const struct satip_name satip_dvbt_mod[] = {
+	{ "qpsk", DVBFE_DVBT_CONST_QPSK }, { "16qam", DVBFE_DVBT_CONST_QAM_16 },
+	{ "64qam", DVBFE_DVBT_CONST_QAM_64 }, { "256qam", DVBFE_DVBT_CONST_QAM_256 }, { NULL, 0 } };
+static const struct satip_name satip_dvbc_mod[] = {
+	{ "16qam", DVBFE_DVBC_MOD_QAM_16 }, { "32qam", DVBFE_DVBC_MOD_QAM_32 },
+	{ "64qam", DVBFE_DVBC_MOD_QAM_64 }, { "128qam", DVBFE_DVBC_MOD_QAM_128 },
+	{ "256qam", DVBFE_DVBC_MOD_QAM_256 }, { NULL, 0 } };
+static const struct satip_name satip_rolloff[] = {
+	{ "0.35", DVBFE_DVBS_ROLLOFF_35 }, { "0.25", DVBFE_DVBS_ROLLOFF_25 },
+	{ "0.20", DVBFE_DVBS_ROLLOFF_20 }, { NULL, 0 } };
+static const struct satip_name satip_pilot[] = {
+	{ "on", DVBFE_DVBS_PILOT_ON }, { "off", DVBFE_DVBS_PILOT_OFF }, { NULL, 0 } };
+static const struct satip_name satip_bandwidth[] = {
+	{ "5", DVBFE_DVBT_BANDWIDTH_5_MHZ }, { "6", DVBFE_DVBT_BANDWIDTH_6_MHZ },
+	{ "7", DVBFE_DVBT_BANDWIDTH_7_MHZ }, { "8", DVBFE_DVBT_BANDWIDTH_8_MHZ },
+	{ "10", DVBFE_DVBT_BANDWIDTH_10_MHZ }, { "1.712", DVBFE_DVBT_BANDWIDTH_1_712_MHZ },
+	{ NULL, 0 } };
+static const struct satip_name satip_tmode[] = {
+	{ "1k", DVBFE_DVBT_TRANSMISSION_MODE_1K }, { "2k", DVBFE_DVBT_TRANSMISSION_MODE_2K },
+	{ "8k", DVBFE_DVBT_TRANSMISSION_MODE_8K }, { "16k", DVBFE_DVBT_TRANSMISSION_MODE_16K },
+	{ "32k", DVBFE_DVBT_TRANSMISSION_MODE_32K }, { NULL, 0 } };
+static const struct satip_name satip_gi[] = {
+	{ "14", DVBFE_DVBT_GUARD_INTERVAL_1_4 }, { "18", DVBFE_DVBT_GUARD_INTERVAL_1_8 },
+	{ "116", DVBFE_DVBT_GUARD_INTERVAL_1_16 }, { "132", DVBFE_DVBT_GUARD_INTERVAL_1_32 },
+	{ "1128", DVBFE_DVBT_GUARD_INTERVAL_1_128 }, { "19128", DVBFE_DVBT_GUARD_INTERVAL_19_128 },
+	{ "19256", DVBFE_DVBT_GUARD_INTERVAL_19_256 }, { NULL, 0 } };
+
+static int64_t satip_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+static void satip_signal(int _signal)
+{
+	(void) _signal;
+
+	dvbreactor_stop(reactor);
+}
+
+static int satip_lookup(const struct satip_name *table, const char *name, int *value)
+{
+	for(; table->name; table++) {
+		if (!strcasecmp(table->name, name)) {
+			*value = table->value;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+static const char *satip_name(const struct satip_name *table, int value)
+{
+	for(; table->name; table++) {
+		if (table->value == value)
+			return table->name;
+	}
+	return "";
+}
+
+/**
+ * Apply the parameters of a query to a tuning and a PID set. *tuned is set
+ * if the query tunes (has a freq=), when tune is replaced with what it says.
+ *
+ * @return 0 on success, -1 if the query is not valid.
+ */
+static int satip_parse_query(char *query, struct satip_tune *tune, int *tuned, uint8_t *wanted)
+{
+	struct satip_tune t;
+	double freq = -1;
+	int msys_set = 0;
+	int sr = -1;
+	char *key;
+	char *value;
+	char *pid;
+	char *save;
+	int v;
+
+	memset(&t, 0, sizeof(t));
+	t.src = 1;
+	t.params.inversion = DVBFE_INVERSION_AUTO;
+	t.params.stream_id = DVBFE_STREAM_ID_NONE;
+	t.params.u.dvbs.fec_inner = DVBFE_FEC_AUTO;
+	t.params.u.dvbs.modulation = DVBFE_DVBS_MOD_AUTO;
+	t.params.u.dvbs.rolloff = DVBFE_DVBS_ROLLOFF_AUTO;
+	t.params.u.dvbs.pilot = DVBFE_DVBS_PILOT_AUTO;
+	*tuned = 0;
+
+	// the DVB-T and DVB-C fields share the union: set once msys is known
+	int bw = DVBFE_DVBT_BANDWIDTH_8_MHZ;
+	int fec = DVBFE_FEC_AUTO;
+	int tmode = DVBFE_DVBT_TRANSMISSION_MODE_AUTO;
+	int gi = DVBFE_DVBT_GUARD_INTERVAL_AUTO;
+
+	for(key = strtok_r(query, "&", &save); key; key = strtok_r(NULL, "&", &save)) {
+		if ((value = strchr(key, '=')) == NULL)
+			return -1;
+		*value++ = 0;
+
+		if (!strcmp(key, "src")) {
+			t.src = atoi(value);
+			if ((t.src < 1) || (t.src > 4))
+				return -1;
+		} else if (!strcmp(key, "fe")) {
+			t.fe = atoi(value);
+		} else if (!strcmp(key, "freq")) {
+			freq = strtod(value, NULL);
+		} else if (!strcmp(key, "pol")) {
+			if (strlen(value) != 1 || !strchr("hvlr", value[0]))
+				return -1;
+			t.polarization = value[0];
+		} else if (!strcmp(key, "msys")) {
+			if (satip_lookup(satip_msys, value, &v))
+				return -1;
+			t.type = v;
+			t.params.delivery_system = !strcasecmp(value, "dvbs2") ? DVBFE_DELSYS_DVBS2 :
+						   !strcasecmp(value, "dvbt2") ? DVBFE_DELSYS_DVBT2 :
+						   DVBFE_DELSYS_DEFAULT;
+			msys_set = 1;
+		} else if (!strcmp(key, "sr")) {
+			sr = atoi(value);
+		} else if (!strcmp(key, "fec")) {
+			if (satip_lookup(satip_fec, value, &fec))
+				return -1;
+		} else if (!strcmp(key, "mtype")) {
+			// depends on msys: see satip_parse_mtype()
+		} else if (!strcmp(key, "ro")) {
+			if (satip_lookup(satip_rolloff, value, &v))
+				return -1;
+			t.params.u.dvbs.rolloff = v;
+		} else if (!strcmp(key, "plts")) {
+			if (satip_lookup(satip_pilot, value, &v))
+				return -1;
+			t.params.u.dvbs.pilot = v;
+		} else if (!strcmp(key, "bw")) {
+			if (satip_lookup(satip_bandwidth, value, &bw))
+				return -1;
+		} else if (!strcmp(key, "tmode")) {
+			if (satip_lookup(satip_tmode, value, &tmode))
+				return -1;
+		} else if (!strcmp(key, "gi")) {
+			if (satip_lookup(satip_gi, value, &gi))
+				return -1;
+		} else if (!strcmp(key, "plp") || !strcmp(key, "isi")) {
+			t.params.stream_id = atoi(value);
+		} else if (!strcmp(key, "specinv")) {
+			t.params.inversion = atoi(value) ? DVBFE_INVERSION_ON : DVBFE_INVERSION_OFF;
+		} else if (!strcmp(key, "pids") || !strcmp(key, "addpids") || !strcmp(key, "delpids")) {
+			int on = strcmp(key, "delpids") != 0;
+
+			if (!strcmp(key, "pids"))
+				memset(wanted, 0, SATIP_ALL_PIDS + 1);
+			if (!strcmp(value, "all")) {
+				wanted[SATIP_ALL_PIDS] = on;
+				continue;
+			}
+			if (!strcmp(value, "none"))
+				continue;
+			for(pid = strtok_r(value, ",", &value); pid; pid = strtok_r(NULL, ",", &value)) {
+				v = atoi(pid);
+				if ((v < 0) || (v >= SATIP_ALL_PIDS))
+					return -1;
+				wanted[v] = on;
+			}
+		}
+		// anything else (t2id, sm, c2tft, ds...) has no frontend setting
+	}
+
+	if (freq < 0)
+		return (msys_set || (sr != -1)) ? -1 : 0;
+	if (!msys_set)
+		return -1;
+
+	switch(t.type) {
+	case DVBFE_TYPE_DVBS:
+		if (!t.polarization || (sr <= 0))
+			return -1;
+		t.params.frequency = (uint32_t) (freq * 1000 + 0.5);
+		t.params.u.dvbs.symbol_rate = sr * 1000;
+		t.params.u.dvbs.fec_inner = fec;
+		break;
+
+	case DVBFE_TYPE_DVBT:
+		t.params.frequency = (uint32_t) (freq * 1000000 + 0.5);
+		t.params.u.dvbt.bandwidth = bw;
+		t.params.u.dvbt.code_rate_HP = fec;
+		t.params.u.dvbt.code_rate_LP = DVBFE_FEC_AUTO;
+		t.params.u.dvbt.constellation = DVBFE_DVBT_CONST_AUTO;
+		t.params.u.dvbt.transmission_mode = tmode;
+		t.params.u.dvbt.guard_interval = gi;
+		t.params.u.dvbt.hierarchy_information = DVBFE_DVBT_HIERARCHY_AUTO;
+		break;
+
+	case DVBFE_TYPE_DVBC:
+		if (sr <= 0)
+			return -1;
+		t.params.frequency = (uint32_t) (freq * 1000000 + 0.5);
+		t.params.u.dvbc.symbol_rate = sr * 1000;
+		t.params.u.dvbc.fec_inner = fec;
+		t.params.u.dvbc.modulation = DVBFE_DVBC_MOD_AUTO;
+		break;
+
+	default:
+		return -1;
+	}
+
+	*tune = t;
+	*tuned = 1;
+	return 0;
+}
+
+/**
+ * The mtype= of a query, which is looked up by msys, so needs a second pass.
+ */
+static int satip_parse_mtype(char *query, struct satip_tune *tune)
+{
+	char *pos;
+	char *end;
+	char value[16];
+	int v;
+
+	for(pos = query; (pos = strstr(pos, "mtype=")) != NULL; pos += 6) {
+		if ((pos != query) && (pos[-1] != '&'))
+			continue;
+		if ((end = strchr(pos + 6, '&')) == NULL)
+			end = pos + strlen(pos);
+		if ((end - (pos + 6)) >= (int) sizeof(value))
+			return -1;
+		memcpy(value, pos + 6, end - (pos + 6));
+		value[end - (pos + 6)] = 0;
+
+		switch(tune->type) {
+		case DVBFE_TYPE_DVBS:
+			if (satip_lookup(satip_dvbs_mod, value, &v))
+				return -1;
+			tune->params.u.dvbs.modulation = v;
+			break;
+		case DVBFE_TYPE_DVBT:
+			if (satip_lookup(satip_dvbt_mod, value, &v))
+				return -1;
+			tune->params.u.dvbt.constellation = v;
+			break;
+		case DVBFE_TYPE_DVBC:
+			if (satip_lookup(satip_dvbc_mod, value, &v))
+				return -1;
+			tune->params.u.dvbc.modulation = v;
+			break;
+		default:
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int satip_same_tune(struct satip_tune *a, struct satip_tune *b)
+{
+	return (a->fe == b->fe) && (a->src == b->src) && (a->polarization == b->polarization) &&
+	       (a->type == b->type) && !memcmp(&a->params, &b->params, sizeof(a->params));
+}
+
+/**
+ * The tuner= of the SAT>IP status: the frontend, its signal and what it is
+ * tuned to.
+ */
+static int satip_tuner_status(char *buf, int size, struct satip_session *s)
+{
+	struct satip_tuner *tuner = s->tuner;
+	struct dvbfe_parameters *p = &s->tune.params;
+	int fe = tuner ? tuner->adapter + 1 : 0;
+	int level = tuner ? tuner->level : 0;
+	int lock = tuner ? tuner->locked : 0;
+	int quality = tuner ? tuner->quality : 0;
+	char plp[16] = "";
+
+	if (p->stream_id != DVBFE_STREAM_ID_NONE)
+		sprintf(plp, "%u", p->stream_id);
+
+	switch(s->tune.type) {
+	case DVBFE_TYPE_DVBS:
+		return snprintf(buf, size, "ver=1.0;src=%i;tuner=%i,%i,%i,%i,%.2f,%c,%s,%s,%s,%s,%i,%s",
+				s->tune.src, fe, level, lock, quality, p->frequency / 1000.0,
+				s->tune.polarization,
+				(p->delivery_system == DVBFE_DELSYS_DVBS2) ? "dvbs2" : "dvbs",
+				satip_name(satip_dvbs_mod, p->u.dvbs.modulation),
+				satip_name(satip_pilot, p->u.dvbs.pilot),
+				satip_name(satip_rolloff, p->u.dvbs.rolloff),
+				p->u.dvbs.symbol_rate / 1000, satip_name(satip_fec, p->u.dvbs.fec_inner));
+	case DVBFE_TYPE_DVBT:
+		return snprintf(buf, size, "ver=1.1;tuner=%i,%i,%i,%i,%.2f,%s,%s,%s,%s,%s,%s,%s,,",
+				fe, level, lock, quality, p->frequency / 1000000.0,
+				satip_name(satip_bandwidth, p->u.dvbt.bandwidth),
+				(p->delivery_system == DVBFE_DELSYS_DVBT2) ? "dvbt2" : "dvbt",
+				satip_name(satip_tmode, p->u.dvbt.transmission_mode),
+				satip_name(satip_dvbt_mod, p->u.dvbt.constellation),
+				satip_name(satip_gi, p->u.dvbt.guard_interval),
+				satip_name(satip_fec, p->u.dvbt.code_rate_HP), plp);
+	default:
+		return snprintf(buf, size, "ver=1.2;tuner=%i,%i,%i,%i,%.2f,,dvbc,%s,%i,,,,%i",
+				fe, level, lock, quality, p->frequency / 1000000.0,
+				satip_name(satip_dvbc_mod, p->u.dvbc.modulation),
+				p->u.dvbc.symbol_rate / 1000,
+				(p->inversion == DVBFE_INVERSION_ON) ? 1 : 0);
+	}
+}
+
+static int satip_pids_status(char *buf, int size, struct satip_session *s)
+{
+	int len;
+	int pid;
+
+	if (s->wanted[SATIP_ALL_PIDS])
+		return snprintf(buf, size, ";pids=all");
+	len = snprintf(buf, size, ";pids=");
+	for(pid = 0; pid < SATIP_ALL_PIDS; pid++) {
+		if (s->wanted[pid] && (len < size - 8))
+			len += snprintf(buf + len, size - len, "%s%i", (buf[len - 1] == '=') ? "" : ",", pid);
+	}
+	if (buf[len - 1] == '=')
+		len += snprintf(buf + len, size - len, "none");
+	return len;
+}
+
+static void satip_session_flush(struct satip_session *s, int force)
+{
+	int size = s->bufsize;
+
+	if (!force)
+		size -= size % SATIP_DATAGRAM_SIZE;
+	if (size == 0)
+		return;
+
+	if (gnutv_data_udp_send(s->udp, s->buf, size) == 0) {
+		s->rtp_packets += (size + SATIP_DATAGRAM_SIZE - 1) / SATIP_DATAGRAM_SIZE;
+		s->rtp_octets += size;
+	}
+	s->bufsize -= size;
+	memmove(s->buf, s->buf + size, s->bufsize);
+	s->pending = s->bufsize ? satip_now() : 0;
+}
+
+static void satip_session_put(struct satip_session *s, uint8_t *pkt)
+{
+	if ((s->bufsize + TRANSPORT_PACKET_LENGTH) > SATIP_SESSION_BUFFER)
+		satip_session_flush(s, 0);
+	if (s->bufsize == 0)
+		s->pending = satip_now();
+	memcpy(s->buf + s->bufsize, pkt, TRANSPORT_PACKET_LENGTH);
+	s->bufsize += TRANSPORT_PACKET_LENGTH;
+}
+
+/**
+ * Read what there is from one of a tuner's filters, and hand each packet
+ * to every session which wants its PID.
+ */
+static void satip_tuner_read(struct satip_tuner *tuner, struct satip_reader *r)
+{
+	uint8_t *buf = r->buf;
+	uint64_t flushed = 0;
+	int64_t now;
+	int result;
+	int size;
+	int used;
+	int pos;
+	int i;
+	int j;
+
+	size = read(r->fd, buf + r->bufsize, SATIP_READ_SIZE - r->bufsize);
+	if (size < 0) {
+		if (errno == EOVERFLOW) {
+			tuner->overflows++;
+			fprintf(stderr, "Demux overflow on adapter %i\n", tuner->adapter);
+		}
+		return;
+	}
+	r->bufsize += size;
+
+	pos = 0;
+	while((r->bufsize - pos) >= TRANSPORT_PACKET_LENGTH) {
+		if (buf[pos] != TRANSPORT_PACKET_SYNC) {
+			if ((result = transport_packet_find_sync(buf + pos, r->bufsize - pos)) < 0) {
+				pos = r->bufsize - (TRANSPORT_PACKET_LENGTH - 1);
+				break;
+			}
+			pos += result ? result : 1;
+			continue;
+		}
+
+		used = transport_packet_batch_extract(buf + pos, r->bufsize - pos, &r->batch);
+		for(i=0; i < r->batch.count; i++) {
+			uint64_t wanted = (r == &tuner->all) ? tuner->all_sessions :
+					  tuner->pid_sessions[r->batch.pid[i]] & ~tuner->all_sessions;
+
+			flushed |= wanted;
+			for(j=0; wanted; j++, wanted >>= 1) {
+				if (wanted & 1)
+					satip_session_put(sessions[j], buf + pos + i * TRANSPORT_PACKET_LENGTH);
+			}
+		}
+		pos += used;
+	}
+
+	r->bufsize -= pos;
+	memmove(buf, buf + pos, r->bufsize);
+
+	now = satip_now();
+	for(j=0; flushed; j++, flushed >>= 1) {
+		if (flushed & 1)
+			satip_session_flush(sessions[j],
+					    (now - sessions[j]->pending) >= SATIP_FLUSH_DELAY);
+	}
+}
+
+static void satip_dvr_ready(void *arg, uint32_t events)
+{
+	struct satip_tuner *tuner = (struct satip_tuner *) arg;
+	(void) events;
+
+	satip_tuner_read(tuner, &tuner->dvr);
+}
+
+static void satip_all_ready(void *arg, uint32_t events)
+{
+	struct satip_tuner *tuner = (struct satip_tuner *) arg;
+	(void) events;
+
+	satip_tuner_read(tuner, &tuner->all);
+}
+
+/**
+ * Make the filters of a tuner match what a session wants: its PIDs if on,
+ * else none of them.
+ */
+static void satip_session_filters(struct satip_session *s, int on)
+{
+	struct satip_tuner *tuner = s->tuner;
+	uint64_t bit = 1ULL << s->slot;
+	int want;
+	int have;
+	int pid;
+
+	if (tuner == NULL)
+		return;
+
+	for(pid = 0; pid < SATIP_ALL_PIDS; pid++) {
+		want = on && s->wanted[pid] && !s->wanted[SATIP_ALL_PIDS];
+		have = (tuner->pid_sessions[pid] & bit) != 0;
+		if (want == have)
+			continue;
+
+		if (want) {
+			if ((tuner->pid_sessions[pid] == 0) && dvbdemux_pidset_add(tuner->pidset, pid)) {
+				fprintf(stderr, "Failed to add PID %i on adapter %i\n", pid, tuner->adapter);
+				continue;
+			}
+			tuner->pid_sessions[pid] |= bit;
+		} else {
+			tuner->pid_sessions[pid] &= ~bit;
+			if (tuner->pid_sessions[pid] == 0)
+				dvbdemux_pidset_remove(tuner->pidset, pid);
+		}
+	}
+
+	// pids=all is one filter of its own, read separately
+	want = on && s->wanted[SATIP_ALL_PIDS];
+	have = (tuner->all_sessions & bit) != 0;
+	if (want && !have) {
+		if (tuner->all.fd == -1) {
+			int fd;
+
+			if ((fd = dvbdemux_open_demux(tuner->adapter, 0, 1)) < 0) {
+				fprintf(stderr, "Failed to open demux of adapter %i\n", tuner->adapter);
+				return;
+			}
+			dvbdemux_set_buffer(fd, params->buffer_size ? params->buffer_size :
+					    DVBDEMUX_DVR_DEFAULT_BUFFER);
+			if (dvbdemux_set_pid_filter(fd, SATIP_ALL_PIDS, DVBDEMUX_INPUT_FRONTEND,
+						    DVBDEMUX_OUTPUT_TS_DEMUX, 1) ||
+			    dvbreactor_add(reactor, fd, EPOLLIN, satip_all_ready, tuner)) {
+				fprintf(stderr, "Failed to filter every PID on adapter %i\n", tuner->adapter);
+				close(fd);
+				return;
+			}
+			tuner->all.fd = fd;
+			tuner->all.bufsize = 0;
+		}
+		tuner->all_sessions |= bit;
+	} else if (!want && have) {
+		tuner->all_sessions &= ~bit;
+		if (tuner->all_sessions == 0) {
+			dvbreactor_remove(reactor, tuner->all.fd);
+			close(tuner->all.fd);
+			tuner->all.fd = -1;
+		}
+	}
+}
+
+static void satip_tuner_close(struct satip_tuner *tuner)
+{
+	dvbreactor_remove(reactor, tuner->dvr.fd);
+	close(tuner->dvr.fd);
+	dvbdemux_pidset_close(tuner->pidset);
+	dvbfe_close(tuner->fe);
+	fprintf(stderr, "Released adapter %i frontend %i\n", tuner->adapter, tuner->frontend);
+	tuner->users = 0;
+}
+
+/**
+ * Let go of a session's tuner and its lease.
+ */
+static void satip_session_detach(struct satip_session *s)
+{
+	if (s->tuner) {
+		satip_session_filters(s, 0);
+		satip_session_flush(s, 1);
+		if (--s->tuner->users == 0)
+			satip_tuner_close(s->tuner);
+		s->tuner = NULL;
+	}
+	if (s->lease) {
+		dvbtuner_release(s->lease);
+		s->lease = NULL;
+	}
+}
+
+/**
+ * Lease a tuner for a session's tuning, sharing it with the other sessions
+ * on the multiplex.
+ *
+ * @return 0 on success, else the RTSP status for the failure.
+ */
+static int satip_session_attach(struct satip_session *s)
+{
+	struct dvbtuner_request request;
+	struct satip_tuner *tuner = NULL;
+	struct satip_tuner *free_tuner = NULL;
+	int shared;
+	int dvrfd;
+	int i;
+
+	memset(&request, 0, sizeof(request));
+	request.mux.type = s->tune.type;
+	request.mux.delivery_system = s->tune.params.delivery_system;
+	request.mux.frequency = s->tune.params.frequency;
+	request.mux.stream_id = s->tune.params.stream_id;
+	if (s->tune.type == DVBFE_TYPE_DVBS) {
+		request.mux.polarization = s->tune.polarization;
+		request.mux.diseqc_switch = s->tune.src - 1;
+		snprintf(request.mux.wiring, sizeof(request.mux.wiring), "%s",
+			 params->secid ? params->secid : "UNIVERSAL");
+	}
+	request.priority = (params->priority > 0) ? params->priority : 0;
+	request.adapter = params->adapter;
+	if ((request.adapter == -1) && s->tune.fe)
+		request.adapter = s->tune.fe - 1;
+	request.frontend = params->frontend;
+	if ((s->lease = dvbtuner_acquire(&request, (params->priority >= 0) ? DVBTUNER_PREEMPT : 0)) == NULL)
+		return (errno == ENODEV) ? 404 : 503;
+	shared = dvbtuner_lease_shared(s->lease);
+
+	// our own sessions on the multiplex already have it open
+	for(i=0; i < SATIP_MAX_TUNERS; i++) {
+		if (tuners[i].users == 0) {
+			if (free_tuner == NULL)
+				free_tuner = &tuners[i];
+		} else if ((tuners[i].adapter == dvbtuner_lease_adapter(s->lease)) &&
+			   (tuners[i].frontend == dvbtuner_lease_frontend(s->lease))) {
+			tuner = &tuners[i];
+			break;
+		}
+	}
+
+	if (tuner == NULL) {
+		if ((tuner = free_tuner) == NULL)
+			goto busy;
+		memset(tuner, 0, sizeof(struct satip_tuner));
+		tuner->adapter = dvbtuner_lease_adapter(s->lease);
+		tuner->frontend = dvbtuner_lease_frontend(s->lease);
+		tuner->all.fd = -1;
+
+		// another process tuned it: leave it alone
+		if ((tuner->fe = dvbfe_open(tuner->adapter, tuner->frontend, shared)) == NULL) {
+			fprintf(stderr, "Failed to open frontend of adapter %i\n", tuner->adapter);
+			goto busy;
+		}
+		if ((tuner->pidset = dvbdemux_pidset_open(tuner->adapter, 0, 0, params->buffer_size)) == NULL) {
+			dvbfe_close(tuner->fe);
+			goto busy;
+		}
+
+		// read the demux filter of the PID set if there is one, else the DVR
+		if ((dvrfd = dvbdemux_pidset_fd(tuner->pidset)) != -1) {
+			dvrfd = dup(dvrfd);
+			if (dvrfd != -1)
+				fcntl(dvrfd, F_SETFL, fcntl(dvrfd, F_GETFL) | O_NONBLOCK);
+		} else if ((dvrfd = dvbdemux_open_dvr(tuner->adapter, 0, 1, 1)) != -1) {
+			if (params->buffer_size > 0)
+				dvbdemux_set_buffer(dvrfd, params->buffer_size);
+		}
+		if ((dvrfd < 0) || dvbreactor_add(reactor, dvrfd, EPOLLIN, satip_dvr_ready, tuner)) {
+			fprintf(stderr, "Failed to open demux of adapter %i\n", tuner->adapter);
+			if (dvrfd >= 0)
+				close(dvrfd);
+			dvbdemux_pidset_close(tuner->pidset);
+			dvbfe_close(tuner->fe);
+			goto busy;
+		}
+		tuner->dvr.fd = dvrfd;
+
+		if (!shared &&
+		    dvbsec_set(tuner->fe,
+			       (s->tune.type == DVBFE_TYPE_DVBS) ? &sec : NULL,
+			       s->tune.polarization,
+			       ((s->tune.src - 1) & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+			       ((s->tune.src - 1) & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+			       &s->tune.params,
+			       0)) {
+			fprintf(stderr, "Failed to tune adapter %i\n", tuner->adapter);
+			tuner->users = 1;
+			satip_tuner_close(tuner);
+			goto busy;
+		}
+		fprintf(stderr, "Leased adapter %i frontend %i%s\n", tuner->adapter, tuner->frontend,
+			shared ? " (shared)" : "");
+	}
+
+	tuner->users++;
+	s->tuner = tuner;
+	return 0;
+
+busy:
+	dvbtuner_release(s->lease);
+	s->lease = NULL;
+	return 503;
+}
+
+static void satip_session_free(struct satip_session *s)
+{
+	satip_session_detach(s);
+	if (s->fd != -1)
+		close(s->fd);
+	if (s->rtcp_fd != -1)
+		close(s->rtcp_fd);
+	if (s->addrs)
+		freeaddrinfo(s->addrs);
+	if (s->rtcp_addrs)
+		freeaddrinfo(s->rtcp_addrs);
+	free(s->udp);
+	sessions[s->slot] = NULL;
+	free(s);
+}
+
+/**
+ * Point a session's RTP (and RTCP, on the next port) at a client port, from
+ * a pair of ports of our own.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int satip_session_ports(struct satip_session *s, int client_port)
+{
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	struct addrinfo hints;
+	char port[16];
+	int tries;
+	int i;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	hints.ai_flags = AI_NUMERICHOST;
+	for(i = 0; i < 2; i++) {
+		struct addrinfo **addrs = i ? &s->rtcp_addrs : &s->addrs;
+
+		if (*addrs)
+			freeaddrinfo(*addrs);
+		*addrs = NULL;
+		sprintf(port, "%i", client_port + i);
+		if (getaddrinfo(s->peer, port, &hints, addrs))
+			return -1;
+	}
+	s->client_port = client_port;
+	if (s->fd != -1)
+		goto output;
+
+	// RTP on an even port, RTCP on the one after
+	for(tries = 0; tries < 16; tries++) {
+		if ((s->fd = socket(s->addrs->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) < 0)
+			return -1;
+		memset(&addr, 0, sizeof(addr));
+		addr.ss_family = s->addrs->ai_family;
+		addrlen = (addr.ss_family == AF_INET6) ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+		if (bind(s->fd, (struct sockaddr *) &addr, addrlen) ||
+		    getsockname(s->fd, (struct sockaddr *) &addr, &addrlen))
+			return -1;
+		s->server_port = ntohs((addr.ss_family == AF_INET6) ?
+				       ((struct sockaddr_in6 *) &addr)->sin6_port :
+				       ((struct sockaddr_in *) &addr)->sin_port);
+		if ((s->server_port & 1) == 0) {
+			if (addr.ss_family == AF_INET6)
+				((struct sockaddr_in6 *) &addr)->sin6_port = htons(s->server_port + 1);
+			else
+				((struct sockaddr_in *) &addr)->sin_port = htons(s->server_port + 1);
+			if (((s->rtcp_fd = socket(addr.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0)) >= 0) &&
+			    !bind(s->rtcp_fd, (struct sockaddr *) &addr, addrlen))
+				break;
+			if (s->rtcp_fd != -1)
+				close(s->rtcp_fd);
+			s->rtcp_fd = -1;
+		}
+		close(s->fd);
+		s->fd = -1;
+	}
+	if (s->fd == -1)
+		return -1;
+
+output:
+	free(s->udp);
+	if ((s->udp = gnutv_data_udp_new(s->fd, s->addrs, 1)) == NULL)
+		return -1;
+	return 0;
+}
+
+/**
+ * Send a session's RTCP: a sender report, its CNAME, and the SAT>IP status
+ * in an APP packet.
+ */
+static void satip_session_rtcp(struct satip_session *s)
+{
+	uint8_t buf[1500];
+	char status[1024];
+	struct timespec ts;
+	uint32_t ssrc = gnutv_data_udp_ssrc(s->udp);
+	uint64_t ntp;
+	uint32_t stamp;
+	int len;
+	int pos;
+	int i;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ntp = ((uint64_t) (ts.tv_sec + 2208988800U) << 32) | (((uint64_t) ts.tv_nsec << 32) / 1000000000);
+	stamp = (uint32_t) (satip_now() / (1000000000LL / 90000));
+
+	// SR
+	buf[0] = 0x80;
+	buf[1] = 200;
+	buf[2] = 0;
+	buf[3] = 6;
+	for(i = 0; i < 4; i++) {
+		buf[4 + i] = ssrc >> (24 - i * 8);
+		buf[16 + i] = stamp >> (24 - i * 8);
+		buf[20 + i] = s->rtp_packets >> (24 - i * 8);
+		buf[24 + i] = s->rtp_octets >> (24 - i * 8);
+	}
+	for(i = 0; i < 8; i++)
+		buf[8 + i] = ntp >> (56 - i * 8);
+	pos = 28;
+
+	// SDES with a CNAME
+	buf[pos] = 0x81;
+	buf[pos + 1] = 202;
+	buf[pos + 2] = 0;
+	buf[pos + 3] = 3;
+	for(i = 0; i < 4; i++)
+		buf[pos + 4 + i] = ssrc >> (24 - i * 8);
+	memcpy(buf + pos + 8, "\x01\x05gnutv\0\0", 8);
+	pos += 16;
+
+	// APP "SES1": identifier, length, then the status string
+	len = satip_tuner_status(status, sizeof(status), s);
+	len += satip_pids_status(status + len, sizeof(status) - len, s);
+	if (len > (int) sizeof(status) - 1)
+		len = sizeof(status) - 1;
+	i = 16 + ((len + 3) & ~3);
+	buf[pos] = 0x80;
+	buf[pos + 1] = 204;
+	buf[pos + 2] = ((i / 4) - 1) >> 8;
+	buf[pos + 3] = (i / 4) - 1;
+	for(i = 0; i < 4; i++)
+		buf[pos + 4 + i] = ssrc >> (24 - i * 8);
+	memcpy(buf + pos + 8, "SES1", 4);
+	buf[pos + 12] = 0;
+	buf[pos + 13] = 0;
+	buf[pos + 14] = len >> 8;
+	buf[pos + 15] = len;
+	memset(buf + pos + 16, 0, (len + 3) & ~3);
+	memcpy(buf + pos + 16, status, len);
+	pos += 16 + ((len + 3) & ~3);
+
+	sendto(s->rtcp_fd, buf, pos, MSG_DONTWAIT, s->rtcp_addrs->ai_addr, s->rtcp_addrs->ai_addrlen);
+}
+
+static void satip_tick(void *arg, uint32_t events)
+{
+	struct dvbfe_info result;
+	int64_t now = satip_now();
+	int i;
+	(void) arg;
+	(void) events;
+
+	for(i=0; i < SATIP_MAX_TUNERS; i++) {
+		struct satip_tuner *tuner = &tuners[i];
+
+		if (tuner->users == 0)
+			continue;
+		memset(&result, 0, sizeof(result));
+		dvbfe_get_info(tuner->fe, DVBFE_INFO_LOCKSTATUS | DVBFE_INFO_SIGNAL_STRENGTH | DVBFE_INFO_SNR,
+			       &result, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+		if (result.lock && !tuner->locked)
+			fprintf(stderr, "Adapter %i locked\n", tuner->adapter);
+		tuner->locked = result.lock;
+		tuner->level = (result.signal_strength * 255) / 65535;
+		tuner->quality = (result.snr * 15) / 65535;
+	}
+
+	for(i=0; i < SATIP_MAX_SESSIONS; i++) {
+		struct satip_session *s = sessions[i];
+
+		if (s == NULL)
+			continue;
+		if (now > s->expires) {
+			fprintf(stderr, "Session %s timed out\n", s->id);
+			satip_session_free(s);
+			continue;
+		}
+		if (s->lease && dvbtuner_lease_revoked(s->lease)) {
+			fprintf(stderr, "Session %s lost its tuner\n", s->id);
+			satip_session_free(s);
+			continue;
+		}
+		if (s->playing) {
+			satip_session_flush(s, 1);
+			satip_session_rtcp(s);
+		}
+	}
+}
+
+static void satip_reply(struct satip_client *client, struct satip_request *req, int code,
+			const char *headers, const char *body)
+{
+	char buf[SATIP_REQUEST_MAX + 1024];
+	const char *reason;
+	int len;
+
+	switch(code) {
+	case 200: reason = "OK"; break;
+	case 400: reason = "Bad Request"; break;
+	case 404: reason = "Not Found"; break;
+	case 454: reason = "Session Not Found"; break;
+	case 461: reason = "Unsupported Transport"; break;
+	case 501: reason = "Not Implemented"; break;
+	default: reason = "Service Unavailable"; break;
+	}
+
+	len = snprintf(buf, sizeof(buf), "RTSP/1.0 %i %s\r\nCSeq: %i\r\n%s", code, reason,
+		       req->cseq, headers ? headers : "");
+	if (body)
+		len += snprintf(buf + len, sizeof(buf) - len,
+				"Content-Type: application/sdp\r\nContent-Length: %i\r\n\r\n%s",
+				(int) strlen(body), body);
+	else
+		len += snprintf(buf + len, sizeof(buf) - len, "\r\n");
+	if (len > (int) sizeof(buf) - 1)
+		len = sizeof(buf) - 1;
+
+	// replies are short; a client which doesn't read them loses them
+	if (send(client->fd, buf, len, MSG_NOSIGNAL|MSG_DONTWAIT) < 0) {
+		// nothing to be done
+	}
+}
+
+static struct satip_session *satip_find_session(struct satip_request *req)
+{
+	char id[16];
+	int i;
+
+	if (req->session == NULL)
+		return NULL;
+	snprintf(id, sizeof(id), "%.*s", (int) strcspn(req->session, "; \t"), req->session);
+	for(i=0; i < SATIP_MAX_SESSIONS; i++) {
+		if (sessions[i] && !strcmp(sessions[i]->id, id))
+			return sessions[i];
+	}
+	return NULL;
+}
+
+/**
+ * Apply the query of a SETUP or PLAY to a session, retuning if it says so.
+ *
+ * @return 0 on success, else the RTSP status for the failure.
+ */
+static int satip_session_query(struct satip_session *s, struct satip_request *req)
+{
+	uint8_t wanted[SATIP_ALL_PIDS + 1];
+	struct satip_tune tune = s->tune;
+	char *query;
+	int tuned;
+	int code;
+
+	if (req->query == NULL)
+		return s->lease ? 0 : 400;
+
+	memcpy(wanted, s->wanted, sizeof(wanted));
+	if ((query = strdup(req->query)) == NULL)
+		return 503;
+	if (satip_parse_query(query, &tune, &tuned, wanted)) {
+		free(query);
+		return 400;
+	}
+	free(query);
+	if (tuned && satip_parse_mtype(req->query, &tune))
+		return 400;
+	if (!tuned && !s->lease)
+		return 400;
+
+	if (tuned && (!s->lease || !satip_same_tune(&tune, &s->tune))) {
+		satip_session_detach(s);
+		s->tune = tune;
+		memcpy(s->wanted, wanted, sizeof(wanted));
+		if ((code = satip_session_attach(s)) != 0)
+			return code;
+	} else {
+		memcpy(s->wanted, wanted, sizeof(wanted));
+	}
+
+	satip_session_filters(s, s->playing);
+	return 0;
+}
+
+static void satip_cmd_setup(struct satip_client *client, struct satip_request *req)
+{
+	struct satip_session *s = NULL;
+	char headers[512];
+	char *pos;
+	int client_port;
+	int code;
+	int i;
+
+	if ((req->transport == NULL) || !strstr(req->transport, "RTP/AVP") ||
+	    strstr(req->transport, "multicast") ||
+	    ((pos = strstr(req->transport, "client_port=")) == NULL) ||
+	    ((client_port = atoi(pos + 12)) <= 0) || (client_port > 65534)) {
+		satip_reply(client, req, 461, NULL, NULL);
+		return;
+	}
+
+	if (req->session) {
+		if (((s = satip_find_session(req)) == NULL) ||
+		    ((req->stream_id != -1) && (req->stream_id != s->stream_id))) {
+			satip_reply(client, req, 454, NULL, NULL);
+			return;
+		}
+	} else {
+		for(i=0; (i < SATIP_MAX_SESSIONS) && sessions[i]; i++);
+		if ((i == SATIP_MAX_SESSIONS) || ((s = calloc(1, sizeof(struct satip_session))) == NULL)) {
+			satip_reply(client, req, 503, NULL, NULL);
+			return;
+		}
+		s->slot = i;
+		s->fd = -1;
+		s->rtcp_fd = -1;
+		snprintf(s->id, sizeof(s->id), "%08lx", random() & 0xffffffffUL);
+		s->stream_id = next_stream_id++;
+		if (next_stream_id > 0xffff)
+			next_stream_id = 1;
+		strcpy(s->peer, client->peer);
+		sessions[i] = s;
+	}
+
+	if ((code = satip_session_query(s, req)) == 0) {
+		if (satip_session_ports(s, client_port))
+			code = 503;
+	}
+	if (code) {
+		// a failed new session is gone; a failed change leaves it idle
+		if (req->session == NULL)
+			satip_session_free(s);
+		satip_reply(client, req, code, NULL, NULL);
+		return;
+	}
+	s->expires = satip_now() + GNUTV_SATIP_TIMEOUT * 1000000000LL;
+
+	snprintf(headers, sizeof(headers),
+		 "Session: %s;timeout=%i\r\n"
+		 "Transport: RTP/AVP;unicast;destination=%s;client_port=%i-%i;server_port=%i-%i\r\n"
+		 "com.ses.streamID: %i\r\n",
+		 s->id, GNUTV_SATIP_TIMEOUT, s->peer, s->client_port, s->client_port + 1,
+		 s->server_port, s->server_port + 1, s->stream_id);
+	satip_reply(client, req, 200, headers, NULL);
+}
+
+static void satip_cmd_play(struct satip_client *client, struct satip_request *req)
+{
+	struct satip_session *s;
+	char headers[512];
+	int code;
+
+	if (((s = satip_find_session(req)) == NULL) ||
+	    ((req->stream_id != -1) && (req->stream_id != s->stream_id))) {
+		satip_reply(client, req, 454, NULL, NULL);
+		return;
+	}
+	s->expires = satip_now() + GNUTV_SATIP_TIMEOUT * 1000000000LL;
+	s->playing = 1;
+	if ((code = satip_session_query(s, req)) != 0) {
+		satip_reply(client, req, code, NULL, NULL);
+		return;
+	}
+
+	snprintf(headers, sizeof(headers),
+		 "Session: %s;timeout=%i\r\n"
+		 "RTP-Info: url=rtsp://%s/stream=%i\r\n"
+		 "Range: npt=0.000-\r\n",
+		 s->id, GNUTV_SATIP_TIMEOUT, client->local, s->stream_id);
+	satip_reply(client, req, 200, headers, NULL);
+}
+
+static void satip_cmd_describe(struct satip_client *client, struct satip_request *req)
+{
+	char body[SATIP_REQUEST_MAX];
+	char headers[256];
+	int family = strchr(client->local, ':') ? 6 : 4;
+	int count = 0;
+	int len;
+	int i;
+
+	len = snprintf(body, sizeof(body),
+		       "v=0\r\no=- %lu 1 IN IP%i %s\r\ns=SatIPServer:1 %i,%i,%i\r\nt=0 0\r\n",
+		       (unsigned long) time(NULL), family, client->local,
+		       frontend_counts[0], frontend_counts[1], frontend_counts[2]);
+	for(i=0; (i < SATIP_MAX_SESSIONS) && (len < (int) sizeof(body) - 512); i++) {
+		struct satip_session *s = sessions[i];
+
+		if ((s == NULL) || ((req->stream_id != -1) && (s->stream_id != req->stream_id)))
+			continue;
+		len += snprintf(body + len, sizeof(body) - len,
+				"m=video 0 RTP/AVP 33\r\nc=IN IP%i %s\r\na=control:stream=%i\r\na=fmtp:33 ",
+				family, (family == 6) ? "::" : "0.0.0.0", s->stream_id);
+		len += satip_tuner_status(body + len, sizeof(body) - len - 128, s);
+		len += satip_pids_status(body + len, sizeof(body) - len - 64, s);
+		len += snprintf(body + len, sizeof(body) - len, "\r\na=%s\r\n",
+				s->playing ? "sendonly" : "inactive");
+		count++;
+	}
+	if (count == 0) {
+		satip_reply(client, req, 404, NULL, NULL);
+		return;
+	}
+
+	snprintf(headers, sizeof(headers), "Content-Base: rtsp://%s/\r\n", client->local);
+	satip_reply(client, req, 200, headers, body);
+}
+
+static void satip_command(struct satip_client *client, char *request)
+{
+	struct satip_request req;
+	struct satip_session *s;
+	char *line;
+	char *next;
+	char *pos;
+
+	memset(&req, 0, sizeof(req));
+	req.stream_id = -1;
+
+	// the request line, then headers
+	next = strstr(request, "\r\n");
+	*next = 0;
+	next += 2;
+	req.method = strtok_r(request, " ", &pos);
+	req.url = strtok_r(NULL, " ", &pos);
+	if ((req.method == NULL) || (req.url == NULL)) {
+		satip_reply(client, &req, 400, NULL, NULL);
+		return;
+	}
+	for(line = strtok_r(next, "\r\n", &pos); line; line = strtok_r(NULL, "\r\n", &pos)) {
+		char *value = strchr(line, ':');
+
+		if (value == NULL)
+			continue;
+		*value++ = 0;
+		value += strspn(value, " \t");
+		if (!strcasecmp(line, "CSeq"))
+			req.cseq = atoi(value);
+		else if (!strcasecmp(line, "Session"))
+			req.session = value;
+		else if (!strcasecmp(line, "Transport"))
+			req.transport = value;
+	}
+
+	// rtsp://host[:port]/[stream=N][?query]
+	if ((pos = strstr(req.url, "://")) != NULL)
+		pos = strchr(pos + 3, '/');
+	else
+		pos = req.url;
+	if (pos != NULL) {
+		if ((req.query = strchr(pos, '?')) != NULL)
+			*req.query++ = 0;
+		if (!strncmp(pos, "/stream=", 8))
+			req.stream_id = atoi(pos + 8);
+	}
+
+	// any request on a session keeps it alive
+	if ((s = satip_find_session(&req)) != NULL)
+		s->expires = satip_now() + GNUTV_SATIP_TIMEOUT * 1000000000LL;
+
+	if (!strcmp(req.method, "OPTIONS")) {
+		satip_reply(client, &req, 200, "Public: OPTIONS, DESCRIBE, SETUP, PLAY, TEARDOWN\r\n", NULL);
+	} else if (!strcmp(req.method, "DESCRIBE")) {
+		satip_cmd_describe(client, &req);
+	} else if (!strcmp(req.method, "SETUP")) {
+		satip_cmd_setup(client, &req);
+	} else if (!strcmp(req.method, "PLAY")) {
+		satip_cmd_play(client, &req);
+	} else if (!strcmp(req.method, "TEARDOWN")) {
+		if (s == NULL) {
+			satip_reply(client, &req, 454, NULL, NULL);
+			return;
+		}
+		satip_session_free(s);
+		satip_reply(client, &req, 200, NULL, NULL);
+	} else {
+		satip_reply(client, &req, 501, NULL, NULL);
+	}
+}
+
+static void satip_client_close(struct satip_client *client)
+{
+	dvbreactor_remove(reactor, client->fd);
+	close(client->fd);
+	client->fd = -1;
+}
+
+static void satip_client_ready(void *arg, uint32_t events)
+{
+	struct satip_client *client = (struct satip_client *) arg;
+	char *end;
+	char *body;
+	int size;
+	int used;
+	(void) events;
+
+	size = read(client->fd, client->buf + client->len, sizeof(client->buf) - 1 - client->len);
+	if (size <= 0) {
+		if ((size < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+			return;
+		satip_client_close(client);
+		return;
+	}
+	client->len += size;
+	client->buf[client->len] = 0;
+
+	// a request is complete with its blank line, and any body (ignored)
+	while((end = strstr(client->buf, "\r\n\r\n")) != NULL) {
+		used = (end + 4) - client->buf;
+		if ((body = strcasestr(client->buf, "\r\nContent-Length:")) && (body < end))
+			used += atoi(body + 17);
+		if (used > client->len)
+			break;
+
+		end[2] = 0;
+		satip_command(client, client->buf);
+		client->len -= used;
+		memmove(client->buf, client->buf + used, client->len + 1);
+	}
+
+	if (client->len == (int) sizeof(client->buf) - 1)
+		satip_client_close(client);
+}
+
+static void satip_address(struct sockaddr_storage *addr, socklen_t len, char *buf)
+{
+	if (getnameinfo((struct sockaddr *) addr, len, buf, INET6_ADDRSTRLEN, NULL, 0, NI_NUMERICHOST))
+		strcpy(buf, "0.0.0.0");
+
+	// an IPv4 client of a dual stack socket
+	if (!strncmp(buf, "::ffff:", 7) && strchr(buf, '.'))
+		memmove(buf, buf + 7, strlen(buf + 7) + 1);
+}
+
+static void satip_accept(void *arg, uint32_t events)
+{
+	struct sockaddr_storage addr;
+	socklen_t len = sizeof(addr);
+	int fd;
+	int i;
+	(void) arg;
+	(void) events;
+
+	if ((fd = accept4(listen_fd, (struct sockaddr *) &addr, &len, SOCK_NONBLOCK|SOCK_CLOEXEC)) < 0)
+		return;
+
+	for(i=0; i < SATIP_MAX_CLIENTS; i++) {
+		if (clients[i].fd == -1)
+			break;
+	}
+	if ((i == SATIP_MAX_CLIENTS) ||
+	    dvbreactor_add(reactor, fd, EPOLLIN, satip_client_ready, &clients[i])) {
+		close(fd);
+		return;
+	}
+	clients[i].fd = fd;
+	clients[i].len = 0;
+	satip_address(&addr, len, clients[i].peer);
+	len = sizeof(addr);
+	getsockname(fd, (struct sockaddr *) &addr, &len);
+	satip_address(&addr, len, clients[i].local);
+}
+
+static int satip_listen(void)
+{
+	struct addrinfo hints;
+	struct addrinfo *addrs;
+	int one = 1;
+	int res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if ((res = getaddrinfo(params->host, params->port, &hints, &addrs)) != 0) {
+		fprintf(stderr, "Unable to resolve RTSP address: %s\n", gai_strerror(res));
+		return -1;
+	}
+
+	listen_fd = socket(addrs->ai_family, addrs->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			   addrs->ai_protocol);
+	if (listen_fd < 0) {
+		fprintf(stderr, "Failed to open RTSP socket: %m\n");
+		freeaddrinfo(addrs);
+		return -1;
+	}
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	if (bind(listen_fd, addrs->ai_addr, addrs->ai_addrlen) || listen(listen_fd, SATIP_MAX_CLIENTS)) {
+		fprintf(stderr, "Failed to listen on RTSP port %s: %m\n", params->port);
+		freeaddrinfo(addrs);
+		return -1;
+	}
+	freeaddrinfo(addrs);
+	return 0;
+}
+
+// the frontends of the host, for the s= of DESCRIBE
+static void satip_count_frontends(void)
+{
+	struct dvbtopo *topo;
+	int i;
+	int j;
+
+	if ((topo = dvbtopo_open(0)) == NULL)
+		return;
+	for(i=0; i < dvbtopo_adapter_count(topo); i++) {
+		const struct dvbtopo_adapter *adapter = dvbtopo_adapter(topo, i);
+
+		for(j=0; j < adapter->frontend_count; j++) {
+			switch(adapter->frontends[j].type) {
+			case DVBFE_TYPE_DVBS: frontend_counts[0]++; break;
+			case DVBFE_TYPE_DVBT: frontend_counts[1]++; break;
+			case DVBFE_TYPE_DVBC: frontend_counts[2]++; break;
+			default: break;
+			}
+		}
+	}
+	dvbtopo_close(topo);
+}
+
+int gnutv_satip_run(struct gnutv_satip_params *_params)
+{
+	char *secid;
+	int result = 1;
+	int i;
+
+	params = _params;
+	for(i=0; i < SATIP_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+	srandom(time(NULL) ^ getpid());
+
+	secid = params->secid ? params->secid : "UNIVERSAL";
+	if ((secstore = dvbsec_cfg_store_open(params->secfile)) == NULL) {
+		fprintf(stderr, "Could not open sec file %s\n", params->secfile);
+		return 1;
+	}
+	if (dvbsec_cfg_store_find(secstore, secid, &sec)) {
+		fprintf(stderr, "Unable to find sec/lnb configuration %s\n", secid);
+		goto out;
+	}
+	satip_count_frontends();
+
+	if ((reactor = dvbreactor_create()) == NULL) {
+		fprintf(stderr, "Failed to create event loop\n");
+		goto out;
+	}
+	if (satip_listen() ||
+	    dvbreactor_add(reactor, listen_fd, EPOLLIN, satip_accept, NULL))
+		goto out;
+	tick_timer = dvbreactor_add_timer(reactor, SATIP_TICK_INTERVAL, SATIP_TICK_INTERVAL, satip_tick, NULL);
+
+	signal(SIGINT, satip_signal);
+	signal(SIGTERM, satip_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	fprintf(stderr, "SAT>IP server listening on RTSP port %s\n", params->port);
+	dvbreactor_run(reactor);
+	result = 0;
+
+out:
+	for(i=0; i < SATIP_MAX_SESSIONS; i++) {
+		if (sessions[i])
+			satip_session_free(sessions[i]);
+	}
+	for(i=0; i < SATIP_MAX_CLIENTS; i++) {
+		if (clients[i].fd != -1)
+			satip_client_close(&clients[i]);
+	}
+	if (listen_fd != -1) {
+		if (reactor)
+			dvbreactor_remove(reactor, listen_fd);
+		close(listen_fd);
+	}
+	if (reactor) {
+		if (tick_timer)
+			dvbreactor_remove_timer(reactor, tick_timer);
+		dvbreactor_destroy(reactor);
+	}
+	dvbsec_cfg_store_close(secstore);
+
+	return result;
+}
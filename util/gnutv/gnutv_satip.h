@@ -0,0 +1,63 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_SATIP_H
+#define gnutv_SATIP_H 1
+
+/**
+ * SAT>IP server mode: the tuners of the host are offered over RTSP, with
+ * the stream of each session sent over RTP, as a SAT>IP server does. The
+ * RTSP URL carries the tuning parameters and PIDs, for example
+ *	rtsp://host/?src=1&freq=11494&pol=h&msys=dvbs2&mtype=8psk&sr=22000&fec=23&pids=0,16,17
+ * (SETUP, or PLAY to change them), and addpids/delpids change the PIDs of
+ * a running stream. src picks the DiSEqC position (src=1 is switch A, A;
+ * src=2 B, A; src=3 A, B; src=4 B, B) for the -secid LNB.
+ *
+ * Each session leases a tuner from the host's allocator (see dvbtuner.h),
+ * so sessions on the same multiplex, here or in other processes, share one
+ * frontend. The sessions on a tuner share its PID set: each PID is filtered
+ * once, and every packet read is copied to the sessions which want it and
+ * sent with the batched RTP sender. RTCP sender reports carry the tuner
+ * status (the SAT>IP "SES1" APP packet) to port + 1.
+ *
+ * Sessions time out after GNUTV_SATIP_TIMEOUT seconds without a request.
+ * There is no UPnP discovery: clients are given the server's address.
+ */
+#define GNUTV_SATIP_TIMEOUT 60
+
+struct gnutv_satip_params {
+	char *host;			// NULL => all addresses
+	char *port;
+	char *secfile;
+	char *secid;			// NULL => UNIVERSAL
+	int adapter;			// -1 => any
+	int frontend;			// -1 => any
+	int buffer_size;		// demux buffer size, 0 for the default
+	int priority;			// of the tuner leases, -1 => 0 and never preempt
+};
+
+/**
+ * Run the server until SIGINT or SIGTERM.
+ * @return The exit status.
+ */
+extern int gnutv_satip_run(struct gnutv_satip_params *params);
+
+#endif
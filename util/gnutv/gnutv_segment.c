@@ -0,0 +1,449 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <libucsi/section.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/mpeg/pat_section.h>
+#include <libucsi/mpeg/pmt_section.h>
+#include <libucsi/mpeg/types.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_segment.h"
+#include "gnutv_timeshift.h"
+
+// packets of a PAT or PMT kept to start segments with; enough for a
+// section of the largest size
+#define SEGMENT_PSI_PACKETS 8
+#define SEGMENT_PSI_MAX 1024
+
+// data is written to a segment in chunks of this size
+#define SEGMENT_BUFFER_SIZE (TRANSPORT_PACKET_LENGTH * 1024)
+
+// PTS counts at 90kHz and wraps at 2^33
+#define PTS_MASK ((1ULL << 33) - 1)
+
+/**
+ * A PAT or PMT being picked out of the stream: the section as it is
+ * reassembled, along with its packets, and the packets of the last
+ * complete one.
+ */
+struct segment_psi {
+	int pid;			// -1 => not known yet
+	uint8_t section[SEGMENT_PSI_MAX + 3];
+	int len;			// -1 => waiting for a section start
+	uint8_t packets[SEGMENT_PSI_PACKETS][TRANSPORT_PACKET_LENGTH];
+	int count;
+	uint8_t complete[SEGMENT_PSI_PACKETS][TRANSPORT_PACKET_LENGTH];
+	int complete_count;		// 0 => none yet
+};
+
+struct gnutv_segment {
+	char prefix[PATH_MAX - 16];
+	uint64_t duration;		// 90kHz
+	FILE *list;
+
+	// the segment being written, if any
+	int fd;
+	FILE *index;
+	char name[PATH_MAX];
+	unsigned int number;
+	uint64_t bytes;
+	uint64_t first_pts;
+	uint64_t last_pts;
+	uint8_t buf[SEGMENT_BUFFER_SIZE];
+	int buf_len;
+
+	struct segment_psi pat;
+	struct segment_psi pmt;
+	int video;			// (stream_type << 16) | pid, -1 => none
+
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int partial_len;
+};
+
+struct gnutv_segment *gnutv_segment_open(const char *prefix, int duration)
+{
+	struct gnutv_segment *seg;
+	char listname[PATH_MAX];
+
+	if ((seg = calloc(1, sizeof(struct gnutv_segment))) == NULL) {
+		fprintf(stderr, "Out of memory for segmenting recording\n");
+		return NULL;
+	}
+	snprintf(seg->prefix, sizeof(seg->prefix), "%s", prefix);
+	seg->duration = (uint64_t) duration * GNUTV_SEGMENT_HZ;
+	seg->fd = -1;
+	seg->pat.pid = TRANSPORT_PAT_PID;
+	seg->pat.len = -1;
+	seg->pmt.pid = -1;
+	seg->pmt.len = -1;
+	seg->video = -1;
+
+	snprintf(listname, sizeof(listname), "%s.segments", prefix);
+	if ((seg->list = fopen(listname, "w")) == NULL) {
+		fprintf(stderr, "Failed to open segment list %s: %m\n", listname);
+		free(seg);
+		return NULL;
+	}
+
+	return seg;
+}
+
+static int gnutv_segment_flush(struct gnutv_segment *seg)
+{
+	int done = 0;
+	ssize_t tmp;
+
+	while(done < seg->buf_len) {
+		tmp = write(seg->fd, seg->buf + done, seg->buf_len - done);
+		if (tmp == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Write error: %m\n");
+			return -1;
+		}
+		done += tmp;
+	}
+	seg->buf_len = 0;
+
+	return 0;
+}
+
+static int gnutv_segment_put(struct gnutv_segment *seg, uint8_t *pkt)
+{
+	if ((seg->buf_len == SEGMENT_BUFFER_SIZE) && gnutv_segment_flush(seg))
+		return -1;
+	memcpy(seg->buf + seg->buf_len, pkt, TRANSPORT_PACKET_LENGTH);
+	seg->buf_len += TRANSPORT_PACKET_LENGTH;
+	seg->bytes += TRANSPORT_PACKET_LENGTH;
+
+	return 0;
+}
+
+/**
+ * Finish the segment being written, and list it.
+ *
+ * @param duration Its length in 90kHz ticks.
+ */
+static int gnutv_segment_finish(struct gnutv_segment *seg, uint64_t duration)
+{
+	const char *base = strrchr(seg->name, '/');
+	int result = gnutv_segment_flush(seg);
+
+	if (close(seg->fd))
+		result = -1;
+	fclose(seg->index);
+	seg->fd = -1;
+
+	fprintf(seg->list, "%s %llu %llu %llu\n", base ? base + 1 : seg->name,
+		(unsigned long long) seg->first_pts, (unsigned long long) duration,
+		(unsigned long long) seg->bytes);
+	fflush(seg->list);
+
+	return result;
+}
+
+/**
+ * Start a segment with a keyframe, after the PAT and PMT.
+ */
+static int gnutv_segment_start(struct gnutv_segment *seg, uint64_t pts)
+{
+	char idxname[PATH_MAX];
+	int i;
+
+	snprintf(seg->name, sizeof(seg->name), "%s-%06u.ts", seg->prefix, seg->number);
+	snprintf(idxname, sizeof(idxname), "%s-%06u.idx", seg->prefix, seg->number);
+	seg->number++;
+
+	if ((seg->fd = open(seg->name, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "Failed to open segment %s: %m\n", seg->name);
+		return -1;
+	}
+	if ((seg->index = fopen(idxname, "w")) == NULL) {
+		fprintf(stderr, "Failed to open segment index %s: %m\n", idxname);
+		close(seg->fd);
+		seg->fd = -1;
+		return -1;
+	}
+	seg->bytes = 0;
+	seg->first_pts = pts;
+	seg->last_pts = pts;
+
+	for(i=0; i < seg->pat.complete_count; i++)
+		gnutv_segment_put(seg, seg->pat.complete[i]);
+	for(i=0; i < seg->pmt.complete_count; i++)
+		gnutv_segment_put(seg, seg->pmt.complete[i]);
+
+	return 0;
+}
+
+static void gnutv_segment_new_pat(struct gnutv_segment *seg, struct mpeg_pat_section *pat)
+{
+	struct mpeg_pat_program *cur_program;
+
+	// the first program; gnutv records just the one
+	mpeg_pat_section_programs_for_each(pat, cur_program) {
+		if (cur_program->program_number == 0)
+			continue;
+		if (cur_program->pid != seg->pmt.pid) {
+			seg->pmt.pid = cur_program->pid;
+			seg->pmt.len = -1;
+			seg->pmt.complete_count = 0;
+			seg->video = -1;
+		}
+		return;
+	}
+}
+
+static void gnutv_segment_new_pmt(struct gnutv_segment *seg, struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		switch(cur_stream->stream_type) {
+		case MPEG_STREAM_TYPE_ISO11172_VIDEO:
+		case MPEG_STREAM_TYPE_ISO13818_2_VIDEO:
+		case MPEG_STREAM_TYPE_ISO14496_10_VIDEO:
+		case MPEG_STREAM_TYPE_ISO23008_2_VIDEO:
+			seg->video = (cur_stream->stream_type << 16) | cur_stream->pid;
+			return;
+		}
+	}
+	seg->video = -1;
+}
+
+/**
+ * A PAT or PMT has been reassembled: keep its packets if it is sound.
+ */
+static void gnutv_segment_psi_complete(struct gnutv_segment *seg, struct segment_psi *psi)
+{
+	uint8_t copy[SEGMENT_PSI_MAX + 3];
+	struct section *section;
+	struct section_ext *section_ext;
+
+	// the codecs work in place
+	memcpy(copy, psi->section, psi->len);
+	if (((section = section_codec(copy, psi->len)) == NULL) ||
+	    ((section_ext = section_ext_decode(section, 1)) == NULL))
+		return;
+
+	if (psi == &seg->pat) {
+		struct mpeg_pat_section *pat;
+
+		if ((section->table_id != stag_mpeg_program_association) ||
+		    ((pat = mpeg_pat_section_codec(section_ext)) == NULL))
+			return;
+		gnutv_segment_new_pat(seg, pat);
+	} else {
+		struct mpeg_pmt_section *pmt;
+
+		if ((section->table_id != stag_mpeg_program_map) ||
+		    ((pmt = mpeg_pmt_section_codec(section_ext)) == NULL))
+			return;
+		gnutv_segment_new_pmt(seg, pmt);
+	}
+
+	memcpy(psi->complete, psi->packets, psi->count * TRANSPORT_PACKET_LENGTH);
+	psi->complete_count = psi->count;
+}
+
+static void gnutv_segment_psi_append(struct gnutv_segment *seg, struct segment_psi *psi,
+				     uint8_t *data, int len)
+{
+	int want;
+
+	if (psi->len + len > (int) sizeof(psi->section)) {
+		psi->len = -1;
+		return;
+	}
+	memcpy(psi->section + psi->len, data, len);
+	psi->len += len;
+
+	if (psi->len < 3)
+		return;
+	want = 3 + (((psi->section[1] & 0x0f) << 8) | psi->section[2]);
+	if (want > (int) sizeof(psi->section)) {
+		psi->len = -1;
+	} else if (psi->len >= want) {
+		psi->len = want;
+		gnutv_segment_psi_complete(seg, psi);
+		psi->len = -1;
+	}
+}
+
+/**
+ * A packet of the PAT or PMT. Only the first section starting in a packet
+ * is looked at.
+ */
+static void gnutv_segment_psi_packet(struct gnutv_segment *seg, struct segment_psi *psi,
+				     uint8_t *pkt)
+{
+	uint8_t *payload = pkt + 4;
+	int len = TRANSPORT_PACKET_LENGTH - 4;
+	int pointer;
+
+	if (!(pkt[3] & 0x10))
+		return;
+	if (pkt[3] & 0x20) {
+		len -= 1 + pkt[4];
+		payload += 1 + pkt[4];
+	}
+	if (len <= 0)
+		return;
+
+	if (pkt[1] & 0x40) {
+		pointer = payload[0];
+		if (pointer + 1 >= len)
+			return;
+
+		// the end of the last section comes first
+		if ((psi->len != -1) && (psi->count < SEGMENT_PSI_PACKETS)) {
+			memcpy(psi->packets[psi->count++], pkt, TRANSPORT_PACKET_LENGTH);
+			gnutv_segment_psi_append(seg, psi, payload + 1, pointer);
+		}
+
+		psi->len = 0;
+		psi->count = 0;
+		memcpy(psi->packets[psi->count++], pkt, TRANSPORT_PACKET_LENGTH);
+		gnutv_segment_psi_append(seg, psi, payload + 1 + pointer, len - 1 - pointer);
+	} else if (psi->len != -1) {
+		if (psi->count == SEGMENT_PSI_PACKETS) {
+			psi->len = -1;
+			return;
+		}
+		memcpy(psi->packets[psi->count++], pkt, TRANSPORT_PACKET_LENGTH);
+		gnutv_segment_psi_append(seg, psi, payload, len);
+	}
+}
+
+/**
+ * A video packet: cut before it if it is a keyframe and the segment is
+ * long enough, or start the first segment with it.
+ */
+static int gnutv_segment_video(struct gnutv_segment *seg, uint8_t *pkt)
+{
+	uint64_t pts = 0;
+	uint64_t elapsed;
+	int flags;
+
+	flags = gnutv_timeshift_keyframe(seg->video >> 16, pkt, &pts);
+	if ((flags == -1) || !(flags & GNUTV_TIMESHIFT_PTS))
+		return 0;
+
+	if (!(flags & GNUTV_TIMESHIFT_KEYFRAME)) {
+		if (seg->fd != -1)
+			seg->last_pts = pts;
+		return 0;
+	}
+
+	if (seg->fd == -1) {
+		if (!seg->pat.complete_count || !seg->pmt.complete_count)
+			return 0;
+		if (gnutv_segment_start(seg, pts))
+			return -1;
+	} else {
+		elapsed = (pts - seg->first_pts) & PTS_MASK;
+		if (elapsed >= seg->duration) {
+			// a jump in the PTS: the segment ran as far as was seen
+			if (elapsed > seg->duration * 4)
+				elapsed = (seg->last_pts - seg->first_pts) & PTS_MASK;
+			if (gnutv_segment_finish(seg, elapsed) || gnutv_segment_start(seg, pts))
+				return -1;
+		}
+		seg->last_pts = pts;
+	}
+
+	fprintf(seg->index, "%llu %llu\n", (unsigned long long) pts, (unsigned long long) seg->bytes);
+	return 0;
+}
+
+static int gnutv_segment_packet(struct gnutv_segment *seg, uint8_t *pkt)
+{
+	int pid;
+
+	if (pkt[0] != TRANSPORT_PACKET_SYNC)
+		return 0;
+	pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+
+	if (pid == seg->pat.pid)
+		gnutv_segment_psi_packet(seg, &seg->pat, pkt);
+	else if (pid == seg->pmt.pid)
+		gnutv_segment_psi_packet(seg, &seg->pmt, pkt);
+	else if ((seg->video != -1) && (pid == (seg->video & 0x1fff)) && (pkt[1] & 0x40) &&
+		 !(pkt[3] & 0xc0) && gnutv_segment_video(seg, pkt))
+		return -1;
+
+	// nothing is kept before the first keyframe
+	if (seg->fd == -1)
+		return 0;
+	return gnutv_segment_put(seg, pkt);
+}
+
+int gnutv_segment_write(struct gnutv_segment *seg, uint8_t *buf, int len)
+{
+	int copy;
+
+	if (seg->partial_len) {
+		copy = TRANSPORT_PACKET_LENGTH - seg->partial_len;
+		if (copy > len)
+			copy = len;
+		memcpy(seg->partial + seg->partial_len, buf, copy);
+		seg->partial_len += copy;
+		buf += copy;
+		len -= copy;
+
+		if (seg->partial_len < TRANSPORT_PACKET_LENGTH)
+			return 0;
+		seg->partial_len = 0;
+		if (gnutv_segment_packet(seg, seg->partial))
+			return -1;
+	}
+
+	while(len >= TRANSPORT_PACKET_LENGTH) {
+		if (gnutv_segment_packet(seg, buf))
+			return -1;
+		buf += TRANSPORT_PACKET_LENGTH;
+		len -= TRANSPORT_PACKET_LENGTH;
+	}
+
+	memcpy(seg->partial, buf, len);
+	seg->partial_len = len;
+	return 0;
+}
+
+void gnutv_segment_close(struct gnutv_segment *seg)
+{
+	if (seg->fd != -1)
+		gnutv_segment_finish(seg, (seg->last_pts - seg->first_pts) & PTS_MASK);
+	fclose(seg->list);
+	free(seg);
+}
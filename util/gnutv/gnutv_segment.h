@@ -0,0 +1,79 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_SEGMENT_H
+#define gnutv_SEGMENT_H 1
+
+#include <stdint.h>
+
+/**
+ * A segmenting recording, for HLS/DASH packagers: the stream is cut into
+ * files "<prefix>-NNNNNN.ts" of about the target duration each. Every cut is
+ * made just before a video keyframe (a PES start flagged random access, or
+ * starting with an IDR/I picture), and every segment starts with the latest
+ * PAT and PMT, so each may be decoded on its own. Nothing is written until
+ * the first keyframe.
+ *
+ * The PAT, PMT and video PID are found in the stream itself, so PIDs moved
+ * by the remux are followed.
+ *
+ * Beside each segment, "<prefix>-NNNNNN.idx" lists its keyframes, one line
+ * each:
+ *
+ *	<PTS> <offset>
+ *
+ * with the PTS in 90kHz ticks and the byte offset of the keyframe's packet
+ * in the segment. When a segment is complete, a line is appended to
+ * "<prefix>.segments":
+ *
+ *	<segment file> <first PTS> <duration> <bytes>
+ *
+ * where the duration (90kHz ticks) runs to the first PTS of the next
+ * segment, or for the last segment to its last video PTS.
+ */
+struct gnutv_segment;
+
+#define GNUTV_SEGMENT_HZ 90000
+
+/**
+ * Start a segmenting recording, replacing the list of segments of any old
+ * one with the same prefix.
+ *
+ * @param prefix Path and name prefix of the files.
+ * @param duration Target segment length in seconds. Segments are cut at
+ * the first keyframe at or after it.
+ * @return The recording, or NULL on failure (which has been reported).
+ */
+extern struct gnutv_segment *gnutv_segment_open(const char *prefix, int duration);
+
+/**
+ * Add data to the recording.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+extern int gnutv_segment_write(struct gnutv_segment *seg, uint8_t *buf, int len);
+
+/**
+ * Finish the segment being written, and the recording.
+ */
+extern void gnutv_segment_close(struct gnutv_segment *seg);
+
+#endif
@@ -0,0 +1,1637 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbfe.h>
+#include <libdvbsec/dvbsec_api.h>
+#include <libdvbsec/dvbsec_cfg.h>
+#include <libdvbcfg/dvbcfg_zapindex.h>
+#include <libucsi/section.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/transport_packet.h>
+#include <libdvbmisc/dvbreactor.h>
+#include "gnutv.h"
+#include "gnutv_data.h"
+#include "gnutv_server.h"
+#include "gnutv_remux.h"
+#include "gnutv_store.h"
+
+// jobs per multiplex: each has a bit in the PID map
+#define SERVER_MAX_JOBS 64
+#define SERVER_MAX_PIDS 64
+#define SERVER_MAX_PROGRAMS 256
+#define SERVER_MAX_CLIENTS 32
+#define SERVER_LINE_MAX 1024
+
+#define SERVER_READ_SIZE (TRANSPORT_PACKET_LENGTH * TRANSPORT_BATCH_MAX)
+#define SERVER_DATAGRAM_SIZE (TRANSPORT_PACKET_LENGTH * 7)
+#define SERVER_JOB_BUFFER (SERVER_DATAGRAM_SIZE * 48)
+
+// PAT and PMT are repeated this often (ns) in each output
+#define SERVER_PSI_INTERVAL 100000000LL
+#define SERVER_PSI_PACKETS 6
+
+// a remuxed job's buffer is flushed at this fraction full, leaving the rest
+// for the stuffing and PSI
+#define SERVER_REMUX_EXPANSION 4
+
+// how often the lock status of the tuners is checked (ms)
+#define SERVER_STATUS_INTERVAL 1000
+
+// -prefetch: started channels remembered, services whose PMT a tuner keeps,
+// and channels predicted
+#define SERVER_HISTORY 8
+#define SERVER_WARM_PMTS 8
+#define SERVER_PREDICT_MAX (SERVER_HISTORY + 2)
+
+#define JOB_TYPE_FILE 0
+#define JOB_TYPE_UDP 1
+
+struct server_tuner;
+
+struct server_job {
+	int id;
+	int type;
+	char channel[128];
+	char target[PATH_MAX + 16];		// for list
+	int service_id;
+	struct server_tuner *tuner;
+	int slot;				// in tuner->jobs
+
+	int fd;
+	struct addrinfo *addrs;
+	struct udp_output *udp;
+	struct gnutv_store_file *file;		// file output through the store
+	int direct;
+	int failed;				// output failed, stop sending to it
+
+	// regenerated PSI; pmt_len is 0 until the service's PMT is seen
+	int pmt_pid;
+	int pmt_fd;
+	int pmt_version;
+	int pat_version;
+	uint8_t pat[GNUTV_DATA_PAT_SIZE];
+	uint8_t pmt[GNUTV_DATA_MAX_PMT];
+	int pmt_len;
+	uint8_t pat_cc;
+	uint8_t pmt_cc;
+	int64_t next_psi;
+
+	int pids[SERVER_MAX_PIDS];
+	int pid_count;
+
+	// with a remux the PSI comes from it instead; done is how much of buf
+	// has been through it
+	struct gnutv_remux *remux;
+	int done;
+
+	uint64_t packets;
+	uint8_t buf[SERVER_JOB_BUFFER];
+	int bufsize;
+};
+
+struct server_program {
+	int program_number;
+	int pmt_pid;
+};
+
+// a PMT kept up to date for a job which may want it
+struct server_warm_pmt {
+	int service_id;				// -1 => slot free
+	int pmt_pid;				// -1 until seen in the PAT
+	int fd;
+	int version;
+	uint8_t section[4096];
+	int len;				// 0 until seen
+};
+
+struct server_tuner {
+	int adapter;
+	struct dvbfe_handle *fe;
+	enum dvbfe_type type;
+	int worker;
+
+	// the multiplex tuned to, while there are jobs on it
+	struct dvbcfg_zapchannel channel;
+	int pat_fd;
+	int pat_version;
+	int transport_stream_id;
+	struct server_program programs[SERVER_MAX_PROGRAMS];
+	int program_count;
+	int locked;
+
+	// -prefetch: a tuner may stay on a multiplex with no jobs, rank
+	// saying how likely it is to be wanted (0 => most)
+	struct server_warm_pmt warm[SERVER_WARM_PMTS];
+	int warm_rank;
+
+	// the worker thread only looks at a tuner with this held; the
+	// control thread takes it to change anything below
+	pthread_mutex_t lock;
+	int active;
+	int demux;				// of the PID set and DVR
+	struct dvbdemux_pool *pool;		// -demux auto, else NULL
+	int dvrfd;
+	struct server_job *jobs[SERVER_MAX_JOBS];
+	int job_count;
+	uint64_t pid_jobs[TRANSPORT_MAX_PIDS];	// bit n => jobs[n] wants it
+	struct dvbdemux_pidset *pidset;		// with the PIDs any job wants
+	uint64_t overflows;
+	uint8_t buf[SERVER_READ_SIZE];
+	int bufsize;
+	struct transport_packet_batch batch;
+};
+
+struct server_worker {
+	pthread_t thread;
+	int epollfd;
+};
+
+struct server_client {
+	int fd;				// -1 => slot free
+	char line[SERVER_LINE_MAX];
+	int len;
+};
+
+static struct gnutv_server_params *params;
+static struct dvbreactor *reactor;
+static struct dvbcfg_zapindex *zapindex;
+static struct dvbsec_cfg_store *secstore;
+static struct server_tuner tuners[GNUTV_SERVER_MAX_TUNERS];
+static int tuner_count = 0;
+static struct server_worker workers[GNUTV_SERVER_MAX_TUNERS];
+static int worker_count = 0;
+static volatile int server_shutdown = 0;
+static struct server_client clients[SERVER_MAX_CLIENTS];
+static int listen_fd = -1;
+static struct dvbreactor_timer *status_timer = NULL;
+static int next_job_id = 1;
+static int prefetching = 0;
+static char history[SERVER_HISTORY][128];	// most recent first
+static int history_count = 0;
+
+static void server_pat_ready(void *arg, uint32_t events);
+static void server_pmt_ready(void *arg, uint32_t events);
+static void server_job_pmt(struct server_job *job, uint8_t *sibuf, int size);
+static void server_warm_pmt_ready(void *arg, uint32_t events);
+
+static int64_t server_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000000000LL) + ts.tv_nsec;
+}
+
+static void server_signal(int _signal)
+{
+	(void) _signal;
+
+	dvbreactor_stop(reactor);
+}
+
+static int server_add_section_filter(struct server_tuner *tuner, uint16_t pid, uint8_t table_id,
+				     dvbreactor_callback callback, void *arg)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+	int fd;
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = table_id;
+	mask[0] = 0xFF;
+
+	if (tuner->pool == NULL) {
+		if ((fd = dvbdemux_open_demux(tuner->adapter, tuner->demux, 0)) < 0)
+			return -1;
+		if (dvbdemux_set_section_filter(fd, pid, filter, mask, 1, 1)) {
+			close(fd);
+			return -1;
+		}
+	} else {
+		// a demux out of filters is passed over from then on
+		while(1) {
+			if ((fd = dvbdemux_pool_open_demux(tuner->pool, -1, 0)) < 0)
+				return -1;
+			if (!dvbdemux_set_section_filter(fd, pid, filter, mask, 1, 1))
+				break;
+			dvbdemux_pool_full(tuner->pool, fd);
+		}
+	}
+
+	if (dvbreactor_add(reactor, fd, EPOLLIN|EPOLLPRI|EPOLLERR, callback, arg)) {
+		if (tuner->pool)
+			dvbdemux_pool_close_fd(tuner->pool, fd);
+		else
+			close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static void server_remove_section_filter(struct server_tuner *tuner, int fd)
+{
+	dvbreactor_remove(reactor, fd);
+	if (tuner->pool)
+		dvbdemux_pool_close_fd(tuner->pool, fd);
+	else
+		close(fd);
+}
+
+/*
+ * The PIDs of the jobs on a tuner. Called with the tuner's lock held.
+ */
+static void server_job_add_pid(struct server_job *job, int pid)
+{
+	struct server_tuner *tuner = job->tuner;
+	int i;
+
+	for(i=0; i < job->pid_count; i++) {
+		if (job->pids[i] == pid)
+			return;
+	}
+	if (job->pid_count == SERVER_MAX_PIDS) {
+		fprintf(stderr, "Too many PIDs in job %i\n", job->id);
+		return;
+	}
+
+	// the first job to want a PID adds it
+	if ((tuner->pid_jobs[pid] == 0) && dvbdemux_pidset_add(tuner->pidset, pid)) {
+		fprintf(stderr, "Unable to create dvr filter for PID %i on adapter %i\n", pid, tuner->adapter);
+		return;
+	}
+
+	tuner->pid_jobs[pid] |= 1ULL << job->slot;
+	job->pids[job->pid_count++] = pid;
+}
+
+static void server_job_free_pids(struct server_job *job)
+{
+	struct server_tuner *tuner = job->tuner;
+	int i;
+
+	for(i=0; i < job->pid_count; i++) {
+		int pid = job->pids[i];
+
+		tuner->pid_jobs[pid] &= ~(1ULL << job->slot);
+		if (tuner->pid_jobs[pid] == 0)
+			dvbdemux_pidset_remove(tuner->pidset, pid);
+	}
+	job->pid_count = 0;
+}
+
+/**
+ * Pass the complete datagrams (or everything, for a file or if force is set)
+ * in a job's buffer on to its output.
+ */
+static void server_job_flush(struct server_job *job, int force)
+{
+	int size;
+	int result;
+
+	if (job->remux) {
+		job->done += gnutv_remux_process(job->remux, job->buf + job->done,
+						 job->bufsize - job->done,
+						 SERVER_JOB_BUFFER - job->done, server_now());
+		job->bufsize = job->done;
+	}
+	size = job->bufsize;
+
+	if (job->udp && !force)
+		size -= size % SERVER_DATAGRAM_SIZE;
+	if ((size == 0) || job->failed) {
+		if (job->failed)
+			job->bufsize = job->done = 0;
+		return;
+	}
+
+	if (job->udp)
+		result = gnutv_data_udp_send(job->udp, job->buf, size);
+	else if (job->file)
+		result = gnutv_store_write(job->file, job->buf, size);
+	else
+		result = gnutv_data_write(job->fd, job->buf, size, &job->direct);
+	if (result) {
+		fprintf(stderr, "Output for job %i failed\n", job->id);
+		job->failed = 1;
+	}
+
+	job->bufsize -= size;
+	job->done = job->bufsize;
+	memmove(job->buf, job->buf + size, job->bufsize);
+}
+
+static void server_job_put(struct server_job *job, uint8_t *pkt, int64_t now)
+{
+	// room for one packet, and the PSI which may precede it
+	if (job->remux) {
+		if ((job->bufsize + TRANSPORT_PACKET_LENGTH) > SERVER_JOB_BUFFER / SERVER_REMUX_EXPANSION)
+			server_job_flush(job, 0);
+	} else if ((job->bufsize + TRANSPORT_PACKET_LENGTH * (SERVER_PSI_PACKETS + 2)) > SERVER_JOB_BUFFER) {
+		server_job_flush(job, 0);
+	}
+
+	if (job->pmt_len && (now >= job->next_psi)) {
+		job->bufsize += gnutv_data_packetise(job->buf + job->bufsize, TRANSPORT_PAT_PID,
+						     &job->pat_cc, job->pat, sizeof(job->pat));
+		job->bufsize += gnutv_data_packetise(job->buf + job->bufsize, job->pmt_pid,
+						     &job->pmt_cc, job->pmt, job->pmt_len);
+		job->next_psi = now + SERVER_PSI_INTERVAL;
+	}
+
+	memcpy(job->buf + job->bufsize, pkt, TRANSPORT_PACKET_LENGTH);
+	job->bufsize += TRANSPORT_PACKET_LENGTH;
+	job->packets++;
+}
+
+/**
+ * Read what there is from a tuner's DVR, and hand each packet to every job
+ * which wants its PID. Called with the tuner's lock held.
+ */
+static void server_tuner_read(struct server_tuner *tuner)
+{
+	uint8_t *buf = tuner->buf;
+	int64_t now;
+	int result;
+	int size;
+	int used;
+	int pos;
+	int i;
+	int j;
+
+	size = read(tuner->dvrfd, buf + tuner->bufsize, SERVER_READ_SIZE - tuner->bufsize);
+	if (size < 0) {
+		if (errno == EOVERFLOW) {
+			// The error flag has been cleared, next read should succeed.
+			tuner->overflows++;
+			fprintf(stderr, "DVR overflow on adapter %i\n", tuner->adapter);
+		}
+		return;
+	}
+	tuner->bufsize += size;
+
+	now = server_now();
+	pos = 0;
+	while((tuner->bufsize - pos) >= TRANSPORT_PACKET_LENGTH) {
+		if (buf[pos] != TRANSPORT_PACKET_SYNC) {
+			if ((result = transport_packet_find_sync(buf + pos, tuner->bufsize - pos)) < 0) {
+				pos = tuner->bufsize - (TRANSPORT_PACKET_LENGTH - 1);
+				break;
+			}
+			pos += result ? result : 1;
+			continue;
+		}
+
+		used = transport_packet_batch_extract(buf + pos, tuner->bufsize - pos, &tuner->batch);
+		for(i=0; i < tuner->batch.count; i++) {
+			uint64_t wanted = tuner->pid_jobs[tuner->batch.pid[i]];
+
+			for(j=0; wanted; j++, wanted >>= 1) {
+				if (wanted & 1)
+					server_job_put(tuner->jobs[j],
+						       buf + pos + i * TRANSPORT_PACKET_LENGTH, now);
+			}
+		}
+		pos += used;
+	}
+
+	tuner->bufsize -= pos;
+	memmove(buf, buf + pos, tuner->bufsize);
+
+	for(i=0; i < SERVER_MAX_JOBS; i++) {
+		if (tuner->jobs[i])
+			server_job_flush(tuner->jobs[i], 0);
+	}
+}
+
+/*
+ * A worker reads the DVRs of the tuners given to it. Tuners are never freed,
+ * so an event for one which has just been stopped only finds it inactive.
+ */
+static void *server_worker_func(void *arg)
+{
+	struct server_worker *worker = (struct server_worker *) arg;
+	struct epoll_event events[GNUTV_SERVER_MAX_TUNERS];
+	int count;
+	int i;
+
+	while(!server_shutdown) {
+		if ((count = epoll_wait(worker->epollfd, events, GNUTV_SERVER_MAX_TUNERS, 200)) < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Worker epoll failure: %m\n");
+			break;
+		}
+
+		for(i=0; i < count; i++) {
+			struct server_tuner *tuner = (struct server_tuner *) events[i].data.ptr;
+
+			pthread_mutex_lock(&tuner->lock);
+			if (tuner->active)
+				server_tuner_read(tuner);
+			pthread_mutex_unlock(&tuner->lock);
+		}
+	}
+
+	return NULL;
+}
+
+static int server_same_mux(struct dvbcfg_zapchannel *a, struct dvbcfg_zapchannel *b)
+{
+	return (a->fe_type == b->fe_type) &&
+	       (a->fe_params.frequency == b->fe_params.frequency) &&
+	       (a->polarization == b->polarization) &&
+	       (a->diseqc_switch == b->diseqc_switch);
+}
+
+/**
+ * The tuner for a channel: the one on its multiplex already, or else a free
+ * one of the right type, or else the one of the right type prefetching the
+ * multiplex least likely to be wanted.
+ */
+static struct server_tuner *server_find_tuner(struct dvbcfg_zapchannel *channel)
+{
+	struct server_tuner *warm = NULL;
+	int i;
+
+	for(i=0; i < tuner_count; i++) {
+		if (tuners[i].active && server_same_mux(&tuners[i].channel, channel))
+			return &tuners[i];
+	}
+	for(i=0; i < tuner_count; i++) {
+		if (!tuners[i].active && (tuners[i].type == channel->fe_type))
+			return &tuners[i];
+	}
+	for(i=0; i < tuner_count; i++) {
+		if (tuners[i].active && (tuners[i].job_count == 0) &&
+		    (tuners[i].type == channel->fe_type) &&
+		    ((warm == NULL) || (tuners[i].warm_rank > warm->warm_rank)))
+			warm = &tuners[i];
+	}
+
+	return warm;
+}
+
+/**
+ * Open the PMT filters of a tuner's warm PMTs, for the PMT PIDs of the
+ * current PAT.
+ */
+static void server_warm_pat(struct server_tuner *tuner)
+{
+	struct server_warm_pmt *warm;
+	int pmt_pid;
+	int i;
+	int j;
+
+	for(i=0; i < SERVER_WARM_PMTS; i++) {
+		warm = &tuner->warm[i];
+		if (warm->service_id == -1)
+			continue;
+
+		pmt_pid = -1;
+		for(j=0; j < tuner->program_count; j++) {
+			if (tuner->programs[j].program_number == warm->service_id)
+				pmt_pid = tuner->programs[j].pmt_pid;
+		}
+		if (pmt_pid == warm->pmt_pid)
+			continue;
+
+		if (warm->fd != -1)
+			server_remove_section_filter(tuner, warm->fd);
+		warm->fd = -1;
+		warm->len = 0;
+		warm->version = -1;
+		warm->pmt_pid = pmt_pid;
+		if ((pmt_pid != -1) &&
+		    ((warm->fd = server_add_section_filter(tuner, pmt_pid, stag_mpeg_program_map,
+							   server_warm_pmt_ready, warm)) < 0))
+			fprintf(stderr, "Failed to create PMT section filter on adapter %i\n",
+				tuner->adapter);
+	}
+}
+
+/**
+ * Keep the PMTs of these services (and only these) on a tuner.
+ */
+static void server_warm_set(struct server_tuner *tuner, int *service_ids, int count)
+{
+	struct server_warm_pmt *warm;
+	int i;
+	int j;
+
+	for(i=0; i < SERVER_WARM_PMTS; i++) {
+		warm = &tuner->warm[i];
+		if (warm->service_id == -1)
+			continue;
+		for(j=0; j < count; j++) {
+			if (service_ids[j] == warm->service_id)
+				break;
+		}
+		if (j < count) {
+			// already kept
+			service_ids[j] = -1;
+			continue;
+		}
+
+		if (warm->fd != -1)
+			server_remove_section_filter(tuner, warm->fd);
+		warm->fd = -1;
+		warm->service_id = -1;
+	}
+
+	for(j=0; j < count; j++) {
+		if (service_ids[j] == -1)
+			continue;
+		for(i=0; (i < SERVER_WARM_PMTS) && (tuner->warm[i].service_id != -1); i++);
+		if (i == SERVER_WARM_PMTS)
+			break;
+
+		warm = &tuner->warm[i];
+		warm->service_id = service_ids[j];
+		warm->pmt_pid = -1;
+		warm->fd = -1;
+		warm->len = 0;
+	}
+
+	server_warm_pat(tuner);
+}
+
+static void server_warm_pmt_ready(void *arg, uint32_t events)
+{
+	struct server_warm_pmt *warm = (struct server_warm_pmt *) arg;
+	struct section_ext *section_ext;
+	struct section *section;
+	uint8_t raw[4096];
+	uint8_t sibuf[4096];
+	int size;
+	(void) events;
+
+	if ((size = read(warm->fd, raw, sizeof(raw))) <= 0)
+		return;
+
+	// decoding works in place: it is kept as it came for the job
+	memcpy(sibuf, raw, size);
+	if ((section = section_codec(sibuf, size)) == NULL)
+		return;
+	if ((section_ext = section_ext_decode(section, 0)) == NULL)
+		return;
+	if ((section_ext->table_id_ext != warm->service_id) ||
+	    (section_ext->version_number == warm->version))
+		return;
+
+	memcpy(warm->section, raw, size);
+	warm->version = section_ext->version_number;
+	warm->len = size;
+}
+
+static const char *server_tuner_start(struct server_tuner *tuner, struct dvbcfg_zapchannel *channel)
+{
+	struct dvbsec_config sec;
+	struct epoll_event event;
+	char *secid = params->secid;
+	int dvrfd;
+
+	// default SEC with a DVBS card, as for a single channel
+	if ((secid == NULL) && (channel->fe_type == DVBFE_TYPE_DVBS))
+		secid = "UNIVERSAL";
+	if ((secid != NULL) && dvbsec_cfg_store_find(secstore, secid, &sec))
+		return "unable to find suitable sec/lnb configuration for channel";
+
+	// read the demux filter of the PID set if there is one, else the DVR
+	if ((dvrfd = dvbdemux_pidset_fd(tuner->pidset)) != -1) {
+		if ((dvrfd = dup(dvrfd)) < 0)
+			return "failed to open demux device";
+		fcntl(dvrfd, F_SETFL, fcntl(dvrfd, F_GETFL) | O_NONBLOCK);
+	} else {
+		if ((dvrfd = dvbdemux_open_dvr(tuner->adapter, tuner->demux, 1, 1)) < 0)
+			return "failed to open DVR device";
+		if (params->buffer_size > 0)
+			dvbdemux_set_buffer(dvrfd, params->buffer_size);
+	}
+
+	if (dvbsec_set(tuner->fe,
+		       (secid != NULL) ? &sec : NULL,
+		       channel->polarization,
+		       (channel->diseqc_switch & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       (channel->diseqc_switch & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       &channel->fe_params,
+		       0)) {
+		close(dvrfd);
+		return "failed to set frontend";
+	}
+
+	tuner->channel = *channel;
+	tuner->pat_version = -1;
+	tuner->program_count = 0;
+	tuner->locked = 0;
+	tuner->warm_rank = 0;
+
+	pthread_mutex_lock(&tuner->lock);
+	tuner->dvrfd = dvrfd;
+	tuner->bufsize = 0;
+	tuner->active = 1;
+	pthread_mutex_unlock(&tuner->lock);
+
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.ptr = tuner;
+	if (epoll_ctl(workers[tuner->worker].epollfd, EPOLL_CTL_ADD, dvrfd, &event))
+		fprintf(stderr, "Failed to watch DVR of adapter %i: %m\n", tuner->adapter);
+
+	if ((tuner->pat_fd = server_add_section_filter(tuner, TRANSPORT_PAT_PID,
+						       stag_mpeg_program_association,
+						       server_pat_ready, tuner)) < 0)
+		fprintf(stderr, "Failed to create PAT section filter on adapter %i\n", tuner->adapter);
+
+	return NULL;
+}
+
+static void server_tuner_stop(struct server_tuner *tuner)
+{
+	server_warm_set(tuner, NULL, 0);
+	if (tuner->pat_fd != -1) {
+		server_remove_section_filter(tuner, tuner->pat_fd);
+		tuner->pat_fd = -1;
+	}
+	epoll_ctl(workers[tuner->worker].epollfd, EPOLL_CTL_DEL, tuner->dvrfd, NULL);
+
+	pthread_mutex_lock(&tuner->lock);
+	tuner->active = 0;
+	close(tuner->dvrfd);
+	tuner->dvrfd = -1;
+	pthread_mutex_unlock(&tuner->lock);
+}
+
+/**
+ * Point a job at its PMT, if the PAT of its multiplex has been seen.
+ */
+static void server_job_pat(struct server_job *job)
+{
+	struct server_tuner *tuner = job->tuner;
+	struct server_warm_pmt *warm;
+	uint8_t sibuf[4096];
+	int i;
+
+	for(i=0; i < tuner->program_count; i++) {
+		if (tuner->programs[i].program_number == job->service_id)
+			break;
+	}
+	if ((i == tuner->program_count) || (tuner->programs[i].pmt_pid == job->pmt_pid))
+		return;
+
+	// a PAT holding nothing but this service; wait for the new PMT, and
+	// send the new PAT right away
+	pthread_mutex_lock(&tuner->lock);
+	job->pmt_pid = tuner->programs[i].pmt_pid;
+	job->pat_version = (job->pat_version + 1) & 0x1f;
+	gnutv_data_build_pat(job->pat, tuner->transport_stream_id, job->service_id,
+			     job->pmt_pid, job->pat_version);
+	job->pmt_len = 0;
+	job->next_psi = 0;
+	pthread_mutex_unlock(&tuner->lock);
+
+	if (job->pmt_fd != -1)
+		server_remove_section_filter(tuner, job->pmt_fd);
+	job->pmt_version = -1;
+	if ((job->pmt_fd = server_add_section_filter(tuner, job->pmt_pid, stag_mpeg_program_map,
+						     server_pmt_ready, job)) < 0)
+		fprintf(stderr, "Failed to create PMT section filter for job %i\n", job->id);
+
+	// a prefetched PMT lets it start right away
+	for(i=0; i < SERVER_WARM_PMTS; i++) {
+		warm = &tuner->warm[i];
+		if ((warm->service_id == job->service_id) && (warm->pmt_pid == job->pmt_pid) &&
+		    warm->len) {
+			memcpy(sibuf, warm->section, warm->len);
+			server_job_pmt(job, sibuf, warm->len);
+		}
+	}
+}
+
+static void server_pat_ready(void *arg, uint32_t events)
+{
+	struct server_tuner *tuner = (struct server_tuner *) arg;
+	struct mpeg_pat_program *cur_program;
+	struct section_ext *section_ext;
+	struct mpeg_pat_section *pat;
+	struct section *section;
+	uint8_t sibuf[4096];
+	int size;
+	int i;
+	(void) events;
+
+	if ((size = read(tuner->pat_fd, sibuf, sizeof(sibuf))) < 0)
+		return;
+	if ((section = section_codec(sibuf, size)) == NULL)
+		return;
+	if ((section_ext = section_ext_decode(section, 0)) == NULL)
+		return;
+	if (section_ext->version_number == tuner->pat_version)
+		return;
+	if ((pat = mpeg_pat_section_codec(section_ext)) == NULL)
+		return;
+
+	tuner->transport_stream_id = pat->head.table_id_ext;
+	tuner->program_count = 0;
+	mpeg_pat_section_programs_for_each(pat, cur_program) {
+		if (tuner->program_count == SERVER_MAX_PROGRAMS)
+			break;
+		tuner->programs[tuner->program_count].program_number = cur_program->program_number;
+		tuner->programs[tuner->program_count].pmt_pid = cur_program->pid;
+		tuner->program_count++;
+	}
+	tuner->pat_version = section_ext->version_number;
+
+	for(i=0; i < SERVER_MAX_JOBS; i++) {
+		if (tuner->jobs[i])
+			server_job_pat(tuner->jobs[i]);
+	}
+	server_warm_pat(tuner);
+}
+
+static void server_pmt_ready(void *arg, uint32_t events)
+{
+	struct server_job *job = (struct server_job *) arg;
+	uint8_t sibuf[4096];
+	int size;
+	(void) events;
+
+	if ((size = read(job->pmt_fd, sibuf, sizeof(sibuf))) < 0)
+		return;
+	server_job_pmt(job, sibuf, size);
+}
+
+/**
+ * Take a PMT section for a job, read from its filter or prefetched.
+ */
+static void server_job_pmt(struct server_job *job, uint8_t *sibuf, int size)
+{
+	struct server_tuner *tuner = job->tuner;
+	struct mpeg_pmt_stream *cur_stream;
+	struct section_ext *section_ext;
+	struct mpeg_pmt_section *pmt;
+	struct section *section;
+
+	if ((section = section_codec(sibuf, size)) == NULL)
+		return;
+	if ((section_ext = section_ext_decode(section, 0)) == NULL)
+		return;
+	if ((section_ext->table_id_ext != job->service_id) ||
+	    (section_ext->version_number == job->pmt_version))
+		return;
+	if ((pmt = mpeg_pmt_section_codec(section_ext)) == NULL)
+		return;
+
+	// the PMT PID itself is not passed on: the PMT is regenerated
+	pthread_mutex_lock(&tuner->lock);
+	server_job_free_pids(job);
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (!job->remux || (gnutv_remux_map(job->remux, cur_stream->pid) != GNUTV_REMUX_DROP))
+			server_job_add_pid(job, cur_stream->pid);
+	}
+	if (!job->remux || (gnutv_remux_map(job->remux, pmt->pcr_pid) != GNUTV_REMUX_DROP))
+		server_job_add_pid(job, pmt->pcr_pid);
+
+	if (job->remux) {
+		if (gnutv_remux_set_pmt(job->remux, tuner->transport_stream_id, job->pmt_pid, pmt))
+			fprintf(stderr, "PMT of job %i is too large\n", job->id);
+	} else {
+		job->pmt_len = gnutv_data_build_pmt(job->pmt, pmt, NULL);
+		if (job->pmt_len < 0) {
+			fprintf(stderr, "PMT of job %i is too large\n", job->id);
+			job->pmt_len = 0;
+		}
+		job->next_psi = 0;
+	}
+	pthread_mutex_unlock(&tuner->lock);
+
+	job->pmt_version = section_ext->version_number;
+}
+
+static void server_predict_add(int *numbers, int *count, int number)
+{
+	int i;
+
+	if ((number < 0) || (number >= dvbcfg_zapindex_count(zapindex)) ||
+	    (*count == SERVER_PREDICT_MAX))
+		return;
+	for(i=0; i < *count; i++) {
+		if (numbers[i] == number)
+			return;
+	}
+	numbers[(*count)++] = number;
+}
+
+/**
+ * The channel numbers most likely to be asked for next, most likely first:
+ * those either side of the last channel started, that channel again, then
+ * the others started recently, most recent first.
+ */
+static int server_predict(int *numbers)
+{
+	int count = 0;
+	int number;
+	int i;
+
+	for(i=0; i < history_count; i++) {
+		if ((number = dvbcfg_zapindex_number(zapindex, history[i])) < 0)
+			continue;
+		if (i == 0) {
+			server_predict_add(numbers, &count, number + 1);
+			server_predict_add(numbers, &count, number - 1);
+		}
+		server_predict_add(numbers, &count, number);
+	}
+
+	return count;
+}
+
+// a multiplex prefetching wants, and the services on it
+struct server_prefetch_mux {
+	struct dvbcfg_zapchannel channel;
+	struct server_tuner *tuner;
+	int service_ids[SERVER_WARM_PMTS];
+	int service_count;
+};
+
+/**
+ * -prefetch: move the tuners without jobs to the multiplexes of the
+ * channels most likely to be asked for next, and keep the PMTs of those
+ * channels on every tuner, so that starting a job on one of them is just
+ * a matter of adding its PIDs.
+ */
+static void server_prefetch(void)
+{
+	struct server_prefetch_mux muxes[SERVER_PREDICT_MAX];
+	struct dvbcfg_zapchannel channel;
+	struct server_prefetch_mux *mux;
+	struct server_tuner *tuner;
+	int numbers[SERVER_PREDICT_MAX];
+	int spare[DVBFE_TYPE_ATSC + 1];
+	int mux_count = 0;
+	int count;
+	const char *err;
+	int i;
+	int j;
+
+	memset(spare, 0, sizeof(spare));
+	for(i=0; i < tuner_count; i++) {
+		if (tuners[i].job_count == 0)
+			spare[tuners[i].type]++;
+	}
+
+	// the multiplexes wanted: those with jobs take no tuner of their own
+	count = server_predict(numbers);
+	for(i=0; i < count; i++) {
+		if (dvbcfg_zapindex_get(zapindex, numbers[i], &channel))
+			continue;
+
+		for(j=0; j < mux_count; j++) {
+			if (server_same_mux(&muxes[j].channel, &channel))
+				break;
+		}
+		if (j == mux_count) {
+			mux = &muxes[mux_count];
+			mux->tuner = NULL;
+			mux->service_count = 0;
+			mux->channel = channel;
+			for(j=0; j < tuner_count; j++) {
+				if (tuners[j].active && tuners[j].job_count &&
+				    server_same_mux(&tuners[j].channel, &channel))
+					mux->tuner = &tuners[j];
+			}
+			if (mux->tuner == NULL) {
+				if (spare[channel.fe_type] == 0)
+					continue;
+				spare[channel.fe_type]--;
+			}
+			mux_count++;
+		}
+
+		mux = &muxes[j];
+		if (mux->service_count < SERVER_WARM_PMTS)
+			mux->service_ids[mux->service_count++] = channel.service_id;
+	}
+
+	// tuners without jobs stay where they are wanted, and give up the rest
+	for(i=0; i < tuner_count; i++) {
+		tuner = &tuners[i];
+		if (!tuner->active || tuner->job_count)
+			continue;
+		for(j=0; j < mux_count; j++) {
+			if (!muxes[j].tuner && server_same_mux(&muxes[j].channel, &tuner->channel))
+				break;
+		}
+		if (j < mux_count)
+			muxes[j].tuner = tuner;
+		else
+			server_tuner_stop(tuner);
+	}
+
+	// and the free ones go to the rest
+	for(j=0; j < mux_count; j++) {
+		mux = &muxes[j];
+		for(i=0; (i < tuner_count) && !mux->tuner; i++) {
+			tuner = &tuners[i];
+			if (tuner->active || (tuner->type != mux->channel.fe_type))
+				continue;
+			if ((err = server_tuner_start(tuner, &mux->channel)) != NULL) {
+				fprintf(stderr, "Adapter %i: prefetching %s: %s\n", tuner->adapter,
+					mux->channel.name, err);
+				break;
+			}
+			fprintf(stderr, "Adapter %i prefetching the multiplex of %s\n",
+				tuner->adapter, mux->channel.name);
+			mux->tuner = tuner;
+		}
+	}
+
+	for(i=0; i < tuner_count; i++) {
+		if (!tuners[i].active)
+			continue;
+		for(j=0; j < mux_count; j++) {
+			if (muxes[j].tuner == &tuners[i])
+				break;
+		}
+		if (j < mux_count) {
+			tuners[i].warm_rank = j;
+			server_warm_set(&tuners[i], muxes[j].service_ids, muxes[j].service_count);
+		} else {
+			server_warm_set(&tuners[i], NULL, 0);
+		}
+	}
+}
+
+/**
+ * Record that a channel was started, for server_predict().
+ */
+static void server_history_add(const char *channel_name)
+{
+	int i;
+
+	for(i=0; i < history_count; i++) {
+		if (!strcmp(history[i], channel_name))
+			break;
+	}
+	if (i == history_count) {
+		if (history_count < SERVER_HISTORY)
+			history_count++;
+		i = history_count - 1;
+	}
+	memmove(history[1], history[0], i * sizeof(history[0]));
+	snprintf(history[0], sizeof(history[0]), "%s", channel_name);
+}
+
+static void server_status_tick(void *arg, uint32_t events)
+{
+	struct dvbfe_info result;
+	int i;
+	(void) arg;
+	(void) events;
+
+	for(i=0; i < tuner_count; i++) {
+		if (!tuners[i].active)
+			continue;
+
+		memset(&result, 0, sizeof(result));
+		dvbfe_get_info(tuners[i].fe, DVBFE_INFO_LOCKSTATUS, &result,
+			       DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+		if (result.lock && !tuners[i].locked)
+			fprintf(stderr, "Adapter %i locked\n", tuners[i].adapter);
+		tuners[i].locked = result.lock;
+	}
+}
+
+static void server_job_free(struct server_job *job)
+{
+	if (job->file && gnutv_store_close(job->file))
+		fprintf(stderr, "Output for job %i failed: %m\n", job->id);
+	if (job->fd != -1)
+		close(job->fd);
+	if (job->addrs)
+		freeaddrinfo(job->addrs);
+	if (job->remux)
+		gnutv_remux_destroy(job->remux);
+	free(job->udp);
+	free(job);
+}
+
+static void server_job_stop(struct server_job *job)
+{
+	struct server_tuner *tuner = job->tuner;
+
+	if (job->pmt_fd != -1)
+		server_remove_section_filter(tuner, job->pmt_fd);
+
+	pthread_mutex_lock(&tuner->lock);
+	server_job_free_pids(job);
+	tuner->jobs[job->slot] = NULL;
+	tuner->job_count--;
+	server_job_flush(job, 1);
+	pthread_mutex_unlock(&tuner->lock);
+
+	fprintf(stderr, "Job %i stopped after %llu packets\n", job->id,
+		(unsigned long long) job->packets);
+	server_job_free(job);
+
+	// the last one out gives up the tuner, unless it is worth prefetching
+	if (prefetching)
+		server_prefetch();
+	else if (tuner->job_count == 0)
+		server_tuner_stop(tuner);
+}
+
+static void server_reply(struct server_client *client, const char *fmt, ...)
+{
+	char buf[SERVER_LINE_MAX];
+	va_list ap;
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+	va_end(ap);
+	if (len > (int) sizeof(buf) - 2)
+		len = sizeof(buf) - 2;
+	buf[len++] = '\n';
+
+	// replies are short; a client which doesn't read them loses them
+	if (send(client->fd, buf, len, MSG_NOSIGNAL|MSG_DONTWAIT) < 0) {
+		// nothing to be done
+	}
+}
+
+static int server_open_udp(struct server_job *job, char *host, char *port, int rtp)
+{
+	struct addrinfo hints;
+	int res;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	if ((res = getaddrinfo(host, port, &hints, &job->addrs)) != 0) {
+		job->addrs = NULL;
+		return -1;
+	}
+
+	job->fd = socket(job->addrs->ai_family, job->addrs->ai_socktype, job->addrs->ai_protocol);
+	if (job->fd < 0)
+		return -1;
+	if ((job->udp = gnutv_data_udp_new(job->fd, job->addrs, rtp)) == NULL)
+		return -1;
+
+	return 0;
+}
+
+// the leading options of record and stream
+struct server_job_options {
+	char *pidmap;
+	unsigned long long cbr_rate;
+	int vbr;
+};
+
+static void server_cmd_start(struct server_client *client, int type, char *outfile,
+			     char *host, char *port, int rtp, struct server_job_options *opts,
+			     char *channel_name)
+{
+	struct dvbcfg_zapchannel channel;
+	struct server_tuner *tuner;
+	struct server_job *job;
+	const char *err;
+	int slot;
+
+	/* pick up whatever the channel store has published since */
+	dvbcfg_zapindex_refresh(zapindex);
+	if ((strlen(channel_name) >= sizeof(channel.name)) ||
+	    dvbcfg_zapindex_find_name(zapindex, channel_name, &channel)) {
+		server_reply(client, "ERR unable to find requested channel %s", channel_name);
+		return;
+	}
+	if ((tuner = server_find_tuner(&channel)) == NULL) {
+		server_reply(client, "ERR no free tuner for channel %s", channel_name);
+		return;
+	}
+	if (tuner->job_count == SERVER_MAX_JOBS) {
+		server_reply(client, "ERR too many jobs on the multiplex of %s", channel_name);
+		return;
+	}
+	for(slot=0; tuner->jobs[slot]; slot++);
+
+	if ((job = calloc(1, sizeof(struct server_job))) == NULL) {
+		server_reply(client, "ERR out of memory");
+		return;
+	}
+	job->type = type;
+	job->tuner = tuner;
+	job->slot = slot;
+	job->service_id = channel.service_id;
+	job->fd = -1;
+	job->pmt_pid = -1;
+	job->pmt_fd = -1;
+	job->pmt_version = -1;
+	job->pat_version = -1;
+	snprintf(job->channel, sizeof(job->channel), "%s", channel_name);
+
+	if (opts->pidmap || opts->cbr_rate || opts->vbr) {
+		if ((job->remux = gnutv_remux_create(opts->cbr_rate, opts->vbr)) == NULL) {
+			server_reply(client, "ERR out of memory");
+			server_job_free(job);
+			return;
+		}
+		if (opts->pidmap && gnutv_remux_set_map(job->remux, opts->pidmap)) {
+			server_reply(client, "ERR bad -map %s: %s", opts->pidmap,
+				     (errno == EEXIST) ? "two PIDs map to one" : "expected IN:OUT,...");
+			server_job_free(job);
+			return;
+		}
+	}
+
+	if (type == JOB_TYPE_FILE) {
+		snprintf(job->target, sizeof(job->target), "file %s", outfile);
+		job->fd = open(outfile, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644);
+		if (job->fd < 0) {
+			server_reply(client, "ERR failed to open output file %s: %m", outfile);
+			server_job_free(job);
+			return;
+		}
+		if (params->store)
+			job->file = gnutv_store_open(params->store, job->fd);
+	} else {
+		snprintf(job->target, sizeof(job->target), "%s %s %s", rtp ? "rtp" : "udp", host, port);
+		if (server_open_udp(job, host, port, rtp)) {
+			server_reply(client, "ERR failed to open output to %s %s", host, port);
+			server_job_free(job);
+			return;
+		}
+	}
+
+	// a new multiplex needs the tuner; a shared one is already flowing
+	if (tuner->active && (tuner->job_count == 0) && !server_same_mux(&tuner->channel, &channel))
+		server_tuner_stop(tuner);
+	if (!tuner->active && ((err = server_tuner_start(tuner, &channel)) != NULL)) {
+		server_reply(client, "ERR %s", err);
+		server_job_free(job);
+		return;
+	}
+
+	job->id = next_job_id++;
+	pthread_mutex_lock(&tuner->lock);
+	tuner->jobs[slot] = job;
+	tuner->job_count++;
+	pthread_mutex_unlock(&tuner->lock);
+	server_job_pat(job);
+
+	fprintf(stderr, "Job %i: %s on adapter %i to %s\n", job->id, channel_name,
+		tuner->adapter, job->target);
+	server_reply(client, "OK %i", job->id);
+
+	if (prefetching) {
+		server_history_add(channel_name);
+		server_prefetch();
+	}
+}
+
+static struct server_job *server_find_job(int id)
+{
+	int i;
+	int j;
+
+	for(i=0; i < tuner_count; i++) {
+		for(j=0; j < SERVER_MAX_JOBS; j++) {
+			if (tuners[i].jobs[j] && (tuners[i].jobs[j]->id == id))
+				return tuners[i].jobs[j];
+		}
+	}
+
+	return NULL;
+}
+
+static void server_cmd_list(struct server_client *client)
+{
+	struct server_tuner *tuner;
+	struct server_job *job;
+	int count = 0;
+	int pmts;
+	int i;
+	int j;
+
+	for(i=0; i < tuner_count; i++) {
+		tuner = &tuners[i];
+		if (!tuner->active) {
+			server_reply(client, "tuner %i idle", tuner->adapter);
+			continue;
+		}
+		if (tuner->job_count == 0) {
+			for(pmts=0, j=0; j < SERVER_WARM_PMTS; j++) {
+				if ((tuner->warm[j].service_id != -1) && tuner->warm[j].len)
+					pmts++;
+			}
+			server_reply(client, "tuner %i prefetching frequency %u %s pmts %i",
+				     tuner->adapter, tuner->channel.fe_params.frequency,
+				     tuner->locked ? "locked" : "unlocked", pmts);
+			continue;
+		}
+		server_reply(client, "tuner %i frequency %u %s jobs %i overflows %llu",
+			     tuner->adapter, tuner->channel.fe_params.frequency,
+			     tuner->locked ? "locked" : "unlocked", tuner->job_count,
+			     (unsigned long long) tuner->overflows);
+
+		for(j=0; j < SERVER_MAX_JOBS; j++) {
+			if ((job = tuner->jobs[j]) == NULL)
+				continue;
+			server_reply(client, "job %i adapter %i packets %llu%s %s %s",
+				     job->id, tuner->adapter, (unsigned long long) job->packets,
+				     job->failed ? " failed" : "", job->target, job->channel);
+			count++;
+		}
+	}
+
+	server_reply(client, "OK %i", count);
+}
+
+/**
+ * Split the next word off a command line.
+ */
+static char *server_word(char **line)
+{
+	char *word;
+
+	while(**line == ' ')
+		(*line)++;
+	if (**line == 0)
+		return NULL;
+
+	word = *line;
+	while(**line && (**line != ' '))
+		(*line)++;
+	if (**line)
+		*(*line)++ = 0;
+	while(**line == ' ')
+		(*line)++;
+
+	return word;
+}
+
+/**
+ * Split the options off the front of a record or stream command.
+ *
+ * @return 0 on success, -1 if they are malformed.
+ */
+static int server_job_options(char **line, struct server_job_options *opts)
+{
+	char *word;
+
+	memset(opts, 0, sizeof(struct server_job_options));
+	while(**line == '-') {
+		word = server_word(line);
+		if (!strcmp(word, "-map")) {
+			if ((opts->pidmap = server_word(line)) == NULL)
+				return -1;
+		} else if (!strcmp(word, "-cbr")) {
+			if (((word = server_word(line)) == NULL) ||
+			    (sscanf(word, "%llu", &opts->cbr_rate) != 1) || (opts->cbr_rate == 0))
+				return -1;
+		} else if (!strcmp(word, "-vbr")) {
+			opts->vbr = 1;
+		} else {
+			return -1;
+		}
+	}
+
+	return (opts->cbr_rate && opts->vbr) ? -1 : 0;
+}
+
+static void server_command(struct server_client *client, char *line)
+{
+	struct server_job_options opts;
+	struct server_job *job;
+	char *cmd;
+	char *proto;
+	char *host;
+	char *port;
+	char *outfile;
+	int id;
+
+	if ((cmd = server_word(&line)) == NULL)
+		return;
+
+	if (!strcmp(cmd, "record")) {
+		if (server_job_options(&line, &opts) ||
+		    ((outfile = server_word(&line)) == NULL) || (*line == 0)) {
+			server_reply(client, "ERR usage: record [<options>] <filename> <channel name>");
+			return;
+		}
+		server_cmd_start(client, JOB_TYPE_FILE, outfile, NULL, NULL, 0, &opts, line);
+	} else if (!strcmp(cmd, "stream")) {
+		if (server_job_options(&line, &opts) ||
+		    ((proto = server_word(&line)) == NULL) ||
+		    (strcmp(proto, "udp") && strcmp(proto, "rtp")) ||
+		    ((host = server_word(&line)) == NULL) ||
+		    ((port = server_word(&line)) == NULL) || (*line == 0)) {
+			server_reply(client, "ERR usage: stream [<options>] udp|rtp <address> <port> <channel name>");
+			return;
+		}
+		server_cmd_start(client, JOB_TYPE_UDP, NULL, host, port, !strcmp(proto, "rtp"), &opts, line);
+	} else if (!strcmp(cmd, "stop")) {
+		if ((sscanf(line, "%i", &id) != 1) || ((job = server_find_job(id)) == NULL)) {
+			server_reply(client, "ERR no such job");
+			return;
+		}
+		server_job_stop(job);
+		server_reply(client, "OK");
+	} else if (!strcmp(cmd, "list")) {
+		server_cmd_list(client);
+	} else {
+		server_reply(client, "ERR unknown command %s", cmd);
+	}
+}
+
+static void server_client_close(struct server_client *client)
+{
+	dvbreactor_remove(reactor, client->fd);
+	close(client->fd);
+	client->fd = -1;
+}
+
+static void server_client_ready(void *arg, uint32_t events)
+{
+	struct server_client *client = (struct server_client *) arg;
+	char *end;
+	int size;
+	(void) events;
+
+	size = read(client->fd, client->line + client->len, sizeof(client->line) - 1 - client->len);
+	if (size <= 0) {
+		if ((size < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+			return;
+		server_client_close(client);
+		return;
+	}
+	client->len += size;
+	client->line[client->len] = 0;
+
+	while((end = strchr(client->line, '\n')) != NULL) {
+		*end = 0;
+		if ((end > client->line) && (end[-1] == '\r'))
+			end[-1] = 0;
+		server_command(client, client->line);
+
+		client->len -= (end + 1) - client->line;
+		memmove(client->line, end + 1, client->len + 1);
+	}
+
+	if (client->len == (int) sizeof(client->line) - 1) {
+		server_reply(client, "ERR line too long");
+		server_client_close(client);
+	}
+}
+
+static void server_accept(void *arg, uint32_t events)
+{
+	int fd;
+	int i;
+	(void) arg;
+	(void) events;
+
+	if ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK|SOCK_CLOEXEC)) < 0)
+		return;
+
+	for(i=0; i < SERVER_MAX_CLIENTS; i++) {
+		if (clients[i].fd == -1)
+			break;
+	}
+	if ((i == SERVER_MAX_CLIENTS) ||
+	    dvbreactor_add(reactor, fd, EPOLLIN, server_client_ready, &clients[i])) {
+		close(fd);
+		return;
+	}
+	clients[i].fd = fd;
+	clients[i].len = 0;
+}
+
+static int server_listen(char *path)
+{
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Control socket name is too long %s\n", path);
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	// a stale socket from a daemon which didn't shut down cleanly
+	unlink(path);
+
+	if ((listen_fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0)) < 0) {
+		fprintf(stderr, "Failed to create control socket: %m\n");
+		return -1;
+	}
+	if (bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(listen_fd, SERVER_MAX_CLIENTS)) {
+		fprintf(stderr, "Failed to listen on %s: %m\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int server_open_tuners(void)
+{
+	struct dvbfe_info result;
+	int i;
+	int j;
+
+	for(i=0; i < params->tuner_count; i++) {
+		struct server_tuner *tuner = &tuners[tuner_count];
+
+		memset(tuner, 0, sizeof(struct server_tuner));
+		tuner->adapter = params->adapters[i];
+		tuner->fe = dvbfe_open(tuner->adapter, params->frontend_id, 0);
+		if (tuner->fe == NULL) {
+			fprintf(stderr, "Failed to open frontend of adapter %i\n", tuner->adapter);
+			return -1;
+		}
+
+		memset(&result, 0, sizeof(result));
+		dvbfe_get_info(tuner->fe, 0, &result, DVBFE_INFO_QUERYTYPE_IMMEDIATE, 0);
+		tuner->type = result.type;
+		tuner->pat_fd = -1;
+		tuner->dvrfd = -1;
+		for(j=0; j < SERVER_WARM_PMTS; j++)
+			tuner->warm[j].service_id = -1;
+		tuner->demux = params->demux_id;
+		if (params->demux_id < 0) {
+			// the stream goes on one demux, counted as one filter
+			tuner->pool = dvbdemux_pool_open(tuner->adapter, params->frontend_id);
+			if (tuner->pool == NULL) {
+				fprintf(stderr, "Failed to find a demux of adapter %i\n", tuner->adapter);
+				return -1;
+			}
+			tuner->demux = dvbdemux_pool_pick(tuner->pool);
+			dvbdemux_pool_add_load(tuner->pool, tuner->demux, 1);
+		}
+		tuner->pidset = dvbdemux_pidset_open(tuner->adapter, tuner->demux, 0,
+						     params->buffer_size);
+		if (tuner->pidset == NULL) {
+			fprintf(stderr, "Out of memory when creating the PID set of adapter %i\n", tuner->adapter);
+			return -1;
+		}
+		pthread_mutex_init(&tuner->lock, NULL);
+		tuner->worker = tuner_count % worker_count;
+
+		fprintf(stderr, "Using frontend \"%s\" of adapter %i\n", result.name, tuner->adapter);
+		if (tuner->pool)
+			fprintf(stderr, "Spreading filters over %i demuxes of adapter %i\n",
+				dvbdemux_pool_count(tuner->pool), tuner->adapter);
+		tuner_count++;
+	}
+
+	return 0;
+}
+
+int gnutv_server_run(struct gnutv_server_params *_params)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int result = 1;
+	int i;
+	int j;
+
+	params = _params;
+	prefetching = params->prefetch;
+	for(i=0; i < SERVER_MAX_CLIENTS; i++)
+		clients[i].fd = -1;
+
+	if (params->chanstore != NULL) {
+		if ((zapindex = dvbcfg_zapindex_attach(params->chanstore)) == NULL) {
+			fprintf(stderr, "Could not attach to channel store %s\n", params->chanstore);
+			return 1;
+		}
+	} else if ((zapindex = dvbcfg_zapindex_open(params->chanfile, NULL)) == NULL) {
+		fprintf(stderr, "Could open channel file %s\n", params->chanfile);
+		return 1;
+	}
+	if ((secstore = dvbsec_cfg_store_open(params->secfile)) == NULL) {
+		fprintf(stderr, "Could not open sec file %s\n", params->secfile);
+		dvbcfg_zapindex_close(zapindex);
+		return 1;
+	}
+
+	// one worker per tuner, up to one per CPU
+	worker_count = params->threads;
+	if (worker_count <= 0)
+		worker_count = (cpus > 0) && (cpus < params->tuner_count) ? cpus : params->tuner_count;
+	if (worker_count > params->tuner_count)
+		worker_count = params->tuner_count;
+
+	if (server_open_tuners())
+		goto out;
+	if ((reactor = dvbreactor_create()) == NULL) {
+		fprintf(stderr, "Failed to create event loop\n");
+		goto out;
+	}
+	if (server_listen(params->socket_path) ||
+	    dvbreactor_add(reactor, listen_fd, EPOLLIN, server_accept, NULL))
+		goto out;
+	status_timer = dvbreactor_add_timer(reactor, SERVER_STATUS_INTERVAL, SERVER_STATUS_INTERVAL, server_status_tick, NULL);
+
+	for(i=0; i < worker_count; i++) {
+		if ((workers[i].epollfd = epoll_create1(EPOLL_CLOEXEC)) < 0) {
+			fprintf(stderr, "Failed to create worker: %m\n");
+			worker_count = i;
+			goto out;
+		}
+		pthread_create(&workers[i].thread, NULL, server_worker_func, &workers[i]);
+	}
+
+	signal(SIGINT, server_signal);
+	signal(SIGTERM, server_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	fprintf(stderr, "Listening on %s with %i tuners and %i worker threads\n",
+		params->socket_path, tuner_count, worker_count);
+	dvbreactor_run(reactor);
+	result = 0;
+
+out:
+	// finish the jobs, finishing their outputs
+	prefetching = 0;
+	for(i=0; i < tuner_count; i++) {
+		for(j=0; j < SERVER_MAX_JOBS; j++) {
+			if (tuners[i].jobs[j])
+				server_job_stop(tuners[i].jobs[j]);
+		}
+		if (tuners[i].active)
+			server_tuner_stop(&tuners[i]);
+	}
+
+	server_shutdown = 1;
+	for(i=0; i < worker_count; i++) {
+		pthread_join(workers[i].thread, NULL);
+		close(workers[i].epollfd);
+	}
+
+	for(i=0; i < SERVER_MAX_CLIENTS; i++) {
+		if (clients[i].fd != -1)
+			server_client_close(&clients[i]);
+	}
+	if (listen_fd != -1) {
+		if (reactor)
+			dvbreactor_remove(reactor, listen_fd);
+		close(listen_fd);
+		unlink(params->socket_path);
+	}
+	if (reactor) {
+		if (status_timer)
+			dvbreactor_remove_timer(reactor, status_timer);
+		dvbreactor_destroy(reactor);
+	}
+	for(i=0; i < tuner_count; i++) {
+		dvbdemux_pidset_close(tuners[i].pidset);
+		if (tuners[i].pool)
+			dvbdemux_pool_close(tuners[i].pool);
+		dvbfe_close(tuners[i].fe);
+	}
+	dvbsec_cfg_store_close(secstore);
+	dvbcfg_zapindex_close(zapindex);
+
+	return result;
+}
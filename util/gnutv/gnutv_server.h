@@ -0,0 +1,83 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_SERVER_H
+#define gnutv_SERVER_H 1
+
+#define GNUTV_SERVER_MAX_TUNERS 16
+
+struct gnutv_store;
+
+/**
+ * Daemon mode: record and stream jobs are accepted on a unix control socket,
+ * one command per line:
+ *
+ *	record [<options>] <filename> <channel name>
+ *	stream [<options>] udp|rtp <address> <port> <channel name>
+ *	stop <job id>
+ *	list
+ *
+ * where the options of a job pass its output through a remux (see
+ * gnutv_remux.h), as the -pidmap, -cbr and -vbr options of gnutv do:
+ *
+ *	-map <IN:OUT,...>	drop (OUT "drop") or renumber PIDs
+ *	-cbr <bits/s>		stuff to a constant rate, restamping the PCRs
+ *	-vbr			remove null packets
+ *
+ * Every reply ends with a line starting "OK" or "ERR". A job goes to the
+ * tuner already on its channel's multiplex if there is one, or else to a
+ * free tuner of the right type. All the jobs on a multiplex share its DVR:
+ * their PIDs are filtered into it once, and a pool of threads reads the
+ * DVRs and writes each job's packets (with a PAT and PMT of its own) to its
+ * output.
+ *
+ * With prefetch, tuners without jobs are kept on the multiplexes of the
+ * channels most likely to be asked for next: the channels either side (in
+ * the channel file) of the last one started, that one, and the others
+ * started recently. Every tuner also keeps the PMTs of those channels on
+ * its multiplex, so that such a job starts as soon as its PIDs are added.
+ * A job for another multiplex takes a tuner from the least likely one if
+ * none is free.
+ */
+struct gnutv_server_params {
+	char *socket_path;
+	char *chanfile;
+	char *chanstore;		// shared channel store, or NULL => chanfile
+	char *secfile;
+	char *secid;			// NULL => UNIVERSAL for DVB-S
+	int tuner_count;
+	int adapters[GNUTV_SERVER_MAX_TUNERS];
+	int frontend_id;
+	int demux_id;			// -1 => spread over all demuxes of a tuner
+	int buffer_size;		// DVR buffer size, 0 for the default
+	int threads;			// 0 => one per tuner, up to the number of CPUs
+	int prefetch;			// keep idle tuners on likely multiplexes
+	struct gnutv_store *store;	// write combining for file jobs, or NULL
+};
+
+/**
+ * Run the daemon until SIGINT or SIGTERM.
+ *
+ * @return The exit status.
+ */
+extern int gnutv_server_run(struct gnutv_server_params *params);
+
+#endif
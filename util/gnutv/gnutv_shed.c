@@ -0,0 +1,378 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/startcode.h>
+#include <libucsi/mpeg/types.h>
+#include <libucsi/mpeg/pmt_section.h>
+#include <libucsi/dvb/descriptor.h>
+#include "gnutv_shed.h"
+
+// streams classed
+#define SHED_MAX_PIDS 32
+
+// what a PID is: the level it is shed from, 0 => never
+#define SHED_KEEP 0
+#define SHED_ANCILLARY 1
+#define SHED_SECONDARY 2
+#define SHED_VIDEO 3
+
+#define SHED_EIT_PID 0x12
+
+#define PES_HDR_SIZE 9
+
+static const int shed_enter[GNUTV_SHED_LEVELS] = {
+	GNUTV_SHED_ENTER_1, GNUTV_SHED_ENTER_2, GNUTV_SHED_ENTER_3
+};
+static const int shed_leave[GNUTV_SHED_LEVELS] = {
+	GNUTV_SHED_LEAVE_1, GNUTV_SHED_LEAVE_2, GNUTV_SHED_LEAVE_3
+};
+static const char *shed_names[GNUTV_SHED_LEVELS] = {
+	"ancillary streams", "secondary audio and video", "disposable video pictures"
+};
+
+struct gnutv_shed {
+	uint8_t pid_class[TRANSPORT_MAX_PIDS];
+	uint8_t dropping[TRANSPORT_MAX_PIDS];	// the PES or section going on is shed
+	int shedding;				// PIDs with dropping set
+	uint16_t pids[SHED_MAX_PIDS];		// those classed from the PMT
+	int pid_count;
+	int video_codec;			// of the SHED_VIDEO PID
+	int pcr_pid;
+	pthread_mutex_t lock;
+
+	int level;
+	int64_t level_time;
+	int skip;			// bytes of a packet begun in the last buffer
+	int skip_drop;			// ... and if it is shed
+
+	struct gnutv_shed_stats stats;
+};
+
+struct gnutv_shed *gnutv_shed_create(void)
+{
+	struct gnutv_shed *shed;
+
+	if ((shed = calloc(1, sizeof(struct gnutv_shed))) == NULL)
+		return NULL;
+	shed->pid_class[SHED_EIT_PID] = SHED_ANCILLARY;
+	shed->video_codec = -1;
+	shed->pcr_pid = -1;
+	pthread_mutex_init(&shed->lock, NULL);
+
+	return shed;
+}
+
+void gnutv_shed_destroy(struct gnutv_shed *shed)
+{
+	pthread_mutex_destroy(&shed->lock);
+	free(shed);
+}
+
+#define SHED_KIND_OTHER 0
+#define SHED_KIND_VIDEO 1
+#define SHED_KIND_AUDIO 2
+#define SHED_KIND_ANCILLARY 3
+
+static int gnutv_shed_kind(struct mpeg_pmt_stream *stream)
+{
+	struct descriptor *curd;
+
+	switch(stream->stream_type) {
+	case MPEG_STREAM_TYPE_ISO11172_VIDEO:
+	case MPEG_STREAM_TYPE_ISO13818_2_VIDEO:
+	case MPEG_STREAM_TYPE_ISO14496_10_VIDEO:
+	case MPEG_STREAM_TYPE_ISO23008_2_VIDEO:
+		return SHED_KIND_VIDEO;
+
+	case MPEG_STREAM_TYPE_ISO11172_AUDIO:
+	case MPEG_STREAM_TYPE_ISO13818_3_AUDIO:
+	case MPEG_STREAM_TYPE_ISO13818_7_AUDIO_ADTS:
+	case MPEG_STREAM_TYPE_ISO14496_3_AUDIO_LATM:
+	case 0x81: // ATSC AC-3
+		return SHED_KIND_AUDIO;
+
+	case MPEG_STREAM_TYPE_ISO13818_1_PRIVATE_PES:
+		// DVB audio says what it is in a descriptor; the rest is teletext,
+		// subtitles or data
+		mpeg_pmt_stream_descriptors_for_each(stream, curd) {
+			switch(curd->tag) {
+			case dtag_dvb_ac3:
+			case dtag_dvb_enhanced_ac3_descriptor:
+			case dtag_dvb_dts_descriptor:
+			case dtag_dvb_aac_descriptor:
+				return SHED_KIND_AUDIO;
+			}
+		}
+		return SHED_KIND_ANCILLARY;
+
+	case MPEG_STREAM_TYPE_ISO13818_1_PRIVATE_SECTIONS:
+	case MPEG_STREAM_TYPE_ISO13522_MHEG:
+	case MPEG_STREAM_TYPE_ISO13818_DSMCC:
+	case MPEG_STREAM_TYPE_ISO13818_6_A:
+	case MPEG_STREAM_TYPE_ISO13818_6_B:
+	case MPEG_STREAM_TYPE_ISO13818_6_C:
+	case MPEG_STREAM_TYPE_ISO13818_6_D:
+	case MPEG_STREAM_TYPE_METADATA_PES:
+	case MPEG_STREAM_TYPE_METADATA_SECTIONS:
+	case MPEG_STREAM_TYPE_METADATA_DSMCC_DATA:
+	case MPEG_STREAM_TYPE_METADATA_DSMCC_OBJECT:
+	case MPEG_STREAM_TYPE_METADATA_SYNCDOWNLOAD:
+		return SHED_KIND_ANCILLARY;
+	}
+
+	return SHED_KIND_OTHER;
+}
+
+void gnutv_shed_set_pmt(struct gnutv_shed *shed, struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	int have_video = 0;
+	int have_audio = 0;
+	int cls;
+	int i;
+
+	pthread_mutex_lock(&shed->lock);
+	for(i = 0; i < shed->pid_count; i++) {
+		shed->pid_class[shed->pids[i]] = SHED_KEEP;
+		if (shed->dropping[shed->pids[i]]) {
+			shed->dropping[shed->pids[i]] = 0;
+			shed->shedding--;
+		}
+	}
+	shed->pid_count = 0;
+	shed->video_codec = -1;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		if (shed->pid_count == SHED_MAX_PIDS)
+			break;
+
+		switch(gnutv_shed_kind(cur_stream)) {
+		case SHED_KIND_VIDEO:
+			if (have_video) {
+				cls = SHED_SECONDARY;
+				break;
+			}
+			have_video = 1;
+			shed->video_codec = startcode_codec(cur_stream->stream_type);
+			cls = (shed->video_codec < 0) ? SHED_KEEP : SHED_VIDEO;
+			break;
+
+		case SHED_KIND_AUDIO:
+			cls = have_audio ? SHED_SECONDARY : SHED_KEEP;
+			have_audio = 1;
+			break;
+
+		case SHED_KIND_ANCILLARY:
+			cls = SHED_ANCILLARY;
+			break;
+
+		default:
+			continue;
+		}
+		shed->pid_class[cur_stream->pid] = cls;
+		shed->pids[shed->pid_count++] = cur_stream->pid;
+	}
+
+	shed->pcr_pid = pmt->pcr_pid;
+	pthread_mutex_unlock(&shed->lock);
+}
+
+/**
+ * Step up to the level for the fill level at once, or down one level at a
+ * time, each held GNUTV_SHED_HOLD_MS first.
+ */
+static void gnutv_shed_level(struct gnutv_shed *shed, int fill, int64_t now)
+{
+	int level = shed->level;
+
+	while((level < GNUTV_SHED_LEVELS) && (fill >= shed_enter[level]))
+		level++;
+	if ((level == shed->level) && level && (fill < shed_leave[level - 1]) &&
+	    (now - shed->level_time >= GNUTV_SHED_HOLD_MS * 1000000LL))
+		level--;
+	if (level == shed->level)
+		return;
+
+	if (level > shed->level)
+		fprintf(stderr, "Output falling behind (ring %i%% full): shedding %s\n",
+			fill, shed_names[level - 1]);
+	else
+		fprintf(stderr, "Output catching up (ring %i%% full): restoring %s\n",
+			fill, shed_names[level]);
+	shed->level = level;
+	shed->level_time = now;
+	shed->stats.changes++;
+}
+
+/**
+ * Whether a packet starting a PES of the video stream starts a picture no
+ * other refers to; anything not clear from the packet is kept.
+ */
+static int gnutv_shed_disposable(struct gnutv_shed *shed, uint8_t *pkt, int len)
+{
+	struct startcode_scanner sc;
+	uint8_t *pes;
+	int pos = 4;
+	int hdrlen;
+
+	// scrambled, or no payload
+	if ((pkt[3] & 0xc0) || !(pkt[3] & 0x10))
+		return 0;
+	if (pkt[3] & 0x20)
+		pos += 1 + pkt[4];
+	if (pos >= len)
+		return 0;
+	pes = pkt + pos;
+	len -= pos;
+
+	if ((len < PES_HDR_SIZE) || (pes[0] != 0x00) || (pes[1] != 0x00) || (pes[2] != 0x01) ||
+	    ((pes[6] & 0xc0) != 0x80))
+		return 0;
+	hdrlen = PES_HDR_SIZE + pes[8];
+	if (hdrlen >= len)
+		return 0;
+
+	startcode_scanner_init(&sc, shed->video_codec);
+	return (startcode_scan(&sc, pes + hdrlen, len - hdrlen) &
+		(STARTCODE_DISPOSABLE|STARTCODE_PARAMS)) == STARTCODE_DISPOSABLE;
+}
+
+/**
+ * The timing of the whole programme comes from the PCRs, so a shed packet
+ * holding one is kept, with the adaptation field stretched over the payload.
+ *
+ * @return 1 if the packet is to be kept.
+ */
+static int gnutv_shed_pcr(struct gnutv_shed *shed, uint8_t *pkt, int len)
+{
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	int af_len = pkt[4];
+
+	if ((pid != shed->pcr_pid) || (len != TRANSPORT_PACKET_LENGTH) || !(pkt[3] & 0x20) ||
+	    (af_len == 0) || (af_len > 183) || !(pkt[5] & transport_adaptation_flag_pcr))
+		return 0;
+
+	pkt[1] &= ~0x40;
+	pkt[3] = (pkt[3] & 0x0f) | 0x20;
+	memset(pkt + 5 + af_len, 0xff, 183 - af_len);
+	pkt[4] = 183;
+	return 1;
+}
+
+/**
+ * @return The class of a packet if it is shed, otherwise 0.
+ */
+static int gnutv_shed_packet(struct gnutv_shed *shed, uint8_t *pkt, int len)
+{
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	int cls = shed->pid_class[pid];
+	int drop;
+
+	if (cls == SHED_KEEP)
+		return 0;
+
+	// decided afresh at the start of each PES or section
+	if (pkt[1] & 0x40) {
+		drop = (shed->level >= cls) &&
+		       ((cls != SHED_VIDEO) || gnutv_shed_disposable(shed, pkt, len));
+		shed->shedding += drop - shed->dropping[pid];
+		shed->dropping[pid] = drop;
+	}
+
+	return shed->dropping[pid] ? cls : 0;
+}
+
+int gnutv_shed_process(struct gnutv_shed *shed, uint8_t *buf, int size, int fill,
+		       int64_t now)
+{
+	int in = 0;
+	int out = 0;
+	int cls;
+	int n;
+
+	pthread_mutex_lock(&shed->lock);
+	gnutv_shed_level(shed, fill, now);
+
+	// nothing to shed: only keep count of where the packets start
+	if (!shed->level && !shed->shedding && !shed->skip && (size > 0) &&
+	    (buf[0] == TRANSPORT_PACKET_SYNC)) {
+		shed->stats.packets += size / TRANSPORT_PACKET_LENGTH;
+		shed->skip = (TRANSPORT_PACKET_LENGTH - (size % TRANSPORT_PACKET_LENGTH)) %
+			     TRANSPORT_PACKET_LENGTH;
+		shed->skip_drop = 0;
+		pthread_mutex_unlock(&shed->lock);
+		return size;
+	}
+
+	// the rest of the packet the last buffer ended in the middle of
+	if (shed->skip) {
+		n = (shed->skip < size) ? shed->skip : size;
+		if (!shed->skip_drop)
+			out = n;
+		in = n;
+		shed->skip -= n;
+	}
+
+	while(in < size) {
+		uint8_t *pkt = buf + in;
+
+		if (pkt[0] != TRANSPORT_PACKET_SYNC) {
+			buf[out++] = buf[in++];
+			continue;
+		}
+
+		// too little of the header to tell: kept
+		n = size - in;
+		if (n > TRANSPORT_PACKET_LENGTH)
+			n = TRANSPORT_PACKET_LENGTH;
+		cls = (n < 4) ? 0 : gnutv_shed_packet(shed, pkt, n);
+		if (cls)
+			shed->stats.shed[cls - 1]++;
+		if (!cls || gnutv_shed_pcr(shed, pkt, n)) {
+			if (out != in)
+				memmove(buf + out, pkt, n);
+			out += n;
+		}
+		shed->stats.packets++;
+		in += n;
+
+		if (n < TRANSPORT_PACKET_LENGTH) {
+			shed->skip = TRANSPORT_PACKET_LENGTH - n;
+			shed->skip_drop = (cls != 0);
+		}
+	}
+	pthread_mutex_unlock(&shed->lock);
+
+	return out;
+}
+
+void gnutv_shed_get_stats(struct gnutv_shed *shed, struct gnutv_shed_stats *stats)
+{
+	pthread_mutex_lock(&shed->lock);
+	*stats = shed->stats;
+	stats->level = shed->level;
+	pthread_mutex_unlock(&shed->lock);
+}
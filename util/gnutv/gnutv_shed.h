@@ -0,0 +1,102 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_SHED_H
+#define gnutv_SHED_H 1
+
+#include <stdint.h>
+
+/**
+ * Sheds the less important streams of the recording when the output can't
+ * keep up, so that the main audio and video carry on rather than the DVR
+ * overflowing and everything losing data. It runs in the -ring drain
+ * thread on the data going into the ring, and steps through these levels
+ * as the ring fills:
+ *
+ * 1. ancillary streams: teletext, subtitles, other private data, DSM-CC,
+ *    and the EIT
+ * 2. secondary streams: every audio and video stream but the first
+ * 3. the pictures of the first video stream which no other refers to
+ *    (MPEG-2 B pictures, H.264 pictures with nal_ref_idc 0), as far as the
+ *    first packet of their PES tells
+ *
+ * A level is entered once the ring is GNUTV_SHED_ENTER_1/2/3 percent full,
+ * and left once it is below GNUTV_SHED_LEAVE_1/2/3 percent and the level has
+ * been held GNUTV_SHED_HOLD_MS. The PAT, the PMT, and whatever the PMT
+ * doesn't list (the ECMs for example) are never shed, nor are the PCRs: a
+ * shed packet holding one is kept as an adaptation field without payload.
+ *
+ * A stream is only started or stopped being shed at the start of a PES or
+ * section, so what is passed on of it is whole, though its continuity
+ * counters jump.
+ */
+struct gnutv_shed;
+struct mpeg_pmt_section;
+
+#define GNUTV_SHED_LEVELS 3
+
+#define GNUTV_SHED_ENTER_1 50
+#define GNUTV_SHED_ENTER_2 70
+#define GNUTV_SHED_ENTER_3 85
+#define GNUTV_SHED_LEAVE_1 25
+#define GNUTV_SHED_LEAVE_2 45
+#define GNUTV_SHED_LEAVE_3 60
+#define GNUTV_SHED_HOLD_MS 2000
+
+// the ring made for -shed if there isn't one
+#define GNUTV_SHED_RING_SIZE (16 * 1024 * 1024)
+
+struct gnutv_shed_stats {
+	int level;			// current level, 0 => nothing shed
+	uint64_t packets;		// packets seen
+	uint64_t shed[GNUTV_SHED_LEVELS];	// packets shed at each level
+	uint64_t changes;		// level changes
+};
+
+/**
+ * @return A shedder with nothing to shed until it has a PMT, or NULL if out
+ * of memory.
+ */
+extern struct gnutv_shed *gnutv_shed_create(void);
+
+extern void gnutv_shed_destroy(struct gnutv_shed *shed);
+
+/**
+ * Class the streams of a PMT, in place of those of the last one. May be
+ * called from another thread than gnutv_shed_process().
+ */
+extern void gnutv_shed_set_pmt(struct gnutv_shed *shed, struct mpeg_pmt_section *pmt);
+
+/**
+ * Choose the level for the ring's fill level, then take the packets shed
+ * at it out of the next piece of the stream, in place. The piece needn't
+ * start or end on a packet boundary.
+ *
+ * @param fill Percentage of the ring in use.
+ * @param now The time in nanoseconds, from a monotonic clock.
+ * @return Length of what is left.
+ */
+extern int gnutv_shed_process(struct gnutv_shed *shed, uint8_t *buf, int size, int fill,
+			      int64_t now);
+
+extern void gnutv_shed_get_stats(struct gnutv_shed *shed, struct gnutv_shed_stats *stats);
+
+#endif
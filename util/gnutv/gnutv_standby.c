@@ -0,0 +1,631 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/poll.h>
+#include <libdvbapi/dvbdemux.h>
+#include <libdvbapi/dvbfe.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_affinity.h"
+#include "gnutv_standby.h"
+
+// how often the standby frontend's lock is read, and how long it gets to
+// lock after each tune (ms)
+#define LOCK_POLL_INTERVAL 50
+#define RETUNE_WAIT 1500
+
+// packets passed on per call of the output
+#define OUTPUT_BATCH 64
+
+// how far ahead in the history a packet of a feed catching up is looked for
+#define CATCHUP_LOOKAHEAD 64
+
+// the table of a backlog's hashes, used at a switch
+#define TABLE_SIZE (GNUTV_STANDBY_WINDOW * 2)
+
+#define CC_UNKNOWN 0xff
+
+// why a feed was switched from
+#define REASON_NONE 0
+#define REASON_TEI 1
+#define REASON_CC 2
+#define REASON_SYNC 3
+#define REASON_SCRAMBLED 4
+#define REASON_LOCK 5
+#define REASON_STALL 6
+
+static const char *reasons[] = {
+	"", "transport errors", "continuity errors", "lost sync", "scrambled",
+	"lost lock", "no data",
+};
+
+static const char *feed_names[] = { "primary", "standby" };
+
+struct standby_feed {
+	int locked;
+	int64_t last_data;		// ms of its last packet; 0 for none yet
+	int64_t last_error;		// ms of its last bad packet
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int partial_fill;
+
+	// the feed's own continuity, and what was last scrambled on it
+	uint8_t cc[TRANSPORT_MAX_PIDS];
+	uint8_t scrambled[TRANSPORT_MAX_PIDS];
+	int scrambled_run;
+
+	// while inactive, its newest packets
+	uint8_t *backlog;
+	uint64_t *backlog_hash;
+	int backlog_head;		// the oldest
+	int backlog_count;
+
+	uint64_t packets;
+	uint64_t errors;
+	int switched_from[REASON_STALL + 1];
+};
+
+struct table_entry {
+	uint64_t hash;
+	int index;			// into the backlog; -1 if free
+};
+
+struct gnutv_standby {
+	struct gnutv_standby_params params;
+	struct dvbfe_handle *fe;
+	struct dvbdemux_pidset *pidset;
+	int dvrfd;
+	int own_dvrfd;			// the DVR device rather than the PID set's filter
+	pthread_t thread;
+	int shutdown;
+	int fe_locked;			// set by the thread
+
+	gnutv_standby_output output;
+	void *arg;
+	uint8_t out[TRANSPORT_PACKET_LENGTH * OUTPUT_BATCH];
+	int out_fill;
+
+	struct standby_feed feeds[2];
+	int active;
+
+	// the hashes of the last packets passed on, and each PID's last CC
+	uint64_t history[GNUTV_STANDBY_WINDOW];
+	uint64_t history_seq;		// that of the next packet passed on
+	uint8_t out_cc[TRANSPORT_MAX_PIDS];
+
+	// a feed switched to which was behind skips what was passed on already
+	int catchup;
+	uint64_t catchup_seq;
+	uint64_t catchup_end;
+
+	struct table_entry *table;
+	int switches;
+	int aligned;
+	uint64_t skipped;
+};
+
+static void *standby_thread_func(void *arg);
+
+static int64_t standby_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+struct gnutv_standby *gnutv_standby_create(struct gnutv_standby_params *params)
+{
+	struct gnutv_standby *sb;
+	int i;
+
+	if ((sb = (struct gnutv_standby *) calloc(1, sizeof(struct gnutv_standby))) == NULL) {
+		fprintf(stderr, "Out of memory for standby\n");
+		return NULL;
+	}
+	sb->params = *params;
+	sb->dvrfd = -1;
+	memset(sb->out_cc, CC_UNKNOWN, sizeof(sb->out_cc));
+	for(i=0; i < 2; i++) {
+		memset(sb->feeds[i].cc, CC_UNKNOWN, sizeof(sb->feeds[i].cc));
+		sb->feeds[i].backlog = (uint8_t *) malloc(GNUTV_STANDBY_WINDOW * TRANSPORT_PACKET_LENGTH);
+		sb->feeds[i].backlog_hash = (uint64_t *) malloc(GNUTV_STANDBY_WINDOW * sizeof(uint64_t));
+		if ((sb->feeds[i].backlog == NULL) || (sb->feeds[i].backlog_hash == NULL))
+			goto nomem;
+	}
+	if ((sb->table = (struct table_entry *) malloc(TABLE_SIZE * sizeof(struct table_entry))) == NULL)
+		goto nomem;
+
+	if ((sb->fe = dvbfe_open(params->adapter_id, params->frontend_id, 0)) == NULL) {
+		fprintf(stderr, "Failed to open standby frontend\n");
+		goto error;
+	}
+	if ((sb->pidset = dvbdemux_pidset_open(params->adapter_id, params->demux_id, 0,
+					       params->buffer_size)) == NULL)
+		goto nomem;
+	if ((sb->dvrfd = dvbdemux_pidset_fd(sb->pidset)) == -1) {
+		if ((sb->dvrfd = dvbdemux_open_dvr(params->adapter_id, params->demux_id, 1, 0)) < 0) {
+			fprintf(stderr, "Failed to open standby DVR device\n");
+			goto error;
+		}
+		sb->own_dvrfd = 1;
+		if ((params->buffer_size > 0) && dvbdemux_set_buffer(sb->dvrfd, params->buffer_size)) {
+			fprintf(stderr, "Failed to set standby DVR buffer size\n");
+			goto error;
+		}
+	}
+
+	if (gnutv_affinity_thread_create(&sb->thread, GNUTV_THREAD_NORMAL, standby_thread_func, sb)) {
+		fprintf(stderr, "Failed to start standby thread\n");
+		goto error;
+	}
+	return sb;
+
+nomem:
+	fprintf(stderr, "Out of memory for standby\n");
+error:
+	if (sb->own_dvrfd)
+		close(sb->dvrfd);
+	if (sb->pidset)
+		dvbdemux_pidset_close(sb->pidset);
+	if (sb->fe)
+		dvbfe_close(sb->fe);
+	for(i=0; i < 2; i++) {
+		free(sb->feeds[i].backlog);
+		free(sb->feeds[i].backlog_hash);
+	}
+	free(sb->table);
+	free(sb);
+	return NULL;
+}
+
+void gnutv_standby_destroy(struct gnutv_standby *sb)
+{
+	int i;
+	int j;
+
+	__atomic_store_n(&sb->shutdown, 1, __ATOMIC_RELEASE);
+	pthread_join(sb->thread, NULL);
+
+	fprintf(stderr, "Standby: %i switches (%i aligned on a common packet), %llu packets skipped\n",
+		sb->switches, sb->aligned, (unsigned long long) sb->skipped);
+	for(i=0; i < 2; i++) {
+		struct standby_feed *feed = &sb->feeds[i];
+
+		fprintf(stderr, "Standby: %s feed %llu packets, %llu bad", feed_names[i],
+			(unsigned long long) feed->packets, (unsigned long long) feed->errors);
+		for(j=REASON_TEI; j <= REASON_STALL; j++) {
+			if (feed->switched_from[j])
+				fprintf(stderr, ", left %i times for %s", feed->switched_from[j], reasons[j]);
+		}
+		fprintf(stderr, "\n");
+		free(feed->backlog);
+		free(feed->backlog_hash);
+	}
+
+	if (sb->own_dvrfd)
+		close(sb->dvrfd);
+	dvbdemux_pidset_close(sb->pidset);
+	dvbfe_close(sb->fe);
+	free(sb->table);
+	free(sb);
+}
+
+void gnutv_standby_set_output(struct gnutv_standby *sb, gnutv_standby_output output, void *arg)
+{
+	sb->output = output;
+	sb->arg = arg;
+}
+
+int gnutv_standby_add_pid(struct gnutv_standby *sb, int pid)
+{
+	if (dvbdemux_pidset_add(sb->pidset, pid)) {
+		fprintf(stderr, "Unable to create standby dvr filter for PID %i\n", pid);
+		return -1;
+	}
+	return 0;
+}
+
+void gnutv_standby_remove_pid(struct gnutv_standby *sb, int pid)
+{
+	dvbdemux_pidset_remove(sb->pidset, pid);
+}
+
+int gnutv_standby_fd(struct gnutv_standby *sb)
+{
+	return sb->dvrfd;
+}
+
+static void standby_tune(struct gnutv_standby *sb)
+{
+	struct gnutv_standby_params *params = &sb->params;
+
+	if (dvbsec_set(sb->fe,
+		       params->valid_sec ? &params->sec : NULL,
+		       params->channel.polarization,
+		       (params->channel.diseqc_switch & 0x01) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       (params->channel.diseqc_switch & 0x02) ? DISEQC_SWITCH_B : DISEQC_SWITCH_A,
+		       &params->channel.fe_params,
+		       0))
+		fprintf(stderr, "Failed to set standby frontend\n");
+}
+
+/*
+ * Tune the standby frontend and follow its lock, from its events and by
+ * reading it regularly, retuning while it has none.
+ */
+static void *standby_thread_func(void *arg)
+{
+	struct gnutv_standby *sb = (struct gnutv_standby *) arg;
+	struct dvbfe_info result;
+	struct pollfd pollfd;
+	int64_t next_retune;
+	int locked = 0;
+
+	standby_tune(sb);
+	next_retune = standby_now() + RETUNE_WAIT;
+
+	pollfd.fd = dvbfe_get_pollfd(sb->fe);
+	pollfd.events = POLLIN|POLLPRI;
+	while(!__atomic_load_n(&sb->shutdown, __ATOMIC_ACQUIRE)) {
+		pollfd.revents = 0;
+		if ((poll(&pollfd, 1, LOCK_POLL_INTERVAL) == -1) && (errno != EINTR))
+			break;
+
+		memset(&result, 0, sizeof(result));
+		if (!(dvbfe_get_info(sb->fe, DVBFE_INFO_LOCKSTATUS, &result,
+				     pollfd.revents ? DVBFE_INFO_QUERYTYPE_LOCKCHANGE : DVBFE_INFO_QUERYTYPE_IMMEDIATE,
+				     0) & DVBFE_INFO_LOCKSTATUS))
+			continue;
+
+		if (result.lock != locked) {
+			locked = result.lock;
+			__atomic_store_n(&sb->fe_locked, locked, __ATOMIC_RELEASE);
+			fprintf(stderr, "Standby frontend %s\n", locked ? "locked" : "lost lock");
+		}
+		if (locked) {
+			next_retune = standby_now() + RETUNE_WAIT;
+		} else if (standby_now() >= next_retune) {
+			standby_tune(sb);
+			next_retune = standby_now() + RETUNE_WAIT;
+		}
+	}
+
+	return NULL;
+}
+
+#define HASH_MULTIPLIER 0x9e3779b97f4a7c15ULL
+
+static uint64_t standby_hash(const uint8_t *pkt)
+{
+	uint64_t hash = 0;
+	uint64_t word;
+	uint32_t tail;
+	int i;
+
+	// 23 words and a half
+	for(i = 0; i + 8 <= TRANSPORT_PACKET_LENGTH; i += 8) {
+		memcpy(&word, pkt + i, 8);
+		hash = (hash ^ word) * HASH_MULTIPLIER;
+		hash ^= hash >> 29;
+	}
+	memcpy(&tail, pkt + i, 4);
+	hash = (hash ^ tail) * HASH_MULTIPLIER;
+	return hash ^ (hash >> 32);
+}
+
+static void standby_flush(struct gnutv_standby *sb)
+{
+	if (sb->out_fill) {
+		sb->output(sb->arg, sb->out, sb->out_fill);
+		sb->out_fill = 0;
+	}
+}
+
+/*
+ * Pass a packet on, recording it in the history.
+ */
+static void standby_emit(struct gnutv_standby *sb, const uint8_t *pkt, uint64_t hash)
+{
+	int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+
+	sb->history[sb->history_seq % GNUTV_STANDBY_WINDOW] = hash;
+	sb->history_seq++;
+	if (pkt[3] & 0x10)
+		sb->out_cc[pid] = pkt[3] & 0x0f;
+
+	memcpy(sb->out + sb->out_fill, pkt, TRANSPORT_PACKET_LENGTH);
+	sb->out_fill += TRANSPORT_PACKET_LENGTH;
+	if (sb->out_fill == sizeof(sb->out))
+		standby_flush(sb);
+}
+
+/*
+ * Pass on a packet of a feed which may be catching up: unless it is one of
+ * those passed on already, from the other feed.
+ */
+static void standby_emit_catchup(struct gnutv_standby *sb, const uint8_t *pkt, uint64_t hash)
+{
+	uint64_t seq;
+	uint64_t end;
+
+	if (sb->catchup) {
+		// what is still to be caught up with may not be overwritten
+		if (sb->history_seq - sb->catchup_seq >= GNUTV_STANDBY_WINDOW) {
+			sb->catchup = 0;
+		} else {
+			end = sb->catchup_seq + CATCHUP_LOOKAHEAD;
+			if (end > sb->catchup_end)
+				end = sb->catchup_end;
+			for(seq = sb->catchup_seq; seq < end; seq++) {
+				if (sb->history[seq % GNUTV_STANDBY_WINDOW] != hash)
+					continue;
+
+				sb->skipped++;
+				sb->catchup_seq = seq + 1;
+				if (sb->catchup_seq >= sb->catchup_end)
+					sb->catchup = 0;
+				return;
+			}
+		}
+	}
+
+	standby_emit(sb, pkt, hash);
+}
+
+/**
+ * @return The index in the backlog of the newest packet also in the
+ * history, and in *seq its place there; -1 if there is none.
+ */
+static int standby_find_common(struct gnutv_standby *sb, struct standby_feed *feed, uint64_t *seq)
+{
+	uint64_t oldest;
+	uint64_t s;
+	int i;
+	int slot;
+
+	if ((feed->backlog_count == 0) || (sb->history_seq == 0))
+		return -1;
+
+	// newer packets overwrite older ones with the same hash
+	for(i=0; i < TABLE_SIZE; i++)
+		sb->table[i].index = -1;
+	for(i=0; i < feed->backlog_count; i++) {
+		int index = (feed->backlog_head + i) % GNUTV_STANDBY_WINDOW;
+		uint64_t hash = feed->backlog_hash[index];
+
+		for(slot = hash % TABLE_SIZE; sb->table[slot].index != -1; slot = (slot + 1) % TABLE_SIZE) {
+			if (sb->table[slot].hash == hash)
+				break;
+		}
+		sb->table[slot].hash = hash;
+		sb->table[slot].index = i;
+	}
+
+	oldest = (sb->history_seq > GNUTV_STANDBY_WINDOW) ? sb->history_seq - GNUTV_STANDBY_WINDOW : 0;
+	for(s = sb->history_seq; s-- > oldest; ) {
+		uint64_t hash = sb->history[s % GNUTV_STANDBY_WINDOW];
+
+		for(slot = hash % TABLE_SIZE; sb->table[slot].index != -1; slot = (slot + 1) % TABLE_SIZE) {
+			if (sb->table[slot].hash == hash) {
+				*seq = s;
+				return sb->table[slot].index;
+			}
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Make the other feed the active one, carrying on from where the stream
+ * passed on got to.
+ */
+static void standby_switch(struct gnutv_standby *sb, int reason)
+{
+	struct standby_feed *old = &sb->feeds[sb->active];
+	struct standby_feed *feed = &sb->feeds[!sb->active];
+	uint64_t common_seq = 0;
+	int common;
+	int i;
+
+	old->switched_from[reason]++;
+	old->scrambled_run = 0;
+	old->backlog_count = 0;
+	sb->active = !sb->active;
+	sb->switches++;
+	fprintf(stderr, "Standby: switching to the %s feed (%s)\n", feed_names[sb->active], reasons[reason]);
+
+	// after the packet in common, skipping those passed on since
+	if ((common = standby_find_common(sb, feed, &common_seq)) != -1) {
+		sb->aligned++;
+		sb->catchup = common_seq + 1 < sb->history_seq;
+		sb->catchup_seq = common_seq + 1;
+		sb->catchup_end = sb->history_seq;
+		for(i = common + 1; i < feed->backlog_count; i++) {
+			int index = (feed->backlog_head + i) % GNUTV_STANDBY_WINDOW;
+
+			standby_emit_catchup(sb, feed->backlog + index * TRANSPORT_PACKET_LENGTH,
+					     feed->backlog_hash[index]);
+		}
+		feed->backlog_count = 0;
+		return;
+	}
+
+	// nothing in common: whatever follows on from each PID's last packet
+	sb->catchup = 0;
+	for(i=0; i < feed->backlog_count; i++) {
+		int index = (feed->backlog_head + i) % GNUTV_STANDBY_WINDOW;
+		uint8_t *pkt = feed->backlog + index * TRANSPORT_PACKET_LENGTH;
+		int pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+		int ahead = ((pkt[3] & 0x0f) - sb->out_cc[pid]) & 0x0f;
+
+		if ((pkt[3] & 0x10) && (sb->out_cc[pid] != CC_UNKNOWN) && ((ahead == 0) || (ahead >= 8))) {
+			sb->skipped++;
+			continue;
+		}
+		standby_emit(sb, pkt, feed->backlog_hash[index]);
+	}
+	feed->backlog_count = 0;
+}
+
+/*
+ * @return Nonzero if a feed may be switched to.
+ */
+static int standby_usable(struct standby_feed *feed, int64_t now)
+{
+	return feed->locked && feed->packets && (now - feed->last_data < GNUTV_STANDBY_STALL_MS) &&
+		(now - feed->last_error >= GNUTV_STANDBY_CLEAN_MS);
+}
+
+/*
+ * Check a packet of a feed against the feed's own continuity.
+ *
+ * @return REASON_NONE, or what is wrong with it.
+ */
+static int standby_check_packet(struct standby_feed *feed, struct standby_feed *other, const uint8_t *pkt)
+{
+	int pid;
+	int cc;
+	int scrambled;
+
+	if (pkt[0] != 0x47)
+		return REASON_SYNC;
+	if (pkt[1] & 0x80)
+		return REASON_TEI;
+
+	pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	if ((pid == TRANSPORT_NULL_PID) || !(pkt[3] & 0x10))
+		return REASON_NONE;
+
+	// the CC only moves on with a payload; one duplicate is allowed
+	cc = pkt[3] & 0x0f;
+	if ((feed->cc[pid] != CC_UNKNOWN) && (cc != feed->cc[pid]) && (cc != ((feed->cc[pid] + 1) & 0x0f)) &&
+	    !(((pkt[3] & 0x20) && (pkt[4] > 0)) && (pkt[5] & 0x80))) {
+		feed->cc[pid] = cc;
+		return REASON_CC;
+	}
+	feed->cc[pid] = cc;
+
+	// scrambled where the other feed has it clear
+	scrambled = (pkt[3] & 0xc0) != 0;
+	feed->scrambled[pid] = scrambled;
+	if (scrambled && (other->cc[pid] != CC_UNKNOWN) && !other->scrambled[pid]) {
+		if (++feed->scrambled_run >= GNUTV_STANDBY_SCRAMBLED_RUN) {
+			feed->scrambled_run = 0;
+			return REASON_SCRAMBLED;
+		}
+	} else if (!scrambled) {
+		feed->scrambled_run = 0;
+	}
+
+	return REASON_NONE;
+}
+
+static void standby_packet(struct gnutv_standby *sb, int f, const uint8_t *pkt, int64_t now)
+{
+	struct standby_feed *feed = &sb->feeds[f];
+	struct standby_feed *other = &sb->feeds[!f];
+	uint64_t hash;
+	int reason;
+	int index;
+
+	feed->packets++;
+	feed->last_data = now;
+	if ((reason = standby_check_packet(feed, other, pkt)) != REASON_NONE) {
+		feed->errors++;
+		feed->last_error = now;
+	}
+
+	// the other feed has this packet, undamaged
+	if ((f == sb->active) && (reason != REASON_NONE) && standby_usable(other, now)) {
+		standby_switch(sb, reason);
+		return;
+	}
+
+	hash = standby_hash(pkt);
+	if (f == sb->active) {
+		standby_emit_catchup(sb, pkt, hash);
+		return;
+	}
+
+	// keep it, in case of a switch
+	if (feed->backlog_count == GNUTV_STANDBY_WINDOW) {
+		feed->backlog_head = (feed->backlog_head + 1) % GNUTV_STANDBY_WINDOW;
+		feed->backlog_count--;
+	}
+	index = (feed->backlog_head + feed->backlog_count) % GNUTV_STANDBY_WINDOW;
+	memcpy(feed->backlog + index * TRANSPORT_PACKET_LENGTH, pkt, TRANSPORT_PACKET_LENGTH);
+	feed->backlog_hash[index] = hash;
+	feed->backlog_count++;
+}
+
+void gnutv_standby_input(struct gnutv_standby *sb, int f, const uint8_t *buf, int size, int64_t now)
+{
+	struct standby_feed *feed = &sb->feeds[f];
+	int pos = 0;
+	int count;
+
+	// the rest of a packet split over reads
+	if (feed->partial_fill) {
+		count = TRANSPORT_PACKET_LENGTH - feed->partial_fill;
+		if (count > size)
+			count = size;
+		memcpy(feed->partial + feed->partial_fill, buf, count);
+		feed->partial_fill += count;
+		pos = count;
+		if (feed->partial_fill < TRANSPORT_PACKET_LENGTH)
+			return;
+		standby_packet(sb, f, feed->partial, now);
+		feed->partial_fill = 0;
+	}
+
+	for(; pos + TRANSPORT_PACKET_LENGTH <= size; pos += TRANSPORT_PACKET_LENGTH)
+		standby_packet(sb, f, buf + pos, now);
+
+	if (pos < size) {
+		memcpy(feed->partial, buf + pos, size - pos);
+		feed->partial_fill = size - pos;
+	}
+	standby_flush(sb);
+}
+
+void gnutv_standby_check(struct gnutv_standby *sb, int primary_locked, int64_t now)
+{
+	struct standby_feed *feed = &sb->feeds[sb->active];
+	struct standby_feed *other = &sb->feeds[!sb->active];
+
+	sb->feeds[GNUTV_STANDBY_PRIMARY].locked = primary_locked;
+	sb->feeds[GNUTV_STANDBY_SECONDARY].locked = __atomic_load_n(&sb->fe_locked, __ATOMIC_ACQUIRE);
+
+	if (!standby_usable(other, now))
+		return;
+	if (!feed->locked)
+		standby_switch(sb, REASON_LOCK);
+	else if (now - feed->last_data >= GNUTV_STANDBY_STALL_MS)
+		standby_switch(sb, REASON_STALL);
+	standby_flush(sb);
+}
@@ -0,0 +1,138 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_STANDBY_H
+#define gnutv_STANDBY_H 1
+
+#include <stdint.h>
+#include <libdvbcfg/dvbcfg_zapchannel.h>
+#include <libdvbsec/dvbsec_api.h>
+
+/**
+ * A hot standby tuner (-standby): a second frontend, ideally fed from
+ * another dish, locked on the same multiplex, with the same PIDs on its
+ * DVR. Both DVRs are read by the drain thread, and one stream, that of the
+ * active feed, goes on into the ring.
+ *
+ * The active feed's packets are checked before they are passed on. A
+ * packet with transport_error_indicator set, a continuity counter jump, a
+ * lost sync byte, a run of packets which are scrambled where the other
+ * feed has them clear, or the active frontend losing lock or its DVR
+ * going quiet, switches to the other feed if that has been clean for
+ * GNUTV_STANDBY_CLEAN_MS. Switching is not revertive: the new feed stays
+ * active until it goes bad in turn.
+ *
+ * The inactive feed's last GNUTV_STANDBY_WINDOW packets are kept, and the
+ * hashes of as many packets passed on. At a switch the newest packet the
+ * two have in common is found, and the new feed carries on from the one
+ * after it: from its backlog if it is ahead, or, if it is behind, once the
+ * packets already passed on have been skipped as they arrive. A feed
+ * without a packet in common (one whose DVR had stopped) carries on with
+ * each PID's next continuity counter instead.
+ */
+struct gnutv_standby;
+
+#define GNUTV_STANDBY_PRIMARY 0
+#define GNUTV_STANDBY_SECONDARY 1
+
+// packets of backlog and history: a few hundred ms of a full multiplex
+#define GNUTV_STANDBY_WINDOW 8192
+
+// how long a feed must be free of errors to be switched to (ms)
+#define GNUTV_STANDBY_CLEAN_MS 1000
+
+// how long the active DVR may give nothing while the other one delivers (ms)
+#define GNUTV_STANDBY_STALL_MS 100
+
+// scrambled packets in a row, clear on the other feed, which are a failure
+#define GNUTV_STANDBY_SCRAMBLED_RUN 32
+
+// the ring used if -ring does not give one
+#define GNUTV_STANDBY_RING_SIZE (16*1024*1024)
+
+struct gnutv_standby_params {
+	int adapter_id;
+	int frontend_id;
+	int demux_id;
+	int buffer_size;		// of the DVR, 0 for the default
+	struct dvbcfg_zapchannel channel;
+	struct dvbsec_config sec;
+	int valid_sec;
+};
+
+/**
+ * Called with the merged stream, whole packets at a time.
+ */
+typedef void (*gnutv_standby_output)(void *arg, const uint8_t *buf, int size);
+
+/**
+ * Open the standby frontend and its demux, and start a thread tuning it and
+ * following its lock.
+ *
+ * @param params Where and what to tune.
+ * @return The standby, or NULL on failure (which has been reported).
+ */
+extern struct gnutv_standby *gnutv_standby_create(struct gnutv_standby_params *params);
+
+/**
+ * Say where the merged stream goes; before the first gnutv_standby_input().
+ */
+extern void gnutv_standby_set_output(struct gnutv_standby *sb, gnutv_standby_output output, void *arg);
+
+/**
+ * Stop the standby tuner, and print how often it was switched to and from.
+ */
+extern void gnutv_standby_destroy(struct gnutv_standby *sb);
+
+/**
+ * Record a PID from the standby frontend as well: the PIDs of the primary
+ * DVR are mirrored through these.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+extern int gnutv_standby_add_pid(struct gnutv_standby *sb, int pid);
+extern void gnutv_standby_remove_pid(struct gnutv_standby *sb, int pid);
+
+/**
+ * @return The fd of the standby DVR, to poll and read.
+ */
+extern int gnutv_standby_fd(struct gnutv_standby *sb);
+
+/**
+ * Pass on what was read from a DVR, which needn't start or end on a packet
+ * boundary. Called from one thread only, as is gnutv_standby_check().
+ *
+ * @param feed GNUTV_STANDBY_PRIMARY or GNUTV_STANDBY_SECONDARY.
+ * @param now The time in ms, from a monotonic clock.
+ */
+extern void gnutv_standby_input(struct gnutv_standby *sb, int feed, const uint8_t *buf, int size,
+				int64_t now);
+
+/**
+ * See whether the active feed has lost lock or stalled, and switch if so;
+ * call at least every GNUTV_STANDBY_STALL_MS / 2.
+ *
+ * @param primary_locked Nonzero if the primary frontend has lock.
+ * @param now The time in ms, from a monotonic clock.
+ */
+extern void gnutv_standby_check(struct gnutv_standby *sb, int primary_locked, int64_t now);
+
+#endif
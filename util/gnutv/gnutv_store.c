@@ -0,0 +1,433 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <libdvbmisc/dvbprobe.h>
+#include "gnutv_store.h"
+
+// the alignment O_DIRECT needs, of extents' memory, offsets and lengths
+#define STORE_ALIGN 4096
+
+// extents waiting to be written (or spare) beyond the one each file fills
+#define STORE_QUEUE_EXTENTS 4
+
+// how far ahead of the data files are preallocated, in extents
+#define STORE_PREALLOC_EXTENTS 4
+
+// how often the files written to are synced (ms)
+#define STORE_SYNC_INTERVAL 2000
+
+struct store_extent {
+	struct gnutv_store_file *file;
+	uint8_t *data;
+	int len;
+	uint64_t offset;
+	struct store_extent *next;
+};
+
+struct gnutv_store_file {
+	struct gnutv_store *store;
+	int fd;
+	int direct;
+	int prealloc;			// fallocate() works on it
+	uint64_t allocated;		// preallocated up to here
+	uint64_t offset;		// of the extent being filled
+	struct store_extent *fill;
+
+	// the rest are under the store's lock
+	int busy;			// extents queued or being written, or a sync
+	int dirty;			// written to since the last sync
+	int error;			// errno of a failed write
+	struct gnutv_store_file *next;
+};
+
+struct gnutv_store {
+	int extent_size;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t work;		// for the thread
+	pthread_cond_t done;		// an extent has been written, or a sync
+	int shutdown;
+
+	struct store_extent *queue;
+	struct store_extent *queue_tail;
+	struct store_extent *spare;
+	int loose;			// extents queued, being written or spare
+	struct gnutv_store_file *files;
+};
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((int64_t) ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+static struct store_extent *store_extent_new(struct gnutv_store *store)
+{
+	struct store_extent *ext;
+
+	if ((ext = calloc(1, sizeof(struct store_extent))) == NULL)
+		return NULL;
+	if (posix_memalign((void **) &ext->data, STORE_ALIGN, store->extent_size)) {
+		free(ext);
+		return NULL;
+	}
+	return ext;
+}
+
+static void store_extent_free(struct store_extent *ext)
+{
+	free(ext->data);
+	free(ext);
+}
+
+/*
+ * Write an extent out, in the store's thread. Only the last extent of a
+ * file may be partial; with O_DIRECT it is padded to the alignment, and the
+ * padding cut off again afterwards.
+ */
+static void store_write_extent(struct gnutv_store *store, struct store_extent *ext)
+{
+	struct gnutv_store_file *file = ext->file;
+	uint64_t len = ext->len;
+	uint64_t done = 0;
+	int err = 0;
+	int tmp;
+
+	if (file->direct && (len % STORE_ALIGN)) {
+		len += STORE_ALIGN - (len % STORE_ALIGN);
+		memset(ext->data + ext->len, 0, len - ext->len);
+	}
+
+	if (file->prealloc && ((ext->offset + len) > file->allocated)) {
+		uint64_t size = (uint64_t) store->extent_size * STORE_PREALLOC_EXTENTS;
+
+		if (fallocate(file->fd, FALLOC_FL_KEEP_SIZE, file->allocated, size) == 0)
+			file->allocated += size;
+		else
+			file->prealloc = 0;
+	}
+
+	DVBPROBE2(output_write, file->fd, ext->len);
+	while(done < len) {
+		tmp = pwrite(file->fd, ext->data + done, len - done, ext->offset + done);
+		if (tmp < 0) {
+			if (errno == EINTR)
+				continue;
+			if ((errno == EINVAL) && file->direct) {
+				fcntl(file->fd, F_SETFL, fcntl(file->fd, F_GETFL) & ~O_DIRECT);
+				file->direct = 0;
+				len = ext->len;
+				continue;
+			}
+			err = errno;
+			break;
+		}
+		done += tmp;
+	}
+	if (!err && (len > (uint64_t) ext->len) && ftruncate(file->fd, ext->offset + ext->len))
+		err = errno;
+
+	pthread_mutex_lock(&store->lock);
+	if (err && !file->error) {
+		fprintf(stderr, "Write error: %s\n", strerror(err));
+		file->error = err;
+	}
+	file->dirty = 1;
+	file->busy--;
+
+	// the last extent of a closed file takes the queue beyond its size
+	if (store->loose > STORE_QUEUE_EXTENTS) {
+		store_extent_free(ext);
+		store->loose--;
+	} else {
+		ext->next = store->spare;
+		store->spare = ext;
+	}
+	pthread_cond_broadcast(&store->done);
+	pthread_mutex_unlock(&store->lock);
+}
+
+/*
+ * Sync every file written to since the last time. Called with the lock
+ * held, which is dropped around each fdatasync(); a file being synced is
+ * busy, so it stays open.
+ */
+static void store_sync(struct gnutv_store *store)
+{
+	struct gnutv_store_file *file;
+
+	for(file = store->files; file; file = file->next) {
+		if (!file->dirty || file->error)
+			continue;
+		file->dirty = 0;
+		file->busy++;
+		pthread_mutex_unlock(&store->lock);
+
+		fdatasync(file->fd);
+
+		pthread_mutex_lock(&store->lock);
+		file->busy--;
+		pthread_cond_broadcast(&store->done);
+	}
+}
+
+static void *store_thread(void *arg)
+{
+	struct gnutv_store *store = (struct gnutv_store *) arg;
+	struct store_extent *ext;
+	int64_t next_sync = now_ms() + STORE_SYNC_INTERVAL;
+	struct timespec ts;
+
+	pthread_mutex_lock(&store->lock);
+	while(1) {
+		if ((ext = store->queue) != NULL) {
+			if ((store->queue = ext->next) == NULL)
+				store->queue_tail = NULL;
+			pthread_mutex_unlock(&store->lock);
+			store_write_extent(store, ext);
+			pthread_mutex_lock(&store->lock);
+			continue;
+		}
+		if (store->shutdown)
+			break;
+
+		if (now_ms() >= next_sync) {
+			store_sync(store);
+			next_sync = now_ms() + STORE_SYNC_INTERVAL;
+			continue;
+		}
+
+		ts.tv_sec = next_sync / 1000;
+		ts.tv_nsec = (next_sync % 1000) * 1000000;
+		pthread_cond_timedwait(&store->work, &store->lock, &ts);
+	}
+	pthread_mutex_unlock(&store->lock);
+
+	return NULL;
+}
+
+struct gnutv_store *gnutv_store_create(int extent_size)
+{
+	struct gnutv_store *store;
+	pthread_condattr_t attr;
+
+	if (extent_size <= 0) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ((store = calloc(1, sizeof(struct gnutv_store))) == NULL)
+		return NULL;
+	store->extent_size = (extent_size + STORE_ALIGN - 1) & ~(STORE_ALIGN - 1);
+
+	pthread_mutex_init(&store->lock, NULL);
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&store->work, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_cond_init(&store->done, NULL);
+
+	if (pthread_create(&store->thread, NULL, store_thread, store)) {
+		pthread_cond_destroy(&store->done);
+		pthread_cond_destroy(&store->work);
+		pthread_mutex_destroy(&store->lock);
+		free(store);
+		return NULL;
+	}
+
+	return store;
+}
+
+void gnutv_store_destroy(struct gnutv_store *store)
+{
+	struct store_extent *ext;
+
+	pthread_mutex_lock(&store->lock);
+	store->shutdown = 1;
+	pthread_cond_signal(&store->work);
+	pthread_mutex_unlock(&store->lock);
+	pthread_join(store->thread, NULL);
+
+	while((ext = store->spare) != NULL) {
+		store->spare = ext->next;
+		store_extent_free(ext);
+	}
+	pthread_cond_destroy(&store->done);
+	pthread_cond_destroy(&store->work);
+	pthread_mutex_destroy(&store->lock);
+	free(store);
+}
+
+struct gnutv_store_file *gnutv_store_open(struct gnutv_store *store, int fd)
+{
+	struct gnutv_store_file *file;
+	struct stat st;
+	off_t pos;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode) || ((pos = lseek(fd, 0, SEEK_CUR)) < 0))
+		return NULL;
+
+	if ((file = calloc(1, sizeof(struct gnutv_store_file))) == NULL)
+		return NULL;
+	if ((file->fill = store_extent_new(store)) == NULL) {
+		free(file);
+		return NULL;
+	}
+	file->fill->file = file;
+	file->store = store;
+	file->fd = fd;
+	file->offset = pos;
+	file->allocated = pos;
+	file->prealloc = 1;
+
+	// O_DIRECT offsets have to be aligned as well
+	if (((pos % STORE_ALIGN) == 0) &&
+	    (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) == 0))
+		file->direct = 1;
+
+	pthread_mutex_lock(&store->lock);
+	file->next = store->files;
+	store->files = file;
+	pthread_mutex_unlock(&store->lock);
+
+	return file;
+}
+
+/*
+ * Hand the extent being filled to the thread. Called with the lock held.
+ */
+static void store_queue(struct gnutv_store_file *file)
+{
+	struct gnutv_store *store = file->store;
+	struct store_extent *ext = file->fill;
+
+	ext->offset = file->offset;
+	ext->next = NULL;
+	if (store->queue_tail)
+		store->queue_tail->next = ext;
+	else
+		store->queue = ext;
+	store->queue_tail = ext;
+	store->loose++;
+	file->offset += ext->len;
+	file->fill = NULL;
+	file->busy++;
+	pthread_cond_signal(&store->work);
+}
+
+int gnutv_store_write(struct gnutv_store_file *file, uint8_t *buf, int len)
+{
+	struct gnutv_store *store = file->store;
+	struct store_extent *ext;
+	int count;
+
+	while(len) {
+		ext = file->fill;
+		count = store->extent_size - ext->len;
+		if (count > len)
+			count = len;
+		memcpy(ext->data + ext->len, buf, count);
+		ext->len += count;
+		buf += count;
+		len -= count;
+		if (ext->len < store->extent_size)
+			break;
+
+		// full: swap it for a spare, or a new one while the queue is short
+		pthread_mutex_lock(&store->lock);
+		if (file->error) {
+			ext->len = 0;
+			errno = file->error;
+			pthread_mutex_unlock(&store->lock);
+			return -1;
+		}
+		store_queue(file);
+		while(file->fill == NULL) {
+			ext = NULL;
+			if (store->spare != NULL) {
+				ext = store->spare;
+				store->spare = ext->next;
+				store->loose--;
+			} else if (store->loose <= STORE_QUEUE_EXTENTS) {
+				ext = store_extent_new(store);
+			}
+			if (ext == NULL) {
+				pthread_cond_wait(&store->done, &store->lock);
+				continue;
+			}
+			ext->file = file;
+			ext->len = 0;
+			file->fill = ext;
+		}
+		pthread_mutex_unlock(&store->lock);
+	}
+
+	return 0;
+}
+
+int gnutv_store_close(struct gnutv_store_file *file)
+{
+	struct gnutv_store *store = file->store;
+	struct gnutv_store_file **cur;
+	int err;
+
+	pthread_mutex_lock(&store->lock);
+	if (file->fill->len && !file->error)
+		store_queue(file);
+	while(file->busy)
+		pthread_cond_wait(&store->done, &store->lock);
+	for(cur = &store->files; *cur != file; cur = &(*cur)->next);
+	*cur = file->next;
+	err = file->error;
+	pthread_mutex_unlock(&store->lock);
+
+	if (file->fill)
+		store_extent_free(file->fill);
+	if (!err && fdatasync(file->fd))
+		err = errno;
+	if (file->allocated > file->offset)
+		fallocate(file->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			  file->offset, file->allocated - file->offset);
+	if (file->direct)
+		fcntl(file->fd, F_SETFL, fcntl(file->fd, F_GETFL) & ~O_DIRECT);
+	free(file);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+	return 0;
+}
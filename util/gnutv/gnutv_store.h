@@ -0,0 +1,81 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_STORE_H
+#define gnutv_STORE_H 1
+
+#include <stdint.h>
+
+/**
+ * Write combining for many recordings at once. Rather than every recording
+ * writing what it has each time round, each collects its data into an
+ * extent of several megabytes of its own, and full extents are written by
+ * the store's thread, so the disk sees a few large sequential writes
+ * instead of many small interleaved ones. Files are written with O_DIRECT
+ * where the filesystem allows it, preallocated some extents ahead of the
+ * data, and fdatasync()ed together every couple of seconds.
+ *
+ * A recording only waits when the thread is several extents behind, which
+ * is when the disk cannot keep up anyway.
+ */
+struct gnutv_store;
+struct gnutv_store_file;
+
+/**
+ * Create a store, and start its thread.
+ *
+ * @param extent_size Bytes in an extent; rounded up to a multiple of 4096.
+ * @return The store, or NULL on failure.
+ */
+extern struct gnutv_store *gnutv_store_create(int extent_size);
+
+/**
+ * Stop a store's thread and free it. Its files must all be closed.
+ */
+extern void gnutv_store_destroy(struct gnutv_store *store);
+
+/**
+ * Record into a file through the store, from its current position. One
+ * thread at a time may write to any one file.
+ *
+ * @param fd The file, which stays the caller's to close (after
+ * gnutv_store_close()).
+ * @return The file, or NULL if fd is not a regular file or out of memory;
+ * the caller should then write to it itself.
+ */
+extern struct gnutv_store_file *gnutv_store_open(struct gnutv_store *store, int fd);
+
+/**
+ * Add data to a file.
+ *
+ * @return 0 on success, -1 if writing to it has failed (errno is set).
+ */
+extern int gnutv_store_write(struct gnutv_store_file *file, uint8_t *buf, int len);
+
+/**
+ * Write out what is left of a file, sync it, and free its preallocated
+ * space beyond the end of the data.
+ *
+ * @return 0 on success, -1 if any of its writes failed (errno is set).
+ */
+extern int gnutv_store_close(struct gnutv_store_file *file);
+
+#endif
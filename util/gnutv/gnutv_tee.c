@@ -0,0 +1,339 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <libucsi/mpeg/section.h>
+#include <libucsi/transport_packet.h>
+#include "gnutv_data.h"
+#include "gnutv_ring.h"
+#include "gnutv_http.h"
+#include "gnutv_affinity.h"
+#include "gnutv_tee.h"
+
+#define TEE_FILE 0
+#define TEE_UDP 1
+#define TEE_HTTP 2
+
+// udp/rtp datagrams carry 7 packets, so are gathered across the end of the ring
+#define TEE_UDP_CHUNK (TRANSPORT_PACKET_LENGTH * 7)
+
+// how long a sink sleeps at a time waiting for data, in ms
+#define TEE_WAIT 100
+
+struct tee_sink {
+	int type;
+	pthread_t thread;
+	int started;
+	struct gnutv_tee *tee;
+	int consumer;
+
+	int fd;				// file or socket; -1 if none
+	struct addrinfo *addrs;
+	struct udp_output *udp;
+	struct gnutv_http *http;
+	int failed;
+
+	// udp: the datagram which straddles the end of the ring
+	uint8_t bounce[TEE_UDP_CHUNK];
+	int bounce_fill;
+
+	uint64_t bytes;
+	uint64_t skipped;
+};
+
+struct gnutv_tee {
+	struct gnutv_ring *ring;
+	size_t lag;			// lossy sinks skip ahead beyond this
+	int sink_count;
+	struct tee_sink sinks[GNUTV_TEE_MAX_SINKS];
+};
+
+static const char *tee_names[] = { "file", "udp", "http" };
+
+struct gnutv_tee *gnutv_tee_create(void)
+{
+	return calloc(1, sizeof(struct gnutv_tee));
+}
+
+static struct tee_sink *gnutv_tee_new_sink(struct gnutv_tee *tee, int type)
+{
+	struct tee_sink *sink;
+
+	if (tee->sink_count == GNUTV_TEE_MAX_SINKS) {
+		fprintf(stderr, "Too many -tee outputs\n");
+		return NULL;
+	}
+	sink = &tee->sinks[tee->sink_count];
+	memset(sink, 0, sizeof(struct tee_sink));
+	sink->type = type;
+	sink->tee = tee;
+	sink->consumer = tee->sink_count;
+	sink->fd = -1;
+	return sink;
+}
+
+int gnutv_tee_add_file(struct gnutv_tee *tee, const char *filename)
+{
+	struct tee_sink *sink;
+
+	if ((sink = gnutv_tee_new_sink(tee, TEE_FILE)) == NULL)
+		return -1;
+	if (filename == NULL) {
+		sink->fd = STDOUT_FILENO;
+	} else if ((sink->fd = open(filename, O_WRONLY|O_CREAT|O_LARGEFILE|O_TRUNC, 0644)) < 0) {
+		fprintf(stderr, "Failed to open output file %s\n", filename);
+		return -1;
+	}
+
+	tee->sink_count++;
+	return 0;
+}
+
+int gnutv_tee_add_udp(struct gnutv_tee *tee, struct addrinfo *addrs, const char *outif, int rtp)
+{
+	struct tee_sink *sink;
+
+	if ((sink = gnutv_tee_new_sink(tee, TEE_UDP)) == NULL)
+		return -1;
+	sink->addrs = addrs;
+	tee->sink_count++;
+
+	if ((sink->fd = socket(addrs->ai_family, addrs->ai_socktype, addrs->ai_protocol)) < 0) {
+		fprintf(stderr, "Failed to open output socket\n");
+		return -1;
+	}
+	if ((outif != NULL) &&
+	    (setsockopt(sink->fd, SOL_SOCKET, SO_BINDTODEVICE, outif, strlen(outif)) < 0)) {
+		fprintf(stderr, "Failed to bind to interface %s\n", outif);
+		return -1;
+	}
+	if ((sink->udp = gnutv_data_udp_new(sink->fd, addrs, rtp)) == NULL) {
+		fprintf(stderr, "Out of memory for udp output\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int gnutv_tee_add_http(struct gnutv_tee *tee, struct gnutv_http *http)
+{
+	struct tee_sink *sink;
+
+	if ((sink = gnutv_tee_new_sink(tee, TEE_HTTP)) == NULL)
+		return -1;
+	sink->http = http;
+	tee->sink_count++;
+	return 0;
+}
+
+int gnutv_tee_count(struct gnutv_tee *tee)
+{
+	return tee->sink_count;
+}
+
+/**
+ * Write out len bytes of the stream at data.
+ *
+ * @return 0 on success, -1 if the sink has failed.
+ */
+static int gnutv_tee_file_put(struct tee_sink *sink, uint8_t *data, int len)
+{
+	int direct = 0;
+
+	return gnutv_data_write(sink->fd, data, len, &direct);
+}
+
+/**
+ * Send what of len bytes at data makes whole datagrams, straight from the
+ * ring; a datagram split by the end of the ring goes through the bounce
+ * buffer. Send errors (e.g. no route yet) lose the datagrams, but the sink
+ * carries on.
+ *
+ * @return Number of bytes used.
+ */
+static int gnutv_tee_udp_put(struct tee_sink *sink, uint8_t *data, int len, int flush)
+{
+	int size;
+
+	if (sink->bounce_fill || (len < TEE_UDP_CHUNK)) {
+		size = TEE_UDP_CHUNK - sink->bounce_fill;
+		if (size > len)
+			size = len;
+		memcpy(sink->bounce + sink->bounce_fill, data, size);
+		sink->bounce_fill += size;
+		if ((sink->bounce_fill == TEE_UDP_CHUNK) || flush) {
+			gnutv_data_udp_send(sink->udp, sink->bounce, sink->bounce_fill);
+			sink->bounce_fill = 0;
+		}
+		return size;
+	}
+
+	size = len - (len % TEE_UDP_CHUNK);
+	if (size > GNUTV_DATA_UDP_MAX_SEND)
+		size = GNUTV_DATA_UDP_MAX_SEND;
+	gnutv_data_udp_send(sink->udp, data, size);
+	return size;
+}
+
+/**
+ * Copy into the server's ring, handing the clients whole packets.
+ *
+ * @return Number of bytes used.
+ */
+static int gnutv_tee_http_put(struct tee_sink *sink, uint8_t *data, int len)
+{
+	size_t avail;
+	uint8_t *buf = gnutv_http_write_ptr(sink->http, &avail);
+	int pending = sink->bounce_fill;
+	int size = len;
+	int done;
+
+	// the partial packet of the last copy is already in place
+	if ((size_t) size > avail - pending)
+		size = avail - pending;
+	memcpy(buf + pending, data, size);
+	pending += size;
+	done = pending - (pending % TRANSPORT_PACKET_LENGTH);
+	if (done) {
+		gnutv_http_write_commit(sink->http, done);
+		pending -= done;
+	}
+	sink->bounce_fill = pending;
+	return size;
+}
+
+static void *gnutv_tee_sink_func(void *arg)
+{
+	struct tee_sink *sink = arg;
+	struct gnutv_ring *ring = sink->tee->ring;
+	uint8_t *data;
+	int len;
+	int used;
+
+	while((len = gnutv_ring_peek(ring, sink->consumer, &data, TEE_WAIT)) >= 0) {
+		if (len == 0)
+			continue;
+
+		switch(sink->type) {
+		case TEE_FILE:
+			// once failed, the data is let go so the others carry on
+			if (!sink->failed && gnutv_tee_file_put(sink, data, len)) {
+				fprintf(stderr, "Tee file output failed, dropping it\n");
+				sink->failed = 1;
+			}
+			used = len;
+			break;
+
+		case TEE_UDP:
+			sink->skipped += gnutv_ring_skip(ring, sink->consumer, sink->tee->lag);
+			if ((len = gnutv_ring_peek(ring, sink->consumer, &data, 0)) <= 0)
+				continue;
+			used = gnutv_tee_udp_put(sink, data, len, 0);
+			break;
+
+		case TEE_HTTP:
+			sink->skipped += gnutv_ring_skip(ring, sink->consumer, sink->tee->lag);
+			if ((len = gnutv_ring_peek(ring, sink->consumer, &data, 0)) <= 0)
+				continue;
+			used = gnutv_tee_http_put(sink, data, len);
+			break;
+
+		default:
+			used = len;
+			break;
+		}
+
+		gnutv_ring_consume(ring, sink->consumer, used);
+		sink->bytes += used;
+	}
+
+	// the last datagram may be short
+	if ((sink->type == TEE_UDP) && sink->bounce_fill)
+		gnutv_tee_udp_put(sink, NULL, 0, 1);
+
+	return NULL;
+}
+
+int gnutv_tee_start(struct gnutv_tee *tee, struct gnutv_ring *ring)
+{
+	struct gnutv_ring_stats stats;
+	int i;
+
+	tee->ring = ring;
+	gnutv_ring_get_stats(ring, &stats);
+	tee->lag = stats.size / 2;
+
+	for(i=0; i < tee->sink_count; i++) {
+		if (gnutv_affinity_thread_create(&tee->sinks[i].thread, GNUTV_THREAD_NORMAL,
+						 gnutv_tee_sink_func, &tee->sinks[i])) {
+			fprintf(stderr, "Failed to start tee output thread\n");
+			return -1;
+		}
+		tee->sinks[i].started = 1;
+	}
+
+	return 0;
+}
+
+void gnutv_tee_stop(struct gnutv_tee *tee)
+{
+	int i;
+
+	for(i=0; i < tee->sink_count; i++) {
+		if (tee->sinks[i].started)
+			pthread_join(tee->sinks[i].thread, NULL);
+		tee->sinks[i].started = 0;
+	}
+}
+
+void gnutv_tee_destroy(struct gnutv_tee *tee)
+{
+	struct tee_sink *sink;
+	int i;
+
+	for(i=0; i < tee->sink_count; i++) {
+		sink = &tee->sinks[i];
+
+		fprintf(stderr, "Tee %s output %i: %llu bytes, %llu skipped%s\n",
+			tee_names[sink->type], i, (unsigned long long) sink->bytes,
+			(unsigned long long) sink->skipped, sink->failed ? ", failed" : "");
+		if ((sink->fd != -1) && (sink->fd != STDOUT_FILENO))
+			close(sink->fd);
+		if (sink->addrs)
+			freeaddrinfo(sink->addrs);
+		free(sink->udp);
+		if (sink->http)
+			gnutv_http_stop(sink->http);
+	}
+	free(tee);
+}
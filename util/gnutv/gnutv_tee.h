@@ -0,0 +1,99 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_TEE_H
+#define gnutv_TEE_H 1
+
+#include <netdb.h>
+
+/**
+ * Several outputs of one DVR stream (-tee). The DVR is drained into the
+ * ring, and each sink is a consumer of it with a thread of its own, which
+ * writes (or sends) straight out of the ring; so a sink costs its own
+ * writes, and the stream is only read once.
+ *
+ * Each sink has its own backpressure. A file sink may not lose anything,
+ * so while it stalls it holds the ring back (which then fills, and drops
+ * with -ringdrop). A udp/rtp or http sink which gets more than half the
+ * ring behind skips ahead to the newest data instead, so it never holds
+ * up the others.
+ */
+struct gnutv_tee;
+struct gnutv_ring;
+struct gnutv_http;
+
+#define GNUTV_TEE_MAX_SINKS 8
+
+// the ring used if -ring does not give one
+#define GNUTV_TEE_RING_SIZE (16*1024*1024)
+
+extern struct gnutv_tee *gnutv_tee_create(void);
+
+/**
+ * Add a file sink.
+ *
+ * @param filename The file, created or truncated; NULL for stdout.
+ * @return 0 on success, -1 on failure (which has been reported).
+ */
+extern int gnutv_tee_add_file(struct gnutv_tee *tee, const char *filename);
+
+/**
+ * Add a udp/rtp sink, sent as by gnutv_data_udp_send().
+ *
+ * @param addrs The destination, freed by gnutv_tee_destroy().
+ * @param outif Interface to send from, or NULL.
+ * @return 0 on success, -1 on failure (which has been reported).
+ */
+extern int gnutv_tee_add_udp(struct gnutv_tee *tee, struct addrinfo *addrs, const char *outif,
+			     int rtp);
+
+/**
+ * Add an HTTP sink: a server (see gnutv_http.h), which gnutv_tee_destroy()
+ * stops.
+ *
+ * @return 0 on success, -1 if there are too many sinks.
+ */
+extern int gnutv_tee_add_http(struct gnutv_tee *tee, struct gnutv_http *http);
+
+/**
+ * @return The number of sinks, each of which needs a consumer of the ring.
+ */
+extern int gnutv_tee_count(struct gnutv_tee *tee);
+
+/**
+ * Start a thread per sink, sink i reading the ring as consumer i.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+extern int gnutv_tee_start(struct gnutv_tee *tee, struct gnutv_ring *ring);
+
+/**
+ * Wait for the sinks to finish with what is in the ring; once it has been
+ * closed (see gnutv_ring_close()).
+ */
+extern void gnutv_tee_stop(struct gnutv_tee *tee);
+
+/**
+ * Close the sinks, printing what each of them did.
+ */
+extern void gnutv_tee_destroy(struct gnutv_tee *tee);
+
+#endif
@@ -0,0 +1,463 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE 1
+#define _FILE_OFFSET_BITS 64
+#define _LARGEFILE_SOURCE 1
+#define _LARGEFILE64_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <libucsi/mpeg/pmt_section.h>
+#include <libucsi/mpeg/types.h>
+#include <libucsi/transport_packet.h>
+#include <libucsi/startcode.h>
+#include "gnutv_timeshift.h"
+
+// the data file is a whole number of packets and pages
+#define TIMESHIFT_UNIT (TRANSPORT_PACKET_LENGTH * 4096)
+
+// one index entry per this many bytes of data is plenty at any bitrate
+#define TIMESHIFT_BYTES_PER_ENTRY (TRANSPORT_PACKET_LENGTH * 32)
+#define TIMESHIFT_MIN_ENTRIES 4096
+
+// the PCR counts at 27MHz and wraps at 2^33 * 300
+#define PCR_WRAP (300ULL << 33)
+#define PCR_MAX_GAP GNUTV_TIMESHIFT_HZ
+
+#define PES_HDR_SIZE 9
+
+struct gnutv_timeshift {
+	int fd;
+	struct gnutv_timeshift_header *hdr;
+	size_t hdr_size;
+
+	// stream clock: time at the last PCR, and the rate since
+	int pcr_pid;			// -1 => the first PID seen with a PCR
+	int64_t last_pcr;		// -1 => none yet
+	uint64_t last_pcr_offset;
+	uint64_t time;
+	double ticks_per_byte;		// 0 until two PCRs have been seen
+	int discontinuity;
+	uint64_t last_entry_time;
+	uint64_t last_entry_offset;
+	int have_entry;
+
+	// the video PES whose first picture hasn't been found yet
+	struct startcode_scanner pes_scan;
+	int pes_scanning;
+	int pes_flags;
+	uint64_t pes_offset;
+	uint64_t pes_time;
+	uint64_t pes_pts;
+
+	// (stream_type << 16) | pid of the video stream, -1 if none; written
+	// by gnutv_timeshift_set_pmt(), possibly from another thread
+	volatile int video;
+	volatile int pmt_pcr_pid;
+
+	uint8_t partial[TRANSPORT_PACKET_LENGTH];
+	int partial_len;
+};
+
+struct gnutv_timeshift *gnutv_timeshift_open(const char *filename, int size_mb)
+{
+	struct gnutv_timeshift *ts;
+	char idxname[PATH_MAX];
+	uint64_t data_size;
+	uint32_t entries;
+	int idxfd;
+	int err;
+
+	data_size = ((uint64_t) size_mb * 1024 * 1024) / TIMESHIFT_UNIT * TIMESHIFT_UNIT;
+	if (data_size == 0)
+		data_size = TIMESHIFT_UNIT;
+	for(entries = TIMESHIFT_MIN_ENTRIES; entries < data_size / TIMESHIFT_BYTES_PER_ENTRY; entries <<= 1);
+
+	if ((ts = calloc(1, sizeof(struct gnutv_timeshift))) == NULL) {
+		fprintf(stderr, "Out of memory for time-shift recording\n");
+		return NULL;
+	}
+	ts->pcr_pid = -1;
+	ts->last_pcr = -1;
+	ts->video = -1;
+	ts->pmt_pcr_pid = -1;
+
+	// all the disk space is claimed up front, so it can't run out later
+	ts->fd = open(filename, O_RDWR|O_CREAT|O_LARGEFILE|O_TRUNC, 0644);
+	if (ts->fd < 0) {
+		fprintf(stderr, "Failed to open time-shift file %s: %m\n", filename);
+		free(ts);
+		return NULL;
+	}
+	if ((err = posix_fallocate(ts->fd, 0, data_size)) != 0) {
+		fprintf(stderr, "Failed to allocate %llu bytes for time-shift file: %s\n",
+			(unsigned long long) data_size, strerror(err));
+		goto fail_data;
+	}
+
+	snprintf(idxname, sizeof(idxname), "%s.idx", filename);
+	ts->hdr_size = sizeof(struct gnutv_timeshift_header) +
+		(entries * sizeof(struct gnutv_timeshift_entry));
+	idxfd = open(idxname, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if (idxfd < 0) {
+		fprintf(stderr, "Failed to open time-shift index %s: %m\n", idxname);
+		goto fail_data;
+	}
+	if ((err = posix_fallocate(idxfd, 0, ts->hdr_size)) != 0) {
+		fprintf(stderr, "Failed to allocate time-shift index: %s\n", strerror(err));
+		close(idxfd);
+		goto fail_data;
+	}
+	ts->hdr = mmap(NULL, ts->hdr_size, PROT_READ|PROT_WRITE, MAP_SHARED, idxfd, 0);
+	close(idxfd);
+	if (ts->hdr == MAP_FAILED) {
+		fprintf(stderr, "Failed to map time-shift index: %m\n");
+		goto fail_data;
+	}
+
+	ts->hdr->version = GNUTV_TIMESHIFT_VERSION;
+	ts->hdr->index_size = entries;
+	ts->hdr->data_size = data_size;
+	__sync_synchronize();
+	ts->hdr->magic = GNUTV_TIMESHIFT_MAGIC;
+
+	return ts;
+
+fail_data:
+	close(ts->fd);
+	free(ts);
+	return NULL;
+}
+
+void gnutv_timeshift_set_pmt(struct gnutv_timeshift *ts, struct mpeg_pmt_section *pmt)
+{
+	struct mpeg_pmt_stream *cur_stream;
+	int video = -1;
+
+	mpeg_pmt_section_streams_for_each(pmt, cur_stream) {
+		switch(cur_stream->stream_type) {
+		case MPEG_STREAM_TYPE_ISO11172_VIDEO:
+		case MPEG_STREAM_TYPE_ISO13818_2_VIDEO:
+		case MPEG_STREAM_TYPE_ISO14496_10_VIDEO:
+		case MPEG_STREAM_TYPE_ISO23008_2_VIDEO:
+			if (video == -1)
+				video = (cur_stream->stream_type << 16) | cur_stream->pid;
+			break;
+		}
+	}
+
+	ts->pmt_pcr_pid = pmt->pcr_pid;
+	ts->video = video;
+}
+
+static void gnutv_timeshift_add_entry(struct gnutv_timeshift *ts, uint64_t offset,
+				      uint64_t time, uint64_t pts, uint32_t flags)
+{
+	struct gnutv_timeshift_header *hdr = ts->hdr;
+	struct gnutv_timeshift_entry *entry;
+	uint64_t pos = hdr->index_head;
+
+	if (ts->discontinuity) {
+		flags |= GNUTV_TIMESHIFT_DISCONTINUITY;
+		ts->discontinuity = 0;
+	}
+
+	entry = &hdr->entries[pos & (hdr->index_size - 1)];
+	entry->seq = 0;
+	__sync_synchronize();
+	entry->offset = offset;
+	entry->time = time;
+	entry->pts = pts;
+	entry->flags = flags;
+	entry->reserved = 0;
+	__sync_synchronize();
+	entry->seq = pos + 1;
+	__sync_synchronize();
+	hdr->index_head = pos + 1;
+
+	ts->last_entry_time = time;
+	ts->last_entry_offset = offset;
+	ts->have_entry = 1;
+}
+
+/**
+ * Stream time of an offset after the last PCR.
+ */
+static uint64_t gnutv_timeshift_time(struct gnutv_timeshift *ts, uint64_t offset)
+{
+	return ts->time + (uint64_t) ((offset - ts->last_pcr_offset) * ts->ticks_per_byte);
+}
+
+static void gnutv_timeshift_pcr(struct gnutv_timeshift *ts, uint64_t pcr, uint64_t offset)
+{
+	uint64_t delta;
+
+	if (ts->last_pcr == -1) {
+		ts->time = 0;
+	} else {
+		delta = (pcr + PCR_WRAP - ts->last_pcr) % PCR_WRAP;
+		if ((delta > 0) && (delta < PCR_MAX_GAP) && (offset > ts->last_pcr_offset)) {
+			double rate = (double) delta / (double) (offset - ts->last_pcr_offset);
+
+			if (ts->ticks_per_byte == 0)
+				ts->ticks_per_byte = rate;
+			else
+				ts->ticks_per_byte += (rate - ts->ticks_per_byte) / 8;
+			ts->time += delta;
+		} else {
+			// carry on from where the old clock had got to
+			ts->time = gnutv_timeshift_time(ts, offset);
+			ts->discontinuity = 1;
+		}
+	}
+	ts->last_pcr = pcr;
+	ts->last_pcr_offset = offset;
+
+	if (!ts->have_entry || ts->discontinuity ||
+	    (ts->time >= ts->last_entry_time + GNUTV_TIMESHIFT_INTERVAL))
+		gnutv_timeshift_add_entry(ts, offset, ts->time, 0, 0);
+}
+
+/**
+ * Find the elementary stream in a packet starting a video PES.
+ *
+ * @return The GNUTV_TIMESHIFT_PTS flag if *pts was set, 0 if not, or -1 if it
+ * doesn't start a video PES.
+ */
+static int gnutv_timeshift_pes(uint8_t *pkt, struct transport_values *values,
+			       uint8_t **es, int *es_len, uint64_t *pts)
+{
+	uint8_t *pes;
+	int len;
+	int hdrlen;
+
+	if (transport_packet_values_extract((struct transport_packet *) pkt, values, 0) < 0)
+		return -1;
+	if ((values->payload == NULL) || (values->payload_length < PES_HDR_SIZE))
+		return -1;
+
+	// packet_start_code_prefix, and the optional header of a video PES
+	pes = values->payload;
+	len = values->payload_length;
+	if ((pes[0] != 0x00) || (pes[1] != 0x00) || (pes[2] != 0x01) || ((pes[6] & 0xc0) != 0x80))
+		return -1;
+	hdrlen = PES_HDR_SIZE + pes[8];
+	if (hdrlen >= len)
+		return -1;
+	*es = pes + hdrlen;
+	*es_len = len - hdrlen;
+
+	if ((pes[7] & 0x80) && (hdrlen >= PES_HDR_SIZE + 5)) {
+		*pts = (((uint64_t) (pes[9] >> 1) & 7) << 30) |
+			((uint64_t) pes[10] << 22) | (((uint64_t) pes[11] >> 1) << 15) |
+			((uint64_t) pes[12] << 7) | ((uint64_t) pes[13] >> 1);
+		return GNUTV_TIMESHIFT_PTS;
+	}
+
+	return 0;
+}
+
+int gnutv_timeshift_keyframe(int stream_type, uint8_t *pkt, uint64_t *pts)
+{
+	struct transport_values values;
+	struct startcode_scanner sc;
+	uint8_t *es;
+	int len;
+	int flags;
+
+	if ((flags = gnutv_timeshift_pes(pkt, &values, &es, &len, pts)) == -1)
+		return -1;
+
+	// a sequence header or SPS is as good as the I picture it is followed by
+	startcode_scanner_init(&sc, startcode_codec(stream_type));
+	if ((values.flags & transport_adaptation_flag_random_access) ||
+	    (startcode_scan(&sc, es, len) & (STARTCODE_KEYFRAME|STARTCODE_PARAMS)))
+		flags |= GNUTV_TIMESHIFT_KEYFRAME;
+
+	return flags;
+}
+
+/**
+ * Look into the video PES: a keyframe is indexed at its first packet, once
+ * the packets after are known to hold one.
+ */
+static void gnutv_timeshift_video(struct gnutv_timeshift *ts, int stream_type, uint8_t *pkt,
+				  uint64_t offset)
+{
+	struct transport_values values;
+	uint8_t *es;
+	int len;
+	int found;
+
+	if (pkt[1] & 0x40) {
+		ts->pes_scanning = 0;
+		if ((ts->pes_flags = gnutv_timeshift_pes(pkt, &values, &es, &len, &ts->pes_pts)) == -1)
+			return;
+
+		// keyframes before the first PCR can't be given a time
+		if (ts->last_pcr == -1)
+			return;
+		ts->pes_offset = offset;
+		ts->pes_time = gnutv_timeshift_time(ts, offset);
+		if (values.flags & transport_adaptation_flag_random_access) {
+			gnutv_timeshift_add_entry(ts, offset, ts->pes_time, ts->pes_pts,
+						  ts->pes_flags | GNUTV_TIMESHIFT_KEYFRAME);
+			return;
+		}
+		startcode_scanner_init(&ts->pes_scan, startcode_codec(stream_type));
+		ts->pes_scanning = 1;
+	} else {
+		if (!ts->pes_scanning)
+			return;
+		if ((transport_packet_values_extract((struct transport_packet *) pkt, &values, 0) < 0) ||
+		    (values.payload == NULL))
+			return;
+		es = values.payload;
+		len = values.payload_length;
+	}
+
+	found = startcode_scan(&ts->pes_scan, es, len);
+	if (!(found & (STARTCODE_PICTURE|STARTCODE_PARAMS)))
+		return;
+	ts->pes_scanning = 0;
+
+	// a PCR entry may have gone in after the start of the PES meanwhile
+	if ((found & (STARTCODE_KEYFRAME|STARTCODE_PARAMS)) && (ts->pes_offset >= ts->last_entry_offset))
+		gnutv_timeshift_add_entry(ts, ts->pes_offset, ts->pes_time, ts->pes_pts,
+					  ts->pes_flags | GNUTV_TIMESHIFT_KEYFRAME);
+}
+
+static void gnutv_timeshift_packet(struct gnutv_timeshift *ts, uint8_t *pkt, uint64_t offset,
+				   int video)
+{
+	struct transport_values values;
+	int pid;
+
+	if (pkt[0] != TRANSPORT_PACKET_SYNC)
+		return;
+	pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+
+	// cheap checks first: adaptation field with the PCR flag
+	if ((pkt[3] & 0x20) && pkt[4] && (pkt[5] & transport_adaptation_flag_pcr)) {
+		if (ts->pcr_pid == -1)
+			ts->pcr_pid = pid;
+		if ((pid == ts->pcr_pid) &&
+		    (transport_packet_values_extract((struct transport_packet *) pkt, &values,
+						     transport_value_pcr) & transport_value_pcr))
+			gnutv_timeshift_pcr(ts, values.pcr, offset);
+	}
+
+	if ((video != -1) && (pid == (video & 0x1fff)) && !(pkt[3] & 0xc0))
+		gnutv_timeshift_video(ts, video >> 16, pkt, offset);
+}
+
+/**
+ * Index the packets of a chunk of data starting at offset.
+ */
+static void gnutv_timeshift_index(struct gnutv_timeshift *ts, uint8_t *buf, int len,
+				  uint64_t offset)
+{
+	int video = ts->video;
+	int copy;
+
+	// follow the PMT's PCR PID once there is one
+	if ((ts->pmt_pcr_pid != -1) && (ts->pmt_pcr_pid != ts->pcr_pid)) {
+		ts->pcr_pid = ts->pmt_pcr_pid;
+		ts->last_pcr = -1;
+		ts->discontinuity = 1;
+	}
+
+	if (ts->partial_len) {
+		copy = TRANSPORT_PACKET_LENGTH - ts->partial_len;
+		if (copy > len)
+			copy = len;
+		memcpy(ts->partial + ts->partial_len, buf, copy);
+		ts->partial_len += copy;
+		buf += copy;
+		len -= copy;
+		offset += copy;
+
+		if (ts->partial_len < TRANSPORT_PACKET_LENGTH)
+			return;
+		ts->partial_len = 0;
+		gnutv_timeshift_packet(ts, ts->partial, offset - TRANSPORT_PACKET_LENGTH, video);
+	}
+
+	while(len >= TRANSPORT_PACKET_LENGTH) {
+		gnutv_timeshift_packet(ts, buf, offset, video);
+		buf += TRANSPORT_PACKET_LENGTH;
+		len -= TRANSPORT_PACKET_LENGTH;
+		offset += TRANSPORT_PACKET_LENGTH;
+	}
+
+	memcpy(ts->partial, buf, len);
+	ts->partial_len = len;
+}
+
+int gnutv_timeshift_write(struct gnutv_timeshift *ts, uint8_t *buf, int len)
+{
+	struct gnutv_timeshift_header *hdr = ts->hdr;
+	uint64_t offset = hdr->data_head;
+	int done = 0;
+
+	// players must not trust what is about to be overwritten
+	hdr->write_head = offset + len;
+	__sync_synchronize();
+
+	while(done < len) {
+		uint64_t pos = (offset + done) % hdr->data_size;
+		size_t size = len - done;
+		ssize_t tmp;
+
+		if (size > hdr->data_size - pos)
+			size = hdr->data_size - pos;
+		tmp = pwrite(ts->fd, buf + done, size, pos);
+		if (tmp == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Write error: %m\n");
+			return -1;
+		}
+		done += tmp;
+	}
+
+	__sync_synchronize();
+	hdr->data_head = offset + len;
+
+	// the index never points at data which hasn't been written yet
+	gnutv_timeshift_index(ts, buf, len, offset);
+	return 0;
+}
+
+void gnutv_timeshift_close(struct gnutv_timeshift *ts)
+{
+	msync(ts->hdr, ts->hdr_size, MS_SYNC);
+	munmap(ts->hdr, ts->hdr_size);
+	close(ts->fd);
+	free(ts);
+}
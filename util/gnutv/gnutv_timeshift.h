@@ -0,0 +1,222 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_TIMESHIFT_H
+#define gnutv_TIMESHIFT_H 1
+
+#include <stdint.h>
+
+/**
+ * A time-shift recording is a preallocated data file used as a ring, and an
+ * index file "<data file>.idx" beside it. The stream is written at
+ * (offset % data_size), where offset counts every byte since the recording
+ * started, so old data is overwritten once the ring is full and the disk
+ * used stays bounded.
+ *
+ * The index is a ring of entries mapping stream time to offset, one at
+ * least every GNUTV_TIMESHIFT_INTERVAL of stream time, plus one for each
+ * video keyframe. Entries are in order of both offset and time, so they may
+ * be binary searched. The index file is mmap()ed by the recorder, and
+ * players may map it read only while recording is in progress:
+ *
+ *	- entry p (index_head - index_size <= p < index_head) is at
+ *	  entries[p & (index_size - 1)]; its seq equals p + 1 before and after
+ *	  copying it (with read barriers in between), or it was overwritten.
+ *	- data at offset o is valid if o >= write_head - data_size after it has
+ *	  been copied (again, after a read barrier); the recorder moves
+ *	  write_head on before overwriting data, and data_head after.
+ *
+ * Times are in 27MHz ticks since the first PCR of the recording, and keep
+ * counting across PCR wraps and discontinuities. All fields are in host
+ * byte order.
+ */
+#define GNUTV_TIMESHIFT_MAGIC		0x54534958	/* "TSIX" */
+#define GNUTV_TIMESHIFT_VERSION		1
+#define GNUTV_TIMESHIFT_HZ		27000000ULL
+#define GNUTV_TIMESHIFT_INTERVAL	(GNUTV_TIMESHIFT_HZ / 10)
+
+/* gnutv_timeshift_entry.flags */
+#define GNUTV_TIMESHIFT_KEYFRAME	0x01	/* a video PES starting with a keyframe */
+#define GNUTV_TIMESHIFT_PTS		0x02	/* pts is valid */
+#define GNUTV_TIMESHIFT_DISCONTINUITY	0x04	/* the PCR jumped just before this */
+
+struct gnutv_timeshift_entry {
+	volatile uint64_t seq;		/* position + 1, 0 while being written */
+	uint64_t offset;		/* of the first byte of the packet */
+	uint64_t time;
+	uint64_t pts;			/* of a keyframe, 90kHz */
+	uint32_t flags;			/* GNUTV_TIMESHIFT_* */
+	uint32_t reserved;
+};
+
+struct gnutv_timeshift_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t index_size;		/* entries; a power of 2 */
+	uint32_t reserved;
+	uint64_t data_size;		/* of the data file; a whole number of packets */
+	volatile uint64_t data_head;	/* bytes completely written */
+	volatile uint64_t write_head;	/* bytes being written */
+	volatile uint64_t index_head;	/* entries written */
+	struct gnutv_timeshift_entry entries[0];
+};
+
+/**
+ * Copy an entry out of a live index.
+ *
+ * @param hdr The mapped index.
+ * @param pos Position of the entry.
+ * @param entry Where to copy it.
+ * @return 0 on success, -1 if it has been overwritten.
+ */
+static inline int gnutv_timeshift_entry_get(struct gnutv_timeshift_header *hdr, uint64_t pos,
+					    struct gnutv_timeshift_entry *entry)
+{
+	struct gnutv_timeshift_entry *cur = &hdr->entries[pos & (hdr->index_size - 1)];
+
+	if (cur->seq != pos + 1)
+		return -1;
+	__sync_synchronize();
+	*entry = *cur;
+	__sync_synchronize();
+	if (cur->seq != pos + 1)
+		return -1;
+
+	return 0;
+}
+
+/**
+ * Find the last entry at or before a stream time, in O(log n). Entries whose
+ * data has been overwritten are skipped.
+ *
+ * @param hdr The mapped index.
+ * @param time The stream time wanted; times before the oldest entry find the
+ * oldest (keyframe).
+ * @param keyframe If 1, only keyframe entries are wanted.
+ * @param entry Where to put the entry found.
+ * @return 0 on success, -1 if there is nothing suitable.
+ */
+static inline int gnutv_timeshift_find(struct gnutv_timeshift_header *hdr, uint64_t time,
+				       int keyframe, struct gnutv_timeshift_entry *entry)
+{
+	struct gnutv_timeshift_entry cur;
+	uint64_t head = hdr->index_head;
+	uint64_t lo, hi, mid, first;
+	uint64_t min_offset;
+
+	__sync_synchronize();
+	min_offset = (hdr->write_head > hdr->data_size) ? hdr->write_head - hdr->data_size : 0;
+	lo = (head > hdr->index_size) ? head - hdr->index_size : 0;
+	hi = head;
+
+	// the first entry which is not overwritten, in either file
+	while(lo < hi) {
+		mid = lo + ((hi - lo) / 2);
+		if (gnutv_timeshift_entry_get(hdr, mid, &cur) || (cur.offset < min_offset))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == head)
+		return -1;
+
+	// the last entry at or before time
+	hi = head;
+	while((hi - lo) > 1) {
+		mid = lo + ((hi - lo) / 2);
+		if (gnutv_timeshift_entry_get(hdr, mid, &cur))
+			return -1;
+		if (cur.time <= time)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	// keyframes are no more than a GOP apart, so this is a short walk; back
+	// to the one before, or on to the oldest one there is
+	first = lo;
+	for(mid = lo;; mid--) {
+		if (gnutv_timeshift_entry_get(hdr, mid, &cur) || (cur.offset < min_offset))
+			break;
+		if (!keyframe || (cur.flags & GNUTV_TIMESHIFT_KEYFRAME)) {
+			*entry = cur;
+			return 0;
+		}
+		if (mid == 0)
+			break;
+	}
+	for(mid = first + 1; mid < head; mid++) {
+		if (gnutv_timeshift_entry_get(hdr, mid, &cur))
+			return -1;
+		if (cur.flags & GNUTV_TIMESHIFT_KEYFRAME) {
+			*entry = cur;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+struct gnutv_timeshift;
+struct mpeg_pmt_section;
+
+/**
+ * Create a time-shift recording, replacing any old one.
+ *
+ * @param filename Name of the data file.
+ * @param size_mb Size of the data file in megabytes; it is allocated up front.
+ * @return The recording, or NULL on failure.
+ */
+extern struct gnutv_timeshift *gnutv_timeshift_open(const char *filename, int size_mb);
+
+/**
+ * Tell the recorder about the program being recorded, so it can find the
+ * keyframes of its video stream. May be called from another thread than
+ * gnutv_timeshift_write().
+ */
+extern void gnutv_timeshift_set_pmt(struct gnutv_timeshift *ts, struct mpeg_pmt_section *pmt);
+
+/**
+ * Append data to the recording and index it.
+ *
+ * @return 0 on success, -1 on a write error.
+ */
+extern int gnutv_timeshift_write(struct gnutv_timeshift *ts, uint8_t *buf, int len);
+
+/**
+ * Finish a recording. The files are kept, and may still be played.
+ */
+extern void gnutv_timeshift_close(struct gnutv_timeshift *ts);
+
+/**
+ * Look at a packet of a video stream (also used by gnutv_segment.c and
+ * gnutv_rotate.c).
+ *
+ * @param stream_type The PMT's type of the stream.
+ * @param pkt The packet.
+ * @param pts Set to the PTS (90kHz) if the packet starts a PES which has one.
+ * @return -1 if the packet does not start a PES, otherwise
+ * GNUTV_TIMESHIFT_KEYFRAME if the PES starts with a keyframe, or'd with
+ * GNUTV_TIMESHIFT_PTS if *pts was set.
+ */
+extern int gnutv_timeshift_keyframe(int stream_type, uint8_t *pkt, uint64_t *pts);
+
+#endif
@@ -0,0 +1,464 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_xdp.h>
+#include "gnutv_xdp.h"
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+// UMEM frames per queue, each holding one datagram
+#define XDP_FRAMES 4096
+#define XDP_FRAME_SIZE 2048
+#define XDP_TX_SIZE 2048
+#define XDP_FILL_SIZE 64
+
+// how long a send waits for the NIC to make room before giving up
+#define XDP_STALL_MS 1000
+
+struct xdp_ring {
+	uint32_t *producer;
+	uint32_t *consumer;
+	uint32_t *flags;
+	void *desc;
+	uint32_t mask;
+	uint32_t cached_prod;
+	uint32_t cached_cons;
+	void *map;
+	size_t map_len;
+};
+
+struct xdp_queue {
+	pthread_mutex_t lock;
+	int fd;
+	int queue_id;
+	int need_wakeup;
+	uint8_t *umem;
+	struct xdp_ring tx;
+	struct xdp_ring cq;
+	uint64_t free_frames[XDP_FRAMES];
+	int free_count;
+};
+
+struct gnutv_xdp {
+	char ifname[IFNAMSIZ];
+	uint8_t mac[6];
+	struct in_addr addr;
+	int queue_count;
+	int next_queue;
+	struct xdp_queue queues[GNUTV_XDP_MAX_QUEUES];
+};
+
+static int gnutv_xdp_map_ring(int fd, struct xdp_ring *ring, struct xdp_ring_offset *off,
+			      size_t entry, uint32_t size, off_t pgoff)
+{
+	ring->map_len = off->desc + (size * entry);
+	ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			 fd, pgoff);
+	if (ring->map == MAP_FAILED) {
+		ring->map = NULL;
+		return -1;
+	}
+	ring->producer = (uint32_t *) ((uint8_t *) ring->map + off->producer);
+	ring->consumer = (uint32_t *) ((uint8_t *) ring->map + off->consumer);
+	ring->flags = (uint32_t *) ((uint8_t *) ring->map + off->flags);
+	ring->desc = (uint8_t *) ring->map + off->desc;
+	ring->mask = size - 1;
+	ring->cached_prod = *ring->producer;
+	ring->cached_cons = *ring->consumer;
+	return 0;
+}
+
+static void gnutv_xdp_queue_free(struct xdp_queue *q)
+{
+	if (q->tx.map)
+		munmap(q->tx.map, q->tx.map_len);
+	if (q->cq.map)
+		munmap(q->cq.map, q->cq.map_len);
+	if (q->fd >= 0)
+		close(q->fd);
+	q->tx.map = q->cq.map = NULL;
+	q->fd = -1;
+}
+
+/**
+ * Create a queue's socket, on the UMEM already allocated, and bind it with
+ * the given flags.
+ */
+static int gnutv_xdp_queue_bind(struct xdp_queue *q, int ifindex, int flags)
+{
+	struct xdp_umem_reg reg;
+	struct xdp_mmap_offsets off;
+	struct sockaddr_xdp sxdp;
+	socklen_t len = sizeof(off);
+	int tx = XDP_TX_SIZE;
+	int cq = XDP_FRAMES;
+	int fq = XDP_FILL_SIZE;
+
+	if ((q->fd = socket(AF_XDP, SOCK_RAW, 0)) < 0)
+		return -1;
+
+	memset(&reg, 0, sizeof(reg));
+	reg.addr = (uintptr_t) q->umem;
+	reg.len = (uint64_t) XDP_FRAMES * XDP_FRAME_SIZE;
+	reg.chunk_size = XDP_FRAME_SIZE;
+	reg.headroom = 0;
+
+	// a fill ring is required even though nothing is received
+	if (setsockopt(q->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) ||
+	    setsockopt(q->fd, SOL_XDP, XDP_UMEM_FILL_RING, &fq, sizeof(fq)) ||
+	    setsockopt(q->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &cq, sizeof(cq)) ||
+	    setsockopt(q->fd, SOL_XDP, XDP_TX_RING, &tx, sizeof(tx)) ||
+	    getsockopt(q->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &len) ||
+	    gnutv_xdp_map_ring(q->fd, &q->tx, &off.tx, sizeof(struct xdp_desc), XDP_TX_SIZE,
+			       XDP_PGOFF_TX_RING) ||
+	    gnutv_xdp_map_ring(q->fd, &q->cq, &off.cr, sizeof(uint64_t), XDP_FRAMES,
+			       XDP_UMEM_PGOFF_COMPLETION_RING))
+		goto fail;
+
+	memset(&sxdp, 0, sizeof(sxdp));
+	sxdp.sxdp_family = AF_XDP;
+	sxdp.sxdp_ifindex = ifindex;
+	sxdp.sxdp_queue_id = q->queue_id;
+	sxdp.sxdp_flags = flags;
+	if (bind(q->fd, (struct sockaddr *) &sxdp, sizeof(sxdp)))
+		goto fail;
+
+	q->need_wakeup = flags & XDP_USE_NEED_WAKEUP;
+	return 0;
+
+fail:
+	gnutv_xdp_queue_free(q);
+	return -1;
+}
+
+static int gnutv_xdp_queue_open(struct gnutv_xdp *xdp, struct xdp_queue *q, int ifindex)
+{
+	static const int modes[] = {
+		XDP_ZEROCOPY | XDP_USE_NEED_WAKEUP,
+		XDP_COPY | XDP_USE_NEED_WAKEUP,
+		XDP_COPY,
+	};
+	unsigned int i;
+
+	q->umem = mmap(NULL, (size_t) XDP_FRAMES * XDP_FRAME_SIZE, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if (q->umem == MAP_FAILED) {
+		q->umem = NULL;
+		return -1;
+	}
+	for(i=0; i < XDP_FRAMES; i++)
+		q->free_frames[i] = (uint64_t) i * XDP_FRAME_SIZE;
+	q->free_count = XDP_FRAMES;
+
+	for(i=0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		if (gnutv_xdp_queue_bind(q, ifindex, modes[i]) == 0) {
+			fprintf(stderr, "xdp: %s queue %i in %s mode\n", xdp->ifname, q->queue_id,
+				(modes[i] & XDP_ZEROCOPY) ? "zero copy" : "copy");
+			pthread_mutex_init(&q->lock, NULL);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+struct gnutv_xdp *gnutv_xdp_open(const char *ifname, int first_queue, int queue_count)
+{
+	struct gnutv_xdp *xdp;
+	struct ifreq ifr;
+	int ifindex;
+	int fd;
+	int i;
+
+	if ((queue_count < 1) || (queue_count > GNUTV_XDP_MAX_QUEUES) || (first_queue < 0) ||
+	    (strlen(ifname) >= IFNAMSIZ)) {
+		fprintf(stderr, "xdp: bad interface or queues\n");
+		return NULL;
+	}
+	if ((ifindex = if_nametoindex(ifname)) == 0) {
+		fprintf(stderr, "xdp: no interface %s\n", ifname);
+		return NULL;
+	}
+	if ((xdp = calloc(1, sizeof(struct gnutv_xdp))) == NULL)
+		return NULL;
+	strcpy(xdp->ifname, ifname);
+	for(i=0; i < GNUTV_XDP_MAX_QUEUES; i++)
+		xdp->queues[i].fd = -1;
+
+	// the addresses the frames come from
+	if ((fd = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+		goto fail;
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, ifname);
+	if (ioctl(fd, SIOCGIFHWADDR, &ifr)) {
+		fprintf(stderr, "xdp: no hardware address on %s: %m\n", ifname);
+		close(fd);
+		goto fail;
+	}
+	memcpy(xdp->mac, ifr.ifr_hwaddr.sa_data, 6);
+	memset(&ifr, 0, sizeof(ifr));
+	strcpy(ifr.ifr_name, ifname);
+	ifr.ifr_addr.sa_family = AF_INET;
+	if (ioctl(fd, SIOCGIFADDR, &ifr)) {
+		fprintf(stderr, "xdp: no IPv4 address on %s: %m\n", ifname);
+		close(fd);
+		goto fail;
+	}
+	xdp->addr = ((struct sockaddr_in *) &ifr.ifr_addr)->sin_addr;
+	close(fd);
+
+	for(i=0; i < queue_count; i++) {
+		xdp->queues[i].queue_id = first_queue + i;
+		if (gnutv_xdp_queue_open(xdp, &xdp->queues[i], ifindex)) {
+			fprintf(stderr, "xdp: could not open %s queue %i: %m\n", ifname,
+				first_queue + i);
+			goto fail;
+		}
+		xdp->queue_count++;
+	}
+	return xdp;
+
+fail:
+	gnutv_xdp_close(xdp);
+	return NULL;
+}
+
+void gnutv_xdp_close(struct gnutv_xdp *xdp)
+{
+	int i;
+
+	for(i=0; i < GNUTV_XDP_MAX_QUEUES; i++) {
+		struct xdp_queue *q = &xdp->queues[i];
+
+		gnutv_xdp_queue_free(q);
+		if (q->umem)
+			munmap(q->umem, (size_t) XDP_FRAMES * XDP_FRAME_SIZE);
+		if (i < xdp->queue_count)
+			pthread_mutex_destroy(&q->lock);
+	}
+	free(xdp);
+}
+
+int gnutv_xdp_flow_init(struct gnutv_xdp *xdp, struct gnutv_xdp_flow *flow, int fd,
+			struct sockaddr *dst, int max_len)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *) dst;
+	struct sockaddr_in src;
+	socklen_t len = sizeof(src);
+	uint8_t *h = flow->header;
+	uint32_t group;
+	int ttl = 1;
+	socklen_t ttllen = sizeof(ttl);
+
+	flow->queue = NULL;
+	if ((dst->sa_family != AF_INET) || !IN_MULTICAST(ntohl(sin->sin_addr.s_addr)) ||
+	    ((max_len + GNUTV_XDP_HEADER) > XDP_FRAME_SIZE))
+		return -1;
+
+	// the port the kernel would have sent from
+	if (getsockname(fd, (struct sockaddr *) &src, &len) || (src.sin_family != AF_INET))
+		return -1;
+	if (src.sin_port == 0) {
+		memset(&src, 0, sizeof(src));
+		src.sin_family = AF_INET;
+		len = sizeof(src);
+		if (bind(fd, (struct sockaddr *) &src, sizeof(src)) ||
+		    getsockname(fd, (struct sockaddr *) &src, &len))
+			return -1;
+	}
+	getsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, &ttllen);
+
+	// Ethernet: the group's MAC address
+	group = ntohl(sin->sin_addr.s_addr);
+	h[0] = 0x01;
+	h[1] = 0x00;
+	h[2] = 0x5e;
+	h[3] = (group >> 16) & 0x7f;
+	h[4] = group >> 8;
+	h[5] = group;
+	memcpy(h + 6, xdp->mac, 6);
+	h[12] = 0x08;
+	h[13] = 0x00;
+
+	// IPv4, with DF set and so an ID of 0 (RFC 6864)
+	memset(h + 14, 0, 20);
+	h[14] = 0x45;
+	h[20] = 0x40;
+	h[22] = ttl;
+	h[23] = IPPROTO_UDP;
+	memcpy(h + 26, &xdp->addr, 4);
+	memcpy(h + 30, &sin->sin_addr, 4);
+
+	// UDP
+	memcpy(h + 34, &src.sin_port, 2);
+	memcpy(h + 36, &sin->sin_port, 2);
+	h[38] = h[39] = 0;
+	h[40] = h[41] = 0;
+
+	flow->queue = &xdp->queues[__atomic_fetch_add(&xdp->next_queue, 1, __ATOMIC_RELAXED) %
+				   xdp->queue_count];
+	return 0;
+}
+
+static uint16_t gnutv_xdp_ip_checksum(const uint8_t *ip)
+{
+	uint32_t sum = 0;
+	int i;
+
+	for(i=0; i < 20; i += 2)
+		sum += (ip[i] << 8) | ip[i + 1];
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return ~sum;
+}
+
+// put the frames of descriptors the NIC is done with back on the free list
+static void gnutv_xdp_reap(struct xdp_queue *q)
+{
+	uint32_t prod = __atomic_load_n(q->cq.producer, __ATOMIC_ACQUIRE);
+	uint64_t *ring = q->cq.desc;
+
+	if (prod == q->cq.cached_cons)
+		return;
+	while (q->cq.cached_cons != prod)
+		q->free_frames[q->free_count++] = ring[q->cq.cached_cons++ & q->cq.mask];
+	__atomic_store_n(q->cq.consumer, q->cq.cached_cons, __ATOMIC_RELEASE);
+}
+
+static void gnutv_xdp_kick(struct xdp_queue *q)
+{
+	if (q->need_wakeup && !(__atomic_load_n(q->tx.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP))
+		return;
+	sendto(q->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+}
+
+static uint32_t gnutv_xdp_tx_room(struct xdp_queue *q)
+{
+	uint32_t room = XDP_TX_SIZE - (q->tx.cached_prod - q->tx.cached_cons);
+
+	if (room == 0) {
+		q->tx.cached_cons = __atomic_load_n(q->tx.consumer, __ATOMIC_ACQUIRE);
+		room = XDP_TX_SIZE - (q->tx.cached_prod - q->tx.cached_cons);
+	}
+	return room;
+}
+
+/**
+ * Wait for a frame and a TX descriptor to be free; what has been queued so
+ * far is handed over to make room.
+ */
+static int gnutv_xdp_wait(struct xdp_queue *q)
+{
+	struct pollfd pfd;
+	struct timespec start, now;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (1) {
+		gnutv_xdp_reap(q);
+		if (q->free_count && gnutv_xdp_tx_room(q))
+			return 0;
+
+		__atomic_store_n(q->tx.producer, q->tx.cached_prod, __ATOMIC_RELEASE);
+		sendto(q->fd, NULL, 0, MSG_DONTWAIT, NULL, 0);
+		pfd.fd = q->fd;
+		pfd.events = POLLOUT;
+		poll(&pfd, 1, 1);
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (((now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000) >
+		    XDP_STALL_MS) {
+			errno = ENOBUFS;
+			return -1;
+		}
+	}
+}
+
+int gnutv_xdp_sendmmsg(struct gnutv_xdp_flow *flow, struct mmsghdr *msgs, int count)
+{
+	struct xdp_queue *q = flow->queue;
+	struct xdp_desc *ring = q->tx.desc;
+	int result = 0;
+	int i, j;
+
+	pthread_mutex_lock(&q->lock);
+	gnutv_xdp_reap(q);
+
+	for(i=0; i < count; i++) {
+		struct msghdr *msg = &msgs[i].msg_hdr;
+		struct xdp_desc *desc;
+		uint8_t *frame;
+		uint16_t csum;
+		int len = 0;
+
+		if ((q->free_count == 0 || !gnutv_xdp_tx_room(q)) && gnutv_xdp_wait(q)) {
+			result = -1;
+			break;
+		}
+
+		frame = q->umem + q->free_frames[--q->free_count];
+		for(j=0; j < (int) msg->msg_iovlen; j++) {
+			if ((GNUTV_XDP_HEADER + len + msg->msg_iov[j].iov_len) > XDP_FRAME_SIZE)
+				break;
+			memcpy(frame + GNUTV_XDP_HEADER + len, msg->msg_iov[j].iov_base,
+			       msg->msg_iov[j].iov_len);
+			len += msg->msg_iov[j].iov_len;
+		}
+
+		memcpy(frame, flow->header, GNUTV_XDP_HEADER);
+		frame[16] = (20 + 8 + len) >> 8;
+		frame[17] = 20 + 8 + len;
+		csum = gnutv_xdp_ip_checksum(frame + 14);
+		frame[24] = csum >> 8;
+		frame[25] = csum;
+		frame[38] = (8 + len) >> 8;
+		frame[39] = 8 + len;
+
+		desc = &ring[q->tx.cached_prod++ & q->tx.mask];
+		desc->addr = frame - q->umem;
+		desc->len = GNUTV_XDP_HEADER + len;
+		desc->options = 0;
+	}
+
+	// the whole batch goes to the NIC at once
+	__atomic_store_n(q->tx.producer, q->tx.cached_prod, __ATOMIC_RELEASE);
+	gnutv_xdp_kick(q);
+	pthread_mutex_unlock(&q->lock);
+	return result;
+}
@@ -0,0 +1,94 @@
+/*
+	gnutv utility
+
+	Copyright (C) 2026 linuxtv.org dvb-apps contributors
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+*/
+
+#ifndef gnutv_XDP_H
+#define gnutv_XDP_H 1
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+/**
+ * AF_XDP output: datagrams to IPv4 multicast groups are framed here
+ * (Ethernet, IP and UDP headers in front of the RTP header and payload) in
+ * a UMEM the NIC reads from, and handed to it a batch of descriptors at a
+ * time, bypassing the kernel's UDP/IP stack and qdiscs.
+ *
+ * Each of the interface's queues used gets a TX-only socket and UMEM of its
+ * own. A flow (one destination) is pinned to one queue for its lifetime, so
+ * its datagrams stay in order; flows are spread round robin over the
+ * queues, and the queues are shared between the threads sending to them.
+ * Zero copy mode is used where the driver supports it, and copy mode
+ * otherwise; no XDP program is needed for transmitting.
+ *
+ * Only IPv4 multicast can be framed without a neighbour lookup, so other
+ * destinations are left to the kernel. The IP TTL is the multicast TTL of
+ * the flow's socket, the UDP source port the one it is bound to, and the
+ * UDP checksum is left out (0), as IPv4 allows.
+ */
+
+#define GNUTV_XDP_MAX_QUEUES 64
+
+// bytes of Ethernet, IPv4 and UDP header
+#define GNUTV_XDP_HEADER 42
+
+struct gnutv_xdp;
+struct xdp_queue;
+
+struct gnutv_xdp_flow {
+	struct xdp_queue *queue;		// NULL => not in use
+	uint8_t header[GNUTV_XDP_HEADER];	// lengths and IP checksum filled in per datagram
+};
+
+/**
+ * Open queues first_queue to first_queue + queue_count - 1 of an interface.
+ * Needs CAP_NET_RAW. Problems are reported.
+ *
+ * @return The output, or NULL on error.
+ */
+extern struct gnutv_xdp *gnutv_xdp_open(const char *ifname, int first_queue, int queue_count);
+
+extern void gnutv_xdp_close(struct gnutv_xdp *xdp);
+
+/**
+ * Set up a flow to a destination.
+ *
+ * @param xdp The output.
+ * @param flow The flow to set up.
+ * @param fd The UDP socket of the destination, for its TTL and source port
+ * (it is bound to one if not yet).
+ * @param dst The destination.
+ * @param max_len The longest datagram (UDP payload) to be sent.
+ * @return 0 on success, -1 if the destination isn't IPv4 multicast, or the
+ * datagrams would not fit a frame.
+ */
+extern int gnutv_xdp_flow_init(struct gnutv_xdp *xdp, struct gnutv_xdp_flow *flow, int fd,
+			       struct sockaddr *dst, int max_len);
+
+/**
+ * Send datagrams, as sendmmsg() would (msg_name is ignored), waiting for
+ * room in the queue if need be.
+ *
+ * @return 0 on success, or -1 with errno set if the NIC stopped taking them.
+ */
+struct mmsghdr;
+extern int gnutv_xdp_sendmmsg(struct gnutv_xdp_flow *flow, struct mmsghdr *msgs, int count);
+
+#endif
@@ -24,300 +24,132 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
-#include <sys/ioctl.h>
-#include <fcntl.h>
 #include <unistd.h>
-#include <sys/stat.h>
-#include <sys/param.h>
-#include <sys/types.h>
-#include <dirent.h>
 
-#include <linux/dvb/frontend.h>
-
-#define DVB_DIR			"/dev/dvb"
-#define DVB_DEV_DIR		"/dev/dvb"
-#define DVB_SYSFS_DIR		"/sys/class/dvb"
+#include <libdvbapi/dvbtopo.h>
 
 /**
- * DVB sysfs entries are found thus:
- * /sys/class/dvb/dvb0.frontend0/device/dvb/dvb0.frontend0/uevent for DVB_ADAPTER_NUM, DVB_DEVICE_NUM
- *
- * /sys/class/dvb/dvb0.frontend0/device/device for PCI_DEVICE_ID
- * /sys/class/dvb/dvb0.frontend0/device/vendor for PCI_VENDOR_ID
- * /sys/class/dvb/dvb0.frontend0/device/irq    for PCI_IRQ
+ * Adapters, their devices and frontend capabilities come from the libdvbapi
+ * topology registry, which caches what it found in sysfs and through
+ * FE_GET_INFO. Listing from the cache opens no devices at all; -r rescans,
+ * for use from a udev rule.
  */
 
-#define MAXLEN		64
-
-int get_frontend_entry(DIR *dvb_dir, char *frontend_dev)
+/* as enum fe_delivery_system */
+static const char *delsys_names[] = {
+	"UNDEFINED", "DVBC_ANNEX_A", "DVBC_ANNEX_B", "DVBT", "DSS", "DVBS", "DVBS2",
+	"DVBH", "ISDBT", "ISDBS", "ISDBC", "ATSC", "ATSCMH", "DTMB", "CMMB", "DAB",
+	"DVBT2", "TURBO", "DVBC_ANNEX_C",
+};
+
+static const char *fe_type[] = {
+	[DVBFE_TYPE_DVBS] = "FE_QPSK",
+	[DVBFE_TYPE_DVBC] = "FE_QAM",
+	[DVBFE_TYPE_DVBT] = "FE_OFDM",
+	[DVBFE_TYPE_ATSC] = "FE_ATSC",
+};
+
+static void usage(void)
 {
-	struct dirent *adap_dir;
-	char tmp[MAXLEN];
-
-	adap_dir = readdir(dvb_dir);
-	if (adap_dir != NULL) {
-		/**
-		 * Directory structure follows:
-		 * .
-		 * ..
-		 * ~dvb0.demux0
-		 * ~dvb0.dvr0
-		 * ~dvb0.frontend0
-		 * ~dvb0.net0
-		 * ~dvb1.demux0
-		 * ~dvb1.dvr0
-		 * ~dvb1.frontend0
-		 * ~dvb1.net0
-		 */
-
-		/* print information */
-		sprintf(tmp, "%s/%s", DVB_SYSFS_DIR, adap_dir->d_name);
-		/* search for a dir entry with string "frontend" */
-		if (strstr(tmp, "frontend")) {
-			/* found a dvbX.frontendY */
-			strcpy(frontend_dev, tmp);
-			return 0;
-		} else {
-			return -2;
-		}
-	} else {
-		return -1;
-	}
+	fprintf(stderr, "usage: lsdvb [-r] [-q]\n"
+		"  -r	rescan the adapters rather than using the cache\n"
+		"  -q	just update the cache, print nothing\n");
+	exit(1);
 }
 
-
-/* read device number and adapter number from the uevent file */
-int read_frontend_uevent(char *uevent, int *device, int *adapter)
+static void print_card(const struct dvbtopo_adapter *adapter)
 {
-	char uf_name[MAXLEN];
-	FILE *ufile;
-	char line[128];
-	char *token = NULL;
-
-	/* get uevent file */
-	sprintf(uf_name, "%s/%s", uevent, "uevent");
-	ufile = fopen(uf_name, "r");
-	if (ufile == NULL) {
-		fprintf(stderr, "File: %s open failed\n", uf_name);
-		return -1;
-	}
-
-	while (1) {
-		if (fgets(line, sizeof (line), ufile) == NULL)
-			return -1;
-
-		if (strstr(line, "DVB_ADAPTER_NUM")) {
-			token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			*adapter = atoi(token);
-		}
-
-		if (strstr(line, "DVB_DEVICE_NUM")) {
-			token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			*device = atoi(token);
-		}
-	}
-
-	fclose(ufile);
-	return 0;
+	const char *slot = strrchr(adapter->bus_path, '/');
+	unsigned int domain, bus, dev, fn;
+
+	fprintf(stderr, "\n%s (%04x:%04x %04x:%04x) ", adapter->driver[0] ? adapter->driver : "unknown",
+		adapter->vendor, adapter->device, adapter->subvendor, adapter->subdevice);
+	if (slot && (sscanf(slot + 1, "%x:%x:%x.%x", &domain, &bus, &dev, &fn) == 4))
+		fprintf(stderr, "on PCI Domain:%d Bus:%d Device:%d Function:%d",
+			domain, bus, dev, fn);
+	else if (adapter->bus_path[0])
+		fprintf(stderr, "on %s", adapter->bus_path);
+	if (adapter->numa_node >= 0)
+		fprintf(stderr, " NUMA node:%d", adapter->numa_node);
+	fprintf(stderr, "\n");
 }
 
-int read_device_uevent(char *uevent,
-		       char *drv,
-		       int *pci_ven,
-		       int *pci_dev,
-		       int *pci_subven,
-		       int *pci_subdev,
-		       int *domain,
-		       int *bus,
-		       int *device,
-		       int *fn)
+static void print_adapter(const struct dvbtopo_adapter *adapter)
 {
-	char uf_name[MAXLEN];
-	FILE *ufile;
-	char line[128];
-	char *token = NULL;
-	char *tmp;
-	unsigned int i;
-
-	/* get uevent file */
-	sprintf(uf_name, "%s/%s", uevent, "device/uevent");
-	ufile = fopen(uf_name, "r");
-	if (ufile == NULL) {
-		fprintf(stderr, "File: %s open failed\n", uf_name);
-		return -1;
-	}
-
-	while (1) {
-		if (fgets(line, sizeof (line), ufile) == NULL)
-			return -1;
-
-		if (strstr(line, "DRIVER")) {
-			token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			for (i = 0; i < strlen(token); i++) {
-				if (token[i] == '\n' || token[i] == '\r')
-					token[i] = '\0';
+	int i, j;
+
+	fprintf(stderr, "\tADAPTER:%d demux:%d dvr:%d ca:%d net:%d\n", adapter->id,
+		adapter->demux_count, adapter->dvr_count, adapter->ca_count, adapter->net_count);
+
+	for (i = 0; i < adapter->frontend_count; i++) {
+		const struct dvbtopo_frontend *fe = &adapter->frontends[i];
+
+		fprintf(stderr, "\t\tFRONTEND:%d (%s) \n\t\t %s Fmin=%dMHz Fmax=%dMHz\n",
+			fe->id,
+			fe->name,
+			fe_type[fe->type],
+			fe->type == DVBFE_TYPE_DVBS ? fe->frequency_min / 1000: fe->frequency_min / 1000000,
+			fe->type == DVBFE_TYPE_DVBS ? fe->frequency_max / 1000: fe->frequency_max / 1000000);
+		if (fe->delsys_count) {
+			fprintf(stderr, "\t\t Delivery systems:");
+			for (j = 0; j < fe->delsys_count; j++) {
+				if (fe->delsys[j] < (sizeof(delsys_names) / sizeof(delsys_names[0])))
+					fprintf(stderr, " %s", delsys_names[fe->delsys[j]]);
+				else
+					fprintf(stderr, " %d", fe->delsys[j]);
 			}
-			strcpy(drv, token);
-		}
-		if (strstr(line, "PCI_ID")) {
-			token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			*pci_ven = atoi(strtok(token, ":"));
-			*pci_dev = atoi(strtok(NULL, ":"));
-		}
-		if (strstr(line, "PCI_SUBSYS_ID")) {
-			token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			*pci_subven = atoi(strtok(token, ":"));
-			*pci_subdev = atoi(strtok(NULL, ":"));
-
-		}
-		if (strstr(line, "PCI_SLOT_NAME")) {
-			token = strtok(line, "=");
-			token = strtok(NULL, "=");
-			*domain = atoi(strtok(token, ":"));
-			*bus = atoi(strtok(NULL, ":"));
-			tmp = strtok(NULL, ":");
-			*device = atoi(strtok(tmp, "."));
-			*fn = atoi(strtok(NULL, "."));
+			fprintf(stderr, "\n");
 		}
 	}
-
-	fclose(ufile);
-	return 0;
 }
 
-/* retrieve frontend info */
-int get_frontend_info(int adapter, char *frontend)
+int main(int argc, char *argv[])
 {
-	DIR *dev_dir;
-	struct dirent *adap_dir;
-	char tmp[MAXLEN];
-
-	sprintf(tmp, "%s/adapter%d", DVB_DIR, adapter);
-	dev_dir = opendir(tmp);
-	if (!dev_dir) {
-		fprintf(stderr, "ERROR: Opening %s directory\n", tmp);
-		return - 1;
-	}
-
-	while ((adap_dir = readdir(dev_dir)) != NULL) {
-		/**
-		 * Directory structure follows:
-		 * .
-		 * ..
-		 * frontend0
-		 * frontend1
-		 * demux0
-		 * dvr0
-		 * net0
-		 */
-		if (!strcmp(adap_dir->d_name, "."))
-			continue;
-		if (!strcmp(adap_dir->d_name, ".."))
-			continue;
-
-		/* search for a dir entry with string "frontend" */
-		if (strstr(adap_dir->d_name, "frontend")) {
-			/* found a dvbX.frontendY */
-			strcpy(frontend, adap_dir->d_name);
+	struct dvbtopo *topo;
+	const char *card_prev = NULL;
+	int flags = 0;
+	int quiet = 0;
+	int opt;
+	int i;
+
+	while ((opt = getopt(argc, argv, "rqh")) != -1) {
+		switch (opt) {
+		case 'r':
+			flags |= DVBTOPO_RESCAN;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		default:
+			usage();
 		}
-
 	}
 
-	closedir(dev_dir);
-	return 0;
-}
-
-int main(void)
-{
-	DIR *sys_dir;
-	char frontend_dev[MAXLEN];
-	int entry, device, adapter;
-	char drv[MAXLEN];
-	int pci_ven, pci_dev, pci_subven, pci_subdev;
-	int domain, bus, dev, fn;
-	int dev_prev = -1;
-
-	char tmp[MAXLEN];
-	char frontend[MAXLEN];
-	char fedev[MAXLEN];
-	int fd, ret;
-	struct dvb_frontend_info info;
-
-	static char *fe_type[] = {
-		[0] = "FE_QPSK",
-		[1] = "FE_QAM",
-		[2] = "FE_OFDM",
-		[3] = "FE_ATSC",
-	};
+	if ((topo = dvbtopo_open(flags)) == NULL) {
+		fprintf(stderr, "ERROR: Unable to enumerate the DVB adapters\n");
+		return -1;
+	}
+	if (quiet) {
+		dvbtopo_close(topo);
+		return 0;
+	}
 
 	fprintf(stderr, "\n\t\tlsdvb: Simple utility to list PCI/PCIe DVB devices\n");
-	fprintf(stderr, "\t\tVersion: 0.0.4\n");
+	fprintf(stderr, "\t\tVersion: 0.0.5\n");
 	fprintf(stderr, "\t\tCopyright (C) Manu Abraham\n");
-	sys_dir = opendir(DVB_SYSFS_DIR);
-	if (!sys_dir) {
-		fprintf(stderr, "ERROR: Opening %s directory\n", DVB_SYSFS_DIR);
-		return - 1;
-	}
-
-	while (1) {
-		entry = get_frontend_entry(sys_dir, frontend_dev);
-		if (entry == 0) {
-
-			read_device_uevent(frontend_dev,
-					   drv,
-					   &pci_ven,
-					   &pci_dev,
-					   &pci_subven,
-					   &pci_subdev,
-					   &domain,
-					   &bus,
-					   &dev,
-					   &fn);
-
-			read_frontend_uevent(frontend_dev, &device, &adapter);
-			if (device != dev_prev) {
-				fprintf(stderr, "\n%s (%d:%d %d:%d) on PCI Domain:%d Bus:%d Device:%d Function:%d\n",
-					drv, pci_ven, pci_dev, pci_subven, pci_subdev, domain, bus, dev, fn);
-			}
-
-			fprintf(stderr, "\tDEVICE:%d ADAPTER:%d ", device, adapter);
-			dev_prev = device;
 
-			get_frontend_info(adapter, frontend);
-			sprintf(fedev, "%s/adapter%d/%s", DVB_DIR, adapter, frontend);
-			fd = open(fedev, O_RDWR | O_NONBLOCK);
-			if (fd < 0) {
-				fprintf(stderr, "ERROR: Open %s failed\n", frontend);
-				return -1;
-			}
+	for (i = 0; i < dvbtopo_adapter_count(topo); i++) {
+		const struct dvbtopo_adapter *adapter = dvbtopo_adapter(topo, i);
 
-			ret = ioctl(fd, FE_GET_INFO, &info);
-			if (ret < 0) {
-				fprintf(stderr, "ERROR: IOCTL failed\n");
-				return -1;
-			}
-			strncpy(tmp, frontend + 8, 1);
-			fprintf(stderr, "FRONTEND:%d (%s) \n\t\t %s Fmin=%dMHz Fmax=%dMHz\n",
-				atoi(tmp),
-				info.name,
-				fe_type[info.type],
-				info.type == 0 ? info.frequency_min / 1000: info.frequency_min / 1000000,
-				info.type == 0 ? info.frequency_max / 1000: info.frequency_max / 1000000);
-		}
-
-		if (entry == -1)
-			break;
-		if (entry == -2)
-			continue;
+		// adapters of one card are numbered next to each other
+		if ((card_prev == NULL) || strcmp(card_prev, adapter->bus_path))
+			print_card(adapter);
+		card_prev = adapter->bus_path;
 
+		print_adapter(adapter);
 	}
 
-	closedir(sys_dir);
+	dvbtopo_close(topo);
 
 	return 0;
 }
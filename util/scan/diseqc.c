@@ -82,10 +82,16 @@ int diseqc_send_msg (int fd, fe_sec_voltage_t v, struct diseqc_cmd **cmd,
 }
 
 
-int setup_switch (int frontend_fd, int switch_pos, int voltage_18, int hiband)
+int setup_switch (int frontend_fd, int *state, int switch_pos, int voltage_18, int hiband)
 {
 	struct diseqc_cmd *cmd[2] = { NULL, NULL };
 	int i = 4 * switch_pos + 2 * hiband + (voltage_18 ? 1 : 0);
+	int err;
+
+	if (i == *state) {
+		verbose("DiSEqC: switch already at index %d\n", i);
+		return 1;
+	}
 
 	verbose("DiSEqC: switch pos %i, %sV, %sband (index %d)\n",
 	    switch_pos, voltage_18 ? "18" : "13", hiband ? "hi" : "lo", i);
@@ -95,9 +101,14 @@ int setup_switch (int frontend_fd, int switch_pos, int voltage_18, int hiband)
 
 	cmd[0] = &switch_cmds[i];
 
-	return diseqc_send_msg (frontend_fd,
-				i % 2 ? SEC_VOLTAGE_18 : SEC_VOLTAGE_13,
-				cmd,
-				(i/2) % 2 ? SEC_TONE_ON : SEC_TONE_OFF,
-				(i/4) % 2 ? SEC_MINI_B : SEC_MINI_A);
+	err = diseqc_send_msg (frontend_fd,
+			       i % 2 ? SEC_VOLTAGE_18 : SEC_VOLTAGE_13,
+			       cmd,
+			       (i/2) % 2 ? SEC_TONE_ON : SEC_TONE_OFF,
+			       (i/4) % 2 ? SEC_MINI_B : SEC_MINI_A);
+
+	/* a partly sent sequence leaves the switch in an unknown state */
+	*state = err ? -1 : i;
+
+	return err;
 }
@@ -16,9 +16,12 @@ extern int diseqc_send_msg (int fd, fe_sec_voltage_t v, struct diseqc_cmd **cmd,
 
 
 /**
- *   set up the switch to position/voltage/tone
+ *   set up the switch to position/voltage/tone, unless *state says it
+ *   already is; *state is the index of the last setup sent (-1 if unknown)
+ *   and is updated. Returns 1 if nothing had to be sent, 0 once sent, or
+ *   an error.
  */
-extern int setup_switch (int frontend_fd, int switch_pos, int voltage_18, int freq);
+extern int setup_switch (int frontend_fd, int *state, int switch_pos, int voltage_18, int hiband);
 
 
 #endif
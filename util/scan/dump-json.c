@@ -0,0 +1,206 @@
+#include <linux/dvb/frontend.h>
+#include "dump-json.h"
+
+static const char *type_name [] = {
+	"S",
+	"C",
+	"T",
+	"A"
+};
+
+static const char *inv_name [] = {
+	"OFF",
+	"ON",
+	"AUTO"
+};
+
+static const char *fec_name [] = {
+	"NONE",
+	"1/2",
+	"2/3",
+	"3/4",
+	"4/5",
+	"5/6",
+	"6/7",
+	"7/8",
+	"8/9",
+	"AUTO"
+};
+
+static const char *qam_name [] = {
+	"QPSK",
+	"QAM16",
+	"QAM32",
+	"QAM64",
+	"QAM128",
+	"QAM256",
+	"AUTO",
+	"8VSB",
+	"16VSB"
+};
+
+static const char *bw_name [] = {
+	"8MHz",
+	"7MHz",
+	"6MHz",
+	"AUTO"
+};
+
+static const char *mode_name [] = {
+	"2k",
+	"8k",
+	"AUTO"
+};
+
+static const char *guard_name [] = {
+	"1/32",
+	"1/16",
+	"1/8",
+	"1/4",
+	"AUTO"
+};
+
+static const char *hierarchy_name [] = {
+	"NONE",
+	"1",
+	"2",
+	"4",
+	"AUTO"
+};
+
+
+static void json_int (struct output *o, const char *key, long v)
+{
+	output_str (o, key);
+	output_int (o, v);
+}
+
+static void json_enum (struct output *o, const char *key, const char *v)
+{
+	output_str (o, key);
+	output_char (o, '"');
+	output_str (o, v);
+	output_char (o, '"');
+}
+
+#define json_enum_tab(o, key, tab, v) \
+	do { \
+		output_str ((o), (key)); \
+		output_char ((o), '"'); \
+		output_enum ((o), tab, (v), "AUTO"); \
+		output_char ((o), '"'); \
+	} while (0)
+
+static void json_dump_dvb_parameters (struct output *o, fe_type_t type,
+		struct dvb_frontend_parameters *p,
+		char polarity, int orbital_pos, int we_flag)
+{
+	char pol[2] = { polarity, '\0' };
+
+	json_enum_tab (o, "\"delivery\":", type_name, type);
+	json_int (o, ",\"frequency\":", p->frequency);
+
+	switch (type) {
+	case FE_QPSK:
+		json_enum (o, ",\"polarisation\":", pol);
+		json_int (o, ",\"symbol_rate\":", p->u.qpsk.symbol_rate);
+		json_enum_tab (o, ",\"fec\":", fec_name, p->u.qpsk.fec_inner);
+		json_int (o, ",\"orbital_position\":", orbital_pos);
+		json_enum (o, ",\"west_east\":", we_flag ? "E" : "W");
+		break;
+
+	case FE_QAM:
+		json_enum_tab (o, ",\"inversion\":", inv_name, p->inversion);
+		json_int (o, ",\"symbol_rate\":", p->u.qam.symbol_rate);
+		json_enum_tab (o, ",\"fec\":", fec_name, p->u.qam.fec_inner);
+		json_enum_tab (o, ",\"modulation\":", qam_name, p->u.qam.modulation);
+		break;
+
+	case FE_OFDM:
+		json_enum_tab (o, ",\"inversion\":", inv_name, p->inversion);
+		json_enum_tab (o, ",\"bandwidth\":", bw_name, p->u.ofdm.bandwidth);
+		json_enum_tab (o, ",\"code_rate_hp\":", fec_name, p->u.ofdm.code_rate_HP);
+		json_enum_tab (o, ",\"code_rate_lp\":", fec_name, p->u.ofdm.code_rate_LP);
+		json_enum_tab (o, ",\"modulation\":", qam_name, p->u.ofdm.constellation);
+		json_enum_tab (o, ",\"transmission_mode\":", mode_name, p->u.ofdm.transmission_mode);
+		json_enum_tab (o, ",\"guard_interval\":", guard_name, p->u.ofdm.guard_interval);
+		json_enum_tab (o, ",\"hierarchy\":", hierarchy_name, p->u.ofdm.hierarchy_information);
+		break;
+
+	case FE_ATSC:
+		json_enum_tab (o, ",\"modulation\":", qam_name, p->u.vsb.modulation);
+		break;
+
+	default:
+		;
+	};
+}
+
+void json_dump_service_parameter_set (struct output *o,
+				 const char *service_name,
+				 const char *provider_name,
+				 fe_type_t type,
+				 struct dvb_frontend_parameters *p,
+				 char polarity,
+				 int orbital_pos,
+				 int we_flag,
+				 int service_type,
+				 int pmt_pid,
+				 int pcr_pid,
+				 int video_pid,
+				 uint16_t *audio_pid,
+				 char audio_lang[][4],
+				 int audio_num,
+				 int ac3_pid,
+				 int teletext_pid,
+				 int subtitling_pid,
+				 uint16_t *ca_id,
+				 int ca_num,
+				 int scrambled,
+				 int service_id,
+				 int network_id,
+				 int transport_stream_id,
+				 int channel_num)
+{
+	int i;
+
+	output_str (o, "{\"name\":");
+	output_json_str (o, service_name);
+	output_str (o, ",\"provider\":");
+	output_json_str (o, provider_name);
+	output_char (o, ',');
+	json_dump_dvb_parameters (o, type, p, polarity, orbital_pos, we_flag);
+	json_int (o, ",\"original_network_id\":", network_id);
+	json_int (o, ",\"transport_stream_id\":", transport_stream_id);
+	json_int (o, ",\"service_id\":", service_id);
+	json_int (o, ",\"service_type\":", service_type);
+	json_int (o, ",\"channel_number\":", channel_num);
+	json_int (o, ",\"pmt_pid\":", pmt_pid);
+	json_int (o, ",\"pcr_pid\":", pcr_pid);
+	json_int (o, ",\"video_pid\":", video_pid);
+
+	output_str (o, ",\"audio\":[");
+	for (i = 0; i < audio_num; i++) {
+		if (i)
+			output_char (o, ',');
+		json_int (o, "{\"pid\":", audio_pid[i]);
+		output_str (o, ",\"lang\":");
+		output_json_str (o, audio_lang[i]);
+		output_char (o, '}');
+	}
+	output_char (o, ']');
+
+	json_int (o, ",\"ac3_pid\":", ac3_pid);
+	json_int (o, ",\"teletext_pid\":", teletext_pid);
+	json_int (o, ",\"subtitling_pid\":", subtitling_pid);
+
+	output_str (o, ",\"ca_ids\":[");
+	for (i = 0; i < ca_num; i++) {
+		if (i)
+			output_char (o, ',');
+		output_int (o, ca_id[i]);
+	}
+	output_char (o, ']');
+
+	output_str (o, scrambled ? ",\"scrambled\":true}\n" : ",\"scrambled\":false}\n");
+}
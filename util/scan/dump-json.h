@@ -0,0 +1,39 @@
+#ifndef __DUMP_JSON_H__
+#define __DUMP_JSON_H__
+
+#include <stdint.h>
+#include <linux/dvb/frontend.h>
+#include "output.h"
+
+/**
+ *   one JSON object per line and service, for programs rather than people:
+ *   every field is always there, and the tuning parameters are named as in
+ *   the initial tuning data files
+ */
+extern void json_dump_service_parameter_set (struct output *o,
+				 const char *service_name,
+				 const char *provider_name,
+				 fe_type_t type,
+				 struct dvb_frontend_parameters *p,
+				 char polarity,
+				 int orbital_pos,
+				 int we_flag,
+				 int service_type,
+				 int pmt_pid,
+				 int pcr_pid,
+				 int video_pid,
+				 uint16_t *audio_pid,
+				 char audio_lang[][4],
+				 int audio_num,
+				 int ac3_pid,
+				 int teletext_pid,
+				 int subtitling_pid,
+				 uint16_t *ca_id,
+				 int ca_num,
+				 int scrambled,
+				 int service_id,
+				 int network_id,
+				 int transport_stream_id,
+				 int channel_num);
+
+#endif
@@ -1,4 +1,3 @@
-#include <stdio.h>
 #include "dump-vdr.h"
 #include <linux/dvb/frontend.h>
 
@@ -69,41 +68,67 @@ static const char *west_east_flag_name [] = {
 	"E"
 };
 
-void vdr_dump_dvb_parameters (FILE *f, fe_type_t type,
+static void output_lang (struct output *o, const char *lang)
+{
+	int i;
+
+	output_char (o, '=');
+	for (i = 0; (i < 4) && lang[i]; i++)
+		output_char (o, lang[i]);
+}
+
+void vdr_dump_dvb_parameters (struct output *o, fe_type_t type,
 		struct dvb_frontend_parameters *p,
 		char polarity, int orbital_pos, int we_flag)
 {
 	switch (type) {
 	case FE_QPSK:
-		fprintf (f, "%i:", p->frequency / 1000);
-		fprintf (f, "%c:", polarity);
-		fprintf (f, "S%i.%i%s:", orbital_pos/10,
-			 orbital_pos % 10, west_east_flag_name[we_flag]);
-		fprintf (f, "%i:", p->u.qpsk.symbol_rate / 1000);
+		output_int (o, p->frequency / 1000);
+		output_char (o, ':');
+		output_char (o, polarity);
+		output_str (o, ":S");
+		output_int (o, orbital_pos / 10);
+		output_char (o, '.');
+		output_int (o, orbital_pos % 10);
+		output_enum (o, west_east_flag_name, we_flag, "E");
+		output_char (o, ':');
+		output_int (o, p->u.qpsk.symbol_rate / 1000);
+		output_char (o, ':');
 		break;
 
 	case FE_QAM:
-		fprintf (f, "%i:", p->frequency / 1000000);
-		fprintf (f, "M%s:C:", qam_name[p->u.qam.modulation]);
-		fprintf (f, "%i:", p->u.qam.symbol_rate / 1000);
+		output_int (o, p->frequency / 1000000);
+		output_str (o, ":M");
+		output_enum (o, qam_name, p->u.qam.modulation, "999");
+		output_str (o, ":C:");
+		output_int (o, p->u.qam.symbol_rate / 1000);
+		output_char (o, ':');
 		break;
 
 	case FE_OFDM:
-		fprintf (f, "%i:", p->frequency / 1000);
-		fprintf (f, "I%s", inv_name[p->inversion]);
-		fprintf (f, "B%s", bw_name[p->u.ofdm.bandwidth]);
-		fprintf (f, "C%s", fec_name[p->u.ofdm.code_rate_HP]);
-		fprintf (f, "D%s", fec_name[p->u.ofdm.code_rate_LP]);
-		fprintf (f, "M%s", qam_name[p->u.ofdm.constellation]);
-		fprintf (f, "T%s", mode_name[p->u.ofdm.transmission_mode]);
-		fprintf (f, "G%s", guard_name[p->u.ofdm.guard_interval]);
-		fprintf (f, "Y%s", hierarchy_name[p->u.ofdm.hierarchy_information]);
-		fprintf (f, ":T:27500:");
+		output_int (o, p->frequency / 1000);
+		output_str (o, ":I");
+		output_enum (o, inv_name, p->inversion, "999");
+		output_char (o, 'B');
+		output_enum (o, bw_name, p->u.ofdm.bandwidth, "999");
+		output_char (o, 'C');
+		output_enum (o, fec_name, p->u.ofdm.code_rate_HP, "999");
+		output_char (o, 'D');
+		output_enum (o, fec_name, p->u.ofdm.code_rate_LP, "999");
+		output_char (o, 'M');
+		output_enum (o, qam_name, p->u.ofdm.constellation, "999");
+		output_char (o, 'T');
+		output_enum (o, mode_name, p->u.ofdm.transmission_mode, "999");
+		output_char (o, 'G');
+		output_enum (o, guard_name, p->u.ofdm.guard_interval, "999");
+		output_char (o, 'Y');
+		output_enum (o, hierarchy_name, p->u.ofdm.hierarchy_information, "999");
+		output_str (o, ":T:27500:");
 		break;
 
 	case FE_ATSC:
-		fprintf (f, "%i:", p->frequency / 1000);
-		fprintf (f, "VDR does not support ATSC at this time");
+		output_int (o, p->frequency / 1000);
+		output_str (o, ":VDR does not support ATSC at this time");
 		break;
 
 	default:
@@ -111,7 +136,7 @@ void vdr_dump_dvb_parameters (FILE *f, fe_type_t type,
 	};
 }
 
-void vdr_dump_service_parameter_set (FILE *f,
+void vdr_dump_service_parameter_set (struct output *o,
 				 const char *service_name,
 				 const char *provider_name,
 				 fe_type_t type,
@@ -144,35 +169,49 @@ void vdr_dump_service_parameter_set (FILE *f,
 			network_id = 0;
 			transport_stream_id = 0;
 		}
-		if ((dump_channum == 1) && (channel_num > 0))
-			fprintf(f, ":@%i\n", channel_num);
-		if (vdr_version >= 3)
-			fprintf (f, "%s;%s:", service_name, provider_name);
+		if ((dump_channum == 1) && (channel_num > 0)) {
+			output_str (o, ":@");
+			output_int (o, channel_num);
+			output_char (o, '\n');
+		}
+		if (vdr_version >= 3) {
+			output_str (o, service_name);
+			output_char (o, ';');
+			output_str (o, provider_name ? provider_name : "(null)");
+			output_char (o, ':');
+		}
 		else
 		  {
-		    if (dump_provider == 1)
-		      fprintf (f, "%s - ", provider_name);
-		    fprintf (f, "%s:", service_name);
+		    if (dump_provider == 1) {
+		      output_str (o, provider_name ? provider_name : "(null)");
+		      output_str (o, " - ");
+		    }
+		    output_str (o, service_name);
+		    output_char (o, ':');
 		  }
-		vdr_dump_dvb_parameters (f, type, p, polarity, orbital_pos, we_flag);
-		if ((pcr_pid != video_pid) && (video_pid > 0))
-			fprintf (f, "%i+%i:", video_pid, pcr_pid);
-		else
-			fprintf (f, "%i:", video_pid);
-		fprintf (f, "%i", audio_pid[0]);
+		vdr_dump_dvb_parameters (o, type, p, polarity, orbital_pos, we_flag);
+		output_int (o, video_pid);
+		if ((pcr_pid != video_pid) && (video_pid > 0)) {
+			output_char (o, '+');
+			output_int (o, pcr_pid);
+		}
+		output_char (o, ':');
+		output_int (o, audio_pid[0]);
 		if (audio_lang && audio_lang[0][0])
-			fprintf (f, "=%.4s", audio_lang[0]);
+			output_lang (o, audio_lang[0]);
 	        for (i = 1; i < audio_num; i++)
 	        {
-			fprintf (f, ",%i", audio_pid[i]);
+			output_char (o, ',');
+			output_int (o, audio_pid[i]);
 			if (audio_lang && audio_lang[i][0])
-				fprintf (f, "=%.4s", audio_lang[i]);
+				output_lang (o, audio_lang[i]);
 		}
 		if (ac3_pid)
 	        {
-			fprintf (f, ";%i", ac3_pid);
+			output_char (o, ';');
+			output_int (o, ac3_pid);
 			if (audio_lang && audio_lang[0][0])
-				fprintf (f, "=%.4s", audio_lang[0]);
+				output_lang (o, audio_lang[0]);
  		}
 		if (scrambled == 1) {
 			if (ca_select == -1)
@@ -183,8 +222,16 @@ void vdr_dump_service_parameter_set (FILE *f,
 			else
 				scrambled = ca_select;
 		}
-		fprintf (f, ":%d:%d:%d:%d:%d:0", teletext_pid, scrambled,
-				service_id, network_id, transport_stream_id);
-		fprintf (f, "\n");
+		output_char (o, ':');
+		output_int (o, teletext_pid);
+		output_char (o, ':');
+		output_int (o, scrambled);
+		output_char (o, ':');
+		output_int (o, service_id);
+		output_char (o, ':');
+		output_int (o, network_id);
+		output_char (o, ':');
+		output_int (o, transport_stream_id);
+		output_str (o, ":0\n");
 	}
 }
@@ -3,14 +3,15 @@
 
 #include <stdint.h>
 #include <linux/dvb/frontend.h>
+#include "output.h"
 
 extern
-void vdr_dump_dvb_parameters (FILE *f, fe_type_t type,
+void vdr_dump_dvb_parameters (struct output *o, fe_type_t type,
 		struct dvb_frontend_parameters *p,
 		char polarity, int orbital_pos, int we_flag);
 
 extern
-void vdr_dump_service_parameter_set (FILE *f,
+void vdr_dump_service_parameter_set (struct output *o,
 				 const char *service_name,
 				 const char *provider_name,
 				 fe_type_t type,
@@ -1,4 +1,3 @@
-#include <stdio.h>
 #include <linux/dvb/frontend.h>
 #include "dump-zap.h"
 
@@ -67,40 +66,55 @@ static const char *hierarchy_name [] = {
 };
 
 
-void zap_dump_dvb_parameters (FILE *f, fe_type_t type, struct dvb_frontend_parameters *p, char polarity, int sat_number)
+void zap_dump_dvb_parameters (struct output *o, fe_type_t type, struct dvb_frontend_parameters *p, char polarity, int sat_number)
 {
 	switch (type) {
 	case FE_QPSK:
-		fprintf (f, "%i:", p->frequency / 1000);	/* channels.conf wants MHz */
-		fprintf (f, "%c:", polarity);
-		fprintf (f, "%d:", sat_number);
-		fprintf (f, "%i", p->u.qpsk.symbol_rate / 1000); /* channels.conf wants kBaud */
-		/*fprintf (f, "%s", fec_name[p->u.qpsk.fec_inner]);*/
+		output_int (o, p->frequency / 1000);	/* channels.conf wants MHz */
+		output_char (o, ':');
+		output_char (o, polarity);
+		output_char (o, ':');
+		output_int (o, sat_number);
+		output_char (o, ':');
+		output_int (o, p->u.qpsk.symbol_rate / 1000); /* channels.conf wants kBaud */
 		break;
 
 	case FE_QAM:
-		fprintf (f, "%i:", p->frequency);
-		fprintf (f, "%s:", inv_name[p->inversion]);
-		fprintf (f, "%i:", p->u.qpsk.symbol_rate);
-		fprintf (f, "%s:", fec_name[p->u.qpsk.fec_inner]);
-		fprintf (f, "%s", qam_name[p->u.qam.modulation]);
+		output_int (o, p->frequency);
+		output_char (o, ':');
+		output_enum (o, inv_name, p->inversion, "INVERSION_AUTO");
+		output_char (o, ':');
+		output_int (o, p->u.qam.symbol_rate);
+		output_char (o, ':');
+		output_enum (o, fec_name, p->u.qam.fec_inner, "FEC_AUTO");
+		output_char (o, ':');
+		output_enum (o, qam_name, p->u.qam.modulation, "QAM_AUTO");
 		break;
 
 	case FE_OFDM:
-		fprintf (f, "%i:", p->frequency);
-		fprintf (f, "%s:", inv_name[p->inversion]);
-		fprintf (f, "%s:", bw_name[p->u.ofdm.bandwidth]);
-		fprintf (f, "%s:", fec_name[p->u.ofdm.code_rate_HP]);
-		fprintf (f, "%s:", fec_name[p->u.ofdm.code_rate_LP]);
-		fprintf (f, "%s:", qam_name[p->u.ofdm.constellation]);
-		fprintf (f, "%s:", mode_name[p->u.ofdm.transmission_mode]);
-		fprintf (f, "%s:", guard_name[p->u.ofdm.guard_interval]);
-		fprintf (f, "%s", hierarchy_name[p->u.ofdm.hierarchy_information]);
+		output_int (o, p->frequency);
+		output_char (o, ':');
+		output_enum (o, inv_name, p->inversion, "INVERSION_AUTO");
+		output_char (o, ':');
+		output_enum (o, bw_name, p->u.ofdm.bandwidth, "BANDWIDTH_AUTO");
+		output_char (o, ':');
+		output_enum (o, fec_name, p->u.ofdm.code_rate_HP, "FEC_AUTO");
+		output_char (o, ':');
+		output_enum (o, fec_name, p->u.ofdm.code_rate_LP, "FEC_AUTO");
+		output_char (o, ':');
+		output_enum (o, qam_name, p->u.ofdm.constellation, "QAM_AUTO");
+		output_char (o, ':');
+		output_enum (o, mode_name, p->u.ofdm.transmission_mode, "TRANSMISSION_MODE_AUTO");
+		output_char (o, ':');
+		output_enum (o, guard_name, p->u.ofdm.guard_interval, "GUARD_INTERVAL_AUTO");
+		output_char (o, ':');
+		output_enum (o, hierarchy_name, p->u.ofdm.hierarchy_information, "HIERARCHY_AUTO");
 		break;
 
 	case FE_ATSC:
-		fprintf (f, "%i:", p->frequency);
-		fprintf (f, "%s", qam_name[p->u.vsb.modulation]);
+		output_int (o, p->frequency);
+		output_char (o, ':');
+		output_enum (o, qam_name, p->u.vsb.modulation, "QAM_AUTO");
 		break;
 
 	default:
@@ -108,7 +122,7 @@ void zap_dump_dvb_parameters (FILE *f, fe_type_t type, struct dvb_frontend_param
 	};
 }
 
-void zap_dump_service_parameter_set (FILE *f,
+void zap_dump_service_parameter_set (struct output *o,
 				 const char *service_name,
 				 fe_type_t type,
 				 struct dvb_frontend_parameters *p,
@@ -118,8 +132,14 @@ void zap_dump_service_parameter_set (FILE *f,
 				 uint16_t *audio_pid,
 				 uint16_t service_id)
 {
-	fprintf (f, "%s:", service_name);
-	zap_dump_dvb_parameters (f, type, p, polarity, sat_number);
-	fprintf (f, ":%i:%i:%i", video_pid, audio_pid[0], service_id);
-	fprintf (f, "\n");
+	output_str (o, service_name);
+	output_char (o, ':');
+	zap_dump_dvb_parameters (o, type, p, polarity, sat_number);
+	output_char (o, ':');
+	output_int (o, video_pid);
+	output_char (o, ':');
+	output_int (o, audio_pid[0]);
+	output_char (o, ':');
+	output_int (o, service_id);
+	output_char (o, '\n');
 }
@@ -3,11 +3,12 @@
 
 #include <stdint.h>
 #include <linux/dvb/frontend.h>
+#include "output.h"
 
-extern void zap_dump_dvb_parameters (FILE *f, fe_type_t type,
+extern void zap_dump_dvb_parameters (struct output *o, fe_type_t type,
 		struct dvb_frontend_parameters *t, char polarity, int sat);
 
-extern void zap_dump_service_parameter_set (FILE *f,
+extern void zap_dump_service_parameter_set (struct output *o,
 				 const char *service_name,
 				 fe_type_t type,
 				 struct dvb_frontend_parameters *t,
@@ -0,0 +1,85 @@
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "output.h"
+
+
+void output_init (struct output *o, int fd)
+{
+	o->fd = fd;
+	o->len = 0;
+}
+
+int output_flush (struct output *o)
+{
+	size_t done = 0;
+	ssize_t n;
+
+	while (done < o->len) {
+		if ((n = write (o->fd, o->buf + done, o->len - done)) < 0) {
+			if (errno == EINTR)
+				continue;
+			o->len = 0;
+			return -errno;
+		}
+		done += n;
+	}
+	o->len = 0;
+	return 0;
+}
+
+void output_str (struct output *o, const char *str)
+{
+	size_t len = strlen (str);
+	size_t n;
+
+	while (len) {
+		if (o->len == sizeof(o->buf))
+			output_flush (o);
+		n = sizeof(o->buf) - o->len;
+		if (n > len)
+			n = len;
+		memcpy (o->buf + o->len, str, n);
+		o->len += n;
+		str += n;
+		len -= n;
+	}
+}
+
+void output_int (struct output *o, long v)
+{
+	char tmp[24];
+	char *p = tmp + sizeof(tmp);
+	unsigned long u = (v < 0) ? -(unsigned long) v : (unsigned long) v;
+
+	*--p = '\0';
+	do {
+		*--p = '0' + (u % 10);
+		u /= 10;
+	} while (u);
+	if (v < 0)
+		*--p = '-';
+
+	output_str (o, p);
+}
+
+void output_json_str (struct output *o, const char *str)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned char c;
+
+	output_char (o, '"');
+	for (; str && (c = *str); str++) {
+		if (c == '"' || c == '\\') {
+			output_char (o, '\\');
+			output_char (o, c);
+		} else if (c < 0x20) {
+			output_str (o, "\\u00");
+			output_char (o, hex[c >> 4]);
+			output_char (o, hex[c & 0xf]);
+		} else
+			output_char (o, c);
+	}
+	output_char (o, '"');
+}
@@ -0,0 +1,55 @@
+#ifndef __OUTPUT_H__
+#define __OUTPUT_H__
+
+#include <stddef.h>
+
+/**
+ *   Buffered writer for the channel lists. The dumpers append to it field
+ *   by field without going through stdio, and scan flushes it with one
+ *   write() after each transponder, so what was output is on its way even
+ *   if scan dies before the end.
+ */
+
+#define OUTPUT_BUF_SIZE 16384
+
+
+struct output {
+	int fd;
+	size_t len;
+	char buf[OUTPUT_BUF_SIZE];
+};
+
+
+extern void output_init (struct output *o, int fd);
+
+/**
+ *   write out what is buffered.
+ *   returns 0 on success, or -errno
+ */
+extern int output_flush (struct output *o);
+
+extern void output_str (struct output *o, const char *str);
+extern void output_int (struct output *o, long v);
+
+/**
+ *   a string as a JSON string literal, quotes included
+ */
+extern void output_json_str (struct output *o, const char *str);
+
+static inline void output_char (struct output *o, char c)
+{
+	if (o->len == sizeof(o->buf))
+		output_flush (o);
+	o->buf[o->len++] = c;
+}
+
+/**
+ *   the name of an enum value from a table indexed by it, or deflt for a
+ *   value past the end of the table
+ */
+#define output_enum(o, tab, v, deflt) \
+	output_str ((o), ((unsigned) (v) < sizeof(tab) / sizeof((tab)[0])) ? \
+			 (tab)[(v)] : (deflt))
+
+
+#endif
@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/dvb/frontend.h>
+
+#include "scan.h"
+#include "rotor.h"
+
+#define TO_RADIANS(d) ((d) * M_PI / 180.0)
+#define TO_DEGREES(r) ((r) * 180.0 / M_PI)
+
+/* earth radius / geostationary orbit radius */
+#define ORBIT_RATIO 0.1513
+
+/* anything closer is the same position, within what GotoX can encode */
+#define ROTOR_RESOLUTION 0.05
+
+
+static int decode_degrees (const char *str, char **end, char plus, char minus,
+			   double *value)
+{
+	*value = strtod(str, end);
+	if (*end == str)
+		return -1;
+
+	if (**end == plus) {
+		(*end)++;
+	} else if (**end == minus) {
+		*value = -*value;
+		(*end)++;
+	}
+
+	return 0;
+}
+
+int rotor_decode (const char *str, struct rotor *r)
+{
+	char *end;
+
+	memset(r, 0, sizeof(*r));
+	r->speed = 1.5;
+
+	if (decode_degrees(str, &end, 'E', 'W', &r->site_longitude) || (*end != ','))
+		return -1;
+	if (decode_degrees(end + 1, &end, 'N', 'S', &r->site_latitude))
+		return -1;
+	if (*end == ',') {
+		str = end + 1;
+		r->speed = strtod(str, &end);
+		if ((end == str) || (r->speed <= 0))
+			return -1;
+	}
+	if (*end)
+		return -1;
+
+	if ((fabs(r->site_longitude) > 180.0) || (fabs(r->site_latitude) > 90.0))
+		return -1;
+
+	return 0;
+}
+
+double rotor_angle (struct rotor *r, double sat_longitude)
+{
+	double lat = TO_RADIANS(r->site_latitude);
+	double dlon = TO_RADIANS(sat_longitude - r->site_longitude);
+	double azimuth, elevation, x, a, b;
+
+	/* look angles of the satellite from the site ... */
+	azimuth = M_PI + atan(tan(dlon) / sin(lat));
+	x = acos(cos(dlon) * cos(lat));
+	elevation = atan((cos(x) - ORBIT_RATIO) / sin(x));
+
+	/* ... turned into the hour angle of a polar mount */
+	a = -cos(elevation) * sin(azimuth);
+	b = (sin(elevation) * cos(lat)) - (cos(elevation) * sin(lat) * cos(azimuth));
+
+	return TO_DEGREES(atan(a / b));
+}
+
+long rotor_travel_ms (struct rotor *r, double angle)
+{
+	double travel;
+
+	if (r->known)
+		travel = fabs(angle - r->bearing);
+	else
+		travel = fabs(angle) + ROTOR_LIMIT;
+	if (travel < ROTOR_RESOLUTION)
+		return 0;
+
+	return (long) (travel * 1000.0 / r->speed) + ROTOR_SETTLE_MS;
+}
+
+long rotor_goto (int frontend_fd, struct rotor *r, double angle)
+{
+	struct dvb_diseqc_master_cmd cmd = { { 0xe0, 0x31, 0x6e, 0x00, 0x00, 0x00 }, 5 };
+	/* tenths of a degree in 1/16ths */
+	static const uint8_t fractions[10] = {
+		0x0, 0x2, 0x3, 0x5, 0x6, 0x8, 0xa, 0xb, 0xd, 0xe
+	};
+	unsigned int tenths;
+	long travel;
+
+	if (angle > ROTOR_LIMIT)
+		angle = ROTOR_LIMIT;
+	else if (angle < -ROTOR_LIMIT)
+		angle = -ROTOR_LIMIT;
+
+	if ((travel = rotor_travel_ms(r, angle)) == 0)
+		return 0;
+
+	/* GotoX: direction and whole degrees, then the fraction */
+	tenths = (unsigned int) (fabs(angle) * 10.0 + 0.5);
+	cmd.msg[3] = (angle < 0 ? 0xd0 : 0xe0) | (((tenths / 10) >> 4) & 0x0f);
+	cmd.msg[4] = (((tenths / 10) & 0x0f) << 4) | fractions[tenths % 10];
+
+	verbose("DiSEqC: rotor to %.1f%c (%02x %02x), about %ld ms\n",
+		fabs(angle), angle < 0 ? 'W' : 'E', cmd.msg[3], cmd.msg[4], travel);
+
+	r->known = 0;
+	if (ioctl(frontend_fd, FE_SET_TONE, SEC_TONE_OFF) ||
+	    ioctl(frontend_fd, FE_DISEQC_SEND_MASTER_CMD, &cmd))
+		return -errno;
+
+	r->known = 1;
+	r->bearing = angle;
+	return travel;
+}
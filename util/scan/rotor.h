@@ -0,0 +1,53 @@
+#ifndef __ROTOR_H__
+#define __ROTOR_H__
+
+/**
+ *   USALS (DiSEqC 1.3) dish motor. Motor angles are in degrees, positive
+ *   to the east, and the satellite the dish points at follows from the
+ *   site's position alone. The motor reports nothing back, so how long a
+ *   move takes is estimated from the angle it travels at a known speed.
+ */
+
+struct rotor {
+	double site_longitude;		/* degrees, positive east */
+	double site_latitude;		/* degrees, positive north */
+	double speed;			/* degrees per second */
+	int known;			/* the motor is at bearing */
+	double bearing;			/* motor angle last driven to */
+};
+
+/* the furthest a USALS motor turns from due south (or north) */
+#define ROTOR_LIMIT 75.0
+
+/* allowed for the dish to stop swinging once the motor has stopped */
+#define ROTOR_SETTLE_MS 500
+
+
+/**
+ *   parse "longitude,latitude[,speed]", e.g. "-3.7,40.4" or "13.4E,52.5N,2"
+ *   returns 0 on success, -1 on a malformed string
+ */
+extern int rotor_decode (const char *str, struct rotor *r);
+
+/**
+ *   motor angle to point at a satellite at sat_longitude (degrees, positive
+ *   east) from the rotor's site
+ */
+extern double rotor_angle (struct rotor *r, double sat_longitude);
+
+/**
+ *   estimated time in ms for the motor to reach angle: 0 if it is there
+ *   already, and, while the motor's bearing is unknown, as if it had to
+ *   come from the far limit
+ */
+extern long rotor_travel_ms (struct rotor *r, double angle);
+
+/**
+ *   drive the motor to angle, unless it is there already.
+ *   returns the estimated travel time in ms (0 if nothing was sent), or an
+ *   error; the bearing is unknown after an error.
+ */
+extern long rotor_goto (int frontend_fd, struct rotor *r, double angle);
+
+
+#endif
@@ -21,10 +21,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/ioctl.h>
+#include <sys/epoll.h>
 #include <sys/poll.h>
+#include <sys/time.h>
+#include <sys/socket.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <time.h>
@@ -35,25 +39,29 @@
 #include <ctype.h>
 #include <iconv.h>
 #include <langinfo.h>
+#include <netdb.h>
 
 #include <linux/dvb/frontend.h>
 #include <linux/dvb/dmx.h>
 
+#include <libucsi/descriptor_index.h>
+#include <libdvbapi/dvblatency.h>
+#include <libdvbapi/dvbdemuxbuf.h>
+#include <libdvbapi/dvbfepool.h>
+
 #include "list.h"
 #include "diseqc.h"
 #include "dump-zap.h"
 #include "dump-vdr.h"
+#include "dump-json.h"
+#include "output.h"
 #include "scan.h"
 #include "lnb.h"
+#include "ts_tap.h"
+#include "rotor.h"
 
 #include "atsc_psip_section.h"
 
-static char demux_devname[80];
-
-static struct dvb_frontend_info fe_info = {
-	.type = -1
-};
-
 int verbosity = 2;
 
 static int long_timeout;
@@ -68,6 +76,22 @@ static int serv_select = 7;
 static int vdr_version = 3;
 static struct lnb_types_st lnb_type;
 static int unique_anon_services;
+static int ts_mode;
+static const char *capture_file;	/* -r */
+static int capture_type = FE_OFDM;
+static int show_latency;
+static struct dvbdemuxbuf *demuxbufs;	/* kernel buffers of the section filters */
+static int fast_scan;			/* -F */
+
+enum fast_mode {
+	FAST_LIST = 1,			/* services from the SDT other only */
+	FAST_PMT,			/* ... then tune for just PAT and PMTs */
+	FAST_OPERATOR			/* services and TPs from the FST and FNT */
+};
+static int fastscan_pid;		/* -F fastscan: the operator's PID */
+static int fastscan_verify;		/* -F fastscan: tune the TPs to check */
+static const char *state_file;		/* -I */
+static int state_loaded;
 
 char *default_charset = "ISO-6937";
 char *output_charset;
@@ -79,13 +103,15 @@ enum table_type {
 	PAT,
 	PMT,
 	SDT,
-	NIT
+	NIT,
+	BAT
 };
 
 enum format {
         OUTPUT_ZAP,
         OUTPUT_VDR,
-	OUTPUT_PIDS
+	OUTPUT_PIDS,
+	OUTPUT_JSON
 };
 static enum format output_format = OUTPUT_ZAP;
 static int output_format_set = 0;
@@ -107,9 +133,12 @@ enum running_mode {
 
 #define AUDIO_CHAN_MAX (32)
 #define CA_SYSTEM_ID_MAX (16)
+#define BLIND_MAX_SR 4
 
 struct service {
 	struct list_head list;
+	struct list_head hash;		/* in service_hash */
+	struct transponder *tp;
 	int transport_stream_id;
 	int service_id;
 	char *provider_name;
@@ -134,6 +163,8 @@ struct service {
 
 struct transponder {
 	struct list_head list;
+	struct list_head hash;		/* in the transponder_hash bucket of */
+	uint32_t hash_frequency;	/* ... this frequency */
 	struct list_head services;
 	int network_id;
 	int original_network_id;
@@ -143,20 +174,39 @@ struct transponder {
 	enum polarisation polarisation;		/* only for DVB-S */
 	int orbital_pos;			/* only for DVB-S */
 	unsigned int we_flag		  : 1;	/* West/East Flag - only for DVB-S */
+	unsigned int orbital_known	  : 1;	/* orbital_pos and we_flag are set */
 	unsigned int scan_done		  : 1;
 	unsigned int last_tuning_failed	  : 1;
 	unsigned int other_frequency_flag : 1;	/* DVB-T */
 	unsigned int wrong_frequency	  : 1;	/* DVB-T with other_frequency_flag */
 	int n_other_f;
 	uint32_t *other_f;			/* DVB-T freqeuency-list descriptor */
+	int version[NIT + 1];			/* of PAT, SDT and NIT, -1 => none */
+	int probe_version[NIT + 1];		/* -I: as found by the probe */
+	unsigned int probe		  : 1;	/* -I: only read the versions */
+	unsigned int unchanged		  : 1;	/* -I: probe found no change */
+	unsigned int from_state		  : 1;	/* -I: loaded from the state file */
+	unsigned int dumped		  : 1;	/* services output and freed */
+	unsigned int home		  : 1;	/* -F: from the initial tuning data */
+	unsigned int discovered		  : 1;	/* -F: only known from a NIT */
+	unsigned int verify		  : 1;	/* -F fastscan: only its PAT is read */
+	unsigned int blind		  : 1;	/* -B: a carrier the sweep found */
+	uint32_t blind_width;			/* -B: kHz it seemed to span */
+	int n_blind_sr;
+	uint32_t blind_sr[BLIND_MAX_SR];	/* -B: symbol rates left to try */
+	struct list_head old_services;		/* -I: services before a rescan */
 };
 
 
+struct scan_adapter;
+
 struct section_buf {
 	struct list_head list;
-	const char *dmx_devname;
+	struct scan_adapter *adapter;
+	struct transponder *tp;		/* transponder the filter was started on */
 	unsigned int run_once  : 1;
 	unsigned int segmented : 1;	/* segmented by table_id_ext */
+	unsigned int probe     : 1;	/* -I: stop at the first section */
 	int fd;
 	int pid;
 	int table_id;
@@ -164,26 +214,71 @@ struct section_buf {
 	int section_version_number;
 	uint8_t section_done[32];
 	int sectionfilter_done;
-	unsigned char buf[1024];
 	time_t timeout;
 	time_t start_time;
+	uint64_t start_pos;		/* -r: ts_tap_position() when started */
 	time_t running_time;
 	struct section_buf *next_seg;	/* this is used to handle
 					 * segmented tables (like NIT-other)
 					 */
 };
 
+#define MAX_ADAPTERS 16
+#define MAX_RUNNING 256		/* upper bound on section filters per demux */
+
+enum adapter_state {
+	ADAPTER_IDLE,
+	ADAPTER_TUNING,
+	ADAPTER_SCANNING,
+	ADAPTER_WAITING			/* -W: asked the coordinator for a TP */
+};
+
+/**
+ * One frontend/demux pair. With several adapters (-a N,N,...), each one
+ * independently takes transponders off new_transponders, so they are tuned
+ * and scanned in parallel while feeding the same transponder/service lists.
+ */
+struct scan_adapter {
+	char frontend_devname[80];
+	char demux_devname[80];
+	char dvr_devname[80];
+	int frontend_fd;
+	int fepool_checkout;		/* -1 => frontend_fd not from dvbfepoold */
+	struct dvb_frontend_info fe_info;
+	enum adapter_state state;
+	struct transponder *tp;		/* transponder being tuned or scanned */
+	int tune_attempt;
+	long tune_start;		/* ms timestamp of the FE_SET_FRONTEND */
+	unsigned int fe_reports_signal : 1;	/* seen FE_HAS_SIGNAL/CARRIER before lock */
+	int n_running;			/* running section filters */
+	int max_running;		/* filters the demux was found to support */
+	int n_filters;			/* running + waiting section filters */
+	struct list_head waiting_filters;
+	struct section_buf filters[6];
+	struct ts_tap *tap;		/* -T: all PIDs go through one TS tap */
+	struct dvblatency_session latency;
+	int switch_index;		/* DiSEqC switch state last sent, -1 => unknown */
+	struct rotor rotor;		/* -R: the adapter's dish motor */
+	long lock_after;		/* ms timestamp before which a lock is ignored */
+	int job;			/* -W: the coordinator's number for tp */
+};
+
+static struct scan_adapter adapters[MAX_ADAPTERS];
+static int n_adapters;
+
 static LIST_HEAD(scanned_transponders);
 static LIST_HEAD(new_transponders);
 static struct transponder *current_tp;
+static struct scan_adapter *current_adapter;
 
 
 static void dump_dvb_parameters (FILE *f, struct transponder *p);
 
-static void setup_filter (struct section_buf* s, const char *dmx_devname,
+static void setup_filter (struct section_buf* s, struct scan_adapter *a,
 		          int pid, int tid, int tid_ext,
 			  int run_once, int segmented, int timeout);
 static void add_filter (struct section_buf *s);
+static void transponder_done (struct transponder *t);
 
 static const char * fe_type2str(fe_type_t t);
 
@@ -195,14 +290,47 @@ static const char * fe_type2str(fe_type_t t);
  * one satellite sometimes list the same TP with slightly different
  * frequencies, so we have to search within some bandwidth.
  */
+#define TP_FREQUENCY_TOLERANCE 2000
+
+/* TPs are hashed by frequency / TP_FREQUENCY_TOLERANCE, so all TPs which
+ * can be the same as a given frequency are in that bucket or the two
+ * next to it. NIT parsing on big platforms would be quadratic otherwise.
+ */
+#define TP_HASH_SIZE 1024
+static struct list_head transponder_hash[TP_HASH_SIZE];
+
+static struct list_head *transponder_bucket(uint32_t frequency)
+{
+	return &transponder_hash[(frequency / TP_FREQUENCY_TOLERANCE) % TP_HASH_SIZE];
+}
+
+/**
+ *   (re)index a TP after its frequency was set or changed
+ */
+static void hash_transponder(struct transponder *tp)
+{
+	if (!list_empty(&tp->hash) && tp->hash_frequency == tp->param.frequency)
+		return;
+
+	list_del_init(&tp->hash);
+	tp->hash_frequency = tp->param.frequency;
+	list_add_tail(&tp->hash, transponder_bucket(tp->hash_frequency));
+}
+
 static struct transponder *alloc_transponder(uint32_t frequency)
 {
 	struct transponder *tp = calloc(1, sizeof(*tp));
+	int i;
 
 	tp->param.frequency = frequency;
+	for (i = 0; i <= NIT; i++)
+		tp->version[i] = -1;
 	INIT_LIST_HEAD(&tp->list);
+	INIT_LIST_HEAD(&tp->hash);
 	INIT_LIST_HEAD(&tp->services);
+	INIT_LIST_HEAD(&tp->old_services);
 	list_add_tail(&tp->list, &new_transponders);
+	hash_transponder(tp);
 	return tp;
 }
 
@@ -213,7 +341,7 @@ static int is_same_transponder(uint32_t f1, uint32_t f2)
 		return 1;
 	diff = (f1 > f2) ? (f1 - f2) : (f2 - f1);
 	//FIXME: use symbolrate etc. to estimate bandwidth
-	if (diff < 2000) {
+	if (diff < TP_FREQUENCY_TOLERANCE) {
 		debug("f1 = %u is same TP as f2 = %u\n", f1, f2);
 		return 1;
 	}
@@ -223,21 +351,31 @@ static int is_same_transponder(uint32_t f1, uint32_t f2)
 static struct transponder *find_transponder(uint32_t frequency)
 {
 	struct list_head *pos;
-	struct transponder *tp;
+	struct transponder *tp, *found = NULL;
+	int i;
 
-	list_for_each(pos, &scanned_transponders) {
-		tp = list_entry(pos, struct transponder, list);
-		if (current_tp_only)
-			return tp;
-		if (is_same_transponder(tp->param.frequency, frequency))
-			return tp;
+	if (current_tp_only) {
+		if (list_empty(&scanned_transponders))
+			return NULL;
+		return list_entry(scanned_transponders.next, struct transponder, list);
 	}
-	list_for_each(pos, &new_transponders) {
-		tp = list_entry(pos, struct transponder, list);
-		if (is_same_transponder(tp->param.frequency, frequency))
-			return tp;
+
+	for (i = -1; i <= 1; i++) {
+		if ((i < 0 && frequency < TP_FREQUENCY_TOLERANCE) ||
+		    (i > 0 && frequency > UINT32_MAX - TP_FREQUENCY_TOLERANCE))
+			continue;
+		list_for_each(pos, transponder_bucket(frequency + i * TP_FREQUENCY_TOLERANCE)) {
+			tp = list_entry(pos, struct transponder, hash);
+			if (!is_same_transponder(tp->param.frequency, frequency))
+				continue;
+			/* like the old list walk, scanned TPs take precedence */
+			if (tp->scan_done)
+				return tp;
+			if (!found)
+				found = tp;
+		}
 	}
-	return NULL;
+	return found;
 }
 
 static void copy_transponder(struct transponder *d, struct transponder *s)
@@ -261,6 +399,7 @@ static void copy_transponder(struct transponder *d, struct transponder *s)
 	d->polarisation = s->polarisation;
 	d->orbital_pos = s->orbital_pos;
 	d->we_flag = s->we_flag;
+	d->orbital_known = s->orbital_known;
 	d->scan_done = s->scan_done;
 	d->last_tuning_failed = s->last_tuning_failed;
 	d->other_frequency_flag = s->other_frequency_flag;
@@ -271,19 +410,102 @@ static void copy_transponder(struct transponder *d, struct transponder *s)
 	}
 	else
 		d->other_f = NULL;
+
+	hash_transponder(d);
 }
 
 /* service_ids are guaranteed to be unique within one TP
  * (the DVB standards say theay should be unique within one
  * network, but in real life...)
  */
+#define SERVICE_HASH_SIZE 4096
+static struct list_head service_hash[SERVICE_HASH_SIZE];
+
+static struct list_head *service_bucket(struct transponder *tp, int service_id)
+{
+	unsigned long h = (unsigned long) tp / sizeof(*tp);
+
+	return &service_hash[(h * 31 + service_id) % SERVICE_HASH_SIZE];
+}
+
+/**
+ *   provider and service names are shared by every service with the same
+ *   one (a platform has only a handful of providers, and many services
+ *   appear on several TPs), and freed with the last of them
+ */
+struct name {
+	struct list_head hash;
+	int refs;
+	char str[];
+};
+
+#define NAME_HASH_SIZE 1024
+static struct list_head name_hash[NAME_HASH_SIZE];
+
+static struct list_head *name_bucket(const char *str)
+{
+	unsigned long h = 5381;
+
+	while (*str)
+		h = (h * 33) ^ (unsigned char) *str++;
+	return &name_hash[h % NAME_HASH_SIZE];
+}
+
+static void name_release(char *str)
+{
+	struct name *n;
+
+	if (!str)
+		return;
+	n = (struct name *) (str - offsetof(struct name, str));
+	if (--n->refs)
+		return;
+	list_del(&n->hash);
+	free(n);
+}
+
+/**
+ *   replace *dest with the shared copy of str, which is freed (str may
+ *   be NULL, for no name)
+ */
+static void name_set(char **dest, char *str)
+{
+	struct list_head *pos, *bucket;
+	struct name *n = NULL;
+
+	name_release(*dest);
+	*dest = NULL;
+	if (!str)
+		return;
+
+	bucket = name_bucket(str);
+	list_for_each(pos, bucket) {
+		n = list_entry(pos, struct name, hash);
+		if (!strcmp(n->str, str))
+			break;
+	}
+	if (pos == bucket) {
+		n = malloc(sizeof(*n) + strlen(str) + 1);
+		if (!n)
+			fatal("out of memory\n");
+		strcpy(n->str, str);
+		n->refs = 0;
+		list_add(&n->hash, bucket);
+	}
+	n->refs++;
+	free(str);
+	*dest = n->str;
+}
+
 static struct service *alloc_service(struct transponder *tp, int service_id)
 {
 	struct service *s = calloc(1, sizeof(*s));
 	INIT_LIST_HEAD(&s->list);
+	s->tp = tp;
 	s->service_id = service_id;
 	s->transport_stream_id = tp->transport_stream_id;
 	list_add_tail(&s->list, &tp->services);
+	list_add_tail(&s->hash, service_bucket(tp, service_id));
 	return s;
 }
 
@@ -292,14 +514,119 @@ static struct service *find_service(struct transponder *tp, int service_id)
 	struct list_head *pos;
 	struct service *s;
 
-	list_for_each(pos, &tp->services) {
-		s = list_entry(pos, struct service, list);
-		if (s->service_id == service_id)
+	list_for_each(pos, service_bucket(tp, service_id)) {
+		s = list_entry(pos, struct service, hash);
+		if (s->tp == tp && s->service_id == service_id)
 			return s;
 	}
 	return NULL;
 }
 
+/**
+ *   -F: services an SDT other or BAT lists are kept on a placeholder TP per
+ *   original_network_id/transport_stream_id, until the TP is known from a
+ *   NIT. These are on no list but other_transponders, and not hashed.
+ */
+static LIST_HEAD(other_transponders);
+
+static struct transponder *other_transponder(int original_network_id,
+					     int transport_stream_id)
+{
+	struct list_head *pos;
+	struct transponder *tp;
+	int i;
+
+	list_for_each(pos, &other_transponders) {
+		tp = list_entry(pos, struct transponder, list);
+		if (tp->original_network_id == original_network_id &&
+		    tp->transport_stream_id == transport_stream_id)
+			return tp;
+	}
+
+	tp = calloc(1, sizeof(*tp));
+	for (i = 0; i <= NIT; i++)
+		tp->version[i] = -1;
+	INIT_LIST_HEAD(&tp->list);
+	INIT_LIST_HEAD(&tp->hash);
+	INIT_LIST_HEAD(&tp->services);
+	INIT_LIST_HEAD(&tp->old_services);
+	tp->original_network_id = original_network_id;
+	tp->transport_stream_id = transport_stream_id;
+	list_add_tail(&tp->list, &other_transponders);
+	return tp;
+}
+
+static void free_service (struct service *s);
+
+/**
+ *   -F: move the services found for a TP in SDT others onto it
+ */
+static void claim_other_services(struct transponder *t)
+{
+	struct list_head *pos, *tmp;
+	struct transponder *o;
+	struct service *s;
+
+	list_for_each(pos, &other_transponders) {
+		o = list_entry(pos, struct transponder, list);
+		if (o->original_network_id == t->original_network_id &&
+		    o->transport_stream_id == t->transport_stream_id)
+			break;
+	}
+	if (pos == &other_transponders)
+		return;
+
+	list_for_each_safe(pos, tmp, &o->services) {
+		s = list_entry(pos, struct service, list);
+		if (find_service(t, s->service_id)) {
+			free_service(s);
+			continue;
+		}
+		list_del(&s->list);
+		list_del(&s->hash);
+		s->tp = t;
+		list_add_tail(&s->list, &t->services);
+		list_add_tail(&s->hash, service_bucket(t, s->service_id));
+	}
+
+	list_del(&o->list);
+	free(o);
+}
+
+/**
+ *   -F: the services listed for TPs which no NIT gave, or whose scan is
+ *   already over
+ */
+static void free_other_transponders(void)
+{
+	struct transponder *o;
+	int n = 0;
+
+	while (!list_empty(&other_transponders)) {
+		o = list_entry(other_transponders.next, struct transponder, list);
+		while (!list_empty(&o->services)) {
+			free_service(list_entry(o->services.next, struct service, list));
+			n++;
+		}
+		list_del(&o->list);
+		free(o);
+	}
+	if (n)
+		verbose("%d services of unknown or scanned transponders skipped\n", n);
+}
+
+static void init_hashes(void)
+{
+	int i;
+
+	for (i = 0; i < TP_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&transponder_hash[i]);
+	for (i = 0; i < SERVICE_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&service_hash[i]);
+	for (i = 0; i < NAME_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&name_hash[i]);
+}
+
 
 static void parse_ca_identifier_descriptor (const unsigned char *buf,
 				     struct service *s)
@@ -456,6 +783,7 @@ static void parse_satellite_delivery_system_descriptor (const unsigned char *buf
 
 	t->orbital_pos = bcd32_to_cpu (0x00, 0x00, buf[6], buf[7]);
 	t->we_flag = buf[8] >> 7;
+	t->orbital_known = 1;
 
 	if (verbosity >= 5) {
 		debug("%#04x/%#04x ", t->network_id, t->transport_stream_id);
@@ -973,21 +1301,51 @@ static void descriptorcpy(char **dest, const unsigned char *src, size_t len)
 		free(tmp);
 }
 
+/**
+ *   -F: the service_list_descriptor of a NIT or BAT transport stream loop
+ *   gives the types of services the SDT other may be missing
+ */
+static void parse_service_list_descriptor (const unsigned char *buf,
+					   struct transponder *tn)
+{
+	struct transponder *o;
+	struct service *s;
+	int len = buf[1];
+
+	if (!fast_scan)
+		return;
+
+	o = other_transponder(tn->original_network_id, tn->transport_stream_id);
+	for (buf += 2; len >= 3; buf += 3, len -= 3) {
+		int service_id = (buf[0] << 8) | buf[1];
+
+		if (!(s = find_service(o, service_id)))
+			s = alloc_service(o, service_id);
+		if (!s->type)
+			s->type = buf[2];
+	}
+}
+
 static void parse_service_descriptor (const unsigned char *buf, struct service *s)
 {
 	unsigned char len;
+	char *name;
 
 	s->type = buf[2];
 
 	buf += 3;
 	len = *buf;
 	buf++;
-	descriptorcpy(&s->provider_name, buf, len);
+	name = NULL;
+	descriptorcpy(&name, buf, len);
+	name_set(&s->provider_name, name);
 
 	buf += len;
 	len = *buf;
 	buf++;
-	descriptorcpy(&s->service_name, buf, len);
+	name = NULL;
+	descriptorcpy(&name, buf, len);
+	name_set(&s->service_name, name);
 
 	info("0x%04x 0x%04x: pmt_pid 0x%04x %s -- %s (%s%s)\n",
 	    s->transport_stream_id,
@@ -1001,33 +1359,6 @@ static void parse_service_descriptor (const unsigned char *buf, struct service *
 	    s->scrambled ? ", scrambled" : "");
 }
 
-static int find_descriptor(uint8_t tag, const unsigned char *buf,
-		int descriptors_loop_len,
-		const unsigned char **desc, int *desc_len)
-{
-	while (descriptors_loop_len > 0) {
-		unsigned char descriptor_tag = buf[0];
-		unsigned char descriptor_len = buf[1] + 2;
-
-		if (!descriptor_len) {
-			warning("descriptor_tag == 0x%02x, len is 0\n", descriptor_tag);
-			break;
-		}
-
-		if (tag == descriptor_tag) {
-			if (desc)
-				*desc = buf;
-			if (desc_len)
-				*desc_len = descriptor_len;
-			return 1;
-		}
-
-		buf += descriptor_len;
-		descriptors_loop_len -= descriptor_len;
-	}
-	return 0;
-}
-
 static void parse_descriptors(enum table_type t, const unsigned char *buf,
 			      int descriptors_loop_len, void *data)
 {
@@ -1051,6 +1382,11 @@ static void parse_descriptors(enum table_type t, const unsigned char *buf,
 				parse_network_name_descriptor (buf, data);
 			break;
 
+		case 0x41:
+			if (t == NIT || t == BAT)
+				parse_service_list_descriptor (buf, data);
+			break;
+
 		case 0x43:
 			if (t == NIT)
 				parse_satellite_delivery_system_descriptor (buf, data);
@@ -1116,9 +1452,9 @@ static void parse_pat(const unsigned char *buf, int section_length,
 		if (!s)
 			s = alloc_service(current_tp, service_id);
 		s->pmt_pid = ((buf[2] & 0x1f) << 8) | buf[3];
-		if (!s->priv && s->pmt_pid) {
+		if (!s->priv && s->pmt_pid && !current_tp->verify) {
 			s->priv = malloc(sizeof(struct section_buf));
-			setup_filter(s->priv, demux_devname,
+			setup_filter(s->priv, current_adapter,
 				     s->pmt_pid, 0x02, s->service_id, 1, 0, 5);
 
 			add_filter (s->priv);
@@ -1135,6 +1471,7 @@ static void parse_pmt (const unsigned char *buf, int section_length, int service
 {
 	int program_info_len;
 	struct service *s;
+	struct descriptor_index idx;
         char msg_buf[14 * AUDIO_CHAN_MAX + 1];
         char *tmp;
         int i;
@@ -1186,12 +1523,14 @@ static void parse_pmt (const unsigned char *buf, int section_length, int service
 			moreverbose("  DSM-CC    : PID 0x%04x\n", elementary_pid);
 			break;
 		case 0x06:
-			if (find_descriptor(0x56, buf + 5, ES_info_len, NULL, NULL)) {
+			/* one walk of the loop for all the tags asked for */
+			descriptor_index_build(&idx, buf + 5, ES_info_len);
+			if (descriptor_index_has(&idx, 0x56)) {
 				moreverbose("  TELETEXT  : PID 0x%04x\n", elementary_pid);
 				s->teletext_pid = elementary_pid;
 				break;
 			}
-			else if (find_descriptor(0x59, buf + 5, ES_info_len, NULL, NULL)) {
+			else if (descriptor_index_has(&idx, 0x59)) {
 				/* Note: The subtitling descriptor can also signal
 				 * teletext subtitling, but then the teletext descriptor
 				 * will also be present; so we can be quite confident
@@ -1201,7 +1540,7 @@ static void parse_pmt (const unsigned char *buf, int section_length, int service
 				s->subtitling_pid = elementary_pid;
 				break;
 			}
-			else if (find_descriptor(0x6a, buf + 5, ES_info_len, NULL, NULL)) {
+			else if (descriptor_index_has(&idx, 0x6a)) {
 				moreverbose("  AC3       : PID 0x%04x\n", elementary_pid);
 				s->ac3_pid = elementary_pid;
 				break;
@@ -1236,7 +1575,8 @@ static void parse_pmt (const unsigned char *buf, int section_length, int service
 }
 
 
-static void parse_nit (const unsigned char *buf, int section_length, int network_id)
+static void parse_nit (const unsigned char *buf, int section_length,
+		       int table_id, int network_id)
 {
 	int descriptors_loop_len = ((buf[0] & 0x0f) << 8) | buf[1];
 
@@ -1278,12 +1618,33 @@ static void parse_nit (const unsigned char *buf, int section_length, int network
 
 		parse_descriptors (NIT, buf + 6, descriptors_loop_len, &tn);
 
-		if (tn.type == fe_info.type) {
+		/* -B: the NIT actual has the exact parameters of a carrier the
+		 * sweep could only estimate */
+		if (table_id == 0x40 && current_tp->blind && tn.type == FE_QPSK &&
+		    tn.polarisation == current_tp->polarisation &&
+		    (uint32_t) abs((int) (tn.param.frequency - current_tp->param.frequency)) <
+		    current_tp->blind_width / 2 + TP_FREQUENCY_TOLERANCE) {
+			copy_transponder(current_tp, &tn);
+			current_tp->blind = 0;
+		}
+
+		if (tn.type == current_adapter->fe_info.type) {
 			/* only add if develivery_descriptor matches FE type */
 			t = find_transponder(tn.param.frequency);
 			if (!t)
 				t = alloc_transponder(tn.param.frequency);
 			copy_transponder(t, &tn);
+
+			if (fast_scan && !t->home && !t->discovered) {
+				t->discovered = 1;
+				/* -F list: its services all come from SDT others,
+				 * -F fastscan from the FST */
+				if (fast_scan == FAST_LIST ||
+				    (fast_scan == FAST_OPERATOR && !fastscan_verify)) {
+					list_del_init(&t->list);
+					list_add_tail(&t->list, &scanned_transponders);
+				}
+			}
 		}
 
 		section_length -= descriptors_loop_len + 6;
@@ -1293,9 +1654,13 @@ static void parse_nit (const unsigned char *buf, int section_length, int network
 
 
 static void parse_sdt (const unsigned char *buf, int section_length,
-		int transport_stream_id)
+		int table_id, int transport_stream_id)
 {
-	(void)transport_stream_id;
+	struct transponder *tp = current_tp;
+
+	/* -F: an SDT other is for the TP with its onid/tsid, wherever it is */
+	if (table_id == 0x46)
+		tp = other_transponder((buf[0] << 8) | buf[1], transport_stream_id);
 
 	buf += 3;	       /*  skip original network id + reserved field */
 
@@ -1313,10 +1678,10 @@ static void parse_sdt (const unsigned char *buf, int section_length,
 			break;
 		}
 
-		s = find_service(current_tp, service_id);
+		s = find_service(tp, service_id);
 		if (!s)
 			/* maybe PAT has not yet been parsed... */
-			s = alloc_service(current_tp, service_id);
+			s = alloc_service(tp, service_id);
 
 		s->running = (buf[3] >> 5) & 0x7;
 		s->scrambled = (buf[3] >> 4) & 1;
@@ -1329,6 +1694,83 @@ static void parse_sdt (const unsigned char *buf, int section_length,
 }
 
 /* ATSC PSIP VCT */
+/**
+ *   -F: only the service lists of a BAT's transport streams are of use
+ */
+static void parse_bat (const unsigned char *buf, int section_length)
+{
+	int descriptors_loop_len = ((buf[0] & 0x0f) << 8) | buf[1];
+
+	if (section_length < descriptors_loop_len + 4)
+		return;
+
+	section_length -= descriptors_loop_len + 4;
+	buf += descriptors_loop_len + 4;
+
+	while (section_length > 6) {
+		struct transponder tn;
+
+		descriptors_loop_len = ((buf[4] & 0x0f) << 8) | buf[5];
+		if (section_length < descriptors_loop_len + 6)
+			break;
+
+		tn.transport_stream_id = (buf[0] << 8) | buf[1];
+		tn.original_network_id = (buf[2] << 8) | buf[3];
+		parse_descriptors (BAT, buf + 6, descriptors_loop_len, &tn);
+
+		section_length -= descriptors_loop_len + 6;
+		buf += descriptors_loop_len + 6;
+	}
+}
+
+/**
+ *   -F fastscan: the operator's service list (FST). Each service has a
+ *   fixed part with its onid, tsid and service_id and its default video,
+ *   audio, ECM and PCR PIDs, then descriptors as in the SDT. The TPs it is
+ *   on are those of the FNT, which is a NIT in all but its table_id.
+ */
+static int fst_pid (const unsigned char *buf)
+{
+	int pid = ((buf[0] & 0x1f) << 8) | buf[1];
+
+	return pid == 0x1fff ? 0 : pid;
+}
+
+static void parse_fst (const unsigned char *buf, int section_length)
+{
+	while (section_length >= 18) {
+		int service_id = (buf[4] << 8) | buf[5];
+		int descriptors_loop_len = ((buf[16] & 0x0f) << 8) | buf[17];
+		struct transponder *tp;
+		struct service *s;
+
+		if (section_length < descriptors_loop_len + 18) {
+			warning("section too short: service_id == 0x%04x, section_length == %i, "
+			     "descriptors_loop_len == %i\n",
+			     service_id, section_length, descriptors_loop_len);
+			break;
+		}
+
+		tp = other_transponder((buf[0] << 8) | buf[1], (buf[2] << 8) | buf[3]);
+		if (!(s = find_service(tp, service_id)))
+			s = alloc_service(tp, service_id);
+
+		s->video_pid = fst_pid(buf + 6);
+		if (fst_pid(buf + 8) && !s->audio_num) {
+			s->audio_pid[0] = fst_pid(buf + 8);
+			s->audio_num = 1;
+		}
+		s->scrambled = fst_pid(buf + 10) || fst_pid(buf + 12);
+		s->pcr_pid = fst_pid(buf + 14);
+		s->running = RM_RUNNING;
+
+		parse_descriptors (SDT, buf + 18, descriptors_loop_len, s);
+
+		section_length -= descriptors_loop_len + 18;
+		buf += descriptors_loop_len + 18;
+	}
+}
+
 static void parse_atsc_service_loc_desc(struct service *s,const unsigned char *buf)
 {
 	struct ATSC_service_location_descriptor d = read_ATSC_service_location_descriptor(buf);
@@ -1377,11 +1819,7 @@ static void parse_atsc_ext_chan_name_desc(struct service *s,const unsigned char
 
 			switch (comp_type) {
 				case 0x00:
-					if (s->service_name)
-						free(s->service_name);
-					s->service_name = malloc(num_bytes * sizeof(char) + 1);
-					memcpy(s->service_name,&b[3],num_bytes);
-					s->service_name[num_bytes] = '\0';
+					name_set(&s->service_name, strndup((char *) &b[3], num_bytes));
 					break;
 				default:
 					warning("compressed strings are not supported yet\n");
@@ -1426,6 +1864,7 @@ static void parse_psip_vct (const unsigned char *buf, int section_length,
 	int i;
 	int pseudo_id = 0xffff;
 	unsigned char *b = (unsigned char *) buf + 2;
+	char short_name[8];
 
 	for (i = 0; i < num_channels_in_section; i++) {
 		struct service *s;
@@ -1450,18 +1889,16 @@ static void parse_psip_vct (const unsigned char *buf, int section_length,
 		if (!s)
 			s = alloc_service(current_tp, ch.program_number);
 
-		if (s->service_name)
-			free(s->service_name);
-
-		s->service_name = malloc(7*sizeof(unsigned char));
 		/* TODO find a better solution to convert UTF-16 */
-		s->service_name[0] = ch.short_name0;
-		s->service_name[1] = ch.short_name1;
-		s->service_name[2] = ch.short_name2;
-		s->service_name[3] = ch.short_name3;
-		s->service_name[4] = ch.short_name4;
-		s->service_name[5] = ch.short_name5;
-		s->service_name[6] = ch.short_name6;
+		short_name[0] = ch.short_name0;
+		short_name[1] = ch.short_name1;
+		short_name[2] = ch.short_name2;
+		short_name[3] = ch.short_name3;
+		short_name[4] = ch.short_name4;
+		short_name[5] = ch.short_name5;
+		short_name[6] = ch.short_name6;
+		short_name[7] = '\0';
+		name_set(&s->service_name, strdup(short_name));
 
 		parse_psip_descriptors(s,&b[32],ch.descriptors_length);
 
@@ -1492,15 +1929,27 @@ static void set_bit (uint8_t *bitfield, int bit)
 	bitfield[bit/8] |= 1 << (bit % 8);
 }
 
+/**
+ *   the tables whose version is kept per TP for -I, or -1
+ */
+static int versioned_table (int table_id)
+{
+	switch (table_id) {
+	case 0x00: return PAT;
+	case 0x42: return SDT;
+	case 0x40: return NIT;
+	default:   return -1;
+	}
+}
+
 
 /**
  *   returns 0 when more sections are expected
  *	   1 when all sections are read on this pid
  *	   -1 on invalid table id
  */
-static int parse_section (struct section_buf *s)
+static int parse_section (struct section_buf *s, const unsigned char *buf)
 {
-	const unsigned char *buf = s->buf;
 	int table_id;
 	int section_length;
 	int table_id_ext;
@@ -1531,6 +1980,8 @@ static int parse_section (struct section_buf *s)
 		if (s->table_id_ext != table_id_ext) {
 			assert(s->next_seg == NULL);
 			s->next_seg = calloc(1, sizeof(struct section_buf));
+			s->next_seg->adapter = s->adapter;
+			s->next_seg->tp = s->tp;
 			s->next_seg->segmented = s->segmented;
 			s->next_seg->run_once = s->run_once;
 			s->next_seg->timeout = s->timeout;
@@ -1541,6 +1992,14 @@ static int parse_section (struct section_buf *s)
 		}
 	}
 
+	if (s->probe) {
+		/* -I: the version is all we are after */
+		if ((i = versioned_table(table_id)) >= 0)
+			s->tp->probe_version[i] = section_version_number;
+		s->sectionfilter_done = 1;
+		return 1;
+	}
+
 	if (s->section_version_number != section_version_number ||
 			s->table_id_ext != table_id_ext) {
 		struct section_buf *next_seg = s->next_seg;
@@ -1573,14 +2032,19 @@ static int parse_section (struct section_buf *s)
 		    s->pid, table_id, table_id_ext, section_number,
 		    last_section_number, section_version_number);
 
+		if ((i = versioned_table(table_id)) >= 0)
+			s->tp->version[i] = section_version_number;
+
 		switch (table_id) {
 		case 0x00:
 			verbose("PAT\n");
+			dvblatency_mark(&s->adapter->latency, DVBLATENCY_FIRST_PAT);
 			parse_pat (buf, section_length, table_id_ext);
 			break;
 
 		case 0x02:
 			verbose("PMT 0x%04x for service 0x%04x\n", s->pid, table_id_ext);
+			dvblatency_mark(&s->adapter->latency, DVBLATENCY_FIRST_PMT);
 			parse_pmt (buf, section_length, table_id_ext);
 			break;
 
@@ -1588,13 +2052,28 @@ static int parse_section (struct section_buf *s)
 			verbose("////////////////////////////////////////////// NIT other\n");
 		case 0x40:
 			verbose("NIT (%s TS)\n", table_id == 0x40 ? "actual":"other");
-			parse_nit (buf, section_length, table_id_ext);
+			parse_nit (buf, section_length, table_id, table_id_ext);
 			break;
 
 		case 0x42:
 		case 0x46:
 			verbose("SDT (%s TS)\n", table_id == 0x42 ? "actual":"other");
-			parse_sdt (buf, section_length, table_id_ext);
+			parse_sdt (buf, section_length, table_id, table_id_ext);
+			break;
+
+		case 0x4a:
+			verbose("BAT 0x%04x\n", table_id_ext);
+			parse_bat (buf, section_length);
+			break;
+
+		case 0xbc:
+			verbose("FNT 0x%04x\n", table_id_ext);
+			parse_nit (buf, section_length, table_id, table_id_ext);
+			break;
+
+		case 0xbd:
+			verbose("FST 0x%04x\n", table_id_ext);
+			parse_fst (buf, section_length);
 			break;
 
 		case 0xc8:
@@ -1627,6 +2106,24 @@ static int parse_section (struct section_buf *s)
 }
 
 
+static int handle_section (struct section_buf *s, const unsigned char *buf)
+{
+	/* the parsers add to whichever transponder this filter belongs to */
+	current_tp = s->tp;
+	current_adapter = s->adapter;
+
+	if (parse_section(s, buf) == 1)
+		return 1;
+
+	return 0;
+}
+
+
+/* every section is parsed as soon as it is read, so one buffer does for
+ * all the filters; PSI/SI sections are up to 1024 bytes, the private ones of
+ * FastScan up to 4096 */
+static unsigned char section_buffer[4096];
+
 static int read_sections (struct section_buf *s)
 {
 	int section_length, count;
@@ -1635,10 +2132,13 @@ static int read_sections (struct section_buf *s)
 		return 1;
 
 	/* the section filter API guarantess that we get one full section
-	 * per read(), provided that the buffer is large enough (it is)
+	 * per read(), provided that the buffer is large enough (it is);
+	 * after an overflow, which grows the filter's kernel buffer, there
+	 * may be nothing left
 	 */
-	if (((count = read (s->fd, s->buf, sizeof(s->buf))) < 0) && errno == EOVERFLOW)
-		count = read (s->fd, s->buf, sizeof(s->buf));
+	count = dvbdemuxbuf_read (demuxbufs, s->fd, section_buffer, sizeof(section_buffer));
+	if ((count < 0) && (errno == EAGAIN))
+		return 0;
 	if (count < 0) {
 		errorn("read_sections: read error");
 		return -1;
@@ -1647,44 +2147,119 @@ static int read_sections (struct section_buf *s)
 	if (count < 4)
 		return -1;
 
-	section_length = ((s->buf[1] & 0x0f) << 8) | s->buf[2];
+	section_length = ((section_buffer[1] & 0x0f) << 8) | section_buffer[2];
 
 	if (count != section_length + 3)
 		return -1;
 
-	if (parse_section(s) == 1)
-		return 1;
-
-	return 0;
+	return handle_section(s, section_buffer);
 }
 
 
 static LIST_HEAD(running_filters);
-static LIST_HEAD(waiting_filters);
 static int n_running;
-#define MAX_RUNNING 27
-static struct pollfd poll_fds[MAX_RUNNING];
-static struct section_buf* poll_section_bufs[MAX_RUNNING];
+static int epoll_fd = -1;
+#define MAX_EVENTS 64
+
+/**
+ *   how long each table took to arrive complete, learned per delivery
+ *   system: once a few have been seen, filter timeouts are cut from the
+ *   conservative defaults (or the -5 ones) down to what the network
+ *   actually needs.
+ */
+struct repetition {
+	int samples;
+	int max_time;		/* slowest complete table seen, in seconds */
+};
 
+#define REP_MIN_SAMPLES 3
+#define REP_CLASSES 5
 
-static void setup_filter (struct section_buf* s, const char *dmx_devname,
-			  int pid, int tid, int tid_ext,
-			  int run_once, int segmented, int timeout)
+static struct repetition repetition[FE_ATSC + 1][REP_CLASSES];
+
+static struct repetition *find_repetition (struct section_buf *s)
 {
-	memset (s, 0, sizeof(struct section_buf));
+	int type = s->adapter->fe_info.type;
+	int c;
+
+	if (s->segmented || (type < 0) || (type > FE_ATSC))
+		return NULL;
+
+	switch (s->table_id) {
+	case 0x00: c = 0; break;		/* PAT */
+	case 0x02: c = 1; break;		/* PMT */
+	case 0x42: c = 2; break;		/* SDT */
+	case 0x40: c = 3; break;		/* NIT */
+	case 0xc8:
+	case 0xc9: c = 4; break;		/* VCT */
+	default:
+		return NULL;
+	}
 
-	s->fd = -1;
-	s->dmx_devname = dmx_devname;
-	s->pid = pid;
-	s->table_id = tid;
+	return &repetition[type][c];
+}
 
-	s->run_once = run_once;
-	s->segmented = segmented;
+/**
+ *   a filter got its whole table: remember how long that took
+ */
+static void learn_repetition (struct section_buf *s)
+{
+	struct repetition *r = find_repetition (s);
+	int t = time(NULL) - s->start_time;
+
+	/* a probe only waits for one section, not the whole table */
+	if (!r || s->probe)
+		return;
+	if (t > r->max_time)
+		r->max_time = t;
+	r->samples++;
+}
+
+/**
+ *   a filter timed out: the table may just be slower than what we learned,
+ *   so go back to the default timeout
+ */
+static void forget_repetition (struct section_buf *s)
+{
+	struct repetition *r = find_repetition (s);
+
+	if (r && r->samples) {
+		verbosedebug("forget repetition rate of table_id 0x%02x\n", s->table_id);
+		r->samples = 0;
+		r->max_time = 0;
+	}
+}
+
+static int filter_timeout (struct section_buf *s, int timeout)
+{
+	struct repetition *r = find_repetition (s);
+	int t;
 
 	if (long_timeout)
-		s->timeout = 5 * timeout;
-	else
-		s->timeout = timeout;
+		timeout *= 5;
+	if (!r || (r->samples < REP_MIN_SAMPLES))
+		return timeout;
+
+	t = 2 * r->max_time + 2;
+	return t < timeout ? t : timeout;
+}
+
+
+static void setup_filter (struct section_buf* s, struct scan_adapter *a,
+			  int pid, int tid, int tid_ext,
+			  int run_once, int segmented, int timeout)
+{
+	memset (s, 0, sizeof(struct section_buf));
+
+	s->fd = -1;
+	s->adapter = a;
+	s->tp = current_tp;
+	s->pid = pid;
+	s->table_id = tid;
+
+	s->run_once = run_once;
+	s->segmented = segmented;
+	s->timeout = filter_timeout (s, timeout);
 
 	s->table_id_ext = tid_ext;
 	s->section_version_number = -1;
@@ -1692,41 +2267,88 @@ static void setup_filter (struct section_buf* s, const char *dmx_devname,
 	INIT_LIST_HEAD (&s->list);
 }
 
-static void update_poll_fds(void)
+/**
+ *   insert a filter into an adapter's waiting queue, most urgent first:
+ *   filters with short timeouts (PAT, PMT, SDT) get started before the
+ *   slow ones (NIT) when a demux slot frees up.
+ */
+static void queue_filter (struct section_buf *s)
 {
-	struct list_head *p;
-	struct section_buf* s;
-	int i;
+	struct list_head *pos;
+	struct section_buf *w;
+
+	list_for_each (pos, &s->adapter->waiting_filters) {
+		w = list_entry (pos, struct section_buf, list);
+		if (s->timeout < w->timeout)
+			break;
+	}
+	/* insert before pos (or at the tail if we ran off the end) */
+	list_add_tail (&s->list, pos);
+}
+
+static void filter_running (struct section_buf *s)
+{
+	s->sectionfilter_done = 0;
+	time(&s->start_time);
+	if (capture_file)
+		s->start_pos = ts_tap_position (s->adapter->tap);
+
+	list_del_init (&s->list);  /* might be in waiting filter list */
+	list_add (&s->list, &running_filters);
 
-	memset(poll_section_bufs, 0, sizeof(poll_section_bufs));
-	for (i = 0; i < MAX_RUNNING; i++)
-		poll_fds[i].fd = -1;
-	i = 0;
-	list_for_each (p, &running_filters) {
-		if (i >= MAX_RUNNING)
-			fatal("too many poll_fds\n");
-		s = list_entry (p, struct section_buf, list);
-		if (s->fd == -1)
-			fatal("s->fd == -1 on running_filters\n");
-		verbosedebug("poll fd %d\n", s->fd);
-		poll_fds[i].fd = s->fd;
-		poll_fds[i].events = POLLIN;
-		poll_fds[i].revents = 0;
-		poll_section_bufs[i] = s;
-		i++;
-	}
-	if (i != n_running)
-		fatal("n_running is hosed\n");
+	n_running++;
+	s->adapter->n_running++;
+}
+
+/**
+ *   -T mode: instead of a section filter, the filter's PID is added to the
+ *   adapter's TS tap and sections are matched up in tap_section()
+ */
+static int start_tap_filter (struct section_buf *s)
+{
+	struct scan_adapter *a = s->adapter;
+	int err;
+
+	verbosedebug("start tap filter pid 0x%04x table_id 0x%02x\n", s->pid, s->table_id);
+
+	if ((err = ts_tap_add_pid (a->tap, s->pid)) < 0) {
+		/* out of PID filters: wait for a PID to be released */
+		if (((err == -ENOSPC) || (err == -EBUSY)) && a->n_running)
+			return -EAGAIN;
+		return err;
+	}
+
+	s->fd = -1;
+	filter_running (s);
+
+	return 0;
 }
 
+/**
+ *   returns 0 on success, -EAGAIN if the demux is out of filters and
+ *   the filter should wait, or another negative value on hard failure
+ */
 static int start_filter (struct section_buf* s)
 {
+	struct scan_adapter *a = s->adapter;
 	struct dmx_sct_filter_params f;
-
-	if (n_running >= MAX_RUNNING)
-		goto err0;
-	if ((s->fd = open (s->dmx_devname, O_RDWR | O_NONBLOCK)) < 0)
+	struct epoll_event ev;
+	int err;
+
+	if (a->n_running >= a->max_running)
+		return -EAGAIN;
+	if (ts_mode)
+		return start_tap_filter (s);
+	if ((s->fd = open (a->demux_devname, O_RDWR | O_NONBLOCK)) < 0) {
+		err = errno;
 		goto err0;
+	}
+	/* filters for the same table start at the size the last one needed */
+	if (dvbdemuxbuf_add (demuxbufs, s->fd, s->pid | ((s->table_id & 0xff) << 13))) {
+		err = errno;
+		errorn ("setting the demux buffer failed");
+		goto err1;
+	}
 
 	verbosedebug("start filter pid 0x%04x table_id 0x%02x\n", s->pid, s->table_id);
 
@@ -1749,90 +2371,234 @@ static int start_filter (struct section_buf* s)
 	f.flags = DMX_IMMEDIATE_START | DMX_CHECK_CRC;
 
 	if (ioctl(s->fd, DMX_SET_FILTER, &f) == -1) {
-		errorn ("ioctl DMX_SET_FILTER failed");
+		err = errno;
+		if ((err != ENOSPC) && (err != EBUSY))
+			errorn ("ioctl DMX_SET_FILTER failed");
 		goto err1;
 	}
 
-	s->sectionfilter_done = 0;
-	time(&s->start_time);
-
-	list_del_init (&s->list);  /* might be in waiting filter list */
-	list_add (&s->list, &running_filters);
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = s;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, s->fd, &ev) == -1) {
+		err = errno;
+		errorn ("epoll_ctl failed");
+		goto err1;
+	}
 
-	n_running++;
-	update_poll_fds();
+	filter_running (s);
 
 	return 0;
 
 err1:
 	ioctl (s->fd, DMX_STOP);
+	dvbdemuxbuf_remove (demuxbufs, s->fd);
 	close (s->fd);
+	s->fd = -1;
 err0:
-	return -1;
+	/* out of demux filters (or file descriptors): remember how many this
+	 * demux really handles, and queue the filter instead */
+	if ((err == ENOSPC) || (err == EBUSY) || (err == EMFILE) || (err == ENFILE)) {
+		if (a->n_running) {
+			if (a->max_running != a->n_running)
+				info("%s: limiting to %d section filters\n",
+				     a->demux_devname, a->n_running);
+			a->max_running = a->n_running;
+			return -EAGAIN;
+		}
+	}
+	return -err;
 }
 
 
 static void stop_filter (struct section_buf *s)
 {
 	verbosedebug("stop filter pid 0x%04x\n", s->pid);
-	ioctl (s->fd, DMX_STOP);
-	close (s->fd);
-	s->fd = -1;
+	if (ts_mode) {
+		ts_tap_remove_pid (s->adapter->tap, s->pid);
+	} else {
+		epoll_ctl (epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+		ioctl (s->fd, DMX_STOP);
+		dvbdemuxbuf_remove (demuxbufs, s->fd);
+		close (s->fd);
+		s->fd = -1;
+	}
 	list_del (&s->list);
 	s->running_time += time(NULL) - s->start_time;
 
 	n_running--;
-	update_poll_fds();
+	s->adapter->n_running--;
 }
 
 
 static void add_filter (struct section_buf *s)
 {
+	int rc;
+
 	verbosedebug("add filter pid 0x%04x\n", s->pid);
-	if (start_filter (s))
-		list_add_tail (&s->list, &waiting_filters);
+	if ((rc = start_filter (s)) == 0) {
+		s->adapter->n_filters++;
+	} else if (rc == -EAGAIN) {
+		s->adapter->n_filters++;
+		queue_filter (s);
+	} else {
+		warning("cannot start filter pid 0x%04x: %s\n", s->pid, strerror(-rc));
+	}
 }
 
 
 static void remove_filter (struct section_buf *s)
 {
+	struct scan_adapter *a = s->adapter;
+	int rc;
+
 	verbosedebug("remove filter pid 0x%04x\n", s->pid);
 	stop_filter (s);
+	a->n_filters--;
+
+	/* the state of each table_id_ext of a segmented table: without
+	 * freeing it, each TP scanned would add a set */
+	while (s->next_seg) {
+		struct section_buf *seg = s->next_seg;
 
-	while (!list_empty(&waiting_filters)) {
-		struct list_head *next = waiting_filters.next;
+		s->next_seg = seg->next_seg;
+		free (seg);
+	}
+
+	while (!list_empty(&a->waiting_filters)) {
+		struct list_head *next = a->waiting_filters.next;
 		s = list_entry (next, struct section_buf, list);
-		if (start_filter (s))
+		if ((rc = start_filter (s)) == -EAGAIN)
 			break;
+		if (rc) {
+			warning("cannot start filter pid 0x%04x: %s\n", s->pid, strerror(-rc));
+			list_del_init (&s->list);
+			a->n_filters--;
+		}
 	};
 }
 
 
-static void read_filters (void)
+/**
+ *   hand a section from the TS tap to every running filter of the adapter
+ *   which the demux would have given it to
+ */
+static void tap_section (void *priv, int pid, const unsigned char *buf, int len)
+{
+	struct scan_adapter *a = priv;
+	struct list_head *pos, *tmp;
+	struct section_buf *s;
+
+	if (len < 8 || len > (int) sizeof(section_buffer))
+		return;
+
+	/* filters started from here go on the head of the list, so the
+	 * walk won't see them */
+	list_for_each_safe (pos, tmp, &running_filters) {
+		s = list_entry (pos, struct section_buf, list);
+		if (s->adapter != a || s->pid != pid)
+			continue;
+		if (s->table_id < 0x100 && s->table_id > 0 &&
+		    buf[0] != s->table_id)
+			continue;
+		if (s->table_id_ext < 0x10000 && s->table_id_ext > 0 &&
+		    ((buf[3] << 8) | buf[4]) != s->table_id_ext)
+			continue;
+		if (s->sectionfilter_done && !s->segmented)
+			continue;
+
+		if (handle_section (s, buf) == 1 && s->run_once) {
+			verbosedebug("filter done pid 0x%04x\n", s->pid);
+			learn_repetition (s);
+			remove_filter (s);
+		}
+	}
+}
+
+
+/**
+ *   -r: there is always more of the capture to read, and a filter only
+ *   times out once it has seen all of it
+ */
+static void read_capture (void)
 {
+	struct scan_adapter *a = &adapters[0];
+	struct list_head *pos, *tmp;
 	struct section_buf *s;
-	int i, n, done;
+	uint64_t now;
 
-	n = poll(poll_fds, n_running, 1000);
-	if (n == -1)
-		errorn("poll");
+	if (ts_tap_read (a->tap, tap_section, a) < 0)
+		fatal("out of memory reading the capture\n");
 
-	for (i = 0; i < n_running; i++) {
-		s = poll_section_bufs[i];
-		if (!s)
-			fatal("poll_section_bufs[%d] is NULL\n", i);
-		if (poll_fds[i].revents)
-			done = read_sections (s) == 1;
-		else
-			done = 0; /* timeout */
-		if (done || time(NULL) > s->start_time + s->timeout) {
-			if (s->run_once) {
-				if (done)
-					verbosedebug("filter done pid 0x%04x\n", s->pid);
-				else
-					warning("filter timeout pid 0x%04x\n", s->pid);
-				remove_filter (s);
-			}
+	now = ts_tap_position (a->tap);
+	list_for_each_safe (pos, tmp, &running_filters) {
+		s = list_entry (pos, struct section_buf, list);
+		if (s->run_once && (now - s->start_pos >= ts_tap_size (a->tap))) {
+			warning("filter timeout pid 0x%04x (not in the capture)\n", s->pid);
+			remove_filter (s);
+		}
+	}
+}
+
+
+static void read_filters (int timeout)
+{
+	struct epoll_event events[MAX_EVENTS];
+	struct list_head *pos, *tmp;
+	struct section_buf *s;
+	time_t now, next_deadline = 0;
+	int i, n;
+
+	if (capture_file) {
+		read_capture ();
+		return;
+	}
+
+	/* don't sleep past the next running filter's deadline */
+	list_for_each (pos, &running_filters) {
+		s = list_entry (pos, struct section_buf, list);
+		if (!next_deadline || (s->start_time + s->timeout < next_deadline))
+			next_deadline = s->start_time + s->timeout;
+	}
+	if (next_deadline) {
+		long ms = (next_deadline + 1 - time(NULL)) * 1000L;
+		if (ms < 0)
+			ms = 0;
+		if (ms < timeout)
+			timeout = ms;
+	}
+
+	n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+	if (n == -1 && errno != EINTR)
+		errorn("epoll_wait");
+
+	for (i = 0; i < n; i++) {
+		/* -W: the coordinator's socket, which the caller reads */
+		if (!events[i].data.ptr)
+			continue;
+		if (ts_mode) {
+			struct scan_adapter *a = events[i].data.ptr;
+			if (ts_tap_read (a->tap, tap_section, a) < 0)
+				errorn("read_filters: DVR read error");
+			continue;
+		}
+		s = events[i].data.ptr;
+		if (read_sections (s) == 1 && s->run_once) {
+			verbosedebug("filter done pid 0x%04x\n", s->pid);
+			learn_repetition (s);
+			remove_filter (s);
+		}
+	}
+
+	now = time(NULL);
+	list_for_each_safe (pos, tmp, &running_filters) {
+		s = list_entry (pos, struct section_buf, list);
+		if (s->run_once && (now > s->start_time + s->timeout)) {
+			warning("filter timeout pid 0x%04x\n", s->pid);
+			forget_repetition (s);
+			/* any waiting filters this starts go on the head
+			 * of the list, so the walk won't see them */
+			remove_filter (s);
 		}
 	}
 }
@@ -1853,14 +2619,212 @@ static int mem_is_zero (const void *mem, int size)
 
 
 static int switch_pos = 0;
+static int use_rotor;			/* -R */
+static struct rotor rotor_site;
+static int initial_orbital_pos = -1;	/* -O, in 0.1 degrees */
+static int initial_we_flag;
+static int blind_scan;			/* -B */
+static uint32_t blind_lo, blind_hi;	/* -B, in kHz */
+static uint32_t blind_step;
+
+static long time_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (tv.tv_sec * 1000L) + (tv.tv_usec / 1000);
+}
+
+/* time allowed for an FE_SET_FRONTEND to achieve lock */
+#define TUNE_LOCK_TIMEOUT_MS 2000
+
+/* time allowed to find a carrier, if the frontend is known to report one */
+#define TUNE_SIGNAL_TIMEOUT_MS 500
+
+/* time given to the switch after a DiSEqC sequence */
+#define SWITCH_SETTLE_MS 50
 
-static int __tune_to_transponder (int frontend_fd, struct transponder *t)
+/**
+ *   throw away queued frontend events (they are only used as wakeups)
+ */
+static void flush_frontend_events (struct scan_adapter *a)
 {
-	struct dvb_frontend_parameters p;
-	fe_status_t s;
+	struct dvb_frontend_event ev;
+
+	while ((ioctl(a->frontend_fd, FE_GET_EVENT, &ev) == 0) || (errno == EOVERFLOW))
+		;
+}
+
+/**
+ *   sleep until the frontend status changes, or at most timeout ms
+ */
+static void wait_frontend_event (struct scan_adapter *a, int timeout)
+{
+	struct pollfd pfd;
+
+	pfd.fd = a->frontend_fd;
+	pfd.events = POLLPRI;
+	if (poll(&pfd, 1, timeout) > 0)
+		flush_frontend_events (a);
+}
+
+/**
+ *   the DiSEqC switch index setup_switch() is given for a TP, or -1 if the
+ *   LNB has no switch
+ */
+static int transponder_switch_index (struct transponder *t)
+{
+	if ((t->type != FE_QPSK) || !lnb_type.high_val || !lnb_type.switch_val)
+		return -1;
+
+	return 4 * switch_pos +
+	       2 * (t->param.frequency >= lnb_type.switch_val ? 1 : 0) +
+	       (t->polarisation == POLARISATION_VERTICAL ? 0 : 1);
+}
+
+/**
+ *   motor angle of a TP's satellite; returns -1 if there is no rotor, or
+ *   it isn't known which satellite the TP is on
+ */
+static int transponder_angle (struct scan_adapter *a, struct transponder *t,
+			      double *angle)
+{
+	if (!use_rotor || (t->type != FE_QPSK) || !t->orbital_known)
+		return -1;
+
+	*angle = rotor_angle (&a->rotor, t->orbital_pos / (t->we_flag ? 10.0 : -10.0));
+	return 0;
+}
+
+/**
+ *   estimated ms before an adapter can start tuning a TP, moving the dish
+ *   and setting the switch
+ */
+static long transponder_cost (struct scan_adapter *a, struct transponder *t)
+{
+	long cost = 0;
+	double angle;
+	int i;
+
+	if (transponder_angle (a, t, &angle) == 0)
+		cost += rotor_travel_ms (&a->rotor, angle);
+	if (((i = transponder_switch_index (t)) != -1) && (i != a->switch_index))
+		cost += SWITCH_SETTLE_MS;
+
+	return cost;
+}
+
+/**
+ *   the TP an adapter should tune next: one it can tune without switching
+ *   delivery system, and of those the one it gets to soonest. So TPs are
+ *   taken a satellite, band and polarisation at a time, and the rotor
+ *   always goes on to the nearest satellite left; the route can only be
+ *   planned one step at a time, as the NITs keep adding TPs. Ties are
+ *   broken by list order.
+ */
+static struct transponder *next_transponder (struct scan_adapter *a)
+{
+	struct list_head *pos;
+	struct transponder *t, *best = NULL;
+	long cost, best_cost = 0;
+	int home = 0;
 	int i;
 
+	if (list_empty(&new_transponders))
+		return NULL;
+
+	/* -F: the home TPs' SDT others name the services of the others, so
+	 * those have to wait until they are all done
+	 */
+	if (fast_scan) {
+		list_for_each(pos, &new_transponders) {
+			if (list_entry (pos, struct transponder, list)->home) {
+				home = 1;
+				break;
+			}
+		}
+		for (i = 0; !home && i < n_adapters; i++) {
+			if (adapters[i].state != ADAPTER_IDLE &&
+			    adapters[i].tp && adapters[i].tp->home)
+				return NULL;
+		}
+	}
+
+	list_for_each(pos, &new_transponders) {
+		t = list_entry (pos, struct transponder, list);
+		if (t->type != a->fe_info.type)
+			continue;
+		if (home && !t->home)
+			continue;
+
+		cost = transponder_cost (a, t);
+		if (!best || (cost < best_cost)) {
+			best = t;
+			best_cost = cost;
+			if (cost == 0)
+				break;
+		}
+	}
+
+	if (!best) {
+		list_for_each(pos, &new_transponders) {
+			best = list_entry (pos, struct transponder, list);
+			if (!home || best->home)
+				break;
+		}
+	}
+	return best;
+}
+
+/**
+ *   DVB-S: set the switch for a TP's band and polarisation, and turn its
+ *   frequency in p into the IF
+ */
+static void lnb_setup (struct scan_adapter *a, struct transponder *t,
+		       struct dvb_frontend_parameters *p)
+{
+	if (lnb_type.high_val) {
+		if (lnb_type.switch_val) {
+			/* Voltage-controlled switch */
+			int hiband = 0;
+
+			if (p->frequency >= lnb_type.switch_val)
+				hiband = 1;
+
+			/* nothing is sent, and there's nothing to wait
+			 * for, if the switch is already set this way */
+			dvblatency_mark(&a->latency, DVBLATENCY_DISEQC_SENT);
+			if (setup_switch (a->frontend_fd,
+					  &a->switch_index,
+					  switch_pos,
+					  t->polarisation == POLARISATION_VERTICAL ? 0 : 1,
+					  hiband) != 1)
+				usleep(SWITCH_SETTLE_MS * 1000);
+			if (hiband)
+				p->frequency = abs(p->frequency - lnb_type.high_val);
+			else
+				p->frequency = abs(p->frequency - lnb_type.low_val);
+		} else {
+			/* C-Band Multipoint LNBf */
+			p->frequency = abs(p->frequency - (t->polarisation == POLARISATION_VERTICAL ?
+					lnb_type.low_val: lnb_type.high_val));
+		}
+	} else	{
+		/* Monopoint LNBf without switch */
+		p->frequency = abs(p->frequency - lnb_type.low_val);
+	}
+}
+
+static int __tune_start (struct scan_adapter *a, struct transponder *t)
+{
+	struct dvb_frontend_parameters p;
+	int frontend_fd = a->frontend_fd;
+	int rotor_known = a->rotor.known;
+	long travel = 0;
+	double angle;
+
 	current_tp = t;
+	current_adapter = a;
 
 	if (mem_is_zero (&t->param, sizeof(struct dvb_frontend_parameters)))
 		return -1;
@@ -1875,58 +2839,84 @@ static int __tune_to_transponder (int frontend_fd, struct transponder *t)
 		dprintf(1, "\n");
 	}
 
-	if (t->type == FE_QPSK) {
-		if (lnb_type.high_val) {
-			if (lnb_type.switch_val) {
-				/* Voltage-controlled switch */
-				int hiband = 0;
-
-				if (p.frequency >= lnb_type.switch_val)
-					hiband = 1;
-
-				setup_switch (frontend_fd,
-					      switch_pos,
-					      t->polarisation == POLARISATION_VERTICAL ? 0 : 1,
-					      hiband);
-				usleep(50000);
-				if (hiband)
-					p.frequency = abs(p.frequency - lnb_type.high_val);
-				else
-					p.frequency = abs(p.frequency - lnb_type.low_val);
-			} else {
-				/* C-Band Multipoint LNBf */
-				p.frequency = abs(p.frequency - (t->polarisation == POLARISATION_VERTICAL ?
-						lnb_type.low_val: lnb_type.high_val));
-			}
-		} else	{
-			/* Monopoint LNBf without switch */
-			p.frequency = abs(p.frequency - lnb_type.low_val);
+	if (transponder_angle (a, t, &angle) == 0) {
+		if ((travel = rotor_goto (frontend_fd, &a->rotor, angle)) < 0) {
+			errno = -travel;
+			errorn("DiSEqC rotor command failed");
+			return -1;
 		}
+		/* the tone was turned off for the command */
+		if (travel)
+			a->switch_index = -1;
+		a->rotor = rotor_site;
+	}
+
+	if (t->type == FE_QPSK) {
+		lnb_setup (a, t, &p);
 		if (verbosity >= 2)
 			dprintf(1,"DVB-S IF freq is %d\n",p.frequency);
 	}
 
+	flush_frontend_events (a);
+
 	if (ioctl(frontend_fd, FE_SET_FRONTEND, &p) == -1) {
 		errorn("Setting frontend parameters failed");
 		return -1;
 	}
 
-	for (i = 0; i < 10; i++) {
-		usleep (200000);
+	dvblatency_mark(&a->latency, DVBLATENCY_TUNE_ISSUED);
+	a->tune_start = time_ms();
+	a->lock_after = 0;
+
+	/* the frontend is tuned straight away, to lock as soon as the dish
+	 * gets there, but the timeouts only start when it should have, with
+	 * some slack for a slow motor. When the dish came from a known
+	 * bearing, an earlier lock can only be a satellite on its way. */
+	if (travel > 0) {
+		if (rotor_known)
+			a->lock_after = a->tune_start + travel;
+		a->tune_start += travel + travel / 4;
+	}
+	return 0;
+}
+
+/**
+ *   returns 1 when locked, 0 while still waiting, -1 on failure,
+ *   -2 when there is not even a carrier (no point in retrying)
+ */
+static int __tune_check_lock (struct scan_adapter *a, struct transponder *t)
+{
+	fe_status_t s;
+	long elapsed;
 
-		if (ioctl(frontend_fd, FE_READ_STATUS, &s) == -1) {
-			errorn("FE_READ_STATUS failed");
-			return -1;
-		}
+	if (ioctl(a->frontend_fd, FE_READ_STATUS, &s) == -1) {
+		errorn("FE_READ_STATUS failed");
+		return -1;
+	}
 
-		verbose(">>> tuning status == 0x%02x\n", s);
+	verbose(">>> tuning status == 0x%02x\n", s);
 
-		if (s & FE_HAS_LOCK) {
-			t->last_tuning_failed = 0;
-			return 0;
-		}
+	if ((s & FE_HAS_LOCK) && (time_ms() >= a->lock_after)) {
+		dvblatency_mark(&a->latency, DVBLATENCY_LOCKED);
+		/* only trust a missing carrier on frontends which report one */
+		if (s & (FE_HAS_SIGNAL | FE_HAS_CARRIER))
+			a->fe_reports_signal = 1;
+		t->last_tuning_failed = 0;
+		return 1;
+	}
+
+	elapsed = time_ms() - a->tune_start;
+
+	if (a->fe_reports_signal && !(s & (FE_HAS_SIGNAL | FE_HAS_CARRIER)) &&
+	    (elapsed >= TUNE_SIGNAL_TIMEOUT_MS)) {
+		warning(">>> tuning failed, no signal\n");
+		t->last_tuning_failed = 1;
+		return -2;
 	}
 
+	if (elapsed < TUNE_LOCK_TIMEOUT_MS)
+		return 0;
+
 	warning(">>> tuning failed!!!\n");
 
 	t->last_tuning_failed = 1;
@@ -1934,11 +2924,27 @@ static int __tune_to_transponder (int frontend_fd, struct transponder *t)
 	return -1;
 }
 
-static int set_delivery_system(int fd, unsigned type)
+static int __tune_to_transponder (struct scan_adapter *a, struct transponder *t)
 {
-	struct dtv_properties props;
-	struct dtv_property dvb_prop[1];
-	unsigned delsys;
+	int rc;
+
+	if (__tune_start (a, t))
+		return -1;
+
+	/* most drivers signal each status change, so this returns as soon
+	 * as there is a lock; poll anyway for those which don't */
+	do {
+		wait_frontend_event (a, 200);
+	} while ((rc = __tune_check_lock (a, t)) == 0);
+
+	return rc == 1 ? 0 : rc;
+}
+
+static int set_delivery_system(int fd, unsigned type)
+{
+	struct dtv_properties props;
+	struct dtv_property dvb_prop[1];
+	unsigned delsys;
 
 	switch (type) {
 		case FE_QPSK:
@@ -1966,7 +2972,10 @@ static int set_delivery_system(int fd, unsigned type)
 	return errno;
 }
 
-static int tune_to_transponder (int frontend_fd, struct transponder *t)
+/**
+ *   move a TP to the "scanned" list and make sure the frontend can tune it
+ */
+static int claim_transponder (struct scan_adapter *a, struct transponder *t)
 {
 	int rc;
 
@@ -1975,63 +2984,291 @@ static int tune_to_transponder (int frontend_fd, struct transponder *t)
 	list_add_tail(&t->list, &scanned_transponders);
 	t->scan_done = 1;
 
-	if (t->type != fe_info.type) {
-		rc = set_delivery_system(frontend_fd, t->type);
+	if (t->type != a->fe_info.type) {
+		rc = set_delivery_system(a->frontend_fd, t->type);
 		if (!rc)
-			fe_info.type = t->type;
+			a->fe_info.type = t->type;
 	}
 
-	if (t->type != fe_info.type) {
+	if (t->type != a->fe_info.type) {
 		warning("frontend type (%s) is not compatible with requested tuning type (%s)\n",
-				fe_type2str(fe_info.type),fe_type2str(t->type));
+				fe_type2str(a->fe_info.type),fe_type2str(t->type));
 		/* ignore cable descriptors in sat NIT and vice versa */
 		t->last_tuning_failed = 1;
 		return -1;
 	}
 
-	if (__tune_to_transponder (frontend_fd, t) == 0)
+	return 0;
+}
+
+static int tune_to_transponder (struct scan_adapter *a, struct transponder *t)
+{
+	int rc;
+
+	if (claim_transponder (a, t))
+		return -1;
+
+	if ((rc = __tune_to_transponder (a, t)) == 0)
 		return 0;
+	if (rc == -2)
+		return -1;
 
-	return __tune_to_transponder (frontend_fd, t);
+	return __tune_to_transponder (a, t) == 0 ? 0 : -1;
 }
 
-
-static int tune_to_next_transponder (int frontend_fd)
+/**
+ *   switch a TP whose tuning failed to its next untried alternative
+ *   frequency (DVB-T other_frequency_flag), or symbol rate (-B).
+ *   returns 0 if there is one to try, -1 otherwise
+ */
+static int next_other_frequency (struct transponder *t)
 {
-	struct list_head *pos, *tmp;
-	struct transponder *t, *to;
+	struct transponder *to;
 	uint32_t freq;
 
-	list_for_each_safe(pos, tmp, &new_transponders) {
-		t = list_entry (pos, struct transponder, list);
-retry:
-		if (tune_to_transponder (frontend_fd, t) == 0)
-			return 0;
-next:
-		if (t->other_frequency_flag && t->other_f && t->n_other_f) {
-			/* check if the alternate freqeuncy is really new to us */
-			freq = t->other_f[t->n_other_f - 1];
-			t->n_other_f--;
-			if (find_transponder(freq))
-				goto next;
-
-			/* remember tuning to the old frequency failed */
-			to = calloc(1, sizeof(*to));
-			to->param.frequency = t->param.frequency;
-			to->wrong_frequency = 1;
-			INIT_LIST_HEAD(&to->list);
-			INIT_LIST_HEAD(&to->services);
-			list_add_tail(&to->list, &scanned_transponders);
-			copy_transponder(to, t);
-
-			t->param.frequency = freq;
-			info("retrying with f=%d\n", t->param.frequency);
-			goto retry;
-		}
+	if (t->n_blind_sr) {
+		t->param.u.qpsk.symbol_rate = t->blind_sr[--t->n_blind_sr];
+		info("retrying with sr=%u\n", t->param.u.qpsk.symbol_rate);
+		return 0;
 	}
+
+	while (t->other_frequency_flag && t->other_f && t->n_other_f) {
+		/* check if the alternate freqeuncy is really new to us */
+		freq = t->other_f[t->n_other_f - 1];
+		t->n_other_f--;
+		if (find_transponder(freq))
+			continue;
+
+		/* remember tuning to the old frequency failed */
+		to = calloc(1, sizeof(*to));
+		to->param.frequency = t->param.frequency;
+		to->wrong_frequency = 1;
+		INIT_LIST_HEAD(&to->list);
+		INIT_LIST_HEAD(&to->hash);
+		INIT_LIST_HEAD(&to->services);
+		INIT_LIST_HEAD(&to->old_services);
+		list_add_tail(&to->list, &scanned_transponders);
+		copy_transponder(to, t);
+
+		t->param.frequency = freq;
+		hash_transponder(t);
+		info("retrying with f=%d\n", t->param.frequency);
+		return 0;
+	}
+
 	return -1;
 }
 
+static int tune_to_next_transponder (struct scan_adapter *a)
+{
+	struct transponder *t;
+
+	/* tune_to_transponder() always takes t off new_transponders */
+	while ((t = next_transponder (a)) != NULL) {
+		do {
+			if (tune_to_transponder (a, t) == 0)
+				return 0;
+		} while (next_other_frequency (t) == 0);
+	}
+	return -1;
+}
+
+/* time the frontend's AGC gets to settle on each point of the -B sweep */
+#define BLIND_SETTLE_MS 50
+
+/* a carrier has to stand out this far above the noise floor (0-0xffff) */
+#define BLIND_MIN_RISE 0x0400
+
+/* the symbol rates in use, to try near a carrier's estimated one */
+static const uint32_t blind_rates[] = {
+	1000000, 1500000, 2000000, 2200000, 2500000, 2960000, 3000000,
+	3333000, 3600000, 4000000, 4340000, 5000000, 5632000, 6000000,
+	6111000, 6666000, 7200000, 7500000, 8000000, 8333000, 10000000,
+	11000000, 11250000, 12500000, 13333000, 14000000, 14400000,
+	15000000, 17500000, 18000000, 20000000, 22000000, 22500000,
+	23000000, 24500000, 25000000, 26000000, 27500000, 28000000,
+	29500000, 29700000, 29900000, 30000000, 32000000, 34000000,
+	36000000, 38000000, 43000000, 45000000
+};
+
+static int blind_cmp (const void *a, const void *b)
+{
+	return *(const uint16_t *) a - *(const uint16_t *) b;
+}
+
+/**
+ *   -B: make a TP of a carrier spanning sweep points start to end. The
+ *   symbol rate is taken from its width (for a roll-off of 0.35), and the
+ *   standard rates closest to that are tried first.
+ */
+static void blind_candidate (int start, int end, enum polarisation pol)
+{
+	uint32_t width = (end - start + 1) * blind_step;
+	uint32_t freq = blind_lo + (start + end) * blind_step / 2;
+	uint32_t sr = width * 100 / 135 * 1000;
+	uint32_t try[BLIND_MAX_SR];
+	struct transponder *t;
+	unsigned int i, j;
+	int n = 0;
+
+	if ((t = find_transponder (freq)) && (t->polarisation == pol)) {
+		verbose("blind scan: carrier at %u already known\n", freq);
+		return;
+	}
+
+	/* pick the closest standard rates, within a quarter of the estimate */
+	for (i = 0; i < sizeof(blind_rates) / sizeof(blind_rates[0]); i++) {
+		uint32_t diff = (uint32_t) abs((int) (blind_rates[i] - sr));
+
+		if (diff > sr / 4)
+			continue;
+		for (j = n; j > 0; j--) {
+			if ((uint32_t) abs((int) (try[j - 1] - sr)) <= diff)
+				break;
+			if (j < BLIND_MAX_SR)
+				try[j] = try[j - 1];
+		}
+		if (j < BLIND_MAX_SR) {
+			try[j] = blind_rates[i];
+			if (n < BLIND_MAX_SR)
+				n++;
+		}
+	}
+	if (n == 0)
+		try[n++] = sr;
+
+	t = alloc_transponder (freq);
+	t->type = FE_QPSK;
+	t->polarisation = pol;
+	if (initial_orbital_pos != -1) {
+		t->orbital_pos = initial_orbital_pos;
+		t->we_flag = initial_we_flag;
+		t->orbital_known = 1;
+	}
+	t->param.inversion = spectral_inversion;
+	t->param.u.qpsk.symbol_rate = try[0];
+	t->param.u.qpsk.fec_inner = FEC_AUTO;
+	t->blind = 1;
+	t->blind_width = width;
+	/* next_other_frequency() takes them off the end */
+	for (i = 1; i < (unsigned int) n; i++)
+		t->blind_sr[n - 1 - i] = try[i];
+	t->n_blind_sr = n - 1;
+
+	info("blind scan: carrier at %u %c, about %u kHz wide, trying sr=%u\n",
+	     freq, pol == POLARISATION_VERTICAL ? 'V' : 'H', width, try[0]);
+}
+
+/**
+ *   -B: find the carriers in one polarisation's sweep, as runs of points
+ *   well above the noise floor (the median), split where a run dips
+ *   halfway back down between two peaks
+ */
+static void blind_carriers (const uint16_t *level, int n, enum polarisation pol)
+{
+	uint16_t *sorted = malloc (n * sizeof(uint16_t));
+	int floor, max, thresh, peak;
+	int i, start;
+
+	memcpy (sorted, level, n * sizeof(uint16_t));
+	qsort (sorted, n, sizeof(uint16_t), blind_cmp);
+	floor = sorted[n / 2];
+	max = sorted[n - 1];
+	free (sorted);
+
+	if (max - floor < BLIND_MIN_RISE)
+		return;
+	thresh = floor + (max - floor) / 4;
+
+	for (i = 0; i < n; ) {
+		if (level[i] <= thresh) {
+			i++;
+			continue;
+		}
+
+		start = i;
+		peak = level[i++];
+		while (i < n && level[i] > thresh) {
+			if ((i + 1 < n) && (level[i] <= level[i - 1]) &&
+			    (level[i] < level[i + 1]) &&
+			    ((level[i] - floor) * 2 < (peak - floor)))
+				break;
+			if (level[i] > peak)
+				peak = level[i];
+			i++;
+		}
+		blind_candidate (start, i - 1, pol);
+	}
+}
+
+/**
+ *   -B: sweep blind_lo to blind_hi in both polarisations, reading the
+ *   signal strength the tuner's AGC reports at each step, and add a TP for
+ *   each carrier found. The sweep is split between the adapters, which
+ *   are all tuned, then all read, a step at a time.
+ */
+static void blind_sweep (void)
+{
+	int n = (blind_hi - blind_lo) / blind_step + 1;
+	int total = 2 * n;
+	uint16_t *level = calloc (total, sizeof(uint16_t));
+	struct transponder probe;
+	struct dvb_frontend_parameters p;
+	int pos[MAX_ADAPTERS], end[MAX_ADAPTERS];
+	uint16_t strength;
+	int busy, i;
+
+	for (i = 0; i < n_adapters; i++) {
+		if (adapters[i].fe_info.type != FE_QPSK)
+			fatal("blind scan needs DVB-S frontends\n");
+		pos[i] = total * i / n_adapters;
+		end[i] = total * (i + 1) / n_adapters;
+	}
+	info("blind scan of %u-%u in %u kHz steps\n", blind_lo, blind_hi, blind_step);
+
+	memset (&probe, 0, sizeof(probe));
+	probe.type = FE_QPSK;
+	probe.param.inversion = spectral_inversion;
+	/* about as wide as a step, so each point sees just its own part */
+	probe.param.u.qpsk.symbol_rate = blind_step * 100 / 135 * 1000;
+	probe.param.u.qpsk.fec_inner = FEC_AUTO;
+
+	do {
+		busy = 0;
+		for (i = 0; i < n_adapters; i++) {
+			if (pos[i] == end[i])
+				continue;
+			busy = 1;
+
+			probe.polarisation = (pos[i] < n) ? POLARISATION_HORIZONTAL :
+							    POLARISATION_VERTICAL;
+			memcpy (&p, &probe.param, sizeof(p));
+			p.frequency = blind_lo + (pos[i] % n) * blind_step;
+			lnb_setup (&adapters[i], &probe, &p);
+			if (ioctl(adapters[i].frontend_fd, FE_SET_FRONTEND, &p) == -1)
+				errorn("Setting frontend parameters failed");
+		}
+		if (!busy)
+			break;
+
+		usleep (BLIND_SETTLE_MS * 1000);
+		for (i = 0; i < n_adapters; i++) {
+			if (pos[i] == end[i])
+				continue;
+			if (ioctl(adapters[i].frontend_fd, FE_READ_SIGNAL_STRENGTH, &strength) == -1)
+				fatal("FE_READ_SIGNAL_STRENGTH failed: %d %m\n", errno);
+			level[pos[i]++] = strength;
+		}
+	} while (busy);
+
+	for (i = 0; i < n_adapters; i++)
+		flush_frontend_events (&adapters[i]);
+
+	blind_carriers (level, n, POLARISATION_HORIZONTAL);
+	blind_carriers (level + n, n, POLARISATION_VERTICAL);
+	free (level);
+}
+
 struct strtab {
 	const char *str;
 	int val;
@@ -2155,13 +3392,47 @@ static const char * fe_type2str(fe_type_t t)
 	return enum2str(t, typetab, "UNK");
 }
 
-static int tune_initial (int frontend_fd, const char *initial)
+/**
+ *   parse an orbital position such as "19.2E" into 0.1 degrees and a
+ *   west/east flag. returns 0 on success, -1 if it isn't one
+ */
+static int parse_orbital_pos (const char *str, int *orbital_pos, int *we_flag)
+{
+	char *end;
+	double pos;
+
+	pos = strtod(str, &end);
+	if ((end == str) || (pos < 0) || (pos > 180.0))
+		return -1;
+
+	switch (*end) {
+		case 'E':
+		case 'e':
+			*we_flag = 1;
+			break;
+		case 'W':
+		case 'w':
+			*we_flag = 0;
+			break;
+		default:
+			return -1;
+	}
+	if (end[1])
+		return -1;
+
+	*orbital_pos = (int) (pos * 10.0 + 0.5);
+	return 0;
+}
+
+static int read_initial (const char *initial)
 {
 	FILE *inif;
 	unsigned int f, sr;
 	char buf[200];
 	char pol[20], fec[20], qam[20], bw[20], fec2[20], mode[20], guard[20], hier[20];
+	char orbit[20];
 	struct transponder *t;
+	int n;
 
 	inif = fopen(initial, "r");
 	if (!inif) {
@@ -2171,9 +3442,19 @@ static int tune_initial (int frontend_fd, const char *initial)
 	while (fgets(buf, sizeof(buf), inif)) {
 		if (buf[0] == '#' || buf[0] == '\n')
 			;
-		else if (sscanf(buf, "S %u %1[HVLR] %u %4s\n", &f, pol, &sr, fec) == 4) {
+		else if ((n = sscanf(buf, "S %u %1[HVLR] %u %4s %7s\n", &f, pol, &sr, fec, orbit)) >= 4) {
 			t = alloc_transponder(f);
 			t->type = FE_QPSK;
+			/* an optional orbital position (for -R) follows */
+			if ((n == 5) &&
+			    (parse_orbital_pos(orbit, &t->orbital_pos, &n) == 0)) {
+				t->we_flag = n;
+				t->orbital_known = 1;
+			} else if (initial_orbital_pos != -1) {
+				t->orbital_pos = initial_orbital_pos;
+				t->we_flag = initial_we_flag;
+				t->orbital_known = 1;
+			}
 			switch(pol[0]) {
 				case 'H':
 				case 'L':
@@ -2239,251 +3520,1513 @@ static int tune_initial (int frontend_fd, const char *initial)
 			error("cannot parse'%s'\n", buf);
 	}
 
-	fclose(inif);
+	fclose(inif);
+
+	/* -F: these are the TPs whose SDT and NIT others are read */
+	if (fast_scan) {
+		struct list_head *pos;
+
+		list_for_each(pos, &new_transponders)
+			list_entry(pos, struct transponder, list)->home = 1;
+	}
+
+	return 0;
+}
+
+
+static void scan_tp_atsc(struct scan_adapter *a)
+{
+	struct section_buf *s0 = &a->filters[0];
+	struct section_buf *s1 = &a->filters[1];
+	struct section_buf *s2 = &a->filters[2];
+
+	if (no_ATSC_PSIP) {
+		setup_filter(s0, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+		add_filter(s0);
+	} else {
+		if (ATSC_type & 0x1) {
+			setup_filter(s0, a, 0x1ffb, 0xc8, -1, 1, 0, 5); /* terrestrial VCT */
+			add_filter(s0);
+		}
+		if (ATSC_type & 0x2) {
+			setup_filter(s1, a, 0x1ffb, 0xc9, -1, 1, 0, 5); /* cable VCT */
+			add_filter(s1);
+		}
+		setup_filter(s2, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+		add_filter(s2);
+	}
+}
+
+/**
+ *   -I: the NIT actual is the same on every TP of a network, so its version
+ *   only needs probing on the first one. returns 1 the first time.
+ */
+#define MAX_PROBED_NETWORKS 64
+static int probed_networks[MAX_PROBED_NETWORKS];
+static int n_probed_networks;
+
+static int probe_network (int network_id)
+{
+	int i;
+
+	for (i = 0; i < n_probed_networks; i++)
+		if (probed_networks[i] == network_id)
+			return 0;
+	if (n_probed_networks < MAX_PROBED_NETWORKS)
+		probed_networks[n_probed_networks++] = network_id;
+	return 1;
+}
+
+/**
+ *   -I: read just the versions of the tables the TP had last time
+ */
+static void probe_tp_dvb (struct scan_adapter *a)
+{
+	struct transponder *t = a->tp;
+	struct section_buf *s0 = &a->filters[0];
+	struct section_buf *s1 = &a->filters[1];
+	struct section_buf *s2 = &a->filters[2];
+
+	memcpy (t->probe_version, t->version, sizeof(t->version));
+
+	t->probe_version[PAT] = -1;
+	setup_filter (s0, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+	s0->probe = 1;
+	add_filter (s0);
+
+	if (t->version[SDT] != -1) {
+		t->probe_version[SDT] = -1;
+		setup_filter (s1, a, 0x11, 0x42, -1, 1, 0, 5); /* SDT */
+		s1->probe = 1;
+		add_filter (s1);
+	}
+
+	if ((t->version[NIT] != -1) && probe_network (t->network_id)) {
+		t->probe_version[NIT] = -1;
+		setup_filter (s2, a, 0x10, 0x40, -1, 1, 0, 15); /* NIT */
+		s2->probe = 1;
+		add_filter (s2);
+	}
+}
+
+static void scan_tp_dvb (struct scan_adapter *a)
+{
+	struct section_buf *s0 = &a->filters[0];
+	struct section_buf *s1 = &a->filters[1];
+	struct section_buf *s2 = &a->filters[2];
+	struct section_buf *s3 = &a->filters[3];
+	struct section_buf *s4 = &a->filters[4];
+	struct section_buf *s5 = &a->filters[5];
+
+	if (a->tp->probe) {
+		probe_tp_dvb (a);
+		return;
+	}
+
+	if (fast_scan == FAST_OPERATOR && a->tp->home) {
+		/* -F fastscan: the operator's tables are all there is to read */
+		setup_filter (s0, a, fastscan_pid, 0xbc, -1, 1, 0, 15); /* FNT */
+		add_filter (s0);
+		setup_filter (s1, a, fastscan_pid, 0xbd, -1, 1, 0, 15); /* FST */
+		add_filter (s1);
+		return;
+	}
+
+	if (a->tp->discovered) {
+		/* -F pmt: the services are known, only their PIDs are not;
+		 * -F fastscan,verify: they are out already, check the PAT */
+		claim_other_services (a->tp);
+		setup_filter (s0, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+		add_filter (s0);
+		return;
+	}
+
+	/**
+	 *  filter timeouts > min repetition rates specified in ETR211
+	 */
+	setup_filter (s0, a, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
+	setup_filter (s1, a, 0x11, 0x42, -1, 1, 0, 5); /* SDT */
+
+	add_filter (s0);
+	add_filter (s1);
+
+	if (!current_tp_only || output_format != OUTPUT_PIDS) {
+		setup_filter (s2, a, 0x10, 0x40, -1, 1, 0, 15); /* NIT */
+		add_filter (s2);
+		if (get_other_nits || fast_scan) {
+			/* get NIT-others
+			 * Note: There is more than one NIT-other: one per
+			 * network, separated by the network_id.
+			 */
+			setup_filter (s3, a, 0x10, 0x41, -1, 1, 1, 15);
+			add_filter (s3);
+		}
+	}
+
+	if (fast_scan) {
+		/* one SDT other per TS and one BAT per bouquet; ETR211 has
+		 * them repeat at least every 10s
+		 */
+		setup_filter (s4, a, 0x11, 0x46, -1, 1, 1, 15); /* SDT other */
+		add_filter (s4);
+		setup_filter (s5, a, 0x11, 0x4a, -1, 1, 1, 15); /* BAT */
+		add_filter (s5);
+	}
+}
+
+/**
+ *   start the section filters for the TP an adapter is tuned to
+ */
+static void scan_tp_start(struct scan_adapter *a)
+{
+	current_adapter = a;
+	current_tp = a->tp;
+
+	switch(a->fe_info.type) {
+		case FE_QPSK:
+		case FE_QAM:
+		case FE_OFDM:
+			scan_tp_dvb(a);
+			break;
+		case FE_ATSC:
+			scan_tp_atsc(a);
+			break;
+		default:
+			break;
+	}
+}
+
+/**
+ *   -I: once the probe of a TP is over, keep the services from the state
+ *   file if no table version changed, or start a full scan of it.
+ *   returns 1 if the full scan was started
+ */
+static int probe_finish (struct scan_adapter *a)
+{
+	struct transponder *t = a->tp;
+	struct list_head *pos, *tmp;
+	struct service *s;
+
+	if (!t || !t->probe)
+		return 0;
+	t->probe = 0;
+
+	if (!memcmp (t->version, t->probe_version, sizeof(t->version))) {
+		info("transponder %u unchanged\n", t->param.frequency);
+		t->unchanged = 1;
+		return 0;
+	}
+
+	info("transponder %u changed (PAT %d -> %d, SDT %d -> %d, NIT %d -> %d)\n",
+	     t->param.frequency,
+	     t->version[PAT], t->probe_version[PAT],
+	     t->version[SDT], t->probe_version[SDT],
+	     t->version[NIT], t->probe_version[NIT]);
+
+	/* set the old services aside, to tell what went away */
+	list_for_each_safe (pos, tmp, &t->services) {
+		s = list_entry (pos, struct service, list);
+		list_del_init (&s->hash);
+		list_del (&s->list);
+		list_add_tail (&s->list, &t->old_services);
+	}
+
+	scan_tp_start (a);
+	return 1;
+}
+
+static void scan_tp(struct scan_adapter *a)
+{
+	a->tp = current_tp;
+	scan_tp_start(a);
+
+	do {
+		while (a->n_filters)
+			read_filters (1000);
+	} while (probe_finish (a));
+
+	transponder_done (a->tp);
+}
+
+static void scan_network (struct scan_adapter *a, const char *initial)
+{
+	if ((!state_loaded && initial && (read_initial (initial) < 0)) ||
+	    (tune_to_next_transponder(a) < 0)) {
+		error("initial tuning failed\n");
+		return;
+	}
+
+	do {
+		scan_tp(a);
+	} while (tune_to_next_transponder(a) == 0);
+}
+
+/**
+ *   give an idle adapter the next TP to scan, as next_transponder() picks
+ */
+static void adapter_tune_next (struct scan_adapter *a)
+{
+	struct transponder *t;
+
+	while ((t = next_transponder (a)) != NULL) {
+		/* claim_transponder() always takes t off new_transponders */
+		a->tp = t;
+		a->tune_attempt = 0;
+		if (claim_transponder (a, t))
+			continue;
+
+		do {
+			if (__tune_start (a, t) == 0) {
+				a->state = ADAPTER_TUNING;
+				return;
+			}
+		} while (next_other_frequency (t) == 0);
+	}
+}
+
+static void adapter_check_tune (struct scan_adapter *a)
+{
+	struct transponder *t = a->tp;
+	int rc;
+
+	switch ((rc = __tune_check_lock (a, t))) {
+	case 0:
+		return;
+
+	case 1:
+		a->state = ADAPTER_SCANNING;
+		scan_tp_start (a);
+		return;
+	}
+
+	/* like tune_to_transponder(), allow each frequency two attempts */
+	if ((rc != -2) && (a->tune_attempt++ == 0)) {
+		if (__tune_start (a, t) == 0)
+			return;
+	}
+
+	while (next_other_frequency (t) == 0) {
+		a->tune_attempt = 0;
+		if (__tune_start (a, t) == 0)
+			return;
+	}
+
+	a->state = ADAPTER_IDLE;
+}
+
+static void scan_network_multi (const char *initial)
+{
+	struct scan_adapter *a;
+	int busy;
+	int i;
+
+	if (!state_loaded && initial && (read_initial (initial) < 0)) {
+		error("initial tuning failed\n");
+		return;
+	}
+
+	do {
+		busy = 0;
+		for (i = 0; i < n_adapters; i++) {
+			a = &adapters[i];
+
+			if ((a->state == ADAPTER_SCANNING) && (a->n_filters == 0) &&
+			    !probe_finish (a)) {
+				transponder_done (a->tp);
+				a->state = ADAPTER_IDLE;
+			}
+			if (a->state == ADAPTER_IDLE)
+				adapter_tune_next (a);
+			else if (a->state == ADAPTER_TUNING)
+				adapter_check_tune (a);
+
+			if (a->state != ADAPTER_IDLE)
+				busy = 1;
+		}
+
+		/* short timeout, so lock status is checked often enough */
+		if (busy)
+			read_filters (100);
+	} while (busy || !list_empty(&new_transponders));
+}
+
+
+static void pids_dump_service_parameter_set(struct output *o, struct service *s)
+{
+	char buf[64];
+        int i;
+
+	snprintf(buf, sizeof(buf), "%-24.24s (0x%04x) %02x: ",
+		 s->service_name, s->service_id, s->type);
+	output_str(o, buf);
+	if (!s->pcr_pid || (s->type > 2))
+		output_str(o, "           ");
+	else if (s->pcr_pid == s->video_pid)
+		output_str(o, "PCR == V   ");
+	else if ((s->audio_num == 1) && (s->pcr_pid == s->audio_pid[0]))
+		output_str(o, "PCR == A   ");
+	else {
+		snprintf(buf, sizeof(buf), "PCR 0x%04x ", s->pcr_pid);
+		output_str(o, buf);
+	}
+	if (s->video_pid) {
+		snprintf(buf, sizeof(buf), "V 0x%04x", s->video_pid);
+		output_str(o, buf);
+	} else
+		output_str(o, "        ");
+	if (s->audio_num)
+		output_str(o, " A");
+        for (i = 0; i < s->audio_num; i++) {
+		snprintf(buf, sizeof(buf), " 0x%04x", s->audio_pid[i]);
+		output_str(o, buf);
+		if (s->audio_lang[i][0]) {
+			snprintf(buf, sizeof(buf), " (%.3s)", s->audio_lang[i]);
+			output_str(o, buf);
+		} else if (s->audio_num == 1)
+			output_str(o, "      ");
+	}
+	if (s->teletext_pid) {
+		snprintf(buf, sizeof(buf), " TT 0x%04x", s->teletext_pid);
+		output_str(o, buf);
+	}
+	if (s->ac3_pid) {
+		snprintf(buf, sizeof(buf), " AC3 0x%04x", s->ac3_pid);
+		output_str(o, buf);
+	}
+	if (s->subtitling_pid) {
+		snprintf(buf, sizeof(buf), " SUB 0x%04x", s->subtitling_pid);
+		output_str(o, buf);
+	}
+	output_char(o, '\n');
+}
+
+static char sat_polarisation (struct transponder *t)
+{
+	return t->polarisation == POLARISATION_VERTICAL ? 'v' : 'h';
+}
+
+static int sat_number (struct transponder *t)
+{
+	(void) t;
+
+	return switch_pos;
+}
+
+static struct output out;		/* stdout */
+static int n_dumped;			/* services output */
+static int anon_services;
+
+/* ':' is field separator in szap and vdr service lists; the names are
+ * shared, so the lists get copies without it */
+static char *list_name (const char *name)
+{
+	char *copy, *p;
+
+	if (!name || !(copy = strdup(name)))
+		return NULL;
+	for (p = copy; *p; p++) {
+		if (*p == ':')
+			*p = ' ';
+	}
+	return copy;
+}
+
+static void dump_service (struct transponder *t, struct service *s)
+{
+	char sn[20];
+	char *service_name, *provider_name;
+
+	if (!s->service_name) {
+		/* not in SDT */
+		if (unique_anon_services)
+			snprintf(sn, sizeof(sn), "[%03x-%04x]",
+				 anon_services, s->service_id);
+		else
+			snprintf(sn, sizeof(sn), "[%04x]",
+				 s->service_id);
+		name_set(&s->service_name, strdup(sn));
+		anon_services++;
+	}
+	if (t->discovered && !s->pmt_pid) {
+		/* -F list: going by the service_type, as there are no PIDs */
+		switch (s->type) {
+		case 0x01: case 0x11: case 0x16: case 0x19: case 0x1f:
+			if (!(serv_select & 1))
+				return; /* no TV services */
+			break;
+		case 0x02: case 0x0a:
+			if (!(serv_select & 2))
+				return; /* no radio services */
+			break;
+		default:
+			if (!(serv_select & 4))
+				return; /* no data/other services */
+		}
+	}
+	else if (s->video_pid && !(serv_select & 1))
+		return; /* no TV services */
+	else if (!s->video_pid && s->audio_num && !(serv_select & 2))
+		return; /* no radio services */
+	else if (!s->video_pid && !s->audio_num && !(serv_select & 4))
+		return; /* no data/other services */
+	if (s->scrambled && !ca_select)
+		return; /* FTA only */
+	n_dumped++;
+	service_name = list_name(s->service_name);
+	provider_name = list_name(s->provider_name);
+	switch (output_format)
+	{
+	  case OUTPUT_PIDS:
+		pids_dump_service_parameter_set (&out, s);
+		break;
+	  case OUTPUT_VDR:
+		vdr_dump_service_parameter_set (&out,
+				    service_name,
+				    provider_name,
+				    t->type,
+				    &t->param,
+				    sat_polarisation(t),
+				    s->video_pid,
+				    s->pcr_pid,
+				    s->audio_pid,
+				    s->audio_lang,
+				    s->audio_num,
+				    s->teletext_pid,
+				    s->scrambled,
+				    //FIXME: s->subtitling_pid
+				    s->ac3_pid,
+				    s->service_id,
+				    t->original_network_id,
+				    s->transport_stream_id,
+				    t->orbital_pos,
+				    t->we_flag,
+				    vdr_dump_provider,
+				    ca_select,
+				    vdr_version,
+				    vdr_dump_channum,
+				    s->channel_num);
+		break;
+	  case OUTPUT_ZAP:
+		zap_dump_service_parameter_set (&out,
+				    service_name,
+				    t->type,
+				    &t->param,
+				    sat_polarisation(t),
+				    sat_number(t),
+				    s->video_pid,
+				    s->audio_pid,
+				    s->service_id);
+		break;
+	  case OUTPUT_JSON:
+		json_dump_service_parameter_set (&out,
+				    service_name,
+				    provider_name,
+				    t->type,
+				    &t->param,
+				    sat_polarisation(t),
+				    t->orbital_pos,
+				    t->we_flag,
+				    s->type,
+				    s->pmt_pid,
+				    s->pcr_pid,
+				    s->video_pid,
+				    s->audio_pid,
+				    s->audio_lang,
+				    s->audio_num,
+				    s->ac3_pid,
+				    s->teletext_pid,
+				    s->subtitling_pid,
+				    s->ca_id,
+				    s->ca_num,
+				    s->scrambled,
+				    s->service_id,
+				    t->original_network_id,
+				    s->transport_stream_id,
+				    s->channel_num);
+		break;
+	  default:
+		break;
+	  }
+	free(service_name);
+	free(provider_name);
+}
+
+/**
+ *   output the services of a TP, in one write()
+ */
+static void dump_transponder (struct transponder *t)
+{
+	struct list_head *pos;
+
+	list_for_each(pos, &t->services)
+		dump_service (t, list_entry(pos, struct service, list));
+	if (output_flush (&out))
+		error("cannot write the channel list: %m\n");
+	t->dumped = 1;
+}
+
+/**
+ *   output the TPs not output yet: normally none are left as each one is
+ *   output when its scan completes, but on SIGINT these are the partial
+ *   results of the TPs being scanned
+ */
+static void dump_lists (void)
+{
+	struct list_head *p1;
+	struct transponder *t;
+
+	list_for_each(p1, &scanned_transponders) {
+		t = list_entry(p1, struct transponder, list);
+		/* with -I, only what changed since the last run */
+		if (t->wrong_frequency || t->dumped || t->unchanged || t->probe)
+			continue;
+		/* -F: the TPs which weren't tuned, or failed to tune */
+		if (t->discovered)
+			claim_other_services (t);
+		dump_transponder (t);
+	}
+	free_other_transponders ();
+	info("dumped %d services\n", n_dumped);
+	info("Done.\n");
+}
+
+/**
+ *   -I state file: every TP scanned, with the versions of its PAT, SDT and
+ *   NIT and all of its services, so the next run only has to rescan the TPs
+ *   where one of them changed. One line per TP, then one per service:
+ *
+ *   T type nid onid tsid pat sdt nit frequency inversion <tuning parameters>
+ *   S sid type scrambled running pmt pcr video teletext subtitling ac3
+ *     channel_num audio_num <pid,lang>... ca_num <ca_id>...\tprovider\tname
+ */
+#define STATE_HEADER "# scan state 1\n"
+
+static void write_state_str (FILE *f, const char *str)
+{
+	fputc ('\t', f);
+	for (; str && *str; str++)
+		fputc ((*str == '\t' || *str == '\n') ? ' ' : *str, f);
+}
+
+static void write_state_tp (FILE *f, struct transponder *t)
+{
+	struct dvb_frontend_parameters *p = &t->param;
+
+	fprintf (f, "T %d %d %d %d %d %d %d %u %d",
+		 t->type, t->network_id, t->original_network_id,
+		 t->transport_stream_id,
+		 t->version[PAT], t->version[SDT], t->version[NIT],
+		 p->frequency, p->inversion);
+
+	switch (t->type) {
+	case FE_QPSK:
+		fprintf (f, " %u %d %d %d %d %d\n",
+			 p->u.qpsk.symbol_rate, p->u.qpsk.fec_inner,
+			 t->polarisation, t->orbital_pos, t->we_flag,
+			 t->orbital_known);
+		break;
+	case FE_QAM:
+		fprintf (f, " %u %d %d\n",
+			 p->u.qam.symbol_rate, p->u.qam.fec_inner,
+			 p->u.qam.modulation);
+		break;
+	case FE_OFDM:
+		fprintf (f, " %d %d %d %d %d %d %d\n",
+			 p->u.ofdm.bandwidth, p->u.ofdm.code_rate_HP,
+			 p->u.ofdm.code_rate_LP, p->u.ofdm.constellation,
+			 p->u.ofdm.transmission_mode, p->u.ofdm.guard_interval,
+			 p->u.ofdm.hierarchy_information);
+		break;
+	case FE_ATSC:
+		fprintf (f, " %d\n", p->u.vsb.modulation);
+		break;
+	}
+}
+
+static void write_state_service (FILE *f, struct service *s)
+{
+	int i;
+
+	fprintf (f, "S %d %d %d %d %d %d %d %d %d %d %d %d",
+		 s->service_id, s->type, s->scrambled, s->running,
+		 s->pmt_pid, s->pcr_pid, s->video_pid, s->teletext_pid,
+		 s->subtitling_pid, s->ac3_pid, s->channel_num, s->audio_num);
+	for (i = 0; i < s->audio_num; i++)
+		fprintf (f, " %d,%.3s", s->audio_pid[i], s->audio_lang[i]);
+	fprintf (f, " %d", s->ca_num);
+	for (i = 0; i < s->ca_num; i++)
+		fprintf (f, " %d", s->ca_id[i]);
+	write_state_str (f, s->provider_name);
+	write_state_str (f, s->service_name);
+	fputc ('\n', f);
+}
+
+/**
+ *   the state file is written through a temporary one as the TPs complete,
+ *   and only replaces the old one once the scan is over, so an interrupted
+ *   or failed scan leaves the previous state alone
+ */
+static FILE *state_out;
+static char state_tmp[256];
+
+static int open_state (const char *path)
+{
+	snprintf (state_tmp, sizeof(state_tmp), "%s.tmp", path);
+	if ((state_out = fopen (state_tmp, "w")) == NULL) {
+		error("cannot create '%s': %d %m\n", state_tmp, errno);
+		return -1;
+	}
+	fputs (STATE_HEADER, state_out);
+	return 0;
+}
+
+static int close_state (const char *path)
+{
+	if (ferror (state_out) | fclose (state_out)) {
+		error("cannot write '%s'\n", state_tmp);
+		unlink (state_tmp);
+		return -1;
+	}
+	if (rename (state_tmp, path)) {
+		error("cannot rename '%s' to '%s': %d %m\n", state_tmp, path, errno);
+		unlink (state_tmp);
+		return -1;
+	}
+	return 0;
+}
+
+static int read_state_ints (char **p, int *v, int n)
+{
+	char *end;
+
+	while (n--) {
+		*v++ = strtol (*p, &end, 10);
+		if (end == *p)
+			return -1;
+		*p = end;
+	}
+	return 0;
+}
+
+static char *read_state_str (char **p)
+{
+	char *str = *p;
+	size_t len = strcspn (str, "\t\n");
+
+	*p = str + len;
+	if (**p)
+		(*p)++;
+	return len ? strndup (str, len) : NULL;
+}
+
+static int read_state_service (struct transponder *t, char *buf)
+{
+	struct service *s;
+	char *p = buf + 1;
+	int v[12], i, n;
+
+	if (read_state_ints (&p, v, 12) || (v[11] < 0) || (v[11] > AUDIO_CHAN_MAX))
+		return -1;
+	if (find_service (t, v[0]))
+		return -1;
+
+	s = alloc_service (t, v[0]);
+	s->type = v[1];
+	s->scrambled = v[2];
+	s->running = v[3];
+	s->pmt_pid = v[4];
+	s->pcr_pid = v[5];
+	s->video_pid = v[6];
+	s->teletext_pid = v[7];
+	s->subtitling_pid = v[8];
+	s->ac3_pid = v[9];
+	s->channel_num = v[10];
+	s->audio_num = v[11];
+
+	for (i = 0; i < s->audio_num; i++) {
+		if (read_state_ints (&p, &n, 1) || (*p++ != ','))
+			return -1;
+		s->audio_pid[i] = n;
+		for (n = 0; (n < 3) && *p && !isspace (*p); n++)
+			s->audio_lang[i][n] = *p++;
+	}
+
+	if (read_state_ints (&p, &s->ca_num, 1) ||
+	    (s->ca_num < 0) || (s->ca_num > CA_SYSTEM_ID_MAX))
+		return -1;
+	for (i = 0; i < s->ca_num; i++) {
+		if (read_state_ints (&p, &n, 1))
+			return -1;
+		s->ca_id[i] = n;
+	}
+
+	if (*p++ != '\t')
+		return -1;
+	name_set(&s->provider_name, read_state_str (&p));
+	name_set(&s->service_name, read_state_str (&p));
+	return 0;
+}
+
+/**
+ *   parse a T line into t, which only gets the fields the line has.
+ *   returns 0, or -1 if the line is malformed
+ */
+static int parse_state_tp (char *buf, struct transponder *t)
+{
+	struct dvb_frontend_parameters *p = &t->param;
+	int v[8], u[7], n;
+
+	memset (t, 0, sizeof(*t));
+	if (sscanf (buf, "T %d %d %d %d %d %d %d %u %d%n", &v[0], &v[1], &v[2],
+		    &v[3], &v[4], &v[5], &v[6], &p->frequency, &v[7], &n) != 9)
+		return -1;
+	p->inversion = v[7];
+	buf += n;
+
+	switch (v[0]) {
+	case FE_QPSK:
+		if (sscanf (buf, "%u %d %d %d %d %d", &p->u.qpsk.symbol_rate,
+			    &u[0], &u[1], &u[2], &u[3], &u[4]) != 6)
+			return -1;
+		p->u.qpsk.fec_inner = u[0];
+		t->polarisation = u[1];
+		t->orbital_pos = u[2];
+		t->we_flag = u[3];
+		t->orbital_known = u[4];
+		break;
+	case FE_QAM:
+		if (sscanf (buf, "%u %d %d", &p->u.qam.symbol_rate, &u[0], &u[1]) != 3)
+			return -1;
+		p->u.qam.fec_inner = u[0];
+		p->u.qam.modulation = u[1];
+		break;
+	case FE_OFDM:
+		if (sscanf (buf, "%d %d %d %d %d %d %d",
+			    &u[0], &u[1], &u[2], &u[3], &u[4], &u[5], &u[6]) != 7)
+			return -1;
+		p->u.ofdm.bandwidth = u[0];
+		p->u.ofdm.code_rate_HP = u[1];
+		p->u.ofdm.code_rate_LP = u[2];
+		p->u.ofdm.constellation = u[3];
+		p->u.ofdm.transmission_mode = u[4];
+		p->u.ofdm.guard_interval = u[5];
+		p->u.ofdm.hierarchy_information = u[6];
+		break;
+	case FE_ATSC:
+		if (sscanf (buf, "%d", &u[0]) != 1)
+			return -1;
+		p->u.vsb.modulation = u[0];
+		break;
+	default:
+		return -1;
+	}
+
+	t->type = v[0];
+	t->network_id = v[1];
+	t->original_network_id = v[2];
+	t->transport_stream_id = v[3];
+	t->version[PAT] = v[4];
+	t->version[SDT] = v[5];
+	t->version[NIT] = v[6];
+	return 0;
+}
+
+/**
+ *   add the TP of a T line to new_transponders
+ */
+static struct transponder *new_state_tp (char *buf)
+{
+	struct transponder tn, *t;
+
+	if (parse_state_tp (buf, &tn))
+		return NULL;
+
+	t = alloc_transponder (tn.param.frequency);
+	copy_transponder (t, &tn);
+	memcpy (t->version, tn.version, sizeof(t->version));
+	return t;
+}
+
+static struct transponder *read_state_tp (char *buf)
+{
+	struct transponder *t;
+
+	if ((t = new_state_tp (buf)) == NULL)
+		return NULL;
+	t->from_state = 1;
+	/* the versions of the ATSC tables are not kept, so those are
+	 * always scanned again */
+	t->probe = (t->type != FE_ATSC);
+	return t;
+}
+
+/**
+ *   returns the number of TPs loaded, 0 if there is no state file yet,
+ *   or -1 if it is unusable
+ */
+static int read_state (const char *path)
+{
+	struct transponder *t = NULL;
+	char buf[1024];
+	int line = 0, n = 0;
+	FILE *f;
+
+	if ((f = fopen (path, "r")) == NULL) {
+		if (errno == ENOENT)
+			return 0;
+		error("cannot open '%s': %d %m\n", path, errno);
+		return -1;
+	}
+
+	if (!fgets (buf, sizeof(buf), f) || strcmp (buf, STATE_HEADER)) {
+		error("'%s' is not a scan state file\n", path);
+		fclose (f);
+		return -1;
+	}
+
+	while (fgets (buf, sizeof(buf), f)) {
+		line++;
+		if (buf[0] == 'T') {
+			if ((t = read_state_tp (buf)) == NULL)
+				goto bad;
+			n++;
+		} else if (buf[0] == 'S') {
+			if (t && t->probe && read_state_service (t, buf))
+				goto bad;
+		} else
+			goto bad;
+	}
+
+	fclose (f);
+	info("%s: %d transponders\n", path, n);
+	return n;
+
+bad:
+	error("%s:%d: cannot parse '%s'\n", path, line + 1, buf);
+	fclose (f);
+	return -1;
+}
+
+static void free_service (struct service *s)
+{
+	list_del (&s->list);
+	list_del (&s->hash);
+	name_release (s->provider_name);
+	name_release (s->service_name);
+	free (s->priv);
+	free (s);
+}
+
+/**
+ *   -F fastscan: with the home TP's FNT and FST in, the whole list is
+ *   known, so it goes out right away. With verify, the other TPs are tuned
+ *   after this for their PATs, and their services are kept aside for
+ *   transponder_done() to tell which the PAT did not have.
+ */
+static void fastscan_publish (void)
+{
+	struct list_head *lists[2] = { &new_transponders, &scanned_transponders };
+	struct list_head *p1, *pos, *tmp;
+	struct transponder *t;
+	struct service *s;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		list_for_each(p1, lists[i]) {
+			t = list_entry(p1, struct transponder, list);
+			if (!t->discovered || t->dumped)
+				continue;
+			claim_other_services (t);
+			dump_transponder (t);
+
+			list_for_each_safe(pos, tmp, &t->services) {
+				s = list_entry(pos, struct service, list);
+				if (!fastscan_verify) {
+					free_service (s);
+					continue;
+				}
+				list_del_init (&s->hash);
+				list_del (&s->list);
+				list_add_tail (&s->list, &t->old_services);
+			}
+			t->verify = fastscan_verify;
+			t->unchanged = fastscan_verify;
+		}
+	}
+	free_other_transponders ();
+	if (fastscan_verify && !list_empty(&new_transponders))
+		info("channel list complete, verifying the transponders\n");
+}
+
+/**
+ *   the scan of a TP is complete: output its services right away and free
+ *   them, so memory use doesn't grow with the number of services and the
+ *   results so far are out should a long scan die
+ */
+static void transponder_done (struct transponder *t)
+{
+	struct list_head *pos, *tmp;
+	struct service *s;
+
+	if (state_out) {
+		/* before dump_service() makes up names for services without one */
+		write_state_tp (state_out, t);
+		list_for_each(pos, &t->services)
+			write_state_service (state_out, list_entry(pos, struct service, list));
+		fflush (state_out);
+	}
+
+	list_for_each_safe(pos, tmp, &t->old_services) {
+		s = list_entry(pos, struct service, list);
+		if (!find_service (t, s->service_id))
+			info("service 0x%04x '%s' %s\n", s->service_id,
+			     s->service_name ? s->service_name : "",
+			     t->verify ? "not in the PAT" : "gone");
+		free_service (s);
+	}
+
+	/* -F fastscan: the home TP's services are in the FST */
+	if (fast_scan == FAST_OPERATOR && t->home)
+		claim_other_services (t);
 
-	return tune_to_next_transponder(frontend_fd);
+	/* with -I, only what changed since the last run */
+	if (!t->unchanged)
+		dump_transponder (t);
+
+	list_for_each_safe(pos, tmp, &t->services)
+		free_service (list_entry(pos, struct service, list));
+	t->dumped = 1;
+
+	if (fast_scan == FAST_OPERATOR && t->home)
+		fastscan_publish ();
 }
 
+/**
+ *   -S/-W: a distributed scan. The coordinator (-S) keeps the TP lists
+ *   and tunes nothing itself. Workers (-W, on this host or others, each
+ *   with its own -a adapters) connect to it and ask for a TP whenever one
+ *   of their adapters is idle, so the queue is shared out as the workers
+ *   get through it, and one done early just gets more. When a TP's scan
+ *   is over, the worker sends the TP, its services and the TPs its NITs
+ *   listed back, and the coordinator adds those it does not know yet to
+ *   the queue, so every network, TP and service is only scanned and
+ *   output once. A lost worker's TPs are put back in the queue.
+ *
+ *   The lines are those of the -I state file:
+ *
+ *   worker:      NEXT type			an adapter of type is idle
+ *   coordinator: J job T ...			scan this TP
+ *   worker:      D job failed, T ..., S ...,	the TP as scanned, its
+ *                N T ..., .			services, the TPs its NITs listed
+ *   coordinator: END				the scan is over
+ */
+#define DIST_PORT "5520"
+#define MAX_WORKERS 64
+
+struct peer {
+	int fd;
+	FILE *out;
+	char buf[4096];
+	int len;
+};
 
-static void scan_tp_atsc(void)
+/**
+ *   split [host:]port, host defaults to NULL
+ */
+static void dist_address (char *arg, char **host, char **port)
 {
-	struct section_buf s0,s1,s2;
+	char *colon = strrchr (arg, ':');
+
+	*host = NULL;
+	*port = arg;
+	if (colon) {
+		*colon = 0;
+		*host = *arg ? arg : NULL;
+		*port = colon + 1;
+	}
+	if (!**port)
+		*port = DIST_PORT;
+}
 
-	if (no_ATSC_PSIP) {
-		setup_filter(&s0, demux_devname, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
-		add_filter(&s0);
-	} else {
-		if (ATSC_type & 0x1) {
-			setup_filter(&s0, demux_devname, 0x1ffb, 0xc8, -1, 1, 0, 5); /* terrestrial VCT */
-			add_filter(&s0);
-		}
-		if (ATSC_type & 0x2) {
-			setup_filter(&s1, demux_devname, 0x1ffb, 0xc9, -1, 1, 0, 5); /* cable VCT */
-			add_filter(&s1);
-		}
-		setup_filter(&s2, demux_devname, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
-		add_filter(&s2);
+static int peer_open (struct peer *p, int fd)
+{
+	p->fd = fd;
+	p->len = 0;
+	if ((p->out = fdopen (fd, "w")) == NULL) {
+		close (fd);
+		return -1;
 	}
+	return 0;
+}
 
-	do {
-		read_filters ();
-	} while (!(list_empty(&running_filters) &&
-		   list_empty(&waiting_filters)));
+static void peer_close (struct peer *p)
+{
+	fclose (p->out);
+	p->out = NULL;
+	p->fd = -1;
 }
 
-static void scan_tp_dvb (void)
+/**
+ *   hand the lines which came in to line(), without blocking.
+ *   returns -1 once the peer is gone or line() did not like one
+ */
+static int peer_read (struct peer *p, int (*line) (struct peer *, char *))
 {
-	struct section_buf s0;
-	struct section_buf s1;
-	struct section_buf s2;
-	struct section_buf s3;
+	char *start, *nl;
+	ssize_t n;
+
+	for (;;) {
+		n = recv (p->fd, p->buf + p->len, sizeof(p->buf) - 1 - p->len,
+			  MSG_DONTWAIT);
+		if (n < 0)
+			return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+		if (n == 0)
+			return -1;
+		p->len += n;
+		p->buf[p->len] = 0;
 
-	/**
-	 *  filter timeouts > min repetition rates specified in ETR211
-	 */
-	setup_filter (&s0, demux_devname, 0x00, 0x00, -1, 1, 0, 5); /* PAT */
-	setup_filter (&s1, demux_devname, 0x11, 0x42, -1, 1, 0, 5); /* SDT */
+		start = p->buf;
+		while ((nl = strchr (start, '\n')) != NULL) {
+			*nl = 0;
+			if (line (p, start) < 0)
+				return -1;
+			start = nl + 1;
+		}
+		p->len -= start - p->buf;
+		memmove (p->buf, start, p->len);
+		if (p->len == sizeof(p->buf) - 1)
+			return -1;
+	}
+}
 
-	add_filter (&s0);
-	add_filter (&s1);
+struct worker {
+	struct peer peer;			/* first, for peer_read() */
+	int want[MAX_ADAPTERS];			/* type of its NEXT, -1 => none */
+	struct transponder *job[MAX_ADAPTERS];	/* the TP given for it */
+	int report;				/* job of the D being read, -1 => none */
+	int report_failed;
+};
 
-	if (!current_tp_only || output_format != OUTPUT_PIDS) {
-		setup_filter (&s2, demux_devname, 0x10, 0x40, -1, 1, 0, 15); /* NIT */
-		add_filter (&s2);
-		if (get_other_nits) {
-			/* get NIT-others
-			 * Note: There is more than one NIT-other: one per
-			 * network, separated by the network_id.
-			 */
-			setup_filter (&s3, demux_devname, 0x10, 0x41, -1, 1, 1, 15);
-			add_filter (&s3);
+static struct worker workers[MAX_WORKERS];
+static int n_workers;
+
+/**
+ *   a TP a worker's NIT listed: add it unless it is known
+ */
+static void coordinator_merge (struct transponder *tn)
+{
+	struct transponder *t = find_transponder (tn->param.frequency);
+
+	if (t && t->scan_done)
+		return;
+	if (!t)
+		t = alloc_transponder (tn->param.frequency);
+	copy_transponder (t, tn);
+}
+
+static int coordinator_line (struct peer *p, char *line)
+{
+	struct worker *w = (struct worker *) p;
+	struct transponder tn, *t;
+	int job, failed, i;
+
+	if (sscanf (line, "NEXT %d", &i) == 1) {
+		for (job = 0; job < MAX_ADAPTERS; job++) {
+			if (w->want[job] < 0 && !w->job[job]) {
+				w->want[job] = i;
+				return 0;
+			}
 		}
+		return -1;
 	}
 
-	do {
-		read_filters ();
-	} while (!(list_empty(&running_filters) &&
-		   list_empty(&waiting_filters)));
+	if (sscanf (line, "D %d %d", &job, &failed) == 2) {
+		if (job < 0 || job >= MAX_ADAPTERS || !w->job[job])
+			return -1;
+		w->report = job;
+		w->report_failed = failed;
+		return 0;
+	}
+
+	if (line[0] == 'N') {
+		if (line[1] != ' ' || parse_state_tp (line + 2, &tn))
+			return -1;
+		coordinator_merge (&tn);
+		return 0;
+	}
+
+	if (w->report < 0)
+		return -1;
+	t = w->job[w->report];
+
+	switch (line[0]) {
+	case 'T':
+		if (parse_state_tp (line, &tn))
+			return -1;
+		/* its NIT actual or -B may have corrected the parameters */
+		tn.scan_done = 1;
+		tn.last_tuning_failed = w->report_failed;
+		copy_transponder (t, &tn);
+		memcpy (t->version, tn.version, sizeof(t->version));
+		return 0;
+	case 'S':
+		/* a service the worker sent before losing the connection */
+		read_state_service (t, line);
+		return 0;
+	case '.':
+		if (!w->report_failed)
+			transponder_done (t);
+		w->job[w->report] = NULL;
+		w->want[w->report] = -1;
+		w->report = -1;
+		return 0;
+	}
+	return -1;
 }
 
-static void scan_tp(void)
+static void coordinator_drop (struct worker *w)
 {
-	switch(fe_info.type) {
-		case FE_QPSK:
-		case FE_QAM:
-		case FE_OFDM:
-			scan_tp_dvb();
-			break;
-		case FE_ATSC:
-			scan_tp_atsc();
-			break;
-		default:
+	struct transponder *t;
+	int i;
+
+	for (i = 0; i < MAX_ADAPTERS; i++) {
+		if ((t = w->job[i]) == NULL)
+			continue;
+		warning("worker lost, transponder %u back in the queue\n",
+			t->param.frequency);
+		list_del_init (&t->list);
+		list_add (&t->list, &new_transponders);
+		t->scan_done = 0;
+	}
+	peer_close (&w->peer);
+	*w = workers[--n_workers];
+}
+
+/**
+ *   give the waiting workers the next TPs of their type, and tell
+ *   whether the scan is over: nothing given out is left, and either the
+ *   queue is empty or none of it can be tuned by the workers waiting
+ */
+static int coordinator_dispatch (void)
+{
+	struct list_head *pos;
+	struct transponder *t;
+	struct worker *w;
+	int i, j, busy = 0, waiting = 0;
+
+	for (i = 0; i < n_workers; i++) {
+		w = &workers[i];
+		for (j = 0; j < MAX_ADAPTERS; j++) {
+			if (w->want[j] >= 0 && !w->job[j]) {
+				list_for_each (pos, &new_transponders) {
+					t = list_entry (pos, struct transponder, list);
+					if (t->type != (enum fe_type) w->want[j])
+						continue;
+					list_del_init (&t->list);
+					list_add_tail (&t->list, &scanned_transponders);
+					t->scan_done = 1;
+					w->job[j] = t;
+					fprintf (w->peer.out, "J %d ", j);
+					write_state_tp (w->peer.out, t);
+					fflush (w->peer.out);
+					break;
+				}
+			}
+			if (w->job[j])
+				busy = 1;
+			else if (w->want[j] >= 0)
+				waiting = 1;
+		}
+	}
+	return !busy && (waiting || list_empty (&new_transponders));
+}
+
+static int dist_listen (char *arg)
+{
+	struct addrinfo hints, *res, *ai;
+	char *host, *port;
+	int fd = -1, on = 1, rc;
+
+	dist_address (arg, &host, &port);
+	memset (&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	if ((rc = getaddrinfo (host, port, &hints, &res)) != 0)
+		fatal("%s: %s\n", arg, gai_strerror (rc));
+
+	for (ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+			continue;
+		setsockopt (fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		if (bind (fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+		    listen (fd, MAX_WORKERS) == 0)
 			break;
+		close (fd);
+		fd = -1;
 	}
+	freeaddrinfo (res);
+	if (fd < 0)
+		fatal("cannot listen on port %s: %d %m\n", port, errno);
+	info("waiting for workers on port %s\n", port);
+	return fd;
 }
 
-static void scan_network (int frontend_fd, const char *initial)
+static void scan_coordinate (const char *initial, char *address)
 {
-	if (tune_initial (frontend_fd, initial) < 0) {
+	struct pollfd pfd[MAX_WORKERS + 1];
+	struct worker *w;
+	int listen_fd, fd, i, j;
+
+	if (!state_loaded && initial && (read_initial (initial) < 0)) {
 		error("initial tuning failed\n");
 		return;
 	}
 
-	do {
-		scan_tp();
-	} while (tune_to_next_transponder(frontend_fd) == 0);
+	listen_fd = dist_listen (address);
+
+	while (!coordinator_dispatch ()) {
+		pfd[0].fd = listen_fd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < n_workers; i++) {
+			pfd[i + 1].fd = workers[i].peer.fd;
+			pfd[i + 1].events = POLLIN;
+		}
+		if (poll (pfd, n_workers + 1, -1) < 0) {
+			if (errno != EINTR)
+				fatal("poll failed: %d %m\n", errno);
+			continue;
+		}
+
+		/* backwards, as dropping a worker moves the last one down */
+		for (i = n_workers - 1; i >= 0; i--) {
+			if (pfd[i + 1].revents &&
+			    peer_read (&workers[i].peer, coordinator_line) < 0)
+				coordinator_drop (&workers[i]);
+		}
+
+		if (pfd[0].revents & POLLIN) {
+			if ((fd = accept (listen_fd, NULL, NULL)) < 0)
+				continue;
+			if (n_workers == MAX_WORKERS) {
+				warning("too many workers\n");
+				close (fd);
+				continue;
+			}
+			w = &workers[n_workers];
+			if (peer_open (&w->peer, fd))
+				continue;
+			for (j = 0; j < MAX_ADAPTERS; j++) {
+				w->want[j] = -1;
+				w->job[j] = NULL;
+			}
+			w->report = -1;
+			n_workers++;
+			info("worker %d connected\n", n_workers);
+		}
+	}
+
+	for (i = 0; i < n_workers; i++) {
+		fputs ("END\n", workers[i].peer.out);
+		peer_close (&workers[i].peer);
+	}
+	close (listen_fd);
 }
 
+static struct peer coordinator = { .fd = -1 };
+static int worker_ending;
 
-static void pids_dump_service_parameter_set(FILE *f, struct service *s)
+static void free_transponder (struct transponder *t)
 {
-        int i;
+	list_del (&t->list);
+	list_del (&t->hash);
+	free (t->other_f);
+	free (t);
+}
 
-	fprintf(f, "%-24.24s (0x%04x) %02x: ", s->service_name, s->service_id, s->type);
-	if (!s->pcr_pid || (s->type > 2))
-		fprintf(f, "           ");
-	else if (s->pcr_pid == s->video_pid)
-		fprintf(f, "PCR == V   ");
-	else if ((s->audio_num == 1) && (s->pcr_pid == s->audio_pid[0]))
-		fprintf(f, "PCR == A   ");
-	else
-		fprintf(f, "PCR 0x%04x ", s->pcr_pid);
-	if (s->video_pid)
-		fprintf(f, "V 0x%04x", s->video_pid);
-	else
-		fprintf(f, "        ");
-	if (s->audio_num)
-		fprintf(f, " A");
-        for (i = 0; i < s->audio_num; i++) {
-		fprintf(f, " 0x%04x", s->audio_pid[i]);
-		if (s->audio_lang[i][0])
-			fprintf(f, " (%.3s)", s->audio_lang[i]);
-		else if (s->audio_num == 1)
-			fprintf(f, "      ");
+/**
+ *   send what the scan of an adapter's TP found, and forget it
+ */
+static void worker_report (struct scan_adapter *a, int failed)
+{
+	struct transponder *t = a->tp;
+	struct list_head *pos, *tmp;
+	FILE *f = coordinator.out;
+
+	fprintf (f, "D %d %d\n", a->job, failed);
+	write_state_tp (f, t);
+	list_for_each (pos, &t->services)
+		write_state_service (f, list_entry(pos, struct service, list));
+
+	/* these are only ever scanned as the coordinator gives them out */
+	list_for_each_safe (pos, tmp, &new_transponders) {
+		fputs ("N ", f);
+		write_state_tp (f, list_entry(pos, struct transponder, list));
+		free_transponder (list_entry(pos, struct transponder, list));
 	}
-	if (s->teletext_pid)
-		fprintf(f, " TT 0x%04x", s->teletext_pid);
-	if (s->ac3_pid)
-		fprintf(f, " AC3 0x%04x", s->ac3_pid);
-	if (s->subtitling_pid)
-		fprintf(f, " SUB 0x%04x", s->subtitling_pid);
-	fprintf(f, "\n");
+	fputs (".\n", f);
+	fflush (f);
+
+	list_for_each_safe (pos, tmp, &t->services)
+		free_service (list_entry(pos, struct service, list));
+	free_transponder (t);
+	a->tp = NULL;
+	a->state = ADAPTER_IDLE;
 }
 
-static char sat_polarisation (struct transponder *t)
+static int worker_line (struct peer *p, char *line)
 {
-	return t->polarisation == POLARISATION_VERTICAL ? 'v' : 'h';
+	struct scan_adapter *a = NULL;
+	struct transponder *t;
+	int job, n, i;
+
+	(void) p;
+
+	if (!strcmp (line, "END")) {
+		worker_ending = 1;
+		return 0;
+	}
+	if (sscanf (line, "J %d %n", &job, &n) != 1 ||
+	    (t = new_state_tp (line + n)) == NULL)
+		return -1;
+	/* the inversion this host's frontends can do */
+	t->param.inversion = spectral_inversion;
+
+	/* the adapter which asked for the type, any waiting one otherwise */
+	for (i = 0; i < n_adapters; i++) {
+		if (adapters[i].state != ADAPTER_WAITING)
+			continue;
+		if (!a || adapters[i].fe_info.type == t->type)
+			a = &adapters[i];
+	}
+	if (!a) {
+		free_transponder (t);
+		return -1;
+	}
+
+	a->tp = t;
+	a->job = job;
+	a->tune_attempt = 0;
+	a->state = ADAPTER_IDLE;
+	if (claim_transponder (a, t) == 0) {
+		do {
+			if (__tune_start (a, t) == 0) {
+				a->state = ADAPTER_TUNING;
+				return 0;
+			}
+		} while (next_other_frequency (t) == 0);
+	}
+	worker_report (a, 1);
+	return 0;
 }
 
-static int sat_number (struct transponder *t)
+static void scan_worker (char *address)
 {
-	(void) t;
+	struct addrinfo hints, *res, *ai;
+	struct epoll_event ev;
+	struct scan_adapter *a;
+	char *host, *port;
+	int fd = -1, busy, i, rc;
+
+	dist_address (address, &host, &port);
+	memset (&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	if ((rc = getaddrinfo (host, port, &hints, &res)) != 0)
+		fatal("%s: %s\n", address, gai_strerror (rc));
+	for (ai = res; ai; ai = ai->ai_next) {
+		if ((fd = socket (ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+			continue;
+		if (connect (fd, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close (fd);
+		fd = -1;
+	}
+	freeaddrinfo (res);
+	if (fd < 0 || peer_open (&coordinator, fd))
+		fatal("cannot connect to the coordinator: %d %m\n", errno);
 
-	return switch_pos;
+	/* wakes read_filters() up as soon as there is a TP to scan */
+	memset (&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)
+		fatal("epoll_ctl failed: %d %m\n", errno);
+
+	do {
+		busy = 0;
+		for (i = 0; i < n_adapters; i++) {
+			a = &adapters[i];
+
+			if (a->state == ADAPTER_SCANNING && a->n_filters == 0)
+				worker_report (a, 0);
+			else if (a->state == ADAPTER_TUNING) {
+				adapter_check_tune (a);
+				if (a->state == ADAPTER_IDLE)
+					worker_report (a, 1);
+			}
+
+			if (a->state == ADAPTER_IDLE && !worker_ending) {
+				fprintf (coordinator.out, "NEXT %d\n", a->fe_info.type);
+				fflush (coordinator.out);
+				a->state = ADAPTER_WAITING;
+			}
+			if (a->state == ADAPTER_TUNING || a->state == ADAPTER_SCANNING)
+				busy = 1;
+		}
+
+		read_filters (100);
+		if (!worker_ending && peer_read (&coordinator, worker_line) < 0) {
+			error("lost the coordinator\n");
+			break;
+		}
+	} while (busy || !worker_ending);
+
+	peer_close (&coordinator);
 }
 
-static void dump_lists (void)
+/**
+ *   -I: say what changed since the state file was written
+ */
+static void report_changes (void)
 {
 	struct list_head *p1, *p2;
 	struct transponder *t;
 	struct service *s;
-	int n = 0, i;
-	char sn[20];
-        int anon_services = 0;
+	int unchanged = 0, changed = 0, added = 0, gone = 0;
 
 	list_for_each(p1, &scanned_transponders) {
 		t = list_entry(p1, struct transponder, list);
 		if (t->wrong_frequency)
 			continue;
-		list_for_each(p2, &t->services) {
-			n++;
-		}
-	}
-	info("dumping lists (%d services)\n", n);
 
-	list_for_each(p1, &scanned_transponders) {
-		t = list_entry(p1, struct transponder, list);
-		if (t->wrong_frequency)
+		if (t->unchanged) {
+			unchanged++;
 			continue;
-		list_for_each(p2, &t->services) {
-			s = list_entry(p2, struct service, list);
-
-			if (!s->service_name) {
-				/* not in SDT */
-				if (unique_anon_services)
-					snprintf(sn, sizeof(sn), "[%03x-%04x]",
-						 anon_services, s->service_id);
-				else
-					snprintf(sn, sizeof(sn), "[%04x]",
-						 s->service_id);
-				s->service_name = strdup(sn);
-				anon_services++;
-			}
-			/* ':' is field separator in szap and vdr service lists */
-			for (i = 0; s->service_name[i]; i++) {
-				if (s->service_name[i] == ':')
-					s->service_name[i] = ' ';
-			}
-			for (i = 0; s->provider_name && s->provider_name[i]; i++) {
-				if (s->provider_name[i] == ':')
-					s->provider_name[i] = ' ';
+		}
+		if (!t->from_state) {
+			if (!t->last_tuning_failed)
+				added++;
+			continue;
+		}
+
+		if (t->probe) {
+			/* the services are not output, so they are gone too */
+			warning("transponder %u gone\n", t->param.frequency);
+			gone++;
+			list_for_each(p2, &t->services) {
+				s = list_entry(p2, struct service, list);
+				info("service 0x%04x '%s' gone\n", s->service_id,
+				     s->service_name ? s->service_name : "");
 			}
-			if (s->video_pid && !(serv_select & 1))
-				continue; /* no TV services */
-			if (!s->video_pid && s->audio_num && !(serv_select & 2))
-				continue; /* no radio services */
-			if (!s->video_pid && !s->audio_num && !(serv_select & 4))
-				continue; /* no data/other services */
-			if (s->scrambled && !ca_select)
-				continue; /* FTA only */
-			switch (output_format)
-			{
-			  case OUTPUT_PIDS:
-				pids_dump_service_parameter_set (stdout, s);
-				break;
-			  case OUTPUT_VDR:
-				vdr_dump_service_parameter_set (stdout,
-						    s->service_name,
-						    s->provider_name,
-						    t->type,
-						    &t->param,
-						    sat_polarisation(t),
-						    s->video_pid,
-						    s->pcr_pid,
-						    s->audio_pid,
-						    s->audio_lang,
-						    s->audio_num,
-						    s->teletext_pid,
-						    s->scrambled,
-						    //FIXME: s->subtitling_pid
-						    s->ac3_pid,
-						    s->service_id,
-						    t->original_network_id,
-						    s->transport_stream_id,
-						    t->orbital_pos,
-						    t->we_flag,
-						    vdr_dump_provider,
-						    ca_select,
-						    vdr_version,
-						    vdr_dump_channum,
-						    s->channel_num);
-				break;
-			  case OUTPUT_ZAP:
-				zap_dump_service_parameter_set (stdout,
-						    s->service_name,
-						    t->type,
-						    &t->param,
-						    sat_polarisation(t),
-						    sat_number(t),
-						    s->video_pid,
-						    s->audio_pid,
-						    s->service_id);
-			  default:
-				break;
-			  }
+			continue;
 		}
+
+		changed++;
 	}
-	info("Done.\n");
+
+	info("%d transponders unchanged, %d changed, %d new, %d gone\n",
+	     unchanged, changed, added, gone);
 }
 
 static void show_existing_tuning_data_files(void)
@@ -2522,17 +5065,45 @@ static const char *usage = "\n"
 	"	atsc/dvbscan doesn't do frequency scans, hence it needs initial\n"
 	"	tuning data for at least one transponder/channel.\n"
 	"	-c	scan on currently tuned transponder only\n"
+	"	-r [S|C|T|A:]file	like -c, but read the tables from a capture\n"
+	"		of a transponder instead of an adapter, as fast as the disk\n"
+	"		allows. The prefix is the delivery system (default T)\n"
 	"	-v 	verbose (repeat for more)\n"
 	"	-q 	quiet (repeat for less)\n"
 	"	-a N	use DVB /dev/dvb/adapterN/\n"
+	"	-a N,M,...	scan in parallel using several adapters\n"
 	"	-f N	use DVB /dev/dvb/adapter?/frontendN\n"
 	"	-d N	use DVB /dev/dvb/adapter?/demuxN\n"
+	"	-T	read all tables through one TS tap on /dev/dvb/adapter?/dvrN\n"
+	"		instead of section filters (for demuxes with few filters)\n"
 	"	-s N	use DiSEqC switch position N (DVB-S only)\n"
+	"	-R lon,lat[,speed]	drive a USALS rotor for a dish at longitude\n"
+	"		lon and latitude lat (e.g. 13.4E,52.5N), turning at speed\n"
+	"		degrees/s (default 1.5). Satellites are scanned one by one,\n"
+	"		nearest first (DVB-S only)\n"
+	"	-O pos	orbital position of the initial transponders (e.g. 19.2E),\n"
+	"		unless given after an S line's FEC\n"
+	"	-B lo-hi[,step]	blind scan (DVB-S only): sweep lo to hi MHz, in\n"
+	"		steps of step MHz (default 4), in both polarisations for\n"
+	"		carriers in the signal strength, and scan those too. The\n"
+	"		initial tuning data is optional then\n"
 	"	-i N	spectral inversion setting (0: off, 1: on, 2: auto [default])\n"
 	"	-n	evaluate NIT-other for full network scan (slow!)\n"
+	"	-F list|pmt	fast network discovery: read the SDT other, NIT\n"
+	"		other and BATs of the initial transponders too, and take\n"
+	"		the services of the other transponders of the network from\n"
+	"		them, either without tuning to those at all (list; there\n"
+	"		are no PIDs then), or tuning just for their PAT and PMTs\n"
+	"		(pmt)\n"
+	"	-F fastscan=PID[,verify]  operator FastScan: read the service\n"
+	"		list (FST) and transponder list (FNT) the operator sends\n"
+	"		on PID of the initial transponder, and output the whole\n"
+	"		list from those. With verify, then tune to each of the\n"
+	"		other transponders to check the services are in its PAT\n"
 	"	-5	multiply all filter timeouts by factor 5\n"
 	"		for non-DVB-compliant section repitition rates\n"
-	"	-o fmt	output format: 'zap' (default), 'vdr' or 'pids' (default with -c)\n"
+	"	-o fmt	output format: 'zap' (default), 'vdr', 'pids' (default with -c)\n"
+	"		or 'json' (one JSON object per line and service)\n"
 	"	-x N	Conditional Access, (default -1)\n"
 	"		N=0 gets only FTA channels\n"
 	"		N=-1 gets all channels\n"
@@ -2552,6 +5123,20 @@ static const char *usage = "\n"
 	"	-U	Uniquely name unknown services\n"
 	"	-C cs	Override default charset for service name/provider (default = ISO-6937)\n"
 	"	-D cs	Output charset (default = %s)\n"
+	"	-L	print tune, lock, PAT and PMT latency histograms when done\n"
+	"	-I file	incremental rescan: the transponders and services found are\n"
+	"		kept in file, and the next run with it only reads the PAT,\n"
+	"		SDT and NIT versions of each transponder in it, scanning it\n"
+	"		again if one changed. Only the services of new and changed\n"
+	"		transponders are output. The initial tuning data is only\n"
+	"		needed while file does not exist\n"
+	"	-S [host:]port	coordinate a distributed scan: hand the\n"
+	"		transponders out to the workers connecting on port (default\n"
+	"		" DIST_PORT "), and output what they found. No adapters are\n"
+	"		used here\n"
+	"	-W host[:port]	be a worker of the coordinator at host, scanning\n"
+	"		the transponders it gives out with the -a adapters. The\n"
+	"		initial tuning data is the coordinator's\n"
 	"Supported charsets by -C/-D parameters can be obtained via 'iconv -l' command\n";
 
 void
@@ -2586,13 +5171,15 @@ bad_usage(char *pname, int problem)
 
 int main (int argc, char **argv)
 {
-	char frontend_devname [80];
-	int adapter = 0, frontend = 0, demux = 0;
+	int adapter_ids[MAX_ADAPTERS] = { 0 };
+	int frontend = 0, demux = 0;
 	int opt, i;
-	int frontend_fd;
 	int fe_open_mode;
+	char *tok;
+	struct scan_adapter *a;
 	const char *initial = NULL;
 	char *charset;
+	char *coordinate = NULL, *worker = NULL;
 
 	if (argc <= 1) {
 	    bad_usage(argv[0], 2);
@@ -2619,12 +5206,21 @@ int main (int argc, char **argv)
 	} else
 		output_charset = nl_langinfo(CODESET);
 
+	init_hashes();
+
 	/* start with default lnb type */
 	lnb_type = *lnb_enum(0);
-	while ((opt = getopt(argc, argv, "5cnpa:f:d:s:o:x:e:t:i:l:vquPA:UC:D:")) != -1) {
+	while ((opt = getopt(argc, argv, "5cnpa:f:d:s:o:x:e:t:i:l:vquPA:UC:D:TLR:O:I:F:B:S:W:r:")) != -1) {
 		switch (opt) {
 		case 'a':
-			adapter = strtoul(optarg, NULL, 0);
+			n_adapters = 0;
+			for (tok = strtok(optarg, ","); tok; tok = strtok(NULL, ",")) {
+				if (n_adapters == MAX_ADAPTERS) {
+					bad_usage(argv[0], 0);
+					return -1;
+				}
+				adapter_ids[n_adapters++] = strtoul(tok, NULL, 0);
+			}
 			break;
 		case 'c':
 			current_tp_only = 1;
@@ -2650,6 +5246,7 @@ int main (int argc, char **argv)
                         if      (strcmp(optarg, "zap") == 0) output_format = OUTPUT_ZAP;
                         else if (strcmp(optarg, "vdr") == 0) output_format = OUTPUT_VDR;
                         else if (strcmp(optarg, "pids") == 0) output_format = OUTPUT_PIDS;
+                        else if (strcmp(optarg, "json") == 0) output_format = OUTPUT_JSON;
                         else {
 				bad_usage(argv[0], 0);
 				return -1;
@@ -2707,6 +5304,84 @@ int main (int argc, char **argv)
 		case 'D':
 			output_charset = optarg;
 			break;
+		case 'T':
+			ts_mode = 1;
+			break;
+		case 'L':
+			show_latency = 1;
+			break;
+		case 'R':
+			if (rotor_decode(optarg, &rotor_site)) {
+				bad_usage(argv[0], 0);
+				return -1;
+			}
+			use_rotor = 1;
+			break;
+		case 'O':
+			if (parse_orbital_pos(optarg, &initial_orbital_pos, &initial_we_flag)) {
+				bad_usage(argv[0], 0);
+				return -1;
+			}
+			break;
+		case 'I':
+			state_file = optarg;
+			break;
+		case 'B': {
+			unsigned int lo, hi, step = 4;
+
+			if ((sscanf(optarg, "%u-%u,%u", &lo, &hi, &step) < 2) ||
+			    (lo >= hi) || (step == 0) || (step > hi - lo)) {
+				bad_usage(argv[0], 0);
+				return -1;
+			}
+			blind_lo = lo * 1000;
+			blind_hi = hi * 1000;
+			blind_step = step * 1000;
+			blind_scan = 1;
+			break;
+		}
+		case 'F': {
+			char verify[8] = "";
+			int n = 0;
+
+			if (strcmp(optarg, "list") == 0) fast_scan = FAST_LIST;
+			else if (strcmp(optarg, "pmt") == 0) fast_scan = FAST_PMT;
+			else if ((sscanf(optarg, "fastscan=%i%n,%7s", &fastscan_pid, &n, verify) >= 1) &&
+				 (fastscan_pid > 0) && (fastscan_pid < 0x1fff) &&
+				 (!optarg[n] || !strcmp(verify, "verify"))) {
+				fast_scan = FAST_OPERATOR;
+				fastscan_verify = !!optarg[n];
+			} else {
+				bad_usage(argv[0], 0);
+				return -1;
+			}
+			break;
+		}
+		case 'S':
+			coordinate = optarg;
+			break;
+		case 'W':
+			worker = optarg;
+			break;
+		case 'r':
+			capture_file = optarg;
+			if (strlen(optarg) > 2 && optarg[1] == ':') {
+				switch (optarg[0]) {
+				case 'S': capture_type = FE_QPSK; break;
+				case 'C': capture_type = FE_QAM; break;
+				case 'T': capture_type = FE_OFDM; break;
+				case 'A': capture_type = FE_ATSC; break;
+				default:
+					bad_usage(argv[0], 0);
+					return -1;
+				}
+				capture_file = optarg + 2;
+			}
+			current_tp_only = 1;
+			ts_mode = 1;
+			if (!output_format_set)
+				output_format = OUTPUT_PIDS;
+			break;
 		default:
 			bad_usage(argv[0], 0);
 			return -1;
@@ -2715,7 +5390,25 @@ int main (int argc, char **argv)
 
 	if (optind < argc)
 		initial = argv[optind];
-	if ((!initial && !current_tp_only) || (initial && current_tp_only) ||
+	if ((coordinate || worker) &&
+	    (current_tp_only || state_file || fast_scan || blind_scan ||
+	     (coordinate && (worker || n_adapters)) || (worker && initial))) {
+		bad_usage(argv[0], 0);
+		return -1;
+	}
+	/* the coordinator leaves the tuning to the workers */
+	if (n_adapters == 0 && !coordinate)
+		n_adapters = 1;
+	if (state_file && !current_tp_only) {
+		if ((state_loaded = read_state (state_file)) < 0)
+			return -1;
+	}
+	if ((!initial && !current_tp_only && !state_loaded && !blind_scan && !worker) ||
+			(initial && current_tp_only) ||
+			(state_file && current_tp_only) ||
+			(current_tp_only && n_adapters > 1) ||
+			(fast_scan && (current_tp_only || state_file)) ||
+			(blind_scan && (current_tp_only || state_file || use_rotor)) ||
 			(spectral_inversion > 2)) {
 		bad_usage(argv[0], 0);
 		return -1;
@@ -2727,65 +5420,153 @@ int main (int argc, char **argv)
 		fprintf (stderr, "switch position needs to be < 4!\n");
 		return -1;
 	}
-	if (initial)
+	if (state_loaded)
+		info("rescanning %s\n", state_file);
+	else if (initial)
 		info("scanning %s\n", initial);
 
-	snprintf (frontend_devname, sizeof(frontend_devname),
-		  "/dev/dvb/adapter%i/frontend%i", adapter, frontend);
+	if ((epoll_fd = epoll_create(MAX_EVENTS)) < 0)
+		fatal("epoll_create failed: %d %m\n", errno);
+	if ((demuxbufs = dvbdemuxbuf_create (0, (verbosity >= 3) ? DVBDEMUXBUF_LOG : 0)) == NULL)
+		fatal("out of memory\n");
+
+	/* non-blocking, so that FE_GET_EVENT can be used to flush events */
+	fe_open_mode = (current_tp_only ? O_RDONLY : O_RDWR) | O_NONBLOCK;
+	for (i = 0; i < n_adapters; i++) {
+		a = &adapters[i];
+
+		snprintf (a->frontend_devname, sizeof(a->frontend_devname),
+			  "/dev/dvb/adapter%i/frontend%i", adapter_ids[i], frontend);
+
+		snprintf (a->demux_devname, sizeof(a->demux_devname),
+			  "/dev/dvb/adapter%i/demux%i", adapter_ids[i], demux);
+		INIT_LIST_HEAD(&a->waiting_filters);
+		a->state = ADAPTER_IDLE;
+		a->max_running = MAX_RUNNING;
+		a->switch_index = -1;
+		a->fepool_checkout = -1;
+
+		if (capture_file) {
+			info("reading '%s'\n", capture_file);
+			if ((a->tap = ts_tap_open_file (capture_file)) == NULL)
+				fatal("failed to read '%s'\n", capture_file);
+			a->frontend_fd = -1;
+			a->fe_info.type = capture_type;
+			continue;
+		}
+		info("using '%s' and '%s'\n", a->frontend_devname, a->demux_devname);
 
-	snprintf (demux_devname, sizeof(demux_devname),
-		  "/dev/dvb/adapter%i/demux%i", adapter, demux);
-	info("using '%s' and '%s'\n", frontend_devname, demux_devname);
+		if (ts_mode) {
+			struct epoll_event ev;
 
-	for (i = 0; i < MAX_RUNNING; i++)
-		poll_fds[i].fd = -1;
+			snprintf (a->dvr_devname, sizeof(a->dvr_devname),
+				  "/dev/dvb/adapter%i/dvr%i", adapter_ids[i], demux);
+			if ((a->tap = ts_tap_open (a->demux_devname, a->dvr_devname)) == NULL)
+				fatal("failed to open TS tap on '%s'\n", a->dvr_devname);
 
-	fe_open_mode = current_tp_only ? O_RDONLY : O_RDWR;
-	if ((frontend_fd = open (frontend_devname, fe_open_mode)) < 0)
-		fatal("failed to open '%s': %d %m\n", frontend_devname, errno);
-	/* determine FE type and caps */
-	if (ioctl(frontend_fd, FE_GET_INFO, &fe_info) == -1)
-		fatal("FE_GET_INFO failed: %d %m\n", errno);
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN;
+			ev.data.ptr = a;
+			if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ts_tap_fd(a->tap), &ev) == -1)
+				fatal("epoll_ctl failed: %d %m\n", errno);
+		}
 
-	if ((spectral_inversion == INVERSION_AUTO ) &&
-	    !(fe_info.caps & FE_CAN_INVERSION_AUTO)) {
-		info("Frontend can not do INVERSION_AUTO, trying INVERSION_OFF instead\n");
-		spectral_inversion = INVERSION_OFF;
+		/* a frontend dvbfepoold keeps warm tunes without loading firmware */
+		if (current_tp_only ||
+		    ((a->frontend_fd = dvbfepool_open_frontend (adapter_ids[i], frontend,
+								 &a->fepool_checkout)) < 0)) {
+			if ((a->frontend_fd = open (a->frontend_devname, fe_open_mode)) < 0)
+				fatal("failed to open '%s': %d %m\n", a->frontend_devname, errno);
+		} else {
+			info("using the warm frontend from dvbfepoold\n");
+			fcntl (a->frontend_fd, F_SETFL, O_NONBLOCK);
+		}
+		/* determine FE type and caps */
+		if (ioctl(a->frontend_fd, FE_GET_INFO, &a->fe_info) == -1)
+			fatal("FE_GET_INFO failed: %d %m\n", errno);
+
+		if ((spectral_inversion == INVERSION_AUTO ) &&
+		    !(a->fe_info.caps & FE_CAN_INVERSION_AUTO)) {
+			info("Frontend can not do INVERSION_AUTO, trying INVERSION_OFF instead\n");
+			spectral_inversion = INVERSION_OFF;
+		}
 	}
 
+	output_init (&out, STDOUT_FILENO);
+	if (state_file && open_state (state_file))
+		return -1;
+
 	signal(SIGINT, handle_sigint);
+	if (coordinate || worker)
+		signal(SIGPIPE, SIG_IGN);
+
+	if (blind_scan)
+		blind_sweep ();
 
 	if (current_tp_only) {
 		current_tp = alloc_transponder(0); /* dummy */
+		if (capture_file)
+			current_tp->type = capture_type;
 		/* move TP from "new" to "scanned" list */
 		list_del_init(&current_tp->list);
 		list_add_tail(&current_tp->list, &scanned_transponders);
 		current_tp->scan_done = 1;
-		scan_tp ();
+		scan_tp (&adapters[0]);
 	}
+	else if (coordinate)
+		scan_coordinate (initial, coordinate);
+	else if (worker)
+		scan_worker (worker);
+	else if (n_adapters > 1)
+		scan_network_multi (initial);
 	else
-		scan_network (frontend_fd, initial);
+		scan_network (&adapters[0], initial);
+
+	for (i = 0; i < n_adapters; i++) {
+		if (adapters[i].tap)
+			ts_tap_close (adapters[i].tap);
+		if (adapters[i].frontend_fd >= 0)
+			close (adapters[i].frontend_fd);
+		if (adapters[i].fepool_checkout >= 0)
+			close (adapters[i].fepool_checkout);
+	}
 
-	close (frontend_fd);
+	if (state_file)
+		close_state (state_file);
 
 	dump_lists ();
 
+	if (state_file)
+		report_changes ();
+
+	if (show_latency)
+		dvblatency_dump (stderr);
+
+	dvbdemuxbuf_destroy (demuxbufs);
 	return 0;
 }
 
 static void dump_dvb_parameters (FILE *f, struct transponder *t)
 {
+	struct output o;
+
+	fflush (f);
+	output_init (&o, fileno (f));
+
 	switch (output_format) {
 		case OUTPUT_PIDS:
 		case OUTPUT_VDR:
-			vdr_dump_dvb_parameters(f, t->type, &t->param,
+		case OUTPUT_JSON:
+			vdr_dump_dvb_parameters(&o, t->type, &t->param,
 					sat_polarisation (t), t->orbital_pos, t->we_flag);
 			break;
 		case OUTPUT_ZAP:
-			zap_dump_dvb_parameters (f, t->type, &t->param,
+			zap_dump_dvb_parameters (&o, t->type, &t->param,
 					sat_polarisation (t), sat_number (t));
 			break;
 		default:
 			break;
 	}
+
+	output_flush (&o);
 }
@@ -0,0 +1,356 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <linux/dvb/dmx.h>
+
+#include <libucsi/crc32.h>
+#include <libucsi/section_reasm.h>
+#include <libdvbswdemux/dvbswdemux.h>
+#include <libdvbswdemux/dvbswdemux_file.h>
+
+#include "scan.h"
+#include "ts_tap.h"
+
+#define TS_PACKET_SIZE 188
+#define TS_TAP_BUFFER_SIZE (TS_PACKET_SIZE * 4096)	/* DVR ring buffer */
+#define TS_TAP_READ_SIZE (TS_PACKET_SIZE * 348)
+#define TS_TAP_MAX_SECTION 4096		/* FastScan has private sections */
+#define TS_MAX_PIDS 8192
+
+
+/* -r: the software demux filter of a PID */
+struct ts_tap_pid {
+	struct ts_tap *tap;
+	int pid;
+	struct dvbswdemux_filter *filter;
+};
+
+
+struct ts_tap {
+	char demux_devname[80];
+	int demux_fd;			/* -1 while no PID is tapped */
+	int dvr_fd;
+	struct section_reasm *reasm;
+	ts_tap_callback cb;
+	void *priv;
+	int n_pids;
+	uint16_t users[TS_MAX_PIDS];	/* section filters per PID */
+	int reading;			/* inside ts_tap_read() */
+	int n_stale;			/* PIDs to drop from the reassembler */
+	uint16_t stale[TS_TAP_MAX_PIDS];
+	uint8_t buf[TS_TAP_READ_SIZE];
+
+	struct dvbswdemux *swdemux;	/* -r: the capture file */
+	struct dvbswdemux_file *file;
+	struct ts_tap_pid pids[TS_MAX_PIDS];
+};
+
+
+struct ts_tap *ts_tap_open (const char *demux_devname, const char *dvr_devname)
+{
+	struct ts_tap *tap;
+
+	if ((tap = calloc (1, sizeof(struct ts_tap))) == NULL)
+		return NULL;
+
+	strncpy (tap->demux_devname, demux_devname, sizeof(tap->demux_devname) - 1);
+	tap->demux_fd = -1;
+
+	/* stale PIDs still hold their slot until ts_tap_read() returns */
+	if ((tap->reasm = section_reasm_create (2 * TS_TAP_MAX_PIDS,
+						 TS_TAP_MAX_SECTION)) == NULL)
+		goto err0;
+
+	if ((tap->dvr_fd = open (dvr_devname, O_RDONLY | O_NONBLOCK)) < 0) {
+		errorn ("open dvr failed");
+		goto err1;
+	}
+	if (ioctl (tap->dvr_fd, DMX_SET_BUFFER_SIZE, TS_TAP_BUFFER_SIZE) == -1)
+		warning("ioctl DMX_SET_BUFFER_SIZE failed: %d %m\n", errno);
+
+	return tap;
+
+err1:
+	section_reasm_destroy (tap->reasm);
+err0:
+	free (tap);
+	return NULL;
+}
+
+
+struct ts_tap *ts_tap_open_file (const char *filename)
+{
+	struct ts_tap *tap;
+	int i;
+
+	if ((tap = calloc (1, sizeof(struct ts_tap))) == NULL)
+		return NULL;
+	tap->demux_fd = -1;
+	tap->dvr_fd = -1;
+
+	if ((tap->swdemux = dvbswdemux_create ()) == NULL)
+		goto err0;
+	if ((tap->file = dvbswdemux_file_open (filename, tap->swdemux, 0)) == NULL) {
+		errorn ("open capture failed");
+		goto err1;
+	}
+	for (i = 0; i < TS_MAX_PIDS; i++) {
+		tap->pids[i].tap = tap;
+		tap->pids[i].pid = i;
+	}
+
+	return tap;
+
+err1:
+	dvbswdemux_destroy (tap->swdemux);
+err0:
+	free (tap);
+	return NULL;
+}
+
+
+void ts_tap_close (struct ts_tap *tap)
+{
+	if (tap->file) {
+		dvbswdemux_file_close (tap->file);
+		dvbswdemux_destroy (tap->swdemux);
+		free (tap);
+		return;
+	}
+	if (tap->demux_fd >= 0) {
+		ioctl (tap->demux_fd, DMX_STOP);
+		close (tap->demux_fd);
+	}
+	close (tap->dvr_fd);
+	section_reasm_destroy (tap->reasm);
+	free (tap);
+}
+
+
+int ts_tap_fd (struct ts_tap *tap)
+{
+	return tap->dvr_fd;
+}
+
+
+/**
+ *   throw away whatever is left in the DVR buffer from a previous tap
+ */
+static void ts_tap_drain (struct ts_tap *tap)
+{
+	int count;
+
+	do {
+		count = read (tap->dvr_fd, tap->buf, sizeof(tap->buf));
+	} while ((count > 0) || ((count < 0) && (errno == EOVERFLOW)));
+}
+
+
+static int ts_tap_start (struct ts_tap *tap, int pid)
+{
+	struct dmx_pes_filter_params f;
+	int err;
+
+	ts_tap_drain (tap);
+
+	if ((tap->demux_fd = open (tap->demux_devname, O_RDWR | O_NONBLOCK)) < 0)
+		return -errno;
+
+	memset(&f, 0, sizeof(f));
+	f.pid = (uint16_t) pid;
+	f.input = DMX_IN_FRONTEND;
+	f.output = DMX_OUT_TS_TAP;
+	f.pes_type = DMX_PES_OTHER;
+	f.flags = DMX_IMMEDIATE_START;
+
+	if (ioctl (tap->demux_fd, DMX_SET_PES_FILTER, &f) == -1) {
+		err = errno;
+		errorn ("ioctl DMX_SET_PES_FILTER failed");
+		close (tap->demux_fd);
+		tap->demux_fd = -1;
+		return -err;
+	}
+
+	return 0;
+}
+
+
+static void ts_tap_stop (struct ts_tap *tap)
+{
+	ioctl (tap->demux_fd, DMX_STOP);
+	close (tap->demux_fd);
+	tap->demux_fd = -1;
+}
+
+
+static int ts_tap_file_section (void *priv, uint8_t *section, int len)
+{
+	struct ts_tap_pid *p = priv;
+
+	if (p->tap->users[p->pid])
+		p->tap->cb (p->tap->priv, p->pid, section, len);
+	return 0;
+}
+
+
+int ts_tap_add_pid (struct ts_tap *tap, int pid)
+{
+	uint16_t p = pid;
+	uint8_t filter[18], mask[18];
+	int err;
+
+	if ((pid < 0) || (pid >= TS_MAX_PIDS))
+		return -EINVAL;
+	if (tap->users[pid]) {
+		tap->users[pid]++;
+		return 0;
+	}
+
+	if (tap->file) {
+		/* every section of the PID, CRC checked by the demux */
+		memset (filter, 0, sizeof(filter));
+		memset (mask, 0, sizeof(mask));
+		tap->pids[pid].filter = dvbswdemux_add_section_filter (tap->swdemux, pid,
+								       filter, mask, 1,
+								       ts_tap_file_section,
+								       &tap->pids[pid]);
+		if (tap->pids[pid].filter == NULL)
+			return -ENOMEM;
+		verbosedebug("tap pid 0x%04x\n", pid);
+		tap->users[pid] = 1;
+		tap->n_pids++;
+		return 0;
+	}
+	if (tap->n_pids == TS_TAP_MAX_PIDS)
+		return -ENOSPC;
+
+	if (tap->demux_fd < 0) {
+		if ((err = ts_tap_start (tap, pid)) < 0)
+			return err;
+	} else if (ioctl (tap->demux_fd, DMX_ADD_PID, &p) == -1) {
+		return -errno;
+	}
+
+	/* a PID dropped earlier in this read may still be registered */
+	section_reasm_reset_pid (tap->reasm, pid);
+	if ((err = section_reasm_add_pid (tap->reasm, pid)) < 0) {
+		if (tap->n_pids)
+			ioctl (tap->demux_fd, DMX_REMOVE_PID, &p);
+		else
+			ts_tap_stop (tap);
+		return err;
+	}
+
+	verbosedebug("tap pid 0x%04x\n", pid);
+	tap->users[pid] = 1;
+	tap->n_pids++;
+
+	return 0;
+}
+
+
+void ts_tap_remove_pid (struct ts_tap *tap, int pid)
+{
+	uint16_t p = pid;
+
+	if ((pid < 0) || (pid >= TS_MAX_PIDS) || !tap->users[pid])
+		return;
+	if (--tap->users[pid])
+		return;
+
+	if (tap->file) {
+		verbosedebug("untap pid 0x%04x\n", pid);
+		dvbswdemux_remove_filter (tap->swdemux, tap->pids[pid].filter);
+		tap->pids[pid].filter = NULL;
+		tap->n_pids--;
+		return;
+	}
+
+	verbosedebug("untap pid 0x%04x\n", pid);
+	if (--tap->n_pids == 0)
+		ts_tap_stop (tap);
+	else
+		ioctl (tap->demux_fd, DMX_REMOVE_PID, &p);
+
+	/* the reassembler may be in the middle of this PID's packet */
+	if (tap->reading && (tap->n_stale < TS_TAP_MAX_PIDS))
+		tap->stale[tap->n_stale++] = pid;
+	else
+		section_reasm_remove_pid (tap->reasm, pid);
+}
+
+
+static void ts_tap_section (void *priv, int pid, uint8_t *section, int len)
+{
+	struct ts_tap *tap = priv;
+
+	if (!tap->users[pid])
+		return;
+
+	/* what DMX_CHECK_CRC would have done for a section filter */
+	if ((section[1] & 0x80) && crc32 (CRC32_INIT, section, len)) {
+		verbosedebug("CRC error on pid 0x%04x\n", pid);
+		return;
+	}
+
+	tap->cb (tap->priv, pid, section, len);
+}
+
+
+int ts_tap_read (struct ts_tap *tap, ts_tap_callback cb, void *priv)
+{
+	uint64_t pos;
+	int count, i;
+
+	if (tap->file) {
+		tap->cb = cb;
+		tap->priv = priv;
+		pos = dvbswdemux_file_position (tap->file);
+		if (dvbswdemux_file_feed (tap->file) < 0)
+			return -ENOMEM;
+		return dvbswdemux_file_position (tap->file) - pos;
+	}
+
+	count = read (tap->dvr_fd, tap->buf, sizeof(tap->buf));
+	if ((count < 0) && (errno == EOVERFLOW)) {
+		/* packets were lost: no partial section can be trusted */
+		warning("DVR buffer overflow\n");
+		for (i = 0; i < TS_MAX_PIDS; i++)
+			if (tap->users[i])
+				section_reasm_reset_pid (tap->reasm, i);
+		count = read (tap->dvr_fd, tap->buf, sizeof(tap->buf));
+	}
+	if (count < 0)
+		return (errno == EAGAIN) ? 0 : -errno;
+
+	tap->cb = cb;
+	tap->priv = priv;
+	tap->reading = 1;
+	section_reasm_add_packets (tap->reasm, tap->buf, count,
+				   ts_tap_section, tap);
+	tap->reading = 0;
+
+	for (i = 0; i < tap->n_stale; i++)
+		if (!tap->users[tap->stale[i]])
+			section_reasm_remove_pid (tap->reasm, tap->stale[i]);
+	tap->n_stale = 0;
+
+	return count;
+}
+
+
+uint64_t ts_tap_position (struct ts_tap *tap)
+{
+	return tap->file ? dvbswdemux_file_position (tap->file) : 0;
+}
+
+
+uint64_t ts_tap_size (struct ts_tap *tap)
+{
+	return tap->file ? dvbswdemux_file_size (tap->file) : 0;
+}
@@ -0,0 +1,73 @@
+#ifndef __TS_TAP_H__
+#define __TS_TAP_H__
+
+#include <stdint.h>
+
+/**
+ *   Single TS tap on the DVR device: one PES filter with DMX_OUT_TS_TAP,
+ *   extended with DMX_ADD_PID for every PID needed, and the sections
+ *   reassembled in userspace. This needs no hardware section filters at
+ *   all, only PID filters.
+ */
+
+#define TS_TAP_MAX_PIDS 256
+
+
+struct ts_tap;
+
+/**
+ *   called for every complete section with a valid CRC; the data is only
+ *   valid until the callback returns
+ */
+typedef void (*ts_tap_callback) (void *priv, int pid,
+				 const unsigned char *buf, int len);
+
+
+extern struct ts_tap *ts_tap_open (const char *demux_devname,
+				   const char *dvr_devname);
+
+/**
+ *   -r: a tap on a capture file instead, read through the software demux
+ *   as fast as the disk allows, over and over (see dvbswdemux_file.h).
+ *   No PID filters are needed, and there is no file descriptor to wait on:
+ *   ts_tap_read() always has data.
+ */
+extern struct ts_tap *ts_tap_open_file (const char *filename);
+
+extern void ts_tap_close (struct ts_tap *tap);
+
+/**
+ *   the DVR file descriptor, to wait on for data (-1 for a capture file)
+ */
+extern int ts_tap_fd (struct ts_tap *tap);
+
+/**
+ *   start receiving a PID; PIDs are reference counted, so this may be
+ *   called once per section filter which needs it.
+ *   returns 0 on success, or -errno (-ENOSPC or -EBUSY if the demux is
+ *   out of PID filters)
+ */
+extern int ts_tap_add_pid (struct ts_tap *tap, int pid);
+
+/**
+ *   drop one reference to a PID, and stop receiving it with the last one
+ */
+extern void ts_tap_remove_pid (struct ts_tap *tap, int pid);
+
+/**
+ *   read what is available from the DVR and pass the sections on.
+ *   The callback may add and remove PIDs.
+ *   returns the number of bytes read, or -errno
+ */
+extern int ts_tap_read (struct ts_tap *tap, ts_tap_callback cb, void *priv);
+
+/**
+ *   capture file: bytes read so far, over all the passes, and the size of
+ *   the file. A PID added at position p has seen the whole capture once the
+ *   position gets to p + size.
+ */
+extern uint64_t ts_tap_position (struct ts_tap *tap);
+extern uint64_t ts_tap_size (struct ts_tap *tap);
+
+
+#endif
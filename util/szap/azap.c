@@ -170,19 +170,12 @@ int try_parse_param(int fd, const Param * plist, int list_size, int *param,
 }
 
 
-int parse(const char *fname, const char *channel,
-	  struct dvb_frontend_parameters *frontend, int *vpid, int *apid, int *sid)
+static int parse_channel(int fd, const char *channel,
+			 struct dvb_frontend_parameters *frontend, int *vpid, int *apid, int *sid)
 {
-	int fd;
 	int err;
 	int tmp;
 
-	if ((fd = open(fname, O_RDONLY | O_NONBLOCK)) < 0) {
-		PERROR ("could not open file '%s'", fname);
-		perror ("");
-		return -1;
-	}
-
 	if (find_channel(fd, channel) < 0) {
 		ERROR("could not find channel '%s' in channel list", channel);
 		return -2;
@@ -207,12 +200,29 @@ int parse(const char *fname, const char *channel,
 	if ((err = try_parse_int(fd, sid, "Service ID")))
 		return -7;
 
-	close(fd);
-
 	return 0;
 }
 
 
+int parse(const char *fname, const char *channel,
+	  struct dvb_frontend_parameters *frontend, int *vpid, int *apid, int *sid)
+{
+	int fd;
+	int err;
+
+	if ((fd = open(fname, O_RDONLY | O_NONBLOCK)) < 0) {
+		PERROR ("could not open file '%s'", fname);
+		perror ("");
+		return -1;
+	}
+
+	/* closed either way: the server mode parses again and again */
+	err = parse_channel(fd, channel, frontend, vpid, apid, sid);
+	close(fd);
+	return err;
+}
+
+
 static
 int setup_frontend (int fe_fd, struct dvb_frontend_parameters *frontend)
 {
@@ -265,7 +275,36 @@ int monitor_frontend (int fe_fd)
 }
 
 
-static const char *usage = "\nusage: %s [-a adapter_num] [-f frontend_id] [-d demux_id] [-c conf_file] [-r] [-p] <channel name>\n\n";
+/*
+ * Server mode (-u): retune and retarget the open filters for each switch
+ * command, until killed.
+ */
+static void server_loop(int server_fd, const char *confname, int frontend_fd,
+			int pmt_fd, int video_fd, int audio_fd, int dvr)
+{
+	struct dvb_frontend_parameters frontend_param;
+	char name[256];
+	unsigned int number;
+	int vpid, apid, sid, ok;
+
+	while (zap_server_next(server_fd, name, sizeof(name), &number) == 0) {
+		memset(&frontend_param, 0, sizeof(struct dvb_frontend_parameters));
+		ok = 0;
+		if (number) {
+			ERROR("channel numbers are not supported");
+		} else if (!parse(confname, name, &frontend_param, &vpid, &apid, &sid) &&
+			   !setup_frontend(frontend_fd, &frontend_param)) {
+			ok = !zap_server_filters(DEMUX_DEV, confname, NULL, sid, pmt_fd,
+						 vpid, video_fd, apid, audio_fd, dvr);
+		}
+		zap_server_reply(ok, frontend_fd, ZAP_SERVER_LOCK_TIMEOUT);
+	}
+}
+
+
+static const char *usage = "\nusage: %s [-a adapter_num] [-f frontend_id] [-d demux_id] [-c conf_file] [-r] [-p] [-u socket] <channel name>\n\n"
+	"     -u socket : once tuned, keep the devices open and take further\n"
+	"                 channel names from unix socket 'socket'\n\n";
 
 
 int main(int argc, char **argv)
@@ -276,12 +315,13 @@ int main(int argc, char **argv)
 	char *channel = NULL;
 	int adapter = 0, frontend = 0, demux = 0, dvr = 0;
 	int vpid, apid, sid, pmtpid = 0;
-	int pat_fd, pmt_fd;
+	int pat_fd = -1, pmt_fd = -1;
 	int frontend_fd, audio_fd, video_fd;
+	int server_fd = -1;
 	int opt;
 	int rec_psi = 0;
 
-	while ((opt = getopt(argc, argv, "hrpn:a:f:d:c:")) != -1) {
+	while ((opt = getopt(argc, argv, "hrpn:a:f:d:c:u:")) != -1) {
 		switch (opt) {
 		case 'a':
 			adapter = strtoul(optarg, NULL, 0);
@@ -301,6 +341,10 @@ int main(int argc, char **argv)
 		case 'c':
 			confname = optarg;
 			break;
+		case 'u':
+			if ((server_fd = zap_server_open(optarg)) < 0)
+				return -1;
+			break;
 		case '?':
 		case 'h':
 		default:
@@ -388,7 +432,10 @@ int main(int argc, char **argv)
 	if (set_pesfilter (audio_fd, apid, DMX_PES_AUDIO, dvr) < 0)
 		return -1;
 
-	monitor_frontend (frontend_fd);
+	if (server_fd >= 0)
+		server_loop(server_fd, confname, frontend_fd, pmt_fd, video_fd, audio_fd, dvr);
+	else
+		monitor_frontend (frontend_fd);
 
 	close (pat_fd);
 	close (pmt_fd);
@@ -239,6 +239,33 @@ int monitor_frontend (int fe_fd, int human_readable)
 }
 
 
+/*
+ * Server mode (-u): retune and retarget the open filters for each switch
+ * command, until killed.
+ */
+static void server_loop(int server_fd, const char *confname, int frontend_fd,
+			int pmt_fd, int video_fd, int audio_fd, int dvr)
+{
+	struct dvb_frontend_parameters frontend_param;
+	char name[256], pmtkey[32];
+	unsigned int number;
+	int vpid, apid, sid, ok;
+
+	while (zap_server_next(server_fd, name, sizeof(name), &number) == 0) {
+		memset(&frontend_param, 0, sizeof(struct dvb_frontend_parameters));
+		ok = 0;
+		if (!parse(confname, 0, number, number ? NULL : name,
+			   &frontend_param, &vpid, &apid, &sid) &&
+		    !setup_frontend(frontend_fd, &frontend_param)) {
+			snprintf(pmtkey, sizeof(pmtkey), "%u", frontend_param.frequency);
+			ok = !zap_server_filters(DEMUX_DEV, confname, pmtkey, sid, pmt_fd,
+						 vpid, video_fd, apid, audio_fd, dvr);
+		}
+		zap_server_reply(ok, frontend_fd, ZAP_SERVER_LOCK_TIMEOUT);
+	}
+}
+
+
 static const char *usage =
 	"\nusage: %s [options]  -l\n"
 	"         list known channels\n"
@@ -251,7 +278,9 @@ static const char *usage =
 	"     -x        : exit after tuning\n"
 	"     -H        : human readable output\n"
 	"     -r        : set up /dev/dvb/adapterX/dvr0 for TS recording\n"
-	"     -p        : add pat and pmt to TS recording (implies -r)\n";
+	"     -p        : add pat and pmt to TS recording (implies -r)\n"
+	"     -u socket : once tuned, keep the devices open and take further\n"
+	"                 channel names or -n numbers from unix socket 'socket'\n";
 
 int main(int argc, char **argv)
 {
@@ -261,11 +290,15 @@ int main(int argc, char **argv)
 	char *channel = NULL;
 	int adapter = 0, frontend = 0, demux = 0, dvr = 0;
 	int vpid, apid, sid, pmtpid = 0;
-	int frontend_fd, video_fd, audio_fd, pat_fd, pmt_fd;
+	int cached_pmt = 0;
+	char pmtkey[32];
+	int frontend_fd, video_fd, audio_fd, pat_fd = -1, pmt_fd = -1;
+	int server_fd = -1;
+	char *server_path = NULL;
 	int opt, list_channels = 0, chan_no = 0;
 	int human_readable = 0, rec_psi = 0;
 
-	while ((opt = getopt(argc, argv, "Hln:hrn:a:f:d:c:x:p")) != -1) {
+	while ((opt = getopt(argc, argv, "Hln:hrn:a:f:d:c:x:pu:")) != -1) {
 		switch (opt) {
 		case 'a':
 			adapter = strtoul(optarg, NULL, 0);
@@ -297,6 +330,9 @@ int main(int argc, char **argv)
 		case 'c':
 			confname = optarg;
 			break;
+		case 'u':
+			server_path = optarg;
+			break;
 		case '?':
 		case 'h':
 		default:
@@ -308,10 +344,12 @@ int main(int argc, char **argv)
 	if (optind < argc)
 		channel = argv[optind];
 
-	if (!channel && chan_no <= 0 && !list_channels) {
+	if ((!channel && chan_no <= 0 && !list_channels) || (server_path && list_channels)) {
 		fprintf (stderr, usage, argv[0], argv[0]);
 		return -1;
 	}
+	if (server_path && ((server_fd = zap_server_open(server_path)) < 0))
+		return -1;
 
 	if (!homedir)
 		ERROR("$HOME not set");
@@ -354,10 +392,17 @@ int main(int argc, char **argv)
 		return -1;
 
 	if (rec_psi) {
-		pmtpid = get_pmt_pid(DEMUX_DEV, sid);
-		if (pmtpid <= 0) {
-			fprintf(stderr,"couldn't find pmt-pid for sid %04x\n",sid);
-			return -1;
+		snprintf(pmtkey, sizeof(pmtkey), "%u", frontend_param.frequency);
+		if ((pmtpid = pmt_cache_lookup(confname, pmtkey, sid)) == 0) {
+			pmtpid = get_pmt_pid(DEMUX_DEV, sid);
+			if (pmtpid <= 0) {
+				fprintf(stderr,"couldn't find pmt-pid for sid %04x\n",sid);
+				return -1;
+			}
+			pmt_cache_store(confname, pmtkey, sid, pmtpid);
+		} else {
+			/* record with the cached pid, check it against the PAT meanwhile */
+			cached_pmt = 1;
 		}
 
 		if ((pat_fd = open(DEMUX_DEV, O_RDWR)) < 0) {
@@ -373,6 +418,8 @@ int main(int argc, char **argv)
 		}
 		if (set_pesfilter(pmt_fd, pmtpid, DMX_PES_OTHER, dvr) < 0)
 			return -1;
+		if (cached_pmt)
+			pmt_cache_validate(DEMUX_DEV, confname, pmtkey, sid, pmtpid, pmt_fd, dvr);
 	}
 
 	if ((video_fd = open(DEMUX_DEV, O_RDWR)) < 0) {
@@ -391,7 +438,10 @@ int main(int argc, char **argv)
 	if (set_pesfilter (audio_fd, apid, DMX_PES_AUDIO, dvr) < 0)
 		return -1;
 
-	monitor_frontend (frontend_fd, human_readable);
+	if (server_fd >= 0)
+		server_loop(server_fd, confname, frontend_fd, pmt_fd, video_fd, audio_fd, dvr);
+	else
+		monitor_frontend (frontend_fd, human_readable);
 
 	close (pat_fd);
 	close (pmt_fd);
@@ -47,6 +47,7 @@
 #include <linux/dvb/frontend.h>
 #include <linux/dvb/dmx.h>
 #include <linux/dvb/audio.h>
+#include <libdvbapi/dvblatency.h>
 #include "lnb.h"
 #include "util.h"
 
@@ -73,6 +74,9 @@ static struct lnb_types_st lnb_type;
 
 static int exit_after_tuning;
 static int interactive;
+static int show_latency;
+static struct dvblatency_session latency;
+static int server_fd = -1;
 
 static char *usage_str =
 	"\nusage: szap -q\n"
@@ -91,30 +95,47 @@ static char *usage_str =
 	"     -l low[,high[,switch]] in Mhz\n"
 	"     -i        : run interactively, allowing you to type in channel names\n"
 	"     -p        : add pat and pmt to TS recording (implies -r)\n"
-	"                 or -n numbers for zapping\n";
+	"     -T        : print tune, lock and PAT latency histograms on exit\n"
+	"                 or -n numbers for zapping\n"
+	"     -u socket : run as a server, keeping the devices open and taking\n"
+	"                 channel names or -n numbers from unix socket 'socket'\n";
 
 struct diseqc_cmd {
 	struct dvb_diseqc_master_cmd cmd;
 	uint32_t wait;
 };
 
-void diseqc_send_msg(int fd, fe_sec_voltage_t v, struct diseqc_cmd *cmd,
+int diseqc_send_msg(int fd, fe_sec_voltage_t v, struct diseqc_cmd *cmd,
 		     fe_sec_tone_mode_t t, fe_sec_mini_cmd_t b)
 {
-	if (ioctl(fd, FE_SET_TONE, SEC_TONE_OFF) == -1)
+	int err = 0;
+
+	if (ioctl(fd, FE_SET_TONE, SEC_TONE_OFF) == -1) {
 		perror("FE_SET_TONE failed");
-	if (ioctl(fd, FE_SET_VOLTAGE, v) == -1)
+		err = -1;
+	}
+	if (ioctl(fd, FE_SET_VOLTAGE, v) == -1) {
 		perror("FE_SET_VOLTAGE failed");
+		err = -1;
+	}
 		usleep(15 * 1000);
-	if (ioctl(fd, FE_DISEQC_SEND_MASTER_CMD, &cmd->cmd) == -1)
+	if (ioctl(fd, FE_DISEQC_SEND_MASTER_CMD, &cmd->cmd) == -1) {
 		perror("FE_DISEQC_SEND_MASTER_CMD failed");
+		err = -1;
+	}
 		usleep(cmd->wait * 1000);
 		usleep(15 * 1000);
-	if (ioctl(fd, FE_DISEQC_SEND_BURST, b) == -1)
+	if (ioctl(fd, FE_DISEQC_SEND_BURST, b) == -1) {
 		perror("FE_DISEQC_SEND_BURST failed");
+		err = -1;
+	}
 		usleep(15 * 1000);
-	if (ioctl(fd, FE_SET_TONE, t) == -1)
+	if (ioctl(fd, FE_SET_TONE, t) == -1) {
 		perror("FE_SET_TONE failed");
+		err = -1;
+	}
+
+	return err;
 }
 
 
@@ -125,22 +146,62 @@ void diseqc_send_msg(int fd, fe_sec_voltage_t v, struct diseqc_cmd *cmd,
  */
 static int diseqc(int secfd, int sat_no, int pol_vert, int hi_band)
 {
+	/* the frontend stays open between zaps, and so does its switch state */
+	static int last_secfd = -1;
+	static int last_sat_no, last_pol_vert, last_hi_band;
 	struct diseqc_cmd cmd =
 	{ {{0xe0, 0x10, 0x38, 0xf0, 0x00, 0x00}, 4}, 0 };
 
+	if ((secfd == last_secfd) && (sat_no == last_sat_no) &&
+	    (pol_vert == last_pol_vert) && (hi_band == last_hi_band))
+		return TRUE;
+
 	/* param: high nibble: reset bits, low nibble set bits,
 	* bits are: option, position, polarization, band
 	*/
 	cmd.cmd.msg[3] =
 	0xf0 | (((sat_no * 4) & 0x0f) | (hi_band ? 1 : 0) | (pol_vert ? 0 : 2));
 
-	diseqc_send_msg(secfd, pol_vert ? SEC_VOLTAGE_13 : SEC_VOLTAGE_18,
-			&cmd, hi_band ? SEC_TONE_ON : SEC_TONE_OFF,
-			sat_no % 2 ? SEC_MINI_B : SEC_MINI_A);
+	dvblatency_mark(&latency, DVBLATENCY_DISEQC_SENT);
+
+	/* a failed sequence leaves the switch in an unknown state */
+	last_secfd = -1;
+	if (diseqc_send_msg(secfd, pol_vert ? SEC_VOLTAGE_13 : SEC_VOLTAGE_18,
+			    &cmd, hi_band ? SEC_TONE_ON : SEC_TONE_OFF,
+			    sat_no % 2 ? SEC_MINI_B : SEC_MINI_A))
+		return TRUE;
+
+	last_secfd = secfd;
+	last_sat_no = sat_no;
+	last_pol_vert = pol_vert;
+	last_hi_band = hi_band;
 
 	return TRUE;
 }
 
+static void wait_lock(int fefd, int timeout)
+{
+	struct dvb_frontend_event ev;
+	struct pollfd pfd;
+	fe_status_t status;
+
+	pfd.fd = fefd;
+	pfd.events = POLLPRI;
+	while (1) {
+		if ((ioctl(fefd, FE_READ_STATUS, &status) == 0) && (status & FE_HAS_LOCK)) {
+			dvblatency_mark(&latency, DVBLATENCY_LOCKED);
+			return;
+		}
+		/* status changes are signalled as events */
+		if (poll(&pfd, 1, timeout < 20 ? timeout : 20) < 0)
+			return;
+		while (ioctl(fefd, FE_GET_EVENT, &ev) == 0)
+			;
+		if ((timeout -= 20) <= 0)
+			return;
+	}
+}
+
 static int do_tune(int fefd, unsigned int ifreq, unsigned int sr)
 {
 	struct dvb_frontend_parameters tuneto;
@@ -161,6 +222,11 @@ static int do_tune(int fefd, unsigned int ifreq, unsigned int sr)
 		perror("FE_SET_FRONTEND failed");
 		return FALSE;
 	}
+	dvblatency_mark(&latency, DVBLATENCY_TUNE_ISSUED);
+
+	/* the monitor only looks once a second, too coarse to time the lock */
+	if (show_latency)
+		wait_lock(fefd, 5000);
 
 	return TRUE;
 }
@@ -197,8 +263,10 @@ static int monitor_frontend (int fe_fd, int dvr, int human_readable)
 				status, signal, snr, ber, uncorrected_blocks);
 		}
 
-		if (status & FE_HAS_LOCK)
+		if (status & FE_HAS_LOCK) {
 			printf("FE_HAS_LOCK");
+			dvblatency_mark(&latency, DVBLATENCY_LOCKED);
+		}
 		printf("\n");
 
 		if (exit_after_tuning && ((status & FE_HAS_LOCK) || (++timeout >= 10)))
@@ -215,17 +283,19 @@ static
 int zap_to(unsigned int adapter, unsigned int frontend, unsigned int demux,
       unsigned int sat_no, unsigned int freq, unsigned int pol,
       unsigned int sr, unsigned int vpid, unsigned int apid, int sid,
-      int dvr, int rec_psi, int bypass, int human_readable)
+      int dvr, int rec_psi, int bypass, int human_readable, const char *chanfile)
 {
-	char fedev[128], dmxdev[128], auddev[128];
+	char fedev[128], dmxdev[128], auddev[128], pmtkey[32];
 	static int fefd, dmxfda, dmxfdv, audiofd = -1, patfd, pmtfd;
-	int pmtpid;
+	int pmtpid, cached_pmt = 0;
 	uint32_t ifreq, mstd;
 	int hiband, result;
 
+	/* needed again for the PMT lookup on each zap */
+	snprintf(dmxdev, sizeof(dmxdev), DEMUXDEVICE, adapter, demux);
+
 	if (!fefd) {
 		snprintf(fedev, sizeof(fedev), FRONTENDDEVICE, adapter, frontend);
-		snprintf(dmxdev, sizeof(dmxdev), DEMUXDEVICE, adapter, demux);
 		snprintf(auddev, sizeof(auddev), AUDIODEVICE, adapter, demux);
 		printf("using '%s' and '%s'\n", fedev, dmxdev);
 
@@ -290,29 +360,45 @@ int zap_to(unsigned int adapter, unsigned int frontend, unsigned int demux,
 
 	if (diseqc(fefd, sat_no, pol, hiband))
 	if (do_tune(fefd, ifreq, sr))
-		if (set_pesfilter(dmxfdv, vpid, DMX_PES_VIDEO, dvr))
+		if (set_pesfilter(dmxfdv, vpid, DMX_PES_VIDEO, dvr) == 0)
 		if (audiofd >= 0)
 		(void)ioctl(audiofd, AUDIO_SET_BYPASS_MODE, bypass);
 
-		if (set_pesfilter(dmxfda, apid, DMX_PES_AUDIO, dvr)) {
+		if (set_pesfilter(dmxfda, apid, DMX_PES_AUDIO, dvr) == 0) {
 			if (rec_psi) {
-				pmtpid = get_pmt_pid(dmxdev, sid);
-				if (pmtpid < 0) {
-					result = FALSE;
+				snprintf(pmtkey, sizeof(pmtkey), "%u%c%u", freq, pol ? 'V' : 'H', sat_no);
+				if ((pmtpid = pmt_cache_lookup(chanfile, pmtkey, sid)) == 0) {
+					pmtpid = get_pmt_pid(dmxdev, sid);
+					if (pmtpid < 0) {
+						result = FALSE;
+					}
+					if (pmtpid == 0) {
+						fprintf(stderr,"couldn't find pmt-pid for sid %04x\n",sid);
+						result = FALSE;
+					}
+					if (pmtpid > 0) {
+						dvblatency_mark(&latency, DVBLATENCY_FIRST_PAT);
+						pmt_cache_store(chanfile, pmtkey, sid, pmtpid);
+					}
+				} else {
+					/* record with the cached pid, check it against the PAT meanwhile */
+					cached_pmt = 1;
 				}
-				if (pmtpid == 0) {
-					fprintf(stderr,"couldn't find pmt-pid for sid %04x\n",sid);
-					result = FALSE;
-				}
-				if (set_pesfilter(patfd, 0, DMX_PES_OTHER, dvr))
-					if (set_pesfilter(pmtfd, pmtpid, DMX_PES_OTHER, dvr))
+				if (pmtpid > 0)
+				if (set_pesfilter(patfd, 0, DMX_PES_OTHER, dvr) == 0)
+					if (set_pesfilter(pmtfd, pmtpid, DMX_PES_OTHER, dvr) == 0)
 						result = TRUE;
+				if (cached_pmt)
+					pmt_cache_validate(dmxdev, chanfile, pmtkey, sid, pmtpid, pmtfd, dvr);
 			} else {
 				result = TRUE;
 			}
 		}
 
-	monitor_frontend (fefd, dvr, human_readable);
+	if (server_fd >= 0)
+		zap_server_reply(result, fefd, ZAP_SERVER_LOCK_TIMEOUT);
+	else
+		monitor_frontend (fefd, dvr, human_readable);
 	if (!interactive) {
 		close(patfd);
 		close(pmtfd);
@@ -351,7 +437,13 @@ again:
 		return FALSE;
 	}
 
-	if (interactive) {
+	if (server_fd >= 0) {
+		if (zap_server_next(server_fd, inp, sizeof(inp), &chan_no) < 0) {
+			fclose(cfp);
+			return -1;
+		}
+		chan_name = chan_no ? NULL : inp;
+	} else if (interactive) {
 		fprintf(stderr, "\n>>> ");
 
 		if (!fgets(inp, sizeof(inp), stdin)) {
@@ -466,7 +558,8 @@ again:
 				     dvr,
 				     rec_psi,
 				     bypass,
-				     human_readable);
+				     human_readable,
+				     filename);
 
 			if (interactive)
 				goto again;
@@ -488,6 +581,7 @@ syntax_err:
 	fclose(cfp);
 	if (!list_channels) {
 		fprintf(stderr, "channel not found\n");
+		zap_server_reply(FALSE, -1, 0);
 		if (!interactive)
 			return FALSE;
 	}
@@ -533,7 +627,7 @@ int main(int argc, char *argv[])
 
 	lnb_type = *lnb_enum(0);
 
-	while ((opt = getopt(argc, argv, "Hhqrpn:a:f:d:c:l:xib")) != -1) {
+	while ((opt = getopt(argc, argv, "HhqrpTn:a:f:d:c:l:xibu:")) != -1) {
 		switch (opt) {
 		case '?':
 		case 'h':
@@ -560,6 +654,9 @@ int main(int argc, char *argv[])
 		case 'p':
 			rec_psi = 1;
 			break;
+		case 'T':
+			show_latency = 1;
+			break;
 		case 'd':
 			demux = strtoul(optarg, NULL, 0);
 			break;
@@ -582,6 +679,12 @@ int main(int argc, char *argv[])
 		case 'i':
 			interactive = 1;
 			exit_after_tuning = 1;
+			break;
+		case 'u':
+			if ((server_fd = zap_server_open(optarg)) < 0)
+				return -1;
+			interactive = 1;
+			exit_after_tuning = 1;
 		}
 	}
 	lnb_type.low_val *= 1000;	/* convert to kiloherz */
@@ -641,5 +744,8 @@ int main(int argc, char *argv[])
 		    	   human_readable))
 		return TRUE;
 
+	if (show_latency)
+		dvblatency_dump(stdout);
+
 	return FALSE;
 }
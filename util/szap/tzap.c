@@ -266,20 +266,13 @@ static int check_fec(fe_code_rate_t *fec)
 }
 
 
-int parse(const char *fname, const char *channel,
-	  struct dvb_frontend_parameters *frontend, int *vpid, int *apid,
-	  int *sid)
+static int parse_channel(int fd, const char *channel,
+			 struct dvb_frontend_parameters *frontend, int *vpid, int *apid,
+			 int *sid)
 {
-	int fd;
 	int err;
 	int tmp;
 
-	if ((fd = open(fname, O_RDONLY | O_NONBLOCK)) < 0) {
-		PERROR ("could not open file '%s'", fname);
-		perror ("");
-		return -1;
-	}
-
 	if (find_channel(fd, channel) < 0) {
 		ERROR("could not find channel '%s' in channel list", channel);
 		return -2;
@@ -346,11 +339,30 @@ int parse(const char *fname, const char *channel,
 	if ((err = try_parse_int(fd, sid, "Service ID")))
 	    return -14;
 
-	close(fd);
 	return 0;
 }
 
 
+int parse(const char *fname, const char *channel,
+	  struct dvb_frontend_parameters *frontend, int *vpid, int *apid,
+	  int *sid)
+{
+	int fd;
+	int err;
+
+	if ((fd = open(fname, O_RDONLY | O_NONBLOCK)) < 0) {
+		PERROR ("could not open file '%s'", fname);
+		perror ("");
+		return -1;
+	}
+
+	/* closed either way: the server mode parses again and again */
+	err = parse_channel(fd, channel, frontend, vpid, apid, sid);
+	close(fd);
+	return err;
+}
+
+
 static int setup_frontend (int fe_fd, struct dvb_frontend_parameters *frontend)
 {
 	int ret;
@@ -432,6 +444,33 @@ int monitor_frontend (int fe_fd, int human_readable)
 	return 0;
 }
 
+/*
+ * Server mode (-u): retune and retarget the open filters for each switch
+ * command, until killed.
+ */
+static void server_loop(int server_fd, const char *confname, int frontend_fd,
+			int pmt_fd, int video_fd, int audio_fd, int dvr)
+{
+	struct dvb_frontend_parameters frontend_param;
+	char name[256], pmtkey[32];
+	unsigned int number;
+	int vpid, apid, sid, ok;
+
+	while (zap_server_next(server_fd, name, sizeof(name), &number) == 0) {
+		memset(&frontend_param, 0, sizeof(struct dvb_frontend_parameters));
+		ok = 0;
+		if (number) {
+			ERROR("channel numbers are not supported");
+		} else if (!parse(confname, name, &frontend_param, &vpid, &apid, &sid) &&
+			   !setup_frontend(frontend_fd, &frontend_param)) {
+			snprintf(pmtkey, sizeof(pmtkey), "%u", frontend_param.frequency);
+			ok = !zap_server_filters(DEMUX_DEV, confname, pmtkey, sid, pmt_fd,
+						 vpid, video_fd, apid, audio_fd, dvr);
+		}
+		zap_server_reply(ok, frontend_fd, ZAP_SERVER_LOCK_TIMEOUT);
+	}
+}
+
 #define BUFLEN (188*256)
 static void copy_to_file(int in_fd, int out_fd)
 {
@@ -478,6 +517,8 @@ static char *usage =
 	"     -F        : set up frontend only, don't touch demux\n"
 	"     -t number : timeout (seconds)\n"
 	"     -o file   : output filename (use -o - for stdout)\n"
+	"     -u socket : once tuned, keep the devices open and take further\n"
+	"                 channel names from unix socket 'socket'\n"
 	"     -h -?     : display this help and exit\n";
 
 
@@ -489,15 +530,19 @@ int main(int argc, char **argv)
 	char *channel = NULL;
 	int adapter = 0, frontend = 0, demux = 0, dvr = 0;
 	int vpid, apid, sid, pmtpid = 0;
-	int pat_fd, pmt_fd;
+	int cached_pmt = 0;
+	char pmtkey[32];
+	int pat_fd = -1, pmt_fd = -1;
 	int frontend_fd, audio_fd = 0, video_fd = 0, dvr_fd, file_fd;
+	int server_fd = -1;
+	char *server_path = NULL;
 	int opt;
 	int record = 0;
 	int frontend_only = 0;
 	char *filename = NULL;
 	int human_readable = 0, rec_psi = 0;
 
-	while ((opt = getopt(argc, argv, "H?hrpxRsFSn:a:f:d:c:t:o:")) != -1) {
+	while ((opt = getopt(argc, argv, "H?hrpxRsFSn:a:f:d:c:t:o:u:")) != -1) {
 		switch (opt) {
 		case 'a':
 			adapter = strtoul(optarg, NULL, 0);
@@ -539,6 +584,9 @@ int main(int argc, char **argv)
 		case 'H':
 			human_readable = 1;
 			break;
+		case 'u':
+			server_path = optarg;
+			break;
 		case '?':
 		case 'h':
 		default:
@@ -550,10 +598,12 @@ int main(int argc, char **argv)
 	if (optind < argc)
 		channel = argv[optind];
 
-	if (!channel) {
+	if (!channel || (server_path && (record || frontend_only))) {
 		fprintf (stderr, usage, argv[0]);
 		return -1;
 	}
+	if (server_path && ((server_fd = zap_server_open(server_path)) < 0))
+		return -1;
 
 	snprintf(FRONTEND_DEV,
 		 sizeof(FRONTEND_DEV),
@@ -603,10 +653,17 @@ int main(int argc, char **argv)
 		goto just_the_frontend_dude;
 
 	if (rec_psi) {
-	    	pmtpid = get_pmt_pid(DEMUX_DEV, sid);
-	    	if (pmtpid <= 0) {
-			fprintf(stderr,"couldn't find pmt-pid for sid %04x\n",sid);
-			return -1;
+	    	snprintf(pmtkey, sizeof(pmtkey), "%u", frontend_param.frequency);
+	    	if ((pmtpid = pmt_cache_lookup(confname, pmtkey, sid)) == 0) {
+			pmtpid = get_pmt_pid(DEMUX_DEV, sid);
+			if (pmtpid <= 0) {
+				fprintf(stderr,"couldn't find pmt-pid for sid %04x\n",sid);
+				return -1;
+			}
+			pmt_cache_store(confname, pmtkey, sid, pmtpid);
+	    	} else {
+			/* record with the cached pid, check it against the PAT meanwhile */
+			cached_pmt = 1;
 	    	}
 
 	    	if ((pat_fd = open(DEMUX_DEV, O_RDWR)) < 0) {
@@ -622,6 +679,8 @@ int main(int argc, char **argv)
 	    	}
 	    	if (set_pesfilter(pmt_fd, pmtpid, DMX_PES_OTHER, dvr) < 0)
 			return -1;
+	    	if (cached_pmt)
+			pmt_cache_validate(DEMUX_DEV, confname, pmtkey, sid, pmtpid, pmt_fd, dvr);
 	}
 
 	if ((video_fd = open(DEMUX_DEV, O_RDWR)) < 0) {
@@ -676,7 +735,11 @@ int main(int argc, char **argv)
 			print_frontend_stats(frontend_fd, human_readable);
 	} else {
 just_the_frontend_dude:
-		monitor_frontend(frontend_fd, human_readable);
+		if (server_fd >= 0)
+			server_loop(server_fd, confname, frontend_fd, pmt_fd,
+				    video_fd, audio_fd, dvr);
+		else
+			monitor_frontend(frontend_fd, human_readable);
 	}
 
 	close(pat_fd);
@@ -24,6 +24,13 @@
 #include <stdio.h>
 #include <errno.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include <sys/ioctl.h>
 #include <sys/types.h>
@@ -33,6 +40,8 @@
 #include <linux/dvb/frontend.h>
 #include <linux/dvb/dmx.h>
 
+#include "util.h"
+
 
 int set_pesfilter(int dmxfd, int pid, int pes_type, int dvr)
 {
@@ -63,7 +72,7 @@ int set_pesfilter(int dmxfd, int pid, int pes_type, int dvr)
 }
 
 
-int get_pmt_pid(char *dmxdev, int sid)
+int get_pmt_pid(const char *dmxdev, int sid)
 {
 	int patfd, count;
 	int pmt_pid = 0;
@@ -123,6 +132,150 @@ int get_pmt_pid(char *dmxdev, int sid)
 	return pmt_pid;
 }
 
+/*
+ * PMT pid cache, kept next to the channels file as "<channels file>.pmt".
+ * One line per service: "<key> <sid> <pmt pid>", where the key names the
+ * transponder (whatever the tool can tell apart, e.g. frequency).
+ */
+#define PMT_CACHE_SUFFIX ".pmt"
+#define PMT_CACHE_LINE 128
+
+struct pmt_validate {
+	char dmxdev[128];
+	char chanfile[PATH_MAX];
+	char key[64];
+	int sid;
+	int pmt_pid;
+	int pmtfd;
+	int dvr;
+	int generation;
+};
+
+static pthread_mutex_t pmt_validate_lock = PTHREAD_MUTEX_INITIALIZER;
+static int pmt_validate_generation;
+
+
+int pmt_cache_lookup(const char *chanfile, const char *key, int sid)
+{
+	char cachefile[PATH_MAX];
+	char line[PMT_CACHE_LINE];
+	char cur_key[64];
+	int cur_sid, cur_pid;
+	int pmt_pid = 0;
+	FILE *f;
+
+	/* whatever a previous zap is still validating is out of date now */
+	pthread_mutex_lock(&pmt_validate_lock);
+	pmt_validate_generation++;
+	pthread_mutex_unlock(&pmt_validate_lock);
+
+	snprintf(cachefile, sizeof(cachefile), "%s" PMT_CACHE_SUFFIX, chanfile);
+	if ((f = fopen(cachefile, "r")) == NULL)
+		return 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%63s %i %i", cur_key, &cur_sid, &cur_pid) != 3)
+			continue;
+		if ((cur_sid == sid) && !strcmp(cur_key, key)) {
+			pmt_pid = cur_pid;
+			break;
+		}
+	}
+	fclose(f);
+
+	if ((pmt_pid <= 0) || (pmt_pid >= 0x1fff))
+		return 0;
+	return pmt_pid;
+}
+
+
+void pmt_cache_store(const char *chanfile, const char *key, int sid, int pmt_pid)
+{
+	char cachefile[PATH_MAX], tmpfile[PATH_MAX];
+	char line[PMT_CACHE_LINE];
+	char cur_key[64];
+	int cur_sid, cur_pid;
+	FILE *in, *out;
+
+	snprintf(cachefile, sizeof(cachefile), "%s" PMT_CACHE_SUFFIX, chanfile);
+	snprintf(tmpfile, sizeof(tmpfile), "%s" PMT_CACHE_SUFFIX ".tmp", chanfile);
+
+	/* the cache is only a hint: failing to write it is not an error */
+	if ((out = fopen(tmpfile, "w")) == NULL)
+		return;
+
+	if ((in = fopen(cachefile, "r")) != NULL) {
+		while (fgets(line, sizeof(line), in)) {
+			if ((sscanf(line, "%63s %i %i", cur_key, &cur_sid, &cur_pid) == 3) &&
+			    (cur_sid == sid) && !strcmp(cur_key, key))
+				continue;
+			fputs(line, out);
+		}
+		fclose(in);
+	}
+	fprintf(out, "%s %d 0x%04x\n", key, sid, pmt_pid);
+
+	if (fclose(out) || rename(tmpfile, cachefile))
+		unlink(tmpfile);
+}
+
+
+static void *pmt_validate_func(void *arg)
+{
+	struct pmt_validate *v = arg;
+	int pmt_pid;
+
+	pmt_pid = get_pmt_pid(v->dmxdev, v->sid);
+
+	pthread_mutex_lock(&pmt_validate_lock);
+	if ((v->generation == pmt_validate_generation) &&
+	    (pmt_pid > 0) && (pmt_pid != v->pmt_pid)) {
+		fprintf(stderr, "pmt-pid for sid %04x moved from %04x to %04x\n",
+			v->sid, v->pmt_pid, pmt_pid);
+		ioctl(v->pmtfd, DMX_STOP);
+		set_pesfilter(v->pmtfd, pmt_pid, DMX_PES_OTHER, v->dvr);
+		pmt_cache_store(v->chanfile, v->key, v->sid, pmt_pid);
+	}
+	pthread_mutex_unlock(&pmt_validate_lock);
+
+	free(v);
+	return NULL;
+}
+
+
+int pmt_cache_validate(const char *dmxdev, const char *chanfile, const char *key,
+		       int sid, int pmt_pid, int pmtfd, int dvr)
+{
+	struct pmt_validate *v;
+	pthread_attr_t attr;
+	pthread_t thread;
+	int ret;
+
+	if ((v = calloc(1, sizeof(struct pmt_validate))) == NULL)
+		return -1;
+	strncpy(v->dmxdev, dmxdev, sizeof(v->dmxdev) - 1);
+	strncpy(v->chanfile, chanfile, sizeof(v->chanfile) - 1);
+	strncpy(v->key, key, sizeof(v->key) - 1);
+	v->sid = sid;
+	v->pmt_pid = pmt_pid;
+	v->pmtfd = pmtfd;
+	v->dvr = dvr;
+
+	pthread_mutex_lock(&pmt_validate_lock);
+	v->generation = pmt_validate_generation;
+	pthread_mutex_unlock(&pmt_validate_lock);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, pmt_validate_func, v);
+	pthread_attr_destroy(&attr);
+	if (ret) {
+		free(v);
+		return -1;
+	}
+	return 0;
+}
+
 char *type_str[] = {
 	"QPSK",
 	"QAM",
@@ -345,3 +498,147 @@ int check_frontend(int fd, enum fe_type type, uint32_t *mstd)
 exit:
 	return ret;
 }
+
+
+/* the client being served, if any, and when its last command arrived */
+static FILE *server_client;
+static struct timespec server_start;
+
+int zap_server_open(const char *path)
+{
+	struct sockaddr_un addr;
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "server socket path '%s' too long\n", path);
+		return -1;
+	}
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("creating server socket failed");
+		return -1;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) || listen(fd, 4)) {
+		perror("binding server socket failed");
+		close(fd);
+		return -1;
+	}
+
+	/* a client may go before its reply */
+	signal(SIGPIPE, SIG_IGN);
+	return fd;
+}
+
+int zap_server_next(int srvfd, char *name, int size, unsigned int *number)
+{
+	char *p;
+	int fd;
+
+	while (1) {
+		if (server_client == NULL) {
+			if ((fd = accept(srvfd, NULL, NULL)) < 0) {
+				if (errno == EINTR)
+					continue;
+				perror("accepting server client failed");
+				return -1;
+			}
+			if ((server_client = fdopen(fd, "r")) == NULL) {
+				close(fd);
+				continue;
+			}
+		}
+
+		if (!fgets(name, size, server_client)) {
+			fclose(server_client);
+			server_client = NULL;
+			continue;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &server_start);
+		if ((p = strpbrk(name, "\r\n")) != NULL)
+			*p = '\0';
+		if (!name[0])
+			continue;
+
+		*number = 0;
+		if (name[0] == '-' && name[1] == 'n') {
+			if ((*number = strtoul(name + 2, NULL, 0)) == 0) {
+				fprintf(stderr, "bad channel number\n");
+				zap_server_reply(0, -1, 0);
+				continue;
+			}
+		}
+		return 0;
+	}
+}
+
+void zap_server_reply(int ok, int fefd, int timeout)
+{
+	struct timespec now;
+	fe_status_t status = 0;
+	char reply[32];
+	long ms = 0;
+
+	if (server_client == NULL)
+		return;
+
+	if (ok && (fefd >= 0)) {
+		while (1) {
+			if ((ioctl(fefd, FE_READ_STATUS, &status) == 0) && (status & FE_HAS_LOCK))
+				break;
+			status = 0;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			ms = (now.tv_sec - server_start.tv_sec) * 1000 +
+			     (now.tv_nsec - server_start.tv_nsec) / 1000000;
+			if (ms >= timeout)
+				break;
+			usleep(10 * 1000);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		ms = (now.tv_sec - server_start.tv_sec) * 1000 +
+		     (now.tv_nsec - server_start.tv_nsec) / 1000000;
+	}
+
+	if (!ok)
+		snprintf(reply, sizeof(reply), "failed\n");
+	else if (status & FE_HAS_LOCK)
+		snprintf(reply, sizeof(reply), "ok locked %ld\n", ms);
+	else
+		snprintf(reply, sizeof(reply), "ok nolock\n");
+	/* if the client has gone, the next fgets() notices */
+	if (write(fileno(server_client), reply, strlen(reply)) < 0)
+		return;
+}
+
+int zap_server_filters(const char *dmxdev, const char *chanfile, const char *pmtkey,
+		       int sid, int pmtfd, int vpid, int videofd, int apid, int audiofd,
+		       int dvr)
+{
+	int pmtpid;
+
+	if (pmtfd >= 0) {
+		if (!pmtkey || (pmtpid = pmt_cache_lookup(chanfile, pmtkey, sid)) == 0) {
+			if ((pmtpid = get_pmt_pid(dmxdev, sid)) <= 0) {
+				fprintf(stderr, "couldn't find pmt-pid for sid %04x\n", sid);
+				return -1;
+			}
+			if (pmtkey)
+				pmt_cache_store(chanfile, pmtkey, sid, pmtpid);
+			if (set_pesfilter(pmtfd, pmtpid, DMX_PES_OTHER, dvr) < 0)
+				return -1;
+		} else {
+			if (set_pesfilter(pmtfd, pmtpid, DMX_PES_OTHER, dvr) < 0)
+				return -1;
+			pmt_cache_validate(dmxdev, chanfile, pmtkey, sid, pmtpid, pmtfd, dvr);
+		}
+	}
+
+	if (set_pesfilter(videofd, vpid, DMX_PES_VIDEO, dvr) < 0)
+		return -1;
+	if (set_pesfilter(audiofd, apid, DMX_PES_AUDIO, dvr) < 0)
+		return -1;
+	return 0;
+}
@@ -21,8 +21,50 @@
 
 int set_pesfilter(int dmxfd, int pid, int pes_type, int dvr);
 
-int get_pmt_pid(char *dmxdev, int sid);
+int get_pmt_pid(const char *dmxdev, int sid);
+
+/*
+ * PMT pid cache, so PSI recording can start as soon as the tuner locks:
+ * pmt_cache_lookup() returns the cached pmt pid for a service, or 0.
+ * pmt_cache_validate() then reads the PAT in the background and moves
+ * the PMT filter on pmtfd (and the cache) if the service's pmt pid has
+ * changed. A new pmt_cache_lookup() abandons any pending validation.
+ */
+int pmt_cache_lookup(const char *chanfile, const char *key, int sid);
+
+void pmt_cache_store(const char *chanfile, const char *key, int sid, int pmt_pid);
+
+int pmt_cache_validate(const char *dmxdev, const char *chanfile, const char *key,
+		       int sid, int pmt_pid, int pmtfd, int dvr);
 
 int check_frontend(int fd, enum fe_type type, uint32_t *mstd);
 
+/*
+ * Server mode, for switching channels without restarting a zap tool: the
+ * frontend, demux filters and SEC state stay as they are, and switch
+ * commands arrive on a unix stream socket, one per line as typed in
+ * interactively: a channel name, or -n and a channel number. Clients are
+ * served one at a time, for as many commands as they send. Each command is
+ * answered, once tuned and locked (or not within ZAP_SERVER_LOCK_TIMEOUT
+ * milliseconds), with one line: "ok locked <ms>" with the milliseconds since
+ * the command arrived, "ok nolock", or "failed".
+ *
+ * zap_server_open() returns the listening socket; zap_server_next() waits
+ * for the next command, setting number to 0 for a name.
+ * zap_server_filters() retargets the open filters at the new service, with
+ * the PMT looked up as for the command line (pmtfd -1 if not recording PSI,
+ * pmtkey NULL not to use the PMT pid cache).
+ */
+#define ZAP_SERVER_LOCK_TIMEOUT 5000
+
+int zap_server_open(const char *path);
+
+int zap_server_next(int srvfd, char *name, int size, unsigned int *number);
+
+void zap_server_reply(int ok, int fefd, int timeout);
+
+int zap_server_filters(const char *dmxdev, const char *chanfile, const char *pmtkey,
+		       int sid, int pmtfd, int vpid, int videofd, int apid, int audiofd,
+		       int dvr);
+
 int dvbfe_set_delsys(int fd, enum fe_delivery_system delsys);
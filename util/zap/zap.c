@@ -20,6 +20,7 @@
 */
 
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 #include <limits.h>
 #include <string.h>
@@ -29,13 +30,17 @@
 #include <sys/poll.h>
 #include <libdvbapi/dvbdemux.h>
 #include <libdvbapi/dvbaudio.h>
+#include <libdvbapi/dvbtunememo.h>
 #include <libdvbsec/dvbsec_cfg.h>
+#include <libdvbcfg/dvbcfg_zapindex.h>
+#include <libdvbepg/dvbnownext.h>
 #include <libucsi/mpeg/section.h>
 #include "zap_dvb.h"
 #include "zap_ca.h"
 
 
 static void signal_handler(int _signal);
+static void print_nownext(struct dvbnownext *nownext, uint16_t service_id);
 
 static int quit_app = 0;
 
@@ -52,27 +57,23 @@ void usage(void)
 		" -demux <id>		demux to use (default 0)\n"
 		" -caslotnum <id>	ca slot number to use (default 0)\n"
 		" -channels <filename>	channels.conf file.\n"
+		" -chanstore <name>	Look channels up in the shared store <name> rather\n"
+		"			than the channels.conf file\n"
 		" -secfile <filename>	Optional sec.conf file.\n"
 		" -secid <secid>	ID of the SEC configuration to use, one of:\n"
 		" -nomoveca		Do not attempt to move CA descriptors from stream to programme level\n"
+		" -pmtcache <dir>	Cache PMTs in <dir>, so a channel can be descrambled as\n"
+		"			soon as the frontend locks, before its PAT and PMT arrive\n"
+		" -tunememo <file>	Remember in <file> the parameters each channel locked\n"
+		"			with, so AUTO values need not be searched for next time\n"
+		" -nownext		Print the present and following events of the channel\n"
+		"			as they change\n"
 		" <channel name>\n";
 	fprintf(stderr, "%s\n", _usage);
 
 	exit(1);
 }
 
-int find_channel(struct dvbcfg_zapchannel *channel, void *private_data)
-{
-	struct dvbcfg_zapchannel *tmpchannel = private_data;
-
-	if (strcmp(channel->name, tmpchannel->name) == 0) {
-		memcpy(tmpchannel, channel, sizeof(struct dvbcfg_zapchannel));
-		return 1;
-	}
-
-	return 0;
-}
-
 int main(int argc, char *argv[])
 {
 	int adapter_id = 0;
@@ -80,10 +81,15 @@ int main(int argc, char *argv[])
 	int demux_id = 0;
 	int caslot_num = 0;
 	char *chanfile = "/etc/channels.conf";
+	char *chanstore = NULL;
 	char *secfile = NULL;
 	char *secid = NULL;
 	char *channel_name = NULL;
 	int moveca = 1;
+	char *pmt_cache_dir = NULL;
+	char *tunememo_file = NULL;
+	struct dvbtunememo *tunememo = NULL;
+	struct dvbnownext *nownext = NULL;
 	int argpos = 1;
 	struct zap_dvb_params zap_dvb_params;
 	struct zap_ca_params zap_ca_params;
@@ -120,6 +126,11 @@ int main(int argc, char *argv[])
 				usage();
 			chanfile = argv[argpos+1];
 			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-chanstore")) {
+			if ((argc - argpos) < 2)
+				usage();
+			chanstore = argv[argpos+1];
+			argpos+=2;
 		} else if (!strcmp(argv[argpos], "-secfile")) {
 			if ((argc - argpos) < 2)
 				usage();
@@ -133,6 +144,22 @@ int main(int argc, char *argv[])
 		} else if (!strcmp(argv[argpos], "-nomoveca")) {
 			moveca = 0;
 			argpos++;
+		} else if (!strcmp(argv[argpos], "-pmtcache")) {
+			if ((argc - argpos) < 2)
+				usage();
+			pmt_cache_dir = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-tunememo")) {
+			if ((argc - argpos) < 2)
+				usage();
+			tunememo_file = argv[argpos+1];
+			argpos+=2;
+		} else if (!strcmp(argv[argpos], "-nownext")) {
+			if ((nownext = dvbnownext_create()) == NULL) {
+				fprintf(stderr, "Failed to create present/following tracker\n");
+				exit(1);
+			}
+			argpos++;
 		} else {
 			if ((argc - argpos) != 1)
 				usage();
@@ -160,17 +187,21 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "Channel name is too long %s\n", channel_name);
 		exit(1);
 	}
-	FILE *channel_file = fopen(chanfile, "r");
-	if (channel_file == NULL) {
+	struct dvbcfg_zapindex *channel_index;
+	if (chanstore != NULL) {
+		if ((channel_index = dvbcfg_zapindex_attach(chanstore)) == NULL) {
+			fprintf(stderr, "Could not attach to channel store %s\n", chanstore);
+			exit(1);
+		}
+	} else if ((channel_index = dvbcfg_zapindex_open(chanfile, NULL)) == NULL) {
 		fprintf(stderr, "Could open channel file %s\n", chanfile);
 		exit(1);
 	}
-	memcpy(zap_dvb_params.channel.name, channel_name, strlen(channel_name) + 1);
-	if (dvbcfg_zapchannel_parse(channel_file, find_channel, &zap_dvb_params.channel) != 1) {
+	if (dvbcfg_zapindex_find_name(channel_index, channel_name, &zap_dvb_params.channel)) {
 		fprintf(stderr, "Unable to find requested channel %s\n", channel_name);
 		exit(1);
 	}
-	fclose(channel_file);
+	dvbcfg_zapindex_close(channel_index);
 
 	// default SEC with a DVBS card
 	if ((secid == NULL) && (zap_dvb_params.channel.fe_type == DVBFE_TYPE_DVBS))
@@ -193,16 +224,32 @@ int main(int argc, char *argv[])
 		fprintf(stderr, "Failed to open frontend\n");
 		exit(1);
 	}
+	if (tunememo_file != NULL) {
+		if ((tunememo = dvbtunememo_open(tunememo_file)) == NULL) {
+			fprintf(stderr, "Failed to open tuning memo %s\n", tunememo_file);
+			exit(1);
+		}
+		dvbfe_set_tunememo(zap_dvb_params.fe, tunememo);
+	}
 
 	// start the DVB stuff
 	zap_dvb_params.adapter_id = adapter_id;
 	zap_dvb_params.frontend_id = frontend_id;
 	zap_dvb_params.demux_id = demux_id;
+	zap_dvb_params.pmt_cache_dir = pmt_cache_dir;
+	zap_dvb_params.nownext = nownext;
 	zap_dvb_start(&zap_dvb_params);
 
-	// the UI
+	// the UI: the DVB thread keeps the tracker up to date, and it is read
+	// from here without any locking
+	uint32_t nownext_changes = 0;
 	while(!quit_app) {
 		sleep(1);
+		if ((nownext != NULL) &&
+		    (dvbnownext_changes(nownext, zap_dvb_params.channel.service_id) != nownext_changes)) {
+			nownext_changes = dvbnownext_changes(nownext, zap_dvb_params.channel.service_id);
+			print_nownext(nownext, zap_dvb_params.channel.service_id);
+		}
 	}
 
 	// shutdown DVB stuff
@@ -212,10 +259,39 @@ int main(int argc, char *argv[])
 	// shutdown CA stuff
 	zap_ca_stop();
 
+	if (tunememo != NULL)
+		dvbtunememo_close(tunememo);
+	if (nownext != NULL)
+		dvbnownext_destroy(nownext);
+
 	// done
 	exit(0);
 }
 
+static void print_nownext(struct dvbnownext *nownext, uint16_t service_id)
+{
+	static const char *labels[] = { "Now", "Next" };
+	struct dvbnownext_service service;
+	int i;
+
+	if (dvbnownext_get(nownext, service_id, &service))
+		return;
+	for (i = DVBNOWNEXT_PRESENT; i <= DVBNOWNEXT_FOLLOWING; i++) {
+		struct dvbnownext_event *event = &service.event[i];
+		char start[16] = "--:--";
+		struct tm tm;
+
+		if (!service.valid[i])
+			continue;
+		if (event->start_time != -1) {
+			localtime_r(&event->start_time, &tm);
+			strftime(start, sizeof(start), "%H:%M", &tm);
+		}
+		printf("%-4s %s %3u min  %s\n", labels[i], start, event->duration / 60, event->title);
+	}
+	fflush(stdout);
+}
+
 static void signal_handler(int _signal)
 {
 	(void) _signal;
@@ -25,8 +25,11 @@
 #include <sys/poll.h>
 #include <pthread.h>
 #include <libdvben50221/en50221_stdcam.h>
+#include <libdvben50221/en50221_camgr.h>
 #include "zap_ca.h"
 
+#define CAMTHREAD_MAX_WAIT_MS 500	// bounds how long shutdown takes to be noticed
+
 
 static int zap_ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_number, uint32_t ca_id_count, uint16_t *ca_ids);
 static int zap_ai_callback(void *arg, uint8_t slot_id, uint16_t session_number,
@@ -38,13 +41,12 @@ static void *camthread_func(void* arg);
 static struct en50221_transport_layer *tl = NULL;
 static struct en50221_session_layer *sl = NULL;
 static struct en50221_stdcam *stdcam = NULL;
+static struct en50221_camgr *camgr = NULL;
 
 static int ca_resource_connected = 0;
 
 static int camthread_shutdown = 0;
 static pthread_t camthread;
-static int seenpmt = 0;
-static int moveca = 0;
 
 void zap_ca_start(struct zap_ca_params *params)
 {
@@ -71,6 +73,20 @@ void zap_ca_start(struct zap_ca_params *params)
 		return;
 	}
 
+	// the CAM is sent each program just once, and then only its changes
+	camgr = en50221_camgr_create(1, 1, params->moveca);
+	if (camgr == NULL) {
+		if (stdcam->destroy)
+			stdcam->destroy(stdcam, 1);
+		en50221_sl_destroy(sl);
+		en50221_tl_destroy(tl);
+		stdcam = NULL;
+		return;
+	}
+
+	// and the CAM is sent them the moment it is ready for them
+	en50221_stdcam_set_camgr(stdcam, camgr, 0, 0, 1);
+
 	// hook up the AI callbacks
 	if (stdcam->ai_resource) {
 		en50221_app_ai_register_callback(stdcam->ai_resource, zap_ai_callback, stdcam);
@@ -81,9 +97,6 @@ void zap_ca_start(struct zap_ca_params *params)
 		en50221_app_ca_register_info_callback(stdcam->ca_resource, zap_ca_info_callback, stdcam);
 	}
 
-	// any other stuff
-	moveca = params->moveca;
-
 	// start the cam thread
 	pthread_create(&camthread, NULL, camthread_func, NULL);
 }
@@ -97,52 +110,38 @@ void zap_ca_stop(void)
 	camthread_shutdown = 1;
 	pthread_join(camthread, NULL);
 
+	// destroy the stdcam, while the stack it uses is still there
+	if (stdcam->destroy)
+		stdcam->destroy(stdcam, 1);
+	en50221_camgr_destroy(camgr);
+
 	// destroy session layer
 	en50221_sl_destroy(sl);
 
 	// destroy transport layer
 	en50221_tl_destroy(tl);
-
-	// destroy the stdcam
-	if (stdcam->destroy)
-		stdcam->destroy(stdcam, 1);
 }
 
 int zap_ca_new_pmt(struct mpeg_pmt_section *pmt)
 {
-	uint8_t capmt[4096];
-	int size;
-
 	if (stdcam == NULL)
 		return -1;
 
-	if (ca_resource_connected) {
-		fprintf(stderr, "Received new PMT - sending to CAM...\n");
+	if (en50221_camgr_set_pmt(camgr, pmt)) {
+		fprintf(stderr, "Failed to format PMT\n");
+		return -1;
+	}
 
-		// translate it into a CA PMT
-		int listmgmt = CA_LIST_MANAGEMENT_ONLY;
-		if (seenpmt) {
-			listmgmt = CA_LIST_MANAGEMENT_UPDATE;
-		}
-		seenpmt = 1;
-
-		if ((size = en50221_ca_format_pmt(pmt, capmt, sizeof(capmt), moveca, listmgmt,
-						  CA_PMT_CMD_ID_OK_DESCRAMBLING)) < 0) {
-			fprintf(stderr, "Failed to format PMT\n");
-			return -1;
-		}
-
-		// set it
-		if (en50221_app_ca_pmt(stdcam->ca_resource, stdcam->ca_session_number, capmt, size)) {
-			fprintf(stderr, "Failed to send PMT\n");
-			return -1;
-		}
-
-		// we've seen this PMT
-		return 1;
+	// it waits in the manager until the CAM is ready for it
+	if (ca_resource_connected)
+		fprintf(stderr, "Received new PMT - sending to CAM...\n");
+	if (en50221_camgr_flush(camgr) < 0) {
+		fprintf(stderr, "Failed to send PMT\n");
+		return -1;
 	}
 
-	return 0;
+	// we've seen this PMT
+	return en50221_camgr_get_slot(camgr, mpeg_pmt_section_program_number(pmt)) != -1;
 }
 
 void zap_ca_new_dvbtime(time_t dvb_time)
@@ -158,8 +157,20 @@ static void *camthread_func(void* arg)
 {
 	(void) arg;
 
+	struct pollfd pollfd;
+	int timeout;
+
 	while(!camthread_shutdown) {
-		stdcam->poll(stdcam);
+		// sleep until the CAM needs servicing
+		pollfd.fd = stdcam->get_pollfd(stdcam, &timeout);
+		pollfd.events = POLLIN | POLLPRI;
+		if ((timeout < 0) || (timeout > CAMTHREAD_MAX_WAIT_MS))
+			timeout = CAMTHREAD_MAX_WAIT_MS;
+		poll(&pollfd, 1, timeout);
+
+		// a CAM which goes away must send its ca_info again
+		if (stdcam->poll(stdcam) != EN50221_STDCAM_CAM_OK)
+			ca_resource_connected = 0;
 	}
 
 	return 0;
@@ -193,6 +204,8 @@ static int zap_ca_info_callback(void *arg, uint8_t slot_id, uint16_t session_num
 	for(i=0; i< ca_id_count; i++) {
 		printf("  0x%04x\n", ca_ids[i]);
 	}
+
+	// the stdcam has already sent it whatever PMT came before it was ready
 	ca_resource_connected = 1;
 	return 0;
 }
@@ -25,6 +25,7 @@
 #include <string.h>
 #include <signal.h>
 #include <pthread.h>
+#include <fcntl.h>
 #include <sys/poll.h>
 #include <libdvbapi/dvbdemux.h>
 #include <libucsi/section.h>
@@ -40,13 +41,25 @@ static pthread_t dvbthread;
 
 static int pat_version = -1;
 static int ca_pmt_version = -1;
+static int pmt_pid = -1;
+static int cache_pmt_version = -1;
+
+// a PMT from the cache, replayed to the CAM as soon as the frontend locks
+static uint8_t cached_pmt[4096];
+static int cached_pmt_size = 0;
 
 static void *dvbthread_func(void* arg);
 
 static void process_pat(int pat_fd, struct zap_dvb_params *params, int *pmt_fd, struct pollfd *pollfd);
 static void process_tdt(int tdt_fd);
 static void process_pmt(int pmt_fd, struct zap_dvb_params *params);
+static void watch_pmt(int pmt_fd, struct zap_dvb_params *params, int version);
 static int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t table_id);
+static void watch_section_filter(int fd, uint16_t pid, uint8_t table_id, int table_id_ext, int version);
+static void pmt_cache_name(struct zap_dvb_params *params, char *name, int size);
+static int pmt_cache_load(struct zap_dvb_params *params);
+static void pmt_cache_save(struct zap_dvb_params *params, uint8_t *section, int size);
+static void pmt_cache_replay(void);
 
 
 int zap_dvb_start(struct zap_dvb_params *params)
@@ -67,7 +80,8 @@ static void *dvbthread_func(void* arg)
 	int pat_fd = -1;
 	int pmt_fd = -1;
 	int tdt_fd = -1;
-	struct pollfd pollfds[3];
+	int eit_fd = -1;
+	struct pollfd pollfds[4];
 
 	struct zap_dvb_params *params = (struct zap_dvb_params *) arg;
 
@@ -92,6 +106,29 @@ static void *dvbthread_func(void* arg)
 	pollfds[2].fd = 0;
 	pollfds[2].events = 0;
 
+	// EIT present/following for the UI
+	pollfds[3].fd = -1;
+	pollfds[3].events = 0;
+	if (params->nownext) {
+		if ((eit_fd = dvbnownext_open(params->adapter_id, params->demux_id)) < 0) {
+			fprintf(stderr, "Failed to create EIT section filter\n");
+			exit(1);
+		}
+		pollfds[3].fd = eit_fd;
+		pollfds[3].events = POLLIN|POLLPRI|POLLERR;
+	}
+
+	// with a cached PMT pid, start its filter now alongside the PAT one
+	if (params->pmt_cache_dir && ((pmt_pid = pmt_cache_load(params)) >= 0)) {
+		if ((pmt_fd = create_section_filter(params->adapter_id, params->demux_id,
+						    pmt_pid, stag_mpeg_program_map)) < 0) {
+			pmt_pid = -1;
+		} else {
+			pollfds[2].fd = pmt_fd;
+			pollfds[2].events = POLLIN|POLLPRI|POLLERR;
+		}
+	}
+
 	// the DVB loop
 	while(!dvbthread_shutdown) {
 		// tune frontend + monitor lock status
@@ -165,13 +202,14 @@ static void *dvbthread_func(void* arg)
 				tune_state++;
 				fprintf(stderr, "\n");
 				fflush(stderr);
+				pmt_cache_replay();
 			} else {
 				usleep(500000);
 			}
 		}
 
 		// is there SI data?
-		int count = poll(pollfds, 3, 100);
+		int count = poll(pollfds, 4, 100);
 		if (count < 0) {
 			fprintf(stderr, "Poll error\n");
 			break;
@@ -194,6 +232,12 @@ static void *dvbthread_func(void* arg)
 		if (pollfds[2].revents & (POLLIN|POLLPRI)) {
 			process_pmt(pmt_fd, params);
 		}
+
+		// EIT: each service's repeats are dropped unless its version changed
+		if (pollfds[3].revents & (POLLIN|POLLPRI)) {
+			while(dvbnownext_process(params->nownext, eit_fd) >= 0)
+				;
+		}
 	}
 
 	// close demuxers
@@ -203,6 +247,8 @@ static void *dvbthread_func(void* arg)
 		close(pmt_fd);
 	if (tdt_fd != -1)
 		close(tdt_fd);
+	if (eit_fd != -1)
+		close(eit_fd);
 
 	return 0;
 }
@@ -242,9 +288,17 @@ static void process_pat(int pat_fd, struct zap_dvb_params *params, int *pmt_fd,
 	struct mpeg_pat_program *cur_program;
 	mpeg_pat_section_programs_for_each(pat, cur_program) {
 		if (cur_program->program_number == params->channel.service_id) {
+			// the PMT hasn't moved (or the cached pid was right): keep its filter
+			if ((*pmt_fd != -1) && (cur_program->pid == pmt_pid))
+				break;
+
 			// close old PMT fd
 			if (*pmt_fd != -1)
 				close(*pmt_fd);
+			*pmt_fd = -1;
+			pollfd->fd = 0;
+			pollfd->events = 0;
+			pmt_pid = -1;
 
 			// create PMT filter
 			if ((*pmt_fd = create_section_filter(params->adapter_id, params->demux_id,
@@ -253,6 +307,8 @@ static void process_pat(int pat_fd, struct zap_dvb_params *params, int *pmt_fd,
 			}
 			pollfd->fd = *pmt_fd;
 			pollfd->events = POLLIN|POLLPRI|POLLERR;
+			pmt_pid = cur_program->pid;
+			cache_pmt_version = -1;
 
 			// we have a new PMT pid
 			ca_pmt_version = -1;
@@ -260,8 +316,9 @@ static void process_pat(int pat_fd, struct zap_dvb_params *params, int *pmt_fd,
 		}
 	}
 
-	// remember the PAT version
+	// remember the PAT version, and sleep until the next one
 	pat_version = section_ext->version_number;
+	watch_section_filter(pat_fd, TRANSPORT_PAT_PID, stag_mpeg_program_association, -1, pat_version);
 }
 
 static void process_tdt(int tdt_fd)
@@ -311,8 +368,11 @@ static void process_pmt(int pmt_fd, struct zap_dvb_params *params)
 	if (section_ext == NULL) {
 		return;
 	}
-	if ((section_ext->table_id_ext != params->channel.service_id) ||
-	    (section_ext->version_number == ca_pmt_version)) {
+	if (section_ext->table_id_ext != params->channel.service_id) {
+		return;
+	}
+	if (section_ext->version_number == ca_pmt_version) {
+		watch_pmt(pmt_fd, params, section_ext->version_number);
 		return;
 	}
 
@@ -322,9 +382,26 @@ static void process_pmt(int pmt_fd, struct zap_dvb_params *params)
 		return;
 	}
 
+	// remember it for the next zap to this channel
+	if (params->pmt_cache_dir && (pmt->head.version_number != cache_pmt_version)) {
+		pmt_cache_save(params, sibuf, size);
+		cache_pmt_version = pmt->head.version_number;
+	}
+
 	// do ca handling
 	if (zap_ca_new_pmt(pmt) == 1)
 		ca_pmt_version = pmt->head.version_number;
+
+	watch_pmt(pmt_fd, params, pmt->head.version_number);
+}
+
+static void watch_pmt(int pmt_fd, struct zap_dvb_params *params, int version)
+{
+	// everything has this version: sleep until the next one
+	if ((version == ca_pmt_version) &&
+	    (!params->pmt_cache_dir || (version == cache_pmt_version)))
+		watch_section_filter(pmt_fd, pmt_pid, stag_mpeg_program_map,
+				     params->channel.service_id, version);
 }
 
 static int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t table_id)
@@ -351,3 +428,116 @@ static int create_section_filter(int adapter, int demux, uint16_t pid, uint8_t t
 	// done
 	return demux_fd;
 }
+
+/*
+ * Once a table has been dealt with, re-arm its filter to pass only other
+ * version_numbers, so the DVB thread sleeps while the table stays the same.
+ * If that fails, the filter just goes on passing everything.
+ */
+static void watch_section_filter(int fd, uint16_t pid, uint8_t table_id, int table_id_ext, int version)
+{
+	uint8_t filter[18];
+	uint8_t mask[18];
+
+	memset(filter, 0, sizeof(filter));
+	memset(mask, 0, sizeof(mask));
+	filter[0] = table_id;
+	mask[0] = 0xFF;
+	if (table_id_ext != -1) {
+		filter[3] = table_id_ext >> 8;
+		filter[4] = table_id_ext & 0xFF;
+		mask[3] = 0xFF;
+		mask[4] = 0xFF;
+	}
+	dvbdemux_set_section_filter_changed(fd, pid, filter, mask, version, 1, 1);
+}
+
+/*
+ * PMT cache: one file per service and transponder in the cache directory,
+ * holding the PMT pid (2 bytes, big endian) followed by the raw PMT section.
+ */
+static void pmt_cache_name(struct zap_dvb_params *params, char *name, int size)
+{
+	snprintf(name, size, "%s/%u-%04x.pmt", params->pmt_cache_dir,
+		 params->channel.fe_params.frequency, params->channel.service_id);
+}
+
+static int pmt_cache_load(struct zap_dvb_params *params)
+{
+	char name[PATH_MAX];
+	uint8_t buf[2 + sizeof(cached_pmt)];
+	int fd;
+	int size;
+
+	pmt_cache_name(params, name, sizeof(name));
+	if ((fd = open(name, O_RDONLY)) < 0)
+		return -1;
+	size = read(fd, buf, sizeof(buf));
+	close(fd);
+	if (size < 2 + 3)
+		return -1;
+	size -= 2;
+
+	// section_codec() works in place: keep a pristine copy for the replay
+	memcpy(cached_pmt, buf + 2, size);
+
+	// check it is still a valid PMT for this service
+	struct section *section = section_codec(buf + 2, size);
+	if (section == NULL)
+		return -1;
+	struct section_ext *section_ext = section_ext_decode(section, 1);
+	if ((section_ext == NULL) || (section_ext->table_id_ext != params->channel.service_id))
+		return -1;
+	if (mpeg_pmt_section_codec(section_ext) == NULL)
+		return -1;
+	cached_pmt_size = size;
+
+	return ((buf[0] & 0x1f) << 8) | buf[1];
+}
+
+static void pmt_cache_save(struct zap_dvb_params *params, uint8_t *section, int size)
+{
+	char name[PATH_MAX];
+	char tmpname[PATH_MAX + 8];
+	uint8_t pid[2];
+	int fd;
+
+	pmt_cache_name(params, name, sizeof(name));
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", name);
+	if ((fd = open(tmpname, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0)
+		return;
+
+	pid[0] = pmt_pid >> 8;
+	pid[1] = pmt_pid & 0xff;
+	if ((write(fd, pid, 2) != 2) || (write(fd, section, size) != size)) {
+		close(fd);
+		unlink(tmpname);
+		return;
+	}
+	close(fd);
+	if (rename(tmpname, name))
+		unlink(tmpname);
+}
+
+static void pmt_cache_replay(void)
+{
+	if (cached_pmt_size == 0)
+		return;
+
+	struct section *section = section_codec(cached_pmt, cached_pmt_size);
+	cached_pmt_size = 0;
+	if (section == NULL)
+		return;
+	struct section_ext *section_ext = section_ext_decode(section, 0);
+	if (section_ext == NULL)
+		return;
+	struct mpeg_pmt_section *pmt = mpeg_pmt_section_codec(section_ext);
+	if (pmt == NULL)
+		return;
+
+	// the live PMT of the same version then needs no second CA PMT, and
+	// is what the cache holds already
+	if ((ca_pmt_version == -1) && (zap_ca_new_pmt(pmt) == 1))
+		ca_pmt_version = pmt->head.version_number;
+	cache_pmt_version = pmt->head.version_number;
+}
@@ -24,6 +24,7 @@
 
 #include <libdvbcfg/dvbcfg_zapchannel.h>
 #include <libdvbsec/dvbsec_api.h>
+#include <libdvbepg/dvbnownext.h>
 
 struct zap_dvb_params {
 	int adapter_id;
@@ -33,6 +34,8 @@ struct zap_dvb_params {
 	struct dvbsec_config sec;
 	int valid_sec;
 	struct dvbfe_handle *fe;
+	char *pmt_cache_dir;		// NULL: no PMT cache
+	struct dvbnownext *nownext;	// NULL: present/following not tracked
 };
 
 extern int zap_dvb_start(struct zap_dvb_params *params);